@@ -53,9 +53,17 @@
 #include "src/engine/profiler.cc"
 
 #include "src/executor/graph_executor.cc"
+#include "src/executor/amp_pass.cc"
 #include "src/executor/attach_op_execs_pass.cc"
 #include "src/executor/attach_op_resource_pass.cc"
+#include "src/executor/constant_fold_pass.cc"
+#include "src/executor/fuse_bn_relu_pass.cc"
+#include "src/executor/fuse_elemwise_pass.cc"
+#include "src/executor/infer_storage_type_pass.cc"
 #include "src/executor/inplace_addto_detect_pass.cc"
+#include "src/executor/layout_pass.cc"
+#include "src/executor/offload_pass.cc"
+#include "src/executor/plan_mirror_pass.cc"
 
 #include "src/nnvm/legacy_json_util.cc"
 #include "src/nnvm/legacy_op_util.cc"
@@ -28,7 +28,7 @@ import sys
 import ctypes
 import numpy as np
 
-__all__ = ["Predictor", "load_ndarray_file"]
+__all__ = ["Predictor", "PredictBatcher", "load_ndarray_file"]
 
 if sys.version_info[0] == 3:
     py_str = lambda x: x.decode('utf-8')
@@ -78,6 +78,7 @@ mx_float = ctypes.c_float
 mx_float_p = ctypes.POINTER(mx_float)
 PredictorHandle = ctypes.c_void_p
 NDListHandle = ctypes.c_void_p
+PredictBatcherHandle = ctypes.c_void_p
 
 devstr2type = {'cpu': 1, 'gpu': 2, 'cpu_pinned': 3}
 
@@ -129,7 +130,126 @@ class Predictor(object):
         self.handle = handle
 
     def __del__(self):
-        _check_call(_LIB.MXPredFree(self.handle))
+        # the predictors of the buckets are freed with the one they belong to
+        if getattr(self, '_owner', None) is None:
+            _check_call(_LIB.MXPredFree(self.handle))
+
+    def clone(self, input_shapes=None):
+        """Create a predictor that shares the weights of this one.
+
+        The new predictor has its own inputs and activations, so that the two
+        can run in different threads with one copy of the weights.
+
+        Parameters
+        ----------
+        input_shapes : dict of str to tuple, optional
+            The new shapes of some inputs, such as another batch size.
+            The shapes of this predictor by default.
+
+        Returns
+        -------
+        out : Predictor
+            The new predictor.
+        """
+        indptr = [0]
+        sdata = []
+        keys = []
+        for k, v in (input_shapes or {}).items():
+            if not isinstance(v, tuple):
+                raise ValueError("Expect input_shapes to be dict str->tuple")
+            keys.append(c_str(k))
+            sdata.extend(v)
+            indptr.append(len(sdata))
+        handle = PredictorHandle()
+        _check_call(_LIB.MXPredCreateShared(
+            self.handle,
+            mx_uint(len(indptr) - 1),
+            c_array(ctypes.c_char_p, keys),
+            c_array(mx_uint, indptr),
+            c_array(mx_uint, sdata),
+            ctypes.byref(handle)))
+        out = Predictor.__new__(Predictor)
+        out.handle = handle
+        return out
+
+    def reshape(self, input_shapes):
+        """Create a predictor for other input shapes, such as another batch size.
+
+        The new predictor reads the weights of this one and reuses the memory
+        of its executor, the two must not run at the same time.
+
+        Parameters
+        ----------
+        input_shapes : dict of str to tuple
+            The new shapes of the inputs.
+
+        Returns
+        -------
+        out : Predictor
+            The reshaped predictor.
+        """
+        indptr = [0]
+        sdata = []
+        keys = []
+        for k, v in input_shapes.items():
+            if not isinstance(v, tuple):
+                raise ValueError("Expect input_shapes to be dict str->tuple")
+            keys.append(c_str(k))
+            sdata.extend(v)
+            indptr.append(len(sdata))
+        handle = PredictorHandle()
+        _check_call(_LIB.MXPredReshape(
+            mx_uint(len(indptr) - 1),
+            c_array(ctypes.c_char_p, keys),
+            c_array(mx_uint, indptr),
+            c_array(mx_uint, sdata),
+            self.handle,
+            ctypes.byref(handle)))
+        out = Predictor.__new__(Predictor)
+        out.handle = handle
+        return out
+
+    def bucket(self, bucket_key, input_shapes=None):
+        """Get the predictor of a bucket, such as a sequence length.
+
+        The predictor is reshaped from this one the first time and kept, the
+        predictors of the buckets share the memory of this one, which should
+        take the largest inputs, and must not run at the same time.
+
+        Parameters
+        ----------
+        bucket_key : int
+            The key of the bucket.
+        input_shapes : dict of str to tuple
+            The shapes of the inputs of the bucket, only used the first time.
+
+        Returns
+        -------
+        out : Predictor
+            The predictor of the bucket.
+        """
+        indptr = [0]
+        sdata = []
+        keys = []
+        for k, v in (input_shapes or {}).items():
+            if not isinstance(v, tuple):
+                raise ValueError("Expect input_shapes to be dict str->tuple")
+            keys.append(c_str(k))
+            sdata.extend(v)
+            indptr.append(len(sdata))
+        handle = PredictorHandle()
+        _check_call(_LIB.MXPredGetBucket(
+            self.handle,
+            ctypes.c_int(bucket_key),
+            mx_uint(len(indptr) - 1),
+            c_array(ctypes.c_char_p, keys),
+            c_array(mx_uint, indptr),
+            c_array(mx_uint, sdata),
+            ctypes.byref(handle)))
+        out = Predictor.__new__(Predictor)
+        out.handle = handle
+        out._owner = self
+        return out
 
     def forward(self, **kwargs):
         """Perform forward to get the output.
@@ -182,6 +302,77 @@ class Predictor(object):
         return data
 
 
+class PredictBatcher(object):
+    """Runs the samples that many threads submit in batches.
+
+    A worker waits until there are samples for the largest batch size, or
+    until the oldest one has waited max_delay_us, and runs them with its
+    predictor of the smallest batch size that holds them. The predictors
+    share the weights of the given one.
+
+    Parameters
+    ----------
+    predictor : Predictor
+        The predictor whose weights are shared.
+
+    input_key : str
+        The input of the samples, whose first axis is the batch.
+
+    batch_sizes : list of int
+        The batch sizes the samples are padded to.
+
+    num_workers : int, optional
+        The number of batches that run at the same time.
+
+    max_delay_us : int, optional
+        The longest a sample waits for a fuller batch, in microseconds.
+    """
+    def __init__(self, predictor, input_key, batch_sizes,
+                 num_workers=1, max_delay_us=1000):
+        handle = PredictBatcherHandle()
+        _check_call(_LIB.MXPredBatcherCreate(
+            predictor.handle, c_str(input_key),
+            mx_uint(len(batch_sizes)),
+            c_array(mx_uint, batch_sizes),
+            mx_uint(num_workers), mx_uint(max_delay_us),
+            ctypes.byref(handle)))
+        self.handle = handle
+        self.output_shapes = []
+        while True:
+            pdata = ctypes.POINTER(mx_uint)()
+            ndim = mx_uint()
+            if _LIB.MXPredBatcherGetOutputShape(
+                    self.handle, mx_uint(len(self.output_shapes)),
+                    ctypes.byref(pdata), ctypes.byref(ndim)) != 0:
+                break
+            self.output_shapes.append(tuple(pdata[:ndim.value]))
+
+    def __del__(self):
+        _check_call(_LIB.MXPredBatcherFree(self.handle))
+
+    def run(self, data):
+        """Run one sample, the calls of other threads join its batch.
+
+        Parameters
+        ----------
+        data : numpy array
+            The input of the sample, without the batch axis.
+
+        Returns
+        -------
+        out : list of numpy array
+            The outputs of the sample, without the batch axis.
+        """
+        data = np.ascontiguousarray(data, dtype=np.float32)
+        outs = [np.empty(s, dtype=np.float32) for s in self.output_shapes]
+        _check_call(_LIB.MXPredBatcherRun(
+            self.handle, data.ctypes.data_as(mx_float_p), mx_uint(data.size),
+            mx_uint(len(outs)),
+            c_array(mx_float_p, [o.ctypes.data_as(mx_float_p) for o in outs]),
+            c_array(mx_uint, [o.size for o in outs])))
+        return outs
+
+
 def load_ndarray_file(nd_bytes):
     """Load ndarray file and return as list of numpy array.
 
@@ -0,0 +1,114 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+
+"""Writes a copy of mxnet_predict0.cc that includes only the operator sources
+registering the operators of some models, and of the operators they look up.
+
+python select_ops.py mxnet_predict0.cc out.cc [--symbol model-symbol.json]... [--ops A,B]
+"""
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import re
+
+MXNET_ROOT = os.path.realpath(os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                                           os.pardir))
+
+# the operator sources every build needs
+CORE = ['src/operator/operator.cc', 'src/operator/operator_util.cc']
+
+RE_REGISTER = re.compile(
+    r'^\s*(?:NNVM_REGISTER_OP|MXNET_REGISTER_OP_PROPERTY|MXNET_OPERATOR_REGISTER_[A-Z0-9_]+)'
+    r'\(\s*(\w+)', re.M)
+RE_ALIAS = re.compile(r'add_alias\(\s*"([^"]+)"\s*\)')
+RE_GET = re.compile(r'Op::Get\(\s*"([^"]+)"\s*\)')
+RE_INCLUDE = re.compile(r'^#include "(src/operator/[^"]+\.cc)"')
+
+
+def op_sources():
+    """Returns the map of each operator name to the sources registering it,
+    an operator may set its attributes in several."""
+    sources = {}
+    top = os.path.join(MXNET_ROOT, 'src', 'operator')
+    for root, dirs, files in os.walk(top):
+        dirs.sort()
+        for name in sorted(files):
+            if not name.endswith('.cc'):
+                continue
+            path = os.path.join(root, name)
+            rel = os.path.relpath(path, MXNET_ROOT).replace(os.sep, '/')
+            text = open(path).read()
+            for op in RE_REGISTER.findall(text) + RE_ALIAS.findall(text):
+                sources.setdefault(op, set()).add(rel)
+    return sources
+
+
+def symbol_ops(fname):
+    """Returns the operators of the nodes of a symbol json file."""
+    nodes = json.load(open(fname))['nodes']
+    return set(node['op'] for node in nodes if node['op'] != 'null')
+
+
+def select(ops, sources):
+    """Returns the sources of ops and of the operators they look up."""
+    missing = sorted(op for op in ops if op not in sources)
+    if missing:
+        raise ValueError('Unknown operators: ' + ', '.join(missing))
+    selected = set()
+    pending = list(ops)
+    while pending:
+        for src in sources[pending.pop()] - selected:
+            selected.add(src)
+            text = open(os.path.join(MXNET_ROOT, src)).read()
+            pending.extend(op for op in RE_GET.findall(text) if op in sources)
+    return selected
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('template', help='the amalgamation source, mxnet_predict0.cc')
+    parser.add_argument('output', help='the source to write')
+    parser.add_argument('--symbol', action='append', default=[],
+                        help='a symbol json file whose operators are kept')
+    parser.add_argument('--ops', default='', help='comma separated operators to keep')
+    args = parser.parse_args()
+
+    ops = set(op for op in args.ops.split(',') if op)
+    for fname in args.symbol:
+        ops |= symbol_ops(fname)
+    selected = select(ops, op_sources())
+    out = []
+    for line in open(args.template):
+        m = RE_INCLUDE.match(line)
+        if m is None:
+            out.append(line)
+            continue
+        # the operator sources of the template are replaced by the selected ones
+        if m.group(1) in CORE:
+            out.append(line)
+        if m.group(1) == CORE[-1]:
+            out.extend('#include "%s"\n' % x for x in sorted(selected - set(CORE)))
+    with open(args.output, 'w') as f:
+        f.write(''.join(out))
+    print('Selected %d operators in %d sources' % (len(ops), len(selected)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,740 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*!
+ * \file benchmark.cpp
+ * \brief forward-only and training throughput of common models on synthetic data
+ *
+ * The models are built from the symbol API and run on data generated on the devices
+ * once, so that the steps measure the models alone. The arguments are key=value pairs,
+ * the lists separated by commas:
+ *  - model: resnet50, inception_v3, lstm_lm, ssd or transformer, resnet50 by default
+ *  - batch_size: the batch sizes over all the devices, 32 by default
+ *  - dtype: float32 or float16, float32 by default
+ *  - gpus: the ids of the gpus, the cpu if empty, which is the default
+ *  - mode: inference or train, both by default
+ *  - kvstore: the kvstore of the gradients, e.g. device or dist_sync, none by default,
+ *    which updates the weights on the single device
+ *  - warmup: the number of untimed steps, 5 by default
+ *  - iters: the number of timed steps, 50 by default
+ *
+ * Each measurement is a line of JSON, e.g.
+ * \code
+ * {"model": "resnet50", "mode": "train", "batch_size": 64, "dtype": "float16",
+ *  "devices": 2, "kvstore": "device", "samples_per_sec": 512.3, "unit": "img",
+ *  "step_ms": {"mean": 124.9, "p50": 124.1, "p90": 127, "p99": 131.2},
+ *  "peak_bytes": 9632087040}
+ * \endcode
+ * where samples_per_sec counts the units, the images or the tokens, and peak_bytes
+ * is the largest peak of the devices since the start of the process, so that a
+ * configuration run alone reports its own. For instance
+ * \code
+ * ./benchmark model=resnet50 batch_size=32,64,128 dtype=float32,float16 gpus=0,1,2,3 \
+ *     kvstore=device mode=train
+ * \endcode
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "mxnet-cpp/MxNetCpp.h"
+
+using namespace mxnet::cpp;
+
+namespace {
+
+std::vector<std::string> Split(const std::string& s) {
+  std::vector<std::string> ret;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (!item.empty()) ret.push_back(item);
+  }
+  return ret;
+}
+
+/*! \brief the layers of the models, named after the operators they create */
+class Layers {
+ public:
+  explicit Layers(const std::string& dtype) : dtype_(dtype) {}
+
+  /*! \brief the input of the model cast to the benchmarked type */
+  Symbol In(Symbol x) {
+    if (dtype_ == "float32") return x;
+    return Operator("Cast").SetParam("dtype", dtype_).SetInput("data", x)
+        .CreateSymbol(Name("cast"));
+  }
+
+  /*! \brief an output cast back to float32 for the losses */
+  Symbol Out(Symbol x) {
+    if (dtype_ == "float32") return x;
+    return Operator("Cast").SetParam("dtype", "float32").SetInput("data", x)
+        .CreateSymbol(Name("cast"));
+  }
+
+  Symbol Conv(Symbol x, int num_filter, Shape kernel, Shape stride = Shape(1, 1),
+              Shape pad = Shape(0, 0), bool no_bias = true) {
+    return Operator("Convolution")
+        .SetParam("kernel", kernel)
+        .SetParam("num_filter", num_filter)
+        .SetParam("stride", stride)
+        .SetParam("pad", pad)
+        .SetParam("no_bias", no_bias)
+        .SetParam("workspace", 1024)
+        .SetInput("data", x)
+        .CreateSymbol(Name("conv"));
+  }
+
+  Symbol BN(Symbol x) {
+    return Operator("BatchNorm")
+        .SetParam("eps", 2e-5)
+        .SetParam("momentum", 0.9)
+        .SetParam("fix_gamma", false)
+        .SetInput("data", x)
+        .CreateSymbol(Name("bn"));
+  }
+
+  Symbol Act(Symbol x, const std::string& type = "relu") {
+    return Operator("Activation").SetParam("act_type", type).SetInput("data", x)
+        .CreateSymbol(Name(type));
+  }
+
+  /*! \brief a convolution followed by a batch normalization and a relu */
+  Symbol ConvBNReLU(Symbol x, int num_filter, Shape kernel, Shape stride = Shape(1, 1),
+                    Shape pad = Shape(0, 0)) {
+    return Act(BN(Conv(x, num_filter, kernel, stride, pad)));
+  }
+
+  Symbol Pool(Symbol x, const std::string& type, Shape kernel, Shape stride = Shape(1, 1),
+              Shape pad = Shape(0, 0)) {
+    return Operator("Pooling")
+        .SetParam("kernel", kernel)
+        .SetParam("pool_type", type)
+        .SetParam("stride", stride)
+        .SetParam("pad", pad)
+        .SetInput("data", x)
+        .CreateSymbol(Name("pool"));
+  }
+
+  Symbol GlobalPool(Symbol x) {
+    return Operator("Pooling")
+        .SetParam("kernel", Shape(1, 1))
+        .SetParam("pool_type", "avg")
+        .SetParam("global_pool", true)
+        .SetInput("data", x)
+        .CreateSymbol(Name("pool"));
+  }
+
+  Symbol FC(Symbol x, int num_hidden) {
+    return Operator("FullyConnected").SetParam("num_hidden", num_hidden).SetInput("data", x)
+        .CreateSymbol(Name("fc"));
+  }
+
+  /*! \brief a fully connected layer with given weights, shared across the time steps */
+  Symbol FC(Symbol x, Symbol weight, Symbol bias, int num_hidden) {
+    return Operator("FullyConnected")
+        .SetParam("num_hidden", num_hidden)
+        .SetInput("data", x)
+        .SetInput("weight", weight)
+        .SetInput("bias", bias)
+        .CreateSymbol(Name("fc"));
+  }
+
+  Symbol Concat(const std::vector<Symbol>& xs, int dim = 1) {
+    return Operator("Concat")
+        .SetParam("num_args", static_cast<int>(xs.size()))
+        .SetParam("dim", dim)(xs)
+        .CreateSymbol(Name("concat"));
+  }
+
+  Symbol Flatten(Symbol x) {
+    return Operator("Flatten").SetInput("data", x).CreateSymbol(Name("flatten"));
+  }
+
+  /*! \brief a reshape to a Shape, or to a string with the special values, e.g. "(0,-1)" */
+  template<typename T>
+  Symbol Reshape(Symbol x, const T& shape) {
+    return Operator("Reshape").SetParam("shape", shape).SetInput("data", x)
+        .CreateSymbol(Name("reshape"));
+  }
+
+  Symbol Transpose(Symbol x, Shape axes) {
+    return Operator("transpose").SetParam("axes", axes).SetInput("data", x)
+        .CreateSymbol(Name("transpose"));
+  }
+
+  Symbol Softmax(Symbol x, Symbol label) {
+    return Operator("SoftmaxOutput").SetInput("data", x).SetInput("label", label)
+        .CreateSymbol("softmax");
+  }
+
+  /*! \return a name unique in the model, as the auto naming is per process */
+  std::string Name(const std::string& op) {
+    return op + std::to_string(count_++);
+  }
+
+ private:
+  std::string dtype_;
+  int count_{0};
+};
+
+/*! \brief a model of the benchmark, for a batch size per device */
+struct Model {
+  Symbol net;
+  /*! \brief the shapes of the inputs, the data, the labels and the initial states */
+  std::map<std::string, std::vector<mx_uint> > inputs;
+  /*! \brief the inputs of token ids below the value by name, the others are uniform */
+  std::map<std::string, int> int_inputs;
+  /*! \brief the units a sample counts for, e.g. its tokens */
+  int units_per_sample{1};
+  std::string unit{"img"};
+};
+
+Symbol ResNet50Body(Layers* l, Symbol x, std::vector<Symbol>* stages = nullptr) {
+  x = l->ConvBNReLU(x, 64, Shape(7, 7), Shape(2, 2), Shape(3, 3));
+  x = l->Pool(x, "max", Shape(3, 3), Shape(2, 2), Shape(1, 1));
+  const int units[] = {3, 4, 6, 3};
+  const int filters[] = {256, 512, 1024, 2048};
+  for (int s = 0; s < 4; ++s) {
+    for (int u = 0; u < units[s]; ++u) {
+      const Shape stride = (u == 0 && s > 0) ? Shape(2, 2) : Shape(1, 1);
+      const int f = filters[s];
+      Symbol y = l->ConvBNReLU(x, f / 4, Shape(1, 1));
+      y = l->ConvBNReLU(y, f / 4, Shape(3, 3), stride, Shape(1, 1));
+      y = l->BN(l->Conv(y, f, Shape(1, 1)));
+      Symbol shortcut = x;
+      if (u == 0) shortcut = l->BN(l->Conv(x, f, Shape(1, 1), stride));
+      x = l->Act(y + shortcut);
+    }
+    if (stages != nullptr) stages->push_back(x);
+  }
+  return x;
+}
+
+Model ResNet50(const std::string& dtype, mx_uint batch, bool train) {
+  Layers l(dtype);
+  Symbol x = ResNet50Body(&l, l.In(Symbol::Variable("data")));
+  x = l.FC(l.Flatten(l.GlobalPool(x)), 1000);
+  Model m;
+  m.net = l.Softmax(l.Out(x), Symbol::Variable("softmax_label"));
+  m.inputs["data"] = {batch, 3, 224, 224};
+  m.inputs["softmax_label"] = {batch};
+  m.int_inputs["softmax_label"] = 1000;
+  return m;
+}
+
+Model InceptionV3(const std::string& dtype, mx_uint batch, bool train) {
+  Layers l(dtype);
+  auto conv = [&l](Symbol x, int f, Shape k, Shape s = Shape(1, 1), Shape p = Shape(0, 0)) {
+    return l.ConvBNReLU(x, f, k, s, p);
+  };
+  auto pool = [&l](Symbol x, const std::string& type) {
+    return l.Pool(x, type, Shape(3, 3), Shape(1, 1), Shape(1, 1));
+  };
+  Symbol x = l.In(Symbol::Variable("data"));
+  // stem
+  x = conv(x, 32, Shape(3, 3), Shape(2, 2));
+  x = conv(x, 32, Shape(3, 3));
+  x = conv(x, 64, Shape(3, 3), Shape(1, 1), Shape(1, 1));
+  x = l.Pool(x, "max", Shape(3, 3), Shape(2, 2));
+  x = conv(x, 80, Shape(1, 1));
+  x = conv(x, 192, Shape(3, 3));
+  x = l.Pool(x, "max", Shape(3, 3), Shape(2, 2));
+  // 35x35
+  for (int proj : {32, 64, 64}) {
+    Symbol b5 = conv(conv(x, 48, Shape(1, 1)), 64, Shape(5, 5), Shape(1, 1), Shape(2, 2));
+    Symbol b3 = conv(x, 64, Shape(1, 1));
+    b3 = conv(b3, 96, Shape(3, 3), Shape(1, 1), Shape(1, 1));
+    b3 = conv(b3, 96, Shape(3, 3), Shape(1, 1), Shape(1, 1));
+    x = l.Concat({conv(x, 64, Shape(1, 1)), b5, b3, conv(pool(x, "avg"), proj, Shape(1, 1))});
+  }
+  {
+    Symbol b3 = conv(x, 384, Shape(3, 3), Shape(2, 2));
+    Symbol bd = conv(x, 64, Shape(1, 1));
+    bd = conv(bd, 96, Shape(3, 3), Shape(1, 1), Shape(1, 1));
+    bd = conv(bd, 96, Shape(3, 3), Shape(2, 2));
+    x = l.Concat({b3, bd, l.Pool(x, "max", Shape(3, 3), Shape(2, 2))});
+  }
+  // 17x17
+  for (int n : {128, 160, 160, 192}) {
+    Symbol b7 = conv(x, n, Shape(1, 1));
+    b7 = conv(b7, n, Shape(1, 7), Shape(1, 1), Shape(0, 3));
+    b7 = conv(b7, 192, Shape(7, 1), Shape(1, 1), Shape(3, 0));
+    Symbol bd = conv(x, n, Shape(1, 1));
+    bd = conv(bd, n, Shape(7, 1), Shape(1, 1), Shape(3, 0));
+    bd = conv(bd, n, Shape(1, 7), Shape(1, 1), Shape(0, 3));
+    bd = conv(bd, n, Shape(7, 1), Shape(1, 1), Shape(3, 0));
+    bd = conv(bd, 192, Shape(1, 7), Shape(1, 1), Shape(0, 3));
+    x = l.Concat({conv(x, 192, Shape(1, 1)), b7, bd, conv(pool(x, "avg"), 192, Shape(1, 1))});
+  }
+  {
+    Symbol b3 = conv(conv(x, 192, Shape(1, 1)), 320, Shape(3, 3), Shape(2, 2));
+    Symbol b7 = conv(x, 192, Shape(1, 1));
+    b7 = conv(b7, 192, Shape(1, 7), Shape(1, 1), Shape(0, 3));
+    b7 = conv(b7, 192, Shape(7, 1), Shape(1, 1), Shape(3, 0));
+    b7 = conv(b7, 192, Shape(3, 3), Shape(2, 2));
+    x = l.Concat({b3, b7, l.Pool(x, "max", Shape(3, 3), Shape(2, 2))});
+  }
+  // 8x8
+  for (const char* type : {"avg", "max"}) {
+    Symbol b3 = conv(x, 384, Shape(1, 1));
+    Symbol bd = conv(x, 448, Shape(1, 1));
+    bd = conv(bd, 384, Shape(3, 3), Shape(1, 1), Shape(1, 1));
+    x = l.Concat({conv(x, 320, Shape(1, 1)),
+                  conv(b3, 384, Shape(1, 3), Shape(1, 1), Shape(0, 1)),
+                  conv(b3, 384, Shape(3, 1), Shape(1, 1), Shape(1, 0)),
+                  conv(bd, 384, Shape(1, 3), Shape(1, 1), Shape(0, 1)),
+                  conv(bd, 384, Shape(3, 1), Shape(1, 1), Shape(1, 0)),
+                  conv(pool(x, type), 192, Shape(1, 1))});
+  }
+  x = l.FC(l.Flatten(l.GlobalPool(x)), 1000);
+  Model m;
+  m.net = l.Softmax(l.Out(x), Symbol::Variable("softmax_label"));
+  m.inputs["data"] = {batch, 3, 299, 299};
+  m.inputs["softmax_label"] = {batch};
+  m.int_inputs["softmax_label"] = 1000;
+  return m;
+}
+
+/*! \brief a 2 layer LSTM language model of 650 units, unrolled over 35 tokens */
+Model LSTMLM(const std::string& dtype, mx_uint batch, bool train) {
+  const int vocab = 10000, hidden = 650, layers = 2, steps = 35;
+  Layers l(dtype);
+  Symbol embed = Operator("Embedding")
+      .SetParam("input_dim", vocab)
+      .SetParam("output_dim", hidden)
+      .SetInput("data", Symbol::Variable("data"))
+      .CreateSymbol("embed");
+  Symbol tokens = Operator("SliceChannel")
+      .SetParam("num_outputs", steps)
+      .SetParam("axis", 1)
+      .SetParam("squeeze_axis", true)
+      .SetInput("data", l.In(embed))
+      .CreateSymbol("tokens");
+  std::vector<Symbol> xs;
+  for (int t = 0; t < steps; ++t) xs.push_back(tokens[t]);
+  Model m;
+  for (int i = 0; i < layers; ++i) {
+    const std::string p = "l" + std::to_string(i);
+    Symbol i2h_w(p + "_i2h_weight"), i2h_b(p + "_i2h_bias");
+    Symbol h2h_w(p + "_h2h_weight"), h2h_b(p + "_h2h_bias");
+    Symbol h = l.In(Symbol::Variable(p + "_init_h"));
+    Symbol c = l.In(Symbol::Variable(p + "_init_c"));
+    m.inputs[p + "_init_h"] = {batch, static_cast<mx_uint>(hidden)};
+    m.inputs[p + "_init_c"] = {batch, static_cast<mx_uint>(hidden)};
+    for (int t = 0; t < steps; ++t) {
+      Symbol gates = l.FC(xs[t], i2h_w, i2h_b, 4 * hidden) + l.FC(h, h2h_w, h2h_b, 4 * hidden);
+      Symbol slices = Operator("SliceChannel").SetParam("num_outputs", 4)
+          .SetInput("data", gates).CreateSymbol(l.Name("gates"));
+      Symbol in_gate = l.Act(slices[0], "sigmoid");
+      Symbol in_transform = l.Act(slices[1], "tanh");
+      Symbol forget_gate = l.Act(slices[2], "sigmoid");
+      Symbol out_gate = l.Act(slices[3], "sigmoid");
+      c = forget_gate * c + in_gate * in_transform;
+      h = out_gate * l.Act(c, "tanh");
+      xs[t] = h;
+    }
+  }
+  Symbol x = l.FC(l.Concat(xs, 0), vocab);
+  m.net = l.Softmax(l.Out(x), Symbol::Variable("softmax_label"));
+  m.inputs["data"] = {batch, static_cast<mx_uint>(steps)};
+  m.inputs["softmax_label"] = {batch * steps};
+  m.int_inputs["data"] = vocab;
+  m.int_inputs["softmax_label"] = vocab;
+  m.units_per_sample = steps;
+  m.unit = "token";
+  return m;
+}
+
+/*! \brief SSD on a ResNet-50 body for 300x300 images and 20 classes */
+Model SSD(const std::string& dtype, mx_uint batch, bool train) {
+  const int num_classes = 20, num_objects = 3;
+  Layers l(dtype);
+  std::vector<Symbol> stages;
+  ResNet50Body(&l, l.In(Symbol::Variable("data")), &stages);
+  // the feature maps of 19, 10, 5, 3 and 1 pixels
+  std::vector<Symbol> maps = {stages[2], stages[3]};
+  for (int f : {512, 256, 256}) {
+    Symbol y = l.ConvBNReLU(maps.back(), f / 2, Shape(1, 1));
+    const bool last = f == 256 && maps.size() == 4;
+    maps.push_back(l.ConvBNReLU(y, f, Shape(3, 3), Shape(2, 2),
+                                last ? Shape(0, 0) : Shape(1, 1)));
+  }
+  const char* sizes[] = {"(.2,.272)", "(.37,.447)", "(.54,.619)", "(.71,.79)", "(.88,.961)"};
+  const int num_anchors = 4;
+  std::vector<Symbol> locs, clss, anchors;
+  for (size_t i = 0; i < maps.size(); ++i) {
+    Symbol loc = l.Conv(maps[i], num_anchors * 4, Shape(3, 3), Shape(1, 1), Shape(1, 1), false);
+    locs.push_back(l.Flatten(l.Transpose(l.Out(loc), Shape(0, 2, 3, 1))));
+    Symbol cls = l.Conv(maps[i], num_anchors * (num_classes + 1), Shape(3, 3), Shape(1, 1),
+                        Shape(1, 1), false);
+    clss.push_back(l.Flatten(l.Transpose(l.Out(cls), Shape(0, 2, 3, 1))));
+    Symbol anchor = Operator("_contrib_MultiBoxPrior")
+        .SetParam("sizes", sizes[i])
+        .SetParam("ratios", "(1,2,.5)")
+        .SetInput("data", maps[i])
+        .CreateSymbol(l.Name("anchors"));
+    anchors.push_back(l.Flatten(anchor));
+  }
+  Symbol loc_preds = l.Concat(locs);
+  const std::string cls_shape = "(0,-1," + std::to_string(num_classes + 1) + ")";
+  Symbol cls_preds = l.Transpose(l.Reshape(l.Concat(clss), cls_shape), Shape(0, 2, 1));
+  Symbol anchor_boxes = l.Reshape(l.Concat(anchors), std::string("(0,-1,4)"));
+  Model m;
+  if (train) {
+    Symbol target = Operator("_contrib_MultiBoxTarget")
+        .SetInput("anchor", anchor_boxes)
+        .SetInput("label", Symbol::Variable("label"))
+        .SetInput("cls_pred", cls_preds)
+        .CreateSymbol("target");
+    Symbol cls_prob = Operator("SoftmaxOutput")
+        .SetParam("ignore_label", -1)
+        .SetParam("use_ignore", true)
+        .SetParam("multi_output", true)
+        .SetParam("normalization", "valid")
+        .SetInput("data", cls_preds)
+        .SetInput("label", target[2])
+        .CreateSymbol("cls_prob");
+    Symbol smooth_l1 = Operator("smooth_l1")
+        .SetParam("scalar", 1.0)
+        .SetInput("data", target[1] * (loc_preds - target[0]))
+        .CreateSymbol("loc_diff");
+    Symbol loc_loss = Operator("MakeLoss").SetParam("normalization", "valid")
+        .SetInput("data", smooth_l1).CreateSymbol("loc_loss");
+    m.net = Symbol::Group({cls_prob, loc_loss});
+    m.inputs["label"] = {batch, static_cast<mx_uint>(num_objects), 5};
+  } else {
+    Symbol cls_prob = Operator("softmax").SetParam("axis", 1).SetInput("data", cls_preds)
+        .CreateSymbol("cls_prob");
+    m.net = Operator("_contrib_MultiBoxDetection")
+        .SetInput("cls_prob", cls_prob)
+        .SetInput("loc_pred", loc_preds)
+        .SetInput("anchor", anchor_boxes)
+        .CreateSymbol("detection");
+  }
+  m.inputs["data"] = {batch, 3, 300, 300};
+  return m;
+}
+
+/*! \brief 6 transformer encoder blocks of 512 units and 8 heads over 128 tokens */
+Model Transformer(const std::string& dtype, mx_uint batch, bool train) {
+  const int units = 512, heads = 8, layers = 6, steps = 128;
+  const int head_units = units / heads;
+  const int rows = batch * steps;
+  Layers l(dtype);
+  // the normalization over the units, as the rows of x
+  auto layer_norm = [&l](Symbol x) {
+    Symbol mean = Operator("mean").SetParam("axis", 1).SetParam("keepdims", true)
+        .SetInput("data", x).CreateSymbol(l.Name("mean"));
+    Symbol centered = Operator("broadcast_sub").SetInput("lhs", x).SetInput("rhs", mean)
+        .CreateSymbol(l.Name("centered"));
+    Symbol var = Operator("mean").SetParam("axis", 1).SetParam("keepdims", true)
+        .SetInput("data", centered * centered).CreateSymbol(l.Name("var"));
+    Symbol std = Operator("sqrt").SetInput("data", var + 1e-5f).CreateSymbol(l.Name("std"));
+    return Operator("broadcast_div").SetInput("lhs", centered).SetInput("rhs", std)
+        .CreateSymbol(l.Name("norm"));
+  };
+  // the rows of x as the heads of each sequence, (batch * heads, steps, head_units)
+  auto split_heads = [&](Symbol x) {
+    x = l.Transpose(l.Reshape(x, Shape(batch, steps, heads, head_units)), Shape(0, 2, 1, 3));
+    return l.Reshape(x, Shape(batch * heads, steps, head_units));
+  };
+  Symbol x = l.In(Symbol::Variable("data"));
+  for (int i = 0; i < layers; ++i) {
+    Symbol q = split_heads(l.FC(x, units) * (1.0f / std::sqrt(head_units)));
+    Symbol k = split_heads(l.FC(x, units));
+    Symbol v = split_heads(l.FC(x, units));
+    Symbol scores = Operator("batch_dot").SetParam("transpose_b", true)
+        .SetInput("lhs", q).SetInput("rhs", k).CreateSymbol(l.Name("scores"));
+    Symbol att = Operator("softmax").SetParam("axis", -1).SetInput("data", scores)
+        .CreateSymbol(l.Name("attention"));
+    Symbol ctx = Operator("batch_dot").SetInput("lhs", att).SetInput("rhs", v)
+        .CreateSymbol(l.Name("context"));
+    ctx = l.Transpose(l.Reshape(ctx, Shape(batch, heads, steps, head_units)), Shape(0, 2, 1, 3));
+    ctx = l.Reshape(ctx, Shape(rows, units));
+    x = layer_norm(x + l.FC(ctx, units));
+    x = layer_norm(x + l.FC(l.Act(l.FC(x, 4 * units)), units));
+  }
+  Model m;
+  m.net = Operator("LinearRegressionOutput").SetInput("data", l.Out(x))
+      .SetInput("label", Symbol::Variable("label")).CreateSymbol("regression");
+  m.inputs["data"] = {static_cast<mx_uint>(rows), static_cast<mx_uint>(units)};
+  m.inputs["label"] = {static_cast<mx_uint>(rows), static_cast<mx_uint>(units)};
+  m.units_per_sample = steps;
+  m.unit = "token";
+  return m;
+}
+
+typedef Model (*ModelFn)(const std::string& dtype, mx_uint batch, bool train);
+
+int DTypeFlag(const std::string& dtype) {
+  if (dtype == "float32") return 0;
+  if (dtype == "float16") return 2;
+  LG << "Unknown dtype " << dtype;
+  exit(1);
+}
+
+/*! \brief an array of the inferred shape and type of an argument */
+NDArray NewArray(const std::vector<mx_uint>& shape, const Context& ctx, int dtype) {
+  NDArrayHandle handle;
+  CHECK_EQ(MXNDArrayCreateEx(shape.data(), shape.size(), ctx.GetDeviceType(),
+                             ctx.GetDeviceId(), false, dtype, &handle), 0);
+  return NDArray(handle);
+}
+
+/*! \brief the largest peak of the bytes in use of the devices */
+uint64_t PeakBytes(const std::vector<Context>& ctxs) {
+  uint64_t peak = 0;
+  for (const auto& ctx : ctxs) {
+    mx_uint size;
+    const char** keys;
+    const uint64_t* vals;
+    CHECK_EQ(MXStorageGetStats(ctx.GetDeviceType(), ctx.GetDeviceId(), &size, &keys, &vals), 0);
+    for (mx_uint i = 0; i < size; ++i) {
+      if (std::string(keys[i]) == "peak_bytes_in_use") peak = std::max(peak, vals[i]);
+    }
+  }
+  return peak;
+}
+
+struct Config {
+  std::string model;
+  std::string mode;
+  int batch_size;
+  std::string dtype;
+  std::vector<Context> ctxs;
+  std::string kvstore;
+  int warmup;
+  int iters;
+};
+
+/*! \brief the executors of the devices, their weights and their gradients */
+class Replicas {
+ public:
+  Replicas(const Config& cfg, ModelFn fn) : cfg_(cfg) {
+    const bool train = cfg.mode == "train";
+    const mx_uint batch = cfg.batch_size / cfg.ctxs.size();
+    CHECK_EQ(batch * cfg.ctxs.size(), static_cast<size_t>(cfg.batch_size))
+        << "the batch size is not a multiple of the devices";
+    model_ = fn(cfg.dtype, batch, train);
+    const std::vector<std::string> arg_names = model_.net.ListArguments();
+    std::vector<std::vector<mx_uint> > arg_shapes, aux_shapes, out_shapes;
+    model_.net.InferShape(model_.inputs, &arg_shapes, &aux_shapes, &out_shapes);
+    // every input is float32, the weights get the types the layers infer
+    std::vector<const char*> keys;
+    std::vector<int> types;
+    for (const auto& input : model_.inputs) {
+      keys.push_back(input.first.c_str());
+      types.push_back(0);
+    }
+    mx_uint num_arg_types, num_out_types, num_aux_types;
+    const int *arg_types, *out_types, *aux_types;
+    int complete;
+    CHECK_EQ(MXSymbolInferType(model_.net.GetHandle(), keys.size(), keys.data(), types.data(),
+                               &num_arg_types, &arg_types, &num_out_types, &out_types,
+                               &num_aux_types, &aux_types, &complete), 0);
+    CHECK(complete) << "cannot infer the types of " << cfg.model;
+    for (size_t d = 0; d < cfg.ctxs.size(); ++d) {
+      const Context& ctx = cfg.ctxs[d];
+      std::vector<NDArray> args, grads, aux;
+      std::vector<OpReqType> reqs;
+      for (size_t i = 0; i < arg_names.size(); ++i) {
+        NDArray arg = NewArray(arg_shapes[i], ctx, arg_types[i]);
+        args.push_back(arg);
+        if (model_.inputs.count(arg_names[i]) != 0) {
+          FillInput(arg_names[i], arg);
+          grads.push_back(NDArray());
+          reqs.push_back(kNullOp);
+          continue;
+        }
+        arg = 0.01f;
+        if (d == 0) params_.push_back(i);
+        grads.push_back(train ? NewArray(arg_shapes[i], ctx, arg_types[i]) : NDArray());
+        reqs.push_back(train ? kWriteTo : kNullOp);
+      }
+      for (size_t i = 0; i < aux_shapes.size(); ++i) {
+        aux.push_back(NewArray(aux_shapes[i], ctx, aux_types[i]));
+        aux.back() = 1.0f;
+      }
+      execs_.emplace_back(model_.net.Bind(ctx, args, grads, reqs, aux));
+    }
+    if (train) InitUpdates();
+  }
+
+  ~Replicas() {
+    NDArray::WaitAll();
+  }
+
+  const Model& model() const { return model_; }
+
+  void Step() {
+    const bool train = cfg_.mode == "train";
+    for (auto& exec : execs_) exec->Forward(train);
+    if (!train) return;
+    for (auto& exec : execs_) exec->Backward();
+    if (cfg_.kvstore == "none") {
+      for (int i : params_) {
+        optimizer_->Update(i, execs_[0]->arg_arrays[i], execs_[0]->grad_arrays[i]);
+      }
+      return;
+    }
+    std::vector<int> keys;
+    std::vector<NDArray> grads, weights;
+    for (int i : params_) {
+      for (auto& exec : execs_) {
+        keys.push_back(i);
+        grads.push_back(exec->grad_arrays[i]);
+        weights.push_back(exec->arg_arrays[i]);
+      }
+    }
+    KVStore::Push(keys, grads);
+    KVStore::Pull(keys, &weights);
+  }
+
+ private:
+  void FillInput(const std::string& name, NDArray arr) {
+    auto it = model_.int_inputs.find(name);
+    if (name == "label" && cfg_.model == "ssd") {
+      // an object of a class at a corner of the image, per label row
+      std::vector<mx_float> boxes;
+      const size_t rows = arr.Size() / 5;
+      for (size_t r = 0; r < rows; ++r) {
+        const mx_float offset = 0.1f * (r % 3);
+        boxes.insert(boxes.end(), {static_cast<mx_float>(r % 20), offset, offset,
+                                   offset + 0.5f, offset + 0.5f});
+      }
+      arr.SyncCopyFromCPU(boxes);
+    } else if (it != model_.int_inputs.end()) {
+      std::vector<mx_float> ids(arr.Size());
+      for (size_t j = 0; j < ids.size(); ++j) ids[j] = static_cast<mx_float>(j % it->second);
+      arr.SyncCopyFromCPU(ids);
+    } else {
+      NDArray::SampleUniform(-1, 1, &arr);
+    }
+  }
+
+  void InitUpdates() {
+    optimizer_.reset(OptimizerRegistry::Find("sgd"));
+    optimizer_->SetParam("lr", 0.01)->SetParam("momentum", 0.9)
+        ->SetParam("rescale_grad", 1.0 / cfg_.batch_size);
+    if (cfg_.kvstore == "none") {
+      CHECK_EQ(cfg_.ctxs.size(), 1U) << "the devices share their gradients through a kvstore";
+      return;
+    }
+    std::vector<NDArray> weights;
+    for (int i : params_) weights.push_back(execs_[0]->arg_arrays[i]);
+    KVStore::Init(params_, weights);
+    KVStore::SetOptimizer(std::move(optimizer_), cfg_.kvstore.find("dist") == std::string::npos);
+  }
+
+  const Config& cfg_;
+  Model model_;
+  std::vector<std::unique_ptr<Executor> > execs_;
+  /*! \brief the indices of the arguments updated, which are the keys of their kvstore */
+  std::vector<int> params_;
+  std::unique_ptr<Optimizer> optimizer_;
+};
+
+void Run(const Config& cfg, ModelFn fn) {
+  Replicas replicas(cfg, fn);
+  for (int i = 0; i < cfg.warmup; ++i) replicas.Step();
+  NDArray::WaitAll();
+  std::vector<double> step_ms;
+  for (int i = 0; i < cfg.iters; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    replicas.Step();
+    NDArray::WaitAll();
+    step_ms.push_back(std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count());
+  }
+  double total = 0;
+  for (double ms : step_ms) total += ms;
+  const double mean = total / step_ms.size();
+  std::sort(step_ms.begin(), step_ms.end());
+  auto percentile = [&step_ms](int p) { return step_ms[(step_ms.size() - 1) * p / 100]; };
+  const Model& m = replicas.model();
+  std::cout << "{\"model\": \"" << cfg.model << "\", \"mode\": \"" << cfg.mode
+            << "\", \"batch_size\": " << cfg.batch_size << ", \"dtype\": \"" << cfg.dtype
+            << "\", \"devices\": " << cfg.ctxs.size() << ", \"kvstore\": \"" << cfg.kvstore
+            << "\", \"samples_per_sec\": "
+            << cfg.batch_size * m.units_per_sample * 1000.0 / mean
+            << ", \"unit\": \"" << m.unit << "\", \"step_ms\": {\"mean\": " << mean
+            << ", \"p50\": " << percentile(50) << ", \"p90\": " << percentile(90)
+            << ", \"p99\": " << percentile(99) << "}, \"peak_bytes\": "
+            << PeakBytes(cfg.ctxs) << "}" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char const *argv[]) {
+  std::map<std::string, std::string> args = {
+    {"model", "resnet50"}, {"batch_size", "32"}, {"dtype", "float32"}, {"gpus", ""},
+    {"mode", "inference,train"}, {"kvstore", "none"}, {"warmup", "5"}, {"iters", "50"},
+  };
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t eq = arg.find('=');
+    if (eq == std::string::npos || args.count(arg.substr(0, eq)) == 0) {
+      LG << "Unknown argument " << arg << ", see the header of benchmark.cpp";
+      return 1;
+    }
+    args[arg.substr(0, eq)] = arg.substr(eq + 1);
+  }
+  const std::map<std::string, ModelFn> models = {
+    {"resnet50", ResNet50}, {"inception_v3", InceptionV3}, {"lstm_lm", LSTMLM},
+    {"ssd", SSD}, {"transformer", Transformer},
+  };
+  Config cfg;
+  cfg.kvstore = args["kvstore"];
+  cfg.warmup = std::stoi(args["warmup"]);
+  cfg.iters = std::max(std::stoi(args["iters"]), 1);
+  for (const auto& id : Split(args["gpus"])) cfg.ctxs.push_back(Context::gpu(std::stoi(id)));
+  if (cfg.ctxs.empty()) cfg.ctxs.push_back(Context::cpu());
+  if (cfg.kvstore != "none") {
+    KVStore::SetType(cfg.kvstore);
+    if (KVStore::GetRole() != "worker") {
+      KVStore::RunServer();
+      return 0;
+    }
+  }
+  for (const auto& model : Split(args["model"])) {
+    if (models.count(model) == 0) {
+      LG << "Unknown model " << model;
+      return 1;
+    }
+    cfg.model = model;
+    for (const auto& mode : Split(args["mode"])) {
+      cfg.mode = mode;
+      for (const auto& dtype : Split(args["dtype"])) {
+        DTypeFlag(dtype);
+        cfg.dtype = dtype;
+        for (const auto& batch_size : Split(args["batch_size"])) {
+          cfg.batch_size = std::stoi(batch_size);
+          Run(cfg, models.at(model));
+        }
+      }
+    }
+  }
+  MXNotifyShutdown();
+  return 0;
+}
@@ -109,32 +109,25 @@ int main(int argc, char const *argv[]) {
 
 
   auto *exec = lenet.SimpleBind(Context::gpu(), args_map);
-  auto arg_names = lenet.ListArguments();
+  auto exec_args = exec->arg_dict();
+
+  // load the batches into the inputs of the executor while it runs
+  PrefetchIter train_prefetch(&train_iter, exec_args["data"], exec_args["data_label"]);
+  Trainer trainer(lenet, exec, {"data", "data_label"}, opt);
 
   for (int iter = 0; iter < max_epoch; ++iter) {
     LG << "Epoch: " << iter;
-    train_iter.Reset();
-    while (train_iter.Next()) {
-      auto data_batch = train_iter.GetDataBatch();
-      args_map["data"] = data_batch.data.Copy(Context::gpu());
-      args_map["data_label"] = data_batch.label.Copy(Context::gpu());
-      NDArray::WaitAll();
-      exec->Forward(true);
-      exec->Backward();
-      // Update parameters
-      for (size_t i = 0; i < arg_names.size(); ++i) {
-        if (arg_names[i] == "data" || arg_names[i] == "data_label") continue;
-        opt->Update(i, exec->arg_arrays[i], exec->grad_arrays[i]);
-      }
+    train_prefetch.Reset();
+    while (train_prefetch.Next()) {
+      trainer.Step();
     }
 
     Accuracy acu;
     val_iter.Reset();
     while (val_iter.Next()) {
       auto data_batch = val_iter.GetDataBatch();
-      args_map["data"] = data_batch.data.Copy(Context::gpu());
-      args_map["data_label"] = data_batch.label.Copy(Context::gpu());
-      NDArray::WaitAll();
+      data_batch.data.CopyTo(&exec_args["data"]);
+      data_batch.label.CopyTo(&exec_args["data_label"]);
       exec->Forward(false);
       NDArray::WaitAll();
       acu.Update(data_batch.label, exec->outputs[0]);
@@ -38,5 +38,7 @@
 #include "mxnet-cpp/io.hpp"
 #include "mxnet-cpp/metric.h"
 #include "mxnet-cpp/initializer.h"
+#include "mxnet-cpp/trainer.h"
+#include "mxnet-cpp/predictor.h"
 
 #endif  // MXNET_CPP_MXNETCPP_H_
@@ -28,8 +28,11 @@
 
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <utility>
 #include "mxnet-cpp/base.h"
 #include "mxnet-cpp/symbol.h"
 
@@ -43,6 +46,7 @@ class Optimizer;
 */
 class Executor {
   friend class Monitor;
+  friend class BucketingExecutor;
  public:
   Executor(const Symbol &symbol, Context context,
            const std::vector<NDArray> &arg_arrays,
@@ -99,7 +103,9 @@ class Executor {
   /*!
   * \brief destructor, free the handle
   */
-  ~Executor() { MXExecutorFree(handle_); }
+  ~Executor() {
+    if (owns_handle_) MXExecutorFree(handle_);
+  }
   std::vector<NDArray> arg_arrays;
   std::vector<NDArray> grad_arrays;
   std::vector<NDArray> aux_arrays;
@@ -120,8 +126,16 @@ class Executor {
  private:
   Executor(const Executor &e);
   Executor &operator=(const Executor &e);
+  /*!
+  * \brief wraps the executor of a bucket, owned by its BucketingExecutor
+  */
+  Executor(const ExecutorHandle &h, const Symbol &symbol,
+           const std::vector<NDArray> &arg_arrays,
+           const std::vector<NDArray> &grad_arrays,
+           const std::vector<NDArray> &aux_arrays);
   ExecutorHandle handle_;
   Symbol symbol_;
+  bool owns_handle_ = true;
   std::map<std::string, NDArray> GetDict(const std::vector<std::string> &names,
                                          const std::vector<NDArray> &arrays) {
     std::map<std::string, NDArray> ret;
@@ -139,6 +153,107 @@ class Executor {
     return ret;
   }
 };
+
+/*!
+* \brief Executors of the buckets of a model, such as the sequence lengths of
+*  a recurrent network. The executor of the default bucket, which should take
+*  the largest inputs, is bound with the given arrays; the executor of another
+*  bucket is bound on its first use, reads and writes the same parameters,
+*  gradients and auxiliary states, views the data arrays of the default bucket
+*  and shares its memory. The executors must not run at the same time.
+*/
+class BucketingExecutor {
+ public:
+  BucketingExecutor(int default_bucket_key, const Symbol &symbol,
+                    Context context,
+                    const std::vector<NDArray> &arg_arrays,
+                    const std::vector<NDArray> &grad_arrays,
+                    const std::vector<OpReqType> &grad_reqs,
+                    const std::vector<NDArray> &aux_arrays,
+                    const std::map<std::string, Context> &group_to_ctx =
+                        std::map<std::string, Context>());
+  /*!
+  * \brief get the executor of a bucket, binding it the first time; thread safe
+  * \param bucket_key the key of the bucket
+  * \param data_shapes the shapes of the arguments that change with the bucket,
+  *  such as the data and the label, only used the first time
+  * \param symbol the symbol of the bucket, nullptr for the one of the default
+  *  bucket, only used the first time
+  * \return the executor, owned by this
+  */
+  Executor *GetExecutor(int bucket_key,
+                        const std::map<std::string, std::vector<mx_uint> > &data_shapes =
+                            std::map<std::string, std::vector<mx_uint> >(),
+                        const Symbol *symbol = nullptr);
+  /*!
+  * \brief destructor, free the executors
+  */
+  ~BucketingExecutor() {
+    execs_.clear();
+    MXBucketingExecutorFree(handle_);
+  }
+
+ private:
+  BucketingExecutor(const BucketingExecutor &e);
+  BucketingExecutor &operator=(const BucketingExecutor &e);
+  BucketingExecutorHandle handle_;
+  Symbol symbol_;
+  std::mutex mutex_;
+  std::map<int, std::unique_ptr<Executor> > execs_;
+};
+/*!
+* \brief one executor of a symbol per context, each taking a slice of the
+*  batch along the first axis, for data parallel training
+*/
+class ExecutorGroup {
+ public:
+  /*!
+  * \brief bind the executors
+  * \param symbol the symbol, whose outputs should be losses
+  * \param contexts the devices
+  * \param data_shapes the shapes of the whole batch of the arguments that are
+  *  split over the devices, such as the data and the label; the other
+  *  arguments are the parameters
+  */
+  ExecutorGroup(const Symbol &symbol, const std::vector<Context> &contexts,
+                const std::vector<std::pair<std::string, Shape> > &data_shapes);
+  /*!
+  * \brief copy parameters or auxiliary states to all the devices
+  */
+  void SetParams(const std::map<std::string, NDArray> &params);
+  /*!
+  * \brief copy the slices of a batch to the devices and run the forward pass
+  * \param data the batch of each argument of data_shapes, in the same order
+  */
+  void Forward(const std::vector<NDArray> &data, bool is_train);
+  /*!
+  * \brief run the backward pass on all the devices
+  */
+  void Backward() { CHECK_EQ(MXExecutorGroupBackward(handle_), 0); }
+  /*!
+  * \brief initialize the parameters in the KVStore with the ones of the first
+  *  device and pull them to all the devices
+  */
+  void InitKVStore();
+  /*!
+  * \brief push the gradients to the KVStore, whose optimizer is set with
+  *  KVStore::SetOptimizer, and pull the updated parameters
+  */
+  void Update();
+  /*!
+  * \return the outputs of all the devices, the ones of the first device first
+  */
+  std::vector<NDArray> GetOutputs();
+  /*!
+  * \brief destructor, free the executors
+  */
+  ~ExecutorGroup() { MXExecutorGroupFree(handle_); }
+
+ private:
+  ExecutorGroup(const ExecutorGroup &e);
+  ExecutorGroup &operator=(const ExecutorGroup &e);
+  ExecutorGroupHandle handle_;
+};
 }  // namespace cpp
 }  // namespace mxnet
 #endif  // MXNET_CPP_EXECUTOR_H_
@@ -31,6 +31,7 @@
 #include <string>
 #include "mxnet-cpp/executor.h"
 #include "mxnet-cpp/optimizer.h"
+#include "mxnet-cpp/kvstore.h"
 
 namespace mxnet {
 namespace cpp {
@@ -91,12 +92,174 @@ inline Executor::Executor(const Symbol &symbol, Context context,
   }
 }
 
+inline Executor::Executor(const ExecutorHandle &h, const Symbol &symbol,
+                          const std::vector<NDArray> &arg_arrays,
+                          const std::vector<NDArray> &grad_arrays,
+                          const std::vector<NDArray> &aux_arrays)
+    : handle_(h), symbol_(symbol), owns_handle_(false) {
+  this->arg_arrays = arg_arrays;
+  this->grad_arrays = grad_arrays;
+  this->aux_arrays = aux_arrays;
+
+  mx_uint out_size;
+  NDArrayHandle *out_array;
+  CHECK_EQ(MXExecutorOutputs(handle_, &out_size, &out_array), 0);
+  for (mx_uint i = 0; i < out_size; ++i) {
+    outputs.push_back(NDArray(out_array[i]));
+  }
+}
+
 inline std::string Executor::DebugStr() {
   const char *output;
   MXExecutorPrint(handle_, &output);
   return std::string(output);
 }
 
+inline BucketingExecutor::BucketingExecutor(
+    int default_bucket_key, const Symbol &symbol, Context context,
+    const std::vector<NDArray> &arg_arrays,
+    const std::vector<NDArray> &grad_arrays,
+    const std::vector<OpReqType> &grad_reqs,
+    const std::vector<NDArray> &aux_arrays,
+    const std::map<std::string, Context> &group_to_ctx)
+    : symbol_(symbol) {
+  std::vector<NDArrayHandle> arg_handles;
+  std::vector<NDArrayHandle> grad_handles;
+  std::vector<NDArrayHandle> aux_handles;
+
+  for (const auto &array : arg_arrays) {
+    arg_handles.push_back(array.GetHandle());
+  }
+  for (const auto &array : grad_arrays) {
+    grad_handles.push_back(array.GetHandle());
+  }
+  for (const auto &array : aux_arrays) {
+    aux_handles.push_back(array.GetHandle());
+  }
+
+  std::vector<mx_uint> grad_reqs_uint;
+  for (auto s : grad_reqs) grad_reqs_uint.push_back(s);
+
+  std::vector<const char *> map_keys;
+  std::vector<int> dev_types, dev_ids;
+  for (const auto &s : group_to_ctx) {
+    map_keys.push_back(s.first.c_str());
+    dev_types.push_back(s.second.GetDeviceType());
+    dev_ids.push_back(s.second.GetDeviceId());
+  }
+
+  CHECK_EQ(MXBucketingExecutorCreate(default_bucket_key, symbol.GetHandle(),
+                                     context.GetDeviceType(), context.GetDeviceId(),
+                                     group_to_ctx.size(), map_keys.data(),
+                                     dev_types.data(), dev_ids.data(),
+                                     arg_handles.size(), arg_handles.data(),
+                                     grad_handles.data(), grad_reqs_uint.data(),
+                                     aux_handles.size(), aux_handles.data(),
+                                     &handle_),
+           0);
+}
+
+inline Executor *BucketingExecutor::GetExecutor(
+    int bucket_key, const std::map<std::string, std::vector<mx_uint> > &data_shapes,
+    const Symbol *symbol) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = execs_.find(bucket_key);
+  if (it != execs_.end()) return it->second.get();
+
+  std::vector<const char *> data_names;
+  std::vector<mx_uint> shape_indptr{0};
+  std::vector<mx_uint> shape_data;
+  for (const auto &s : data_shapes) {
+    data_names.push_back(s.first.c_str());
+    shape_data.insert(shape_data.end(), s.second.begin(), s.second.end());
+    shape_indptr.push_back(shape_data.size());
+  }
+  mx_uint num_args, num_aux;
+  NDArrayHandle *arg_handles, *grad_handles, *aux_handles;
+  ExecutorHandle exec_handle;
+  CHECK_EQ(MXBucketingExecutorGet(handle_, bucket_key,
+                                  symbol == nullptr ? nullptr : symbol->GetHandle(),
+                                  data_names.size(), data_names.data(),
+                                  shape_indptr.data(), shape_data.data(),
+                                  &num_args, &arg_handles, &grad_handles,
+                                  &num_aux, &aux_handles, &exec_handle),
+           0);
+  std::vector<NDArray> arg_arrays, grad_arrays, aux_arrays;
+  for (mx_uint i = 0; i < num_args; ++i) {
+    arg_arrays.push_back(NDArray(arg_handles[i]));
+    grad_arrays.push_back(grad_handles[i] == nullptr ? NDArray() : NDArray(grad_handles[i]));
+  }
+  for (mx_uint i = 0; i < num_aux; ++i) {
+    aux_arrays.push_back(NDArray(aux_handles[i]));
+  }
+  Executor *exec = new Executor(exec_handle, symbol == nullptr ? symbol_ : *symbol,
+                                arg_arrays, grad_arrays, aux_arrays);
+  execs_[bucket_key].reset(exec);
+  return exec;
+}
+
+inline ExecutorGroup::ExecutorGroup(
+    const Symbol &symbol, const std::vector<Context> &contexts,
+    const std::vector<std::pair<std::string, Shape> > &data_shapes) {
+  std::vector<int> dev_types, dev_ids;
+  for (const auto &ctx : contexts) {
+    dev_types.push_back(ctx.GetDeviceType());
+    dev_ids.push_back(ctx.GetDeviceId());
+  }
+  std::vector<const char *> data_names;
+  std::vector<mx_uint> shape_indptr{0};
+  std::vector<mx_uint> shape_data;
+  for (const auto &s : data_shapes) {
+    data_names.push_back(s.first.c_str());
+    shape_data.insert(shape_data.end(), s.second.data(), s.second.data() + s.second.ndim());
+    shape_indptr.push_back(shape_data.size());
+  }
+  CHECK_EQ(MXExecutorGroupCreate(symbol.GetHandle(), contexts.size(),
+                                 dev_types.data(), dev_ids.data(),
+                                 data_names.size(), data_names.data(),
+                                 shape_indptr.data(), shape_data.data(), &handle_),
+           0);
+}
+
+inline void ExecutorGroup::SetParams(const std::map<std::string, NDArray> &params) {
+  std::vector<const char *> names;
+  std::vector<NDArrayHandle> arrays;
+  for (const auto &p : params) {
+    names.push_back(p.first.c_str());
+    arrays.push_back(p.second.GetHandle());
+  }
+  CHECK_EQ(MXExecutorGroupSetParams(handle_, names.size(), names.data(), arrays.data()), 0);
+}
+
+inline void ExecutorGroup::Forward(const std::vector<NDArray> &data, bool is_train) {
+  std::vector<NDArrayHandle> handles;
+  for (const auto &d : data) {
+    handles.push_back(d.GetHandle());
+  }
+  CHECK_EQ(MXExecutorGroupForward(handle_, handles.size(), handles.data(),
+                                  is_train ? 1 : 0),
+           0);
+}
+
+inline void ExecutorGroup::InitKVStore() {
+  CHECK_EQ(MXExecutorGroupInitKVStore(handle_, KVStore::get_handle()), 0);
+}
+
+inline void ExecutorGroup::Update() {
+  CHECK_EQ(MXExecutorGroupUpdate(handle_, KVStore::get_handle()), 0);
+}
+
+inline std::vector<NDArray> ExecutorGroup::GetOutputs() {
+  mx_uint out_size;
+  NDArrayHandle *out_array;
+  CHECK_EQ(MXExecutorGroupGetOutputs(handle_, &out_size, &out_array), 0);
+  std::vector<NDArray> outputs;
+  for (mx_uint i = 0; i < out_size; ++i) {
+    outputs.push_back(NDArray(out_array[i]));
+  }
+  return outputs;
+}
+
 }  // namespace cpp
 }  // namespace mxnet
 
@@ -25,8 +25,11 @@
 #ifndef MXNET_CPP_IO_H_
 #define MXNET_CPP_IO_H_
 
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <sstream>
 #include "mxnet-cpp/base.h"
@@ -139,6 +142,57 @@ class MXDataIter : public DataIter {
   std::shared_ptr<MXDataIterBlob> blob_ptr_;
   static MXDataIterMap*& mxdataiter_map();
 };
+
+/*!
+* \brief Loads the batches of a DataIter on a thread ahead of their use, into
+* two buffers on the device of the given arrays, and copies each batch into the
+* arrays on Next(). The arrays are the inputs of an executor: the copies are
+* ordered by the engine after the operations still reading them, so a training
+* loop does not need to wait for the previous batch, e.g. with NDArray::WaitAll.
+*/
+class PrefetchIter : public DataIter {
+ public:
+  /*!
+  * \brief start loading the batches of iter
+  * \param iter the iterator to load, used by the thread until destruction
+  * \param data the array receiving the data of each batch
+  * \param label the array receiving the label of each batch
+  */
+  PrefetchIter(DataIter *iter, NDArray data, NDArray label);
+  ~PrefetchIter() { Stop(); }
+  void BeforeFirst();
+  bool Next();
+  NDArray GetData() { return data_; }
+  NDArray GetLabel() { return label_; }
+  int GetPadNum() { return pad_num_; }
+  std::vector<int> GetIndex() { return index_; }
+
+ private:
+  PrefetchIter(const PrefetchIter &);
+  PrefetchIter &operator=(const PrefetchIter &);
+  /*! \brief a loaded batch */
+  struct Slot {
+    NDArray data, label;
+    int pad_num;
+    std::vector<int> index;
+  };
+  void Start();
+  void Stop();
+  /*! \brief the loading thread */
+  void Run();
+  DataIter *iter_;
+  NDArray data_, label_;
+  int pad_num_ = 0;
+  std::vector<int> index_;
+  Slot slots_[2];
+  /*! \brief the next slot given by Next, and the number of loaded slots */
+  int head_ = 0, num_ready_ = 0;
+  /*! \brief whether the iterator is at its end, and whether the thread should stop */
+  bool end_ = false, stop_ = false;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+};
 }  // namespace cpp
 }  // namespace mxnet
 
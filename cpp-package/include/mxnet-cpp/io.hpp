@@ -101,6 +101,89 @@ inline MXDataIter MXDataIter::CreateDataIter() {
 
 // MXDataIter MNIst
 
+inline PrefetchIter::PrefetchIter(DataIter *iter, NDArray data, NDArray label)
+    : iter_(iter), data_(data), label_(label) {
+  for (auto &slot : slots_) {
+    slot.data = NDArray(data.GetShape(), data.GetContext(), false);
+    slot.label = NDArray(label.GetShape(), label.GetContext(), false);
+  }
+  Start();
+}
+
+inline void PrefetchIter::BeforeFirst() {
+  Stop();
+  iter_->BeforeFirst();
+  Start();
+}
+
+inline bool PrefetchIter::Next() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return num_ready_ > 0 || end_; });
+  if (num_ready_ == 0) return false;
+  Slot &slot = slots_[head_];
+  // the thread writes the slot again after these copies, in the order of the engine
+  slot.data.CopyTo(&data_);
+  slot.label.CopyTo(&label_);
+  pad_num_ = slot.pad_num;
+  index_ = slot.index;
+  head_ = 1 - head_;
+  --num_ready_;
+  lock.unlock();
+  cv_.notify_all();
+  return true;
+}
+
+inline void PrefetchIter::Start() {
+  head_ = 0;
+  num_ready_ = 0;
+  end_ = false;
+  stop_ = false;
+  thread_ = std::thread(&PrefetchIter::Run, this);
+}
+
+inline void PrefetchIter::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) thread_.join();
+}
+
+inline void PrefetchIter::Run() {
+  for (int k = 0; ; k = 1 - k) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stop_ || num_ready_ < 2; });
+      if (stop_) return;
+    }
+    bool more = iter_->Next();
+    if (more) {
+      Slot &slot = slots_[k];
+      NDArray data = iter_->GetData(), label = iter_->GetLabel();
+      CHECK(data.GetShape() == slot.data.GetShape())
+          << "the batches should have the shape of the data array";
+      data.CopyTo(&slot.data);
+      label.CopyTo(&slot.label);
+      slot.pad_num = iter_->GetPadNum();
+      slot.index = iter_->GetIndex();
+      // the next batch of iter may reuse the arrays of this one
+      slot.data.WaitToRead();
+      slot.label.WaitToRead();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (more) {
+        ++num_ready_;
+      } else {
+        end_ = true;
+      }
+    }
+    cv_.notify_all();
+    if (!more) return;
+  }
+}
+
 }  // namespace cpp
 }  // namespace mxnet
 
@@ -34,6 +34,7 @@ namespace mxnet {
 namespace cpp {
 
 class KVStore {
+  friend class ExecutorGroup;
  public:
   static void SetType(const std::string& type);
   static void RunServer();
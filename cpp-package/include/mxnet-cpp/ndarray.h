@@ -40,7 +40,8 @@ namespace cpp {
 enum DeviceType {
   kCPU = 1,
   kGPU = 2,
-  kCPUPinned = 3
+  kCPUPinned = 3,
+  kCPUShared = 5
 };
 
 /*!
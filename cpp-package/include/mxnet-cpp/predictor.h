@@ -0,0 +1,171 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+* \file predictor.h
+* \brief a predictor running the inference of a network from many threads
+*/
+
+#ifndef MXNET_CPP_PREDICTOR_H_
+#define MXNET_CPP_PREDICTOR_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mxnet-cpp/executor.h"
+#include "mxnet-cpp/ndarray.h"
+#include "mxnet-cpp/symbol.h"
+
+namespace mxnet {
+namespace cpp {
+
+/*!
+* \brief Runs the inference of a network from several threads. The executors of
+* the predictor are bound to the same parameter arrays, so that the weights are
+* held once whatever the number of executors, and each of them has its own
+* inputs, outputs and internal memory. A thread checks an executor out of a lock
+* free pool, runs it and checks it back in; the executors checked out by
+* different threads run concurrently in the engine.
+*/
+class Predictor {
+ public:
+  /*!
+  * \brief create the executors of the inference of net
+  * \param net the symbol of the network
+  * \param params the arguments and the auxiliary states which are not inputs,
+  *  by name, copied once to ctx when they are on another device
+  * \param input_shapes the shapes of the inputs, e.g. the data, by name
+  * \param ctx the device of the executors
+  * \param num_executors the number of executors, i.e. of concurrent predictions
+  */
+  Predictor(const Symbol &net, const std::map<std::string, NDArray> &params,
+            const std::map<std::string, std::vector<mx_uint> > &input_shapes,
+            const Context &ctx, int num_executors)
+      : num_slots_(num_executors),
+        slots_(new std::atomic<Executor *>[num_executors]) {
+    CHECK_GT(num_executors, 0);
+    std::vector<std::vector<mx_uint> > arg_shapes, aux_shapes, out_shapes;
+    net.InferShape(input_shapes, &arg_shapes, &aux_shapes, &out_shapes);
+    std::vector<std::string> arg_names = net.ListArguments();
+    std::vector<std::string> aux_names = net.ListAuxiliaryStates();
+    std::vector<NDArray> shared_args(arg_names.size()), shared_aux;
+    for (size_t i = 0; i < arg_names.size(); ++i) {
+      if (input_shapes.count(arg_names[i]) != 0) {
+        inputs_[arg_names[i]] = i;
+      } else {
+        shared_args[i] = Param(params, arg_names[i], ctx);
+      }
+    }
+    for (const auto &name : aux_names) {
+      shared_aux.push_back(Param(params, name, ctx));
+    }
+    std::vector<NDArray> grad_arrays(arg_names.size());
+    std::vector<OpReqType> grad_reqs(arg_names.size(), kNullOp);
+    for (int k = 0; k < num_executors; ++k) {
+      std::vector<NDArray> arg_arrays = shared_args;
+      for (const auto &input : inputs_) {
+        arg_arrays[input.second] = NDArray(arg_shapes[input.second], ctx, false);
+      }
+      // no shared_exec: executors sharing their memory could not run together
+      executors_.emplace_back(new Executor(net, ctx, arg_arrays, grad_arrays,
+                                           grad_reqs, shared_aux));
+      slots_[k].store(executors_.back().get(), std::memory_order_relaxed);
+    }
+  }
+  /*!
+  * \brief check an executor out of the pool, waiting for one when all of them
+  *  are checked out
+  * \return the executor, to check in with Release
+  */
+  Executor *Acquire() {
+    while (true) {
+      for (int i = 0; i < num_slots_; ++i) {
+        Executor *exec = slots_[i].exchange(nullptr, std::memory_order_acquire);
+        if (exec != nullptr) return exec;
+      }
+      std::this_thread::yield();
+    }
+  }
+  /*! \brief check in an executor checked out by Acquire */
+  void Release(Executor *exec) {
+    // there are as many slots as executors, there is a free one
+    for (int i = 0; ; i = (i + 1) % num_slots_) {
+      Executor *expected = nullptr;
+      if (slots_[i].compare_exchange_weak(expected, exec, std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+  /*!
+  * \brief run the inference of a batch, can be called from any thread
+  * \param inputs the data of the inputs, by name, of the sizes of their shapes
+  * \param outputs used to store the data of the outputs
+  */
+  void Predict(const std::map<std::string, std::vector<mx_float> > &inputs,
+               std::vector<std::vector<mx_float> > *outputs) {
+    Executor *exec = Acquire();
+    for (const auto &input : inputs_) {
+      auto it = inputs.find(input.first);
+      CHECK(it != inputs.end()) << "missing input " << input.first;
+      NDArray &array = exec->arg_arrays[input.second];
+      CHECK_EQ(it->second.size(), array.Size()) << "wrong size of input " << input.first;
+      array.SyncCopyFromCPU(it->second);
+    }
+    exec->Forward(false);
+    outputs->resize(exec->outputs.size());
+    for (size_t i = 0; i < exec->outputs.size(); ++i) {
+      exec->outputs[i].SyncCopyToCPU(&(*outputs)[i]);
+    }
+    Release(exec);
+  }
+  /*! \return the number of executors */
+  int num_executors() const { return num_slots_; }
+
+ private:
+  /*! \brief the shared array of a parameter, on ctx */
+  static NDArray Param(const std::map<std::string, NDArray> &params,
+                       const std::string &name, const Context &ctx) {
+    auto it = params.find(name);
+    CHECK(it != params.end()) << "missing parameter " << name;
+    Context from = it->second.GetContext();
+    if (from.GetDeviceType() == ctx.GetDeviceType() &&
+        from.GetDeviceId() == ctx.GetDeviceId()) {
+      return it->second;
+    }
+    NDArray ret = it->second.Copy(ctx);
+    ret.WaitToRead();
+    return ret;
+  }
+
+  int num_slots_;
+  /*! \brief the pool, an executor or nullptr when it is checked out */
+  std::unique_ptr<std::atomic<Executor *>[]> slots_;
+  std::vector<std::unique_ptr<Executor> > executors_;
+  /*! \brief the indices of the inputs in the arguments */
+  std::map<std::string, size_t> inputs_;
+};
+
+}  // namespace cpp
+}  // namespace mxnet
+
+#endif  // MXNET_CPP_PREDICTOR_H_
@@ -0,0 +1,114 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+* \file trainer.h
+* \brief a training loop overlapping the steps of an executor
+*/
+
+#ifndef MXNET_CPP_TRAINER_H_
+#define MXNET_CPP_TRAINER_H_
+
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+#include "mxnet-cpp/executor.h"
+#include "mxnet-cpp/io.h"
+#include "mxnet-cpp/kvstore.h"
+#include "mxnet-cpp/optimizer.h"
+#include "mxnet-cpp/symbol.h"
+
+namespace mxnet {
+namespace cpp {
+
+/*!
+* \brief Runs the training steps of an executor without waiting for each of
+* them. The weights are updated as the backward produces their gradients, the
+* last layers first, by the optimizer or through the kvstore, and a step is
+* pushed when the forward of the previous one is done, so that the backward and
+* the updates of a step overlap the forward of the next one, while a
+* PrefetchIter loads the next batch.
+*/
+class Trainer {
+ public:
+  /*!
+  * \brief create a trainer of the arguments of net bound in exec
+  * \param net the symbol of exec
+  * \param exec the executor, bound with the gradients of the weights
+  * \param input_names the arguments not updated, e.g. the data and the label
+  * \param opt the optimizer of the weights, nullptr to push the gradients to
+  *  the kvstore and pull the weights, its optimizer set with KVStore::SetOptimizer
+  */
+  Trainer(const Symbol &net, Executor *exec, const std::set<std::string> &input_names,
+          Optimizer *opt = nullptr)
+      : exec_(exec), opt_(opt) {
+    std::vector<std::string> arg_names = net.ListArguments();
+    for (size_t i = 0; i < arg_names.size(); ++i) {
+      if (input_names.count(arg_names[i]) == 0) weights_.push_back(i);
+    }
+    if (opt_ == nullptr) {
+      std::vector<NDArray> vals;
+      for (int i : weights_) vals.push_back(exec_->arg_arrays[i]);
+      KVStore::Init(weights_, vals);
+    }
+  }
+  /*! \brief push the forward, the backward and the updates of the bound batch */
+  void Step() {
+    // at most the backward and the updates of one step are queued ahead
+    if (!exec_->outputs.empty()) exec_->outputs[0].WaitToRead();
+    exec_->Forward(true);
+    exec_->Backward();
+    for (auto it = weights_.rbegin(); it != weights_.rend(); ++it) {
+      int i = *it;
+      if (opt_ != nullptr) {
+        opt_->Update(i, exec_->arg_arrays[i], exec_->grad_arrays[i]);
+      } else {
+        KVStore::Push(i, exec_->grad_arrays[i], -i);
+        KVStore::Pull(i, &exec_->arg_arrays[i], -i);
+      }
+    }
+  }
+  /*!
+  * \brief train over the epochs of iter, which copies its batches into exec
+  * \param batch_end called after the step of each batch with the epoch and the batch
+  */
+  void Fit(PrefetchIter *iter, int num_epoch,
+           std::function<void(int, int)> batch_end = nullptr) {
+    for (int epoch = 0; epoch < num_epoch; ++epoch) {
+      iter->Reset();
+      for (int nbatch = 0; iter->Next(); ++nbatch) {
+        Step();
+        if (batch_end) batch_end(epoch, nbatch);
+      }
+    }
+    NDArray::WaitAll();
+  }
+
+ private:
+  Executor *exec_;
+  Optimizer *opt_;
+  /*! \brief the indices of the updated arguments */
+  std::vector<int> weights_;
+};
+
+}  // namespace cpp
+}  // namespace mxnet
+
+#endif  // MXNET_CPP_TRAINER_H_
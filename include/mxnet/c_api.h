@@ -68,12 +68,20 @@ typedef const void *FunctionHandle;
 typedef void *AtomicSymbolCreator;
 /*! \brief handle to cached operator */
 typedef void *CachedOpHandle;
+/*! \brief handle to an operator with parsed parameters, for repeated invokes */
+typedef void *ImperativeOpHandle;
 /*! \brief handle to a symbol that can be bind as operator */
 typedef void *SymbolHandle;
 /*! \brief handle to a AtomicSymbol */
 typedef void *AtomicSymbolHandle;
 /*! \brief handle to an Executor */
 typedef void *ExecutorHandle;
+/*! \brief handle to the executors of the buckets of a model */
+typedef void *BucketingExecutorHandle;
+/*! \brief handle to the executors of a symbol on several devices */
+typedef void *ExecutorGroupHandle;
+/*! \brief handle to the executors of the micro-batches of a model parallel symbol */
+typedef void *PipelineExecutorHandle;
 /*! \brief handle a dataiter creator */
 typedef void *DataIterCreator;
 /*! \brief handle to a DataIterator */
@@ -224,10 +232,88 @@ MXNET_DLL int MXSetProfilerState(int state);
 
 /*! \brief Save profile and stop profiler */
 MXNET_DLL int MXDumpProfile();
+/*!
+ * \brief Set whether the profiler only keeps the count, the total, the
+ *  minimum and the maximum time of the operations of each name and device,
+ *  instead of an event for every execution. MXDumpProfile then saves the
+ *  table of these statistics.
+ * \param aggregate aggregate the statistics when aggregate == 1
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXSetProfilerAggregate(int aggregate);
+/*!
+ * \brief Set whether the profiler records the allocations and releases of
+ *  memory, each attributed to the operator or the executor bind that caused
+ *  it. The trace file shows them with a counter of the bytes in use of
+ *  each device.
+ * \param memory record the memory events when memory == 1
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXSetProfilerMemory(int memory);
+/*!
+ * \brief Print the aggregate statistics of the profiler as a table
+ * \param out_str the table, valid until the next call of the thread
+ * \param reset clear the statistics after printing them when reset == 1
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXAggregateProfileStatsPrint(const char **out_str, int reset);
+/*!
+ * \brief Set the profiler to keep only the last events finished by each
+ *  thread, in preallocated rings, so that it can stay on. The rings that
+ *  exist keep their size.
+ * \param capacity the number of events per thread, 0 to keep all events
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXSetProfilerRingBuffer(int capacity);
+/*!
+ * \brief Save the events of the profiler rings as a trace file, without
+ *  stopping the profiler
+ * \param filename where to save trace file
+ * \param seconds only save the events that ended in the last seconds, all of
+ *  them when seconds <= 0
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXDumpProfileRing(const char* filename, float seconds);
 
 /*! \brief Set the number of OMP threads to use */
 MXNET_DLL int MXSetNumOMPThreads(int thread_num);
 
+/*!
+ * \brief Set the number of the imperative operations that the calling thread
+ *  collects into one engine operation.
+ * \param bulk_size the number of operations, 0 to push them one by one
+ * \param prev_bulk_size the previous number of operations
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXEngineSetBulkSize(int bulk_size, int* prev_bulk_size);
+
+/*!
+ * \brief Set whether the calling thread runs the CPU operations it pushes
+ *  inline, without dependency tracking nor thread hand-off.
+ * \param enable 1 to run the operations inline, 0 to push them to the engine
+ * \param prev_enable the previous setting
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXEngineSetInline(int enable, int* prev_enable);
+
+/*!
+ * \brief Get the memory allocation statistics of a context.
+ *  The names are bytes_in_use, peak_bytes_in_use, bytes_reserved,
+ *  peak_bytes_reserved, bytes_pooled, largest_pooled_block, num_allocs
+ *  and num_pool_hits.
+ * \param dev_type device type of the context
+ * \param dev_id device id of the context
+ * \param out_size number of returned statistics
+ * \param out_keys the names of the statistics
+ * \param out_vals the values of the statistics
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXStorageGetStats(int dev_type,
+                                int dev_id,
+                                mx_uint *out_size,
+                                const char ***out_keys,
+                                const uint64_t **out_vals);
+
 //-------------------------------------
 // Part 1: NDArray creation and deletion
 //-------------------------------------
@@ -276,6 +362,61 @@ MXNET_DLL int MXNDArrayCreateEx(const mx_uint *shape,
                               int delay_alloc,
                               int dtype,
                               NDArrayHandle *out);
+/*!
+ * \brief create a sparse NDArray, whose values and aux arrays are allocated
+ *  when it is first written
+ * \param storage_type the storage type, 1 for row_sparse and 2 for csr
+ * \param shape the pointer to the dense shape
+ * \param ndim the dimension of the shape
+ * \param dev_type device type, specify device we want to take
+ * \param dev_id the device id of the specific device
+ * \param delay_alloc whether to delay allocation until
+ *    the narray is first mutated
+ * \param dtype data type of the values
+ * \param num_aux the number of aux arrays
+ * \param aux_type data types of the aux arrays
+ * \param out the returning handle
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayCreateSparseEx(int storage_type,
+                                      const mx_uint *shape,
+                                      mx_uint ndim,
+                                      int dev_type,
+                                      int dev_id,
+                                      int delay_alloc,
+                                      int dtype,
+                                      mx_uint num_aux,
+                                      int *aux_type,
+                                      NDArrayHandle *out);
+/*!
+ * \brief get the ids of the shared memory of a dense NDArray on cpu_shared,
+ *  waiting for its pending writes. Every call adds a reference to the
+ *  memory, which MXNDArrayCreateFromSharedMem takes over in any process.
+ * \param handle the handle to the NDArray
+ * \param shared_pid the id of the process which allocated the memory
+ * \param shared_id the id of the memory in that process
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayGetSharedMemHandle(NDArrayHandle handle,
+                                          int *shared_pid,
+                                          int *shared_id);
+/*!
+ * \brief create a NDArray on the shared memory of MXNDArrayGetSharedMemHandle,
+ *  without a copy
+ * \param shared_pid the id of the process which allocated the memory
+ * \param shared_id the id of the memory in that process
+ * \param shape the pointer to the shape
+ * \param ndim the dimension of the shape
+ * \param dtype data type of the array
+ * \param out the returning handle
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayCreateFromSharedMem(int shared_pid,
+                                           int shared_id,
+                                           const mx_uint *shape,
+                                           mx_uint ndim,
+                                           int dtype,
+                                           NDArrayHandle *out);
 /*!
  * \brief create a NDArray handle that is loaded from raw bytes.
  * \param buf the head of the raw bytes
@@ -308,6 +449,44 @@ MXNET_DLL int MXNDArraySave(const char* fname,
                             mx_uint num_args,
                             NDArrayHandle* args,
                             const char** keys);
+/*!
+ * \brief Save list of narray into the file without waiting for them.
+ *  The arrays may be written right after the call, they are copied to the
+ *  cpu in order with their other operations and written by a background
+ *  thread. MXNDArrayWaitSaves and MXNDArrayWaitAll wait for the saves.
+ * \param fname name of the file.
+ * \param num_args number of arguments to save.
+ * \param args the array of NDArrayHandles to be saved.
+ * \param keys the name of the NDArray, optional, can be NULL
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArraySaveAsync(const char* fname,
+                                 mx_uint num_args,
+                                 NDArrayHandle* args,
+                                 const char** keys);
+/*!
+ * \brief Wait for the saves of MXNDArraySaveAsync.
+ * \return 0 when success, -1 when one of the saves failed
+ */
+MXNET_DLL int MXNDArrayWaitSaves();
+/*!
+ * \brief Save list of narray into the file, with the float32 dense arrays
+ *  in a reduced precision that loading decodes.
+ * \param fname name of the file.
+ * \param num_args number of arguments to save.
+ * \param args the array of NDArrayHandles to be saved.
+ * \param keys the name of the NDArray, optional, can be NULL
+ * \param encoding "raw", "float16", or "int8" with a scale per array for
+ *  the arrays of 2 dimensions or more
+ * \param blocking whether to wait for the save, see MXNDArraySaveAsync
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArraySaveEx(const char* fname,
+                              mx_uint num_args,
+                              NDArrayHandle* args,
+                              const char** keys,
+                              const char* encoding,
+                              int blocking);
 /*!
  * \brief Load list of narray from the file.
  * \param fname name of the file.
@@ -350,6 +529,49 @@ MXNET_DLL int MXNDArraySyncCopyFromCPU(NDArrayHandle handle,
 MXNET_DLL int MXNDArraySyncCopyToCPU(NDArrayHandle handle,
                                      void *data,
                                      size_t size);
+/*!
+ * \brief the callback of MXNDArrayAsyncCopyFromCPU and MXNDArrayAsyncCopyToCPU,
+ *  called on an engine thread with the param of the copy once it is done
+ */
+typedef void (*MXNDArrayCopyCallback)(void* /*param*/);
+/*!
+ * \brief Start a copy from a continugous CPU memory region without waiting.
+ *
+ *  The copy runs after the pending operations of the NDArray. The memory
+ *  must stay valid and unchanged until it is done, that is until the
+ *  callback is called or MXNDArrayWaitToRead returns.
+ *
+ * \param handle the NDArray handle
+ * \param data the data source to copy from.
+ * \param size the memory size we want to copy from.
+ * \param callback called once the copy is done, may be NULL.
+ * \param callback_param the argument of the callback.
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayAsyncCopyFromCPU(NDArrayHandle handle,
+                                        const void *data,
+                                        size_t size,
+                                        MXNDArrayCopyCallback callback,
+                                        void *callback_param);
+/*!
+ * \brief Start a copy to a continugous CPU memory region without waiting.
+ *
+ *  The copy runs after the pending writes of the NDArray. The memory must
+ *  stay valid until it is done, that is until the callback is called or
+ *  MXNDArrayWaitToWrite returns.
+ *
+ * \param handle the NDArray handle
+ * \param data the data source to copy into.
+ * \param size the memory size we want to copy into.
+ * \param callback called once the copy is done, may be NULL.
+ * \param callback_param the argument of the callback.
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayAsyncCopyToCPU(NDArrayHandle handle,
+                                      void *data,
+                                      size_t size,
+                                      MXNDArrayCopyCallback callback,
+                                      void *callback_param);
 /*!
  * \brief Wait until all the pending writes with respect NDArray are finished.
  *  Always call this before read data out synchronizely.
@@ -436,6 +658,53 @@ MXNET_DLL int MXNDArrayGetData(NDArrayHandle handle,
  */
 MXNET_DLL int MXNDArrayGetDType(NDArrayHandle handle,
                                int *out_dtype);
+/*!
+ * \brief get the storage type of the NDArray
+ * \param handle the handle to the narray
+ * \param out_storage_type 0 for dense, 1 for row_sparse, 2 for csr, -1 if empty
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayGetStorageType(NDArrayHandle handle,
+                                      int *out_storage_type);
+/*!
+ * \brief get the type of the i-th aux array of a sparse NDArray
+ * \param handle the handle to the narray
+ * \param i the index of the aux array
+ * \param out_type pointer holder to get the type
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayGetAuxType(NDArrayHandle handle,
+                                  mx_uint i,
+                                  int *out_type);
+/*!
+ * \brief get a dense copy of the i-th aux array of a sparse NDArray
+ * \param handle the handle to the narray
+ * \param i the index of the aux array
+ * \param out the returning handle
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayGetAuxNDArray(NDArrayHandle handle,
+                                     mx_uint i,
+                                     NDArrayHandle *out);
+/*!
+ * \brief get a dense copy of the values of a sparse NDArray
+ * \param handle the handle to the narray
+ * \param out the returning handle
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArrayGetDataNDArray(NDArrayHandle handle,
+                                      NDArrayHandle *out);
+/*!
+ * \brief copy a dense NDArray into the values or an aux array of a sparse
+ *  NDArray on the same device
+ * \param handle_dst the sparse NDArray
+ * \param handle_src the dense NDArray
+ * \param i the index of the aux array, -1 for the values
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXNDArraySyncCopyFromNDArray(NDArrayHandle handle_dst,
+                                           const NDArrayHandle handle_src,
+                                           const int i);
 /*!
  * \brief get the context of the NDArray
  * \param handle the handle to the narray
@@ -674,6 +943,45 @@ MXNET_DLL int MXInvokeCachedOp(CachedOpHandle handle,
                                NDArrayHandle *inputs,
                                int *num_outputs,
                                NDArrayHandle **outputs);
+/*!
+ * \brief create an operator invocation with its parameters parsed once, for
+ *  the ops invoked many times with the same parameters. The shapes and types
+ *  of the outputs are inferred again only when those of the arrays change.
+ * \param creator the op
+ * \param num_inputs number of input NDArrays of the invocations
+ * \param num_params number of keyword parameters
+ * \param param_keys keys for keyword parameters
+ * \param param_vals values for keyword parameters
+ * \param out the created operator invocation
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXCreateImperativeOp(AtomicSymbolCreator creator,
+                                   int num_inputs,
+                                   int num_params,
+                                   const char **param_keys,
+                                   const char **param_vals,
+                                   ImperativeOpHandle *out);
+/*!
+ * \brief free an operator invocation
+ * \param handle the operator invocation
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXFreeImperativeOp(ImperativeOpHandle handle);
+/*!
+ * \brief invoke an operator invocation, as MXImperativeInvoke with the
+ *  parameters of its creation
+ * \param handle the operator invocation
+ * \param num_inputs number of input NDArrays
+ * \param inputs input NDArrays
+ * \param num_outputs number of output NDArrays
+ * \param outputs output NDArrays
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXInvokeImperativeOp(ImperativeOpHandle handle,
+                                   int num_inputs,
+                                   NDArrayHandle *inputs,
+                                   int *num_outputs,
+                                   NDArrayHandle **outputs);
 //--------------------------------------------
 // Part 3: symbolic configuration generation
 //--------------------------------------------
@@ -1253,11 +1561,269 @@ MXNET_DLL int MXExecutorSimpleBind(SymbolHandle symbol_handle,
                          ExecutorHandle shared_exec_handle,
                          ExecutorHandle* out);
 /*!
- * \brief set a call back to notify the completion of operation
+ * \brief set a call back to notify the completion of operation,
+ *  a NULL callback removes the installed one
  */
 MXNET_DLL int MXExecutorSetMonitorCallback(ExecutorHandle handle,
                                            ExecutorMonitorCallback callback,
                                            void* callback_handle);
+/*!
+ * \brief set a call back called during backward with the name of an argument
+ *  and a new handle of its gradient, as soon as the gradient is scheduled
+ */
+MXNET_DLL int MXExecutorSetGradientCallback(ExecutorHandle handle,
+                                            ExecutorMonitorCallback callback,
+                                            void* callback_handle);
+/*!
+ * \brief Create the executors of the buckets of a model, such as the sequence
+ *  lengths of a recurrent network, and bind the one of the default bucket,
+ *  which should take the largest inputs. See MXExecutorBindX for the arguments.
+ *  The executors of the other buckets are bound on their first use, share the
+ *  parameters, gradients, auxiliary states and memory of the default one, and
+ *  must not run at the same time.
+ * \param default_bucket_key the key of the default bucket
+ * \param out the created handle, freed with MXBucketingExecutorFree
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXBucketingExecutorCreate(int default_bucket_key,
+                                        SymbolHandle symbol_handle,
+                                        int dev_type,
+                                        int dev_id,
+                                        mx_uint num_map_keys,
+                                        const char** map_keys,
+                                        const int* map_dev_types,
+                                        const int* map_dev_ids,
+                                        mx_uint len,
+                                        NDArrayHandle *in_args,
+                                        NDArrayHandle *arg_grad_store,
+                                        mx_uint *grad_req_type,
+                                        mx_uint aux_states_len,
+                                        NDArrayHandle *aux_states,
+                                        BucketingExecutorHandle *out);
+/*!
+ * \brief Get the executor of a bucket, binding it the first time; thread safe.
+ * \param handle the bucketing executor
+ * \param bucket_key the key of the bucket
+ * \param symbol_handle the symbol of the bucket, NULL for the one of the
+ *  default bucket; only used the first time
+ * \param num_data the number of the arguments whose shapes change with the
+ *  bucket, such as the data and the label; only used the first time
+ * \param data_names the names of these arguments
+ * \param data_shape_indptr index pointer of the shapes, of length num_data + 1
+ * \param data_shape_data the flattened shapes
+ * \param num_in_args the number of the arguments of the executor
+ * \param in_args new handles to the arguments of the executor
+ * \param arg_grads new handles to their gradients, NULL for the ones without
+ * \param num_aux_states the number of the auxiliary states of the executor
+ * \param aux_states new handles to the auxiliary states
+ * \param out the executor, owned by handle and not to be freed
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXBucketingExecutorGet(BucketingExecutorHandle handle,
+                                     int bucket_key,
+                                     SymbolHandle symbol_handle,
+                                     mx_uint num_data,
+                                     const char** data_names,
+                                     const mx_uint* data_shape_indptr,
+                                     const mx_uint* data_shape_data,
+                                     mx_uint* num_in_args,
+                                     NDArrayHandle** in_args,
+                                     NDArrayHandle** arg_grads,
+                                     mx_uint* num_aux_states,
+                                     NDArrayHandle** aux_states,
+                                     ExecutorHandle *out);
+/*!
+ * \brief Free the bucketing executor and the executors of its buckets.
+ * \param handle the handle to be freed
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXBucketingExecutorFree(BucketingExecutorHandle handle);
+/*!
+ * \brief Bind a symbol on several devices, each executor taking a slice of
+ *  the batch along the first axis, for data parallel training. The calls on
+ *  the group are issued for all the devices at once.
+ * \param symbol_handle the symbol, whose outputs should be losses
+ * \param num_ctx the number of the devices
+ * \param dev_types the device type of each device
+ * \param dev_ids the device id of each device
+ * \param num_data the number of the arguments split over the devices, such as
+ *  the data and the label; the other arguments are the parameters
+ * \param data_names the names of these arguments
+ * \param data_shape_indptr index pointer of the shapes, of length num_data + 1
+ * \param data_shape_data the flattened shapes of the whole batch
+ * \param out the created handle, freed with MXExecutorGroupFree
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorGroupCreate(SymbolHandle symbol_handle,
+                                    mx_uint num_ctx,
+                                    const int* dev_types,
+                                    const int* dev_ids,
+                                    mx_uint num_data,
+                                    const char** data_names,
+                                    const mx_uint* data_shape_indptr,
+                                    const mx_uint* data_shape_data,
+                                    ExecutorGroupHandle *out);
+/*!
+ * \brief Copy parameters or auxiliary states to all the devices of the group.
+ * \param handle the executor group
+ * \param num the number of the arrays
+ * \param names the names of the arrays
+ * \param arrays the arrays
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorGroupSetParams(ExecutorGroupHandle handle,
+                                       mx_uint num,
+                                       const char** names,
+                                       NDArrayHandle* arrays);
+/*!
+ * \brief Copy the slices of a batch to the devices and run the forward pass.
+ * \param handle the executor group
+ * \param num_data the number of the arrays, as at the creation
+ * \param data the batch of each argument given at the creation, in order
+ * \param is_train whether the forward pass is for training
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorGroupForward(ExecutorGroupHandle handle,
+                                     mx_uint num_data,
+                                     NDArrayHandle* data,
+                                     int is_train);
+/*!
+ * \brief Run the backward pass on all the devices of the group.
+ * \param handle the executor group
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorGroupBackward(ExecutorGroupHandle handle);
+/*!
+ * \brief Initialize the parameters in the kvstore with the ones of the first
+ *  device, and pull them to all the devices. The key of a parameter is its
+ *  index among the arguments which are not data.
+ * \param handle the executor group
+ * \param kvstore the kvstore
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorGroupInitKVStore(ExecutorGroupHandle handle,
+                                         KVStoreHandle kvstore);
+/*!
+ * \brief Push the gradients of all the devices to the kvstore, which should
+ *  have an updater, and pull the updated parameters.
+ * \param handle the executor group
+ * \param kvstore the kvstore
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorGroupUpdate(ExecutorGroupHandle handle,
+                                    KVStoreHandle kvstore);
+/*!
+ * \brief Get the outputs of all the devices, the ones of the first device first.
+ * \param handle the executor group
+ * \param out_size the number of the outputs
+ * \param out new handles to the outputs
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorGroupGetOutputs(ExecutorGroupHandle handle,
+                                        mx_uint *out_size,
+                                        NDArrayHandle **out);
+/*!
+ * \brief Free the executor group.
+ * \param handle the handle to be freed
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorGroupFree(ExecutorGroupHandle handle);
+/*!
+ * \brief Bind a symbol placed over devices with group2ctx once per micro-batch,
+ *  the batch split along the first axis. The executors share the parameters
+ *  and the gradients, which are the sums over the micro-batches, and all the
+ *  micro-batches are pushed at once, so that the devices work on different
+ *  micro-batches at the same time.
+ * \param symbol_handle the symbol, whose outputs should be losses
+ * \param dev_type the device type of the nodes out of the groups
+ * \param dev_id the device id of the nodes out of the groups
+ * \param num_g2c_keys the number of the groups
+ * \param g2c_keys the name of each group
+ * \param g2c_dev_types the device type of each group
+ * \param g2c_dev_ids the device id of each group
+ * \param num_data the number of the arguments split into the micro-batches,
+ *  such as the data and the label; the other arguments are the parameters
+ * \param data_names the names of these arguments
+ * \param data_shape_indptr index pointer of the shapes, of length num_data + 1
+ * \param data_shape_data the flattened shapes of the whole batch
+ * \param num_micro_batches the number of the micro-batches
+ * \param out the created handle, freed with MXPipelineExecutorFree
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXPipelineExecutorCreate(SymbolHandle symbol_handle,
+                                       int dev_type,
+                                       int dev_id,
+                                       mx_uint num_g2c_keys,
+                                       const char** g2c_keys,
+                                       const int* g2c_dev_types,
+                                       const int* g2c_dev_ids,
+                                       mx_uint num_data,
+                                       const char** data_names,
+                                       const mx_uint* data_shape_indptr,
+                                       const mx_uint* data_shape_data,
+                                       int num_micro_batches,
+                                       PipelineExecutorHandle *out);
+/*!
+ * \brief Copy parameters or auxiliary states to their devices.
+ * \param handle the pipeline executor
+ * \param num the number of the arrays
+ * \param names the names of the arrays
+ * \param arrays the arrays
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXPipelineExecutorSetParams(PipelineExecutorHandle handle,
+                                          mx_uint num,
+                                          const char** names,
+                                          NDArrayHandle* arrays);
+/*!
+ * \brief Copy the micro-batches of a batch and run the forward pass of each.
+ * \param handle the pipeline executor
+ * \param num_data the number of the arrays, as at the creation
+ * \param data the batch of each argument given at the creation, in order
+ * \param is_train whether the forward pass is for training
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXPipelineExecutorForward(PipelineExecutorHandle handle,
+                                        mx_uint num_data,
+                                        NDArrayHandle* data,
+                                        int is_train);
+/*!
+ * \brief Run the backward pass of every micro-batch.
+ * \param handle the pipeline executor
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXPipelineExecutorBackward(PipelineExecutorHandle handle);
+/*!
+ * \brief Get the outputs of all the micro-batches, the ones of the first first.
+ * \param handle the pipeline executor
+ * \param out_size the number of the outputs
+ * \param out new handles to the outputs
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXPipelineExecutorGetOutputs(PipelineExecutorHandle handle,
+                                           mx_uint *out_size,
+                                           NDArrayHandle **out);
+/*!
+ * \brief Get the parameters and their gradients, which are the sums over the
+ *  micro-batches.
+ * \param handle the pipeline executor
+ * \param out_size the number of the parameters
+ * \param out_names the names of the parameters
+ * \param out_params new handles to the parameters
+ * \param out_grads new handles to the gradients
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXPipelineExecutorGetParams(PipelineExecutorHandle handle,
+                                          mx_uint *out_size,
+                                          const char ***out_names,
+                                          NDArrayHandle **out_params,
+                                          NDArrayHandle **out_grads);
+/*!
+ * \brief Free the pipeline executor.
+ * \param handle the handle to be freed
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXPipelineExecutorFree(PipelineExecutorHandle handle);
 //--------------------------------------------
 // Part 5: IO Interface
 //--------------------------------------------
@@ -1358,6 +1924,21 @@ MXNET_DLL int MXDataIterGetPadNum(DataIterHandle handle,
  */
 MXNET_DLL int MXDataIterGetLabel(DataIterHandle handle,
                                  NDArrayHandle *out);
+/*!
+ * \brief Get the throughput counters of the iterator and of the iterators
+ *  it wraps, such as the bytes read, the records decoded, the time spent in
+ *  decoding and augmentation, and the occupancy and stall time of the
+ *  prefetch queue. Times are in microseconds.
+ * \param handle the handle pointer to the data iterator
+ * \param out_size the number of counters
+ * \param out_keys the names of the counters
+ * \param out_values the values of the counters
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXDataIterGetStats(DataIterHandle handle,
+                                 mx_uint *out_size,
+                                 const char ***out_keys,
+                                 uint64_t **out_values);
 //--------------------------------------------
 // Part 6: basic KVStore interface
 //--------------------------------------------
@@ -1468,6 +2049,40 @@ MXNET_DLL int MXKVStorePullEx(KVStoreHandle handle,
                               const char** keys,
                               NDArrayHandle* vals,
                               int priority);
+/*!
+ * \brief push the rows of a list of (key, value) pairs listed in row_ids,
+ *  the other rows of the values being zero, where each key is a string
+ * \param handle handle to the kvstore
+ * \param num the number of key-value pairs
+ * \param keys the list of keys
+ * \param vals the list of values
+ * \param row_ids the row indices of each value
+ * \param priority the priority of the action
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStorePushRowSparseEx(KVStoreHandle handle,
+                                       mx_uint num,
+                                       const char** keys,
+                                       NDArrayHandle* vals,
+                                       NDArrayHandle* row_ids,
+                                       int priority);
+/*!
+ * \brief pull the rows of a list of (key, value) pairs listed in row_ids,
+ *  where each key is a string
+ * \param handle handle to the kvstore
+ * \param num the number of key-value pairs
+ * \param keys the list of keys
+ * \param vals the list of values
+ * \param row_ids the row indices of each value
+ * \param priority the priority of the action
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStorePullRowSparseEx(KVStoreHandle handle,
+                                       mx_uint num,
+                                       const char** keys,
+                                       NDArrayHandle* vals,
+                                       NDArrayHandle* row_ids,
+                                       int priority);
 /*!
  * \brief user-defined updater for the kvstore
  * It's this updater's responsibility to delete \a recv and \a local
@@ -1565,6 +2180,20 @@ MXNET_DLL int MXKVStoreBarrier(KVStoreHandle handle);
 MXNET_DLL int MXKVStoreSetBarrierBeforeExit(KVStoreHandle handle,
                                             const int barrier_before_exit);
 
+/**
+ * \brief set the compression of the gradients pushed to the servers
+ *
+ * \param handle handle to the KVStore
+ * \param num_params number of parameters of the compression
+ * \param keys the names of the parameters
+ * \param vals the values of the parameters
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStoreSetGradientCompression(KVStoreHandle handle,
+                                              mx_uint num_params,
+                                              const char** keys,
+                                              const char** vals);
+
 /**
  * \brief the prototype of a server controller
  * \param head the head of the command
@@ -48,6 +48,8 @@ typedef float mx_float;
 typedef void *PredictorHandle;
 /*! \brief handle to NDArray list */
 typedef void *NDListHandle;
+/*! \brief handle to a batcher of the requests of a predictor */
+typedef void *PredictBatcherHandle;
 
 /*!
  * \brief Get the last error happeneed.
@@ -118,6 +120,110 @@ MXNET_DLL int MXPredCreatePartialOut(const char* symbol_json_str,
                                      mx_uint num_output_nodes,
                                      const char** output_keys,
                                      PredictorHandle* out);
+/*!
+ * \brief create a predictor, with the parameters of a local file that is
+ *  mapped into memory rather than read. The float32 parameters of a cpu
+ *  predictor are read from the mapping in place, so that the predictor
+ *  starts without reading them, and the processes that load one file share
+ *  its memory. The file must not be rewritten while the predictor is alive.
+ * \param symbol_json_str The JSON string of the symbol.
+ * \param param_file The name of the parameter file.
+ * \param dev_type The device type, 1: cpu, 2:gpu
+ * \param dev_id The device id of the predictor.
+ * \param num_input_nodes Number of input nodes to the net,
+ *    For feedforward net, this is 1.
+ * \param input_keys The name of input argument.
+ *    For feedforward net, this is {"data"}
+ * \param input_shape_indptr Index pointer of shapes of each input node.
+ *    The length of this array = num_input_nodes + 1.
+ * \param input_shape_data A flatted data of shapes of each input node.
+ * \param out The created predictor handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredCreateFromFile(const char* symbol_json_str,
+                                   const char* param_file,
+                                   int dev_type, int dev_id,
+                                   mx_uint num_input_nodes,
+                                   const char** input_keys,
+                                   const mx_uint* input_shape_indptr,
+                                   const mx_uint* input_shape_data,
+                                   PredictorHandle* out);
+/*!
+ * \brief create a predictor that shares the weights of another predictor.
+ *  It reads the parameter arrays of handle rather than copies of them, and
+ *  has its own inputs, auxiliary states and memory for the activations, so
+ *  that predictors of one model can run in different threads with one copy
+ *  of the weights. The weights stay alive until all their predictors are freed.
+ *
+ *  Setting a parameter with MXPredSetInput changes it in all the predictors.
+ * \param handle The predictor whose weights are shared.
+ * \param num_input_nodes Number of input nodes whose shapes change, 0 keeps the shapes of handle.
+ * \param input_keys The names of the input nodes whose shapes change.
+ * \param input_shape_indptr Index pointer of shapes of each input node.
+ *    The length of this array = num_input_nodes + 1.
+ * \param input_shape_data A flatted data of shapes of each input node.
+ *    The shapes may only change the shapes of the activations, such as the batch size.
+ * \param out The created predictor handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredCreateShared(PredictorHandle handle,
+                                 mx_uint num_input_nodes,
+                                 const char** input_keys,
+                                 const mx_uint* input_shape_indptr,
+                                 const mx_uint* input_shape_data,
+                                 PredictorHandle* out);
+/*!
+ * \brief create a predictor that shares the weights of another predictor,
+ *  with the same input shapes. See MXPredCreateShared.
+ * \param handle The predictor whose weights are shared.
+ * \param out The created predictor handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredClone(PredictorHandle handle, PredictorHandle* out);
+/*!
+ * \brief create a predictor for other input shapes, such as another batch
+ *  size, without loading the model again. It reads the weights of handle,
+ *  and its executor reuses the memory of the executor of handle where it can,
+ *  so the two predictors must not run at the same time; keeping one reshaped
+ *  predictor for each batch size makes switching between them free.
+ *  handle stays valid and must still be freed with MXPredFree.
+ * \param num_input_nodes Number of input nodes whose shapes change.
+ * \param input_keys The names of the input nodes whose shapes change.
+ * \param input_shape_indptr Index pointer of shapes of each input node.
+ *    The length of this array = num_input_nodes + 1.
+ * \param input_shape_data A flatted data of shapes of each input node.
+ * \param handle The predictor to reshape.
+ * \param out The reshaped predictor handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredReshape(mx_uint num_input_nodes,
+                            const char** input_keys,
+                            const mx_uint* input_shape_indptr,
+                            const mx_uint* input_shape_data,
+                            PredictorHandle handle,
+                            PredictorHandle* out);
+/*!
+ * \brief get the predictor of a bucket of handle, such as a sequence length,
+ *  reshaping handle with MXPredReshape the first time; thread safe.
+ *  The predictors of the buckets share the memory of handle, which should be
+ *  created with the largest inputs, so they must not run at the same time.
+ * \param handle The predictor of the default bucket.
+ * \param bucket_key The key of the bucket.
+ * \param num_input_nodes Number of input nodes whose shapes change, only used the first time.
+ * \param input_keys The names of the input nodes whose shapes change.
+ * \param input_shape_indptr Index pointer of shapes of each input node.
+ *    The length of this array = num_input_nodes + 1.
+ * \param input_shape_data A flatted data of shapes of each input node.
+ * \param out The predictor of the bucket, owned by handle and not to be freed.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredGetBucket(PredictorHandle handle,
+                              int bucket_key,
+                              mx_uint num_input_nodes,
+                              const char** input_keys,
+                              const mx_uint* input_shape_indptr,
+                              const mx_uint* input_shape_data,
+                              PredictorHandle* out);
 /*!
  * \brief Get the shape of output node.
  *  The returned shape_data and shape_ndim is only valid before next call to MXPred function.
@@ -144,6 +250,23 @@ MXNET_DLL int MXPredSetInput(PredictorHandle handle,
                              const char* key,
                              const mx_float* data,
                              mx_uint size);
+/*!
+ * \brief Bind the input of a cpu predictor to a buffer of the caller, which
+ *  the forward passes then read in place rather than copying it with
+ *  MXPredSetInput. The caller writes the next input into the buffer once the
+ *  outputs of the previous pass are read, and keeps the buffer alive as long
+ *  as the predictor. Binding rebinds the executor, so it is done once, not
+ *  before every pass. Buffers aligned to 64 bytes suit the vectorized kernels.
+ * \param handle The predictor handle.
+ * \param key The name of input node to bind.
+ * \param data The buffer, with room for the shape of the input.
+ * \param size The size of the buffer in floats, used for safety check.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredBindInput(PredictorHandle handle,
+                              const char* key,
+                              mx_float* data,
+                              mx_uint size);
 /*!
  * \brief Run a forward pass to get the output.
  * \param handle The handle of the predictor.
@@ -179,12 +302,115 @@ MXNET_DLL int MXPredGetOutput(PredictorHandle handle,
                               mx_uint index,
                               mx_float* data,
                               mx_uint size);
+/*!
+ * \brief the callback of MXPredGetOutputAsync, called on an engine thread
+ *  with the param of the copy once it is done
+ */
+typedef void (*MXPredCopyCallback)(void* /*param*/);
+/*!
+ * \brief Start copying the output value of prediction without waiting.
+ *
+ *  The copy runs after the forward that computes the output, and before the
+ *  next forward overwrites it, so the caller can prepare the next input in
+ *  the meantime. data must stay valid until the callback is called.
+ *
+ * \param handle The handle of the predictor.
+ * \param index The index of output node, set to 0 if there is only one output.
+ * \param data User allocated data to hold the output.
+ * \param size The size of data array, used for safe checking.
+ * \param callback Called once data holds the output.
+ * \param callback_param The argument of the callback.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredGetOutputAsync(PredictorHandle handle,
+                                   mx_uint index,
+                                   mx_float* data,
+                                   mx_uint size,
+                                   MXPredCopyCallback callback,
+                                   void* callback_param);
+/*!
+ * \brief Get a pointer to the output of a cpu predictor, rather than a copy.
+ *  Waits for the forward pass. The memory is valid until the next forward
+ *  pass or until the predictor is freed.
+ * \param handle The handle of the predictor.
+ * \param index The index of the output node, set to 0 if there is only one output.
+ * \param data Used to hold the pointer to the output.
+ * \param size Used to hold the size of the output in floats.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredGetOutputPtr(PredictorHandle handle,
+                                 mx_uint index,
+                                 const mx_float** data,
+                                 mx_uint* size);
 /*!
  * \brief Free a predictor handle.
  * \param handle The handle of the predictor.
  * \return 0 when success, -1 when failure.
  */
 MXNET_DLL int MXPredFree(PredictorHandle handle);
+/*!
+ * \brief create a batcher, which runs the requests of one sample each that
+ *  many threads submit with MXPredBatcherRun in batches. A worker takes the
+ *  queued requests once there are enough for the largest batch size, or once
+ *  the oldest one has waited max_delay_us, and runs them with its predictor
+ *  of the smallest batch size that holds them. The workers have a predictor
+ *  for each batch size that shares the weights of handle, see
+ *  MXPredCreateShared and MXPredReshape.
+ *
+ *  The first axis of the input and of the outputs is the batch, a request
+ *  holds the rest of the input shape of handle.
+ * \param handle The predictor whose weights are shared, it may be freed after.
+ * \param input_key The name of the input node of the requests.
+ * \param num_batch_sizes The number of batch sizes.
+ * \param batch_sizes The batch sizes the requests are padded to.
+ * \param num_workers The number of batches that run at the same time.
+ * \param max_delay_us The longest a request waits for a fuller batch, in microseconds.
+ * \param out The created batcher handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredBatcherCreate(PredictorHandle handle,
+                                  const char* input_key,
+                                  mx_uint num_batch_sizes,
+                                  const mx_uint* batch_sizes,
+                                  mx_uint num_workers,
+                                  mx_uint max_delay_us,
+                                  PredictBatcherHandle* out);
+/*!
+ * \brief Get the shape of an output of one request of a batcher.
+ * \param handle The batcher handle.
+ * \param index The index of the output node.
+ * \param shape_data Used to hold pointer to the shape data, without the batch axis.
+ * \param shape_ndim Used to hold shape dimension.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredBatcherGetOutputShape(PredictBatcherHandle handle,
+                                          mx_uint index,
+                                          const mx_uint** shape_data,
+                                          mx_uint* shape_ndim);
+/*!
+ * \brief Run one sample with a batcher, blocking until its outputs are written.
+ *  It may be called from many threads at the same time.
+ * \param handle The batcher handle.
+ * \param data The input of the sample.
+ * \param size The size of data, used for safety check.
+ * \param num_outputs The number of outputs of the predictor.
+ * \param outputs User allocated data to hold each output of the sample.
+ * \param output_sizes The size of each output, used for safety check.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredBatcherRun(PredictBatcherHandle handle,
+                               const mx_float* data,
+                               mx_uint size,
+                               mx_uint num_outputs,
+                               mx_float** outputs,
+                               const mx_uint* output_sizes);
+/*!
+ * \brief Free a batcher, after running the requests it holds.
+ *  No request may be submitted once it is called.
+ * \param handle The batcher handle.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXPredBatcherFree(PredictBatcherHandle handle);
 /*!
  * \brief Create a NDArray List by loading from ndarray file.
  *     This can be used to load mean image file.
@@ -198,6 +424,17 @@ MXNET_DLL int MXNDListCreate(const char* nd_file_bytes,
                              int nd_file_size,
                              NDListHandle *out,
                              mx_uint* out_length);
+/*!
+ * \brief Create a NDArray List by mapping a local file into memory.
+ *  The float32 arrays are read from the mapping in place rather than copied.
+ * \param nd_file The name of the NDArray file.
+ * \param out The out put NDListHandle
+ * \param out_length Length of the list.
+ * \return 0 when success, -1 when failure.
+ */
+MXNET_DLL int MXNDListCreateFromFile(const char* nd_file,
+                                     NDListHandle *out,
+                                     mx_uint* out_length);
 /*!
  * \brief Get an element from list
  * \param handle The handle to the NDArray
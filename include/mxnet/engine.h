@@ -27,6 +27,7 @@
 #include <dmlc/base.h>
 #if DMLC_USE_CXX11
 #include <algorithm>
+#include <atomic>
 #include <memory>
 #include <functional>
 #endif
@@ -117,6 +118,19 @@ class MXNET_API Engine {
    * \return The new variable allocated.
    */
   virtual VarHandle NewVariable() = 0;
+  /*!
+   * \brief Allocate a variable for a part of the data of parent, as a slice
+   *        of an array. The operations that mutate the parts of different
+   *        variables can run concurrently, and stay ordered with the
+   *        operations on parent; reading a part reads parent. The parts must
+   *        not overlap, and are deleted with DeleteVariable before parent.
+   *        The engines that do not track the parts return parent itself.
+   * \param parent the variable of the whole data.
+   * \return the variable of the part.
+   */
+  virtual VarHandle NewViewVariable(VarHandle parent) {
+    return parent;
+  }
   /*!
    * \brief Create a new operator. The returned operator could be saved
    *        externally so that it could be resued for scheduling.
@@ -168,6 +182,35 @@ class MXNET_API Engine {
                          FnProperty prop = FnProperty::kNormal,
                          int priority = 0,
                          const char* opr_name = nullptr) = 0;
+  /*! \brief An asynchronous operation to be pushed by PushAsyncBatch. */
+  struct AsyncOpr {
+    /*! \brief Execution function, see PushAsync. */
+    AsyncFn fn;
+    /*! \brief Execution context. */
+    Context exec_ctx;
+    /*! \brief The variables that the operation will use but not mutate. */
+    std::vector<VarHandle> const_vars;
+    /*! \brief The variables that the operation will mutate. */
+    std::vector<VarHandle> mutable_vars;
+    /*! \brief Property of the function. */
+    FnProperty prop{FnProperty::kNormal};
+    /*! \brief Priority of the action, as hint to the engine. */
+    int priority{0};
+    /*! \brief The operator name. */
+    const char* opr_name{nullptr};
+  };
+  /*!
+   * \brief Push a sequence of asynchronous operations to the engine.
+   *  This is equivalent to calling PushAsync on each of them in order,
+   *  but lets the engine amortize the per-push overhead.
+   * \param oprs The operations to push. The functions are moved out.
+   */
+  virtual void PushAsyncBatch(std::vector<AsyncOpr>* oprs) {
+    for (auto& opr : *oprs) {
+      this->PushAsync(std::move(opr.fn), opr.exec_ctx, opr.const_vars,
+                      opr.mutable_vars, opr.prop, opr.priority, opr.opr_name);
+    }
+  }
   /*!
    * \brief Schedule the deletion of a variable.
    *
@@ -188,6 +231,20 @@ class MXNET_API Engine {
    *            variable is ready.
    */
   virtual void WaitForVar(VarHandle var) = 0;
+  /*!
+   * \brief Get a stamp of the writes pushed on a variable. The stamp changes
+   *        whenever an operation that writes the variable, or the variable it
+   *        is a view of, is pushed, and is never that of another variable, so
+   *        an equal stamp means that the data was not written in between.
+   *        The engines that do not track the writes return a new stamp on
+   *        every call.
+   * \param var The variable.
+   * \return The stamp of the last write pushed on var.
+   */
+  virtual uint64_t WriteStamp(VarHandle var) {
+    static std::atomic<uint64_t> stamp{0};
+    return ++stamp;
+  }
   /*!
    * \brief Wait until all the activity of engine finishes.
    */
@@ -219,17 +276,46 @@ class MXNET_API Engine {
    * \param opr_name The operator name.
    * \tparam SyncFn the synchronous function to be pushed.
    */
-  inline void PushSync(SyncFn exec_fn, Context exec_ctx,
-                       std::vector<VarHandle> const& const_vars,
-                       std::vector<VarHandle> const& mutable_vars,
-                       FnProperty prop = FnProperty::kNormal,
-                       int priority = 0,
-                       const char* opr_name = nullptr) {
+  virtual void PushSync(SyncFn exec_fn, Context exec_ctx,
+                        std::vector<VarHandle> const& const_vars,
+                        std::vector<VarHandle> const& mutable_vars,
+                        FnProperty prop = FnProperty::kNormal,
+                        int priority = 0,
+                        const char* opr_name = nullptr) {
     this->PushAsync([exec_fn](RunContext ctx, CallbackOnComplete on_complete) {
         exec_fn(ctx);
         on_complete();
       }, exec_ctx, const_vars, mutable_vars, prop, priority, opr_name);
   }
+  /*!
+   * \brief Set the number of the normal operations pushed by PushSync that
+   *        the calling thread collects into one engine operation. The
+   *        collected operations are pushed when there are size of them, on a
+   *        change of context, and before any other push or wait of the thread.
+   * \param size the number of operations, 0 to push them one by one.
+   * \return the previous size.
+   */
+  virtual int set_bulk_size(int size) {
+    return 0;
+  }
+  /*!
+   * \brief Set whether the calling thread runs the CPU operations it pushes
+   *        inline: each runs on the thread before the push returns, without
+   *        dependency tracking, queueing or profiling. The other operations of
+   *        the thread are pushed as usual and waited for. Enabling the mode
+   *        waits for all the operations pushed before. The arrays of the thread
+   *        must not be used by the other threads meanwhile, and the CPU
+   *        resources it requests in the mode are its own.
+   * \param enable whether to run the operations inline.
+   * \return the previous setting.
+   */
+  virtual bool set_inline(bool enable) {
+    return false;
+  }
+  /*! \return whether the calling thread runs its CPU operations inline, see set_inline */
+  virtual bool is_inline() const {
+    return false;
+  }
 
   /*!
    * \brief factory function to create OnComplete callback.
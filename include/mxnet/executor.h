@@ -146,9 +146,22 @@ class Executor {
    */
   typedef std::function<void(const char*, void*)> MonitorCallback;
   /*!
-   * \brief Install a callback to notify the completion of operation.
+   * \brief Install a callback to notify the completion of operation,
+   *  an empty callback removes the installed one.
    */
   virtual void SetMonitorCallback(const MonitorCallback& callback) {}
+  /*!
+   * \brief the prototype of the callback taking the name of an argument and
+   *  the handle of its gradient
+   */
+  typedef std::function<void(const char*, void*)> GradientCallback;
+  /*!
+   * \brief Install a callback called during Backward as soon as the operation
+   *  computing the gradient of an argument is pushed to the engine, so that
+   *  the operations using the gradient can be pushed before the rest of the
+   *  backward pass. The operations of a bulk segment are pushed together.
+   */
+  virtual void SetGradientCallback(const GradientCallback& callback) {}
 };  // class executor
 }  // namespace mxnet
 #endif  // MXNET_EXECUTOR_H_
@@ -52,6 +52,11 @@ class IIterator : public dmlc::DataIter<DType> {
   virtual bool Next(void) = 0;
   /*! \brief get current data */
   virtual const DType &Value(void) const = 0;
+  /*!
+   * \brief append the counters of the iterator and of the iterators it reads
+   *  from, such as the bytes read or the time waited for the batches
+   */
+  virtual void GetStats(std::vector<std::pair<std::string, uint64_t> >* stats) const {}
   /*! \brief constructor */
   virtual ~IIterator(void) {}
   /*! \brief store the name of each data, it could be used for making NDArrays */
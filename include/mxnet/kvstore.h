@@ -29,6 +29,7 @@
 #include <string>
 #include <functional>
 #include <atomic>
+#include <utility>
 #include "./ndarray.h"
 #if MXNET_USE_DIST_KVSTORE
 #include "ps/ps.h"
@@ -172,6 +173,52 @@ class KVStore {
   virtual void Pull(const std::vector<std::string>& str_keys,
                     const std::vector<NDArray*>& values,
                     int priority = 0) = 0;
+  /*!
+   * \brief push the rows of the values listed in row_ids, the other rows of
+   *  the values being zero, like the gradient of an embedding
+   *
+   * The values are summed over the keys like \ref Push. The distributed store
+   * sends only the listed rows and the servers only update them, the others
+   * push the whole values.
+   *
+   * \param keys the list of keys
+   * \param values the list of values, at least 2-D
+   * \param row_ids the row indices of each value, in any dtype
+   * \param priority Priority of the action.
+   */
+  virtual void PushRowSparse(const std::vector<int>& keys,
+                             const std::vector<NDArray>& values,
+                             const std::vector<NDArray>& row_ids,
+                             int priority = 0) {
+    Push(keys, values, priority);
+  }
+  virtual void PushRowSparse(const std::vector<std::string>& str_keys,
+                             const std::vector<NDArray>& values,
+                             const std::vector<NDArray>& row_ids,
+                             int priority = 0) {
+    Push(str_keys, values, priority);
+  }
+  /*!
+   * \brief pull the rows listed in row_ids, the other rows of the values are
+   *  left unchanged by the distributed store and pulled by the others
+   *
+   * \param keys the list of keys
+   * \param values the list of buffers for the pulled data, they should be preallocated
+   * \param row_ids the row indices of each value, in any dtype
+   * \param priority Priority of the action.
+   */
+  virtual void PullRowSparse(const std::vector<int>& keys,
+                             const std::vector<NDArray*>& values,
+                             const std::vector<NDArray>& row_ids,
+                             int priority = 0) {
+    Pull(keys, values, priority);
+  }
+  virtual void PullRowSparse(const std::vector<std::string>& str_keys,
+                             const std::vector<NDArray*>& values,
+                             const std::vector<NDArray>& row_ids,
+                             int priority = 0) {
+    Pull(str_keys, values, priority);
+  }
 
 
   /**
@@ -196,6 +243,17 @@ class KVStore {
    * the following are used for multi-machines.
    ******************************************************/
 
+  /*!
+   * \brief set the compression of the gradients pushed to the servers,
+   * before the keys are initialized. only supported by the dist kvstores
+   *
+   * \param kwargs the parameters of the compression, type and threshold
+   */
+  virtual void SetGradientCompression(
+      const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    LOG(FATAL) << "Gradient compression is only supported by the dist kvstores";
+  }
+
   /**
    * \brief initalize ps-lite environment variables
    * \param envs key-value environment variables
@@ -32,6 +32,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
 #include <utility>
 #include <unordered_map>
 #include "./ndarray.h"
@@ -76,10 +77,28 @@ class MXRtc {
             unsigned int  block_dim_X,
             unsigned int  block_dim_Y,
             unsigned int  block_dim_Z);
+  /*!
+   * \brief launch the kernel on a stream directly, without the engine.
+   *  The caller is responsible for the dependencies of the blobs and
+   *  for the synchronization of the stream.
+   * \param input list of input blobs.
+   * \param output list of output blobs.
+   * \param dev_id device of the blobs.
+   * \param stream the stream to launch the kernel on.
+   * \param grid_dim_X kernel grid dimension.
+   * \param block_dim_X kernel block dimension.
+   */
+  void Launch(std::vector<TBlob> const& input,
+              std::vector<TBlob> const& output,
+              int dev_id,
+              mshadow::Stream<gpu> *stream,
+              unsigned int grid_dim_X,
+              unsigned int block_dim_X);
 
  private:
   static const char str_type[];
   static std::unordered_map<std::string, char*> kernel_registry;
+  static std::mutex registry_mutex;
 
   std::string name_;
   index_t num_input_, num_output_;
@@ -87,6 +106,8 @@ class MXRtc {
   char* ptx_;
   std::unordered_map<int, CUmodule> module_;
   std::unordered_map<int, CUfunction> func_;
+  /*! \brief protects module_ and func_ */
+  std::mutex mutex_;
 
   /*!
    * \brief add supporting code to kernel.
@@ -99,6 +120,10 @@ class MXRtc {
    * \brief compile the kernel with nvrtc.
    */
   char* compile(const std::string& name, const std::string& code);
+  /*!
+   * \brief get the kernel function loaded on a device.
+   */
+  CUfunction GetFunction(int dev_id);
 };
 
 }  // namespace mxnet
@@ -30,10 +30,13 @@
 #include <dmlc/type_traits.h>
 #include <dmlc/registry.h>
 #include <nnvm/node.h>
+#include <algorithm>
 #include <vector>
 #include <map>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <functional>
 #include "./base.h"
 #include "./storage.h"
 #include "./engine.h"
@@ -71,6 +74,37 @@ class AGNodeEntry {
 class AutogradRuntime;
 }  // namespace autograd
 
+/*! \brief the storage type of an NDArray */
+enum NDArrayStorageType {
+  kUndefinedStorage = -1,  // undefined storage
+  kDefaultStorage,         // dense
+  kRowSparseStorage,       // row sparse
+  kCSRStorage,             // csr
+};
+
+/*!
+ * \brief the encodings NDArray::Save may store the float32 dense arrays in,
+ *  which Load decodes to float32
+ */
+enum NDArraySaveEncoding {
+  kSaveRaw,      // the values
+  kSaveFloat16,  // fp16
+  kSaveInt8,     // int8 with a scale per array, for the arrays of 2 dimensions or more
+};
+
+namespace csr {
+/*! \brief the aux arrays of a csr array: row offsets and column indices */
+enum CSRAuxType {kIndPtr, kIdx};
+}  // namespace csr
+
+namespace rowsparse {
+/*! \brief the aux array of a row sparse array: the indices of its rows */
+enum RowSparseAuxType {kIdx};
+}  // namespace rowsparse
+
+/*! \brief the type of the indices of the sparse arrays */
+const int kSparseIndexType = mshadow::kInt32;
+
 /*!
  * \brief ndarray interface
  */
@@ -97,20 +131,63 @@ class NDArray {
     Mkl_mem_ = std::make_shared<MKLMemHolder>();
 #endif
   }
+  /*!
+   * \brief constructs a new dynamic sparse NDArray
+   * \param stype the storage type, row sparse or csr
+   * \param shape the dense shape of array
+   * \param ctx context of NDArray
+   * \param delay_alloc whether delay the allocation, the aux shapes are
+   *  usually only known when the array is written
+   * \param dtype data type of the values
+   * \param aux_types data types of the aux arrays, kSparseIndexType if empty
+   * \param aux_shapes shapes of the aux arrays, empty if unknown
+   * \param storage_shape shape of the values, empty if unknown
+   */
+  NDArray(const NDArrayStorageType stype, const TShape &shape, Context ctx,
+          bool delay_alloc = true, int dtype = mshadow::default_type_flag,
+          std::vector<int> aux_types = {}, std::vector<TShape> aux_shapes = {},
+          TShape storage_shape = TShape(mshadow::Shape1(0)));
   /*!
    * \brief constructing a static NDArray that shares data with TBlob
    *  Use with caution: allocate ONLY ONE NDArray for each TBlob,
    *  make sure the memory region is available through out the life of NDArray
    * \param data the memory content of static data
    * \param dev_id the device id this tensor sits at
+   * \param holder the owner of the memory, optional, which the array keeps
+   *  until it and its pending operations are gone
    */
-  NDArray(const TBlob &data, int dev_id)
-      : ptr_(std::make_shared<Chunk>(data, dev_id)), shape_(data.shape_),
+  NDArray(const TBlob &data, int dev_id, const std::shared_ptr<void> &holder = nullptr)
+      : ptr_(std::make_shared<Chunk>(data, dev_id, holder)), shape_(data.shape_),
         dtype_(data.type_flag_), entry_({nullptr, 0, 0}) {
 #if MKL_EXPERIMENTAL == 1
     Mkl_mem_ = std::make_shared<MKLMemHolder>();
 #endif
   }
+  /*!
+   * \brief constructs a dense NDArray on the cpu_shared memory of another
+   *  process, or of this one, without a copy. The array takes over the
+   *  reference GetSharedMemHandle added for it.
+   * \param shared_pid the id of the process which allocated the memory
+   * \param shared_id the id of the memory in that process
+   * \param shape the shape of array
+   * \param dtype data type of this ndarray
+   */
+  NDArray(int shared_pid, int shared_id, const TShape& shape, int dtype)
+      : ptr_(std::make_shared<Chunk>(shared_pid, shared_id, shape.Size(), dtype)),
+        shape_(shape), dtype_(dtype), entry_({nullptr, 0, 0}) {
+#if MKL_EXPERIMENTAL == 1
+    Mkl_mem_ = std::make_shared<MKLMemHolder>();
+#endif
+  }
+  /*!
+   * \brief the ids of the shared memory of a dense array on cpu_shared, for
+   *  the NDArray another process creates from them. Every call adds a
+   *  reference to the memory, which that NDArray takes over, so the memory
+   *  outlives this array until it is created. Waits for the pending writes.
+   * \param shared_pid set to the id of the process which allocated the memory
+   * \param shared_id set to the id of the memory in that process
+   */
+  void GetSharedMemHandle(int* shared_pid, int* shared_id) const;
   /*!
    * \return the shape of current NDArray
    */
@@ -118,13 +195,79 @@ class NDArray {
     return shape_;
   }
   /*!
-   * \return the data TBlob
+   * \return the shape of the values of a sparse NDArray, for row sparse
+   *  (number of rows stored, row width...) and for csr (number of non-zeros,)
+   */
+  inline const TShape& storage_shape() const {
+    CHECK(ptr_ != nullptr);
+    CHECK_NE(storage_type(), kDefaultStorage)
+        << "storage_shape() is not intended for the dense storage";
+    return ptr_->storage_shape;
+  }
+  /*! \return the shape of the i-th aux array of a sparse NDArray */
+  inline const TShape& aux_shape(size_t i) const {
+    CHECK_NE(storage_type(), kDefaultStorage)
+        << "aux_shape() is not intended for the dense storage";
+    return ptr_->aux_shapes.at(i);
+  }
+  /*! \return the shapes of all the aux arrays */
+  inline const std::vector<TShape>& aux_shapes() const {
+    CHECK_NE(storage_type(), kDefaultStorage)
+        << "aux_shapes() is not intended for the dense storage";
+    return ptr_->aux_shapes;
+  }
+  /*! \return the data types of all the aux arrays */
+  inline const std::vector<int>& aux_types() const {
+    CHECK_NE(storage_type(), kDefaultStorage)
+        << "aux_types() is not intended for the dense storage";
+    return ptr_->aux_types;
+  }
+  /*! \return the data type of the i-th aux array */
+  inline int aux_type(size_t i) const {
+    return aux_types().at(i);
+  }
+  /*! \return the storage type of the NDArray */
+  inline NDArrayStorageType storage_type() const {
+    if (is_none()) return kUndefinedStorage;
+    return ptr_->storage_type;
+  }
+  /*! \return whether the NDArray stores only some of its values */
+  inline bool is_sparse() const {
+    return storage_type() == kRowSparseStorage || storage_type() == kCSRStorage;
+  }
+  /*!
+   * \return the data TBlob, the values of a sparse NDArray in storage_shape
    */
   inline const TBlob& data() const {
-    CheckAndAlloc();
+    if (storage_type() == kDefaultStorage) CheckAndAlloc();
     SetTBlob();
     return tblob_;
   }
+  /*!
+   * \return the i-th aux array of a sparse NDArray as a TBlob
+   */
+  inline TBlob aux_data(size_t i) const {
+    CHECK_NE(storage_type(), kDefaultStorage)
+        << "aux_data() is not intended for the dense storage";
+    const Storage::Handle& h = ptr_->aux_handles.at(i);
+    return TBlob(h.dptr, ptr_->aux_shapes[i], h.ctx.dev_mask(), ptr_->aux_types[i],
+                 h.ctx.dev_id);
+  }
+  /*!
+   * \return a dense copy of the values of a sparse NDArray, in storage_shape
+   */
+  NDArray data_ndarray() const;
+  /*!
+   * \return a dense copy of the i-th aux array of a sparse NDArray
+   */
+  NDArray aux_ndarray(size_t i) const;
+  /*!
+   * \brief copy a dense src of the same context into the values (i < 0) or
+   *  the i-th aux array of a sparse NDArray, allocating it for src's shape
+   * \param src the dense array to copy from
+   * \param i the aux array to write, -1 for the values
+   */
+  void SyncCopyFromNDArray(const NDArray &src, int i = -1);
   /*!
    * \return the gradient ndarray.
    */
@@ -155,7 +298,7 @@ class NDArray {
    */
   inline void WaitToRead() const {
     if (is_none()) return;
-    Engine::Get()->WaitForVar(ptr_->var);
+    Engine::Get()->WaitForVar(this->var());
   }
   /*!
    * \brief Block until all the pending read/write operations with respect
@@ -167,12 +310,12 @@ class NDArray {
      * Push an empty mutable function to flush all preceding reads to the
      * variable.
      */
-    Engine::Get()->PushSync([](RunContext) {}, Context{}, {}, {ptr_->var});
-    Engine::Get()->WaitForVar(ptr_->var);
+    Engine::Get()->PushSync([](RunContext) {}, Context{}, {}, {this->var()});
+    Engine::Get()->WaitForVar(this->var());
   }
   /*! \return the associated variable of the ndarray.*/
   inline Engine::VarHandle var() const {
-    return ptr_->var;
+    return slice_var_ ? slice_var_->var : ptr_->var;
   }
   /*!
    * \brief save the content into binary stream
@@ -280,6 +423,30 @@ class NDArray {
    * \param size the memory size we want to copy into, in sizeof(DType) not raw btyes.
    */
   void SyncCopyToCPU(void *data, size_t size) const;
+  /*!
+   * \brief copy from a continugous CPU memory region without waiting, after
+   *  the pending operations of the array, as an operation of the engine.
+   *  The memory must stay valid and unchanged until the copy is done, which
+   *  WaitToRead waits for.
+   *
+   * \param data the data source to copy from.
+   * \param size the size of the source array, in sizeof(DType) not raw btyes.
+   * \param on_complete called on an engine thread once the copy is done, may be empty.
+   *  It runs after the copy has released the array, so it may wait for it.
+   */
+  void AsyncCopyFromCPU(const void *data, size_t size,
+                        std::function<void()> on_complete = nullptr) const;
+  /*!
+   * \brief copy to a continugous CPU memory region without waiting, after the
+   *  pending writes of the array, as an operation of the engine. The memory must
+   *  stay valid until the copy is done, which WaitToWrite waits for.
+   *
+   * \param data the data source to copyinto.
+   * \param size the memory size we want to copy into, in sizeof(DType) not raw btyes.
+   * \param on_complete called on an engine thread once the copy is done, may be empty.
+   */
+  void AsyncCopyToCPU(void *data, size_t size,
+                      std::function<void()> on_complete = nullptr) const;
   /*!
    * \brief Slice a NDArray
    * \param begin begin index in first dim
@@ -301,6 +468,8 @@ class NDArray {
    * \return NDArray in new shape and type.
    */
   inline NDArray AsArray(const TShape &shape, int dtype) const {
+    CHECK_EQ(storage_type(), kDefaultStorage)
+        << "AsArray is not supported for the sparse storage";
     CHECK_GE(shape_.Size() * mshadow::mshadow_sizeof(dtype_),
              shape.Size() * mshadow::mshadow_sizeof(dtype))
         << "NDArray.AsArray: target memory size is bigger";
@@ -315,6 +484,17 @@ class NDArray {
     ret.dtype_ = dtype;
     return ret;
   }
+  /*!
+   * \brief Create an NDArray on the memory of this NDArray with its own
+   *  engine variable. The engine does not order the operations on the two
+   *  NDArrays, which is left to the caller. The memory stays valid as long
+   *  as the returned NDArray is in use.
+   * \param byte_offset offset of the memory in bytes.
+   * \param shape shape of the returned NDArray.
+   * \param dtype data type of the returned NDArray.
+   * \return NDArray on the memory.
+   */
+  NDArray MemoryView(size_t byte_offset, const TShape &shape, int dtype) const;
   /*!
    * \brief Get an reshaped NDArray
    * \param shape new shape
@@ -342,17 +522,59 @@ class NDArray {
    * This is an internal function used by system that normal user should not use
    */
   inline void CheckAndAlloc() const {
+    CHECK_EQ(storage_type(), kDefaultStorage)
+        << "the aux shapes are needed to allocate a sparse NDArray";
     ptr_->CheckAndAlloc();
   }
+  /*!
+   * \brief Allocate a sparse NDArray for the given aux shapes, the storage
+   *  shape follows from them. Memory is reused when it is large enough.
+   * This is an internal function used by system that normal user should not use
+   */
+  void CheckAndAlloc(const std::vector<TShape> &aux_shapes) const;
+  /*!
+   * \brief Allocate the values of a sparse NDArray for the storage shape
+   * This is an internal function used by system that normal user should not use
+   */
+  void CheckAndAllocData(const TShape &storage_shape) const;
+  /*!
+   * \brief Allocate the i-th aux array of a sparse NDArray for shape
+   * This is an internal function used by system that normal user should not use
+   */
+  void CheckAndAllocAux(size_t i, const TShape &shape) const;
   /*!
    * \brief Save list of ndarray into the Stream.x
    * \param fo The stream of output.
    * \param data the NDArrays to be saved.
    * \param names the name of the NDArray, optional, can be zero length.
+   * \param encoding the NDArraySaveEncoding of the float32 dense arrays.
+   *  The files of other encodings than kSaveRaw are not read by the
+   *  versions without them.
    */
   static void Save(dmlc::Stream* fo,
                    const std::vector<NDArray>& data,
-                   const std::vector<std::string>& names);
+                   const std::vector<std::string>& names,
+                   int encoding = kSaveRaw);
+  /*!
+   * \brief Save list of ndarray into a file without waiting for them. The
+   *  arrays are copied to the cpu by the engine, in order with their other
+   *  operations, so that they may be written right after the call, and the
+   *  copies are written by a thread of their own in the format of Save.
+   *  The saves complete in the order of the calls, WaitSaves and
+   *  Engine::WaitForAll wait for them.
+   * \param fname the name of the file.
+   * \param data the NDArrays to be saved.
+   * \param names the name of the NDArray, optional, can be zero length.
+   * \param encoding the NDArraySaveEncoding of the float32 dense arrays.
+   */
+  static void SaveAsync(const std::string& fname,
+                        const std::vector<NDArray>& data,
+                        const std::vector<std::string>& names,
+                        int encoding = kSaveRaw);
+  /*!
+   * \brief wait for the saves of SaveAsync, failing if one of them failed
+   */
+  static void WaitSaves();
   /*!
    * \brief Load list of ndarray into from the stream.
    * \param fi The stream of the input file.
@@ -362,9 +584,41 @@ class NDArray {
   static void Load(dmlc::Stream* fi,
                    std::vector<NDArray>* data,
                    std::vector<std::string>* keys);
+  /*!
+   * \brief Load list of ndarray from a local file by mapping it into memory.
+   *  The dense arrays saved from the cpu are views of the mapping rather
+   *  than copies, so that loading costs no reads until the values are used,
+   *  and the processes that load one file share its pages. The mapping is
+   *  private: writing an array copies the pages it writes, and never
+   *  changes the file. The file must not be truncated or rewritten while
+   *  the arrays are alive. Without mmap, it is Load.
+   * \param fname the name of the file.
+   * \param data the NDArrays to be loaded
+   * \param keys the name of the NDArray, if saved in the file.
+   */
+  static void LoadMapped(const std::string& fname,
+                         std::vector<NDArray>* data,
+                         std::vector<std::string>* keys);
 
  private:
   friend class autograd::AutogradRuntime;
+  struct Chunk;
+  /*!
+   * \brief the engine variable of the slices of a byte range of a chunk,
+   *  shared by the slices of the range. The writes of the slices of
+   *  disjoint ranges run concurrently, see Engine::NewViewVariable.
+   */
+  struct SliceVar {
+    /*! \brief the chunk, deleted after the variable */
+    std::shared_ptr<Chunk> chunk;
+    /*! \brief the byte range in the chunk */
+    size_t begin, end;
+    /*! \brief the view variable of the chunk variable */
+    Engine::VarHandle var;
+    ~SliceVar() {
+      Engine::Get()->DeleteVariable([](RunContext s) {}, chunk->shandle.ctx, var);
+    }
+  };
   /*! \brief the real data chunk that backs NDArray */
   struct Chunk {
     /*! \brief storage handlefrom storage engine */
@@ -378,14 +632,33 @@ class NDArray {
     bool static_data;
     /*! \brief whether allocation is delayed */
     bool delay_alloc;
+    /*! \brief chunk owning the memory of a view chunk */
+    std::shared_ptr<Chunk> base;
+    /*! \brief the owner of the memory of static data, if any */
+    std::shared_ptr<void> holder;
+    /*! \brief the storage type, dense unless built by the sparse constructor */
+    NDArrayStorageType storage_type = kDefaultStorage;
+    /*! \brief the storage of the aux arrays of a sparse chunk */
+    std::vector<Storage::Handle> aux_handles;
+    /*! \brief the data types and shapes of the aux arrays */
+    std::vector<int> aux_types;
+    std::vector<TShape> aux_shapes;
+    /*! \brief the shape of the values of a sparse chunk */
+    TShape storage_shape;
+    /*! \brief the data type of the values, to allocate a sparse chunk */
+    int dtype = -1;
+    /*! \brief the variables of the live slices, at most kMaxSliceVars */
+    std::vector<std::weak_ptr<SliceVar> > slice_vars;
+    /*! \brief protects slice_vars */
+    std::mutex slice_mutex;
     /*! \brief default cosntructor */
     Chunk() : static_data(true), delay_alloc(false) {
       var  = Engine::Get()->NewVariable();
     }
     /*! \brief construct from static data */
-    Chunk(const TBlob &data, int dev_id)
+    Chunk(const TBlob &data, int dev_id, const std::shared_ptr<void> &holder_ = nullptr)
         : static_data(true),
-          delay_alloc(false) {
+          delay_alloc(false), holder(holder_) {
       var = Engine::Get()->NewVariable();
       if (data.dev_mask() == cpu::kDevMask) {
         shandle.ctx = Context::CPU();
@@ -396,6 +669,15 @@ class NDArray {
       shandle.dptr = data.dptr_;
       shandle.size = data.shape_.Size() * mshadow::mshadow_sizeof(data.type_flag_);
     }
+    /*! \brief construct a view of the memory of another chunk */
+    Chunk(const std::shared_ptr<Chunk>& base_chunk, size_t offset, size_t size)
+        : static_data(true), delay_alloc(false), base(base_chunk) {
+      var = Engine::Get()->NewVariable();
+      base->CheckAndAlloc();
+      shandle.ctx = base->shandle.ctx;
+      shandle.dptr = static_cast<char*>(base->shandle.dptr) + offset;
+      shandle.size = size;
+    }
     /*! \brief construct a new chunk */
     Chunk(uint64_t size, Context ctx, bool delay_alloc_, int dtype)
         : static_data(false), delay_alloc(true) {
@@ -404,6 +686,32 @@ class NDArray {
       shandle.ctx = ctx;
       if (!delay_alloc_) this->CheckAndAlloc();
     }
+    /*! \brief construct a chunk of the shared memory of a process */
+    Chunk(int shared_pid, int shared_id, uint64_t size, int dtype)
+        : static_data(false), delay_alloc(false) {
+      var = Engine::Get()->NewVariable();
+      shandle = Storage::Get()->SharedAttach(shared_pid, shared_id);
+      CHECK_GE(shandle.size, size * mshadow::mshadow_sizeof(dtype))
+          << "the shared memory is smaller than the array";
+    }
+    /*! \brief construct a new sparse chunk */
+    Chunk(NDArrayStorageType stype, const TShape &storage_shape_, Context ctx,
+          bool delay_alloc_, int dtype_, const std::vector<int> &aux_types_,
+          const std::vector<TShape> &aux_shapes_)
+        : static_data(false), delay_alloc(true), storage_type(stype),
+          aux_types(aux_types_), aux_shapes(aux_shapes_),
+          storage_shape(storage_shape_), dtype(dtype_) {
+      var = Engine::Get()->NewVariable();
+      shandle.ctx = ctx;
+      aux_handles.resize(aux_types.size());
+      for (auto& h : aux_handles) h.ctx = ctx;
+      if (!delay_alloc_) {
+        for (size_t i = 0; i < aux_shapes.size(); ++i) {
+          CheckAndAllocAux(i, aux_shapes[i]);
+        }
+        CheckAndAllocData(storage_shape);
+      }
+    }
     /*! \brief check if delay alloc is on, do alloc if not yet done */
     inline void CheckAndAlloc(void) {
       if (delay_alloc) {
@@ -411,22 +719,70 @@ class NDArray {
         delay_alloc = false;
       }
     }
+    /*!
+     * \brief make h hold at least size bytes, the memory is kept when it is
+     *  large enough so that a sparse array rewritten every batch does not
+     *  allocate every batch
+     */
+    static void Reserve(Storage::Handle* h, size_t size) {
+      if (h->dptr != nullptr && h->size >= size) return;
+      if (h->dptr != nullptr) Storage::Get()->Free(*h);
+      Context ctx = h->ctx;
+      // zero sized arrays are valid, e.g. a row sparse array without rows
+      *h = Storage::Get()->Alloc(std::max<size_t>(size, 1), ctx);
+    }
+    /*! \brief allocate the values of a sparse chunk */
+    inline void CheckAndAllocData(const TShape &shape) {
+      CHECK_NE(storage_type, kDefaultStorage);
+      Reserve(&shandle, shape.Size() * mshadow::mshadow_sizeof(dtype));
+      storage_shape = shape;
+      delay_alloc = false;
+    }
+    /*! \brief allocate the i-th aux array of a sparse chunk */
+    inline void CheckAndAllocAux(size_t i, const TShape &shape) {
+      CHECK_NE(storage_type, kDefaultStorage);
+      if (aux_shapes.size() <= i) aux_shapes.resize(i + 1);
+      Reserve(&aux_handles.at(i), shape.Size() * mshadow::mshadow_sizeof(aux_types[i]));
+      aux_shapes[i] = shape;
+    }
     /*! \brief destructor */
     ~Chunk() {
+      std::vector<Storage::Handle> aux = aux_handles;
       if (static_data || delay_alloc) {
-        Engine::Get()->DeleteVariable([](RunContext s) {}, shandle.ctx, var);
+        // a view keeps the memory of its base until its operations are done
+        std::shared_ptr<Chunk> b = base;
+        std::shared_ptr<void> m = holder;
+        Engine::Get()->DeleteVariable([b, m, aux](RunContext s) {
+            for (const auto& h : aux) {
+              if (h.dptr != nullptr) Storage::Get()->Free(h);
+            }
+          }, shandle.ctx, var);
       } else {
         Storage::Handle h = this->shandle;
-        Engine::Get()->DeleteVariable([h](RunContext s) {
+        Engine::Get()->DeleteVariable([h, aux](RunContext s) {
             Storage::Get()->Free(h);
+            for (const auto& a : aux) {
+              if (a.dptr != nullptr) Storage::Get()->Free(a);
+            }
           }, shandle.ctx, var);
       }
     }
   };
 
+  /*!
+   * \brief the variable of the slice [begin, end) of the bytes of the chunk,
+   *  nullptr when the slice uses the variable of the chunk: the whole chunk,
+   *  a range that overlaps the range of a live slice, or an engine that does
+   *  not track the parts of variables.
+   */
+  std::shared_ptr<SliceVar> GetSliceVar(size_t begin, size_t end) const;
+  /*! \brief the storage shape of a sparse array with these aux shapes */
+  static TShape StorageShape(NDArrayStorageType stype, const TShape &shape,
+                             const std::vector<TShape> &aux_shapes);
+
   void SetTBlob() const {
     tblob_.dptr_ = static_cast<char*>(ptr_->shandle.dptr) + byte_offset_;
-    tblob_.shape_ = shape_;
+    tblob_.shape_ = ptr_->storage_type == kDefaultStorage ? shape_ : ptr_->storage_shape;
     tblob_.type_flag_ = dtype_;
     tblob_.SetDLTensor(ptr_->shandle.ctx.dev_mask(), ptr_->shandle.ctx.dev_id);
 #if MKL_EXPERIMENTAL == 1
@@ -439,6 +795,8 @@ class NDArray {
 #endif
   /*! \brief internal data of NDArray */
   std::shared_ptr<Chunk> ptr_;
+  /*! \brief the variable of a slice, used instead of the chunk's */
+  std::shared_ptr<SliceVar> slice_var_;
   /*! \brief shape of current NDArray */
   TShape shape_;
   /*! \brief byte offset in chunk */
@@ -226,6 +226,30 @@ using FCompute = std::function<void (const nnvm::NodeAttrs& attrs,
                                      const std::vector<TBlob>& inputs,
                                      const std::vector<OpReqType>& req,
                                      const std::vector<TBlob>& outputs)>;
+/*!
+ * \brief Resiger an NDArray compute function for simple stateless forward
+ *  only operator, which handles the sparse storage types of its arrays.
+ *  Without it, the sparse inputs of an operator are cast to dense arrays
+ *  for its FCompute.
+ *
+ * \note Register under "FComputeEx<cpu>" and "FComputeEx<gpu>"
+ */
+using FComputeEx = std::function<void (const nnvm::NodeAttrs& attrs,
+                                       const OpContext& ctx,
+                                       const std::vector<NDArray>& inputs,
+                                       const std::vector<OpReqType>& req,
+                                       const std::vector<NDArray>& outputs)>;
+/*!
+ * \brief Infer the storage types of the outputs of an operator from the
+ *  storage types of its inputs, an NDArrayStorageType each, on the device
+ *  of dev_mask. The outputs are dense without it.
+ *
+ * \note Register under "FInferStorageType"
+ */
+using FInferStorageType = std::function<bool (const NodeAttrs& attrs,
+                                              const int dev_mask,
+                                              std::vector<int>* in_attrs,
+                                              std::vector<int>* out_attrs)>;
 }  // namespace mxnet
 
 #endif  // MXNET_OP_ATTR_TYPES_H_
@@ -0,0 +1,138 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file random_generator.h
+ * \brief the counter-based random numbers of the kParallelRandom resource
+ *
+ * The numbers are the Philox4x32-10 generator of Salmon et al., "Parallel
+ * random numbers: as easy as 1, 2, 3", of a counter made of the number of
+ * the kernel launch, the element and the number of the draw in the element.
+ * The elements of a kernel draw their numbers in parallel, on any device and
+ * any number of threads, and the numbers only depend on the seed.
+ */
+#ifndef MXNET_RANDOM_GENERATOR_H_
+#define MXNET_RANDOM_GENERATOR_H_
+
+#include <mshadow/base.h>
+#include <cmath>
+#include <cstdint>
+
+namespace mxnet {
+namespace common {
+namespace random {
+
+/*! \brief the key and the launch number the elements of a kernel launch draw with */
+struct PhiloxCall {
+  uint32_t key[2];
+  uint32_t call[2];
+};
+
+/*! \brief replaces ctr by the Philox4x32-10 of ctr with the key */
+MSHADOW_XINLINE void Philox4x32(uint32_t key0, uint32_t key1, uint32_t ctr[4]) {
+  for (int r = 0; r < 10; ++r) {
+    if (r > 0) {
+      key0 += 0x9E3779B9u;
+      key1 += 0xBB67AE85u;
+    }
+    const uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * ctr[0];
+    const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * ctr[2];
+    const uint32_t c1 = ctr[1], c3 = ctr[3];
+    ctr[0] = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ key0;
+    ctr[1] = static_cast<uint32_t>(p1);
+    ctr[2] = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ key1;
+    ctr[3] = static_cast<uint32_t>(p0);
+  }
+}
+
+/*! \brief the numbers an element of a kernel launch draws */
+class PhiloxGenerator {
+ public:
+  MSHADOW_XINLINE PhiloxGenerator(const PhiloxCall& call, uint32_t index)
+      : key0_(call.key[0]), key1_(call.key[1]), call0_(call.call[0]), call1_(call.call[1]),
+        index_(index), block_(0), pos_(4), has_normal_(false) {}
+  /*! \brief the next 32 random bits */
+  MSHADOW_XINLINE uint32_t Rand() {
+    if (pos_ == 4) {
+      out_[0] = block_++;
+      out_[1] = index_;
+      out_[2] = call0_;
+      out_[3] = call1_;
+      Philox4x32(key0_, key1_, out_);
+      pos_ = 0;
+    }
+    return out_[pos_++];
+  }
+  /*! \brief uniform in (0, 1] */
+  MSHADOW_XINLINE float Uniform() {
+    return static_cast<float>((Rand() >> 8) + 1) * (1.0f / 16777216.0f);
+  }
+  /*! \brief standard normal, two at a time by Box-Muller */
+  MSHADOW_XINLINE float Normal() {
+    if (has_normal_) {
+      has_normal_ = false;
+      return normal_;
+    }
+    const float r = sqrtf(-2.0f * logf(Uniform()));
+    const float t = 6.283185307179586f * Uniform();
+    normal_ = r * sinf(t);
+    has_normal_ = true;
+    return r * cosf(t);
+  }
+
+ private:
+  uint32_t key0_, key1_, call0_, call1_, index_, block_;
+  uint32_t out_[4];
+  int pos_;
+  bool has_normal_;
+  float normal_;
+};
+
+/*!
+ * \brief the state of a kParallelRandom resource: its seed and the number
+ *  of launches that drew from it, on the host for every device
+ */
+class ParallelRandom {
+ public:
+  explicit ParallelRandom(uint64_t seed) { Seed(seed); }
+  /*! \brief restarts the launches from seed */
+  void Seed(uint64_t seed) {
+    seed_ = seed;
+    calls_ = 0;
+  }
+  /*! \brief the PhiloxCall of the next kernel launch */
+  PhiloxCall Next() {
+    PhiloxCall c;
+    c.key[0] = static_cast<uint32_t>(seed_);
+    c.key[1] = static_cast<uint32_t>(seed_ >> 32);
+    c.call[0] = static_cast<uint32_t>(calls_);
+    c.call[1] = static_cast<uint32_t>(calls_ >> 32);
+    ++calls_;
+    return c;
+  }
+
+ private:
+  uint64_t seed_;
+  uint64_t calls_;
+};
+
+}  // namespace random
+}  // namespace common
+}  // namespace mxnet
+#endif  // MXNET_RANDOM_GENERATOR_H_
@@ -27,6 +27,7 @@
 #include <dmlc/logging.h>
 #include "./base.h"
 #include "./engine.h"
+#include "./random_generator.h"
 
 namespace mxnet {
 
@@ -39,7 +40,9 @@ struct ResourceRequest {
     /*! \brief mshadow::Random<xpu> object */
     kRandom,
     /*! \brief A dynamic temp space that can be arbitrary size */
-    kTempSpace
+    kTempSpace,
+    /*! \brief common::random::ParallelRandom object, whose draws kernels make in parallel */
+    kParallelRandom
   };
   /*! \brief type of resources */
   Type type;
@@ -88,6 +91,16 @@ struct Resource {
     ret->set_stream(stream);
     return ret;
   }
+  /*!
+   * \brief Get the counter-based random number generator.
+   *  Each kernel launch takes the PhiloxCall of Next(), by value, and each
+   *  of its elements draws by a common::random::PhiloxGenerator of it.
+   * \return the generator of the device of the resource.
+   */
+  inline common::random::ParallelRandom* get_parallel_random() const {
+    CHECK_EQ(req.type, ResourceRequest::kParallelRandom);
+    return static_cast<common::random::ParallelRandom*>(ptr_);
+  }
   /*!
    * \brief Get space requested as mshadow Tensor.
    *  The caller can request arbitrary size.
@@ -50,6 +50,39 @@ class Storage {
      * \brief Context information about device and ID.
      */
     Context ctx;
+    /*!
+     * \brief The id of the process which allocated the memory of a
+     *  Context::kCPUShared handle, -1 for the other contexts.
+     */
+    int shared_pid{-1};
+    /*!
+     * \brief The id of the shared memory in the process shared_pid, -1 for
+     *  the other contexts.
+     */
+    int shared_id{-1};
+  };
+  /*!
+   * \brief Allocation statistics of one context.
+   *  The pool hit rate is num_pool_hits / num_allocs, and the fragmentation
+   *  of the pool is 1 - largest_pooled_block / bytes_pooled.
+   */
+  struct Stats {
+    /*! \brief bytes held by live handles, as requested by the callers */
+    size_t bytes_in_use = 0;
+    /*! \brief highest value bytes_in_use has reached */
+    size_t peak_bytes_in_use = 0;
+    /*! \brief bytes obtained from the device, including pooled blocks */
+    size_t bytes_reserved = 0;
+    /*! \brief highest value bytes_reserved has reached */
+    size_t peak_bytes_reserved = 0;
+    /*! \brief free bytes cached by the memory pool */
+    size_t bytes_pooled = 0;
+    /*! \brief size of the largest free block cached by the memory pool */
+    size_t largest_pooled_block = 0;
+    /*! \brief number of allocations */
+    size_t num_allocs = 0;
+    /*! \brief number of allocations served from the memory pool */
+    size_t num_pool_hits = 0;
   };
   /*!
    * \brief Allocate a new contiguous memory for a given size.
@@ -73,6 +106,28 @@ class Storage {
    * \param handle Handle struct.
    */
   virtual void DirectFree(Handle handle) = 0;
+  /*!
+   * \brief Get the allocation statistics of a context.
+   * \param ctx Context information about the device and ID.
+   * \return The statistics, all zero if nothing was allocated on ctx.
+   */
+  virtual Stats GetStats(Context ctx) = 0;
+  /*!
+   * \brief Map the shared memory allocated on Context::kCPUShared by any
+   *  process. The handle takes over the reference which
+   *  SharedIncrementRefCount added for it, and Free releases it.
+   * \param shared_pid The id of the process which allocated the memory.
+   * \param shared_id The id of the memory in that process.
+   * \return Handle struct, of the size of the allocation.
+   */
+  virtual Handle SharedAttach(int shared_pid, int shared_id) = 0;
+  /*!
+   * \brief Add a reference to the shared memory of a Context::kCPUShared
+   *  handle, for a handle another process attaches. The memory is removed
+   *  when its last reference is freed.
+   * \param handle Handle struct.
+   */
+  virtual void SharedIncrementRefCount(Handle handle) = 0;
   /*!
    * \brief Destructor.
    */
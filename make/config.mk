@@ -33,6 +33,9 @@ DEBUG = 0
 # whether compiler with profiler
 USE_PROFILER =
 
+# whether the profiled operators are also nvtx ranges, for nvprof and Nsight
+USE_NVTX = 0
+
 # the additional link flags you want to add
 ADD_LDFLAGS =
 
@@ -57,6 +60,18 @@ USE_CUDNN = 0
 # whether use cuda runtime compiling for writing kernels in native language (i.e. Python)
 USE_NVRTC = 0
 
+# whether use NCCL for the reduction between the GPUs of the nccl kvstore
+USE_NCCL = 0
+# add the path to NCCL library to link and compile flag
+# if you have already add them to environment variable, leave it as NONE
+USE_NCCL_PATH = NONE
+
+# whether use nvJPEG for the gpu_decode option of ImageRecordIter
+USE_NVJPEG = 0
+# add the path to nvJPEG library to link and compile flag
+# if you have already add them to environment variable, leave it as NONE
+USE_NVJPEG_PATH = NONE
+
 # whether use opencv during compilation
 # you can disable it, however, you will not able to use
 # imbin iterator
@@ -130,6 +145,10 @@ endif
 # whether or not to enable multi-machine supporting
 USE_DIST_KVSTORE = 0
 
+# whether or not to build ps-lite with the RDMA (ibverbs) transport, selected at
+# run time with DMLC_PS_VAN_TYPE=ibverbs. libibverbs and librdmacm are required
+USE_IBVERBS = 0
+
 # whether or not allow to read and write HDFS directly. If yes, then hadoop is
 # required
 USE_HDFS = 0
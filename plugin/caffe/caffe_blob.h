@@ -50,6 +50,12 @@ void SetDataGradToBlob(caffeMemoryTypes memType,
 /**
  * \brief The interface to convert mxnet's tensor to caffe's blob
  * \brief called in caffe_operator_inl.h
+ *
+ * The blob aliases the memory of the tensor, and its head is set on Device:
+ * mxnet may have written the memory since the last call, so a copy caffe
+ * made on the other device is stale, and caffe reads the tensor itself
+ * without a transfer. Call it on every forward and backward, the tensors
+ * can move between calls.
  */
 template<typename Device, typename Dtype>
 void TBlob2CaffeBlob(caffeMemoryTypes memType,
@@ -57,7 +63,8 @@ void TBlob2CaffeBlob(caffeMemoryTypes memType,
                      typename std::vector<TBlob>::const_iterator tblob,
                      int n = 1) {
   for (int i = 0; i < n; ++i, ++blob, ++tblob) {
-    (*blob)->Reshape(TShape2Vector((*tblob).shape_));
+    std::vector<int> shape = TShape2Vector((*tblob).shape_);
+    if ((*blob)->shape() != shape) (*blob)->Reshape(shape);
     SetDataGradToBlob<Device, Dtype>(memType, blob, tblob);
   }
 }
@@ -164,6 +164,16 @@ class CaffeLoss : public Operator {
           << "Must init CuBLAS handle in stream";
 #endif  // __CUDACC__
 
+    // The data are set before the gradients: a blob whose data change size
+    // drops its gradient
+    caffe::TBlob2CaffeBlob<xpu, Dtype>(caffe::Data,
+                                      bot_.begin(),
+                                      in_data.begin(),
+                                      param_.num_data);
+    caffe::TBlob2CaffeBlob<xpu, Dtype>(caffe::Data,
+                                      top_.begin(),
+                                      out_data.begin(),
+                                      param_.num_out);
     caffe::TBlob2CaffeBlob<xpu, Dtype>(caffe::Grad,
                                       bot_.begin(),
                                       in_grad.begin(),
@@ -69,7 +69,6 @@ class CaffeOp : public Operator {
  public:
   explicit CaffeOp(CaffeOpParam p):param_(p),
                                    init_w_(false),
-                                   init_wd_(false),
                                    setup_(false) {
     std::string type = param_.prototxt.type();
     caffeOp_ = caffe::LayerRegistry<Dtype>::CreateLayer(param_.prototxt);
@@ -119,13 +118,13 @@ class CaffeOp : public Operator {
                                        out_data.begin(),
                                        param_.num_out);
     CaffeOpSetup();
-    // Init caffe's weight pointer
+    // Point caffe's weights to the weight arrays of this call
+    caffe::TBlob2CaffeBlob<xpu, Dtype>(caffe::Data,
+                                       wei_.begin(),
+                                       in_data.begin() + param_.num_data,
+                                       param_.num_weight);
     if (!init_w_) {
       init_w_ = true;
-      caffe::TBlob2CaffeBlob<xpu, Dtype>(caffe::Data,
-                                         wei_.begin(),
-                                         in_data.begin() + param_.num_data,
-                                         param_.num_weight);
       caffe::SetOpBlobs(caffeOp_, wei_);
     }
     if (ctx.is_train)
@@ -177,6 +176,20 @@ class CaffeOp : public Operator {
           << "Must init CuBLAS handle in stream";
 #endif  // __CUDACC__
 
+    // The data are set before the gradients: a blob whose data change size
+    // drops its gradient
+    caffe::TBlob2CaffeBlob<xpu, Dtype>(caffe::Data,
+                                       bot_.begin(),
+                                       in_data.begin(),
+                                       param_.num_data);
+    caffe::TBlob2CaffeBlob<xpu, Dtype>(caffe::Data,
+                                       top_.begin(),
+                                       out_data.begin(),
+                                       param_.num_out);
+    caffe::TBlob2CaffeBlob<xpu, Dtype>(caffe::Data,
+                                       wei_.begin(),
+                                       in_data.begin() + param_.num_data,
+                                       param_.num_weight);
     caffe::TBlob2CaffeBlob<xpu, Dtype>(caffe::Grad,
                                        bot_.begin(),
                                        in_grad.begin(),
@@ -185,15 +198,10 @@ class CaffeOp : public Operator {
                                        top_.begin(),
                                        out_grad.begin(),
                                        param_.num_out);
-
-    // Init caffe's gradient pointer
-    if (!init_wd_) {
-      init_wd_ = true;
-      caffe::TBlob2CaffeBlob<xpu, Dtype>(caffe::Grad,
-                                         wei_.begin(),
-                                         in_grad.begin() + param_.num_data,
-                                         param_.num_weight);
-    }
+    caffe::TBlob2CaffeBlob<xpu, Dtype>(caffe::Grad,
+                                       wei_.begin(),
+                                       in_grad.begin() + param_.num_data,
+                                       param_.num_weight);
 
     // Handle OpReqType of weights
     for (int i = param_.num_data; i < expected_num_data; ++i)
@@ -226,7 +234,7 @@ class CaffeOp : public Operator {
   ::caffe::Layer<Dtype> *caffeOp_;
   std::vector< ::caffe::Blob<Dtype> *> bot_, top_, wei_;
   std::vector<bool> flags_;
-  bool init_w_, init_wd_, setup_;
+  bool init_w_, setup_;
 };  // class CaffeOp
 
 // Decalre Factory function, used for dispatch specialization
@@ -29,8 +29,12 @@
 #include <dmlc/omp.h>
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
+#include <dmlc/threadediter.h>
+#include <algorithm>
+#include <queue>
 #include <string>
 #include <memory>
+#include <vector>
 #include <unity/lib/image_util.hpp>
 #include <unity/lib/gl_sframe.hpp>
 #include <unity/lib/gl_sarray.hpp>
@@ -65,6 +69,15 @@ struct SFrameParam : public dmlc::Parameter<SFrameParam> {
   }
 };  // struct SFrameImageParam
 
+struct SFrameColumnParam : public dmlc::Parameter<SFrameColumnParam> {
+  /*! \brief the number of threads reading the blocks of a batch */
+  int preprocess_threads;
+  DMLC_DECLARE_PARAMETER(SFrameColumnParam) {
+    DMLC_DECLARE_FIELD(preprocess_threads).set_lower_bound(1).set_default(4)
+    .describe("Backend Param: the number of threads reading the column blocks of a batch.");
+  }
+};  // struct SFrameColumnParam
+
 class SFrameIterBase : public IIterator<DataInst> {
  public:
   SFrameIterBase() {}
@@ -210,7 +223,170 @@ class SFrameDataIter : public SFrameIterBase {
   typedef SFrameIterBase Parent;
 };  // class SFrameDataIter
 
+/*!
+ * \brief Reads the batches column by column: each column of a batch is split
+ *  into row blocks, read in parallel by range iterators straight into the
+ *  pinned arrays of the batch slots of the prefetch queue, without a copy
+ *  into instances or a batch loader. The columns are read from disk, so the
+ *  frame does not have to fit in memory. The last batch of an epoch is filled
+ *  from the first rows and has num_batch_padd rows of padding.
+ *  Other columnar formats could be read the same way, through a reader of
+ *  the row range of a column.
+ */
+class SFrameColumnIter : public IIterator<DataBatch> {
+ public:
+  SFrameColumnIter() : out_(nullptr) {}
+
+  virtual ~SFrameColumnIter() {
+    iter_.Destroy();
+  }
+
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.InitAllowUnknown(kwargs);
+    batch_param_.InitAllowUnknown(kwargs);
+    column_param_.InitAllowUnknown(kwargs);
+    prefetch_param_.InitAllowUnknown(kwargs);
+    device_ = DeviceBatchAhead(prefetch_param_.copy_to_gpu);
+    graphlab::gl_sframe sframe(param_.path_sframe);
+    num_rows_ = sframe.size();
+    CHECK_GT(num_rows_, 0U) << "empty sframe " << param_.path_sframe;
+    columns_ = {sframe[param_.data_field], sframe[param_.label_field]};
+    widths_ = {param_.data_shape.Size(), param_.label_shape.Size()};
+    index_t batch_size = batch_param_.batch_size;
+    std::vector<index_t> data_shape(1, batch_size), label_shape(1, batch_size);
+    data_shape.insert(data_shape.end(), param_.data_shape.begin(), param_.data_shape.end());
+    if (param_.label_shape.Size() != 1) {
+      label_shape.insert(label_shape.end(), param_.label_shape.begin(),
+                         param_.label_shape.end());
+    }
+    shapes_ = {TShape(data_shape.begin(), data_shape.end()),
+               TShape(label_shape.begin(), label_shape.end())};
+    // maximum prefetch threaded iter internal size
+    const int kMaxPrefetchBuffer = 16;
+    iter_.set_max_capacity(kMaxPrefetchBuffer);
+    iter_.Init([this](DataBatch **dptr) {
+        if (*dptr == nullptr) {
+          *dptr = new DataBatch();
+          for (const TShape& shape : shapes_) {
+            // pinned, for the copies to the gpus to be asynchronous
+            (*dptr)->data.push_back(NDArray(shape, Context::CPUPinned(0), false));
+          }
+        }
+        if (!ReadBatch(*dptr)) return false;
+        queue_.Produced();
+        return true;
+      },
+      [this]() { row_ = 0; });
+  }
+
+  void BeforeFirst() override {
+    iter_.BeforeFirst();
+    queue_.BeforeFirst();
+    device_.BeforeFirst();
+  }
+
+  bool Next() override {
+    if (device_.enabled()) {
+      return device_.Next([this]() { return NextHost() ? out_ : nullptr; });
+    }
+    return NextHost();
+  }
+
+  const DataBatch &Value() const override {
+    return device_.enabled() ? device_.Value() : *out_;
+  }
+
+  void GetStats(IterStatList* stats) const override {
+    queue_.Append(prefetch_param_.prefetch_buffer, stats);
+  }
+
+ private:
+  inline bool NextHost() {
+    if (out_ != nullptr) {
+      recycle_queue_.push(out_); out_ = nullptr;
+    }
+    if (recycle_queue_.size() == prefetch_param_.prefetch_buffer) {
+      DataBatch *old_batch = recycle_queue_.front();
+      for (NDArray& arr : old_batch->data) {
+        arr.WaitToWrite();
+      }
+      recycle_queue_.pop();
+      iter_.Recycle(&old_batch);
+    }
+    return queue_.Next([this]() { return iter_.Next(&out_); });
+  }
+
+  /*! \brief read the batch starting at row_ into the arrays of batch */
+  bool ReadBatch(DataBatch* batch) {
+    if (row_ >= num_rows_) return false;
+    const size_t batch_size = batch_param_.batch_size;
+    const size_t nthread = column_param_.preprocess_threads;
+    const size_t block = (batch_size + nthread - 1) / nthread;
+    const size_t nblock = (batch_size + block - 1) / block;
+    const int ntask = static_cast<int>(nblock * columns_.size());
+    std::vector<real_t*> dptrs;
+    for (NDArray& arr : batch->data) dptrs.push_back(arr.data().dptr<real_t>());
+    #pragma omp parallel for num_threads(nthread) schedule(static, 1)
+    for (int task = 0; task < ntask; ++task) {
+      size_t c = task / nblock, begin = task % nblock * block;
+      size_t count = std::min(block, batch_size - begin);
+      ReadRows(c, row_ + begin, count, dptrs[c] + begin * widths_[c]);
+    }
+    batch->num_batch_padd = std::max(row_ + batch_size, num_rows_) - num_rows_;
+    batch->index.resize(batch_size);
+    for (size_t i = 0; i < batch_size; ++i) batch->index[i] = (row_ + i) % num_rows_;
+    row_ += batch_size;
+    return true;
+  }
+
+  /*! \brief read count rows of column c from row first, wrapping around the end */
+  void ReadRows(size_t c, size_t first, size_t count, real_t* dst) const {
+    const size_t width = widths_[c];
+    while (count > 0) {
+      size_t begin = first % num_rows_, end = std::min(begin + count, num_rows_);
+      graphlab::gl_sarray_range range = columns_[c].range_iterator(begin, end);
+      for (auto it = range.begin(); it != range.end(); ++it) {
+        const graphlab::flexible_type& value = *it;
+        if (value.get_type() == graphlab::flex_type_enum::VECTOR) {
+          const graphlab::flex_vec& vec = value.get<graphlab::flex_vec>();
+          CHECK_EQ(vec.size(), width) << "the shape of column " << c << " does not match";
+          std::copy(vec.begin(), vec.end(), dst);
+        } else {
+          CHECK_EQ(width, 1U) << "the shape of column " << c << " does not match";
+          dst[0] = static_cast<real_t>(value.to<graphlab::flex_float>());
+        }
+        dst += width;
+      }
+      count -= end - begin;
+      first += end - begin;
+    }
+  }
+
+  SFrameParam param_;
+  BatchParam batch_param_;
+  SFrameColumnParam column_param_;
+  PrefetcherParam prefetch_param_;
+  /*! \brief the data and the label columns, their number of values per row and batch shapes */
+  std::vector<graphlab::gl_sarray> columns_;
+  std::vector<size_t> widths_;
+  std::vector<TShape> shapes_;
+  size_t num_rows_{0};
+  /*! \brief the first row of the next batch, read by the backend thread */
+  size_t row_{0};
+  /*! \brief Backend thread */
+  dmlc::ThreadedIter<DataBatch> iter_;
+  /*! \brief output data */
+  DataBatch *out_;
+  /*! \brief queue to be recycled */
+  std::queue<DataBatch*> recycle_queue_;
+  /*! \brief the batches on the gpu, with copy_to_gpu */
+  DeviceBatchAhead device_;
+  /*! \brief the counters of iter_ */
+  QueueStats queue_;
+};  // class SFrameColumnIter
+
 DMLC_REGISTER_PARAMETER(SFrameParam);
+DMLC_REGISTER_PARAMETER(SFrameColumnParam);
 
 MXNET_REGISTER_IO_ITER(SFrameImageIter)
 .describe("Naive SFrame image iterator prototype")
@@ -237,6 +413,16 @@ MXNET_REGISTER_IO_ITER(SFrameDataIter)
               new SFrameDataIter()));
     });
 
+MXNET_REGISTER_IO_ITER(SFrameColumnIter)
+.describe("SFrame data iterator reading the column blocks of the batches in parallel")
+.add_arguments(SFrameParam::__FIELDS__())
+.add_arguments(SFrameColumnParam::__FIELDS__())
+.add_arguments(BatchParam::__FIELDS__())
+.add_arguments(PrefetcherParam::__FIELDS__())
+.set_body([]() {
+    return new SFrameColumnIter();
+    });
+
 
 }  // namespace io
 }  // namespace mxnet
@@ -53,14 +53,16 @@ class TorchState {
   static TorchState* ThreadSharedLuaState();
 
 #if MXNET_USE_CUDA
+  /*! \brief the cutorch state, looked up once since every tensor wrap needs it */
   THCState* CudaState() {
+    if (cuda_state_ != nullptr) return cuda_state_;
     lua_getglobal(L, "cutorch");
     CHECK(!lua_isnil(L, -1));
     lua_getfield(L, -1, "_state");
     CHECK(!lua_isnil(L, -1));
-    THCState* state = reinterpret_cast<THCState*>(lua_touserdata(L, -1));
+    cuda_state_ = reinterpret_cast<THCState*>(lua_touserdata(L, -1));
     lua_pop(L, 2);
-    return state;
+    return cuda_state_;
   }
 #endif  // MXNET_USE_CUDA
 
@@ -111,6 +113,12 @@ class TorchState {
     lua_pop(L, 2);
     return 0;
   }
+
+#if MXNET_USE_CUDA
+
+ private:
+  THCState* cuda_state_{nullptr};
+#endif  // MXNET_USE_CUDA
 };
 
 typedef void* THGeneralTensor;
@@ -150,6 +158,15 @@ class TorchTensor {
     return TensorType(data.dev_mask());
   }
 
+  /*!
+   * \brief make a storage that wraps MXNet memory alias it strictly: Torch neither
+   *  frees it nor reallocates it on a resize, which fails instead
+   */
+  static void AliasStorage(THFloatStorage* storage) {
+    THFloatStorage_clearFlag(storage, TH_STORAGE_FREEMEM);
+    THFloatStorage_clearFlag(storage, TH_STORAGE_RESIZABLE);
+  }
+
   static THGeneralTensor TBlobToTHTensor(TorchState* torchState, TBlob data) {
     size_t size = data.Size();
     THGeneralTensor tensor = NULL;
@@ -162,7 +179,7 @@ class TorchTensor {
       case cpu::kDevMask: {
         THFloatStorage* storage = THFloatStorage_newWithData(static_cast<real_t*>(data.dptr_),
                                                              size);
-        THFloatStorage_clearFlag(storage, TH_STORAGE_FREEMEM);
+        AliasStorage(storage);
         tensor = (THGeneralTensor)THFloatTensor_newWithStorage(storage, 0, thshape, NULL);
         THFloatStorage_free(storage);
         break;
@@ -173,7 +190,7 @@ class TorchTensor {
         THCudaStorage* storage = THCudaStorage_newWithData(state, static_cast<real_t*>(data.dptr_),
                                                            size);
         // a bug in cutorch
-        THFloatStorage_clearFlag(reinterpret_cast<THFloatStorage*>(storage), TH_STORAGE_FREEMEM);
+        AliasStorage(reinterpret_cast<THFloatStorage*>(storage));
         tensor = (THGeneralTensor)THCudaTensor_newWithStorage(state, storage, 0, thshape, NULL);
         THCudaStorage_free(state, storage);
         break;
@@ -187,18 +204,24 @@ class TorchTensor {
     return tensor;
   }
 
+  /*!
+   * \brief free the storage Torch allocated for tensor, which SetInternal later
+   *  points at MXNet memory
+   */
   static void FreeInternal(TorchState* torchState, THGeneralTensor tensor, int dev_mask) {
     switch (dev_mask) {
       case cpu::kDevMask: {
         THFloatStorage* original = static_cast<THFloatTensor*>(tensor)->storage;
-        THFloatStorage_free(original);
+        if (original != NULL) THFloatStorage_free(original);
+        static_cast<THFloatTensor*>(tensor)->storage = NULL;
         break;
       }
 #if MXNET_USE_CUDA
       case gpu::kDevMask: {
         THCState* state = torchState->CudaState();
         THCudaStorage* original = static_cast<THCudaTensor*>(tensor)->storage;
-        THCudaStorage_free(state, original);
+        if (original != NULL) THCudaStorage_free(state, original);
+        static_cast<THCudaTensor*>(tensor)->storage = NULL;
         break;
       }
 #endif
@@ -207,29 +230,51 @@ class TorchTensor {
     }
   }
 
+  /*!
+   * \brief point tensor, a parameter or a gradient of a module, at the memory
+   *  of blob; the tensor keeps its shape, which must cover blob contiguously
+   */
   static void SetInternal(TorchState* torchState, THGeneralTensor tensor, const TBlob& blob) {
     size_t size = blob.Size();
     switch (blob.dev_mask()) {
       case cpu::kDevMask: {
+        THFloatTensor* th = static_cast<THFloatTensor*>(tensor);
+        CHECK_EQ(static_cast<size_t>(THFloatTensor_nElement(th)), size)
+            << "Torch tensor does not match the array";
+        CHECK(THFloatTensor_isContiguous(th)) << "Torch tensor is not contiguous";
+        THFloatStorage* original = th->storage;
+        if (original != NULL && original->data == static_cast<real_t*>(blob.dptr_) &&
+            th->storageOffset == 0) {
+          break;
+        }
         THFloatStorage* storage = THFloatStorage_newWithData(static_cast<real_t*>(blob.dptr_),
                                                              size);
-        THFloatStorage_clearFlag(storage, TH_STORAGE_FREEMEM);
-        THFloatStorage* original = static_cast<THFloatTensor*>(tensor)->storage;
-        static_cast<THFloatTensor*>(tensor)->storage = storage;
-        THFloatStorage_free(original);
+        AliasStorage(storage);
+        th->storage = storage;
+        th->storageOffset = 0;
+        if (original != NULL) THFloatStorage_free(original);
         break;
       }
 #if MXNET_USE_CUDA
       case gpu::kDevMask: {
         THCState* state = torchState->CudaState();
+        THCudaTensor* th = static_cast<THCudaTensor*>(tensor);
+        CHECK_EQ(static_cast<size_t>(THCudaTensor_nElement(state, th)), size)
+            << "Torch tensor does not match the array";
+        CHECK(THCudaTensor_isContiguous(state, th)) << "Torch tensor is not contiguous";
+        THCudaStorage* original = th->storage;
+        if (original != NULL && original->data == static_cast<real_t*>(blob.dptr_) &&
+            th->storageOffset == 0) {
+          break;
+        }
         THCudaStorage* storage = THCudaStorage_newWithData(state,
                                                            static_cast<real_t*>(blob.dptr_),
                                                            size);
         // TODO(min): torch bug Cuda version not implemented
-        THFloatStorage_clearFlag(reinterpret_cast<THFloatStorage*>(storage), TH_STORAGE_FREEMEM);
-        THCudaStorage* original = static_cast<THCudaTensor*>(tensor)->storage;
-        static_cast<THCudaTensor*>(tensor)->storage = storage;
-        THCudaStorage_free(state, original);
+        AliasStorage(reinterpret_cast<THFloatStorage*>(storage));
+        th->storage = storage;
+        th->storageOffset = 0;
+        if (original != NULL) THCudaStorage_free(state, original);
         break;
       }
 #endif
@@ -264,13 +309,18 @@ class TorchTensor {
     return res;
   }
 
+  /*!
+   * \brief copy the tensor on top of the lua stack into th_dst, unless the
+   *  module wrote its result in place into the memory of dst
+   */
   static void CopyIfDifferent(TorchState* torchState, TBlob dst, THGeneralTensor th_dst) {
     lua_State* L = torchState->L;
     if (luaT_isudata(L, -1, TorchTensor::TensorType(cpu::kDevMask))) {
       CHECK_EQ(dst.dev_mask(), cpu::kDevMask) << "Device type mismatch.";
       THFloatTensor* src = static_cast<THFloatTensor*>(
         luaT_toudata(L, -1, TorchTensor::TensorType(cpu::kDevMask)));
-      if (src->storage != static_cast<THFloatTensor*>(th_dst)->storage) {
+      if (src->storage == NULL || THFloatTensor_data(src) != dst.dptr_ ||
+          !THFloatTensor_isContiguous(src)) {
         THFloatTensor_copy(static_cast<THFloatTensor*>(th_dst), src);
       }
 #if MXNET_USE_CUDA
@@ -278,8 +328,10 @@ class TorchTensor {
       CHECK_EQ(dst.dev_mask(), gpu::kDevMask) << "Device type mismatch.";
       THCudaTensor* src = static_cast<THCudaTensor*>(
         luaT_toudata(L, -1, TorchTensor::TensorType(gpu::kDevMask)));
-      if (src->storage != static_cast<THCudaTensor*>(th_dst)->storage) {
-        THCudaTensor_copy(torchState->CudaState(), static_cast<THCudaTensor*>(th_dst), src);
+      THCState* state = torchState->CudaState();
+      if (src->storage == NULL || THCudaTensor_data(state, src) != dst.dptr_ ||
+          !THCudaTensor_isContiguous(state, src)) {
+        THCudaTensor_copy(state, static_cast<THCudaTensor*>(th_dst), src);
       }
 #endif  // MXNET_USE_CUDA
     } else {
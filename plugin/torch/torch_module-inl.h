@@ -90,22 +90,26 @@ class TorchModuleOp : public Operator {
       lua_pop(L, 2);
     }
     CHECK_EQ(param_num, param_.num_params);
-    // Free the parameters allocated by torch so it doesn't take up memory.
+    // Free the parameters and their gradients allocated by torch so they don't
+    // take up memory, the arrays of MXNet are aliased in their place.
     if (param_.num_params != 0) {
-      // get the parameters into the stack
+      // get the parameters and the gradients into the stack
       lua_getfield(L, -1, "parameters");
       lua_pushvalue(L, -2);
-      int err = lua_pcall(L, 1, 1, 0);
+      int err = lua_pcall(L, 1, 2, 0);
       CHECK_EQ(err, 0);
-      // iterate the parameters table to free tblobs inside
-      lua_pushnil(L);
-      while (lua_next(L, -2)) {
-        CHECK(luaT_isudata(L, -1, TorchTensor::TensorType(xpu::kDevMask)));
-        void* udata = luaT_toudata(L, -1, TorchTensor::TensorType(xpu::kDevMask));
-        TorchTensor::FreeInternal(torchState_, static_cast<THGeneralTensor>(udata), xpu::kDevMask);
-        lua_pop(L, 1);
+      // iterate the two tables to free tblobs inside
+      for (int table = -2; table <= -1; ++table) {
+        lua_pushnil(L);
+        while (lua_next(L, table - 1)) {
+          CHECK(luaT_isudata(L, -1, TorchTensor::TensorType(xpu::kDevMask)));
+          void* udata = luaT_toudata(L, -1, TorchTensor::TensorType(xpu::kDevMask));
+          TorchTensor::FreeInternal(torchState_, static_cast<THGeneralTensor>(udata),
+                                    xpu::kDevMask);
+          lua_pop(L, 1);
+        }
       }
-      lua_pop(L, 1);  // pop the parameter table
+      lua_pop(L, 2);  // pop the parameter and the gradient tables
     }
     this->lua_reference_ = luaL_ref(L, LUA_REGISTRYINDEX);
   }
@@ -219,9 +223,14 @@ class TorchModuleOp : public Operator {
       }
       lua_pop(L, 2);  // pop the parameters
     }
-    lua_getfield(L, -1, "zeroGradParameters");
-    lua_pushvalue(L, -2);
-    CHECK_EQ(lua_pcall(L, 1, 0, 0), 0);
+    // accGradParameters accumulates into the aliased gradients, so only the
+    // ones written to are cleared, on the stream of the op
+    for (uint32_t i = param_.num_data; i < in_grad.size(); ++i) {
+      if (req[i] == kWriteTo || req[i] == kWriteInplace) {
+        mshadow::Tensor<xpu, 1> grad = in_grad[i].FlatTo1D<xpu, real_t>(s);
+        grad = 0.0f;
+      }
+    }
     TorchTensor::TBlobVectorAsTable(torchState_, in_data.begin(),
                                     in_data.begin() + param_.num_data);
     TorchTensor::TBlobVectorAsTable(torchState_, out_grad.begin(), out_grad.end());
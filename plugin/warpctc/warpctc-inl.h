@@ -42,7 +42,7 @@ namespace mxnet {
 namespace op {
 
 namespace warpctc_enum {
-  enum CTCOpInputs {kData, kLabel};
+  enum CTCOpInputs {kData, kLabel, kInputLength};
   enum CTCOpOutputs {kOut};
   enum CTCTemp {kTmp};
 }  // namespace warpctc_enum
@@ -50,6 +50,7 @@ namespace warpctc_enum {
 struct WarpCTCParam : public dmlc::Parameter<WarpCTCParam> {
   int label_length;
   int input_length;
+  bool use_input_lengths;
   DMLC_DECLARE_PARAMETER(WarpCTCParam) {
     DMLC_DECLARE_FIELD(label_length)
         .set_default(0)
@@ -57,6 +58,11 @@ struct WarpCTCParam : public dmlc::Parameter<WarpCTCParam> {
     DMLC_DECLARE_FIELD(input_length)
         .set_default(0)
         .describe("Input length");
+    DMLC_DECLARE_FIELD(use_input_lengths)
+        .set_default(false)
+        .describe("Whether the lengths of the sequences are given by the input_lengths "
+                  "input, of shape (minibatch,), instead of all being input_length. The "
+                  "frames past the length of a sequence are skipped, and get no gradient.");
   }
 };
 
@@ -64,6 +70,13 @@ template<typename xpu>
 class WarpCTCOp : public Operator {
  private:
   WarpCTCParam param_;
+  /*! \brief the host buffers of the labels and the lengths, kept across the calls */
+  std::vector<int> host_labels_;
+  std::vector<int> host_input_lengths_;
+  std::vector<int> input_lengths_;
+  std::vector<int> labels_;
+  std::vector<int> label_lengths_;
+  std::vector<float> costs_;
 
  public:
   explicit WarpCTCOp(WarpCTCParam p) {
@@ -88,7 +101,8 @@ class WarpCTCOp : public Operator {
                        const std::vector<TBlob> &aux_args) {
     using namespace mshadow;
     using namespace mshadow::expr;
-    CHECK_EQ(in_data.size(), 2) << "CTCOutput Input: [data, label]";
+    CHECK_EQ(in_data.size(), param_.use_input_lengths ? 3 : 2)
+        << "CTCOutput Input: [data, label] or [data, label, input_lengths]";
     CHECK_EQ(out_data.size(), 1) << "CTCOutput Output: [output]";
 
     Stream<xpu> *s = ctx.get_stream<xpu>();
@@ -99,31 +113,35 @@ class WarpCTCOp : public Operator {
     Softmax(out_tensor, data_tensor);
   }
 
-  std::vector<int> labelLengths(const int * flat_labels, int minibatch,
-                                int size, int blank, int * total_length) {
+  /*!
+   * \brief count the labels of each sequence and pack them without the
+   *  blanks into labels_, which warp-ctc reads on the host on any device
+   */
+  void PackLabels(const int * flat_labels, int minibatch, int size, int blank) {
     CHECK_EQ(param_.label_length * minibatch, size)
         << "label size should = label_length * minibatch";
-    std::vector<int> ret(minibatch, 0);
+    label_lengths_.assign(minibatch, 0);
+    labels_.clear();
     for (int i = 0; i < size; i++) {
       if (flat_labels[i] == blank) {
         continue;
       }
-      int b = i / param_.label_length;
-      ret[b]++;
-      (*total_length)++;
+      label_lengths_[i / param_.label_length]++;
+      labels_.push_back(flat_labels[i]);
     }
-    return ret;
   }
 
-  void removeBlank(const int * flat_labels, int * cpu_labels,
-                   int size, int blank) {
-    int k = 0;
-    for (int i = 0; i < size; i++) {
-      if (flat_labels[i] != blank) {
-        cpu_labels[k] = flat_labels[i];
-        k += 1;
-      }
-    }
+  /*!
+   * \brief the int32 values of blob on the host: blob itself on the cpu, else
+   *  a copy into buf on the stream, valid after the stream is waited for
+   */
+  const int* HostInts(const TBlob& blob, mshadow::Stream<xpu> *s, std::vector<int>* buf) {
+    using namespace mshadow;
+    if (blob.dev_mask() == cpu::kDevMask) return blob.dptr<int>();
+    buf->resize(blob.Size());
+    Tensor<cpu, 1, int> dst(buf->data(), Shape1(buf->size()));
+    Copy(dst, blob.get_with_shape<xpu, 1, int>(Shape1(blob.Size()), s), s);
+    return buf->data();
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -155,70 +173,54 @@ class WarpCTCOp : public Operator {
     int T = param_.input_length;
     int minibatch = data.shape_[0] / T;
     int alphabet_size = data.shape_[1];
-    std::vector<int> input_lengths;
-    for (int i = 0; i < minibatch; i++) {
-      input_lengths.push_back(T);
-    }
 
-#if MXNET_USE_CUDA
-    cudaError_t cuda_status;
-#endif
     float* activations = static_cast<float*>(data.dptr_);
-    int* flat_labels = static_cast<int*>(label.dptr_);
-    int* cpu_raw_labels = flat_labels;
     float* grads = static_cast<float*>(in_grad[warpctc_enum::kData].dptr_);
-    if (data.dev_mask() == gpu::kDevMask) {
-#if MXNET_USE_CUDA
-      cpu_raw_labels = reinterpret_cast<int*>(malloc(sizeof(int) * label.Size()));
-      cuda_status = cudaMemcpyAsync(cpu_raw_labels, flat_labels,
-                                    label.Size()*sizeof(int),
-                                    cudaMemcpyDeviceToHost,
-                                    ctx.get_stream<gpu>()->stream_);
-      CHECK_EQ(cuda_status, cudaSuccess) << "cuda memcpy label error";
-#endif
+    // the labels and the lengths are copied to the host together, into
+    // buffers kept across the calls
+    const int* flat_labels = HostInts(label, s, &host_labels_);
+    const int* input_lengths = nullptr;
+    if (param_.use_input_lengths) {
+      input_lengths = HostInts(in_data[warpctc_enum::kInputLength], s, &host_input_lengths_);
+      // warp-ctc does not write the gradients of the frames it skips
+      Tensor<xpu, 2, float> grad = in_grad[warpctc_enum::kData].FlatTo2D<xpu, float>(s);
+      grad = 0.0f;
     }
-
-    int total_label_length = 0;
-    std::vector<int> label_lengths = labelLengths(cpu_raw_labels,
-                                                  minibatch,
-                                                  label.Size(),
-                                                  0, &total_label_length);
-    int* cpu_labels = reinterpret_cast<int*>(
-        malloc(sizeof(int) * total_label_length));
-    removeBlank(cpu_raw_labels, cpu_labels, label.Size(), 0);
+    s->Wait();
+    if (!param_.use_input_lengths) {
+      input_lengths_.assign(minibatch, T);
+      input_lengths = input_lengths_.data();
+    }
+    for (int i = 0; i < minibatch; i++) {
+      CHECK(input_lengths[i] >= 0 && input_lengths[i] <= T)
+          << "the input length of sequence " << i << " is not in [0, " << T << "]";
+    }
+    PackLabels(flat_labels, minibatch, label.Size(), 0);
 
     size_t alloc_bytes;
-    throw_on_error(get_workspace_size(label_lengths.data(),
-                                      input_lengths.data(),
+    throw_on_error(get_workspace_size(label_lengths_.data(),
+                                      input_lengths,
                                       alphabet_size,
-                                      input_lengths.size(), info,
+                                      minibatch, info,
                                       &alloc_bytes),
                    "Error: get_workspace_size in inf_test");
 
+    // the temp space is shared by the operators and grows to the largest request
     Tensor<xpu, 1> ctc_workspace = ctx.requested[warpctc_enum::kTmp].get_space<xpu>(
-        mshadow::Shape1(alloc_bytes), s);
+        mshadow::Shape1((alloc_bytes + sizeof(real_t) - 1) / sizeof(real_t)), s);
 
-    std::vector<float> costs(minibatch);
+    costs_.resize(minibatch);
     throw_on_error(compute_ctc_loss(activations,
                                     grads,
-                                    cpu_labels,
-                                    label_lengths.data(),
-                                    input_lengths.data(),
+                                    labels_.data(),
+                                    label_lengths_.data(),
+                                    input_lengths,
                                     alphabet_size,
                                     minibatch,
-                                    costs.data(),
+                                    costs_.data(),
                                     ctc_workspace.dptr_,
                                     info),
                    "Error: compute_ctc_loss");
-
-    if (data.dev_mask() == cpu::kDevMask) {
-      free(cpu_labels);
-    } else if (data.dev_mask() == gpu::kDevMask) {
-#if MXNET_USE_CUDA
-      free(cpu_raw_labels);
-      free(cpu_labels);
-#endif
-    }
   }
 };
 
@@ -230,6 +232,7 @@ Operator* CreateOp(WarpCTCParam type);
 class WarpCTCProp : public OperatorProperty {
  public:
   std::vector<std::string> ListArguments() const override {
+    if (param_.use_input_lengths) return {"data", "label", "input_lengths"};
     return {"data", "label"};
   }
 
@@ -250,12 +253,16 @@ class WarpCTCProp : public OperatorProperty {
                   std::vector<TShape> *out_shape,
                   std::vector<TShape> *aux_shape) const override {
     using namespace mshadow;
-    CHECK_EQ(in_shape->size(), 2) << "Input:[data, label]";
+    CHECK_EQ(in_shape->size(), ListArguments().size()) << "Input:[data, label]";
     const TShape &dshape = in_shape->at(0);
     if (dshape.ndim() == 0) return false;
     TShape label_shape(dshape.ndim() - 1);
     label_shape[0] = param_.label_length * (dshape[0] / param_.input_length);
     SHAPE_ASSIGN_CHECK(*in_shape, warpctc_enum::kLabel, label_shape);
+    if (param_.use_input_lengths) {
+      SHAPE_ASSIGN_CHECK(*in_shape, warpctc_enum::kInputLength,
+                         Shape1(dshape[0] / param_.input_length));
+    }
 
     out_shape->clear();
     out_shape->push_back(dshape);
@@ -269,6 +276,7 @@ class WarpCTCProp : public OperatorProperty {
     in_type->clear();
     in_type->push_back(mshadow::kFloat32);
     in_type->push_back(mshadow::kInt32);
+    if (param_.use_input_lengths) in_type->push_back(mshadow::kInt32);
     out_type->clear();
     out_type->push_back(mshadow::kFloat32);
     return true;
@@ -294,9 +302,11 @@ class WarpCTCProp : public OperatorProperty {
                                              const std::vector<int> &in_data,
                                              const std::vector<int> &out_data)
       const override {
-    return {in_data[warpctc_enum::kData],
-          in_data[warpctc_enum::kLabel],
-          out_data[warpctc_enum::kOut]};
+    std::vector<int> dep = {in_data[warpctc_enum::kData],
+                            in_data[warpctc_enum::kLabel],
+                            out_data[warpctc_enum::kOut]};
+    if (param_.use_input_lengths) dep.push_back(in_data[warpctc_enum::kInputLength]);
+    return dep;
   }
 
   Operator* CreateOperator(Context ctx) const override;
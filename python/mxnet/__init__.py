@@ -21,7 +21,7 @@
 """MXNet: a concise, fast and flexible framework for deep learning."""
 from __future__ import absolute_import
 
-from .context import Context, current_context, cpu, gpu
+from .context import Context, current_context, cpu, gpu, cpu_shared
 from .base import MXNetError
 from . import base
 from . import contrib
@@ -36,6 +36,9 @@ from . import recordio
 from . import operator
 # use mx.nd as short for mx.ndarray
 from . import ndarray as nd
+from . import sparse_ndarray
+# use mx.sparse_nd as short for mx.sparse_ndarray
+from . import sparse_ndarray as sparse_nd
 # use mx.rnd as short for mx.random
 from . import random as rnd
 from . import random
@@ -66,6 +69,7 @@ from . import torch
 from . import torch as th
 
 from . import profiler
+from . import engine
 from . import log
 
 from . import module
@@ -27,7 +27,7 @@ import numpy as np
 
 from ..base import _LIB
 from ..base import c_array, py_str, c_str, mx_uint, _Null
-from ..base import NDArrayHandle, OpHandle, CachedOpHandle
+from ..base import NDArrayHandle, OpHandle, CachedOpHandle, ImperativeOpHandle
 from ..base import check_call
 from ..ndarray_doc import _build_doc
 
@@ -142,3 +142,66 @@ class CachedOp(object):
         else:
             return [_ndarray_cls(ctypes.cast(output_vars[i], NDArrayHandle))
                     for i in range(num_output.value)]
+
+
+class ImperativeOp(object):
+    """Operator with its parameters parsed once, invoked with only its arrays.
+
+    The shapes and types of the outputs are inferred again only when those
+    of the arrays change.
+
+    Examples
+    --------
+    >>> relu = mx.nd.ImperativeOp('Activation', 1, act_type='relu')
+    >>> y = relu(x)
+    """
+    __slots__ = ["handle"]
+    def __init__(self, name, num_inputs, **kwargs):
+        op = OpHandle()
+        check_call(_LIB.NNGetOpHandle(c_str(name), ctypes.byref(op)))
+        keys = list(kwargs.keys())
+        self.handle = ImperativeOpHandle()
+        check_call(_LIB.MXCreateImperativeOp(
+            op,
+            ctypes.c_int(num_inputs),
+            ctypes.c_int(len(keys)),
+            c_array(ctypes.c_char_p, [c_str(key) for key in keys]),
+            c_array(ctypes.c_char_p, [c_str(str(kwargs[key])) for key in keys]),
+            ctypes.byref(self.handle)))
+
+    def __del__(self):
+        check_call(_LIB.MXFreeImperativeOp(self.handle))
+
+    def __call__(self, *args, **kwargs):
+        """ctypes implementation of imperative op invoke wrapper"""
+        out = kwargs.pop('out', None)
+        if out is not None:
+            original_output = out
+            if isinstance(out, NDArrayBase):
+                out = (out,)
+            num_output = ctypes.c_int(len(out))
+            output_vars = c_array(NDArrayHandle, [i.handle for i in out])
+            output_vars = ctypes.cast(output_vars, ctypes.POINTER(NDArrayHandle))
+        else:
+            original_output = None
+            output_vars = ctypes.POINTER(NDArrayHandle)()
+            num_output = ctypes.c_int(0)
+        if kwargs:
+            raise TypeError(
+                "ImperativeOp.__call__ got unexpected keyword argument(s): " + \
+                ', '.join(kwargs.keys()))
+
+        check_call(_LIB.MXInvokeImperativeOp(
+            self.handle,
+            ctypes.c_int(len(args)),
+            c_array(NDArrayHandle, [arr.handle for arr in args]),
+            ctypes.byref(num_output),
+            ctypes.byref(output_vars)))
+
+        if original_output is not None:
+            return original_output
+        if num_output.value == 1:
+            return _ndarray_cls(ctypes.cast(output_vars[0], NDArrayHandle))
+        else:
+            return [_ndarray_cls(ctypes.cast(output_vars[i], NDArrayHandle))
+                    for i in range(num_output.value)]
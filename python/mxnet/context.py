@@ -62,8 +62,8 @@ class Context(object):
     """
     # static class variable
     default_ctx = None
-    devtype2str = {1: 'cpu', 2: 'gpu', 3: 'cpu_pinned'}
-    devstr2type = {'cpu': 1, 'gpu': 2, 'cpu_pinned': 3}
+    devtype2str = {1: 'cpu', 2: 'gpu', 3: 'cpu_pinned', 5: 'cpu_shared'}
+    devstr2type = {'cpu': 1, 'gpu': 2, 'cpu_pinned': 3, 'cpu_shared': 5}
     def __init__(self, device_type, device_id=0):
         if isinstance(device_type, Context):
             self.device_typeid = device_type.device_typeid
@@ -151,6 +151,32 @@ def cpu(device_id=0):
     return Context('cpu', device_id)
 
 
+def cpu_shared(device_id=0):
+    """Returns a CPU context of the memory shared across the processes.
+
+    The arrays on it are in POSIX shared memory, which another process maps by
+    the handle of ``NDArray._to_shared_mem`` without a copy of the data. The
+    operators on them compute on the cpu and write their outputs on `cpu()`.
+
+    Examples
+    ----------
+    >>> x = mx.nd.empty((2, 3), ctx=mx.cpu_shared())
+    >>> x.context
+    cpu_shared(0)
+
+    Parameters
+    ----------
+    device_id : int, optional
+        The device id of the device, not needed for the shared memory.
+
+    Returns
+    -------
+    context : Context
+        The corresponding CPU shared memory context.
+    """
+    return Context('cpu_shared', device_id)
+
+
 def gpu(device_id=0):
     """Returns a GPU context.
 
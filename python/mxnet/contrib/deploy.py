@@ -0,0 +1,168 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+# coding: utf-8
+"""Graph rewrites of trained models for inference."""
+from __future__ import absolute_import
+
+import json
+import numpy as np
+
+from .. import symbol as sym
+from .. import ndarray as nd
+
+_FOLDABLE_OPS = ('Convolution', 'FullyConnected')
+_BATCHNORM_OPS = ('BatchNorm', 'CuDNNBatchNorm')
+
+
+def _to_bool(value, default):
+    if value is None:
+        return default
+    return value.lower() in ('true', '1')
+
+
+def fold_batchnorm(symbol, arg_params, aux_params):
+    """Fold the BatchNorm layers that follow a Convolution or a FullyConnected
+    layer into the weights and the bias of that layer.
+
+    At inference a BatchNorm layer applies a fixed affine transform per channel
+    with its moving statistics, so it can be merged with the layer computing its
+    input, which saves a pass over the feature map. A layer without bias gets
+    one. The outputs of the new symbol are named after the folded layers instead
+    of the removed BatchNorm layers.
+
+    Parameters
+    ----------
+    symbol : Symbol
+        The trained network.
+    arg_params : dict of str to NDArray
+        The arguments of the network.
+    aux_params : dict of str to NDArray
+        The auxiliary states of the network.
+
+    Returns
+    -------
+    (Symbol, dict of str to NDArray, dict of str to NDArray)
+        The new network, its arguments and its auxiliary states. The results
+        match the original network in inference mode only.
+
+    Examples
+    --------
+    >>> sym, arg_params, aux_params = mx.model.load_checkpoint('resnet', 0)
+    >>> sym, arg_params, aux_params = mx.contrib.deploy.fold_batchnorm(
+    ...     sym, arg_params, aux_params)
+    """
+    # pylint: disable=too-many-locals, too-many-branches, too-many-statements
+    graph = json.loads(symbol.tojson())
+    nodes = graph['nodes']
+    attr_key = 'attrs' if any('attrs' in node for node in nodes) else 'attr'
+    arg_params = dict(arg_params)
+    aux_params = dict(aux_params)
+
+    num_users = {}
+    for node in nodes:
+        for entry in node['inputs']:
+            num_users[entry[0], entry[1]] = num_users.get((entry[0], entry[1]), 0) + 1
+    for entry in graph['heads']:
+        num_users[entry[0], entry[1]] = num_users.get((entry[0], entry[1]), 0) + 1
+
+    def name_of(entry):
+        return nodes[entry[0]]['name']
+
+    # the node read in place of each removed BatchNorm, and the new biases
+    replace = {}
+    new_bias = {}
+    removed = set()
+    for bn_id, bn_node in enumerate(nodes):
+        if bn_node['op'] not in _BATCHNORM_OPS:
+            continue
+        attrs = bn_node.get(attr_key, {})
+        if _to_bool(attrs.get('output_mean_var'), False) or int(attrs.get('axis', 1)) != 1:
+            continue
+        data, gamma, beta, mean, var = bn_node['inputs']
+        layer_id = data[0]
+        layer = nodes[layer_id]
+        if layer['op'] not in _FOLDABLE_OPS or data[1] != 0 or num_users[tuple(data[:2])] != 1:
+            continue
+        layer_attrs = layer.setdefault(attr_key, {})
+        weight_name = name_of(layer['inputs'][1])
+        no_bias = _to_bool(layer_attrs.get('no_bias'), False)
+        bias_name = layer['name'] + '_bias' if no_bias else name_of(layer['inputs'][2])
+        if weight_name not in arg_params or (not no_bias and bias_name not in arg_params):
+            continue
+        if no_bias and bias_name in arg_params:
+            continue
+
+        eps = float(attrs.get('eps', 1e-3))
+        weight = arg_params[weight_name].asnumpy()
+        mean_np = aux_params[name_of(mean)].asnumpy()
+        var_np = aux_params[name_of(var)].asnumpy()
+        gamma_np = np.ones_like(var_np) if _to_bool(attrs.get('fix_gamma'), True) \
+            else arg_params[name_of(gamma)].asnumpy()
+        beta_np = arg_params[name_of(beta)].asnumpy()
+        bias = np.zeros_like(mean_np) if no_bias else arg_params[bias_name].asnumpy()
+        scale = gamma_np / np.sqrt(var_np + eps)
+        weight = weight * scale.reshape((-1,) + (1,) * (weight.ndim - 1))
+        bias = (bias - mean_np) * scale + beta_np
+        dtype = arg_params[weight_name].dtype
+        arg_params[weight_name] = nd.array(weight, dtype=dtype)
+        arg_params[bias_name] = nd.array(bias, dtype=dtype)
+        if no_bias:
+            layer_attrs['no_bias'] = 'False'
+            new_bias[layer_id] = {'op': 'null', 'name': bias_name, 'inputs': []}
+        replace[bn_id] = layer_id
+        removed.add(bn_id)
+        for entry in (gamma, beta, mean, var):
+            num_users[tuple(entry[:2])] -= 1
+            if num_users[tuple(entry[:2])] == 0:
+                removed.add(entry[0])
+
+    if not replace:
+        return symbol, arg_params, aux_params
+    for node_id in removed:
+        if nodes[node_id]['op'] == 'null':
+            arg_params.pop(nodes[node_id]['name'], None)
+            aux_params.pop(nodes[node_id]['name'], None)
+
+    # rebuild the node list in topological order
+    new_nodes = []
+    new_id = {}
+    bias_id = {}
+    for node_id, node in enumerate(nodes):
+        if node_id in removed:
+            continue
+        if node_id in new_bias:
+            bias_id[node_id] = len(new_nodes)
+            new_nodes.append(new_bias[node_id])
+        new_id[node_id] = len(new_nodes)
+        new_nodes.append(node)
+
+    def remap(entry):
+        node_id = replace.get(entry[0], entry[0])
+        return [new_id[node_id]] + list(entry[1:])
+
+    for node_id, node in enumerate(nodes):
+        if node_id in removed:
+            continue
+        node['inputs'] = [remap(entry) for entry in node['inputs']]
+        if node_id in bias_id:
+            node['inputs'].append([bias_id[node_id], 0, 0])
+    graph['nodes'] = new_nodes
+    graph['arg_nodes'] = [i for i, node in enumerate(new_nodes) if node['op'] == 'null']
+    graph['heads'] = [remap(entry) for entry in graph['heads']]
+    graph.pop('node_row_ptr', None)
+    return sym.load_json(json.dumps(graph)), arg_params, aux_params
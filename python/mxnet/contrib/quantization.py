@@ -0,0 +1,261 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+# coding: utf-8
+"""Quantization of trained models to 8-bit integers for inference."""
+from __future__ import absolute_import
+
+import json
+import numpy as np
+
+from .. import symbol as sym
+from .. import ndarray as nd
+from ..context import cpu
+
+_QUANTIZABLE_OPS = ('FullyConnected',)
+
+
+def _to_bool(value, default):
+    if value is None:
+        return default
+    return value.lower() in ('true', '1')
+
+
+def _range(low, high):
+    """Widen an empty range so that its scale is not zero."""
+    low, high = float(low), float(high)
+    if high - low < 1e-8:
+        high = low + 1e-8
+    return low, high
+
+
+def _quantizable(graph, arg_params):
+    """The ids of the layers whose weights are known."""
+    nodes = graph['nodes']
+    attr_key = 'attrs' if any('attrs' in node for node in nodes) else 'attr'
+    layers = []
+    for node_id, node in enumerate(nodes):
+        if node['op'] not in _QUANTIZABLE_OPS:
+            continue
+        no_bias = _to_bool(node.get(attr_key, {}).get('no_bias'), False)
+        params = [nodes[entry[0]] for entry in node['inputs'][1:]]
+        if all(param['op'] == 'null' and param['name'] in arg_params for param in params) \
+                and len(params) == (1 if no_bias else 2):
+            layers.append(node_id)
+    return layers
+
+
+def calibrate(symbol, arg_params, aux_params, calib_data, ctx=cpu(), num_batches=None):
+    """Measure the range of the data of each layer that can be quantized.
+
+    Parameters
+    ----------
+    symbol : Symbol
+        The trained network.
+    arg_params : dict of str to NDArray
+        The arguments of the network.
+    aux_params : dict of str to NDArray
+        The auxiliary states of the network.
+    calib_data : DataIter
+        Representative input data. The labels are not used.
+    ctx : Context
+        The device running the network.
+    num_batches : int, optional
+        The number of batches to read. Reads the whole iterator by default.
+
+    Returns
+    -------
+    dict of str to (float, float)
+        The minimum and the maximum of the data of each layer, by layer name.
+    """
+    graph = json.loads(symbol.tojson())
+    layers = _quantizable(graph, arg_params)
+    if not layers:
+        return {}
+    # a network whose outputs are the data of the layers
+    graph['heads'] = [graph['nodes'][layer]['inputs'][0] for layer in layers]
+    graph.pop('node_row_ptr', None)
+    probe = sym.load_json(json.dumps(graph))
+    data_names = [desc[0] for desc in calib_data.provide_data]
+    shapes = dict((desc[0], desc[1]) for desc in calib_data.provide_data)
+    exe = probe.simple_bind(ctx, grad_req='null', **shapes)
+    for name, arr in exe.arg_dict.items():
+        if name not in shapes:
+            arr[:] = arg_params[name]
+    for name, arr in exe.aux_dict.items():
+        arr[:] = aux_params[name]
+
+    low = [np.inf] * len(layers)
+    high = [-np.inf] * len(layers)
+    calib_data.reset()
+    for i, batch in enumerate(calib_data):
+        if num_batches is not None and i >= num_batches:
+            break
+        exe.forward(is_train=False, **dict(zip(data_names, batch.data)))
+        for j, out in enumerate(exe.outputs):
+            out = out.asnumpy()
+            low[j] = min(low[j], out.min())
+            high[j] = max(high[j], out.max())
+    nodes = graph['nodes']
+    return {nodes[layer]['name']: _range(low[j], high[j]) for j, layer in enumerate(layers)}
+
+
+def quantize_symbol(symbol, arg_params, data_ranges):
+    """Replace the layers whose data range is known by their quantized version.
+
+    The data of each layer is quantized to `uint8` with its calibrated range,
+    the weights are quantized offline with their own range and the layer runs
+    `_contrib_quantized_fully_connected`, which accumulates in int32 and
+    returns float32, so the other layers are unchanged.
+
+    Parameters
+    ----------
+    symbol : Symbol
+        The trained network.
+    arg_params : dict of str to NDArray
+        The arguments of the network.
+    data_ranges : dict of str to (float, float)
+        The range of the data of the layers to quantize, as returned by
+        `calibrate`.
+
+    Returns
+    -------
+    (Symbol, dict of str to NDArray)
+        The new network and its arguments.
+    """
+    # pylint: disable=too-many-locals
+    graph = json.loads(symbol.tojson())
+    nodes = graph['nodes']
+    attr_key = 'attrs' if any('attrs' in node for node in nodes) else 'attr'
+    layers = [layer for layer in _quantizable(graph, arg_params)
+              if nodes[layer]['name'] in data_ranges]
+    if not layers:
+        return symbol, arg_params
+    arg_params = dict(arg_params)
+
+    num_users = {}
+    for node in nodes:
+        for entry in node['inputs']:
+            num_users[entry[0]] = num_users.get(entry[0], 0) + 1
+    for entry in graph['heads']:
+        num_users[entry[0]] = num_users.get(entry[0], 0) + 1
+
+    # the nodes inserted before each quantized layer
+    inserted = {}
+    removed = set()
+    for layer in layers:
+        node = nodes[layer]
+        name = node['name']
+        attrs = node.get(attr_key, {})
+        no_bias = _to_bool(attrs.get('no_bias'), False)
+        weight_id = node['inputs'][1][0]
+        weight = arg_params[nodes[weight_id]['name']].asnumpy()
+        min_w, max_w = _range(weight.min(), weight.max())
+        qweight = np.clip(np.round((weight - min_w) * 255.0 / (max_w - min_w)), 0, 255)
+        min_d, max_d = data_ranges[name]
+
+        params = {'_data_min': [min_d], '_data_max': [max_d],
+                  '_weight_quantized': qweight.astype(np.uint8),
+                  '_weight_min': [min_w], '_weight_max': [max_w]}
+        if no_bias:
+            params['_bias'] = np.zeros((weight.shape[0],))
+        for suffix, value in params.items():
+            dtype = np.uint8 if suffix == '_weight_quantized' else np.float32
+            arg_params[name + suffix] = nd.array(value, dtype=dtype)
+        # the float weight is dropped once no layer reads it
+        num_users[weight_id] -= 1
+        if num_users[weight_id] == 0:
+            removed.add(weight_id)
+            arg_params.pop(nodes[weight_id]['name'], None)
+
+        def var(suffix):
+            return {'op': 'null', 'name': name + suffix, 'inputs': []}
+        inserted[layer] = [
+            var('_data_min'), var('_data_max'),
+            {'op': '_contrib_quantize', 'name': name + '_data_quantize',
+             attr_key: {'out_type': 'uint8'}, 'inputs': node['inputs'][:1]},
+            var('_weight_quantized'), var('_weight_min'), var('_weight_max')]
+        if no_bias:
+            inserted[layer].append(var('_bias'))
+        node['op'] = '_contrib_quantized_fully_connected'
+        node[attr_key] = {'num_hidden': attrs['num_hidden']}
+
+    # rebuild the node list in topological order
+    new_nodes = []
+    new_id = {}
+    for node_id, node in enumerate(nodes):
+        if node_id in removed:
+            continue
+        if node_id in inserted:
+            start = len(new_nodes)
+            extra = inserted[node_id]
+            quantize = extra[2]
+            quantize['inputs'] = [[new_id[quantize['inputs'][0][0]]] + quantize['inputs'][0][1:]]
+            quantize['inputs'] += [[start, 0, 0], [start + 1, 0, 0]]
+            bias = [start + 6, 0, 0] if len(extra) == 7 else \
+                [new_id[node['inputs'][2][0]]] + node['inputs'][2][1:]
+            new_nodes.extend(extra)
+            node['inputs'] = [[start + 2, 0, 0], [start + 3, 0, 0], bias,
+                              [start + 2, 1, 0], [start + 2, 2, 0],
+                              [start + 4, 0, 0], [start + 5, 0, 0]]
+        else:
+            node['inputs'] = [[new_id[entry[0]]] + entry[1:] for entry in node['inputs']]
+        new_id[node_id] = len(new_nodes)
+        new_nodes.append(node)
+    graph['nodes'] = new_nodes
+    graph['arg_nodes'] = [i for i, node in enumerate(new_nodes) if node['op'] == 'null']
+    graph['heads'] = [[new_id[entry[0]]] + entry[1:] for entry in graph['heads']]
+    graph.pop('node_row_ptr', None)
+    return sym.load_json(json.dumps(graph)), arg_params
+
+
+def quantize_model(symbol, arg_params, aux_params, calib_data, ctx=cpu(), num_batches=None):
+    """Quantize the fully connected layers of a trained network to `uint8`.
+
+    The ranges of the data of the layers are calibrated on `calib_data`, which
+    should be representative of the data seen at inference. The other layers
+    keep running in float32.
+
+    Parameters
+    ----------
+    symbol : Symbol
+        The trained network.
+    arg_params : dict of str to NDArray
+        The arguments of the network.
+    aux_params : dict of str to NDArray
+        The auxiliary states of the network.
+    calib_data : DataIter
+        Representative input data. The labels are not used.
+    ctx : Context
+        The device running the calibration.
+    num_batches : int, optional
+        The number of batches used for calibration.
+
+    Returns
+    -------
+    (Symbol, dict of str to NDArray, dict of str to NDArray)
+        The quantized network, its arguments and its auxiliary states.
+
+    Examples
+    --------
+    >>> sym, arg_params, aux_params = mx.model.load_checkpoint('mlp', 0)
+    >>> sym, arg_params, aux_params = mx.contrib.quantization.quantize_model(
+    ...     sym, arg_params, aux_params, val_iter, num_batches=10)
+    """
+    ranges = calibrate(symbol, arg_params, aux_params, calib_data, ctx, num_batches)
+    symbol, arg_params = quantize_symbol(symbol, arg_params, ranges)
+    return symbol, arg_params, aux_params
@@ -8,6 +8,7 @@ ctypedef void* SymbolHandle
 ctypedef void* NDArrayHandle
 ctypedef void* OpHandle
 ctypedef void* CachedOpHandle
+ctypedef void* ImperativeOpHandle
 ctypedef unsigned nn_uint
 
 cdef py_str(const char* x):
@@ -107,3 +108,15 @@ cdef extern from "mxnet/c_api.h":
                        NDArrayHandle *inputs,
                        int *num_outputs,
                        NDArrayHandle **outputs);
+    int MXCreateImperativeOp(OpHandle creator,
+                             int num_inputs,
+                             int num_params,
+                             const char **param_keys,
+                             const char **param_vals,
+                             ImperativeOpHandle *out);
+    int MXFreeImperativeOp(ImperativeOpHandle handle);
+    int MXInvokeImperativeOp(ImperativeOpHandle handle,
+                             int num_inputs,
+                             NDArrayHandle *inputs,
+                             int *num_outputs,
+                             NDArrayHandle **outputs);
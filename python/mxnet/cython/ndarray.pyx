@@ -133,6 +133,73 @@ cdef class CachedOp:
             return tuple(NewArray(p_output_vars[i]) for i in range(num_output))
 
 
+cdef class ImperativeOp:
+    """Operator with its parameters parsed once, invoked with only its arrays."""
+    cdef ImperativeOpHandle chandle
+
+    def __init__(self, name, num_inputs, **kwargs):
+        cdef OpHandle op
+        cdef vector[string] ckeys
+        cdef vector[string] cvals
+        cdef string cname = c_str(name)
+        CALL(NNGetOpHandle(cname.c_str(), &op))
+        for k, v in kwargs.items():
+            ckeys.push_back(c_str(k))
+            cvals.push_back(c_str(str(v)))
+        cdef vector[const char*] param_keys = SVec2Ptr(ckeys)
+        cdef vector[const char*] param_vals = SVec2Ptr(cvals)
+        CALL(MXCreateImperativeOp(
+            op,
+            <int>num_inputs,
+            <int>param_keys.size(),
+            CBeginPtr(param_keys),
+            CBeginPtr(param_vals),
+            &self.chandle))
+
+    def __del__(self):
+        CALL(MXFreeImperativeOp(self.chandle))
+
+    def __call__(self, *args, out=None):
+        """cython implementation of imperative op invoke wrapper"""
+        cdef vector[NDArrayHandle] ndvars
+        cdef vector[NDArrayHandle] output_vars
+        cdef NDArrayHandle* p_output_vars
+        cdef int num_output
+
+        for i in args:
+            ndvars.push_back((<NDArrayBase>i).chandle)
+
+        original_output = None
+        if out is not None:
+            original_output = out
+            if isinstance(out, NDArrayBase):
+                output_vars.push_back((<NDArrayBase>out).chandle)
+            else:
+                for i in out:
+                    output_vars.push_back((<NDArrayBase>i).chandle)
+
+        num_output = output_vars.size()
+        if output_vars.size() == 0:
+            output_vars.resize(1)
+            p_output_vars = NULL
+        else:
+            p_output_vars = &output_vars[0]
+
+        CALL(MXInvokeImperativeOp(
+            (<ImperativeOp>self).chandle,
+            <int>len(args),
+            &ndvars[0] if ndvars.size() != 0 else NULL,
+            &num_output,
+            &p_output_vars))
+
+        if original_output is not None:
+            return original_output
+        if num_output == 1:
+            return NewArray(p_output_vars[0])
+        else:
+            return tuple(NewArray(p_output_vars[i]) for i in range(num_output))
+
+
 def _imperative_invoke(handle, ndargs, keys, vals, out):
     """cython implementation of imperative invoke wrapper"""
     cdef unsigned long long ihandle = handle
@@ -0,0 +1,109 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+
+# coding: utf-8
+"""Engine setting methods."""
+from __future__ import absolute_import
+
+import ctypes
+import contextlib
+from .base import _LIB, check_call
+
+def set_bulk_size(size):
+    """Set the number of the imperative operations that the calling thread
+    collects into one engine operation.
+
+    The collected operations are pushed together when there are `size` of
+    them, when an operation runs on another device, and before any other
+    operation of the thread or any wait, such as `asnumpy`. This saves the
+    scheduling cost of the small operations, at the price of their
+    parallelism.
+
+    Parameters
+    ----------
+    size : int
+        The number of operations, 0 to push them one by one.
+
+    Returns
+    -------
+    int
+        The previous number of operations.
+    """
+    prev = ctypes.c_int()
+    check_call(_LIB.MXEngineSetBulkSize(
+        ctypes.c_int(size), ctypes.byref(prev)))
+    return prev.value
+
+@contextlib.contextmanager
+def bulk(size):
+    """Collect the imperative operations of the calling thread in the scope
+    into engine operations of `size` of them, see `set_bulk_size`.
+
+    Example::
+
+        with mx.engine.bulk(10):
+            for _ in range(100):
+                x += 1
+    """
+    prev = set_bulk_size(size)
+    try:
+        yield
+    finally:
+        set_bulk_size(prev)
+
+def set_inline(enable):
+    """Set whether the calling thread runs the CPU operations it pushes
+    inline, on the thread and before the push returns.
+
+    The operations run inline skip the dependency tracking and the hand-off
+    to the engine threads, which saves their scheduling latency, such as for
+    the batch-1 inference of a predictor owned by a serving thread. The
+    operations on the other devices are pushed as usual, then waited for.
+    Enabling the mode waits for all the operations pushed before. The arrays
+    the thread uses must not be used by the other threads meanwhile.
+
+    Parameters
+    ----------
+    enable : bool
+        Whether to run the operations inline.
+
+    Returns
+    -------
+    bool
+        The previous setting.
+    """
+    prev = ctypes.c_int()
+    check_call(_LIB.MXEngineSetInline(
+        ctypes.c_int(int(enable)), ctypes.byref(prev)))
+    return bool(prev.value)
+
+@contextlib.contextmanager
+def inline():
+    """Run the CPU operations of the calling thread in the scope inline,
+    see `set_inline`.
+
+    Example::
+
+        with mx.engine.inline():
+            out = executor.forward(data=x)[0].asnumpy()
+    """
+    prev = set_inline(True)
+    try:
+        yield
+    finally:
+        set_inline(prev)
@@ -22,10 +22,12 @@ from __future__ import absolute_import
 
 import ctypes
 import copy
+import os
+from collections import OrderedDict
 import numpy as np
 from .base import _LIB
-from .base import mx_uint, NDArrayHandle, ExecutorHandle
-from .base import check_call, c_array, py_str
+from .base import mx_uint, NDArrayHandle, ExecutorHandle, PipelineExecutorHandle
+from .base import check_call, c_array, c_str, py_str
 from .ndarray import NDArray
 from . import ndarray as nd
 
@@ -77,9 +79,11 @@ class Executor(object):
         self._aux_dict = None
         self._output_dict = None
         self._monitor_callback = None
+        self._gradient_callback = None
         self._ctx = copy.deepcopy(ctx)
         self._grad_req = copy.deepcopy(grad_req)
         self._group2ctx = copy.deepcopy(group2ctx)
+        self._reshape_cache = OrderedDict()
 
     def __del__(self):
         check_call(_LIB.MXExecutorFree(self.handle))
@@ -236,7 +240,8 @@ class Executor(object):
         Parameters
         ----------
         callback : function
-            Takes a string and an NDArrayHandle.
+            Takes a string and an NDArrayHandle. None removes the installed callback,
+            the forwards of the executor are bulked again.
 
         Examples
         --------
@@ -246,12 +251,41 @@ class Executor(object):
         >>> texe.set_monitor_callback(mon_callback)
         """
         cb_type = ctypes.CFUNCTYPE(None, ctypes.c_char_p, NDArrayHandle, ctypes.c_void_p)
-        self._monitor_callback = cb_type(_monitor_callback_wrapper(callback))
+        if callback is None:
+            self._monitor_callback = cb_type()
+        else:
+            self._monitor_callback = cb_type(_monitor_callback_wrapper(callback))
         check_call(_LIB.MXExecutorSetMonitorCallback(
             self.handle,
             self._monitor_callback,
             None))
 
+    def set_gradient_callback(self, callback):
+        """Install a callback called during `backward` with the name of each argument
+        and its gradient, as soon as the operation computing the gradient is scheduled.
+
+        The operations that the callback schedules on the gradient, such as a push to
+        a kvstore, run while the rest of the backward pass is computed.
+
+        Parameters
+        ----------
+        callback : function
+            Takes the name of an argument and its gradient NDArray.
+
+        Examples
+        --------
+        >>> texe.set_gradient_callback(lambda name, grad: kv.push(name, grad))
+        """
+        def callback_handle(name, array, _):
+            """ ctypes function """
+            callback(py_str(name), NDArray(ctypes.cast(array, NDArrayHandle)))
+        cb_type = ctypes.CFUNCTYPE(None, ctypes.c_char_p, NDArrayHandle, ctypes.c_void_p)
+        self._gradient_callback = cb_type(callback_handle)
+        check_call(_LIB.MXExecutorSetGradientCallback(
+            self.handle,
+            self._gradient_callback,
+            None))
+
     @property
     def arg_dict(self):
         """Get dictionary representation of argument arrrays.
@@ -384,7 +418,9 @@ class Executor(object):
         Returns
         -------
         exec : Executor
-            A new executor that shares memory with self.
+            A new executor that shares memory with self. The executors of the
+            last `MXNET_EXEC_RESHAPE_CACHE_SIZE` distinct shapes are cached, and
+            reshaping to one of them again returns the same executor.
 
         Examples
         --------
@@ -396,6 +432,12 @@ class Executor(object):
         >>> texec.reshape(allow_up_sizing=True, **new_shape)
         """
         # pylint: disable=too-many-branches
+        key = (partial_shaping, allow_up_sizing,
+               tuple(sorted((k, tuple(v)) for k, v in kwargs.items())))
+        if key in self._reshape_cache:
+            exe = self._reshape_cache.pop(key)
+            self._reshape_cache[key] = exe
+            return exe
         arg_shapes, _, aux_shapes = self._symbol.infer_shape(**kwargs)
         if arg_shapes is None:
             raise ValueError("Insufficient argument shapes provided.")
@@ -445,13 +487,19 @@ class Executor(object):
                     "with the old one. Please check for error in network." +\
                     "If this is intended, set partial_shaping=True to suppress this warning.")
 
-        return self._symbol.bind(self._ctx,
-                                 args=new_arg_dict,
-                                 args_grad=new_grad_dict,
-                                 grad_req=self._grad_req,
-                                 aux_states=new_aux_dict,
-                                 group2ctx=self._group2ctx,
-                                 shared_exec=self)
+        exe = self._symbol.bind(self._ctx,
+                                args=new_arg_dict,
+                                args_grad=new_grad_dict,
+                                grad_req=self._grad_req,
+                                aux_states=new_aux_dict,
+                                group2ctx=self._group2ctx,
+                                shared_exec=self)
+        cache_size = int(os.environ.get('MXNET_EXEC_RESHAPE_CACHE_SIZE', 8))
+        if cache_size > 0:
+            while len(self._reshape_cache) >= cache_size:
+                self._reshape_cache.popitem(last=False)
+            self._reshape_cache[key] = exe
+        return exe
 
     def debug_str(self):
         """Get a debug string about internal execution plan.
@@ -493,3 +541,122 @@ class Executor(object):
         check_call(_LIB.MXExecutorPrint(
             self.handle, ctypes.byref(debug_str)))
         return py_str(debug_str.value)
+
+
+class PipelineExecutor(object):
+    """Executors of a model parallel symbol, one per micro-batch.
+
+    The batch is split along the first axis into `num_micro_batches`. The
+    executors share the parameters and the gradients, and each forward and
+    backward pushes all the micro-batches at once, so that the device of a
+    ctx_group works on one micro-batch while the next device works on the
+    previous one, instead of waiting for the whole batch.
+
+    The gradients are the sums over the micro-batches, which are the gradients
+    of the batch for the losses that do not normalize by the batch size.
+
+    Parameters
+    ----------
+    symbol : Symbol
+        The symbol, whose outputs should be losses.
+    ctx : Context
+        The device of the nodes out of the groups.
+    group2ctx : dict of str to Context
+        The device of each ctx_group.
+    data_shapes : list of (str, tuple)
+        The names and the shapes of the whole batch of the arguments split into
+        the micro-batches, such as the data and the label; the other arguments
+        are the parameters.
+    num_micro_batches : int
+        The number of the micro-batches.
+
+    Examples
+    --------
+    >>> pipe = mx.executor.PipelineExecutor(net, mx.gpu(0), {'dev1': mx.gpu(0), 'dev2': mx.gpu(1)},
+    ...                                     [('data', (128, 100)), ('label', (128,))], 4)
+    >>> pipe.set_params(arg_params, aux_params)
+    >>> pipe.forward([data, label], is_train=True)
+    >>> pipe.backward()
+    >>> for name, (weight, grad) in pipe.params.items():
+    ...     updater(name, grad, weight)
+    """
+    def __init__(self, symbol, ctx, group2ctx, data_shapes, num_micro_batches):
+        self.handle = PipelineExecutorHandle()
+        keys = [c_str(k) for k in group2ctx]
+        shape_data = []
+        shape_indptr = [0]
+        for _, shape in data_shapes:
+            shape_data.extend(shape)
+            shape_indptr.append(len(shape_data))
+        check_call(_LIB.MXPipelineExecutorCreate(
+            symbol.handle, ctypes.c_int(ctx.device_typeid), ctypes.c_int(ctx.device_id),
+            mx_uint(len(keys)), c_array(ctypes.c_char_p, keys),
+            c_array(ctypes.c_int, [v.device_typeid for v in group2ctx.values()]),
+            c_array(ctypes.c_int, [v.device_id for v in group2ctx.values()]),
+            mx_uint(len(data_shapes)),
+            c_array(ctypes.c_char_p, [c_str(name) for name, _ in data_shapes]),
+            c_array(mx_uint, shape_indptr), c_array(mx_uint, shape_data),
+            ctypes.c_int(num_micro_batches), ctypes.byref(self.handle)))
+        self._num_data = len(data_shapes)
+
+    def __del__(self):
+        check_call(_LIB.MXPipelineExecutorFree(self.handle))
+
+    def set_params(self, arg_params, aux_params=None):
+        """Copy parameters and auxiliary states to their devices.
+
+        Parameters
+        ----------
+        arg_params : dict of str to NDArray
+        aux_params : dict of str to NDArray, optional
+        """
+        params = dict(arg_params)
+        params.update(aux_params or {})
+        check_call(_LIB.MXPipelineExecutorSetParams(
+            self.handle, mx_uint(len(params)),
+            c_array(ctypes.c_char_p, [c_str(k) for k in params]),
+            c_array(NDArrayHandle, [v.handle for v in params.values()])))
+
+    def forward(self, data, is_train=False):
+        """Copy the micro-batches of a batch and run the forward pass of each.
+
+        Parameters
+        ----------
+        data : list of NDArray
+            The batch of each argument of `data_shapes`, in the same order.
+        is_train : bool, optional
+            Whether a backward call is expected to follow.
+        """
+        if len(data) != self._num_data:
+            raise ValueError('Expect %d data, got %d' % (self._num_data, len(data)))
+        check_call(_LIB.MXPipelineExecutorForward(
+            self.handle, mx_uint(len(data)),
+            c_array(NDArrayHandle, [d.handle for d in data]), ctypes.c_int(int(is_train))))
+
+    def backward(self):
+        """Run the backward pass of every micro-batch, summing the gradients."""
+        check_call(_LIB.MXPipelineExecutorBackward(self.handle))
+
+    @property
+    def outputs(self):
+        """The outputs of all the micro-batches, the ones of the first first."""
+        out_size = mx_uint()
+        handles = ctypes.POINTER(NDArrayHandle)()
+        check_call(_LIB.MXPipelineExecutorGetOutputs(
+            self.handle, ctypes.byref(out_size), ctypes.byref(handles)))
+        return [NDArray(NDArrayHandle(handles[i])) for i in range(out_size.value)]
+
+    @property
+    def params(self):
+        """The dict of the name of each parameter to the parameter and its gradient."""
+        size = mx_uint()
+        names = ctypes.POINTER(ctypes.c_char_p)()
+        params = ctypes.POINTER(NDArrayHandle)()
+        grads = ctypes.POINTER(NDArrayHandle)()
+        check_call(_LIB.MXPipelineExecutorGetParams(
+            self.handle, ctypes.byref(size), ctypes.byref(names),
+            ctypes.byref(params), ctypes.byref(grads)))
+        return OrderedDict((py_str(names[i]),
+                            (NDArray(NDArrayHandle(params[i])),
+                             NDArray(NDArrayHandle(grads[i]))))
+                           for i in range(size.value))
@@ -184,7 +184,9 @@ class _RNNLayer(Block):
             for i in range(self._dir):
                 self.i2h_weight[i].shape = (self._gates*self._hidden_size, inputs.shape[2])
                 self.i2h_weight[i]._finish_deferred_init()
-        if inputs.context.device_type == 'gpu':
+        # the cpu RNN operator has no dropout between the layers
+        if inputs.context.device_type == 'gpu' or \
+                self._dropout == 0 or self._num_layers == 1:
             out = self._forward_gpu(inputs, states)
         else:
             out = self._forward_cpu(inputs, states)
@@ -131,6 +131,8 @@ class Trainer(object):
 
         self._optimizer.rescale_grad = self._scale / batch_size
 
+        # the updates of each device are made together once all are pushed
+        updates = [([], [], []) for _ in self._updaters]
         for i, param in enumerate(self._params):
             if param.grad_req == 'null':
                 continue
@@ -154,7 +156,13 @@ class Trainer(object):
                 else:
                     self._kvstore.pull(i, param.list_grad(), priority=-i)
 
-            for upd, arr, grad in zip(self._updaters, param.list_data(), param.list_grad()):
+            for upd, arr, grad in zip(updates, param.list_data(), param.list_grad()):
                 if not ignore_stale_grad or arr._fresh_grad:
-                    upd(i, grad, arr)
+                    upd[0].append(i)
+                    upd[1].append(grad)
+                    upd[2].append(arr)
                     arr._fresh_grad = False
+
+        for updater, upd in zip(self._updaters, updates):
+            if upd[0]:
+                updater.update_multi(*upd)
@@ -188,6 +188,7 @@ class DataIter(object):
     --------
     NDArrayIter : Data-iterator for MXNet NDArray or numpy-ndarray objects.
     CSVIter : Data-iterator for csv data.
+    LibSVMIter : Data-iterator for libsvm data, in csr batches.
     ImageIter : Data-iterator for images.
     """
     def __init__(self, batch_size=0):
@@ -824,6 +825,38 @@ class MXDataIter(DataIter):
         check_call(_LIB.MXDataIterGetPadNum(self.handle, ctypes.byref(pad)))
         return pad.value
 
+    def stats(self):
+        """Get the throughput counters of the iterator.
+
+        The counters depend on the iterator: ``bytes_read``, ``records_decoded``,
+        ``decode_usec`` and ``augment_usec`` for the stages that read and decode
+        the records, and ``batches``, ``stall_usec``, ``queue_requests``,
+        ``queue_ready_sum`` and ``queue_capacity`` for the prefetch queue. Times
+        are in microseconds, summed over the threads of a stage.
+
+        Returns
+        -------
+        dict of str to number
+            The counters, with ``records_per_sec``, the mean ``queue_occupancy``
+            as a fraction of the capacity and the ``stall_fraction`` of the wall
+            time spent waiting for batches when those can be derived.
+        """
+        size = mx_uint()
+        keys = ctypes.POINTER(ctypes.c_char_p)()
+        values = ctypes.POINTER(ctypes.c_uint64)()
+        check_call(_LIB.MXDataIterGetStats(self.handle, ctypes.byref(size),
+                                           ctypes.byref(keys), ctypes.byref(values)))
+        ret = {py_str(keys[i]): values[i] for i in range(size.value)}
+        wall = ret.get('wall_usec', 0)
+        if wall > 0 and 'records_decoded' in ret:
+            ret['records_per_sec'] = ret['records_decoded'] * 1e6 / wall
+        if wall > 0 and 'stall_usec' in ret:
+            ret['stall_fraction'] = float(ret['stall_usec']) / wall
+        if ret.get('queue_requests', 0) > 0 and ret.get('queue_capacity', 0) > 0:
+            ret['queue_occupancy'] = float(ret['queue_ready_sum']) / \
+                (ret['queue_requests'] * ret['queue_capacity'])
+        return ret
+
 def _make_io_iterator(handle):
     """Create an io iterator by handle."""
     name = ctypes.c_char_p()
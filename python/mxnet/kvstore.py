@@ -27,6 +27,41 @@ from .base import check_call, c_array, c_str, string_types, mx_uint, py_str
 from .base import NDArrayHandle, KVStoreHandle
 from . import optimizer as opt
 
+# the command of the native server optimizers, kSetServerOptimizer in kvstore_dist_server.h
+_SET_SERVER_OPTIMIZER = -10
+
+def _server_optimizer_settings(optimizer):
+    """Returns the settings of the update operator the servers can run instead
+    of optimizer, or None if the optimizer needs the python updater."""
+    # pylint: disable=unidiomatic-typecheck, protected-access
+    if optimizer.lr_scheduler is not None or optimizer.param_dict:
+        return None
+    if type(optimizer) is opt.SGD and not optimizer.multi_precision:
+        if optimizer.momentum > 0:
+            settings = {'op': 'sgd_mom_update', 'momentum': optimizer.momentum}
+        else:
+            settings = {'op': 'sgd_update'}
+    elif type(optimizer) is opt.Adam:
+        settings = {'op': 'adam_update', 'beta1': optimizer.beta1,
+                    'beta2': optimizer.beta2, 'epsilon': optimizer.epsilon,
+                    'bias_correction': 1, 'begin_num_update': optimizer.begin_num_update}
+    else:
+        return None
+    settings['lr'] = optimizer.lr
+    settings['wd'] = optimizer.wd
+    settings['rescale_grad'] = optimizer.rescale_grad
+    if optimizer.clip_gradient is not None:
+        settings['clip_gradient'] = optimizer.clip_gradient
+    # the keys are the indices of the parameters
+    indices = set(optimizer.idx2name.keys())
+    indices.update(k for k in list(optimizer.lr_mult) + list(optimizer.wd_mult)
+                   if isinstance(k, int))
+    for index in indices:
+        settings['lr.%d' % index] = optimizer._get_lr(index)
+        settings['wd.%d' % index] = optimizer._get_wd(index)
+    return '\n'.join('%s=%s' % (k, repr(v) if isinstance(v, float) else v)
+                     for k, v in settings.items())
+
 def _ctype_key_value(keys, vals):
     if isinstance(keys, (tuple, list)):
         assert(len(keys) == len(vals))
@@ -236,7 +271,73 @@ class KVStore(object):
             self.handle, mx_uint(len(ckeys)), ckeys, cvals,
             ctypes.c_int(priority)))
 
-    def set_optimizer(self, optimizer):
+    def row_sparse_push(self, key, value, row_ids, priority=0):
+        """ Pushes the rows of the values listed in `row_ids`, the other rows
+        being zero, like the gradient of an `Embedding`.
+
+        The values are aggregated like `push`. With a distributed store only the
+        listed rows are sent, and the servers only update those rows: their
+        optimizer receives the rows of the gradient and of the weight, so it has
+        to keep no state, like `sgd` without momentum. The other stores push
+        the whole values.
+
+        Parameters
+        ----------
+        key : str or list of str
+            Keys.
+
+        value : NDArray or list of NDArray or list of list of NDArray
+            Values corresponding to the keys, at least 2-D.
+
+        row_ids : NDArray or list of NDArray or list of list of NDArray
+            The indices of the rows of each value, like the data of an `Embedding`.
+
+        priority : int, optional
+            The priority of the push operation.
+
+        Examples
+        --------
+        >>> # push the gradient of the rows of a batch
+        >>> kv.row_sparse_push('embed', grad, row_ids=batch.data[0])
+        """
+        ckeys, cvals = _ctype_key_value(key, value)
+        _, crows = _ctype_key_value(key, row_ids)
+        check_call(_LIB.MXKVStorePushRowSparseEx(
+            self.handle, mx_uint(len(ckeys)), ckeys, cvals, crows,
+            ctypes.c_int(priority)))
+
+    def row_sparse_pull(self, key, out, row_ids, priority=0):
+        """ Pulls the rows listed in `row_ids` from the store.
+
+        With a distributed store only the listed rows are received, the other
+        rows of `out` are left unchanged. The other stores pull the whole values.
+
+        Parameters
+        ----------
+        key : str or list of str
+            Keys.
+
+        out: NDArray or list of NDArray or list of list of NDArray
+            Values corresponding to the keys.
+
+        row_ids : NDArray or list of NDArray or list of list of NDArray
+            The indices of the rows to pull into each value.
+
+        priority : int, optional
+            The priority of the pull operation.
+
+        Examples
+        --------
+        >>> # pull the rows of the next batch
+        >>> kv.row_sparse_pull('embed', out=weight, row_ids=batch.data[0])
+        """
+        ckeys, cvals = _ctype_key_value(key, out)
+        _, crows = _ctype_key_value(key, row_ids)
+        check_call(_LIB.MXKVStorePullRowSparseEx(
+            self.handle, mx_uint(len(ckeys)), ckeys, cvals, crows,
+            ctypes.c_int(priority)))
+
+    def set_optimizer(self, optimizer, native=True):
         """ Registers an optimizer with the kvstore.
 
         When using a single machine, this function updates the local optimizer.
@@ -244,10 +345,17 @@ class KVStore(object):
         it will serialized the optimizer with pickle and send it to all servers.
         The function returns after all servers have been updated.
 
+        The servers run SGD and Adam, without a learning rate scheduler or
+        multi-precision, with the ``sgd_update``, ``sgd_mom_update`` and
+        ``adam_update`` operators in their own threads instead of the python
+        updater, unless ``native`` is False.
+
         Parameters
         ----------
         optimizer : Optimizer
             The new optimizer for the store
+        native : bool, optional
+            Whether the servers may run the optimizer natively.
 
         Examples
         --------
@@ -271,6 +379,10 @@ class KVStore(object):
 
         # pylint: disable=invalid-name
         if 'dist' in self.type and is_worker.value:
+            settings = _server_optimizer_settings(optimizer) if native else None
+            if settings is not None:
+                self._send_command_to_servers(_SET_SERVER_OPTIMIZER, settings)
+                return
             # send the optimizer to server
             try:
                 # use ASCII protocol 0, might be slower, but not a big ideal
@@ -281,6 +393,36 @@ class KVStore(object):
         else:
             self._set_updater(opt.get_updater(optimizer))
 
+    def set_gradient_compression(self, compression_params):
+        """ Compresses the gradients pushed to the servers.
+
+        The workers quantize each value of the gradients to 2 bits, sending
+        `-threshold`, `0` or `threshold`, or to 1 bit, sending `-threshold` or
+        `threshold`. The error of the quantization is kept by the worker and
+        added to the next gradient. The gradients are quantized on the device
+        where they are merged, before they are copied to the host. The initial
+        values and the pulled weights are not compressed.
+
+        Only supported by the dist kvstores, and called on every worker
+        before the keys are initialized.
+
+        Parameters
+        ----------
+        compression_params : dict
+            `type` is `'2bit'`, `'1bit'` or `'none'`, and `threshold`
+            defaults to 0.5.
+
+        Examples
+        --------
+        >>> kv = mx.kv.create('dist_sync')
+        >>> kv.set_gradient_compression({'type': '2bit', 'threshold': 0.5})
+        """
+        keys = [c_str(k) for k in compression_params.keys()]
+        vals = [c_str(str(v)) for v in compression_params.values()]
+        check_call(_LIB.MXKVStoreSetGradientCompression(
+            self.handle, mx_uint(len(keys)),
+            c_array(ctypes.c_char_p, keys), c_array(ctypes.c_char_p, vals)))
+
     @property
     def type(self):
         """ Returns the type of this kvstore.
@@ -419,6 +561,9 @@ def create(name='local'):
     the KVStore also attempts to use GPU peer-to-peer communication,
     potentially accelerating the communication.
 
+    ``nccl``: Like ``device``, but the gradients are reduced and the weights are
+    broadcast between the GPUs with NCCL. Requires building with ``USE_NCCL=1``.
+
     For distributed training, KVStore also supports a number of types:
 
     ``dist_sync``: Behaves similarly to ``local`` but with one major difference.
@@ -436,7 +581,7 @@ def create(name='local'):
 
     Parameters
     ----------
-    name : {'local', 'device', 'dist_sync', 'dist_device_sync', 'dist_async'}
+    name : {'local', 'device', 'nccl', 'dist_sync', 'dist_device_sync', 'dist_async'}
         The type of KVStore.
     Returns
     -------
@@ -118,6 +118,8 @@ def _update_params_on_kvstore(param_arrays, grad_arrays, kvstore, param_names):
 def _update_params(param_arrays, grad_arrays, updater, num_device,
                    kvstore=None, param_names=None):
     """Perform update of param_arrays from grad_arrays not on kvstore."""
+    multi = hasattr(updater, 'update_multi')
+    indices, grads, weights = [], [], []
     for index, pair in enumerate(zip(param_arrays, grad_arrays)):
         arg_list, grad_list = pair
         if grad_list[0] is None:
@@ -133,7 +135,14 @@ def _update_params(param_arrays, grad_arrays, updater, num_device,
             # state for the same index but on diff devs, TODO(mli)
             # use a better solution latter
             w, g = p
-            updater(index*num_device+k, g, w)
+            if multi:
+                indices.append(index*num_device+k)
+                grads.append(g)
+                weights.append(w)
+            else:
+                updater(index*num_device+k, g, w)
+    if multi and indices:
+        updater.update_multi(indices, grads, weights)
 
 
 def _multiple_callbacks(callbacks, *args, **kwargs):
@@ -337,7 +346,7 @@ def _train_multi_device(symbol, ctx, arg_names, param_names, aux_names,
     return
 
 
-def save_checkpoint(prefix, epoch, symbol, arg_params, aux_params):
+def save_checkpoint(prefix, epoch, symbol, arg_params, aux_params, blocking=True):
     """Checkpoint the model data into file.
 
     Parameters
@@ -352,6 +361,9 @@ def save_checkpoint(prefix, epoch, symbol, arg_params, aux_params):
         Model parameter, dict of name to NDArray of net's weights.
     aux_params : dict of str to NDArray
         Model parameter, dict of name to NDArray of net's auxiliary states.
+    blocking : bool, optional
+        Whether to wait until the parameters are written. Otherwise training
+        may go on while they are, see ``mx.nd.save``.
     Notes
     -----
     - ``prefix-symbol.json`` will be saved for symbol.
@@ -360,10 +372,16 @@ def save_checkpoint(prefix, epoch, symbol, arg_params, aux_params):
     if symbol is not None:
         symbol.save('%s-symbol.json' % prefix)
 
-    save_dict = {('arg:%s' % k) : v.as_in_context(cpu()) for k, v in arg_params.items()}
-    save_dict.update({('aux:%s' % k) : v.as_in_context(cpu()) for k, v in aux_params.items()})
+    if blocking:
+        save_dict = {('arg:%s' % k) : v.as_in_context(cpu()) for k, v in arg_params.items()}
+        save_dict.update({('aux:%s' % k) : v.as_in_context(cpu())
+                          for k, v in aux_params.items()})
+    else:
+        # the asynchronous save takes its own copies
+        save_dict = {('arg:%s' % k) : v for k, v in arg_params.items()}
+        save_dict.update({('aux:%s' % k) : v for k, v in aux_params.items()})
     param_name = '%s-%04d.params' % (prefix, epoch)
-    nd.save(param_name, save_dict)
+    nd.save(param_name, save_dict, blocking=blocking)
     logging.info('Saved checkpoint to \"%s\"', param_name)
 
 
@@ -622,6 +622,17 @@ class DataParallelExecutorGroup(object):
             sliced_shapes.append(DataDesc(desc.name, tuple(shape), desc.dtype, desc.layout))
         return sliced_shapes
 
+    def set_gradient_callback(self, callback):
+        """Calls `callback` with the index of a parameter during `backward`, once its
+        gradients are scheduled on all the devices."""
+        index = {name: i for i, name in enumerate(self.param_names)}
+        def grad_callback(name, _):
+            """Drops the gradients of the inputs."""
+            if name in index:
+                callback(index[name])
+        # the devices run backward in order, so the previous ones are all scheduled
+        self.execs[-1].set_gradient_callback(grad_callback)
+
     def install_monitor(self, mon):
         """Install monitor on all executors"""
         for exe in self.execs:
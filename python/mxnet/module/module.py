@@ -22,6 +22,7 @@ more `Executor` for data parallelization.
 """
 
 import logging
+import os
 import warnings
 
 from .. import context as ctx
@@ -105,6 +106,9 @@ class Module(BaseModule):
         self._updater = None
         self._preload_opt_states = None
         self._grad_req = None
+        self._push_in_backward = False
+        self._pushed_params = set()
+        self._grad_callback_group = None
 
         self._exec_group = None
         self._data_shapes = None
@@ -610,8 +614,23 @@ class Module(BaseModule):
             on outputs that are not a loss function.
         """
         assert self.binded and self.params_initialized
+        self._push_in_backward = self.optimizer_initialized and bool(self._update_on_kvstore) \
+            and int(os.environ.get('MXNET_KVSTORE_PUSH_IN_BACKWARD', 0)) != 0
+        if self._push_in_backward and self._grad_callback_group is not self._exec_group:
+            self._exec_group.set_gradient_callback(self._push_gradient)
+            self._grad_callback_group = self._exec_group
         self._exec_group.backward(out_grads=out_grads)
 
+    def _push_gradient(self, index):
+        """Pushes the gradients of a parameter and pulls it back as soon as backward
+        schedules them, instead of in `update`."""
+        if not self._push_in_backward:
+            return
+        name = self._exec_group.param_names[index]
+        self._kvstore.push(name, self._exec_group.grad_arrays[index], priority=-index)
+        self._kvstore.pull(name, self._exec_group.param_arrays[index], priority=-index)
+        self._pushed_params.add(index)
+
     def update(self):
         """Updates parameters according to the installed optimizer and the gradients computed
         in the previous forward-backward batch.
@@ -624,8 +643,12 @@ class Module(BaseModule):
 
         self._params_dirty = True
         if self._update_on_kvstore:
+            # the parameters pushed during backward are skipped
+            grad_arrays = [[None] if i in self._pushed_params else grads
+                           for i, grads in enumerate(self._exec_group.grad_arrays)]
+            self._pushed_params = set()
             _update_params_on_kvstore(self._exec_group.param_arrays,
-                                      self._exec_group.grad_arrays,
+                                      grad_arrays,
                                       self._kvstore, self._exec_group.param_names)
         else:
             _update_params(self._exec_group.param_arrays,
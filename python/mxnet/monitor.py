@@ -28,6 +28,15 @@ from math import sqrt
 from .ndarray import NDArray
 from .base import NDArrayHandle, py_str
 from . import ndarray
+from .context import cpu
+
+
+def tensor_stats(x):
+    """Returns the statistics of `x` computed on its device in one pass: the norm,
+    the mean and the largest absolute value of its finite elements, then the numbers
+    of its NaN and infinite elements. Use it as the `stat_func` of a `Monitor` to
+    copy only these 5 values to the host."""
+    return ndarray.contrib.tensor_stats(x)
 
 
 class Monitor(object):
@@ -40,7 +49,8 @@ class Monitor(object):
     stat_func : function
         A function that computes statistics of tensors.
         Takes an `NDArray` and returns an `NDArray`. Defaults to mean
-        absolute value |x|/size(x).
+        absolute value |x|/size(x). `tensor_stats` computes the statistics used
+        to check the health of a training on the device of the tensor.
     pattern : str
         A regular expression specifying which tensors to monitor.
         Only tensors with names that match `name_pattern` will be included.
@@ -72,14 +82,14 @@ class Monitor(object):
 
     def install(self, exe):
         """install callback to executor.
-        Supports installing to multiple exes.
+        Supports installing to multiple exes. The callback is set only for the
+        monitored batches, the others run without it, in bulk.
 
         Parameters
         ----------
         exe : mx.executor.Executor
             The Executor (returned by symbol.bind) to install to.
         """
-        exe.set_monitor_callback(self.stat_helper)
         self.exes.append(exe)
 
     def tic(self):
@@ -91,6 +101,7 @@ class Monitor(object):
                     array.wait_to_read()
                 for array in exe.aux_arrays:
                     array.wait_to_read()
+                exe.set_monitor_callback(self.stat_helper)
             self.queue = []
             self.activated = True
         self.step += 1
@@ -105,6 +116,8 @@ class Monitor(object):
         res : list of """
         if not self.activated:
             return []
+        for exe in self.exes:
+            exe.set_monitor_callback(None)
         for exe in self.exes:
             for array in exe.arg_arrays:
                 array.wait_to_read()
@@ -121,10 +134,15 @@ class Monitor(object):
         res = []
         if self.sort:
             self.queue.sort(key=lambda x: x[1])
+        # start the copies of all the statistics to the host before reading any
+        queue = []
         for n, k, v_list in self.queue:
             if isinstance(v_list, NDArray):
                 v_list = [v_list]
             assert isinstance(v_list, list)
+            queue.append((n, k, [v if v.context.device_type == 'cpu' else v.copyto(cpu())
+                                 for v in v_list]))
+        for n, k, v_list in queue:
             s = ''
             for v in v_list:
                 assert isinstance(v, NDArray)
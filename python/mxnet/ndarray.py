@@ -49,18 +49,18 @@ from .ndarray_doc import _build_doc
 try:
     if int(_os.environ.get("MXNET_ENABLE_CYTHON", True)) == 0:
         from ._ctypes.ndarray import NDArrayBase, _set_ndarray_class
-        from ._ctypes.ndarray import CachedOp, _imperative_invoke
+        from ._ctypes.ndarray import CachedOp, ImperativeOp, _imperative_invoke
     elif _sys.version_info >= (3, 0):
         from ._cy3.ndarray import NDArrayBase, _set_ndarray_class, _imperative_invoke
-        from ._cy3.ndarray import CachedOp, _imperative_invoke
+        from ._cy3.ndarray import CachedOp, ImperativeOp, _imperative_invoke
     else:
         from ._cy2.ndarray import NDArrayBase, _set_ndarray_class, _imperative_invoke
-        from ._cy2.ndarray import CachedOp, _imperative_invoke
+        from ._cy2.ndarray import CachedOp, ImperativeOp, _imperative_invoke
 except ImportError:
     if int(_os.environ.get("MXNET_ENFORCE_CYTHON", False)) != 0:
         raise ImportError("Cython Module cannot be loaded but MXNET_ENFORCE_CYTHON=1")
     from ._ctypes.ndarray import NDArrayBase, _set_ndarray_class, _imperative_invoke
-    from ._ctypes.ndarray import CachedOp, _imperative_invoke
+    from ._ctypes.ndarray import CachedOp, ImperativeOp, _imperative_invoke
 # pylint: enable=unused-import
 
 # pylint: disable= no-member
@@ -86,6 +86,21 @@ _DTYPE_MX_TO_NP = {
     6 : np.int64,
 }
 
+_STORAGE_TYPE_STR_TO_ID = {
+    'undefined': -1,
+    'default': 0,
+    'row_sparse': 1,
+    'csr': 2,
+}
+
+_STORAGE_TYPE_ID_TO_STR = {v: k for k, v in _STORAGE_TYPE_STR_TO_ID.items()}
+
+# the number of int32 aux arrays of each sparse storage type
+_STORAGE_AUX_NUM = {
+    'row_sparse': 1,
+    'csr': 2,
+}
+
 _GRAD_REQ_MAP = {
     'null': 0,
     'write': 1,
@@ -128,6 +143,40 @@ def _new_alloc_handle(shape, ctx, delay_alloc, dtype=mx_real_t):
         ctypes.byref(hdl)))
     return hdl
 
+def _new_alloc_sparse_handle(stype, shape, ctx, delay_alloc, dtype=mx_real_t):
+    """Return a new handle of a sparse array, whose values and indices are
+    allocated when it is written.
+    """
+    hdl = NDArrayHandle()
+    num_aux = _STORAGE_AUX_NUM[stype]
+    aux_types = [_DTYPE_NP_TO_MX[np.int32]] * num_aux
+    check_call(_LIB.MXNDArrayCreateSparseEx(
+        ctypes.c_int(_STORAGE_TYPE_STR_TO_ID[stype]),
+        c_array(mx_uint, shape),
+        mx_uint(len(shape)),
+        ctypes.c_int(ctx.device_typeid),
+        ctypes.c_int(ctx.device_id),
+        ctypes.c_int(int(delay_alloc)),
+        ctypes.c_int(int(_DTYPE_NP_TO_MX[np.dtype(dtype).type])),
+        mx_uint(num_aux),
+        c_array(ctypes.c_int, aux_types),
+        ctypes.byref(hdl)))
+    return hdl
+
+def _new_from_shared_mem(shared_pid, shared_id, shape, dtype):
+    """Returns an array on the shared memory of ``NDArray._to_shared_mem``,
+    without a copy. It takes over the reference of the handle to the memory.
+    """
+    hdl = NDArrayHandle()
+    check_call(_LIB.MXNDArrayCreateFromSharedMem(
+        ctypes.c_int(shared_pid),
+        ctypes.c_int(shared_id),
+        c_array(mx_uint, shape),
+        mx_uint(len(shape)),
+        ctypes.c_int(int(_DTYPE_NP_TO_MX[np.dtype(dtype).type])),
+        ctypes.byref(hdl)))
+    return NDArray(hdl)
+
 def waitall():
     """Wait for all async operations to finish in MXNet.
 
@@ -841,6 +890,79 @@ fixed-size items.
             self.handle, ctypes.byref(mx_dtype)))
         return _DTYPE_MX_TO_NP[mx_dtype.value]
 
+    @property
+    def stype(self):
+        """Storage type of the array: 'default' for dense, 'row_sparse' or 'csr'.
+
+        Examples
+        --------
+        >>> x = mx.nd.zeros((2,3))
+        >>> x.stype
+        'default'
+        >>> x.tostype('csr').stype
+        'csr'
+        """
+        stype = ctypes.c_int()
+        check_call(_LIB.MXNDArrayGetStorageType(self.handle, ctypes.byref(stype)))
+        return _STORAGE_TYPE_ID_TO_STR[stype.value]
+
+    @property
+    def data(self):
+        """A dense copy of the values stored in a sparse array: the stored rows of a
+        row_sparse array, or the non-zeros of a csr array."""
+        self._check_sparse('data')
+        hdl = NDArrayHandle()
+        check_call(_LIB.MXNDArrayGetDataNDArray(self.handle, ctypes.byref(hdl)))
+        return NDArray(hdl)
+
+    @property
+    def indices(self):
+        """A dense copy of the row indices of a row_sparse array, or of the column
+        indices of a csr array."""
+        self._check_sparse('indices')
+        return self._aux_data(0 if self.stype == 'row_sparse' else 1)
+
+    @property
+    def indptr(self):
+        """A dense copy of the row offsets of a csr array."""
+        if self.stype != 'csr':
+            raise ValueError('indptr is only defined for csr arrays')
+        return self._aux_data(0)
+
+    def _check_sparse(self, name):
+        if self.stype == 'default':
+            raise ValueError('%s is only defined for sparse arrays' % name)
+
+    def _aux_data(self, i):
+        hdl = NDArrayHandle()
+        check_call(_LIB.MXNDArrayGetAuxNDArray(self.handle, mx_uint(i), ctypes.byref(hdl)))
+        return NDArray(hdl)
+
+    def tostype(self, stype):
+        """Returns a copy of the array in another storage type.
+
+        Parameters
+        ----------
+        stype : str
+            'default', 'row_sparse' or 'csr'.
+
+        Examples
+        --------
+        >>> x = mx.nd.array([[0, 1], [0, 0]])
+        >>> y = x.tostype('row_sparse')
+        >>> y.indices.asnumpy()
+        array([0], dtype=int32)
+        >>> y.tostype('default').asnumpy()
+        array([[ 0.,  1.],
+               [ 0.,  0.]], dtype=float32)
+        """
+        if stype == 'default':
+            hret = NDArray(_new_alloc_handle(self.shape, self.context, True, self.dtype))
+        else:
+            hret = NDArray(_new_alloc_sparse_handle(stype, self.shape, self.context,
+                                                    True, self.dtype))
+        return _internal._copyto(self, out=hret)
+
     @property
     # pylint: disable= invalid-name, undefined-variable
     def T(self):
@@ -904,6 +1026,8 @@ fixed-size items.
         array([[1, 1, 1],
                [1, 1, 1]], dtype=int32)
         """
+        if self.stype != 'default':
+            return self.tostype('default').asnumpy()
         data = np.empty(self.shape, dtype=self.dtype)
         check_call(_LIB.MXNDArraySyncCopyToCPU(
             self.handle,
@@ -988,7 +1112,11 @@ fixed-size items.
                 return
             return _internal._copyto(self, out=other)
         elif isinstance(other, Context):
-            hret = NDArray(_new_alloc_handle(self.shape, other, True, self.dtype))
+            if self.stype == 'default':
+                hret = NDArray(_new_alloc_handle(self.shape, other, True, self.dtype))
+            else:
+                hret = NDArray(_new_alloc_sparse_handle(self.stype, self.shape, other,
+                                                        True, self.dtype))
             return _internal._copyto(self, out=hret)
         else:
             raise TypeError('copyto does not support type ' + str(type(other)))
@@ -1042,6 +1170,36 @@ fixed-size items.
             return self
         return self.copyto(context)
 
+    def _to_shared_mem(self):
+        """Returns the handle of the memory of this array on `cpu_shared`, from
+        which another process creates an array on the same memory by
+        ``_new_from_shared_mem(*handle)``. Waits for the pending writes.
+
+        Every handle holds a reference to the memory, which keeps it after this
+        array is freed, until the array of the handle is created and freed. A
+        handle which is never used leaves its memory until the system reboots.
+
+        Returns
+        -------
+        tuple
+            The ids of the process and of the memory, the shape and the dtype.
+
+        Examples
+        --------
+        >>> x = mx.nd.empty((2, 3), ctx=mx.cpu_shared())
+        >>> x[:] = 1
+        >>> y = mx.nd._new_from_shared_mem(*x._to_shared_mem())
+        >>> y[:] = 2
+        >>> x.asnumpy()
+        array([[ 2.,  2.,  2.],
+               [ 2.,  2.,  2.]], dtype=float32)
+        """
+        shared_pid = ctypes.c_int()
+        shared_id = ctypes.c_int()
+        check_call(_LIB.MXNDArrayGetSharedMemHandle(
+            self.handle, ctypes.byref(shared_pid), ctypes.byref(shared_id)))
+        return shared_pid.value, shared_id.value, self.shape, self.dtype
+
     def attach_grad(self, grad_req='write'):
         """Attach a gradient buffer to this NDArray, so that `backward`
         can compute gradient with respect to it.
@@ -2344,7 +2502,7 @@ def load(fname):
             (py_str(names[i]), NDArray(NDArrayHandle(handles[i]))) for i in range(out_size.value))
 
 
-def save(fname, data):
+def save(fname, data, blocking=True, encoding=None):
     """Saves a list of arrays or a dict of str->array to file.
 
     Examples of filenames:
@@ -2359,6 +2517,16 @@ def save(fname, data):
         The filename.
     data : ``NDArray``, list of ``NDArray` or dict of str to ``NDArray``
         The data to save.
+    blocking : bool, optional
+        Whether to wait until the file is written. Otherwise the arrays are
+        copied to the cpu in order with their other operations, and written
+        by a background thread while they may change: ``wait_saves`` and
+        ``waitall`` wait for the saves.
+    encoding : {None, 'float16', 'int8'}, optional
+        Stores the float32 dense arrays in fp16, or in int8 with a scale per
+        array for the arrays of 2 dimensions or more, and ``load`` decodes
+        them to float32. The saved files are 2 or 4 times smaller, and are
+        not read by the versions without encodings.
 
     Examples
     --------
@@ -2393,10 +2561,26 @@ def save(fname, data):
     else:
         raise ValueError("data needs to either be a NDArray, dict of str, NDArray pairs "
                          "or a list of NDarrays.")
-    check_call(_LIB.MXNDArraySave(c_str(fname),
-                                  mx_uint(len(handles)),
-                                  c_array(NDArrayHandle, handles),
-                                  keys))
+    if encoding is not None:
+        check_call(_LIB.MXNDArraySaveEx(c_str(fname),
+                                        mx_uint(len(handles)),
+                                        c_array(NDArrayHandle, handles),
+                                        keys, c_str(encoding),
+                                        ctypes.c_int(blocking)))
+        return
+    save_fn = _LIB.MXNDArraySave if blocking else _LIB.MXNDArraySaveAsync
+    check_call(save_fn(c_str(fname),
+                       mx_uint(len(handles)),
+                       c_array(NDArrayHandle, handles),
+                       keys))
+
+
+def wait_saves():
+    """Waits for the saves of ``save`` with ``blocking=False``.
+
+    Raises an error if one of them failed.
+    """
+    check_call(_LIB.MXNDArrayWaitSaves())
 
 
 def concatenate(arrays, axis=0, always_copy=True):
@@ -2651,5 +2835,19 @@ def _init_ndarray_module(ndarray_class, root_namespace):
 
 _init_ndarray_module(NDArray, "mxnet")
 
+def _reduce_ndarray(arr):
+    """Pickles an array on `cpu_shared` as the handle of its memory in the
+    messages between processes, and the other arrays as their data.
+    """
+    if arr.context.device_type != 'cpu_shared':
+        return arr.__reduce_ex__(2)
+    return _new_from_shared_mem, arr._to_shared_mem()
+
+try:
+    from multiprocessing.reduction import ForkingPickler
+    ForkingPickler.register(NDArray, _reduce_ndarray)
+except (ImportError, AttributeError):
+    pass
+
 # from .base import add_fileline_to_docstring
 # add_fileline_to_docstring(__name__)
@@ -17,13 +17,18 @@
 
 """Weight updating functions."""
 import math
+import os
 import pickle
 import logging
 import warnings
 import numpy
 from .ndarray import (NDArray, zeros, clip, sqrt, sign, array, maximum, abs as NDabs)
 from .ndarray import (sgd_update, sgd_mom_update, adam_update, rmsprop_update, rmspropalex_update,
-                      mp_sgd_update, mp_sgd_mom_update)
+                      mp_sgd_update, mp_sgd_mom_update, mp_adam_update, mp_rmsprop_update,
+                      mp_rmspropalex_update)
+from .ndarray import (multi_sgd_update, multi_sgd_mom_update, multi_mp_sgd_update,
+                      multi_mp_sgd_mom_update, multi_adam_update, multi_lars_update,
+                      multi_mp_lars_update, multi_lamb_update, multi_mp_lamb_update)
 from .random import normal
 
 
@@ -191,6 +196,40 @@ class Optimizer(object):
         """
         raise NotImplementedError()
 
+    def update_multi(self, indices, weights, grads, states):
+        """Updates several parameters, as `update` does for each of them.
+
+        The optimizers that have a multi-tensor operator update the parameters
+        of a context by `MXNET_OPTIMIZER_AGGREGATION_SIZE` (default 4) at a
+        time with it, rather than launching an update per parameter.
+        """
+        for index, weight, grad, state in zip(indices, weights, grads, states):
+            self.update(index, weight, grad, state)
+
+    def _aggregate(self, indices, weights, grads, states, kind):
+        """Groups the parameters to update together by `kind(weight, grad, state)`,
+        which is None for the ones `update` updates alone, and by context. Returns
+        the lists of (index, weight, grad, state) of at most
+        `MXNET_OPTIMIZER_AGGREGATION_SIZE` parameters."""
+        size = max(int(os.environ.get('MXNET_OPTIMIZER_AGGREGATION_SIZE', 4)), 1)
+        groups = {}
+        order = []
+        for item in zip(indices, weights, grads, states):
+            _, weight, grad, state = item
+            key = None
+            if weight.stype == 'default' and grad.stype == 'default':
+                key = kind(weight, grad, state)
+            if key is None:
+                self.update(*item)
+                continue
+            key = (key, weight.context)
+            if key not in groups:
+                groups[key] = []
+                order.append(key)
+            groups[key].append(item)
+        return [(key[0], groups[key][i:i + size]) for key in order
+                for i in range(0, len(groups[key]), size)]
+
     def set_lr_scale(self, args_lrscale): # pylint: disable=unused-argument
         """[DEPRECATED] Sets lr scale. Use set_lr_mult instead."""
         raise DeprecationWarning
@@ -407,6 +446,40 @@ class SGD(Optimizer):
                 mp_sgd_update(weight, grad, state[1], out=weight,
                               lr=lr, wd=wd, **kwargs)
 
+    def update_multi(self, indices, weights, grads, states):
+        if type(self).update != SGD.update:
+            # the subclasses that change the update, such as NAG
+            return super(SGD, self).update_multi(indices, weights, grads, states)
+
+        def kind(weight, grad, state): # pylint: disable=unused-argument
+            if isinstance(state, (list, tuple)):
+                return 'mp_mom' if state[0] is not None else 'mp'
+            return 'mom' if state is not None else 'sgd'
+
+        for key, group in self._aggregate(indices, weights, grads, states, kind):
+            lrs, wds, data, out = [], [], [], []
+            for index, weight, grad, state in group:
+                lrs.append(self._get_lr(index))
+                wds.append(self._get_wd(index))
+                self._update_count(index)
+                data += [weight, grad]
+                if key == 'mom':
+                    data.append(state)
+                elif key == 'mp':
+                    data.append(state[1])
+                elif key == 'mp_mom':
+                    data += [state[0], state[1]]
+                out.append(weight)
+            kwargs = {'rescale_grad': self.rescale_grad, 'num_weights': len(group),
+                      'lrs': tuple(lrs), 'wds': tuple(wds)}
+            if self.clip_gradient:
+                kwargs['clip_gradient'] = self.clip_gradient
+            if key in ('mom', 'mp_mom'):
+                kwargs['momentum'] = self.momentum
+            update = {'sgd': multi_sgd_update, 'mom': multi_sgd_mom_update,
+                      'mp': multi_mp_sgd_update, 'mp_mom': multi_mp_sgd_mom_update}[key]
+            update(*data, out=out, **kwargs)
+
 @register
 class DCASGD(Optimizer):
     """The DCASGD optimizer.
@@ -554,15 +627,23 @@ class Adam(Optimizer):
         Exponential decay rate for the second moment estimates.
     epsilon : float, optional
         Small value to avoid division by 0.
+    multi_precision: bool, optional
+       ``True`` keeps a 32-bit copy of float16 weights and 32-bit moments, and updates
+       them with :class:`ndarray.mp_adam_update`, as the same option of :class:`SGD`.
     """
     def __init__(self, learning_rate=0.001, beta1=0.9, beta2=0.999, epsilon=1e-8,
-                 **kwargs):
+                 multi_precision=False, **kwargs):
         super(Adam, self).__init__(learning_rate=learning_rate, **kwargs)
         self.beta1 = beta1
         self.beta2 = beta2
         self.epsilon = epsilon
+        self.multi_precision = multi_precision
 
     def create_state(self, index, weight):
+        if self.multi_precision and weight.dtype == numpy.float16:
+            return (zeros(weight.shape, weight.context, dtype=numpy.float32),  # mean
+                    zeros(weight.shape, weight.context, dtype=numpy.float32),  # variance
+                    array(weight, ctx=weight.context, dtype=numpy.float32))  # weight32
         return (zeros(weight.shape, weight.context, dtype=weight.dtype),  # mean
                 zeros(weight.shape, weight.context, dtype=weight.dtype))  # variance
 
@@ -583,9 +664,178 @@ class Adam(Optimizer):
         if self.clip_gradient:
             kwargs['clip_gradient'] = self.clip_gradient
 
-        mean, var = state
-        adam_update(weight, grad, mean, var, out=weight,
-                    lr=lr, wd=wd, **kwargs)
+        if len(state) == 3:
+            mean, var, weight32 = state
+            mp_adam_update(weight, grad, mean, var, weight32, out=weight,
+                           lr=lr, wd=wd, **kwargs)
+        else:
+            mean, var = state
+            adam_update(weight, grad, mean, var, out=weight,
+                        lr=lr, wd=wd, **kwargs)
+
+    def update_multi(self, indices, weights, grads, states):
+        if type(self).update != Adam.update:
+            return super(Adam, self).update_multi(indices, weights, grads, states)
+        def kind(weight, grad, state): # pylint: disable=unused-argument
+            # the multi-precision states are updated one by one
+            return 'adam' if len(state) == 2 else None
+
+        for _, group in self._aggregate(indices, weights, grads, states, kind):
+            lrs, wds, data, out = [], [], [], []
+            for index, weight, grad, state in group:
+                lr = self._get_lr(index)
+                wds.append(self._get_wd(index))
+                self._update_count(index)
+                t = self._index_update_count[index]
+                lrs.append(lr * math.sqrt(1. - self.beta2**t) / (1. - self.beta1**t))
+                data += [weight, grad, state[0], state[1]]
+                out.append(weight)
+            kwargs = {'beta1': self.beta1, 'beta2': self.beta2, 'epsilon': self.epsilon,
+                      'rescale_grad': self.rescale_grad, 'num_weights': len(group),
+                      'lrs': tuple(lrs), 'wds': tuple(wds)}
+            if self.clip_gradient:
+                kwargs['clip_gradient'] = self.clip_gradient
+            multi_adam_update(*data, out=out, **kwargs)
+
+@register
+class LARS(Optimizer):
+    """The LARS optimizer, momentum SGD whose learning rate is scaled by the trust
+    ratio of each parameter.
+
+    This class implements the optimizer described in *Large Batch Training of
+    Convolutional Networks*, available at https://arxiv.org/abs/1708.03888.
+    For details of the update algorithm see :class:`~mxnet.ndarray.multi_lars_update`.
+
+    This optimizer accepts the following parameters in addition to those accepted
+    by :class:`.Optimizer`.
+
+    Parameters
+    ----------
+    momentum : float, optional
+       The momentum value.
+    eta : float, optional
+       The trust coefficient of the layer-wise learning rates.
+    epsilon : float, optional
+        Small value to avoid division by 0.
+    multi_precision: bool, optional
+       ``True`` keeps a 32-bit copy of float16 weights and a 32-bit momentum, as the
+       same option of :class:`SGD`.
+    """
+    def __init__(self, momentum=0.9, eta=0.001, epsilon=1e-8, multi_precision=False,
+                 **kwargs):
+        super(LARS, self).__init__(**kwargs)
+        self.momentum = momentum
+        self.eta = eta
+        self.epsilon = epsilon
+        self.multi_precision = multi_precision
+
+    def create_state(self, index, weight):
+        if self.multi_precision and weight.dtype == numpy.float16:
+            return (zeros(weight.shape, weight.context, dtype=numpy.float32),  # momentum
+                    array(weight, ctx=weight.context, dtype=numpy.float32))  # weight32
+        return (zeros(weight.shape, weight.context, dtype=weight.dtype), )  # momentum
+
+    def update(self, index, weight, grad, state):
+        assert(isinstance(weight, NDArray))
+        assert(isinstance(grad, NDArray))
+        self._update_group([(index, weight, grad, state)])
+
+    def update_multi(self, indices, weights, grads, states):
+        if type(self).update != LARS.update:
+            return super(LARS, self).update_multi(indices, weights, grads, states)
+        for _, group in self._aggregate(indices, weights, grads, states,
+                                        lambda weight, grad, state: len(state)):
+            self._update_group(group)
+
+    def _update_group(self, group):
+        lrs, wds, data, out = [], [], [], []
+        for index, weight, grad, state in group:
+            lrs.append(self._get_lr(index))
+            wds.append(self._get_wd(index))
+            self._update_count(index)
+            data += [weight, grad] + list(state)
+            out.append(weight)
+        kwargs = {'momentum': self.momentum, 'eta': self.eta, 'epsilon': self.epsilon,
+                  'rescale_grad': self.rescale_grad, 'num_weights': len(group),
+                  'lrs': tuple(lrs), 'wds': tuple(wds)}
+        if self.clip_gradient:
+            kwargs['clip_gradient'] = self.clip_gradient
+        update = multi_mp_lars_update if len(group[0][3]) == 2 else multi_lars_update
+        update(*data, out=out, **kwargs)
+
+@register
+class LAMB(Optimizer):
+    """The LAMB optimizer, Adam whose step is scaled by the trust ratio of each
+    parameter.
+
+    This class implements the optimizer described in *Large Batch Optimization for
+    Deep Learning: Training BERT in 76 minutes*, available at
+    https://arxiv.org/abs/1904.00962.
+    For details of the update algorithm see :class:`~mxnet.ndarray.multi_lamb_update`.
+
+    This optimizer accepts the following parameters in addition to those accepted
+    by :class:`.Optimizer`.
+
+    Parameters
+    ----------
+    beta1 : float, optional
+        Exponential decay rate for the first moment estimates.
+    beta2 : float, optional
+        Exponential decay rate for the second moment estimates.
+    epsilon : float, optional
+        Small value to avoid division by 0.
+    bias_correction : bool, optional
+        Whether the moment estimates are corrected for their initialization to 0.
+    multi_precision: bool, optional
+       ``True`` keeps a 32-bit copy of float16 weights and 32-bit moments, as the
+       same option of :class:`SGD`.
+    """
+    def __init__(self, learning_rate=0.001, beta1=0.9, beta2=0.999, epsilon=1e-6,
+                 bias_correction=True, multi_precision=False, **kwargs):
+        super(LAMB, self).__init__(learning_rate=learning_rate, **kwargs)
+        self.beta1 = beta1
+        self.beta2 = beta2
+        self.epsilon = epsilon
+        self.bias_correction = bias_correction
+        self.multi_precision = multi_precision
+
+    def create_state(self, index, weight):
+        if self.multi_precision and weight.dtype == numpy.float16:
+            return (zeros(weight.shape, weight.context, dtype=numpy.float32),  # mean
+                    zeros(weight.shape, weight.context, dtype=numpy.float32),  # variance
+                    array(weight, ctx=weight.context, dtype=numpy.float32))  # weight32
+        return (zeros(weight.shape, weight.context, dtype=weight.dtype),  # mean
+                zeros(weight.shape, weight.context, dtype=weight.dtype))  # variance
+
+    def update(self, index, weight, grad, state):
+        assert(isinstance(weight, NDArray))
+        assert(isinstance(grad, NDArray))
+        self._update_group([(index, weight, grad, state)])
+
+    def update_multi(self, indices, weights, grads, states):
+        if type(self).update != LAMB.update:
+            return super(LAMB, self).update_multi(indices, weights, grads, states)
+        for _, group in self._aggregate(indices, weights, grads, states,
+                                        lambda weight, grad, state: len(state)):
+            self._update_group(group)
+
+    def _update_group(self, group):
+        lrs, wds, steps, data, out = [], [], [], [], []
+        for index, weight, grad, state in group:
+            lrs.append(self._get_lr(index))
+            wds.append(self._get_wd(index))
+            self._update_count(index)
+            steps.append(self._index_update_count[index])
+            data += [weight, grad] + list(state)
+            out.append(weight)
+        kwargs = {'beta1': self.beta1, 'beta2': self.beta2, 'epsilon': self.epsilon,
+                  'bias_correction': self.bias_correction, 'steps': tuple(steps),
+                  'rescale_grad': self.rescale_grad, 'num_weights': len(group),
+                  'lrs': tuple(lrs), 'wds': tuple(wds)}
+        if self.clip_gradient:
+            kwargs['clip_gradient'] = self.clip_gradient
+        update = multi_mp_lamb_update if len(group[0][3]) == 3 else multi_lamb_update
+        update(*data, out=out, **kwargs)
 
 @register
 class AdaGrad(Optimizer):
@@ -656,24 +906,33 @@ class RMSProp(Optimizer):
         ``False`` will use Tieleman & Hinton's version of `RMSProp`.
     clip_weights : float, optional
         Clips weights into range ``[-clip_weights, clip_weights]``.
+    multi_precision: bool, optional
+       ``True`` keeps a 32-bit copy of float16 weights and updates it with
+       :class:`~mxnet.ndarray.mp_rmsprop_update` or
+       :class:`~mxnet.ndarray.mp_rmspropalex_update`, as the same option of :class:`SGD`.
     """
     def __init__(self, learning_rate=0.001, gamma1=0.9, gamma2=0.9,
-                 epsilon=1e-8, centered=False, clip_weights=None, **kwargs):
+                 epsilon=1e-8, centered=False, clip_weights=None, multi_precision=False,
+                 **kwargs):
         super(RMSProp, self).__init__(learning_rate=learning_rate, **kwargs)
         self.gamma1 = gamma1
         self.gamma2 = gamma2
         self.centered = centered
         self.epsilon = epsilon
         self.clip_weights = clip_weights
+        self.multi_precision = multi_precision
 
     def create_state(self, index, weight):
         if self.centered:
-            return (
+            state = (
                 zeros(weight.shape, weight.context),  # n
                 zeros(weight.shape, weight.context),  # g
                 zeros(weight.shape, weight.context))  # delta
         else:
-            return (zeros(weight.shape, weight.context), )  # n
+            state = (zeros(weight.shape, weight.context), )  # n
+        if self.multi_precision and weight.dtype == numpy.float16:
+            state += (array(weight, ctx=weight.context, dtype=numpy.float32), )  # weight32
+        return state
 
     def update(self, index, weight, grad, state):
         assert(isinstance(weight, NDArray))
@@ -692,13 +951,23 @@ class RMSProp(Optimizer):
             kwargs['clip_weights'] = self.clip_weights
 
         if not self.centered:
-            (n, ) = state
-            rmsprop_update(
-                weight, grad, n, out=weight, lr=lr, wd=wd, **kwargs)
+            if len(state) == 2:
+                n, weight32 = state
+                mp_rmsprop_update(
+                    weight, grad, n, weight32, out=weight, lr=lr, wd=wd, **kwargs)
+            else:
+                (n, ) = state
+                rmsprop_update(
+                    weight, grad, n, out=weight, lr=lr, wd=wd, **kwargs)
         else:
-            n, g, delta = state
-            rmspropalex_update(weight, grad, n, g, delta, out=weight,
-                               lr=lr, wd=wd, **kwargs)
+            if len(state) == 4:
+                n, g, delta, weight32 = state
+                mp_rmspropalex_update(weight, grad, n, g, delta, weight32, out=weight,
+                                      lr=lr, wd=wd, **kwargs)
+            else:
+                n, g, delta = state
+                rmspropalex_update(weight, grad, n, g, delta, out=weight,
+                                   lr=lr, wd=wd, **kwargs)
 
 @register
 class AdaDelta(Optimizer):
@@ -946,6 +1215,15 @@ class Updater(object):
 
     def __call__(self, index, grad, weight):
         """Updates weight given gradient and index."""
+        self.optimizer.update(index, weight, grad, self._state(index, weight))
+
+    def update_multi(self, indices, grads, weights):
+        """Updates the weights given their gradients and indices, together when
+        the optimizer can."""
+        states = [self._state(i, w) for i, w in zip(indices, weights)]
+        self.optimizer.update_multi(indices, weights, grads, states)
+
+    def _state(self, index, weight):
         if index not in self.states:
             self.states[index] = self.optimizer.create_state(index, weight)
             self.states_synced[index] = True
@@ -953,7 +1231,7 @@ class Updater(object):
             self.states[index] = \
                 self.sync_state_context(self.states[index], weight.context)
             self.states_synced[index] = True
-        self.optimizer.update(index, weight, grad, self.states[index])
+        return self.states[index]
 
     def sync_state_context(self, state, context):
         if isinstance(state, NDArray):
@@ -22,9 +22,10 @@
 from __future__ import absolute_import
 
 import ctypes
-from .base import _LIB, check_call, c_str
+from .base import _LIB, check_call, c_str, py_str
 
-def profiler_set_config(mode='symbolic', filename='profile.json'):
+def profiler_set_config(mode='symbolic', filename='profile.json', aggregate=False,
+                        memory=False):
     """Set up the configure of profiler.
 
     Parameters
@@ -34,11 +35,21 @@ def profiler_set_config(mode='symbolic', filename='profile.json'):
         be 'symbolic', or 'all'. Defaults to `symbolic`.
     filename : string, optional
         The name of output trace file. Defaults to 'profile.json'.
+    aggregate : bool, optional
+        Only keep the count, total, min and max time of the operators of each
+        name and device, instead of a trace event for every execution. The
+        output file is then the table of these statistics.
+    memory : bool, optional
+        Also record the allocations and releases of memory, with the operator
+        or the executor bind that caused them, and the bytes in use of each
+        device as a counter of the trace.
     """
     mode2int = {'symbolic': 0, 'all': 1}
     check_call(_LIB.MXSetProfilerConfig(
         ctypes.c_int(mode2int[mode]),
         c_str(filename)))
+    check_call(_LIB.MXSetProfilerAggregate(ctypes.c_int(int(aggregate))))
+    check_call(_LIB.MXSetProfilerMemory(ctypes.c_int(int(memory))))
 
 def profiler_set_state(state='stop'):
     """Set up the profiler state to record operator.
@@ -56,3 +67,40 @@ def dump_profile():
     """Dump profile and stop profiler. Use this to save profile
     in advance in case your program cannot exit normally."""
     check_call(_LIB.MXDumpProfile())
+
+def dumps(reset=False):
+    """Return the aggregate statistics of the profiler as a table.
+
+    Parameters
+    ----------
+    reset : bool, optional
+        Clear the statistics after printing them.
+    """
+    debug_str = ctypes.c_char_p()
+    check_call(_LIB.MXAggregateProfileStatsPrint(ctypes.byref(debug_str),
+                                                 ctypes.c_int(int(reset))))
+    return py_str(debug_str.value)
+
+def set_ring_buffer(capacity):
+    """Keep only the last events finished by each thread, in preallocated
+    rings, so that the profiler can stay on in a long running job.
+
+    Parameters
+    ----------
+    capacity : int
+        The number of events per thread, 0 to keep all events. The threads
+        that already have a ring keep its size.
+    """
+    check_call(_LIB.MXSetProfilerRingBuffer(ctypes.c_int(capacity)))
+
+def dump_ring(filename='profile.json', seconds=0):
+    """Save the events of the rings as a trace file, without stopping the profiler.
+
+    Parameters
+    ----------
+    filename : string, optional
+        The name of output trace file.
+    seconds : float, optional
+        Only save the events that ended in the last seconds, all of them if 0.
+    """
+    check_call(_LIB.MXDumpProfileRing(c_str(filename), ctypes.c_float(seconds)))
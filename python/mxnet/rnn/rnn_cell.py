@@ -532,8 +532,8 @@ class GRUCell(BaseRNNCell):
 
 class FusedRNNCell(BaseRNNCell):
     """Fusing RNN layers across time step into one kernel.
-    Improves speed but is less flexible. Currently only
-    supported if using cuDNN on GPU.
+    Improves speed but is less flexible. Runs with cuDNN on GPU, the CPU
+    version does not support dropout between the layers in training.
 
     Parameters
     ----------
@@ -0,0 +1,140 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+# coding: utf-8
+"""Constructors of the sparse NDArrays.
+
+A ``row_sparse`` array stores a subset of the rows of a dense array together
+with their sorted row ``indices``, the other rows are zeros. A ``csr`` array
+stores the non-zeros of a 2-D array row by row, with their column ``indices``
+and the row offsets ``indptr``. Both are ``NDArray`` objects whose ``stype``
+tells the storage, and ``tostype`` converts between the storage types.
+"""
+from __future__ import absolute_import
+
+import ctypes
+import numpy as np
+from .base import _LIB, check_call, mx_real_t
+from .context import current_context, cpu
+from .ndarray import NDArray, _new_alloc_sparse_handle, array
+
+__all__ = ['csr_matrix', 'row_sparse_array', 'zeros']
+
+
+def _from_parts(stype, shape, ctx, dtype, data, aux):
+    """Builds a sparse array on the cpu from its values and aux arrays, then
+    moves it to ctx."""
+    ctx = current_context() if ctx is None else ctx
+    if dtype is None:
+        dtype = data.dtype if isinstance(data, (NDArray, np.ndarray)) else mx_real_t
+    cpu_ctx = cpu()
+    arr = NDArray(_new_alloc_sparse_handle(stype, shape, cpu_ctx, True, dtype))
+    for i, a in enumerate(aux):
+        src = array(a, ctx=cpu_ctx, dtype=np.int32)
+        check_call(_LIB.MXNDArraySyncCopyFromNDArray(arr.handle, src.handle, ctypes.c_int(i)))
+    src = array(data, ctx=cpu_ctx, dtype=dtype)
+    check_call(_LIB.MXNDArraySyncCopyFromNDArray(arr.handle, src.handle, ctypes.c_int(-1)))
+    if ctx != cpu_ctx:
+        arr = arr.copyto(ctx)
+    return arr
+
+
+def csr_matrix(data, indices, indptr, shape, ctx=None, dtype=None):
+    """Creates a 2-D ``csr`` array.
+
+    Parameters
+    ----------
+    data : array_like
+        The non-zeros, row by row.
+    indices : array_like
+        The column of each non-zero.
+    indptr : array_like
+        The offsets of the rows in ``data``, of length ``shape[0] + 1``.
+    shape : tuple of int
+        The dense shape of the array.
+    ctx : Context, optional
+        Device context (default is the current default context).
+    dtype : str or numpy.dtype, optional
+        The type of the values, the type of ``data`` by default.
+
+    Examples
+    --------
+    >>> a = mx.sparse_nd.csr_matrix([1, 2, 3], [1, 0, 2], [0, 1, 1, 3], (3, 3))
+    >>> a.asnumpy()
+    array([[ 0.,  1.,  0.],
+           [ 0.,  0.,  0.],
+           [ 2.,  0.,  3.]], dtype=float32)
+    """
+    if len(shape) != 2:
+        raise ValueError('csr arrays are 2-D, got shape %s' % str(shape))
+    return _from_parts('csr', shape, ctx, dtype, data, [indptr, indices])
+
+
+def row_sparse_array(data, indices, shape, ctx=None, dtype=None):
+    """Creates a ``row_sparse`` array.
+
+    Parameters
+    ----------
+    data : array_like
+        The stored rows, of shape ``(len(indices),) + shape[1:]``.
+    indices : array_like
+        The sorted indices of the stored rows.
+    shape : tuple of int
+        The dense shape of the array.
+    ctx : Context, optional
+        Device context (default is the current default context).
+    dtype : str or numpy.dtype, optional
+        The type of the values, the type of ``data`` by default.
+
+    Examples
+    --------
+    >>> a = mx.sparse_nd.row_sparse_array([[1, 2]], [1], (3, 2))
+    >>> a.asnumpy()
+    array([[ 0.,  0.],
+           [ 1.,  2.],
+           [ 0.,  0.]], dtype=float32)
+    """
+    if dtype is None:
+        dtype = data.dtype if isinstance(data, (NDArray, np.ndarray)) else mx_real_t
+    data = data.asnumpy() if isinstance(data, NDArray) else data
+    indices = np.asarray(indices, dtype=np.int32)
+    data = np.asarray(data, dtype=dtype).reshape((len(indices),) + tuple(shape[1:]))
+    return _from_parts('row_sparse', shape, ctx, dtype, data, [indices])
+
+
+def zeros(stype, shape, ctx=None, dtype=None):
+    """Creates a sparse array of zeros, which stores no value.
+
+    Parameters
+    ----------
+    stype : str
+        'row_sparse' or 'csr'.
+    shape : tuple of int
+        The dense shape of the array.
+    ctx : Context, optional
+        Device context (default is the current default context).
+    dtype : str or numpy.dtype, optional
+        The type of the values, float32 by default.
+    """
+    dtype = mx_real_t if dtype is None else dtype
+    if stype == 'csr':
+        return csr_matrix(np.zeros((0,), dtype=dtype), np.zeros((0,), dtype=np.int32),
+                          np.zeros((shape[0] + 1,), dtype=np.int32), shape, ctx, dtype)
+    if stype == 'row_sparse':
+        return row_sparse_array(np.zeros((0,) + tuple(shape[1:]), dtype=dtype),
+                                np.zeros((0,), dtype=np.int32), shape, ctx, dtype)
+    raise ValueError('unknown sparse storage type %s' % stype)
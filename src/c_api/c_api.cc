@@ -29,8 +29,10 @@
 #include <dmlc/omp.h>
 #include <mxnet/base.h>
 #include <mxnet/ndarray.h>
+#include <mxnet/engine.h>
 #include <mxnet/operator.h>
 #include <mxnet/io.h>
+#include <mxnet/storage.h>
 #include <mxnet/c_api.h>
 #include <mxnet/kvstore.h>
 #include <mxnet/mxrtc.h>
@@ -41,9 +43,11 @@
 #include <memory>
 #include <functional>
 #include <utility>
+#include <cstring>
 #include "./c_api_common.h"
 #include "../operator/custom/custom-inl.h"
 #include "../engine/profiler.h"
+#include "../io/iter_stats.h"
 
 using namespace mxnet;
 
@@ -119,6 +123,59 @@ int MXDumpProfile() {
   API_END()
 }
 
+int MXSetProfilerAggregate(int aggregate) {
+  API_BEGIN();
+#if MXNET_USE_PROFILER
+  engine::Profiler::Get()->SetAggregate(aggregate != 0);
+#else
+  LOG(FATAL) << "Need to compile with USE_PROFILER=1 for MXNet Profiler";
+#endif
+  API_END();
+}
+
+int MXSetProfilerMemory(int memory) {
+  API_BEGIN();
+#if MXNET_USE_PROFILER
+  engine::Profiler::Get()->SetMemory(memory != 0);
+#else
+  LOG(FATAL) << "Need to compile with USE_PROFILER=1 for MXNet Profiler";
+#endif
+  API_END();
+}
+
+int MXAggregateProfileStatsPrint(const char **out_str, int reset) {
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+#if MXNET_USE_PROFILER
+  ret->ret_str = engine::Profiler::Get()->AggregateStats(reset != 0);
+  *out_str = ret->ret_str.c_str();
+#else
+  LOG(FATAL) << "Need to compile with USE_PROFILER=1 for MXNet Profiler";
+#endif
+  API_END();
+}
+
+int MXSetProfilerRingBuffer(int capacity) {
+  API_BEGIN();
+#if MXNET_USE_PROFILER
+  CHECK_GE(capacity, 0) << "The ring capacity must not be negative";
+  engine::Profiler::Get()->SetRingBuffer(static_cast<size_t>(capacity));
+#else
+  LOG(FATAL) << "Need to compile with USE_PROFILER=1 for MXNet Profiler";
+#endif
+  API_END();
+}
+
+int MXDumpProfileRing(const char* filename, float seconds) {
+  API_BEGIN();
+#if MXNET_USE_PROFILER
+  engine::Profiler::Get()->DumpRing(std::string(filename), seconds);
+#else
+  LOG(FATAL) << "Need to compile with USE_PROFILER=1 for MXNet Profiler";
+#endif
+  API_END();
+}
+
 int MXSetProfilerState(int state) {
   // state, kNotRunning: 0, kRunning: 1
   API_BEGIN();
@@ -136,6 +193,43 @@ int MXSetNumOMPThreads(int thread_num) {
   API_END();
 }
 
+int MXEngineSetBulkSize(int bulk_size, int* prev_bulk_size) {
+  API_BEGIN();
+  CHECK_GE(bulk_size, 0) << "the bulk size must not be negative";
+  *prev_bulk_size = Engine::Get()->set_bulk_size(bulk_size);
+  API_END();
+}
+
+int MXEngineSetInline(int enable, int* prev_enable) {
+  API_BEGIN();
+  *prev_enable = Engine::Get()->set_inline(enable != 0);
+  API_END();
+}
+
+int MXStorageGetStats(int dev_type,
+                      int dev_id,
+                      mx_uint *out_size,
+                      const char ***out_keys,
+                      const uint64_t **out_vals) {
+  static const char* kNames[] = {
+    "bytes_in_use", "peak_bytes_in_use", "bytes_reserved", "peak_bytes_reserved",
+    "bytes_pooled", "largest_pooled_block", "num_allocs", "num_pool_hits"
+  };
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  Context ctx = Context::Create(static_cast<Context::DeviceType>(dev_type), dev_id);
+  Storage::Stats stats = Storage::Get()->GetStats(ctx);
+  ret->ret_vec_uint64 = {stats.bytes_in_use, stats.peak_bytes_in_use,
+                         stats.bytes_reserved, stats.peak_bytes_reserved,
+                         stats.bytes_pooled, stats.largest_pooled_block,
+                         stats.num_allocs, stats.num_pool_hits};
+  ret->ret_vec_charp.assign(kNames, kNames + ret->ret_vec_uint64.size());
+  *out_size = static_cast<mx_uint>(ret->ret_vec_uint64.size());
+  *out_keys = dmlc::BeginPtr(ret->ret_vec_charp);
+  *out_vals = dmlc::BeginPtr(ret->ret_vec_uint64);
+  API_END();
+}
+
 int MXNDArrayCreateNone(NDArrayHandle *out) {
   API_BEGIN();
   *out = new NDArray();
@@ -172,6 +266,46 @@ int MXNDArrayCreateEx(const mx_uint *shape,
   API_END();
 }
 
+int MXNDArrayGetSharedMemHandle(NDArrayHandle handle,
+                                int *shared_pid,
+                                int *shared_id) {
+  API_BEGIN();
+  static_cast<NDArray*>(handle)->GetSharedMemHandle(shared_pid, shared_id);
+  API_END();
+}
+
+int MXNDArrayCreateFromSharedMem(int shared_pid,
+                                 int shared_id,
+                                 const mx_uint *shape,
+                                 mx_uint ndim,
+                                 int dtype,
+                                 NDArrayHandle *out) {
+  API_BEGIN();
+  *out = new NDArray(shared_pid, shared_id, TShape(shape, shape + ndim), dtype);
+  API_END();
+}
+
+int MXNDArrayCreateSparseEx(int storage_type,
+                            const mx_uint *shape,
+                            mx_uint ndim,
+                            int dev_type,
+                            int dev_id,
+                            int delay_alloc,
+                            int dtype,
+                            mx_uint num_aux,
+                            int *aux_type,
+                            NDArrayHandle *out) {
+  API_BEGIN();
+  *out = new NDArray(
+      static_cast<NDArrayStorageType>(storage_type),
+      TShape(shape, shape + ndim),
+      Context::Create(static_cast<Context::DeviceType>(dev_type), dev_id),
+      delay_alloc != 0,
+      dtype,
+      std::vector<int>(aux_type, aux_type + num_aux));
+  API_END();
+}
+
 int MXNDArrayLoadFromRawBytes(const void *buf,
                               size_t size,
                               NDArrayHandle *out) {
@@ -215,6 +349,34 @@ int MXNDArraySyncCopyToCPU(NDArrayHandle handle,
   API_END();
 }
 
+int MXNDArrayAsyncCopyFromCPU(NDArrayHandle handle,
+                              const void *data,
+                              size_t size,
+                              MXNDArrayCopyCallback callback,
+                              void *callback_param) {
+  API_BEGIN();
+  std::function<void()> on_complete;
+  if (callback != nullptr) {
+    on_complete = [callback, callback_param]() { callback(callback_param); };
+  }
+  static_cast<NDArray*>(handle)->AsyncCopyFromCPU(data, size, on_complete);
+  API_END();
+}
+
+int MXNDArrayAsyncCopyToCPU(NDArrayHandle handle,
+                            void *data,
+                            size_t size,
+                            MXNDArrayCopyCallback callback,
+                            void *callback_param) {
+  API_BEGIN();
+  std::function<void()> on_complete;
+  if (callback != nullptr) {
+    on_complete = [callback, callback_param]() { callback(callback_param); };
+  }
+  static_cast<NDArray*>(handle)->AsyncCopyToCPU(data, size, on_complete);
+  API_END();
+}
+
 int MXNDArrayWaitToRead(NDArrayHandle handle) {
   API_BEGIN();
   static_cast<NDArray*>(handle)->WaitToRead();
@@ -256,6 +418,67 @@ int MXNDArraySave(const char* fname,
   API_END();
 }
 
+int MXNDArraySaveAsync(const char* fname,
+                       mx_uint num_args,
+                       NDArrayHandle* args,
+                       const char** keys) {
+  API_BEGIN();
+  std::vector<NDArray> data(num_args);
+  std::vector<std::string> names;
+  for (mx_uint i = 0; i < num_args; ++i) {
+    data[i] = *static_cast<NDArray*>(args[i]);
+  }
+  if (keys != nullptr) {
+    names.resize(num_args);
+    for (mx_uint i = 0; i < num_args; ++i) {
+      names[i] = keys[i];
+    }
+  }
+  mxnet::NDArray::SaveAsync(fname, data, names);
+  API_END();
+}
+
+int MXNDArrayWaitSaves() {
+  API_BEGIN();
+  mxnet::NDArray::WaitSaves();
+  API_END();
+}
+
+int MXNDArraySaveEx(const char* fname,
+                    mx_uint num_args,
+                    NDArrayHandle* args,
+                    const char** keys,
+                    const char* encoding,
+                    int blocking) {
+  API_BEGIN();
+  std::vector<NDArray> data(num_args);
+  std::vector<std::string> names;
+  for (mx_uint i = 0; i < num_args; ++i) {
+    data[i] = *static_cast<NDArray*>(args[i]);
+  }
+  if (keys != nullptr) {
+    names.resize(num_args);
+    for (mx_uint i = 0; i < num_args; ++i) {
+      names[i] = keys[i];
+    }
+  }
+  int enc = mxnet::kSaveRaw;
+  if (!strcmp(encoding, "float16")) {
+    enc = mxnet::kSaveFloat16;
+  } else if (!strcmp(encoding, "int8")) {
+    enc = mxnet::kSaveInt8;
+  } else {
+    CHECK(!strcmp(encoding, "raw")) << "Unknown encoding " << encoding;
+  }
+  if (blocking) {
+    std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(fname, "w"));
+    mxnet::NDArray::Save(fo.get(), data, names, enc);
+  } else {
+    mxnet::NDArray::SaveAsync(fname, data, names, enc);
+  }
+  API_END();
+}
+
 int MXNDArrayLoad(const char* fname,
                   mx_uint *out_size,
                   NDArrayHandle** out_arr,
@@ -266,7 +489,10 @@ int MXNDArrayLoad(const char* fname,
   API_BEGIN();
   std::vector<NDArray> data;
   std::vector<std::string> &names = ret->ret_vec_str;
-  {
+  static const bool mapped = dmlc::GetEnv("MXNET_NDARRAY_LOAD_MMAP", false);
+  if (mapped && std::string(fname).find("://") == std::string::npos) {
+    mxnet::NDArray::LoadMapped(fname, &data, &names);
+  } else {
     std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(fname, "r"));
     mxnet::NDArray::Load(fi.get(), &data, &names);
   }
@@ -287,9 +513,38 @@ int MXNDArrayLoad(const char* fname,
   API_END();
 }
 
+/*!
+ * \brief the handles freed by MXNDArrayFree, reused for the views so that the
+ *  slices taken every batch do not allocate their handles
+ */
+struct NDArrayHandlePool {
+  /*! \brief the number of handles kept by a thread */
+  static const size_t kMaxHandles = 256;
+  std::vector<NDArray*> handles;
+  ~NDArrayHandlePool() {
+    for (NDArray* p : handles) delete p;
+  }
+  inline NDArray* Get() {
+    if (handles.empty()) return new NDArray();
+    NDArray* p = handles.back();
+    handles.pop_back();
+    return p;
+  }
+  inline void Release(NDArray* p) {
+    if (handles.size() >= kMaxHandles) {
+      delete p;
+      return;
+    }
+    // releases the chunk now, as the delete would
+    *p = NDArray();
+    handles.push_back(p);
+  }
+};
+typedef dmlc::ThreadLocalStore<NDArrayHandlePool> NDArrayHandlePoolStore;
+
 int MXNDArrayFree(NDArrayHandle handle) {
   API_BEGIN();
-  delete static_cast<NDArray*>(handle);
+  NDArrayHandlePoolStore::Get()->Release(static_cast<NDArray*>(handle));
   API_END();
 }
 
@@ -297,7 +552,7 @@ int MXNDArraySlice(NDArrayHandle handle,
                    mx_uint slice_begin,
                    mx_uint slice_end,
                    NDArrayHandle *out) {
-  NDArray *ptr = new NDArray();
+  NDArray *ptr = NDArrayHandlePoolStore::Get()->Get();
   API_BEGIN();
   *ptr = static_cast<NDArray*>(handle)->Slice(
       slice_begin, slice_end);
@@ -308,7 +563,7 @@ int MXNDArraySlice(NDArrayHandle handle,
 int MXNDArrayAt(NDArrayHandle handle,
                 mx_uint idx,
                 NDArrayHandle *out) {
-  NDArray *ptr = new NDArray();
+  NDArray *ptr = NDArrayHandlePoolStore::Get()->Get();
   API_BEGIN();
   *ptr = static_cast<NDArray*>(handle)->At(idx);
   *out = ptr;
@@ -319,7 +574,7 @@ MXNET_DLL int MXNDArrayReshape(NDArrayHandle handle,
                                int ndim,
                                int *dims,
                                NDArrayHandle *out) {
-  NDArray *ptr = new NDArray();
+  NDArray *ptr = NDArrayHandlePoolStore::Get()->Get();
   API_BEGIN();
   NDArray *arr = static_cast<NDArray*>(handle);
   TShape new_shape(dims, dims+ndim);
@@ -400,6 +655,50 @@ int MXNDArrayGetDType(NDArrayHandle handle,
   API_END();
 }
 
+int MXNDArrayGetStorageType(NDArrayHandle handle,
+                            int *out_storage_type) {
+  API_BEGIN();
+  NDArray *arr = static_cast<NDArray*>(handle);
+  *out_storage_type = arr->storage_type();
+  API_END();
+}
+
+int MXNDArrayGetAuxType(NDArrayHandle handle,
+                        mx_uint i,
+                        int *out_type) {
+  API_BEGIN();
+  NDArray *arr = static_cast<NDArray*>(handle);
+  *out_type = arr->aux_type(i);
+  API_END();
+}
+
+int MXNDArrayGetAuxNDArray(NDArrayHandle handle,
+                           mx_uint i,
+                           NDArrayHandle *out) {
+  API_BEGIN();
+  NDArray *arr = static_cast<NDArray*>(handle);
+  *out = new NDArray(arr->aux_ndarray(i));
+  API_END();
+}
+
+int MXNDArrayGetDataNDArray(NDArrayHandle handle,
+                            NDArrayHandle *out) {
+  API_BEGIN();
+  NDArray *arr = static_cast<NDArray*>(handle);
+  *out = new NDArray(arr->data_ndarray());
+  API_END();
+}
+
+int MXNDArraySyncCopyFromNDArray(NDArrayHandle handle_dst,
+                                 const NDArrayHandle handle_src,
+                                 const int i) {
+  API_BEGIN();
+  NDArray *dst = static_cast<NDArray*>(handle_dst);
+  NDArray *src = static_cast<NDArray*>(handle_src);
+  dst->SyncCopyFromNDArray(*src, i);
+  API_END();
+}
+
 int MXNDArrayGetContext(NDArrayHandle handle,
                         int *out_dev_type,
                         int *out_dev_id) {
@@ -566,12 +865,14 @@ int MXDataIterCreateIter(DataIterCreator creator,
     kwargs.push_back({std::string(keys[i]), std::string(vals[i])});
   }
   iter->Init(kwargs);
+  io::IterRegistry::Get()->Add(e->name, iter);
   *out = iter;
   API_END_HANDLE_ERROR(delete iter);
 }
 
 int MXDataIterFree(DataIterHandle handle) {
   API_BEGIN();
+  io::IterRegistry::Get()->Remove(static_cast<IIterator<DataBatch> *>(handle));
   delete static_cast<IIterator<DataBatch> *>(handle);
   API_END();
 }
@@ -604,6 +905,26 @@ int MXDataIterGetLabel(DataIterHandle handle, NDArrayHandle *out) {
   API_END();
 }
 
+int MXDataIterGetStats(DataIterHandle handle, mx_uint *out_size, const char ***out_keys,
+                       uint64_t **out_values) {
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  io::IterStatList stats;
+  static_cast<IIterator<DataBatch>* >(handle)->GetStats(&stats);
+  ret->ret_vec_str.clear();
+  ret->ret_vec_charp.clear();
+  ret->ret_vec_uint64.clear();
+  for (const auto& s : stats) {
+    ret->ret_vec_str.push_back(s.first);
+    ret->ret_vec_uint64.push_back(s.second);
+  }
+  for (const auto& s : ret->ret_vec_str) ret->ret_vec_charp.push_back(s.c_str());
+  *out_size = static_cast<mx_uint>(stats.size());
+  *out_keys = dmlc::BeginPtr(ret->ret_vec_charp);
+  *out_values = dmlc::BeginPtr(ret->ret_vec_uint64);
+  API_END();
+}
+
 int MXDataIterGetIndex(DataIterHandle handle, uint64_t **out_index, uint64_t *out_size) {
   API_BEGIN();
   const DataBatch& db = static_cast<IIterator<DataBatch>* >(handle)->Value();
@@ -735,6 +1056,44 @@ int MXKVStorePullEx(KVStoreHandle handle,
   API_END();
 }
 
+int MXKVStorePushRowSparseEx(KVStoreHandle handle,
+                             mx_uint num,
+                             const char** keys,
+                             NDArrayHandle* vals,
+                             NDArrayHandle* row_ids,
+                             int priority) {
+  API_BEGIN();
+  std::vector<std::string> v_keys(num);
+  std::vector<NDArray> v_vals(num);
+  std::vector<NDArray> v_row_ids(num);
+  for (mx_uint i = 0; i < num; ++i) {
+    v_keys[i] = keys[i];
+    v_vals[i] = *static_cast<NDArray*>(vals[i]);
+    v_row_ids[i] = *static_cast<NDArray*>(row_ids[i]);
+  }
+  static_cast<KVStore*>(handle)->PushRowSparse(v_keys, v_vals, v_row_ids, priority);
+  API_END();
+}
+
+int MXKVStorePullRowSparseEx(KVStoreHandle handle,
+                             mx_uint num,
+                             const char** keys,
+                             NDArrayHandle* vals,
+                             NDArrayHandle* row_ids,
+                             int priority) {
+  API_BEGIN();
+  std::vector<std::string> v_keys(num);
+  std::vector<NDArray*> v_vals(num);
+  std::vector<NDArray> v_row_ids(num);
+  for (mx_uint i = 0; i < num; ++i) {
+    v_keys[i] = keys[i];
+    v_vals[i] = static_cast<NDArray*>(vals[i]);
+    v_row_ids[i] = *static_cast<NDArray*>(row_ids[i]);
+  }
+  static_cast<KVStore*>(handle)->PullRowSparse(v_keys, v_vals, v_row_ids, priority);
+  API_END();
+}
+
 int MXKVStoreSetUpdater(KVStoreHandle handle,
                         MXKVStoreUpdater updater,
                         void* updater_handle) {
@@ -778,6 +1137,19 @@ int MXKVStoreSetBarrierBeforeExit(KVStoreHandle handle,
   API_END();
 }
 
+int MXKVStoreSetGradientCompression(KVStoreHandle handle,
+                                    mx_uint num_params,
+                                    const char** keys,
+                                    const char** vals) {
+  API_BEGIN();
+  std::vector<std::pair<std::string, std::string> > kwargs;
+  for (mx_uint i = 0; i < num_params; ++i) {
+    kwargs.push_back(std::make_pair(keys[i], vals[i]));
+  }
+  static_cast<KVStore*>(handle)->SetGradientCompression(kwargs);
+  API_END();
+}
+
 int MXInitPSEnv(mx_uint num_vars,
                 const char **keys,
                 const char **vals) {
@@ -25,6 +25,9 @@
 #include <mxnet/c_api.h>
 #include <mxnet/executor.h>
 #include "./c_api_common.h"
+#include "../executor/bucketing_executor.h"
+#include "../executor/executor_group.h"
+#include "../executor/pipeline_executor.h"
 
 int MXExecutorPrint(ExecutorHandle handle, const char **out_str) {
   Executor *exec = static_cast<Executor*>(handle);
@@ -494,11 +497,336 @@ int MXExecutorSetMonitorCallback(ExecutorHandle handle,
   API_BEGIN();
   ExecutorMonitorCallback callback_temp = callback;
   void* callback_handle_temp = callback_handle;
+  std::function<void(const char*, void*)> clbk;
+  if (callback != nullptr) {
+    clbk = [callback_temp, callback_handle_temp](const char *name, void* handle) {
+      callback_temp(name, handle, callback_handle_temp);
+    };
+  }
+  Executor *exec = static_cast<Executor*>(handle);
+  exec->SetMonitorCallback(clbk);
+  API_END();
+}
+
+int MXExecutorSetGradientCallback(ExecutorHandle handle,
+                                  ExecutorMonitorCallback callback,
+                                  void* callback_handle) {
+  API_BEGIN();
+  ExecutorMonitorCallback callback_temp = callback;
+  void* callback_handle_temp = callback_handle;
   std::function<void(const char*, void*)> clbk
   = [callback_temp, callback_handle_temp](const char *name, void* handle) {
     callback_temp(name, handle, callback_handle_temp);
   };
   Executor *exec = static_cast<Executor*>(handle);
-  exec->SetMonitorCallback(clbk);
+  exec->SetGradientCallback(clbk);
+  API_END();
+}
+
+int MXBucketingExecutorCreate(int default_bucket_key,
+                              SymbolHandle symbol_handle,
+                              int dev_type,
+                              int dev_id,
+                              mx_uint num_map_keys,
+                              const char** map_keys,
+                              const int* map_dev_types,
+                              const int* map_dev_ids,
+                              mx_uint len,
+                              NDArrayHandle *in_args,
+                              NDArrayHandle *arg_grad_store,
+                              mx_uint *grad_req_type,
+                              mx_uint aux_states_len,
+                              NDArrayHandle *aux_states,
+                              BucketingExecutorHandle *out) {
+  API_BEGIN();
+  nnvm::Symbol *symb = static_cast<nnvm::Symbol*>(symbol_handle);
+  Context ctx = Context::Create(static_cast<Context::DeviceType>(dev_type), dev_id);
+  std::map<std::string, Context> ctx_map;
+  for (mx_uint i = 0; i < num_map_keys; ++i) {
+    ctx_map[std::string(map_keys[i])] = Context::Create(
+        static_cast<Context::DeviceType>(map_dev_types[i]), map_dev_ids[i]);
+  }
+  NDArray **in_args_ptr = reinterpret_cast<NDArray**>(in_args);
+  NDArray **arg_grad_ptr = reinterpret_cast<NDArray**>(arg_grad_store);
+  NDArray **aux_states_ptr = reinterpret_cast<NDArray**>(aux_states);
+  std::vector<NDArray> in_args_vec;
+  std::vector<NDArray> arg_grad_vec;
+  std::vector<OpReqType> grad_req_vec;
+  std::vector<NDArray> aux_states_vec;
+  for (mx_uint i = 0; i < len; ++i) {
+    in_args_vec.push_back(*(in_args_ptr[i]));
+    if (arg_grad_ptr[i] == nullptr) {
+      arg_grad_vec.push_back(NDArray());
+      grad_req_vec.push_back(kNullOp);
+    } else {
+      arg_grad_vec.push_back(*(arg_grad_ptr[i]));
+      grad_req_vec.push_back(static_cast<OpReqType>(grad_req_type[i]));
+    }
+  }
+  for (mx_uint i = 0; i < aux_states_len; ++i) {
+    aux_states_vec.push_back(*(aux_states_ptr[i]));
+  }
+  *out = new exec::BucketingExecutor(default_bucket_key, *symb, ctx, ctx_map,
+                                     in_args_vec, arg_grad_vec, grad_req_vec,
+                                     aux_states_vec);
+  API_END();
+}
+
+int MXBucketingExecutorGet(BucketingExecutorHandle handle,
+                           int bucket_key,
+                           SymbolHandle symbol_handle,
+                           mx_uint num_data,
+                           const char** data_names,
+                           const mx_uint* data_shape_indptr,
+                           const mx_uint* data_shape_data,
+                           mx_uint* num_in_args,
+                           NDArrayHandle** in_args,
+                           NDArrayHandle** arg_grads,
+                           mx_uint* num_aux_states,
+                           NDArrayHandle** aux_states,
+                           ExecutorHandle *out) {
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  exec::BucketingExecutor *bucketing = static_cast<exec::BucketingExecutor*>(handle);
+  std::unordered_map<std::string, TShape> data_shapes;
+  for (mx_uint i = 0; i < num_data; ++i) {
+    data_shapes[std::string(data_names[i])] =
+        TShape(data_shape_data + data_shape_indptr[i],
+               data_shape_data + data_shape_indptr[i + 1]);
+  }
+  std::vector<NDArray> in_arg_vec, arg_grad_vec, aux_state_vec;
+  *out = bucketing->Get(bucket_key, static_cast<nnvm::Symbol*>(symbol_handle), data_shapes,
+                        &in_arg_vec, &arg_grad_vec, &aux_state_vec);
+  // the arguments, then their gradients, then the auxiliary states
+  ret->ret_handles.clear();
+  for (const auto& nd : in_arg_vec) {
+    ret->ret_handles.push_back(new NDArray(nd));
+  }
+  for (const auto& nd : arg_grad_vec) {
+    ret->ret_handles.push_back(nd.is_none() ? nullptr : new NDArray(nd));
+  }
+  for (const auto& nd : aux_state_vec) {
+    ret->ret_handles.push_back(new NDArray(nd));
+  }
+  *num_in_args = in_arg_vec.size();
+  *in_args = dmlc::BeginPtr(ret->ret_handles);
+  *arg_grads = *in_args + in_arg_vec.size();
+  *num_aux_states = aux_state_vec.size();
+  *aux_states = *arg_grads + arg_grad_vec.size();
+  API_END();
+}
+
+int MXBucketingExecutorFree(BucketingExecutorHandle handle) {
+  API_BEGIN();
+  delete static_cast<exec::BucketingExecutor*>(handle);
+  API_END();
+}
+
+int MXExecutorGroupCreate(SymbolHandle symbol_handle,
+                          mx_uint num_ctx,
+                          const int* dev_types,
+                          const int* dev_ids,
+                          mx_uint num_data,
+                          const char** data_names,
+                          const mx_uint* data_shape_indptr,
+                          const mx_uint* data_shape_data,
+                          ExecutorGroupHandle *out) {
+  API_BEGIN();
+  nnvm::Symbol *symb = static_cast<nnvm::Symbol*>(symbol_handle);
+  std::vector<Context> contexts;
+  for (mx_uint i = 0; i < num_ctx; ++i) {
+    contexts.push_back(Context::Create(static_cast<Context::DeviceType>(dev_types[i]),
+                                       dev_ids[i]));
+  }
+  std::vector<std::pair<std::string, TShape> > data_shapes;
+  for (mx_uint i = 0; i < num_data; ++i) {
+    data_shapes.emplace_back(std::string(data_names[i]),
+                             TShape(data_shape_data + data_shape_indptr[i],
+                                    data_shape_data + data_shape_indptr[i + 1]));
+  }
+  *out = new exec::ExecutorGroup(*symb, contexts, data_shapes);
+  API_END();
+}
+
+int MXExecutorGroupSetParams(ExecutorGroupHandle handle,
+                             mx_uint num,
+                             const char** names,
+                             NDArrayHandle* arrays) {
+  API_BEGIN();
+  std::unordered_map<std::string, NDArray> params;
+  for (mx_uint i = 0; i < num; ++i) {
+    params[std::string(names[i])] = *static_cast<NDArray*>(arrays[i]);
+  }
+  static_cast<exec::ExecutorGroup*>(handle)->SetParams(params);
+  API_END();
+}
+
+int MXExecutorGroupForward(ExecutorGroupHandle handle,
+                           mx_uint num_data,
+                           NDArrayHandle* data,
+                           int is_train) {
+  API_BEGIN();
+  std::vector<NDArray> data_vec;
+  for (mx_uint i = 0; i < num_data; ++i) {
+    data_vec.push_back(*static_cast<NDArray*>(data[i]));
+  }
+  static_cast<exec::ExecutorGroup*>(handle)->Forward(data_vec, is_train != 0);
+  API_END();
+}
+
+int MXExecutorGroupBackward(ExecutorGroupHandle handle) {
+  API_BEGIN();
+  static_cast<exec::ExecutorGroup*>(handle)->Backward();
+  API_END();
+}
+
+int MXExecutorGroupInitKVStore(ExecutorGroupHandle handle,
+                               KVStoreHandle kvstore) {
+  API_BEGIN();
+  static_cast<exec::ExecutorGroup*>(handle)->InitKVStore(static_cast<KVStore*>(kvstore));
+  API_END();
+}
+
+int MXExecutorGroupUpdate(ExecutorGroupHandle handle,
+                          KVStoreHandle kvstore) {
+  API_BEGIN();
+  static_cast<exec::ExecutorGroup*>(handle)->Update(static_cast<KVStore*>(kvstore));
+  API_END();
+}
+
+int MXExecutorGroupGetOutputs(ExecutorGroupHandle handle,
+                              mx_uint *out_size,
+                              NDArrayHandle **out) {
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  exec::ExecutorGroup *group = static_cast<exec::ExecutorGroup*>(handle);
+  ret->ret_handles.clear();
+  for (const auto& exec : group->executors()) {
+    for (const auto& nd : exec->outputs()) {
+      ret->ret_handles.push_back(new NDArray(nd));
+    }
+  }
+  *out_size = ret->ret_handles.size();
+  *out = dmlc::BeginPtr(ret->ret_handles);
+  API_END();
+}
+
+int MXExecutorGroupFree(ExecutorGroupHandle handle) {
+  API_BEGIN();
+  delete static_cast<exec::ExecutorGroup*>(handle);
+  API_END();
+}
+
+int MXPipelineExecutorCreate(SymbolHandle symbol_handle,
+                             int dev_type,
+                             int dev_id,
+                             mx_uint num_g2c_keys,
+                             const char** g2c_keys,
+                             const int* g2c_dev_types,
+                             const int* g2c_dev_ids,
+                             mx_uint num_data,
+                             const char** data_names,
+                             const mx_uint* data_shape_indptr,
+                             const mx_uint* data_shape_data,
+                             int num_micro_batches,
+                             PipelineExecutorHandle *out) {
+  API_BEGIN();
+  nnvm::Symbol *symb = static_cast<nnvm::Symbol*>(symbol_handle);
+  Context ctx = Context::Create(static_cast<Context::DeviceType>(dev_type), dev_id);
+  std::map<std::string, Context> group2ctx;
+  for (mx_uint i = 0; i < num_g2c_keys; ++i) {
+    group2ctx[g2c_keys[i]] = Context::Create(
+        static_cast<Context::DeviceType>(g2c_dev_types[i]), g2c_dev_ids[i]);
+  }
+  std::vector<std::pair<std::string, TShape> > data_shapes;
+  for (mx_uint i = 0; i < num_data; ++i) {
+    data_shapes.emplace_back(std::string(data_names[i]),
+                             TShape(data_shape_data + data_shape_indptr[i],
+                                    data_shape_data + data_shape_indptr[i + 1]));
+  }
+  *out = new exec::PipelineExecutor(*symb, ctx, group2ctx, data_shapes, num_micro_batches);
+  API_END();
+}
+
+int MXPipelineExecutorSetParams(PipelineExecutorHandle handle,
+                                mx_uint num,
+                                const char** names,
+                                NDArrayHandle* arrays) {
+  API_BEGIN();
+  std::unordered_map<std::string, NDArray> params;
+  for (mx_uint i = 0; i < num; ++i) {
+    params[std::string(names[i])] = *static_cast<NDArray*>(arrays[i]);
+  }
+  static_cast<exec::PipelineExecutor*>(handle)->SetParams(params);
+  API_END();
+}
+
+int MXPipelineExecutorForward(PipelineExecutorHandle handle,
+                              mx_uint num_data,
+                              NDArrayHandle* data,
+                              int is_train) {
+  API_BEGIN();
+  std::vector<NDArray> data_vec;
+  for (mx_uint i = 0; i < num_data; ++i) {
+    data_vec.push_back(*static_cast<NDArray*>(data[i]));
+  }
+  static_cast<exec::PipelineExecutor*>(handle)->Forward(data_vec, is_train != 0);
+  API_END();
+}
+
+int MXPipelineExecutorBackward(PipelineExecutorHandle handle) {
+  API_BEGIN();
+  static_cast<exec::PipelineExecutor*>(handle)->Backward();
+  API_END();
+}
+
+int MXPipelineExecutorGetOutputs(PipelineExecutorHandle handle,
+                                 mx_uint *out_size,
+                                 NDArrayHandle **out) {
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  exec::PipelineExecutor *pipeline = static_cast<exec::PipelineExecutor*>(handle);
+  ret->ret_handles.clear();
+  for (const auto& exec : pipeline->executors()) {
+    for (const auto& nd : exec->outputs()) {
+      ret->ret_handles.push_back(new NDArray(nd));
+    }
+  }
+  *out_size = ret->ret_handles.size();
+  *out = dmlc::BeginPtr(ret->ret_handles);
+  API_END();
+}
+
+int MXPipelineExecutorGetParams(PipelineExecutorHandle handle,
+                                mx_uint *out_size,
+                                const char ***out_names,
+                                NDArrayHandle **out_params,
+                                NDArrayHandle **out_grads) {
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  exec::PipelineExecutor *pipeline = static_cast<exec::PipelineExecutor*>(handle);
+  const std::vector<std::string>& names = pipeline->param_names();
+  ret->ret_vec_charp.clear();
+  ret->ret_handles.clear();
+  for (const auto& name : names) {
+    ret->ret_vec_charp.push_back(name.c_str());
+  }
+  // the parameters, followed by the gradients
+  for (const auto& nd : pipeline->params()) {
+    ret->ret_handles.push_back(new NDArray(nd));
+  }
+  for (const auto& nd : pipeline->grads()) {
+    ret->ret_handles.push_back(new NDArray(nd));
+  }
+  *out_size = names.size();
+  *out_names = dmlc::BeginPtr(ret->ret_vec_charp);
+  *out_params = dmlc::BeginPtr(ret->ret_handles);
+  *out_grads = dmlc::BeginPtr(ret->ret_handles) + names.size();
+  API_END();
+}
+
+int MXPipelineExecutorFree(PipelineExecutorHandle handle) {
+  API_BEGIN();
+  delete static_cast<exec::PipelineExecutor*>(handle);
   API_END();
 }
@@ -29,10 +29,19 @@
 #include <mxnet/op_attr_types.h>
 #include <nnvm/node.h>
 #include <nnvm/op_attr_types.h>
+#include <nnvm/graph_attr_types.h>
+#include <nnvm/pass_functions.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include "./c_api_common.h"
 #include "../common/utils.h"
 #include "../ndarray/autograd.h"
+#include "../operator/tensor/cast_storage.h"
 
 using namespace mxnet;
 using mxnet::autograd::AutogradRuntime;
@@ -138,8 +147,8 @@ void SetContext(Context* p_ctx,
   } else {
     ctx = default_ctx;
   }
-  // Pinned context doesn't propagate
-  if (ctx.dev_type == Context::kCPUPinned) {
+  // Pinned and shared contexts don't propagate
+  if (ctx.dev_type == Context::kCPUPinned || ctx.dev_type == Context::kCPUShared) {
     ctx = Context::CPU();
   }
 #if !MXNET_USE_CUDA
@@ -158,6 +167,7 @@ void SetShapeType(const nnvm::Op* op,
   std::vector<NDArray>& ndoutputs = *p_ndoutputs;
   static auto& infershape = nnvm::Op::GetAttr<nnvm::FInferShape>("FInferShape");
   static auto& infertype = nnvm::Op::GetAttr<nnvm::FInferType>("FInferType");
+  static auto& inferstorage = nnvm::Op::GetAttr<FInferStorageType>("FInferStorageType");
   MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
   // infer shape
   std::vector<TShape>& in_shapes  = ret->arg_shapes;
@@ -193,9 +203,30 @@ void SetShapeType(const nnvm::Op* op,
   CHECK(infertype[op](attrs, &in_types, &out_types));
   CHECK_EQ(out_types.size(), ndoutputs.size());
 
+  // infer storage type, the outputs given keep theirs
+  std::vector<int> in_stypes, out_stypes;
+  for (auto& i : ndinputs) {
+    in_stypes.push_back(i.storage_type());
+  }
+  for (auto& i : ndoutputs) {
+    out_stypes.push_back(i.storage_type());
+  }
+  if (inferstorage.count(op)) {
+    CHECK(inferstorage[op](attrs, ctx.dev_mask(), &in_stypes, &out_stypes));
+    CHECK_EQ(out_stypes.size(), ndoutputs.size());
+    for (size_t i = 0; i < ndoutputs.size(); ++i) {
+      if (!ndoutputs[i].is_none()) out_stypes[i] = ndoutputs[i].storage_type();
+    }
+  }
+
   for (size_t i = 0; i < ndoutputs.size(); ++i) {
     if (ndoutputs[i].is_none()) {
-      ndoutputs[i] = NDArray(out_shapes[i], ctx, true, out_types[i]);
+      if (out_stypes[i] == kRowSparseStorage || out_stypes[i] == kCSRStorage) {
+        ndoutputs[i] = NDArray(static_cast<NDArrayStorageType>(out_stypes[i]),
+                               out_shapes[i], ctx, true, out_types[i]);
+      } else {
+        ndoutputs[i] = NDArray(out_shapes[i], ctx, true, out_types[i]);
+      }
     } else {
       CHECK_EQ(ndoutputs[i].shape(), out_shapes[i])
         << i << "th output has invalid shape. "
@@ -233,6 +264,7 @@ void SetDependency(std::vector<engine::VarHandle> *p_read_vars,
        case ResourceRequest::kTempSpace:
         ++ntmp;
        case ResourceRequest::kRandom:
+       case ResourceRequest::kParallelRandom:
         requested.push_back(ResourceManager::Get()->Request(ctx, req));
         write_vars.push_back(requested.back().var);
         break;
@@ -259,6 +291,58 @@ void SetDependency(std::vector<engine::VarHandle> *p_read_vars,
   Engine::Get()->DeduplicateVarHandle(&read_vars, &write_vars);
 }
 
+/*!
+ * \brief Push an operation to the engine, or defer it into batch
+ *  to be pushed together with the operations around it.
+ */
+void PushOrDefer(Engine::AsyncFn fn,
+                 const Context& ctx,
+                 const std::vector<engine::VarHandle>& read_vars,
+                 const std::vector<engine::VarHandle>& write_vars,
+                 const char* opr_name,
+                 std::vector<Engine::AsyncOpr>* batch) {
+  if (batch == nullptr) {
+    Engine::Get()->PushAsync(std::move(fn), ctx, read_vars, write_vars,
+                             FnProperty::kNormal, 0, opr_name);
+  } else {
+    batch->emplace_back();
+    Engine::AsyncOpr& opr = batch->back();
+    opr.fn = std::move(fn);
+    opr.exec_ctx = ctx;
+    opr.const_vars = read_vars;
+    opr.mutable_vars = write_vars;
+    opr.opr_name = opr_name;
+  }
+}
+
+/*!
+ * \brief Push a synchronous operation to the engine, which may collect it
+ *  into the bulk of this thread, or defer it into batch.
+ */
+void PushSyncOrDefer(Engine::SyncFn fn,
+                     const Context& ctx,
+                     const std::vector<engine::VarHandle>& read_vars,
+                     const std::vector<engine::VarHandle>& write_vars,
+                     const char* opr_name,
+                     std::vector<Engine::AsyncOpr>* batch) {
+  if (batch == nullptr) {
+    Engine::Get()->PushSync(std::move(fn), ctx, read_vars, write_vars,
+                            FnProperty::kNormal, 0, opr_name);
+  } else {
+    PushOrDefer([fn](RunContext rctx, engine::CallbackOnComplete on_complete) {
+        fn(rctx);
+        on_complete();
+      }, ctx, read_vars, write_vars, opr_name, batch);
+  }
+}
+
+/*! \brief Push the deferred operations in batch to the engine. */
+void FlushBatch(std::vector<Engine::AsyncOpr>* batch) {
+  if (batch == nullptr || batch->empty()) return;
+  Engine::Get()->PushAsyncBatch(batch);
+  batch->clear();
+}
+
 void PushFCompute(const FCompute& fn,
                   const nnvm::Op* op,
                   const nnvm::NodeAttrs& attrs,
@@ -267,30 +351,67 @@ void PushFCompute(const FCompute& fn,
                   const std::vector<engine::VarHandle>& write_vars,
                   const std::vector<Resource>& requested,
                   const std::vector<NDArray>& ndinputs,
-                  const std::vector<NDArray>& ndoutputs) {
+                  const std::vector<NDArray>& ndoutputs,
+                  std::vector<Engine::AsyncOpr>* batch) {
   bool is_train = AutogradRuntime::Get()->IsTraining();
-  Engine::Get()->PushAsync(
-    [ctx, attrs, fn, ndinputs, ndoutputs, requested, is_train](
-        RunContext rctx,
-        engine::CallbackOnComplete on_complete) {
-      std::vector<TBlob> input_blobs, output_blobs;
-      for (auto& i : ndinputs) {
-        input_blobs.push_back(i.data());
+  // the sparse arrays are cast for the operators without sparse kernels
+  bool fallback = op::HasSparse(ndinputs) || op::HasSparse(ndoutputs);
+  PushSyncOrDefer(
+    [ctx, attrs, fn, ndinputs, ndoutputs, requested, is_train, fallback](
+        RunContext rctx) {
+      OpContext opctx{is_train, rctx,
+                      engine::CallbackOnComplete(),
+                      requested};
+      std::vector<OpReqType> req(ndoutputs.size(), kWriteTo);
+      if (fallback) {
+        if (ctx.dev_mask() == gpu::kDevMask) {
+#if MXNET_USE_CUDA
+          op::FComputeFallback<gpu>(fn, attrs, opctx, ndinputs, req, ndoutputs);
+#else
+          LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+#endif
+        } else {
+          op::FComputeFallback<cpu>(fn, attrs, opctx, ndinputs, req, ndoutputs);
+        }
+      } else {
+        std::vector<TBlob> input_blobs, output_blobs;
+        for (auto& i : ndinputs) {
+          input_blobs.push_back(i.data());
+        }
+        for (auto& i : ndoutputs) {
+          output_blobs.push_back(i.data());
+        }
+        fn(attrs, opctx, input_blobs, req, output_blobs);
       }
-      for (auto& i : ndoutputs) {
-        output_blobs.push_back(i.data());
+      if (ctx.dev_mask() == gpu::kDevMask) {
+        rctx.get_stream<gpu>()->Wait();
       }
+    }, ctx, read_vars, write_vars, PROFILER_MESSAGE(op->name.c_str()), batch);
+}
+
+void PushFComputeEx(const FComputeEx& fn,
+                    const nnvm::Op* op,
+                    const nnvm::NodeAttrs& attrs,
+                    const Context& ctx,
+                    const std::vector<engine::VarHandle>& read_vars,
+                    const std::vector<engine::VarHandle>& write_vars,
+                    const std::vector<Resource>& requested,
+                    const std::vector<NDArray>& ndinputs,
+                    const std::vector<NDArray>& ndoutputs,
+                    std::vector<Engine::AsyncOpr>* batch) {
+  bool is_train = AutogradRuntime::Get()->IsTraining();
+  PushSyncOrDefer(
+    [ctx, attrs, fn, ndinputs, ndoutputs, requested, is_train](
+        RunContext rctx) {
       OpContext opctx{is_train, rctx,
                       engine::CallbackOnComplete(),
                       requested};
-      std::vector<OpReqType> req(output_blobs.size(), kWriteTo);
-      fn(attrs, opctx, input_blobs, req, output_blobs);
+      std::vector<OpReqType> req(ndoutputs.size(), kWriteTo);
+      fn(attrs, opctx, ndinputs, req, ndoutputs);
       if (ctx.dev_mask() == gpu::kDevMask) {
         rctx.get_stream<gpu>()->Wait();
       }
-      on_complete();
-    }, ctx, read_vars, write_vars, FnProperty::kNormal,
-    0, PROFILER_MESSAGE(op->name.c_str()));
+    }, ctx, read_vars, write_vars, PROFILER_MESSAGE(op->name.c_str()), batch);
 }
 
 void PushOperator(const OpStatePtr& state,
@@ -301,7 +422,8 @@ void PushOperator(const OpStatePtr& state,
                   const std::vector<engine::VarHandle>& write_vars,
                   const std::vector<Resource>& requested,
                   const std::vector<NDArray>& ndinputs,
-                  const std::vector<NDArray>& ndoutputs) {
+                  const std::vector<NDArray>& ndoutputs,
+                  std::vector<Engine::AsyncOpr>* batch) {
   static auto& fexec_type = nnvm::Op::GetAttr<FExecType>("FExecType");
 
   bool is_train = AutogradRuntime::Get()->IsTraining();
@@ -313,7 +435,7 @@ void PushOperator(const OpStatePtr& state,
   auto fcompute = common::GetFCompute<FStatefulCompute>(op, "FStatefulCompute", ctx);
   if (fcompute != nullptr) {
     CHECK(exec_type == ExecType::kSync || exec_type == ExecType::kAsync);
-    Engine::Get()->PushAsync(
+    PushOrDefer(
       [state, fcompute, ndinputs, ndoutputs, requested, is_train, exec_type](
           RunContext rctx,
           engine::CallbackOnComplete on_complete) {
@@ -329,8 +451,7 @@ void PushOperator(const OpStatePtr& state,
           }
           on_complete();
         }
-      }, ctx, read_vars, write_vars, FnProperty::kNormal,
-      0, PROFILER_MESSAGE(op->name.c_str()));
+      }, ctx, read_vars, write_vars, PROFILER_MESSAGE(op->name.c_str()), batch);
   } else {
     auto fcompute_ex = common::GetFCompute<FStatefulComputeEx>(
         op, "FStatefulComputeEx", ctx);
@@ -351,18 +472,99 @@ void PushOperator(const OpStatePtr& state,
         }
       };
     if (exec_type == ExecType::kLocal) {
+      // runs on this thread and may push on its own, keep the order
+      FlushBatch(batch);
       run(RunContext{ctx, nullptr}, engine::CallbackOnComplete());
     } else {
-      Engine::Get()->PushAsync(run, ctx, read_vars, write_vars, FnProperty::kNormal,
-                               0, PROFILER_MESSAGE(op->name.c_str()));
+      PushOrDefer(run, ctx, read_vars, write_vars,
+                  PROFILER_MESSAGE(op->name.c_str()), batch);
     }
   }
 }
 
+/*!
+ * \brief The inference of the outputs of an operator, kept for the next calls
+ *  whose arrays have the same device, shapes, types and storage types.
+ */
+struct InferCache {
+  bool valid{false};
+  int dev_mask;
+  std::vector<TShape> in_shapes, out_shapes;
+  std::vector<int> in_types, out_types;
+  std::vector<int> in_stypes, out_stypes;
+  /*! \brief the state of a stateful operator, created for state_ctx with the kept inference */
+  OpStatePtr state;
+  Context state_ctx;
+
+  /*! \brief whether the inference of the arrays is the kept one */
+  bool Match(const Context& ctx,
+             const std::vector<NDArray>& ndinputs,
+             const std::vector<NDArray>& ndoutputs) const {
+    if (!valid || ctx.dev_mask() != dev_mask || ndinputs.size() != in_shapes.size() ||
+        ndoutputs.size() != out_shapes.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < ndinputs.size(); ++i) {
+      if (ndinputs[i].shape() != in_shapes[i] || ndinputs[i].dtype() != in_types[i] ||
+          ndinputs[i].storage_type() != in_stypes[i]) {
+        return false;
+      }
+    }
+    // the given outputs are checked by the inference otherwise
+    for (size_t i = 0; i < ndoutputs.size(); ++i) {
+      if (!ndoutputs[i].is_none() &&
+          (ndoutputs[i].shape() != out_shapes[i] || ndoutputs[i].dtype() != out_types[i] ||
+           ndoutputs[i].storage_type() != out_stypes[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+  /*! \brief keep the inference of SetShapeType */
+  void Store(const Context& ctx,
+             const std::vector<NDArray>& ndinputs,
+             const std::vector<NDArray>& ndoutputs) {
+    dev_mask = ctx.dev_mask();
+    in_shapes.clear();
+    in_types.clear();
+    in_stypes.clear();
+    for (const auto& i : ndinputs) {
+      in_shapes.push_back(i.shape());
+      in_types.push_back(i.dtype());
+      in_stypes.push_back(i.storage_type());
+    }
+    out_shapes.clear();
+    out_types.clear();
+    out_stypes.clear();
+    for (const auto& i : ndoutputs) {
+      out_shapes.push_back(i.shape());
+      out_types.push_back(i.dtype());
+      out_stypes.push_back(i.storage_type());
+    }
+    state = OpStatePtr();
+    valid = true;
+  }
+  /*! \brief allocate the outputs not given, as SetShapeType */
+  void SetOutputs(const Context& ctx, std::vector<NDArray>* p_ndoutputs) const {
+    std::vector<NDArray>& ndoutputs = *p_ndoutputs;
+    for (size_t i = 0; i < ndoutputs.size(); ++i) {
+      if (!ndoutputs[i].is_none()) continue;
+      if (out_stypes[i] == kRowSparseStorage || out_stypes[i] == kCSRStorage) {
+        ndoutputs[i] = NDArray(static_cast<NDArrayStorageType>(out_stypes[i]),
+                               out_shapes[i], ctx, true, out_types[i]);
+      } else {
+        ndoutputs[i] = NDArray(out_shapes[i], ctx, true, out_types[i]);
+      }
+    }
+  }
+};
+
 void ImperativeInvokeImpl(const Context& default_ctx,
                           const nnvm::NodeAttrs& attrs,
                           std::vector<NDArray>* p_ndinputs,
-                          std::vector<NDArray>* p_ndoutputs) {
+                          std::vector<NDArray>* p_ndoutputs,
+                          std::vector<Engine::AsyncOpr>* batch = nullptr,
+                          InferCache* cache = nullptr) {
   static auto& fcpu = nnvm::Op::GetAttr<FCompute>("FCompute<cpu>");
   static auto& fgpu = nnvm::Op::GetAttr<FCompute>("FCompute<gpu>");
   static auto& ndfunc = nnvm::Op::GetAttr<FNDArrayFunction>("FNDArrayFunction");
@@ -375,12 +577,25 @@ void ImperativeInvokeImpl(const Context& default_ctx,
 
 
   if (ndfunc.count(op)) {
+    // ndarray functions push on their own, keep the order
+    FlushBatch(batch);
     ndfunc[op](attrs, ndinputs, &ndoutputs);
   } else {
     // TODO(piiswrong): infer ctx
     Context ctx;
     SetContext(&ctx, attrs, ndinputs, ndoutputs, default_ctx);
-    SetShapeType(op, attrs, ctx, ndinputs, &ndoutputs);
+    const std::vector<TShape>* in_shapes = &ret->arg_shapes;
+    const std::vector<int>* in_types = &ret->arg_types;
+    bool matched = false;
+    if (cache != nullptr && cache->Match(ctx, ndinputs, ndoutputs)) {
+      matched = true;
+      cache->SetOutputs(ctx, &ndoutputs);
+      in_shapes = &cache->in_shapes;
+      in_types = &cache->in_types;
+    } else {
+      SetShapeType(op, attrs, ctx, ndinputs, &ndoutputs);
+      if (cache != nullptr) cache->Store(ctx, ndinputs, ndoutputs);
+    }
 
     std::vector<engine::VarHandle> read_vars, write_vars;
     std::vector<Resource> requested;
@@ -394,24 +609,46 @@ void ImperativeInvokeImpl(const Context& default_ctx,
     } else if (ctx.dev_mask() == gpu::kDevMask && fgpu.count(op)) {
       fn = fgpu[op];
     }
+    FComputeEx fn_ex = common::GetFCompute<FComputeEx>(op, "FComputeEx", ctx);
+    const bool sparse = op::HasSparse(ndinputs) || op::HasSparse(ndoutputs);
 
-    if (fn) {
+    if (fn_ex && (sparse || !fn)) {
+      if (AutogradRuntime::Get()->IsRecording()) {
+        AutogradRuntime::Get()->RecordImperativeFCompute(op,
+            attrs, &ndinputs, &ndoutputs);
+      }
+      PushFComputeEx(fn_ex, op, attrs, ctx, read_vars, write_vars,
+          requested, ndinputs, ndoutputs, batch);
+    } else if (fn) {
       if (AutogradRuntime::Get()->IsRecording()) {
         AutogradRuntime::Get()->RecordImperativeFCompute(op,
             attrs, &ndinputs, &ndoutputs);
       }
       PushFCompute(fn, op, attrs, ctx, read_vars, write_vars,
-          requested, ndinputs, ndoutputs);
+          requested, ndinputs, ndoutputs, batch);
     } else if (createop.count(op)) {
-      auto state =
-          createop[op](attrs, ctx, ret->arg_shapes, ret->arg_types);
-      if (AutogradRuntime::Get()->IsRecording()) {
+      CHECK(!sparse) << "Operator " << op->name << " does not support the sparse "
+                     << "storage, cast its arrays with cast_storage";
+      // a recorded state is kept by its backward, the others of a handle are
+      // reused while the inference holds, without creating the operator again
+      const bool recording = AutogradRuntime::Get()->IsRecording();
+      OpStatePtr state;
+      if (!recording && matched && cache->state && cache->state_ctx == ctx) {
+        state = cache->state;
+      } else {
+        state = createop[op](attrs, ctx, *in_shapes, *in_types);
+        if (!recording && cache != nullptr) {
+          cache->state = state;
+          cache->state_ctx = ctx;
+        }
+      }
+      if (recording) {
         AutogradRuntime::Get()->RecordImperativeOperator(state, op,
             attrs, &ndinputs, &ndoutputs);
       }
       write_vars.push_back(state.get_var());
       PushOperator(state, op, attrs, ctx, read_vars, write_vars,
-          requested, ndinputs, ndoutputs);
+          requested, ndinputs, ndoutputs, batch);
     } else {
       LOG(FATAL)
         << "Operator " << op->name << " is not implemented for "
@@ -420,6 +657,28 @@ void ImperativeInvokeImpl(const Context& default_ctx,
   }
 }
 
+/*! \brief return the outputs of an invocation, in new handles when none were given */
+void SetOutputHandles(std::vector<NDArray>* p_ndoutputs,
+                      const int& num_visible_outputs,
+                      int *num_outputs,
+                      NDArrayHandle **outputs,
+                      NDArray** outarray) {
+  std::vector<NDArray>& ndoutputs = *p_ndoutputs;
+  if (outarray == nullptr) {
+    MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+    ret->ret_handles.clear();
+    for (int i = 0; i < num_visible_outputs; ++i) {
+      ret->ret_handles.push_back(
+        reinterpret_cast<NDArrayHandle>(new NDArray(std::move(ndoutputs[i]))));
+    }
+    *outputs = dmlc::BeginPtr(ret->ret_handles);
+  } else {
+    for (int i = 0; i < *num_outputs; ++i) {
+      *outarray[i] = std::move(ndoutputs[i]);
+    }
+  }
+}
+
 int MXImperativeInvoke(AtomicSymbolCreator creator,
                        int num_inputs,
                        NDArrayHandle *inputs,
@@ -429,7 +688,6 @@ int MXImperativeInvoke(AtomicSymbolCreator creator,
                        const char **param_keys,
                        const char **param_vals) {
   const nnvm::Op* op = static_cast<nnvm::Op*>(creator);
-  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
   NDArray** outarray = *reinterpret_cast<NDArray***>(outputs);
 
   API_BEGIN();
@@ -445,20 +703,387 @@ int MXImperativeInvoke(AtomicSymbolCreator creator,
       num_outputs, infered_num_outputs, num_visible_outputs, outarray);
 
   ImperativeInvokeImpl(Context::CPU(), attrs, &ndinputs, &ndoutputs);
+  SetOutputHandles(&ndoutputs, num_visible_outputs, num_outputs, outputs, outarray);
+  API_END();
+}
 
-  if (outarray == nullptr) {
-    ret->ret_handles.clear();
-    for (int i = 0; i < num_visible_outputs; ++i) {
-      ret->ret_handles.push_back(
-        reinterpret_cast<NDArrayHandle>(new NDArray(std::move(ndoutputs[i]))));
+/*! \brief An operator invocation with parsed parameters, see MXCreateImperativeOp */
+struct ImperativeOp {
+  nnvm::NodeAttrs attrs;
+  int num_inputs;
+  int infered_num_outputs;
+  int num_visible_outputs;
+  InferCache infer;
+  /*! \brief the calls of a handle from different threads take turns */
+  std::mutex mutex;
+};
+
+int MXCreateImperativeOp(AtomicSymbolCreator creator,
+                         int num_inputs,
+                         int num_params,
+                         const char **param_keys,
+                         const char **param_vals,
+                         ImperativeOpHandle *out) {
+  const nnvm::Op* op = static_cast<nnvm::Op*>(creator);
+  ImperativeOp* iop = new ImperativeOp();
+  API_BEGIN();
+  SetOpAttrs(op, &iop->attrs, num_inputs, num_params, param_keys, param_vals);
+  SetNumOutputs(op, iop->attrs, num_inputs, &iop->infered_num_outputs,
+                &iop->num_visible_outputs);
+  iop->num_inputs = num_inputs;
+  *out = iop;
+  API_END_HANDLE_ERROR(delete iop);
+}
+
+int MXFreeImperativeOp(ImperativeOpHandle handle) {
+  API_BEGIN();
+  delete static_cast<ImperativeOp*>(handle);
+  API_END();
+}
+
+int MXInvokeImperativeOp(ImperativeOpHandle handle,
+                         int num_inputs,
+                         NDArrayHandle *inputs,
+                         int *num_outputs,
+                         NDArrayHandle **outputs) {
+  ImperativeOp* iop = static_cast<ImperativeOp*>(handle);
+  NDArray** outarray = *reinterpret_cast<NDArray***>(outputs);
+
+  API_BEGIN();
+  const nnvm::Op* op = iop->attrs.op;
+  CHECK_EQ(num_inputs, iop->num_inputs)
+    << "Expecting " << iop->num_inputs << " inputs, got "
+    << num_inputs << " in operator " << op->name;
+  std::vector<NDArray> ndinputs, ndoutputs;
+  SetNDInputsOutputs(op, &ndinputs, &ndoutputs, num_inputs, inputs,
+      num_outputs, iop->infered_num_outputs, iop->num_visible_outputs, outarray);
+  {
+    std::lock_guard<std::mutex> lock(iop->mutex);
+    ImperativeInvokeImpl(Context::CPU(), iop->attrs, &ndinputs, &ndoutputs,
+                         nullptr, &iop->infer);
+  }
+  SetOutputHandles(&ndoutputs, iop->num_visible_outputs, num_outputs, outputs, outarray);
+  API_END();
+}
+
+/*!
+ * \brief The compiled form of a cached op for one signature of its inputs.
+ *  The shapes, types, kernels and resources of the nodes are computed once,
+ *  as the states and the memory of the intermediate entries when the calls
+ *  are not recorded, and the nodes are pushed to the engine in segments.
+ */
+struct CachedOpPlan {
+  struct OpNode {
+    /*! \brief the node in the graph of the plan */
+    uint32_t nid;
+    const nnvm::Op* op;
+    const nnvm::NodeAttrs* attrs;
+    FCompute fn;
+    FStatefulCompute fstateful;
+    /*! \brief the state of a stateful node, created at every call when recording */
+    OpStatePtr state;
+    std::vector<Resource> requested;
+    /*! \brief the inputs the node mutates */
+    std::vector<uint32_t> auxidx;
+    std::vector<OpReqType> req;
+    std::vector<TShape> in_shapes;
+    std::vector<int> in_types;
+  };
+  nnvm::Graph graph;
+  Context ctx;
+  bool recording;
+  /*! \brief the entries of the inputs of the cached op */
+  std::vector<uint32_t> input_entries;
+  std::vector<OpNode> nodes;
+  /*! \brief the [begin, end) ranges of nodes pushed as one engine operation */
+  std::vector<std::pair<size_t, size_t> > segments;
+  std::vector<std::string> segment_names;
+  nnvm::ShapeVector shapes;
+  nnvm::DTypeVector dtypes;
+  /*! \brief the planned arrays of the intermediate entries, none for the others */
+  std::vector<NDArray> entries;
+};
+
+/*! \brief A graph invoked imperatively, with its plans by the signature of the inputs */
+struct CachedOp {
+  nnvm::Graph graph;
+  std::vector<nnvm::NodePtr> vars;
+  std::mutex mutex;
+  std::unordered_map<std::string, std::shared_ptr<CachedOpPlan> > plans;
+};
+
+std::string CachedOpSignature(const std::vector<NDArray>& inputs, bool recording) {
+  std::ostringstream os;
+  os << recording;
+  for (const auto& i : inputs) {
+    os << ';' << i.ctx().dev_type << ':' << i.ctx().dev_id << ':' << i.storage_type()
+       << ':' << i.dtype() << ':' << i.shape();
+  }
+  return os.str();
+}
+
+/*!
+ * \brief Compile the graph of a cached op for its inputs.
+ * \return nullptr if a node has to run through ImperativeInvokeImpl, as the
+ *  sparse, asynchronous and ndarray function operators.
+ */
+std::shared_ptr<CachedOpPlan> BuildCachedOpPlan(const CachedOp& cop,
+                                                const std::vector<NDArray>& inputs,
+                                                bool recording) {
+  static auto& fcpu = nnvm::Op::GetAttr<FCompute>("FCompute<cpu>");
+  static auto& fgpu = nnvm::Op::GetAttr<FCompute>("FCompute<gpu>");
+  static auto& ndfunc = nnvm::Op::GetAttr<FNDArrayFunction>("FNDArrayFunction");
+  static auto& createop = nnvm::Op::GetAttr<FCreateOpState>("FCreateOpState");
+  static auto& fexec_type = nnvm::Op::GetAttr<FExecType>("FExecType");
+  static auto& inferstorage = nnvm::Op::GetAttr<FInferStorageType>("FInferStorageType");
+  static auto& mutate = nnvm::Op::GetAttr<nnvm::FMutateInputs>("FMutateInputs");
+  static auto& tmp_resource = nnvm::Op::GetAttr<FResourceRequest>("FResourceRequest");
+
+  Context ctx = inputs[0].ctx();
+  for (const auto& i : inputs) {
+    if (i.storage_type() != kDefaultStorage || i.ctx() != ctx) return nullptr;
+  }
+  // Pinned and shared contexts don't propagate
+  if (ctx.dev_type == Context::kCPUPinned || ctx.dev_type == Context::kCPUShared) {
+    ctx = Context::CPU();
+  }
+
+  auto plan = std::make_shared<CachedOpPlan>();
+  plan->ctx = ctx;
+  plan->recording = recording;
+  nnvm::Graph& g = plan->graph;
+  g.outputs = cop.graph.outputs;
+  {
+    const nnvm::IndexedGraph& idx = g.indexed_graph();
+    std::unordered_map<uint32_t, size_t> var_index;
+    for (size_t i = 0; i < cop.vars.size(); ++i) {
+      const uint32_t nid = idx.node_id(cop.vars[i].get());
+      var_index[nid] = i;
+      plan->input_entries.push_back(idx.entry_id(nid, 0));
     }
-    *outputs = dmlc::BeginPtr(ret->ret_handles);
-  } else {
-    for (int i = 0; i < *num_outputs; ++i) {
-      *outarray[i] = std::move(ndoutputs[i]);
+    nnvm::ShapeVector arg_shapes;
+    nnvm::DTypeVector arg_dtypes;
+    for (uint32_t nid : idx.input_nodes()) {
+      const NDArray& in = inputs[var_index.at(nid)];
+      arg_shapes.push_back(in.shape());
+      arg_dtypes.push_back(in.dtype());
     }
+    g = nnvm::pass::InferShape(g, arg_shapes, "__shape__");
+    if (g.GetAttr<size_t>("shape_num_unknown_nodes") != 0) return nullptr;
+    g = nnvm::pass::InferType(g, arg_dtypes, "__dtype__");
+    if (g.GetAttr<size_t>("dtype_num_unknown_nodes") != 0) return nullptr;
   }
-  API_END();
+  const nnvm::IndexedGraph& idx = g.indexed_graph();
+  plan->shapes = g.GetAttr<nnvm::ShapeVector>("shape");
+  plan->dtypes = g.GetAttr<nnvm::DTypeVector>("dtype");
+
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    const nnvm::Node* node = idx[nid].source;
+    if (node->is_variable()) continue;
+    const nnvm::Op* op = node->op();
+    if (ndfunc.count(op)) return nullptr;
+    auto it = node->attrs.dict.find("ctx");
+    if (it != node->attrs.dict.end() && Context::FromString(it->second) != ctx) return nullptr;
+    CachedOpPlan::OpNode n;
+    n.nid = nid;
+    n.op = op;
+    n.attrs = &node->attrs;
+    for (const auto& e : idx[nid].inputs) {
+      n.in_shapes.push_back(plan->shapes[idx.entry_id(e)]);
+      n.in_types.push_back(plan->dtypes[idx.entry_id(e)]);
+    }
+    // the outputs of some operators are sparse for dense inputs
+    if (inferstorage.count(op)) {
+      std::vector<int> in_stypes(n.in_shapes.size(), kDefaultStorage);
+      std::vector<int> out_stypes(node->num_outputs(), kUndefinedStorage);
+      if (!inferstorage[op](node->attrs, ctx.dev_mask(), &in_stypes, &out_stypes)) {
+        return nullptr;
+      }
+      for (int stype : out_stypes) {
+        if (stype != kDefaultStorage) return nullptr;
+      }
+    }
+    if (ctx.dev_mask() == cpu::kDevMask && fcpu.count(op)) {
+      n.fn = fcpu[op];
+    } else if (ctx.dev_mask() == gpu::kDevMask && fgpu.count(op)) {
+      n.fn = fgpu[op];
+    }
+    if (!n.fn) {
+      // the same choice of kernel as ImperativeInvokeImpl
+      if (common::GetFCompute<FComputeEx>(op, "FComputeEx", ctx) != nullptr ||
+          !createop.count(op)) {
+        return nullptr;
+      }
+      if (fexec_type.count(op) && fexec_type[op](node->attrs) != ExecType::kSync) {
+        return nullptr;
+      }
+      n.fstateful = common::GetFCompute<FStatefulCompute>(op, "FStatefulCompute", ctx);
+      if (n.fstateful == nullptr) return nullptr;
+      if (!recording) n.state = createop[op](node->attrs, ctx, n.in_shapes, n.in_types);
+    }
+    if (tmp_resource.count(op)) {
+      for (const auto& req : tmp_resource[op](node->attrs)) {
+        if (req.type != ResourceRequest::kTempSpace && req.type != ResourceRequest::kRandom &&
+            req.type != ResourceRequest::kParallelRandom) {
+          return nullptr;
+        }
+        n.requested.push_back(ResourceManager::Get()->Request(ctx, req));
+      }
+    }
+    if (mutate.count(op)) n.auxidx = mutate[op](node->attrs);
+    n.req.assign(node->num_outputs(), kWriteTo);
+    plan->nodes.push_back(std::move(n));
+  }
+
+  plan->entries.resize(idx.num_node_entries());
+  if (!recording) {
+    // the outputs are new arrays at every call, the intermediate entries share
+    // the memory of the plan, which the engine orders across the calls
+    const int kBadStorageID = -1;
+    const int kExternalStorageID = -2;
+    nnvm::StorageVector storage(idx.num_node_entries(), kBadStorageID);
+    for (const auto& e : idx.outputs()) storage[idx.entry_id(e)] = kExternalStorageID;
+    g.attrs["storage"] = std::make_shared<dmlc::any>(std::move(storage));
+    g = nnvm::ApplyPass(g, "PlanMemory");
+    const auto& vstorage = g.GetAttr<nnvm::StorageVector>("storage_id");
+    const auto& vinplace = g.GetAttr<std::vector<int> >("storage_inplace_index");
+    std::vector<size_t> pool_bytes;
+    for (const auto& n : plan->nodes) {
+      for (uint32_t i = 0; i < idx[n.nid].source->num_outputs(); ++i) {
+        const uint32_t eid = idx.entry_id(n.nid, i);
+        if (vstorage[eid] < 0) continue;
+        const size_t sid = static_cast<size_t>(vstorage[eid]);
+        if (sid >= pool_bytes.size()) pool_bytes.resize(sid + 1, 0);
+        pool_bytes[sid] = std::max(pool_bytes[sid],
+            plan->shapes[eid].Size() * mshadow::mshadow_sizeof(plan->dtypes[eid]));
+      }
+    }
+    std::vector<NDArray> pool(pool_bytes.size());
+    for (size_t i = 0; i < pool_bytes.size(); ++i) {
+      if (pool_bytes[i] == 0) continue;
+      // allocate float arrays
+      pool[i] = NDArray(TShape{static_cast<nnvm::dim_t>((pool_bytes[i] + 3) / 4)}, ctx);
+    }
+    for (auto& n : plan->nodes) {
+      for (uint32_t i = 0; i < idx[n.nid].source->num_outputs(); ++i) {
+        const uint32_t eid = idx.entry_id(n.nid, i);
+        if (vstorage[eid] < 0 || pool[vstorage[eid]].is_none()) continue;
+        plan->entries[eid] = pool[vstorage[eid]].AsArray(plan->shapes[eid], plan->dtypes[eid]);
+        if (vinplace[eid] >= 0) n.req[i] = kWriteInplace;
+      }
+    }
+  }
+
+  // the same segments as the ones of GraphExecutor
+  size_t num_nodes_threshold = 1;
+  if (!recording && dmlc::GetEnv("MXNET_EXEC_BULK_EXEC_INFERENCE", true)) {
+    num_nodes_threshold = plan->nodes.size();
+  } else if (dmlc::GetEnv("MXNET_EXEC_BULK_EXEC_TRAIN", 1)) {
+    num_nodes_threshold = dmlc::GetEnv("MXNET_EXEC_BULK_EXEC_MAX_NODE_TRAIN", 15);
+  }
+  num_nodes_threshold = std::max<size_t>(num_nodes_threshold, 1);
+  for (size_t begin = 0; begin < plan->nodes.size(); begin += num_nodes_threshold) {
+    const size_t end = std::min(begin + num_nodes_threshold, plan->nodes.size());
+    plan->segments.emplace_back(begin, end);
+    std::string name = plan->nodes[begin].op->name;
+    if (end - begin > 1) {
+      name = "[";
+      for (size_t k = begin; k < end; ++k) name += plan->nodes[k].op->name + ",";
+      name.back() = ']';
+    }
+    plan->segment_names.push_back(std::move(name));
+  }
+  return plan;
+}
+
+/*! \brief Run a plan of a cached op, the arrays of its entries are set in buff */
+void InvokeCachedOpPlan(const std::shared_ptr<CachedOpPlan>& plan,
+                        const std::vector<NDArray>& inputs,
+                        std::vector<NDArray>* p_buff) {
+  static auto& createop = nnvm::Op::GetAttr<FCreateOpState>("FCreateOpState");
+  const nnvm::IndexedGraph& idx = plan->graph.indexed_graph();
+  std::vector<NDArray>& buff = *p_buff;
+  buff = plan->entries;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    buff[plan->input_entries[i]] = inputs[i];
+  }
+
+  const size_t num_nodes = plan->nodes.size();
+  std::vector<std::vector<NDArray> > ndinputs(num_nodes), ndoutputs(num_nodes);
+  std::vector<OpStatePtr> states(num_nodes);
+  for (size_t k = 0; k < num_nodes; ++k) {
+    const CachedOpPlan::OpNode& n = plan->nodes[k];
+    const nnvm::IndexedGraph::Node& inode = idx[n.nid];
+    for (const auto& e : inode.inputs) {
+      ndinputs[k].push_back(buff[idx.entry_id(e)]);
+    }
+    for (uint32_t i = 0; i < inode.source->num_outputs(); ++i) {
+      const uint32_t eid = idx.entry_id(n.nid, i);
+      if (buff[eid].is_none()) {
+        buff[eid] = NDArray(plan->shapes[eid], plan->ctx, true, plan->dtypes[eid]);
+      }
+      ndoutputs[k].push_back(buff[eid]);
+    }
+    states[k] = n.state;
+    if (plan->recording) {
+      if (n.fstateful) {
+        states[k] = createop[n.op](*n.attrs, plan->ctx, n.in_shapes, n.in_types);
+        AutogradRuntime::Get()->RecordImperativeOperator(states[k], n.op, *n.attrs,
+                                                         &ndinputs[k], &ndoutputs[k]);
+      } else {
+        AutogradRuntime::Get()->RecordImperativeFCompute(n.op, *n.attrs,
+                                                         &ndinputs[k], &ndoutputs[k]);
+      }
+      // the recorded outputs are the inputs of the next nodes
+      for (uint32_t i = 0; i < inode.source->num_outputs(); ++i) {
+        buff[idx.entry_id(n.nid, i)] = ndoutputs[k][i];
+      }
+    }
+  }
+
+  const bool is_train = AutogradRuntime::Get()->IsTraining();
+  std::vector<Engine::AsyncOpr> batch;
+  for (size_t s = 0; s < plan->segments.size(); ++s) {
+    const size_t begin = plan->segments[s].first;
+    const size_t end = plan->segments[s].second;
+    std::vector<engine::VarHandle> read_vars, write_vars;
+    for (size_t k = begin; k < end; ++k) {
+      for (const auto& r : plan->nodes[k].requested) write_vars.push_back(r.var);
+      for (const auto& i : ndinputs[k]) read_vars.push_back(i.var());
+      for (const auto& i : ndoutputs[k]) write_vars.push_back(i.var());
+      for (uint32_t i : plan->nodes[k].auxidx) write_vars.push_back(ndinputs[k][i].var());
+      if (plan->nodes[k].fstateful) write_vars.push_back(states[k].get_var());
+    }
+    Engine::Get()->DeduplicateVarHandle(&read_vars, &write_vars);
+    std::vector<std::vector<NDArray> > seg_inputs(ndinputs.begin() + begin,
+                                                  ndinputs.begin() + end);
+    std::vector<std::vector<NDArray> > seg_outputs(ndoutputs.begin() + begin,
+                                                   ndoutputs.begin() + end);
+    std::vector<OpStatePtr> seg_states(states.begin() + begin, states.begin() + end);
+    PushOrDefer(
+      [plan, begin, end, seg_inputs, seg_outputs, seg_states, is_train](
+          RunContext rctx,
+          engine::CallbackOnComplete on_complete) {
+        for (size_t k = begin; k < end; ++k) {
+          const CachedOpPlan::OpNode& n = plan->nodes[k];
+          OpContext opctx{is_train, rctx, engine::CallbackOnComplete(), n.requested};
+          std::vector<TBlob> input_blobs, output_blobs;
+          for (const auto& i : seg_inputs[k - begin]) input_blobs.push_back(i.data());
+          for (const auto& i : seg_outputs[k - begin]) output_blobs.push_back(i.data());
+          if (n.fn) {
+            n.fn(*n.attrs, opctx, input_blobs, n.req, output_blobs);
+          } else {
+            n.fstateful(seg_states[k - begin], opctx, input_blobs, n.req, output_blobs);
+          }
+        }
+        if (rctx.get_ctx().dev_mask() == gpu::kDevMask) {
+          rctx.get_stream<gpu>()->Wait();
+        }
+        on_complete();
+      }, plan->ctx, read_vars, write_vars,
+      PROFILER_MESSAGE(plan->segment_names[s].c_str()), &batch);
+  }
+  FlushBatch(&batch);
 }
 
 int MXCreateCachedOp(SymbolHandle handle,
@@ -466,19 +1091,19 @@ int MXCreateCachedOp(SymbolHandle handle,
   nnvm::Symbol* sym = static_cast<nnvm::Symbol*>(handle);
 
   API_BEGIN();
-  nnvm::Graph *g = new nnvm::Graph;
-  g->outputs = sym->outputs;
   auto vars = sym->ListInputs(nnvm::Symbol::kAll);
   CHECK_GE(vars.size(), 1) << "CachedOp must have at least 1 input.";
-  g->attrs["vars"] = std::make_shared<dmlc::any>(std::move(vars));
-  *out = g;
+  CachedOp *op = new CachedOp;
+  op->graph.outputs = sym->outputs;
+  op->vars = std::move(vars);
+  *out = op;
   API_END();
 }
 
 int MXFreeCachedOp(CachedOpHandle handle) {
-  nnvm::Graph *g = static_cast<nnvm::Graph*>(handle);
+  CachedOp *op = static_cast<CachedOp*>(handle);
   API_BEGIN();
-  delete g;
+  delete op;
   API_END();
 }
 
@@ -487,38 +1112,69 @@ int MXInvokeCachedOp(CachedOpHandle handle,
                      NDArrayHandle *inputs,
                      int *num_outputs,
                      NDArrayHandle **outputs) {
-  nnvm::Graph *g = static_cast<nnvm::Graph*>(handle);
+  CachedOp *op = static_cast<CachedOp*>(handle);
   MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
   NDArray** outarray = *reinterpret_cast<NDArray***>(outputs);
 
   API_BEGIN();
-  const std::vector<nnvm::NodePtr>& vars =
-    g->GetAttr<std::vector<nnvm::NodePtr> >("vars");
-  const nnvm::IndexedGraph& idx = g->indexed_graph();
+  static const size_t max_plans = dmlc::GetEnv("MXNET_CACHED_OP_MAX_PLANS", 16);
+  const std::vector<nnvm::NodePtr>& vars = op->vars;
   CHECK_EQ(static_cast<size_t>(num_inputs), vars.size())
       << "Actually number of inputs differs from expected number of inputs";
-  Context default_ctx = static_cast<NDArray*>(inputs[0])->ctx();
+  std::vector<NDArray> ndinputs;
+  ndinputs.reserve(num_inputs);
+  for (int i = 0; i < num_inputs; ++i) {
+    ndinputs.emplace_back(*static_cast<NDArray*>(inputs[i]));
+  }
 
-  std::vector<NDArray> buff(idx.num_node_entries());
-  for (size_t i = 0; i < vars.size(); ++i) {
-    buff[idx.entry_id(idx.node_id(vars[i].get()), 0)] =
-        *static_cast<NDArray*>(inputs[i]);
+  std::shared_ptr<CachedOpPlan> plan;
+  if (max_plans != 0) {
+    const bool recording = AutogradRuntime::Get()->IsRecording();
+    const std::string key = CachedOpSignature(ndinputs, recording);
+    std::lock_guard<std::mutex> lock(op->mutex);
+    auto it = op->plans.find(key);
+    if (it != op->plans.end()) {
+      plan = it->second;
+    } else {
+      // the plans keep the memory of their entries, the ones of the shapes
+      // seen before are dropped when the shapes keep changing
+      if (op->plans.size() >= max_plans) op->plans.clear();
+      plan = BuildCachedOpPlan(*op, ndinputs, recording);
+      // the graphs that cannot be compiled are not tried again
+      op->plans[key] = plan;
+    }
   }
 
-  for (size_t i = 0; i < idx.num_nodes(); ++i) {
-    const nnvm::IndexedGraph::Node& node = idx[i];
-    if (node.source->attrs.op == nullptr) continue;
-    std::vector<NDArray> in;
-    in.reserve(node.inputs.size());
-    for (const auto& j : node.inputs) {
-      in.emplace_back(buff[idx.entry_id(j)]);
+  // the plans have the node ids of this graph
+  const nnvm::IndexedGraph& idx = op->graph.indexed_graph();
+  std::vector<NDArray> buff;
+  if (plan != nullptr) {
+    InvokeCachedOpPlan(plan, ndinputs, &buff);
+  } else {
+    Context default_ctx = ndinputs[0].ctx();
+    buff.resize(idx.num_node_entries());
+    // operations of the graph are pushed to the engine in one batch
+    std::vector<Engine::AsyncOpr> batch;
+    for (size_t i = 0; i < vars.size(); ++i) {
+      buff[idx.entry_id(idx.node_id(vars[i].get()), 0)] = ndinputs[i];
     }
-    std::vector<NDArray> out(node.source->num_outputs());
-    ImperativeInvokeImpl(default_ctx, node.source->attrs, &in, &out);
 
-    for (size_t j = 0; j < node.source->num_outputs(); ++j) {
-      buff[idx.entry_id(i, j)] = std::move(out[j]);
+    for (size_t i = 0; i < idx.num_nodes(); ++i) {
+      const nnvm::IndexedGraph::Node& node = idx[i];
+      if (node.source->attrs.op == nullptr) continue;
+      std::vector<NDArray> in;
+      in.reserve(node.inputs.size());
+      for (const auto& j : node.inputs) {
+        in.emplace_back(buff[idx.entry_id(j)]);
+      }
+      std::vector<NDArray> out(node.source->num_outputs());
+      ImperativeInvokeImpl(default_ctx, node.source->attrs, &in, &out, &batch);
+
+      for (size_t j = 0; j < node.source->num_outputs(); ++j) {
+        buff[idx.entry_id(i, j)] = std::move(out[j]);
+      }
     }
+    FlushBatch(&batch);
   }
 
   if (outarray == nullptr) {
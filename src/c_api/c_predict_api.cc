@@ -28,10 +28,12 @@
 #include <mxnet/ndarray.h>
 #include <nnvm/pass_functions.h>
 #include <memory>
+#include <mutex>
 #include <unordered_set>
 #include <unordered_map>
 #include "./c_api_common.h"
 #include "../operator/operator_common.h"
+#include "../serving/predict_batcher.h"
 
 using namespace mxnet;
 
@@ -49,6 +51,18 @@ struct MXAPIPredictor {
   std::unordered_map<std::string, size_t> key2arg;
   // executor
   std::unique_ptr<Executor> exec;
+  // the symbol and the context, to bind more predictors
+  nnvm::Symbol sym;
+  Context ctx;
+  // the shapes of the inputs
+  std::unordered_map<std::string, TShape> input_shapes;
+  // auxiliary state arrays
+  std::vector<NDArray> aux_arrays;
+  // whether each argument was loaded from the parameters, the shared predictors read it
+  std::vector<bool> arg_is_param;
+  // the reshaped predictors of the buckets, created by MXPredGetBucket
+  std::unordered_map<int, std::unique_ptr<MXAPIPredictor> > buckets;
+  std::mutex buckets_mutex;
 };
 
 struct MXAPINDList {
@@ -57,6 +71,8 @@ struct MXAPINDList {
   std::vector<uint32_t> shapes_buffer;
   std::vector<size_t> indptr;
   std::vector<mx_float> data;
+  // the arrays that are read in place rather than copied into data
+  std::vector<NDArray> arrays;
 };
 
 int MXPredCreate(const char* symbol_json_str,
@@ -84,23 +100,85 @@ int MXPredCreate(const char* symbol_json_str,
 }
 namespace mxnet {
 
-}  // namespace mxnet
+/*! \brief sets the shapes of the inputs from the arguments of the C API */
+void SetInputShapes(mx_uint num_input_nodes,
+                    const char** input_keys,
+                    const mx_uint* input_shape_indptr,
+                    const mx_uint* input_shape_data,
+                    std::unordered_map<std::string, TShape>* input_shapes) {
+  for (mx_uint i = 0; i < num_input_nodes; ++i) {
+    (*input_shapes)[std::string(input_keys[i])] =
+        TShape(input_shape_data + input_shape_indptr[i],
+               input_shape_data + input_shape_indptr[i + 1]);
+  }
+}
 
-int MXPredCreatePartialOut(const char* symbol_json_str,
-                           const void* param_bytes,
-                           int param_size,
-                           int dev_type, int dev_id,
-                           mx_uint num_input_nodes,
-                           const char** input_keys,
-                           const mx_uint* input_shape_indptr,
-                           const mx_uint* input_shape_data,
-                           mx_uint num_output_nodes,
-                           const char** output_keys,
-                           PredictorHandle* out) {
+/*! \brief the shapes of the arguments, the auxiliary states and the outputs of a predictor */
+void PredictorInferShape(const nnvm::Symbol& sym,
+                         const std::unordered_map<std::string, TShape>& known_shape,
+                         std::vector<TShape>* arg_shapes,
+                         std::vector<TShape>* aux_shapes,
+                         std::vector<TShape>* out_shapes) {
+  using nnvm::Symbol;
+  out_shapes->resize(sym.ListOutputNames().size());
+  aux_shapes->resize(sym.ListInputNames(Symbol::kAuxiliaryStates).size());
+  try {
+    std::vector<TShape> in_shapes;
+    for (std::string key : sym.ListInputNames(Symbol::kAll)) {
+      auto it = known_shape.find(key);
+      in_shapes.push_back(it != known_shape.end() ? it->second : TShape());
+    }
+    nnvm::Graph g; g.outputs = sym.outputs;
+    g = nnvm::pass::InferShape(std::move(g), in_shapes, "__shape__");
+    bool infer_complete = (g.GetAttr<size_t>("shape_num_unknown_nodes") == 0);
+    CHECK(infer_complete)
+      << "The shape information of is not enough to get the shapes";
+    CopyAttr(g.indexed_graph(),
+             g.GetAttr<nnvm::ShapeVector>("shape"),
+             arg_shapes, out_shapes, aux_shapes);
+  } catch (const mxnet::op::InferShapeError &err) {
+    throw dmlc::Error(err.msg);
+  }
+}
+
+/*!
+ * \brief binds the executor of p to its argument and auxiliary state arrays,
+ *  with the memory of shared_exec when it is given
+ */
+void PredictorBind(MXAPIPredictor* p, Executor* shared_exec = nullptr) {
+  std::vector<std::string> arg_names = p->sym.ListInputNames(nnvm::Symbol::kReadOnlyArgs);
+  for (size_t i = 0; i < arg_names.size(); ++i) {
+    p->key2arg[arg_names[i]] = i;
+  }
+  std::map<std::string, Context> ctx_map;
+  std::vector<NDArray> grad_store(p->arg_arrays.size());
+  std::vector<OpReqType> grad_req(p->arg_arrays.size(), kNullOp);
+  p->exec.reset(Executor::Bind(p->sym, p->ctx, ctx_map,
+                               p->arg_arrays,
+                               grad_store, grad_req,
+                               p->aux_arrays, shared_exec));
+  p->out_arrays = p->exec->outputs();
+}
+
+/*!
+ * \brief creates the predictor ret of the parameters data, named names.
+ *  With read_params_in_place, the float32 parameters loaded on the context
+ *  of the predictor are its arguments rather than copied into them.
+ */
+void PredictorCreate(const char* symbol_json_str,
+                     const std::vector<NDArray>& data,
+                     const std::vector<std::string>& names,
+                     int dev_type, int dev_id,
+                     mx_uint num_input_nodes,
+                     const char** input_keys,
+                     const mx_uint* input_shape_indptr,
+                     const mx_uint* input_shape_data,
+                     mx_uint num_output_nodes,
+                     const char** output_keys,
+                     bool read_params_in_place,
+                     MXAPIPredictor* ret) {
   using nnvm::Symbol;
 
-  MXAPIPredictor* ret = new MXAPIPredictor();
-  API_BEGIN();
   Symbol sym;
   // make sure symbols are registered
   {
@@ -145,10 +223,6 @@ int MXPredCreatePartialOut(const char* symbol_json_str,
     for (size_t i = 0; i < aux_names_vec.size(); ++i) {
       aux_names.insert(aux_names_vec[i]);
     }
-    std::vector<NDArray> data;
-    std::vector<std::string> names;
-    dmlc::MemoryFixedSizeStream fi((void*)param_bytes, param_size);  // NOLINT(*)
-    NDArray::Load(&fi, &data, &names);
     CHECK_EQ(names.size(), data.size())
         << "Invalid param file format";
     for (size_t i = 0; i < names.size(); ++i) {
@@ -168,79 +242,206 @@ int MXPredCreatePartialOut(const char* symbol_json_str,
   }
 
   // shape inference and bind
-  std::unordered_map<std::string, TShape> known_shape;
-  for (mx_uint i = 0; i < num_input_nodes; ++i) {
-    known_shape[std::string(input_keys[i])] =
-        TShape(input_shape_data + input_shape_indptr[i],
-               input_shape_data + input_shape_indptr[i + 1]);
-  }
+  SetInputShapes(num_input_nodes, input_keys, input_shape_indptr, input_shape_data,
+                 &ret->input_shapes);
   std::vector<std::string> arg_names = sym.ListInputNames(Symbol::kReadOnlyArgs);
   std::vector<std::string> aux_names = sym.ListInputNames(Symbol::kAuxiliaryStates);
-  std::vector<TShape> out_shapes(sym.ListOutputNames().size());
-  std::vector<TShape> aux_shapes(aux_names.size());
-  std::vector<TShape> arg_shapes;
-  for (size_t i = 0; i < arg_names.size(); ++i) {
-    std::string key = arg_names[i];
-    ret->key2arg[key] = i;
-  }
-
-  try {
-    std::vector<TShape> in_shapes;
-    for (std::string key : sym.ListInputNames(Symbol::kAll)) {
-      if (known_shape.count(key) != 0) {
-        in_shapes.push_back(known_shape[key]);
-      } else {
-        in_shapes.push_back(TShape());
-      }
-    }
-    nnvm::Graph g; g.outputs = sym.outputs;
-    g = nnvm::pass::InferShape(std::move(g), in_shapes, "__shape__");
-    bool infer_complete = (g.GetAttr<size_t>("shape_num_unknown_nodes") == 0);
-    CHECK(infer_complete)
-      << "The shape information of is not enough to get the shapes";
-    CopyAttr(g.indexed_graph(),
-             g.GetAttr<nnvm::ShapeVector>("shape"),
-             &arg_shapes, &out_shapes, &aux_shapes);
-  } catch (const mxnet::op::InferShapeError &err) {
-    throw dmlc::Error(err.msg);
-  }
+  std::vector<TShape> arg_shapes, aux_shapes;
+  PredictorInferShape(sym, ret->input_shapes, &arg_shapes, &aux_shapes, &ret->out_shapes);
 
   Context ctx = Context::Create(static_cast<Context::DeviceType>(dev_type), dev_id);
 
-  std::vector<NDArray> arg_arrays, aux_arrays;
   for (size_t i = 0; i < arg_shapes.size(); ++i) {
+    const bool is_param = arg_params.count(arg_names[i]) != 0;
+    if (is_param && read_params_in_place) {
+      const NDArray& param = arg_params[arg_names[i]];
+      if (param.storage_type() == kDefaultStorage && param.ctx() == ctx &&
+          param.dtype() == mshadow::kFloat32 && param.shape() == arg_shapes[i]) {
+        ret->arg_arrays.push_back(param);
+        ret->arg_is_param.push_back(true);
+        continue;
+      }
+    }
     NDArray nd = NDArray(arg_shapes[i], ctx);
-    if (arg_params.count(arg_names[i]) != 0) {
+    if (is_param) {
       CopyFromTo(arg_params[arg_names[i]], &nd);
     }
-    arg_arrays.push_back(nd);
+    ret->arg_arrays.push_back(nd);
+    ret->arg_is_param.push_back(is_param);
   }
   for (size_t i = 0; i < aux_shapes.size(); ++i) {
     NDArray nd = NDArray(aux_shapes[i], ctx);
     if (aux_params.count(aux_names[i]) != 0) {
       CopyFromTo(aux_params[aux_names[i]], &nd);
     }
-    aux_arrays.push_back(nd);
+    ret->aux_arrays.push_back(nd);
   }
-  ret->arg_arrays = arg_arrays;
-  // bind
-  {
-    std::map<std::string, Context> ctx_map;
-    std::vector<NDArray> grad_store(arg_arrays.size());
-    std::vector<OpReqType> grad_req(arg_arrays.size(), kNullOp);
+  ret->sym = sym;
+  ret->ctx = ctx;
+  PredictorBind(ret);
+}
 
+/*! \brief creates ret, the predictor of src for other input shapes, see MXPredReshape */
+void PredictorReshape(MXAPIPredictor* src,
+                      mx_uint num_input_nodes,
+                      const char** input_keys,
+                      const mx_uint* input_shape_indptr,
+                      const mx_uint* input_shape_data,
+                      MXAPIPredictor* ret) {
+  ret->sym = src->sym;
+  ret->ctx = src->ctx;
+  ret->input_shapes = src->input_shapes;
+  SetInputShapes(num_input_nodes, input_keys, input_shape_indptr, input_shape_data,
+                 &ret->input_shapes);
+  std::vector<TShape> arg_shapes, aux_shapes;
+  PredictorInferShape(ret->sym, ret->input_shapes, &arg_shapes, &aux_shapes, &ret->out_shapes);
+  std::vector<std::string> arg_names = ret->sym.ListInputNames(nnvm::Symbol::kReadOnlyArgs);
+  // the arrays whose shapes do not change are reused, the parameters must not change
+  for (size_t i = 0; i < arg_shapes.size(); ++i) {
+    if (arg_shapes[i] == src->arg_arrays[i].shape()) {
+      ret->arg_arrays.push_back(src->arg_arrays[i]);
+    } else {
+      CHECK(!src->arg_is_param[i])
+          << "The input shapes change the shape of the parameter " << arg_names[i];
+      ret->arg_arrays.push_back(NDArray(arg_shapes[i], ret->ctx));
+    }
+    ret->arg_is_param.push_back(src->arg_is_param[i]);
+  }
+  for (size_t i = 0; i < aux_shapes.size(); ++i) {
+    CHECK_EQ(aux_shapes[i], src->aux_arrays[i].shape())
+        << "The input shapes change the shape of an auxiliary state";
+  }
+  ret->aux_arrays = src->aux_arrays;
+  PredictorBind(ret, src->exec.get());
+}
 
-    ret->exec.reset(Executor::Bind(sym, ctx, ctx_map,
-                                   arg_arrays,
-                                   grad_store, grad_req,
-                                   aux_arrays));
-    ret->out_shapes = out_shapes;
-    ret->out_arrays = ret->exec->outputs();
+}  // namespace mxnet
+
+int MXPredCreatePartialOut(const char* symbol_json_str,
+                           const void* param_bytes,
+                           int param_size,
+                           int dev_type, int dev_id,
+                           mx_uint num_input_nodes,
+                           const char** input_keys,
+                           const mx_uint* input_shape_indptr,
+                           const mx_uint* input_shape_data,
+                           mx_uint num_output_nodes,
+                           const char** output_keys,
+                           PredictorHandle* out) {
+  MXAPIPredictor* ret = new MXAPIPredictor();
+  API_BEGIN();
+  std::vector<NDArray> data;
+  std::vector<std::string> names;
+  dmlc::MemoryFixedSizeStream fi((void*)param_bytes, param_size);  // NOLINT(*)
+  NDArray::Load(&fi, &data, &names);
+  PredictorCreate(symbol_json_str, data, names, dev_type, dev_id,
+                  num_input_nodes, input_keys, input_shape_indptr, input_shape_data,
+                  num_output_nodes, output_keys, false, ret);
+  *out = ret;
+  API_END_HANDLE_ERROR(delete ret);
+}
+
+int MXPredCreateFromFile(const char* symbol_json_str,
+                         const char* param_file,
+                         int dev_type, int dev_id,
+                         mx_uint num_input_nodes,
+                         const char** input_keys,
+                         const mx_uint* input_shape_indptr,
+                         const mx_uint* input_shape_data,
+                         PredictorHandle* out) {
+  MXAPIPredictor* ret = new MXAPIPredictor();
+  API_BEGIN();
+  std::vector<NDArray> data;
+  std::vector<std::string> names;
+  NDArray::LoadMapped(param_file, &data, &names);
+  PredictorCreate(symbol_json_str, data, names, dev_type, dev_id,
+                  num_input_nodes, input_keys, input_shape_indptr, input_shape_data,
+                  0, NULL, true, ret);
+  *out = ret;
+  API_END_HANDLE_ERROR(delete ret);
+}
+
+int MXPredCreateShared(PredictorHandle handle,
+                       mx_uint num_input_nodes,
+                       const char** input_keys,
+                       const mx_uint* input_shape_indptr,
+                       const mx_uint* input_shape_data,
+                       PredictorHandle* out) {
+  MXAPIPredictor* src = static_cast<MXAPIPredictor*>(handle);
+  MXAPIPredictor* ret = new MXAPIPredictor();
+  API_BEGIN();
+  ret->sym = src->sym;
+  ret->ctx = src->ctx;
+  ret->input_shapes = src->input_shapes;
+  SetInputShapes(num_input_nodes, input_keys, input_shape_indptr, input_shape_data,
+                 &ret->input_shapes);
+  std::vector<TShape> arg_shapes, aux_shapes;
+  PredictorInferShape(ret->sym, ret->input_shapes, &arg_shapes, &aux_shapes, &ret->out_shapes);
+  std::vector<std::string> arg_names = ret->sym.ListInputNames(nnvm::Symbol::kReadOnlyArgs);
+  for (size_t i = 0; i < arg_shapes.size(); ++i) {
+    if (src->arg_is_param[i]) {
+      // the weights are only read, the predictors share them
+      CHECK_EQ(arg_shapes[i], src->arg_arrays[i].shape())
+          << "The input shapes change the shape of the parameter " << arg_names[i];
+      ret->arg_arrays.push_back(src->arg_arrays[i]);
+    } else {
+      ret->arg_arrays.push_back(NDArray(arg_shapes[i], ret->ctx));
+    }
+    ret->arg_is_param.push_back(src->arg_is_param[i]);
   }
+  // the auxiliary states are small, and the operators declare them as written,
+  // so that sharing them would serialize the predictors
+  for (size_t i = 0; i < aux_shapes.size(); ++i) {
+    CHECK_EQ(aux_shapes[i], src->aux_arrays[i].shape())
+        << "The input shapes change the shape of an auxiliary state";
+    NDArray nd = NDArray(aux_shapes[i], ret->ctx);
+    CopyFromTo(src->aux_arrays[i], &nd);
+    ret->aux_arrays.push_back(nd);
+  }
+  PredictorBind(ret);
+  *out = ret;
+  API_END_HANDLE_ERROR(delete ret);
+}
+
+int MXPredClone(PredictorHandle handle, PredictorHandle* out) {
+  return MXPredCreateShared(handle, 0, NULL, NULL, NULL, out);
+}
+
+int MXPredReshape(mx_uint num_input_nodes,
+                  const char** input_keys,
+                  const mx_uint* input_shape_indptr,
+                  const mx_uint* input_shape_data,
+                  PredictorHandle handle,
+                  PredictorHandle* out) {
+  MXAPIPredictor* src = static_cast<MXAPIPredictor*>(handle);
+  MXAPIPredictor* ret = new MXAPIPredictor();
+  API_BEGIN();
+  PredictorReshape(src, num_input_nodes, input_keys, input_shape_indptr, input_shape_data, ret);
   *out = ret;
   API_END_HANDLE_ERROR(delete ret);
 }
 
+int MXPredGetBucket(PredictorHandle handle,
+                    int bucket_key,
+                    mx_uint num_input_nodes,
+                    const char** input_keys,
+                    const mx_uint* input_shape_indptr,
+                    const mx_uint* input_shape_data,
+                    PredictorHandle* out) {
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  API_BEGIN();
+  std::lock_guard<std::mutex> lock(p->buckets_mutex);
+  auto it = p->buckets.find(bucket_key);
+  if (it == p->buckets.end()) {
+    std::unique_ptr<MXAPIPredictor> bucket(new MXAPIPredictor());
+    PredictorReshape(p, num_input_nodes, input_keys, input_shape_indptr, input_shape_data,
+                     bucket.get());
+    it = p->buckets.emplace(bucket_key, std::move(bucket)).first;
+  }
+  *out = it->second.get();
+  API_END();
+}
+
 int MXPredGetOutputShape(PredictorHandle handle,
                          mx_uint out_index,
                          mx_uint** shape_data,
@@ -273,6 +474,30 @@ int MXPredSetInput(PredictorHandle handle,
   API_END();
 }
 
+int MXPredBindInput(PredictorHandle handle,
+                    const char* key,
+                    mx_float* data,
+                    mx_uint size) {
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  API_BEGIN();
+  auto it = p->key2arg.find(key);
+  if (it == p->key2arg.end()) {
+    LOG(FATAL) << "cannot find input key " << key;
+  }
+  CHECK_EQ(p->ctx.dev_mask(), cpu::kDevMask)
+      << "Only the inputs of a cpu predictor can be bound to a buffer";
+  CHECK(!p->arg_is_param[it->second]) << "Cannot bind the parameter " << key << " to a buffer";
+  const TShape& shape = p->arg_arrays[it->second].shape();
+  CHECK_EQ(static_cast<size_t>(size), shape.Size()) << "Memory size do not match";
+  p->arg_arrays[it->second] = NDArray(TBlob(data, shape, cpu::kDevMask), 0);
+  // the executor may still run, it is replaced once it is done; the new one
+  // takes its memory
+  for (const NDArray& nd : p->out_arrays) nd.WaitToRead();
+  std::unique_ptr<Executor> old_exec(std::move(p->exec));
+  PredictorBind(p, old_exec.get());
+  API_END();
+}
+
 int MXPredForward(PredictorHandle handle) {
   MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
   API_BEGIN();
@@ -300,41 +525,167 @@ int MXPredGetOutput(PredictorHandle handle,
   API_END();
 }
 
+int MXPredGetOutputAsync(PredictorHandle handle,
+                         mx_uint index,
+                         mx_float* data,
+                         mx_uint size,
+                         MXPredCopyCallback callback,
+                         void* callback_param) {
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  API_BEGIN();
+  CHECK_LT(index, p->out_arrays.size())
+      << "Output index out of range";
+  CHECK(callback != nullptr) << "MXPredGetOutputAsync needs a callback";
+  p->out_arrays[index].AsyncCopyToCPU(data, size, [callback, callback_param]() {
+      callback(callback_param);
+    });
+  API_END();
+}
+
+int MXPredGetOutputPtr(PredictorHandle handle,
+                       mx_uint index,
+                       const mx_float** data,
+                       mx_uint* size) {
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
+  API_BEGIN();
+  CHECK_LT(index, p->out_arrays.size())
+      << "Output index out of range";
+  const NDArray& nd = p->out_arrays[index];
+  CHECK_EQ(nd.ctx().dev_mask(), cpu::kDevMask)
+      << "Only the outputs of a cpu predictor can be read in place, use MXPredGetOutput";
+  CHECK_EQ(nd.dtype(), mshadow::kFloat32) << "The output is not float32, use MXPredGetOutput";
+  nd.WaitToRead();
+  *data = nd.data().dptr<mx_float>();
+  *size = static_cast<mx_uint>(nd.shape().Size());
+  API_END();
+}
+
 int MXPredFree(PredictorHandle handle) {
   API_BEGIN();
   delete static_cast<MXAPIPredictor*>(handle);
   API_END();
 }
 
-int MXNDListCreate(const char* nd_file_bytes,
-                   int nd_file_size,
-                   NDListHandle *out,
-                   mx_uint* out_length) {
-  MXAPINDList* ret = new MXAPINDList();
+int MXPredBatcherCreate(PredictorHandle handle,
+                        const char* input_key,
+                        mx_uint num_batch_sizes,
+                        const mx_uint* batch_sizes,
+                        mx_uint num_workers,
+                        mx_uint max_delay_us,
+                        PredictBatcherHandle* out) {
+  MXAPIPredictor* p = static_cast<MXAPIPredictor*>(handle);
   API_BEGIN();
-  std::vector<NDArray> arrays;
-  dmlc::MemoryFixedSizeStream fi((void*)nd_file_bytes, nd_file_size);  // NOLINT(*)
-  NDArray::Load(&fi,
-                &(arrays),
-                &(ret->keys));
+  auto it = p->input_shapes.find(input_key);
+  if (it == p->input_shapes.end()) {
+    LOG(FATAL) << "cannot find input key " << input_key;
+  }
+  CHECK_GT(it->second.ndim(), 0U) << "The input " << input_key << " has no batch axis";
+  std::vector<mx_uint> sample_shape(it->second.begin() + 1, it->second.end());
+  *out = new serving::PredictBatcher(
+      handle, input_key, sample_shape, p->out_arrays.size(),
+      std::vector<mx_uint>(batch_sizes, batch_sizes + num_batch_sizes),
+      num_workers, max_delay_us);
+  API_END();
+}
+
+int MXPredBatcherGetOutputShape(PredictBatcherHandle handle,
+                                mx_uint index,
+                                const mx_uint** shape_data,
+                                mx_uint* shape_ndim) {
+  serving::PredictBatcher* b = static_cast<serving::PredictBatcher*>(handle);
+  API_BEGIN();
+  const std::vector<mx_uint>& s = b->OutputShape(index);
+  *shape_data = s.data();
+  *shape_ndim = static_cast<mx_uint>(s.size());
+  API_END();
+}
+
+int MXPredBatcherRun(PredictBatcherHandle handle,
+                     const mx_float* data,
+                     mx_uint size,
+                     mx_uint num_outputs,
+                     mx_float** outputs,
+                     const mx_uint* output_sizes) {
+  serving::PredictBatcher* b = static_cast<serving::PredictBatcher*>(handle);
+  API_BEGIN();
+  CHECK_EQ(static_cast<size_t>(size), b->input_size()) << "Memory size do not match";
+  CHECK_EQ(static_cast<size_t>(num_outputs), b->num_outputs())
+      << "The number of outputs do not match";
+  for (mx_uint i = 0; i < num_outputs; ++i) {
+    CHECK_EQ(static_cast<size_t>(output_sizes[i]), b->output_size(i))
+        << "Memory size of output " << i << " do not match";
+  }
+  b->Run(data, outputs);
+  API_END();
+}
+
+int MXPredBatcherFree(PredictBatcherHandle handle) {
+  API_BEGIN();
+  delete static_cast<serving::PredictBatcher*>(handle);
+  API_END();
+}
+
+namespace mxnet {
+
+/*!
+ * \brief fills the list ret with the loaded arrays, the dense float32 cpu
+ *  arrays are read in place when in_place is set
+ */
+void NDListInit(const std::vector<NDArray>& arrays, bool in_place, MXAPINDList* ret) {
   if (ret->keys.size() == 0) {
     ret->keys.resize(arrays.size());
   }
   ret->indptr.push_back(0);
+  ret->arrays.resize(arrays.size());
   for (size_t i = 0; i < arrays.size(); ++i) {
     TShape shape = arrays[i].shape();
     size_t begin = ret->data.size();
     size_t size = shape.Size();
     ret->shapes.push_back(shape);
+    if (in_place && arrays[i].storage_type() == kDefaultStorage &&
+        arrays[i].ctx().dev_mask() == cpu::kDevMask && arrays[i].dtype() == mshadow::kFloat32) {
+      ret->arrays[i] = arrays[i];
+      ret->indptr.push_back(begin);
+      continue;
+    }
     ret->data.resize(begin + size);
     arrays[i].SyncCopyToCPU(dmlc::BeginPtr(ret->data) + begin, size);
     ret->indptr.push_back(begin + size);
   }
+}
+
+}  // namespace mxnet
+
+int MXNDListCreate(const char* nd_file_bytes,
+                   int nd_file_size,
+                   NDListHandle *out,
+                   mx_uint* out_length) {
+  MXAPINDList* ret = new MXAPINDList();
+  API_BEGIN();
+  std::vector<NDArray> arrays;
+  dmlc::MemoryFixedSizeStream fi((void*)nd_file_bytes, nd_file_size);  // NOLINT(*)
+  NDArray::Load(&fi,
+                &(arrays),
+                &(ret->keys));
+  NDListInit(arrays, false, ret);
   *out = ret;
   *out_length = static_cast<mx_uint>(arrays.size());
   API_END();
 }
 
+int MXNDListCreateFromFile(const char* nd_file,
+                           NDListHandle *out,
+                           mx_uint* out_length) {
+  MXAPINDList* ret = new MXAPINDList();
+  API_BEGIN();
+  std::vector<NDArray> arrays;
+  NDArray::LoadMapped(nd_file, &arrays, &(ret->keys));
+  NDListInit(arrays, true, ret);
+  *out = ret;
+  *out_length = static_cast<mx_uint>(arrays.size());
+  API_END_HANDLE_ERROR(delete ret);
+}
+
 int MXNDListGet(NDListHandle handle,
                 mx_uint index,
                 const char** out_key,
@@ -346,7 +697,11 @@ int MXNDListGet(NDListHandle handle,
   CHECK_LT(index, p->shapes.size())
       << "Index out of range";
   *out_key = p->keys[index].c_str();
-  *out_data = dmlc::BeginPtr(p->data) + p->indptr[index];
+  if (p->arrays[index].is_none()) {
+    *out_data = dmlc::BeginPtr(p->data) + p->indptr[index];
+  } else {
+    *out_data = p->arrays[index].data().dptr<mx_float>();
+  }
   const TShape& s = p->shapes[index];
   p->shapes_buffer.resize(s.ndim());
   nnvm::ShapeTypeCast(s.begin(), s.end(), p->shapes_buffer.data());
@@ -51,6 +51,10 @@ extern __cuda_fake_struct blockIdx;
 #include <cuda_runtime.h>
 #include <cublas_v2.h>
 #include <curand.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
 
 namespace mxnet {
 namespace common {
@@ -292,6 +296,97 @@ inline bool GetEnvAllowTensorCore() {
                       dmlc::optional<bool>(default_value)).value();
 }
 
+/*!
+ * \brief Enable once the direct access of a gpu to the memory of a peer, so
+ *  that the copies between them are not staged through the host.
+ * \param device_id The device index of the current gpu.
+ * \param peer_id The device index of the peer.
+ * \return whether the current gpu can access the memory of the peer.
+ */
+inline bool EnablePeerAccess(int device_id, int peer_id) {
+  static std::mutex mutex;
+  static std::map<std::pair<int, int>, bool> enabled;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = enabled.find(std::make_pair(device_id, peer_id));
+  if (it != enabled.end()) return it->second;
+  int access = 0;
+  CUDA_CALL(cudaDeviceCanAccessPeer(&access, device_id, peer_id));
+  bool ok = false;
+  if (access) {
+    cudaError_t e = cudaDeviceEnablePeerAccess(peer_id, 0);
+    ok = e == cudaSuccess || e == cudaErrorPeerAccessAlreadyEnabled;
+    // clear the error of an access enabled before
+    cudaGetLastError();
+  }
+  if (!ok) {
+    LOG(WARNING) << "GPU " << device_id << " cannot access the memory of GPU " << peer_id
+                 << ", the copies between them go through the host";
+  }
+  enabled[std::make_pair(device_id, peer_id)] = ok;
+  return ok;
+}
+
+/*!
+ * \brief The bytes that binds have planned for their arrays on a gpu but not
+ *  allocated yet. The operators a bind creates before its arrays, such as the
+ *  cuDNN convolutions sizing their workspace by the free memory, count them as used.
+ * \param device_id The device index of the gpu.
+ * \param delta The bytes to add, negative once they are allocated.
+ * \return The planned bytes of the gpu after the change.
+ */
+inline int64_t PlannedGPUMemory(int device_id, int64_t delta = 0) {
+  static std::mutex mutex;
+  static std::map<int, int64_t> planned;
+  std::lock_guard<std::mutex> lock(mutex);
+  int64_t& bytes = planned[device_id];
+  bytes += delta;
+  return bytes;
+}
+
+/*! \brief Adds the planned bytes of each gpu to PlannedGPUMemory during its lifetime. */
+class PlannedGPUMemoryScope {
+ public:
+  explicit PlannedGPUMemoryScope(const std::map<int, int64_t>& bytes) : bytes_(bytes) {
+    for (const auto& kv : bytes_) PlannedGPUMemory(kv.first, kv.second);
+  }
+  ~PlannedGPUMemoryScope() {
+    for (const auto& kv : bytes_) PlannedGPUMemory(kv.first, -kv.second);
+  }
+
+ private:
+  std::map<int, int64_t> bytes_;
+};
+
+/*!
+ * \brief Whether the gpu arrays are allocated as CUDA managed memory, which the
+ *  driver migrates between the gpu and the host on demand.
+ * \return whether MXNET_GPU_MEM_POOL_TYPE is set to Unified.
+ */
+inline bool UseManagedMemory() {
+  static const bool managed =
+      dmlc::GetEnv("MXNET_GPU_MEM_POOL_TYPE", std::string("Pooled")) == "Unified";
+  return managed;
+}
+
+/*!
+ * \brief Migrate managed memory to a gpu ahead of its use by work on a stream, so the
+ *  kernels do not stall on page faults. A hint only, errors are ignored.
+ * \param ptr The start of the memory.
+ * \param size The bytes to migrate.
+ * \param device_id The device index of the gpu.
+ * \param stream The stream the work using the memory runs on.
+ */
+inline void PrefetchManagedMemory(const void* ptr, size_t size, int device_id,
+                                  cudaStream_t stream) {
+#if CUDA_VERSION >= 8000
+  if (ptr == nullptr || size == 0) return;
+  if (cudaMemPrefetchAsync(ptr, size, device_id, stream) != cudaSuccess) {
+    // e.g. a device without concurrent managed access
+    cudaGetLastError();
+  }
+#endif  // CUDA_VERSION >= 8000
+}
+
 #endif  // MXNET_USE_CUDA
 
 #if MXNET_USE_CUDNN
@@ -27,6 +27,7 @@
 namespace mxnet {
 const char MXRtc::str_type[] = "float";
 std::unordered_map<std::string, char*> MXRtc::kernel_registry;
+std::mutex MXRtc::registry_mutex;
 
 MXRtc::MXRtc(const std::string& name,
              std::vector<std::pair<std::string, NDArray> > const& input,
@@ -36,13 +37,31 @@ MXRtc::MXRtc(const std::string& name,
     num_input_ = input.size();
     num_output_ = output.size();
     code_ = decorate(name, input, output, kernel);
+    std::lock_guard<std::mutex> lock(registry_mutex);
     if (MXRtc::kernel_registry.find(code_) != MXRtc::kernel_registry.end()) {
         ptx_ = MXRtc::kernel_registry[code_];
     } else {
         ptx_ = compile(name, code_);
+        MXRtc::kernel_registry[code_] = ptx_;
     }
 }
 
+CUfunction MXRtc::GetFunction(int dev_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = func_.find(dev_id);
+    if (it != func_.end()) return it->second;
+    cudaError_enum err;
+    CUmodule module;
+    CUfunction func;
+    CHECK_EQ(err = cuModuleLoadDataEx(&module, ptx_, 0, 0, 0), CUDA_SUCCESS)
+        << "CudaError: " << err;
+    CHECK_EQ(err = cuModuleGetFunction(&func, module, name_.c_str()), CUDA_SUCCESS)
+        << "CudaError: " << err;
+    module_[dev_id] = module;
+    func_[dev_id] = func;
+    return func;
+}
+
 void MXRtc::push(std::vector<NDArray> const& input,
                  std::vector<NDArray> const& output,
                  unsigned int grid_dim_X,
@@ -54,20 +73,7 @@ void MXRtc::push(std::vector<NDArray> const& input,
     CHECK_EQ(num_input_, input.size());
     CHECK_EQ(num_output_, output.size());
     CHECK(output.size());
-    cudaError_enum err;
-    CUfunction func;
-    int dev_id = output[0].ctx().dev_id;
-    if (func_.find(dev_id) != func_.end()) {
-        func = func_[dev_id];
-    } else {
-        CUmodule module;
-        CHECK_EQ(err = cuModuleLoadDataEx(&module, ptx_, 0, 0, 0), CUDA_SUCCESS)
-            << "CudaError: " << err;
-        CHECK_EQ(err = cuModuleGetFunction(&func, module, name_.c_str()), CUDA_SUCCESS)
-            << "CudaError: " << err;
-        module_[dev_id] = module;
-        func_[dev_id] = func;
-    }
+    CUfunction func = GetFunction(output[0].ctx().dev_id);
     auto op = [this, func, input, output,
                grid_dim_X, grid_dim_Y, grid_dim_Z,
                block_dim_X, block_dim_Y, block_dim_Z](RunContext rctx) {
@@ -93,6 +99,28 @@ void MXRtc::push(std::vector<NDArray> const& input,
             FnProperty::kNormal, 0, PROFILER_MESSAGE("MXRtc"));
 }
 
+void MXRtc::Launch(std::vector<TBlob> const& input,
+                   std::vector<TBlob> const& output,
+                   int dev_id,
+                   mshadow::Stream<gpu> *stream,
+                   unsigned int grid_dim_X,
+                   unsigned int block_dim_X) {
+    CHECK_EQ(num_input_, input.size());
+    CHECK_EQ(num_output_, output.size());
+    CUfunction func = GetFunction(dev_id);
+    std::vector<float*> float_args;
+    for (auto& i : input) float_args.push_back(static_cast<float*>(i.dptr_));
+    for (auto& i : output) float_args.push_back(static_cast<float*>(i.dptr_));
+    std::vector<void*> args;
+    for (auto& i : float_args) args.push_back(&i);
+    cudaError_enum err;
+    CHECK_EQ(err = cuLaunchKernel(func,
+                                  grid_dim_X, 1, 1,
+                                  block_dim_X, 1, 1,
+                                  0, mshadow::Stream<gpu>::GetStream(stream),
+                                  args.data(), 0), CUDA_SUCCESS) << "CudaError: " << err;
+}
+
 std::string MXRtc::decorate(const std::string& name,
                          std::vector<std::pair<std::string, NDArray> > const& input,
                          std::vector<std::pair<std::string, NDArray> > const& output,
@@ -23,6 +23,7 @@
 #define MXNET_COMMON_OBJECT_POOL_H_
 #include <dmlc/logging.h>
 #include <cstdlib>
+#include <memory>
 #include <mutex>
 #include <utility>
 #include <vector>
@@ -31,6 +32,11 @@ namespace mxnet {
 namespace common {
 /*!
  * \brief Object pool for fast allocation and deallocation.
+ *
+ *  Each thread keeps a small cache of free objects, moved from and to the
+ *  shared free list a batch at a time. An object freed on another thread
+ *  than the one that allocated it, as when the engine pushes from one thread
+ *  and completes on a worker, goes back to the shared list with the batch.
  */
 template <typename T>
 class ObjectPool {
@@ -86,6 +92,31 @@ class ObjectPool {
    * Currently defined to be 4KB.
    */
   constexpr static std::size_t kPageSize = 1 << 12;
+  /*! \brief number of objects moved between a thread cache and the shared list */
+  constexpr static std::size_t kCacheBatch = 32;
+  /*!
+   * \brief The free objects cached by a thread. It is trivially destructible
+   *  so that it stays usable by the destructors run at the thread exit.
+   */
+  struct LocalCache {
+    /*! \brief head of the cached free list */
+    LinkedList* head{nullptr};
+    /*! \brief number of cached objects */
+    std::size_t size{0};
+    /*! \brief whether the releaser of the cache is created */
+    bool registered{false};
+    /*! \brief whether the thread exits, the objects then skip the cache */
+    bool released{false};
+  };
+  /*! \brief Returns the objects cached by a thread to the pool at the thread exit. */
+  struct LocalCacheReleaser {
+    LocalCache* cache;
+    std::shared_ptr<ObjectPool> pool;
+    ~LocalCacheReleaser() {
+      pool->ReturnToPool(cache, cache->size);
+      cache->released = true;
+    }
+  };
   /*! \brief internal mutex */
   std::mutex m_;
   /*!
@@ -106,6 +137,12 @@ class ObjectPool {
    * This function is not protected and must be called with caution.
    */
   void AllocateChunk();
+  /*! \return the object cache of the calling thread */
+  static LocalCache* GetLocalCache();
+  /*! \brief move a batch of objects from the shared list to cache */
+  void TakeFromPool(LocalCache* cache);
+  /*! \brief move the first num objects of cache to the shared list */
+  void ReturnToPool(LocalCache* cache, std::size_t num);
   DISALLOW_COPY_AND_ASSIGN(ObjectPool);
 };  // class ObjectPool
 
@@ -141,13 +178,21 @@ template <typename T>
 template <typename... Args>
 T* ObjectPool<T>::New(Args&&... args) {
   LinkedList* ret;
-  {
+  LocalCache* cache = GetLocalCache();
+  if (cache->released) {
     std::lock_guard<std::mutex> lock{m_};
-    if (head_->next == nullptr) {
+    if (head_ == nullptr) {
       AllocateChunk();
     }
     ret = head_;
     head_ = head_->next;
+  } else {
+    if (cache->head == nullptr) {
+      TakeFromPool(cache);
+    }
+    ret = cache->head;
+    cache->head = ret->next;
+    --cache->size;
   }
   return new (static_cast<void*>(ret)) T(std::forward<Args>(args)...);
 }
@@ -156,11 +201,59 @@ template <typename T>
 void ObjectPool<T>::Delete(T* ptr) {
   ptr->~T();
   auto linked_list_ptr = reinterpret_cast<LinkedList*>(ptr);
-  {
+  LocalCache* cache = GetLocalCache();
+  if (cache->released) {
     std::lock_guard<std::mutex> lock{m_};
     linked_list_ptr->next = head_;
     head_ = linked_list_ptr;
+    return;
+  }
+  linked_list_ptr->next = cache->head;
+  cache->head = linked_list_ptr;
+  // keep a batch for the next allocations, return the one before
+  if (++cache->size >= 2 * kCacheBatch) {
+    ReturnToPool(cache, kCacheBatch);
+  }
+}
+
+template <typename T>
+typename ObjectPool<T>::LocalCache* ObjectPool<T>::GetLocalCache() {
+  static thread_local LocalCache cache;
+  if (!cache.registered) {
+    cache.registered = true;
+    static thread_local LocalCacheReleaser releaser{&cache, _GetSharedRef()};
+  }
+  return &cache;
+}
+
+template <typename T>
+void ObjectPool<T>::TakeFromPool(LocalCache* cache) {
+  std::lock_guard<std::mutex> lock{m_};
+  for (std::size_t i = 0; i < kCacheBatch; ++i) {
+    if (head_ == nullptr) {
+      AllocateChunk();
+    }
+    LinkedList* ptr = head_;
+    head_ = ptr->next;
+    ptr->next = cache->head;
+    cache->head = ptr;
+  }
+  cache->size += kCacheBatch;
+}
+
+template <typename T>
+void ObjectPool<T>::ReturnToPool(LocalCache* cache, std::size_t num) {
+  if (num == 0) return;
+  LinkedList* first = cache->head;
+  LinkedList* last = first;
+  for (std::size_t i = 1; i < num; ++i) {
+    last = last->next;
   }
+  cache->head = last->next;
+  cache->size -= num;
+  std::lock_guard<std::mutex> lock{m_};
+  last->next = head_;
+  head_ = first;
 }
 
 template <typename T>
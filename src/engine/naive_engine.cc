@@ -96,16 +96,16 @@ class NaiveEngine final : public Engine {
           opr->opr_stat = Profiler::Get()->AddOprStat(exec_ctx.dev_type, exec_ctx.dev_id);
           uint64_t id = std::hash<std::thread::id>()(std::this_thread::get_id());
           opr->opr_stat->thread_id = id;
-          strncpy(opr->opr_stat->opr_name,
-            opr->opr_name,
-            sizeof(opr->opr_stat->opr_name) - 1);
-          SetOprStart(opr->opr_stat);
+          opr->opr_stat->opr_name = opr->opr_name;
+          SetOprStart(opr->opr_stat, ctx);
         }
+        MemoryScope memory_scope(opr->profiling ? opr->opr_name : nullptr);
         opr->fn(ctx, on_complete);
         if (opr->profiling) {
           SetOprEnd(opr->opr_stat);
         }
 #else
+        MemoryScope memory_scope(nullptr);
         opr->fn(ctx, on_complete);
 #endif
       },
@@ -140,12 +140,10 @@ class NaiveEngine final : public Engine {
       opr->opr_stat = Profiler::Get()->AddOprStat(exec_ctx.dev_type, exec_ctx.dev_id);
       uint64_t id = std::hash<std::thread::id>()(std::this_thread::get_id());
       opr->opr_stat->thread_id = id;
-      strncpy(opr->opr_stat->opr_name,
-              opr->opr_name,
-              sizeof(opr->opr_stat->opr_name) - 1);
-      SetOprStart(opr->opr_stat);
+      opr->opr_stat->opr_name = opr->opr_name;
     }
 #endif
+    RunContext rctx{exec_ctx, &cpu_stream_};
     if (exec_ctx.dev_mask() == gpu::kDevMask) {
 #if MXNET_USE_CUDA
       size_t dev_id = static_cast<size_t>(exec_ctx.dev_id);
@@ -156,13 +154,21 @@ class NaiveEngine final : public Engine {
       if (streams_[dev_id] == nullptr) {
         streams_[dev_id] = mshadow::NewStream<gpu>(true, MXNET_USE_CUDNN != 0);
       }
-      exec_fun(RunContext{exec_ctx, streams_[dev_id]}, callback);
+      rctx.stream = streams_[dev_id];
 #else
       LOG(FATAL) << "GPU is not enabled";
 #endif
-    } else {
-      exec_fun(RunContext{exec_ctx, &cpu_stream_}, callback);
     }
+#if MXNET_USE_PROFILER
+    if (profiling) {
+      SetOprStart(opr->opr_stat, rctx);
+    }
+    MemoryScope memory_scope(profiling ? opr_name : nullptr);
+#else
+    // the scope still marks the invocation, for the elastic temp space
+    MemoryScope memory_scope(nullptr);
+#endif
+    exec_fun(rctx, callback);
     CHECK(this->req_completed_)
         << "NaiveEngine only support synchronize Push so far";
 #if MXNET_USE_PROFILER
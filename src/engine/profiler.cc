@@ -24,24 +24,41 @@
 #include <dmlc/base.h>
 #include <dmlc/logging.h>
 #include <mxnet/base.h>
+#include <mxnet/storage.h>
 #include <set>
 #include <map>
 #include <mutex>
 #include <chrono>
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <thread>
+#include <cstring>
 #include "./profiler.h"
+#include "../io/iter_stats.h"
+#include "../common/cuda_utils.h"
 
 #if defined(_MSC_VER) && _MSC_VER <= 1800
 #include <Windows.h>
 #endif
+#ifndef _WIN32
+#include <signal.h>
+#endif
 
 namespace mxnet {
 namespace engine {
 const int INITIAL_SIZE = 1024;
 
+thread_local const char* MemoryScope::current_ = nullptr;
+thread_local uint64_t MemoryScope::serial_ = 0;
+std::atomic<uint64_t> MemoryScope::next_serial_(0);
+
 Profiler::Profiler()
-  : state_(kNotRunning), enable_output_(false), filename_("profile.json") {
+  : state_(kNotRunning), enable_output_(false), aggregate_(false), memory_(false),
+    ring_capacity_(0),
+    filename_("profile.json") {
   this->init_time_ = NowInUsec();
 
   // TODO(ziheng) get device number during execution
@@ -65,6 +82,11 @@ Profiler::Profiler()
   profile_stat[cpu_num_ + gpu_num_].dev_name = "cpu pinned/";
 
   mode_ = (ProfilerMode)dmlc::GetEnv("MXNET_PROFILER_MODE", static_cast<int>(kOnlySymbolic));
+  aggregate_ = dmlc::GetEnv("MXNET_PROFILER_AGGREGATE", false);
+  memory_ = dmlc::GetEnv("MXNET_PROFILER_MEMORY", false);
+  ring_capacity_ = dmlc::GetEnv("MXNET_PROFILER_RING_BUFFER", 0);
+  int ring_signal = dmlc::GetEnv("MXNET_PROFILER_RING_SIGNAL", 0);
+  if (ring_signal > 0) this->WatchRingSignal(ring_signal);
   if (dmlc::GetEnv("MXNET_PROFILER_AUTOSTART", 0)) {
     this->state_ = ProfilerState::kRunning;
     this->enable_output_ = true;
@@ -94,29 +116,79 @@ void Profiler::SetConfig(ProfilerMode mode, std::string output_filename) {
   this->filename_ = output_filename;
 }
 
-OprExecStat *Profiler::AddOprStat(int dev_type, uint32_t dev_id) {
-  OprExecStat* opr_stat = new OprExecStat;
-  opr_stat->dev_type = dev_type;
-  opr_stat->dev_id   = dev_id;
-  opr_stat->opr_name[sizeof(opr_stat->opr_name)-1] = '\0';
+void Profiler::SetMemory(bool memory) {
+  std::lock_guard<std::mutex> lock{this->m_};
+  this->memory_ = memory;
+}
+
+void Profiler::AddMemoryEvent(const Context& ctx, size_t bytes, bool alloc,
+                              size_t bytes_in_use) {
+  MemoryEvent e;
+  e.ts = NowInUsec() - init_time_;
+  e.bytes = bytes;
+  e.bytes_in_use = bytes_in_use;
+  e.thread_id = std::hash<std::thread::id>()(std::this_thread::get_id());
+  e.alloc = alloc;
+  const char* scope = MemoryScope::Current();
+  e.scope = scope != nullptr ? scope : "unknown";
+  DevStat& dev_stat = profile_stat[DevIndex(ctx.dev_type, ctx.dev_id)];
+  std::lock_guard<std::mutex> lock{dev_stat.m_};
+  dev_stat.memory_events.push_back(std::move(e));
+}
 
-  int idx;
+void Profiler::AddTempSpace(const Context& ctx, size_t bytes, bool alloc) {
+  const char* scope = MemoryScope::Current();
+  DevStat& dev_stat = profile_stat[DevIndex(ctx.dev_type, ctx.dev_id)];
+  std::lock_guard<std::mutex> lock{dev_stat.m_};
+  TempSpaceStat& stat = dev_stat.temp_space_stats[scope != nullptr ? scope : "unknown"];
+  ++stat.requests;
+  if (alloc) ++stat.allocs;
+  stat.peak_bytes = std::max<uint64_t>(stat.peak_bytes, bytes);
+}
+
+void Profiler::SetAggregate(bool aggregate) {
+  std::lock_guard<std::mutex> lock{this->m_};
+  this->aggregate_ = aggregate;
+}
+
+uint32_t Profiler::DevIndex(int dev_type, uint32_t dev_id) const {
   switch (dev_type) {
     case Context::kCPU:
-      idx = dev_id;
-      break;
+    case Context::kCPUShared:
+      return dev_id;
     case Context::kGPU:
-      idx = cpu_num_ + dev_id;
-      break;
+      return cpu_num_ + dev_id;
     case Context::kCPUPinned:
-      idx = cpu_num_ + gpu_num_;
-      break;
+      return cpu_num_ + gpu_num_;
     default:
       LOG(FATAL) << "Unkown dev_type";
-      return NULL;
+      return 0;
   }
+}
 
-  DevStat& dev_stat = profile_stat[idx];
+OprExecStat *Profiler::AddOprStat(int dev_type, uint32_t dev_id) {
+  const bool ring = !aggregate_ && ring_capacity_ != 0;
+  OprExecStat* opr_stat = nullptr;
+  if (ring) {
+    // the records of the ring mode are reused, their names keep their capacity
+    EventRing* thread_ring = ThreadRing();
+    if (!thread_ring->free_stats.empty()) {
+      opr_stat = thread_ring->free_stats.back();
+      thread_ring->free_stats.pop_back();
+    }
+  }
+  if (opr_stat == nullptr) opr_stat = new OprExecStat;
+  opr_stat->dev_type = dev_type;
+  opr_stat->dev_id   = dev_id;
+  opr_stat->aggregate = aggregate_;
+  opr_stat->ring = ring;
+  opr_stat->push_rel_micros = 0;
+  opr_stat->ready_rel_micros = 0;
+  opr_stat->dequeue_rel_micros = 0;
+  // the aggregated records and the ones of the rings are only kept at their end
+  if (opr_stat->aggregate || opr_stat->ring) return opr_stat;
+
+  DevStat& dev_stat = profile_stat[DevIndex(dev_type, dev_id)];
   {
     std::lock_guard<std::mutex> lock{dev_stat.m_};
     dev_stat.opr_exec_stats.push_back(opr_stat);
@@ -124,6 +196,337 @@ OprExecStat *Profiler::AddOprStat(int dev_type, uint32_t dev_id) {
   return opr_stat;
 }
 
+void Profiler::AggregateOprStat(OprExecStat* opr_stat) {
+  const uint64_t micros = opr_stat->opr_end_rel_micros - opr_stat->opr_start_rel_micros;
+  DevStat& dev_stat = profile_stat[DevIndex(opr_stat->dev_type, opr_stat->dev_id)];
+  {
+    std::lock_guard<std::mutex> lock{dev_stat.m_};
+    OprAggregateStat& agg = dev_stat.opr_aggregate_stats[opr_stat->opr_name];
+    ++agg.count;
+    agg.total_micros += micros;
+    agg.min_micros = std::min(agg.min_micros, micros);
+    agg.max_micros = std::max(agg.max_micros, micros);
+    if (opr_stat->push_rel_micros != 0) {
+      ++agg.sched_count;
+      agg.deps_wait_micros += opr_stat->ready_rel_micros - opr_stat->push_rel_micros;
+      agg.queue_wait_micros += opr_stat->dequeue_rel_micros - opr_stat->ready_rel_micros;
+    }
+  }
+  delete opr_stat;
+}
+
+void Profiler::FinishOprStat(OprExecStat* opr_stat) {
+  if (opr_stat->aggregate) {
+    AggregateOprStat(opr_stat);
+  } else if (opr_stat->ring) {
+    RingOprStat(opr_stat);
+  }
+}
+
+#if MXNET_USE_CUDA
+cudaEvent_t Profiler::NewEvent(uint32_t dev_id) {
+  std::lock_guard<std::mutex> lock{gpu_m_};
+  if (free_events_.size() <= dev_id) {
+    free_events_.resize(dev_id + 1);
+    ref_events_.resize(dev_id + 1, nullptr);
+    ref_times_.resize(dev_id + 1, 0);
+  }
+  if (ref_events_[dev_id] == nullptr) {
+    // the reference is recorded on a stream of its own, so that it completes
+    // at once and its host time is the one after the synchronization
+    cudaStream_t stream;
+    CUDA_CALL(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
+    CUDA_CALL(cudaEventCreate(&ref_events_[dev_id]));
+    CUDA_CALL(cudaEventRecord(ref_events_[dev_id], stream));
+    CUDA_CALL(cudaEventSynchronize(ref_events_[dev_id]));
+    ref_times_[dev_id] = NowInUsec() - init_time_;
+    CUDA_CALL(cudaStreamDestroy(stream));
+  }
+  cudaEvent_t event;
+  if (free_events_[dev_id].empty()) {
+    CUDA_CALL(cudaEventCreate(&event));
+  } else {
+    event = free_events_[dev_id].back();
+    free_events_[dev_id].pop_back();
+  }
+  return event;
+}
+
+uint64_t Profiler::EventTime(uint32_t dev_id, cudaEvent_t event) {
+  float ms = 0;
+  CUDA_CALL(cudaEventElapsedTime(&ms, ref_events_[dev_id], event));
+  return ref_times_[dev_id] + static_cast<uint64_t>(std::max(ms, 0.0f) * 1000);
+}
+
+void Profiler::StartGPUOprStat(OprExecStat* opr_stat, cudaStream_t stream) {
+  opr_stat->stream = stream;
+  opr_stat->start_event = NewEvent(opr_stat->dev_id);
+  CUDA_CALL(cudaEventRecord(opr_stat->start_event, stream));
+}
+
+void Profiler::EndGPUOprStat(OprExecStat* opr_stat) {
+  // the asynchronous operations may complete on a thread of another device
+  int cur_dev = -1;
+  CUDA_CALL(cudaGetDevice(&cur_dev));
+  if (cur_dev != static_cast<int>(opr_stat->dev_id)) CUDA_CALL(cudaSetDevice(opr_stat->dev_id));
+  opr_stat->end_event = NewEvent(opr_stat->dev_id);
+  CUDA_CALL(cudaEventRecord(opr_stat->end_event, opr_stat->stream));
+  if (cur_dev != static_cast<int>(opr_stat->dev_id)) CUDA_CALL(cudaSetDevice(cur_dev));
+  {
+    std::lock_guard<std::mutex> lock{gpu_m_};
+    pending_gpu_stats_.push_back(opr_stat);
+  }
+  ResolveGPUOprStats(false);
+}
+#endif  // MXNET_USE_CUDA
+
+void Profiler::ResolveGPUOprStats(bool wait) {
+#if MXNET_USE_CUDA
+  std::vector<OprExecStat*> done;
+  {
+    std::lock_guard<std::mutex> lock{gpu_m_};
+    while (!pending_gpu_stats_.empty()) {
+      OprExecStat* opr_stat = pending_gpu_stats_.front();
+      if (wait) {
+        CUDA_CALL(cudaEventSynchronize(opr_stat->end_event));
+      } else if (cudaEventQuery(opr_stat->end_event) != cudaSuccess) {
+        break;
+      }
+      const uint32_t dev_id = opr_stat->dev_id;
+      opr_stat->opr_start_rel_micros = EventTime(dev_id, opr_stat->start_event);
+      opr_stat->opr_end_rel_micros = EventTime(dev_id, opr_stat->end_event);
+      free_events_[dev_id].push_back(opr_stat->start_event);
+      free_events_[dev_id].push_back(opr_stat->end_event);
+      opr_stat->start_event = nullptr;
+      opr_stat->end_event = nullptr;
+      pending_gpu_stats_.pop_front();
+      done.push_back(opr_stat);
+    }
+  }
+  for (OprExecStat* opr_stat : done) FinishOprStat(opr_stat);
+#endif  // MXNET_USE_CUDA
+}
+
+void Profiler::SetRingBuffer(size_t capacity) {
+  std::lock_guard<std::mutex> lock{this->m_};
+  this->ring_capacity_ = capacity;
+}
+
+EventRing* Profiler::ThreadRing() {
+  static thread_local EventRing* ring = nullptr;
+  if (ring == nullptr) {
+    ring = new EventRing(ring_capacity_);
+    // the records of the free list are allocated before the first operations
+    const size_t kInitFreeStats = 64;
+    for (size_t i = 0; i < kInitFreeStats; ++i) ring->free_stats.push_back(new OprExecStat);
+    std::lock_guard<std::mutex> lock{rings_m_};
+    rings_.push_back(ring);
+  }
+  return ring;
+}
+
+void Profiler::RingOprStat(OprExecStat* opr_stat) {
+  EventRing* ring = ThreadRing();
+  const size_t capacity = ring->events.size();
+  if (capacity != 0) {
+    const uint64_t head = ring->head.load(std::memory_order_relaxed);
+    RingEvent& e = ring->events[head % capacity];
+    strncpy(e.opr_name, opr_stat->opr_name.c_str(), sizeof(e.opr_name) - 1);
+    e.opr_name[sizeof(e.opr_name) - 1] = '\0';
+    e.push_rel_micros = opr_stat->push_rel_micros;
+    e.ready_rel_micros = opr_stat->ready_rel_micros;
+    e.dequeue_rel_micros = opr_stat->dequeue_rel_micros;
+    e.opr_start_rel_micros = opr_stat->opr_start_rel_micros;
+    e.opr_end_rel_micros = opr_stat->opr_end_rel_micros;
+    e.thread_id = opr_stat->thread_id;
+    e.dev_type = opr_stat->dev_type;
+    e.dev_id = opr_stat->dev_id;
+    ring->head.store(head + 1, std::memory_order_release);
+  }
+  // the records started by a thread and ended by another move to the free
+  // list of the latter, which is bounded
+  if (ring->free_stats.size() < std::max<size_t>(capacity, 64)) {
+    ring->free_stats.push_back(opr_stat);
+  } else {
+    delete opr_stat;
+  }
+}
+
+void Profiler::EmitRingEvents(std::ostream *os, uint64_t since, bool* first) {
+  std::vector<EventRing*> rings;
+  {
+    std::lock_guard<std::mutex> lock{rings_m_};
+    rings = rings_;
+  }
+  std::vector<RingEvent> events;
+  for (EventRing* ring : rings) {
+    const uint64_t capacity = ring->events.size();
+    if (capacity == 0) continue;
+    const uint64_t end = ring->head.load(std::memory_order_acquire);
+    const uint64_t begin = end > capacity ? end - capacity : 0;
+    events.resize(end - begin);
+    for (uint64_t i = begin; i < end; ++i) {
+      events[i - begin] = ring->events[i % capacity];
+    }
+    // the writer may have overwritten the events up to the current head
+    const uint64_t head = ring->head.load(std::memory_order_acquire);
+    const uint64_t valid = head + 1 > capacity ? head + 1 - capacity : 0;
+    for (uint64_t i = std::max(begin, valid); i < end; ++i) {
+      const RingEvent& e = events[i - begin];
+      if (e.opr_end_rel_micros < since) continue;
+      const uint32_t pid = DevIndex(e.dev_type, e.dev_id);
+      if (*first) {
+        *first = false;
+      } else {
+        (*os) << ",";
+      }
+      (*os) << std::endl;
+      this->EmitEvent(os, e.opr_name, "category", "B", e.opr_start_rel_micros, pid, e.thread_id,
+                      SchedArgs(e.push_rel_micros, e.ready_rel_micros, e.dequeue_rel_micros,
+                                e.opr_start_rel_micros));
+      (*os) << ",\n";
+      this->EmitEvent(os, e.opr_name, "category", "E", e.opr_end_rel_micros, pid, e.thread_id);
+    }
+  }
+}
+
+void Profiler::DumpRing(const std::string& filename, double seconds) {
+  ResolveGPUOprStats(true);
+  const uint64_t now = NowInUsec() - init_time_;
+  const uint64_t window = static_cast<uint64_t>(seconds * 1000000);
+  const uint64_t since = seconds > 0 && window < now ? now - window : 0;
+  std::ofstream file;
+  file.open(filename);
+  file << "{" << std::endl;
+  file << "    \"traceEvents\": [" << std::endl;
+  const uint32_t dev_num = cpu_num_ + gpu_num_ + 1;
+  for (uint32_t i = 0; i < dev_num; ++i) {
+    this->EmitPid(&file, profile_stat[i].dev_name, i);
+    if (i + 1 < dev_num) file << ",\n";
+  }
+  bool first_flag = false;
+  this->EmitRingEvents(&file, since, &first_flag);
+  file << "\n" << std::endl;
+  file << "    ]," << std::endl;
+  file << "    \"displayTimeUnit\": \"ms\"" << std::endl;
+  file << "}" << std::endl;
+}
+
+#ifndef _WIN32
+namespace {
+volatile sig_atomic_t ring_signal_raised = 0;
+void RingSignalHandler(int sig) {
+  ring_signal_raised = 1;
+}
+}  // namespace
+
+void Profiler::WatchRingSignal(int sig) {
+  // the handler only raises a flag, files cannot be written in a handler
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = RingSignalHandler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  CHECK_EQ(sigaction(sig, &action, nullptr), 0) << "Cannot handle signal " << sig;
+  const double seconds = dmlc::GetEnv("MXNET_PROFILER_RING_SECONDS", 0.0);
+  std::thread([this, seconds]() {
+      while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (!ring_signal_raised) continue;
+        ring_signal_raised = 0;
+        std::string filename;
+        {
+          std::lock_guard<std::mutex> lock{this->m_};
+          filename = this->filename_;
+        }
+        this->DumpRing(filename, seconds);
+        LOG(INFO) << "Saved the profiler rings to " << filename;
+      }
+    }).detach();
+}
+#else
+void Profiler::WatchRingSignal(int sig) {
+  LOG(WARNING) << "MXNET_PROFILER_RING_SIGNAL is not supported on Windows";
+}
+#endif  // _WIN32
+
+void Profiler::AggregateTempSpace(std::ostream* os, const std::string& dev_name,
+                                  std::vector<std::pair<std::string, TempSpaceStat> >* temps) {
+  std::sort(temps->begin(), temps->end(), [](const std::pair<std::string, TempSpaceStat>& a,
+                                             const std::pair<std::string, TempSpaceStat>& b) {
+      return a.second.peak_bytes > b.second.peak_bytes;
+    });
+  size_t width = 4;
+  for (const auto& t : *temps) width = std::max(width, t.first.size());
+  (*os) << "Temp space of device " << dev_name << "\n"
+        << std::left << std::setw(width) << "Name" << std::right
+        << std::setw(12) << "Requests" << std::setw(12) << "Allocs"
+        << std::setw(16) << "Peak(KB)" << "\n";
+  for (const auto& t : *temps) {
+    (*os) << std::left << std::setw(width) << t.first << std::right
+          << std::setw(12) << t.second.requests << std::setw(12) << t.second.allocs
+          << std::setw(16) << t.second.peak_bytes / 1024.0 << "\n";
+  }
+  (*os) << "\n";
+}
+
+std::string Profiler::AggregateStats(bool reset) {
+  ResolveGPUOprStats(true);
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(4);
+  const uint32_t dev_num = cpu_num_ + gpu_num_ + 1;
+  for (uint32_t i = 0; i < dev_num; ++i) {
+    DevStat &d = profile_stat[i];
+    std::vector<std::pair<std::string, OprAggregateStat> > stats;
+    std::vector<std::pair<std::string, TempSpaceStat> > temps;
+    {
+      std::lock_guard<std::mutex> lock(d.m_);
+      stats.assign(d.opr_aggregate_stats.begin(), d.opr_aggregate_stats.end());
+      temps.assign(d.temp_space_stats.begin(), d.temp_space_stats.end());
+      if (reset) {
+        d.opr_aggregate_stats.clear();
+        d.temp_space_stats.clear();
+      }
+    }
+    if (stats.empty()) {
+      if (!temps.empty()) AggregateTempSpace(&os, d.dev_name, &temps);
+      continue;
+    }
+    std::sort(stats.begin(), stats.end(), [](const std::pair<std::string, OprAggregateStat>& a,
+                                             const std::pair<std::string, OprAggregateStat>& b) {
+        return a.second.total_micros > b.second.total_micros;
+      });
+    size_t width = 4;
+    for (const auto& s : stats) width = std::max(width, s.first.size());
+    os << "Device " << d.dev_name << "\n"
+       << std::left << std::setw(width) << "Name" << std::right
+       << std::setw(12) << "Count" << std::setw(16) << "Total(ms)"
+       << std::setw(12) << "Min(ms)" << std::setw(12) << "Max(ms)"
+       << std::setw(12) << "Avg(ms)" << std::setw(14) << "DepsWait(ms)"
+       << std::setw(14) << "QueueWait(ms)" << "\n";
+    for (const auto& s : stats) {
+      const OprAggregateStat& agg = s.second;
+      os << std::left << std::setw(width) << s.first << std::right
+         << std::setw(12) << agg.count
+         << std::setw(16) << agg.total_micros / 1000.0
+         << std::setw(12) << agg.min_micros / 1000.0
+         << std::setw(12) << agg.max_micros / 1000.0
+         << std::setw(12) << agg.total_micros / 1000.0 / agg.count;
+      // the average waits of the operations pushed to the threaded engines
+      if (agg.sched_count != 0) {
+        os << std::setw(14) << agg.deps_wait_micros / 1000.0 / agg.sched_count
+           << std::setw(14) << agg.queue_wait_micros / 1000.0 / agg.sched_count;
+      } else {
+        os << std::setw(14) << "-" << std::setw(14) << "-";
+      }
+      os << "\n";
+    }
+    os << "\n";
+    if (!temps.empty()) AggregateTempSpace(&os, d.dev_name, &temps);
+  }
+  return os.str();
+}
+
 void Profiler::EmitPid(std::ostream *os, const std::string& name, uint32_t pid) {
   (*os) << "        {\n"
         << "            \"ph\": \"M\",\n"
@@ -137,25 +540,148 @@ void Profiler::EmitPid(std::ostream *os, const std::string& name, uint32_t pid)
 
 void Profiler::EmitEvent(std::ostream *os, const std::string& name,
                        const std::string& category, const std::string& ph,
-                       uint64_t ts, uint32_t pid, uint32_t tid) {
+                       uint64_t ts, uint32_t pid, uint32_t tid, const std::string& args) {
   (*os) << "        {\n"
         << "            \"name\": \""  << name << "\",\n"
         << "            \"cat\": " << "\"" << category << "\",\n"
         << "            \"ph\": \""<< ph << "\",\n"
         << "            \"ts\": "  << ts << ",\n"
         << "            \"pid\": " << pid << ",\n"
-        << "            \"tid\": " << tid << "\n"
+        << "            \"tid\": " << tid;
+  if (!args.empty()) {
+    (*os) << ",\n"
+          << "            \"args\": {\n"
+          << args << "\n"
+          << "            }";
+  }
+  (*os) << "\n"
+        << "        }";
+}
+
+std::string Profiler::SchedArgs(uint64_t push, uint64_t ready, uint64_t dequeue,
+                                uint64_t start) {
+  if (push == 0) return "";
+  // the start of a gpu operation is the one of its kernels, which may be
+  // before the host clock of its dequeue
+  auto wait = [](uint64_t from, uint64_t to) { return to > from ? to - from : 0; };
+  std::ostringstream os;
+  os << "                \"deps_wait_us\": " << wait(push, ready) << ",\n"
+     << "                \"queue_wait_us\": " << wait(ready, dequeue) << ",\n"
+     << "                \"launch_us\": " << wait(dequeue, start);
+  return os.str();
+}
+
+void Profiler::AddQueueSample(int dev_type, uint32_t dev_id, const char* queue,
+                              size_t depth) {
+  QueueSample q;
+  q.ts = NowInUsec() - init_time_;
+  q.queue = queue;
+  q.depth = depth;
+  DevStat& dev_stat = profile_stat[DevIndex(dev_type, dev_id)];
+  std::lock_guard<std::mutex> lock{dev_stat.m_};
+  dev_stat.queue_samples.push_back(q);
+}
+
+void Profiler::EmitQueueSample(std::ostream *os, const QueueSample& q, uint32_t pid) {
+  (*os) << "        {\n"
+        << "            \"name\": \"queue_depth\",\n"
+        << "            \"cat\": \"engine\",\n"
+        << "            \"ph\": \"C\",\n"
+        << "            \"ts\": " << q.ts << ",\n"
+        << "            \"pid\": " << pid << ",\n"
+        << "            \"args\": {\n"
+        << "                \"" << q.queue << "\": " << q.depth << "\n"
+        << "            }\n"
+        << "        }";
+}
+
+Context Profiler::DevContext(uint32_t i) const {
+  if (i < cpu_num_) return Context::CPU(i);
+  if (i < cpu_num_ + gpu_num_) return Context::GPU(i - cpu_num_);
+  return Context::CPUPinned(0);
+}
+
+void Profiler::EmitStorageStats(std::ostream *os, const Context& ctx,
+                                uint64_t ts, uint32_t pid) {
+  Storage::Stats stats = Storage::Get()->GetStats(ctx);
+  (*os) << "        {\n"
+        << "            \"name\": \"memory\",\n"
+        << "            \"cat\": \"storage\",\n"
+        << "            \"ph\": \"C\",\n"
+        << "            \"ts\": " << ts << ",\n"
+        << "            \"pid\": " << pid << ",\n"
+        << "            \"args\": {\n"
+        << "                \"bytes_in_use\": " << stats.bytes_in_use << ",\n"
+        << "                \"peak_bytes_in_use\": " << stats.peak_bytes_in_use << ",\n"
+        << "                \"bytes_reserved\": " << stats.bytes_reserved << ",\n"
+        << "                \"peak_bytes_reserved\": " << stats.peak_bytes_reserved << ",\n"
+        << "                \"bytes_pooled\": " << stats.bytes_pooled << ",\n"
+        << "                \"largest_pooled_block\": " << stats.largest_pooled_block << ",\n"
+        << "                \"num_allocs\": " << stats.num_allocs << ",\n"
+        << "                \"num_pool_hits\": " << stats.num_pool_hits << "\n"
+        << "            }\n"
         << "        }";
 }
 
+void Profiler::EmitMemoryEvent(std::ostream *os, const MemoryEvent& e, uint32_t pid) {
+  (*os) << "        {\n"
+        << "            \"name\": \"memory_in_use\",\n"
+        << "            \"cat\": \"memory\",\n"
+        << "            \"ph\": \"C\",\n"
+        << "            \"ts\": " << e.ts << ",\n"
+        << "            \"pid\": " << pid << ",\n"
+        << "            \"args\": {\n"
+        << "                \"bytes_in_use\": " << e.bytes_in_use << "\n"
+        << "            }\n"
+        << "        },\n"
+        << "        {\n"
+        << "            \"name\": \"" << (e.alloc ? "Alloc" : "Free") << "\",\n"
+        << "            \"cat\": \"memory\",\n"
+        << "            \"ph\": \"i\",\n"
+        << "            \"s\": \"t\",\n"
+        << "            \"ts\": " << e.ts << ",\n"
+        << "            \"pid\": " << pid << ",\n"
+        << "            \"tid\": " << e.thread_id << ",\n"
+        << "            \"args\": {\n"
+        << "                \"bytes\": " << e.bytes << ",\n"
+        << "                \"scope\": \"" << e.scope << "\"\n"
+        << "            }\n"
+        << "        }";
+}
+
+void Profiler::EmitIterStats(std::ostream *os, const std::string& name,
+                             const std::vector<std::pair<std::string, uint64_t> >& stats,
+                             uint64_t ts, uint32_t pid) {
+  (*os) << "        {\n"
+        << "            \"name\": \"" << name << "\",\n"
+        << "            \"cat\": \"io\",\n"
+        << "            \"ph\": \"C\",\n"
+        << "            \"ts\": " << ts << ",\n"
+        << "            \"pid\": " << pid << ",\n"
+        << "            \"args\": {";
+  for (size_t i = 0; i < stats.size(); ++i) {
+    (*os) << (i == 0 ? "\n" : ",\n")
+          << "                \"" << stats[i].first << "\": " << stats[i].second;
+  }
+  (*os) << "\n            }\n"
+        << "        }";
+}
 
 void Profiler::DumpProfile() {
   SetState(kNotRunning);
+  ResolveGPUOprStats(true);
 
   std::lock_guard<std::mutex> lock{this->m_};
   std::ofstream file;
   file.open(filename_);
 
+  // the aggregate statistics are saved as the text table
+  if (aggregate_) {
+    file << AggregateStats(false);
+    enable_output_ = false;
+    return;
+  }
+
   file << "{" << std::endl;
   file << "    \"traceEvents\": [" << std::endl;
 
@@ -186,12 +712,69 @@ void Profiler::DumpProfile() {
       }
       file << std::endl;
       this->EmitEvent(&file, opr_stat->opr_name, "category", "B",
-            opr_stat->opr_start_rel_micros, pid, tid);
+            opr_stat->opr_start_rel_micros, pid, tid,
+            SchedArgs(opr_stat->push_rel_micros, opr_stat->ready_rel_micros,
+                      opr_stat->dequeue_rel_micros, opr_stat->opr_start_rel_micros));
       file << ",\n";
       this->EmitEvent(&file, opr_stat->opr_name, "category", "E",
             opr_stat->opr_end_rel_micros, pid, tid);
     }
   }
+  this->EmitRingEvents(&file, 0, &first_flag);
+
+  // the allocations and releases, with the bytes in use of each device as a counter
+  for (uint32_t i = 0; i < dev_num; ++i) {
+    DevStat &d = profile_stat[i];
+    std::lock_guard<std::mutex> lock(d.m_);
+    for (const MemoryEvent& e : d.memory_events) {
+      if (first_flag) {
+        first_flag = false;
+      } else {
+        file << ",";
+      }
+      file << std::endl;
+      this->EmitMemoryEvent(&file, e, i);
+    }
+  }
+
+  // the depths of the worker queues, one counter series per queue
+  for (uint32_t i = 0; i < dev_num; ++i) {
+    DevStat &d = profile_stat[i];
+    std::lock_guard<std::mutex> lock(d.m_);
+    for (const QueueSample& q : d.queue_samples) {
+      if (first_flag) {
+        first_flag = false;
+      } else {
+        file << ",";
+      }
+      file << std::endl;
+      this->EmitQueueSample(&file, q, i);
+    }
+  }
+
+  // a snapshot of the allocation statistics of every device in use
+  uint64_t now = NowInUsec() - init_time_;
+  for (uint32_t i = 0; i < dev_num; ++i) {
+    if (Storage::Get()->GetStats(DevContext(i)).num_allocs == 0) continue;
+    if (first_flag) {
+      first_flag = false;
+    } else {
+      file << ",";
+    }
+    file << std::endl;
+    this->EmitStorageStats(&file, DevContext(i), now, i);
+  }
+
+  // the counters of the live data iterators, on the process of the first cpu
+  for (const auto& it : io::IterRegistry::Get()->Stats()) {
+    if (first_flag) {
+      first_flag = false;
+    } else {
+      file << ",";
+    }
+    file << std::endl;
+    this->EmitIterStats(&file, it.first, it.second, now, 0);
+  }
 
   file << "\n" << std::endl;
   file << "    ]," << std::endl;
@@ -214,12 +797,45 @@ inline uint64_t NowInUsec() {
 #endif
 }
 
+uint64_t RelNowInUsec() {
+  return NowInUsec() - Profiler::Get()->GetInitTime();
+}
+
+ProfileScope::ProfileScope(const char* name) {
+#if MXNET_USE_PROFILER
+  Profiler* profiler = Profiler::Get();
+  if (profiler->GetState() != Profiler::kRunning) return;
+  opr_stat_ = profiler->AddOprStat(Context::kCPU, 0);
+  opr_stat_->thread_id = std::hash<std::thread::id>()(std::this_thread::get_id());
+  opr_stat_->opr_name = name;
+  SetOprStart(opr_stat_);
+#endif
+}
+
+ProfileScope::~ProfileScope() {
+  if (opr_stat_ != nullptr) SetOprEnd(opr_stat_);
+}
+
 void SetOprStart(OprExecStat* opr_stat) {
   if (!opr_stat) {
     LOG(WARNING) << "SetOpStart: nullptr";
     return;
   }
   opr_stat->opr_start_rel_micros = NowInUsec() - Profiler::Get()->GetInitTime();
+#if MXNET_USE_NVTX
+  opr_stat->nvtx_range = nvtxRangeStartA(opr_stat->opr_name.c_str());
+#endif
+}
+
+void SetOprStart(OprExecStat* opr_stat, const RunContext& rctx) {
+  SetOprStart(opr_stat);
+#if MXNET_USE_CUDA
+  // the host time of a gpu operation is the one of its launches
+  if (opr_stat && rctx.ctx.dev_mask() == gpu::kDevMask && rctx.stream != nullptr) {
+    Profiler::Get()->StartGPUOprStat(
+        opr_stat, mshadow::Stream<gpu>::GetStream(rctx.get_stream<gpu>()));
+  }
+#endif
 }
 
 void SetOprEnd(OprExecStat* opr_stat) {
@@ -228,6 +844,16 @@ void SetOprEnd(OprExecStat* opr_stat) {
     return;
   }
   opr_stat->opr_end_rel_micros   = NowInUsec() - Profiler::Get()->GetInitTime();
+#if MXNET_USE_NVTX
+  nvtxRangeEnd(opr_stat->nvtx_range);
+#endif
+#if MXNET_USE_CUDA
+  if (opr_stat->start_event != nullptr) {
+    Profiler::Get()->EndGPUOprStat(opr_stat);
+    return;
+  }
+#endif
+  Profiler::Get()->FinishOprStat(opr_stat);
 }
 
 }  // namespace engine
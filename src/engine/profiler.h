@@ -24,10 +24,25 @@
 #ifndef MXNET_ENGINE_PROFILER_H_
 #define MXNET_ENGINE_PROFILER_H_
 
+#include <atomic>
 #include <vector>
 #include <string>
 #include <mutex>
+#include <limits>
+#include <unordered_map>
 #include <memory>
+#include <ostream>
+#include <utility>
+#include <deque>
+#include "mxnet/base.h"
+
+#ifndef MXNET_USE_NVTX
+#define MXNET_USE_NVTX 0
+#endif
+
+#if MXNET_USE_NVTX
+#include <nvToolsExt.h>
+#endif
 
 namespace mxnet {
 namespace engine {
@@ -37,7 +52,7 @@ namespace engine {
  */
 struct OprExecStat {
   /*! \brief operation name */
-  char opr_name[32];
+  std::string opr_name;
   /*!
    * \brief operation execution start relative timestamp
    *        time unit is microsecond (10^-6 s)
@@ -57,6 +72,119 @@ struct OprExecStat {
   uint32_t dev_type;
   /*! \brief device id */
   uint32_t dev_id;
+  /*!
+   * \brief when the operation was pushed, when its dependencies were ready
+   *        and when a worker took it, relative timestamps in microsecond,
+   *        0 if the engine does not record them
+   */
+  uint64_t push_rel_micros = 0;
+  uint64_t ready_rel_micros = 0;
+  uint64_t dequeue_rel_micros = 0;
+  /*! \brief whether the record is folded into the aggregate statistics at its end */
+  bool aggregate;
+  /*! \brief whether the record is written to the ring of its thread at its end */
+  bool ring;
+#if MXNET_USE_CUDA
+  /*!
+   * \brief events recorded on the stream of a gpu operation around its
+   *        launches, the timestamps are those of the events once they are
+   *        resolved
+   */
+  cudaEvent_t start_event = nullptr;
+  cudaEvent_t end_event = nullptr;
+  /*! \brief the stream of the gpu operation */
+  cudaStream_t stream = nullptr;
+#endif
+#if MXNET_USE_NVTX
+  /*! \brief the range of the operation in the nvtx timeline */
+  nvtxRangeId_t nvtx_range;
+#endif
+};
+
+/*!
+ * \brief A finished operation in an event ring, a fixed size copy of the
+ *        OprExecStat that can be overwritten while it is read
+ */
+struct RingEvent {
+  char opr_name[64];
+  uint64_t push_rel_micros;
+  uint64_t ready_rel_micros;
+  uint64_t dequeue_rel_micros;
+  uint64_t opr_start_rel_micros;
+  uint64_t opr_end_rel_micros;
+  uint32_t thread_id;
+  uint32_t dev_type;
+  uint32_t dev_id;
+};
+
+/*!
+ * \brief The last events finished by a thread. Only the thread writes to it,
+ *        the readers copy the events and drop the ones the writer reached
+ *        meanwhile
+ */
+struct EventRing {
+  explicit EventRing(size_t capacity) : events(capacity), head(0) {}
+  /*! \brief the events, the i-th one of the thread is at i % size */
+  std::vector<RingEvent> events;
+  /*! \brief the number of events written */
+  std::atomic<uint64_t> head;
+  /*! \brief the records freed by the thread, for its next operations */
+  std::vector<OprExecStat*> free_stats;
+};
+
+/*!
+ * \brief Execution time statistics of the operations of a name
+ *        time unit is microsecond (10^-6 s)
+ */
+struct OprAggregateStat {
+  uint64_t count = 0;
+  uint64_t total_micros = 0;
+  uint64_t min_micros = std::numeric_limits<uint64_t>::max();
+  uint64_t max_micros = 0;
+  /*! \brief the operations with scheduling timestamps, and their total waits */
+  uint64_t sched_count = 0;
+  uint64_t deps_wait_micros = 0;
+  uint64_t queue_wait_micros = 0;
+};
+
+/*!
+ * \brief An allocation or a release of device memory
+ */
+struct MemoryEvent {
+  /*! \brief timestamp relative to the profiler init, in microseconds */
+  uint64_t ts;
+  /*! \brief the size of the allocation */
+  uint64_t bytes;
+  /*! \brief the bytes in use on the device after the event */
+  uint64_t bytes_in_use;
+  /*! \brief id of the thread of the event */
+  uint32_t thread_id;
+  /*! \brief whether the memory is allocated rather than released */
+  bool alloc;
+  /*! \brief the operation or the executor that caused the event, see MemoryScope */
+  std::string scope;
+};
+
+/*!
+ * \brief The requests of temp space of the operations of a name
+ */
+struct TempSpaceStat {
+  uint64_t requests = 0;
+  /*! \brief the requests that allocated rather than reused the held space */
+  uint64_t allocs = 0;
+  /*! \brief the largest request */
+  uint64_t peak_bytes = 0;
+};
+
+/*!
+ * \brief The number of operations waiting in a worker queue
+ */
+struct QueueSample {
+  /*! \brief timestamp relative to the profiler init, in microseconds */
+  uint64_t ts;
+  /*! \brief the name of the queue, a literal */
+  const char* queue;
+  size_t depth;
 };
 
 /*!
@@ -67,6 +195,14 @@ struct DevStat {
   std::string dev_name;
   /*! \brief operation execution statistics on this device */
   std::vector<OprExecStat*> opr_exec_stats;
+  /*! \brief the allocations and releases of memory on this device */
+  std::vector<MemoryEvent> memory_events;
+  /*! \brief the depths of the worker queues of this device */
+  std::vector<QueueSample> queue_samples;
+  /*! \brief aggregate statistics of the operations on this device, by name */
+  std::unordered_map<std::string, OprAggregateStat> opr_aggregate_stats;
+  /*! \brief the temp space requests on this device, by the MemoryScope of the requests */
+  std::unordered_map<std::string, TempSpaceStat> temp_space_stats;
   /*! \brief internal mutex of the execution state */
   std::mutex m_;
 };
@@ -102,8 +238,88 @@ class Profiler {
   inline bool IsEnableOutput() const {
     return this->enable_output_;
   }
+  /*!
+   * \brief set whether the operations are only counted in the aggregate
+   *        statistics, rather than kept as events of the profile file
+   */
+  void SetAggregate(bool aggregate);
+  /*! \return whether the operations are only counted in the aggregate statistics */
+  inline bool IsAggregate() const {
+    return this->aggregate_;
+  }
+  /*! \brief set whether the allocations and releases of memory are recorded */
+  void SetMemory(bool memory);
+  /*! \return whether the allocations and releases of memory are recorded now */
+  inline bool IsRecordingMemory() const {
+    return this->memory_ && this->state_ == kRunning;
+  }
+  /*!
+   * \brief record an allocation or a release of memory, attributed to the
+   *        current MemoryScope of the thread
+   * \param bytes_in_use the bytes in use on the device after the event
+   */
+  void AddMemoryEvent(const Context& ctx, size_t bytes, bool alloc, size_t bytes_in_use);
+  /*!
+   * \brief record a request of bytes of temp space, attributed to the current
+   *        MemoryScope of the thread
+   * \param alloc whether the request allocated rather than reused the held space
+   */
+  void AddTempSpace(const Context& ctx, size_t bytes, bool alloc);
+  /*!
+   * \brief record the depth of a worker queue after a profiled operation
+   *        was pushed to it
+   * \param queue the name of the queue, a literal
+   */
+  void AddQueueSample(int dev_type, uint32_t dev_id, const char* queue, size_t depth);
   /*! \brief dump the profile file */
   void DumpProfile();
+  /*!
+   * \brief print the aggregate statistics as a table, by device and by
+   *        operation name with the largest total time first
+   * \param reset clear the statistics after printing them
+   */
+  std::string AggregateStats(bool reset);
+  /*! \brief count a finished operation in the aggregate statistics and free it */
+  void AggregateOprStat(OprExecStat* opr_stat);
+  /*!
+   * \brief keep the last events finished by each thread in a preallocated ring
+   *        instead of all of them; the rings stay small enough for a
+   *        profiler that is always on, and are saved by DumpRing
+   * \param capacity the number of events per thread, 0 to keep all events.
+   *        The rings that exist keep their size.
+   */
+  void SetRingBuffer(size_t capacity);
+  /*! \return the number of events kept per thread, 0 if all events are kept */
+  inline size_t GetRingBuffer() const {
+    return this->ring_capacity_;
+  }
+  /*!
+   * \brief save the events of the rings as a chrome trace, without stopping
+   *        the profiler
+   * \param filename the file to write
+   * \param seconds only save the events that ended in the last seconds, all
+   *        events if seconds <= 0
+   */
+  void DumpRing(const std::string& filename, double seconds);
+  /*! \brief write a finished operation to the ring of the thread and recycle it */
+  void RingOprStat(OprExecStat* opr_stat);
+  /*! \brief pass an ended operation on to the aggregate statistics or the rings */
+  void FinishOprStat(OprExecStat* opr_stat);
+#if MXNET_USE_CUDA
+  /*! \brief record the start event of a gpu operation on its stream */
+  void StartGPUOprStat(OprExecStat* opr_stat, cudaStream_t stream);
+  /*!
+   * \brief record the end event of a gpu operation, whose timestamps are
+   *        set once the events completed
+   */
+  void EndGPUOprStat(OprExecStat* opr_stat);
+#endif
+  /*!
+   * \brief set the timestamps of the gpu operations whose events completed,
+   *        and pass them on to the aggregate statistics or the rings
+   * \param wait wait for the events of all the operations ended
+   */
+  void ResolveGPUOprStats(bool wait);
   /*! \return the profiler init time, time unit is microsecond (10^-6) s */
   inline uint64_t GetInitTime() const {
     return init_time_;
@@ -121,10 +337,61 @@ class Profiler {
  private:
   /*! \brief generate device information following chrome profile file format */
   void EmitPid(std::ostream *os, const std::string& name, uint32_t pid);
-  /*! \brief generate event information following chrome profile file format */
+  /*!
+   * \brief generate event information following chrome profile file format
+   * \param args the members of the args object of the event, if not empty
+   */
   void EmitEvent(std::ostream *os, const std::string& name,
           const std::string& category, const std::string& ph,
-          uint64_t ts, uint32_t pid, uint32_t tid);
+          uint64_t ts, uint32_t pid, uint32_t tid, const std::string& args = "");
+  /*!
+   * \return the waits of an operation before its start as members of the
+   *         args of its event, empty when the engine did not record them
+   */
+  static std::string SchedArgs(uint64_t push, uint64_t ready, uint64_t dequeue,
+                               uint64_t start);
+  /*! \brief generate memory statistics of a device as a counter event */
+  void EmitStorageStats(std::ostream *os, const Context& ctx,
+          uint64_t ts, uint32_t pid);
+  /*! \brief print the temp space requests of a device, the largest first */
+  void AggregateTempSpace(std::ostream* os, const std::string& dev_name,
+                          std::vector<std::pair<std::string, TempSpaceStat> >* temps);
+  /*! \brief generate a memory event as a counter of the bytes in use and an instant event */
+  void EmitMemoryEvent(std::ostream *os, const MemoryEvent& e, uint32_t pid);
+  /*! \brief generate the depth of a worker queue as a counter event */
+  void EmitQueueSample(std::ostream *os, const QueueSample& q, uint32_t pid);
+  /*! \brief generate the throughput counters of a data iterator as a counter event */
+  void EmitIterStats(std::ostream *os, const std::string& name,
+          const std::vector<std::pair<std::string, uint64_t> >& stats,
+          uint64_t ts, uint32_t pid);
+  /*! \return the context of the device statistics with index i */
+  Context DevContext(uint32_t i) const;
+  /*! \return the index of the device statistics of a device */
+  uint32_t DevIndex(int dev_type, uint32_t dev_id) const;
+  /*! \return the event ring of the calling thread, created at its first call */
+  EventRing* ThreadRing();
+  /*!
+   * \brief generate the events of the rings that ended after since
+   * \param first whether no event was generated before, updated
+   */
+  void EmitRingEvents(std::ostream *os, uint64_t since, bool* first);
+  /*! \brief dump the rings when the signal of MXNET_PROFILER_RING_SIGNAL is raised */
+  void WatchRingSignal(int sig);
+#if MXNET_USE_CUDA
+  /*! \return an event with timing of the current device, from the pool of dev_id */
+  cudaEvent_t NewEvent(uint32_t dev_id);
+  /*! \brief the time of an event relative to the profiler init, in microseconds */
+  uint64_t EventTime(uint32_t dev_id, cudaEvent_t event);
+  /*! \brief the events of each device that can be recorded again */
+  std::vector<std::vector<cudaEvent_t> > free_events_;
+  /*! \brief an event of each device, recorded when the host clock was ref_times_ */
+  std::vector<cudaEvent_t> ref_events_;
+  std::vector<uint64_t> ref_times_;
+  /*! \brief the gpu operations ended whose events may not be complete, by end */
+  std::deque<OprExecStat*> pending_gpu_stats_;
+  /*! \brief protects the events and the pending operations */
+  std::mutex gpu_m_;
+#endif
   /*! \brief Profiler instance */
   static Profiler* instance_;
   /*! \brief internal mutex of the profiler */
@@ -135,6 +402,17 @@ class Profiler {
   bool enable_output_;
   /*! \brief indicate what operator the profiler will record */
   ProfilerMode mode_;
+  /*! \brief only count the operations in the aggregate statistics */
+  bool aggregate_;
+  /*! \brief record the allocations and releases of memory */
+  bool memory_;
+  /*! \brief the number of events kept per thread, 0 if all events are kept */
+  size_t ring_capacity_;
+  /*! \brief the event rings of the threads, never freed as the threads may outlive
+   *         the profiler */
+  std::vector<EventRing*> rings_;
+  /*! \brief protects rings_ */
+  std::mutex rings_m_;
   /*! \brief filename to output profile file */
   std::string filename_;
   /*! \brief profile statistics consist of multiple device statistics */
@@ -147,10 +425,69 @@ class Profiler {
   uint64_t init_time_;
 };
 
+/*!
+ * \brief names the cause of the allocations of the thread while it lives,
+ *        the operation that runs or the executor that binds; scopes nest
+ */
+class MemoryScope {
+ public:
+  /*! \param name the cause, which must outlive the scope; nullptr keeps the current one */
+  explicit MemoryScope(const char* name)
+      : prev_(current_), prev_serial_(serial_) {
+    if (name != nullptr) current_ = name;
+    serial_ = next_serial_.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+  ~MemoryScope() {
+    current_ = prev_;
+    serial_ = prev_serial_;
+  }
+  /*! \return the cause of the allocations of the thread, nullptr if unknown */
+  static const char* Current() {
+    return current_;
+  }
+  /*!
+   * \return the id of the innermost scope of the thread, unique across the
+   *         threads, 0 outside of the scopes. Every operation the engines run
+   *         is in a scope, whether profiled or not
+   */
+  static uint64_t Serial() {
+    return serial_;
+  }
+
+ private:
+  const char* prev_;
+  uint64_t prev_serial_;
+  static thread_local const char* current_;
+  static thread_local uint64_t serial_;
+  static std::atomic<uint64_t> next_serial_;
+};
+
+/*!
+ * \brief records the time the scope lives as an operation of the cpu, when
+ *        the profiler runs; for the host work outside of the engine, as the
+ *        phases of a bind
+ */
+class ProfileScope {
+ public:
+  /*! \param name the name of the operation */
+  explicit ProfileScope(const char* name);
+  ~ProfileScope();
+
+ private:
+  OprExecStat* opr_stat_{nullptr};
+};
+
 /*! \return current clock time, time unit is microsecond (10^-6 s) */
 inline uint64_t NowInUsec();
+/*! \return current clock time relative to the profiler init, in microsecond */
+uint64_t RelNowInUsec();
 /*! \brief set operation execution start timestamp */
 void SetOprStart(OprExecStat* opr_stat);
+/*!
+ * \brief set operation execution start timestamp, the one of the stream of
+ *        rctx for the gpu operations
+ */
+void SetOprStart(OprExecStat* opr_stat, const RunContext& rctx);
 /*! \brief set operation execution end timestamp */
 void SetOprEnd(OprExecStat* opr_stat);
 
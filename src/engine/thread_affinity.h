@@ -0,0 +1,168 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file thread_affinity.h
+ * \brief CPU affinity and OpenMP team size of the threads of a pool.
+ */
+#ifndef MXNET_ENGINE_THREAD_AFFINITY_H_
+#define MXNET_ENGINE_THREAD_AFFINITY_H_
+
+#include <dmlc/base.h>
+#include <dmlc/logging.h>
+#include <dmlc/omp.h>
+#include <dmlc/parameter.h>
+#if MSHADOW_USE_MKL == 1
+#include <mkl_service.h>
+#endif
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace mxnet {
+namespace engine {
+
+/*!
+ * \brief Placement of the threads of a pool.
+ *
+ *  When a set of cpus is given, it is split evenly between the threads of
+ *  the pool and each thread is bound to its share, so that OpenMP teams
+ *  started by a thread stay on its cores as well. The OpenMP team size of
+ *  each thread defaults to the size of its share, so that the teams of
+ *  several threads do not oversubscribe the cores. A pool given a total
+ *  budget of OpenMP threads splits it the same way when no cpus are given.
+ *  MKL and the NNPACK thread pool of a thread follow its team size, so that
+ *  the operators run by a thread share one budget.
+ */
+class ThreadAffinity {
+ public:
+  /*! \brief default placement, threads are neither bound nor sized */
+  ThreadAffinity() = default;
+  /*!
+   * \brief read the placement of a pool from the environment.
+   *  `<prefix>_CPUS` is a list of cpus such as "0-7,16-23", an entry like
+   *  "node1" stands for all the cpus of NUMA node 1. `<prefix>_OMP_THREADS`
+   *  is the OpenMP team size of each thread.
+   * \param prefix prefix of the environment variables.
+   * \param num_threads number of threads in the pool.
+   * \param total_omp_threads OpenMP threads shared by the pool when no cpus
+   *  are given, 0 to keep the OpenMP default of each thread.
+   */
+  static ThreadAffinity FromEnv(const std::string& prefix, size_t num_threads,
+                                int total_omp_threads = 0) {
+    ThreadAffinity ret;
+    ret.num_threads_ = std::max<size_t>(num_threads, 1);
+    ret.cpus_ = ParseCPUList(dmlc::GetEnv((prefix + "_CPUS").c_str(), std::string()));
+    int share = 0;
+    if (!ret.cpus_.empty()) {
+      share = static_cast<int>(std::max<size_t>(ret.cpus_.size() / ret.num_threads_, 1));
+    } else if (total_omp_threads > 0 && ret.num_threads_ > 1) {
+      share = std::max(total_omp_threads / static_cast<int>(ret.num_threads_), 1);
+    }
+    ret.omp_threads_ = dmlc::GetEnv((prefix + "_OMP_THREADS").c_str(), share);
+    return ret;
+  }
+  /*!
+   * \brief apply the placement to the calling thread.
+   * \param index index of the thread in the pool.
+   */
+  void Apply(size_t index) const {
+    if (!cpus_.empty()) {
+      std::vector<int> share;
+      if (cpus_.size() >= num_threads_) {
+        const size_t n = cpus_.size() / num_threads_;
+        const size_t begin = (index % num_threads_) * n;
+        share.assign(cpus_.begin() + begin, cpus_.begin() + begin + n);
+      } else {
+        share.push_back(cpus_[index % cpus_.size()]);
+      }
+      BindCurrentThread(share);
+    }
+    if (omp_threads_ > 0) {
+      omp_set_num_threads(omp_threads_);
+#if MSHADOW_USE_MKL == 1
+      // MKL keeps its own team size, which would otherwise be all the cores
+      mkl_set_num_threads_local(omp_threads_);
+#endif
+    }
+  }
+  /*! \brief whether the placement changes anything */
+  bool empty() const {
+    return cpus_.empty() && omp_threads_ <= 0;
+  }
+  /*!
+   * \brief parse a list of cpus.
+   * \param str comma separated cpus, ranges of cpus or NUMA nodes.
+   */
+  static std::vector<int> ParseCPUList(const std::string& str) {
+    std::vector<int> ret;
+    std::istringstream is(str);
+    std::string token;
+    while (std::getline(is, token, ',')) {
+      if (token.empty()) continue;
+      if (token.compare(0, 4, "node") == 0) {
+        std::ifstream fs("/sys/devices/system/node/" + token + "/cpulist");
+        CHECK(fs) << "Cannot find the cpus of NUMA " << token;
+        std::string list;
+        std::getline(fs, list);
+        std::vector<int> cpus = ParseCPUList(list);
+        ret.insert(ret.end(), cpus.begin(), cpus.end());
+        continue;
+      }
+      size_t dash = token.find('-');
+      int first = std::atoi(token.substr(0, dash).c_str());
+      int last = dash == std::string::npos ? first : std::atoi(token.substr(dash + 1).c_str());
+      CHECK_LE(first, last) << "Invalid cpu range " << token;
+      for (int cpu = first; cpu <= last; ++cpu) ret.push_back(cpu);
+    }
+    return ret;
+  }
+
+ private:
+  static void BindCurrentThread(const std::vector<int>& cpus) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+      LOG(WARNING) << "Failed to set the affinity of an engine thread, error " << err;
+    }
+#else
+    LOG(WARNING) << "Thread affinity is only supported on Linux";
+#endif
+  }
+  /*! \brief cpus shared by the pool */
+  std::vector<int> cpus_;
+  /*! \brief number of threads in the pool */
+  size_t num_threads_{1};
+  /*! \brief OpenMP team size of each thread, 0 to keep the default */
+  int omp_threads_{0};
+};
+
+}  // namespace engine
+}  // namespace mxnet
+#endif  // MXNET_ENGINE_THREAD_AFFINITY_H_
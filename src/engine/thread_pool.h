@@ -29,6 +29,7 @@
 #include <thread>
 #include <utility>
 #include "mxnet/base.h"
+#include "./thread_affinity.h"
 
 namespace mxnet {
 namespace engine {
@@ -78,21 +79,38 @@ class ThreadPool {
    * \brief Constructor takes function to run.
    * \param size size of the thread pool.
    * \param func the function to run on the thread pool.
+   * \param affinity placement of the threads.
    */
-  explicit ThreadPool(size_t size, std::function<void()> func)
+  explicit ThreadPool(size_t size, std::function<void()> func,
+                      const ThreadAffinity& affinity = ThreadAffinity())
       : worker_threads_(size) {
-    for (auto& i : worker_threads_) {
-      i = std::thread(func);
+    for (size_t i = 0; i < worker_threads_.size(); ++i) {
+      if (affinity.empty()) {
+        worker_threads_[i] = std::thread(func);
+      } else {
+        worker_threads_[i] = std::thread([func, affinity, i]() {
+            affinity.Apply(i);
+            func();
+          });
+      }
     }
   }
   explicit ThreadPool(size_t size,
                       std::function<void(std::shared_ptr<SimpleEvent> ready)> func,
-                      const bool wait)
+                      const bool wait,
+                      const ThreadAffinity& affinity = ThreadAffinity())
       : worker_threads_(size) {
-    for (auto& i : worker_threads_) {
+    for (size_t i = 0; i < worker_threads_.size(); ++i) {
       std::shared_ptr<SimpleEvent> ptr = std::make_shared<SimpleEvent>();
       ready_events_.emplace_back(ptr);
-      i = std::thread(func, ptr);
+      if (affinity.empty()) {
+        worker_threads_[i] = std::thread(func, ptr);
+      } else {
+        worker_threads_[i] = std::thread([func, affinity, i, ptr]() {
+            affinity.Apply(i);
+            func(ptr);
+          });
+      }
     }
     if (wait) {
       WaitForReady();
@@ -48,7 +48,7 @@ ThreadedVar::ThreadedVar(VersionedVarBlock* head) : head_{head} {
 }
 
 inline void ThreadedVar::AppendReadDependency(OprBlock* opr_block) {
-  std::lock_guard<std::mutex> lock{m_};
+  std::lock_guard<SpinLock> lock{m_};
   if (pending_write_ == nullptr) {
     // invariant: is_ready_to_read()
     CHECK_GE(num_pending_reads_, 0);
@@ -68,9 +68,42 @@ inline void ThreadedVar::AppendReadDependency(OprBlock* opr_block) {
   }
 }
 
+inline void ThreadedVar::AppendPartialWriteDependency(OprBlock* opr_block) {
+  StampWrite();
+  auto&& new_var_block = VersionedVarBlock::New();
+  std::lock_guard<SpinLock> lock{m_};
+  assert(head_->next == nullptr);
+  assert(head_->trigger == nullptr);
+  assert(head_->write == false);
+  head_->next = new_var_block;
+  head_->trigger = opr_block;
+  head_->write = true;
+  head_->partial = true;
+  if (pending_write_ == nullptr) {
+    pending_write_ = head_;
+    CHECK_GE(num_pending_reads_, 0);
+    if (num_pending_reads_ == 0) {
+      // STATE CHANGE
+      opr_block->decr_wait();
+      num_pending_reads_ = kWriteTriggered;
+      num_running_partials_ = 1;
+      partial_end_ = new_var_block;
+    }
+  } else if (num_running_partials_ != 0 && partial_end_ == head_) {
+    // nothing waits after the running partial writes, run with them
+    opr_block->decr_wait();
+    ++num_running_partials_;
+    partial_end_ = new_var_block;
+  } else {
+    CHECK_NE(num_pending_reads_, 0);
+  }
+  head_ = new_var_block;
+}
+
 inline void ThreadedVar::AppendWriteDependency(OprBlock* opr_block) {
+  StampWrite();
   auto&& new_var_block = VersionedVarBlock::New();
-  std::lock_guard<std::mutex> lock{m_};
+  std::lock_guard<SpinLock> lock{m_};
   // invariant.
   assert(head_->next == nullptr);
   assert(head_->trigger == nullptr);
@@ -99,22 +132,27 @@ inline void ThreadedVar::AppendWriteDependency(OprBlock* opr_block) {
 template <typename Dispatcher>
 inline void ThreadedVar::CompleteReadDependency(Dispatcher dispatcher) {
   OprBlock *trigger = nullptr;
+  std::vector<OprBlock*> partials;
   {
     // this is lock scope
-    std::lock_guard<std::mutex> lock{m_};
+    std::lock_guard<SpinLock> lock{m_};
     CHECK_GT(num_pending_reads_, 0);
 
     if (--num_pending_reads_ == 0) {
       if (pending_write_ != nullptr) {
         // STATE CHANGE
-        trigger = pending_write_->trigger;
-        num_pending_reads_ = kWriteTriggered;
+        trigger = TriggerPendingWrite(&partials);
       }
     }
   }
   if (trigger != nullptr && trigger->decr_wait() == 0) {
     dispatcher(trigger);
   }
+  for (OprBlock* partial : partials) {
+    if (partial->decr_wait() == 0) {
+      dispatcher(partial);
+    }
+  }
 }
 
 template <typename Dispatcher>
@@ -122,8 +160,9 @@ inline bool ThreadedVar::CompleteWriteDependency(Dispatcher dispatcher) {
   // this is lock scope
   VersionedVarBlock *old_pending_write, *end_of_read_chain;
   OprBlock* trigger_write = nullptr;
+  std::vector<OprBlock*> partials;
   {
-    std::lock_guard<std::mutex> lock{m_};
+    std::lock_guard<SpinLock> lock{m_};
     // invariants
     assert(head_->next == nullptr);
     assert(pending_write_ != nullptr);
@@ -156,8 +195,7 @@ inline bool ThreadedVar::CompleteWriteDependency(Dispatcher dispatcher) {
       pending_write_ = end_of_read_chain;
       if (num_pending_reads_ == 0) {
         // mark write as already activated in this var
-        num_pending_reads_ = kWriteTriggered;
-        trigger_write = end_of_read_chain->trigger;
+        trigger_write = TriggerPendingWrite(&partials);
       }
     }
   }
@@ -182,16 +220,90 @@ inline bool ThreadedVar::CompleteWriteDependency(Dispatcher dispatcher) {
   if (trigger_write != nullptr && trigger_write->decr_wait() == 0) {
     dispatcher(trigger_write);
   }
+  for (OprBlock* partial : partials) {
+    if (partial->decr_wait() == 0) {
+      dispatcher(partial);
+    }
+  }
   return false;
 }
 
+template <typename Dispatcher>
+inline void ThreadedVar::CompletePartialWriteDependency(Dispatcher dispatcher) {
+  VersionedVarBlock *old_pending_write, *end_of_partials, *end_of_read_chain;
+  OprBlock* trigger_write = nullptr;
+  std::vector<OprBlock*> partials;
+  {
+    std::lock_guard<SpinLock> lock{m_};
+    CHECK_EQ(num_pending_reads_, kWriteTriggered);
+    CHECK_GT(num_running_partials_, 0);
+    if (--num_running_partials_ != 0) return;
+    // detach the partial writes, as a single write
+    old_pending_write = pending_write_;
+    end_of_partials = partial_end_;
+    partial_end_ = nullptr;
+    end_of_read_chain = end_of_partials;
+    num_pending_reads_ = 0;
+    while (end_of_read_chain != head_ &&
+           end_of_read_chain->write == false) {
+      ++num_pending_reads_;
+      end_of_read_chain = end_of_read_chain->next;
+    }
+    if (end_of_read_chain == head_) {
+      pending_write_ = nullptr;
+    } else {
+      pending_write_ = end_of_read_chain;
+      if (num_pending_reads_ == 0) {
+        trigger_write = TriggerPendingWrite(&partials);
+      }
+    }
+  }
+  // outside of the lock, as in CompleteWriteDependency
+  VersionedVarBlock *cur_head = old_pending_write;
+  while (cur_head != end_of_partials) {
+    auto prev = cur_head;
+    cur_head = cur_head->next;
+    VersionedVarBlock::Delete(prev);
+  }
+  while (cur_head != end_of_read_chain) {
+    if (cur_head->trigger->decr_wait() == 0) {
+      dispatcher(cur_head->trigger);
+    }
+    auto prev = cur_head;
+    cur_head = cur_head->next;
+    assert(cur_head != nullptr);
+    VersionedVarBlock::Delete(prev);
+  }
+  if (trigger_write != nullptr && trigger_write->decr_wait() == 0) {
+    dispatcher(trigger_write);
+  }
+  for (OprBlock* partial : partials) {
+    if (partial->decr_wait() == 0) {
+      dispatcher(partial);
+    }
+  }
+}
+
+inline OprBlock* ThreadedVar::TriggerPendingWrite(std::vector<OprBlock*>* partials) {
+  num_pending_reads_ = kWriteTriggered;
+  if (!pending_write_->partial) return pending_write_->trigger;
+  VersionedVarBlock* blk = pending_write_;
+  while (blk != head_ && blk->partial) {
+    partials->push_back(blk->trigger);
+    blk = blk->next;
+  }
+  num_running_partials_ = static_cast<int>(partials->size());
+  partial_end_ = blk;
+  return nullptr;
+}
+
 inline void ThreadedVar::SetToDelete() {
-  std::lock_guard<std::mutex> lock{m_};
+  std::lock_guard<SpinLock> lock{m_};
   to_delete_ = true;
 }
 
 inline bool ThreadedVar::ready_to_read() {
-  std::lock_guard<std::mutex> lock{m_};
+  std::lock_guard<SpinLock> lock{m_};
   return this->is_ready_to_read();
 }
 
@@ -200,6 +312,14 @@ ThreadedVar* ThreadedEngine::NewVariable() {
   return ThreadedVar::New(VersionedVarBlock::New());
 }
 
+ThreadedVar* ThreadedEngine::NewViewVariable(VarHandle parent) {
+  ThreadedVar* var = NewVariable();
+  ThreadedVar* threaded_parent = ThreadedVar::CastFromBase(parent);
+  CHECK(threaded_parent->parent() == nullptr) << "a view of a view is a view of its parent";
+  var->set_parent(threaded_parent);
+  return var;
+}
+
 ThreadedOpr* ThreadedEngine::NewOperator(
     ThreadedEngine::AsyncFn fn,
     std::vector<VarHandle> const& const_vars,
@@ -219,9 +339,44 @@ ThreadedOpr* ThreadedEngine::NewOperator(
   if (ENGINE_DEBUG != 0) {
     CheckDuplicate(const_vars, mutable_vars);
   }
+  auto is_view = [](ThreadedVar* v) { return v->parent() != nullptr; };
+  if (std::any_of(ret->const_vars.begin(), ret->const_vars.end(), is_view) ||
+      std::any_of(ret->mutable_vars.begin(), ret->mutable_vars.end(), is_view)) {
+    ResolveViews(ret);
+  }
   return ret;
 }
 
+void ThreadedEngine::ResolveViews(ThreadedOpr* opr) {
+  auto contains = [](const std::vector<ThreadedVar*>& vars, ThreadedVar* v) {
+    return std::find(vars.begin(), vars.end(), v) != vars.end();
+  };
+  for (auto&& v : opr->const_vars) {
+    if (v->parent() != nullptr) v = v->parent();
+  }
+  std::vector<ThreadedVar*> parents;
+  for (auto* v : opr->mutable_vars) {
+    if (v->parent() != nullptr && !contains(parents, v->parent())) {
+      parents.push_back(v->parent());
+    }
+  }
+  for (auto* p : parents) {
+    if (contains(opr->mutable_vars, p)) continue;
+    if (contains(opr->const_vars, p)) {
+      // read whole and written in part, it is written whole
+      opr->mutable_vars.push_back(p);
+    } else {
+      opr->partial_vars.push_back(p);
+    }
+  }
+  // a variable is read once, and not when it is written
+  std::vector<ThreadedVar*> reads;
+  for (auto* v : opr->const_vars) {
+    if (!contains(reads, v) && !contains(opr->mutable_vars, v)) reads.push_back(v);
+  }
+  opr->const_vars.swap(reads);
+}
+
 void ThreadedEngine::CheckDuplicate(std::vector<VarHandle> const& const_vars,
                                     std::vector<VarHandle> const& mutable_vars) {
   // Check for duplicates.
@@ -273,17 +428,78 @@ void ThreadedEngine::DeleteOperator(OprHandle op) {
     PROFILER_MESSAGE("DeleteOperator"));
 }
 
+namespace {
+/*! \brief the completion of an operation run inline */
+struct InlineCompletion {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool completed{false};
+};
+
+void OnCompleteInline(Engine *engine, void *param) {
+  InlineCompletion* done = static_cast<InlineCompletion*>(param);
+  {
+    std::lock_guard<std::mutex> lock{done->mutex};
+    done->completed = true;
+  }
+  done->cv.notify_all();
+}
+}  // namespace
+
+bool ThreadedEngine::set_inline(bool enable) {
+  InlineStatus* status = InlineStatus::Get();
+  const bool prev = status->enabled;
+  // the operations run inline track no dependency on the ones pushed before
+  if (enable && !prev) WaitForAll();
+  status->enabled = enable;
+  return prev;
+}
+
+void ThreadedEngine::ExecuteInline(const AsyncFn& fn, Context exec_ctx) {
+  InlineCompletion done;
+  {
+    // the scope still marks the invocation, for the elastic temp space
+    MemoryScope memory_scope(nullptr);
+    fn(RunContext{exec_ctx, nullptr}, this->CreateCallback(OnCompleteInline, &done));
+  }
+  // an asynchronous function may complete on another thread
+  std::unique_lock<std::mutex> lock{done.mutex};
+  done.cv.wait(lock, [&done]() { return done.completed; });
+}
+
 void ThreadedEngine::Push(OprHandle op, Context exec_ctx, int priority, bool profiling) {
   ThreadedOpr* threaded_opr = ThreadedOpr::CastFromBase(op);
+  // in the inline mode, the other operations are waited for, by the vars
+  // they write, as the operation is gone once it completes
+  std::vector<VarHandle> inline_waits;
+  if (InlineStatus::Get()->enabled) {
+    if (RunsInline(exec_ctx, threaded_opr->prop)) {
+      StampWrites(threaded_opr->mutable_vars);
+      StampWrites(threaded_opr->partial_vars);
+      ExecuteInline(threaded_opr->fn, exec_ctx);
+      return;
+    }
+    if (threaded_opr->prop != FnProperty::kAsync) {
+      inline_waits.assign(threaded_opr->mutable_vars.begin(), threaded_opr->mutable_vars.end());
+      inline_waits.insert(inline_waits.end(), threaded_opr->partial_vars.begin(),
+                          threaded_opr->partial_vars.end());
+    }
+  }
+  // the operations collected before are pushed first
+  BulkFlush();
   OprBlock* opr_block = OprBlock::New();
   opr_block->opr = threaded_opr;
 
   opr_block->wait.store(static_cast<int>(
       threaded_opr->const_vars.size() +
-      threaded_opr->mutable_vars.size() + 1));
+      threaded_opr->mutable_vars.size() +
+      threaded_opr->partial_vars.size() + 1));
   opr_block->ctx = exec_ctx;
   opr_block->priority = priority;
   opr_block->profiling = profiling;
+#if MXNET_USE_PROFILER
+  if (profiling) opr_block->push_micros = RelNowInUsec();
+#endif
   ++pending_;
   // Add read dependencies.
   for (auto&& i : threaded_opr->const_vars) {
@@ -293,9 +509,13 @@ void ThreadedEngine::Push(OprHandle op, Context exec_ctx, int priority, bool pro
   for (auto&& i : threaded_opr->mutable_vars) {
     i->AppendWriteDependency(opr_block);
   }
+  for (auto&& i : threaded_opr->partial_vars) {
+    i->AppendPartialWriteDependency(opr_block);
+  }
   if (opr_block->decr_wait() == 0) {
-    this->PushToExecute(opr_block, true);
+    this->PushReady(opr_block, true);
   }
+  for (VarHandle var : inline_waits) WaitForVar(var);
 }
 
 void ThreadedEngine::PushAsync(AsyncFn fn, Context exec_ctx,
@@ -304,6 +524,11 @@ void ThreadedEngine::PushAsync(AsyncFn fn, Context exec_ctx,
                                FnProperty prop,
                                int priority,
                                const char* opr_name) {
+  if (RunsInline(exec_ctx, prop)) {
+    StampWrites(mutable_vars);
+    ExecuteInline(fn, exec_ctx);
+    return;
+  }
   ThreadedOpr *opr = NewOperator(std::move(fn), const_vars, mutable_vars, prop, opr_name);
   opr->temporary = true;
 #if MXNET_USE_PROFILER
@@ -316,6 +541,88 @@ void ThreadedEngine::PushAsync(AsyncFn fn, Context exec_ctx,
   Push(opr, exec_ctx, priority, profiling);
 }
 
+void ThreadedEngine::PushAsyncBatch(std::vector<AsyncOpr>* oprs) {
+  if (oprs->empty()) return;
+  if (InlineStatus::Get()->enabled) {
+    Engine::PushAsyncBatch(oprs);
+    return;
+  }
+  BulkFlush();
+#if MXNET_USE_PROFILER
+  Profiler *profiler = Profiler::Get();
+  bool profiling = (profiler->GetState() == Profiler::kRunning) &&
+                   (profiler->GetMode() == Profiler::kAllOperator);
+#else
+  bool profiling = false;
+#endif
+  pending_ += static_cast<int>(oprs->size());
+  // Register the dependencies of the whole batch first, then execute the
+  // blocks that are ready, so that an async operation run on this thread
+  // does not delay the registration of the rest.
+  std::vector<OprBlock*> ready;
+  ready.reserve(oprs->size());
+  for (auto& opr : *oprs) {
+    ThreadedOpr* threaded_opr = NewOperator(std::move(opr.fn), opr.const_vars,
+                                            opr.mutable_vars, opr.prop, opr.opr_name);
+    threaded_opr->temporary = true;
+    OprBlock* opr_block = OprBlock::New();
+    opr_block->opr = threaded_opr;
+    opr_block->wait.store(static_cast<int>(
+        threaded_opr->const_vars.size() +
+        threaded_opr->mutable_vars.size() +
+        threaded_opr->partial_vars.size() + 1));
+    opr_block->ctx = opr.exec_ctx;
+    opr_block->priority = opr.priority;
+    opr_block->profiling = profiling;
+#if MXNET_USE_PROFILER
+    if (profiling) opr_block->push_micros = RelNowInUsec();
+#endif
+    for (auto&& i : threaded_opr->const_vars) {
+      i->AppendReadDependency(opr_block);
+    }
+    for (auto&& i : threaded_opr->mutable_vars) {
+      i->AppendWriteDependency(opr_block);
+    }
+    for (auto&& i : threaded_opr->partial_vars) {
+      i->AppendPartialWriteDependency(opr_block);
+    }
+    if (opr_block->decr_wait() == 0) {
+      ready.push_back(opr_block);
+    }
+  }
+  for (OprBlock* opr_block : ready) {
+    this->PushReady(opr_block, true);
+  }
+}
+
+void ThreadedEngine::PushSync(SyncFn exec_fn, Context exec_ctx,
+                              std::vector<VarHandle> const& const_vars,
+                              std::vector<VarHandle> const& mutable_vars,
+                              FnProperty prop,
+                              int priority,
+                              const char* opr_name) {
+  if (RunsInline(exec_ctx, prop)) {
+    StampWrites(mutable_vars);
+    MemoryScope memory_scope(nullptr);
+    exec_fn(RunContext{exec_ctx, nullptr});
+    return;
+  }
+  BulkStatus* bulk = BulkStatus::Get();
+  if (bulk->size == 0 || prop != FnProperty::kNormal || priority != 0) {
+    Engine::PushSync(std::move(exec_fn), exec_ctx, const_vars, mutable_vars,
+                     prop, priority, opr_name);
+    return;
+  }
+  if (bulk->count != 0 && bulk->ctx != exec_ctx) BulkFlush();
+  bulk->ctx = exec_ctx;
+  // the writes are appended when the bulk is pushed, but are stamped already
+  StampWrites(mutable_vars);
+  bulk->fns.push_back(std::move(exec_fn));
+  bulk->const_vars.insert(bulk->const_vars.end(), const_vars.begin(), const_vars.end());
+  bulk->mutable_vars.insert(bulk->mutable_vars.end(), mutable_vars.begin(), mutable_vars.end());
+  if (++bulk->count >= bulk->size) BulkFlush();
+}
+
 void ThreadedEngine::DeleteVariable(SyncFn delete_fn,
                                     Context exec_ctx,
                                     VarHandle var) {
@@ -330,14 +637,21 @@ void ThreadedEngine::DeleteVariable(SyncFn delete_fn,
 }
 
 void ThreadedEngine::WaitForVar(VarHandle var) {
+  BulkFlush();
   ThreadedVar* threaded_var = ThreadedVar::CastFromBase(var);
+  // a view is read through its parent
+  if (threaded_var->parent() != nullptr) threaded_var = threaded_var->parent();
   if (threaded_var->ready_to_read()) return;
   if (engine_info_) {
     LOG(INFO) << "Wait for " << threaded_var;
     debug_wait_var_ = threaded_var;
   }
   std::atomic<bool> done{false};
-  this->PushSync([this, &done](RunContext) {
+  // pushed directly, not collected into a bulk nor run inline
+  InlineStatus* inline_status = InlineStatus::Get();
+  const bool inline_enabled = inline_status->enabled;
+  inline_status->enabled = false;
+  this->PushAsync([this, &done](RunContext, CallbackOnComplete on_complete) {
       if (engine_info_) {
         LOG(INFO) << "Sync is executed";
       }
@@ -349,8 +663,11 @@ void ThreadedEngine::WaitForVar(VarHandle var) {
       if (engine_info_) {
         LOG(INFO) << "Sync is notified";
       }
+      on_complete();
     }, Context::CPU(), {var}, {}, FnProperty::kNormal, 0,
     PROFILER_MESSAGE("WaitForVar"));
+  inline_status->enabled = inline_enabled;
+  if (SpinWait([this, &done]() { return done.load() || kill_.load(); })) return;
   {
     std::unique_lock<std::mutex> lock{finished_m_};
     finished_cv_.wait(lock, [this, &done]() {
@@ -359,7 +676,19 @@ void ThreadedEngine::WaitForVar(VarHandle var) {
   }
 }
 
+uint64_t ThreadedEngine::WriteStamp(VarHandle var) {
+  ThreadedVar* threaded_var = ThreadedVar::CastFromBase(var);
+  uint64_t stamp = threaded_var->write_stamp();
+  // the data of a view also changes with the writes of its parent
+  if (threaded_var->parent() != nullptr) {
+    stamp = std::max(stamp, threaded_var->parent()->write_stamp());
+  }
+  return stamp;
+}
+
 void ThreadedEngine::WaitForAll() {
+  BulkFlush();
+  if (SpinWait([this]() { return pending_.load() == 0 || kill_.load(); })) return;
   std::unique_lock<std::mutex> lock{finished_m_};
   finished_cv_.wait(lock, [this]() {
       return pending_.load() == 0 || kill_.load();
@@ -371,7 +700,7 @@ inline void ThreadedEngine::OnComplete(ThreadedOpr* threaded_opr) {
   // Mark complete for read variables
   for (auto&& i : threaded_opr->const_vars) {
     i->CompleteReadDependency([this](OprBlock* opr) {
-        this->PushToExecute(opr, false);
+        this->PushReady(opr, false);
       });
   }
   // Mark complete for write variables.
@@ -386,7 +715,7 @@ inline void ThreadedEngine::OnComplete(ThreadedOpr* threaded_opr) {
             LOG(INFO) << "PushToExecute " << opr;
             debug_push_opr_ = opr;
           }
-          this->PushToExecute(opr, false);
+          this->PushReady(opr, false);
           if (debug_info) {
             LOG(INFO) << "Fin PushToExecute " << opr;
           }
@@ -395,6 +724,12 @@ inline void ThreadedEngine::OnComplete(ThreadedOpr* threaded_opr) {
       ThreadedVar::Delete(i);
     }
   }
+  // Mark complete for the variables written in part.
+  for (auto&& i : threaded_opr->partial_vars) {
+    i->CompletePartialWriteDependency([this](OprBlock* opr) {
+        this->PushReady(opr, false);
+      });
+  }
   // The function been pushed from `ThreadedEngine::DeleteOperator`
   // could execute right after we mark all vars as complete, so if
   // threaded_opr is not temporary, its value is not reliable
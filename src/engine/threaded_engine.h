@@ -29,6 +29,7 @@
 #include <dmlc/base.h>
 #include <dmlc/logging.h>
 #include <vector>
+#include <chrono>
 #include <functional>
 #include <condition_variable>
 #include <atomic>
@@ -55,6 +56,37 @@ namespace engine {
 // Forward declarations
 struct ThreadedOpr;
 
+/*!
+ * \brief Test-and-test-and-set spin lock.
+ *  The critical sections of ThreadedVar are only a few pointer updates,
+ *  so spinning is much cheaper than parking the thread on a mutex.
+ *  Meets the BasicLockable requirement and works with std::lock_guard.
+ */
+class SpinLock {
+ public:
+  inline void lock() {
+    while (locked_.exchange(true, std::memory_order_acquire)) {
+      int spin = 0;
+      while (locked_.load(std::memory_order_relaxed)) {
+        // give the lock holder a chance to run when it has been preempted
+        if (++spin > kSpinBeforeYield) {
+          std::this_thread::yield();
+          spin = 0;
+        }
+      }
+    }
+  }
+  inline void unlock() {
+    locked_.store(false, std::memory_order_release);
+  }
+
+ private:
+  /*! \brief number of spins before yielding the thread */
+  static constexpr int kSpinBeforeYield = 64;
+  /*! \brief whether the lock is held */
+  std::atomic<bool> locked_{false};
+};  // class SpinLock
+
 /*!
  * \brief Operation block in the scheduler.
  *  Each OprBlock corresponds to an operation pushed to the engine.
@@ -74,6 +106,12 @@ struct OprBlock : public common::ObjectPoolAllocatable<OprBlock> {
   bool profiling{false};
   /*! \brief operator execution statistics */
   OprExecStat *opr_stat;
+  /*!
+   * \brief when the block was pushed and when its dependencies were ready,
+   *        relative to the profiler init, only recorded when profiling
+   */
+  uint64_t push_micros{0};
+  uint64_t ready_micros{0};
   // define possible debug information
   DEFINE_ENGINE_DEBUG_INFO(OprBlock);
   /*!
@@ -100,6 +138,11 @@ struct VersionedVarBlock
   OprBlock* trigger{nullptr};
   /*! \brief whether this operation is a write(mutate) operation. */
   bool write{false};
+  /*!
+   * \brief whether the write only mutates a part of the variable,
+   *  the consecutive partial writes run together.
+   */
+  bool partial{false};
   /*! \brief define possible debug information */
   DEFINE_ENGINE_DEBUG_INFO(VersionedVarBlock);
 };  // struct VersionedVarBlock
@@ -133,6 +176,13 @@ class ThreadedVar final : public Var,
    * \param opr_block The operation to be scheduled.
    */
   inline void AppendWriteDependency(OprBlock* opr_block);
+  /*!
+   * \brief Schedule a write of a part of this variable. It runs with the
+   *  partial writes it directly follows in the queue, which mutate other
+   *  parts, and is ordered like a write with everything else.
+   * \param opr_block The operation to be scheduled.
+   */
+  inline void AppendPartialWriteDependency(OprBlock* opr_block);
   /*!
    * \brief A read operation is completed on this variable.
    *  This function may trigger subsequent waiting operations on this variable.
@@ -154,10 +204,37 @@ class ThreadedVar final : public Var,
    */
   template <typename Dispatcher>
   inline bool CompleteWriteDependency(Dispatcher dispatcher);
+  /*!
+   * \brief A partial write operation is completed on this variable.
+   *  The last one of the running partial writes triggers the subsequent
+   *  waiting operations.
+   *
+   * \param dispatcher the function called to trigger the operation,
+   *            when all of its dependencies are satiesfied.
+   * \tparam Dispatcher the function called to trigger an operation.
+   */
+  template <typename Dispatcher>
+  inline void CompletePartialWriteDependency(Dispatcher dispatcher);
   /*! \brief Mark this variable to be deleted. */
   inline void SetToDelete();
   /*! \return whether this variable is ready to read. */
   inline bool ready_to_read();
+  /*! \return the variable this one is a part of, nullptr if it is not a view. */
+  inline ThreadedVar* parent() const {
+    return parent_;
+  }
+  /*! \brief make this variable a part of parent, before it is used */
+  inline void set_parent(ThreadedVar* parent) {
+    parent_ = parent;
+  }
+  /*! \return the stamp of the last write pushed on this variable, see Engine::WriteStamp */
+  inline uint64_t write_stamp() const {
+    return write_stamp_.load(std::memory_order_relaxed);
+  }
+  /*! \brief give this variable a new stamp, when a write of it is pushed */
+  inline void StampWrite() {
+    write_stamp_.store(NextWriteStamp(), std::memory_order_relaxed);
+  }
   /*!
    * \brief Cast a Var pointer to ThreadedVar pointer
    * \param ptr pointer from base.
@@ -173,10 +250,9 @@ class ThreadedVar final : public Var,
 #endif  // ENGINE_DEBUG
 
  private:
-  // TODO(hotpxl) change this to spinlock for faster runtime
   // TODO(hotpxl) consider rename head
-  /*! \brief inetrnal mutex of the ThreadedVar */
-  std::mutex m_;
+  /*! \brief inetrnal lock of the ThreadedVar */
+  SpinLock m_;
   /*!
    * \brief number of pending reads operation in the variable.
    *  will be marked as -1 when there is a already triggered pending write.
@@ -201,8 +277,27 @@ class ThreadedVar final : public Var,
    * \brief If true, delete after operation completes.
    */
   bool to_delete_{false};
+  /*! \brief the variable this one is a part of, the operations are scheduled on it */
+  ThreadedVar* parent_{nullptr};
+  /*! \brief number of the triggered partial writes not completed yet */
+  int num_running_partials_{0};
+  /*!
+   * \brief the block after the triggered partial writes,
+   *  which start at pending_write_.
+   */
+  VersionedVarBlock* partial_end_{nullptr};
+  /*!
+   * \brief the stamp of the last write pushed, unique over all the variables
+   *  as the pooled variables are reused
+   */
+  std::atomic<uint64_t> write_stamp_{NextWriteStamp()};
   /*! \brief special const on num_pending_reads_ to mark write being triggered */
   static constexpr int kWriteTriggered = -1;
+  /*! \return a stamp greater than all the stamps given before */
+  static uint64_t NextWriteStamp() {
+    static std::atomic<uint64_t> stamp{0};
+    return ++stamp;
+  }
   /*!
    * \brief derived invariant of ready to ready, without lock.
    * \return whether the current variable is ready to read.
@@ -210,6 +305,14 @@ class ThreadedVar final : public Var,
   inline bool is_ready_to_read() const {
     return pending_write_ == nullptr;
   }
+  /*!
+   * \brief trigger the write at pending_write_ once the reads before it are
+   *  done, under the lock. A partial write is triggered with the partial
+   *  writes that follow it.
+   * \param partials the triggered partial writes.
+   * \return the triggered write, nullptr for partial writes.
+   */
+  inline OprBlock* TriggerPendingWrite(std::vector<OprBlock*>* partials);
 };  // struct ThreadedVar
 
 /*!
@@ -223,6 +326,11 @@ struct ThreadedOpr final : public Opr,
   std::vector<ThreadedVar*> const_vars;
   /*! \brief The variable this operation will mutate. */
   std::vector<ThreadedVar*> mutable_vars;
+  /*!
+   * \brief The variables this operation will mutate a part of,
+   *  the parents of the views in mutable_vars.
+   */
+  std::vector<ThreadedVar*> partial_vars;
   /*! \brief The property of the operator */
   FnProperty prop;
   /*! \brief The name of the operator */
@@ -257,6 +365,7 @@ class ThreadedEngine : public Engine {
  public:
   // implementing all the functions from Engine.
   ThreadedVar* NewVariable() override;
+  ThreadedVar* NewViewVariable(VarHandle parent) override;
   ThreadedOpr* NewOperator(AsyncFn fn,
                            std::vector<VarHandle> const& const_vars,
                            std::vector<VarHandle> const& mutable_vars,
@@ -270,8 +379,27 @@ class ThreadedEngine : public Engine {
                  FnProperty prop = FnProperty::kNormal,
                  int priority = 0,
                  const char* opr_name = nullptr) override;
+  void PushAsyncBatch(std::vector<AsyncOpr>* oprs) override;
+  void PushSync(SyncFn exec_fn, Context exec_ctx,
+                std::vector<VarHandle> const& const_vars,
+                std::vector<VarHandle> const& mutable_vars,
+                FnProperty prop = FnProperty::kNormal,
+                int priority = 0,
+                const char* opr_name = nullptr) override;
+  int set_bulk_size(int size) override {
+    BulkStatus* bulk = BulkStatus::Get();
+    const int prev = bulk->size;
+    bulk->size = size;
+    if (bulk->count >= size) BulkFlush();
+    return prev;
+  }
+  bool set_inline(bool enable) override;
+  bool is_inline() const override {
+    return InlineStatus::Get()->enabled;
+  }
   void DeleteVariable(SyncFn delete_fn, Context exec_ctx, VarHandle var) override;
   void WaitForVar(VarHandle var) override;
+  uint64_t WriteStamp(VarHandle var) override;
   void WaitForAll() override;
   void NotifyShutdown() override {
     shutdown_phase_.store(true);
@@ -279,6 +407,7 @@ class ThreadedEngine : public Engine {
 
   ThreadedEngine() {
     engine_info_ = dmlc::GetEnv("MXNET_ENGINE_INFO", false);
+    wait_spin_us_ = dmlc::GetEnv("MXNET_ENGINE_WAIT_SPIN_US", 0);
 
     objpool_opr_ref_    = common::ObjectPool<ThreadedOpr>::_GetSharedRef();
     objpool_blk_ref_    = common::ObjectPool<OprBlock>::_GetSharedRef();
@@ -303,6 +432,16 @@ class ThreadedEngine : public Engine {
    * \param pusher_thread whether the caller is the thread that calls push
    */
   virtual void PushToExecute(OprBlock* opr_block, bool pusher_thread) = 0;
+  /*!
+   * \brief Push an opr block whose dependencies are ready to execution,
+   *  recording the time when profiling.
+   */
+  inline void PushReady(OprBlock* opr_block, bool pusher_thread) {
+#if MXNET_USE_PROFILER
+    if (opr_block->profiling) opr_block->ready_micros = RelNowInUsec();
+#endif
+    this->PushToExecute(opr_block, pusher_thread);
+  }
   /*!
    * \brief Call this function to actually execute an opr_block
    *  This function also deletes the opr_block after execution.
@@ -313,15 +452,17 @@ class ThreadedEngine : public Engine {
     ThreadedOpr* threaded_opr = opr_block->opr;
 #if MXNET_USE_PROFILER
     if (opr_block->profiling && threaded_opr->opr_name) {
+      const uint64_t dequeue_micros = RelNowInUsec();
       const Context& ctx = opr_block->ctx;
       opr_block->opr_stat = Profiler::Get()->AddOprStat(ctx.dev_type, ctx.dev_id);
       uint64_t id = std::hash<std::thread::id>()(std::this_thread::get_id());
       opr_block->opr_stat->thread_id = id;
-      strncpy(opr_block->opr_stat->opr_name,
-        threaded_opr->opr_name,
-        sizeof(opr_block->opr_stat->opr_name) - 1);
+      opr_block->opr_stat->opr_name = threaded_opr->opr_name;
+      opr_block->opr_stat->push_rel_micros = opr_block->push_micros;
+      opr_block->opr_stat->ready_rel_micros = opr_block->ready_micros;
+      opr_block->opr_stat->dequeue_rel_micros = dequeue_micros;
       // record operator start timestamp
-      SetOprStart(opr_block->opr_stat);
+      SetOprStart(opr_block->opr_stat, run_ctx);
     }
 #endif
     CallbackOnComplete callback = this->CreateCallback(
@@ -336,6 +477,13 @@ class ThreadedEngine : public Engine {
         if (debug_info) {
           LOG(INFO) << "ExecuteOprFn ";
         }
+#if MXNET_USE_PROFILER
+        // the allocations of the operation are attributed to it
+        MemoryScope memory_scope(opr_block->profiling ? threaded_opr->opr_name : nullptr);
+#else
+        // the scope still marks the invocation, for the elastic temp space
+        MemoryScope memory_scope(nullptr);
+#endif
         threaded_opr->fn(run_ctx, callback);
         if (debug_info) {
           LOG(INFO) << "Fin ExecuteOprFn ";
@@ -368,6 +516,83 @@ class ThreadedEngine : public Engine {
    */
   void CheckDuplicate(std::vector<VarHandle> const& const_vars,
                       std::vector<VarHandle> const& mutable_vars);
+  /*!
+   * \brief schedule the views of an operator on their parents: the reads of
+   *  views become reads of the parents, and the writes of views add partial
+   *  writes of the parents, or full writes when the parents are used whole.
+   * \param opr the operator whose variables include views.
+   */
+  static void ResolveViews(ThreadedOpr* opr);
+  /*!
+   * \brief stamp the variables written by an operation that is run inline or
+   *  collected into a bulk, whose writes are not appended to the variables yet.
+   *  The parents of the views are written as well.
+   * \param vars the variables the operation writes.
+   */
+  template<typename V>
+  static void StampWrites(const std::vector<V*>& vars) {
+    for (V* v : vars) {
+      ThreadedVar* var = ThreadedVar::CastFromBase(v);
+      var->StampWrite();
+      if (var->parent() != nullptr) var->parent()->StampWrite();
+    }
+  }
+  /*!
+   * \brief the operations of PushSync collected by a pushing thread,
+   *  pushed together as one engine operation
+   */
+  struct BulkStatus {
+    /*! \brief the number of operations pushed together, 0 for no bulk */
+    int size{0};
+    /*! \brief the number of operations collected */
+    int count{0};
+    Context ctx;
+    std::vector<SyncFn> fns;
+    std::vector<VarHandle> const_vars;
+    std::vector<VarHandle> mutable_vars;
+    /*! \return the bulk of the calling thread */
+    static BulkStatus* Get() {
+      static thread_local BulkStatus inst;
+      return &inst;
+    }
+  };
+  /*! \brief whether the calling thread runs its operations inline, see set_inline */
+  struct InlineStatus {
+    bool enabled{false};
+    /*! \return the status of the calling thread */
+    static InlineStatus* Get() {
+      static thread_local InlineStatus inst;
+      return &inst;
+    }
+  };
+  /*! \return whether the calling thread runs an operation itself, see set_inline */
+  static bool RunsInline(Context exec_ctx, FnProperty prop) {
+    return InlineStatus::Get()->enabled && exec_ctx.dev_mask() == cpu::kDevMask &&
+        (prop == FnProperty::kNormal || prop == FnProperty::kCPUPrioritized);
+  }
+  /*!
+   * \brief run an operation on the calling thread, returning once it completes
+   * \param fn the function of the operation.
+   * \param exec_ctx the context of the operation.
+   */
+  void ExecuteInline(const AsyncFn& fn, Context exec_ctx);
+  /*! \brief push the operations collected by the calling thread, if any */
+  inline void BulkFlush() {
+    BulkStatus* bulk = BulkStatus::Get();
+    if (bulk->count == 0) return;
+    auto fns = std::make_shared<std::vector<SyncFn> >();
+    fns->swap(bulk->fns);
+    std::vector<VarHandle> const_vars, mutable_vars;
+    const_vars.swap(bulk->const_vars);
+    mutable_vars.swap(bulk->mutable_vars);
+    bulk->count = 0;
+    this->DeduplicateVarHandle(&const_vars, &mutable_vars);
+    this->PushAsync([fns](RunContext ctx, CallbackOnComplete on_complete) {
+        for (const auto& fn : *fns) fn(ctx);
+        on_complete();
+      }, bulk->ctx, const_vars, mutable_vars, FnProperty::kNormal, 0,
+      PROFILER_MESSAGE("ImperativeBulk"));
+  }
   /*!
    * \brief Callback on operation completion.
    *
@@ -376,6 +601,25 @@ class ThreadedEngine : public Engine {
   inline void OnComplete(ThreadedOpr* threaded_opr);
   // callback to the threaded engine
   static void OnCompleteStatic(Engine *engine, void *threaded_opr);
+  /*!
+   * \brief Spin on a wait condition before blocking on finished_cv_,
+   *  which saves the wake-up latency of short waits.
+   * \param cond the wait condition.
+   * \return whether the condition holds within the spin time.
+   */
+  template<typename Cond>
+  inline bool SpinWait(Cond cond) const {
+    if (wait_spin_us_ <= 0) return false;
+    auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::microseconds(wait_spin_us_);
+    for (int i = 0;; ++i) {
+      if (cond()) return true;
+      // do not query the clock on every iteration
+      if ((i & 63) == 63 && std::chrono::steady_clock::now() >= deadline) {
+        return cond();
+      }
+    }
+  }
   /*!
    * \brief Number of pending operations.
    */
@@ -386,6 +630,8 @@ class ThreadedEngine : public Engine {
   std::atomic<bool> shutdown_phase_{false};
   /*!\brief show more information from engine actions */
   bool engine_info_{false};
+  /*! \brief microseconds a waiter spins before it blocks */
+  int wait_spin_us_{0};
   /*! \brief debug information about wait for var. */
   std::atomic<ThreadedVar*> debug_wait_var_{nullptr};
   /*! \brief debug information about wait for var. */
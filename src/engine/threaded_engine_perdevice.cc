@@ -28,6 +28,7 @@
 #include <dmlc/concurrency.h>
 #include "./threaded_engine.h"
 #include "./thread_pool.h"
+#include "./work_stealing_queue.h"
 #include "../common/lazy_alloc_array.h"
 #include "../common/utils.h"
 
@@ -52,26 +53,30 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
   ThreadedEnginePerDevice() noexcept(false) {
     gpu_worker_nthreads_ = common::GetNumThreadPerGPU();
     cpu_worker_nthreads_ = dmlc::GetEnv("MXNET_CPU_WORKER_NTHREADS", 1);
-    // create CPU task
-    int cpu_priority_nthreads = dmlc::GetEnv("MXNET_CPU_PRIORITY_NTHREADS", 4);
-    cpu_priority_worker_.reset(new ThreadWorkerBlock<kPriorityQueue>());
-    cpu_priority_worker_->pool.reset(new ThreadPool(
-        cpu_priority_nthreads, [this]() {
-          this->CPUWorker(Context(), cpu_priority_worker_.get());
-        }));
-    // GPU tasks will be created lazily
+    cpu_work_stealing_ = dmlc::GetEnv("MXNET_CPU_WORKER_WORK_STEALING", false);
+    gpu_worker_priority_ = dmlc::GetEnv("MXNET_GPU_WORKER_PRIORITY_QUEUE", false);
+    // the cpu workers of a device split the OpenMP threads of the process
+    cpu_worker_affinity_ = ThreadAffinity::FromEnv("MXNET_CPU_WORKER", cpu_worker_nthreads_,
+                                                   omp_get_max_threads());
+    cpu_priority_nthreads_ = dmlc::GetEnv("MXNET_CPU_PRIORITY_NTHREADS", 4);
+    // all the workers, the CPU priority ones included, are created at the first
+    // push to them, so that the processes that run few operations start fast
   }
   ~ThreadedEnginePerDevice() noexcept(false) {
     SignalQueuesForKill();
     gpu_normal_workers_.Clear();
+    gpu_priority_workers_.Clear();
     gpu_copy_workers_.Clear();
     cpu_normal_workers_.Clear();
-    cpu_priority_worker_.reset(nullptr);
+    cpu_stealing_workers_.Clear();
+    cpu_priority_worker_.Clear();
   }
 
  protected:
   void PushToExecute(OprBlock *opr_block, bool pusher_thread) override {
-    const Context& ctx = opr_block->ctx;
+    // a worker may run and free the block as soon as it is queued
+    const Context ctx = opr_block->ctx;
+    const bool profiling = opr_block->profiling;
     if (opr_block->opr->prop == FnProperty::kAsync && pusher_thread) {
       if (ctx.dev_mask() == gpu::kDevMask) {
         #if MXNET_USE_CUDA
@@ -82,20 +87,47 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     } else {
       if (ctx.dev_mask() == cpu::kDevMask) {
         if (opr_block->opr->prop == FnProperty::kCPUPrioritized) {
-          cpu_priority_worker_->task_queue.Push(opr_block, opr_block->priority);
+          int nthread = cpu_priority_nthreads_;
+          auto ptr = cpu_priority_worker_.Get(0, [this, nthread]() {
+              auto blk = new ThreadWorkerBlock<kPriorityQueue>();
+              blk->pool.reset(new ThreadPool(nthread, [this, blk]() {
+                    this->CPUWorker(Context(), blk);
+                  }, ThreadAffinity::FromEnv("MXNET_CPU_PRIORITY", nthread)));
+              return blk;
+            });
+          if (ptr) {
+            ptr->task_queue.Push(opr_block, opr_block->priority);
+            SampleQueue(profiling, ctx, "cpu_priority", &ptr->task_queue);
+          }
         } else {
           int dev_id = ctx.dev_id;
           int nthread = cpu_worker_nthreads_;
+          if (cpu_work_stealing_ && nthread > 1) {
+            auto ptr =
+            cpu_stealing_workers_.Get(dev_id, [this, ctx, nthread]() {
+                auto blk = new WorkStealingWorkerBlock(nthread);
+                blk->pool.reset(new ThreadPool(nthread, [this, ctx, blk] () {
+                      this->CPUWorker(ctx, blk);
+                    }, cpu_worker_affinity_));
+                return blk;
+              });
+            if (ptr) {
+              ptr->task_queue.Push(opr_block, opr_block->priority);
+              SampleQueue(profiling, ctx, "cpu_stealing", &ptr->task_queue);
+            }
+            return;
+          }
           auto ptr =
           cpu_normal_workers_.Get(dev_id, [this, ctx, nthread]() {
               auto blk = new ThreadWorkerBlock<kWorkerQueue>();
               blk->pool.reset(new ThreadPool(nthread, [this, ctx, blk] () {
                     this->CPUWorker(ctx, blk);
-                  }));
+                  }, cpu_worker_affinity_));
               return blk;
             });
           if (ptr) {
             ptr->task_queue.Push(opr_block, opr_block->priority);
+            SampleQueue(profiling, ctx, "cpu_worker", &ptr->task_queue);
           }
         }
       } else {
@@ -114,11 +146,27 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
                 [this, ctx, is_copy, blk]
                   (std::shared_ptr<ThreadPool::SimpleEvent> ready_event) {
                     this->GPUWorker(ctx, is_copy, blk, ready_event);
-                  }, true));
+                  }, true, ThreadAffinity::FromEnv("MXNET_GPU_COPY", nthread)));
               return blk;
             });
           if (ptr) {
             ptr->task_queue.Push(opr_block, opr_block->priority);
+            SampleQueue(profiling, ctx, "gpu_copy", &ptr->task_queue);
+          }
+        } else if (gpu_worker_priority_) {
+          auto ptr = gpu_priority_workers_.Get(ctx.dev_id, [this, ctx, is_copy, nthread]() {
+              auto blk = new ThreadWorkerBlock<kPriority>();
+              blk->pool.reset(new ThreadPool(
+                nthread,
+                [this, ctx, is_copy, blk]
+                  (std::shared_ptr<ThreadPool::SimpleEvent> ready_event) {
+                    this->GPUWorker(ctx, is_copy, blk, ready_event);
+                  }, true, ThreadAffinity::FromEnv("MXNET_GPU_WORKER", nthread)));
+              return blk;
+            });
+          if (ptr) {
+            ptr->task_queue.Push(opr_block, opr_block->priority);
+            SampleQueue(profiling, ctx, "gpu_priority", &ptr->task_queue);
           }
         } else {
           auto ptr = gpu_normal_workers_.Get(ctx.dev_id, [this, ctx, is_copy, nthread]() {
@@ -128,11 +176,12 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
                 [this, ctx, is_copy, blk]
                   (std::shared_ptr<ThreadPool::SimpleEvent> ready_event) {
                     this->GPUWorker(ctx, is_copy, blk, ready_event);
-                  }, true));
+                  }, true, ThreadAffinity::FromEnv("MXNET_GPU_WORKER", nthread)));
               return blk;
             });
           if (ptr) {
             ptr->task_queue.Push(opr_block, opr_block->priority);
+            SampleQueue(profiling, ctx, "gpu_worker", &ptr->task_queue);
           }
         }
       }
@@ -140,6 +189,15 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
   }
 
  private:
+  /*! \brief record the depth of a worker queue after a profiled push to it */
+  template<typename Queue>
+  inline void SampleQueue(bool profiling, const Context& ctx, const char* name, Queue* queue) {
+#if MXNET_USE_PROFILER
+    if (profiling) {
+      Profiler::Get()->AddQueueSample(ctx.dev_type, ctx.dev_id, name, queue->Size());
+    }
+#endif
+  }
   // working unit for each of the task.
   template<dmlc::ConcurrentQueueType type>
   struct ThreadWorkerBlock {
@@ -152,17 +210,40 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     // destructor
     ~ThreadWorkerBlock() noexcept(false) {}
   };
+  // working unit of a CPU device whose workers steal tasks from each other.
+  struct WorkStealingWorkerBlock {
+    // task queue on this task
+    WorkStealingQueue<OprBlock*> task_queue;
+    // thread pool that works on this task
+    std::unique_ptr<ThreadPool> pool;
+    // constructor
+    explicit WorkStealingWorkerBlock(int nthread) : task_queue(nthread) {}
+    // destructor
+    ~WorkStealingWorkerBlock() noexcept(false) {}
+  };
 
   /*! \brief number of concurrent thread cpu worker uses */
   int cpu_worker_nthreads_;
+  /*! \brief number of concurrent thread cpu priority worker uses */
+  int cpu_priority_nthreads_;
   /*! \brief number of concurrent thread each gpu worker uses */
   int gpu_worker_nthreads_;
+  /*! \brief whether cpu workers of a device steal tasks from each other */
+  bool cpu_work_stealing_;
+  /*! \brief whether gpu workers run ready operations by their priority */
+  bool gpu_worker_priority_;
+  /*! \brief placement and OpenMP team size of the cpu workers */
+  ThreadAffinity cpu_worker_affinity_;
   // cpu worker
   common::LazyAllocArray<ThreadWorkerBlock<kWorkerQueue> > cpu_normal_workers_;
+  // cpu worker with work stealing
+  common::LazyAllocArray<WorkStealingWorkerBlock> cpu_stealing_workers_;
   // cpu priority worker
-  std::unique_ptr<ThreadWorkerBlock<kPriorityQueue> > cpu_priority_worker_;
+  common::LazyAllocArray<ThreadWorkerBlock<kPriorityQueue> > cpu_priority_worker_;
   // workers doing normal works on GPU
   common::LazyAllocArray<ThreadWorkerBlock<kWorkerQueue> > gpu_normal_workers_;
+  // workers doing normal works on GPU, ordered by priority
+  common::LazyAllocArray<ThreadWorkerBlock<kPriority> > gpu_priority_workers_;
   // workers doing copy works from/to GPU
   common::LazyAllocArray<ThreadWorkerBlock<kCopyQueue> > gpu_copy_workers_;
   /*!
@@ -205,9 +286,8 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
    * \brief CPU worker that performs operations on CPU.
    * \param block The task block of the worker.
    */
-  template<dmlc::ConcurrentQueueType type>
-  inline void CPUWorker(Context ctx,
-                        ThreadWorkerBlock<type> *block) {
+  template<typename Block>
+  inline void CPUWorker(Context ctx, Block *block) {
     auto* task_queue = &(block->task_queue);
     RunContext run_ctx{ctx, nullptr};
     // execute task
@@ -228,11 +308,11 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
   /*! Signal all queues for shutdown */
   void SignalQueuesForKill() {
     SignalQueueForKill(&gpu_normal_workers_);
+    SignalQueueForKill(&gpu_priority_workers_);
     SignalQueueForKill(&gpu_copy_workers_);
     SignalQueueForKill(&cpu_normal_workers_);
-    if (cpu_priority_worker_) {
-      cpu_priority_worker_->task_queue.SignalForKill();
-    }
+    SignalQueueForKill(&cpu_stealing_workers_);
+    SignalQueueForKill(&cpu_priority_worker_);
   }
 };
 
@@ -26,6 +26,8 @@
 #include <dmlc/logging.h>
 #include <dmlc/concurrency.h>
 #include <cassert>
+#include <memory>
+#include <mutex>
 #include "./threaded_engine.h"
 #include "./thread_pool.h"
 #include "./stream_manager.h"
@@ -41,9 +43,8 @@ namespace engine {
  */
 class ThreadedEnginePooled : public ThreadedEngine {
  public:
-  ThreadedEnginePooled() :
-      thread_pool_(kNumWorkingThreads, [this]() { ThreadWorker(&task_queue_); }),
-      io_thread_pool_(1, [this]() { ThreadWorker(&io_task_queue_); }) {}
+  // the thread pools are started at the first push to them
+  ThreadedEnginePooled() = default;
 
   ~ThreadedEnginePooled() noexcept(false) {
     streams_.Finalize();
@@ -79,8 +80,10 @@ class ThreadedEnginePooled : public ThreadedEngine {
   /*!
    * \brief Thread pools.
    */
-  ThreadPool thread_pool_;
-  ThreadPool io_thread_pool_;
+  std::unique_ptr<ThreadPool> thread_pool_;
+  std::unique_ptr<ThreadPool> io_thread_pool_;
+  std::once_flag thread_pool_started_;
+  std::once_flag io_thread_pool_started_;
   /*!
    * \brief Worker.
    * \param task_queue Queue to work on.
@@ -113,19 +116,43 @@ class ThreadedEnginePooled : public ThreadedEngine {
         : streams_.GetRunContext(opr_block->ctx);
     this->ExecuteOprBlock(rctx, opr_block);
   }
+  /*! \brief record the depth of a queue after a profiled push to it */
+  inline void SampleQueue(bool profiling, const Context& ctx, const char* name,
+                          dmlc::ConcurrentBlockingQueue<OprBlock*>* queue) {
+#if MXNET_USE_PROFILER
+    if (profiling) {
+      Profiler::Get()->AddQueueSample(ctx.dev_type, ctx.dev_id, name, queue->Size());
+    }
+#endif
+  }
   /*!
    * \brief Push the operation to the queue.
    * \param opr_block The operator block.
    */
   void DoPushToQueue(OprBlock* opr_block) {
+    // a worker may run and free the block as soon as it is queued
+    const Context ctx = opr_block->ctx;
+    const bool profiling = opr_block->profiling;
     switch (opr_block->opr->prop) {
       case FnProperty::kCopyFromGPU:
       case FnProperty::kCopyToGPU: {
+        std::call_once(io_thread_pool_started_, [this]() {
+            io_thread_pool_.reset(new ThreadPool(1, [this]() {
+                  ThreadWorker(&io_task_queue_);
+                }));
+          });
         io_task_queue_.Push(opr_block);
+        SampleQueue(profiling, ctx, "io_worker", &io_task_queue_);
         break;
       }
       default: {
+        std::call_once(thread_pool_started_, [this]() {
+            thread_pool_.reset(new ThreadPool(kNumWorkingThreads, [this]() {
+                  ThreadWorker(&task_queue_);
+                }));
+          });
         task_queue_.Push(opr_block);
+        SampleQueue(profiling, ctx, "worker", &task_queue_);
         break;
       }
     }
@@ -0,0 +1,254 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file work_stealing_queue.h
+ * \brief task queue of a worker pool where idle workers steal tasks
+ *  from the lock-free deques of busy workers.
+ */
+#ifndef MXNET_ENGINE_WORK_STEALING_QUEUE_H_
+#define MXNET_ENGINE_WORK_STEALING_QUEUE_H_
+
+#include <dmlc/base.h>
+#include <dmlc/logging.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "mxnet/base.h"
+
+namespace mxnet {
+namespace engine {
+
+/*!
+ * \brief Bounded single-owner deque (Chase-Lev).
+ *  Only the owner thread calls Push and Take, any thread can call Steal.
+ * \tparam T pointer type of the stored items.
+ */
+template<typename T>
+class WorkStealingDeque {
+ public:
+  WorkStealingDeque() {
+    for (auto& item : buffer_) item.store(nullptr, std::memory_order_relaxed);
+  }
+  /*!
+   * \brief push an item to the bottom, owner only.
+   * \return false if the deque is full.
+   */
+  inline bool Push(T item) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t >= kCapacity) return false;
+    buffer_[b & kMask].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+  /*!
+   * \brief take the most recently pushed item, owner only.
+   * \return nullptr if the deque is empty.
+   */
+  inline T Take() {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    T item = buffer_[b & kMask].load(std::memory_order_relaxed);
+    if (t == b) {
+      // the last item, race against the thieves
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        item = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+  /*!
+   * \brief steal the oldest item, any thread.
+   * \return nullptr if the deque is empty or the steal lost a race.
+   */
+  inline T Steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+    T item = buffer_[t & kMask].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return item;
+  }
+
+ private:
+  /*! \brief capacity of the deque, a power of two */
+  static constexpr int64_t kCapacity = 1024;
+  static constexpr int64_t kMask = kCapacity - 1;
+  /*! \brief index of the oldest item, advanced by thieves */
+  std::atomic<int64_t> top_{0};
+  /*! \brief index after the newest item, only written by the owner */
+  std::atomic<int64_t> bottom_{0};
+  /*! \brief ring buffer of the items */
+  std::atomic<T> buffer_[kCapacity];
+};
+
+/*!
+ * \brief Task queue shared by a fixed number of worker threads.
+ *  Each worker keeps a lock-free deque.  Tasks pushed by a worker go to its
+ *  own deque, tasks pushed by other threads go to a shared injection queue.
+ *  A worker pops its own deque first, then the injection queue, and then
+ *  steals from the other workers before it goes to sleep.
+ *
+ *  The interface follows dmlc::ConcurrentBlockingQueue, so it can be used
+ *  in place of it by the engine workers.
+ * \tparam T pointer type of the tasks.
+ */
+template<typename T>
+class WorkStealingQueue {
+ public:
+  /*!
+   * \brief constructor
+   * \param num_workers number of threads that will call Pop.
+   */
+  explicit WorkStealingQueue(int num_workers) {
+    CHECK_GT(num_workers, 0);
+    for (int i = 0; i < num_workers; ++i) {
+      deques_.emplace_back(new WorkStealingDeque<T>());
+    }
+  }
+  /*!
+   * \brief push a task, the priority is ignored.
+   */
+  inline void Push(T item, int priority = 0) {
+    WorkerSlot* slot = CurrentWorker();
+    if (slot->owner != this || !deques_[slot->index]->Push(item)) {
+      std::lock_guard<std::mutex> lock(inject_mutex_);
+      inject_queue_.push_back(item);
+    }
+    // seq_cst pairs with the sleeper, which increases num_sleeping_ before
+    // it checks num_tasks_, so either side sees the other one
+    ++num_tasks_;
+    if (num_sleeping_.load() > 0) {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      sleep_cv_.notify_one();
+    }
+  }
+  /*!
+   * \brief pop a task, blocks until there is one.
+   *  Each worker thread is registered on its first call.
+   * \return false if the queue has been signaled for kill.
+   */
+  inline bool Pop(T* item) {
+    int index = WorkerIndex();
+    while (!exit_now_.load()) {
+      if (TryPop(index, item)) {
+        --num_tasks_;
+        return true;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      ++num_sleeping_;
+      sleep_cv_.wait(lock, [this]() {
+          return num_tasks_.load() > 0 || exit_now_.load();
+        });
+      --num_sleeping_;
+    }
+    return false;
+  }
+  /*! \return the number of tasks pushed and not yet popped */
+  inline size_t Size() const {
+    const int n = num_tasks_.load();
+    return n > 0 ? n : 0;
+  }
+  /*! \brief wake up all workers and make Pop return false */
+  inline void SignalForKill() {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    exit_now_.store(true);
+    sleep_cv_.notify_all();
+  }
+
+ private:
+  /*! \brief queue and index of the worker running on the current thread */
+  struct WorkerSlot {
+    const WorkStealingQueue* owner;
+    int index;
+  };
+  static WorkerSlot* CurrentWorker() {
+#if DMLC_CXX11_THREAD_LOCAL
+    static thread_local WorkerSlot slot{nullptr, -1};
+#else
+    static MX_THREAD_LOCAL WorkerSlot slot{nullptr, -1};
+#endif
+    return &slot;
+  }
+  inline int WorkerIndex() {
+    WorkerSlot* slot = CurrentWorker();
+    if (slot->owner != this) {
+      int index = num_registered_++;
+      CHECK_LT(index, static_cast<int>(deques_.size()))
+          << "More workers than the WorkStealingQueue was created for";
+      slot->owner = this;
+      slot->index = index;
+    }
+    return slot->index;
+  }
+  inline bool TryPop(int index, T* item) {
+    T task = deques_[index]->Take();
+    if (task == nullptr) {
+      std::lock_guard<std::mutex> lock(inject_mutex_);
+      if (!inject_queue_.empty()) {
+        task = inject_queue_.front();
+        inject_queue_.pop_front();
+      }
+    }
+    const int num_workers = static_cast<int>(deques_.size());
+    for (int i = 1; task == nullptr && i < num_workers; ++i) {
+      task = deques_[(index + i) % num_workers]->Steal();
+    }
+    *item = task;
+    return task != nullptr;
+  }
+  /*! \brief deques of the workers */
+  std::vector<std::unique_ptr<WorkStealingDeque<T> > > deques_;
+  /*! \brief tasks from non-worker threads and overflow of full deques */
+  std::mutex inject_mutex_;
+  std::deque<T> inject_queue_;
+  /*! \brief number of tasks pushed but not popped yet */
+  std::atomic<int> num_tasks_{0};
+  /*! \brief number of workers waiting on sleep_cv_ */
+  std::atomic<int> num_sleeping_{0};
+  /*! \brief number of workers registered so far */
+  std::atomic<int> num_registered_{0};
+  /*! \brief whether the queue is being destroyed */
+  std::atomic<bool> exit_now_{false};
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingQueue);
+};
+
+}  // namespace engine
+}  // namespace mxnet
+#endif  // MXNET_ENGINE_WORK_STEALING_QUEUE_H_
@@ -0,0 +1,98 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file amp_pass.cc
+ * \brief Run selected operators of a float32 symbol in float16.
+ */
+#include <mxnet/base.h>
+#include <nnvm/graph.h>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+nnvm::Symbol ReducePrecision(const nnvm::Symbol& src,
+                             const std::unordered_set<std::string>& target_ops,
+                             const std::unordered_set<std::string>& fp32_ops) {
+  using nnvm::Node;
+  using nnvm::NodeEntry;
+  using nnvm::NodePtr;
+  // the nodes of the copy can be modified without changing the symbol of the user
+  nnvm::Symbol sym = src.Copy();
+  static const nnvm::Op* cast_op = nnvm::Op::Get("Cast");
+  // the nodes whose outputs are in float16
+  std::unordered_set<const Node*> reduced;
+  std::map<std::tuple<const Node*, uint32_t, int>, NodeEntry> casts;
+  auto cast = [&casts](const NodeEntry& e, int to) {
+    auto key = std::make_tuple(e.node.get(), e.index, to);
+    auto it = casts.find(key);
+    if (it != casts.end()) return it->second;
+    NodePtr n = Node::Create();
+    n->attrs.op = cast_op;
+    n->attrs.name = e.node->attrs.name + (to == mshadow::kFloat32 ? "_amp_fp32" : "_amp_fp16");
+    n->attrs.dict["dtype"] = to == mshadow::kFloat32 ? "float32" : "float16";
+    cast_op->attr_parser(&(n->attrs));
+    n->inputs.push_back(e);
+    NodeEntry ret{n, 0, 0};
+    casts[key] = ret;
+    return ret;
+  };
+  nnvm::DFSVisit(sym.outputs, [&](const NodePtr& node) {
+    if (node->is_variable()) return;
+    const std::string& name = node->op()->name;
+    bool all_reduced = !node->inputs.empty();
+    for (const auto& e : node->inputs) {
+      if (!reduced.count(e.node.get())) all_reduced = false;
+    }
+    if (target_ops.count(name)) {
+      for (auto& e : node->inputs) {
+        if (reduced.count(e.node.get())) continue;
+        // the type of an argument cast to float16 is not
+        // constrained by its users anymore, so it defaults to float32
+        if (e.node->is_variable() && e.node->attrs.dict.count("__dtype__") == 0) {
+          e.node->attrs.dict["__dtype__"] = std::to_string(mshadow::kFloat32);
+        }
+        e = cast(e, mshadow::kFloat16);
+      }
+      reduced.insert(node.get());
+    } else if (fp32_ops.count(name) || !all_reduced) {
+      // an operator with inputs of both precisions runs in float32
+      for (auto& e : node->inputs) {
+        if (reduced.count(e.node.get())) e = cast(e, mshadow::kFloat32);
+      }
+    } else {
+      reduced.insert(node.get());
+    }
+  });
+  for (auto& e : sym.outputs) {
+    if (reduced.count(e.node.get())) e = cast(e, mshadow::kFloat32);
+  }
+  return sym;
+}
+
+}  // namespace exec
+}  // namespace mxnet
@@ -25,7 +25,15 @@
 #include <mxnet/operator.h>
 #include <mxnet/op_attr_types.h>
 #include <nnvm/graph_attr_types.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include "../common/utils.h"
+#include "../common/cuda_utils.h"
+#include "../engine/profiler.h"
+#include "../operator/tensor/cast_storage.h"
 #include "./exec_pass.h"
 #if MXNET_USE_MKL2017 == 1
 #include <mkl_memory.h>
@@ -40,6 +48,94 @@ const OperatorProperty* OpPropGetOpProperty(const NodeAttrs& attrs);
 
 namespace exec {
 
+/*!
+ * \brief create the states of the stateful nodes, on several threads as
+ *  creating one may search the fastest algorithm of the operator; the ones
+ *  of the operators with TSerialCreateOpState are created on this thread.
+ */
+std::vector<OpStatePtr> CreateOpStates(const Graph& g) {
+  auto& fcreate_op_state = nnvm::Op::GetAttr<FCreateOpState>("FCreateOpState");
+  auto& serial_create = nnvm::Op::GetAttr<bool>("TSerialCreateOpState");
+  const auto& vdtype = g.GetAttr<nnvm::DTypeVector>("dtype");
+  const auto& vshape = g.GetAttr<nnvm::ShapeVector>("shape");
+  const auto& vctx = g.GetAttr<ContextVector>("context");
+  const auto& vstype = g.GetAttr<std::vector<int> >("storage_type");
+  const auto& saved_states = g.GetAttr<
+    std::unordered_map<const nnvm::Node*, OpStatePtr> >("saved_states");
+  const auto& idx = g.indexed_graph();
+
+  std::vector<OpStatePtr> states(idx.num_nodes());
+  auto create = [&](uint32_t nid) {
+    const auto& inode = idx[nid];
+    std::vector<TShape> ishape;
+    std::vector<int> itype;
+    for (const auto& e : inode.inputs) {
+      ishape.emplace_back(vshape[idx.entry_id(e)]);
+      itype.emplace_back(vdtype[idx.entry_id(e)]);
+    }
+    states[nid] = fcreate_op_state[inode.source->op()](
+        inode.source->attrs, vctx[nid], ishape, itype);
+  };
+  std::vector<uint32_t> parallel_nids;
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    const auto& inode = idx[nid];
+    if (inode.source->is_variable()) continue;
+    const nnvm::Op* op = inode.source->op();
+    if (!fcreate_op_state.count(op)) continue;
+    if (saved_states.count(inode.source)) {
+      states[nid] = saved_states.at(inode.source);
+      continue;
+    }
+    bool sparse = false;
+    for (const auto& e : inode.inputs) {
+      sparse = sparse || vstype[idx.entry_id(e)] != kDefaultStorage;
+    }
+    for (uint32_t j = 0; j < inode.source->num_outputs(); ++j) {
+      sparse = sparse || vstype[idx.entry_id(nid, j)] != kDefaultStorage;
+    }
+    CHECK(!sparse) << "Operator " << op->name << " does not support the sparse "
+                   << "storage, cast its arrays with cast_storage";
+    if (serial_create.get(op, false)) {
+      create(nid);
+    } else {
+      parallel_nids.push_back(nid);
+    }
+  }
+
+  static const size_t max_threads = dmlc::GetEnv("MXNET_EXEC_BIND_NUM_THREADS", 4);
+  const size_t num_threads = std::min(max_threads, parallel_nids.size());
+  if (num_threads <= 1) {
+    for (uint32_t nid : parallel_nids) create(nid);
+    return states;
+  }
+  std::atomic<size_t> next{0};
+  std::mutex mu;
+  std::exception_ptr error;
+  auto work = [&]() {
+    // the memory of the states is attributed to the bind
+    engine::MemoryScope memory_scope("GraphExecutor::Bind");
+    for (size_t k = next++; k < parallel_nids.size(); k = next++) {
+      try {
+#if MXNET_USE_CUDA
+        // the state of a gpu node is created on its device
+        if (vctx[parallel_nids[k]].dev_mask() == gpu::kDevMask) {
+          CUDA_CALL(cudaSetDevice(vctx[parallel_nids[k]].dev_id));
+        }
+#endif
+        create(parallel_nids[k]);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mu);
+        if (!error) error = std::current_exception();
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < num_threads; ++i) threads.emplace_back(work);
+  for (auto& t : threads) t.join();
+  if (error) std::rethrow_exception(error);
+  return states;
+}
+
 // forward executor
 class StatefulComputeExecutor : public OpExecutor {
  public:
@@ -121,6 +217,19 @@ class FComputeExecutor : public OpExecutor {
  public:
   void Run(RunContext rctx) override {
     op_ctx.run_ctx = rctx;
+    if (fallback_) {
+      // the sparse arrays are cast for the operators without sparse kernels
+      if (rctx.get_ctx().dev_mask() == gpu::kDevMask) {
+#if MXNET_USE_CUDA
+        op::FComputeFallback<gpu>(fcompute_, attrs_, op_ctx, in_array, req, out_array);
+#else
+        LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+#endif
+      } else {
+        op::FComputeFallback<cpu>(fcompute_, attrs_, op_ctx, in_array, req, out_array);
+      }
+      return;
+    }
     fcompute_(attrs_, op_ctx, in_data_, req, out_data_);
 #if MKL_EXPERIMENTAL == 1
     mkl_tblobs_prv_to_cpu(in_data_);
@@ -129,6 +238,8 @@ class FComputeExecutor : public OpExecutor {
   }
 
   void Setup() override {
+    fallback_ = op::HasSparse(in_array) || op::HasSparse(out_array);
+    if (fallback_) return;
     in_data_.resize(in_array.size());
     out_data_.resize(out_array.size());
     auto get_blob =  [](const NDArray& nd) {
@@ -151,13 +262,37 @@ class FComputeExecutor : public OpExecutor {
   NodeAttrs attrs_;
   FCompute fcompute_;
   ExecType exec_type_;
+  bool fallback_ = false;
   std::vector<TBlob> in_data_, out_data_;
 };
 
+// fcompute executor on the NDArrays, for the sparse kernels
+class FComputeExExecutor : public OpExecutor {
+ public:
+  void Run(RunContext rctx) override {
+    op_ctx.run_ctx = rctx;
+    fcompute_(attrs_, op_ctx, in_array, req, out_array);
+  }
+
+  void Setup() override {}
+
+  ExecType exec_type() const override {
+    return exec_type_;
+  }
+
+  explicit FComputeExExecutor(const NodeAttrs& attrs, FComputeEx fcompute,
+                              ExecType exec_type)
+      : attrs_(attrs), fcompute_(fcompute), exec_type_(exec_type) {
+  }
+
+ private:
+  NodeAttrs attrs_;
+  FComputeEx fcompute_;
+  ExecType exec_type_;
+};
+
 // pass to attach operator executors
 Graph AttachOpExecs(Graph g) {
-  using nnvm::DTypeVector;
-  using nnvm::ShapeVector;
   using nnvm::FMutateInputs;
 
   auto& fcreate_op_state = nnvm::Op::GetAttr<FCreateOpState>("FCreateOpState");
@@ -165,15 +300,13 @@ Graph AttachOpExecs(Graph g) {
   auto& fexec_type = nnvm::Op::GetAttr<FExecType>("FExecType");
   auto& is_layer_backward = nnvm::Op::GetAttr<bool>("TIsLayerOpBackward");
 
-  const auto& vdtype = g.GetAttr<DTypeVector>("dtype");
-  const auto& vshape = g.GetAttr<ShapeVector>("shape");
   const auto& vctx = g.GetAttr<ContextVector>("context");
-  const auto& saved_states = g.GetAttr<
-    std::unordered_map<const nnvm::Node*, OpStatePtr> >("saved_states");
+  const auto& vstype = g.GetAttr<std::vector<int> >("storage_type");
 
   // get the graph
   const auto& idx = g.indexed_graph();
   std::vector<std::shared_ptr<OpExecutor> > ret(idx.num_nodes());
+  std::vector<OpStatePtr> states = CreateOpStates(g);
 
   // initialize the nodes
   for (size_t i = 0; i < idx.num_nodes(); ++i) {
@@ -189,21 +322,17 @@ Graph AttachOpExecs(Graph g) {
       exec_type = fexec_type[op](inode.source->attrs);
     }
 
-    if (fcreate_op_state.count(op)) {
-      std::vector<TShape> ishape;
-      std::vector<int> itype;
-      for (const auto& e : inode.inputs) {
-        ishape.emplace_back(vshape[idx.entry_id(e)]);
-        itype.emplace_back(vdtype[idx.entry_id(e)]);
-      }
+    // whether the node reads or writes a sparse entry
+    bool sparse = false;
+    for (const auto& e : inode.inputs) {
+      sparse = sparse || vstype[idx.entry_id(e)] != kDefaultStorage;
+    }
+    for (uint32_t j = 0; j < inode.source->num_outputs(); ++j) {
+      sparse = sparse || vstype[idx.entry_id(i, j)] != kDefaultStorage;
+    }
 
-      OpStatePtr state;
-      if (saved_states.count(inode.source)) {
-        state = saved_states.at(inode.source);
-      } else {
-        state = fcreate_op_state[op](
-            inode.source->attrs, vctx[i], ishape, itype);
-      }
+    if (fcreate_op_state.count(op)) {
+      const OpStatePtr& state = states[i];
       FStatefulCompute fcompute = common::GetFCompute<FStatefulCompute>(
           op, "FStatefulCompute", vctx[i]);
       if (fcompute != nullptr) {
@@ -239,7 +368,11 @@ Graph AttachOpExecs(Graph g) {
       }
     } else {
       FCompute fcompute = common::GetFCompute<FCompute>(op, "FCompute", vctx[i]);
-      if (fcompute != nullptr) {
+      FComputeEx fcompute_ex = common::GetFCompute<FComputeEx>(op, "FComputeEx", vctx[i]);
+      if (fcompute_ex != nullptr && (sparse || fcompute == nullptr)) {
+        ret[i] = std::make_shared<FComputeExExecutor>(
+            inode.source->attrs, fcompute_ex, exec_type);
+      } else if (fcompute != nullptr) {
         ret[i] = std::make_shared<FComputeExecutor>(
             inode.source->attrs, fcompute, exec_type);
       } else {
@@ -0,0 +1,134 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file bucketing_executor.cc
+ * \brief executors of the buckets of a model sharing the default one
+ */
+#include "./bucketing_executor.h"
+
+namespace mxnet {
+namespace exec {
+
+BucketingExecutor::BucketingExecutor(int default_bucket_key,
+                                     const nnvm::Symbol& symbol,
+                                     const Context& default_ctx,
+                                     const std::map<std::string, Context>& group2ctx,
+                                     const std::vector<NDArray>& in_args,
+                                     const std::vector<NDArray>& arg_grad_store,
+                                     const std::vector<OpReqType>& grad_req_type,
+                                     const std::vector<NDArray>& aux_states)
+    : default_ctx_(default_ctx), group2ctx_(group2ctx), symbol_(symbol) {
+  std::vector<std::string> arg_names = symbol.ListInputNames(nnvm::Symbol::kReadOnlyArgs);
+  std::vector<std::string> aux_names = symbol.ListInputNames(nnvm::Symbol::kAuxiliaryStates);
+  CHECK_EQ(arg_names.size(), in_args.size()) << "Bucketing: wrong number of arguments";
+  CHECK_EQ(arg_names.size(), arg_grad_store.size());
+  CHECK_EQ(arg_names.size(), grad_req_type.size());
+  CHECK_EQ(aux_names.size(), aux_states.size())
+      << "Bucketing: wrong number of auxiliary states";
+  for (size_t i = 0; i < arg_names.size(); ++i) {
+    in_args_[arg_names[i]] = in_args[i];
+    arg_grads_[arg_names[i]] = arg_grad_store[i];
+    grad_reqs_[arg_names[i]] = grad_req_type[i];
+  }
+  for (size_t i = 0; i < aux_names.size(); ++i) {
+    aux_states_[aux_names[i]] = aux_states[i];
+  }
+  Bucket& bucket = buckets_[default_bucket_key];
+  default_exec_ = Executor::Bind(symbol, default_ctx, group2ctx, in_args,
+                                 arg_grad_store, grad_req_type, aux_states);
+  bucket.exec.reset(default_exec_);
+  bucket.in_args = in_args;
+  bucket.arg_grads = arg_grad_store;
+  bucket.aux_states = aux_states;
+}
+
+NDArray BucketingExecutor::DataArray(const std::string& name, const TShape& shape,
+                                     const NDArray& like,
+                                     std::unordered_map<std::string, NDArray>* buffer) {
+  auto it = buffer->find(name);
+  if (it == buffer->end()) {
+    it = buffer->emplace(name, like).first;
+  }
+  if (it->second.shape().Size() < shape.Size()) {
+    LOG(WARNING) << "Bucketing: " << name << " has a shape " << shape
+                 << ", which is larger than the allocated shape " << it->second.shape()
+                 << ". The default bucket should be the one taking the largest inputs.";
+    it->second = NDArray(shape, like.ctx(), false, like.dtype());
+  }
+  return it->second.Reshape(shape);
+}
+
+Executor* BucketingExecutor::Get(int bucket_key, const nnvm::Symbol* symbol,
+                                 const std::unordered_map<std::string, TShape>& data_shapes,
+                                 std::vector<NDArray>* in_args,
+                                 std::vector<NDArray>* arg_grads,
+                                 std::vector<NDArray>* aux_states) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = buckets_.find(bucket_key);
+  if (it == buckets_.end()) {
+    it = buckets_.emplace(bucket_key, Bind(bucket_key, symbol, data_shapes)).first;
+  }
+  const Bucket& bucket = it->second;
+  if (in_args != nullptr) *in_args = bucket.in_args;
+  if (arg_grads != nullptr) *arg_grads = bucket.arg_grads;
+  if (aux_states != nullptr) *aux_states = bucket.aux_states;
+  return bucket.exec.get();
+}
+
+BucketingExecutor::Bucket BucketingExecutor::Bind(
+    int bucket_key, const nnvm::Symbol* symbol,
+    const std::unordered_map<std::string, TShape>& data_shapes) {
+  const nnvm::Symbol& sym = symbol != nullptr ? *symbol : symbol_;
+  Bucket bucket;
+  std::vector<NDArray>& in_args = bucket.in_args;
+  std::vector<NDArray>& arg_grads = bucket.arg_grads;
+  std::vector<NDArray>& aux_states = bucket.aux_states;
+  std::vector<OpReqType> grad_reqs;
+  for (const std::string& name : sym.ListInputNames(nnvm::Symbol::kReadOnlyArgs)) {
+    auto arg = in_args_.find(name);
+    CHECK(arg != in_args_.end()) << "Bucketing: the argument " << name << " of the bucket "
+                                 << bucket_key << " is not an argument of the default bucket";
+    const NDArray& grad = arg_grads_.at(name);
+    const OpReqType req = grad_reqs_.at(name);
+    auto shape = data_shapes.find(name);
+    if (shape == data_shapes.end()) {
+      in_args.push_back(arg->second);
+      arg_grads.push_back(grad);
+    } else {
+      in_args.push_back(DataArray(name, shape->second, arg->second, &data_buffer_));
+      arg_grads.push_back(req == kNullOp || grad.is_none() ? NDArray() :
+                          DataArray(name, shape->second, grad, &grad_buffer_));
+    }
+    grad_reqs.push_back(req);
+  }
+  for (const std::string& name : sym.ListInputNames(nnvm::Symbol::kAuxiliaryStates)) {
+    auto aux = aux_states_.find(name);
+    CHECK(aux != aux_states_.end()) << "Bucketing: the auxiliary state " << name
+                                    << " of the bucket " << bucket_key
+                                    << " is not one of the default bucket";
+    aux_states.push_back(aux->second);
+  }
+  bucket.exec.reset(Executor::Bind(sym, default_ctx_, group2ctx_, in_args, arg_grads,
+                                   grad_reqs, aux_states, default_exec_));
+  return bucket;
+}
+
+}  // namespace exec
+}  // namespace mxnet
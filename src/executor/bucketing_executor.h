@@ -0,0 +1,122 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file bucketing_executor.h
+ * \brief executors of the buckets of a model, such as the sequence lengths of
+ *  a recurrent network, that share the parameters and the memory of the largest
+ */
+#ifndef MXNET_EXECUTOR_BUCKETING_EXECUTOR_H_
+#define MXNET_EXECUTOR_BUCKETING_EXECUTOR_H_
+
+#include <mxnet/base.h>
+#include <mxnet/executor.h>
+#include <mxnet/ndarray.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mxnet {
+namespace exec {
+
+/*!
+ * \brief executors keyed by the bucket, bound on their first use.
+ *  The executor of the default bucket, which should take the largest inputs,
+ *  is bound with the given arrays. The executor of another bucket reads and
+ *  writes the same parameters, gradients and auxiliary states, its data
+ *  arrays are views of the ones of the default bucket, and it plans its
+ *  memory in the pool of the default executor, so a bucket costs little more
+ *  than its graph. The executors share memory and must not run at the same
+ *  time; getting them is thread safe.
+ */
+class BucketingExecutor {
+ public:
+  /*!
+   * \brief bind the executor of the default bucket, see Executor::Bind.
+   * \param default_bucket_key the key of the default bucket.
+   */
+  BucketingExecutor(int default_bucket_key,
+                    const nnvm::Symbol& symbol,
+                    const Context& default_ctx,
+                    const std::map<std::string, Context>& group2ctx,
+                    const std::vector<NDArray>& in_args,
+                    const std::vector<NDArray>& arg_grad_store,
+                    const std::vector<OpReqType>& grad_req_type,
+                    const std::vector<NDArray>& aux_states);
+  /*!
+   * \brief get the executor of a bucket, binding it the first time.
+   * \param bucket_key the key of the bucket.
+   * \param symbol the symbol of the bucket, nullptr for the one of the
+   *  default bucket; only used the first time.
+   * \param data_shapes the shapes of the arguments that change with the
+   *  bucket, such as the data and the label; the other arguments are the
+   *  ones of the default bucket. Only used the first time.
+   * \param in_args if not nullptr, set to the arguments of the executor.
+   * \param arg_grads if not nullptr, set to the gradients of the arguments.
+   * \param aux_states if not nullptr, set to the auxiliary states.
+   * \return the executor, owned by this.
+   */
+  Executor* Get(int bucket_key, const nnvm::Symbol* symbol,
+                const std::unordered_map<std::string, TShape>& data_shapes,
+                std::vector<NDArray>* in_args = nullptr,
+                std::vector<NDArray>* arg_grads = nullptr,
+                std::vector<NDArray>* aux_states = nullptr);
+  /*! \return the executor of the default bucket */
+  Executor* default_executor() const {
+    return default_exec_;
+  }
+
+ private:
+  /*! \brief the executor of a bucket and the arrays it is bound to */
+  struct Bucket {
+    std::unique_ptr<Executor> exec;
+    std::vector<NDArray> in_args, arg_grads, aux_states;
+  };
+
+  /*! \brief bind the executor of a new bucket, see Get */
+  Bucket Bind(int bucket_key, const nnvm::Symbol* symbol,
+              const std::unordered_map<std::string, TShape>& data_shapes);
+  /*! \brief a view of shape of the array named name of buffer, grown as needed */
+  NDArray DataArray(const std::string& name, const TShape& shape, const NDArray& like,
+                    std::unordered_map<std::string, NDArray>* buffer);
+
+  /*! \brief protects the executors and the buffers */
+  std::mutex mutex_;
+  /*! \brief the context and the groups of the executors */
+  Context default_ctx_;
+  std::map<std::string, Context> group2ctx_;
+  /*! \brief the symbol of the default bucket */
+  nnvm::Symbol symbol_;
+  /*! \brief the executors of the buckets */
+  std::unordered_map<int, Bucket> buckets_;
+  /*! \brief the executor of the default bucket */
+  Executor* default_exec_{nullptr};
+  /*! \brief the arrays of the default bucket by name */
+  std::unordered_map<std::string, NDArray> in_args_, arg_grads_, aux_states_;
+  std::unordered_map<std::string, OpReqType> grad_reqs_;
+  /*! \brief the largest data arrays and data gradients by name */
+  std::unordered_map<std::string, NDArray> data_buffer_, grad_buffer_;
+};
+
+}  // namespace exec
+}  // namespace mxnet
+#endif  // MXNET_EXECUTOR_BUCKETING_EXECUTOR_H_
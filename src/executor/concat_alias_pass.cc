@@ -0,0 +1,198 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file concat_alias_pass.cc
+ * \brief let the producers of a Concat write into its output, and the
+ *  outputs of a SliceChannel be views of its input
+ */
+#include <dmlc/parameter.h>
+#include <mxnet/base.h>
+#include <mxnet/ndarray.h>
+#include <mxnet/op_attr_types.h>
+#include <nnvm/graph_attr_types.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+namespace {
+
+/*! \brief the value of an integer parameter of a node */
+int IntParam(const nnvm::NodeAttrs& attrs, const std::string& key, int value) {
+  auto it = attrs.dict.find(key);
+  return it == attrs.dict.end() ? value : std::stoi(it->second);
+}
+
+/*! \brief whether the part of shape split at axis is contiguous */
+bool OuterAxis(const TShape& shape, int axis) {
+  if (axis < 0) axis += shape.ndim();
+  return axis >= 0 && static_cast<uint32_t>(axis) < shape.ndim() &&
+         shape.ProdShape(0, axis) == 1;
+}
+
+}  // namespace
+
+Graph DetectConcatAlias(Graph g) {
+  static const Op* concat_op = Op::Get("Concat");
+  static const Op* split_op = Op::Get("SliceChannel");
+  const auto& idx = g.indexed_graph();
+  const auto& vshape = g.GetAttr<nnvm::ShapeVector>("shape");
+  const auto& vdtype = g.GetAttr<nnvm::DTypeVector>("dtype");
+  const auto& vstype = g.GetAttr<std::vector<int> >("storage_type");
+  const auto& vctx = g.GetAttr<ContextVector>("context");
+  const auto& addto_entry = g.GetAttr<std::vector<int> >("addto_entry");
+  nnvm::StorageVector storage_id = g.MoveCopyAttr<nnvm::StorageVector>("storage_id");
+  std::vector<int> storage_inplace_index =
+      g.MoveCopyAttr<std::vector<int> >("storage_inplace_index");
+  std::vector<int> skip_plus_node = g.MoveCopyAttr<std::vector<int> >("skip_plus_node");
+  std::vector<int> alias_entry(idx.num_node_entries(), -1);
+  std::vector<size_t> alias_offset(idx.num_node_entries(), 0);
+  // the arena plans the lifetimes of the blocks itself
+  const bool enable = dmlc::GetEnv("MXNET_EXEC_INPLACE_CONCAT", true) &&
+                      !dmlc::GetEnv("MXNET_EXEC_MEMORY_ARENA", false);
+
+  // the lifetime of each entry, the entries written in place over, and the entries of each storage
+  const uint32_t kForever = idx.num_nodes();
+  std::vector<int> inplace_source(idx.num_node_entries(), 0);
+  std::vector<uint32_t> producer(idx.num_node_entries(), 0), last_use(idx.num_node_entries(), 0);
+  std::vector<int> is_target(idx.num_node_entries(), 0);
+  std::vector<std::vector<uint32_t> > storage_entries;
+  for (uint32_t nid = 0; enable && nid < idx.num_nodes(); ++nid) {
+    for (const auto& e : idx[nid].inputs) {
+      uint32_t eid = idx.entry_id(e);
+      last_use[eid] = std::max(last_use[eid], nid);
+    }
+    for (uint32_t i = 0; i < idx[nid].source->num_outputs(); ++i) {
+      uint32_t eid = idx.entry_id(nid, i);
+      producer[eid] = nid;
+      last_use[eid] = std::max(last_use[eid], nid);
+      if (storage_inplace_index[eid] >= 0) {
+        inplace_source[idx.entry_id(idx[nid].inputs[storage_inplace_index[eid]])] = 1;
+      }
+      if (storage_id[eid] < 0) continue;
+      if (static_cast<size_t>(storage_id[eid]) >= storage_entries.size()) {
+        storage_entries.resize(storage_id[eid] + 1);
+      }
+      storage_entries[storage_id[eid]].push_back(eid);
+    }
+  }
+  for (const auto& e : idx.outputs()) {
+    last_use[idx.entry_id(e)] = kForever;
+  }
+  // whether no entry other than the ones of share lives in sid during [begin, end]
+  auto is_free = [&](int sid, uint32_t begin, uint32_t end, uint32_t share) {
+    for (uint32_t eid : storage_entries[sid]) {
+      if (eid == share || alias_entry[eid] == static_cast<int>(share)) continue;
+      if (producer[eid] <= end && last_use[eid] >= begin) return false;
+    }
+    return true;
+  };
+  // whether eid is a dense entry in the plan of the node's context, free to alias
+  auto can_alias = [&](uint32_t eid, uint32_t nid) {
+    return storage_id[eid] >= 0 && vstype[eid] == kDefaultStorage && vshape[eid].Size() > 0 &&
+           addto_entry[eid] == 0 && alias_entry[eid] < 0 && !is_target[eid] &&
+           vctx[producer[eid]] == vctx[nid] && !skip_plus_node[producer[eid]];
+  };
+  auto alias = [&](uint32_t eid, uint32_t target, size_t offset) {
+    auto& entries = storage_entries[storage_id[eid]];
+    entries.erase(std::find(entries.begin(), entries.end(), eid));
+    if (storage_id[target] >= 0) {
+      storage_entries[storage_id[target]].push_back(eid);
+      storage_id[eid] = storage_id[target];
+    }
+    alias_entry[eid] = target;
+    alias_offset[eid] = offset;
+    storage_inplace_index[eid] = -1;
+    is_target[target] = 1;
+  };
+
+  for (uint32_t nid = 0; enable && nid < idx.num_nodes(); ++nid) {
+    const auto& inode = idx[nid];
+    if (inode.source->op() == concat_op) {
+      // the producers write their outputs into the parts of the output
+      uint32_t out = idx.entry_id(nid, 0);
+      if (!can_alias(out, nid) || inode.inputs.empty() ||
+          !OuterAxis(vshape[out], IntParam(inode.source->attrs, "dim", 1))) continue;
+      // the inputs live in the output from their producers to their last readers
+      bool convert = true;
+      uint32_t first = nid, last = nid - 1;
+      for (const auto& e : inode.inputs) {
+        uint32_t eid = idx.entry_id(e);
+        convert = convert && !idx[e.node_id].source->is_variable() && can_alias(eid, nid) &&
+                  vdtype[eid] == vdtype[out] && last_use[eid] != kForever &&
+                  !inplace_source[eid];
+        first = std::min(first, e.node_id);
+        last = std::max(last, last_use[eid]);
+      }
+      if (!convert || !is_free(storage_id[out], first, last, out)) continue;
+      size_t offset = 0;
+      for (const auto& e : inode.inputs) {
+        uint32_t eid = idx.entry_id(e);
+        alias(eid, out, offset);
+        offset += vshape[eid].Size();
+      }
+      skip_plus_node[nid] = 1;
+    } else if (inode.source->op() == split_op) {
+      // the outputs are views of the input
+      const auto& in = inode.inputs[0];
+      uint32_t in_eid = idx.entry_id(in);
+      // an argument that no operator mutates, or an entry of the plan
+      const bool in_arg = idx[in.node_id].source->is_variable() &&
+                          idx.mutable_input_nodes().count(in.node_id) == 0;
+      if (!in_arg && (storage_id[in_eid] < 0 || addto_entry[in_eid] != 0)) continue;
+      if (alias_entry[in_eid] >= 0 || vstype[in_eid] != kDefaultStorage ||
+          vshape[in_eid].Size() == 0 || vctx[in.node_id] != vctx[nid] ||
+          !OuterAxis(vshape[in_eid], IntParam(inode.source->attrs, "axis", 1))) continue;
+      bool convert = true;
+      uint32_t end = nid;
+      for (uint32_t i = 0; i < inode.source->num_outputs(); ++i) {
+        // the outputs of the graph stay apart from the arguments
+        uint32_t eid = idx.entry_id(nid, i);
+        convert = convert && can_alias(eid, nid) && vdtype[eid] == vdtype[in_eid] &&
+                  last_use[eid] != kForever && !inplace_source[eid];
+        end = std::max(end, last_use[eid]);
+      }
+      if (!convert) continue;
+      if (storage_id[in_eid] >= 0 && !is_free(storage_id[in_eid], nid, end, in_eid)) continue;
+      size_t offset = 0;
+      for (uint32_t i = 0; i < inode.source->num_outputs(); ++i) {
+        uint32_t eid = idx.entry_id(nid, i);
+        alias(eid, in_eid, offset);
+        offset += vshape[eid].Size();
+      }
+      skip_plus_node[nid] = 1;
+    }
+  }
+
+  g.attrs["storage_id"] = std::make_shared<nnvm::any>(std::move(storage_id));
+  g.attrs["storage_inplace_index"] = std::make_shared<nnvm::any>(
+      std::move(storage_inplace_index));
+  g.attrs["skip_plus_node"] = std::make_shared<nnvm::any>(std::move(skip_plus_node));
+  g.attrs["alias_entry"] = std::make_shared<nnvm::any>(std::move(alias_entry));
+  g.attrs["alias_offset"] = std::make_shared<nnvm::any>(std::move(alias_offset));
+  return g;
+}
+
+}  // namespace exec
+}  // namespace mxnet
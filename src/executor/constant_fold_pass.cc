@@ -0,0 +1,87 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file constant_fold_pass.cc
+ * \brief Detect the nodes whose outputs do not change between runs.
+ */
+#include <mxnet/base.h>
+#include <mxnet/operator.h>
+#include <mxnet/op_attr_types.h>
+#include <nnvm/graph_attr_types.h>
+#include <vector>
+
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+Graph DetectConstantNodes(Graph g) {
+  static auto& fresource = Op::GetAttr<FResourceRequest>("FResourceRequest");
+  static auto& fmutate = Op::GetAttr<nnvm::FMutateInputs>("FMutateInputs");
+  const auto& idx = g.indexed_graph();
+  std::vector<int> constant_node(idx.num_nodes(), 0);
+  std::vector<int> constant_entry(idx.num_node_entries(), 0);
+  std::vector<bool> is_output(idx.num_node_entries(), false);
+  for (const auto& e : idx.outputs()) is_output[idx.entry_id(e)] = true;
+
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    const auto& inode = idx[nid];
+    if (inode.source->is_variable()) continue;
+    // the state of backward nodes is kept by their forward nodes
+    if (!inode.control_deps.empty()) continue;
+    const Op* op = inode.source->op();
+    if (fmutate.count(op)) continue;
+    bool deterministic = true;
+    if (fresource.count(op)) {
+      for (const auto& req : fresource[op](inode.source->attrs)) {
+        if (req.type == ResourceRequest::kRandom ||
+            req.type == ResourceRequest::kParallelRandom) deterministic = false;
+      }
+    }
+    if (!deterministic) continue;
+    bool constant = true;
+    for (const auto& e : inode.inputs) {
+      if (!constant_entry[idx.entry_id(e)]) constant = false;
+    }
+    // outputs of the executor are visible to the user, who may write them
+    for (uint32_t i = 0; i < inode.source->num_outputs(); ++i) {
+      if (is_output[idx.entry_id(nid, i)]) constant = false;
+    }
+    if (!constant) continue;
+    constant_node[nid] = 1;
+    for (uint32_t i = 0; i < inode.source->num_outputs(); ++i) {
+      constant_entry[idx.entry_id(nid, i)] = 1;
+    }
+  }
+  // the constants read by the other nodes are kept between runs
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    if (constant_node[nid]) continue;
+    for (const auto& e : idx[nid].inputs) {
+      uint32_t eid = idx.entry_id(e);
+      if (constant_entry[eid]) constant_entry[eid] = 2;
+    }
+  }
+  g.attrs["constant_node"] = std::make_shared<nnvm::any>(std::move(constant_node));
+  g.attrs["constant_entry"] = std::make_shared<nnvm::any>(std::move(constant_entry));
+  return g;
+}
+
+}  // namespace exec
+}  // namespace mxnet
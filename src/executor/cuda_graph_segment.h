@@ -0,0 +1,160 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file cuda_graph_segment.h
+ * \brief Capture the kernels of a GPU bulk segment into a CUDA graph
+ *  and replay it with a single launch.
+ */
+#ifndef MXNET_EXECUTOR_CUDA_GRAPH_SEGMENT_H_
+#define MXNET_EXECUTOR_CUDA_GRAPH_SEGMENT_H_
+
+#include <mxnet/base.h>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "./exec_pass.h"
+#include "../common/cuda_utils.h"
+
+#if MXNET_USE_CUDA && CUDA_VERSION >= 10000
+namespace mxnet {
+namespace exec {
+
+/*!
+ * \brief Runs a bulk segment through CUDA graphs.
+ *
+ *  The first run of the segment is executed normally, so that memory is
+ *  allocated and algorithms are selected outside of a capture. The second
+ *  run is captured into a CUDA graph, which is replayed by all later runs.
+ *  Training and inference runs are captured separately, since operators may
+ *  launch different kernels for them.
+ *
+ *  A graph replays the pointers seen during capture. The graph is captured
+ *  again when a temporary space of the segment has been reallocated.
+ */
+class CudaGraphSegment {
+ public:
+  /*!
+   * \brief whether the segment can be replayed from a graph.
+   *  Random number generators keep their state on the host, so replaying
+   *  them would produce the same numbers again.
+   */
+  static bool Supported(const std::vector<std::shared_ptr<OpExecutor> >& exec_list) {
+    for (const auto& exec : exec_list) {
+      for (const auto& r : exec->op_ctx.requested) {
+        if (r.req.type != ResourceRequest::kTempSpace) return false;
+      }
+      // sparse arrays are allocated when they are written
+      for (const auto& nd : exec->out_array) {
+        if (nd.is_sparse()) return false;
+      }
+      for (const auto& nd : exec->in_array) {
+        if (nd.is_sparse()) return false;
+      }
+    }
+    return true;
+  }
+  /*!
+   * \param exec_list executors of the segment, they provide the resources
+   *  and the training flag of the segment.
+   * \param run function launching the kernels of the segment.
+   */
+  CudaGraphSegment(const std::vector<std::shared_ptr<OpExecutor> >& exec_list,
+                   std::function<void(RunContext)> run)
+      : run_(run) {
+    CHECK(!exec_list.empty());
+    ref_ = exec_list[0];
+    for (const auto& exec : exec_list) {
+      for (const auto& r : exec->op_ctx.requested) temp_space_.push_back(r);
+    }
+  }
+
+  ~CudaGraphSegment() {
+    for (auto& graph : graphs_) {
+      // Catch exception for CUDA driver shutdown
+      if (graph.exec != nullptr) MSHADOW_CATCH_ERROR(CUDA_CALL(cudaGraphExecDestroy(graph.exec)));
+    }
+  }
+  /*!
+   * \brief run the segment, the work is complete when the stream of
+   *  rctx is synchronized.
+   */
+  void Run(RunContext rctx) {
+    Graph& graph = graphs_[ref_->op_ctx.is_train ? 1 : 0];
+    cudaStream_t stream = mshadow::Stream<gpu>::GetStream(rctx.get_stream<gpu>());
+    if (graph.exec != nullptr && graph.space != TempSpace()) {
+      CUDA_CALL(cudaGraphExecDestroy(graph.exec));
+      graph.exec = nullptr;
+    }
+    if (graph.exec == nullptr) {
+      if (graph.num_runs++ < kWarmupRuns) {
+        run_(rctx);
+        return;
+      }
+      Capture(rctx, stream, &graph);
+    }
+    CUDA_CALL(cudaGraphLaunch(graph.exec, stream));
+  }
+
+ private:
+  /*! \brief number of runs executed normally before the capture */
+  static constexpr int kWarmupRuns = 1;
+  struct Graph {
+    cudaGraphExec_t exec{nullptr};
+    int num_runs{0};
+    /*! \brief temporary space pointers during the capture */
+    std::vector<void*> space;
+  };
+  std::vector<void*> TempSpace() const {
+    std::vector<void*> ret;
+    for (const auto& r : temp_space_) {
+      ret.push_back(r.get_space_typed<gpu, 1, char>(mshadow::Shape1(0), nullptr).dptr_);
+    }
+    return ret;
+  }
+  void Capture(RunContext rctx, cudaStream_t stream, Graph* graph) {
+    cudaGraph_t captured;
+    CUDA_CALL(cudaStreamBeginCapture(stream, cudaStreamCaptureModeThreadLocal));
+    try {
+      run_(rctx);
+    } catch (const dmlc::Error&) {
+      // leave the stream usable before reporting the failure
+      if (cudaStreamEndCapture(stream, &captured) == cudaSuccess) {
+        cudaGraphDestroy(captured);
+      }
+      throw;
+    }
+    CUDA_CALL(cudaStreamEndCapture(stream, &captured));
+    CUDA_CALL(cudaGraphInstantiate(&graph->exec, captured, nullptr, nullptr, 0));
+    CUDA_CALL(cudaGraphDestroy(captured));
+    graph->space = TempSpace();
+  }
+
+  std::function<void(RunContext)> run_;
+  /*! \brief executor whose context holds the training flag */
+  std::shared_ptr<OpExecutor> ref_;
+  std::vector<Resource> temp_space_;
+  /*! \brief graphs for inference and training */
+  Graph graphs_[2];
+};
+
+}  // namespace exec
+}  // namespace mxnet
+#endif  // MXNET_USE_CUDA && CUDA_VERSION >= 10000
+#endif  // MXNET_EXECUTOR_CUDA_GRAPH_SEGMENT_H_
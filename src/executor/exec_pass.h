@@ -28,6 +28,11 @@
 #include <mxnet/ndarray.h>
 #include <mxnet/operator.h>
 #include <nnvm/graph.h>
+#include <nnvm/symbolic.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <memory>
 
@@ -105,9 +110,24 @@ Graph AttachOpExecs(Graph g);
  */
 Graph AttachOpResources(Graph g);
 
+/*!
+ * \brief Infer the storage type of every entry of the graph, in topological
+ *  order with the FInferStorageType of the operators. The outputs of the
+ *  operators without it are dense.
+ *
+ * \param g input graph need to contain the context attribute.
+ * \param stypes the storage type of each entry, kUndefinedStorage for the
+ *  entries to infer. The others, of the arrays bound to the executor, are kept.
+ *
+ * \return graph with new attribute "storage_type",
+ *  std::vector<int> size=g.num_node_entries()
+ */
+Graph InferStorageType(Graph g, std::vector<int> stypes);
+
 /*!
  * \brief Discover chance of inplace addto operators.
  *  i.e. z = plus(z, source_op), and encourage it to become z += source_op.
+ *  With MXNET_EXEC_ENABLE_ADDTO, likewise for ElementWiseSum(z, a, b, ...).
  *
  * This optimization is coupled with executor. This is helpful to reduce memory
  * and computation for gradient aggregation of RNN.
@@ -123,6 +143,158 @@ Graph AttachOpResources(Graph g);
  */
 Graph DetectInplaceAddTo(Graph g);
 
+/*!
+ * \brief Let the producers of the inputs of a Concat write them into the
+ *  parts of its output, and the outputs of a SliceChannel be views of its
+ *  input, when the parts are contiguous, as for the first axis, and the
+ *  memory of the output, or of the input, is not used by other entries
+ *  meanwhile. The Concat or SliceChannel is then skipped.
+ *
+ * Require storage placement and DetectInplaceAddTo to be already finished.
+ *
+ * \param g input graph.
+ *
+ * \return graph with two new attributes, changes attributes "storage_id",
+ *  "storage_inplace_index" and "skip_plus_node".
+ *  - "alias_entry", std::vector<int> size=g.num_node_entries()
+ *    - alias_entry[eid] >= 0, the entry is a view of the entry alias_entry[eid]
+ *  - "alias_offset", std::vector<size_t> size=g.num_node_entries()
+ *    - the offset of the view in elements
+ */
+Graph DetectConcatAlias(Graph g);
+
+/*!
+ * \brief Insert Cast nodes to run selected operators in float16.
+ *  The inputs of the target operators are cast to float16. The other
+ *  operators whose inputs are all in float16 stay in float16, unless they
+ *  are float32 operators, and their float16 inputs are cast back otherwise.
+ *  The outputs of the symbol are cast back to float32. The gradients of the
+ *  Casts bring the gradients of the float32 arguments back to float32.
+ *
+ * \param src the float32 symbol, which is left unchanged.
+ * \param target_ops the operators run in float16.
+ * \param fp32_ops the operators always run in float32.
+ * \return a copy of the symbol with the Cast nodes.
+ */
+nnvm::Symbol ReducePrecision(const nnvm::Symbol& src,
+                             const std::unordered_set<std::string>& target_ops,
+                             const std::unordered_set<std::string>& fp32_ops);
+
+/*!
+ * \brief Run the 2D convolutions of a NCHW symbol in NHWC, which cuDNN runs
+ *  faster on Tensor Cores. The data and the weights of the convolutions are
+ *  transposed to NHWC. The layout then propagates through elementwise
+ *  operators, pooling and batch normalization, and the entries read by the
+ *  other operators and the outputs of the symbol are transposed back, so the
+ *  transposes only sit at the boundaries of the NHWC regions.
+ *
+ * \param src the NCHW symbol, which is left unchanged.
+ * \return a copy of the symbol with the NHWC operators and the transposes.
+ */
+nnvm::Symbol ConvertToNHWC(const nnvm::Symbol& src);
+
+/*!
+ * \brief Fold each Pad that pads the spatial axes of the data of a
+ *  Convolution with zeros, by the same width on both sides, into the pad of
+ *  the Convolution, which then reads the input of the Pad.
+ *
+ * \param src the symbol, which is left unchanged.
+ * \return a copy of the symbol with the folded paddings.
+ */
+nnvm::Symbol FoldPadIntoConvolution(const nnvm::Symbol& src);
+
+/*!
+ * \brief Fuse each relu Activation that reads a BatchNorm, directly or
+ *  through an elemwise_add, into the BatchNorm, which then adds the other
+ *  input of the add and applies the relu in its own passes over the data.
+ *  The BatchNorm and the add must have no other reader. A fusion that would
+ *  change the order of the arguments or of the auxiliary states is skipped.
+ *
+ * \param src the symbol, which is left unchanged.
+ * \return a copy of the symbol with the fused batch normalizations.
+ */
+nnvm::Symbol FuseBatchNormReLU(const nnvm::Symbol& src);
+
+/*!
+ * \brief Detect the nodes computed from constants only.
+ *  A node is constant when all its inputs are constant, including nodes
+ *  without inputs such as _zeros or _arange, and when it neither mutates
+ *  its inputs nor draws random numbers. Nodes producing an output of the
+ *  graph are not constant.
+ *
+ * \param g input graph.
+ *
+ * \return graph with two new attributes.
+ *  - "constant_node", std::vector<int> size=g.num_nodes()
+ *    - constant_node[nid] == 1, the node only has to be run once.
+ *  - "constant_entry", std::vector<int> size=g.num_node_entries()
+ *    - constant_entry[eid] == 1, the entry is constant.
+ *    - constant_entry[eid] == 2, the entry is constant and read by a node that
+ *      is not, so it has to be kept between runs.
+ */
+Graph DetectConstantNodes(Graph g);
+
+/*!
+ * \brief Plan the forward nodes recomputed in the backward pass.
+ *  The candidates are split into segments in topological order and only the
+ *  last node of each segment keeps its outputs for the backward pass. The
+ *  segment size is chosen so that the estimated forward activations, the kept
+ *  outputs plus the largest recomputed segment, fit into the budget with the
+ *  least recomputation.
+ *
+ * \param symbol the forward symbol.
+ * \param arg_shapes shapes of the inputs of the symbol.
+ * \param budget_mb memory budget of the forward activations in MB, a
+ *  negative budget asks for the least memory.
+ * \param can_mirror whether a node may be recomputed.
+ * \return the nodes to recompute, empty when the shapes are unknown.
+ */
+std::unordered_set<const nnvm::Node*> PlanMirror(
+    const nnvm::Symbol& symbol,
+    const std::unordered_map<std::string, TShape>& arg_shapes,
+    double budget_mb,
+    const std::function<bool(const nnvm::Node&)>& can_mirror);
+
+/*!
+ * \brief Offload forward activations to pinned host memory.
+ *  A GPU entry used by both the forward and the backward pass is copied to
+ *  the host next to its last forward use and copied back for the backward
+ *  pass. The copy back has a control dependency on a backward node a few
+ *  nodes before the first backward use, and starts only when that node is
+ *  done, so the transfers overlap the computation.
+ *
+ * \param g the graph with gradients, which needs to contain the context attribute.
+ * \param arg_shapes shapes of the inputs of the graph.
+ * \param num_forward_outputs number of the forward outputs of the graph.
+ * \param min_bytes the smallest activation to offload.
+ * \param prefetch_distance number of backward nodes between the start of
+ *  a copy back and the first use of its result, at least 1.
+ * \return the graph with the copies, with new context and device attributes.
+ */
+Graph OffloadActivations(Graph g,
+                         const std::unordered_map<std::string, TShape>& arg_shapes,
+                         size_t num_forward_outputs,
+                         size_t min_bytes,
+                         size_t prefetch_distance);
+
+/*!
+ * \brief Fuse chains of elementwise operators in a bulk segment.
+ *  Consecutive CPU FCompute operators marked with TIsElemwise whose arrays
+ *  share one shape and type are replaced by one executor, which runs the
+ *  whole chain over one cache-sized chunk of the arrays at a time. Inputs of
+ *  a single element, as the condition of where, are broadcast.
+ *  On GPU, when built with NVRTC, chains of float32 operators with a known
+ *  CUDA expression are compiled into one kernel instead.
+ *
+ * \param nodes the graph nodes of the executors.
+ * \param execs the executors of the segment, in execution order.
+ * \param ctx the context of the segment.
+ * \return the executors to run instead of execs.
+ */
+OpExecVector FuseElemwiseOps(const std::vector<const nnvm::Node*>& nodes,
+                             const OpExecVector& execs,
+                             const Context& ctx);
+
 }  // namespace exec
 }  // namespace mxnet
 
@@ -0,0 +1,153 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file executor_group.cc
+ * \brief executors of a symbol on several devices
+ */
+#include <algorithm>
+#include <map>
+#include <unordered_set>
+#include "./executor_group.h"
+
+namespace mxnet {
+namespace exec {
+
+ExecutorGroup::ExecutorGroup(const nnvm::Symbol& symbol,
+                             const std::vector<Context>& contexts,
+                             const std::vector<std::pair<std::string, TShape> >& data_shapes) {
+  CHECK(!contexts.empty()) << "ExecutorGroup: no context given";
+  CHECK(!data_shapes.empty()) << "ExecutorGroup: no data given";
+  arg_names_ = symbol.ListInputNames(nnvm::Symbol::kReadOnlyArgs);
+  aux_names_ = symbol.ListInputNames(nnvm::Symbol::kAuxiliaryStates);
+  batch_size_ = data_shapes[0].second[0];
+  for (const auto& s : data_shapes) {
+    auto it = std::find(arg_names_.begin(), arg_names_.end(), s.first);
+    CHECK(it != arg_names_.end()) << "ExecutorGroup: " << s.first << " is not an argument";
+    CHECK_EQ(s.second[0], batch_size_) << "ExecutorGroup: the data must have the same batch size";
+    data_index_.push_back(it - arg_names_.begin());
+  }
+  std::vector<OpReqType> grad_reqs(arg_names_.size(), kWriteTo);
+  for (size_t i : data_index_) grad_reqs[i] = kNullOp;
+  for (size_t i = 0; i < arg_names_.size(); ++i) {
+    if (grad_reqs[i] == kNullOp) continue;
+    param_index_.push_back(i);
+    param_names_.push_back(arg_names_[i]);
+  }
+
+  const index_t num_devices = contexts.size();
+  CHECK_GE(batch_size_, num_devices) << "ExecutorGroup: the batch is smaller than the devices";
+  index_t begin = 0;
+  for (index_t i = 0; i < num_devices; ++i) {
+    index_t end = begin + batch_size_ / num_devices + (i < batch_size_ % num_devices);
+    slices_.emplace_back(begin, end);
+    begin = end;
+  }
+
+  in_args_.resize(num_devices);
+  arg_grads_.resize(num_devices);
+  aux_states_.resize(num_devices);
+  for (index_t i = 0; i < num_devices; ++i) {
+    const Context& ctx = contexts[i];
+    std::unordered_map<std::string, TShape> arg_shapes;
+    for (const auto& s : data_shapes) {
+      TShape shape = s.second;
+      shape[0] = slices_[i].second - slices_[i].first;
+      arg_shapes[s.first] = shape;
+    }
+    execs_.emplace_back(Executor::SimpleBind(
+        symbol, ctx, std::map<std::string, Context>(),
+        std::vector<Context>(arg_names_.size(), ctx),
+        std::vector<Context>(arg_names_.size(), ctx),
+        std::vector<Context>(aux_names_.size(), ctx),
+        arg_shapes, std::unordered_map<std::string, int>(), grad_reqs,
+        std::unordered_set<std::string>(),
+        &in_args_[i], &arg_grads_[i], &aux_states_[i]));
+  }
+}
+
+void ExecutorGroup::SetParams(const std::unordered_map<std::string, NDArray>& params) {
+  for (const auto& kv : params) {
+    auto arg = std::find(arg_names_.begin(), arg_names_.end(), kv.first);
+    auto aux = std::find(aux_names_.begin(), aux_names_.end(), kv.first);
+    CHECK(arg != arg_names_.end() || aux != aux_names_.end())
+        << "ExecutorGroup: " << kv.first << " is not a parameter";
+    for (size_t i = 0; i < execs_.size(); ++i) {
+      NDArray* dst = arg != arg_names_.end() ? &in_args_[i][arg - arg_names_.begin()] :
+                                               &aux_states_[i][aux - aux_names_.begin()];
+      CopyFromTo(kv.second, dst);
+    }
+  }
+}
+
+void ExecutorGroup::Forward(const std::vector<NDArray>& data, bool is_train) {
+  CHECK_EQ(data.size(), data_index_.size()) << "ExecutorGroup: wrong number of data";
+  for (size_t j = 0; j < data.size(); ++j) {
+    CHECK_EQ(data[j].shape()[0], batch_size_) << "ExecutorGroup: wrong batch size";
+  }
+  for (size_t i = 0; i < execs_.size(); ++i) {
+    for (size_t j = 0; j < data.size(); ++j) {
+      CopyFromTo(data[j].Slice(slices_[i].first, slices_[i].second),
+                 &in_args_[i][data_index_[j]]);
+    }
+    execs_[i]->Forward(is_train);
+  }
+}
+
+void ExecutorGroup::Backward() {
+  for (const auto& exec : execs_) {
+    exec->Backward(std::vector<NDArray>());
+  }
+}
+
+void ExecutorGroup::InitKVStore(KVStore* kv) {
+  std::vector<int> keys;
+  std::vector<NDArray> values;
+  for (size_t k = 0; k < param_index_.size(); ++k) {
+    keys.push_back(static_cast<int>(k));
+    values.push_back(in_args_[0][param_index_[k]]);
+  }
+  kv->Init(keys, values);
+  for (size_t k = 0; k < param_index_.size(); ++k) {
+    std::vector<NDArray*> weights;
+    for (size_t i = 0; i < execs_.size(); ++i) {
+      weights.push_back(&in_args_[i][param_index_[k]]);
+    }
+    kv->Pull(std::vector<int>(weights.size(), static_cast<int>(k)), weights,
+             -static_cast<int>(k));
+  }
+}
+
+void ExecutorGroup::Update(KVStore* kv) {
+  for (size_t r = param_index_.size(); r > 0; --r) {
+    const int k = static_cast<int>(r - 1);
+    std::vector<NDArray> grads;
+    std::vector<NDArray*> weights;
+    for (size_t i = 0; i < execs_.size(); ++i) {
+      grads.push_back(arg_grads_[i][param_index_[k]]);
+      weights.push_back(&in_args_[i][param_index_[k]]);
+    }
+    const std::vector<int> keys(execs_.size(), k);
+    kv->Push(keys, grads, -k);
+    kv->Pull(keys, weights, -k);
+  }
+}
+
+}  // namespace exec
+}  // namespace mxnet
@@ -0,0 +1,109 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file executor_group.h
+ * \brief executors of a symbol on several devices, training data parallel
+ */
+#ifndef MXNET_EXECUTOR_EXECUTOR_GROUP_H_
+#define MXNET_EXECUTOR_EXECUTOR_GROUP_H_
+
+#include <mxnet/base.h>
+#include <mxnet/executor.h>
+#include <mxnet/kvstore.h>
+#include <mxnet/ndarray.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace exec {
+
+/*!
+ * \brief one executor of a symbol per context, each taking a slice of the
+ *  batch along the first axis. Every call is issued for all the devices at
+ *  once and returns when it is pushed to the engine, so the devices and the
+ *  kvstore run overlapped, as the executor group of the Python module does.
+ */
+class ExecutorGroup {
+ public:
+  /*!
+   * \brief bind the executors.
+   * \param symbol the symbol, whose outputs should be losses.
+   * \param contexts the devices.
+   * \param data_shapes the shapes of the whole batch of the arguments that
+   *  are split over the devices, such as the data and the labels; the other
+   *  arguments are the parameters, whose gradients are computed.
+   */
+  ExecutorGroup(const nnvm::Symbol& symbol,
+                const std::vector<Context>& contexts,
+                const std::vector<std::pair<std::string, TShape> >& data_shapes);
+  /*!
+   * \brief copy parameters or auxiliary states to all the devices.
+   * \param params the arrays by name.
+   */
+  void SetParams(const std::unordered_map<std::string, NDArray>& params);
+  /*!
+   * \brief copy the slices of a batch to the devices and run the forward pass.
+   * \param data the batch of each argument of data_shapes, in the same order.
+   * \param is_train whether the forward pass is for training.
+   */
+  void Forward(const std::vector<NDArray>& data, bool is_train);
+  /*! \brief run the backward pass on all the devices */
+  void Backward();
+  /*!
+   * \brief initialize the parameters in kv with the ones of the first device,
+   *  and pull them to all the devices; the key of a parameter is its index
+   *  among the parameters.
+   */
+  void InitKVStore(KVStore* kv);
+  /*!
+   * \brief push the gradients of all the devices to kv and pull the updated
+   *  parameters, the last parameters first as backward computes them first;
+   *  kv should update the parameters with its updater.
+   */
+  void Update(KVStore* kv);
+  /*! \return the executors, one per device */
+  const std::vector<std::unique_ptr<Executor> >& executors() const {
+    return execs_;
+  }
+  /*! \return the names of the parameters */
+  const std::vector<std::string>& param_names() const {
+    return param_names_;
+  }
+
+ private:
+  /*! \brief the names of the arguments and of the auxiliary states */
+  std::vector<std::string> arg_names_, aux_names_, param_names_;
+  /*! \brief the argument index of each data and of each parameter */
+  std::vector<size_t> data_index_, param_index_;
+  /*! \brief the rows of the batch of each device */
+  std::vector<std::pair<index_t, index_t> > slices_;
+  /*! \brief the size of the whole batch */
+  index_t batch_size_;
+  std::vector<std::unique_ptr<Executor> > execs_;
+  /*! \brief the arrays of each device */
+  std::vector<std::vector<NDArray> > in_args_, arg_grads_, aux_states_;
+};
+
+}  // namespace exec
+}  // namespace mxnet
+#endif  // MXNET_EXECUTOR_EXECUTOR_GROUP_H_
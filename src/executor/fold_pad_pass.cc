@@ -0,0 +1,118 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file fold_pad_pass.cc
+ * \brief Fold the zero padding of a Pad into the Convolution that reads it.
+ */
+#include <mxnet/base.h>
+#include <dmlc/registry.h>
+#include <nnvm/graph.h>
+#include <nnvm/op.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+namespace {
+TShape ShapeAttr(const nnvm::NodeAttrs& attrs, const std::string& key) {
+  TShape shape;
+  auto it = attrs.dict.find(key);
+  if (it != attrs.dict.end()) {
+    std::istringstream is(it->second);
+    is >> shape;
+  }
+  return shape;
+}
+
+/*! \brief whether the layout of the convolution has the channels right after the batch */
+bool ChannelFirst(const nnvm::NodeAttrs& attrs) {
+  auto it = attrs.dict.find("layout");
+  return it == attrs.dict.end() || it->second == "None" || it->second.compare(0, 2, "NC") == 0;
+}
+
+/*!
+ * \brief the paddings of the spatial axes of a Pad that only pads them with zeros,
+ *  by the same width before and after, or an empty shape.
+ */
+TShape ZeroPadding(const nnvm::NodeAttrs& attrs) {
+  auto mode = attrs.dict.find("mode");
+  auto value = attrs.dict.find("constant_value");
+  if (mode == attrs.dict.end() || mode->second != "constant" ||
+      (value != attrs.dict.end() && std::stod(value->second) != 0)) {
+    return TShape();
+  }
+  const TShape width = ShapeAttr(attrs, "pad_width");
+  if (width.ndim() < 6 || width.ndim() % 2 != 0 ||
+      width[0] != 0 || width[1] != 0 || width[2] != 0 || width[3] != 0) {
+    return TShape();
+  }
+  TShape pad(width.ndim() / 2 - 2);
+  for (uint32_t i = 0; i < pad.ndim(); ++i) {
+    if (width[4 + 2 * i] != width[5 + 2 * i]) return TShape();
+    pad[i] = width[4 + 2 * i];
+  }
+  return pad;
+}
+}  // namespace
+
+nnvm::Symbol FoldPadIntoConvolution(const nnvm::Symbol& src) {
+  using nnvm::Node;
+  using nnvm::NodePtr;
+  // the builds with some of the operators, as the amalgamation, may lack them
+  static const nnvm::Op* conv_op = dmlc::Registry<nnvm::Op>::Find("Convolution");
+  static const nnvm::Op* pad_op = dmlc::Registry<nnvm::Op>::Find("Pad");
+  if (conv_op == nullptr || pad_op == nullptr) return src;
+  // the nodes of the copy can be modified without changing the symbol of the user
+  nnvm::Symbol sym = src.Copy();
+  nnvm::DFSVisit(sym.outputs, [&](const NodePtr& node) {
+    if (node->is_variable() || node->op() != conv_op || node->inputs.empty()) return;
+    const Node* pad = node->inputs[0].node.get();
+    if (pad->is_variable() || pad->op() != pad_op || !pad->control_deps.empty() ||
+        !ChannelFirst(node->attrs)) return;
+    const TShape padding = ZeroPadding(pad->attrs);
+    const TShape kernel = ShapeAttr(node->attrs, "kernel");
+    if (padding.ndim() == 0 || padding.ndim() != kernel.ndim()) return;
+    // an empty pad of the convolution is all zeros
+    TShape conv_pad = ShapeAttr(node->attrs, "pad");
+    if (conv_pad.ndim() == 0) {
+      conv_pad = padding;
+    } else if (conv_pad.ndim() == padding.ndim()) {
+      for (uint32_t i = 0; i < conv_pad.ndim(); ++i) conv_pad[i] += padding[i];
+    } else {
+      return;
+    }
+    std::ostringstream os;
+    os << conv_pad;
+    node->attrs.dict["pad"] = os.str();
+    conv_op->attr_parser(&(node->attrs));
+    // the convolution reads the input of the Pad, which is left to its other readers;
+    // the entry is copied first since the Pad may go with the last reference to it
+    const nnvm::NodeEntry data = pad->inputs[0];
+    node->inputs[0] = data;
+  });
+  return sym;
+}
+
+}  // namespace exec
+}  // namespace mxnet
@@ -0,0 +1,127 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file fuse_bn_relu_pass.cc
+ * \brief Fuse the relu, and the add before it, into the batch normalization.
+ */
+#include <mxnet/base.h>
+#include <dmlc/registry.h>
+#include <nnvm/graph.h>
+#include <nnvm/op.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+namespace {
+bool IsTrue(const nnvm::NodeAttrs& attrs, const std::string& key) {
+  auto it = attrs.dict.find(key);
+  return it != attrs.dict.end() && (it->second == "True" || it->second == "true" ||
+                                    it->second == "1");
+}
+
+bool HasDefault(const nnvm::NodeAttrs& attrs, const std::string& key,
+                const std::string& value) {
+  auto it = attrs.dict.find(key);
+  return it == attrs.dict.end() || it->second == value;
+}
+}  // namespace
+
+nnvm::Symbol FuseBatchNormReLU(const nnvm::Symbol& src) {
+  using nnvm::Node;
+  using nnvm::NodeEntry;
+  using nnvm::NodePtr;
+  // the builds with some of the operators, as the amalgamation, may lack them
+  static const nnvm::Op* bn_op = dmlc::Registry<nnvm::Op>::Find("BatchNorm");
+  static const nnvm::Op* act_op = dmlc::Registry<nnvm::Op>::Find("Activation");
+  static const nnvm::Op* relu_op = dmlc::Registry<nnvm::Op>::Find("relu");
+  static const nnvm::Op* add_op = dmlc::Registry<nnvm::Op>::Find("elemwise_add");
+  if (bn_op == nullptr) return src;
+  // the nodes of the copy can be modified without changing the symbol of the user
+  nnvm::Symbol sym = src.Copy();
+  const std::vector<std::string> inputs = src.ListInputNames(nnvm::Symbol::kAll);
+  // the number of reads of each entry, the outputs of the symbol included
+  std::map<std::pair<const Node*, uint32_t>, int> uses;
+  std::vector<NodePtr> relus;
+  nnvm::DFSVisit(sym.outputs, [&](const NodePtr& node) {
+    for (const auto& e : node->inputs) ++uses[std::make_pair(e.node.get(), e.index)];
+    if (node->is_variable()) return;
+    if (node->op() == relu_op ||
+        (node->op() == act_op && node->attrs.dict.count("act_type") &&
+         node->attrs.dict.at("act_type") == "relu")) {
+      relus.push_back(node);
+    }
+  });
+  for (const auto& e : sym.outputs) ++uses[std::make_pair(e.node.get(), e.index)];
+  auto read_once = [&uses](const NodeEntry& e) {
+    return uses[std::make_pair(e.node.get(), e.index)] == 1;
+  };
+  // a batch normalization whose output is only read by the add or the relu
+  auto fusible = [&read_once](const NodeEntry& e) {
+    const Node* n = e.node.get();
+    return !n->is_variable() && n->op() == bn_op && e.index == 0 && read_once(e) &&
+           n->control_deps.empty() && !IsTrue(n->attrs, "output_mean_var") &&
+           HasDefault(n->attrs, "act_type", "none") && !IsTrue(n->attrs, "fuse_add");
+  };
+  for (const NodePtr& relu : relus) {
+    // the batch normalizations that can be fused, with the addend
+    std::vector<std::pair<NodePtr, const NodeEntry*> > candidates;
+    const NodeEntry& in = relu->inputs[0];
+    if (fusible(in)) {
+      candidates.emplace_back(in.node, nullptr);
+    } else if (!in.node->is_variable() && in.node->op() == add_op && read_once(in) &&
+               in.node->control_deps.empty()) {
+      for (size_t i = 0; i < 2; ++i) {
+        if (fusible(in.node->inputs[i])) {
+          candidates.emplace_back(in.node->inputs[i].node, &in.node->inputs[1 - i]);
+        }
+      }
+    }
+    // the relu node becomes the fused batch normalization, so that its readers
+    // are unchanged; the batch normalization and the add are left unread
+    const nnvm::NodeAttrs relu_attrs = relu->attrs;
+    const std::vector<NodeEntry> relu_inputs = relu->inputs;
+    for (const auto& c : candidates) {
+      relu->attrs = c.first->attrs;
+      relu->attrs.name = relu_attrs.name;
+      relu->attrs.dict["act_type"] = "relu";
+      relu->inputs = c.first->inputs;
+      if (c.second != nullptr) {
+        relu->attrs.dict["fuse_add"] = "True";
+        relu->inputs.insert(relu->inputs.begin() + 3, *c.second);
+      }
+      bn_op->attr_parser(&(relu->attrs));
+      // the arguments and the auxiliary states are bound in the order of the
+      // symbol, which the addend may change
+      if (sym.ListInputNames(nnvm::Symbol::kAll) == inputs) break;
+      relu->attrs = relu_attrs;
+      relu->inputs = relu_inputs;
+    }
+  }
+  return sym;
+}
+
+}  // namespace exec
+}  // namespace mxnet
@@ -0,0 +1,442 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file fuse_elemwise_pass.cc
+ * \brief Fuse chains of elementwise operators of a bulk segment.
+ *  On CPU a chain runs as one loop over cache-sized chunks of the data,
+ *  on GPU it is compiled into one kernel with NVRTC.
+ */
+#include <mxnet/base.h>
+#include <mxnet/operator.h>
+#include <mxnet/op_attr_types.h>
+#include <mxnet/mxrtc.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../common/utils.h"
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+// executor running a chain of elementwise FCompute operators chunk by chunk
+class FusedElemwiseExecutor : public OpExecutor {
+ public:
+  // a member operator of the chain
+  struct Member {
+    NodeAttrs attrs;
+    FCompute fcompute;
+    std::shared_ptr<OpExecutor> exec;
+  };
+
+  void Run(RunContext rctx) override {
+    // blobs of all members, in the order of members
+    std::vector<std::vector<TBlob> > in_data(members_.size());
+    std::vector<std::vector<TBlob> > out_data(members_.size());
+    for (size_t m = 0; m < members_.size(); ++m) {
+      const auto& exec = members_[m].exec;
+      for (const auto& nd : exec->in_array) in_data[m].push_back(nd.data());
+      for (const auto& nd : exec->out_array) out_data[m].push_back(nd.data());
+    }
+    if (!SafeToChunk(in_data, out_data)) {
+      for (const auto& member : members_) member.exec->Run(rctx);
+      return;
+    }
+    const TBlob& ref = out_data[0][0];
+    const size_t size = ref.Size();
+    const size_t type_size = mshadow::mshadow_sizeof(ref.type_flag_);
+    const size_t chunk = std::max(kChunkBytes / type_size, static_cast<size_t>(1));
+    const int num_chunks = static_cast<int>((size + chunk - 1) / chunk);
+    // the operators are not parallelized inside a fused loop, since the
+    // nested OpenMP region of their kernels runs on a single thread
+    #pragma omp parallel for schedule(static)
+    for (int c = 0; c < num_chunks; ++c) {
+      const size_t begin = c * chunk;
+      const TShape shape = mshadow::Shape1(std::min(chunk, size - begin));
+      std::vector<TBlob> inputs, outputs;
+      for (size_t m = 0; m < members_.size(); ++m) {
+        const Member& member = members_[m];
+        inputs.clear();
+        outputs.clear();
+        // a scalar input, as the condition of where, is broadcast by the member
+        for (const auto& blob : in_data[m]) {
+          inputs.push_back(blob.Size() == size ? Slice(blob, begin, shape) : blob);
+        }
+        for (const auto& blob : out_data[m]) outputs.push_back(Slice(blob, begin, shape));
+        OpContext op_ctx = member.exec->op_ctx;
+        op_ctx.run_ctx = rctx;
+        member.fcompute(member.attrs, op_ctx, inputs, member.exec->req, outputs);
+      }
+    }
+  }
+
+  // the members are setup on their own by the graph executor
+  void Setup() override {}
+
+  ExecType exec_type() const override {
+    return ExecType::kSync;
+  }
+
+  explicit FusedElemwiseExecutor(std::vector<Member> members)
+      : members_(std::move(members)) {
+    // expose the arrays of the members to the users of the executor
+    for (const auto& member : members_) {
+      in_array.insert(in_array.end(), member.exec->in_array.begin(),
+                      member.exec->in_array.end());
+      out_array.insert(out_array.end(), member.exec->out_array.begin(),
+                       member.exec->out_array.end());
+    }
+  }
+
+ private:
+  /*! \brief size of a chunk of each array, fits several arrays in L2 cache */
+  static constexpr size_t kChunkBytes = 32 << 10;
+  // slice a flat chunk of the blob
+  static TBlob Slice(const TBlob& blob, size_t begin, const TShape& shape) {
+    char* dptr = static_cast<char*>(blob.dptr_) +
+        begin * mshadow::mshadow_sizeof(blob.type_flag_);
+    return TBlob(dptr, shape, blob.dev_mask(), blob.type_flag_);
+  }
+  // Chunking is only equivalent to running the operators one by one
+  // if arrays that are written either alias others exactly or not at all.
+  static bool SafeToChunk(const std::vector<std::vector<TBlob> >& in_data,
+                          const std::vector<std::vector<TBlob> >& out_data) {
+    std::vector<std::pair<const char*, const char*> > reads, writes;
+    auto range = [](const TBlob& blob) {
+      const char* begin = static_cast<const char*>(blob.dptr_);
+      return std::make_pair(begin,
+          begin + blob.Size() * mshadow::mshadow_sizeof(blob.type_flag_));
+    };
+    for (const auto& blobs : in_data) {
+      for (const auto& blob : blobs) reads.push_back(range(blob));
+    }
+    for (const auto& blobs : out_data) {
+      for (const auto& blob : blobs) writes.push_back(range(blob));
+    }
+    auto conflict = [](const std::pair<const char*, const char*>& a,
+                       const std::pair<const char*, const char*>& b) {
+      return a.first != b.first && a.first < b.second && b.first < a.second;
+    };
+    for (size_t i = 0; i < writes.size(); ++i) {
+      for (const auto& r : reads) {
+        if (conflict(writes[i], r)) return false;
+      }
+      for (size_t j = i + 1; j < writes.size(); ++j) {
+        if (conflict(writes[i], writes[j])) return false;
+      }
+    }
+    return true;
+  }
+  std::vector<Member> members_;
+};
+
+// whether an input of the shape can be read by a member of a chain of the
+// shape: an elementwise operator takes an input of a single element only if
+// it broadcasts it, as where does with its condition
+static bool ChainShape(const TShape& input, const TShape& shape) {
+  return input == shape || input.Size() == 1;
+}
+
+// whether the node can be a member of a fused elementwise chain
+static bool IsFusable(const nnvm::Node* node, const OpExecutor& exec,
+                      const Context& ctx, const TShape& shape, int dtype) {
+  static auto& is_elemwise = nnvm::Op::GetAttr<bool>("TIsElemwise");
+  static auto& fcreate_op_state = nnvm::Op::GetAttr<FCreateOpState>("FCreateOpState");
+  const nnvm::Op* op = node->op();
+  if (op == nullptr || !is_elemwise.get(op, false) || fcreate_op_state.count(op)) {
+    return false;
+  }
+  if (ctx.dev_mask() != cpu::kDevMask || exec.exec_type() != ExecType::kSync ||
+      !exec.op_ctx.requested.empty() || exec.out_array.empty()) {
+    return false;
+  }
+  if (common::GetFCompute<FCompute>(op, "FCompute", ctx) == nullptr) return false;
+  for (const auto& nd : exec.in_array) {
+    if (nd.is_sparse() || !ChainShape(nd.shape(), shape) || nd.dtype() != dtype) return false;
+  }
+  for (const auto& nd : exec.out_array) {
+    if (nd.is_sparse() || nd.shape() != shape || nd.dtype() != dtype) return false;
+  }
+  return true;
+}
+
+#if MXNET_USE_CUDA && MXNET_USE_NVRTC
+/*!
+ * \brief CUDA expressions of the float32 operators that can be fused into a
+ *  runtime compiled kernel. %0, %1 and %2 are the inputs, %{name} is the
+ *  parameter name of the operator.
+ */
+static const std::unordered_map<std::string, std::string>& RtcExpressions() {
+  static const std::unordered_map<std::string, std::string> exprs = {
+    {"_copy", "%0"},
+    {"negative", "(-%0)"},
+    {"abs", "fabsf(%0)"},
+    {"relu", "(%0 > 0.f ? %0 : 0.f)"},
+    {"sigmoid", "(1.f / (1.f + expf(-%0)))"},
+    {"tanh", "tanhf(%0)"},
+    {"exp", "expf(%0)"},
+    {"log", "logf(%0)"},
+    {"sqrt", "sqrtf(%0)"},
+    {"square", "(%0 * %0)"},
+    {"elemwise_add", "(%0 + %1)"},
+    {"_grad_add", "(%0 + %1)"},
+    {"_sub", "(%0 - %1)"},
+    {"_mul", "(%0 * %1)"},
+    {"_div", "(%0 / %1)"},
+    {"_maximum", "fmaxf(%0, %1)"},
+    {"_minimum", "fminf(%0, %1)"},
+    {"where", "(%0 != 0.f ? %1 : %2)"},
+    {"clip", "(%0 > %{a_max} ? %{a_max} : (%0 < %{a_min} ? %{a_min} : %0))"},
+    {"_backward_clip", "(%1 > %{a_max} || %1 < %{a_min} ? 0.f : %0)"},
+    {"_plus_scalar", "(%0 + %{scalar})"},
+    {"_minus_scalar", "(%0 - %{scalar})"},
+    {"_rminus_scalar", "(%{scalar} - %0)"},
+    {"_mul_scalar", "(%0 * %{scalar})"},
+    {"_div_scalar", "(%0 / %{scalar})"},
+    {"_rdiv_scalar", "(%{scalar} / %0)"},
+  };
+  return exprs;
+}
+
+// executor running a chain of elementwise operators as one compiled kernel
+class FusedRtcExecutor : public OpExecutor {
+ public:
+  // location of an array, as (member, index in the member's arrays)
+  typedef std::pair<size_t, size_t> ArrayRef;
+
+  void Run(RunContext rctx) override {
+    std::vector<TBlob> inputs, outputs;
+    for (const auto& ref : inputs_) {
+      inputs.push_back(execs_[ref.first]->in_array[ref.second].data());
+    }
+    for (const auto& ref : outputs_) {
+      outputs.push_back(execs_[ref.first]->out_array[ref.second].data());
+    }
+    rtc_->Launch(inputs, outputs, rctx.get_ctx().dev_id,
+                 rctx.get_stream<gpu>(), grid_dim_, block_dim_);
+  }
+
+  // the members are setup on their own by the graph executor
+  void Setup() override {}
+
+  ExecType exec_type() const override {
+    return ExecType::kSync;
+  }
+
+  FusedRtcExecutor(const std::vector<const nnvm::Node*>& nodes,
+                   OpExecVector execs)
+      : execs_(std::move(execs)) {
+    // expose the arrays of the members to the users of the executor
+    for (const auto& exec : execs_) {
+      in_array.insert(in_array.end(), exec->in_array.begin(), exec->in_array.end());
+      out_array.insert(out_array.end(), exec->out_array.begin(), exec->out_array.end());
+    }
+    // name of the value of each output of a member in the kernel
+    std::unordered_map<const nnvm::Node*, size_t> member_id;
+    std::string body;
+    std::vector<std::pair<std::string, NDArray> > rtc_in, rtc_out;
+    for (size_t m = 0; m < nodes.size(); ++m) {
+      member_id[nodes[m]] = m;
+      std::string expr = RtcExpressions().at(nodes[m]->op()->name);
+      for (size_t j = 0; j < nodes[m]->inputs.size(); ++j) {
+        const auto& e = nodes[m]->inputs[j];
+        std::string value;
+        auto it = member_id.find(e.node.get());
+        if (it != member_id.end()) {
+          value = "v" + std::to_string(it->second) + "_" + std::to_string(e.index);
+        } else {
+          value = "x" + std::to_string(inputs_.size());
+          inputs_.emplace_back(m, j);
+          rtc_in.emplace_back("in" + std::to_string(inputs_.size() - 1),
+                              execs_[m]->in_array[j]);
+          // a scalar input is broadcast, see ChainShape
+          const bool scalar = execs_[m]->in_array[j].shape().Size() == 1;
+          body = "    float " + value + " = in" + std::to_string(inputs_.size() - 1) +
+                 (scalar ? "[0];\n" : "[i];\n") + body;
+        }
+        Replace(&expr, "%" + std::to_string(j), value);
+      }
+      for (const auto& kv : nodes[m]->attrs.dict) {
+        Replace(&expr, "%{" + kv.first + "}", "((float)" + kv.second + ")");
+      }
+      std::string value = "v" + std::to_string(m) + "_0";
+      body += "    float " + value + " = " + expr + ";\n";
+      OpReqType req = execs_[m]->req[0];
+      if (req != kNullOp) {
+        std::string out = "out" + std::to_string(outputs_.size());
+        outputs_.emplace_back(m, 0);
+        rtc_out.emplace_back(out, execs_[m]->out_array[0]);
+        body += "    " + out + "[i] " + (req == kAddTo ? "+= " : "= ") + value + ";\n";
+      }
+    }
+    const size_t size = execs_[0]->out_array[0].shape().Size();
+    // all the inputs are loaded at the top of an iteration, so that an output
+    // written inplace cannot be read again by a later member
+    std::string kernel =
+        "  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < " +
+        std::to_string(size) + "; i += blockDim.x * gridDim.x) {\n" + body + "  }";
+    std::lock_guard<std::mutex> lock(CacheMutex());
+    // kernels are cached by their code, which encodes the whole chain
+    auto& cache = KernelCache();
+    auto it = cache.find(kernel);
+    if (it == cache.end()) {
+      it = cache.emplace(kernel, std::make_shared<MXRtc>(
+          "fused_elemwise_" + std::to_string(cache.size()), rtc_in, rtc_out, kernel)).first;
+    }
+    rtc_ = it->second;
+    block_dim_ = mshadow::cuda::kBaseThreadNum;
+    grid_dim_ = static_cast<unsigned int>(std::min<size_t>(
+        mshadow::cuda::kMaxGridNum, (size + block_dim_ - 1) / block_dim_));
+  }
+
+ private:
+  static void Replace(std::string* str, const std::string& from, const std::string& to) {
+    for (size_t pos = str->find(from); pos != std::string::npos;
+         pos = str->find(from, pos + to.size())) {
+      str->replace(pos, from.size(), to);
+    }
+  }
+  static std::unordered_map<std::string, std::shared_ptr<MXRtc> >& KernelCache() {
+    static std::unordered_map<std::string, std::shared_ptr<MXRtc> > cache;
+    return cache;
+  }
+  static std::mutex& CacheMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+  OpExecVector execs_;
+  std::vector<ArrayRef> inputs_, outputs_;
+  std::shared_ptr<MXRtc> rtc_;
+  unsigned int grid_dim_, block_dim_;
+};
+
+// whether the node can be a member of a runtime compiled chain
+static bool IsRtcFusable(const nnvm::Node* node, const OpExecutor& exec,
+                         const TShape& shape) {
+  const nnvm::Op* op = node->op();
+  if (op == nullptr || !RtcExpressions().count(op->name)) return false;
+  if (exec.exec_type() != ExecType::kSync || !exec.op_ctx.requested.empty() ||
+      exec.out_array.size() != 1 || exec.in_array.size() != node->inputs.size()) {
+    return false;
+  }
+  for (const auto& nd : exec.in_array) {
+    if (nd.is_sparse() || !ChainShape(nd.shape(), shape) ||
+        nd.dtype() != mshadow::kFloat32) {
+      return false;
+    }
+  }
+  for (const auto& nd : exec.out_array) {
+    if (nd.is_sparse() || nd.shape() != shape || nd.dtype() != mshadow::kFloat32) return false;
+  }
+  return true;
+}
+
+// fuse chains of a GPU segment into runtime compiled kernels
+static OpExecVector FuseRtcOps(const std::vector<const nnvm::Node*>& nodes,
+                               const OpExecVector& execs) {
+  OpExecVector ret;
+  std::vector<const nnvm::Node*> chain_nodes;
+  OpExecVector chain;
+  auto flush = [&]() {
+    if (chain.size() > 1) {
+      ret.push_back(std::make_shared<FusedRtcExecutor>(chain_nodes, chain));
+    } else if (chain.size() == 1) {
+      ret.push_back(chain[0]);
+    }
+    chain.clear();
+    chain_nodes.clear();
+  };
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const OpExecutor& exec = *execs[i];
+    if (!chain.empty() &&
+        !IsRtcFusable(nodes[i], exec, chain[0]->out_array[0].shape())) {
+      flush();
+    }
+    if (chain.empty() &&
+        (exec.out_array.size() != 1 ||
+         !IsRtcFusable(nodes[i], exec, exec.out_array[0].shape()))) {
+      ret.push_back(execs[i]);
+      continue;
+    }
+    chain.push_back(execs[i]);
+    chain_nodes.push_back(nodes[i]);
+  }
+  flush();
+  return ret;
+}
+#endif  // MXNET_USE_CUDA && MXNET_USE_NVRTC
+
+OpExecVector FuseElemwiseOps(const std::vector<const nnvm::Node*>& nodes,
+                             const OpExecVector& execs,
+                             const Context& ctx) {
+  CHECK_EQ(nodes.size(), execs.size());
+  if (ctx.dev_mask() == gpu::kDevMask) {
+#if MXNET_USE_CUDA && MXNET_USE_NVRTC
+    return FuseRtcOps(nodes, execs);
+#else
+    return execs;
+#endif
+  }
+#if MKL_EXPERIMENTAL == 1
+  // mkl arrays keep their private layout, which cannot be chunked
+  return execs;
+#endif
+  OpExecVector ret;
+  std::vector<FusedElemwiseExecutor::Member> chain;
+  TShape shape;
+  int dtype = -1;
+  auto flush = [&ret, &chain]() {
+    if (chain.size() > 1) {
+      ret.push_back(std::make_shared<FusedElemwiseExecutor>(std::move(chain)));
+    } else if (chain.size() == 1) {
+      ret.push_back(chain[0].exec);
+    }
+    chain.clear();
+  };
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const OpExecutor& exec = *execs[i];
+    if (!chain.empty() && !IsFusable(nodes[i], exec, ctx, shape, dtype)) {
+      flush();
+    }
+    if (chain.empty()) {
+      if (exec.out_array.empty() ||
+          !IsFusable(nodes[i], exec, ctx, exec.out_array[0].shape(),
+                     exec.out_array[0].dtype())) {
+        ret.push_back(execs[i]);
+        continue;
+      }
+      shape = exec.out_array[0].shape();
+      dtype = exec.out_array[0].dtype();
+    }
+    chain.push_back(FusedElemwiseExecutor::Member{
+        nodes[i]->attrs,
+        common::GetFCompute<FCompute>(nodes[i]->op(), "FCompute", ctx),
+        execs[i]});
+  }
+  flush();
+  return ret;
+}
+
+}  // namespace exec
+}  // namespace mxnet
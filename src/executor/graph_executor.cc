@@ -26,9 +26,15 @@
 #include <nnvm/pass_functions.h>
 #include <vector>
 #include <algorithm>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
 
 #include "./exec_pass.h"
 #include "./graph_executor.h"
+#include "./cuda_graph_segment.h"
+#include "./multi_stream_segment.h"
+#include "../common/cuda_utils.h"
 #include "../engine/profiler.h"
 
 namespace mxnet {
@@ -75,6 +81,11 @@ void GraphExecutor::Backward(const std::vector<NDArray>& head_grads, bool is_tra
       }
     }
   }
+  if (gradient_callback_) {
+    // the gradients computed by the forward pass are ready to be used next
+    size_t next = 0;
+    ExecuteGradCallback(&next, num_forward_nodes_);
+  }
   RunOps(is_train, num_forward_nodes_, idx.num_nodes());
 }
 
@@ -88,10 +99,28 @@ void GraphExecutor::Print(std::ostream &os) const {  // NOLINT(*)
 }
 
 void GraphExecutor::SetMonitorCallback(const MonitorCallback& callback) {
-  CHECK(callback) << "invalid callback";
+  // an empty callback removes the installed one, the forwards use the bulk
+  // segments again
   monitor_callback_ = callback;
 }
 
+void GraphExecutor::SetGradientCallback(const GradientCallback& callback) {
+  CHECK(callback) << "invalid callback";
+  gradient_callback_ = callback;
+  const auto& idx = graph_.indexed_graph();
+  grad_callback_nodes_.clear();
+  for (size_t j = num_forward_outputs_; j < idx.outputs().size(); ++j) {
+    const NDArray& grad = grad_store_[j - num_forward_outputs_].second;
+    for (const auto& kv : arg_grad_map_) {
+      if (kv.second.var() == grad.var()) {
+        grad_callback_nodes_.emplace_back(idx.outputs()[j].node_id, kv.first);
+        break;
+      }
+    }
+  }
+  std::sort(grad_callback_nodes_.begin(), grad_callback_nodes_.end());
+}
+
 const std::vector<NDArray>& GraphExecutor::outputs() const {
   return output_arrays_;
 }
@@ -208,12 +237,34 @@ inline ValueType get_node_attr(
   }
 }
 
+/*!
+ * \brief Migrate the managed memory of the arrays an operator reads and writes to
+ *  its gpu, on its stream ahead of its kernels, instead of faulting the pages in.
+ */
+inline void PrefetchArrays(const OpExecutor& exec, RunContext ctx) {
+#if MXNET_USE_CUDA
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(ctx.get_stream<gpu>());
+  for (const std::vector<NDArray>* arrays : {&exec.in_array, &exec.out_array}) {
+    for (const NDArray& nd : *arrays) {
+      if (nd.is_none() || nd.storage_type() != kDefaultStorage) continue;
+      const TBlob& blob = nd.data();
+      PrefetchManagedMemory(blob.dptr_, blob.Size() * mshadow::mshadow_sizeof(blob.type_flag_),
+                            ctx.ctx.dev_id, stream);
+    }
+  }
+#else
+  LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+#endif  // MXNET_USE_CUDA
+}
+
 /*!
  * \brief Create the graph for backward pass.
  * This is triggered by both simple_bind and bind flows.
  */
-nnvm::Graph GraphExecutor::InitFullGraph(nnvm::Symbol symbol,
-                                         const std::vector<OpReqType>& grad_req_types) {
+nnvm::Graph GraphExecutor::InitFullGraph(
+    nnvm::Symbol symbol,
+    const std::unordered_map<std::string, TShape>& arg_shape_map,
+    const std::vector<OpReqType>& grad_req_types) {
   using nnvm::NodePtr;
   using nnvm::NodeEntry;
   // initial information
@@ -241,11 +292,36 @@ nnvm::Graph GraphExecutor::InitFullGraph(nnvm::Symbol symbol,
   }
 
   int do_mirror = dmlc::GetEnv("MXNET_BACKWARD_DO_MIRROR", 0);
-  auto need_mirror = [do_mirror](const nnvm::Node& node) -> int {
+  double mirror_budget = dmlc::GetEnv("MXNET_BACKWARD_MIRROR_BUDGET_MB", 0.0);
+  // nodes whose recomputation would not reproduce the forward pass
+  auto can_mirror = [](const nnvm::Node& node) -> bool {
+    if (node.is_variable()) return false;
+    const std::string& type = node.attrs.op->name;
+    if (type == "Dropout") return false;
+    if (type == "SoftmaxOutput") return false;
+    if (type == "BatchNorm") return false;
+    if (type == "CuDNNBatchNorm") return false;
+    static auto& fmutate = nnvm::Op::GetAttr<nnvm::FMutateInputs>("FMutateInputs");
+    if (fmutate.count(node.op())) return false;
+    static auto& fresource = nnvm::Op::GetAttr<FResourceRequest>("FResourceRequest");
+    if (fresource.count(node.op())) {
+      for (const auto& req : fresource[node.op()](node.attrs)) {
+        if (req.type == ResourceRequest::kRandom ||
+            req.type == ResourceRequest::kParallelRandom) return false;
+      }
+    }
+    return true;
+  };
+  std::unordered_set<const nnvm::Node*> mirror_plan;
+  if (mirror_budget != 0) {
+    mirror_plan = PlanMirror(symbol, arg_shape_map, mirror_budget, can_mirror);
+  }
+  auto need_mirror = [do_mirror, mirror_budget, &mirror_plan](const nnvm::Node& node) -> int {
     if (node.is_variable()) return 0;
     const std::string& type = node.attrs.op->name;
     if (type == "Dropout") return false;
     if (get_node_attr(node, "__force_mirroring__", false)) return true;
+    if (mirror_budget != 0) return mirror_plan.count(&node) != 0;
     if (do_mirror == 0) return false;
     if (type == "Convolution") return false;
     if (type == "FullyConnected") return false;
@@ -438,6 +514,89 @@ void HandleInferTypeError(const size_t num_forward_inputs,
              << oss.str();
 }
 
+/*!
+ * \brief the structure of idx, the operators and attributes of its nodes and
+ *  their edges, and the shapes and types of its inputs
+ */
+std::string InferKey(const nnvm::IndexedGraph& idx,
+                     const nnvm::ShapeVector& arg_shapes,
+                     const nnvm::DTypeVector& arg_dtypes) {
+  std::ostringstream os;
+  std::vector<std::pair<std::string, std::string> > dict;
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    const nnvm::Node* node = idx[nid].source;
+    os << (node->is_variable() ? "null" : node->op()->name);
+    dict.assign(node->attrs.dict.begin(), node->attrs.dict.end());
+    std::sort(dict.begin(), dict.end());
+    for (const auto& kv : dict) {
+      os << ' ' << kv.first.size() << ':' << kv.first << kv.second.size() << ':' << kv.second;
+    }
+    for (const auto& e : idx[nid].inputs) os << ' ' << e.node_id << '.' << e.index;
+    for (uint32_t dep : idx[nid].control_deps) os << " ^" << dep;
+    os << ';';
+  }
+  for (const auto& e : idx.outputs()) os << ' ' << e.node_id << '.' << e.index;
+  os << '|';
+  for (const auto& shape : arg_shapes) os << shape << ';';
+  for (int dtype : arg_dtypes) os << dtype << ';';
+  return os.str();
+}
+
+/*!
+ * \brief infer the shapes and the types of g from the ones of its inputs, or
+ *  take the ones inferred for a graph of the same structure and inputs, as
+ *  each executor of a data parallel group binds the same symbol
+ */
+nnvm::Graph InferShapeType(nnvm::Graph g,
+                           const nnvm::ShapeVector& arg_shapes,
+                           const nnvm::DTypeVector& arg_dtypes,
+                           const size_t num_forward_inputs) {
+  struct Inferred {
+    nnvm::ShapeVector shapes;
+    nnvm::DTypeVector dtypes;
+  };
+  static const size_t max_size = dmlc::GetEnv("MXNET_EXEC_INFER_CACHE_SIZE", 16);
+  static std::mutex mu;
+  static std::unordered_map<std::string, Inferred> cache;
+  std::string key;
+  if (max_size != 0) {
+    key = InferKey(g.indexed_graph(), arg_shapes, arg_dtypes);
+    std::lock_guard<std::mutex> lock(mu);
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+      g.attrs["shape"] = std::make_shared<nnvm::any>(it->second.shapes);
+      g.attrs["shape_num_unknown_nodes"] = std::make_shared<nnvm::any>(static_cast<size_t>(0));
+      g.attrs["dtype"] = std::make_shared<nnvm::any>(it->second.dtypes);
+      g.attrs["dtype_num_unknown_nodes"] = std::make_shared<nnvm::any>(static_cast<size_t>(0));
+      return g;
+    }
+  }
+  {
+    engine::ProfileScope profile_scope("Bind::InferShape");
+    g = nnvm::pass::InferShape(g, arg_shapes, "__shape__");
+  }
+  if (g.GetAttr<size_t>("shape_num_unknown_nodes") != 0U) {
+    HandleInferShapeError(num_forward_inputs, g.indexed_graph(),
+                          g.GetAttr<nnvm::ShapeVector>("shape"));
+  }
+  {
+    engine::ProfileScope profile_scope("Bind::InferType");
+    g = nnvm::pass::InferType(g, arg_dtypes, "__dtype__");
+  }
+  if (g.GetAttr<size_t>("dtype_num_unknown_nodes") != 0U) {
+    HandleInferTypeError(num_forward_inputs, g.indexed_graph(),
+                         g.GetAttr<nnvm::DTypeVector>("dtype"));
+  }
+  if (max_size != 0) {
+    std::lock_guard<std::mutex> lock(mu);
+    // all the entries are dropped when a new one goes over the limit
+    if (cache.size() >= max_size) cache.clear();
+    cache[key] = Inferred{g.GetAttr<nnvm::ShapeVector>("shape"),
+                          g.GetAttr<nnvm::DTypeVector>("dtype")};
+  }
+  return g;
+}
+
 /*!
  * \brief GraphExecutor initializer for regular bind flow in which
  * input arguments and gradients are provided by users. This initializer
@@ -452,6 +611,8 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
                          const std::vector<NDArray>& aux_states,
                          Executor* shared_exec,
                          const nnvm::NodeEntryMap<NDArray>& feed_dict) {
+  // the memory of the executor is attributed to the bind in the profiler traces
+  engine::MemoryScope memory_scope("GraphExecutor::Bind");
   // create in_arg_ctxes, arg_grad_ctxes, aux_state_ctxes
   auto get_ctx1 = [](const NDArray& nd) { return nd.ctx(); };
   auto get_ctx2 = [default_ctx](const NDArray& nd) -> Context {
@@ -465,8 +626,23 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
   std::vector<Context> aux_state_ctxes(aux_states.size());
   std::transform(aux_states.begin(), aux_states.end(), aux_state_ctxes.begin(), get_ctx1);
 
-  nnvm::Graph g = InitGraph(symbol, default_ctx, ctx_map, in_arg_ctxes,
-                            arg_grad_ctxes, aux_state_ctxes, grad_req_types);
+  // shapes of the arguments for the planning of the backward mirroring
+  std::unordered_map<std::string, TShape> arg_shape_map;
+  std::vector<std::string> arg_names = symbol.ListInputNames(nnvm::Symbol::kReadOnlyArgs);
+  for (size_t i = 0; i < arg_names.size() && i < in_args.size(); ++i) {
+    arg_shape_map[arg_names[i]] = in_args[i].shape();
+  }
+  std::vector<std::string> aux_names = symbol.ListInputNames(nnvm::Symbol::kAuxiliaryStates);
+  for (size_t i = 0; i < aux_names.size() && i < aux_states.size(); ++i) {
+    arg_shape_map[aux_names[i]] = aux_states[i].shape();
+  }
+  nnvm::Graph g;
+  {
+    engine::ProfileScope profile_scope("Bind::InitGraph");
+    g = InitGraph(symbol, default_ctx, ctx_map, in_arg_ctxes,
+                  arg_grad_ctxes, aux_state_ctxes, arg_shape_map, grad_req_types,
+                  feed_dict);
+  }
 
   // create arg_shapes and arg_dtypes for shape and type inferences
   const auto& idx = g.indexed_graph();
@@ -501,18 +677,8 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
 
   // expand arg_shapes and arg_dtypes to contain backward inputs
   arg_shapes.resize(idx.input_nodes().size(), TShape());
-  g = nnvm::pass::InferShape(g, arg_shapes, "__shape__");
-  if (g.GetAttr<size_t>("shape_num_unknown_nodes") != 0U) {
-    HandleInferShapeError(num_forward_inputs_, g.indexed_graph(),
-                          g.GetAttr<nnvm::ShapeVector>("shape"));
-  }
-
   arg_dtypes.resize(idx.input_nodes().size(), -1);
-  g = nnvm::pass::InferType(g, arg_dtypes, "__dtype__");
-  if (g.GetAttr<size_t>("dtype_num_unknown_nodes") != 0U) {
-    HandleInferTypeError(num_forward_inputs_, g.indexed_graph(),
-                         g.GetAttr<nnvm::DTypeVector>("dtype"));
-  }
+  g = InferShapeType(std::move(g), arg_shapes, arg_dtypes, num_forward_inputs_);
 
   // Initialize the rest attributes of the graph.
   // This function can be called by regular bind
@@ -735,20 +901,80 @@ void GraphExecutor::FinishInitGraph(nnvm::Symbol symbol,
       data_entry_[eid] = kv.second;
       arg_storage_id[eid] = kExternalStorageID;
     }
+    // the bound arrays give the storage types the others are inferred from
+    std::vector<int> arg_stypes(idx.num_node_entries(), kUndefinedStorage);
+    for (size_t eid = 0; eid < data_entry_.size(); ++eid) {
+      if (!data_entry_[eid].is_none()) arg_stypes[eid] = data_entry_[eid].storage_type();
+    }
+    {
+      engine::ProfileScope profile_scope("Bind::InferStorageType");
+      g = InferStorageType(g, std::move(arg_stypes));
+    }
+    {
+      // sparse entries are allocated when they are written, outside of the plan
+      const auto& vstype = g.GetAttr<std::vector<int> >("storage_type");
+      const auto& vshape = g.GetAttr<nnvm::ShapeVector>("shape");
+      const auto& vdtype = g.GetAttr<nnvm::DTypeVector>("dtype");
+      const auto& vctx = g.GetAttr<ContextVector>("context");
+      for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+        for (uint32_t i = 0; i < idx[nid].source->num_outputs(); ++i) {
+          uint32_t eid = idx.entry_id(nid, i);
+          if (vstype[eid] == kDefaultStorage || !data_entry_[eid].is_none()) continue;
+          data_entry_[eid] = NDArray(static_cast<NDArrayStorageType>(vstype[eid]),
+                                     vshape[eid], vctx[nid], true, vdtype[eid]);
+          arg_storage_id[eid] = kExternalStorageID;
+        }
+      }
+    }
+    // the constants read by other nodes get their own memory, so that they
+    // are computed once and never overwritten
+    g = DetectConstantNodes(g);
+    if (!feed_dict.empty() || !dmlc::GetEnv("MXNET_EXEC_CONSTANT_FOLDING", true)) {
+      g.attrs["constant_node"] = std::make_shared<nnvm::any>(
+          std::vector<int>(idx.num_nodes(), 0));
+    } else {
+      const auto& constant_entry = g.GetAttr<std::vector<int> >("constant_entry");
+      const auto& vshape = g.GetAttr<nnvm::ShapeVector>("shape");
+      const auto& vdtype = g.GetAttr<nnvm::DTypeVector>("dtype");
+      const auto& vctx = g.GetAttr<ContextVector>("context");
+      for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+        for (uint32_t i = 0; i < idx[nid].source->num_outputs(); ++i) {
+          uint32_t eid = idx.entry_id(nid, i);
+          if (constant_entry[eid] != 2 || !data_entry_[eid].is_none()) continue;
+          data_entry_[eid] = NDArray(vshape[eid], vctx[nid], false, vdtype[eid]);
+          arg_storage_id[eid] = kExternalStorageID;
+        }
+      }
+    }
     g.attrs["storage"] = std::make_shared<dmlc::any>(std::move(arg_storage_id));
+    engine::ProfileScope profile_scope("Bind::PlanMemory");
     g = nnvm::ApplyPass(g, "PlanMemory");
   }
   g = DetectInplaceAddTo(g);
+  g = DetectConcatAlias(g);
 
   g.attrs["saved_states"] = std::make_shared<nnvm::any>(std::move(saved_states_));
-  g = AttachOpExecs(g);
-  g = AttachOpResources(g);
-  graph_ = std::move(g);
+  {
+#if MXNET_USE_CUDA
+    // the operators are created before the arrays, they count the planned
+    // arrays as used when sizing their workspace by the free memory
+    PlannedGPUMemoryScope planned(PlannedGPUBytes(g, shared_exec));
+#endif
+    {
+      engine::ProfileScope profile_scope("Bind::AttachOpExecs");
+      g = AttachOpExecs(g);
+      g = AttachOpResources(g);
+    }
+    graph_ = std::move(g);
 
-  if (shared_exec != nullptr) {
-    this->InitDataEntryMemory(&(dynamic_cast<GraphExecutor*>(shared_exec)->data_pool_));
-  } else {
-    this->InitDataEntryMemory(nullptr);
+    {
+      engine::ProfileScope profile_scope("Bind::InitDataEntryMemory");
+      if (shared_exec != nullptr) {
+        this->InitDataEntryMemory(&(dynamic_cast<GraphExecutor*>(shared_exec)->data_pool_));
+      } else {
+        this->InitDataEntryMemory(nullptr);
+      }
+    }
   }
 
   {
@@ -766,8 +992,16 @@ void GraphExecutor::FinishInitGraph(nnvm::Symbol symbol,
       head_grad_array_[oid] = data_entry_[idx.entry_id(nid, 0)];
     }
   }
-  this->InitCachedOps();
-  this->InitOpSegs();
+  {
+    engine::ProfileScope profile_scope("Bind::InitCachedOps");
+    this->InitCachedOps();
+    this->InitOpPriorities();
+    this->FoldConstantNodes();
+  }
+  {
+    engine::ProfileScope profile_scope("Bind::InitOpSegs");
+    this->InitOpSegs();
+  }
 }
 
 /*!
@@ -800,8 +1034,13 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
                          std::unordered_map<std::string, NDArray>* shared_buffer,
                          Executor* shared_exec,
                          const nnvm::NodeEntryMap<NDArray>& feed_dict) {
-  nnvm::Graph g = InitGraph(symbol, default_ctx, ctx_map, in_arg_ctxes, arg_grad_ctxes,
-                            aux_state_ctxes, grad_req_types);
+  engine::MemoryScope memory_scope("GraphExecutor::Bind");
+  nnvm::Graph g;
+  {
+    engine::ProfileScope profile_scope("Bind::InitGraph");
+    g = InitGraph(symbol, default_ctx, ctx_map, in_arg_ctxes, arg_grad_ctxes,
+                  aux_state_ctxes, arg_shape_map, grad_req_types, feed_dict);
+  }
   // The following code of shape and dtype inferences and argument
   // initialization is for simple_bind only. Regular bind operation
   // should do this differently.
@@ -823,17 +1062,7 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
       arg_dtypes[i] = it2->second;
     }
   }
-  g = nnvm::pass::InferShape(g, arg_shapes, "__shape__");
-  if (g.GetAttr<size_t>("shape_num_unknown_nodes") != 0U) {
-    HandleInferShapeError(num_forward_inputs_, g.indexed_graph(),
-                          g.GetAttr<nnvm::ShapeVector>("shape"));
-  }
-
-  g = nnvm::pass::InferType(g, arg_dtypes, "__dtype__");
-  if (g.GetAttr<size_t>("dtype_num_unknown_nodes") != 0U) {
-    HandleInferTypeError(num_forward_inputs_, g.indexed_graph(),
-                         g.GetAttr<nnvm::DTypeVector>("dtype"));
-  }
+  g = InferShapeType(std::move(g), arg_shapes, arg_dtypes, num_forward_inputs_);
 
   // Create in_args, arg_grads, and aux_states using
   // the inferred shapes and dtypes.
@@ -872,9 +1101,46 @@ Graph GraphExecutor::InitGraph(nnvm::Symbol symbol,
                                const std::vector<Context>& in_arg_ctxes,
                                const std::vector<Context>& arg_grad_ctxes,
                                const std::vector<Context>& aux_state_ctxes,
-                               const std::vector<OpReqType>& grad_req_types) {
+                               const std::unordered_map<std::string, TShape>& arg_shape_map,
+                               const std::vector<OpReqType>& grad_req_types,
+                               const nnvm::NodeEntryMap<NDArray>& feed_dict) {
+  // the entries fed by autograd have to stay in the graph
+  if (feed_dict.empty() && dmlc::GetEnv("MXNET_EXEC_FOLD_PAD", true)) {
+    symbol = FoldPadIntoConvolution(symbol);
+  }
+  // run the operators that benefit from it in float16
+  if (default_ctx.dev_mask() == gpu::kDevMask && feed_dict.empty() &&
+      dmlc::GetEnv("MXNET_EXEC_AMP", 0)) {
+    std::unordered_set<std::string> target_ops = {
+      "Convolution", "Deconvolution", "FullyConnected", "dot", "batch_dot", "RNN"};
+    std::unordered_set<std::string> fp32_ops = {
+      "Cast", "softmax", "log_softmax", "SoftmaxOutput", "SoftmaxActivation",
+      "BatchNorm", "CuDNNBatchNorm", "InstanceNorm", "L2Normalization", "LRN",
+      "norm", "sum", "mean", "prod", "nansum", "nanprod", "exp", "log", "_power",
+      "LinearRegressionOutput", "LogisticRegressionOutput", "MAERegressionOutput",
+      "MakeLoss", "make_loss", "smooth_l1", "SVMOutput"};
+    auto add_ops = [](const char* env, std::unordered_set<std::string>* ops) {
+      std::istringstream is(dmlc::GetEnv(env, std::string()));
+      std::string op;
+      while (std::getline(is, op, ',')) {
+        if (!op.empty()) ops->insert(op);
+      }
+    };
+    add_ops("MXNET_EXEC_AMP_FP16_OPS", &target_ops);
+    add_ops("MXNET_EXEC_AMP_FP32_OPS", &fp32_ops);
+    symbol = ReducePrecision(symbol, target_ops, fp32_ops);
+  }
+#if MXNET_USE_CUDNN == 1
+  if (default_ctx.dev_mask() == gpu::kDevMask && feed_dict.empty() &&
+      dmlc::GetEnv("MXNET_EXEC_LAYOUT", std::string()) == "NHWC") {
+    symbol = ConvertToNHWC(symbol);
+  }
+#endif  // MXNET_USE_CUDNN
+  if (feed_dict.empty() && dmlc::GetEnv("MXNET_EXEC_FUSE_BN_RELU", true)) {
+    symbol = FuseBatchNormReLU(symbol);
+  }
   // setup gradient
-  nnvm::Graph g = InitFullGraph(symbol, grad_req_types);
+  nnvm::Graph g = InitFullGraph(symbol, arg_shape_map, grad_req_types);
 
   // create "device" and "context" attrs for the graph
   g = AssignContext(g, default_ctx, ctx_map,
@@ -884,6 +1150,15 @@ Graph GraphExecutor::InitGraph(nnvm::Symbol symbol,
                     num_forward_inputs_,
                     num_forward_outputs_);
 
+  // the entries fed by autograd have to stay in the graph
+  if (g.outputs.size() > num_forward_outputs_ && feed_dict.empty() &&
+      dmlc::GetEnv("MXNET_BACKWARD_OFFLOAD", 0)) {
+    size_t min_kb = dmlc::GetEnv("MXNET_BACKWARD_OFFLOAD_MIN_KB", 1024);
+    size_t distance = dmlc::GetEnv("MXNET_BACKWARD_OFFLOAD_PREFETCH", 4);
+    g = OffloadActivations(g, arg_shape_map, num_forward_outputs_,
+                           min_kb << 10, std::max<size_t>(distance, 1));
+  }
+
   const auto& idx = g.indexed_graph();
   // get number of nodes used in forward pass
   num_forward_nodes_ = 0;
@@ -895,6 +1170,41 @@ Graph GraphExecutor::InitGraph(nnvm::Symbol symbol,
 }
 
 // initialize the memory of each entries
+std::map<int, int64_t> GraphExecutor::PlannedGPUBytes(const nnvm::Graph& g,
+                                                      Executor* shared_exec) const {
+  const auto& idx = g.indexed_graph();
+  const auto& vdtype = g.GetAttr<nnvm::DTypeVector>("dtype");
+  const auto& vshape = g.GetAttr<nnvm::ShapeVector>("shape");
+  const auto& vstorage = g.GetAttr<nnvm::StorageVector>("storage_id");
+  const auto& vctx = g.GetAttr<ContextVector>("context");
+  const auto& alias_entry = g.GetAttr<std::vector<int> >("alias_entry");
+  // the largest entry of each storage id on a gpu
+  std::map<int, std::pair<int, size_t> > pool;
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    if (vctx[nid].dev_mask() != gpu::kDevMask) continue;
+    for (uint32_t i = 0; i < idx[nid].source->num_outputs(); ++i) {
+      const uint32_t eid = idx.entry_id(nid, i);
+      if (vstorage[eid] < 0 || alias_entry[eid] >= 0 || vdtype[eid] < 0) continue;
+      auto& info = pool[vstorage[eid]];
+      info.first = vctx[nid].dev_id;
+      info.second = std::max(info.second,
+                             vshape[eid].Size() * mshadow::mshadow_sizeof(vdtype[eid]));
+    }
+  }
+  std::map<int, int64_t> bytes;
+  for (const auto& kv : pool) bytes[kv.second.first] += kv.second.second;
+  if (shared_exec != nullptr) {
+    for (const NDArray& nd : dynamic_cast<GraphExecutor*>(shared_exec)->data_pool_) {
+      if (nd.is_none() || nd.ctx().dev_mask() != gpu::kDevMask) continue;
+      auto it = bytes.find(nd.ctx().dev_id);
+      if (it == bytes.end()) continue;
+      it->second = std::max<int64_t>(
+          0, it->second - nd.shape().Size() * mshadow::mshadow_sizeof(nd.dtype()));
+    }
+  }
+  return bytes;
+}
+
 void GraphExecutor::InitDataEntryMemory(std::vector<NDArray>* shared_pool) {
   using nnvm::DTypeVector;
   using nnvm::ShapeVector;
@@ -906,6 +1216,8 @@ void GraphExecutor::InitDataEntryMemory(std::vector<NDArray>* shared_pool) {
   const auto& vshape = graph_.GetAttr<ShapeVector>("shape");
   const auto& vstorage = graph_.GetAttr<StorageVector>("storage_id");
   const auto& vctx = graph_.GetAttr<ContextVector>("context");
+  const auto& alias_entry = graph_.GetAttr<std::vector<int> >("alias_entry");
+  const auto& alias_offset = graph_.GetAttr<std::vector<size_t> >("alias_offset");
   CHECK_EQ(idx.num_node_entries(), vshape.size());
   CHECK_EQ(idx.num_node_entries(), vdtype.size());
   CHECK_EQ(idx.num_node_entries(), vstorage.size());
@@ -933,7 +1245,7 @@ void GraphExecutor::InitDataEntryMemory(std::vector<NDArray>* shared_pool) {
   }
   // get maximum bytes in each pool
   for (size_t i = 0; i < vshape.size(); ++i) {
-    if (!data_entry_[i].is_none()) continue;
+    if (!data_entry_[i].is_none() || alias_entry[i] >= 0) continue;
     size_t bytes = vshape[i].Size() * mshadow::mshadow_sizeof(vdtype[i]);
     int storage_id = vstorage[i];
     if (storage_id < 0) continue;
@@ -948,6 +1260,16 @@ void GraphExecutor::InitDataEntryMemory(std::vector<NDArray>* shared_pool) {
       info.second = std::max(info.second, bytes);
     }
   }
+  if (dmlc::GetEnv("MXNET_EXEC_MEMORY_ARENA", false)) {
+    std::vector<NDArray> storage = InitArenaMemory(pool_info, shared_pool);
+    for (size_t i = 0; i < data_entry_.size(); ++i) {
+      if (!data_entry_[i].is_none()) continue;
+      int storage_id = vstorage[i];
+      CHECK_GE(storage_id, 0) << "Do not support runtime shape op yet";
+      data_entry_[i] = storage.at(storage_id).AsArray(vshape[i], vdtype[i]);
+    }
+    return;
+  }
   // construct the re-use pool, if needed
   std::multimap<size_t, NDArray> free_pool;
   if (shared_pool != nullptr) {
@@ -1000,16 +1322,173 @@ void GraphExecutor::InitDataEntryMemory(std::vector<NDArray>* shared_pool) {
 
   for (size_t i = 0; i < data_entry_.size(); ++i) {
     // avoid pre-allocated arrays
-    if (!data_entry_[i].is_none()) continue;
+    if (!data_entry_[i].is_none() || alias_entry[i] >= 0) continue;
     // assign allocated array by storage id
     int storage_id = vstorage[i];
     CHECK_GE(storage_id, 0) << "Do not support runtime shape op yet";
     const NDArray& src = data_pool_.at(storage_id);
     data_entry_[i] = src.AsArray(vshape[i], vdtype[i]);
   }
+  // the parts of the outputs of Concat and of the inputs of SliceChannel
+  for (size_t i = 0; i < data_entry_.size(); ++i) {
+    if (alias_entry[i] < 0) continue;
+    const NDArray& src = data_entry_[alias_entry[i]];
+    data_entry_[i] = src.Reshape(mshadow::Shape1(src.shape().Size()))
+                         .Slice(alias_offset[i], alias_offset[i] + vshape[i].Size())
+                         .Reshape(vshape[i]);
+  }
 }
 
 
+std::vector<NDArray> GraphExecutor::InitArenaMemory(
+    const std::vector<std::pair<Context, size_t> >& pool_info,
+    std::vector<NDArray>* shared_pool) {
+  const auto& idx = graph_.indexed_graph();
+  const auto& vstorage = graph_.GetAttr<nnvm::StorageVector>("storage_id");
+  const auto& op_execs = graph_.GetAttr<OpExecVector>("op_execs");
+  const size_t num_blocks = pool_info.size();
+  const uint32_t kForever = idx.num_nodes();
+  // storage id of an entry allocated here, -1 for pre-allocated entries
+  auto block_of = [&](uint32_t eid) -> int {
+    return data_entry_[eid].is_none() ? vstorage[eid] : -1;
+  };
+  // the lifetime of each storage id in topological order
+  std::vector<uint32_t> first(num_blocks, kForever), last(num_blocks, 0);
+  // Storage ids written by operators that push their own engine operations
+  // cannot get the dependencies of the arena, so they are not packed.
+  std::vector<bool> exclusive(num_blocks, false);
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    const auto& inode = idx[nid];
+    for (const auto& e : inode.inputs) {
+      int sid = block_of(idx.entry_id(e));
+      if (sid >= 0) last[sid] = std::max(last[sid], nid);
+    }
+    for (uint32_t i = 0; i < inode.source->num_outputs(); ++i) {
+      int sid = block_of(idx.entry_id(nid, i));
+      if (sid < 0) continue;
+      first[sid] = std::min(first[sid], nid);
+      last[sid] = std::max(last[sid], nid);
+      const auto& exec = op_execs[nid];
+      if (exec != nullptr && exec->exec_type() != ExecType::kSync &&
+          exec->exec_type() != ExecType::kAsync) {
+        exclusive[sid] = true;
+      }
+    }
+  }
+  for (const auto& e : idx.outputs()) {
+    int sid = block_of(idx.entry_id(e));
+    if (sid >= 0) last[sid] = kForever;
+  }
+  // storage ids in the descending order of their sizes
+  const size_t kAlign = 256;
+  std::vector<size_t> bytes(num_blocks), order;
+  for (size_t sid = 0; sid < num_blocks; ++sid) {
+    bytes[sid] = (pool_info[sid].second + kAlign - 1) / kAlign * kAlign;
+    if (bytes[sid] != 0) order.push_back(sid);
+  }
+  std::stable_sort(order.begin(), order.end(), [&bytes](size_t lhs, size_t rhs) {
+      return bytes[lhs] > bytes[rhs];
+    });
+  // re-use pool, only taken as a whole
+  std::multimap<size_t, NDArray> free_pool;
+  if (shared_pool != nullptr) {
+    for (const NDArray& nd : *shared_pool) {
+      size_t nbytes = nd.shape().Size() * mshadow::mshadow_sizeof(nd.dtype());
+      free_pool.insert(std::make_pair(nbytes, nd));
+    }
+  }
+  auto alloc = [&free_pool, shared_pool](size_t nbytes, const Context& ctx) -> NDArray {
+    for (auto it = free_pool.lower_bound(nbytes); it != free_pool.end(); ++it) {
+      if (it->second.ctx() == ctx) {
+        NDArray nd = it->second;
+        free_pool.erase(it);
+        return nd;
+      }
+    }
+    size_t nword = (nbytes + 3) / 4;
+    CHECK_LE(nword, std::numeric_limits<nnvm::dim_t>::max());
+    NDArray nd(TShape{static_cast<nnvm::dim_t>(nword)}, ctx);
+    if (shared_pool != nullptr) shared_pool->push_back(nd);
+    return nd;
+  };
+  auto word_shape = [](size_t nbytes) -> TShape {
+    return TShape{static_cast<nnvm::dim_t>((nbytes + 3) / 4)};
+  };
+
+  data_pool_.clear();
+  arena_vars_.clear();
+  arena_view_vars_.clear();
+  arena_alias_vars_.clear();
+  std::vector<NDArray> storage(num_blocks);
+  std::vector<Context> contexts;
+  for (size_t sid : order) {
+    if (exclusive[sid]) {
+      storage[sid] = alloc(bytes[sid], pool_info[sid].first);
+      data_pool_.push_back(storage[sid]);
+    } else if (std::find(contexts.begin(), contexts.end(),
+                         pool_info[sid].first) == contexts.end()) {
+      contexts.push_back(pool_info[sid].first);
+    }
+  }
+  std::vector<size_t> offset(num_blocks, 0);
+  for (const Context& ctx : contexts) {
+    // Place each storage id at the lowest offset that does not overlap the
+    // storage ids placed before it and alive at the same time.
+    std::vector<size_t> placed;
+    size_t arena_bytes = 0;
+    for (size_t sid : order) {
+      if (exclusive[sid] || pool_info[sid].first != ctx) continue;
+      std::vector<size_t> alive;
+      for (size_t p : placed) {
+        if (last[p] >= first[sid] && last[sid] >= first[p]) alive.push_back(p);
+      }
+      std::sort(alive.begin(), alive.end(), [&offset](size_t lhs, size_t rhs) {
+          return offset[lhs] < offset[rhs];
+        });
+      size_t off = 0;
+      for (size_t p : alive) {
+        if (off + bytes[sid] <= offset[p]) break;
+        off = std::max(off, offset[p] + bytes[p]);
+      }
+      offset[sid] = off;
+      arena_bytes = std::max(arena_bytes, off + bytes[sid]);
+      placed.push_back(sid);
+    }
+    NDArray arena = alloc(arena_bytes, ctx);
+    data_pool_.push_back(arena);
+    arena_vars_.push_back(arena.var());
+    for (size_t sid : placed) {
+      storage[sid] = arena.MemoryView(offset[sid], word_shape(bytes[sid]), mshadow::kFloat32);
+      arena_view_vars_.push_back(storage[sid].var());
+    }
+    // The engine orders the storage ids sharing memory through the
+    // variables of each other, which their writers mutate as well.
+    for (size_t a : placed) {
+      for (size_t b : placed) {
+        if (a != b && offset[a] < offset[b] + bytes[b] && offset[b] < offset[a] + bytes[a]) {
+          arena_alias_vars_[storage[a].var()].push_back(storage[b].var());
+        }
+      }
+    }
+  }
+  return storage;
+}
+
+void GraphExecutor::PushArenaFence(bool begin) {
+  // Other executors sharing the memory through shared_pool only know the
+  // variables of the arenas. The operations of this executor are put after
+  // their previous uses of an arena, and their later uses after this one.
+  if (arena_vars_.empty()) return;
+  std::vector<Engine::VarHandle> const_vars, mutable_vars(arena_vars_);
+  if (begin) {
+    mutable_vars.insert(mutable_vars.end(), arena_view_vars_.begin(), arena_view_vars_.end());
+  } else {
+    const_vars = arena_view_vars_;
+  }
+  Engine::Get()->PushSync([](RunContext) {}, Context::CPU(), const_vars, mutable_vars,
+                          FnProperty::kNormal, 0, PROFILER_MESSAGE("ArenaFence"));
+}
+
 void GraphExecutor::InitCachedOps() {
   // get the graph
   const auto& idx = graph_.indexed_graph();
@@ -1043,6 +1522,12 @@ void GraphExecutor::InitCachedOps() {
     for (const auto& e : inode.inputs) {
       exec->in_array.push_back(data_entry_[idx.entry_id(e)]);
     }
+    if (exec->exec_type() == ExecType::kCrossDeviceCopy) {
+      // a prefetch of an offloaded activation waits for its control dependencies
+      for (uint32_t dep : inode.control_deps) {
+        op_nodes_[nid].copy_wait_vars.push_back(data_entry_[idx.entry_id(dep, 0)].var());
+      }
+    }
     // detect inplace requirement
     for (uint32_t index = 0; index < inode.source->num_outputs(); ++index) {
       uint32_t eid = idx.entry_id(nid, index);
@@ -1084,6 +1569,10 @@ void GraphExecutor::InitCachedOps() {
     }
     for (auto& nd : exec->out_array) {
       mutate_vars.push_back(nd.var());
+      auto it = arena_alias_vars_.find(nd.var());
+      if (it != arena_alias_vars_.end()) {
+        mutate_vars.insert(mutate_vars.end(), it->second.begin(), it->second.end());
+      }
     }
     if (exec->var() != nullptr) {
       mutate_vars.push_back(exec->var());
@@ -1099,11 +1588,17 @@ void GraphExecutor::InitCachedOps() {
         exec->Setup();
       }, Context::CPU(), {}, all_vars, FnProperty::kNormal, 0,
       PROFILER_MESSAGE("SetupExec"));
-    auto exec_fun = [exec, is_async, is_gpu] (
+#if MXNET_USE_CUDA
+    const bool prefetch = is_gpu && UseManagedMemory();
+#else
+    const bool prefetch = false;
+#endif  // MXNET_USE_CUDA
+    auto exec_fun = [exec, is_async, is_gpu, prefetch] (
         RunContext ctx, Engine::CallbackOnComplete on_complete) {
       if (is_async) {
         exec->op_ctx.async_on_complete = on_complete;
       }
+      if (prefetch) PrefetchArrays(*exec, ctx);
       exec->Run(ctx);
       // call on complete only if it is async op
       if (!is_async) {
@@ -1127,6 +1622,49 @@ void GraphExecutor::InitCachedOps() {
   }
 }
 
+void GraphExecutor::InitOpPriorities() {
+  // The priority of a node is the length of the longest path from it to an
+  // output, so that the engine runs the critical path first. A node writing
+  // a gradient is additionally put ahead of all other nodes, so that the
+  // gradient is ready for the kvstore push as early as possible.
+  const auto& idx = graph_.indexed_graph();
+  const int num_nodes = static_cast<int>(idx.num_nodes());
+  std::vector<int> path(num_nodes, 0);
+  for (int nid = num_nodes - 1; nid >= 0; --nid) {
+    const auto& inode = idx[nid];
+    if (inode.source->is_variable()) continue;
+    if (!op_nodes_[nid].skip_exec_node) ++path[nid];
+    for (const auto& e : inode.inputs) {
+      path[e.node_id] = std::max(path[e.node_id], path[nid]);
+    }
+  }
+  for (int nid = 0; nid < num_nodes; ++nid) {
+    op_nodes_[nid].priority = path[nid];
+  }
+  for (size_t j = num_forward_outputs_; j < idx.outputs().size(); ++j) {
+    OpNode& op_node = op_nodes_[idx.outputs()[j].node_id];
+    op_node.priority = path[idx.outputs()[j].node_id] + num_nodes;
+  }
+}
+
+void GraphExecutor::FoldConstantNodes() {
+  const auto& idx = graph_.indexed_graph();
+  const auto& constant_node = graph_.GetAttr<std::vector<int> >("constant_node");
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    OpNode& opnode = op_nodes_[nid];
+    if (!constant_node[nid] || opnode.skip_exec_node) continue;
+    opnode.exec->op_ctx.is_train = false;
+    if (opnode.exec->exec_type() == ExecType::kCrossDeviceCopy) {
+      CopyFromTo(opnode.exec->in_array[0], &(opnode.exec->out_array[0]));
+    } else if (opnode.exec->exec_type() == ExecType::kLocal) {
+      opnode.exec->Run(RunContext{opnode.ctx, nullptr});
+    } else {
+      Engine::Get()->Push(opnode.cached_opr, opnode.ctx, opnode.priority, false);
+    }
+    opnode.skip_exec_node = true;
+  }
+}
+
 void GraphExecutor::InitOpSegs() {
   size_t total_num_nodes = graph_.indexed_graph().num_nodes();
   cached_seg_opr_.clear();
@@ -1228,6 +1766,15 @@ void GraphExecutor::ExecuteMonCallback(size_t nid) {
   }
 }
 
+void GraphExecutor::ExecuteGradCallback(size_t* next, size_t nid_end) {
+  for (; *next < grad_callback_nodes_.size() &&
+         grad_callback_nodes_[*next].first < nid_end; ++(*next)) {
+    const std::string& name = grad_callback_nodes_[*next].second;
+    NDArray *cpy = new NDArray(arg_grad_map_.at(name));
+    this->gradient_callback_(name.c_str(), reinterpret_cast<void*>(cpy));
+  }
+}
+
 void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
   // Update context
   const auto& idx = graph_.indexed_graph();
@@ -1238,9 +1785,20 @@ void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
     if (inode.source->is_variable()) continue;
     opnode.exec->op_ctx.is_train = is_train;
   }
+  PushArenaFence(true);
+
+  // the gradients of the backward nodes already pushed
+  bool grad_callback = gradient_callback_ && topo_start >= num_forward_nodes_;
+  size_t next_grad = std::lower_bound(
+      grad_callback_nodes_.begin(), grad_callback_nodes_.end(),
+      std::make_pair(static_cast<uint32_t>(topo_start), std::string())) -
+      grad_callback_nodes_.begin();
 
   // Push Ops
   for (size_t nid = topo_start; nid < topo_end; ++nid) {
+    if (grad_callback) {
+      ExecuteGradCallback(&next_grad, nid);
+    }
     auto seg_op = cached_seg_opr_[nid];
     // Check segments first
     if (monitor_callback_ == nullptr && seg_op.opr != nullptr && seg_op.topo_end <= topo_end) {
@@ -1249,7 +1807,7 @@ void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
 #else
       bool profiling = false;
 #endif
-      Engine::Get()->Push(seg_op.opr, seg_op.ctx, 0, profiling);
+      Engine::Get()->Push(seg_op.opr, seg_op.ctx, seg_op.priority, profiling);
       nid = seg_op.topo_end - 1;
       continue;
     }
@@ -1263,6 +1821,11 @@ void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
       CHECK_EQ(inode.inputs.size(), 1U);
       CHECK_EQ(opnode.exec->in_array.size(), 1U);
       CHECK_EQ(opnode.exec->out_array.size(), 1U);
+      if (!opnode.copy_wait_vars.empty()) {
+        Engine::Get()->PushSync([](RunContext ctx) {}, Context::CPU(), opnode.copy_wait_vars,
+                                {opnode.exec->in_array[0].var()}, FnProperty::kNormal, 0,
+                                PROFILER_MESSAGE("WaitCopy"));
+      }
       CopyFromTo(opnode.exec->in_array[0], &(opnode.exec->out_array[0]));
     } else if (opnode.exec->exec_type() == ExecType::kLocal) {
       opnode.exec->Run(RunContext{opnode.ctx, nullptr});
@@ -1272,7 +1835,7 @@ void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
 #else
       bool profiling = false;
 #endif
-      Engine::Get()->Push(opnode.cached_opr, opnode.ctx, 0, profiling);
+      Engine::Get()->Push(opnode.cached_opr, opnode.ctx, opnode.priority, profiling);
     } else {
       LOG(FATAL) << "Not accessed";
     }
@@ -1281,6 +1844,10 @@ void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
       ExecuteMonCallback(nid);
     }
   }
+  if (grad_callback) {
+    ExecuteGradCallback(&next_grad, topo_end);
+  }
+  PushArenaFence(false);
 }
 
 GraphExecutor::CachedSegOpr GraphExecutor::CreateCachedSegOpr(size_t topo_start, size_t topo_end) {
@@ -1302,6 +1869,7 @@ GraphExecutor::CachedSegOpr GraphExecutor::CreateCachedSegOpr(size_t topo_start,
 #endif
 
   const auto& idx = graph_.indexed_graph();
+  std::vector<const nnvm::Node*> seg_nodes;
   for (size_t nid = topo_start; nid < topo_end; ++nid) {
     std::vector<Engine::VarHandle> all_vars;
     const auto& inode = idx[nid];
@@ -1321,6 +1889,8 @@ GraphExecutor::CachedSegOpr GraphExecutor::CreateCachedSegOpr(size_t topo_start,
     std::copy(op_node.use_vars.begin(), op_node.use_vars.end(),
               std::inserter(use_vars, use_vars.end()));
     ret.exec_list.push_back(exec);
+    ret.priority = std::max(ret.priority, op_node.priority);
+    seg_nodes.push_back(inode.source);
 #if MXNET_USE_PROFILER
     opr_names += inode.source->op()->name + ",";
 #endif
@@ -1329,14 +1899,44 @@ GraphExecutor::CachedSegOpr GraphExecutor::CreateCachedSegOpr(size_t topo_start,
   if (pctx == nullptr) return ret;
   ret.ctx = *pctx;
   Engine::Get()->DeduplicateVarHandle(&use_vars, &mutate_vars);
+  // executors of the graph nodes, which keep their context up to date
+  const std::vector<std::shared_ptr<OpExecutor> > node_execs = exec_list;
+  if (dmlc::GetEnv("MXNET_EXEC_FUSE_ELEMWISE", true)) {
+    exec_list = FuseElemwiseOps(seg_nodes, exec_list, ret.ctx);
+  }
 
   bool is_gpu = pctx->dev_mask() == gpu::kDevMask;
-  auto exec_fun = [exec_list, is_gpu] (
-      RunContext ctx, Engine::CallbackOnComplete on_complete) {
-    // Run all opr in the sub-graph
+  std::function<void(RunContext)> run_list = [exec_list](RunContext ctx) {
     for (auto &exec : exec_list) {
       exec->Run(ctx);
     }
+  };
+#if MXNET_USE_CUDA
+  int num_streams = dmlc::GetEnv("MXNET_EXEC_SEGMENT_NUM_STREAMS", 1);
+  if (is_gpu && num_streams > 1 && exec_list.size() > 1) {
+    auto segment = std::make_shared<MultiStreamSegment>(exec_list, num_streams);
+    run_list = [segment](RunContext ctx) { segment->Run(ctx); };
+  }
+#if CUDA_VERSION >= 10000
+  if (is_gpu && dmlc::GetEnv("MXNET_EXEC_ENABLE_CUDA_GRAPH", false) &&
+      CudaGraphSegment::Supported(node_execs)) {
+    auto graph = std::make_shared<CudaGraphSegment>(node_execs, run_list);
+    run_list = [graph](RunContext ctx) { graph->Run(ctx); };
+  }
+#endif  // CUDA_VERSION >= 10000
+#endif
+#if MXNET_USE_CUDA
+  const bool prefetch = is_gpu && UseManagedMemory();
+#else
+  const bool prefetch = false;
+#endif  // MXNET_USE_CUDA
+  auto exec_fun = [run_list, is_gpu, prefetch, node_execs] (
+      RunContext ctx, Engine::CallbackOnComplete on_complete) {
+    if (prefetch) {
+      for (const auto& exec : node_execs) PrefetchArrays(*exec, ctx);
+    }
+    // Run all opr in the sub-graph
+    run_list(ctx);
     if (is_gpu) {
 #if MXNET_USE_CUDA
       // Wait GPU kernel to finish.
@@ -58,6 +58,7 @@ class GraphExecutor : public Executor {
  public:
   friend class autograd::AutogradRuntime;
   using Executor::MonitorCallback;
+  using Executor::GradientCallback;
 
   virtual ~GraphExecutor();
   void Forward(bool is_train) override;
@@ -69,6 +70,7 @@ class GraphExecutor : public Executor {
   const std::unordered_map<std::string, NDArray>& aux_state_map() const override;
   void Print(std::ostream &os) const override; // NOLINT(*)
   void SetMonitorCallback(const MonitorCallback& callback) override;
+  void SetGradientCallback(const GradientCallback& callback) override;
   // Initialize the rest of attributes
   // after setting up arguments.
   void FinishInitGraph(nnvm::Symbol symbol, nnvm::Graph g,
@@ -123,6 +125,10 @@ class GraphExecutor : public Executor {
     std::vector<Engine::VarHandle> use_vars;
     // cached mutate vars, used for seg ops creation
     std::vector<Engine::VarHandle> mutate_vars;
+    // engine priority of the node
+    int priority{0};
+    // vars a cross device copy waits for besides its input
+    std::vector<Engine::VarHandle> copy_wait_vars;
   };
   // a cached segment operator that executes a segment
   struct CachedSegOpr {
@@ -134,6 +140,8 @@ class GraphExecutor : public Executor {
     size_t topo_end;
     // the cached operator
     Engine::OprHandle opr = nullptr;
+    // engine priority of the segment
+    int priority = 0;
     // list of op executors
     std::vector<std::shared_ptr<OpExecutor> > exec_list;
   };
@@ -170,18 +178,35 @@ class GraphExecutor : public Executor {
                   const std::vector<Context>& in_arg_ctxes,
                   const std::vector<Context>& arg_grad_ctxes,
                   const std::vector<Context>& aux_state_ctxes,
-                  const std::vector<OpReqType>& grad_req_types);
+                  const std::unordered_map<std::string, TShape>& arg_shape_map,
+                  const std::vector<OpReqType>& grad_req_types,
+                  const nnvm::NodeEntryMap<NDArray>& feed_dict);
   // intialize the full graph for simple bind, including gradient
   Graph InitFullGraph(nnvm::Symbol symbol,
+                      const std::unordered_map<std::string, TShape>& arg_shape_map,
                       const std::vector<OpReqType>& grad_req_types);
   // initialize the cached operator
   void InitCachedOps();
+  // initialize the engine priorities of the nodes from the critical path
+  void InitOpPriorities();
+  // run the constant nodes once and skip them in later runs
+  void FoldConstantNodes();
   // initialize the opr segments for bulk exec
   void InitOpSegs();
+  // the bytes the memory plan of g allocates on each gpu, less those of the
+  // pool of shared_exec on the gpu
+  std::map<int, int64_t> PlannedGPUBytes(const nnvm::Graph& g, Executor* shared_exec) const;
   // initialize the resources in the graph
   // initialize the memory of data entries
   // shared_pool: extra memory shared from other parts
   void InitDataEntryMemory(std::vector<NDArray>* shared_pool);
+  // pack the storage of the data entries into one arena per context
+  // pool_info: context and bytes of each storage id
+  // returns the array of each storage id
+  std::vector<NDArray> InitArenaMemory(const std::vector<std::pair<Context, size_t> >& pool_info,
+                                       std::vector<NDArray>* shared_pool);
+  // push a no-op ordering the arena with the other users of the memory
+  void PushArenaFence(bool begin);
   // run ops from topo order start to end
   void RunOps(bool is_train, size_t topo_start, size_t topo_end);
   /*!
@@ -194,6 +219,8 @@ class GraphExecutor : public Executor {
   CachedSegOpr CreateCachedSegOpr(size_t topo_start, size_t topo_end);
   // run the monitor callback for node `nid`
   void ExecuteMonCallback(size_t nid);
+  // run the gradient callbacks from grad_callback_nodes_[*next] for the nodes before nid_end
+  void ExecuteGradCallback(size_t* next, size_t nid_end);
 
   // internal graph
   nnvm::Graph graph_;
@@ -203,6 +230,10 @@ class GraphExecutor : public Executor {
   std::vector<NDArray> data_entry_;
   // internal data pool of allocated entries
   std::vector<NDArray> data_pool_;
+  // engine variables of the arenas and of the storage ids packed in them
+  std::vector<Engine::VarHandle> arena_vars_, arena_view_vars_;
+  // storage ids sharing memory in the arena, keyed by their variables
+  std::unordered_map<Engine::VarHandle, std::vector<Engine::VarHandle> > arena_alias_vars_;
   // output arrays
   std::vector<NDArray> output_arrays_;
   // input argument map, key is arg name, value is arg's NDArray
@@ -229,6 +260,10 @@ class GraphExecutor : public Executor {
   std::unordered_map<const nnvm::Node*, OpStatePtr> saved_states_;
   // monitor call back
   std::function<void(const char*, void*)> monitor_callback_{nullptr};
+  // gradient call back
+  std::function<void(const char*, void*)> gradient_callback_{nullptr};
+  // the node computing each gradient with a name, and the name, sorted by node
+  std::vector<std::pair<uint32_t, std::string> > grad_callback_nodes_;
   // whether to enable bulk execution
   bool prefer_bulk_execution_;
   // cached segment operator
@@ -0,0 +1,73 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file infer_storage_type_pass.cc
+ * \brief Infer the storage types of the entries of a graph.
+ */
+#include <mxnet/base.h>
+#include <mxnet/op_attr_types.h>
+#include <nnvm/graph_attr_types.h>
+#include <vector>
+
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+Graph InferStorageType(Graph g, std::vector<int> stypes) {
+  static auto& finfer = nnvm::Op::GetAttr<FInferStorageType>("FInferStorageType");
+  const auto& idx = g.indexed_graph();
+  const auto& vctx = g.GetAttr<ContextVector>("context");
+  CHECK_EQ(stypes.size(), idx.num_node_entries());
+
+  std::vector<int> in_stypes, out_stypes;
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    const auto& inode = idx[nid];
+    const uint32_t num_outputs = inode.source->num_outputs();
+    if (inode.source->is_variable()) {
+      // the unbound inputs, e.g. the head gradients, are dense
+      if (stypes[idx.entry_id(nid, 0)] == kUndefinedStorage) {
+        stypes[idx.entry_id(nid, 0)] = kDefaultStorage;
+      }
+      continue;
+    }
+    in_stypes.clear();
+    for (const auto& e : inode.inputs) {
+      in_stypes.push_back(stypes[idx.entry_id(e)]);
+    }
+    out_stypes.assign(num_outputs, kUndefinedStorage);
+    const nnvm::Op* op = inode.source->op();
+    if (finfer.count(op)) {
+      CHECK(finfer[op](inode.source->attrs, vctx[nid].dev_mask(), &in_stypes, &out_stypes))
+          << "cannot infer the storage types of the outputs of " << op->name;
+    }
+    for (uint32_t i = 0; i < num_outputs; ++i) {
+      int& stype = stypes[idx.entry_id(nid, i)];
+      // the bound arrays keep their storage, a mismatch is cast when the node runs
+      if (stype != kUndefinedStorage) continue;
+      stype = out_stypes[i] == kUndefinedStorage ? kDefaultStorage : out_stypes[i];
+    }
+  }
+  g.attrs["storage_type"] = std::make_shared<nnvm::any>(std::move(stypes));
+  return g;
+}
+
+}  // namespace exec
+}  // namespace mxnet
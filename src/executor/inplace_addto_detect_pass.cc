@@ -24,6 +24,7 @@
 #include <mxnet/base.h>
 #include <mxnet/operator.h>
 #include <mxnet/op_attr_types.h>
+#include <dmlc/parameter.h>
 #include <nnvm/graph_attr_types.h>
 
 #include "./exec_pass.h"
@@ -56,6 +57,8 @@ Graph DetectInplaceAddTo(Graph g) {
     const auto& inode = idx[nid];
     if (inode.source->op() != ewise_plus_op) continue;
     int sid = storage_id[idx.entry_id(inode.inputs[0])];
+    // external storage, e.g. of the sparse entries, is not shared
+    if (sid < 0) continue;
     if (sid != storage_id[idx.entry_id(nid, 0)]) continue;
     if (idx[inode.inputs[0].node_id].source->is_variable()) continue;
     if (idx[inode.inputs[1].node_id].source->is_variable()) continue;
@@ -69,6 +72,41 @@ Graph DetectInplaceAddTo(Graph g) {
     skip_plus_node[nid] = 1;
   }
 
+  // z = ElementWiseSum(z, a, b, ...) of the gradients becomes z += a, z += b, ...
+  // when z is summed in place and is only read by the sum; the backward ops
+  // writing a, b, ... must honor kAddTo.
+  static const bool enable_sum = dmlc::GetEnv("MXNET_EXEC_ENABLE_ADDTO", false);
+  static const Op* ewise_sum_op = Op::Get("ElementWiseSum");
+  static auto& is_backward = Op::GetAttr<nnvm::TIsBackward>("TIsBackward");
+  for (uint32_t nid = 0; enable_sum && nid < idx.num_nodes(); ++nid) {
+    const auto& inode = idx[nid];
+    if (inode.source->op() != ewise_sum_op || inode.inputs.size() < 2) continue;
+    uint32_t eid_lhs = idx.entry_id(inode.inputs[0]);
+    int sid = storage_id[eid_lhs];
+    if (sid < 0 || sid != storage_id[idx.entry_id(nid, 0)]) continue;
+    if (ref_count[eid_lhs] != 1) continue;
+    const auto& lhs = idx[inode.inputs[0].node_id];
+    if (lhs.source->is_variable() || skip_plus_node[inode.inputs[0].node_id]) continue;
+    bool convert = true;
+    for (size_t i = 1; convert && i < inode.inputs.size(); ++i) {
+      const auto& e = inode.inputs[i];
+      const auto& src = idx[e.node_id];
+      uint32_t eid_rhs = idx.entry_id(e);
+      convert = !src.source->is_variable() && !skip_plus_node[e.node_id] &&
+                is_backward.get(src.source->op(), false) && ref_count[eid_rhs] == 1 &&
+                storage_id[eid_rhs] >= 0 && storage_id[eid_rhs] != sid &&
+                e.node_id > inode.inputs[0].node_id;
+    }
+    if (!convert) continue;
+    for (size_t i = 1; i < inode.inputs.size(); ++i) {
+      uint32_t eid_rhs = idx.entry_id(inode.inputs[i]);
+      storage_id[eid_rhs] = sid;
+      addto_entry[eid_rhs] = 1;
+      storage_inplace_index[eid_rhs] = -1;
+    }
+    skip_plus_node[nid] = 1;
+  }
+
   g.attrs["storage_id"] = std::make_shared<nnvm::any>(std::move(storage_id));
   g.attrs["storage_inplace_index"] = std::make_shared<nnvm::any>(
       std::move(storage_inplace_index));
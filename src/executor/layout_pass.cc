@@ -0,0 +1,144 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file layout_pass.cc
+ * \brief Run the 2D convolutions of a NCHW symbol in NHWC.
+ */
+#include <mxnet/base.h>
+#include <nnvm/graph.h>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+namespace {
+bool IsTrue(const nnvm::NodeAttrs& attrs, const std::string& key) {
+  auto it = attrs.dict.find(key);
+  return it != attrs.dict.end() && (it->second == "True" || it->second == "true" ||
+                                    it->second == "1");
+}
+
+bool Is2D(const nnvm::NodeAttrs& attrs) {
+  auto it = attrs.dict.find("kernel");
+  if (it == attrs.dict.end()) return false;
+  TShape kernel;
+  std::istringstream is(it->second);
+  is >> kernel;
+  return kernel.ndim() == 2;
+}
+
+bool HasDefault(const nnvm::NodeAttrs& attrs, const std::string& key,
+                const std::string& value) {
+  auto it = attrs.dict.find(key);
+  return it == attrs.dict.end() || it->second == value;
+}
+}  // namespace
+
+nnvm::Symbol ConvertToNHWC(const nnvm::Symbol& src) {
+  using nnvm::Node;
+  using nnvm::NodeEntry;
+  using nnvm::NodePtr;
+  // operators that apply the same function to every element
+  static const std::unordered_set<std::string> agnostic_ops = {
+    "Activation", "Dropout", "Cast", "BlockGrad", "stop_gradient", "_copy", "clip",
+    "relu", "sigmoid", "tanh", "elemwise_add", "elemwise_sub", "elemwise_mul",
+    "_Plus", "_plus", "_Minus", "_minus", "_Mul", "_mul", "ElementWiseSum", "add_n",
+    "_PlusScalar", "_plus_scalar", "_MinusScalar", "_minus_scalar",
+    "_MulScalar", "_mul_scalar", "_DivScalar", "_div_scalar"};
+  static const nnvm::Op* transpose_op = nnvm::Op::Get("transpose");
+  // the nodes of the copy can be modified without changing the symbol of the user
+  nnvm::Symbol sym = src.Copy();
+  // the entries in NHWC
+  std::set<std::pair<const Node*, uint32_t> > nhwc;
+  std::map<std::tuple<const Node*, uint32_t, bool>, NodeEntry> transposes;
+  auto is_nhwc = [&nhwc](const NodeEntry& e) {
+    return nhwc.count(std::make_pair(e.node.get(), e.index)) != 0;
+  };
+  auto transpose = [&transposes](const NodeEntry& e, bool to_nhwc) {
+    auto key = std::make_tuple(e.node.get(), e.index, to_nhwc);
+    auto it = transposes.find(key);
+    if (it != transposes.end()) return it->second;
+    NodePtr n = Node::Create();
+    n->attrs.op = transpose_op;
+    n->attrs.name = e.node->attrs.name + (to_nhwc ? "_nhwc" : "_nchw");
+    n->attrs.dict["axes"] = to_nhwc ? "(0,2,3,1)" : "(0,3,1,2)";
+    transpose_op->attr_parser(&(n->attrs));
+    n->inputs.push_back(e);
+    NodeEntry ret{n, 0, 0};
+    transposes[key] = ret;
+    return ret;
+  };
+  auto set_attr = [](Node* node, const std::string& key, const std::string& value) {
+    node->attrs.dict[key] = value;
+    node->op()->attr_parser(&(node->attrs));
+  };
+  nnvm::DFSVisit(sym.outputs, [&](const NodePtr& node) {
+    if (node->is_variable()) return;
+    const std::string& name = node->op()->name;
+    const nnvm::NodeAttrs& attrs = node->attrs;
+    bool any_nhwc = false;
+    for (const auto& e : node->inputs) any_nhwc = any_nhwc || is_nhwc(e);
+    if (name == "Convolution" && Is2D(attrs) && HasDefault(attrs, "layout", "NCHW") &&
+        !IsTrue(attrs, "cudnn_off")) {
+      // the weight is transposed from OIHW to OHWI like the data
+      for (size_t i = 0; i < 2; ++i) {
+        if (!is_nhwc(node->inputs[i])) node->inputs[i] = transpose(node->inputs[i], true);
+      }
+      set_attr(node.get(), "layout", "NHWC");
+      nhwc.insert(std::make_pair(node.get(), 0U));
+    } else if (any_nhwc && name == "Pooling" && Is2D(attrs) && !attrs.dict.count("layout") &&
+               attrs.dict.count("pool_type") && attrs.dict.at("pool_type") != "sum" &&
+               !IsTrue(attrs, "cudnn_off")) {
+      set_attr(node.get(), "layout", "NHWC");
+      nhwc.insert(std::make_pair(node.get(), 0U));
+    } else if (any_nhwc && name == "BatchNorm" && HasDefault(attrs, "axis", "1")) {
+      set_attr(node.get(), "axis", "3");
+      nhwc.insert(std::make_pair(node.get(), 0U));
+    } else if (any_nhwc && agnostic_ops.count(name)) {
+      // the inputs of an elementwise operator all have the same shape
+      for (auto& e : node->inputs) {
+        if (!is_nhwc(e)) e = transpose(e, true);
+      }
+      for (uint32_t i = 0; i < node->num_outputs(); ++i) {
+        nhwc.insert(std::make_pair(node.get(), i));
+      }
+    } else {
+      for (auto& e : node->inputs) {
+        if (is_nhwc(e)) e = transpose(e, false);
+      }
+    }
+  });
+  for (auto& e : sym.outputs) {
+    if (is_nhwc(e)) e = transpose(e, false);
+  }
+  return sym;
+}
+
+}  // namespace exec
+}  // namespace mxnet
@@ -0,0 +1,213 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file multi_stream_segment.h
+ * \brief Run the operators of a GPU bulk segment on several streams,
+ *  ordered by CUDA events instead of a single stream.
+ */
+#ifndef MXNET_EXECUTOR_MULTI_STREAM_SEGMENT_H_
+#define MXNET_EXECUTOR_MULTI_STREAM_SEGMENT_H_
+
+#include <mxnet/base.h>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "./exec_pass.h"
+#include "../common/cuda_utils.h"
+
+#if MXNET_USE_CUDA
+namespace mxnet {
+namespace exec {
+
+/*!
+ * \brief Runs the executors of a bulk segment on several CUDA streams.
+ *
+ *  Two executors depend on each other when one writes memory the other reads
+ *  or writes, or when they share a requested resource. Each executor goes to
+ *  the stream of its latest dependency when it can, so that chains stay on
+ *  one stream, and independent branches go to other streams. Dependencies
+ *  across streams are enforced with cudaStreamWaitEvent. All the streams are
+ *  joined into the stream of the engine worker at the end of Run, so to the
+ *  engine the segment still completes as a whole.
+ *
+ *  The schedule is computed on the first run, when the memory of the arrays
+ *  is known, and reused afterwards.
+ */
+class MultiStreamSegment {
+ public:
+  MultiStreamSegment(const std::vector<std::shared_ptr<OpExecutor> >& exec_list,
+                     int num_streams)
+      : exec_list_(exec_list), num_streams_(std::max(num_streams, 1)) {}
+
+  ~MultiStreamSegment() {
+    // Catch exception for CUDA driver shutdown
+    for (auto& e : events_) MSHADOW_CATCH_ERROR(CUDA_CALL(cudaEventDestroy(e)));
+    for (auto& e : join_events_) MSHADOW_CATCH_ERROR(CUDA_CALL(cudaEventDestroy(e)));
+    if (!aux_streams_.empty()) MSHADOW_CATCH_ERROR(CUDA_CALL(cudaEventDestroy(fork_event_)));
+    for (auto s : aux_streams_) MSHADOW_CATCH_ERROR(mshadow::DeleteStream<gpu>(s));
+  }
+  /*!
+   * \brief run all executors, the work is complete when the stream of
+   *  rctx is synchronized.
+   */
+  void Run(RunContext rctx) {
+    if (stream_of_.empty()) Init(rctx);
+    mshadow::Stream<gpu>* main = rctx.get_stream<gpu>();
+    auto stream = [this, main](int k) {
+      return k == 0 ? main : aux_streams_[k - 1];
+    };
+    // fork the auxiliary streams from the main one, which also makes them
+    // part of a CUDA graph capture of the main stream
+    if (!aux_streams_.empty()) {
+      CUDA_CALL(cudaEventRecord(fork_event_, mshadow::Stream<gpu>::GetStream(main)));
+      for (auto s : aux_streams_) {
+        CUDA_CALL(cudaStreamWaitEvent(mshadow::Stream<gpu>::GetStream(s), fork_event_, 0));
+      }
+    }
+    for (size_t i = 0; i < exec_list_.size(); ++i) {
+      mshadow::Stream<gpu>* s = stream(stream_of_[i]);
+      for (size_t j : waits_[i]) {
+        CUDA_CALL(cudaStreamWaitEvent(mshadow::Stream<gpu>::GetStream(s), events_[j], 0));
+      }
+      exec_list_[i]->Run(RunContext{rctx.ctx, s});
+      if (needs_event_[i]) {
+        CUDA_CALL(cudaEventRecord(events_[i], mshadow::Stream<gpu>::GetStream(s)));
+      }
+    }
+    // join the auxiliary streams into the main one
+    for (size_t k = 0; k < aux_streams_.size(); ++k) {
+      CUDA_CALL(cudaEventRecord(join_events_[k],
+                                mshadow::Stream<gpu>::GetStream(aux_streams_[k])));
+      CUDA_CALL(cudaStreamWaitEvent(mshadow::Stream<gpu>::GetStream(main),
+                                    join_events_[k], 0));
+    }
+  }
+
+ private:
+  // byte ranges of memory touched by an executor
+  typedef std::pair<const char*, const char*> Range;
+  struct Access {
+    std::vector<Range> reads, writes;
+    std::vector<engine::VarHandle> resources;
+  };
+  static Range GetRange(const NDArray& nd) {
+    TBlob blob = nd.data();
+    const char* begin = static_cast<const char*>(blob.dptr_);
+    return Range(begin, begin + blob.Size() * mshadow::mshadow_sizeof(blob.type_flag_));
+  }
+  static bool Overlap(const std::vector<Range>& a, const std::vector<Range>& b) {
+    for (const auto& x : a) {
+      for (const auto& y : b) {
+        if (x.first < y.second && y.first < x.second) return true;
+      }
+    }
+    return false;
+  }
+  static bool Conflict(const Access& a, const Access& b) {
+    if (Overlap(a.writes, b.reads) || Overlap(a.writes, b.writes) ||
+        Overlap(a.reads, b.writes)) {
+      return true;
+    }
+    for (auto v : a.resources) {
+      if (std::find(b.resources.begin(), b.resources.end(), v) != b.resources.end()) {
+        return true;
+      }
+    }
+    return false;
+  }
+  void Init(RunContext rctx) {
+    const size_t n = exec_list_.size();
+    std::vector<Access> access(n);
+    for (size_t i = 0; i < n; ++i) {
+      const auto& exec = exec_list_[i];
+      for (const auto& nd : exec->in_array) access[i].reads.push_back(GetRange(nd));
+      for (const auto& nd : exec->out_array) access[i].writes.push_back(GetRange(nd));
+      for (const auto& r : exec->op_ctx.requested) access[i].resources.push_back(r.var);
+    }
+    stream_of_.assign(n, 0);
+    waits_.assign(n, std::vector<size_t>());
+    needs_event_.assign(n, false);
+    // last executor assigned to each stream, -1 if none
+    std::vector<int> last(num_streams_, -1);
+    for (size_t i = 0; i < n; ++i) {
+      // latest conflicting executor on each stream
+      std::vector<int> dep(num_streams_, -1);
+      for (size_t j = 0; j < i; ++j) {
+        if (Conflict(access[i], access[j])) dep[stream_of_[j]] = static_cast<int>(j);
+      }
+      // continue the chain of the latest dependency that is still the tail
+      // of its stream, otherwise take the stream that has been idle longest
+      int chosen = -1;
+      for (int k = 0; k < num_streams_; ++k) {
+        if (dep[k] >= 0 && dep[k] == last[k] && (chosen < 0 || dep[k] > dep[chosen])) {
+          chosen = k;
+        }
+      }
+      if (chosen < 0) {
+        chosen = 0;
+        for (int k = 1; k < num_streams_; ++k) {
+          if (last[k] < last[chosen]) chosen = k;
+        }
+      }
+      stream_of_[i] = chosen;
+      last[chosen] = static_cast<int>(i);
+      for (int k = 0; k < num_streams_; ++k) {
+        if (k != chosen && dep[k] >= 0) {
+          waits_[i].push_back(dep[k]);
+          needs_event_[dep[k]] = true;
+        }
+      }
+    }
+    int used = *std::max_element(stream_of_.begin(), stream_of_.end());
+    for (int k = 0; k < used; ++k) {
+      aux_streams_.push_back(mshadow::NewStream<gpu>(true, MXNET_USE_CUDNN != 0,
+                                                     rctx.ctx.dev_id));
+      cudaEvent_t e;
+      CUDA_CALL(cudaEventCreateWithFlags(&e, cudaEventDisableTiming));
+      join_events_.push_back(e);
+    }
+    if (used > 0) CUDA_CALL(cudaEventCreateWithFlags(&fork_event_, cudaEventDisableTiming));
+    events_.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+      if (needs_event_[i]) {
+        CUDA_CALL(cudaEventCreateWithFlags(&events_[i], cudaEventDisableTiming));
+      }
+    }
+  }
+
+  std::vector<std::shared_ptr<OpExecutor> > exec_list_;
+  int num_streams_;
+  /*! \brief stream index of each executor, 0 is the stream of the worker */
+  std::vector<int> stream_of_;
+  /*! \brief executors on other streams each executor has to wait for */
+  std::vector<std::vector<size_t> > waits_;
+  /*! \brief whether an event is recorded after the executor */
+  std::vector<bool> needs_event_;
+  std::vector<cudaEvent_t> events_;
+  std::vector<mshadow::Stream<gpu>*> aux_streams_;
+  std::vector<cudaEvent_t> join_events_;
+  cudaEvent_t fork_event_;
+};
+
+}  // namespace exec
+}  // namespace mxnet
+#endif  // MXNET_USE_CUDA
+#endif  // MXNET_EXECUTOR_MULTI_STREAM_SEGMENT_H_
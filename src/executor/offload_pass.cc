@@ -0,0 +1,206 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file offload_pass.cc
+ * \brief Move forward activations to pinned host memory until the
+ *  backward pass needs them.
+ */
+#include <mxnet/base.h>
+#include <nnvm/graph.h>
+#include <nnvm/pass_functions.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+Graph OffloadActivations(Graph g,
+                         const std::unordered_map<std::string, TShape>& arg_shapes,
+                         size_t num_forward_outputs,
+                         size_t min_bytes,
+                         size_t prefetch_distance) {
+  using nnvm::Node;
+  using nnvm::NodeEntry;
+  using nnvm::NodePtr;
+  const auto& idx = g.indexed_graph();
+  const auto& vctx = g.GetAttr<ContextVector>("context");
+  size_t num_forward_nodes = 0;
+  for (size_t i = 0; i < num_forward_outputs; ++i) {
+    num_forward_nodes = std::max(num_forward_nodes,
+                                 static_cast<size_t>(idx.outputs()[i].node_id + 1));
+  }
+  // shapes of the forward entries, the head gradients may stay unknown
+  nnvm::Graph sg;
+  sg.outputs = g.outputs;
+  nnvm::ShapeVector shapes(idx.input_nodes().size(), TShape());
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    auto it = arg_shapes.find(idx[idx.input_nodes()[i]].source->attrs.name);
+    if (it != arg_shapes.end()) shapes[i] = it->second;
+  }
+  sg = nnvm::pass::InferShape(sg, shapes, "__shape__");
+  const auto& vshape = sg.GetAttr<nnvm::ShapeVector>("shape");
+
+  // pointers of the nodes, and the consumers of each entry
+  std::vector<NodePtr> nodes(idx.num_nodes());
+  std::vector<std::vector<uint32_t> > consumers(idx.num_node_entries());
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    const Node* node = idx[nid].source;
+    for (size_t i = 0; i < node->inputs.size(); ++i) {
+      const NodeEntry& e = node->inputs[i];
+      nodes[idx.node_id(e.node.get())] = e.node;
+      consumers[idx.entry_id(e)].push_back(nid);
+    }
+    for (const auto& n : node->control_deps) nodes[idx.node_id(n.get())] = n;
+  }
+  for (const auto& e : g.outputs) nodes[idx.node_id(e.node.get())] = e.node;
+  std::vector<bool> is_output(idx.num_node_entries(), false);
+  for (const auto& e : idx.outputs()) is_output[idx.entry_id(e)] = true;
+
+  // select the GPU activations used by both passes
+  std::vector<std::pair<uint32_t, uint32_t> > selected;
+  for (uint32_t nid = 0; nid < num_forward_nodes; ++nid) {
+    if (idx[nid].source->is_variable() || vctx[nid].dev_mask() != gpu::kDevMask) continue;
+    for (uint32_t i = 0; i < idx[nid].source->num_outputs(); ++i) {
+      uint32_t eid = idx.entry_id(nid, i);
+      const auto& users = consumers[eid];
+      if (is_output[eid] || users.empty() || users.front() >= num_forward_nodes ||
+          users.back() < num_forward_nodes || vshape[eid].ndim() == 0 ||
+          vshape[eid].Size() * sizeof(real_t) < min_bytes) {
+        continue;
+      }
+      selected.emplace_back(nid, i);
+    }
+  }
+  if (selected.empty()) return g;
+
+  // the forward nodes belong to the symbol of the user, so they are copied
+  // before the offloading copies are attached to them
+  std::unordered_map<const Node*, NodePtr> clone;
+  auto remap = [&clone](NodeEntry* e) {
+    auto it = clone.find(e->node.get());
+    if (it != clone.end()) e->node = it->second;
+  };
+  for (uint32_t nid = 0; nid < num_forward_nodes; ++nid) {
+    const NodePtr& src = nodes[nid];
+    if (src->is_variable()) continue;
+    NodePtr n = Node::Create();
+    n->attrs = src->attrs;
+    n->inputs = src->inputs;
+    n->control_deps = src->control_deps;
+    for (auto& e : n->inputs) remap(&e);
+    for (auto& c : n->control_deps) {
+      auto it = clone.find(c.get());
+      if (it != clone.end()) c = it->second;
+    }
+    clone[src.get()] = n;
+  }
+  for (uint32_t nid = num_forward_nodes; nid < idx.num_nodes(); ++nid) {
+    const NodePtr& n = nodes[nid];
+    for (auto& e : n->inputs) remap(&e);
+    for (auto& c : n->control_deps) {
+      auto it = clone.find(c.get());
+      if (it != clone.end()) c = it->second;
+    }
+  }
+
+  std::unordered_map<const Node*, Context> node_ctx;
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    auto it = clone.find(idx[nid].source);
+    node_ctx[it != clone.end() ? it->second.get() : idx[nid].source] = vctx[nid];
+  }
+  static const nnvm::Op* copy_op = nnvm::Op::Get("_CrossDeviceCopy");
+  auto create_copy = [](const NodeEntry& src, const std::string& name) {
+    NodePtr n = Node::Create();
+    n->attrs.op = copy_op;
+    n->attrs.name = name;
+    if (copy_op->attr_parser != nullptr) copy_op->attr_parser(&(n->attrs));
+    n->inputs.push_back(src);
+    return n;
+  };
+  size_t offloaded_bytes = 0;
+  for (const auto& sel : selected) {
+    const uint32_t nid = sel.first, index = sel.second;
+    const uint32_t eid = idx.entry_id(nid, index);
+    const auto& users = consumers[eid];
+    const Node* src = idx[nid].source;
+    const Context& ctx = vctx[nid];
+    std::string name = src->attrs.name + (src->num_outputs() > 1 ?
+                                          "_" + std::to_string(index) : std::string());
+    // copy to the host next to the last forward use
+    NodePtr offload = create_copy(NodeEntry{clone.at(src), index, 0}, name + "_offload");
+    uint32_t last_forward = 0;
+    for (uint32_t u : users) {
+      if (u < num_forward_nodes) last_forward = u;
+    }
+    clone.at(idx[last_forward].source)->control_deps.push_back(offload);
+    node_ctx[offload.get()] = Context::CPUPinned(ctx.dev_id);
+    // copy back a few backward nodes before the first backward use
+    NodePtr prefetch = create_copy(NodeEntry{offload, 0, 0}, name + "_prefetch");
+    uint32_t first_backward = *std::lower_bound(users.begin(), users.end(),
+                                                static_cast<uint32_t>(num_forward_nodes));
+    if (first_backward > num_forward_nodes + prefetch_distance) {
+      uint32_t t = first_backward - prefetch_distance;
+      while (t > num_forward_nodes && nodes[t]->is_variable()) --t;
+      if (!nodes[t]->is_variable()) prefetch->control_deps.push_back(nodes[t]);
+    }
+    node_ctx[prefetch.get()] = ctx;
+    for (uint32_t u : users) {
+      if (u < num_forward_nodes) continue;
+      for (auto& e : nodes[u]->inputs) {
+        if (e.node.get() == clone.at(src).get() && e.index == index) {
+          e = NodeEntry{prefetch, 0, 0};
+        }
+      }
+    }
+    offloaded_bytes += vshape[eid].Size() * sizeof(real_t);
+  }
+
+  Graph ret;
+  ret.outputs = g.outputs;
+  for (auto& e : ret.outputs) remap(&e);
+  ret.attrs = g.attrs;
+  const auto& new_idx = ret.indexed_graph();
+  ContextVector new_ctx(new_idx.num_nodes());
+  nnvm::DeviceVector device(new_idx.num_nodes());
+  std::map<Context, int> ctx2id;
+  for (uint32_t nid = 0; nid < new_idx.num_nodes(); ++nid) {
+    new_ctx[nid] = node_ctx.at(new_idx[nid].source);
+    if (ctx2id.count(new_ctx[nid]) == 0) {
+      int id = static_cast<int>(ctx2id.size());
+      ctx2id[new_ctx[nid]] = id;
+    }
+    device[nid] = ctx2id.at(new_ctx[nid]);
+  }
+  ret.attrs["context"] = std::make_shared<nnvm::any>(std::move(new_ctx));
+  // separate the storage of the host and device entries in memory planning
+  ret.attrs["device"] = std::make_shared<nnvm::any>(std::move(device));
+  LOG(INFO) << "Offloading " << selected.size() << " activations of "
+            << (offloaded_bytes >> 20) << " MB to pinned host memory";
+  return ret;
+}
+
+}  // namespace exec
+}  // namespace mxnet
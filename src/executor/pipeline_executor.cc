@@ -0,0 +1,180 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file pipeline_executor.cc
+ * \brief executors of a model parallel symbol, one per micro-batch
+ */
+#include <algorithm>
+#include <tuple>
+#include <unordered_set>
+#include "./pipeline_executor.h"
+
+namespace mxnet {
+namespace exec {
+
+PipelineExecutor::PipelineExecutor(
+    const nnvm::Symbol& symbol,
+    const Context& default_ctx,
+    const std::map<std::string, Context>& group2ctx,
+    const std::vector<std::pair<std::string, TShape> >& data_shapes,
+    int num_micro_batches) {
+  CHECK_GT(num_micro_batches, 0) << "PipelineExecutor: no micro-batch";
+  CHECK(!data_shapes.empty()) << "PipelineExecutor: no data given";
+  arg_names_ = symbol.ListInputNames(nnvm::Symbol::kReadOnlyArgs);
+  aux_names_ = symbol.ListInputNames(nnvm::Symbol::kAuxiliaryStates);
+  batch_size_ = data_shapes[0].second[0];
+  for (const auto& s : data_shapes) {
+    auto it = std::find(arg_names_.begin(), arg_names_.end(), s.first);
+    CHECK(it != arg_names_.end()) << "PipelineExecutor: " << s.first << " is not an argument";
+    CHECK_EQ(s.second[0], batch_size_)
+        << "PipelineExecutor: the data must have the same batch size";
+    data_index_.push_back(it - arg_names_.begin());
+  }
+  std::vector<OpReqType> grad_reqs(arg_names_.size(), kWriteTo);
+  for (size_t i : data_index_) grad_reqs[i] = kNullOp;
+  for (size_t i = 0; i < arg_names_.size(); ++i) {
+    if (grad_reqs[i] == kNullOp) continue;
+    param_index_.push_back(i);
+    param_names_.push_back(arg_names_[i]);
+  }
+
+  const index_t num = num_micro_batches;
+  CHECK_GE(batch_size_, num) << "PipelineExecutor: the batch is smaller than the micro-batches";
+  index_t begin = 0;
+  for (index_t i = 0; i < num; ++i) {
+    index_t end = begin + batch_size_ / num + (i < batch_size_ % num);
+    slices_.emplace_back(begin, end);
+    begin = end;
+  }
+
+  // the arguments and the auxiliary states live on the device of their group
+  std::unordered_map<std::string, Context> input_ctx;
+  for (const auto& attr : symbol.ListAttrsRecursive()) {
+    if (std::get<1>(attr) != "__ctx_group__") continue;
+    auto it = group2ctx.find(std::get<2>(attr));
+    if (it != group2ctx.end()) input_ctx[std::get<0>(attr)] = it->second;
+  }
+  auto ctx_of = [&](const std::vector<std::string>& names) {
+    std::vector<Context> ctxes;
+    for (const auto& name : names) {
+      auto it = input_ctx.find(name);
+      ctxes.push_back(it != input_ctx.end() ? it->second : default_ctx);
+    }
+    return ctxes;
+  };
+  const std::vector<Context> arg_ctxes = ctx_of(arg_names_);
+
+  // the first micro-batch allocates the parameters, gradients and states
+  in_args_.resize(num);
+  std::unordered_map<std::string, TShape> arg_shapes;
+  for (const auto& s : data_shapes) {
+    TShape shape = s.second;
+    shape[0] = slices_[0].second - slices_[0].first;
+    arg_shapes[s.first] = shape;
+  }
+  execs_.emplace_back(Executor::SimpleBind(
+      symbol, default_ctx, group2ctx, arg_ctxes, arg_ctxes, ctx_of(aux_names_),
+      arg_shapes, std::unordered_map<std::string, int>(), grad_reqs,
+      std::unordered_set<std::string>(),
+      &in_args_[0], &arg_grads_, &aux_states_));
+  // the others add their gradients to the ones of the first
+  for (size_t i : param_index_) grad_reqs[i] = kAddTo;
+  for (index_t m = 1; m < num; ++m) {
+    in_args_[m] = in_args_[0];
+    for (size_t i : data_index_) {
+      const NDArray& first = in_args_[0][i];
+      TShape shape = first.shape();
+      shape[0] = slices_[m].second - slices_[m].first;
+      in_args_[m][i] = NDArray(shape, first.ctx(), false, first.dtype());
+    }
+    execs_.emplace_back(Executor::Bind(symbol, default_ctx, group2ctx, in_args_[m],
+                                       arg_grads_, grad_reqs, aux_states_));
+  }
+}
+
+void PipelineExecutor::SetParams(const std::unordered_map<std::string, NDArray>& params) {
+  for (const auto& kv : params) {
+    auto arg = std::find(arg_names_.begin(), arg_names_.end(), kv.first);
+    auto aux = std::find(aux_names_.begin(), aux_names_.end(), kv.first);
+    CHECK(arg != arg_names_.end() || aux != aux_names_.end())
+        << "PipelineExecutor: " << kv.first << " is not a parameter";
+    NDArray* dst = arg != arg_names_.end() ? &in_args_[0][arg - arg_names_.begin()] :
+                                             &aux_states_[aux - aux_names_.begin()];
+    CopyFromTo(kv.second, dst);
+  }
+}
+
+void PipelineExecutor::Forward(const std::vector<NDArray>& data, bool is_train) {
+  CHECK_EQ(data.size(), data_index_.size()) << "PipelineExecutor: wrong number of data";
+  for (size_t j = 0; j < data.size(); ++j) {
+    CHECK_EQ(data[j].shape()[0], batch_size_) << "PipelineExecutor: wrong batch size";
+  }
+  for (size_t m = 0; m < execs_.size(); ++m) {
+    for (size_t j = 0; j < data.size(); ++j) {
+      CopyFromTo(data[j].Slice(slices_[m].first, slices_[m].second),
+                 &in_args_[m][data_index_[j]]);
+    }
+    execs_[m]->Forward(is_train);
+  }
+}
+
+void PipelineExecutor::Backward() {
+  // the first micro-batch, which writes the gradients, is pushed first
+  for (const auto& exec : execs_) {
+    exec->Backward(std::vector<NDArray>());
+  }
+}
+
+void PipelineExecutor::InitKVStore(KVStore* kv) {
+  std::vector<int> keys;
+  std::vector<NDArray> values = params();
+  for (size_t k = 0; k < param_index_.size(); ++k) {
+    keys.push_back(static_cast<int>(k));
+  }
+  kv->Init(keys, values);
+  for (size_t k = 0; k < param_index_.size(); ++k) {
+    kv->Pull(std::vector<int>(1, static_cast<int>(k)), {&in_args_[0][param_index_[k]]},
+             -static_cast<int>(k));
+  }
+}
+
+void PipelineExecutor::Update(KVStore* kv) {
+  for (size_t r = param_index_.size(); r > 0; --r) {
+    const int k = static_cast<int>(r - 1);
+    const std::vector<int> keys(1, k);
+    kv->Push(keys, {arg_grads_[param_index_[k]]}, -k);
+    kv->Pull(keys, {&in_args_[0][param_index_[k]]}, -k);
+  }
+}
+
+std::vector<NDArray> PipelineExecutor::params() const {
+  std::vector<NDArray> ret;
+  for (size_t i : param_index_) ret.push_back(in_args_[0][i]);
+  return ret;
+}
+
+std::vector<NDArray> PipelineExecutor::grads() const {
+  std::vector<NDArray> ret;
+  for (size_t i : param_index_) ret.push_back(arg_grads_[i]);
+  return ret;
+}
+
+}  // namespace exec
+}  // namespace mxnet
@@ -0,0 +1,125 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file pipeline_executor.h
+ * \brief executors of a symbol placed over devices with group2ctx, each
+ *  taking a micro-batch, so that the stages of the model overlap
+ */
+#ifndef MXNET_EXECUTOR_PIPELINE_EXECUTOR_H_
+#define MXNET_EXECUTOR_PIPELINE_EXECUTOR_H_
+
+#include <mxnet/base.h>
+#include <mxnet/executor.h>
+#include <mxnet/kvstore.h>
+#include <mxnet/ndarray.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace exec {
+
+/*!
+ * \brief one executor of a model parallel symbol per micro-batch, the batch
+ *  split along the first axis. The executors share the parameters, the
+ *  auxiliary states and the gradients, which the first micro-batch writes
+ *  and the others add to; each has its own activations. Forward and Backward
+ *  push all the micro-batches to the engine in order, so a device runs the
+ *  stage of micro-batch m + 1 while the next device runs the one of m, as in
+ *  GPipe, and the gradients are the sums over the micro-batches.
+ */
+class PipelineExecutor {
+ public:
+  /*!
+   * \brief bind the executors.
+   * \param symbol the symbol, whose outputs should be losses that do not
+   *  normalize by the batch size, so that the sums over the micro-batches
+   *  are the gradients of the batch.
+   * \param default_ctx the device of the nodes out of the groups.
+   * \param group2ctx the device of each ctx_group.
+   * \param data_shapes the shapes of the whole batch of the arguments that
+   *  are split into the micro-batches, such as the data and the labels; the
+   *  other arguments are the parameters, whose gradients are computed.
+   * \param num_micro_batches the number of the micro-batches.
+   */
+  PipelineExecutor(const nnvm::Symbol& symbol,
+                   const Context& default_ctx,
+                   const std::map<std::string, Context>& group2ctx,
+                   const std::vector<std::pair<std::string, TShape> >& data_shapes,
+                   int num_micro_batches);
+  /*!
+   * \brief copy parameters or auxiliary states to their devices.
+   * \param params the arrays by name.
+   */
+  void SetParams(const std::unordered_map<std::string, NDArray>& params);
+  /*!
+   * \brief copy the micro-batches of a batch to the executors and run the
+   *  forward pass of each.
+   * \param data the batch of each argument of data_shapes, in the same order.
+   * \param is_train whether the forward pass is for training.
+   */
+  void Forward(const std::vector<NDArray>& data, bool is_train);
+  /*! \brief run the backward pass of every micro-batch */
+  void Backward();
+  /*!
+   * \brief initialize the parameters in kv, and pull them back; the key of a
+   *  parameter is its index among the parameters.
+   */
+  void InitKVStore(KVStore* kv);
+  /*!
+   * \brief push the gradients to kv and pull the updated parameters, the
+   *  last parameters first; kv should update the parameters with its updater.
+   */
+  void Update(KVStore* kv);
+  /*! \return the executors, one per micro-batch */
+  const std::vector<std::unique_ptr<Executor> >& executors() const {
+    return execs_;
+  }
+  /*! \return the names of the parameters */
+  const std::vector<std::string>& param_names() const {
+    return param_names_;
+  }
+  /*! \return the parameters, in the order of param_names */
+  std::vector<NDArray> params() const;
+  /*! \return the gradients of the batch, in the order of param_names */
+  std::vector<NDArray> grads() const;
+
+ private:
+  /*! \brief the names of the arguments and of the auxiliary states */
+  std::vector<std::string> arg_names_, aux_names_, param_names_;
+  /*! \brief the argument index of each data and of each parameter */
+  std::vector<size_t> data_index_, param_index_;
+  /*! \brief the rows of the batch of each micro-batch */
+  std::vector<std::pair<index_t, index_t> > slices_;
+  /*! \brief the size of the whole batch */
+  index_t batch_size_;
+  std::vector<std::unique_ptr<Executor> > execs_;
+  /*! \brief the arguments of each micro-batch, which differ in the data */
+  std::vector<std::vector<NDArray> > in_args_;
+  /*! \brief the shared gradients and auxiliary states */
+  std::vector<NDArray> arg_grads_, aux_states_;
+};
+
+}  // namespace exec
+}  // namespace mxnet
+#endif  // MXNET_EXECUTOR_PIPELINE_EXECUTOR_H_
@@ -0,0 +1,161 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file plan_mirror_pass.cc
+ * \brief Choose the forward nodes recomputed in the backward pass
+ *  under a memory budget.
+ */
+#include <mxnet/base.h>
+#include <nnvm/graph.h>
+#include <nnvm/pass_functions.h>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+namespace {
+// result of a segmentation of the candidates
+struct MirrorPlan {
+  // whether each candidate is recomputed
+  std::vector<bool> mirror;
+  // estimated bytes of the forward activations kept for the backward pass,
+  // including the largest recomputed segment
+  size_t memory{0};
+  // bytes of the recomputed outputs
+  size_t recompute{0};
+};
+
+// Split the candidates into segments of at most segment_bytes, only the
+// last node of each segment is kept and the others are recomputed.
+MirrorPlan Segment(const std::vector<size_t>& bytes, size_t segment_bytes, size_t kept_bytes) {
+  MirrorPlan plan;
+  plan.mirror.resize(bytes.size(), true);
+  plan.memory = kept_bytes;
+  size_t acc = 0, max_segment = 0;
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    acc += bytes[i];
+    if (acc > segment_bytes) {
+      plan.mirror[i] = false;
+      plan.memory += bytes[i];
+      max_segment = std::max(max_segment, acc - bytes[i]);
+      acc = 0;
+    } else {
+      plan.recompute += bytes[i];
+    }
+  }
+  plan.memory += std::max(max_segment, acc);
+  return plan;
+}
+}  // namespace
+
+std::unordered_set<const nnvm::Node*> PlanMirror(
+    const nnvm::Symbol& symbol,
+    const std::unordered_map<std::string, TShape>& arg_shapes,
+    double budget_mb,
+    const std::function<bool(const nnvm::Node&)>& can_mirror) {
+  std::unordered_set<const nnvm::Node*> ret;
+  nnvm::Graph g;
+  g.outputs = symbol.outputs;
+  const auto& idx = g.indexed_graph();
+  nnvm::ShapeVector shapes(idx.input_nodes().size(), TShape());
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    auto it = arg_shapes.find(idx[idx.input_nodes()[i]].source->attrs.name);
+    if (it != arg_shapes.end()) shapes[i] = it->second;
+  }
+  g = nnvm::pass::InferShape(g, shapes, "__shape__");
+  if (g.GetAttr<size_t>("shape_num_unknown_nodes") != 0U) {
+    LOG(WARNING) << "Cannot plan the backward mirroring without the shapes of all inputs";
+    return ret;
+  }
+  const auto& vshape = g.GetAttr<nnvm::ShapeVector>("shape");
+  // bytes of the outputs of the forward nodes, the types are not known yet
+  // so all entries are assumed to be 32 bit
+  std::vector<const nnvm::Node*> candidates;
+  std::vector<size_t> bytes;
+  size_t kept_bytes = 0, total_bytes = 0;
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    const nnvm::Node* node = idx[nid].source;
+    if (node->is_variable()) continue;
+    size_t nbytes = 0;
+    for (uint32_t i = 0; i < node->num_outputs(); ++i) {
+      nbytes += vshape[idx.entry_id(nid, i)].Size() * sizeof(real_t);
+    }
+    total_bytes += nbytes;
+    if (can_mirror(*node)) {
+      candidates.push_back(node);
+      bytes.push_back(nbytes);
+    } else {
+      kept_bytes += nbytes;
+    }
+  }
+  if (candidates.empty()) return ret;
+  // try segment sizes growing geometrically from the smallest candidate
+  // to all candidates, which keeps nothing but the final one
+  const size_t budget = budget_mb > 0 ?
+      static_cast<size_t>(budget_mb * (1 << 20)) : std::numeric_limits<size_t>::max();
+  size_t sum = 0, min_bytes = std::numeric_limits<size_t>::max();
+  for (size_t b : bytes) {
+    sum += b;
+    min_bytes = std::max<size_t>(std::min(min_bytes, b), 1);
+  }
+  MirrorPlan best;
+  bool found = false;
+  for (double seg = static_cast<double>(min_bytes); ; seg *= 1.25) {
+    MirrorPlan plan = Segment(bytes, static_cast<size_t>(seg), kept_bytes);
+    bool better;
+    if (budget_mb > 0) {
+      // the least recomputation within the budget, or the least memory
+      bool fits = plan.memory <= budget, best_fits = found && best.memory <= budget;
+      better = !found || (fits && (!best_fits || plan.recompute < best.recompute)) ||
+          (!fits && !best_fits && plan.memory < best.memory);
+    } else {
+      // the least memory, like the sqrt(N) segmentation
+      better = !found || plan.memory < best.memory;
+    }
+    if (better) {
+      best = plan;
+      found = true;
+    }
+    if (seg >= static_cast<double>(sum)) break;
+  }
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (best.mirror[i]) ret.insert(candidates[i]);
+  }
+  if (budget_mb > 0 && best.memory > budget) {
+    LOG(WARNING) << "The backward mirroring cannot fit the forward activations in "
+                 << budget_mb << " MB, the closest plan keeps "
+                 << (best.memory >> 20) << " MB";
+  }
+  LOG(INFO) << "Backward mirroring recomputes " << ret.size() << " of "
+            << candidates.size() << " candidate nodes: the forward activations take "
+            << (best.memory >> 20) << " MB instead of " << (total_bytes >> 20)
+            << " MB, and " << (best.recompute >> 20) << " MB of outputs are recomputed";
+  return ret;
+}
+
+}  // namespace exec
+}  // namespace mxnet
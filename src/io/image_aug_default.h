@@ -0,0 +1,171 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file image_aug_default.h
+ * \brief the parameters of the default augmenter, shared with the gpu decoder
+ */
+#ifndef MXNET_IO_IMAGE_AUG_DEFAULT_H_
+#define MXNET_IO_IMAGE_AUG_DEFAULT_H_
+
+#include <dmlc/parameter.h>
+#include <mxnet/base.h>
+#include <random>
+#if MXNET_USE_OPENCV
+#include <opencv2/opencv.hpp>
+#endif
+#include "../common/utils.h"
+
+namespace mxnet {
+namespace io {
+
+/*! \brief image augmentation parameters*/
+struct DefaultImageAugmentParam : public dmlc::Parameter<DefaultImageAugmentParam> {
+  /*! \brief resize shorter edge to size before applying other augmentations */
+  int resize;
+  /*! \brief whether we do random cropping */
+  bool rand_crop;
+  /*! \brief [-max_rotate_angle, max_rotate_angle] */
+  int max_rotate_angle;
+  /*! \brief max aspect ratio */
+  float max_aspect_ratio;
+  /*! \brief random shear the image [-max_shear_ratio, max_shear_ratio] */
+  float max_shear_ratio;
+  /*! \brief max crop size */
+  int max_crop_size;
+  /*! \brief min crop size */
+  int min_crop_size;
+  /*! \brief max scale ratio */
+  float max_random_scale;
+  /*! \brief min scale_ratio */
+  float min_random_scale;
+  /*! \brief min image size */
+  float min_img_size;
+  /*! \brief max image size */
+  float max_img_size;
+  /*! \brief max random in H channel */
+  int random_h;
+  /*! \brief max random in S channel */
+  int random_s;
+  /*! \brief max random in L channel */
+  int random_l;
+  /*! \brief rotate angle */
+  int rotate;
+  /*! \brief filled color while padding */
+  int fill_value;
+  /*! \brief interpolation method 0-NN 1-bilinear 2-cubic 3-area 4-lanczos4 9-auto 10-rand  */
+  int inter_method;
+  /*! \brief padding size */
+  int pad;
+  /*! \brief shape of the image data*/
+  TShape data_shape;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(DefaultImageAugmentParam) {
+    DMLC_DECLARE_FIELD(resize).set_default(-1)
+        .describe("Down scale the shorter edge to a new size  "
+                  "before applying other augmentations.");
+    DMLC_DECLARE_FIELD(rand_crop).set_default(false)
+        .describe("If or not randomly crop the image");
+    DMLC_DECLARE_FIELD(max_rotate_angle).set_default(0.0f)
+        .describe("Rotate by a random degree in ``[-v, v]``");
+    DMLC_DECLARE_FIELD(max_aspect_ratio).set_default(0.0f)
+        .describe("Change the aspect (namely width/height) to a random value "
+                  "in ``[1 - max_aspect_ratio, 1 + max_aspect_ratio]``");
+    DMLC_DECLARE_FIELD(max_shear_ratio).set_default(0.0f)
+        .describe("Apply a shear transformation (namely ``(x,y)->(x+my,y)``) "
+                  "with ``m`` randomly chose from "
+                  "``[-max_shear_ratio, max_shear_ratio]``");
+    DMLC_DECLARE_FIELD(max_crop_size).set_default(-1)
+        .describe("Crop both width and height into a random size in "
+                  "``[min_crop_size, max_crop_size]``");
+    DMLC_DECLARE_FIELD(min_crop_size).set_default(-1)
+        .describe("Crop both width and height into a random size in "
+                  "``[min_crop_size, max_crop_size]``");
+    DMLC_DECLARE_FIELD(max_random_scale).set_default(1.0f)
+        .describe("Resize into ``[width*s, height*s]`` with ``s`` randomly"
+                  " chosen from ``[min_random_scale, max_random_scale]``");
+    DMLC_DECLARE_FIELD(min_random_scale).set_default(1.0f)
+        .describe("Resize into ``[width*s, height*s]`` with ``s`` randomly"
+                  " chosen from ``[min_random_scale, max_random_scale]``");
+    DMLC_DECLARE_FIELD(max_img_size).set_default(1e10f)
+        .describe("Set the maximal width and height after all resize and"
+                  " rotate argumentation  are applied");
+    DMLC_DECLARE_FIELD(min_img_size).set_default(0.0f)
+        .describe("Set the minimal width and height after all resize and"
+                  " rotate argumentation  are applied");
+    DMLC_DECLARE_FIELD(random_h).set_default(0)
+        .describe("Add a random value in ``[-random_h, random_h]`` to "
+                  "the H channel in HSL color space.");
+    DMLC_DECLARE_FIELD(random_s).set_default(0)
+        .describe("Add a random value in ``[-random_s, random_s]`` to "
+                  "the S channel in HSL color space.");
+    DMLC_DECLARE_FIELD(random_l).set_default(0)
+        .describe("Add a random value in ``[-random_l, random_l]`` to "
+                  "the L channel in HSL color space.");
+    DMLC_DECLARE_FIELD(rotate).set_default(-1.0f)
+        .describe("Rotate by an angle. If set, it overwrites the ``max_rotate_angle`` option.");
+    DMLC_DECLARE_FIELD(fill_value).set_default(255)
+        .describe("Set the padding pixes value into ``fill_value``.");
+    DMLC_DECLARE_FIELD(data_shape)
+        .set_expect_ndim(3).enforce_nonzero()
+        .describe("The shape of a output image.");
+    DMLC_DECLARE_FIELD(inter_method).set_default(1)
+        .describe("The interpolation method: 0-NN 1-bilinear 2-cubic 3-area "
+                  "4-lanczos4 9-auto 10-rand.");
+    DMLC_DECLARE_FIELD(pad).set_default(0)
+        .describe("Change size from ``[width, height]`` into "
+                  "``[pad + width + pad, pad + height + pad]`` by padding pixes");
+  }
+};
+
+#if MXNET_USE_OPENCV
+/*!
+ * \brief get interpolation method with given inter_method, 0-CV_INTER_NN 1-CV_INTER_LINEAR 2-CV_INTER_CUBIC
+ * \ 3-CV_INTER_AREA 4-CV_INTER_LANCZOS4 9-AUTO(cubic for enlarge, area for shrink, bilinear for others) 10-RAND
+ */
+inline int GetInterMethod(int inter_method, int old_width, int old_height, int new_width,
+                          int new_height, common::RANDOM_ENGINE *prnd) {
+  if (inter_method == 9) {
+    if (new_width > old_width && new_height > old_height) {
+      return 2;  // CV_INTER_CUBIC for enlarge
+    } else if (new_width < old_width && new_height < old_height) {
+      return 3;  // CV_INTER_AREA for shrink
+    } else {
+      return 1;  // CV_INTER_LINEAR for others
+    }
+  } else if (inter_method == 10) {
+    std::uniform_int_distribution<size_t> rand_uniform_int(0, 4);
+    return rand_uniform_int(*prnd);
+  } else {
+    return inter_method;
+  }
+}
+
+/*! \brief the size of src with its shorter edge resized to size */
+inline cv::Size ShorterEdgeSize(const cv::Mat& src, int size) {
+  if (src.rows > src.cols) {
+    return cv::Size(size, size * src.rows / src.cols);
+  }
+  return cv::Size(size * src.cols / src.rows, size);
+}
+#endif  // MXNET_USE_OPENCV
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_IMAGE_AUG_DEFAULT_H_
@@ -0,0 +1,75 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file image_decode_cache.h
+ * \brief a cache of the decoded and resized images of an epoch
+ */
+#ifndef MXNET_IO_IMAGE_DECODE_CACHE_H_
+#define MXNET_IO_IMAGE_DECODE_CACHE_H_
+
+#if MXNET_USE_OPENCV
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace mxnet {
+namespace io {
+
+/*!
+ * \brief holds decoded uint8 images by their record index, up to a number
+ *  of bytes. The images are not evicted: a full cache keeps the images of
+ *  the first epoch, which the later epochs hit in the same proportion
+ *  whatever their order. It is shared by the decoding threads.
+ */
+class DecodedImageCache {
+ public:
+  explicit DecodedImageCache(size_t capacity) : capacity_(capacity), size_(0) {}
+
+  /*! \brief copy the image of index into img, false if it is not cached */
+  bool Get(uint64_t index, cv::Mat* img) const {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = images_.find(index);
+    if (it == images_.end()) return false;
+    // the augmenters may write into their source
+    it->second.copyTo(*img);
+    return true;
+  }
+
+  /*! \brief cache a copy of img, unless the cache is full */
+  void Put(uint64_t index, const cv::Mat& img) {
+    const size_t bytes = img.total() * img.elemSize();
+    std::lock_guard<std::mutex> lk(mu_);
+    if (size_ + bytes > capacity_ || images_.count(index)) return;
+    images_[index] = img.clone();
+    size_ += bytes;
+  }
+
+ private:
+  const size_t capacity_;
+  size_t size_;
+  std::unordered_map<uint64_t, cv::Mat> images_;
+  mutable std::mutex mu_;
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_USE_OPENCV
+#endif  // MXNET_IO_IMAGE_DECODE_CACHE_H_
@@ -0,0 +1,227 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file image_decode_gpu.cu
+ * \brief batched nvJPEG decoding and augmentation of images on a gpu
+ */
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <type_traits>
+#include "./image_decode_gpu.h"
+#include "../common/cuda_utils.h"
+#include "../operator/mxnet_op.h"
+
+#if MXNET_USE_NVJPEG
+namespace mxnet {
+namespace io {
+
+/*!
+ * \brief one value of the batch per thread, sampled bilinearly from the
+ *  interleaved decoded pixels, then normalized
+ */
+struct gpu_image_augment {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const uint8_t* src,
+                                  const GPUImageAug* augs, int channels, int height,
+                                  int width, GPUImageNorm norm, bool normalize) {
+    const int x = i % width;
+    int t = i / width;
+    const int y = t % height;
+    t /= height;
+    const int k = t % channels;
+    const GPUImageAug& a = augs[t / channels];
+    const int rx = a.crop_x + (a.mirror ? width - 1 - x : x);
+    const int ry = a.crop_y + y;
+    // pixel centers of the resized image in the decoded one
+    float sx = (rx + 0.5f) * a.src_w / a.resize_w - 0.5f;
+    float sy = (ry + 0.5f) * a.src_h / a.resize_h - 0.5f;
+    sx = fminf(fmaxf(sx, 0.0f), a.src_w - 1);
+    sy = fminf(fmaxf(sy, 0.0f), a.src_h - 1);
+    const int x0 = static_cast<int>(sx), y0 = static_cast<int>(sy);
+    const int x1 = min(x0 + 1, a.src_w - 1), y1 = min(y0 + 1, a.src_h - 1);
+    const float fx = sx - x0, fy = sy - y0;
+    const uint8_t* img = src + a.offset;
+    const int stride = a.src_w * channels;
+    const float top = img[y0 * stride + x0 * channels + k] * (1 - fx)
+                      + img[y0 * stride + x1 * channels + k] * fx;
+    const float bottom = img[y1 * stride + x0 * channels + k] * (1 - fx)
+                         + img[y1 * stride + x1 * channels + k] * fx;
+    float v = top * (1 - fy) + bottom * fy;
+    if (normalize) {
+      // as the cpu parser does, see ImageRecordIOParser2::ParseChunk
+      if (norm.has_mean) {
+        v = (v - norm.mean[k]) * a.contrast + a.illumination;
+      } else {
+        v *= norm.scale;
+      }
+    } else {
+      v = roundf(v);
+    }
+    out[i] = DType(v);
+  }
+};
+
+GPUImageDecoder::GPUImageDecoder(int dev_id, const TShape& data_shape,
+                                 const DefaultImageAugmentParam& aug_param,
+                                 const ImageNormalizeParam& normalize_param)
+  : dev_id_(dev_id), data_shape_(data_shape), aug_param_(aug_param),
+    normalize_param_(normalize_param), batch_size_(0) {
+  CHECK(data_shape[0] == 1 || data_shape[0] == 3)
+    << "gpu_decode decodes gray or RGB images, not " << data_shape[0] << " channels";
+  CHECK(aug_param.max_rotate_angle == 0 && aug_param.rotate <= 0 &&
+        aug_param.max_aspect_ratio == 0.0f && aug_param.max_shear_ratio == 0.0f &&
+        aug_param.max_crop_size == -1 && aug_param.min_crop_size == -1 &&
+        aug_param.max_random_scale == 1.0f && aug_param.min_random_scale == 1.0f &&
+        aug_param.max_img_size == 1e10f && aug_param.min_img_size == 0.0f &&
+        aug_param.random_h == 0 && aug_param.random_s == 0 && aug_param.random_l == 0 &&
+        aug_param.pad == 0)
+    << "gpu_decode only supports the resize, rand_crop and mirror augmentations";
+  CHECK_EQ(normalize_param.mean_img.length(), 0U)
+    << "gpu_decode does not support mean_img, use mean_r, mean_g and mean_b";
+  norm_.mean[0] = normalize_param.mean_r;
+  norm_.mean[1] = data_shape[0] == 3 ? normalize_param.mean_g : 0.0f;
+  norm_.mean[2] = normalize_param.mean_b;
+  norm_.mean[3] = 0.0f;
+  norm_.has_mean = normalize_param.mean_r > 0.0f || normalize_param.mean_g > 0.0f ||
+                   normalize_param.mean_b > 0.0f;
+  norm_.scale = normalize_param.scale;
+  mshadow::SetDevice<gpu>(dev_id_);
+  stream_ = mshadow::NewStream<gpu>(false, false);
+  NVJPEG_CALL(nvjpegCreate(NVJPEG_BACKEND_DEFAULT, nullptr, &handle_));
+  NVJPEG_CALL(nvjpegJpegStateCreate(handle_, &state_));
+  decoded_.size = 0;
+  augs_.size = 0;
+}
+
+GPUImageDecoder::~GPUImageDecoder() {
+  mshadow::SetDevice<gpu>(dev_id_);
+  if (decoded_.size != 0) Storage::Get()->Free(decoded_);
+  if (augs_.size != 0) Storage::Get()->Free(augs_);
+  nvjpegJpegStateDestroy(state_);
+  nvjpegDestroy(handle_);
+  mshadow::DeleteStream<gpu>(stream_);
+}
+
+void GPUImageDecoder::Reserve(Storage::Handle* buf, size_t bytes) {
+  if (buf->size >= bytes) return;
+  if (buf->size != 0) Storage::Get()->Free(*buf);
+  *buf = Storage::Get()->Alloc(bytes, Context::GPU(dev_id_));
+}
+
+GPUImageAug GPUImageDecoder::Choose(int src_w, int src_h, common::RANDOM_ENGINE* prnd) const {
+  GPUImageAug a;
+  a.src_w = src_w;
+  a.src_h = src_h;
+  // the same choices as DefaultImageAugmenter and the cpu parser
+  if (aug_param_.resize != -1) {
+    if (src_h > src_w) {
+      a.resize_h = aug_param_.resize * src_h / src_w;
+      a.resize_w = aug_param_.resize;
+    } else {
+      a.resize_h = aug_param_.resize;
+      a.resize_w = aug_param_.resize * src_w / src_h;
+    }
+  } else {
+    a.resize_w = src_w;
+    a.resize_h = src_h;
+  }
+  const int height = data_shape_[1], width = data_shape_[2];
+  CHECK(a.resize_h >= height && a.resize_w >= width)
+    << "input image size smaller than input shape";
+  a.crop_y = a.resize_h - height;
+  a.crop_x = a.resize_w - width;
+  if (aug_param_.rand_crop) {
+    a.crop_y = std::uniform_int_distribution<int>(0, a.crop_y)(*prnd);
+    a.crop_x = std::uniform_int_distribution<int>(0, a.crop_x)(*prnd);
+  } else {
+    a.crop_y /= 2;
+    a.crop_x /= 2;
+  }
+  std::uniform_real_distribution<float> rand_uniform(0, 1);
+  std::bernoulli_distribution coin_flip(0.5);
+  a.mirror = (normalize_param_.rand_mirror && coin_flip(*prnd)) || normalize_param_.mirror;
+  a.contrast = (rand_uniform(*prnd) * normalize_param_.max_random_contrast * 2
+                - normalize_param_.max_random_contrast + 1) * normalize_param_.scale;
+  a.illumination = (rand_uniform(*prnd) * normalize_param_.max_random_illumination * 2
+                    - normalize_param_.max_random_illumination) * normalize_param_.scale;
+  return a;
+}
+
+void GPUImageDecoder::Decode(const std::vector<const uint8_t*>& images,
+                             const std::vector<size_t>& sizes,
+                             common::RANDOM_ENGINE* prnd, const TBlob& out) {
+  using namespace mxnet_op;
+  const int n = images.size();
+  if (n == 0) return;
+  CHECK_EQ(out.dev_mask(), gpu::kDevMask);
+  CHECK_GE(out.shape_[0], static_cast<index_t>(n));
+  mshadow::SetDevice<gpu>(dev_id_);
+  const int channels = data_shape_[0];
+  const nvjpegOutputFormat_t format = channels == 3 ? NVJPEG_OUTPUT_RGBI : NVJPEG_OUTPUT_Y;
+  // the sizes from the headers, to lay out the decoded images and choose the crops
+  std::vector<GPUImageAug> augs(n);
+  size_t total = 0;
+  for (int i = 0; i < n; ++i) {
+    int ncomp;
+    nvjpegChromaSubsampling_t subsampling;
+    int widths[NVJPEG_MAX_COMPONENT], heights[NVJPEG_MAX_COMPONENT];
+    NVJPEG_CALL(nvjpegGetImageInfo(handle_, images[i], sizes[i], &ncomp, &subsampling,
+                                   widths, heights));
+    augs[i] = Choose(widths[0], heights[0], prnd);
+    augs[i].offset = total;
+    // keep the images 256 bytes aligned in the buffer
+    total += (static_cast<size_t>(widths[0]) * heights[0] * channels + 255) / 256 * 256;
+  }
+  Reserve(&decoded_, total);
+  Reserve(&augs_, n * sizeof(GPUImageAug));
+  uint8_t* decoded = static_cast<uint8_t*>(decoded_.dptr);
+  std::vector<nvjpegImage_t> dst(n);
+  for (int i = 0; i < n; ++i) {
+    std::fill(dst[i].channel, dst[i].channel + NVJPEG_MAX_COMPONENT, nullptr);
+    std::fill(dst[i].pitch, dst[i].pitch + NVJPEG_MAX_COMPONENT, 0);
+    dst[i].channel[0] = decoded + augs[i].offset;
+    dst[i].pitch[0] = augs[i].src_w * channels;
+  }
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(stream_);
+  if (batch_size_ != n) {
+    NVJPEG_CALL(nvjpegDecodeBatchedInitialize(handle_, state_, n, 1, format));
+    batch_size_ = n;
+  }
+  NVJPEG_CALL(nvjpegDecodeBatched(handle_, state_, images.data(), sizes.data(),
+                                  dst.data(), stream));
+  GPUImageAug* dev_augs = static_cast<GPUImageAug*>(augs_.dptr);
+  CUDA_CALL(cudaMemcpyAsync(dev_augs, augs.data(), n * sizeof(GPUImageAug),
+                            cudaMemcpyHostToDevice, stream));
+  const int image_size = channels * data_shape_[1] * data_shape_[2];
+  MSHADOW_TYPE_SWITCH(out.type_flag_, DType, {
+    Kernel<gpu_image_augment, gpu>::Launch(
+      stream_, n * image_size, out.dptr<DType>(), static_cast<const uint8_t*>(decoded),
+      static_cast<const GPUImageAug*>(dev_augs), channels,
+      static_cast<int>(data_shape_[1]), static_cast<int>(data_shape_[2]), norm_,
+      !std::is_same<DType, uint8_t>::value);
+  });
+  CHECK_CUDA_ERROR("gpu_image_augment");
+  stream_->Wait();
+}
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_USE_NVJPEG
@@ -0,0 +1,117 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file image_decode_gpu.h
+ * \brief batched nvJPEG decoding and augmentation of images on a gpu
+ */
+#ifndef MXNET_IO_IMAGE_DECODE_GPU_H_
+#define MXNET_IO_IMAGE_DECODE_GPU_H_
+
+#include <mxnet/base.h>
+#include <mxnet/storage.h>
+#include <mxnet/tensor_blob.h>
+#include <cstdint>
+#include <vector>
+#include "./image_aug_default.h"
+#include "./image_iter_common.h"
+#include "../common/utils.h"
+
+#if MXNET_USE_CUDA && MXNET_USE_NVJPEG
+#include <nvjpeg.h>
+
+/*!
+ * \brief Protected nvJPEG call.
+ * \param func Expression to call.
+ */
+#define NVJPEG_CALL(func)                                          \
+  {                                                                \
+    nvjpegStatus_t e = (func);                                     \
+    CHECK_EQ(e, NVJPEG_STATUS_SUCCESS) << "nvJPEG: error " << e;   \
+  }
+
+namespace mxnet {
+namespace io {
+
+/*! \brief the augmentation of one image of a batch, chosen on the host */
+struct GPUImageAug {
+  /*! \brief the offset of the decoded interleaved pixels in the decode buffer */
+  size_t offset;
+  /*! \brief the decoded size */
+  int src_w, src_h;
+  /*! \brief the size after the resize of the shorter edge */
+  int resize_w, resize_h;
+  /*! \brief the top left corner of the crop in the resized image */
+  int crop_x, crop_y;
+  int mirror;
+  /*! \brief the contrast, scale included, and the illumination of the normalization */
+  float contrast, illumination;
+};
+
+/*! \brief the normalization shared by the images of a batch */
+struct GPUImageNorm {
+  float mean[4];
+  bool has_mean;
+  float scale;
+};
+
+/*!
+ * \brief decodes batches of JPEG images with nvJPEG on a gpu, then resizes,
+ *  crops, mirrors and normalizes them into the (batch, channel, height,
+ *  width) data of a batch with one kernel. It is used by the prefetching
+ *  thread of an iterator only.
+ */
+class GPUImageDecoder {
+ public:
+  GPUImageDecoder(int dev_id, const TShape& data_shape,
+                  const DefaultImageAugmentParam& aug_param,
+                  const ImageNormalizeParam& normalize_param);
+  ~GPUImageDecoder();
+  /*!
+   * \brief decode the images[i] of sizes[i] bytes into the i-th image of out,
+   *  and wait for the results
+   * \param prnd the random engine of the crops, the mirrors and the normalization
+   */
+  void Decode(const std::vector<const uint8_t*>& images, const std::vector<size_t>& sizes,
+              common::RANDOM_ENGINE* prnd, const TBlob& out);
+
+ private:
+  /*! \brief choose the augmentation of an image of src_w x src_h */
+  GPUImageAug Choose(int src_w, int src_h, common::RANDOM_ENGINE* prnd) const;
+  /*! \brief make the device buffer hold bytes at least */
+  void Reserve(Storage::Handle* buf, size_t bytes);
+
+  int dev_id_;
+  TShape data_shape_;
+  DefaultImageAugmentParam aug_param_;
+  ImageNormalizeParam normalize_param_;
+  GPUImageNorm norm_;
+  mshadow::Stream<gpu>* stream_;
+  nvjpegHandle_t handle_;
+  nvjpegJpegState_t state_;
+  /*! \brief the batch size nvjpegDecodeBatchedInitialize was called for */
+  int batch_size_;
+  /*! \brief the decoded images and the augmentations on the device */
+  Storage::Handle decoded_, augs_;
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_USE_CUDA && MXNET_USE_NVJPEG
+#endif  // MXNET_IO_IMAGE_DECODE_GPU_H_
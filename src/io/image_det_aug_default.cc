@@ -30,6 +30,13 @@
 #include "./image_augmenter.h"
 #include "../common/utils.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MXNET_IO_DET_AUG_SIMD 1
+#include <immintrin.h>
+#else
+#define MXNET_IO_DET_AUG_SIMD 0
+#endif
+
 namespace mxnet {
 namespace io {
 
@@ -208,6 +215,102 @@ using Rect = cv::Rect_<float>;
 #define M_PI CV_PI
 #endif
 
+/*! \brief the corners and areas of the crop boxes of a sampler, one array per field */
+struct CropBoxes {
+  std::vector<float> left, top, right, bottom, area;
+
+  explicit CropBoxes(const std::vector<Rect>& boxes) {
+    for (const Rect& r : boxes) {
+      left.push_back(r.x);
+      top.push_back(r.y);
+      right.push_back(r.x + r.width);
+      bottom.push_back(r.y + r.height);
+      area.push_back(r.area());
+    }
+  }
+  size_t Size() const { return left.size(); }
+};
+
+/*!
+ * \brief the [min, max] ranges a crop box must meet with an object: the IoU,
+ *  the part of the crop box covered and the part of the object covered
+ */
+struct CropRanges {
+  float min_overlap, max_overlap;
+  float min_sample_coverage, max_sample_coverage;
+  float min_object_coverage, max_object_coverage;
+};
+
+/*! \brief mark the boxes from begin meeting the ranges with gt in valid */
+inline void MarkValidCrops(const CropBoxes& boxes, size_t begin, const Rect& gt,
+                           const CropRanges& c, uint8_t* valid) {
+  const float gt_right = gt.x + gt.width, gt_bottom = gt.y + gt.height;
+  const float gt_area = gt.area();
+  for (size_t i = begin; i < boxes.Size(); ++i) {
+    const float w = std::min(boxes.right[i], gt_right) - std::max(boxes.left[i], gt.x);
+    const float h = std::min(boxes.bottom[i], gt_bottom) - std::max(boxes.top[i], gt.y);
+    const float inter = w > 0.f && h > 0.f ? w * h : 0.f;
+    const float iou = inter > 0.f ? inter / (boxes.area[i] + gt_area - inter) : 0.f;
+    const float sample_coverage = inter / boxes.area[i];
+    const float object_coverage = inter / gt_area;
+    valid[i] |= iou >= c.min_overlap && iou <= c.max_overlap &&
+                sample_coverage >= c.min_sample_coverage &&
+                sample_coverage <= c.max_sample_coverage &&
+                object_coverage >= c.min_object_coverage &&
+                object_coverage <= c.max_object_coverage;
+  }
+}
+
+#if MXNET_IO_DET_AUG_SIMD
+inline bool HasAVX() {
+  static const bool avx = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+  }();
+  return avx;
+}
+
+/*! \brief MarkValidCrops 8 boxes at a time, return the boxes left to mark */
+__attribute__((target("avx")))
+inline size_t MarkValidCropsAVX(const CropBoxes& boxes, const Rect& gt, const CropRanges& c,
+                                uint8_t* valid) {
+  const __m256 gl = _mm256_set1_ps(gt.x), gt_ = _mm256_set1_ps(gt.y);
+  const __m256 gr = _mm256_set1_ps(gt.x + gt.width), gb = _mm256_set1_ps(gt.y + gt.height);
+  const __m256 ga = _mm256_set1_ps(gt.area());
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 min_ovp = _mm256_set1_ps(c.min_overlap), max_ovp = _mm256_set1_ps(c.max_overlap);
+  const __m256 min_sc = _mm256_set1_ps(c.min_sample_coverage);
+  const __m256 max_sc = _mm256_set1_ps(c.max_sample_coverage);
+  const __m256 min_oc = _mm256_set1_ps(c.min_object_coverage);
+  const __m256 max_oc = _mm256_set1_ps(c.max_object_coverage);
+  size_t i = 0;
+  for (; i + 8 <= boxes.Size(); i += 8) {
+    const __m256 area = _mm256_loadu_ps(&boxes.area[i]);
+    const __m256 w = _mm256_sub_ps(_mm256_min_ps(_mm256_loadu_ps(&boxes.right[i]), gr),
+                                   _mm256_max_ps(_mm256_loadu_ps(&boxes.left[i]), gl));
+    const __m256 h = _mm256_sub_ps(_mm256_min_ps(_mm256_loadu_ps(&boxes.bottom[i]), gb),
+                                   _mm256_max_ps(_mm256_loadu_ps(&boxes.top[i]), gt_));
+    const __m256 overlapped = _mm256_and_ps(_mm256_cmp_ps(w, zero, _CMP_GT_OQ),
+                                            _mm256_cmp_ps(h, zero, _CMP_GT_OQ));
+    const __m256 inter = _mm256_and_ps(overlapped, _mm256_mul_ps(w, h));
+    const __m256 iou = _mm256_and_ps(
+        _mm256_cmp_ps(inter, zero, _CMP_GT_OQ),
+        _mm256_div_ps(inter, _mm256_sub_ps(_mm256_add_ps(area, ga), inter)));
+    const __m256 sc = _mm256_div_ps(inter, area);
+    const __m256 oc = _mm256_div_ps(inter, ga);
+    __m256 ok = _mm256_and_ps(_mm256_cmp_ps(iou, min_ovp, _CMP_GE_OQ),
+                              _mm256_cmp_ps(iou, max_ovp, _CMP_LE_OQ));
+    ok = _mm256_and_ps(ok, _mm256_and_ps(_mm256_cmp_ps(sc, min_sc, _CMP_GE_OQ),
+                                         _mm256_cmp_ps(sc, max_sc, _CMP_LE_OQ)));
+    ok = _mm256_and_ps(ok, _mm256_and_ps(_mm256_cmp_ps(oc, min_oc, _CMP_GE_OQ),
+                                         _mm256_cmp_ps(oc, max_oc, _CMP_LE_OQ)));
+    const int mask = _mm256_movemask_ps(ok);
+    for (int k = 0; k < 8; ++k) valid[i + k] |= (mask >> k) & 1;
+  }
+  return i;
+}
+#endif  // MXNET_IO_DET_AUG_SIMD
+
 /*! \brief helper class for better detection label handling */
 class ImageDetLabel {
  public:
@@ -294,58 +397,47 @@ class ImageDetLabel {
     return out;
   }
 
-  /*! \brief Intersection over Union between two rects */
-  static float RectIOU(Rect a, Rect b) {
-    float intersect = (a & b).area();
-    if (intersect <= 0.f) return 0.f;
-    return intersect / (a.area() + b.area() - intersect);
-  }
-
-  /*! \brief try crop image with given crop_box
-   * return false if fail to meet any of the constraints
-   * convert all objects if success
+  /*!
+   * \brief try the crop boxes in order, a box is valid if it meets the
+   *  constraints with one of the objects, when all of them are set. Convert
+   *  all objects by the first valid box that keeps an object.
+   * \return the index of that box, -1 if there is none
    */
-  bool TryCrop(const Rect crop_box,
-    const float min_crop_overlap, const float max_crop_overlap,
-    const float min_crop_sample_coverage, const float max_crop_sample_coverage,
-    const float min_crop_object_coverage, const float max_crop_object_coverage,
-    const int crop_emit_mode, const float emit_overlap_thresh) {
+  int TryCrops(const std::vector<Rect>& crop_boxes, const CropRanges& c,
+               const int crop_emit_mode, const float emit_overlap_thresh) {
+    if (crop_boxes.empty()) return -1;
     if (objects_.size() < 1) {
-      return true;  // no object, raise error or just skip?
+      return 0;  // no object, raise error or just skip?
     }
-    // check if crop_box valid
-    bool valid = false;
-    if (min_crop_overlap > 0.f && max_crop_overlap < 1.f &&
-        min_crop_sample_coverage > 0.f && max_crop_sample_coverage < 1.f &&
-        min_crop_object_coverage > 0.f && max_crop_object_coverage < 1.f) {
+    std::vector<uint8_t> valid(crop_boxes.size(), 1);
+    if (c.min_overlap > 0.f && c.max_overlap < 1.f &&
+        c.min_sample_coverage > 0.f && c.max_sample_coverage < 1.f &&
+        c.min_object_coverage > 0.f && c.max_object_coverage < 1.f) {
+      // all the boxes against each object at once
+      std::fill(valid.begin(), valid.end(), 0);
+      const CropBoxes boxes(crop_boxes);
       for (auto& obj : objects_) {
-        Rect gt_box = obj.ToRect();
-        if (min_crop_overlap > 0.f || max_crop_overlap < 1.f) {
-          float ovp = RectIOU(crop_box, gt_box);
-          if (ovp < min_crop_overlap || ovp > max_crop_overlap) {
-            continue;
-          }
-        }
-        if (min_crop_sample_coverage > 0.f || max_crop_sample_coverage < 1.f) {
-          float c = (crop_box & gt_box).area() / crop_box.area();
-          if (c < min_crop_sample_coverage || c > max_crop_sample_coverage) {
-            continue;
-          }
-        }
-        if (min_crop_object_coverage > 0.f || max_crop_object_coverage < 1.f) {
-          float c = (crop_box & gt_box).area() / gt_box.area();
-          if (c < min_crop_object_coverage || c > max_crop_object_coverage) {
-            continue;
-          }
-        }
-        valid = true;
-        break;
+        const Rect gt_box = obj.ToRect();
+        size_t begin = 0;
+#if MXNET_IO_DET_AUG_SIMD
+        if (HasAVX()) begin = MarkValidCropsAVX(boxes, gt_box, c, valid.data());
+#endif
+        MarkValidCrops(boxes, begin, gt_box, c, valid.data());
       }
-    } else {
-      valid = true;
     }
+    for (size_t i = 0; i < crop_boxes.size(); ++i) {
+      if (valid[i] && TryEmit(crop_boxes[i], crop_emit_mode, emit_overlap_thresh)) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
 
-    if (!valid) return false;
+  /*!
+   * \brief convert the objects kept by crop_box
+   * \return false, leaving the objects, if none is kept
+   */
+  bool TryEmit(const Rect crop_box, const int crop_emit_mode, const float emit_overlap_thresh) {
     // transform ground-truth labels
     std::vector<ImageDetObject> new_objects;
     for (auto iter = objects_.begin(); iter != objects_.end(); ++iter) {
@@ -604,28 +696,30 @@ class DefaultImageDetAugmenter : public ImageAugmenter {
           indices[i] = i;
         }
         std::shuffle(indices.begin(), indices.end(), *prnd);
-        int num_processed = 0;
         for (auto idx : indices) {
-          if (num_processed > 0) break;
+          // sample all the trials of the sampler, then check them together
+          crop_boxes_.clear();
           for (int t = 0; t < param_.max_crop_trials[idx]; ++t) {
-            Rect crop_box = GenerateCropBox(param_.min_crop_scales[idx],
+            crop_boxes_.push_back(GenerateCropBox(param_.min_crop_scales[idx],
               param_.max_crop_scales[idx], param_.min_crop_aspect_ratios[idx],
               param_.max_crop_aspect_ratios[idx], prnd,
-              static_cast<float>(res.cols) / res.rows);
-            if (det_label.TryCrop(crop_box, param_.min_crop_overlaps[idx],
-                param_.max_crop_overlaps[idx], param_.min_crop_sample_coverages[idx],
-                param_.max_crop_sample_coverages[idx], param_.min_crop_object_coverages[idx],
-                param_.max_crop_object_coverages[idx], param_.crop_emit_mode,
-                param_.emit_overlap_thresh)) {
-              ++num_processed;
-              // crop image
-              int left = static_cast<int>(crop_box.x * res.cols);
-              int top = static_cast<int>(crop_box.y * res.rows);
-              int width = static_cast<int>(crop_box.width * res.cols);
-              int height = static_cast<int>(crop_box.height * res.rows);
-              res = res(cv::Rect(left, top, width, height));
-              break;
-            }
+              static_cast<float>(res.cols) / res.rows));
+          }
+          const CropRanges ranges = {
+            param_.min_crop_overlaps[idx], param_.max_crop_overlaps[idx],
+            param_.min_crop_sample_coverages[idx], param_.max_crop_sample_coverages[idx],
+            param_.min_crop_object_coverages[idx], param_.max_crop_object_coverages[idx]};
+          const int t = det_label.TryCrops(crop_boxes_, ranges, param_.crop_emit_mode,
+                                           param_.emit_overlap_thresh);
+          if (t >= 0) {
+            // crop image
+            const Rect& crop_box = crop_boxes_[t];
+            int left = static_cast<int>(crop_box.x * res.cols);
+            int top = static_cast<int>(crop_box.y * res.rows);
+            int width = static_cast<int>(crop_box.width * res.cols);
+            int height = static_cast<int>(crop_box.height * res.rows);
+            res = res(cv::Rect(left, top, width, height));
+            break;
           }
         }
       }
@@ -671,6 +765,8 @@ class DefaultImageDetAugmenter : public ImageAugmenter {
  private:
   // temporal space
   cv::Mat temp_;
+  // the crop boxes of a sampler
+  std::vector<Rect> crop_boxes_;
   // parameters
   DefaultImageDetAugmentParam param_;
 };
@@ -34,8 +34,11 @@
 #include <nnvm/tuple.h>
 
 #include <fstream>
+#include <string>
+#include <vector>
 
 #include "../operator/elemwise_op_common.h"
+#include "../operator/half_cpu.h"
 
 #if MXNET_USE_OPENCV
   #include <opencv2/opencv.hpp>
@@ -265,28 +268,74 @@ inline bool ResizeShape(const nnvm::NodeAttrs& attrs,
                         std::vector<TShape> *ishape,
                         std::vector<TShape> *oshape) {
   const auto& param = nnvm::get<ResizeParam>(attrs.parsed);
-  if (ishape->size() != 1 || (*ishape)[0].ndim() != 3) return false;
+  if (ishape->size() != 1) return false;
+  const TShape& shape = (*ishape)[0];
+  if (shape.ndim() != 3 && shape.ndim() != 4) return false;
 
   oshape->clear();
-  oshape->push_back(mshadow::Shape3(param.h, param.w, (*ishape)[0][2]));
+  if (shape.ndim() == 3) {
+    oshape->push_back(mshadow::Shape3(param.h, param.w, shape[2]));
+  } else {
+    oshape->push_back(mshadow::Shape4(shape[0], param.h, param.w, shape[3]));
+  }
   return true;
 }
 
+#if MXNET_USE_OPENCV
+/*!
+ * \brief split an image, or a batch of images with the shape (n, h, w, c), into
+ *  the number of images, and the height, the width and the channels of each
+ */
+inline int ImageDims(const TShape& shape, int* h, int* w, int* c) {
+  const int n = shape.ndim() == 4 ? shape[0] : 1;
+  *h = shape[shape.ndim() - 3];
+  *w = shape[shape.ndim() - 2];
+  *c = shape[shape.ndim() - 1];
+  return n;
+}
+
+void ResizeImage(const ResizeParam& param, int type_flag, int ih, int iw, int c,
+                 void* in, void* out) {
+  const int DTYPE[] = {CV_32F, CV_64F, -1, CV_8U, CV_32S};
+  if (type_flag == mshadow::kFloat16) {
+    // opencv has no fp16 resize, the image is resized in fp32
+    using mshadow::half::half_t;
+    const int cv_type = CV_MAKETYPE(CV_32F, c);
+    cv::Mat buf(ih, iw, cv_type);
+    cv::Mat dst(param.h, param.w, cv_type);
+    op::half_cpu::HalfToFloat(static_cast<half_t*>(in), buf.ptr<float>(), buf.total() * c);
+    cv::resize(buf, dst, cv::Size(param.w, param.h), 0, 0, param.interp);
+    CHECK(dst.isContinuous());
+    op::half_cpu::FloatToHalf(dst.ptr<float>(), static_cast<half_t*>(out), dst.total() * c);
+    return;
+  }
+  int cv_type = CV_MAKETYPE(DTYPE[type_flag], c);
+  cv::Mat buf(ih, iw, cv_type, in);
+  cv::Mat dst(param.h, param.w, cv_type, out);
+  cv::resize(buf, dst, cv::Size(param.w, param.h), 0, 0, param.interp);
+  CHECK(!dst.empty());
+  CHECK_EQ(static_cast<void*>(dst.ptr()), out);
+}
+#endif  // MXNET_USE_OPENCV
+
 inline void Imresize(const nnvm::NodeAttrs& attrs,
                      const OpContext &ctx,
                      const std::vector<TBlob> &inputs,
                      const std::vector<OpReqType> &req,
                      const std::vector<TBlob> &outputs) {
 #if MXNET_USE_OPENCV
-  CHECK_NE(inputs[0].type_flag_, mshadow::kFloat16) << "imresize doesn't support fp16";
-  const int DTYPE[] = {CV_32F, CV_64F, -1, CV_8U, CV_32S};
-  int cv_type = CV_MAKETYPE(DTYPE[inputs[0].type_flag_], inputs[0].shape_[2]);
   const auto& param = nnvm::get<ResizeParam>(attrs.parsed);
-  cv::Mat buf(inputs[0].shape_[0], inputs[0].shape_[1], cv_type, inputs[0].dptr_);
-  cv::Mat dst(outputs[0].shape_[0], outputs[0].shape_[1], cv_type, outputs[0].dptr_);
-  cv::resize(buf, dst, cv::Size(param.w, param.h), 0, 0, param.interp);
-  CHECK(!dst.empty());
-  CHECK_EQ(static_cast<void*>(dst.ptr()), outputs[0].dptr_);
+  int ih, iw, c;
+  const int n = ImageDims(inputs[0].shape_, &ih, &iw, &c);
+  const size_t esize = mshadow::mshadow_sizeof(inputs[0].type_flag_);
+  const size_t isize = esize * ih * iw * c, osize = esize * param.h * param.w * c;
+  char* in = static_cast<char*>(inputs[0].dptr_);
+  char* out = static_cast<char*>(outputs[0].dptr_);
+  // the images of a batch are resized in parallel, in one engine operation
+  #pragma omp parallel for if (n > 1)
+  for (int i = 0; i < n; ++i) {
+    ResizeImage(param, inputs[0].type_flag_, ih, iw, c, in + i * isize, out + i * osize);
+  }
 #else
   LOG(FATAL) << "Build with USE_OPENCV=1 for image io.";
 #endif  // MXNET_USE_OPENCV
@@ -324,35 +373,190 @@ inline bool MakeBorderShape(const nnvm::NodeAttrs& attrs,
                         std::vector<TShape> *ishape,
                         std::vector<TShape> *oshape) {
   const auto& param = nnvm::get<MakeBorderParam>(attrs.parsed);
-  if (ishape->size() != 1 || (*ishape)[0].ndim() != 3) return false;
+  if (ishape->size() != 1) return false;
+  TShape shape = (*ishape)[0];
+  if (shape.ndim() != 3 && shape.ndim() != 4) return false;
 
+  shape[shape.ndim() - 3] += param.top + param.bot;
+  shape[shape.ndim() - 2] += param.left + param.right;
   oshape->clear();
-  oshape->push_back(
-    mshadow::Shape3((*ishape)[0][0]+param.top+param.bot,
-                    (*ishape)[0][1]+param.left+param.right,
-                    (*ishape)[0][2]));
+  oshape->push_back(shape);
   return true;
 }
 
+#if MXNET_USE_OPENCV
+/*! \brief the fill color of a border, of values of cv_depth, fp16 as 16 bit integers */
+inline cv::Scalar BorderColor(const MakeBorderParam& param, int type_flag) {
+  cv::Scalar color(param.value, param.value, param.value);
+  if (param.values.ndim() > 0) {
+    color = cv::Scalar(cv::Vec<double, 4>(param.values.begin()));
+  }
+  if (type_flag == mshadow::kFloat16) {
+    for (int i = 0; i < 4; ++i) {
+      color[i] = mshadow::half::half_t(static_cast<float>(color[i])).half_;
+    }
+  }
+  return color;
+}
+#endif  // MXNET_USE_OPENCV
+
 inline void copyMakeBorder(const nnvm::NodeAttrs& attrs,
                            const OpContext &ctx,
                            const std::vector<TBlob> &inputs,
                            const std::vector<OpReqType> &req,
                            const std::vector<TBlob> &outputs) {
 #if MXNET_USE_OPENCV
-  CHECK_NE(inputs[0].type_flag_, mshadow::kFloat16) << "imresize doesn't support fp16";
-  const int DTYPE[] = {CV_32F, CV_64F, -1, CV_8U, CV_32S};
-  int cv_type = CV_MAKETYPE(DTYPE[inputs[0].type_flag_], inputs[0].shape_[2]);
+  // the border only copies the values, fp16 is copied as 16 bit integers
+  const int DTYPE[] = {CV_32F, CV_64F, CV_16U, CV_8U, CV_32S};
   const auto& param = nnvm::get<MakeBorderParam>(attrs.parsed);
-  cv::Mat buf(inputs[0].shape_[0], inputs[0].shape_[1], cv_type, inputs[0].dptr_);
-  cv::Mat dst(outputs[0].shape_[0], outputs[0].shape_[1], cv_type, outputs[0].dptr_);
-  cv::Scalar color(param.value, param.value, param.value);
-  if (param.values.ndim() > 0) {
-    color = cv::Scalar(cv::Vec<double, 4>(param.values.begin()));
+  int ih, iw, c;
+  const int n = ImageDims(inputs[0].shape_, &ih, &iw, &c);
+  const int oh = ih + param.top + param.bot, ow = iw + param.left + param.right;
+  int cv_type = CV_MAKETYPE(DTYPE[inputs[0].type_flag_], c);
+  const cv::Scalar color = BorderColor(param, inputs[0].type_flag_);
+  const size_t esize = mshadow::mshadow_sizeof(inputs[0].type_flag_);
+  char* in = static_cast<char*>(inputs[0].dptr_);
+  char* out = static_cast<char*>(outputs[0].dptr_);
+  #pragma omp parallel for if (n > 1)
+  for (int i = 0; i < n; ++i) {
+    cv::Mat buf(ih, iw, cv_type, in + i * esize * ih * iw * c);
+    cv::Mat dst(oh, ow, cv_type, out + i * esize * oh * ow * c);
+    cv::copyMakeBorder(buf, dst, param.top, param.bot, param.left, param.right, param.type,
+                       color);
+    CHECK_EQ(static_cast<void*>(dst.ptr()), out + i * esize * oh * ow * c);
   }
-  cv::copyMakeBorder(buf, dst, param.top, param.bot, param.left, param.right, param.type, color);
-  CHECK(!dst.empty());
-  CHECK_EQ(static_cast<void*>(dst.ptr()), outputs[0].dptr_);
+#else
+  LOG(FATAL) << "Build with USE_OPENCV=1 for image io.";
+#endif  // MXNET_USE_OPENCV
+}
+
+struct ImdecodeBatchParam : public dmlc::Parameter<ImdecodeBatchParam> {
+  int num_args;
+  int flag;
+  bool to_rgb;
+  int w, h, interp;
+  int top, bot, left, right;
+  int type;
+  nnvm::Tuple<double> values;
+  DMLC_DECLARE_PARAMETER(ImdecodeBatchParam) {
+    DMLC_DECLARE_FIELD(num_args)
+    .set_lower_bound(1)
+    .describe("Number of images.");
+    DMLC_DECLARE_FIELD(flag)
+    .set_lower_bound(0)
+    .set_default(1)
+    .describe("Convert decoded image to grayscale (0) or color (1).");
+    DMLC_DECLARE_FIELD(to_rgb)
+    .set_default(true)
+    .describe("Whether to convert decoded image to mxnet's default RGB format "
+              "(instead of opencv's default BGR).");
+    DMLC_DECLARE_FIELD(w)
+    .set_lower_bound(1)
+    .describe("Width of resized image.");
+    DMLC_DECLARE_FIELD(h)
+    .set_lower_bound(1)
+    .describe("Height of resized image.");
+    DMLC_DECLARE_FIELD(interp)
+    .set_default(1)
+    .describe("Interpolation method (default=cv2.INTER_LINEAR).");
+    DMLC_DECLARE_FIELD(top)
+    .set_default(0)
+    .describe("Top margin.");
+    DMLC_DECLARE_FIELD(bot)
+    .set_default(0)
+    .describe("Bottom margin.");
+    DMLC_DECLARE_FIELD(left)
+    .set_default(0)
+    .describe("Left margin.");
+    DMLC_DECLARE_FIELD(right)
+    .set_default(0)
+    .describe("Right margin.");
+    DMLC_DECLARE_FIELD(type)
+    .set_default(0)
+    .describe("Filling type (default=cv2.BORDER_CONSTANT).");
+    DMLC_DECLARE_FIELD(values)
+    .set_default({})
+    .describe("Fill with value(RGB[A] or gray), up to 4 channels.");
+  }
+};
+DMLC_REGISTER_PARAMETER(ImdecodeBatchParam);
+
+#if MXNET_USE_OPENCV
+/*!
+ * \brief decode an image, resize it to (h, w), convert it to rgb and pad it
+ *  into out, of the shape (h + top + bot, w + left + right, c)
+ * \return whether the image could be decoded
+ */
+bool DecodeResizePad(const ImdecodeBatchParam& param, const uint8_t* data, size_t size,
+                     uint8_t* out) {
+  const int cv_type = param.flag == 0 ? CV_8U : CV_8UC3;
+  const bool pad = param.top || param.bot || param.left || param.right;
+  cv::Mat buf(1, size, CV_8U, const_cast<uint8_t*>(data));
+  cv::Mat img = cv::imdecode(buf, param.flag);
+  if (img.empty()) return false;
+  cv::Mat dst(param.h + param.top + param.bot, param.w + param.left + param.right,
+              cv_type, out);
+  // without a border the image is resized straight into the batch
+  cv::Mat sized = pad ? cv::Mat() : dst;
+  if (img.rows == param.h && img.cols == param.w) {
+    sized = img;
+  } else {
+    cv::resize(img, sized, cv::Size(param.w, param.h), 0, 0, param.interp);
+  }
+  if (param.to_rgb && param.flag != 0) {
+    cv::cvtColor(sized, sized, CV_BGR2RGB);
+  }
+  if (pad) {
+    cv::Scalar color;
+    if (param.values.ndim() > 0) {
+      color = cv::Scalar(cv::Vec<double, 4>(param.values.begin()));
+    }
+    cv::copyMakeBorder(sized, dst, param.top, param.bot, param.left, param.right,
+                       param.type, color);
+  } else if (sized.data != dst.data) {
+    sized.copyTo(dst);
+  }
+  return dst.data == out;
+}
+#endif  // MXNET_USE_OPENCV
+
+void ImdecodeBatch(const nnvm::NodeAttrs& attrs,
+                   const std::vector<NDArray>& inputs,
+                   std::vector<NDArray>* outputs) {
+#if MXNET_USE_OPENCV
+  const auto& param = nnvm::get<ImdecodeBatchParam>(attrs.parsed);
+  const int n = inputs.size();
+  std::vector<Engine::VarHandle> vars;
+  for (const auto& in : inputs) {
+    CHECK_EQ(in.ctx().dev_mask(), cpu::kDevMask) << "Only supports cpu input";
+    CHECK_EQ(in.dtype(), mshadow::kUint8) << "Input needs to be uint8 buffer";
+    vars.push_back(in.var());
+  }
+  TShape oshape = mshadow::Shape4(n, param.h + param.top + param.bot,
+                                  param.w + param.left + param.right, param.flag == 0 ? 1 : 3);
+  NDArray& ndout = (*outputs)[0];
+  if (ndout.is_none()) {
+    ndout = NDArray(oshape, Context::CPU(), true, mshadow::kUint8);
+  } else {
+    CHECK_EQ(ndout.shape(), oshape) << "Output needs the shape of the decoded batch";
+    CHECK_EQ(ndout.dtype(), mshadow::kUint8) << "Output needs to be uint8";
+    CHECK_EQ(ndout.ctx().dev_mask(), cpu::kDevMask) << "Only supports cpu output";
+  }
+  // the images are decoded in parallel in one engine operation, into the batch
+  Engine::Get()->PushSync([inputs, ndout, param, n](RunContext ctx) {
+      uint8_t* out = ndout.data().dptr<uint8_t>();
+      const size_t isize = ndout.shape().Size() / n;
+      std::vector<char> ok(n);
+      #pragma omp parallel for
+      for (int i = 0; i < n; ++i) {
+        ok[i] = DecodeResizePad(param, inputs[i].data().dptr<uint8_t>(),
+                                inputs[i].shape().Size(), out + i * isize);
+      }
+      for (int i = 0; i < n; ++i) {
+        CHECK(ok[i]) << "Invalid image file " << i << ". Only supports png and jpg.";
+      }
+    }, ndout.ctx(), vars, {ndout.var()},
+    FnProperty::kNormal, 0, PROFILER_MESSAGE("ImdecodeBatch"));
 #else
   LOG(FATAL) << "Build with USE_OPENCV=1 for image io.";
 #endif  // MXNET_USE_OPENCV
@@ -369,6 +573,22 @@ NNVM_REGISTER_OP(_cvimdecode)
 .add_argument("buf", "NDArray", "Buffer containing binary encoded image")
 .add_arguments(ImdecodeParam::__FIELDS__());
 
+NNVM_REGISTER_OP(_cvimdecode_batch)
+.describe("Decode a batch of images with OpenCV in parallel, resize them to (h, w) and pad "
+          "them, into an NDArray of the shape (num_args, h + top + bot, w + left + right, "
+          "channels).\n"
+          "Note: return images in RGB by default, "
+          "instead of OpenCV's default BGR.")
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(nnvm::get<ImdecodeBatchParam>(attrs.parsed).num_args);
+  })
+.set_num_outputs(1)
+.set_attr_parser(op::ParamParser<ImdecodeBatchParam>)
+.set_attr<FNDArrayFunction>("FNDArrayFunction", ImdecodeBatch)
+.set_attr<std::string>("key_var_num_args", "num_args")
+.add_argument("bufs", "NDArray[]", "Buffers containing binary encoded images")
+.add_arguments(ImdecodeBatchParam::__FIELDS__());
+
 NNVM_REGISTER_OP(_cvimread)
 .describe("Read and decode image with OpenCV. \n"
           "Note: return image in RGB by default, "
@@ -380,7 +600,8 @@ NNVM_REGISTER_OP(_cvimread)
 .add_arguments(ImreadParam::__FIELDS__());
 
 NNVM_REGISTER_OP(_cvimresize)
-.describe("Resize image with OpenCV. \n")
+.describe("Resize image with OpenCV. \n"
+          "A batch of images of the shape (n, h, w, c) is resized in parallel.")
 .set_num_inputs(1)
 .set_num_outputs(1)
 .set_attr_parser(op::ParamParser<ResizeParam>)
@@ -391,7 +612,8 @@ NNVM_REGISTER_OP(_cvimresize)
 .add_arguments(ResizeParam::__FIELDS__());
 
 NNVM_REGISTER_OP(_cvcopyMakeBorder)
-.describe("Pad image border with OpenCV. \n")
+.describe("Pad image border with OpenCV. \n"
+          "A batch of images of the shape (n, h, w, c) is padded in parallel.")
 .set_num_inputs(1)
 .set_num_outputs(1)
 .set_attr_parser(op::ParamParser<MakeBorderParam>)
@@ -102,6 +102,8 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
   std::string path_imglist;
   /*! \brief path to image recordio */
   std::string path_imgrec;
+  /*! \brief path to the index of the image recordio */
+  std::string path_imgidx;
   /*! \brief a sequence of names of image augmenters, seperated by , */
   std::string aug_seq;
   /*! \brief label-width */
@@ -120,6 +122,16 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
   size_t shuffle_chunk_size;
   /*! \brief the seed for chunk shuffling*/
   int shuffle_chunk_seed;
+  /*! \brief whether to deal the chunks of the file to the parts anew every epoch */
+  bool shard_shuffle;
+  /*! \brief the size in MB of the cache of decoded images */
+  size_t cache_size;
+  /*! \brief the number of concurrent range reads of a path_imgrec on S3 or HDFS */
+  int remote_read_threads;
+  /*! \brief the number of chunks read ahead of the parsed one on S3 or HDFS */
+  int remote_readahead;
+  /*! \brief the number of retries of a failed range read */
+  int remote_read_retries;
 
   // declare parameters
   DMLC_DECLARE_PARAMETER(ImageRecParserParam) {
@@ -130,6 +142,11 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
     DMLC_DECLARE_FIELD(path_imgrec).set_default("")
         .describe("Path to the image RecordIO (.rec) file or a directory path. "\
                   "Created with tools/im2rec.py.");
+    DMLC_DECLARE_FIELD(path_imgidx).set_default("")
+        .describe("Path to the .idx of a local path_imgrec, written by tools/im2rec. "\
+                  "If set, the .rec file is memory mapped and its records are read "\
+                  "through the index, in a new random order every epoch if shuffle is "\
+                  "true, instead of in shuffled chunks.");
     DMLC_DECLARE_FIELD(aug_seq).set_default("aug_default")
         .describe("The augmenter names to represent"\
                   " sequence of augmenters to be applied, seperated by comma." \
@@ -151,6 +168,42 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
         .describe("The data shuffle buffer size in MB. Only valid if shuffle is true.");
     DMLC_DECLARE_FIELD(shuffle_chunk_seed).set_default(0)
         .describe("The random seed for shuffling");
+    DMLC_DECLARE_FIELD(shard_shuffle).set_default(false)
+        .describe("With path_imgidx, deal the chunks of records of the whole file to the "
+                  "num_parts parts in a new random order every epoch instead of reading "
+                  "a fixed range of the file. The order is computed from "
+                  "shuffle_chunk_seed and the epoch, which must be the same on all the "
+                  "workers. The records of a chunk are read together, in a random order "
+                  "if shuffle is true.");
+    DMLC_DECLARE_FIELD(cache_size).set_default(0)
+        .describe("The size in MB of a cache of the decoded images, after the resize "
+                  "of the shorter edge. The later epochs only run the random "
+                  "augmentations on the cached images. 0 disables the cache.");
+    DMLC_DECLARE_FIELD(remote_read_threads).set_default(8).set_lower_bound(0)
+        .describe("The number of concurrent range reads of the chunks of a path_imgrec "
+                  "file on S3 or HDFS, instead of one sequential stream. 0 reads with "
+                  "one stream. Not used with shuffle_chunk_size.");
+    DMLC_DECLARE_FIELD(remote_readahead).set_default(16).set_lower_bound(1)
+        .describe("The number of chunks of a path_imgrec file on S3 or HDFS read ahead "
+                  "of the parsed one, which bounds the memory of the reads.");
+    DMLC_DECLARE_FIELD(remote_read_retries).set_default(3).set_lower_bound(0)
+        .describe("The number of retries of a failed range read of a path_imgrec file on "
+                  "S3 or HDFS, each on a new connection.");
+  }
+};
+
+// gpu decoding parameters
+struct ImageGPUDecodeParam : public dmlc::Parameter<ImageGPUDecodeParam> {
+  /*! \brief the gpu decoding and augmenting the images, -1 for the cpu */
+  int gpu_decode;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(ImageGPUDecodeParam) {
+    DMLC_DECLARE_FIELD(gpu_decode).set_default(-1)
+        .describe("Decode the JPEG images in batches with nvJPEG and resize, crop, "
+                  "mirror and normalize them on this gpu, which then holds the data of "
+                  "the batches. Only the resize, rand_crop, mirror, rand_mirror and "
+                  "mean/scale/contrast/illumination normalizations are supported. "
+                  "-1 decodes on the cpu.");
   }
 };
 
@@ -309,6 +362,8 @@ struct PrefetcherParam : public dmlc::Parameter<PrefetcherParam> {
   size_t prefetch_buffer;
   /*! \brief data type */
   dmlc::optional<int> dtype;
+  /*! \brief the gpu the batches are copied to in the background */
+  int copy_to_gpu;
 
   // declare parameters
   DMLC_DECLARE_PARAMETER(PrefetcherParam) {
@@ -322,6 +377,10 @@ struct PrefetcherParam : public dmlc::Parameter<PrefetcherParam> {
       .add_enum("uint8", mshadow::kUint8)
       .set_default(dmlc::optional<int>())
       .describe("Output data type. ``None`` means no change.");
+    DMLC_DECLARE_FIELD(copy_to_gpu).set_default(-1)
+      .describe("Copy each batch to this gpu on the copy streams while the previous "
+                "batch is used, the batches are then on that gpu. -1 keeps them on "
+                "the cpu.");
   }
 };
 
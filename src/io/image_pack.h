@@ -0,0 +1,249 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file image_pack.h
+ * \brief write a decoded HWC uint8 image into a CHW slot of a batch
+ *
+ * The channels are swapped from the BGR(A) of OpenCV to RGB(A), the image
+ * is mirrored, normalized and cast to the type of the batch in one pass.
+ * The x86 version moves 8 pixels at a time with AVX2 and is chosen at
+ * runtime. The scalar version has no per-pixel branches, for the compilers
+ * to vectorize it on the other cpus.
+ */
+#ifndef MXNET_IO_IMAGE_PACK_H_
+#define MXNET_IO_IMAGE_PACK_H_
+
+#include <mshadow/base.h>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MXNET_IO_IMAGE_PACK_SIMD 1
+#include <immintrin.h>
+#else
+#define MXNET_IO_IMAGE_PACK_SIMD 0
+#endif
+
+namespace mxnet {
+namespace io {
+
+/*!
+ * \brief the normalization of PackImage, channel c of the output is
+ *  (input - mean[c]) * scale[c] + bias[c], in RGB(A) order
+ */
+struct PackParam {
+  float mean[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  float scale[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+  float bias[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  /*! \brief a CHW mean image of the input size subtracted instead of mean, if set */
+  const float* mean_img = nullptr;
+  /*! \brief whether to mirror the image horizontally */
+  bool mirror = false;
+};
+
+namespace pack {
+
+/*! \brief the rows of the output channels an input row is written to */
+template<typename DType>
+struct RowArgs {
+  int channels;
+  int cols;
+  /*! \brief the offset of the input channel of each output channel */
+  int src_offset[4];
+  const float* mean_row[4];
+  DType* dst_row[4];
+};
+
+template<typename DType, bool kMirror, bool kMeanImg>
+inline void PackRowScalar(const uint8_t* src, int begin, const RowArgs<DType>& r,
+                          const PackParam& p) {
+  for (int c = 0; c < r.channels; ++c) {
+    const uint8_t* s = src + r.src_offset[c];
+    const float* m = r.mean_row[c];
+    DType* d = r.dst_row[c];
+    const float mean = p.mean[c], scale = p.scale[c], bias = p.bias[c];
+    for (int x = begin; x < r.cols; ++x) {
+      const float v = (static_cast<float>(s[x * r.channels]) - (kMeanImg ? m[x] : mean)) *
+                      scale + bias;
+      d[kMirror ? r.cols - 1 - x : x] = static_cast<DType>(v);
+    }
+  }
+}
+
+template<typename DType>
+inline void PackRowScalar(const uint8_t* src, int begin, const RowArgs<DType>& r,
+                          const PackParam& p) {
+  if (p.mirror) {
+    if (p.mean_img != nullptr) {
+      PackRowScalar<DType, true, true>(src, begin, r, p);
+    } else {
+      PackRowScalar<DType, true, false>(src, begin, r, p);
+    }
+  } else {
+    if (p.mean_img != nullptr) {
+      PackRowScalar<DType, false, true>(src, begin, r, p);
+    } else {
+      PackRowScalar<DType, false, false>(src, begin, r, p);
+    }
+  }
+}
+
+#if MXNET_IO_IMAGE_PACK_SIMD
+inline bool HasAVX2() {
+  static const bool avx2 = [] {
+    __builtin_cpu_init();
+    // f16c is not known to __builtin_cpu_supports, the cpus with avx2 have it
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  }();
+  return avx2;
+}
+
+__attribute__((target("avx2,fma,f16c")))
+inline void StoreAVX2(float* dst, __m256 v) {
+  _mm256_storeu_ps(dst, v);
+}
+
+__attribute__((target("avx2,fma,f16c")))
+inline void StoreAVX2(mshadow::half::half_t* dst, __m256 v) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                   _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+}
+
+__attribute__((target("avx2,fma,f16c")))
+inline void StoreAVX2(uint8_t* dst, __m256 v) {
+  const __m256i i = _mm256_cvtps_epi32(v);
+  const __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(w, w));
+}
+
+/*!
+ * \brief pack the first pixels of a row 8 at a time
+ * \return the number of pixels packed
+ */
+template<typename DType>
+__attribute__((target("avx2,fma,f16c")))
+inline int PackRowAVX2(const uint8_t* src, const RowArgs<DType>& r, const PackParam& p) {
+  const int channels = r.channels;
+  if (channels != 1 && channels != 3 && channels != 4) return 0;
+  // the shuffles gathering channel c of 8 pixels from two 16 byte loads,
+  // the second one 8 bytes further for 3 channels and 16 for 4
+  const int hi_offset = channels == 3 ? 8 : 16;
+  __m128i lo_mask[4], hi_mask[4];
+  __m256 mean[4], scale[4], bias[4];
+  for (int c = 0; c < channels; ++c) {
+    alignas(16) uint8_t lo[16], hi[16];
+    for (int k = 0; k < 16; ++k) {
+      const int idx = k * channels + r.src_offset[c];
+      lo[k] = k < 8 && idx < 16 ? idx : 0x80;
+      hi[k] = k < 8 && idx >= 16 ? idx - hi_offset : 0x80;
+    }
+    lo_mask[c] = _mm_load_si128(reinterpret_cast<const __m128i*>(lo));
+    hi_mask[c] = _mm_load_si128(reinterpret_cast<const __m128i*>(hi));
+    mean[c] = _mm256_set1_ps(p.mean[c]);
+    scale[c] = _mm256_set1_ps(p.scale[c]);
+    bias[c] = _mm256_set1_ps(p.bias[c]);
+  }
+  const __m256i reverse = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  int x = 0;
+  for (; x + 8 <= r.cols; x += 8) {
+    const uint8_t* s = src + x * channels;
+    __m128i lo, hi;
+    if (channels == 1) {
+      lo = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(s));
+      hi = _mm_setzero_si128();
+    } else {
+      lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+      hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + hi_offset));
+    }
+    for (int c = 0; c < channels; ++c) {
+      const __m128i bytes = channels == 1 ? lo :
+          _mm_or_si128(_mm_shuffle_epi8(lo, lo_mask[c]), _mm_shuffle_epi8(hi, hi_mask[c]));
+      __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+      const __m256 m = p.mean_img != nullptr ? _mm256_loadu_ps(r.mean_row[c] + x) : mean[c];
+      v = _mm256_fmadd_ps(_mm256_sub_ps(v, m), scale[c], bias[c]);
+      if (p.mirror) {
+        StoreAVX2(r.dst_row[c] + r.cols - x - 8, _mm256_permutevar8x32_ps(v, reverse));
+      } else {
+        StoreAVX2(r.dst_row[c] + x, v);
+      }
+    }
+  }
+  return x;
+}
+#endif  // MXNET_IO_IMAGE_PACK_SIMD
+
+/*! \return the number of pixels of the row packed with vectors, 0 for the other types */
+template<typename DType>
+inline int PackRowSIMD(const uint8_t* src, const RowArgs<DType>& r, const PackParam& p) {
+  return 0;
+}
+
+#if MXNET_IO_IMAGE_PACK_SIMD
+template<>
+inline int PackRowSIMD<float>(const uint8_t* src, const RowArgs<float>& r,
+                              const PackParam& p) {
+  return HasAVX2() ? PackRowAVX2(src, r, p) : 0;
+}
+
+template<>
+inline int PackRowSIMD<mshadow::half::half_t>(const uint8_t* src,
+                                              const RowArgs<mshadow::half::half_t>& r,
+                                              const PackParam& p) {
+  return HasAVX2() ? PackRowAVX2(src, r, p) : 0;
+}
+
+template<>
+inline int PackRowSIMD<uint8_t>(const uint8_t* src, const RowArgs<uint8_t>& r,
+                                const PackParam& p) {
+  return HasAVX2() ? PackRowAVX2(src, r, p) : 0;
+}
+#endif  // MXNET_IO_IMAGE_PACK_SIMD
+
+}  // namespace pack
+
+/*!
+ * \brief write the HWC image src, with channels in BGR(A) order, into the
+ *  CHW array dst in RGB(A) order, normalized by p
+ * \param src_step the bytes between the rows of src
+ */
+template<typename DType>
+inline void PackImage(const uint8_t* src, size_t src_step, int rows, int cols, int channels,
+                      const PackParam& p, DType* dst) {
+  pack::RowArgs<DType> r;
+  r.channels = channels;
+  r.cols = cols;
+  for (int c = 0; c < channels; ++c) {
+    r.src_offset[c] = channels >= 3 && c < 3 ? 2 - c : c;
+  }
+  for (int y = 0; y < rows; ++y) {
+    const uint8_t* s = src + y * src_step;
+    for (int c = 0; c < channels; ++c) {
+      const size_t offset = (static_cast<size_t>(c) * rows + y) * cols;
+      r.dst_row[c] = dst + offset;
+      r.mean_row[c] = p.mean_img != nullptr ? p.mean_img + offset : nullptr;
+    }
+    const int begin = pack::PackRowSIMD(s, r, p);
+    pack::PackRowScalar(s, begin, r, p);
+  }
+}
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_IMAGE_PACK_H_
@@ -0,0 +1,299 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file indexed_recordio.h
+ * \brief random access to the records of a memory-mapped RecordIO file
+ *  through its .idx
+ */
+#ifndef MXNET_IO_INDEXED_RECORDIO_H_
+#define MXNET_IO_INDEXED_RECORDIO_H_
+
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/recordio.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "../common/utils.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mxnet {
+namespace io {
+
+/*!
+ * \brief maps a .rec file into memory and reads its records in chunks, in
+ *  the order of the offsets of the .idx or in a random order per epoch.
+ *  The pages of the next chunk are requested from the kernel while the
+ *  current one is parsed. The records are read in place, except the ones
+ *  RecordIO split around a magic number.
+ *
+ *  With a shard seed, the parts are not fixed ranges of the file: every
+ *  epoch the chunks of consecutive records of the whole file are dealt to
+ *  the parts in a new permutation, which every worker computes alike from
+ *  the seed and the number of the epoch. The workers must start the same
+ *  number of epochs, and be built with the same standard library.
+ */
+class IndexedRecordIO {
+ public:
+  /*!
+   * \param rec_path the local .rec file
+   * \param idx_path its index, of "key\toffset" lines
+   * \param part_index the part of the records to read, as the InputSplit parts
+   * \param num_parts the number of parts
+   * \param chunk_size the number of records of a chunk
+   * \param shard_seed the seed of the chunks dealt to the parts every epoch,
+   *  -1 for the fixed parts
+   */
+  IndexedRecordIO(const std::string& rec_path, const std::string& idx_path,
+                  int part_index, int num_parts, size_t chunk_size, int shard_seed = -1)
+    : chunk_size_(chunk_size), pos_(0), part_index_(part_index), num_parts_(num_parts),
+      shard_seed_(shard_seed) {
+#ifndef _WIN32
+    std::ifstream idx(idx_path);
+    CHECK(idx.good()) << "Cannot open " << idx_path;
+    std::string key;
+    size_t offset;
+    std::vector<size_t> offsets;
+    while (idx >> key >> offset) offsets.push_back(offset);
+    std::sort(offsets.begin(), offsets.end());
+    if (shard_seed_ >= 0) {
+      offsets_.swap(offsets);
+      CHECK_GE(offsets_.size(), static_cast<size_t>(num_parts))
+          << idx_path << " has fewer records than parts";
+    } else {
+      const size_t begin = offsets.size() * part_index / num_parts;
+      const size_t end = offsets.size() * (part_index + 1) / num_parts;
+      offsets_.assign(offsets.begin() + begin, offsets.begin() + end);
+    }
+    CHECK(!offsets_.empty()) << idx_path << " has no record for part " << part_index;
+    fd_ = open(rec_path.c_str(), O_RDONLY);
+    CHECK_GE(fd_, 0) << "Cannot open " << rec_path << ", indexed reads need a local file";
+    struct stat st;
+    CHECK_EQ(fstat(fd_, &st), 0);
+    size_ = st.st_size;
+    CHECK_LT(offsets_.back(), size_) << idx_path << " does not index " << rec_path;
+    data_ = static_cast<char*>(mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0));
+    CHECK(data_ != MAP_FAILED) << "Cannot map " << rec_path;
+    // the accesses are random, do not read ahead around them
+    madvise(data_, size_, MADV_RANDOM);
+    if (shard_seed_ >= 0) {
+      DealChunks(nullptr);
+    } else {
+      order_.resize(offsets_.size());
+      for (size_t i = 0; i < order_.size(); ++i) order_[i] = i;
+    }
+#else
+    LOG(FATAL) << "indexed RecordIO reads are not supported on windows";
+#endif
+  }
+
+  ~IndexedRecordIO() {
+#ifndef _WIN32
+    munmap(data_, size_);
+    close(fd_);
+#endif
+  }
+
+  /*! \brief the number of records of the epoch */
+  size_t Size() const { return order_.size(); }
+
+  /*!
+   * \brief start an epoch, in a new random order if prnd is not null. With
+   *  a shard seed, prnd only shuffles the records within each chunk.
+   */
+  void BeforeFirst(common::RANDOM_ENGINE* prnd) {
+    if (shard_seed_ >= 0) {
+      DealChunks(prnd);
+      ++epoch_;
+    } else if (prnd != nullptr) {
+      std::shuffle(order_.begin(), order_.end(), *prnd);
+    }
+    pos_ = 0;
+    Prefetch(0);
+  }
+
+  /*! \brief the records of the next chunk, false at the end of the epoch */
+  bool NextChunk(std::vector<size_t>* ids) {
+    if (pos_ >= order_.size()) return false;
+    const size_t end = std::min(pos_ + chunk_size_, order_.size());
+    ids->assign(order_.begin() + pos_, order_.begin() + end);
+    pos_ = end;
+    Prefetch(pos_);
+    return true;
+  }
+
+  /*!
+   * \brief the content of record i
+   * \param buf holds the records which were split in parts
+   */
+  void Record(size_t i, std::vector<char>* buf, dmlc::InputSplit::Blob* out) const {
+    size_t pos = offsets_[i];
+    uint32_t cflag, len;
+    Part(pos, &cflag, &len);
+    if (cflag == 0) {
+      out->dptr = data_ + pos + kHeadSize;
+      out->size = len;
+      return;
+    }
+    // join the parts with the magic number they were split around
+    buf->clear();
+    while (true) {
+      Part(pos, &cflag, &len);
+      buf->insert(buf->end(), data_ + pos + kHeadSize, data_ + pos + kHeadSize + len);
+      pos += kHeadSize + Pad(len);
+      if (cflag == 3U) break;
+      const uint32_t magic = dmlc::RecordIOWriter::kMagic;
+      const char* m = reinterpret_cast<const char*>(&magic);
+      buf->insert(buf->end(), m, m + sizeof(magic));
+    }
+    out->dptr = buf->data();
+    out->size = buf->size();
+  }
+
+ private:
+  static const size_t kHeadSize = 2 * sizeof(uint32_t);
+
+  static size_t Pad(uint32_t len) { return (len + 3U) & ~3U; }
+
+  void Part(size_t pos, uint32_t* cflag, uint32_t* len) const {
+    CHECK_LE(pos + kHeadSize, size_) << "truncated RecordIO file";
+    uint32_t head[2];
+    std::memcpy(head, data_ + pos, sizeof(head));
+    CHECK_EQ(head[0], dmlc::RecordIOWriter::kMagic) << "invalid RecordIO offset " << pos;
+    *cflag = dmlc::RecordIOWriter::DecodeFlag(head[1]);
+    *len = dmlc::RecordIOWriter::DecodeLength(head[1]);
+    CHECK_LE(pos + kHeadSize + *len, size_) << "truncated RecordIO file";
+  }
+
+  /*!
+   * \brief the records of this part in the epoch: its share of the records
+   *  of a permutation of the chunks of the file, so that the parts differ
+   *  by at most one record and read whole chunks but at their ends
+   */
+  void DealChunks(common::RANDOM_ENGINE* prnd) {
+    const size_t n = offsets_.size();
+    const size_t num_chunks = (n + chunk_size_ - 1) / chunk_size_;
+    std::vector<size_t> chunks(num_chunks);
+    for (size_t i = 0; i < num_chunks; ++i) chunks[i] = i;
+    std::seed_seq seq{shard_seed_, epoch_};
+    common::RANDOM_ENGINE rnd(seq);
+    std::shuffle(chunks.begin(), chunks.end(), rnd);
+    const size_t begin = n * part_index_ / num_parts_, end = n * (part_index_ + 1) / num_parts_;
+    order_.clear();
+    for (size_t k = 0, pos = 0; k < num_chunks && pos < end; ++k) {
+      const size_t first = chunks[k] * chunk_size_;
+      const size_t size = std::min(first + chunk_size_, n) - first;
+      // the records [lo, hi) of the chunk are in the range of the part
+      const size_t lo = std::max(pos, begin), hi = std::min(pos + size, end);
+      if (lo < hi) {
+        const size_t head = order_.size();
+        for (size_t i = lo; i < hi; ++i) order_.push_back(first + i - pos);
+        if (prnd != nullptr) std::shuffle(order_.begin() + head, order_.end(), *prnd);
+      }
+      pos += size;
+    }
+  }
+
+  /*!
+   * \brief ask the kernel for the pages of the chunk from begin in the
+   *  order, in one call for the records next to each other in the file
+   */
+  void Prefetch(size_t begin) {
+#ifndef _WIN32
+    const size_t page = sysconf(_SC_PAGESIZE);
+    const size_t end = std::min(begin + chunk_size_, order_.size());
+    size_t lo = 0, hi = 0;
+    for (size_t k = begin; k < end; ++k) {
+      const size_t pos = offsets_[order_[k]];
+      uint32_t cflag, len;
+      Part(pos, &cflag, &len);
+      const size_t first = pos / page * page, last = pos + kHeadSize + len;
+      if (first >= lo && first <= hi) {
+        hi = std::max(hi, last);
+        continue;
+      }
+      if (hi > lo) madvise(data_ + lo, hi - lo, MADV_WILLNEED);
+      lo = first;
+      hi = last;
+    }
+    if (hi > lo) madvise(data_ + lo, hi - lo, MADV_WILLNEED);
+#endif
+  }
+
+  size_t chunk_size_;
+  /*! \brief the offsets of the records, sorted */
+  std::vector<size_t> offsets_;
+  /*! \brief the order of the records in the epoch */
+  std::vector<size_t> order_;
+  /*! \brief the position of the next chunk in order_ */
+  size_t pos_;
+  int part_index_;
+  int num_parts_;
+  int shard_seed_;
+  /*! \brief the number of the epoch BeforeFirst starts, with a shard seed */
+  int epoch_ = 0;
+  int fd_;
+  char* data_;
+  size_t size_;
+};
+
+/*!
+ * \brief the records of a chunk one thread parses, from a chunk of a
+ *  RecordIO InputSplit or from the records of an indexed file
+ */
+class ChunkRecordReader {
+ public:
+  ChunkRecordReader(const dmlc::InputSplit::Blob& chunk, int tid, int nthreads)
+    : reader_(new dmlc::RecordIOChunkReader(chunk, tid, nthreads)) {}
+
+  ChunkRecordReader(const IndexedRecordIO* file, const std::vector<size_t>& ids,
+                    int tid, int nthreads)
+    : file_(file), ids_(&ids), pos_(ids.size() * tid / nthreads),
+      end_(ids.size() * (tid + 1) / nthreads) {}
+
+  bool NextRecord(dmlc::InputSplit::Blob* out) {
+    if (reader_ != nullptr) return reader_->NextRecord(out);
+    if (pos_ >= end_) return false;
+    file_->Record((*ids_)[pos_++], &buf_, out);
+    return true;
+  }
+
+ private:
+  std::unique_ptr<dmlc::RecordIOChunkReader> reader_;
+  const IndexedRecordIO* file_ = nullptr;
+  const std::vector<size_t>* ids_ = nullptr;
+  size_t pos_ = 0, end_ = 0;
+  std::vector<char> buf_;
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_INDEXED_RECORDIO_H_
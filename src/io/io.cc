@@ -22,6 +22,7 @@
 #include <dmlc/registry.h>
 #include "./image_augmenter.h"
 #include "./image_iter_common.h"
+#include "./iter_echo.h"
 
 // Registers
 namespace dmlc {
@@ -35,7 +36,9 @@ DMLC_REGISTER_PARAMETER(BatchParam);
 DMLC_REGISTER_PARAMETER(PrefetcherParam);
 DMLC_REGISTER_PARAMETER(ImageNormalizeParam);
 DMLC_REGISTER_PARAMETER(ImageRecParserParam);
+DMLC_REGISTER_PARAMETER(ImageGPUDecodeParam);
 DMLC_REGISTER_PARAMETER(ImageRecordParam);
 DMLC_REGISTER_PARAMETER(ImageDetNormalizeParam);
+DMLC_REGISTER_PARAMETER(EchoParam);
 }  // namespace io
 }  // namespace mxnet
@@ -20,14 +20,29 @@
 /*!
  * \file iter_csv.cc
  * \brief define a CSV Reader to read in arrays
+ *
+ * The files are read chunk by chunk with a dmlc::InputSplit. The lines of a
+ * chunk are split among the threads, which parse their rows straight into
+ * one row-major buffer, so that the batches inside a chunk are returned
+ * without a copy and only the ones across two chunks are assembled.
  */
 #include <mxnet/io.h>
 #include <dmlc/base.h>
+#include <dmlc/io.h>
 #include <dmlc/logging.h>
+#include <dmlc/omp.h>
 #include <dmlc/parameter.h>
-#include <dmlc/data.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 #include "./iter_prefetcher.h"
-#include "./iter_batchloader.h"
+#include "./image_iter_common.h"
+#include "./iter_echo.h"
+#include "./iter_stats.h"
 
 namespace mxnet {
 namespace io {
@@ -41,6 +56,8 @@ struct CSVIterParam : public dmlc::Parameter<CSVIterParam> {
   std::string label_csv;
   /*! \brief label shape */
   TShape label_shape;
+  /*! \brief number of threads parsing a chunk */
+  int preprocess_threads;
   // declare parameters
   DMLC_DECLARE_PARAMETER(CSVIterParam) {
     DMLC_DECLARE_FIELD(data_csv)
@@ -53,10 +70,193 @@ struct CSVIterParam : public dmlc::Parameter<CSVIterParam> {
     index_t shape1[] = {1};
     DMLC_DECLARE_FIELD(label_shape).set_default(TShape(shape1, shape1 + 1))
         .describe("The shape of one label.");
+    DMLC_DECLARE_FIELD(preprocess_threads).set_lower_bound(1).set_default(4)
+        .describe("The number of threads parsing the rows of a chunk.");
   }
 };
 
-class CSVIter: public IIterator<DataInst> {
+/*! \brief the end of the line at p, a '\n' or end */
+inline const char* LineEnd(const char* p, const char* end) {
+  const void* q = std::memchr(p, '\n', end - p);
+  return q == nullptr ? end : static_cast<const char*>(q);
+}
+
+/*! \brief whether [p, end) has a character other than a blank */
+inline bool HasValue(const char* p, const char* end) {
+  for (; p != end; ++p) {
+    if (*p != ' ' && *p != '\t' && *p != '\r') return true;
+  }
+  return false;
+}
+
+/*!
+ * \brief parse the decimal number at p, which ends at end or at the first
+ *  character that does not belong to it. The numbers of up to 15 significant
+ *  digits and a power of ten of at most 22 are exact in a double, the others
+ *  and nan or inf go to strtof.
+ * \return the end of the number
+ */
+inline const char* ParseFloat(const char* p, const char* end, real_t* out) {
+  static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const char* begin = p;
+  bool neg = false;
+  if (p != end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+  uint64_t mant = 0;
+  int digits = 0, exp10 = 0, num_digits = 0;
+  for (; p != end && *p >= '0' && *p <= '9'; ++p, ++num_digits) {
+    mant = mant * 10 + (*p - '0');
+    if (mant != 0) ++digits;
+  }
+  if (p != end && *p == '.') {
+    for (++p; p != end && *p >= '0' && *p <= '9'; ++p, ++num_digits) {
+      mant = mant * 10 + (*p - '0');
+      if (mant != 0) ++digits;
+      --exp10;
+    }
+  }
+  if (num_digits != 0 && p != end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool eneg = false;
+    if (q != end && (*q == '-' || *q == '+')) eneg = *q++ == '-';
+    if (q != end && *q >= '0' && *q <= '9') {
+      int e = 0;
+      for (; q != end && *q >= '0' && *q <= '9'; ++q) {
+        if (e < 10000) e = e * 10 + (*q - '0');
+      }
+      exp10 += eneg ? -e : e;
+      p = q;
+    }
+  }
+  if (num_digits != 0 && digits == 0) {
+    *out = neg ? -0.0f : 0.0f;
+  } else if (num_digits != 0 && digits <= 15 && exp10 >= -22 && exp10 <= 22) {
+    const double v = exp10 < 0 ? mant / kPow10[-exp10] : mant * kPow10[exp10];
+    *out = static_cast<real_t>(neg ? -v : v);
+  } else {
+    // strtof needs a terminated string, the chunks are not
+    char buf[64];
+    const char* q = begin;
+    size_t n = 0;
+    while (q != end && n + 1 < sizeof(buf) && *q != ',' && *q != '\n') buf[n++] = *q++;
+    buf[n] = '\0';
+    char* stop;
+    *out = std::strtof(buf, &stop);
+    p = begin + (stop - buf);
+  }
+  return p;
+}
+
+/*!
+ * \brief reads the rows of a csv file, parsing each chunk of the file with
+ *  several threads into one buffer of rows
+ */
+class CSVRowReader {
+ public:
+  CSVRowReader(const std::string& uri, size_t row_size, int nthread, DecodeStats* stats)
+      : row_size_(row_size), nthread_(nthread), stats_(stats) {
+    source_.reset(dmlc::InputSplit::Create(uri.c_str(), 0, 1, "text"));
+  }
+
+  void BeforeFirst() {
+    source_->BeforeFirst();
+    pos_ = num_rows_ = 0;
+  }
+
+  /*!
+   * \brief the next rows of the file, contiguous in memory
+   * \param n the maximum number of rows
+   * \param rows returns the first row
+   * \return the number of rows, 0 at the end of the file
+   */
+  size_t Read(size_t n, const real_t** rows) {
+    while (pos_ >= num_rows_) {
+      if (!ParseChunk()) return 0;
+    }
+    const size_t k = std::min(n, num_rows_ - pos_);
+    *rows = buf_.data() + pos_ * row_size_;
+    pos_ += k;
+    return k;
+  }
+
+ private:
+  bool ParseChunk() {
+    dmlc::InputSplit::Blob chunk;
+    if (!source_->NextChunk(&chunk)) return false;
+    const double t0 = dmlc::GetTime();
+    const char* begin = static_cast<const char*>(chunk.dptr);
+    const char* end = begin + chunk.size;
+    // small chunks are not worth the threads
+    const int nthread = std::max(1, std::min(nthread_, static_cast<int>(chunk.size >> 16)));
+    std::vector<const char*> bounds(nthread + 1, end);
+    bounds[0] = begin;
+    for (int i = 1; i < nthread; ++i) {
+      const char* p = std::max(begin + chunk.size * i / nthread, bounds[i - 1]);
+      const char* e = LineEnd(p, end);
+      bounds[i] = e == end ? end : e + 1;
+    }
+    std::vector<size_t> offset(nthread + 1, 0);
+    #pragma omp parallel for num_threads(nthread)
+    for (int i = 0; i < nthread; ++i) {
+      size_t count = 0;
+      for (const char* p = bounds[i]; p != bounds[i + 1];) {
+        const char* e = LineEnd(p, bounds[i + 1]);
+        if (HasValue(p, e)) ++count;
+        p = e == bounds[i + 1] ? e : e + 1;
+      }
+      offset[i + 1] = count;
+    }
+    for (int i = 0; i < nthread; ++i) offset[i + 1] += offset[i];
+    num_rows_ = offset[nthread];
+    pos_ = 0;
+    buf_.resize(num_rows_ * row_size_);
+    #pragma omp parallel for num_threads(nthread)
+    for (int i = 0; i < nthread; ++i) {
+      real_t* row = buf_.data() + offset[i] * row_size_;
+      for (const char* p = bounds[i]; p != bounds[i + 1];) {
+        const char* e = LineEnd(p, bounds[i + 1]);
+        if (HasValue(p, e)) {
+          ParseRow(p, e, row);
+          row += row_size_;
+        }
+        p = e == bounds[i + 1] ? e : e + 1;
+      }
+    }
+    stats_->bytes_read += chunk.size;
+    stats_->decode_usec += MicrosSince(t0);
+    return true;
+  }
+
+  /*! \brief parse the comma separated values of [p, end) into row */
+  void ParseRow(const char* p, const char* end, real_t* row) const {
+    size_t ncol = 0;
+    while (true) {
+      while (p != end && (*p == ' ' || *p == '\t')) ++p;
+      real_t v = 0.0f;
+      if (p != end && *p != ',') p = ParseFloat(p, end, &v);
+      if (ncol < row_size_) row[ncol] = v;
+      ++ncol;
+      while (p != end && *p != ',') ++p;
+      if (p == end) break;
+      ++p;
+    }
+    CHECK_EQ(ncol, row_size_)
+        << "The data size in CSV do not match size of shape: "
+        << "specified shape size=" << row_size_ << ", the csv row-length=" << ncol;
+  }
+
+  size_t row_size_;
+  int nthread_;
+  DecodeStats* stats_;
+  std::unique_ptr<dmlc::InputSplit> source_;
+  /*! \brief the rows of the current chunk */
+  std::vector<real_t> buf_;
+  size_t pos_{0}, num_rows_{0};
+};
+
+class CSVIter: public IIterator<TBlobBatch> {
  public:
   CSVIter() {
     out_.data.resize(2);
@@ -66,82 +266,131 @@ class CSVIter: public IIterator<DataInst> {
   // intialize iterator loads data in
   virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
     param_.InitAllowUnknown(kwargs);
-    data_parser_.reset(dmlc::Parser<uint32_t>::Create(param_.data_csv.c_str(), 0, 1, "csv"));
+    batch_param_.InitAllowUnknown(kwargs);
+    const int nthread = std::min(param_.preprocess_threads, omp_get_num_procs());
+    const index_t batch_size = batch_param_.batch_size;
+    out_.inst_index = new unsigned[batch_size];
+    out_.batch_size = batch_size;
+    std::vector<index_t> shape(1, batch_size);
+    shape.insert(shape.end(), param_.data_shape.begin(), param_.data_shape.end());
+    data_shape_ = TShape(shape.begin(), shape.end());
+    data_parser_.reset(new CSVRowReader(param_.data_csv, param_.data_shape.Size(), nthread,
+                                          &stats_));
+    data_batch_.resize(data_shape_.Size());
     if (param_.label_csv != "NULL") {
-      label_parser_.reset(dmlc::Parser<uint32_t>::Create(param_.label_csv.c_str(), 0, 1, "csv"));
+      shape.resize(1);
+      shape.insert(shape.end(), param_.label_shape.begin(), param_.label_shape.end());
+      label_shape_ = TShape(shape.begin(), shape.end());
+      label_parser_.reset(new CSVRowReader(param_.label_csv, param_.label_shape.Size(),
+                                           nthread, &stats_));
+      label_batch_.resize(label_shape_.Size());
     } else {
-      dummy_label.set_pad(false);
-      dummy_label.Resize(mshadow::Shape1(1));
-      dummy_label = 0.0f;
+      label_shape_ = mshadow::Shape2(batch_size, 1);
+      label_batch_.assign(batch_size, 0.0f);
+      out_.data[1] = TBlob(label_batch_.data(), label_shape_, cpu::kDevMask, 0);
     }
   }
 
   virtual void BeforeFirst() {
-    data_parser_->BeforeFirst();
-    if (label_parser_.get() != nullptr) {
-      label_parser_->BeforeFirst();
+    // in round_batch mode the rows after the ones of the overflowed batch come next
+    if (batch_param_.round_batch == 0 || num_overflow_ == 0) {
+      ResetParsers();
+    } else {
+      num_overflow_ = 0;
     }
-    data_ptr_ = label_ptr_ = 0;
-    data_size_ = label_size_ = 0;
-    inst_counter_ = 0;
-    end_ = false;
   }
 
   virtual bool Next() {
-    if (end_) return false;
-    while (data_ptr_ >= data_size_) {
-      if (!data_parser_->Next()) {
-        end_ = true; return false;
-      }
-      data_ptr_ = 0;
-      data_size_ = data_parser_->Value().size;
-    }
-    out_.index = inst_counter_++;
-    CHECK_LT(data_ptr_, data_size_);
-    out_.data[0] = AsTBlob(data_parser_->Value()[data_ptr_++], param_.data_shape);
-
-    if (label_parser_.get() != nullptr) {
-      while (label_ptr_ >= label_size_) {
-        CHECK(label_parser_->Next())
-            << "Data CSV's row is smaller than the number of rows in label_csv";
-        label_ptr_ = 0;
-        label_size_ = label_parser_->Value().size;
+    out_.num_batch_padd = 0;
+    if (num_overflow_ != 0) return false;
+    const index_t batch_size = batch_param_.batch_size;
+    index_t top = ReadRows(0);
+    if (top == 0) return false;
+    if (top < batch_size) {
+      if (batch_param_.round_batch != 0) {
+        ResetParsers();
+        const index_t filled = ReadRows(top);
+        CHECK_EQ(filled, batch_size) << "number of input must be bigger than batch size";
+        num_overflow_ = batch_size - top;
+        out_.num_batch_padd = num_overflow_;
+      } else {
+        out_.num_batch_padd = batch_size - top;
       }
-      CHECK_LT(label_ptr_, label_size_);
-      out_.data[1] = AsTBlob(label_parser_->Value()[label_ptr_++], param_.label_shape);
-    } else {
-      out_.data[1] = dummy_label;
     }
     return true;
   }
 
-  virtual const DataInst &Value(void) const {
+  virtual const TBlobBatch &Value(void) const {
     return out_;
   }
 
+  virtual void GetStats(IterStatList* stats) const {
+    stats_.Append(stats);
+  }
+
  private:
-  inline TBlob AsTBlob(const dmlc::Row<uint32_t>& row, const TShape& shape) {
-    CHECK_EQ(row.length, shape.Size())
-        << "The data size in CSV do not match size of shape: "
-        << "specified shape=" << shape << ", the csv row-length=" << row.length;
-    const real_t* ptr = row.value;
-    return TBlob((real_t*)ptr, shape, cpu::kDevMask, 0);  // NOLINT(*)
+  void ResetParsers() {
+    data_parser_->BeforeFirst();
+    if (label_parser_ != nullptr) label_parser_->BeforeFirst();
+    inst_counter_ = 0;
+  }
+
+  /*!
+   * \brief read the rows of the batch from begin on
+   * \return the number of rows in the batch
+   */
+  index_t ReadRows(index_t begin) {
+    const index_t top = Fill(data_parser_.get(), begin, batch_param_.batch_size,
+                             &data_batch_, data_shape_, &out_.data[0]);
+    if (label_parser_ != nullptr && top > begin) {
+      CHECK_EQ(Fill(label_parser_.get(), begin, top, &label_batch_, label_shape_,
+                    &out_.data[1]), top)
+          << "Data CSV's row is smaller than the number of rows in label_csv";
+    }
+    for (index_t i = begin; i < top; ++i) out_.inst_index[i] = inst_counter_++;
+    stats_.records_decoded += top - begin;
+    return top;
+  }
+
+  /*!
+   * \brief read the rows [begin, end) of a batch of shape, pointing out
+   *  into the buffer of the reader when the whole batch is in one chunk
+   * \return the end of the rows read
+   */
+  index_t Fill(CSVRowReader* reader, index_t begin, index_t end, std::vector<real_t>* batch,
+               const TShape& shape, TBlob* out) {
+    const size_t row_size = shape.Size() / shape[0];
+    const real_t* rows;
+    index_t top = begin;
+    while (top < end) {
+      const size_t n = reader->Read(end - top, &rows);
+      if (n == 0) break;
+      if (top == 0 && n == shape[0]) {
+        *out = TBlob(const_cast<real_t*>(rows), shape, cpu::kDevMask, 0);
+        return n;
+      }
+      std::memcpy(batch->data() + top * row_size, rows, n * row_size * sizeof(real_t));
+      top += n;
+    }
+    *out = TBlob(batch->data(), shape, cpu::kDevMask, 0);
+    return top;
   }
 
   CSVIterParam param_;
-  // output instance
-  DataInst out_;
+  BatchParam batch_param_;
+  // output batch
+  TBlobBatch out_;
   // internal instance counter
   unsigned inst_counter_{0};
-  // at end
-  bool end_{false};
-  // dummy label
-  mshadow::TensorContainer<cpu, 1, real_t> dummy_label;
-  // label parser
-  size_t label_ptr_{0}, label_size_{0};
-  size_t data_ptr_{0}, data_size_{0};
-  std::unique_ptr<dmlc::Parser<uint32_t> > label_parser_;
-  std::unique_ptr<dmlc::Parser<uint32_t> > data_parser_;
+  // number of rows of the next epoch in the last batch, in round_batch mode
+  index_t num_overflow_{0};
+  TShape data_shape_, label_shape_;
+  // the batches across two chunks, and the zero labels
+  std::vector<real_t> data_batch_, label_batch_;
+  // the counters of both readers
+  DecodeStats stats_;
+  std::unique_ptr<CSVRowReader> label_parser_;
+  std::unique_ptr<CSVRowReader> data_parser_;
 };
 
 
@@ -221,10 +470,9 @@ Examples::
 .add_arguments(CSVIterParam::__FIELDS__())
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
+.add_arguments(EchoParam::__FIELDS__())
 .set_body([]() {
-    return new PrefetcherIter(
-        new BatchLoader(
-            new CSVIter()));
+    return new EchoIter(new PrefetcherIter(new CSVIter()), false);
   });
 
 }  // namespace io
@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file iter_echo.h
+ * \brief repeat the batches of an iterator, for the jobs bound by reading
+ *  or decoding them
+ */
+#ifndef MXNET_IO_ITER_ECHO_H_
+#define MXNET_IO_ITER_ECHO_H_
+
+#include <mxnet/io.h>
+#include <mxnet/ndarray.h>
+#include <mxnet/engine.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../common/utils.h"
+
+namespace mxnet {
+namespace io {
+
+/*! \brief the parameters of EchoIter */
+struct EchoParam : public dmlc::Parameter<EchoParam> {
+  /*! \brief the number of times each batch is returned */
+  int echo_factor;
+  /*! \brief whether the repeats mirror the images at random */
+  bool echo_rand_mirror;
+  /*! \brief the seed of the mirrors */
+  int echo_seed;
+  DMLC_DECLARE_PARAMETER(EchoParam) {
+    DMLC_DECLARE_FIELD(echo_factor).set_default(1).set_lower_bound(1)
+        .describe("Return each batch this many times before reading the next one, "
+                  "which multiplies the batches of an epoch. It keeps the devices busy "
+                  "when reading or decoding is slower than training.");
+    DMLC_DECLARE_FIELD(echo_rand_mirror).set_default(false)
+        .describe("Mirror each image of the repeated batches with probability 0.5. "
+                  "The first time a batch is returned it is left as it is.");
+    DMLC_DECLARE_FIELD(echo_seed).set_default(0)
+        .describe("The random seed of echo_rand_mirror.");
+  }
+};
+
+/*!
+ * \brief returns each batch of base echo_factor times. The repeats share the
+ *  arrays of the batch, or, with echo_rand_mirror, are copies of it with some
+ *  images mirrored, written on the engine after the reads of the last repeat.
+ */
+class EchoIter : public IIterator<DataBatch> {
+ public:
+  /*!
+   * \param base the iterator whose batches are repeated
+   * \param images whether the data of base are NCHW images, which can be mirrored
+   */
+  explicit EchoIter(IIterator<DataBatch>* base, bool images = true)
+      : base_(base), images_(images) {}
+
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    param_.InitAllowUnknown(kwargs);
+    CHECK(images_ || !param_.echo_rand_mirror)
+      << "echo_rand_mirror needs an iterator of images without object labels";
+    rnd_.seed(param_.echo_seed);
+    echoed_ = param_.echo_factor;
+    base_->Init(kwargs);
+  }
+
+  virtual void BeforeFirst(void) {
+    base_->BeforeFirst();
+    echoed_ = param_.echo_factor;
+  }
+
+  virtual bool Next(void) {
+    if (echoed_ < param_.echo_factor) {
+      if (param_.echo_rand_mirror) Mirror(base_->Value());
+      ++echoed_;
+      return true;
+    }
+    if (!base_->Next()) return false;
+    echoed_ = 1;
+    return true;
+  }
+
+  virtual const DataBatch &Value(void) const {
+    return echoed_ > 1 && param_.echo_rand_mirror ? out_ : base_->Value();
+  }
+
+  virtual void GetStats(std::vector<std::pair<std::string, uint64_t> >* stats) const {
+    base_->GetStats(stats);
+  }
+
+ private:
+  /*! \brief write batch into out_, with images mirrored at random */
+  void Mirror(const DataBatch& batch) {
+    const NDArray& src = batch.data[0];
+    CHECK_EQ(src.shape().ndim(), 4U) << "echo_rand_mirror needs batches of NCHW images";
+    CHECK_EQ(src.ctx().dev_mask(), cpu::kDevMask)
+      << "echo_rand_mirror mirrors the batches on the cpu, it cannot be used with "
+         "copy_to_gpu or the gpu decoding";
+    out_.data = batch.data;
+    out_.index = batch.index;
+    out_.num_batch_padd = batch.num_batch_padd;
+    if (data_.is_none() || data_.shape() != src.shape() || data_.dtype() != src.dtype()) {
+      data_ = NDArray(src.shape(), src.ctx(), true, src.dtype());
+    }
+    std::bernoulli_distribution coin_flip(0.5);
+    std::vector<bool> mirror(src.shape()[0]);
+    for (size_t i = 0; i < mirror.size(); ++i) mirror[i] = coin_flip(rnd_);
+    NDArray dst = data_;
+    Engine::Get()->PushSync([src, dst, mirror](RunContext ctx) {
+        const TBlob in = src.data(), out = dst.data();
+        const size_t width = in.shape_[3];
+        const size_t rows = in.shape_.Size() / in.shape_[0] / width;
+        MSHADOW_TYPE_SWITCH(in.type_flag_, DType, {
+          for (size_t i = 0; i < mirror.size(); ++i) {
+            const DType* s = in.dptr<DType>() + i * rows * width;
+            DType* d = out.dptr<DType>() + i * rows * width;
+            if (!mirror[i]) {
+              std::copy(s, s + rows * width, d);
+              continue;
+            }
+            for (size_t r = 0; r < rows; ++r) {
+              std::reverse_copy(s + r * width, s + (r + 1) * width, d + r * width);
+            }
+          }
+        });
+      }, src.ctx(), {src.var()}, {dst.var()},
+      FnProperty::kNormal, 0, PROFILER_MESSAGE("EchoMirror"));
+    out_.data[0] = dst;
+  }
+
+  /*! \brief the iterator whose batches are repeated */
+  std::unique_ptr<IIterator<DataBatch> > base_;
+  bool images_;
+  EchoParam param_;
+  /*! \brief the times the current batch was returned */
+  int echoed_{0};
+  /*! \brief the mirrored repeat */
+  DataBatch out_;
+  NDArray data_;
+  common::RANDOM_ENGINE rnd_;
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_ITER_ECHO_H_
@@ -31,16 +31,23 @@
 #include <dmlc/parameter.h>
 #include <dmlc/recordio.h>
 #include <dmlc/threadediter.h>
+#include <dmlc/timer.h>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <queue>
+#include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
-#include <cstdlib>
-#include "./inst_vector.h"
 #include "./image_recordio.h"
 #include "./image_augmenter.h"
 #include "./image_iter_common.h"
+#include "./image_pack.h"
+#include "./iter_echo.h"
 #include "./iter_prefetcher.h"
-#include "./iter_normalize.h"
-#include "./iter_batchloader.h"
+#include "./iter_stats.h"
+#include "../common/utils.h"
 
 namespace mxnet {
 namespace io {
@@ -167,6 +174,8 @@ struct ImageDetRecParserParam : public dmlc::Parameter<ImageDetRecParserParam> {
   int label_pad_width;
   /*! \brief labe padding value */
   float label_pad_value;
+  /*! \brief the storage of the labels, dense and padded or csr */
+  int label_stype;
 
   // declare parameters
   DMLC_DECLARE_PARAMETER(ImageDetRecParserParam) {
@@ -201,10 +210,36 @@ struct ImageDetRecParserParam : public dmlc::Parameter<ImageDetRecParserParam> {
         .describe("pad output label width if set larger than 0, -1 for auto estimate");
     DMLC_DECLARE_FIELD(label_pad_value).set_default(-1.f)
         .describe("label padding value if enabled");
+    DMLC_DECLARE_FIELD(label_stype).set_default(kDefaultStorage)
+        .add_enum("default", kDefaultStorage)
+        .add_enum("csr", kCSRStorage)
+        .describe("The storage of the labels. default pads the label of each image to "
+                  "label_pad_width, csr keeps the labels of the images one after the "
+                  "other.  The label of image i is then data[indptr[i]:indptr[i+1]], "
+                  "with the same header of 4 values.");
+  }
+};
+
+// Define image record parameters
+struct ImageDetRecordParam: public dmlc::Parameter<ImageDetRecordParam> {
+  /*! \brief whether to do shuffle */
+  bool shuffle;
+  /*! \brief random seed */
+  int seed;
+  /*! \brief whether to remain silent */
+  bool verbose;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(ImageDetRecordParam) {
+    DMLC_DECLARE_FIELD(shuffle).set_default(false)
+        .describe("Augmentation Param: Whether to shuffle data.");
+    DMLC_DECLARE_FIELD(seed).set_default(0)
+        .describe("Augmentation Param: Random Seed.");
+    DMLC_DECLARE_FIELD(verbose).set_default(true)
+        .describe("Auxiliary Param: Whether to output information.");
   }
 };
 
-// parser to parse image recordio
+// parser to parse image recordio into batches
 template<typename DType>
 class ImageDetRecordIOParser {
  public:
@@ -213,29 +248,84 @@ class ImageDetRecordIOParser {
 
   // set record to the head
   inline void BeforeFirst(void) {
-    return source_->BeforeFirst();
+    if (batch_param_.round_batch == 0 || !overflow_) {
+      n_parsed_ = 0;
+      source_->BeforeFirst();
+    } else {
+      overflow_ = false;
+    }
   }
-  // parse next set of records, return an array of
-  // instance vector to the user
-  virtual inline bool ParseNext(std::vector<InstVector<DType>> *out);
+  // parse the next batch, decoding each image into its slot of out
+  inline bool ParseNext(DataBatch *out);
+  /*! \brief the counters of the reads and the decodes */
+  const DecodeStats& stats() const { return stats_; }
+
+ private:
+  // keep the images of a chunk encoded, with their labels
+  inline void ParseChunk(const dmlc::InputSplit::Blob& chunk);
+  // decode, augment and normalize image pos of thread part into data, and
+  // its label, with the header, into label
+  inline void DecodeImage(int tid, unsigned part, unsigned pos,
+                          mshadow::Tensor<cpu, 3, DType> data,
+                          std::vector<float>* label);
+  // write the labels of the first n images of the batch into out
+  inline void SetLabels(unsigned n, DataBatch* out) const;
+  inline void CreateMeanImg(void);
+
+  /*! \brief the undecoded images of a thread, with their labels */
+  struct EncodedImages {
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> offsets;
+    std::vector<size_t> sizes;
+    std::vector<uint64_t> ids;
+    std::vector<float> labels;
+    std::vector<size_t> label_offsets;
+    unsigned Size() const { return offsets.size(); }
+    void Clear() {
+      bytes.clear();
+      offsets.clear();
+      sizes.clear();
+      ids.clear();
+      labels.clear();
+      label_offsets.assign(1, 0);
+    }
+  };
 
- protected:
   // magic number to see prng
   static const int kRandMagic = 233;
   /*! \brief parameters */
   ImageDetRecParserParam param_;
+  ImageDetRecordParam record_param_;
+  BatchParam batch_param_;
+  ImageDetNormalizeParam normalize_param_;
   #if MXNET_USE_OPENCV
   /*! \brief augmenters */
   std::vector<std::vector<std::unique_ptr<ImageAugmenter> > > augmenters_;
   #endif
   /*! \brief random samplers */
   std::vector<std::unique_ptr<common::RANDOM_ENGINE> > prnds_;
+  /*! \brief the sampler of the instance order */
+  common::RANDOM_ENGINE rnd_;
   /*! \brief data source */
   std::unique_ptr<dmlc::InputSplit> source_;
   /*! \brief label information, if any */
   std::unique_ptr<ImageDetLabelMap> label_map_;
-  /*! \brief temp space */
-  mshadow::TensorContainer<cpu, 3> img_;
+  /*! \brief the encoded images of the threads */
+  std::vector<EncodedImages> encoded_;
+  /*! \brief internal instance order */
+  std::vector<std::pair<unsigned, unsigned> > inst_order_;
+  unsigned inst_index_{0};
+  /*! \brief the instances of the last chunk not in a batch yet */
+  unsigned n_parsed_{0};
+  /*! \brief whether the last batch took instances of the next epoch */
+  bool overflow_{false};
+  /*! \brief the labels of the images of the batch */
+  std::vector<std::vector<float> > labels_;
+  /*! \brief mean image, if needed */
+  mshadow::TensorContainer<cpu, 3> meanimg_;
+  // whether mean image is ready.
+  bool meanfile_ready_{false};
+  DecodeStats stats_;
 };
 
 template<typename DType>
@@ -245,6 +335,10 @@ inline void ImageDetRecordIOParser<DType>::Init(
   // initialize parameter
   // init image rec param
   param_.InitAllowUnknown(kwargs);
+  record_param_.InitAllowUnknown(kwargs);
+  batch_param_.InitAllowUnknown(kwargs);
+  normalize_param_.InitAllowUnknown(kwargs);
+  rnd_.seed(kRandMagic + record_param_.seed);
   int maxthread, threadget;
   #pragma omp parallel
   {
@@ -364,20 +458,43 @@ inline void ImageDetRecordIOParser<DType>::Init(
     // use 64 MB chunk when possible
     source_->HintChunkSize(8 << 20UL);
   }
+  // Normalize init
+  meanimg_.set_pad(false);
+  if (normalize_param_.mean_img.length() != 0) {
+    std::unique_ptr<dmlc::Stream> fi(
+        dmlc::Stream::Create(normalize_param_.mean_img.c_str(), "r", true));
+    if (fi.get() == nullptr) {
+      this->CreateMeanImg();
+    } else {
+      fi.reset(nullptr);
+      if (normalize_param_.verbose) {
+        LOG(INFO) << "Load mean image from " << normalize_param_.mean_img;
+      }
+      // use python compatible ndarray store format
+      std::vector<NDArray> data;
+      std::vector<std::string> keys;
+      {
+        std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(normalize_param_.mean_img.c_str(),
+                                                              "r"));
+        NDArray::Load(fi.get(), &data, &keys);
+      }
+      CHECK_EQ(data.size(), 1)
+          << "Invalid mean image file format";
+      data[0].WaitToRead();
+      mshadow::Tensor<cpu, 3> src = data[0].data().get<cpu, 3, real_t>();
+      meanimg_.Resize(src.shape_);
+      mshadow::Copy(meanimg_, src);
+      meanfile_ready_ = true;
+    }
+  }
 #else
   LOG(FATAL) << "ImageDetRec need opencv to process";
 #endif
 }
 
 template<typename DType>
-inline bool ImageDetRecordIOParser<DType>::
-ParseNext(std::vector<InstVector<DType>> *out_vec) {
-  CHECK(source_ != nullptr);
-  dmlc::InputSplit::Blob chunk;
-  if (!source_->NextChunk(&chunk)) return false;
-#if MXNET_USE_OPENCV
-  // save opencv out
-  out_vec->resize(param_.preprocess_threads);
+inline void ImageDetRecordIOParser<DType>::ParseChunk(const dmlc::InputSplit::Blob& chunk) {
+  encoded_.resize(param_.preprocess_threads);
   #pragma omp parallel num_threads(param_.preprocess_threads)
   {
     CHECK(omp_get_num_threads() == param_.preprocess_threads);
@@ -385,194 +502,372 @@ ParseNext(std::vector<InstVector<DType>> *out_vec) {
     dmlc::RecordIOChunkReader reader(chunk, tid, param_.preprocess_threads);
     ImageRecordIO rec;
     dmlc::InputSplit::Blob blob;
-    // image data
-    InstVector<DType> &out = (*out_vec)[tid];
+    EncodedImages &out = encoded_[tid];
     out.Clear();
+    size_t bytes = 0;
     while (reader.NextRecord(&blob)) {
-      // Opencv decode and augments
-      cv::Mat res;
+      bytes += blob.size;
       rec.Load(blob.dptr, blob.size);
-      cv::Mat buf(1, rec.content_size, CV_8U, rec.content);
-      switch (param_.data_shape[0]) {
-       case 1:
-        res = cv::imdecode(buf, 0);
-        break;
-       case 3:
-        res = cv::imdecode(buf, 1);
-        break;
-       case 4:
-        // -1 to keep the number of channel of the encoded image, and not force gray or color.
-        res = cv::imdecode(buf, -1);
-        CHECK_EQ(res.channels(), 4)
-          << "Invalid image with index " << rec.image_index()
-          << ". Expected 4 channels, got " << res.channels();
-        break;
-       default:
-        LOG(FATAL) << "Invalid output shape " << param_.data_shape;
-      }
-      const int n_channels = res.channels();
+      out.offsets.push_back(out.bytes.size());
+      out.sizes.push_back(rec.content_size);
+      out.ids.push_back(rec.image_index());
+      out.bytes.insert(out.bytes.end(), rec.content, rec.content + rec.content_size);
       // load label before augmentations
-      std::vector<float> label_buf;
       if (this->label_map_ != nullptr) {
-        label_buf = label_map_->FindCopy(rec.image_index());
+        std::vector<float> label_buf = label_map_->FindCopy(rec.image_index());
+        out.labels.insert(out.labels.end(), label_buf.begin(), label_buf.end());
       } else if (rec.label != NULL) {
         if (param_.label_width > 0) {
           CHECK_EQ(param_.label_width, rec.num_label)
             << "rec file provide " << rec.num_label << "-dimensional label "
                "but label_width is set to " << param_.label_width;
         }
-        label_buf.assign(rec.label, rec.label + rec.num_label);
+        out.labels.insert(out.labels.end(), rec.label, rec.label + rec.num_label);
       } else {
         LOG(FATAL) << "Not enough label packed in img_list or rec file.";
       }
-      for (auto& aug : this->augmenters_[tid]) {
-        res = aug->Process(res, &label_buf, this->prnds_[tid].get());
-      }
-      out.Push(static_cast<unsigned>(rec.image_index()),
-               mshadow::Shape3(n_channels, param_.data_shape[1], param_.data_shape[2]),
-               mshadow::Shape1(param_.label_pad_width + 4));
-
-      mshadow::Tensor<cpu, 3, DType> data = out.data().Back();
-
-      // For RGB or RGBA data, swap the B and R channel:
-      // OpenCV store as BGR (or BGRA) and we want RGB (or RGBA)
-      std::vector<int> swap_indices;
-      if (n_channels == 1) swap_indices = {0};
-      if (n_channels == 3) swap_indices = {2, 1, 0};
-      if (n_channels == 4) swap_indices = {2, 1, 0, 3};
-
-      for (int i = 0; i < res.rows; ++i) {
-        uchar* im_data = res.ptr<uchar>(i);
-        for (int j = 0; j < res.cols; ++j) {
-          for (int k = 0; k < n_channels; ++k) {
-              data[k][i][j] = im_data[swap_indices[k]];
+      out.label_offsets.push_back(out.labels.size());
+    }
+    stats_.bytes_read += bytes;
+  }
+}
+
+template<typename DType>
+inline void ImageDetRecordIOParser<DType>::DecodeImage(int tid, unsigned part, unsigned pos,
+                                                       mshadow::Tensor<cpu, 3, DType> data,
+                                                       std::vector<float>* label) {
+#if MXNET_USE_OPENCV
+  const EncodedImages& enc = encoded_[part];
+  // Opencv decode and augments
+  const double t0 = dmlc::GetTime();
+  cv::Mat res;
+  cv::Mat buf(1, enc.sizes[pos], CV_8U,
+              const_cast<uint8_t*>(enc.bytes.data() + enc.offsets[pos]));
+  switch (param_.data_shape[0]) {
+   case 1:
+    res = cv::imdecode(buf, 0);
+    break;
+   case 3:
+    res = cv::imdecode(buf, 1);
+    break;
+   case 4:
+    // -1 to keep the number of channel of the encoded image, and not force gray or color.
+    res = cv::imdecode(buf, -1);
+    CHECK_EQ(res.channels(), 4)
+      << "Invalid image with index " << enc.ids[pos]
+      << ". Expected 4 channels, got " << res.channels();
+    break;
+   default:
+    LOG(FATAL) << "Invalid output shape " << param_.data_shape;
+  }
+  const int n_channels = res.channels();
+  std::vector<float> label_buf(enc.labels.begin() + enc.label_offsets[pos],
+                               enc.labels.begin() + enc.label_offsets[pos + 1]);
+  const double t1 = dmlc::GetTime();
+  for (auto& aug : this->augmenters_[tid]) {
+    res = aug->Process(res, &label_buf, this->prnds_[tid].get());
+  }
+  const double t2 = dmlc::GetTime();
+  CHECK(res.rows == static_cast<int>(data.size(1)) &&
+        res.cols == static_cast<int>(data.size(2)))
+    << "The augmented image with index " << enc.ids[pos] << " is " << res.rows << "x"
+    << res.cols << ", not of the data shape " << param_.data_shape;
+  CHECK_LE(label_buf.size(), static_cast<size_t>(param_.label_pad_width))
+    << "The label of the image with index " << enc.ids[pos]
+    << " is wider than label_pad_width";
+
+  // the mean, std and scale of ImageDetNormalizeParam, applied while writing the slot
+  PackParam pack;
+  const float mean_rgba[4] = {normalize_param_.mean_r, normalize_param_.mean_g,
+                              normalize_param_.mean_b, normalize_param_.mean_a};
+  const float std_rgba[4] = {normalize_param_.std_r, normalize_param_.std_g,
+                             normalize_param_.std_b, normalize_param_.std_a};
+  const bool mean_values = normalize_param_.mean_r > 0.0f || normalize_param_.mean_g > 0.0f ||
+                           normalize_param_.mean_b > 0.0f || normalize_param_.mean_a > 0.0f;
+  const bool mean_image = !mean_values && meanfile_ready_ &&
+                          normalize_param_.mean_img.length() != 0;
+  for (int k = 0; k < n_channels; ++k) {
+    pack.mean[k] = mean_values ? mean_rgba[k] : 0.0f;
+    pack.scale[k] = std_rgba[k] > 0.0f ? normalize_param_.scale / std_rgba[k]
+                                       : normalize_param_.scale;
+  }
+  if (mean_image) pack.mean_img = meanimg_.dptr_;
+  // swap the BGR(A) of OpenCV to RGB(A) and normalize in one pass
+  PackImage(res.data, res.step, res.rows, res.cols, n_channels, pack, data.dptr_);
+  // the packing is counted with the decode
+  stats_.records_decoded += 1;
+  stats_.decode_usec += static_cast<uint64_t>((t1 - t0) * 1e6) + MicrosSince(t2);
+  stats_.augment_usec += static_cast<uint64_t>((t2 - t1) * 1e6);
+  // store info for real data_shape and label_width
+  label->assign({static_cast<float>(res.channels()), static_cast<float>(res.rows),
+                 static_cast<float>(res.cols), static_cast<float>(label_buf.size())});
+  label->insert(label->end(), label_buf.begin(), label_buf.end());
+  res.release();
+#else
+  LOG(FATAL) << "Opencv is needed for image decoding and augmenting.";
+#endif
+}
+
+template<typename DType>
+inline bool ImageDetRecordIOParser<DType>::ParseNext(DataBatch *out) {
+  if (overflow_) return false;
+  CHECK(source_ != nullptr);
+  dmlc::InputSplit::Blob chunk;
+  const unsigned batch_size = batch_param_.batch_size;
+  unsigned current_size = 0;
+  out->index.resize(batch_size);
+  out->num_batch_padd = 0;
+  if (out->data.size() == 0) {
+    // the slots the images are decoded into, pinned for the copies to the gpus
+    const TShape& s = param_.data_shape;
+    out->data.resize(2);
+    out->data[0] = NDArray(mshadow::Shape4(batch_size, s[0], s[1], s[2]),
+                           Context::CPUPinned(0), false, mshadow::DataType<DType>::kFlag);
+    if (param_.label_stype == kDefaultStorage) {
+      out->data[1] = NDArray(mshadow::Shape2(batch_size, param_.label_pad_width + 4),
+                             Context::CPUPinned(0), false, mshadow::kFloat32);
+    }
+  }
+  mshadow::Tensor<cpu, 4, DType> data = out->data[0].data().get<cpu, 4, DType>();
+  labels_.resize(batch_size);
+  while (current_size < batch_size) {
+    unsigned n_to_copy;
+    if (n_parsed_ == 0) {
+      if (source_->NextChunk(&chunk)) {
+        ParseChunk(chunk);
+        inst_order_.clear();
+        inst_index_ = 0;
+        for (unsigned i = 0; i < encoded_.size(); ++i) {
+          for (unsigned j = 0; j < encoded_[i].Size(); ++j) {
+            inst_order_.push_back(std::make_pair(i, j));
           }
-          im_data += n_channels;
         }
+        // shuffle instance order if needed
+        if (record_param_.shuffle != 0) {
+          std::shuffle(inst_order_.begin(), inst_order_.end(), rnd_);
+        }
+        n_parsed_ = inst_order_.size();
+        continue;
+      }
+      if (current_size == 0) return false;
+      CHECK(!overflow_) << "number of input must be bigger than batch size";
+      if (batch_param_.round_batch == 0) {
+        out->num_batch_padd = batch_size - current_size;
+        SetLabels(current_size, out);
+        return true;
       }
-      mshadow::Tensor<cpu, 1> label = out.label().Back();
-      label = param_.label_pad_value;
-      // store info for real data_shape and label_width
-      label[0] = res.channels();
-      label[1] = res.rows;
-      label[2] = res.cols;
-      label[3] = label_buf.size();
-      mshadow::Copy(label.Slice(4, 4 + label_buf.size()),
-        mshadow::Tensor<cpu, 1>(dmlc::BeginPtr(label_buf),
-        mshadow::Shape1(label_buf.size())));
-      res.release();
+      overflow_ = true;
+      out->num_batch_padd = batch_size - current_size;
+      source_->BeforeFirst();
+      continue;
+    }
+    n_to_copy = std::min(n_parsed_, batch_size - current_size);
+    #pragma omp parallel for num_threads(param_.preprocess_threads)
+    for (int i = 0; i < static_cast<int>(n_to_copy); ++i) {
+      std::pair<unsigned, unsigned> place = inst_order_[inst_index_ + i];
+      DecodeImage(omp_get_thread_num(), place.first, place.second,
+                  data[current_size + i], &labels_[current_size + i]);
+      out->index[current_size + i] = encoded_[place.first].ids[place.second];
     }
+    n_parsed_ -= n_to_copy;
+    inst_index_ += n_to_copy;
+    current_size += n_to_copy;
   }
-#else
-      LOG(FATAL) << "Opencv is needed for image decoding and augmenting.";
-#endif
+  SetLabels(batch_size, out);
   return true;
 }
 
-// Define image record parameters
-struct ImageDetRecordParam: public dmlc::Parameter<ImageDetRecordParam> {
-  /*! \brief whether to do shuffle */
-  bool shuffle;
-  /*! \brief random seed */
-  int seed;
-  /*! \brief whether to remain silent */
-  bool verbose;
-  // declare parameters
-  DMLC_DECLARE_PARAMETER(ImageDetRecordParam) {
-    DMLC_DECLARE_FIELD(shuffle).set_default(false)
-        .describe("Augmentation Param: Whether to shuffle data.");
-    DMLC_DECLARE_FIELD(seed).set_default(0)
-        .describe("Augmentation Param: Random Seed.");
-    DMLC_DECLARE_FIELD(verbose).set_default(true)
-        .describe("Auxiliary Param: Whether to output information.");
+template<typename DType>
+inline void ImageDetRecordIOParser<DType>::SetLabels(unsigned n, DataBatch* out) const {
+  const int width = param_.label_pad_width + 4;
+  if (param_.label_stype == kDefaultStorage) {
+    mshadow::Tensor<cpu, 2> labels = out->data[1].data().get<cpu, 2, real_t>();
+    for (unsigned i = 0; i < n; ++i) {
+      labels[i] = param_.label_pad_value;
+      std::copy(labels_[i].begin(), labels_[i].end(), labels[i].dptr_);
+    }
+    return;
   }
-};
+  // a new array for each batch, its number of values changes
+  const unsigned batch_size = batch_param_.batch_size;
+  size_t nnz = 0;
+  for (unsigned i = 0; i < n; ++i) nnz += labels_[i].size();
+  NDArray label(kCSRStorage, mshadow::Shape2(batch_size, width), Context::CPU());
+  label.CheckAndAlloc({mshadow::Shape1(batch_size + 1), mshadow::Shape1(nnz)});
+  int* indptr = label.aux_data(csr::kIndPtr).dptr<int>();
+  int* idx = label.aux_data(csr::kIdx).dptr<int>();
+  real_t* values = label.data().dptr<real_t>();
+  indptr[0] = 0;
+  for (unsigned i = 0; i < batch_size; ++i) {
+    const size_t row = i < n ? labels_[i].size() : 0;
+    for (size_t j = 0; j < row; ++j) {
+      idx[indptr[i] + j] = static_cast<int>(j);
+      values[indptr[i] + j] = labels_[i][j];
+    }
+    indptr[i + 1] = indptr[i] + static_cast<int>(row);
+  }
+  out->data[1] = label;
+}
 
-// iterator on image recordio
+// create mean image.
+template<typename DType>
+inline void ImageDetRecordIOParser<DType>::CreateMeanImg(void) {
+  if (normalize_param_.verbose) {
+    LOG(INFO) << "Cannot find " << normalize_param_.mean_img
+              << ": create mean image, this will take some time...";
+  }
+  double start = dmlc::GetTime();
+  dmlc::InputSplit::Blob chunk;
+  size_t imcnt = 0;  // NOLINT(*)
+  const TShape& s = param_.data_shape;
+  const mshadow::Shape<3> shape = mshadow::Shape3(s[0], s[1], s[2]);
+  // the sums of the threads, each decodes into its image, without normalization
+  const ImageDetNormalizeParam normalize_param = normalize_param_;
+  normalize_param_.mean_r = normalize_param_.mean_g = 0.0f;
+  normalize_param_.mean_b = normalize_param_.mean_a = 0.0f;
+  normalize_param_.std_r = normalize_param_.std_g = 0.0f;
+  normalize_param_.std_b = normalize_param_.std_a = 0.0f;
+  normalize_param_.scale = 1.0f;
+  std::vector<mshadow::TensorContainer<cpu, 3> > sums(param_.preprocess_threads);
+  std::vector<mshadow::TensorContainer<cpu, 3, DType> > imgs(param_.preprocess_threads);
+  std::vector<std::vector<float> > labels(param_.preprocess_threads);
+  for (int t = 0; t < param_.preprocess_threads; ++t) {
+    sums[t].set_pad(false);
+    sums[t].Resize(shape, 0.0f);
+    imgs[t].set_pad(false);
+    imgs[t].Resize(shape);
+  }
+  while (source_->NextChunk(&chunk)) {
+    ParseChunk(chunk);
+    #pragma omp parallel num_threads(param_.preprocess_threads)
+    {
+      const int tid = omp_get_thread_num();
+      for (unsigned j = 0; j < encoded_[tid].Size(); ++j) {
+        DecodeImage(tid, tid, j, imgs[tid], &labels[tid]);
+        for (size_t k = 0; k < shape.Size(); ++k) {
+          sums[tid].dptr_[k] += imgs[tid].dptr_[k];
+        }
+      }
+    }
+    const size_t prev = imcnt;
+    for (int t = 0; t < param_.preprocess_threads; ++t) imcnt += encoded_[t].Size();
+    double elapsed = dmlc::GetTime() - start;
+    if (imcnt / 10000L != prev / 10000L && normalize_param_.verbose) {
+      LOG(INFO) << imcnt << " images processed, " << elapsed << " sec elapsed";
+    }
+  }
+  normalize_param_ = normalize_param;
+  meanimg_.Resize(shape, 0.0f);
+  for (int t = 0; t < param_.preprocess_threads; ++t) {
+    meanimg_ += sums[t];
+  }
+  meanimg_ *= (1.0f / imcnt);
+  // save as mxnet python compatible format.
+  TBlob tmp = meanimg_;
+  {
+    std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(normalize_param_.mean_img.c_str(),
+                                                          "w"));
+    NDArray::Save(fo.get(),
+                  {NDArray(tmp, 0)},
+                  {"mean_img"});
+  }
+  if (normalize_param_.verbose) {
+    LOG(INFO) << "Save mean image to " << normalize_param_.mean_img << "..";
+  }
+  meanfile_ready_ = true;
+  n_parsed_ = 0;
+  source_->BeforeFirst();
+}
+
+// iterator on image recordio, with the parser on a background thread
 template<typename DType = real_t>
-class ImageDetRecordIter : public IIterator<DataInst> {
+class ImageDetRecordIter : public IIterator<DataBatch> {
  public:
-  ImageDetRecordIter() : data_(nullptr) { }
+  ImageDetRecordIter() : out_(nullptr) { }
   // destructor
   virtual ~ImageDetRecordIter(void) {
     iter_.Destroy();
-    delete data_;
   }
   // constructor
   virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
-    param_.InitAllowUnknown(kwargs);
+    prefetch_param_.InitAllowUnknown(kwargs);
+    ImageDetRecParserParam param;
+    param.InitAllowUnknown(kwargs);
+    CHECK(param.label_stype == kDefaultStorage || prefetch_param_.copy_to_gpu < 0)
+      << "the csr labels are returned on the cpu, copy_to_gpu needs label_stype=default";
+    device_ = DeviceBatchAhead(prefetch_param_.copy_to_gpu);
     // use the kwarg to init parser
     parser_.Init(kwargs);
-    // prefetch at most 4 minbatches
-    iter_.set_max_capacity(4);
+    // maximum prefetch threaded iter internal size
+    const int kMaxPrefetchBuffer = 16;
+    iter_.set_max_capacity(kMaxPrefetchBuffer);
     // init thread iter
-    iter_.Init([this](std::vector<InstVector<DType>> **dptr) {
+    iter_.Init([this](DataBatch **dptr) {
         if (*dptr == nullptr) {
-          *dptr = new std::vector<InstVector<DType>>();
+          *dptr = new DataBatch();
         }
-        return parser_.ParseNext(*dptr);
+        if (!parser_.ParseNext(*dptr)) return false;
+        queue_.Produced();
+        return true;
       },
       [this]() { parser_.BeforeFirst(); });
-    inst_ptr_ = 0;
-    rnd_.seed(kRandMagic + param_.seed);
   }
   // before first
   virtual void BeforeFirst(void) {
     iter_.BeforeFirst();
-    inst_order_.clear();
-    inst_ptr_ = 0;
+    queue_.BeforeFirst();
+    device_.BeforeFirst();
   }
 
   virtual bool Next(void) {
-    while (true) {
-      if (inst_ptr_ < inst_order_.size()) {
-        std::pair<unsigned, unsigned> p = inst_order_[inst_ptr_];
-        out_ = (*data_)[p.first][p.second];
-        ++inst_ptr_;
-        return true;
-      } else {
-        if (data_ != nullptr) iter_.Recycle(&data_);
-        if (!iter_.Next(&data_)) return false;
-        inst_order_.clear();
-        for (unsigned i = 0; i < data_->size(); ++i) {
-          const InstVector<DType>& tmp = (*data_)[i];
-          for (unsigned j = 0; j < tmp.Size(); ++j) {
-            inst_order_.push_back(std::make_pair(i, j));
-          }
-        }
-        // shuffle instance order if needed
-        if (param_.shuffle != 0) {
-          std::shuffle(inst_order_.begin(), inst_order_.end(), rnd_);
-        }
-        inst_ptr_ = 0;
-      }
+    if (device_.enabled()) {
+      return device_.Next([this]() { return NextHost() ? out_ : nullptr; });
     }
-    return false;
+    return NextHost();
   }
 
-  virtual const DataInst &Value(void) const {
-    return out_;
+  virtual const DataBatch &Value(void) const {
+    return device_.enabled() ? device_.Value() : *out_;
+  }
+
+  virtual void GetStats(IterStatList* stats) const {
+    parser_.stats().Append(stats);
+    queue_.Append(prefetch_param_.prefetch_buffer, stats);
   }
 
  private:
-  // random magic
-  static const int kRandMagic = 233;
-  // output instance
-  DataInst out_;
-  // data ptr
-  size_t inst_ptr_;
-  // internal instance order
-  std::vector<std::pair<unsigned, unsigned> > inst_order_;
-  // data
-  std::vector<InstVector<DType>> *data_;
+  // From iter_prefetcher.h
+  inline bool NextHost(void) {
+    if (out_ != nullptr) {
+      recycle_queue_.push(out_); out_ = nullptr;
+    }
+    // do recycle
+    if (recycle_queue_.size() == prefetch_param_.prefetch_buffer) {
+      DataBatch *old_batch =  recycle_queue_.front();
+      // the parser writes into the arrays of the recycled batch
+      for (NDArray& arr : old_batch->data) {
+        arr.WaitToWrite();
+      }
+      recycle_queue_.pop();
+      iter_.Recycle(&old_batch);
+    }
+    return queue_.Next([this]() { return iter_.Next(&out_); });
+  }
+
+  /*! \brief backend thread */
+  dmlc::ThreadedIter<DataBatch> iter_;
+  /*! \brief parameters */
+  PrefetcherParam prefetch_param_;
+  /*! \brief output data */
+  DataBatch *out_;
+  /*! \brief queue to be recycled */
+  std::queue<DataBatch*> recycle_queue_;
   // internal parser
   ImageDetRecordIOParser<DType> parser_;
-  // backend thread
-  dmlc::ThreadedIter<std::vector<InstVector<DType>> > iter_;
-  // parameters
-  ImageDetRecordParam param_;
-  // random number generator
-  common::RANDOM_ENGINE rnd_;
+  /*! \brief the batches on the gpu, with copy_to_gpu */
+  DeviceBatchAhead device_;
+  /*! \brief the counters of iter_ */
+  QueueStats queue_;
 };
 
 DMLC_REGISTER_PARAMETER(ImageDetRecParserParam);
@@ -586,11 +881,10 @@ MXNET_REGISTER_IO_ITER(ImageDetRecordIter)
 .add_arguments(PrefetcherParam::__FIELDS__())
 .add_arguments(ListDefaultDetAugParams())
 .add_arguments(ImageDetNormalizeParam::__FIELDS__())
+.add_arguments(EchoParam::__FIELDS__())
 .set_body([]() {
-  return new PrefetcherIter(
-        new BatchLoader(
-            new ImageDetNormalizeIter(
-                new ImageDetRecordIter<real_t>())));
+  // the repeats keep the object labels, they are not mirrored
+  return new EchoIter(new ImageDetRecordIter<real_t>(), false);
 });
 }  // namespace io
 }  // namespace mxnet
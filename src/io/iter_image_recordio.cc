@@ -37,10 +37,12 @@
 #include "./image_iter_common.h"
 #include "./inst_vector.h"
 #include "./image_recordio.h"
+#include "./remote_recordio.h"
 #include "./image_augmenter.h"
 #include "./iter_prefetcher.h"
 #include "./iter_normalize.h"
 #include "./iter_batchloader.h"
+#include "./iter_echo.h"
 
 namespace mxnet {
 namespace io {
@@ -120,9 +122,10 @@ inline void ImageRecordIOParser<DType>::Init(
     LOG(INFO) << "ImageRecordIOParser: " << param_.path_imgrec
               << ", use " << threadget << " threads for decoding..";
   }
-  source_.reset(dmlc::InputSplit::Create(
-      param_.path_imgrec.c_str(), param_.part_index,
-      param_.num_parts, "recordio"));
+  source_.reset(CreateRecordIOSplit(
+      param_.path_imgrec, param_.part_index, param_.num_parts,
+      param_.shuffle_chunk_size > 0 ? 0 : param_.remote_read_threads,
+      param_.remote_readahead, param_.remote_read_retries));
   if (param_.shuffle_chunk_size > 0) {
     if (param_.shuffle_chunk_size > 4096) {
       LOG(INFO) << "Chunk size: " << param_.shuffle_chunk_size
@@ -350,11 +353,13 @@ files.
 .add_arguments(PrefetcherParam::__FIELDS__())
 .add_arguments(ListDefaultAugParams())
 .add_arguments(ImageNormalizeParam::__FIELDS__())
+.add_arguments(EchoParam::__FIELDS__())
 .set_body([]() {
-    return new PrefetcherIter(
-        new BatchLoader(
-            new ImageNormalizeIter(
-                new ImageRecordIter<real_t>())));
+    return new EchoIter(
+        new PrefetcherIter(
+            new BatchLoader(
+                new ImageNormalizeIter(
+                    new ImageRecordIter<real_t>()))));
   });
 
 // OLD VERSION - DEPRECATED
@@ -370,10 +375,12 @@ the data type instead of ``float``.
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
 .add_arguments(ListDefaultAugParams())
+.add_arguments(EchoParam::__FIELDS__())
 .set_body([]() {
-    return new PrefetcherIter(
-        new BatchLoader(
-            new ImageRecordIter<uint8_t>()));
+    return new EchoIter(
+        new PrefetcherIter(
+            new BatchLoader(
+                new ImageRecordIter<uint8_t>())));
   });
 }  // namespace io
 }  // namespace mxnet
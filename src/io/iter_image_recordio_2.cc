@@ -35,12 +35,55 @@
 #include <type_traits>
 #include "./image_recordio.h"
 #include "./image_augmenter.h"
+#include "./image_aug_default.h"
+#include "./image_decode_cache.h"
+#include "./image_decode_gpu.h"
 #include "./image_iter_common.h"
+#include "./image_pack.h"
+#include "./indexed_recordio.h"
+#include "./remote_recordio.h"
 #include "./inst_vector.h"
+#include "./iter_echo.h"
+#include "./iter_prefetcher.h"
+#include "./iter_stats.h"
 #include "../common/utils.h"
 
 namespace mxnet {
 namespace io {
+/*!
+ * \brief read the size of a JPEG image from its frame header
+ * \return false if buf is not a JPEG image
+ */
+inline bool JpegSize(const uint8_t* buf, size_t size, int* width, int* height) {
+  if (size < 4 || buf[0] != 0xFF || buf[1] != 0xD8) return false;
+  size_t pos = 2;
+  while (pos + 3 < size) {
+    if (buf[pos] != 0xFF) return false;
+    const uint8_t marker = buf[pos + 1];
+    if (marker == 0xFF) {
+      // fill byte
+      ++pos;
+      continue;
+    }
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+      // markers without a segment
+      pos += 2;
+      continue;
+    }
+    const size_t length = (buf[pos + 2] << 8) | buf[pos + 3];
+    // the start of frame markers, not DHT, JPG and DAC
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+        marker != 0xCC) {
+      if (pos + 9 > size) return false;
+      *height = (buf[pos + 5] << 8) | buf[pos + 6];
+      *width = (buf[pos + 7] << 8) | buf[pos + 8];
+      return *width > 0 && *height > 0;
+    }
+    pos += 2 + length;
+  }
+  return false;
+}
+
 // parser to parse image recordio
 template<typename DType>
 class ImageRecordIOParser2 {
@@ -48,11 +91,13 @@ class ImageRecordIOParser2 {
   // initialize the parser
   inline void Init(const std::vector<std::pair<std::string, std::string> >& kwargs);
 
+  /*! \brief the counters of the reads and the decodes */
+  const DecodeStats& stats() const { return stats_; }
   // set record to the head
   inline void BeforeFirst(void) {
     if (batch_param_.round_batch == 0 || !overflow) {
       n_parsed_ = 0;
-      return source_->BeforeFirst();
+      return SourceBeforeFirst();
     } else {
       overflow = false;
     }
@@ -62,8 +107,54 @@ class ImageRecordIOParser2 {
   inline bool ParseNext(DataBatch *out);
 
  private:
+  // read the next chunk, from the indexed file if there is one
+  inline bool NextChunk(dmlc::InputSplit::Blob* chunk) {
+    if (indexed_ != nullptr) return indexed_->NextChunk(&chunk_ids_);
+    return source_->NextChunk(chunk);
+  }
+  inline void SourceBeforeFirst(void) {
+    if (indexed_ != nullptr) {
+      indexed_->BeforeFirst(record_param_.shuffle ? &rnd_ : nullptr);
+    } else {
+      source_->BeforeFirst();
+    }
+  }
+  // the reader of the records thread tid parses from the chunk
+  inline ChunkRecordReader ChunkReader(const dmlc::InputSplit::Blob& chunk, int tid) const {
+    if (indexed_ != nullptr) {
+      return ChunkRecordReader(indexed_.get(), chunk_ids_, tid, param_.preprocess_threads);
+    }
+    return ChunkRecordReader(chunk, tid, param_.preprocess_threads);
+  }
+  // keep the images of a chunk encoded, with their labels
   inline void ParseChunk(dmlc::InputSplit::Blob * chunk);
+  // decode and augment an image on thread tid into its slot of a batch
+  inline void DecodeImage(int tid, const uint8_t* content, size_t content_size, uint64_t index,
+                          const TBlob& data);
+  inline void ParseLabel(const ImageRecordIO& rec, mshadow::Tensor<cpu, 1> label);
   inline void CreateMeanImg(void);
+  /*!
+   * \brief the imdecode flag for an image, decoding a JPEG image at 1/2, 1/4
+   *  or 1/8 of its size when its shorter edge stays at least the resize of
+   *  the default augmenter
+   */
+  inline int DecodeFlag(int flag, const uint8_t* buf, size_t size) const;
+  /*! \brief the undecoded images of a thread, with their labels */
+  struct EncodedImages {
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> offsets;
+    std::vector<size_t> sizes;
+    std::vector<uint64_t> ids;
+    std::vector<real_t> labels;
+    unsigned Size() const { return offsets.size(); }
+    void Clear() {
+      bytes.clear();
+      offsets.clear();
+      sizes.clear();
+      ids.clear();
+      labels.clear();
+    }
+  };
 
   // magic number to seed prng
   static const int kRandMagic = 111;
@@ -74,6 +165,7 @@ class ImageRecordIOParser2 {
   BatchParam batch_param_;
   ImageNormalizeParam normalize_param_;
   PrefetcherParam prefetch_param_;
+  ImageGPUDecodeParam gpu_param_;
   #if MXNET_USE_OPENCV
   /*! \brief augmenters */
   std::vector<std::vector<std::unique_ptr<ImageAugmenter> > > augmenters_;
@@ -83,10 +175,28 @@ class ImageRecordIOParser2 {
   common::RANDOM_ENGINE rnd_;
   /*! \brief data source */
   std::unique_ptr<dmlc::InputSplit> source_;
+  /*! \brief the memory-mapped data source, if path_imgidx is set */
+  std::unique_ptr<IndexedRecordIO> indexed_;
+  /*! \brief the records of the chunk of indexed_ */
+  std::vector<size_t> chunk_ids_;
   /*! \brief label information, if any */
   std::unique_ptr<ImageLabelMap> label_map_;
-  /*! \brief temporary results */
-  std::vector<InstVector<DType>> temp_;
+  /*! \brief the shorter edge the first augmenter resizes to, -1 to decode at full size */
+  int decode_resize_;
+  /*! \brief the resize of the default augmenter, if it is the first augmenter */
+  DefaultImageAugmentParam resize_param_;
+  bool first_aug_default_;
+  #if MXNET_USE_OPENCV
+  /*! \brief the decoded and resized images, if cache_size is set */
+  std::unique_ptr<DecodedImageCache> cache_;
+  #endif
+  /*! \brief the encoded images of the threads, decoded into the batch slots */
+  std::vector<EncodedImages> encoded_;
+  /*! \brief the encoded images of a batch */
+  std::vector<uint8_t> batch_bytes_;
+#if MXNET_USE_CUDA && MXNET_USE_NVJPEG
+  std::unique_ptr<GPUImageDecoder> gpu_decoder_;
+#endif
   /*! \brief temp space */
   mshadow::TensorContainer<cpu, 3> img_;
   /*! \brief internal instance order */
@@ -96,12 +206,11 @@ class ImageRecordIOParser2 {
   unsigned n_parsed_;
   /*! \brief overflow marker */
   bool overflow;
-  /*! \brief unit size */
-  std::vector<size_t> unit_size_;
   /*! \brief mean image, if needed */
   mshadow::TensorContainer<cpu, 3> meanimg_;
   // whether mean image is ready.
   bool meanfile_ready_;
+  DecodeStats stats_;
 };
 
 template<typename DType>
@@ -115,6 +224,7 @@ inline void ImageRecordIOParser2<DType>::Init(
   batch_param_.InitAllowUnknown(kwargs);
   normalize_param_.InitAllowUnknown(kwargs);
   prefetch_param_.InitAllowUnknown(kwargs);
+  gpu_param_.InitAllowUnknown(kwargs);
   n_parsed_ = 0;
   overflow = false;
   rnd_.seed(kRandMagic + record_param_.seed);
@@ -132,6 +242,14 @@ inline void ImageRecordIOParser2<DType>::Init(
   param_.preprocess_threads = threadget;
 
   std::vector<std::string> aug_names = dmlc::Split(param_.aug_seq, ',');
+  first_aug_default_ = !aug_names.empty() && aug_names[0] == "aug_default";
+  if (first_aug_default_) resize_param_.InitAllowUnknown(kwargs);
+  // the default augmenter resizes first, so a smaller decode gives the same result
+  decode_resize_ = first_aug_default_ && dmlc::GetEnv("MXNET_IMAGE_REDUCED_DECODE", true)
+                   ? resize_param_.resize : -1;
+  if (param_.cache_size > 0) {
+    cache_.reset(new DecodedImageCache(param_.cache_size << 20UL));
+  }
   augmenters_.clear();
   augmenters_.resize(threadget);
   // setup decoders
@@ -153,34 +271,59 @@ inline void ImageRecordIOParser2<DType>::Init(
     LOG(INFO) << "ImageRecordIOParser2: " << param_.path_imgrec
               << ", use " << threadget << " threads for decoding..";
   }
-  source_.reset(dmlc::InputSplit::Create(
-      param_.path_imgrec.c_str(), param_.part_index,
-      param_.num_parts, "recordio"));
-  if (param_.shuffle_chunk_size > 0) {
-    if (param_.shuffle_chunk_size > 4096) {
-      LOG(INFO) << "Chunk size: " << param_.shuffle_chunk_size
-                 << " MB which is larger than 4096 MB, please set "
-                    "smaller chunk size";
-    }
-    if (param_.shuffle_chunk_size < 4) {
-      LOG(INFO) << "Chunk size: " << param_.shuffle_chunk_size
-                 << " MB which is less than 4 MB, please set "
-                    "larger chunk size";
-    }
-    // 1.1 ratio is for a bit more shuffle parts to avoid boundary issue
-    unsigned num_shuffle_parts =
-        std::ceil(source_->GetTotalSize() * 1.1 /
-                  (param_.num_parts * (param_.shuffle_chunk_size << 20UL)));
-
-    if (num_shuffle_parts > 1) {
-      source_.reset(dmlc::InputSplitShuffle::Create(
-          param_.path_imgrec.c_str(), param_.part_index,
-          param_.num_parts, "recordio", num_shuffle_parts, param_.shuffle_chunk_seed));
-    }
-    source_->HintChunkSize(param_.shuffle_chunk_size << 17UL);
+  if (param_.path_imgidx.length() != 0) {
+    // chunks of records, enough for the threads to share
+    const size_t chunk_size = std::max<size_t>(batch_param_.batch_size, 1024);
+    CHECK(!param_.shard_shuffle || param_.shuffle_chunk_seed >= 0)
+        << "shard_shuffle needs a non-negative shuffle_chunk_seed";
+    indexed_.reset(new IndexedRecordIO(param_.path_imgrec, param_.path_imgidx,
+                                       param_.part_index, param_.num_parts, chunk_size,
+                                       param_.shard_shuffle ? param_.shuffle_chunk_seed : -1));
+    SourceBeforeFirst();
   } else {
-    // use 64 MB chunk when possible
-    source_->HintChunkSize(8 << 20UL);
+    CHECK(!param_.shard_shuffle) << "shard_shuffle needs the records of path_imgidx";
+    source_.reset(CreateRecordIOSplit(
+        param_.path_imgrec, param_.part_index, param_.num_parts,
+        param_.shuffle_chunk_size > 0 ? 0 : param_.remote_read_threads,
+        param_.remote_readahead, param_.remote_read_retries));
+    if (param_.shuffle_chunk_size > 0) {
+      if (param_.shuffle_chunk_size > 4096) {
+        LOG(INFO) << "Chunk size: " << param_.shuffle_chunk_size
+                   << " MB which is larger than 4096 MB, please set "
+                      "smaller chunk size";
+      }
+      if (param_.shuffle_chunk_size < 4) {
+        LOG(INFO) << "Chunk size: " << param_.shuffle_chunk_size
+                   << " MB which is less than 4 MB, please set "
+                      "larger chunk size";
+      }
+      // 1.1 ratio is for a bit more shuffle parts to avoid boundary issue
+      unsigned num_shuffle_parts =
+          std::ceil(source_->GetTotalSize() * 1.1 /
+                    (param_.num_parts * (param_.shuffle_chunk_size << 20UL)));
+
+      if (num_shuffle_parts > 1) {
+        source_.reset(dmlc::InputSplitShuffle::Create(
+            param_.path_imgrec.c_str(), param_.part_index,
+            param_.num_parts, "recordio", num_shuffle_parts, param_.shuffle_chunk_seed));
+      }
+      source_->HintChunkSize(param_.shuffle_chunk_size << 17UL);
+    } else {
+      // use 64 MB chunk when possible
+      source_->HintChunkSize(8 << 20UL);
+    }
+  }
+  if (gpu_param_.gpu_decode >= 0) {
+#if MXNET_USE_CUDA && MXNET_USE_NVJPEG
+    CHECK_EQ(param_.aug_seq, "aug_default")
+      << "gpu_decode only runs the default augmenter";
+    DefaultImageAugmentParam aug_param;
+    aug_param.InitAllowUnknown(kwargs);
+    gpu_decoder_.reset(new GPUImageDecoder(gpu_param_.gpu_decode, param_.data_shape,
+                                           aug_param, normalize_param_));
+#else
+    LOG(FATAL) << "compile with USE_CUDA=1 and USE_NVJPEG=1 to use gpu_decode";
+#endif
   }
   // Normalize init
   if (!std::is_same<DType, uint8_t>::value) {
@@ -223,24 +366,26 @@ template<typename DType>
 inline bool ImageRecordIOParser2<DType>::ParseNext(DataBatch *out) {
   if (overflow)
     return false;
-  CHECK(source_ != nullptr);
+  CHECK(source_ != nullptr || indexed_ != nullptr);
   dmlc::InputSplit::Blob chunk;
   unsigned current_size = 0;
   out->index.resize(batch_param_.batch_size);
+  const bool gpu_decode = gpu_param_.gpu_decode >= 0;
+  std::vector<size_t> batch_offsets, batch_sizes;
+  batch_bytes_.clear();
   while (current_size < batch_param_.batch_size) {
     int n_to_copy;
     if (n_parsed_ == 0) {
-      if (source_->NextChunk(&chunk)) {
+      if (NextChunk(&chunk)) {
         inst_order_.clear();
         inst_index_ = 0;
         ParseChunk(&chunk);
         unsigned n_read = 0;
-        for (unsigned i = 0; i < temp_.size(); ++i) {
-          const InstVector<DType>& tmp = temp_[i];
-          for (unsigned j = 0; j < tmp.Size(); ++j) {
+        for (unsigned i = 0; i < static_cast<unsigned>(param_.preprocess_threads); ++i) {
+          for (unsigned j = 0; j < encoded_[i].Size(); ++j) {
             inst_order_.push_back(std::make_pair(i, j));
           }
-          n_read += tmp.Size();
+          n_read += encoded_[i].Size();
         }
         n_to_copy = std::min(n_read, batch_param_.batch_size - current_size);
         n_parsed_ = n_read - n_to_copy;
@@ -253,7 +398,7 @@ inline bool ImageRecordIOParser2<DType>::ParseNext(DataBatch *out) {
         CHECK(!overflow) << "number of input images must be bigger than the batch size";
         if (batch_param_.round_batch != 0) {
           overflow = true;
-          source_->BeforeFirst();
+          SourceBeforeFirst();
         } else {
           current_size = batch_param_.batch_size;
         }
@@ -265,194 +410,246 @@ inline bool ImageRecordIOParser2<DType>::ParseNext(DataBatch *out) {
       n_parsed_ -= n_to_copy;
     }
 
-    // InitBatch
-    if (out->data.size() == 0 && n_to_copy != 0) {
-      std::pair<unsigned, unsigned> place = inst_order_[inst_index_];
-      const DataInst& first_batch = temp_[place.first][place.second];
-      out->data.resize(first_batch.data.size());
-      unit_size_.resize(first_batch.data.size());
-      for (size_t i = 0; i < out->data.size(); ++i) {
-        TShape src_shape = first_batch.data[i].shape_;
-        int src_type_flag = first_batch.data[i].type_flag_;
-        // init object attributes
-        std::vector<index_t> shape_vec;
-        shape_vec.push_back(batch_param_.batch_size);
-        for (index_t dim = 0; dim < src_shape.ndim(); ++dim) {
-          shape_vec.push_back(src_shape[dim]);
-        }
-        TShape dst_shape(shape_vec.begin(), shape_vec.end());
-        auto dtype = prefetch_param_.dtype
-          ? prefetch_param_.dtype.value()
-          : first_batch.data[i].type_flag_;
-        out->data.at(i) = NDArray(dst_shape, Context::CPUPinned(0), false, src_type_flag);
-        unit_size_[i] = src_shape.Size();
-      }
+    // InitBatch, the slots the images are decoded into, normalized images
+    // are written in the dtype of the prefetcher
+    if (out->data.size() == 0) {
+      const TShape& s = param_.data_shape;
+      const int dtype = !gpu_decode && !std::is_same<DType, uint8_t>::value &&
+                        prefetch_param_.dtype ? prefetch_param_.dtype.value()
+                                              : mshadow::DataType<DType>::kFlag;
+      out->data.resize(2);
+      // pinned, for the copies to the gpus to be asynchronous
+      out->data[0] = NDArray(mshadow::Shape4(batch_param_.batch_size, s[0], s[1], s[2]),
+                             gpu_decode ? Context::GPU(gpu_param_.gpu_decode)
+                                        : Context::CPUPinned(0),
+                             false, dtype);
+      out->data[1] = NDArray(mshadow::Shape2(batch_param_.batch_size, param_.label_width),
+                             Context::CPUPinned(0), false, mshadow::kFloat32);
     }
 
-    // Copy
+    mshadow::Tensor<cpu, 2> labels = out->data[1].data().get<cpu, 2, real_t>();
+    if (gpu_decode) {
+      // keep the images of the batch, the next chunk replaces encoded_
+      for (int i = 0; i < n_to_copy; ++i) {
+        std::pair<unsigned, unsigned> place = inst_order_[inst_index_ + i];
+        const EncodedImages& enc = encoded_[place.first];
+        const uint8_t* begin = enc.bytes.data() + enc.offsets[place.second];
+        batch_offsets.push_back(batch_bytes_.size());
+        batch_sizes.push_back(enc.sizes[place.second]);
+        batch_bytes_.insert(batch_bytes_.end(), begin, begin + enc.sizes[place.second]);
+        std::copy(enc.labels.begin() + place.second * param_.label_width,
+                  enc.labels.begin() + (place.second + 1) * param_.label_width,
+                  labels[current_size + i].dptr_);
+        out->index[current_size + i] = enc.ids[place.second];
+      }
+      inst_index_ += n_to_copy;
+      current_size += n_to_copy;
+      continue;
+    }
+    // decode and augment each image straight into its slot of the batch
+    const TBlob data = out->data[0].data();
+    const size_t slot_size = data.shape_.ProdShape(1, 4);
+    const TShape slot_shape = mshadow::Shape3(data.shape_[1], data.shape_[2], data.shape_[3]);
     #pragma omp parallel for num_threads(param_.preprocess_threads)
     for (int i = 0; i < n_to_copy; ++i) {
       std::pair<unsigned, unsigned> place = inst_order_[inst_index_ + i];
-      const DataInst& batch = temp_[place.first][place.second];
-      for (unsigned j = 0; j < batch.data.size(); ++j) {
-        CHECK_EQ(unit_size_[j], batch.data[j].Size());
-        MSHADOW_TYPE_SWITCH(out->data[j].data().type_flag_, dtype, {
-        mshadow::Copy(
-            out->data[j].data().FlatTo1D<cpu, dtype>().Slice((current_size + i) * unit_size_[j],
-              (current_size + i + 1) * unit_size_[j]),
-            batch.data[j].get_with_shape<cpu, 1, dtype>(mshadow::Shape1(unit_size_[j])));
-        });
-      }
+      const EncodedImages& enc = encoded_[place.first];
+      MSHADOW_TYPE_SWITCH(data.type_flag_, OType, {
+        const TBlob slot(data.dptr<OType>() + (current_size + i) * slot_size, slot_shape,
+                         cpu::kDevMask);
+        DecodeImage(omp_get_thread_num(), enc.bytes.data() + enc.offsets[place.second],
+                    enc.sizes[place.second], enc.ids[place.second], slot);
+      });
+      std::copy(enc.labels.begin() + place.second * param_.label_width,
+                enc.labels.begin() + (place.second + 1) * param_.label_width,
+                labels[current_size + i].dptr_);
+      out->index[current_size + i] = enc.ids[place.second];
     }
     inst_index_ += n_to_copy;
     current_size += n_to_copy;
   }
+#if MXNET_USE_CUDA && MXNET_USE_NVJPEG
+  if (gpu_decode) {
+    const double t0 = dmlc::GetTime();
+    std::vector<const uint8_t*> images;
+    for (size_t off : batch_offsets) images.push_back(batch_bytes_.data() + off);
+    gpu_decoder_->Decode(images, batch_sizes, prnds_[0].get(), out->data[0].data());
+    stats_.records_decoded += images.size();
+    stats_.decode_usec += MicrosSince(t0);
+  }
+#endif
   return true;
 }
 
+template<typename DType>
+inline int ImageRecordIOParser2<DType>::DecodeFlag(int flag, const uint8_t* buf,
+                                                  size_t size) const {
+#if MXNET_USE_OPENCV && CV_VERSION_MAJOR >= 3
+  int width, height;
+  if (decode_resize_ <= 0 || !JpegSize(buf, size, &width, &height)) return flag;
+  const int edge = std::min(width, height);
+  // libjpeg scales the IDCT, the decoded edges are rounded up
+  if ((edge + 7) / 8 >= decode_resize_) {
+    return flag ? cv::IMREAD_REDUCED_COLOR_8 : cv::IMREAD_REDUCED_GRAYSCALE_8;
+  }
+  if ((edge + 3) / 4 >= decode_resize_) {
+    return flag ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_REDUCED_GRAYSCALE_4;
+  }
+  if ((edge + 1) / 2 >= decode_resize_) {
+    return flag ? cv::IMREAD_REDUCED_COLOR_2 : cv::IMREAD_REDUCED_GRAYSCALE_2;
+  }
+#endif
+  return flag;
+}
+
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::ParseLabel(const ImageRecordIO& rec,
+                                                    mshadow::Tensor<cpu, 1> label) {
+  if (label_map_ != nullptr) {
+    mshadow::Copy(label, label_map_->Find(rec.image_index()));
+  } else if (rec.label != NULL) {
+    CHECK_EQ(param_.label_width, rec.num_label)
+      << "rec file provide " << rec.num_label << "-dimensional label "
+         "but label_width is set to " << param_.label_width;
+    mshadow::Copy(label, mshadow::Tensor<cpu, 1>(rec.label,
+                                                 mshadow::Shape1(rec.num_label)));
+  } else {
+    CHECK_EQ(param_.label_width, 1)
+      << "label_width must be 1 unless an imglist is provided "
+         "or the rec file is packed with multi dimensional label";
+    label[0] = rec.header.label;
+  }
+}
+
 template<typename DType>
 inline void ImageRecordIOParser2<DType>::ParseChunk(dmlc::InputSplit::Blob * chunk) {
-  temp_.resize(param_.preprocess_threads);
-#if MXNET_USE_OPENCV
-  // save opencv out
+  encoded_.resize(param_.preprocess_threads);
   #pragma omp parallel num_threads(param_.preprocess_threads)
   {
     CHECK(omp_get_num_threads() == param_.preprocess_threads);
     int tid = omp_get_thread_num();
-    dmlc::RecordIOChunkReader reader(*chunk, tid, param_.preprocess_threads);
+    ChunkRecordReader reader = ChunkReader(*chunk, tid);
     ImageRecordIO rec;
     dmlc::InputSplit::Blob blob;
-    // image data
-    InstVector<DType> &out = temp_[tid];
+    EncodedImages &out = encoded_[tid];
     out.Clear();
+    size_t bytes = 0;
     while (reader.NextRecord(&blob)) {
-      // Opencv decode and augments
-      cv::Mat res;
+      bytes += blob.size;
       rec.Load(blob.dptr, blob.size);
-      cv::Mat buf(1, rec.content_size, CV_8U, rec.content);
-      switch (param_.data_shape[0]) {
-       case 1:
-        res = cv::imdecode(buf, 0);
-        break;
-       case 3:
-        res = cv::imdecode(buf, 1);
-        break;
-       case 4:
-        // -1 to keep the number of channel of the encoded image, and not force gray or color.
-        res = cv::imdecode(buf, -1);
-        CHECK_EQ(res.channels(), 4)
-          << "Invalid image with index " << rec.image_index()
-          << ". Expected 4 channels, got " << res.channels();
-        break;
-       default:
-        LOG(FATAL) << "Invalid output shape " << param_.data_shape;
-      }
-      const int n_channels = res.channels();
-      for (auto& aug : augmenters_[tid]) {
-        res = aug->Process(res, nullptr, prnds_[tid].get());
-      }
-      out.Push(static_cast<unsigned>(rec.image_index()),
-               mshadow::Shape3(n_channels, res.rows, res.cols),
-               mshadow::Shape1(param_.label_width));
-
-      mshadow::Tensor<cpu, 3, DType> data = out.data().Back();
-
-      // For RGB or RGBA data, swap the B and R channel:
-      // OpenCV store as BGR (or BGRA) and we want RGB (or RGBA)
-      std::vector<int> swap_indices;
-      if (n_channels == 1) swap_indices = {0};
-      if (n_channels == 3) swap_indices = {2, 1, 0};
-      if (n_channels == 4) swap_indices = {2, 1, 0, 3};
-
-      std::uniform_real_distribution<float> rand_uniform(0, 1);
-      std::bernoulli_distribution coin_flip(0.5);
-      bool is_mirrored = (normalize_param_.rand_mirror && coin_flip(*(prnds_[tid])))
-                         || normalize_param_.mirror;
-      float contrast_scaled;
-      float illumination_scaled;
-      if (!std::is_same<DType, uint8_t>::value) {
-        contrast_scaled =
-          (rand_uniform(*(prnds_[tid])) * normalize_param_.max_random_contrast * 2
-          - normalize_param_.max_random_contrast + 1)*normalize_param_.scale;
-        illumination_scaled =
-          (rand_uniform(*(prnds_[tid])) * normalize_param_.max_random_illumination * 2
-          - normalize_param_.max_random_illumination) * normalize_param_.scale;
-      }
-      DType RGBA[4] = {};
-      for (int i = 0; i < res.rows; ++i) {
-        uchar* im_data = res.ptr<uchar>(i);
-        for (int j = 0; j < res.cols; ++j) {
-          for (int k = 0; k < n_channels; ++k) {
-            RGBA[k] = im_data[swap_indices[k]];
-          }
-          if (!std::is_same<DType, uint8_t>::value) {
-            // normalize/mirror here to avoid memory copies
-            // logic from iter_normalize.h, function SetOutImg
-
-            if (normalize_param_.mean_r > 0.0f || normalize_param_.mean_g > 0.0f ||
-                normalize_param_.mean_b > 0.0f || normalize_param_.mean_a > 0.0f) {
-              // subtract mean per channel
-              RGBA[0] -= normalize_param_.mean_r;
-              if (n_channels >= 3) {
-                RGBA[1] -= normalize_param_.mean_g;
-                RGBA[2] -= normalize_param_.mean_b;
-              }
-              if (n_channels == 4) {
-                RGBA[3] -= normalize_param_.mean_a;
-              }
-              for (int k = 0; k < n_channels; ++k) {
-                RGBA[k] = RGBA[k] * contrast_scaled + illumination_scaled;
-              }
-            } else if (!meanfile_ready_ || normalize_param_.mean_img.length() == 0) {
-              // do not subtract anything
-              for (int k = 0; k < n_channels; ++k) {
-                RGBA[k] = RGBA[k] * normalize_param_.scale;
-              }
-            } else {
-              CHECK(meanfile_ready_);
-              for (int k = 0; k < n_channels; ++k) {
-                  RGBA[k] = (RGBA[k] - meanimg_[k][i][j]) * contrast_scaled + illumination_scaled;
-              }
-            }
-          }
-          for (int k = 0; k < n_channels; ++k) {
-            if (!std::is_same<DType, uint8_t>::value) {
-              // normalize/mirror here to avoid memory copies
-              // logic from iter_normalize.h, function SetOutImg
-              if (is_mirrored) {
-                data[k][i][res.cols - j - 1] = RGBA[k];
-              } else {
-                data[k][i][j] = RGBA[k];
-              }
-            } else {
-              // do not do normalization in Uint8 reader
-              data[k][i][j] = RGBA[k];
-            }
-          }
-          im_data += n_channels;
-        }
-      }
+      out.offsets.push_back(out.bytes.size());
+      out.sizes.push_back(rec.content_size);
+      out.ids.push_back(rec.image_index());
+      out.bytes.insert(out.bytes.end(), rec.content, rec.content + rec.content_size);
+      out.labels.resize(out.labels.size() + param_.label_width);
+      ParseLabel(rec, mshadow::Tensor<cpu, 1>(
+          out.labels.data() + out.labels.size() - param_.label_width,
+          mshadow::Shape1(param_.label_width)));
+    }
+    stats_.bytes_read += bytes;
+  }
+}
 
-      mshadow::Tensor<cpu, 1> label = out.label().Back();
-      if (label_map_ != nullptr) {
-        mshadow::Copy(label, label_map_->Find(rec.image_index()));
-      } else if (rec.label != NULL) {
-        CHECK_EQ(param_.label_width, rec.num_label)
-          << "rec file provide " << rec.num_label << "-dimensional label "
-             "but label_width is set to " << param_.label_width;
-        mshadow::Copy(label, mshadow::Tensor<cpu, 1>(rec.label,
-                                                     mshadow::Shape1(rec.num_label)));
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::DecodeImage(int tid, const uint8_t* content,
+                                                     size_t content_size, uint64_t index,
+                                                     const TBlob& data) {
+#if MXNET_USE_OPENCV
+  // Opencv decode and augments
+  const double t0 = dmlc::GetTime();
+  cv::Mat res;
+  const bool cached = cache_ != nullptr && cache_->Get(index, &res);
+  if (!cached) {
+    cv::Mat buf(1, content_size, CV_8U, const_cast<uint8_t*>(content));
+    switch (param_.data_shape[0]) {
+     case 1:
+      res = cv::imdecode(buf, DecodeFlag(0, content, content_size));
+      break;
+     case 3:
+      res = cv::imdecode(buf, DecodeFlag(1, content, content_size));
+      break;
+     case 4:
+      // -1 to keep the number of channel of the encoded image, and not force gray or color.
+      res = cv::imdecode(buf, -1);
+      CHECK_EQ(res.channels(), 4)
+        << "Invalid image with index " << index
+        << ". Expected 4 channels, got " << res.channels();
+      break;
+     default:
+      LOG(FATAL) << "Invalid output shape " << param_.data_shape;
+    }
+    if (cache_ != nullptr) {
+      // cache the image after the resize of the default augmenter, unless
+      // its interpolation is random. Resizing it again to the same size
+      // is a copy.
+      if (first_aug_default_ && resize_param_.resize != -1 &&
+          resize_param_.inter_method != 10) {
+        const cv::Size size = ShorterEdgeSize(res, resize_param_.resize);
+        cv::resize(res, res, size, 0, 0,
+                   GetInterMethod(resize_param_.inter_method, res.cols, res.rows,
+                                  size.width, size.height, nullptr));
+      }
+      cache_->Put(index, res);
+    }
+  }
+  const int n_channels = res.channels();
+  const double t1 = dmlc::GetTime();
+  for (auto& aug : augmenters_[tid]) {
+    res = aug->Process(res, nullptr, prnds_[tid].get());
+  }
+  const double t2 = dmlc::GetTime();
+  CHECK(res.rows == static_cast<int>(data.shape_[1]) &&
+        res.cols == static_cast<int>(data.shape_[2]))
+    << "The augmented image with index " << index << " is " << res.rows << "x" << res.cols
+    << ", not of the data shape " << param_.data_shape;
+
+  // swap the BGR(A) of OpenCV to RGB(A), normalize, mirror and cast in one
+  // pass over the image, the uint8 reader only transposes it
+  PackParam pack;
+  if (!std::is_same<DType, uint8_t>::value) {
+    std::uniform_real_distribution<float> rand_uniform(0, 1);
+    std::bernoulli_distribution coin_flip(0.5);
+    pack.mirror = (normalize_param_.rand_mirror && coin_flip(*(prnds_[tid])))
+                  || normalize_param_.mirror;
+    const float contrast_scaled =
+      (rand_uniform(*(prnds_[tid])) * normalize_param_.max_random_contrast * 2
+      - normalize_param_.max_random_contrast + 1)*normalize_param_.scale;
+    const float illumination_scaled =
+      (rand_uniform(*(prnds_[tid])) * normalize_param_.max_random_illumination * 2
+      - normalize_param_.max_random_illumination) * normalize_param_.scale;
+    const float mean[4] = {normalize_param_.mean_r, normalize_param_.mean_g,
+                           normalize_param_.mean_b, normalize_param_.mean_a};
+    for (int k = 0; k < n_channels; ++k) {
+      if (mean[0] > 0.0f || mean[1] > 0.0f || mean[2] > 0.0f || mean[3] > 0.0f) {
+        // subtract mean per channel
+        pack.mean[k] = mean[k];
+        pack.scale[k] = contrast_scaled;
+        pack.bias[k] = illumination_scaled;
+      } else if (!meanfile_ready_ || normalize_param_.mean_img.length() == 0) {
+        // do not subtract anything
+        pack.scale[k] = normalize_param_.scale;
       } else {
-        CHECK_EQ(param_.label_width, 1)
-          << "label_width must be 1 unless an imglist is provided "
-             "or the rec file is packed with multi dimensional label";
-        label[0] = rec.header.label;
+        pack.scale[k] = contrast_scaled;
+        pack.bias[k] = illumination_scaled;
+        pack.mean_img = meanimg_.dptr_;
       }
-      res.release();
+    }
+    if (pack.mean_img != nullptr) {
+      CHECK(meanimg_.size(1) == data.shape_[1] && meanimg_.size(2) == data.shape_[2])
+        << "The mean image " << normalize_param_.mean_img << " is not of the data shape "
+        << param_.data_shape;
     }
   }
+  MSHADOW_TYPE_SWITCH(data.type_flag_, OType, {
+    PackImage(res.data, res.step, res.rows, res.cols, n_channels, pack, data.dptr<OType>());
+  });
+  // the packing is counted with the decode
+  stats_.records_decoded += 1;
+  stats_.decode_usec += static_cast<uint64_t>((t1 - t0) * 1e6) + MicrosSince(t2);
+  stats_.augment_usec += static_cast<uint64_t>((t2 - t1) * 1e6);
+  res.release();
 #else
-      LOG(FATAL) << "Opencv is needed for image decoding and augmenting.";
+  LOG(FATAL) << "Opencv is needed for image decoding and augmenting.";
 #endif
 }
 
@@ -466,32 +663,42 @@ inline void ImageRecordIOParser2<DType>::CreateMeanImg(void) {
     double start = dmlc::GetTime();
     dmlc::InputSplit::Blob chunk;
     size_t imcnt = 0;  // NOLINT(*)
-    while (source_->NextChunk(&chunk)) {
+    const TShape& s = param_.data_shape;
+    const mshadow::Shape<3> shape = mshadow::Shape3(s[0], s[1], s[2]);
+    // the sums of the threads, each decodes into its image
+    std::vector<mshadow::TensorContainer<cpu, 3> > sums(param_.preprocess_threads);
+    std::vector<mshadow::TensorContainer<cpu, 3, DType> > imgs(param_.preprocess_threads);
+    for (int t = 0; t < param_.preprocess_threads; ++t) {
+      sums[t].set_pad(false);
+      sums[t].Resize(shape, 0.0f);
+      imgs[t].set_pad(false);
+      imgs[t].Resize(shape);
+    }
+    while (NextChunk(&chunk)) {
       ParseChunk(&chunk);
-      inst_order_.clear();
-      for (unsigned i = 0; i < temp_.size(); ++i) {
-        const InstVector<DType>& tmp = temp_[i];
-        for (unsigned j = 0; j < tmp.Size(); ++j) {
-          inst_order_.push_back(std::make_pair(i, j));
+      #pragma omp parallel num_threads(param_.preprocess_threads)
+      {
+        const int tid = omp_get_thread_num();
+        const EncodedImages& enc = encoded_[tid];
+        for (unsigned j = 0; j < enc.Size(); ++j) {
+          DecodeImage(tid, enc.bytes.data() + enc.offsets[j], enc.sizes[j], enc.ids[j],
+                      TBlob(imgs[tid]));
+          for (size_t k = 0; k < shape.Size(); ++k) {
+            sums[tid].dptr_[k] += imgs[tid].dptr_[k];
+          }
         }
       }
-      for (unsigned i = 0; i < inst_order_.size(); ++i) {
-        std::pair<unsigned, unsigned> place = inst_order_[i];
-        mshadow::Tensor<cpu, 3> outimg =
-          temp_[place.first][place.second].data[0].template get<cpu, 3, real_t>();
-        if (imcnt == 0) {
-          meanimg_.Resize(outimg.shape_);
-          mshadow::Copy(meanimg_, outimg);
-        } else {
-          meanimg_ += outimg;
-        }
-        imcnt += 1;
-        double elapsed = dmlc::GetTime() - start;
-        if (imcnt % 10000L == 0 && param_.verbose) {
-          LOG(INFO) << imcnt << " images processed, " << elapsed << " sec elapsed";
-        }
+      const size_t prev = imcnt;
+      for (int t = 0; t < param_.preprocess_threads; ++t) imcnt += encoded_[t].Size();
+      double elapsed = dmlc::GetTime() - start;
+      if (imcnt / 10000L != prev / 10000L && param_.verbose) {
+        LOG(INFO) << imcnt << " images processed, " << elapsed << " sec elapsed";
       }
     }
+    meanimg_.Resize(shape, 0.0f);
+    for (int t = 0; t < param_.preprocess_threads; ++t) {
+      meanimg_ += sums[t];
+    }
     meanimg_ *= (1.0f / imcnt);
     // save as mxnet python compatible format.
     TBlob tmp = meanimg_;
@@ -520,6 +727,7 @@ class ImageRecordIter2 : public IIterator<DataBatch> {
 
     virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
       prefetch_param_.InitAllowUnknown(kwargs);
+      device_ = DeviceBatchAhead(prefetch_param_.copy_to_gpu);
       parser_.Init(kwargs);
       // maximum prefetch threaded iter internal size
       const int kMaxPrefetchBuffer = 16;
@@ -530,17 +738,38 @@ class ImageRecordIter2 : public IIterator<DataBatch> {
           if (*dptr == nullptr) {
             *dptr = new DataBatch();
           }
-          return parser_.ParseNext(*dptr);
+          if (!parser_.ParseNext(*dptr)) return false;
+          queue_.Produced();
+          return true;
           },
           [this]() { parser_.BeforeFirst(); });
     }
 
     virtual void BeforeFirst(void) {
       iter_.BeforeFirst();
+      queue_.BeforeFirst();
+      device_.BeforeFirst();
     }
 
-    // From iter_prefetcher.h
     virtual bool Next(void) {
+      if (device_.enabled()) {
+        return device_.Next([this]() { return NextHost() ? out_ : nullptr; });
+      }
+      return NextHost();
+    }
+
+    virtual const DataBatch &Value(void) const {
+      return device_.enabled() ? device_.Value() : *out_;
+    }
+
+    virtual void GetStats(IterStatList* stats) const {
+      parser_.stats().Append(stats);
+      queue_.Append(prefetch_param_.prefetch_buffer, stats);
+    }
+
+ private:
+    // From iter_prefetcher.h
+    inline bool NextHost(void) {
       if (out_ != nullptr) {
         recycle_queue_.push(out_); out_ = nullptr;
       }
@@ -554,14 +783,9 @@ class ImageRecordIter2 : public IIterator<DataBatch> {
         recycle_queue_.pop();
         iter_.Recycle(&old_batch);
       }
-      return iter_.Next(&out_);
+      return queue_.Next([this]() { return iter_.Next(&out_); });
     }
 
-    virtual const DataBatch &Value(void) const {
-      return *out_;
-    }
-
- private:
     /*! \brief Backend thread */
     dmlc::ThreadedIter<DataBatch> iter_;
     /*! \brief Parameters */
@@ -572,6 +796,10 @@ class ImageRecordIter2 : public IIterator<DataBatch> {
     std::queue<DataBatch*> recycle_queue_;
     /* \brief parser */
     ImageRecordIOParser2<DType> parser_;
+    /*! \brief the batches on the gpu, with copy_to_gpu */
+    DeviceBatchAhead device_;
+    /*! \brief the counters of iter_ */
+    QueueStats queue_;
 };
 
 MXNET_REGISTER_IO_ITER(ImageRecordIter)
@@ -600,13 +828,15 @@ Example::
 
 )code" ADD_FILELINE)
 .add_arguments(ImageRecParserParam::__FIELDS__())
+.add_arguments(ImageGPUDecodeParam::__FIELDS__())
 .add_arguments(ImageRecordParam::__FIELDS__())
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
 .add_arguments(ListDefaultAugParams())
 .add_arguments(ImageNormalizeParam::__FIELDS__())
+.add_arguments(EchoParam::__FIELDS__())
 .set_body([]() {
-    return new ImageRecordIter2<real_t>();
+    return new EchoIter(new ImageRecordIter2<real_t>());
     });
 
 MXNET_REGISTER_IO_ITER(ImageRecordUInt8Iter)
@@ -617,12 +847,14 @@ the data type instead of ``float``.
 
 )code" ADD_FILELINE)
 .add_arguments(ImageRecParserParam::__FIELDS__())
+.add_arguments(ImageGPUDecodeParam::__FIELDS__())
 .add_arguments(ImageRecordParam::__FIELDS__())
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
 .add_arguments(ListDefaultAugParams())
+.add_arguments(EchoParam::__FIELDS__())
 .set_body([]() {
-    return new ImageRecordIter2<uint8_t>();
+    return new EchoIter(new ImageRecordIter2<uint8_t>());
   });
 }  // namespace io
 }  // namespace mxnet
@@ -0,0 +1,303 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file iter_libsvm.cc
+ * \brief define a LibSVM Reader to read in csr batches
+ */
+#include <mxnet/io.h>
+#include <mxnet/ndarray.h>
+#include <dmlc/base.h>
+#include <dmlc/data.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./iter_sparse_prefetcher.h"
+#include "./image_iter_common.h"
+#include "./iter_stats.h"
+
+namespace mxnet {
+namespace io {
+// LibSVM parameters
+struct LibSVMIterParam : public dmlc::Parameter<LibSVMIterParam> {
+  /*! \brief path to data libsvm file */
+  std::string data_libsvm;
+  /*! \brief data shape */
+  TShape data_shape;
+  /*! \brief path to label libsvm file */
+  std::string label_libsvm;
+  /*! \brief label shape */
+  TShape label_shape;
+  /*! \brief partition the data into multiple parts */
+  int num_parts;
+  /*! \brief the index of the part will read */
+  int part_index;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(LibSVMIterParam) {
+    DMLC_DECLARE_FIELD(data_libsvm)
+        .describe("The input LibSVM file or a directory path.");
+    DMLC_DECLARE_FIELD(data_shape)
+        .describe("The shape of one example, the number of features.");
+    DMLC_DECLARE_FIELD(label_libsvm).set_default("NULL")
+        .describe("The input LibSVM file or a directory path of the labels. "
+                  "If NULL, the labels of the data file are returned.");
+    index_t shape1[] = {1};
+    DMLC_DECLARE_FIELD(label_shape).set_default(TShape(shape1, shape1 + 1))
+        .describe("The shape of one label.");
+    DMLC_DECLARE_FIELD(num_parts).set_default(1)
+        .describe("The number of parts the data is split into.");
+    DMLC_DECLARE_FIELD(part_index).set_default(0)
+        .describe("The index of the part to read.");
+  }
+};
+
+/*! \brief the rows of a dmlc::Parser, one at a time */
+class LibSVMRows {
+ public:
+  LibSVMRows(dmlc::Parser<uint32_t>* parser, DecodeStats* stats)
+      : parser_(parser), stats_(stats) {}
+
+  void BeforeFirst() {
+    parser_->BeforeFirst();
+    pos_ = 0;
+    block_.size = 0;
+  }
+
+  bool Next(dmlc::Row<uint32_t>* row) {
+    while (pos_ >= block_.size) {
+      const size_t bytes = parser_->BytesRead();
+      const double t0 = dmlc::GetTime();
+      if (!parser_->Next()) return false;
+      stats_->decode_usec += MicrosSince(t0);
+      // the count of the parser restarts with BeforeFirst
+      const size_t read = parser_->BytesRead();
+      stats_->bytes_read += read >= bytes ? read - bytes : read;
+      block_ = parser_->Value();
+      pos_ = 0;
+    }
+    *row = block_[pos_++];
+    return true;
+  }
+
+ private:
+  std::unique_ptr<dmlc::Parser<uint32_t> > parser_;
+  DecodeStats* stats_;
+  dmlc::RowBlock<uint32_t> block_;
+  size_t pos_{0};
+};
+
+/*!
+ * \brief returns the rows of a libsvm file as csr batches of shape
+ *  (batch_size, data_shape[0]), with dense labels. Each batch gets new
+ *  arrays, the number of non-zeros differs from batch to batch.
+ */
+class LibSVMIter: public IIterator<DataBatch> {
+ public:
+  LibSVMIter() {}
+  virtual ~LibSVMIter() {}
+
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    param_.InitAllowUnknown(kwargs);
+    batch_param_.InitAllowUnknown(kwargs);
+    CHECK_EQ(param_.data_shape.ndim(), 1U)
+        << "The data shape of LibSVMIter is the number of features";
+    CHECK_LT(param_.part_index, param_.num_parts);
+    data_rows_.reset(new LibSVMRows(dmlc::Parser<uint32_t>::Create(
+        param_.data_libsvm.c_str(), param_.part_index, param_.num_parts, "libsvm"), &stats_));
+    if (param_.label_libsvm != "NULL") {
+      label_rows_.reset(new LibSVMRows(dmlc::Parser<uint32_t>::Create(
+          param_.label_libsvm.c_str(), param_.part_index, param_.num_parts, "libsvm"),
+          &stats_));
+    } else {
+      CHECK_EQ(param_.label_shape.Size(), 1U)
+          << "The labels of the data file are scalars, set label_libsvm for other shapes";
+    }
+    std::vector<index_t> shape(1, batch_param_.batch_size);
+    shape.insert(shape.end(), param_.label_shape.begin(), param_.label_shape.end());
+    label_shape_ = TShape(shape.begin(), shape.end());
+  }
+
+  virtual void BeforeFirst() {
+    // in round_batch mode the rows after the ones of the overflowed batch come next
+    if (batch_param_.round_batch == 0 || num_overflow_ == 0) {
+      ResetRows();
+    } else {
+      num_overflow_ = 0;
+    }
+  }
+
+  virtual bool Next() {
+    if (num_overflow_ != 0) return false;
+    const index_t batch_size = batch_param_.batch_size;
+    indptr_.assign(1, 0);
+    indices_.clear();
+    values_.clear();
+    labels_.clear();
+    out_.index.clear();
+    out_.num_batch_padd = 0;
+    const index_t top = ReadRows(batch_size);
+    if (top == 0) return false;
+    if (top < batch_size) {
+      if (batch_param_.round_batch != 0) {
+        ResetRows();
+        CHECK_EQ(ReadRows(batch_size - top), batch_size - top)
+            << "number of input must be bigger than batch size";
+        num_overflow_ = batch_size - top;
+      } else {
+        // the padding rows are empty
+        indptr_.resize(batch_size + 1, indptr_.back());
+        labels_.resize(label_shape_.Size(), 0.0f);
+        out_.index.resize(batch_size, 0);
+      }
+      out_.num_batch_padd = batch_size - top;
+    }
+    MakeBatch();
+    return true;
+  }
+
+  virtual const DataBatch &Value(void) const {
+    return out_;
+  }
+
+  virtual void GetStats(IterStatList* stats) const {
+    stats_.Append(stats);
+  }
+
+ private:
+  void ResetRows() {
+    data_rows_->BeforeFirst();
+    if (label_rows_ != nullptr) label_rows_->BeforeFirst();
+    inst_counter_ = 0;
+  }
+
+  /*! \return the number of rows appended to the batch, at most n */
+  index_t ReadRows(index_t n) {
+    const uint32_t num_cols = param_.data_shape[0];
+    const size_t label_size = param_.label_shape.Size();
+    dmlc::Row<uint32_t> row;
+    index_t k = 0;
+    for (; k < n && data_rows_->Next(&row); ++k) {
+      for (size_t j = 0; j < row.length; ++j) {
+        CHECK_LT(row.index[j], num_cols)
+            << "The feature index in LibSVM is out of the data shape "
+            << param_.data_shape;
+        indices_.push_back(static_cast<int>(row.index[j]));
+        values_.push_back(row.value != nullptr ? row.value[j] : 1.0f);
+      }
+      indptr_.push_back(static_cast<int>(indices_.size()));
+      if (label_rows_ != nullptr) {
+        dmlc::Row<uint32_t> label;
+        CHECK(label_rows_->Next(&label))
+            << "Data LibSVM's row is smaller than the number of rows in label_libsvm";
+        const size_t offset = labels_.size();
+        labels_.resize(offset + label_size, 0.0f);
+        for (size_t j = 0; j < label.length; ++j) {
+          CHECK_LT(label.index[j], label_size)
+              << "The label index in LibSVM is out of the label shape " << param_.label_shape;
+          labels_[offset + label.index[j]] = label.value != nullptr ? label.value[j] : 1.0f;
+        }
+      } else {
+        labels_.push_back(row.label);
+      }
+      out_.index.push_back(inst_counter_++);
+    }
+    stats_.records_decoded += k;
+    return k;
+  }
+
+  void MakeBatch() {
+    const index_t batch_size = batch_param_.batch_size;
+    NDArray data(kCSRStorage, mshadow::Shape2(batch_size, param_.data_shape[0]),
+                 Context::CPU());
+    data.CheckAndAlloc({mshadow::Shape1(batch_size + 1), mshadow::Shape1(indices_.size())});
+    std::copy(indptr_.begin(), indptr_.end(), data.aux_data(csr::kIndPtr).dptr<int>());
+    std::copy(indices_.begin(), indices_.end(), data.aux_data(csr::kIdx).dptr<int>());
+    std::copy(values_.begin(), values_.end(), data.data().dptr<real_t>());
+    NDArray label(label_shape_, Context::CPU(), false);
+    std::copy(labels_.begin(), labels_.end(), label.data().dptr<real_t>());
+    out_.data = {data, label};
+  }
+
+  LibSVMIterParam param_;
+  BatchParam batch_param_;
+  // output batch
+  DataBatch out_;
+  // internal instance counter
+  unsigned inst_counter_{0};
+  // number of rows of the next epoch in the last batch, in round_batch mode
+  index_t num_overflow_{0};
+  TShape label_shape_;
+  // the csr arrays and the labels of the batch being read
+  std::vector<int> indptr_, indices_;
+  std::vector<real_t> values_, labels_;
+  // the counters of both readers
+  DecodeStats stats_;
+  std::unique_ptr<LibSVMRows> data_rows_;
+  std::unique_ptr<LibSVMRows> label_rows_;
+};
+
+
+DMLC_REGISTER_PARAMETER(LibSVMIterParam);
+
+MXNET_REGISTER_IO_ITER(LibSVMIter)
+.describe(R"code(Returns the LibSVM iterator, which returns the data as ``csr`` arrays.
+
+Each line of a LibSVM file is a label followed by the non-zero features of
+one example, as ``index:value`` pairs. The data of a batch is a ``csr``
+array of shape (`batch_size`, `data_shape[0]`), whose columns are the indices
+in the file. The labels are dense. If `label_libsvm` is set, the label of an
+example is the dense array of `label_shape` made of the row of that file.
+
+The file is parsed by several threads, and the batches are assembled on a
+background thread. The `round_batch` parameter works as in `CSVIter`.
+
+Examples::
+
+  // Contents of LibSVM file ``data.t``.
+  1.0 0:0.5 2:1.2
+  -2.0
+  -3.0 0:0.6 1:2.4 2:1.2
+  4 2:-1.2
+
+  // Creates a `LibSVMIter` with `batch_size`=3.
+  >>> data_iter = mx.io.LibSVMIter(data_libsvm = 'data.t', data_shape = (3,), batch_size = 3)
+  // The data of the first batch, stored in csr storage type
+  >>> data_iter.next().data[0].asnumpy()
+  [[ 0.5         0.          1.2       ]
+   [ 0.          0.          0.        ]
+   [ 0.6         2.4         1.2       ]]
+  // The label of the first batch
+  >>> data_iter.getlabel().asnumpy()
+  [ 1. -2. -3.]
+
+)code" ADD_FILELINE)
+.add_arguments(LibSVMIterParam::__FIELDS__())
+.add_arguments(BatchParam::__FIELDS__())
+.add_arguments(PrefetcherParam::__FIELDS__())
+.set_body([]() {
+    return new SparsePrefetcherIter(new LibSVMIter());
+  });
+
+}  // namespace io
+}  // namespace mxnet
@@ -30,6 +30,7 @@
 #include <vector>
 #include <utility>
 #include <map>
+#include "./iter_echo.h"
 #include "./iter_prefetcher.h"
 #include "../common/utils.h"
 
@@ -264,8 +265,9 @@ One can download the dataset from http://yann.lecun.com/exdb/mnist/
 )code" ADD_FILELINE)
 .add_arguments(MNISTParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
+.add_arguments(EchoParam::__FIELDS__())
 .set_body([]() {
-    return new PrefetcherIter(new MNISTIter());
+    return new EchoIter(new PrefetcherIter(new MNISTIter()));
   });
 
 }  // namespace io
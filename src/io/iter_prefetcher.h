@@ -37,11 +37,71 @@
 #include <vector>
 #include <queue>
 #include <algorithm>
+#include <functional>
 #include "./inst_vector.h"
 #include "./image_iter_common.h"
+#include "./iter_stats.h"
+#include "../engine/thread_affinity.h"
 
 namespace mxnet {
 namespace io {
+/*!
+ * \brief keeps the batches of an iterator one ahead on a gpu. The copy of
+ *  batch n + 1 is pushed to the engine, which runs it on a copy stream,
+ *  when batch n is returned. The two device batches are reused in turn.
+ */
+class DeviceBatchAhead {
+ public:
+  explicit DeviceBatchAhead(int dev_id = -1) : dev_id_(dev_id) {}
+
+  bool enabled() const { return dev_id_ >= 0; }
+
+  void BeforeFirst() { started_ = false; }
+
+  /*!
+   * \brief advance to the next device batch
+   * \param next_host returns the next host batch, nullptr at the end
+   */
+  bool Next(const std::function<const DataBatch*()>& next_host) {
+    if (!started_) {
+      has_next_ = CopyNext(next_host, &batches_[pos_]);
+      started_ = true;
+    }
+    if (!has_next_) return false;
+    out_ = &batches_[pos_];
+    pos_ = 1 - pos_;
+    has_next_ = CopyNext(next_host, &batches_[pos_]);
+    return true;
+  }
+
+  const DataBatch& Value() const { return *out_; }
+
+ private:
+  bool CopyNext(const std::function<const DataBatch*()>& next_host, DataBatch* dst) {
+    const DataBatch* src = next_host();
+    if (src == nullptr) return false;
+    if (dst->data.size() != src->data.size()) dst->data.resize(src->data.size());
+    for (size_t i = 0; i < src->data.size(); ++i) {
+      const NDArray& s = src->data[i];
+      if (dst->data[i].is_none() || dst->data[i].shape() != s.shape() ||
+          dst->data[i].dtype() != s.dtype()) {
+        dst->data[i] = NDArray(s.shape(), Context::GPU(dev_id_), true, s.dtype());
+      }
+      CopyFromTo(s, &dst->data[i], 0);
+    }
+    dst->index = src->index;
+    dst->num_batch_padd = src->num_batch_padd;
+    return true;
+  }
+
+  int dev_id_;
+  bool started_{false};
+  bool has_next_{false};
+  int pos_{0};
+  DataBatch batches_[2];
+  const DataBatch* out_{nullptr};
+};
+
 // iterator on image recordio
 class PrefetcherIter : public IIterator<DataBatch> {
  public:
@@ -63,6 +123,7 @@ class PrefetcherIter : public IIterator<DataBatch> {
     std::vector<std::pair<std::string, std::string> > kwargs_left;
     // init image rec param
     kwargs_left = param_.InitAllowUnknown(kwargs);
+    device_ = DeviceBatchAhead(param_.copy_to_gpu);
     // use the kwarg to init batch loader
     loader_->Init(kwargs);
     // maximum prefetch threaded iter internal size
@@ -71,6 +132,11 @@ class PrefetcherIter : public IIterator<DataBatch> {
     iter_.set_max_capacity(kMaxPrefetchBuffer);
 
     iter_.Init([this](DataBatch **dptr) {
+        if (!thread_placed_) {
+          // the producer runs on a single thread for the lifetime of iter_
+          engine::ThreadAffinity::FromEnv("MXNET_IO", 1).Apply(0);
+          thread_placed_ = true;
+        }
         if (!loader_->Next()) return false;
         const TBlobBatch& batch = loader_->Value();
         if (*dptr == nullptr) {
@@ -83,8 +149,9 @@ class PrefetcherIter : public IIterator<DataBatch> {
             auto dtype = param_.dtype
                              ? param_.dtype.value()
                              : batch.data[i].type_flag_;
+            // pinned, for the copies to the gpus to be asynchronous
             (*dptr)->data.at(i) = NDArray(batch.data[i].shape_,
-                                          Context::CPU(), false,
+                                          Context::CPUPinned(0), false,
                                           dtype);
           }
         }
@@ -103,16 +170,40 @@ class PrefetcherIter : public IIterator<DataBatch> {
                     batch.inst_index + batch.batch_size,
                     (*dptr)->index.begin());
         }
-       return true;
+        queue_.Produced();
+        return true;
       },
       [this]() { loader_->BeforeFirst(); });
   }
 
   virtual void BeforeFirst(void) {
     iter_.BeforeFirst();
+    queue_.BeforeFirst();
+    device_.BeforeFirst();
   }
 
   virtual bool Next(void) {
+    if (device_.enabled()) {
+      return device_.Next([this]() { return NextHost() ? out_ : nullptr; });
+    }
+    return NextHost();
+  }
+  virtual const DataBatch &Value(void) const {
+    return device_.enabled() ? device_.Value() : *out_;
+  }
+  virtual void GetStats(IterStatList* stats) const {
+    loader_->GetStats(stats);
+    queue_.Append(param_.prefetch_buffer, stats);
+  }
+
+ protected:
+  /*! \brief prefetcher parameters */
+  PrefetcherParam param_;
+  /*! \brief internal batch loader */
+  std::unique_ptr<IIterator<TBlobBatch> > loader_;
+
+ private:
+  inline bool NextHost(void) {
     if (out_ != nullptr) {
       recycle_queue_.push(out_); out_ = nullptr;
     }
@@ -126,25 +217,21 @@ class PrefetcherIter : public IIterator<DataBatch> {
       recycle_queue_.pop();
       iter_.Recycle(&old_batch);
     }
-    return iter_.Next(&out_);
-  }
-  virtual const DataBatch &Value(void) const {
-    return *out_;
+    return queue_.Next([this]() { return iter_.Next(&out_); });
   }
 
- protected:
-  /*! \brief prefetcher parameters */
-  PrefetcherParam param_;
-  /*! \brief internal batch loader */
-  std::unique_ptr<IIterator<TBlobBatch> > loader_;
-
- private:
   /*! \brief output data */
   DataBatch *out_;
   /*! \brief queue to be recycled */
   std::queue<DataBatch*> recycle_queue_;
   /*! \brief backend thread */
   dmlc::ThreadedIter<DataBatch> iter_;
+  /*! \brief whether the backend thread has been placed, only used by it */
+  bool thread_placed_{false};
+  /*! \brief the batches on the gpu, with copy_to_gpu */
+  DeviceBatchAhead device_;
+  /*! \brief the counters of iter_ */
+  QueueStats queue_;
 };
 }  // namespace io
 }  // namespace mxnet
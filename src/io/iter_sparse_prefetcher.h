@@ -0,0 +1,112 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file iter_sparse_prefetcher.h
+ * \brief prefetch the batches of an iterator of sparse batches
+ */
+#ifndef MXNET_IO_ITER_SPARSE_PREFETCHER_H_
+#define MXNET_IO_ITER_SPARSE_PREFETCHER_H_
+
+#include <mxnet/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/threadediter.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./image_iter_common.h"
+#include "./iter_stats.h"
+#include "../engine/thread_affinity.h"
+
+namespace mxnet {
+namespace io {
+/*!
+ * \brief runs an iterator of DataBatch on a background thread. The sparse
+ *  arrays change their number of non-zeros from batch to batch, so the base
+ *  allocates new arrays for every batch and they are passed on as they are,
+ *  instead of being copied into recycled ones as PrefetcherIter does.
+ */
+class SparsePrefetcherIter : public IIterator<DataBatch> {
+ public:
+  explicit SparsePrefetcherIter(IIterator<DataBatch>* base)
+      : loader_(base), out_(nullptr) {
+  }
+
+  ~SparsePrefetcherIter() {
+    delete out_;
+    iter_.Destroy();
+  }
+
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    param_.InitAllowUnknown(kwargs);
+    CHECK_LT(param_.copy_to_gpu, 0) << "the sparse batches are returned on the cpu";
+    CHECK(!param_.dtype) << "the sparse batches keep the type of the values they are parsed to";
+    loader_->Init(kwargs);
+    iter_.set_max_capacity(param_.prefetch_buffer);
+    iter_.Init([this](DataBatch **dptr) {
+        if (!thread_placed_) {
+          engine::ThreadAffinity::FromEnv("MXNET_IO", 1).Apply(0);
+          thread_placed_ = true;
+        }
+        if (!loader_->Next()) return false;
+        if (*dptr == nullptr) *dptr = new DataBatch();
+        **dptr = loader_->Value();
+        queue_.Produced();
+        return true;
+      },
+      [this]() { loader_->BeforeFirst(); });
+  }
+
+  virtual void BeforeFirst(void) {
+    iter_.BeforeFirst();
+    queue_.BeforeFirst();
+  }
+
+  virtual bool Next(void) {
+    if (out_ != nullptr) iter_.Recycle(&out_);
+    return queue_.Next([this]() { return iter_.Next(&out_); });
+  }
+
+  virtual const DataBatch &Value(void) const {
+    return *out_;
+  }
+
+  virtual void GetStats(IterStatList* stats) const {
+    loader_->GetStats(stats);
+    queue_.Append(param_.prefetch_buffer, stats);
+  }
+
+ private:
+  /*! \brief prefetcher parameters */
+  PrefetcherParam param_;
+  /*! \brief the iterator of the batches */
+  std::unique_ptr<IIterator<DataBatch> > loader_;
+  /*! \brief output data */
+  DataBatch *out_;
+  /*! \brief backend thread */
+  dmlc::ThreadedIter<DataBatch> iter_;
+  /*! \brief whether the backend thread has been placed, only used by it */
+  bool thread_placed_{false};
+  /*! \brief the counters of iter_ */
+  QueueStats queue_;
+};
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_ITER_SPARSE_PREFETCHER_H_
@@ -0,0 +1,159 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file iter_stats.h
+ * \brief the counters the iterators keep about their own throughput
+ *
+ * The counters of an iterator are returned by IIterator::GetStats, through
+ * MXDataIterGetStats, and written into the profile for the iterators created
+ * through the C API. Times are in microseconds.
+ */
+#ifndef MXNET_IO_ITER_STATS_H_
+#define MXNET_IO_ITER_STATS_H_
+
+#include <mxnet/io.h>
+#include <dmlc/timer.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+
+typedef std::vector<std::pair<std::string, uint64_t> > IterStatList;
+
+/*! \return the microseconds since t0, a dmlc::GetTime() */
+inline uint64_t MicrosSince(double t0) {
+  return static_cast<uint64_t>((dmlc::GetTime() - t0) * 1e6);
+}
+
+/*! \brief the counters of an iterator reading and decoding records, updated by its threads */
+struct DecodeStats {
+  std::atomic<uint64_t> bytes_read{0};
+  std::atomic<uint64_t> records_decoded{0};
+  /*! \brief the time of the threads in decoding, or parsing, the records */
+  std::atomic<uint64_t> decode_usec{0};
+  /*! \brief the time of the threads in the augmenters */
+  std::atomic<uint64_t> augment_usec{0};
+  /*! \brief the time since the iterator was created */
+  double start{dmlc::GetTime()};
+
+  void Append(IterStatList* out) const {
+    out->emplace_back("bytes_read", bytes_read);
+    out->emplace_back("records_decoded", records_decoded);
+    out->emplace_back("decode_usec", decode_usec);
+    out->emplace_back("augment_usec", augment_usec);
+    out->emplace_back("wall_usec", MicrosSince(start));
+  }
+};
+
+/*!
+ * \brief the counters of a prefetch queue. The consumer samples the batches
+ *  ready in the queue when it asks for one, and times how long it waits.
+ */
+class QueueStats {
+ public:
+  /*! \brief count a batch put in the queue, on the producer thread */
+  void Produced() { ++produced_; }
+
+  /*! \brief run next, which takes a batch from the queue, on the consumer thread */
+  template<typename F>
+  bool Next(F next) {
+    const uint64_t produced = produced_, consumed = consumed_;
+    ready_sum_ += produced > consumed ? produced - consumed : 0;
+    ++requests_;
+    const double t0 = dmlc::GetTime();
+    const bool ret = next();
+    stall_usec_ += MicrosSince(t0);
+    if (ret) {
+      ++consumed_;
+      ++batches_;
+    }
+    return ret;
+  }
+
+  /*! \brief the queue was emptied, the batches left in it are dropped */
+  void BeforeFirst() { consumed_ = produced_.load(); }
+
+  void Append(size_t capacity, IterStatList* out) const {
+    out->emplace_back("batches", batches_);
+    out->emplace_back("stall_usec", stall_usec_);
+    // the mean occupancy is queue_ready_sum / queue_requests
+    out->emplace_back("queue_requests", requests_);
+    out->emplace_back("queue_ready_sum", ready_sum_);
+    out->emplace_back("queue_capacity", capacity);
+  }
+
+ private:
+  std::atomic<uint64_t> produced_{0};
+  std::atomic<uint64_t> consumed_{0};
+  std::atomic<uint64_t> batches_{0};
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> ready_sum_{0};
+  std::atomic<uint64_t> stall_usec_{0};
+};
+
+/*! \brief the iterators created through the C API, whose counters the profiler writes */
+class IterRegistry {
+ public:
+  static IterRegistry* Get() {
+    static IterRegistry inst;
+    return &inst;
+  }
+
+  void Add(const std::string& name, const IIterator<DataBatch>* iter) {
+    std::lock_guard<std::mutex> lk(mu_);
+    iters_.emplace_back(name, iter);
+  }
+
+  void Remove(const IIterator<DataBatch>* iter) {
+    std::lock_guard<std::mutex> lk(mu_);
+    iters_.erase(std::remove_if(iters_.begin(), iters_.end(),
+                                [iter](const std::pair<std::string,
+                                                       const IIterator<DataBatch>*>& p) {
+                                  return p.second == iter;
+                                }),
+                 iters_.end());
+  }
+
+  /*! \return the names of the live iterators with their counters */
+  std::vector<std::pair<std::string, IterStatList> > Stats() {
+    std::lock_guard<std::mutex> lk(mu_);
+    std::vector<std::pair<std::string, IterStatList> > ret;
+    for (const auto& p : iters_) {
+      IterStatList stats;
+      p.second->GetStats(&stats);
+      ret.emplace_back(p.first, stats);
+    }
+    return ret;
+  }
+
+ private:
+  std::mutex mu_;
+  std::vector<std::pair<std::string, const IIterator<DataBatch>*> > iters_;
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_ITER_STATS_H_
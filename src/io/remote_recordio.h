@@ -0,0 +1,333 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file remote_recordio.h
+ * \brief a RecordIO InputSplit of a remote file, read by concurrent range reads
+ */
+#ifndef MXNET_IO_REMOTE_RECORDIO_H_
+#define MXNET_IO_REMOTE_RECORDIO_H_
+
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/recordio.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+
+/*!
+ * \brief the records of a part of a RecordIO file on S3 or HDFS.
+ *  The bytes of the part are cut in chunks which threads fetch with one
+ *  stream each, so that the throughput is not bound by the bandwidth and
+ *  the latency of a single connection. At most readahead chunks are
+ *  fetched ahead of the one consumed, and a failed read is retried on a
+ *  new stream. The parts have the same records as the parts of
+ *  dmlc::InputSplit, the records which start in their byte ranges.
+ */
+class RemoteRecordIOSplit : public dmlc::InputSplit {
+ public:
+  /*!
+   * \param uri the .rec file, a single file
+   * \param part_index the part to read
+   * \param num_parts the number of parts
+   * \param num_threads the number of concurrent range reads
+   * \param readahead the number of chunks fetched ahead of the consumed one
+   * \param retries the number of retries of a failed range read
+   */
+  RemoteRecordIOSplit(const std::string& uri, unsigned part_index, unsigned num_parts,
+                      int num_threads, int readahead, int retries)
+    : uri_(uri), readahead_(std::max(readahead, 1)), retries_(std::max(retries, 0)) {
+    {
+      // the size of the file, as dmlc::InputSplit lists it
+      std::unique_ptr<dmlc::InputSplit> split(
+          dmlc::InputSplit::Create(uri.c_str(), 0, 1, "recordio"));
+      file_size_ = split->GetTotalSize();
+    }
+    ResetPartition(part_index, num_parts);
+    for (int i = 0; i < std::max(num_threads, 1); ++i) {
+      workers_.emplace_back([this] { this->Worker(); });
+    }
+  }
+
+  ~RemoteRecordIOSplit() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) worker.join();
+  }
+
+  void HintChunkSize(size_t chunk_size) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    chunk_size_ = std::max(chunk_size, static_cast<size_t>(kMinChunkSize));
+    Stop();
+  }
+
+  size_t GetTotalSize() override { return file_size_; }
+
+  void BeforeFirst() override {
+    Start();
+  }
+
+  bool NextRecord(Blob* out_rec) override {
+    while (reader_ == nullptr || !reader_->NextRecord(out_rec)) {
+      Blob chunk;
+      if (!NextChunk(&chunk)) return false;
+      reader_.reset(new dmlc::RecordIOChunkReader(chunk));
+    }
+    return true;
+  }
+
+  bool NextChunk(Blob* out_chunk) override {
+    if (!started_) Start();
+    while (true) {
+      if (next_consume_ == num_chunks_) {
+        if (carry_.empty()) return false;
+        chunk_.swap(carry_);
+        carry_.clear();
+        break;
+      }
+      Take();
+      // the records which end in the fetched bytes, the others wait for the next chunk
+      const size_t cut = next_consume_ == num_chunks_ ? carry_.size() : LastRecordStart(carry_);
+      if (cut == 0) continue;
+      chunk_.swap(carry_);
+      carry_.assign(chunk_.begin() + cut, chunk_.end());
+      chunk_.resize(cut);
+      break;
+    }
+    out_chunk->dptr = chunk_.data();
+    out_chunk->size = chunk_.size();
+    return true;
+  }
+
+  void ResetPartition(unsigned part_index, unsigned num_parts) override {
+    CHECK_LT(part_index, num_parts);
+    // the steps of dmlc::InputSplit, aligned to the words of RecordIO
+    const size_t step = ((file_size_ + num_parts - 1) / num_parts + 3) & ~size_t(3);
+    const size_t begin = std::min(step * part_index, file_size_);
+    const size_t end = std::min(step * (part_index + 1), file_size_);
+    std::unique_ptr<dmlc::SeekStream> stream;
+    const size_t begin_record = begin == 0 ? 0 : SeekRecordBegin(begin, &stream);
+    const size_t end_record = end == file_size_ ? file_size_ : SeekRecordBegin(end, &stream);
+    std::lock_guard<std::mutex> lock(mutex_);
+    begin_ = begin_record;
+    end_ = std::max(begin_record, end_record);
+    Stop();
+  }
+
+ private:
+  static const size_t kHeadSize = 2 * sizeof(uint32_t);
+  static const size_t kMinChunkSize = 1 << 16;
+
+  /*! \brief whether the words at p are the head of the first part of a record */
+  static bool IsRecordBegin(const char* p) {
+    uint32_t head[2];
+    std::memcpy(head, p, sizeof(head));
+    if (head[0] != dmlc::RecordIOWriter::kMagic) return false;
+    const uint32_t cflag = dmlc::RecordIOWriter::DecodeFlag(head[1]);
+    return cflag == 0 || cflag == 1;
+  }
+
+  /*!
+   * \brief the position of the last record beginning in buf, which starts
+   *  with a record, 0 if there is none after the first. The magic number is
+   *  only found aligned at the heads, as RecordIO splits the records around
+   *  it.
+   */
+  static size_t LastRecordStart(const std::vector<char>& buf) {
+    if (buf.size() < kHeadSize + 4) return 0;
+    for (size_t pos = (buf.size() - kHeadSize) & ~size_t(3); pos > 0; pos -= 4) {
+      if (IsRecordBegin(buf.data() + pos)) return pos;
+    }
+    return 0;
+  }
+
+  /*! \brief the first record beginning at or after pos, the file size if there is none */
+  size_t SeekRecordBegin(size_t pos, std::unique_ptr<dmlc::SeekStream>* stream) {
+    pos = (pos + 3) & ~size_t(3);
+    std::vector<char> buf;
+    while (pos + kHeadSize <= file_size_) {
+      // overlap the blocks by a head, for the heads across them
+      buf.resize(std::min(static_cast<size_t>(kMinChunkSize), file_size_ - pos));
+      Fetch(pos, &buf, stream);
+      for (size_t i = 0; i + kHeadSize <= buf.size(); i += 4) {
+        if (IsRecordBegin(buf.data() + i)) return pos + i;
+      }
+      if (pos + buf.size() == file_size_) break;
+      pos += buf.size() - kHeadSize;
+    }
+    return file_size_;
+  }
+
+  /*! \brief read the bytes from begin into buf, retrying on a new stream */
+  void Fetch(size_t begin, std::vector<char>* buf, std::unique_ptr<dmlc::SeekStream>* stream) {
+    for (int attempt = 0;; ++attempt) {
+      try {
+        if (*stream == nullptr) stream->reset(dmlc::SeekStream::CreateForRead(uri_.c_str()));
+        (*stream)->Seek(begin);
+        for (size_t n = 0; n < buf->size();) {
+          const size_t read = (*stream)->Read(buf->data() + n, buf->size() - n);
+          CHECK_NE(read, 0U) << "unexpected end of " << uri_ << " at " << begin + n;
+          n += read;
+        }
+        return;
+      } catch (const dmlc::Error& e) {
+        stream->reset();
+        if (attempt >= retries_) throw;
+        LOG(INFO) << "Retry the read of " << uri_ << " at " << begin << ": " << e.what();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100 << std::min(attempt, 6)));
+      }
+    }
+  }
+
+  /*! \brief drop the fetched chunks, the next start fetches from the first one */
+  void Stop() {
+    ++epoch_;
+    started_ = false;
+    num_chunks_ = (end_ - begin_ + chunk_size_ - 1) / chunk_size_;
+    next_fetch_ = next_consume_ = 0;
+    ready_.clear();
+    error_.clear();
+  }
+
+  void Start() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      Stop();
+      started_ = true;
+    }
+    carry_.clear();
+    reader_.reset();
+    cv_.notify_all();
+  }
+
+  /*! \brief append the next chunk to carry_ */
+  void Take() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return ready_.count(next_consume_) != 0 || !error_.empty(); });
+    if (!error_.empty()) LOG(FATAL) << error_;
+    std::vector<char>& chunk = ready_[next_consume_];
+    carry_.insert(carry_.end(), chunk.begin(), chunk.end());
+    ready_.erase(next_consume_++);
+    lock.unlock();
+    cv_.notify_all();
+  }
+
+  void Worker() {
+    std::unique_ptr<dmlc::SeekStream> stream;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this] {
+        return stop_ || (started_ && next_fetch_ < num_chunks_ &&
+                         next_fetch_ < next_consume_ + readahead_);
+      });
+      if (stop_) return;
+      const size_t index = next_fetch_++;
+      const uint64_t epoch = epoch_;
+      const size_t begin = begin_ + index * chunk_size_;
+      std::vector<char> buf(std::min(chunk_size_, end_ - begin));
+      lock.unlock();
+      std::string error;
+      try {
+        Fetch(begin, &buf, &stream);
+      } catch (const dmlc::Error& e) {
+        error = e.what();
+      }
+      lock.lock();
+      // a chunk of a previous start
+      if (epoch != epoch_) continue;
+      if (error.empty()) {
+        ready_[index].swap(buf);
+      } else {
+        error_ = error;
+      }
+      cv_.notify_all();
+    }
+  }
+
+  std::string uri_;
+  size_t file_size_;
+  size_t readahead_;
+  int retries_;
+  /*! \brief the byte range of the records of the part */
+  size_t begin_ = 0, end_ = 0;
+  size_t chunk_size_ = 8 << 20;
+  /*! \brief the chunks read by NextChunk */
+  std::vector<char> chunk_;
+  /*! \brief the fetched bytes after the last record of chunk_ */
+  std::vector<char> carry_;
+  /*! \brief the reader of the records of chunk_, for NextRecord */
+  std::unique_ptr<dmlc::RecordIOChunkReader> reader_;
+  std::vector<std::thread> workers_;
+  /*! \brief guards the chunks and the state of the fetches below */
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  /*! \brief the fetched chunks by index, not consumed yet */
+  std::map<size_t, std::vector<char> > ready_;
+  size_t num_chunks_ = 0;
+  size_t next_fetch_ = 0;
+  size_t next_consume_ = 0;
+  /*! \brief the number of the start, the fetches of a previous one are dropped */
+  uint64_t epoch_ = 0;
+  bool started_ = false;
+  bool stop_ = false;
+  /*! \brief the error of a read which failed its retries */
+  std::string error_;
+};
+
+/*! \brief whether the RecordIO file of uri is read by RemoteRecordIOSplit */
+inline bool UseRemoteRecordIO(const std::string& uri) {
+  return (uri.compare(0, 5, "s3://") == 0 || uri.compare(0, 7, "hdfs://") == 0) &&
+      uri.find(';') == std::string::npos;
+}
+
+/*!
+ * \brief the RecordIO split of a file, read by RemoteRecordIOSplit if it is
+ *  a single file on S3 or HDFS and num_threads is positive
+ */
+inline dmlc::InputSplit* CreateRecordIOSplit(const std::string& uri, unsigned part_index,
+                                             unsigned num_parts, int num_threads,
+                                             int readahead, int retries) {
+  if (num_threads > 0 && UseRemoteRecordIO(uri)) {
+    // a directory is left to dmlc::InputSplit, which reads all its files
+    std::unique_ptr<dmlc::SeekStream> file(dmlc::SeekStream::CreateForRead(uri.c_str(), true));
+    if (file != nullptr) {
+      return new RemoteRecordIOSplit(uri, part_index, num_parts, num_threads, readahead,
+                                     retries);
+    }
+  }
+  return dmlc::InputSplit::Create(uri.c_str(), part_index, num_parts, "recordio");
+}
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_REMOTE_RECORDIO_H_
@@ -27,7 +27,10 @@
 #include <limits>
 #include <vector>
 #include <tuple>
+#include <unordered_map>
+#include "dmlc/omp.h"
 #include "mxnet/ndarray.h"
+#include "./reduce_sum_cpu.h"
 namespace mxnet {
 namespace kvstore {
 /**
@@ -55,6 +58,45 @@ class Comm {
       int key, const NDArray& src,
       const std::vector<NDArray*> dst, int priority) = 0;
 
+  /**
+   * \brief copy src, the given version of the value of key, to the arrays of dst
+   *  that do not hold it yet. An array holds the version it received from the
+   *  last broadcast of key as long as nothing else writes it, nor src, which
+   *  may be an array pushed by the caller.
+   */
+  void BroadcastChanged(int key, uint64_t version, const NDArray& src,
+                        const std::vector<NDArray*>& dst, int priority) {
+    std::vector<Received>& last = received_[key];
+    std::vector<Received> received;
+    std::vector<NDArray*> changed;
+    const uint64_t src_stamp = Engine::Get()->WriteStamp(src.var());
+    for (NDArray* d : dst) {
+      if (d->storage_type() != kDefaultStorage) {
+        changed.push_back(d);
+        continue;
+      }
+      Received r{d->var(), d->data().dptr_, d->shape().Size(), version, src_stamp, 0};
+      auto it = std::find_if(last.begin(), last.end(), [&r](const Received& l) {
+          return l.var == r.var && l.dptr == r.dptr && l.size == r.size;
+        });
+      if (it != last.end() && it->version == version && it->src_stamp == src_stamp &&
+          it->stamp == Engine::Get()->WriteStamp(r.var)) {
+        received.push_back(*it);
+      } else {
+        changed.push_back(d);
+      }
+    }
+    if (!changed.empty()) Broadcast(key, src, changed, priority);
+    // the stamps include the copies just pushed
+    for (NDArray* d : changed) {
+      if (d->storage_type() != kDefaultStorage) continue;
+      received.push_back(Received{d->var(), d->data().dptr_, d->shape().Size(), version,
+                                  src_stamp, Engine::Get()->WriteStamp(d->var())});
+    }
+    // only the arrays of the last pull are kept, which are usually the same every time
+    last.swap(received);
+  }
+
   /**
    * \brief return a pinned contex
    */
@@ -64,6 +106,22 @@ class Comm {
 
  protected:
   Context pinned_ctx_;
+
+ private:
+  /**
+   * \brief an array that received a version of a key, with the write stamps of
+   *  the source and of the array after that
+   */
+  struct Received {
+    Engine::VarHandle var;
+    const void* dptr;
+    size_t size;
+    uint64_t version;
+    uint64_t src_stamp;
+    uint64_t stamp;
+  };
+  /** \brief the arrays of the last broadcast of each key */
+  std::unordered_map<int, std::vector<Received> > received_;
 };
 
 /**
@@ -73,7 +131,7 @@ class Comm {
 class CommCPU : public Comm {
  public:
   CommCPU() {
-    nthread_reduction_ = dmlc::GetEnv("MXNET_KVSTORE_REDUCTION_NTHREADS", 4);
+    nthread_reduction_ = dmlc::GetEnv("MXNET_KVSTORE_REDUCTION_NTHREADS", 0);
     bigarray_bound_ = dmlc::GetEnv("MXNET_KVSTORE_BIGARRAY_BOUND", 1000 * 1000);
   }
   virtual ~CommCPU() { }
@@ -181,24 +239,50 @@ class CommCPU : public Comm {
     }
   }
 
+  // sum a range with the vectorized kernels, the rest with mshadow
+  template<typename DType>
+  inline static void ReduceSumRange(
+      const std::vector<DType*> &dptr, size_t offset, size_t size, bool stream) {
+    const size_t done = reduce::SumSIMD(dptr, offset, size, stream);
+    if (done < size) {
+      ReduceSumCPU(dptr, offset + done, static_cast<index_t>(size - done));
+    }
+  }
+
+  // the number of threads summing total values: enough of them to keep the
+  // memory busy, each with at least kMinReduceSizePerThread values
+  inline int ReduceThreads(size_t total) const {
+    if (total < bigarray_bound_) return 1;
+    const int max_threads = nthread_reduction_ > 0 ?
+        nthread_reduction_ : std::max(omp_get_num_procs() / 2, 1);
+    const size_t by_size = std::max(total / kMinReduceSizePerThread, static_cast<size_t>(1));
+    return static_cast<int>(std::min(static_cast<size_t>(max_threads), by_size));
+  }
+
   template<typename DType>
   inline void ReduceSumCPUImpl(std::vector<DType*> dptr, size_t total) {
-    const size_t step = std::min(bigarray_bound_, static_cast<size_t>(4 << 10));
-    long ntask = (total + step - 1) / step; // NOLINT(*)
-    if (total < bigarray_bound_ || nthread_reduction_ <= 1) {
-      ReduceSumCPU(dptr, 0, total);
+    // the sums of the arrays larger than the cache are not read again soon
+    const bool stream = total * sizeof(DType) >= kReduceStreamBytes;
+    const int nthread = ReduceThreads(total);
+    if (nthread <= 1) {
+      ReduceSumRange(dptr, 0, total, stream);
     } else {
-      #pragma omp parallel for schedule(static) num_threads(nthread_reduction_)
-      for (long j = 0; j < ntask; ++j) { // NOLINT(*)
-        size_t k = static_cast<size_t>(j);
-        size_t begin = std::min(k * step, total);
-        size_t end = std::min((k + 1) * step, total);
-        if (j == ntask - 1) CHECK_EQ(end, total);
-        ReduceSumCPU(dptr, begin, static_cast<index_t>(end - begin));
+      // one contiguous slice per thread, cut at cache lines
+      const size_t align = 64 / sizeof(DType) > 0 ? 64 / sizeof(DType) : 1;
+      size_t step = (total + nthread - 1) / nthread;
+      step = (step + align - 1) / align * align;
+      #pragma omp parallel for schedule(static) num_threads(nthread)
+      for (int j = 0; j < nthread; ++j) {
+        size_t begin = std::min(j * step, total);
+        size_t end = std::min((j + 1) * step, total);
+        if (begin < end) ReduceSumRange(dptr, begin, end - begin, stream);
       }
     }
   }
 
+  static const size_t kMinReduceSizePerThread = 1 << 18;
+  static const size_t kReduceStreamBytes = 16 << 20;
+
   /// \brief temporal space for pushing and pulling
   struct BufferEntry {
     /// \brief the merged value
@@ -223,6 +307,7 @@ class CommDevice : public Comm {
  public:
   CommDevice() {
     inited_ = false;
+    ring_bound_ = dmlc::GetEnv("MXNET_KVSTORE_RING_REDUCE_BOUND", 1000 * 1000);
   }
 
   virtual ~CommDevice() { }
@@ -248,9 +333,23 @@ class CommDevice : public Comm {
       if (dmlc::GetEnv("MXNET_ENABLE_GPU_P2P", 1)) {
         EnableP2P(devs);
       }
+      InitRing(devs);
     }
 
     auto& buf = merge_buf_[key];
+    if (src.size() == ring_.size() && src[0].shape().Size() >= ring_bound_) {
+      std::vector<NDArray> by_pos(ring_.size());
+      for (const auto& a : src) {
+        auto it = std::find(ring_.begin(), ring_.end(), a.ctx());
+        if (it == ring_.end() || !by_pos[it - ring_.begin()].is_none()) break;
+        by_pos[it - ring_.begin()] = a;
+      }
+      if (std::none_of(by_pos.begin(), by_pos.end(),
+                       [](const NDArray& a) { return a.is_none(); })) {
+        RingReduce(key, by_pos, priority);
+        return buf.merged;
+      }
+    }
     std::vector<NDArray> reduce(src.size());
     CopyFromTo(src[0], &(buf.merged), priority);
     reduce[0] = buf.merged;
@@ -339,6 +438,111 @@ class CommDevice : public Comm {
 #endif
   }
 
+  /*!
+   * \brief order the GPUs in a ring whose consecutive devices have the
+   *  fastest links, with the performance rank of the pairs reported by CUDA.
+   *  Rings need three devices or more to beat copying to the merge buffer.
+   */
+  void InitRing(const std::vector<Context>& devs) {
+    ring_.clear();
+#if MXNET_USE_CUDA
+    std::vector<Context> gpus;
+    for (const auto& d : devs) {
+      if (d.dev_mask() != gpu::kDevMask ||
+          std::find(gpus.begin(), gpus.end(), d) != gpus.end()) return;
+      gpus.push_back(d);
+    }
+    const int n = static_cast<int>(gpus.size());
+    if (n < 3) return;
+    // the cost of a link, pairs without peer access go through the host
+    std::vector<int> cost(n * n, 0);
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j) {
+        if (i == j) continue;
+        int access = 0;
+        cudaDeviceCanAccessPeer(&access, gpus[i].dev_id, gpus[j].dev_id);
+        int rank = 0;
+#if CUDA_VERSION >= 8000
+        cudaDeviceGetP2PAttribute(&rank, cudaDevP2PAttrPerformanceRank,
+                                  gpus[i].dev_id, gpus[j].dev_id);
+#endif  // CUDA_VERSION >= 8000
+        cost[i * n + j] = access ? rank : 100;
+      }
+    }
+    std::sort(gpus.begin(), gpus.end(), [](const Context& a, const Context& b) {
+        return a.dev_id < b.dev_id;
+      });
+    std::vector<int> order(n), best;
+    for (int i = 0; i < n; ++i) order[i] = i;
+    auto ring_cost = [&](const std::vector<int>& o) {
+      int c = 0;
+      for (int i = 0; i < n; ++i) c += cost[o[i] * n + o[(i + 1) % n]];
+      return c;
+    };
+    // up to 8 devices all the rings starting with the first one are tried
+    int min_cost = std::numeric_limits<int>::max();
+    do {
+      int c = ring_cost(order);
+      if (c < min_cost) {
+        min_cost = c;
+        best = order;
+      }
+    } while (n <= 8 && std::next_permutation(order.begin() + 1, order.end()));
+    for (int i : best) ring_.push_back(gpus[i]);
+#endif  // MXNET_USE_CUDA
+  }
+
+  /*!
+   * \brief reduce-scatter the arrays around the ring, one chunk per device,
+   *  and gather the reduced chunks into the merge buffer. Each link carries
+   *  (n-1)/n of the array instead of the links of the merge buffer carrying
+   *  n-1 arrays.
+   * \param src the arrays in the order of the ring
+   */
+  void RingReduce(int key, const std::vector<NDArray>& src, int priority) {
+    BufferEntry* buf = &merge_buf_[key];
+    const int n = static_cast<int>(src.size());
+    const size_t size = src[0].shape().Size();
+    const size_t chunk = (size + n - 1) / n;
+    auto begin = [=](int c) { return std::min(size, c * chunk); };
+    auto end = [=](int c) { return std::min(size, (c + 1) * chunk); };
+    std::vector<NDArray> flat(n);
+    for (int p = 0; p < n; ++p) {
+      flat[p] = src[p].Reshape(mshadow::Shape1(size));
+    }
+    if (buf->ring_acc.empty()) {
+      buf->ring_acc.resize(n);
+      buf->ring_recv.resize(n);
+      for (int p = 0; p < n; ++p) {
+        for (int c = 0; c < n; ++c) {
+          TShape s = mshadow::Shape1(std::max<size_t>(end(c) - begin(c), 1));
+          buf->ring_acc[p].emplace_back(s, ring_[p], false, buf->merged.dtype());
+          buf->ring_recv[p].emplace_back(s, ring_[p], false, buf->merged.dtype());
+        }
+      }
+    }
+    // step s: position p sends chunk p-s to position p+1, which adds its own
+    for (int s = 0; s < n - 1; ++s) {
+      for (int p = 0; p < n; ++p) {
+        const int c = ((p - s) % n + n) % n;
+        const int q = (p + 1) % n;
+        if (begin(c) == end(c)) continue;
+        NDArray sent = s == 0 ? flat[p].Slice(begin(c), end(c)) : buf->ring_acc[p][c];
+        CopyFromTo(sent, &(buf->ring_recv[q][c]), priority);
+        ElementwiseSum({flat[q].Slice(begin(c), end(c)), buf->ring_recv[q][c]},
+                       &(buf->ring_acc[q][c]), priority);
+      }
+    }
+    // position p holds the sum of chunk p+1
+    NDArray merged = buf->merged.Reshape(mshadow::Shape1(size));
+    for (int p = 0; p < n; ++p) {
+      const int c = (p + 1) % n;
+      if (begin(c) == end(c)) continue;
+      NDArray dst = merged.Slice(begin(c), end(c));
+      CopyFromTo(buf->ring_acc[p][c], &dst, priority);
+    }
+  }
+
   using KeyAttrs = std::tuple<int, TShape, int>;
   // try to allocate buff on device evenly
   void InitMergeBuffer(const std::vector<Context>& devs) {
@@ -378,9 +582,15 @@ class CommDevice : public Comm {
     NDArray merged;
     /// \brief the gpu buffer
     std::vector<NDArray> copy_buf;
+    /// \brief the reduced and the received chunks of each ring position
+    std::vector<std::vector<NDArray> > ring_acc, ring_recv;
   };
   std::unordered_map<int, BufferEntry> merge_buf_;
   bool inited_;
+  /// \brief the devices of the ring, empty when it is not used
+  std::vector<Context> ring_;
+  /// \brief the minimum size of the arrays reduced around the ring
+  size_t ring_bound_;
 };
 
 }  // namespace kvstore
@@ -0,0 +1,256 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file comm_nccl.h
+ * \brief Reduce and broadcast between the GPUs of a machine with NCCL
+ */
+#ifndef MXNET_KVSTORE_COMM_NCCL_H_
+#define MXNET_KVSTORE_COMM_NCCL_H_
+#if MXNET_USE_NCCL
+#include <nccl.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "mxnet/engine.h"
+#include "./comm.h"
+
+#define NCCL_CALL(cmd) {                                              \
+    ncclResult_t e = (cmd);                                           \
+    CHECK_EQ(e, ncclSuccess) << "NCCL: " << ncclGetErrorString(e);    \
+  }
+
+namespace mxnet {
+namespace kvstore {
+
+/*!
+ * \brief an implementation of Comm that reduces and broadcasts with the ring
+ *  collectives of NCCL, which run at the bandwidth of NVLink when the GPUs
+ *  have it. It falls back to CommDevice for the arrays that are not on
+ *  each of the GPUs of the communicator exactly once.
+ */
+class CommNCCL : public CommDevice {
+ public:
+  CommNCCL() { }
+
+  virtual ~CommNCCL() { }
+
+  const NDArray& Reduce(int key, const std::vector<NDArray>& src,
+                        int priority) override {
+    if (src.size() == 1) {
+      return src[0];
+    }
+    if (state_ == nullptr) {
+      InitState(src);
+    }
+    std::vector<NDArray> by_rank;
+    if (!ByRank(src, &by_rank)) {
+      return CommDevice::Reduce(key, src, priority);
+    }
+    NDArray& buf = MergeBuffer(key, src[0].shape(), src[0].dtype());
+    std::vector<Engine::VarHandle> const_vars;
+    for (const auto& a : by_rank) {
+      const_vars.push_back(a.var());
+    }
+    auto state = state_;
+    NDArray out = buf;
+    Engine::Get()->PushSync([by_rank, out, state](RunContext rctx) {
+        const int root = state->rank.at(out.ctx().dev_id);
+        state->Run([&](int rank) {
+            const TBlob& in = by_rank[rank].data();
+            void* recv = rank == root ? out.data().dptr_ : nullptr;
+            NCCL_CALL(ncclReduce(in.dptr_, recv, in.Size(), DataType(in.type_flag_),
+                                 ncclSum, root, state->comms[rank], state->streams[rank]));
+          });
+      }, out.ctx(), const_vars, {out.var()},
+      FnProperty::kNormal, priority, "KVStoreNCCLReduce");
+    return buf;
+  }
+
+  void Broadcast(int key, const NDArray& src,
+                 const std::vector<NDArray*> dst, int priority) override {
+    std::vector<NDArray> targets;
+    for (auto d : dst) {
+      targets.push_back(*d);
+    }
+    std::vector<NDArray> by_rank;
+    if (state_ == nullptr || !ByRank(targets, &by_rank)) {
+      CommDevice::Broadcast(key, src, dst, priority);
+      return;
+    }
+    NDArray& buf = MergeBuffer(key, src.shape(), src.dtype());
+    // without updater the stored value is the merge buffer itself
+    if (src.var() != buf.var()) {
+      CopyFromTo(src, &buf, priority);
+    }
+    const int root = state_->rank.at(buf.ctx().dev_id);
+    std::vector<Engine::VarHandle> mutable_vars;
+    for (int i = 0; i < static_cast<int>(by_rank.size()); ++i) {
+      if (i != root) {
+        mutable_vars.push_back(by_rank[i].var());
+      }
+    }
+    auto state = state_;
+    NDArray in = buf;
+    Engine::Get()->PushSync([by_rank, in, state, root](RunContext rctx) {
+        state->Run([&](int rank) {
+            const TBlob& data = rank == root ? in.data() : by_rank[rank].data();
+            NCCL_CALL(ncclBcast(data.dptr_, data.Size(), DataType(data.type_flag_),
+                                root, state->comms[rank], state->streams[rank]));
+          });
+      }, in.ctx(), {in.var()}, mutable_vars,
+      FnProperty::kNormal, priority, "KVStoreNCCLBcast");
+    // the broadcast wrote one array per device, the others are copies of it
+    std::vector<bool> done(by_rank.size(), false);
+    done[root] = true;
+    for (auto d : dst) {
+      int rank = state_->rank.at(d->ctx().dev_id);
+      if (rank == root) {
+        CopyFromTo(buf, d, priority);
+      } else if (done[rank]) {
+        CopyFromTo(by_rank[rank], d, priority);
+      } else {
+        done[rank] = true;
+      }
+    }
+  }
+
+ private:
+  /*!
+   * \brief the communicators and their streams, owned by the engine
+   *  operations as well so that they outlive the pending ones
+   */
+  struct State {
+    std::vector<int> devs;
+    std::unordered_map<int, int> rank;
+    std::vector<ncclComm_t> comms;
+    std::vector<cudaStream_t> streams;
+    std::mutex mutex;
+
+    ~State() {
+      for (size_t i = 0; i < devs.size(); ++i) {
+        cudaSetDevice(devs[i]);
+        cudaStreamDestroy(streams[i]);
+        ncclCommDestroy(comms[i]);
+      }
+    }
+
+    /*!
+     * \brief call fn with the rank of every device and wait for the
+     *  collective. The engine may run several of them at the same time,
+     *  but each one must be enqueued on all of the devices before the next.
+     */
+    template<typename F>
+    void Run(const F& fn) {
+      std::lock_guard<std::mutex> lock(mutex);
+      int current;
+      CUDA_CALL(cudaGetDevice(&current));
+      NCCL_CALL(ncclGroupStart());
+      for (size_t i = 0; i < devs.size(); ++i) {
+        CUDA_CALL(cudaSetDevice(devs[i]));
+        fn(static_cast<int>(i));
+      }
+      NCCL_CALL(ncclGroupEnd());
+      for (size_t i = 0; i < devs.size(); ++i) {
+        CUDA_CALL(cudaSetDevice(devs[i]));
+        CUDA_CALL(cudaStreamSynchronize(streams[i]));
+      }
+      CUDA_CALL(cudaSetDevice(current));
+    }
+  };
+
+  static ncclDataType_t DataType(int dtype) {
+    switch (dtype) {
+      case mshadow::kFloat32: return ncclFloat;
+      case mshadow::kFloat64: return ncclDouble;
+      case mshadow::kFloat16: return ncclHalf;
+      case mshadow::kUint8: return ncclChar;
+      case mshadow::kInt32: return ncclInt;
+      default: LOG(FATAL) << "unknown type " << dtype;
+    }
+    return ncclFloat;
+  }
+
+  /*! \brief create a communicator over the GPUs of the first reduce */
+  void InitState(const std::vector<NDArray>& src) {
+    std::vector<int> devs;
+    for (const auto& a : src) {
+      if (a.ctx().dev_mask() != gpu::kDevMask) return;
+      if (std::find(devs.begin(), devs.end(), a.ctx().dev_id) != devs.end()) return;
+      devs.push_back(a.ctx().dev_id);
+    }
+    std::sort(devs.begin(), devs.end());
+    state_ = std::make_shared<State>();
+    state_->devs = devs;
+    state_->comms.resize(devs.size());
+    state_->streams.resize(devs.size());
+    NCCL_CALL(ncclCommInitAll(state_->comms.data(), static_cast<int>(devs.size()),
+                              devs.data()));
+    int current;
+    CUDA_CALL(cudaGetDevice(&current));
+    for (size_t i = 0; i < devs.size(); ++i) {
+      state_->rank[devs[i]] = static_cast<int>(i);
+      CUDA_CALL(cudaSetDevice(devs[i]));
+      CUDA_CALL(cudaStreamCreateWithFlags(&state_->streams[i], cudaStreamNonBlocking));
+    }
+    CUDA_CALL(cudaSetDevice(current));
+  }
+
+  /*!
+   * \brief order arrays by the rank of their device, false if a device of
+   *  the communicator is missing or an array is not on one of them
+   */
+  bool ByRank(const std::vector<NDArray>& arrays, std::vector<NDArray>* by_rank) const {
+    if (state_ == nullptr) return false;
+    by_rank->clear();
+    by_rank->resize(state_->devs.size());
+    for (const auto& a : arrays) {
+      if (a.ctx().dev_mask() != gpu::kDevMask) return false;
+      auto it = state_->rank.find(a.ctx().dev_id);
+      if (it == state_->rank.end()) return false;
+      if ((*by_rank)[it->second].is_none()) (*by_rank)[it->second] = a;
+    }
+    for (const auto& a : *by_rank) {
+      if (a.is_none() || a.shape() != arrays[0].shape() || a.dtype() != arrays[0].dtype()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /*! \brief the buffer of a key, spread over the devices like CommDevice */
+  NDArray& MergeBuffer(int key, const TShape& shape, int dtype) {
+    NDArray& buf = nccl_buf_[key];
+    if (buf.is_none()) {
+      int dev_id = state_->devs[key % state_->devs.size()];
+      buf = NDArray(shape, Context::GPU(dev_id), false, dtype);
+    }
+    return buf;
+  }
+
+  std::shared_ptr<State> state_;
+  std::unordered_map<int, NDArray> nccl_buf_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_USE_NCCL
+#endif  // MXNET_KVSTORE_COMM_NCCL_H_
@@ -0,0 +1,216 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file fusion_buffer.h
+ * \brief Batches the pushes and the pulls of the small keys of a server
+ */
+#ifndef MXNET_KVSTORE_FUSION_BUFFER_H_
+#define MXNET_KVSTORE_FUSION_BUFFER_H_
+#include <dmlc/parameter.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ps/ps.h"
+
+namespace mxnet {
+namespace kvstore {
+
+/*!
+ * \brief Collects the pushes and the pulls of the small keys by server, and
+ *  sends the keys collected for a server in one message when they hold bound
+ *  values, or when the first of them has waited for delay microseconds. The
+ *  pushed values are copied into the message, and the pulled values are
+ *  copied out of the response. The callback of a key is called when the
+ *  server has responded to its message.
+ */
+class FusionBuffer {
+ public:
+  typedef std::function<void()> Callback;
+
+  FusionBuffer()
+      : bound_(dmlc::GetEnv("MXNET_KVSTORE_FUSION_BOUND", 0)),
+        delay_(dmlc::GetEnv("MXNET_KVSTORE_FUSION_DELAY", 500)) {}
+
+  ~FusionBuffer() {
+    Stop();
+  }
+
+  /*! \brief whether the keys of size values are batched */
+  bool Fits(size_t size) const {
+    return size < bound_;
+  }
+
+  /*! \brief start sending the messages of worker, if the batching is enabled */
+  void Start(ps::KVWorker<real_t>* worker) {
+    worker_ = worker;
+    if (bound_ == 0) return;
+    auto krs = ps::Postoffice::Get()->GetServerKeyRanges();
+    for (const auto& kr : krs) begins_.push_back(kr.begin());
+    pushes_.resize(krs.size());
+    pulls_.resize(krs.size());
+    flusher_ = std::thread([this]() { Run(); });
+  }
+
+  /*! \brief send the keys collected and stop */
+  void Stop() {
+    if (!flusher_.joinable()) return;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      stop_ = true;
+      cv_.notify_one();
+    }
+    flusher_.join();
+  }
+
+  /*! \brief push the len values of data from the key, which is read until callback */
+  void Push(ps::Key key, const real_t* data, int len, const Callback& callback) {
+    Add(&pushes_, Entry{key, const_cast<real_t*>(data), len, callback});
+  }
+
+  /*! \brief pull the len values of the key into data */
+  void Pull(ps::Key key, real_t* data, int len, const Callback& callback) {
+    Add(&pulls_, Entry{key, data, len, callback});
+  }
+
+ private:
+  struct Entry {
+    ps::Key key;
+    real_t* data;
+    int len;
+    Callback callback;
+  };
+  struct Bucket {
+    std::vector<Entry> entries;
+    size_t size = 0;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  void Add(std::vector<Bucket>* buckets, Entry entry) {
+    int server = std::upper_bound(begins_.begin(), begins_.end(), entry.key) -
+        begins_.begin() - 1;
+    std::vector<Entry> ready;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      Bucket& bucket = (*buckets)[server];
+      if (bucket.entries.empty()) {
+        bucket.deadline = std::chrono::steady_clock::now() + delay_;
+        cv_.notify_one();
+      }
+      bucket.size += entry.len;
+      bucket.entries.push_back(std::move(entry));
+      if (bucket.size < bound_) return;
+      ready.swap(bucket.entries);
+      bucket.size = 0;
+    }
+    Send(buckets == &pushes_, &ready);
+  }
+
+  /*! \brief send the entries of a server in one message, sorted by key */
+  void Send(bool push, std::vector<Entry>* ready) {
+    auto entries = std::make_shared<std::vector<Entry> >();
+    entries->swap(*ready);
+    std::sort(entries->begin(), entries->end(),
+              [](const Entry& a, const Entry& b) { return a.key < b.key; });
+    ps::SArray<ps::Key> keys;
+    ps::SArray<int> lens;
+    size_t size = 0;
+    for (const auto& entry : *entries) {
+      keys.push_back(entry.key);
+      lens.push_back(entry.len);
+      size += entry.len;
+    }
+    auto vals = std::make_shared<ps::SArray<real_t> >(size);
+    if (push) {
+      real_t* data = vals->data();
+      for (const auto& entry : *entries) {
+        std::copy(entry.data, entry.data + entry.len, data);
+        data += entry.len;
+      }
+      worker_->ZPush(keys, *vals, lens, 0, [entries]() {
+          for (const auto& entry : *entries) entry.callback();
+        });
+    } else {
+      worker_->ZPull(keys, vals.get(), nullptr, 0, [entries, vals]() {
+          const real_t* data = vals->data();
+          for (const auto& entry : *entries) {
+            std::copy(data, data + entry.len, entry.data);
+            data += entry.len;
+            entry.callback();
+          }
+        });
+    }
+  }
+
+  /*! \brief send the buckets whose first key has waited for delay */
+  void Run() {
+    std::unique_lock<std::mutex> lk(mu_);
+    while (true) {
+      auto now = std::chrono::steady_clock::now();
+      auto next = std::chrono::steady_clock::time_point::max();
+      std::vector<std::pair<bool, std::vector<Entry> > > ready;
+      for (auto* buckets : {&pushes_, &pulls_}) {
+        for (auto& bucket : *buckets) {
+          if (bucket.entries.empty()) continue;
+          if (stop_ || bucket.deadline <= now) {
+            ready.emplace_back(buckets == &pushes_, std::vector<Entry>());
+            ready.back().second.swap(bucket.entries);
+            bucket.size = 0;
+          } else {
+            next = std::min(next, bucket.deadline);
+          }
+        }
+      }
+      if (!ready.empty()) {
+        lk.unlock();
+        for (auto& r : ready) Send(r.first, &r.second);
+        lk.lock();
+        continue;
+      }
+      if (stop_) return;
+      if (next == std::chrono::steady_clock::time_point::max()) {
+        cv_.wait(lk);
+      } else {
+        cv_.wait_until(lk, next);
+      }
+    }
+  }
+
+  /*! \brief the number of values of the messages, 0 to disable the batching */
+  size_t bound_;
+  std::chrono::microseconds delay_;
+  ps::KVWorker<real_t>* worker_ = nullptr;
+  /*! \brief the first key of each server */
+  std::vector<ps::Key> begins_;
+  std::vector<Bucket> pushes_, pulls_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread flusher_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_FUSION_BUFFER_H_
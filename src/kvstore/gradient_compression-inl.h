@@ -0,0 +1,113 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file gradient_compression-inl.h
+ * \brief Kernels quantizing the gradients
+ */
+#ifndef MXNET_KVSTORE_GRADIENT_COMPRESSION_INL_H_
+#define MXNET_KVSTORE_GRADIENT_COMPRESSION_INL_H_
+#include <stdint.h>
+#include "./gradient_compression.h"
+#include "../operator/mxnet_op.h"
+
+namespace mxnet {
+namespace kvstore {
+
+/*!
+ * \brief one word per thread. the code of a value is 3 for threshold, 2 for
+ *  -threshold and 0 for 0, or 1 for threshold and 0 for -threshold with 1
+ *  bit. the value sent is subtracted from the residual.
+ */
+template<int bits>
+struct quantize {
+  MSHADOW_XINLINE static void Map(int i, uint32_t* out, const float* grad, float* residual,
+                                  int size, float threshold) {
+    const int per_word = 32 / bits;
+    const int start = i * per_word;
+    const int end = start + per_word < size ? start + per_word : size;
+    uint32_t word = 0;
+    for (int j = start; j < end; ++j) {
+      float r = residual[j] + grad[j];
+      uint32_t code;
+      if (bits == 1) {
+        code = r >= 0.0f ? 1 : 0;
+        r -= code ? threshold : -threshold;
+      } else if (r >= threshold) {
+        code = 3;
+        r -= threshold;
+      } else if (r <= -threshold) {
+        code = 2;
+        r += threshold;
+      } else {
+        code = 0;
+      }
+      residual[j] = r;
+      word |= code << ((j - start) * bits);
+    }
+    out[i] = word;
+  }
+};
+
+/*! \brief one value per thread */
+template<int bits>
+struct dequantize {
+  MSHADOW_XINLINE static void Map(int i, float* out, const uint32_t* in, float threshold) {
+    const int per_word = 32 / bits;
+    const uint32_t code = (in[i / per_word] >> ((i % per_word) * bits)) & ((1U << bits) - 1);
+    if (bits == 1) {
+      out[i] = code ? threshold : -threshold;
+    } else {
+      out[i] = code == 3 ? threshold : (code == 2 ? -threshold : 0.0f);
+    }
+  }
+};
+
+template<typename xpu>
+void QuantizeLaunch(mshadow::Stream<xpu>* s, int type, const TBlob& grad, const TBlob& out,
+                    const TBlob& residual, float threshold) {
+  using namespace mxnet::op;
+  const int size = grad.Size();
+  uint32_t* words = reinterpret_cast<uint32_t*>(out.dptr<float>());
+  if (type == kOneBit) {
+    mxnet_op::Kernel<quantize<1>, xpu>::Launch(s, out.Size(), words, grad.dptr<float>(),
+                                              residual.dptr<float>(), size, threshold);
+  } else {
+    mxnet_op::Kernel<quantize<2>, xpu>::Launch(s, out.Size(), words, grad.dptr<float>(),
+                                              residual.dptr<float>(), size, threshold);
+  }
+}
+
+template<typename xpu>
+void DequantizeLaunch(mshadow::Stream<xpu>* s, int type, const TBlob& in, const TBlob& out,
+                      float threshold) {
+  using namespace mxnet::op;
+  const uint32_t* words = reinterpret_cast<const uint32_t*>(in.dptr<float>());
+  if (type == kOneBit) {
+    mxnet_op::Kernel<dequantize<1>, xpu>::Launch(s, out.Size(), out.dptr<float>(), words,
+                                                threshold);
+  } else {
+    mxnet_op::Kernel<dequantize<2>, xpu>::Launch(s, out.Size(), out.dptr<float>(), words,
+                                                threshold);
+  }
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_GRADIENT_COMPRESSION_INL_H_
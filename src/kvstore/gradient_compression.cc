@@ -0,0 +1,122 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file gradient_compression.cc
+ * \brief Compression of the gradients pushed to the servers
+ */
+#include <mxnet/engine.h>
+#include <sstream>
+#include "./gradient_compression-inl.h"
+
+namespace mxnet {
+namespace kvstore {
+
+DMLC_REGISTER_PARAMETER(GradientCompressionParam);
+
+template<>
+void QuantizeImpl<cpu>(mshadow::Stream<cpu>* s, int type, const TBlob& grad, const TBlob& out,
+                       const TBlob& residual, float threshold) {
+  QuantizeLaunch(s, type, grad, out, residual, threshold);
+}
+
+template<>
+void DequantizeImpl<cpu>(mshadow::Stream<cpu>* s, int type, const TBlob& in, const TBlob& out,
+                         float threshold) {
+  DequantizeLaunch(s, type, in, out, threshold);
+}
+
+std::string GradientCompression::EncodeParams() const {
+  std::ostringstream os;
+  os << param_.type << ',' << param_.threshold;
+  return os.str();
+}
+
+void GradientCompression::DecodeParams(const std::string& str) {
+  std::istringstream is(str);
+  char sep;
+  CHECK(is >> param_.type >> sep >> param_.threshold)
+    << "Invalid gradient compression parameters " << str;
+}
+
+void GradientCompression::Quantize(const NDArray& from, NDArray* to, NDArray* residual,
+                                   int priority) const {
+  CHECK_EQ(from.dtype(), mshadow::kFloat32) << "Gradient compression only supports float32";
+  CHECK(from.ctx() == to->ctx() && from.ctx() == residual->ctx())
+    << "The gradient is quantized on its own device";
+  CHECK_EQ(to->shape().Size(), compressed_size(from.shape().Size()));
+  const int type = param_.type;
+  const float threshold = param_.threshold;
+  NDArray grad = from, out = *to, res = *residual;
+  switch (from.ctx().dev_mask()) {
+    case cpu::kDevMask: {
+      Engine::Get()->PushSync([grad, out, res, type, threshold](RunContext ctx) {
+          QuantizeImpl<cpu>(ctx.get_stream<cpu>(), type, grad.data(), out.data(), res.data(),
+                            threshold);
+        }, from.ctx(), {from.var()}, {to->var(), residual->var()},
+        FnProperty::kNormal, priority, PROFILER_MESSAGE("QuantizeGradient"));
+      break;
+    }
+#if MXNET_USE_CUDA
+    case gpu::kDevMask: {
+      Engine::Get()->PushSync([grad, out, res, type, threshold](RunContext ctx) {
+          QuantizeImpl<gpu>(ctx.get_stream<gpu>(), type, grad.data(), out.data(), res.data(),
+                            threshold);
+          // Wait GPU kernel to complete
+          ctx.get_stream<gpu>()->Wait();
+        }, from.ctx(), {from.var()}, {to->var(), residual->var()},
+        FnProperty::kNormal, priority, PROFILER_MESSAGE("QuantizeGradient"));
+      break;
+    }
+#endif
+    default: LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+  }
+}
+
+void GradientCompression::Dequantize(const NDArray& from, NDArray* to, int priority) const {
+  CHECK_EQ(from.shape().Size(), compressed_size(to->shape().Size()));
+  CHECK(from.ctx() == to->ctx()) << "The gradient is dequantized on its own device";
+  const int type = param_.type;
+  const float threshold = param_.threshold;
+  NDArray in = from, out = *to;
+  switch (from.ctx().dev_mask()) {
+    case cpu::kDevMask: {
+      Engine::Get()->PushSync([in, out, type, threshold](RunContext ctx) {
+          DequantizeImpl<cpu>(ctx.get_stream<cpu>(), type, in.data(), out.data(), threshold);
+        }, from.ctx(), {from.var()}, {to->var()},
+        FnProperty::kNormal, priority, PROFILER_MESSAGE("DequantizeGradient"));
+      break;
+    }
+#if MXNET_USE_CUDA
+    case gpu::kDevMask: {
+      Engine::Get()->PushSync([in, out, type, threshold](RunContext ctx) {
+          DequantizeImpl<gpu>(ctx.get_stream<gpu>(), type, in.data(), out.data(), threshold);
+          // Wait GPU kernel to complete
+          ctx.get_stream<gpu>()->Wait();
+        }, from.ctx(), {from.var()}, {to->var()},
+        FnProperty::kNormal, priority, PROFILER_MESSAGE("DequantizeGradient"));
+      break;
+    }
+#endif
+    default: LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+  }
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
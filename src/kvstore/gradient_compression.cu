@@ -0,0 +1,42 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file gradient_compression.cu
+ * \brief Compression of the gradients pushed to the servers
+ */
+#include "./gradient_compression-inl.h"
+
+namespace mxnet {
+namespace kvstore {
+
+template<>
+void QuantizeImpl<gpu>(mshadow::Stream<gpu>* s, int type, const TBlob& grad, const TBlob& out,
+                       const TBlob& residual, float threshold) {
+  QuantizeLaunch(s, type, grad, out, residual, threshold);
+}
+
+template<>
+void DequantizeImpl<gpu>(mshadow::Stream<gpu>* s, int type, const TBlob& in, const TBlob& out,
+                         float threshold) {
+  DequantizeLaunch(s, type, in, out, threshold);
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
@@ -0,0 +1,109 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file gradient_compression.h
+ * \brief Compression of the gradients pushed to the servers
+ */
+#ifndef MXNET_KVSTORE_GRADIENT_COMPRESSION_H_
+#define MXNET_KVSTORE_GRADIENT_COMPRESSION_H_
+#include <dmlc/parameter.h>
+#include <mxnet/ndarray.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace kvstore {
+
+enum CompressionType {
+  kNone, kOneBit, kTwoBit
+};
+
+struct GradientCompressionParam : public dmlc::Parameter<GradientCompressionParam> {
+  int type;
+  float threshold;
+  DMLC_DECLARE_PARAMETER(GradientCompressionParam) {
+    DMLC_DECLARE_FIELD(type).set_default(kNone)
+    .add_enum("none", kNone)
+    .add_enum("1bit", kOneBit)
+    .add_enum("2bit", kTwoBit)
+    .describe("The compression of the gradients. 2bit sends -threshold, 0 or "
+              "threshold for each value, 1bit sends -threshold or threshold.");
+    DMLC_DECLARE_FIELD(threshold).set_default(0.5f).set_lower_bound(0.0f)
+    .describe("The magnitude of the values sent.");
+  }
+};
+
+/*! \brief quantize grad into the words of out, runs on the device of xpu */
+template<typename xpu>
+void QuantizeImpl(mshadow::Stream<xpu>* s, int type, const TBlob& grad, const TBlob& out,
+                  const TBlob& residual, float threshold);
+
+template<typename xpu>
+void DequantizeImpl(mshadow::Stream<xpu>* s, int type, const TBlob& in, const TBlob& out,
+                    float threshold);
+
+/*!
+ * \brief Quantizes the gradients of a worker to 1 or 2 bits per value,
+ *  packed into the bits of float32 words. What a value loses to the
+ *  quantization is kept in a residual and added to the next gradient, so
+ *  it is eventually sent. The servers dequantize before merging.
+ */
+class GradientCompression {
+ public:
+  void SetParams(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    param_.Init(kwargs);
+  }
+
+  /*! \brief the parameters, to send them to the servers */
+  std::string EncodeParams() const;
+
+  void DecodeParams(const std::string& str);
+
+  bool enabled() const {
+    return param_.type != kNone;
+  }
+
+  /*! \brief the number of values held by a float32 word */
+  int values_per_word() const {
+    return param_.type == kOneBit ? 32 : 16;
+  }
+
+  /*! \brief the number of float32 words holding size values */
+  size_t compressed_size(size_t size) const {
+    return (size + values_per_word() - 1) / values_per_word();
+  }
+
+  /*!
+   * \brief quantize from into to, on the device of from
+   * \param residual the error of the previous quantizations, updated
+   */
+  void Quantize(const NDArray& from, NDArray* to, NDArray* residual, int priority) const;
+
+  /*! \brief dequantize from into to, whose size is the size of the gradient */
+  void Dequantize(const NDArray& from, NDArray* to, int priority) const;
+
+ private:
+  GradientCompressionParam param_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_GRADIENT_COMPRESSION_H_
@@ -36,12 +36,16 @@ KVStore* KVStore::Create(const char *type_name) {
   std::transform(tname.begin(), tname.end(), tname.begin(), ::tolower);
   KVStore* kv = nullptr;
   bool use_device_comm = false;
+  bool use_nccl = false;
   auto has = [tname](const std::string& pattern) {
     return tname.find(pattern) != std::string::npos;
   };
   if (has("device")) {
     use_device_comm = true;
   }
+  if (has("nccl")) {
+    use_nccl = true;
+  }
 
   if (has("dist")) {
 #if MXNET_USE_DIST_KVSTORE
@@ -55,7 +59,7 @@ KVStore* KVStore::Create(const char *type_name) {
     return nullptr;
 #endif  // MXNET_USE_DIST_KVSTORE
   } else {
-    kv =  new kvstore::KVStoreLocal(use_device_comm);
+    kv =  new kvstore::KVStoreLocal(use_device_comm, use_nccl);
   }
   kv->type_ = tname;
   return kv;
@@ -23,12 +23,25 @@
  */
 #ifndef MXNET_KVSTORE_KVSTORE_DIST_H_
 #define MXNET_KVSTORE_KVSTORE_DIST_H_
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 #include "./kvstore_local.h"
 #include "mxnet/engine.h"
 #include "ps/ps.h"
 #include "./kvstore_dist_server.h"
+#include "./fusion_buffer.h"
+#include "./gradient_compression.h"
+#include "./row_sparse.h"
+#include "./wire_format.h"
 #if MKL_EXPERIMENTAL == 1
 #include <mkl_memory.h>
 #include "../operator/mkl/mkl_memory-inl.h"
@@ -50,9 +63,15 @@ namespace kvstore {
 class KVStoreDist : public KVStoreLocal {
  public:
   explicit KVStoreDist(bool use_device_comm)
-      : KVStoreLocal(use_device_comm), ps_worker_(nullptr), server_(nullptr) {
+      : KVStoreLocal(use_device_comm), ps_worker_(nullptr), server_(nullptr),
+        group_size_(1) {
     if (IsWorkerNode()) {
+      using namespace std::placeholders;
       ps_worker_ = new ps::KVWorker<real_t>(0);
+      static_cast<ps::SimpleApp*>(ps_worker_)->set_request_handle(
+          std::bind(&KVStoreDist::GroupRequestHandle, this, _1, _2));
+      static_cast<ps::SimpleApp*>(ps_worker_)->set_response_handle(
+          std::bind(&KVStoreDist::GroupResponseHandle, this, _1));
       ps::StartAsync("mxnet\0");
       if (!ps::Postoffice::Get()->is_recovery()) {
         ps::Postoffice::Get()->Barrier(
@@ -60,6 +79,22 @@ class KVStoreDist : public KVStoreLocal {
       }
     }
     bigarray_bound_ = dmlc::GetEnv("MXNET_KVSTORE_BIGARRAY_BOUND", 1000 * 1000);
+    if (IsWorkerNode()) {
+      wire_format_.SetType(dmlc::GetEnv("MXNET_KVSTORE_WIRE_DTYPE", std::string("float32")));
+      if (wire_format_.enabled() && get_rank() == 0 && !ps::Postoffice::Get()->is_recovery()) {
+        SendCommandToServers(kSetWireDType, std::to_string(wire_format_.type()));
+      }
+      group_size_ = dmlc::GetEnv("MXNET_KVSTORE_GROUP_SIZE", 1);
+      CHECK_GE(group_size_, 1) << "MXNET_KVSTORE_GROUP_SIZE must be positive";
+      if (group_size_ > 1 && get_rank() == 0 && !ps::Postoffice::Get()->is_recovery()) {
+        SendCommandToServers(kSetGroupSize, std::to_string(group_size_));
+      }
+      int staleness = dmlc::GetEnv("MXNET_KVSTORE_STALENESS", -1);
+      if (staleness >= 0 && get_rank() == 0 && !ps::Postoffice::Get()->is_recovery()) {
+        SendCommandToServers(kSetStaleness, std::to_string(staleness));
+      }
+      fusion_.Start(ps_worker_);
+    }
   }
 
   virtual ~KVStoreDist() {
@@ -72,6 +107,7 @@ class KVStoreDist : public KVStoreLocal {
           SendCommandToServers(kStopServer, "");
         }
       }
+      fusion_.Stop();
       ps::Finalize(barrier_before_exit_);
       delete ps_worker_;
     }
@@ -82,7 +118,12 @@ class KVStoreDist : public KVStoreLocal {
     CheckUnique(keys);
     for (size_t i = 0; i < keys.size(); ++i) {
       comm_->Init(keys[i], values[i].shape(), values[i].dtype());
+      // the values of every worker have the shape of the key
+      const TShape& shape = values[i].shape();
+      std::lock_guard<std::mutex> lk(mu_);
+      row_size_[keys[i]] = shape.ndim() > 1 && shape[0] > 0 ? shape.Size() / shape[0] : 1;
     }
+    PlaceKeys_(keys, values);
     if (get_rank() == 0) {
       Push_(keys, values, 0, false);
       // wait until the push is finished
@@ -123,14 +164,40 @@ class KVStoreDist : public KVStoreLocal {
 #if MKL_EXPERIMENTAL == 1
       mkl_set_tblob_eager_mode(recv_buf.data());
 #endif
-      real_t* data = static_cast<real_t*>(recv_buf.data().dptr_);
       size_t size = recv_buf.shape().Size();
+      // the members of a group pull from their leader what they pushed to it
+      if (group_size_ > 1 && !IsGroupLeader() && group_round_[key] > group_pulled_[key]) {
+        group_pulled_[key] = group_round_[key];
+        PullFromLeader_(key, group_round_[key], &recv_buf, priority);
+        comm_->Broadcast(key, recv_buf, grouped_vals[i], priority);
+        continue;
+      }
+      if (wire_format_.enabled()) {
+        PullPacked_(key, &recv_buf, priority);
+        PublishToGroup_(key, recv_buf, priority);
+        comm_->Broadcast(key, recv_buf, grouped_vals[i], priority);
+        continue;
+      }
+      real_t* data = static_cast<real_t*>(recv_buf.data().dptr_);
+      // recv_buf still holds the values pulled last if nothing wrote it since, so
+      // the servers can leave out those that were not updated
+      auto pulled = pulled_stamps_.find(key);
+      const bool if_changed = skip_unchanged_pull_ && pulled != pulled_stamps_.end() &&
+          pulled->second == Engine::Get()->WriteStamp(recv_buf.var());
 
-      auto pull_from_servers = [this, key, data, size](
+      auto pull_from_servers = [this, key, data, size, if_changed](
           RunContext rctx, Engine::CallbackOnComplete cb) {
         // convert to ps keys
         PSKV& pskv = EncodeKey(key, size);
 
+        if (pskv.keys.size() == 1 && fusion_.Fits(size)) {
+          fusion_.Pull(pskv.keys[0], data, size, [cb]() { cb(); });
+          return;
+        }
+        if (if_changed) {
+          PullIfChanged_(pskv, data, cb);
+          return;
+        }
         // issue pull, false means no delete
         auto vals = new ps::SArray<real_t>(data, size, false);
         CHECK_NOTNULL(ps_worker_)->ZPull(
@@ -145,11 +212,57 @@ class KVStoreDist : public KVStoreLocal {
           FnProperty::kNormal,
           priority,
           PROFILER_MESSAGE("KVStoreDistPull"));
+      pulled_stamps_[key] = Engine::Get()->WriteStamp(recv_buf.var());
 
+      PublishToGroup_(key, recv_buf, priority);
       comm_->Broadcast(key, recv_buf, grouped_vals[i], priority);
     }
   }
 
+  void PushRowSparse(const std::vector<int>& keys,
+                     const std::vector<NDArray>& values,
+                     const std::vector<NDArray>& row_ids,
+                     int priority) override {
+    std::vector<int> uniq_keys;
+    std::vector<std::vector<NDArray> > grouped_vals, grouped_rows;
+    GroupKVPairs(keys, values, &uniq_keys, &grouped_vals);
+    uniq_keys.clear();
+    GroupKVPairs(keys, row_ids, &uniq_keys, &grouped_rows);
+
+    for (size_t i = 0; i < uniq_keys.size(); ++i) {
+      int key = uniq_keys[i];
+      const auto& vals = grouped_vals[i];
+      if (!UseRows_(key, vals[0])) {
+        Push_(std::vector<int>(vals.size(), key), vals, priority, true);
+        continue;
+      }
+      const NDArray& merged = comm_->Reduce(key, vals, priority);
+      PushRows_(key, merged, UniqueRows(grouped_rows[i], merged.shape()[0]), priority);
+    }
+  }
+
+  void PullRowSparse(const std::vector<int>& keys,
+                     const std::vector<NDArray*>& values,
+                     const std::vector<NDArray>& row_ids,
+                     int priority) override {
+    std::vector<int> uniq_keys;
+    std::vector<std::vector<NDArray*> > grouped_vals;
+    std::vector<std::vector<NDArray> > grouped_rows;
+    GroupKVPairs(keys, values, &uniq_keys, &grouped_vals);
+    uniq_keys.clear();
+    GroupKVPairs(keys, row_ids, &uniq_keys, &grouped_rows);
+
+    for (size_t i = 0; i < uniq_keys.size(); ++i) {
+      int key = uniq_keys[i];
+      const auto& outs = grouped_vals[i];
+      if (!UseRows_(key, *outs[0])) {
+        Pull(std::vector<int>(outs.size(), key), outs, priority);
+        continue;
+      }
+      PullRows_(key, outs, UniqueRows(grouped_rows[i], outs[0]->shape()[0]), priority);
+    }
+  }
+
   void set_updater(const Updater& updater) override {
     CHECK(updater) << "invalid updater";
     if (IsServerNode()) {
@@ -220,8 +333,25 @@ class KVStoreDist : public KVStoreLocal {
       int key = uniq_keys[i];
       const auto& vals = grouped_vals[i];
       NDArray merged = do_merge ? comm_->Reduce(key, vals, priority) : vals[0];
+      if (do_merge && group_size_ > 1) {
+        int round = ++group_round_[key];
+        if (!IsGroupLeader()) {
+          PushToLeader_(key, round, merged, priority);
+          continue;
+        }
+        merged = SumGroup_(key, merged, priority);
+      }
 
       auto& send_buf = comm_buf_[key];
+      // the initial values are sent uncompressed
+      if (do_merge && gradient_compression_.enabled()) {
+        PushCompressed_(key, merged, priority);
+        continue;
+      }
+      if (do_merge && wire_format_.enabled()) {
+        PushPacked_(key, merged, priority);
+        continue;
+      }
       if (merged.ctx().dev_mask() == cpu::kDevMask) {
         send_buf = merged;  // avoid memory copy
       } else {
@@ -231,19 +361,24 @@ class KVStoreDist : public KVStoreLocal {
         CopyFromTo(merged, &send_buf);
       }
 
-      // push to servers
-      send_buf.WaitToRead();
+      // push to servers. the pointer is read by the operation so that the
+      // push does not wait for the gradient, which can be pushed during backward
       size_t size = send_buf.shape().Size();
 #if MKL_EXPERIMENTAL == 1
       mkl_set_tblob_eager_mode(send_buf.data());
 #endif
-      real_t* data = static_cast<real_t*>(send_buf.data().dptr_);
+      NDArray buf = send_buf;
       auto push_to_servers =
-          [this, key, data, size](RunContext rctx, Engine::CallbackOnComplete cb) {
+          [this, key, buf, size](RunContext rctx, Engine::CallbackOnComplete cb) {
          // convert to ps keys
         PSKV& pskv = EncodeKey(key, size);
 
         // do push. false means no delete
+        real_t* data = static_cast<real_t*>(buf.data().dptr_);
+        if (pskv.keys.size() == 1 && fusion_.Fits(size)) {
+          fusion_.Push(pskv.keys[0], data, size, [cb]() { cb(); });
+          return;
+        }
         ps::SArray<real_t> vals(data, size, false);
         CHECK_NOTNULL(ps_worker_)->ZPush(
         pskv.keys, vals, pskv.lens, 0, [cb]() { cb(); });
@@ -259,6 +394,498 @@ class KVStoreDist : public KVStoreLocal {
     }
   }
 
+  /**
+   * \brief quantize the merged gradient on its device and push the
+   * compressed words
+   */
+  void PushCompressed_(int key, const NDArray& merged, int priority) {
+    size_t size = merged.shape().Size();
+    auto& residual = residual_[key];
+    auto& words = words_buf_[key];
+    if (residual.is_none()) {
+      residual = NDArray(merged.shape(), merged.ctx(), false, merged.dtype());
+      residual = 0;
+      words = NDArray(mshadow::Shape1(gradient_compression_.compressed_size(size)),
+                      merged.ctx(), false, mshadow::kFloat32);
+    }
+    gradient_compression_.Quantize(merged, &words, &residual, priority);
+    PushWords_(key, words, merged, gradient_compression_.values_per_word(),
+               &compressed_ps_kv_, priority);
+  }
+
+  /**
+   * \brief convert the merged gradient to the wire dtype on its device and
+   * push the packed words
+   */
+  void PushPacked_(int key, const NDArray& merged, int priority) {
+    auto& words = words_buf_[key];
+    if (words.is_none()) {
+      words = NDArray(mshadow::Shape1(WireFormat::packed_size(merged.shape().Size())),
+                      merged.ctx(), false, mshadow::kFloat32);
+    }
+    wire_format_.Pack(merged, &words, priority);
+    PushWords_(key, words, merged, 2, &packed_ps_kv_, priority);
+  }
+
+  /**
+   * \brief push the words encoding the values of merged, values_per_word
+   * values in each word
+   */
+  void PushWords_(int key, const NDArray& words, const NDArray& merged, int values_per_word,
+                  std::unordered_map<int, PSKV>* cache, int priority) {
+    size_t size = merged.shape().Size();
+    auto& send_buf = words_send_buf_[key];
+    if (words.ctx().dev_mask() == cpu::kDevMask) {
+      send_buf = words;  // avoid memory copy
+    } else {
+      if (send_buf.is_none()) {
+        send_buf = NDArray(words.shape(), pinned_ctx_, false, words.dtype());
+      }
+      CopyFromTo(words, &send_buf);
+    }
+    // reading the buffer of the pulls keeps the pulls after the push
+    auto& comm_buf = comm_buf_[key];
+    if (comm_buf.is_none()) {
+      comm_buf = NDArray(merged.shape(), pinned_ctx_, false, merged.dtype());
+    }
+
+    NDArray buf = send_buf;
+    auto push_to_servers = [this, key, buf, size, values_per_word, cache](
+        RunContext rctx, Engine::CallbackOnComplete cb) {
+      PSKV& pskv = EncodePackedKey(key, size, values_per_word, cache);
+      real_t* data = static_cast<real_t*>(buf.data().dptr_);
+      ps::SArray<real_t> vals(data, pskv.size, false);
+      CHECK_NOTNULL(ps_worker_)->ZPush(
+      pskv.keys, vals, pskv.lens, 0, [cb]() { cb(); });
+    };
+    Engine::Get()->PushAsync(
+        push_to_servers,
+        pinned_ctx_,
+        {send_buf.var(), comm_buf.var()},
+        {},
+        FnProperty::kNormal,
+        priority,
+        PROFILER_MESSAGE("KVStoreDistPushWords"));
+  }
+
+  /**
+   * \brief pull the parts of a key the servers updated since this worker pulled
+   * them last into data, which holds the values of that pull
+   */
+  void PullIfChanged_(const PSKV& pskv, real_t* data, Engine::CallbackOnComplete cb) {
+    // the values received are those of the parts with a length
+    auto vals = new ps::SArray<real_t>();
+    auto lens = new ps::SArray<int>();
+    ps::SArray<int> expected = pskv.lens;
+    CHECK_NOTNULL(ps_worker_)->ZPull(
+    pskv.keys, vals, lens, kPullIfChanged, [vals, lens, expected, data, cb]() {
+        CHECK_EQ(lens->size(), expected.size());
+        const real_t* received = vals->data();
+        real_t* part = data;
+        for (size_t i = 0; i < expected.size(); ++i) {
+          if ((*lens)[i] != 0) {
+            CHECK_EQ((*lens)[i], expected[i]);
+            std::copy(received, received + expected[i], part);
+            received += expected[i];
+          }
+          part += expected[i];
+        }
+        delete vals;
+        delete lens;
+        cb();
+      });
+  }
+
+  /**
+   * \brief pull the values in the wire dtype and convert them to the dtype
+   * of recv_buf
+   */
+  void PullPacked_(int key, NDArray* recv_buf, int priority) {
+    size_t size = recv_buf->shape().Size();
+    auto& words = words_recv_buf_[key];
+    if (words.is_none()) {
+      words = NDArray(mshadow::Shape1(WireFormat::packed_size(size)), pinned_ctx_,
+                      false, mshadow::kFloat32);
+    }
+    real_t* data = static_cast<real_t*>(words.data().dptr_);
+    auto pull_from_servers = [this, key, data, size](
+        RunContext rctx, Engine::CallbackOnComplete cb) {
+      PSKV& pskv = EncodePackedKey(key, size, 2, &packed_ps_kv_);
+      auto vals = new ps::SArray<real_t>(data, pskv.size, false);
+      CHECK_NOTNULL(ps_worker_)->ZPull(
+      pskv.keys, vals, &pskv.lens, 0, [vals, cb](){ delete vals; cb(); });
+    };
+    // writing recv_buf keeps the pull after the previous push
+    CHECK_NOTNULL(Engine::Get())->PushAsync(
+        pull_from_servers,
+        pinned_ctx_,
+        {},
+        {words.var(), recv_buf->var()},
+        FnProperty::kNormal,
+        priority,
+        PROFILER_MESSAGE("KVStoreDistPullPacked"));
+    wire_format_.Unpack(words, recv_buf, priority);
+  }
+
+  /**
+   * \brief whether this worker pushes the sum of its group to the servers
+   */
+  bool IsGroupLeader() const {
+    return get_rank() % group_size_ == 0;
+  }
+
+  int GroupLeaderID() const {
+    return ps::Postoffice::WorkerRankToID(get_rank() - get_rank() % group_size_);
+  }
+
+  /**
+   * \brief the number of workers sending their gradients to this leader
+   */
+  int NumGroupMembers() const {
+    return std::min(group_size_, ps::NumWorkers() - get_rank()) - 1;
+  }
+
+  static std::string EncodeGroupMessage(int key, int round, const real_t* data, size_t size) {
+    int header[2] = {key, round};
+    std::string body(reinterpret_cast<const char*>(header), sizeof(header));
+    body.append(reinterpret_cast<const char*>(data), size * sizeof(real_t));
+    return body;
+  }
+
+  static void DecodeGroupHeader(const std::string& body, int* key, int* round) {
+    CHECK_GE(body.size(), 2 * sizeof(int));
+    const int* header = reinterpret_cast<const int*>(body.data());
+    *key = header[0];
+    *round = header[1];
+  }
+
+  static const real_t* GroupMessageData(const std::string& body, size_t size) {
+    CHECK_EQ(body.size(), 2 * sizeof(int) + size * sizeof(real_t));
+    return reinterpret_cast<const real_t*>(body.data() + 2 * sizeof(int));
+  }
+
+  /**
+   * \brief send the merged gradient of a member to its leader
+   */
+  void PushToLeader_(int key, int round, const NDArray& merged, int priority) {
+    auto& send_buf = comm_buf_[key];
+    if (send_buf.is_none()) {
+      send_buf = NDArray(merged.shape(), pinned_ctx_, false, merged.dtype());
+    }
+    CopyFromTo(merged, &send_buf, priority);
+    NDArray buf = send_buf;
+    auto push_to_leader = [this, key, round, buf](RunContext rctx) {
+      std::string body = EncodeGroupMessage(key, round, buf.data().dptr<real_t>(),
+                                            buf.shape().Size());
+      ps_worker_->Wait(ps_worker_->Request(kGroupPush, body, GroupLeaderID()));
+    };
+    Engine::Get()->PushSync(
+        push_to_leader,
+        pinned_ctx_,
+        {send_buf.var()},
+        {},
+        FnProperty::kNormal,
+        priority,
+        PROFILER_MESSAGE("KVStoreDistPushToLeader"));
+  }
+
+  /**
+   * \brief add the gradients of the members to the merged gradient of the
+   * leader, waiting for the ones that have not arrived
+   */
+  NDArray SumGroup_(int key, const NDArray& merged, int priority) {
+    auto& sum = group_sum_buf_[key];
+    if (sum.is_none()) {
+      sum = NDArray(merged.shape(), pinned_ctx_, false, merged.dtype());
+    }
+    CopyFromTo(merged, &sum, priority);
+    NDArray buf = sum;
+    auto add_members = [this, key, buf](RunContext rctx) {
+      std::vector<std::string> parts;
+      {
+        std::unique_lock<std::mutex> lk(group_mu_);
+        auto& pushed = GroupBuffer(key).pushed;
+        group_cv_.wait(lk, [&pushed]() {
+            return std::none_of(pushed.begin(), pushed.end(),
+                                [](const std::deque<std::string>& q) { return q.empty(); });
+          });
+        for (auto& q : pushed) {
+          parts.push_back(std::move(q.front()));
+          q.pop_front();
+        }
+      }
+      size_t size = buf.shape().Size();
+      real_t* data = buf.data().dptr<real_t>();
+      for (const auto& part : parts) {
+        const real_t* vals = GroupMessageData(part, size);
+        for (size_t i = 0; i < size; ++i) {
+          data[i] += vals[i];
+        }
+      }
+    };
+    Engine::Get()->PushSync(
+        add_members,
+        pinned_ctx_,
+        {},
+        {buf.var()},
+        FnProperty::kNormal,
+        priority,
+        PROFILER_MESSAGE("KVStoreDistGroupSum"));
+    return sum;
+  }
+
+  /**
+   * \brief let the leader answer the pulls of its members with the pulled
+   * weights, once they include the round the members pushed
+   */
+  void PublishToGroup_(int key, const NDArray& recv_buf, int priority) {
+    if (group_size_ <= 1 || !IsGroupLeader()) return;
+    int round = group_round_[key];
+    NDArray buf = recv_buf;
+    auto publish = [this, key, round, buf](RunContext rctx) {
+      std::string weights = EncodeGroupMessage(key, round, buf.data().dptr<real_t>(),
+                                               buf.shape().Size());
+      std::lock_guard<std::mutex> lk(group_mu_);
+      auto& group = GroupBuffer(key);
+      group.round = round;
+      group.weights = std::move(weights);
+      std::vector<ps::SimpleData> waiting;
+      for (const auto& req : group.pending) {
+        int req_key, req_round;
+        DecodeGroupHeader(req.body, &req_key, &req_round);
+        if (req_round <= round) {
+          ps_worker_->Response(req, group.weights);
+        } else {
+          waiting.push_back(req);
+        }
+      }
+      group.pending.swap(waiting);
+    };
+    Engine::Get()->PushSync(
+        publish,
+        pinned_ctx_,
+        {buf.var()},
+        {},
+        FnProperty::kNormal,
+        priority,
+        PROFILER_MESSAGE("KVStoreDistPublishToGroup"));
+  }
+
+  /**
+   * \brief pull the weights of a round from the leader
+   */
+  void PullFromLeader_(int key, int round, NDArray* recv_buf, int priority) {
+    NDArray buf = *recv_buf;
+    auto pull_from_leader = [this, key, round, buf](
+        RunContext rctx, Engine::CallbackOnComplete cb) {
+      // the response cannot be handled before the pull is recorded
+      std::lock_guard<std::mutex> lk(group_mu_);
+      int ts = ps_worker_->Request(kGroupPull, EncodeGroupMessage(key, round, nullptr, 0),
+                                   GroupLeaderID());
+      real_t* data = buf.data().dptr<real_t>();
+      size_t size = buf.shape().Size();
+      group_pulls_[ts] = [data, size, cb](const std::string& body) {
+        const real_t* vals = GroupMessageData(body, size);
+        std::copy(vals, vals + size, data);
+        cb();
+      };
+    };
+    CHECK_NOTNULL(Engine::Get())->PushAsync(
+        pull_from_leader,
+        pinned_ctx_,
+        {},
+        {recv_buf->var()},
+        FnProperty::kNormal,
+        priority,
+        PROFILER_MESSAGE("KVStoreDistPullFromLeader"));
+  }
+
+  /**
+   * \brief the leader receives the gradients and the pulls of its members
+   */
+  void GroupRequestHandle(const ps::SimpleData& recved, ps::SimpleApp* app) {
+    if (recved.head != kGroupPush && recved.head != kGroupPull) {
+      app->Response(recved);
+      return;
+    }
+    int key, round;
+    DecodeGroupHeader(recved.body, &key, &round);
+    std::lock_guard<std::mutex> lk(group_mu_);
+    auto& group = GroupBuffer(key);
+    if (recved.head == kGroupPush) {
+      int member = ps::Postoffice::IDtoRank(recved.sender) - get_rank() - 1;
+      CHECK(member >= 0 && member < static_cast<int>(group.pushed.size()))
+          << "worker " << ps::Postoffice::IDtoRank(recved.sender)
+          << " is not in the group of " << get_rank();
+      group.pushed[member].push_back(recved.body);
+      group_cv_.notify_all();
+      app->Response(recved);
+    } else if (group.round >= round) {
+      app->Response(recved, group.weights);
+    } else {
+      group.pending.push_back(recved);
+    }
+  }
+
+  /**
+   * \brief a member receives the weights it pulled from its leader
+   */
+  void GroupResponseHandle(const ps::SimpleData& recved) {
+    if (recved.head != kGroupPull) return;
+    std::function<void(const std::string&)> done;
+    {
+      std::lock_guard<std::mutex> lk(group_mu_);
+      auto it = group_pulls_.find(recved.timestamp);
+      CHECK(it != group_pulls_.end());
+      done = std::move(it->second);
+      group_pulls_.erase(it);
+    }
+    done(recved.body);
+  }
+
+  /**
+   * \brief the state of a key at a leader, guarded by group_mu_
+   */
+  struct GroupBuf {
+    /*! \brief the gradients received from each member, in order */
+    std::vector<std::deque<std::string> > pushed;
+    /*! \brief the last round whose weights were pulled, and the weights */
+    int round = 0;
+    std::string weights;
+    /*! \brief the pulls of rounds that are not pulled yet */
+    std::vector<ps::SimpleData> pending;
+  };
+
+  GroupBuf& GroupBuffer(int key) {
+    auto& group = group_buf_[key];
+    group.pushed.resize(NumGroupMembers());
+    return group;
+  }
+
+  /**
+   * \brief whether the rows of a key can be pushed and pulled alone: each
+   * server holds whole rows, and the values are neither compressed nor summed
+   * by a group. tells the servers the size of the rows on the first use
+   */
+  bool UseRows_(int key, const NDArray& value) {
+    const TShape& shape = value.shape();
+    if (shape.ndim() < 2 || value.dtype() != mshadow::kFloat32 || group_size_ > 1 ||
+        gradient_compression_.enabled() || wire_format_.enabled()) {
+      return false;
+    }
+    size_t width = shape.Size() / shape[0];
+    PSKV& pskv = EncodeKey(key, shape.Size());
+    for (int len : pskv.lens) {
+      if (len % width != 0) return false;
+    }
+    if (rows_registered_.insert(key).second) {
+      SendCommandToServers(kSetRowSize, std::to_string(key) + "," + std::to_string(width));
+    }
+    return true;
+  }
+
+  /**
+   * \brief the sorted distinct rows listed in the arrays, once they are computed
+   */
+  static std::vector<int64_t> UniqueRows(const std::vector<NDArray>& row_ids,
+                                         int64_t num_rows) {
+    std::vector<int64_t> rows;
+    for (const auto& ids : row_ids) {
+      NDArray cpu_ids = ids.ctx().dev_mask() == cpu::kDevMask ? ids : ids.Copy(Context());
+      cpu_ids.WaitToRead();
+      MSHADOW_TYPE_SWITCH(cpu_ids.dtype(), DType, {
+        const DType* data = cpu_ids.data().dptr<DType>();
+        for (size_t j = 0; j < cpu_ids.shape().Size(); ++j) {
+          rows.push_back(static_cast<int64_t>(data[j]));
+          CHECK(rows.back() >= 0 && rows.back() < num_rows)
+              << "row " << rows.back() << " is out of range";
+        }
+      });
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    return rows;
+  }
+
+  /**
+   * \brief push the rows of the merged gradient, gathered on its device
+   */
+  void PushRows_(int key, const NDArray& merged, const std::vector<int64_t>& rows,
+                 int priority) {
+    size_t width = merged.shape().Size() / merged.shape()[0];
+    auto kv = std::make_shared<PSKV>(EncodeRows(key, merged.shape(), rows));
+    NDArray send_buf(mshadow::Shape2(rows.size(), width), pinned_ctx_, rows.empty(),
+                     merged.dtype());
+    if (!rows.empty()) {
+      NDArray gathered(send_buf.shape(), merged.ctx(), false, merged.dtype());
+      GatherRows(merged.Reshape(mshadow::Shape2(merged.shape()[0], width)),
+                 RowIndex(rows, merged.ctx()), &gathered, priority);
+      CopyFromTo(gathered, &send_buf, priority);
+    }
+    // reading the buffer of the pulls keeps the pulls after the push
+    auto& comm_buf = comm_buf_[key];
+    if (comm_buf.is_none()) {
+      comm_buf = NDArray(merged.shape(), pinned_ctx_, false, merged.dtype());
+    }
+    NDArray buf = send_buf;
+    auto push_rows = [this, kv, buf](RunContext rctx, Engine::CallbackOnComplete cb) {
+      real_t* data = kv->size ? static_cast<real_t*>(buf.data().dptr_) : nullptr;
+      ps::SArray<real_t> vals(data, kv->size, false);
+      CHECK_NOTNULL(ps_worker_)->ZPush(
+      kv->keys, vals, kv->lens, 0, [cb]() { cb(); });
+    };
+    Engine::Get()->PushAsync(
+        push_rows,
+        pinned_ctx_,
+        {send_buf.var(), comm_buf.var()},
+        {},
+        FnProperty::kNormal,
+        priority,
+        PROFILER_MESSAGE("KVStoreDistPushRows"));
+  }
+
+  /**
+   * \brief pull rows into a buffer and scatter them into the rows of each
+   * output, on its device
+   */
+  void PullRows_(int key, const std::vector<NDArray*>& outs, const std::vector<int64_t>& rows,
+                 int priority) {
+    if (rows.empty()) return;
+    const TShape& shape = outs[0]->shape();
+    size_t width = shape.Size() / shape[0];
+    auto kv = std::make_shared<PSKV>(EncodeRows(key, shape, rows));
+    NDArray recv_buf(mshadow::Shape2(rows.size(), width), pinned_ctx_, false,
+                     outs[0]->dtype());
+    // writing the buffer of the pulls keeps the pull after the previous push
+    auto& comm_buf = comm_buf_[key];
+    if (comm_buf.is_none()) {
+      comm_buf = NDArray(shape, pinned_ctx_, false, outs[0]->dtype());
+    }
+    real_t* data = static_cast<real_t*>(recv_buf.data().dptr_);
+    auto pull_rows = [this, kv, data](RunContext rctx, Engine::CallbackOnComplete cb) {
+      auto vals = new ps::SArray<real_t>(data, kv->size, false);
+      CHECK_NOTNULL(ps_worker_)->ZPull(
+      kv->keys, vals, &kv->lens, 0, [vals, kv, cb](){ delete vals; cb(); });
+    };
+    CHECK_NOTNULL(Engine::Get())->PushAsync(
+        pull_rows,
+        pinned_ctx_,
+        {},
+        {recv_buf.var(), comm_buf.var()},
+        FnProperty::kNormal,
+        priority,
+        PROFILER_MESSAGE("KVStoreDistPullRows"));
+    for (auto out : outs) {
+      NDArray all = out->Reshape(mshadow::Shape2(shape[0], width));
+      NDArray pulled = recv_buf;
+      if (out->ctx() != recv_buf.ctx()) {
+        pulled = NDArray(recv_buf.shape(), out->ctx(), false, recv_buf.dtype());
+        CopyFromTo(recv_buf, &pulled, priority);
+      }
+      ScatterRows(pulled, RowIndex(rows, out->ctx()), &all, priority);
+    }
+  }
+
   /**
    * \brief check if the keys are all unique
    */
@@ -283,6 +910,24 @@ class KVStoreDist : public KVStoreLocal {
    */
   std::unordered_map<int, PSKV> ps_kv_;
 
+  /**
+   * \brief the server of each small key placed at initialization
+   */
+  std::unordered_map<int, int> key_server_;
+  /**
+   * \brief the number of values held by each server
+   */
+  std::vector<size_t> server_load_;
+
+  /**
+   * \brief the number of values in a row of each key
+   */
+  std::unordered_map<int, size_t> row_size_;
+  /**
+   * \brief the keys whose row size was sent to the servers
+   */
+  std::unordered_set<int> rows_registered_;
+
   /**
    * \brief serizelize EncodeKey
    */
@@ -294,6 +939,7 @@ class KVStoreDist : public KVStoreLocal {
   inline PSKV& EncodeKey(int key, size_t size) {
     mu_.lock();
     PSKV& pskv = ps_kv_[key];
+    size_t width = row_size_.count(key) ? row_size_[key] : 1;
     mu_.unlock();
 
     if (!pskv.keys.empty()) {
@@ -303,22 +949,36 @@ class KVStoreDist : public KVStoreLocal {
       int num_servers = krs.size();
       CHECK_GT(num_servers, 0);
 
-      // a simple heuristic for load balance
       if (size < bigarray_bound_) {
-        // send it to a single random picked server
-        int server = (key * 9973) % num_servers;
+        // send it to the server it was placed on at initialization, or to a
+        // hashed server
+        mu_.lock();
+        auto placed = key_server_.find(key);
+        int server = placed != key_server_.end() ? placed->second : (key * 9973) % num_servers;
+        mu_.unlock();
         ps::Key ps_key = krs[server].begin() + key;
         CHECK_LT(ps_key, krs[server].end());
         pskv.keys.push_back(ps_key);
         pskv.lens.push_back(size);
         pskv.size = size;
       } else {
-        // parition it to all servers
+        // parition it to all servers. with gradient compression or a 16 bit
+        // wire dtype the parts start at the first value of a word
+        size_t align = gradient_compression_.enabled() ?
+            gradient_compression_.values_per_word() : (wire_format_.enabled() ? 2 : 1);
+        // and at the first value of a row when every server gets some, so
+        // that the rows can be pushed and pulled alone
+        size_t row_align = align;
+        while (row_align % width != 0) row_align += align;
+        if (size / row_align >= static_cast<size_t>(num_servers)) align = row_align;
+        auto bound = [size, num_servers, align](int i) {
+          if (i == num_servers) return size;
+          return static_cast<size_t>(round(static_cast<double>(size)/num_servers*i)) /
+              align * align;
+        };
         pskv.size = 0;
         for (int i = 0; i < num_servers; ++i) {
-          size_t part_size =
-              static_cast<size_t>(round(static_cast<double>(size)/num_servers*(i+1))) -
-              static_cast<size_t>(round(static_cast<double>(size)/num_servers*i));
+          size_t part_size = bound(i + 1) - bound(i);
           ps::Key ps_key = krs[i].begin() + key;
           CHECK_LT(ps_key, krs[i].end());
           pskv.keys.push_back(ps_key);
@@ -331,6 +991,111 @@ class KVStoreDist : public KVStoreLocal {
     return pskv;
   }
 
+  /**
+   * \brief place the small keys initialized together on the servers: the
+   * biggest first, each on the server holding the fewest values. the big keys
+   * are partitioned to all the servers. every worker initializes the same keys
+   * in the same order, so they all compute the same placement
+   */
+  void PlaceKeys_(const std::vector<int>& keys, const std::vector<NDArray>& values) {
+    size_t num_servers = ps::Postoffice::Get()->GetServerKeyRanges().size();
+    CHECK_GT(num_servers, 0U);
+    std::vector<std::pair<size_t, int> > small;
+    std::lock_guard<std::mutex> lk(mu_);
+    server_load_.resize(num_servers, 0);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      size_t size = values[i].shape().Size();
+      if (size >= bigarray_bound_) {
+        for (size_t& load : server_load_) load += size / num_servers;
+      } else if (key_server_.count(keys[i]) == 0) {
+        small.emplace_back(size, keys[i]);
+      }
+    }
+    std::sort(small.begin(), small.end(),
+              [](const std::pair<size_t, int>& a, const std::pair<size_t, int>& b) {
+                return a.first != b.first ? a.first > b.first : a.second < b.second;
+              });
+    for (const auto& kv : small) {
+      int server = std::min_element(server_load_.begin(), server_load_.end()) -
+          server_load_.begin();
+      key_server_[kv.second] = server;
+      server_load_[server] += kv.first;
+    }
+    if (get_rank() == 0 && dmlc::GetEnv("PS_VERBOSE", 0) > 0) {
+      std::ostringstream os;
+      for (size_t load : server_load_) os << " " << load;
+      auto minmax = std::minmax_element(server_load_.begin(), server_load_.end());
+      LOG(INFO) << "values held by each server:" << os.str() << ", the most loaded holds "
+                << static_cast<double>(*minmax.second) / std::max<size_t>(*minmax.first, 1)
+                << " times the values of the least loaded";
+    }
+  }
+
+  /**
+   * \brief the keys of values packed values_per_word in each word,
+   * partitioned like the values so that each server receives the words of
+   * its part
+   */
+  inline PSKV& EncodePackedKey(int key, size_t size, int values_per_word,
+                               std::unordered_map<int, PSKV>* cache) {
+    PSKV& pskv = EncodeKey(key, size);
+    mu_.lock();
+    PSKV& packed = (*cache)[key];
+    mu_.unlock();
+    if (packed.keys.empty()) {
+      packed.keys = pskv.keys;
+      packed.size = 0;
+      for (int len : pskv.lens) {
+        int part_size = (len + values_per_word - 1) / values_per_word;
+        packed.lens.push_back(part_size);
+        packed.size += part_size;
+      }
+    }
+    return packed;
+  }
+
+  /**
+   * \brief the ps keys of sorted rows: each server holding a part of the key
+   * receives its marker key, followed by the keys of its rows
+   */
+  PSKV EncodeRows(int key, const TShape& shape, const std::vector<int64_t>& rows) {
+    size_t width = shape.Size() / shape[0];
+    PSKV& pskv = EncodeKey(key, shape.Size());
+    auto krs = ps::Postoffice::Get()->GetServerKeyRanges();
+    PSKV kv;
+    kv.size = 0;
+    int64_t first = 0;
+    auto row = rows.begin();
+    for (size_t i = 0; i < pskv.keys.size(); ++i) {
+      int64_t end = first + pskv.lens[i] / width;
+      ps::Key server_end = 0;
+      for (const auto& kr : krs) {
+        if (pskv.keys[i] >= kr.begin() && pskv.keys[i] < kr.end()) server_end = kr.end();
+      }
+      CHECK_LT(RowKey(pskv.keys[i], end - first - 1), server_end)
+          << "too many rows for the key range of a server";
+      kv.keys.push_back(RowMarkerKey(pskv.keys[i]));
+      kv.lens.push_back(0);
+      for (; row != rows.end() && *row < end; ++row) {
+        kv.keys.push_back(RowKey(pskv.keys[i], *row - first));
+        kv.lens.push_back(width);
+        kv.size += width;
+      }
+      first = end;
+    }
+    return kv;
+  }
+
+  void SetGradientCompression(
+      const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    CHECK(IsWorkerNode()) << "Gradient compression is set on the workers";
+    CHECK(ps_kv_.empty()) << "Gradient compression has to be set before initializing the keys";
+    gradient_compression_.SetParams(kwargs);
+    if (get_rank() == 0) {
+      SendCommandToServers(kSetGradientCompression, gradient_compression_.EncodeParams());
+    }
+  }
+
   /**
    * \brief for worker to push and pull data
    */
@@ -345,6 +1110,33 @@ class KVStoreDist : public KVStoreLocal {
   size_t bigarray_bound_;
   /// \brief send & recver buffer
   std::unordered_map<int, NDArray> comm_buf_;
+  /// \brief the write stamps of the buffers after their last pull from the servers
+  std::unordered_map<int, uint64_t> pulled_stamps_;
+  std::unordered_map<int, PSKV> compressed_ps_kv_;
+  std::unordered_map<int, PSKV> packed_ps_kv_;
+  GradientCompression gradient_compression_;
+  WireFormat wire_format_;
+  /// \brief the batches of the pushes and the pulls of the small keys
+  FusionBuffer fusion_;
+  /// \brief the quantization errors not sent yet, on the device of the gradients
+  std::unordered_map<int, NDArray> residual_;
+  /// \brief the compressed or packed gradients, on their device and on the host
+  std::unordered_map<int, NDArray> words_buf_;
+  std::unordered_map<int, NDArray> words_send_buf_;
+  /// \brief the packed values pulled
+  std::unordered_map<int, NDArray> words_recv_buf_;
+  /// \brief the number of consecutive workers whose gradients are summed by the first one
+  int group_size_;
+  /// \brief the rounds of each key pushed, and pulled by a member
+  std::unordered_map<int, int> group_round_;
+  std::unordered_map<int, int> group_pulled_;
+  /// \brief the sum of the gradients of the group, at a leader
+  std::unordered_map<int, NDArray> group_sum_buf_;
+  std::unordered_map<int, GroupBuf> group_buf_;
+  /// \brief the pulls of a member waiting for the leader, by request timestamp
+  std::unordered_map<int, std::function<void(const std::string&)> > group_pulls_;
+  std::mutex group_mu_;
+  std::condition_variable group_cv_;
 };
 
 }  // namespace kvstore
@@ -23,6 +23,7 @@
  */
 #ifndef MXNET_KVSTORE_KVSTORE_DIST_SERVER_H_
 #define MXNET_KVSTORE_KVSTORE_DIST_SERVER_H_
+#include <algorithm>
 #include <queue>
 #include <string>
 #include <mutex>
@@ -30,15 +31,54 @@
 #include <memory>
 #include <functional>
 #include <future>
+#include <map>
+#include <unordered_map>
+#include <thread>
 #include <vector>
+#include "dmlc/concurrency.h"
 #include "ps/ps.h"
 #include "mxnet/kvstore.h"
+#include "mxnet/engine.h"
+#include "./gradient_compression.h"
+#include "./row_sparse.h"
+#include "./server_optimizer.h"
+#include "./wire_format.h"
 
 namespace mxnet {
 namespace kvstore {
 
 static const int kStopServer = -1;
 static const int kSyncMode = -2;
+static const int kSetGradientCompression = -3;
+static const int kSetWireDType = -4;
+static const int kSetGroupSize = -5;
+/*! \brief the requests between the workers of a group and their leader */
+static const int kGroupPush = -6;
+static const int kGroupPull = -7;
+static const int kSetStaleness = -8;
+/*! \brief the number of values in a row of a key, for its row sparse requests */
+static const int kSetRowSize = -9;
+/*! \brief the settings of the optimizer the servers run natively, see ServerOptimizer */
+static const int kSetServerOptimizer = -10;
+/*!
+ * \brief the cmd of a dense pull whose response leaves out the values of the keys
+ *  that were not updated since the worker pulled them last, with a length of 0
+ */
+static const int kPullIfChanged = 1;
+
+/*!
+ * \brief the ps keys of the rows of a key on a server hold the row + 2 in
+ *  their upper 32 bits. each row sparse request of a server starts with the
+ *  marker key, without values, so that the servers holding a part of the key
+ *  count the push of a worker even when none of its rows are theirs
+ */
+inline ps::Key RowMarkerKey(ps::Key key) {
+  return key + (static_cast<ps::Key>(1) << 32);
+}
+
+inline ps::Key RowKey(ps::Key key, int64_t row) {
+  return key + (static_cast<ps::Key>(row + 2) << 32);
+}
 
 /**
  * \brief executor runs a function using the thread called \ref Start
@@ -112,9 +152,26 @@ class KVStoreDistServer {
     ps_server_->set_request_handle(
         std::bind(&KVStoreDistServer::DataHandle, this, _1, _2, _3));
     sync_mode_ = false;
+    group_size_ = 1;
+    staleness_ = -1;
+    // the requests of a key are all handled by the same thread, in order
+    int nthreads = dmlc::GetEnv("MXNET_KVSTORE_SERVER_NTHREADS", 4);
+    for (int i = 0; i < nthreads; ++i) {
+      queues_.emplace_back(new dmlc::ConcurrentBlockingQueue<Request>());
+    }
+    for (int i = 0; i < nthreads; ++i) {
+      workers_.emplace_back([this, i]() {
+          Request req;
+          while (queues_[i]->Pop(&req)) {
+            ProcessRequest(req.meta, req.data, req.server);
+          }
+        });
+    }
   }
 
   ~KVStoreDistServer() {
+    for (auto& queue : queues_) queue->SignalForKill();
+    for (auto& worker : workers_) worker.join();
     delete ps_server_;
   }
 
@@ -141,6 +198,21 @@ class KVStoreDistServer {
       exec_.Stop();
     } else if (recved.head == kSyncMode) {
       sync_mode_ = true;
+    } else if (recved.head == kSetGradientCompression) {
+      gradient_compression_.DecodeParams(recved.body);
+    } else if (recved.head == kSetWireDType) {
+      wire_format_.set_type(std::stoi(recved.body));
+    } else if (recved.head == kSetGroupSize) {
+      group_size_ = std::stoi(recved.body);
+    } else if (recved.head == kSetStaleness) {
+      staleness_ = std::stoi(recved.body);
+    } else if (recved.head == kSetServerOptimizer) {
+      optimizer_.Init(recved.body);
+    } else if (recved.head == kSetRowSize) {
+      size_t sep = recved.body.find(',');
+      CHECK_NE(sep, std::string::npos) << "Invalid row size " << recved.body;
+      std::lock_guard<std::mutex> lk(store_mu_);
+      row_size_[std::stoi(recved.body.substr(0, sep))] = std::stoi(recved.body.substr(sep + 1));
     } else {
       // let the main thread to execute ctrl, which is necessary for python
       exec_.Exec([this, recved]() {
@@ -154,15 +226,129 @@ class KVStoreDistServer {
   void DataHandle(const ps::KVMeta& req_meta,
                   const ps::KVPairs<real_t>& req_data,
                   ps::KVServer<real_t>* server) {
+    if (!IsRowRequest(req_data.keys) && req_data.keys.size() > 1) {
+      SplitBatch(req_meta, req_data, server);
+      return;
+    }
     // do some check
-    CHECK_EQ(req_data.keys.size(), (size_t)1);
+    if (!IsRowRequest(req_data.keys)) {
+      CHECK_EQ(req_data.keys.size(), (size_t)1);
+      if (req_meta.push) {
+        CHECK_EQ(req_data.lens.size(), (size_t)1);
+        CHECK_EQ(req_data.vals.size(), (size_t)req_data.lens[0]);
+      }
+    }
+    Enqueue(req_meta, req_data, server);
+  }
+
+  void Enqueue(const ps::KVMeta& req_meta, const ps::KVPairs<real_t>& req_data,
+               ps::KVServer<real_t>* server) {
+    if (queues_.empty()) {
+      ProcessRequest(req_meta, req_data, server);
+    } else {
+      // the copy of the request shares the received memory, which stays
+      // alive until the request is processed
+      int key = DecodeKey(req_data.keys[0]);
+      queues_[key % queues_.size()]->Push(Request{req_meta, req_data, server});
+    }
+  }
+
+  /**
+   * \brief process each key of a request batching the pushes or the pulls of
+   * several small keys as a request of its own. the responses of the keys are
+   * collected by Respond, which responds to the batch after the last one
+   */
+  void SplitBatch(const ps::KVMeta& req_meta, const ps::KVPairs<real_t>& req_data,
+                  ps::KVServer<real_t>* server) {
+    size_t n = req_data.keys.size();
+    if (req_meta.push) CHECK_EQ(req_data.lens.size(), n);
+    {
+      std::lock_guard<std::mutex> lk(batch_mu_);
+      Batch& batch = batches_[std::make_pair(req_meta.sender, req_meta.timestamp)];
+      batch.keys = req_data.keys;
+      batch.remaining = n;
+      batch.parts.resize(req_meta.push ? 0 : n);
+    }
+    size_t offset = 0;
+    for (size_t i = 0; i < n; ++i) {
+      ps::KVPairs<real_t> part;
+      part.keys = req_data.keys.segment(i, i + 1);
+      if (req_meta.push) {
+        part.lens = req_data.lens.segment(i, i + 1);
+        part.vals = req_data.vals.segment(offset, offset + req_data.lens[i]);
+        offset += req_data.lens[i];
+      }
+      Enqueue(req_meta, part, server);
+    }
+    if (req_meta.push) CHECK_EQ(req_data.vals.size(), offset);
+  }
+
+  /**
+   * \brief respond to a request, or count the key down when the request is a
+   * part of a batch. the values pulled by the parts are copied into the
+   * response to the batch, in the order of its keys
+   */
+  void Respond(const ps::KVMeta& req_meta, ps::KVServer<real_t>* server,
+               const ps::KVPairs<real_t>& res = ps::KVPairs<real_t>()) {
+    Batch done;
+    {
+      std::unique_lock<std::mutex> lk(batch_mu_);
+      auto it = batches_.find(std::make_pair(req_meta.sender, req_meta.timestamp));
+      if (it == batches_.end()) {
+        lk.unlock();
+        server->Response(req_meta, res);
+        return;
+      }
+      Batch& batch = it->second;
+      if (!req_meta.push) {
+        size_t i = std::lower_bound(batch.keys.begin(), batch.keys.end(), res.keys[0]) -
+            batch.keys.begin();
+        CHECK_LT(i, batch.keys.size());
+        batch.parts[i] = res;
+      }
+      if (--batch.remaining > 0) return;
+      done = std::move(batch);
+      batches_.erase(it);
+    }
     if (req_meta.push) {
-      CHECK_EQ(req_data.lens.size(), (size_t)1);
-      CHECK_EQ(req_data.vals.size(), (size_t)req_data.lens[0]);
+      server->Response(req_meta);
+      return;
+    }
+    ps::KVPairs<real_t> response;
+    response.keys = done.keys;
+    size_t size = 0;
+    for (const auto& part : done.parts) {
+      response.lens.push_back(part.vals.size());
+      size += part.vals.size();
     }
+    response.vals.resize(size);
+    real_t* data = response.vals.data();
+    for (const auto& part : done.parts) {
+      std::copy(part.vals.begin(), part.vals.end(), data);
+      data += part.vals.size();
+    }
+    // releases the stored arrays read by the parts
+    done.parts.clear();
+    server->Response(req_meta, response);
+  }
 
+  void ProcessRequest(const ps::KVMeta& req_meta,
+                      const ps::KVPairs<real_t>& req_data,
+                      ps::KVServer<real_t>* server) {
     int key = DecodeKey(req_data.keys[0]);
-    auto& stored = store_[key];
+    NDArray* stored_ptr;
+    MergeBuf* merged_ptr;
+    {
+      // the references to the elements stay valid when the maps grow
+      std::lock_guard<std::mutex> lk(store_mu_);
+      stored_ptr = &store_[key];
+      merged_ptr = &merge_buf_[key];
+    }
+    auto& stored = *stored_ptr;
+    if (IsRowRequest(req_data.keys)) {
+      ProcessRows(key, req_meta, req_data, &stored, merged_ptr, server);
+      return;
+    }
 
     // there used several WaitToRead, this is because \a recved's memory
     // could be deallocated when this function returns. so we need to make sure
@@ -173,20 +359,43 @@ class KVStoreDistServer {
       TBlob recv_blob((real_t*)req_data.vals.data(), // NOLINT(*)
                       dshape, cpu::kDevMask);
       NDArray recved = NDArray(recv_blob, 0);
+      if (!stored.is_none() && gradient_compression_.enabled()) {
+        // the pushes after the initialization are compressed
+        dshape = stored.shape();
+        auto& decompressed = merged_ptr->decompressed;
+        if (decompressed.is_none()) {
+          decompressed = NDArray(dshape, Context());
+        }
+        gradient_compression_.Dequantize(recved, &decompressed, 0);
+        recved = decompressed;
+      } else if (!stored.is_none() && wire_format_.enabled()) {
+        // the pushes after the initialization are packed, and merged in float32
+        dshape = stored.shape();
+        auto& decompressed = merged_ptr->decompressed;
+        if (decompressed.is_none()) {
+          decompressed = NDArray(dshape, Context());
+        }
+        wire_format_.Unpack(recved, &decompressed, 0);
+        recved = decompressed;
+      }
       if (stored.is_none()) {
         // initialization
         stored = NDArray(dshape, Context());
         CopyFromTo(recved, &stored, 0);
-        server->Response(req_meta);
+        ++merged_ptr->version;
+        Respond(req_meta, server);
         stored.WaitToRead();
       } else if (sync_mode_) {
         // synced push
-        auto& merged = merge_buf_[key];
+        auto& merged = *merged_ptr;
         if (merged.array.is_none()) {
           merged.array = NDArray(dshape, Context());
         }
 
+        CHECK(merged.request.empty() || !merged.row_sparse)
+            << "the pushes of a round of key " << key << " are all dense or all row sparse";
         if (merged.request.size() == 0) {
+          merged.row_sparse = false;
           CopyFromTo(recved, &merged.array, 0);
         } else {
           merged.array += recved;
@@ -194,20 +403,18 @@ class KVStoreDistServer {
 
         merged.request.push_back(req_meta);
 
-        if (merged.request.size() == (size_t)ps::NumWorkers()) {
-          // let the main thread to execute updater_, which is necessary for
-          // python
-          if (updater_) {
-            exec_.Exec([this, key, &merged, &stored](){
-                CHECK(updater_);
-                updater_(key, merged.array, &stored);
-              });
+        // only the leaders push when the workers are grouped
+        size_t num_pushes = (ps::NumWorkers() + group_size_ - 1) / group_size_;
+        if (merged.request.size() == num_pushes) {
+          if (optimizer_.enabled() || updater_) {
+            ApplyUpdate(key, merged.array, &stored);
           } else {
             // if no updater, just copy
             CopyFromTo(merged.array, &stored);
           }
+          ++merged.version;
           for (const auto& req : merged.request) {
-            server->Response(req);
+            Respond(req, server);
           }
           merged.request.clear();
           stored.WaitToRead();
@@ -216,49 +423,301 @@ class KVStoreDistServer {
         }
       } else {
         // async push
-        exec_.Exec([this, key, &recved, &stored](){
-            CHECK(updater_);
-            updater_(key, recved, &stored);
-          });
-        server->Response(req_meta);
+        ApplyUpdate(key, recved, &stored);
+        ++merged_ptr->version;
+        Respond(req_meta, server);
         stored.WaitToRead();
+        if (staleness_ >= 0) {
+          ++Clock(merged_ptr, req_meta.sender);
+          ReleaseDelayedPulls(stored, merged_ptr, server);
+        }
       }
     } else {
       // pull
-      ps::KVPairs<real_t> response;
       CHECK(!stored.is_none()) << "init " << key << " first";
-      int len = stored.shape()[0];
+      if (!sync_mode_ && staleness_ >= 0 && TooFarAhead(merged_ptr, req_meta.sender)) {
+        merged_ptr->delayed_pulls.emplace_back(req_meta, req_data.keys);
+        return;
+      }
+      RespondPull(stored, merged_ptr, req_meta, req_data.keys, server);
+    }
+  }
+
+  /**
+   * \brief push or pull the rows of a key listed in a row sparse request.
+   * the rows are summed over the workers in sync mode, and the updater
+   * receives the rows of the gradient and of the weight
+   */
+  void ProcessRows(int key, const ps::KVMeta& req_meta, const ps::KVPairs<real_t>& req_data,
+                   NDArray* stored_ptr, MergeBuf* merged_ptr, ps::KVServer<real_t>* server) {
+    auto& stored = *stored_ptr;
+    CHECK(!stored.is_none()) << "init " << key << " first";
+    int width;
+    {
+      std::lock_guard<std::mutex> lk(store_mu_);
+      auto it = row_size_.find(key);
+      CHECK(it != row_size_.end()) << "the row size of " << key << " is not set";
+      width = it->second;
+    }
+    std::vector<int64_t> rows;
+    for (size_t i = 1; i < req_data.keys.size(); ++i) {
+      rows.push_back(DecodeRow(req_data.keys[i]));
+      CHECK_LT(rows.back() * width, static_cast<int64_t>(stored.shape().Size()))
+          << "row " << rows.back() << " of key " << key << " is not on this server";
+    }
+    if (!req_meta.push) {
+      stored.WaitToRead();
+      const real_t* data = stored.data().dptr<real_t>();
+      ps::KVPairs<real_t> response;
       response.keys = req_data.keys;
-      response.lens = {len};
-      // TODO(mli) try to remove this CopyFrom
-      response.vals.CopyFrom(static_cast<const float*>(stored.data().dptr_), len);
+      response.lens.resize(req_data.keys.size(), width);
+      response.lens[0] = 0;
+      response.vals.resize(rows.size() * width);
+      for (size_t i = 0; i < rows.size(); ++i) {
+        std::copy(data + rows[i] * width, data + (rows[i] + 1) * width,
+                  response.vals.data() + i * width);
+      }
       server->Response(req_meta, response);
+      return;
+    }
+    CHECK_EQ(req_data.vals.size(), rows.size() * width);
+    const real_t* vals = req_data.vals.data();
+    if (!sync_mode_) {
+      UpdateRows(key, rows, vals, width, &stored);
+      ++merged_ptr->version;
+      server->Response(req_meta);
+      return;
+    }
+    auto& merged = *merged_ptr;
+    CHECK(merged.request.empty() || merged.row_sparse)
+        << "the pushes of a round of key " << key << " are all dense or all row sparse";
+    merged.row_sparse = true;
+    for (size_t i = 0; i < rows.size(); ++i) {
+      auto& sum = merged.rows[rows[i]];
+      if (sum.empty()) {
+        sum.assign(vals + i * width, vals + (i + 1) * width);
+      } else {
+        for (int j = 0; j < width; ++j) sum[j] += vals[i * width + j];
+      }
+    }
+    merged.request.push_back(req_meta);
+    size_t num_pushes = (ps::NumWorkers() + group_size_ - 1) / group_size_;
+    if (merged.request.size() == num_pushes) {
+      std::vector<int64_t> merged_rows;
+      std::vector<real_t> sums;
+      for (const auto& row : merged.rows) {
+        merged_rows.push_back(row.first);
+        sums.insert(sums.end(), row.second.begin(), row.second.end());
+      }
+      UpdateRows(key, merged_rows, sums.data(), width, &stored);
+      ++merged.version;
+      for (const auto& req : merged.request) {
+        server->Response(req);
+      }
+      merged.request.clear();
+      merged.rows.clear();
     }
   }
 
+  /**
+   * \brief update the rows of the stored array with the rows of a gradient
+   */
+  void UpdateRows(int key, const std::vector<int64_t>& rows, const real_t* vals, int width,
+                  NDArray* stored) {
+    if (rows.empty()) return;
+    TShape shape = mshadow::Shape2(rows.size(), width);
+    NDArray grad(TBlob(const_cast<real_t*>(vals), shape, cpu::kDevMask), 0);
+    NDArray weight(shape, Context());
+    NDArray all = stored->Reshape(mshadow::Shape2(stored->shape().Size() / width, width));
+    NDArray idx = RowIndex(rows, Context());
+    GatherRows(all, idx, &weight, 0);
+    if (optimizer_.enabled()) {
+      optimizer_.UpdateRows(key, idx, all, grad, &weight);
+    } else if (updater_) {
+      exec_.Exec([this, key, &grad, &weight](){
+          updater_(key, grad, &weight);
+        });
+    } else {
+      CopyFromTo(grad, &weight, 0);
+    }
+    ScatterRows(weight, idx, &all, 0);
+    // vals may be released when this returns
+    stored->WaitToRead();
+  }
+
+  /**
+   * \brief update the stored array by a gradient, with the native optimizer on
+   * the calling thread if there is one, else with the updater on the main
+   * thread, which is necessary for python
+   */
+  void ApplyUpdate(int key, const NDArray& grad, NDArray* stored) {
+    if (optimizer_.enabled()) {
+      optimizer_.Update(key, grad, stored);
+      return;
+    }
+    exec_.Exec([this, key, &grad, stored](){
+        CHECK(updater_);
+        updater_(key, grad, stored);
+      });
+  }
+
+  /*! \brief whether the keys of a request are the rows of a key, after the marker */
+  static bool IsRowRequest(const ps::SArray<ps::Key>& keys) {
+    auto kr = ps::Postoffice::Get()->GetServerKeyRanges()[ps::MyRank()];
+    return !keys.empty() && ((keys[0] - kr.begin()) >> 32) != 0;
+  }
+
+  static int64_t DecodeRow(ps::Key key) {
+    auto kr = ps::Postoffice::Get()->GetServerKeyRanges()[ps::MyRank()];
+    return static_cast<int64_t>((key - kr.begin()) >> 32) - 2;
+  }
+
   int DecodeKey(ps::Key key) {
     auto kr = ps::Postoffice::Get()->GetServerKeyRanges()[ps::MyRank()];
-    return key - kr.begin();
+    return static_cast<int>((key - kr.begin()) & 0xffffffff);
   }
 
   /**
    * \brief user defined
    */
   bool sync_mode_;
+  /*! \brief the number of workers whose gradients each push sums */
+  int group_size_;
+  /*! \brief how many more async pushes a worker can make than the slowest one before
+   *  its pulls wait, -1 for no bound */
+  int staleness_;
   KVStore::Controller controller_;
   KVStore::Updater updater_;
+  /*! \brief the native optimizer set by kSetServerOptimizer, used instead of updater_ */
+  ServerOptimizer optimizer_;
 
   std::unordered_map<int, NDArray> store_;
 
   struct MergeBuf {
     std::vector<ps::KVMeta> request;
     NDArray array;
+    /*! \brief the last compressed or packed push, in float32 */
+    NDArray decompressed;
+    /*! \brief the stored array in the wire dtype, for the pulls */
+    NDArray packed;
+    /*! \brief the async pushes of each worker, with a staleness bound */
+    std::vector<int> clock;
+    /*! \brief the pulls waiting for the slowest worker to push */
+    std::vector<std::pair<ps::KVMeta, ps::SArray<ps::Key> > > delayed_pulls;
+    /*! \brief whether the pushes of the round are row sparse, and the sum of their rows */
+    bool row_sparse = false;
+    std::map<int64_t, std::vector<real_t> > rows;
+    /*! \brief the version of the stored array, which changes with every update */
+    uint64_t version = 0;
+    /*! \brief the version each worker pulled last, by node id */
+    std::unordered_map<int, uint64_t> pulled_versions;
   };
   std::unordered_map<int, MergeBuf> merge_buf_;
+  /*! \brief the number of values in a row of the keys pushed by rows */
+  std::unordered_map<int, int> row_size_;
+
+  GradientCompression gradient_compression_;
+  WireFormat wire_format_;
+  /*! \brief protects the insertions into store_ and merge_buf_, and row_size_ */
+  std::mutex store_mu_;
+
+  /*! \brief a request batching several keys, waiting for the responses of its keys */
+  struct Batch {
+    ps::SArray<ps::Key> keys;
+    size_t remaining = 0;
+    /*! \brief the responses of the keys of a pull */
+    std::vector<ps::KVPairs<real_t> > parts;
+  };
+  /*! \brief the batches by sender and timestamp */
+  std::map<std::pair<int, int>, Batch> batches_;
+  std::mutex batch_mu_;
+
+  struct Request {
+    ps::KVMeta meta;
+    ps::KVPairs<real_t> data;
+    ps::KVServer<real_t>* server;
+  };
+  /*! \brief the requests waiting for each thread */
+  std::vector<std::unique_ptr<dmlc::ConcurrentBlockingQueue<Request> > > queues_;
+  std::vector<std::thread> workers_;
 
   Executor exec_;
 
   ps::KVServer<float>* ps_server_;
+
+  /**
+   * \brief the number of async pushes of a key by the worker, or by the
+   * group of the worker when only group leaders push
+   */
+  int& Clock(MergeBuf* merged, int sender) {
+    if (merged->clock.empty()) {
+      merged->clock.resize((ps::NumWorkers() + group_size_ - 1) / group_size_, 0);
+    }
+    return merged->clock[ps::Postoffice::IDtoRank(sender) / group_size_];
+  }
+
+  /**
+   * \brief whether the worker pushed the key more than staleness_ times more
+   * than the slowest worker, so that it has to wait before pulling
+   */
+  bool TooFarAhead(MergeBuf* merged, int sender) {
+    int clock = Clock(merged, sender);
+    int slowest = *std::min_element(merged->clock.begin(), merged->clock.end());
+    return clock - slowest > staleness_;
+  }
+
+  void ReleaseDelayedPulls(const NDArray& stored, MergeBuf* merged,
+                           ps::KVServer<real_t>* server) {
+    std::vector<std::pair<ps::KVMeta, ps::SArray<ps::Key> > > delayed;
+    for (const auto& pull : merged->delayed_pulls) {
+      if (TooFarAhead(merged, pull.first.sender)) {
+        delayed.push_back(pull);
+      } else {
+        RespondPull(stored, merged, pull.first, pull.second, server);
+      }
+    }
+    merged->delayed_pulls.swap(delayed);
+  }
+
+  void RespondPull(const NDArray& stored, MergeBuf* merged_ptr, const ps::KVMeta& req_meta,
+                   const ps::SArray<ps::Key>& keys, ps::KVServer<real_t>* server) {
+    auto pulled = merged_ptr->pulled_versions.find(req_meta.sender);
+    if (req_meta.cmd == kPullIfChanged && pulled != merged_ptr->pulled_versions.end() &&
+        pulled->second == merged_ptr->version) {
+      // the worker still holds the values it pulled last
+      ps::KVPairs<real_t> response;
+      response.keys = keys;
+      response.lens = {0};
+      Respond(req_meta, server, response);
+      return;
+    }
+    merged_ptr->pulled_versions[req_meta.sender] = merged_ptr->version;
+    // the response references the memory of the stored array instead of a
+    // copy. the engine operation keeps a read dependency on the array until
+    // the message is sent, so the next update of the array waits for it
+    NDArray array = stored;
+    if (wire_format_.enabled()) {
+      auto& packed = merged_ptr->packed;
+      if (packed.is_none()) {
+        packed = NDArray(mshadow::Shape1(WireFormat::packed_size(stored.shape()[0])),
+                         Context());
+      }
+      wire_format_.Pack(stored, &packed, 0);
+      array = packed;
+    }
+    auto respond = [this, array, keys, req_meta, server](
+        RunContext rctx, Engine::CallbackOnComplete on_complete) {
+      ps::KVPairs<real_t> response;
+      int len = array.shape()[0];
+      response.keys = keys;
+      response.lens = {len};
+      response.vals.reset(static_cast<real_t*>(array.data().dptr_), len,
+                          [on_complete](real_t*) { on_complete(); });
+      Respond(req_meta, server, response);
+    };
+    Engine::Get()->PushAsync(respond, array.ctx(), {array.var()}, {},
+                             FnProperty::kNormal, 0, PROFILER_MESSAGE("KVStoreDistServerPull"));
+  }
 };
 
 }  // namespace kvstore
@@ -32,6 +32,7 @@
 #include <utility>
 #include <algorithm>
 #include "./comm.h"
+#include "./comm_nccl.h"
 
 namespace mxnet {
 namespace kvstore {
@@ -42,14 +43,22 @@ class KVStoreLocal : public KVStore {
  public:
   /*
    * \param use_device_comm
+   * \param use_nccl reduce between the GPUs with NCCL
    */
-  explicit KVStoreLocal(bool use_device_comm) : KVStore() {
-    if (use_device_comm) {
+  explicit KVStoreLocal(bool use_device_comm, bool use_nccl = false) : KVStore() {
+    if (use_nccl) {
+#if MXNET_USE_NCCL
+      comm_ = new CommNCCL();
+#else
+      LOG(FATAL) << "compile with USE_NCCL=1 to use NCCL";
+#endif  // MXNET_USE_NCCL
+    } else if (use_device_comm) {
       comm_ = new CommDevice();
     } else {
       comm_ = new CommCPU();
     }
     pinned_ctx_ = comm_->pinned_ctx();
+    skip_unchanged_pull_ = dmlc::GetEnv("MXNET_KVSTORE_SKIP_UNCHANGED_PULL", true);
   }
 
   virtual ~KVStoreLocal() {
@@ -62,6 +71,7 @@ class KVStoreLocal : public KVStore {
       CHECK(local_.find(keys[i]) == local_.end())
           << "duplicate init of key " << keys[i];
       local_[keys[i]] = values[i].Copy(pinned_ctx_);
+      ++versions_[keys[i]];
       comm_->Init(keys[i], values[i].shape(), values[i].dtype());
     }
   }
@@ -91,6 +101,7 @@ class KVStoreLocal : public KVStore {
       int key = uniq_keys[i];
       const NDArray& merged = comm_->Reduce(key, grouped_vals[i], priority);
       NDArray& local = local_[key];
+      ++versions_[key];
       if (updater_ != nullptr) {
         CHECK(!local.is_none()) << "key " << key << " has not been inited";
         // if merged is on gpu, we may need copy weight from cpu to gpu
@@ -116,7 +127,12 @@ class KVStoreLocal : public KVStore {
       int key = uniq_keys[i];
       const NDArray& local = local_[key];
       CHECK(!local.is_none()) << "key " << key << " has not been inited";
-      comm_->Broadcast(key, local, grouped_vals[i], priority);
+      if (skip_unchanged_pull_) {
+        // the arrays pulled before and not written since keep their value
+        comm_->BroadcastChanged(key, versions_[key], local, grouped_vals[i], priority);
+      } else {
+        comm_->Broadcast(key, local, grouped_vals[i], priority);
+      }
     }
   }
 
@@ -136,6 +152,28 @@ class KVStoreLocal : public KVStore {
     Pull(keys, values, priority);
   }
 
+  // the dense defaults of the integer keys
+  using KVStore::PushRowSparse;
+  using KVStore::PullRowSparse;
+
+  void PushRowSparse(const std::vector<std::string>& str_keys,
+                     const std::vector<NDArray>& values,
+                     const std::vector<NDArray>& row_ids,
+                     int priority) override {
+    std::vector<int> keys(str_keys.size());
+    LookupKeys(str_keys, &keys);
+    PushRowSparse(keys, values, row_ids, priority);
+  }
+
+  void PullRowSparse(const std::vector<std::string>& str_keys,
+                     const std::vector<NDArray*>& values,
+                     const std::vector<NDArray>& row_ids,
+                     int priority) override {
+    std::vector<int> keys(str_keys.size());
+    LookupKeys(str_keys, &keys);
+    PullRowSparse(keys, values, row_ids, priority);
+  }
+
  protected:
   /**
    * \brief group values on keys
@@ -184,6 +222,10 @@ class KVStoreLocal : public KVStore {
   Context pinned_ctx_;
   /// \brief buffer for storing local values
   std::unordered_map<int, NDArray> local_;
+  /// \brief the version of each value in local_, which changes with every push
+  std::unordered_map<int, uint64_t> versions_;
+  /// \brief whether the pulls skip the arrays that hold the current value already
+  bool skip_unchanged_pull_;
   /// key mapping for string -> integer
   std::unordered_map<std::string, int> str_key_dict_;
   /// the next available integer for string->int key mapping
@@ -0,0 +1,203 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * \file reduce_sum_cpu.h
+ * \brief vectorized sums of the cpu copies of an array, for CommCPU
+ *
+ * The AVX2 and AVX-512 versions are compiled with target attributes and
+ * chosen at runtime, so that a default build uses them on the cpus that
+ * have them. Every source is read once per vector and the sum is written
+ * once, with non-temporal stores for the arrays that do not fit in cache.
+ */
+#ifndef MXNET_KVSTORE_REDUCE_SUM_CPU_H_
+#define MXNET_KVSTORE_REDUCE_SUM_CPU_H_
+
+#include <mshadow/base.h>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MXNET_KVSTORE_REDUCE_SIMD 1
+#include <immintrin.h>
+#else
+#define MXNET_KVSTORE_REDUCE_SIMD 0
+#endif
+
+namespace mxnet {
+namespace kvstore {
+namespace reduce {
+
+#if MXNET_KVSTORE_REDUCE_SIMD
+/*! \brief the instruction sets the reductions can use on this cpu */
+struct CPUFeatures {
+  bool avx2;
+  bool avx512f;
+  bool f16c;
+  CPUFeatures() {
+    __builtin_cpu_init();
+    avx2 = __builtin_cpu_supports("avx2");
+    avx512f = __builtin_cpu_supports("avx512f");
+    // f16c is not known to __builtin_cpu_supports, the cpus with avx2 have it
+    f16c = avx2;
+  }
+  static const CPUFeatures& Get() {
+    static CPUFeatures inst;
+    return inst;
+  }
+};
+
+__attribute__((target("avx2")))
+inline void SumFloatAVX2(float* const* src, size_t nsrc, size_t n, bool stream) {
+  float* dst = src[0];
+  size_t i = 0;
+  if (stream) {
+    // non-temporal stores need aligned addresses
+    for (; i < n && (reinterpret_cast<uintptr_t>(dst + i) & 31); ++i) {
+      for (size_t k = 1; k < nsrc; ++k) dst[i] += src[k][i];
+    }
+  }
+  for (; i + 16 <= n; i += 16) {
+    __m256 a0 = _mm256_loadu_ps(dst + i);
+    __m256 a1 = _mm256_loadu_ps(dst + i + 8);
+    for (size_t k = 1; k < nsrc; ++k) {
+      a0 = _mm256_add_ps(a0, _mm256_loadu_ps(src[k] + i));
+      a1 = _mm256_add_ps(a1, _mm256_loadu_ps(src[k] + i + 8));
+    }
+    if (stream) {
+      _mm256_stream_ps(dst + i, a0);
+      _mm256_stream_ps(dst + i + 8, a1);
+    } else {
+      _mm256_storeu_ps(dst + i, a0);
+      _mm256_storeu_ps(dst + i + 8, a1);
+    }
+  }
+  for (; i < n; ++i) {
+    for (size_t k = 1; k < nsrc; ++k) dst[i] += src[k][i];
+  }
+  if (stream) _mm_sfence();
+}
+
+__attribute__((target("avx512f")))
+inline void SumFloatAVX512(float* const* src, size_t nsrc, size_t n, bool stream) {
+  float* dst = src[0];
+  size_t i = 0;
+  if (stream) {
+    for (; i < n && (reinterpret_cast<uintptr_t>(dst + i) & 63); ++i) {
+      for (size_t k = 1; k < nsrc; ++k) dst[i] += src[k][i];
+    }
+  }
+  for (; i + 32 <= n; i += 32) {
+    __m512 a0 = _mm512_loadu_ps(dst + i);
+    __m512 a1 = _mm512_loadu_ps(dst + i + 16);
+    for (size_t k = 1; k < nsrc; ++k) {
+      a0 = _mm512_add_ps(a0, _mm512_loadu_ps(src[k] + i));
+      a1 = _mm512_add_ps(a1, _mm512_loadu_ps(src[k] + i + 16));
+    }
+    if (stream) {
+      _mm512_stream_ps(dst + i, a0);
+      _mm512_stream_ps(dst + i + 16, a1);
+    } else {
+      _mm512_storeu_ps(dst + i, a0);
+      _mm512_storeu_ps(dst + i + 16, a1);
+    }
+  }
+  for (; i < n; ++i) {
+    for (size_t k = 1; k < nsrc; ++k) dst[i] += src[k][i];
+  }
+  if (stream) _mm_sfence();
+}
+
+/*! \brief fp16 sums accumulate in fp32 and round once, 8 values at a time */
+__attribute__((target("avx2,f16c")))
+inline size_t SumHalfF16C(uint16_t* const* src, size_t nsrc, size_t n, bool stream) {
+  uint16_t* dst = src[0];
+  size_t i = 0;
+  const bool aligned = (reinterpret_cast<uintptr_t>(dst) & 15) == 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 acc = _mm256_cvtph_ps(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i)));
+    for (size_t k = 1; k < nsrc; ++k) {
+      acc = _mm256_add_ps(acc, _mm256_cvtph_ps(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[k] + i))));
+    }
+    const __m128i h = _mm256_cvtps_ph(acc, _MM_FROUND_TO_NEAREST_INT);
+    if (stream && aligned) {
+      _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    } else {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+  }
+  if (stream && aligned) _mm_sfence();
+  // the tail is left to the caller
+  return i;
+}
+#endif  // MXNET_KVSTORE_REDUCE_SIMD
+
+/*!
+ * \brief dptr[0][offset, offset + size) += the same range of dptr[1...]
+ *  with the widest vectors of the cpu
+ * \param stream write the sum with non-temporal stores
+ * \return the number of values summed, 0 if there is no vectorized version
+ */
+template<typename DType>
+inline size_t SumSIMD(const std::vector<DType*>& dptr, size_t offset, size_t size,
+                      bool stream) {
+  return 0;
+}
+
+template<>
+inline size_t SumSIMD<float>(const std::vector<float*>& dptr, size_t offset, size_t size,
+                             bool stream) {
+#if MXNET_KVSTORE_REDUCE_SIMD
+  const CPUFeatures& cpu = CPUFeatures::Get();
+  if (!cpu.avx2) return 0;
+  std::vector<float*> src(dptr.size());
+  for (size_t k = 0; k < dptr.size(); ++k) src[k] = dptr[k] + offset;
+  if (cpu.avx512f) {
+    SumFloatAVX512(src.data(), src.size(), size, stream);
+  } else {
+    SumFloatAVX2(src.data(), src.size(), size, stream);
+  }
+  return size;
+#else
+  return 0;
+#endif  // MXNET_KVSTORE_REDUCE_SIMD
+}
+
+template<>
+inline size_t SumSIMD<mshadow::half::half_t>(const std::vector<mshadow::half::half_t*>& dptr,
+                                             size_t offset, size_t size, bool stream) {
+#if MXNET_KVSTORE_REDUCE_SIMD
+  if (!CPUFeatures::Get().f16c) return 0;
+  std::vector<uint16_t*> src(dptr.size());
+  for (size_t k = 0; k < dptr.size(); ++k) {
+    src[k] = reinterpret_cast<uint16_t*>(dptr[k] + offset);
+  }
+  return SumHalfF16C(src.data(), src.size(), size, stream);
+#else
+  return 0;
+#endif  // MXNET_KVSTORE_REDUCE_SIMD
+}
+
+}  // namespace reduce
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_REDUCE_SUM_CPU_H_
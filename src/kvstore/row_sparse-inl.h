@@ -0,0 +1,73 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file row_sparse-inl.h
+ * \brief Kernels gathering and scattering rows
+ */
+#ifndef MXNET_KVSTORE_ROW_SPARSE_INL_H_
+#define MXNET_KVSTORE_ROW_SPARSE_INL_H_
+#include "./row_sparse.h"
+#include "../operator/mxnet_op.h"
+
+namespace mxnet {
+namespace kvstore {
+
+/*! \brief one value per thread */
+struct gather_rows {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* dst, const DType* src, const int* idx,
+                                  int width) {
+    dst[i] = src[idx[i / width] * width + i % width];
+  }
+};
+
+struct scatter_rows {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* dst, const DType* src, const int* idx,
+                                  int width) {
+    dst[idx[i / width] * width + i % width] = src[i];
+  }
+};
+
+template<typename xpu>
+void GatherRowsLaunch(mshadow::Stream<xpu>* s, const TBlob& src, const TBlob& idx,
+                      const TBlob& dst) {
+  using namespace mxnet::op;
+  const int width = dst.shape_[1];
+  MSHADOW_TYPE_SWITCH(dst.type_flag_, DType, {
+    mxnet_op::Kernel<gather_rows, xpu>::Launch(s, dst.Size(), dst.dptr<DType>(),
+                                               src.dptr<DType>(), idx.dptr<int>(), width);
+  });
+}
+
+template<typename xpu>
+void ScatterRowsLaunch(mshadow::Stream<xpu>* s, const TBlob& src, const TBlob& idx,
+                       const TBlob& dst) {
+  using namespace mxnet::op;
+  const int width = src.shape_[1];
+  MSHADOW_TYPE_SWITCH(src.type_flag_, DType, {
+    mxnet_op::Kernel<scatter_rows, xpu>::Launch(s, src.Size(), dst.dptr<DType>(),
+                                                src.dptr<DType>(), idx.dptr<int>(), width);
+  });
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_ROW_SPARSE_INL_H_
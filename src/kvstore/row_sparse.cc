@@ -0,0 +1,118 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file row_sparse.cc
+ * \brief Gathering and scattering the rows pushed and pulled alone
+ */
+#include <mxnet/engine.h>
+#include "./row_sparse-inl.h"
+
+namespace mxnet {
+namespace kvstore {
+
+template<>
+void GatherRowsImpl<cpu>(mshadow::Stream<cpu>* s, const TBlob& src, const TBlob& idx,
+                         const TBlob& dst) {
+  GatherRowsLaunch(s, src, idx, dst);
+}
+
+template<>
+void ScatterRowsImpl<cpu>(mshadow::Stream<cpu>* s, const TBlob& src, const TBlob& idx,
+                          const TBlob& dst) {
+  ScatterRowsLaunch(s, src, idx, dst);
+}
+
+void GatherRows(const NDArray& src, const NDArray& idx, NDArray* dst, int priority) {
+  CHECK_EQ(src.shape().ndim(), 2U);
+  CHECK_EQ(dst->shape().ndim(), 2U);
+  CHECK_EQ(src.shape()[1], dst->shape()[1]) << "The rows have different widths";
+  CHECK_EQ(idx.shape().Size(), dst->shape()[0]);
+  CHECK_EQ(idx.dtype(), mshadow::kInt32);
+  CHECK(src.ctx() == dst->ctx() && src.ctx() == idx.ctx())
+    << "The rows are gathered on their own device";
+  if (dst->shape()[0] == 0) return;
+  NDArray in = src, index = idx, out = *dst;
+  switch (src.ctx().dev_mask()) {
+    case cpu::kDevMask: {
+      Engine::Get()->PushSync([in, index, out](RunContext ctx) {
+          GatherRowsImpl<cpu>(ctx.get_stream<cpu>(), in.data(), index.data(), out.data());
+        }, src.ctx(), {src.var(), idx.var()}, {dst->var()},
+        FnProperty::kNormal, priority, PROFILER_MESSAGE("GatherRows"));
+      break;
+    }
+#if MXNET_USE_CUDA
+    case gpu::kDevMask: {
+      Engine::Get()->PushSync([in, index, out](RunContext ctx) {
+          GatherRowsImpl<gpu>(ctx.get_stream<gpu>(), in.data(), index.data(), out.data());
+          // Wait GPU kernel to complete
+          ctx.get_stream<gpu>()->Wait();
+        }, src.ctx(), {src.var(), idx.var()}, {dst->var()},
+        FnProperty::kNormal, priority, PROFILER_MESSAGE("GatherRows"));
+      break;
+    }
+#endif
+    default: LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+  }
+}
+
+void ScatterRows(const NDArray& src, const NDArray& idx, NDArray* dst, int priority) {
+  CHECK_EQ(src.shape().ndim(), 2U);
+  CHECK_EQ(dst->shape().ndim(), 2U);
+  CHECK_EQ(src.shape()[1], dst->shape()[1]) << "The rows have different widths";
+  CHECK_EQ(idx.shape().Size(), src.shape()[0]);
+  CHECK_EQ(idx.dtype(), mshadow::kInt32);
+  CHECK(src.ctx() == dst->ctx() && src.ctx() == idx.ctx())
+    << "The rows are scattered on their own device";
+  if (src.shape()[0] == 0) return;
+  NDArray in = src, index = idx, out = *dst;
+  switch (src.ctx().dev_mask()) {
+    case cpu::kDevMask: {
+      Engine::Get()->PushSync([in, index, out](RunContext ctx) {
+          ScatterRowsImpl<cpu>(ctx.get_stream<cpu>(), in.data(), index.data(), out.data());
+        }, src.ctx(), {src.var(), idx.var()}, {dst->var()},
+        FnProperty::kNormal, priority, PROFILER_MESSAGE("ScatterRows"));
+      break;
+    }
+#if MXNET_USE_CUDA
+    case gpu::kDevMask: {
+      Engine::Get()->PushSync([in, index, out](RunContext ctx) {
+          ScatterRowsImpl<gpu>(ctx.get_stream<gpu>(), in.data(), index.data(), out.data());
+          // Wait GPU kernel to complete
+          ctx.get_stream<gpu>()->Wait();
+        }, src.ctx(), {src.var(), idx.var()}, {dst->var()},
+        FnProperty::kNormal, priority, PROFILER_MESSAGE("ScatterRows"));
+      break;
+    }
+#endif
+    default: LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+  }
+}
+
+NDArray RowIndex(const std::vector<int64_t>& rows, const Context& ctx) {
+  std::vector<int> index(rows.begin(), rows.end());
+  NDArray idx(mshadow::Shape1(index.size()), Context(), false, mshadow::kInt32);
+  if (!index.empty()) {
+    idx.SyncCopyFromCPU(index.data(), index.size());
+  }
+  return ctx == idx.ctx() ? idx : idx.Copy(ctx);
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
@@ -0,0 +1,42 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file row_sparse.cu
+ * \brief Gathering and scattering the rows pushed and pulled alone
+ */
+#include "./row_sparse-inl.h"
+
+namespace mxnet {
+namespace kvstore {
+
+template<>
+void GatherRowsImpl<gpu>(mshadow::Stream<gpu>* s, const TBlob& src, const TBlob& idx,
+                         const TBlob& dst) {
+  GatherRowsLaunch(s, src, idx, dst);
+}
+
+template<>
+void ScatterRowsImpl<gpu>(mshadow::Stream<gpu>* s, const TBlob& src, const TBlob& idx,
+                          const TBlob& dst) {
+  ScatterRowsLaunch(s, src, idx, dst);
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
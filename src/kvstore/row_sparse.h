@@ -0,0 +1,61 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file row_sparse.h
+ * \brief Gathering and scattering the rows pushed and pulled alone
+ */
+#ifndef MXNET_KVSTORE_ROW_SPARSE_H_
+#define MXNET_KVSTORE_ROW_SPARSE_H_
+#include <mxnet/ndarray.h>
+#include <stdint.h>
+#include <vector>
+
+namespace mxnet {
+namespace kvstore {
+
+/*! \brief dst[i] = src[idx[i]] for the rows of 2-D arrays, runs on the device of xpu */
+template<typename xpu>
+void GatherRowsImpl(mshadow::Stream<xpu>* s, const TBlob& src, const TBlob& idx,
+                    const TBlob& dst);
+
+/*! \brief dst[idx[i]] = src[i] */
+template<typename xpu>
+void ScatterRowsImpl(mshadow::Stream<xpu>* s, const TBlob& src, const TBlob& idx,
+                     const TBlob& dst);
+
+/*!
+ * \brief copy the rows of src listed in idx into the rows of dst, on the
+ *  device of the arrays
+ * \param idx the int32 row indices, one per row of dst
+ */
+void GatherRows(const NDArray& src, const NDArray& idx, NDArray* dst, int priority);
+
+/*!
+ * \brief copy the rows of src into the rows of dst listed in idx, leaving
+ *  the other rows of dst unchanged
+ */
+void ScatterRows(const NDArray& src, const NDArray& idx, NDArray* dst, int priority);
+
+/*! \brief the int32 array of the row indices, on ctx */
+NDArray RowIndex(const std::vector<int64_t>& rows, const Context& ctx);
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_ROW_SPARSE_H_
@@ -0,0 +1,208 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * \file server_optimizer.h
+ * \brief the optimizers a server runs natively, without the python updater
+ */
+#ifndef MXNET_KVSTORE_SERVER_OPTIMIZER_H_
+#define MXNET_KVSTORE_SERVER_OPTIMIZER_H_
+
+#include <mxnet/ndarray.h>
+#include <mxnet/engine.h>
+#include <mxnet/op_attr_types.h>
+#include <nnvm/op.h>
+#include <cmath>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "./row_sparse.h"
+
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief runs an update operator such as sgd_mom_update or adam_update on
+ * the stored weights, with a state array of the weight's shape for each of
+ * the operator's inputs after the weight and the gradient.
+ *
+ * The settings are lines of name=value: op is the operator, lr and wd the
+ * defaults of the keys, lr.<key> and wd.<key> the values of a key, and the
+ * rest the operator's hyper-parameters. With bias_correction=1 the lr of
+ * adam_update is scaled by sqrt(1 - beta2^t) / (1 - beta1^t) for the t-th
+ * update of the key, as the python Adam does, counting from
+ * begin_num_update.
+ *
+ * The updates of different keys may run in parallel, the ones of a key
+ * must not.
+ */
+class ServerOptimizer {
+ public:
+  bool enabled() const { return op_ != nullptr; }
+
+  void Init(const std::string& settings) {
+    std::lock_guard<std::mutex> lk(mu_);
+    std::istringstream is(settings);
+    std::string line;
+    std::string name;
+    params_.clear();
+    key_lr_.clear();
+    key_wd_.clear();
+    lr_ = 0.01f;
+    wd_ = 0.0f;
+    bias_correction_ = false;
+    begin_num_update_ = 0;
+    while (std::getline(is, line)) {
+      if (line.empty()) continue;
+      size_t sep = line.find('=');
+      CHECK_NE(sep, std::string::npos) << "Invalid server optimizer setting " << line;
+      std::string k = line.substr(0, sep), v = line.substr(sep + 1);
+      if (k == "op") {
+        name = v;
+      } else if (k == "lr") {
+        lr_ = std::stof(v);
+      } else if (k == "wd") {
+        wd_ = std::stof(v);
+      } else if (k.compare(0, 3, "lr.") == 0) {
+        key_lr_[std::stoi(k.substr(3))] = std::stof(v);
+      } else if (k.compare(0, 3, "wd.") == 0) {
+        key_wd_[std::stoi(k.substr(3))] = std::stof(v);
+      } else if (k == "bias_correction") {
+        bias_correction_ = std::stoi(v) != 0;
+      } else if (k == "begin_num_update") {
+        begin_num_update_ = std::stoi(v);
+      } else {
+        params_[k] = v;
+      }
+    }
+    const nnvm::Op* op = nnvm::Op::Get(name);
+    static auto& fcompute = nnvm::Op::GetAttr<FCompute>("FCompute<cpu>");
+    CHECK(fcompute.count(op)) << name << " has no cpu implementation for the server";
+    CHECK_GE(op->num_inputs, 2U) << name << " is not an update operator";
+    if (op != op_) states_.clear();
+    op_ = op;
+    fcompute_ = fcompute[op];
+    // check the hyper-parameters now rather than at the first push
+    Attrs(0, 1);
+  }
+
+  /*! \brief update weight by grad, allocating the states of key at the first update */
+  void Update(int key, const NDArray& grad, NDArray* weight) {
+    KeyState* st = State(key, weight->shape());
+    Run(Attrs(key, ++st->count), grad, *weight, st->arrays);
+  }
+
+  /**
+   * \brief update the rows idx of a key, whose stored array is viewed as
+   * all_rows, by the rows of grad. weight holds the rows of the stored array,
+   * and the rows of the states are gathered and scattered around the update
+   */
+  void UpdateRows(int key, const NDArray& idx, const NDArray& all_rows, const NDArray& grad,
+                  NDArray* weight) {
+    KeyState* st = State(key, all_rows.shape());
+    std::vector<NDArray> rows(st->arrays.size()), all(st->arrays.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+      all[i] = st->arrays[i].Reshape(all_rows.shape());
+      rows[i] = NDArray(weight->shape(), Context());
+      GatherRows(all[i], idx, &rows[i], 0);
+    }
+    Run(Attrs(key, ++st->count), grad, *weight, rows);
+    for (size_t i = 0; i < rows.size(); ++i) {
+      ScatterRows(rows[i], idx, &all[i], 0);
+    }
+  }
+
+ private:
+  struct KeyState {
+    std::vector<NDArray> arrays;
+    int count = 0;
+  };
+
+  KeyState* State(int key, const TShape& shape) {
+    std::lock_guard<std::mutex> lk(mu_);
+    KeyState& st = states_[key];
+    if (st.arrays.empty()) {
+      for (uint32_t i = 2; i < op_->num_inputs; ++i) {
+        NDArray a(shape, Context());
+        a = 0.0f;
+        st.arrays.push_back(a);
+      }
+    }
+    return &st;
+  }
+
+  nnvm::NodeAttrs Attrs(int key, int count) {
+    nnvm::NodeAttrs attrs;
+    attrs.op = op_;
+    attrs.dict = params_;
+    float lr = key_lr_.count(key) ? key_lr_.at(key) : lr_;
+    const float wd = key_wd_.count(key) ? key_wd_.at(key) : wd_;
+    if (bias_correction_) {
+      const int t = begin_num_update_ + count;
+      const double beta1 = params_.count("beta1") ? std::stod(params_.at("beta1")) : 0.9;
+      const double beta2 = params_.count("beta2") ? std::stod(params_.at("beta2")) : 0.999;
+      lr *= std::sqrt(1.0 - std::pow(beta2, t)) / (1.0 - std::pow(beta1, t));
+    }
+    std::ostringstream lr_str, wd_str;
+    lr_str.precision(9);
+    wd_str.precision(9);
+    lr_str << lr;
+    wd_str << wd;
+    attrs.dict["lr"] = lr_str.str();
+    attrs.dict["wd"] = wd_str.str();
+    if (op_->attr_parser != nullptr) op_->attr_parser(&attrs);
+    return attrs;
+  }
+
+  void Run(const nnvm::NodeAttrs& attrs, const NDArray& grad, const NDArray& weight,
+           const std::vector<NDArray>& states) {
+    std::vector<Engine::VarHandle> mutate_vars = {weight.var()};
+    for (const auto& s : states) mutate_vars.push_back(s.var());
+    FCompute fn = fcompute_;
+    Engine::Get()->PushSync([attrs, fn, grad, weight, states](RunContext rctx) {
+        std::vector<TBlob> inputs = {weight.data(), grad.data()};
+        for (const auto& s : states) inputs.push_back(s.data());
+        std::vector<TBlob> outputs = {weight.data()};
+        OpContext ctx;
+        ctx.is_train = true;
+        ctx.run_ctx = rctx;
+        fn(attrs, ctx, inputs, {kWriteInplace}, outputs);
+      }, Context::CPU(), {grad.var()}, mutate_vars,
+      FnProperty::kNormal, 0, PROFILER_MESSAGE("KVStoreServerOptimizer"));
+  }
+
+  const nnvm::Op* op_ = nullptr;
+  FCompute fcompute_;
+  std::unordered_map<std::string, std::string> params_;
+  float lr_ = 0.01f;
+  float wd_ = 0.0f;
+  std::unordered_map<int, float> key_lr_;
+  std::unordered_map<int, float> key_wd_;
+  bool bias_correction_ = false;
+  int begin_num_update_ = 0;
+  std::unordered_map<int, KeyState> states_;
+  /*! \brief protects the settings and the insertions into states_ */
+  std::mutex mu_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_SERVER_OPTIMIZER_H_
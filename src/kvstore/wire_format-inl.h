@@ -0,0 +1,98 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file wire_format-inl.h
+ * \brief Kernels converting the values sent to the servers
+ */
+#ifndef MXNET_KVSTORE_WIRE_FORMAT_INL_H_
+#define MXNET_KVSTORE_WIRE_FORMAT_INL_H_
+#include <stdint.h>
+#include "./wire_format.h"
+#include "../operator/mxnet_op.h"
+
+namespace mxnet {
+namespace kvstore {
+
+union FloatBits {
+  float f;
+  uint32_t u;
+};
+
+template<int type>
+struct pack {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, uint16_t* out, const DType* in) {
+    if (type == kWireFloat16) {
+      out[i] = mshadow::half::half_t(static_cast<float>(in[i])).half_;
+    } else {
+      FloatBits bits;
+      bits.f = static_cast<float>(in[i]);
+      out[i] = static_cast<uint16_t>(bits.u >> 16);
+    }
+  }
+};
+
+template<int type>
+struct unpack {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const uint16_t* in) {
+    if (type == kWireFloat16) {
+      mshadow::half::half_t value;
+      value.half_ = in[i];
+      out[i] = static_cast<DType>(static_cast<float>(value));
+    } else {
+      FloatBits bits;
+      bits.u = static_cast<uint32_t>(in[i]) << 16;
+      out[i] = static_cast<DType>(bits.f);
+    }
+  }
+};
+
+template<typename xpu>
+void PackLaunch(mshadow::Stream<xpu>* s, int type, const TBlob& in, const TBlob& out) {
+  using namespace mxnet::op;
+  uint16_t* halves = reinterpret_cast<uint16_t*>(out.dptr<float>());
+  MSHADOW_REAL_TYPE_SWITCH(in.type_flag_, DType, {
+    if (type == kWireFloat16) {
+      mxnet_op::Kernel<pack<kWireFloat16>, xpu>::Launch(s, in.Size(), halves, in.dptr<DType>());
+    } else {
+      mxnet_op::Kernel<pack<kWireBFloat16>, xpu>::Launch(s, in.Size(), halves, in.dptr<DType>());
+    }
+  });
+}
+
+template<typename xpu>
+void UnpackLaunch(mshadow::Stream<xpu>* s, int type, const TBlob& in, const TBlob& out) {
+  using namespace mxnet::op;
+  const uint16_t* halves = reinterpret_cast<const uint16_t*>(in.dptr<float>());
+  MSHADOW_REAL_TYPE_SWITCH(out.type_flag_, DType, {
+    if (type == kWireFloat16) {
+      mxnet_op::Kernel<unpack<kWireFloat16>, xpu>::Launch(s, out.Size(), out.dptr<DType>(),
+                                                         halves);
+    } else {
+      mxnet_op::Kernel<unpack<kWireBFloat16>, xpu>::Launch(s, out.Size(), out.dptr<DType>(),
+                                                          halves);
+    }
+  });
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_WIRE_FORMAT_INL_H_
@@ -0,0 +1,110 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file wire_format.cc
+ * \brief The dtype of the values sent between the workers and the servers
+ */
+#include <mxnet/engine.h>
+#include "./wire_format-inl.h"
+
+namespace mxnet {
+namespace kvstore {
+
+template<>
+void PackImpl<cpu>(mshadow::Stream<cpu>* s, int type, const TBlob& in, const TBlob& out) {
+  PackLaunch(s, type, in, out);
+}
+
+template<>
+void UnpackImpl<cpu>(mshadow::Stream<cpu>* s, int type, const TBlob& in, const TBlob& out) {
+  UnpackLaunch(s, type, in, out);
+}
+
+void WireFormat::SetType(const std::string& name) {
+  if (name == "float32") {
+    type_ = kWireFloat32;
+  } else if (name == "float16") {
+    type_ = kWireFloat16;
+  } else if (name == "bfloat16") {
+    type_ = kWireBFloat16;
+  } else {
+    LOG(FATAL) << "Unknown kvstore wire dtype " << name
+               << ", expected float32, float16 or bfloat16";
+  }
+}
+
+void WireFormat::Pack(const NDArray& from, NDArray* to, int priority) const {
+  CHECK_EQ(to->shape().Size(), packed_size(from.shape().Size()));
+  CHECK(from.ctx() == to->ctx()) << "The values are packed on their own device";
+  const int type = type_;
+  NDArray in = from, out = *to;
+  switch (from.ctx().dev_mask()) {
+    case cpu::kDevMask: {
+      Engine::Get()->PushSync([in, out, type](RunContext ctx) {
+          PackImpl<cpu>(ctx.get_stream<cpu>(), type, in.data(), out.data());
+        }, from.ctx(), {from.var()}, {to->var()},
+        FnProperty::kNormal, priority, PROFILER_MESSAGE("PackWireDType"));
+      break;
+    }
+#if MXNET_USE_CUDA
+    case gpu::kDevMask: {
+      Engine::Get()->PushSync([in, out, type](RunContext ctx) {
+          PackImpl<gpu>(ctx.get_stream<gpu>(), type, in.data(), out.data());
+          // Wait GPU kernel to complete
+          ctx.get_stream<gpu>()->Wait();
+        }, from.ctx(), {from.var()}, {to->var()},
+        FnProperty::kNormal, priority, PROFILER_MESSAGE("PackWireDType"));
+      break;
+    }
+#endif
+    default: LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+  }
+}
+
+void WireFormat::Unpack(const NDArray& from, NDArray* to, int priority) const {
+  CHECK_EQ(from.shape().Size(), packed_size(to->shape().Size()));
+  CHECK(from.ctx() == to->ctx()) << "The values are unpacked on their own device";
+  const int type = type_;
+  NDArray in = from, out = *to;
+  switch (from.ctx().dev_mask()) {
+    case cpu::kDevMask: {
+      Engine::Get()->PushSync([in, out, type](RunContext ctx) {
+          UnpackImpl<cpu>(ctx.get_stream<cpu>(), type, in.data(), out.data());
+        }, from.ctx(), {from.var()}, {to->var()},
+        FnProperty::kNormal, priority, PROFILER_MESSAGE("UnpackWireDType"));
+      break;
+    }
+#if MXNET_USE_CUDA
+    case gpu::kDevMask: {
+      Engine::Get()->PushSync([in, out, type](RunContext ctx) {
+          UnpackImpl<gpu>(ctx.get_stream<gpu>(), type, in.data(), out.data());
+          // Wait GPU kernel to complete
+          ctx.get_stream<gpu>()->Wait();
+        }, from.ctx(), {from.var()}, {to->var()},
+        FnProperty::kNormal, priority, PROFILER_MESSAGE("UnpackWireDType"));
+      break;
+    }
+#endif
+    default: LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+  }
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
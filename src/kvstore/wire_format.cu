@@ -0,0 +1,40 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file wire_format.cu
+ * \brief The dtype of the values sent between the workers and the servers
+ */
+#include "./wire_format-inl.h"
+
+namespace mxnet {
+namespace kvstore {
+
+template<>
+void PackImpl<gpu>(mshadow::Stream<gpu>* s, int type, const TBlob& in, const TBlob& out) {
+  PackLaunch(s, type, in, out);
+}
+
+template<>
+void UnpackImpl<gpu>(mshadow::Stream<gpu>* s, int type, const TBlob& in, const TBlob& out) {
+  UnpackLaunch(s, type, in, out);
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
@@ -0,0 +1,83 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file wire_format.h
+ * \brief The dtype of the values sent between the workers and the servers
+ */
+#ifndef MXNET_KVSTORE_WIRE_FORMAT_H_
+#define MXNET_KVSTORE_WIRE_FORMAT_H_
+#include <mxnet/ndarray.h>
+#include <string>
+
+namespace mxnet {
+namespace kvstore {
+
+enum WireDType {
+  kWireFloat32, kWireFloat16, kWireBFloat16
+};
+
+/*! \brief pack in into the 16 bit halves of the words of out */
+template<typename xpu>
+void PackImpl(mshadow::Stream<xpu>* s, int type, const TBlob& in, const TBlob& out);
+
+template<typename xpu>
+void UnpackImpl(mshadow::Stream<xpu>* s, int type, const TBlob& in, const TBlob& out);
+
+/*!
+ * \brief Sends the pushed gradients and the pulled weights with 16 bits per
+ *  value, as float16 or as float32 truncated to its upper half like
+ *  bfloat16. Two values are packed into each float32 word of the messages,
+ *  and the servers keep and accumulate the values in float32.
+ */
+class WireFormat {
+ public:
+  /*! \brief parse float32, float16 or bfloat16 */
+  void SetType(const std::string& name);
+
+  void set_type(int type) {
+    type_ = type;
+  }
+
+  int type() const {
+    return type_;
+  }
+
+  bool enabled() const {
+    return type_ != kWireFloat32;
+  }
+
+  /*! \brief the number of float32 words holding size values */
+  static size_t packed_size(size_t size) {
+    return (size + 1) / 2;
+  }
+
+  /*! \brief pack from into to, on the device of from */
+  void Pack(const NDArray& from, NDArray* to, int priority) const;
+
+  /*! \brief unpack from into to, whose size is the number of values */
+  void Unpack(const NDArray& from, NDArray* to, int priority) const;
+
+ private:
+  int type_ = kWireFloat32;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_WIRE_FORMAT_H_
@@ -73,7 +73,65 @@ bool AGNodeEntry::is_none() const {
   return ag_node == nullptr || ag_node->outputs.empty();
 }
 
-AutogradRuntime::AutogradRuntime() {}
+AutogradRuntime::AutogradRuntime()
+    : engine_ref_(Engine::_GetSharedRef()), storage_ref_(Storage::_GetSharedRef()) {}
+
+/*! \brief an array of the shape, type and context of arr, without its memory */
+inline NDArray Placeholder(const NDArray& arr) {
+  if (arr.storage_type() == kDefaultStorage) {
+    return NDArray(arr.shape(), arr.ctx(), true, arr.dtype());
+  }
+  return NDArray(arr.storage_type(), arr.shape(), arr.ctx(), true, arr.dtype());
+}
+
+void AutogradRuntime::GetBackwardDependency(const nnvm::NodePtr& node,
+                                            uint32_t num_inputs, uint32_t num_outputs,
+                                            std::vector<bool>* p_save_inputs,
+                                            std::vector<bool>* p_save_outputs) {
+  static auto& fgradient = nnvm::Op::GetAttr<nnvm::FGradient>("FGradient");
+  std::vector<bool>& save_inputs = *p_save_inputs;
+  std::vector<bool>& save_outputs = *p_save_outputs;
+  if (!fgradient.count(node->op())) {
+    save_inputs.assign(num_inputs, true);
+    save_outputs.assign(num_outputs, true);
+    return;
+  }
+  save_inputs.assign(num_inputs, false);
+  save_outputs.assign(num_outputs, false);
+  // the inputs are entries without node of version 0, the gradients of the
+  // outputs the ones of version 1, so that the gradient nodes show which
+  // of them they read
+  std::vector<NodeEntry> inputs = std::move(node->inputs);
+  node->inputs.clear();
+  for (uint32_t i = 0; i < num_inputs; ++i) {
+    node->inputs.emplace_back(NodeEntry{nullptr, i, 0});
+  }
+  std::vector<NodeEntry> ograds;
+  for (uint32_t i = 0; i < num_outputs; ++i) {
+    ograds.emplace_back(NodeEntry{nullptr, i, 1});
+  }
+  std::vector<const Node*> stack;
+  std::unordered_set<const Node*> visited;
+  auto visit = [&](const NodeEntry& e) {
+    if (e.node == nullptr) {
+      if (e.version == 0) save_inputs[e.index] = true;
+    } else if (e.node == node) {
+      save_outputs[e.index] = true;
+    } else if (visited.insert(e.node.get()).second) {
+      stack.push_back(e.node.get());
+    }
+  };
+  for (const auto& e : fgradient[node->op()](node, ograds)) visit(e);
+  while (!stack.empty()) {
+    const Node* n = stack.back();
+    stack.pop_back();
+    for (const auto& e : n->inputs) visit(e);
+    for (const auto& c : n->control_deps) {
+      if (c != nullptr && c != node && visited.insert(c.get()).second) stack.push_back(c.get());
+    }
+  }
+  node->inputs = std::move(inputs);
+}
 
 void AutogradRuntime::MarkVariables(
     const std::vector<NDArray*>& variables,
@@ -141,15 +199,29 @@ AGNodePtr AutogradRuntime::RecordOp(const nnvm::Op* op,
   AGNodePtr ag_node = AGNode::Create(nn_node);
   ag_node->state = state;
 
+  // the arrays the backward pass does not read are not kept by the graph,
+  // the mutated inputs always are
+  static auto& fmutate_inputs = nnvm::Op::GetAttr<nnvm::FMutateInputs>("FMutateInputs");
+  std::vector<bool> save_inputs, save_outputs;
+  GetBackwardDependency(nn_node, inputs.size(), outputs.size(), &save_inputs, &save_outputs);
+  if (fmutate_inputs.count(op)) {
+    for (uint32_t i : fmutate_inputs[op](attrs)) save_inputs[i] = true;
+  }
+
   for (size_t i = 0; i < inputs.size(); ++i) {
     if (inputs[i].entry_.is_none()) {
       AGNodeEntry e{
         AGNode::Create(
           nnvm::Symbol::CreateVariable(
             "null" + std::to_string(variable_count_++)).outputs[0].node), 0, 0};
-      e.ag_node->outputs.emplace_back(inputs[i]);
+      e.ag_node->outputs.emplace_back(save_inputs[i] ? inputs[i] : Placeholder(inputs[i]));
       e.ag_node->out_grads.emplace_back();
       inputs[i].entry_ = std::move(e);  // assign last to prevent cyclic reference
+    } else if (save_inputs[i]) {
+      // the output of a recorded node that its own gradient does not read
+      NDArray saved = inputs[i];
+      saved.entry_.clear();
+      inputs[i].entry_.ag_node->outputs[inputs[i].entry_.index] = std::move(saved);
     }
     nn_node->inputs.push_back(inputs[i].entry_.nn_entry());
     ag_node->inputs.push_back(inputs[i].entry_);
@@ -164,7 +236,7 @@ AGNodePtr AutogradRuntime::RecordOp(const nnvm::Op* op,
       << "Please call backward first to clear the graph or do this out side of "
       << "a record section. ";
     outputs[i].entry_.clear();
-    ag_node->outputs.push_back(outputs[i]);
+    ag_node->outputs.push_back(save_outputs[i] ? outputs[i] : Placeholder(outputs[i]));
     outputs[i].entry_ = AGNodeEntry{ag_node, i, 0};
   }
 
@@ -238,9 +310,17 @@ void AutogradRuntime::ComputeGradient(const std::vector<NDArray>& outputs,
     auto exec = new exec::GraphExecutor();
     // (TODO) too hack here
     exec->saved_states_ = saved_states;
+    // the backward pass takes its memory from the one of the previous pass of
+    // this thread, the passes of other threads may still be running on theirs
+    exec::GraphExecutor pool_exec;
+    const std::thread::id thread_id = std::this_thread::get_id();
+    {
+      std::lock_guard<std::mutex> lock(backward_pools_mutex_);
+      pool_exec.data_pool_.swap(backward_pools_[thread_id]);
+    }
     exec->Init(sym, args[0].ctx(), ctx_map,
                args, args_grad, grad_reqs,
-               aux_states, nullptr, feed_dict);
+               aux_states, &pool_exec, feed_dict);
 
     std::vector<NDArray> head_grads;
     head_grads.reserve(exec->head_grad_array_.size());
@@ -258,6 +338,11 @@ void AutogradRuntime::ComputeGradient(const std::vector<NDArray>& outputs,
     }
 
     exec->Backward(head_grads, is_train);
+    {
+      // only the memory of this pass is kept, so that the pool stays bounded
+      std::lock_guard<std::mutex> lock(backward_pools_mutex_);
+      backward_pools_[thread_id] = exec->data_pool_;
+    }
     delete exec;
   }
 
@@ -34,6 +34,9 @@
 #include <nnvm/graph.h>
 #include <vector>
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 namespace mxnet {
@@ -132,6 +135,14 @@ class AutogradRuntime {
                      std::vector<NDArray>* p_inputs,
                      std::vector<NDArray>* p_outputs,
                      const OpStatePtr& state);
+  /*!
+   * \brief which inputs and outputs of a node the gradient of its operator
+   *  reads, all of them for the operators without FGradient.
+   */
+  static void GetBackwardDependency(const nnvm::NodePtr& node,
+                                    uint32_t num_inputs, uint32_t num_outputs,
+                                    std::vector<bool>* p_save_inputs,
+                                    std::vector<bool>* p_save_outputs);
   /*! \brief AutogradRuntime singleton. */
   static AutogradRuntime* instance_;
   /*! \brief indicate whether is training. */
@@ -146,6 +157,15 @@ class AutogradRuntime {
   std::atomic<uint64_t> node_count_{0};
   /*! \brief variable count used for naming */
   std::atomic<uint64_t> variable_count_{0};
+  /*!
+   * \brief the memory of the last backward pass of each thread, which the
+   *  next one reuses instead of allocating its own
+   */
+  std::unordered_map<std::thread::id, std::vector<NDArray> > backward_pools_;
+  std::mutex backward_pools_mutex_;
+  /*! \brief the arrays of the pools are released before the engine and the storage */
+  std::shared_ptr<Engine> engine_ref_;
+  std::shared_ptr<Storage> storage_ref_;
 };
 
 }  // namespace autograd
@@ -24,13 +24,32 @@
 #include <dmlc/io.h>
 #include <dmlc/memory_io.h>
 #include <dmlc/logging.h>
+#include <dmlc/parameter.h>
 #include <dmlc/registry.h>
 #include <mxnet/base.h>
 #include <mxnet/ndarray.h>
 #include <mxnet/resource.h>
 #include <mshadow/tensor.h>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
 #include "./ndarray_function.h"
 #include "./autograd.h"
+#include "../operator/half_cpu.h"
+#include "../operator/tensor/cast_storage.h"
+#include "../common/cuda_utils.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #if MXNET_USE_OPENCV
 #include <opencv2/opencv.hpp>
@@ -42,6 +61,155 @@ DMLC_REGISTRY_ENABLE(::mxnet::NDArrayFunctionReg);
 
 namespace mxnet {
 
+NDArray::NDArray(const NDArrayStorageType stype, const TShape &shape, Context ctx,
+                 bool delay_alloc, int dtype, std::vector<int> aux_types,
+                 std::vector<TShape> aux_shapes, TShape storage_shape)
+    : shape_(shape), dtype_(dtype), entry_({nullptr, 0, 0}) {
+  CHECK(stype == kRowSparseStorage || stype == kCSRStorage)
+      << "the sparse constructor is for row_sparse and csr, not " << stype;
+  CHECK_GT(shape.ndim(), 0U) << "a sparse array needs a shape";
+  if (stype == kCSRStorage) {
+    CHECK_EQ(shape.ndim(), 2U) << "csr arrays are 2-D";
+  }
+  const size_t num_aux = stype == kCSRStorage ? 2 : 1;
+  if (aux_types.empty()) aux_types.assign(num_aux, kSparseIndexType);
+  CHECK_EQ(aux_types.size(), num_aux);
+  for (int t : aux_types) {
+    CHECK_EQ(t, kSparseIndexType) << "the indices of the sparse arrays are int32";
+  }
+  if (aux_shapes.empty()) aux_shapes.assign(num_aux, TShape(mshadow::Shape1(0)));
+  CHECK_EQ(aux_shapes.size(), num_aux);
+  if (storage_shape.Size() == 0) {
+    storage_shape = StorageShape(stype, shape, aux_shapes);
+  }
+  ptr_ = std::make_shared<Chunk>(stype, storage_shape, ctx, delay_alloc, dtype,
+                                 aux_types, aux_shapes);
+#if MKL_EXPERIMENTAL == 1
+  Mkl_mem_ = std::make_shared<MKLMemHolder>();
+#endif
+}
+
+TShape NDArray::StorageShape(NDArrayStorageType stype, const TShape &shape,
+                             const std::vector<TShape> &aux_shapes) {
+  if (stype == kRowSparseStorage) {
+    // the stored rows, each as wide as a row of the dense array
+    TShape ret = shape;
+    ret[0] = aux_shapes[rowsparse::kIdx][0];
+    return ret;
+  }
+  CHECK_EQ(stype, kCSRStorage);
+  return mshadow::Shape1(aux_shapes[csr::kIdx][0]);
+}
+
+void NDArray::CheckAndAlloc(const std::vector<TShape> &aux_shapes) const {
+  CHECK(is_sparse()) << "the aux shapes are for the sparse storage";
+  CHECK_EQ(aux_shapes.size(), ptr_->aux_types.size());
+  for (size_t i = 0; i < aux_shapes.size(); ++i) {
+    ptr_->CheckAndAllocAux(i, aux_shapes[i]);
+  }
+  ptr_->CheckAndAllocData(StorageShape(storage_type(), shape_, aux_shapes));
+}
+
+void NDArray::CheckAndAllocData(const TShape &storage_shape) const {
+  CHECK(is_sparse()) << "the storage shape is for the sparse storage";
+  ptr_->CheckAndAllocData(storage_shape);
+}
+
+void NDArray::CheckAndAllocAux(size_t i, const TShape &shape) const {
+  CHECK(is_sparse()) << "the aux arrays are for the sparse storage";
+  ptr_->CheckAndAllocAux(i, shape);
+}
+
+void NDArray::GetSharedMemHandle(int* shared_pid, int* shared_id) const {
+  CHECK_EQ(ctx().dev_type, Context::kCPUShared) << "the array is not on cpu_shared";
+  CHECK_EQ(storage_type(), kDefaultStorage) << "only the dense arrays are shared";
+  CHECK(!ptr_->static_data && byte_offset_ == 0)
+      << "a view or a slice of an array cannot be shared, copy it first";
+  CheckAndAlloc();
+  WaitToRead();
+  Storage::Get()->SharedIncrementRefCount(ptr_->shandle);
+  *shared_pid = ptr_->shandle.shared_pid;
+  *shared_id = ptr_->shandle.shared_id;
+}
+
+/*! \brief copy blob of src to a new dense array, ordered after the writes of src */
+static NDArray CopyBlob(const NDArray &src, const TShape &shape, int dtype,
+                        std::function<TBlob(const NDArray&)> blob) {
+  NDArray ret(shape, src.ctx(), false, dtype);
+  switch (src.ctx().dev_mask()) {
+    case cpu::kDevMask: {
+      Engine::Get()->PushSync([src, ret, blob](RunContext ctx) {
+          TBlob tmp = ret.data();
+          ndarray::Copy<cpu, cpu>(blob(src), &tmp, src.ctx(), ret.ctx(), ctx);
+        }, src.ctx(), {src.var()}, {ret.var()},
+        FnProperty::kNormal, 0, PROFILER_MESSAGE("CopySparseBlob"));
+      break;
+    }
+#if MXNET_USE_CUDA
+    case gpu::kDevMask: {
+      Engine::Get()->PushSync([src, ret, blob](RunContext ctx) {
+          TBlob tmp = ret.data();
+          ndarray::Copy<gpu, gpu>(blob(src), &tmp, src.ctx(), ret.ctx(), ctx);
+          // Wait GPU kernel to complete
+          ctx.get_stream<gpu>()->Wait();
+        }, src.ctx(), {src.var()}, {ret.var()},
+        FnProperty::kNormal, 0, PROFILER_MESSAGE("CopySparseBlob"));
+      break;
+    }
+#endif
+    default: LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+  }
+  return ret;
+}
+
+NDArray NDArray::data_ndarray() const {
+  CHECK(is_sparse()) << "data_ndarray() is for the sparse storage";
+  // the storage shape is only final once the pending writes are done
+  WaitToRead();
+  return CopyBlob(*this, storage_shape(), dtype_,
+                  [](const NDArray& a) { return a.data(); });
+}
+
+NDArray NDArray::aux_ndarray(size_t i) const {
+  CHECK(is_sparse()) << "aux_ndarray() is for the sparse storage";
+  WaitToRead();
+  return CopyBlob(*this, aux_shape(i), aux_type(i),
+                  [i](const NDArray& a) { return a.aux_data(i); });
+}
+
+void NDArray::SyncCopyFromNDArray(const NDArray &src, int i) {
+  CHECK(is_sparse()) << "SyncCopyFromNDArray writes the parts of a sparse array";
+  CHECK_EQ(src.storage_type(), kDefaultStorage) << "the source must be dense";
+  CHECK(src.ctx() == ctx()) << "SyncCopyFromNDArray does not copy across devices";
+  if (i < 0) {
+    CHECK_EQ(src.dtype(), dtype_) << "the values must have the array's dtype";
+  } else {
+    CHECK_EQ(src.dtype(), aux_type(i)) << "the aux array must have the aux dtype";
+  }
+  NDArray dst = *this;
+  auto copy = [src, dst, i](RunContext ctx) {
+    if (i < 0) {
+      dst.CheckAndAllocData(src.shape());
+    } else {
+      dst.CheckAndAllocAux(i, src.shape());
+    }
+    TBlob tmp = i < 0 ? dst.data() : dst.aux_data(i);
+    if (src.ctx().dev_mask() == cpu::kDevMask) {
+      ndarray::Copy<cpu, cpu>(src.data(), &tmp, src.ctx(), dst.ctx(), ctx);
+    } else {
+#if MXNET_USE_CUDA
+      ndarray::Copy<gpu, gpu>(src.data(), &tmp, src.ctx(), dst.ctx(), ctx);
+      ctx.get_stream<gpu>()->Wait();
+#else
+      LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
+#endif
+    }
+  };
+  Engine::Get()->PushSync(copy, ctx(), {src.var()}, {var()},
+                          FnProperty::kNormal, 0, PROFILER_MESSAGE("SyncCopyFromNDArray"));
+  WaitToRead();
+}
+
 NDArray NDArray::grad() const {
   if (this->entry_.ag_node && this->entry_.ag_node->out_grads.size()) {
     CHECK_EQ(this->entry_.ag_node->out_grads.size(), 1);
@@ -50,8 +218,24 @@ NDArray NDArray::grad() const {
   return NDArray();
 }
 
+NDArray NDArray::MemoryView(size_t byte_offset, const TShape &shape, int dtype) const {
+  CHECK(!is_none()) << "NDArray.MemoryView: the NDArray is empty";
+  CHECK_EQ(storage_type(), kDefaultStorage)
+      << "NDArray.MemoryView is not supported for the sparse storage";
+  const size_t size = shape.Size() * mshadow::mshadow_sizeof(dtype);
+  CHECK_LE(byte_offset_ + byte_offset + size, ptr_->shandle.size)
+      << "NDArray.MemoryView: the view exceeds the memory of the NDArray";
+  NDArray ret;
+  ret.ptr_ = std::make_shared<Chunk>(ptr_, byte_offset_ + byte_offset, size);
+  ret.shape_ = shape;
+  ret.dtype_ = dtype;
+  return ret;
+}
+
 NDArray NDArray::Reshape(const TShape &shape) const {
   using namespace autograd;
+  CHECK_EQ(storage_type(), kDefaultStorage)
+      << "NDArray.Reshape is not supported for the sparse storage";
   if (AutogradRuntime::Get()->IsTraining()) {
     CHECK_GE(shape_.Size(), shape.Size())
       << "NDArray.Reshape: target shape must have must have the same size as "
@@ -87,13 +271,20 @@ NDArray NDArray::Slice(index_t begin, index_t end) const {
   using namespace autograd;
   NDArray ret = *this;
   CHECK(!is_none()) << "NDArray is not initialized";
+  CHECK_EQ(storage_type(), kDefaultStorage)
+      << "NDArray.Slice is not supported for the sparse storage";
   CHECK_LT(begin, end) << "Invalid slicing range [" << begin << ", " << end << ")";
   CHECK_GE(shape_[0], end) << "Slice end index out of range";
   size_t length = shape_.ProdShape(1, shape_.ndim());
+  size_t slice_bytes = 0;
   MSHADOW_TYPE_SWITCH(ret.dtype(), DType, {
     ret.byte_offset_ += begin * length * sizeof(DType);
+    slice_bytes = (end - begin) * length * sizeof(DType);
   });
   ret.shape_[0] = end - begin;
+  const bool whole = ret.byte_offset_ == 0 && slice_bytes >= ptr_->shandle.size;
+  ret.slice_var_ = whole ? nullptr
+                         : GetSliceVar(ret.byte_offset_, ret.byte_offset_ + slice_bytes);
   if (AutogradRuntime::Get()->IsTraining()) {
     // fake a slice_axis op
     ret.entry_.clear();
@@ -116,6 +307,44 @@ NDArray NDArray::Slice(index_t begin, index_t end) const {
 }
 
 
+std::shared_ptr<NDArray::SliceVar> NDArray::GetSliceVar(size_t begin, size_t end) const {
+  // bounds the scan of the live slices, the slices beyond use the chunk's variable
+  const size_t kMaxSliceVars = 64;
+  std::lock_guard<std::mutex> lock(ptr_->slice_mutex);
+  auto& vars = ptr_->slice_vars;
+  std::shared_ptr<SliceVar> same;
+  for (size_t i = 0; i < vars.size();) {
+    std::shared_ptr<SliceVar> v = vars[i].lock();
+    if (v == nullptr) {
+      vars[i] = vars.back();
+      vars.pop_back();
+      continue;
+    }
+    if (v->begin == begin && v->end == end) {
+      same = v;
+    } else if (v->begin < end && begin < v->end) {
+      // a slice of this slice is ordered with it, other overlaps with everything
+      if (slice_var_ && slice_var_->begin <= begin && end <= slice_var_->end) {
+        return slice_var_;
+      }
+      return nullptr;
+    }
+    ++i;
+  }
+  if (same != nullptr) return same;
+  if (vars.size() >= kMaxSliceVars) return nullptr;
+  Engine::VarHandle var = Engine::Get()->NewViewVariable(ptr_->var);
+  if (var == ptr_->var) return nullptr;
+  std::shared_ptr<SliceVar> ret = std::make_shared<SliceVar>();
+  ret->chunk = ptr_;
+  ret->begin = begin;
+  ret->end = end;
+  ret->var = var;
+  vars.push_back(ret);
+  return ret;
+}
+
+
 NDArray NDArray::At(index_t idx) const {
   NDArray ret = this->Slice(idx, idx+1);
   if (shape_.ndim() > 1) {
@@ -340,6 +569,114 @@ void ScalarOp(const NDArray &lhs,
   }
 }
 
+/*!
+ * \brief copy the values of from into to, with the aux arrays of the sparse
+ *  arrays. The memory of a sparse to is reused when it is large enough.
+ */
+template<typename from_xpu, typename to_xpu>
+void CopyFromToImpl(const NDArray &from, const NDArray &to, RunContext ctx) {
+  if (from.storage_type() != kDefaultStorage) {
+    to.CheckAndAlloc(from.aux_shapes());
+    for (size_t i = 0; i < from.aux_shapes().size(); ++i) {
+      TBlob tmp = to.aux_data(i);
+      ndarray::Copy<from_xpu, to_xpu>(from.aux_data(i), &tmp,
+                                      from.ctx(), to.ctx(), ctx);
+    }
+  }
+  TBlob tmp = to.data();
+  ndarray::Copy<from_xpu, to_xpu>(from.data(), &tmp,
+                                  from.ctx(), to.ctx(), ctx);
+}
+
+/*!
+ * \brief copy between storage types, the cast runs on the cpu and the
+ *  arrays on other devices are copied there and back
+ */
+void CastFromTo(const NDArray &from, NDArray *to, int priority) {
+  NDArray src = from, dst = *to;
+  if (from.ctx().dev_mask() != cpu::kDevMask) {
+    src = from.Copy(Context::CPU());
+  }
+  if (to->ctx().dev_mask() != cpu::kDevMask) {
+    dst = to->is_sparse() ?
+        NDArray(to->storage_type(), to->shape(), Context::CPU(), true, to->dtype()) :
+        NDArray(to->shape(), Context::CPU(), true, to->dtype());
+  }
+  std::vector<Engine::VarHandle> const_vars;
+  if (src.var() != dst.var()) const_vars.push_back(src.var());
+  Engine::Get()->PushSync([src, dst](RunContext ctx) {
+      op::CastStorageDispatch<cpu>(ctx.get_stream<cpu>(), src, dst);
+    }, Context::CPU(), const_vars, {dst.var()},
+    FnProperty::kNormal, priority, PROFILER_MESSAGE("CastStorage"));
+  if (dst.var() != to->var()) CopyFromTo(dst, to, priority);
+}
+
+#if MXNET_USE_CUDA
+/*!
+ * \brief completes the copies between GPUs once their CUDA events fire, in a
+ *  thread of each source device, so that the copy worker issues the next copy
+ *  instead of synchronizing with its stream
+ */
+class CopyCompleter {
+ public:
+  static CopyCompleter* Get(int dev_id) {
+    static std::mutex mu;
+    static std::map<int, CopyCompleter*> insts;
+    std::lock_guard<std::mutex> lk(mu);
+    CopyCompleter*& inst = insts[dev_id];
+    if (inst == nullptr) inst = new CopyCompleter();
+    return inst;
+  }
+
+  /*! \brief calls on_complete once the work queued so far on the stream of ctx is done */
+  void CompleteAfter(RunContext ctx, const Engine::CallbackOnComplete& on_complete) {
+    cudaEvent_t event;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      if (events_.empty()) {
+        CUDA_CALL(cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+      } else {
+        event = events_.back();
+        events_.pop_back();
+      }
+    }
+    CUDA_CALL(cudaEventRecord(event, mshadow::Stream<gpu>::GetStream(ctx.get_stream<gpu>())));
+    std::lock_guard<std::mutex> lk(mu_);
+    jobs_.emplace_back(event, on_complete);
+    cv_.notify_one();
+  }
+
+ private:
+  CopyCompleter() {
+    std::thread([this]() { Run(); }).detach();
+  }
+
+  void Run() {
+    while (true) {
+      std::pair<cudaEvent_t, Engine::CallbackOnComplete> job;
+      {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [this]() { return !jobs_.empty(); });
+        job = jobs_.front();
+        jobs_.pop_front();
+      }
+      CUDA_CALL(cudaEventSynchronize(job.first));
+      {
+        std::lock_guard<std::mutex> lk(mu_);
+        events_.push_back(job.first);
+      }
+      job.second();
+    }
+  }
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<std::pair<cudaEvent_t, Engine::CallbackOnComplete> > jobs_;
+  /*! \brief the events of the completed copies, reused by the next ones */
+  std::vector<cudaEvent_t> events_;
+};
+#endif
+
 void CopyFromTo(const NDArray &from, NDArray *to, int priority) {
   if (from.var() == to->var()) {
     // skip to copy to itself
@@ -350,6 +687,10 @@ void CopyFromTo(const NDArray &from, NDArray *to, int priority) {
       << "from.shape = " << from.shape() << " to.shape=" << to->shape();
   CHECK(from.shape().ndim() != 0)
       << "source operands have zero dimension shape";
+  if (from.storage_type() != to->storage_type()) {
+    CastFromTo(from, to, priority);
+    return;
+  }
   // important: callback must always capture by value
   NDArray ret = *to;
   int a = from.ctx().dev_mask();
@@ -360,36 +701,37 @@ void CopyFromTo(const NDArray &from, NDArray *to, int priority) {
 
   if (a == cpu::kDevMask && b == cpu::kDevMask) {
     Engine::Get()->PushSync([from, ret](RunContext ctx) {
-        TBlob tmp = ret.data();
-        ndarray::Copy<cpu, cpu>(from.data(), &tmp,
-                                from.ctx(), ret.ctx(), ctx);
+        CopyFromToImpl<cpu, cpu>(from, ret, ctx);
       }, from.ctx(), const_vars, {ret.var()},
       FnProperty::kNormal, priority, PROFILER_MESSAGE("CopyCPU2CPU"));
   } else {
 #if MXNET_USE_CUDA
+    static const bool async_complete = dmlc::GetEnv("MXNET_GPU_COPY_ASYNC_COMPLETE", true);
     if (a == cpu::kDevMask && b == gpu::kDevMask) {
       Engine::Get()->PushSync([from, ret](RunContext ctx) {
-          TBlob tmp = ret.data();
-          ndarray::Copy<cpu, gpu>(from.data(), &tmp,
-                                  from.ctx(), ret.ctx(), ctx);
+          CopyFromToImpl<cpu, gpu>(from, ret, ctx);
           // Wait GPU kernel to complete
           ctx.get_stream<gpu>()->Wait();
         }, ret.ctx(), const_vars, {ret.var()},
         FnProperty::kCopyToGPU, priority, PROFILER_MESSAGE("CopyCPU2GPU"));
     } else if (a == gpu::kDevMask && b == cpu::kDevMask) {
       Engine::Get()->PushSync([from, ret](RunContext ctx) {
-          TBlob tmp = ret.data();
-          ndarray::Copy<gpu, cpu>(from.data(), &tmp,
-                                  from.ctx(), ret.ctx(), ctx);
+          CopyFromToImpl<gpu, cpu>(from, ret, ctx);
           // Wait GPU kernel to complete
           ctx.get_stream<gpu>()->Wait();
         }, from.ctx(), const_vars, {ret.var()},
         FnProperty::kCopyFromGPU, priority, PROFILER_MESSAGE("CopyGPU2CPU"));
+    } else if (a == gpu::kDevMask && b == gpu::kDevMask && from.dtype() == ret.dtype() &&
+               from.storage_type() == kDefaultStorage && ret.storage_type() == kDefaultStorage &&
+               async_complete) {
+      Engine::Get()->PushAsync([from, ret](RunContext ctx, Engine::CallbackOnComplete on_complete) {
+          CopyFromToImpl<gpu, gpu>(from, ret, ctx);
+          CopyCompleter::Get(ctx.ctx.dev_id)->CompleteAfter(ctx, on_complete);
+        }, from.ctx(), const_vars, {ret.var()}, FnProperty::kCopyFromGPU,
+        priority, PROFILER_MESSAGE("CopyGPU2GPU"));
     } else if (a == gpu::kDevMask && b == gpu::kDevMask) {
       Engine::Get()->PushSync([from, ret](RunContext ctx) {
-          TBlob tmp = ret.data();
-          ndarray::Copy<gpu, gpu>(from.data(), &tmp,
-                                  from.ctx(), ret.ctx(), ctx);
+          CopyFromToImpl<gpu, gpu>(from, ret, ctx);
           // Wait GPU kernel to complete
           ctx.get_stream<gpu>()->Wait();
         }, from.ctx(), const_vars, {ret.var()},
@@ -664,35 +1006,219 @@ NDArray &NDArray::operator/=(const real_t &src) {
 
 /* magic number for ndarray version 1, with int64_t TShape */
 static const uint32_t NDARRAY_V1_MAGIC = 0xF993fac8;
+/* magic number for ndarray version 2, with the storage type */
+static const uint32_t NDARRAY_V2_MAGIC = 0xF993fac9;
+/* magic number for the float32 dense arrays saved in fp16 or int8 */
+static const uint32_t NDARRAY_ENCODED_MAGIC = 0xF993faca;
+/* the number of values encoded at a time */
+static const size_t kEncodeChunk = 1 << 16;
 
-void NDArray::Save(dmlc::Stream *strm) const {
+/*!
+ * \brief save a sparse array: its storage type, the shapes and types of its
+ *  values and aux arrays, then the values and the aux arrays
+ */
+void SaveSparse(const NDArray &arr, const Context &ctx, dmlc::Stream *strm) {
+  NDArray temp = arr;
+  if (arr.ctx().dev_mask() != cpu::kDevMask) {
+    temp = arr.Copy(Context::CPU());
+  }
+  temp.WaitToRead();
+  strm->Write(NDARRAY_V2_MAGIC);
+  int32_t stype = temp.storage_type();
+  strm->Write(&stype, sizeof(stype));
+  temp.storage_shape().Save(strm);
+  temp.shape().Save(strm);
+  ctx.Save(strm);
+  int32_t type_flag = temp.dtype();
+  strm->Write(&type_flag, sizeof(type_flag));
+  const int32_t num_aux = temp.aux_types().size();
+  strm->Write(&num_aux, sizeof(num_aux));
+  for (int32_t i = 0; i < num_aux; ++i) {
+    int32_t aux_type = temp.aux_type(i);
+    strm->Write(&aux_type, sizeof(aux_type));
+    temp.aux_shape(i).Save(strm);
+  }
+  const TBlob data = temp.data();
+  strm->Write(data.dptr_, mshadow::mshadow_sizeof(type_flag) * data.Size());
+  for (int32_t i = 0; i < num_aux; ++i) {
+    const TBlob aux = temp.aux_data(i);
+    strm->Write(aux.dptr_, mshadow::mshadow_sizeof(aux.type_flag_) * aux.Size());
+  }
+}
+
+bool LoadSparse(NDArray *arr, dmlc::Stream *strm) {
+  int32_t stype;
+  if (strm->Read(&stype, sizeof(stype)) != sizeof(stype)) return false;
+  TShape storage_shape, shape;
+  if (!storage_shape.Load(strm)) return false;
+  if (!shape.Load(strm)) return false;
+  Context ctx;
+  if (!ctx.Load(strm)) return false;
+  int32_t type_flag;
+  if (strm->Read(&type_flag, sizeof(type_flag)) != sizeof(type_flag)) return false;
+  int32_t num_aux;
+  if (strm->Read(&num_aux, sizeof(num_aux)) != sizeof(num_aux)) return false;
+  std::vector<int> aux_types(num_aux);
+  std::vector<TShape> aux_shapes(num_aux);
+  for (int32_t i = 0; i < num_aux; ++i) {
+    int32_t aux_type;
+    if (strm->Read(&aux_type, sizeof(aux_type)) != sizeof(aux_type)) return false;
+    aux_types[i] = aux_type;
+    if (!aux_shapes[i].Load(strm)) return false;
+  }
+  NDArray temp(static_cast<NDArrayStorageType>(stype), shape, Context::CPU(), false,
+               type_flag, aux_types, aux_shapes, storage_shape);
+  const TBlob data = temp.data();
+  size_t nread = mshadow::mshadow_sizeof(type_flag) * data.Size();
+  if (strm->Read(data.dptr_, nread) != nread) return false;
+  for (int32_t i = 0; i < num_aux; ++i) {
+    const TBlob aux = temp.aux_data(i);
+    nread = mshadow::mshadow_sizeof(aux.type_flag_) * aux.Size();
+    if (strm->Read(aux.dptr_, nread) != nread) return false;
+  }
+#if MXNET_USE_CUDA
+  if (ctx.dev_mask() != cpu::kDevMask) {
+    *arr = temp.Copy(ctx); return true;
+  }
+#endif
+  *arr = std::move(temp);
+  return true;
+}
+
+/*!
+ * \brief save the float32 dense array arr in fp16, or in int8 scaled by the
+ *  largest magnitude of arr over 127
+ */
+void SaveEncoded(const NDArray &arr, const Context &ctx, int encoding, dmlc::Stream *strm) {
+  NDArray temp = arr;
+  if (arr.ctx().dev_mask() != cpu::kDevMask) {
+    temp = arr.Copy(Context::CPU());
+  }
+  temp.WaitToRead();
+  strm->Write(NDARRAY_ENCODED_MAGIC);
+  arr.shape().Save(strm);
+  ctx.Save(strm);
+  int32_t type_flag = mshadow::kFloat32;
+  strm->Write(&type_flag, sizeof(type_flag));
+  int32_t enc = encoding;
+  strm->Write(&enc, sizeof(enc));
+  const float* src = temp.data().dptr<float>();
+  const size_t size = arr.shape().Size();
+  if (encoding == kSaveFloat16) {
+    std::vector<mshadow::half::half_t> buf(std::min(size, kEncodeChunk));
+    for (size_t i = 0; i < size; i += kEncodeChunk) {
+      const size_t n = std::min(kEncodeChunk, size - i);
+      op::half_cpu::FloatToHalf(src + i, buf.data(), n);
+      strm->Write(buf.data(), n * sizeof(mshadow::half::half_t));
+    }
+    return;
+  }
+  CHECK_EQ(encoding, kSaveInt8) << "Unknown encoding " << encoding;
+  float amax = 0.0f;
+  for (size_t i = 0; i < size; ++i) {
+    const float a = std::fabs(src[i]);
+    amax = a > amax ? a : amax;
+  }
+  const float scale = amax / 127.0f;
+  const float inv_scale = amax > 0.0f ? 127.0f / amax : 0.0f;
+  strm->Write(&scale, sizeof(scale));
+  std::vector<int8_t> buf(std::min(size, kEncodeChunk));
+  for (size_t i = 0; i < size; i += kEncodeChunk) {
+    const size_t n = std::min(kEncodeChunk, size - i);
+    for (size_t j = 0; j < n; ++j) {
+      buf[j] = static_cast<int8_t>(std::round(src[i + j] * inv_scale));
+    }
+    strm->Write(buf.data(), n);
+  }
+}
+
+/*! \brief load an array of SaveEncoded as float32, after its magic number */
+bool LoadEncoded(NDArray *arr, dmlc::Stream *strm) {
+  TShape shape;
+  if (!shape.Load(strm)) return false;
+  Context ctx;
+  if (!ctx.Load(strm)) return false;
+  int32_t type_flag, encoding;
+  if (strm->Read(&type_flag, sizeof(type_flag)) != sizeof(type_flag)) return false;
+  if (strm->Read(&encoding, sizeof(encoding)) != sizeof(encoding)) return false;
+  if (type_flag != mshadow::kFloat32) return false;
+  NDArray temp(shape, Context::CPU(), false, type_flag);
+  float* dst = temp.data().dptr<float>();
+  const size_t size = shape.Size();
+  if (encoding == kSaveFloat16) {
+    std::vector<mshadow::half::half_t> buf(std::min(size, kEncodeChunk));
+    for (size_t i = 0; i < size; i += kEncodeChunk) {
+      const size_t n = std::min(kEncodeChunk, size - i);
+      const size_t nread = n * sizeof(mshadow::half::half_t);
+      if (strm->Read(buf.data(), nread) != nread) return false;
+      op::half_cpu::HalfToFloat(buf.data(), dst + i, n);
+    }
+  } else if (encoding == kSaveInt8) {
+    float scale;
+    if (strm->Read(&scale, sizeof(scale)) != sizeof(scale)) return false;
+    std::vector<int8_t> buf(std::min(size, kEncodeChunk));
+    for (size_t i = 0; i < size; i += kEncodeChunk) {
+      const size_t n = std::min(kEncodeChunk, size - i);
+      if (strm->Read(buf.data(), n) != n) return false;
+      for (size_t j = 0; j < n; ++j) dst[i + j] = buf[j] * scale;
+    }
+  } else {
+    return false;
+  }
+#if MXNET_USE_CUDA
+  if (ctx.dev_mask() != cpu::kDevMask) {
+    *arr = temp.Copy(ctx); return true;
+  }
+#endif
+  *arr = std::move(temp);
+  return true;
+}
+
+/*!
+ * \brief save arr, whose copy is saved for the context ctx. The encoding
+ *  applies to float32 dense arrays, int8 only to the ones of 2 dimensions
+ *  or more: the biases and the normalization parameters keep their values.
+ */
+void SaveArray(const NDArray &arr, const Context &ctx, dmlc::Stream *strm,
+               int encoding = kSaveRaw) {
+  if (arr.is_sparse()) {
+    SaveSparse(arr, ctx, strm);
+    return;
+  }
+  if (encoding != kSaveRaw && !arr.is_none() && arr.dtype() == mshadow::kFloat32 &&
+      (encoding == kSaveFloat16 || arr.shape().ndim() >= 2)) {
+    SaveEncoded(arr, ctx, encoding, strm);
+    return;
+  }
+  // dense arrays keep the format of version 1
   strm->Write(NDARRAY_V1_MAGIC);
-  shape_.Save(strm);
-  if (is_none()) return;
+  arr.shape().Save(strm);
+  if (arr.is_none()) return;
   // save context
-  Context ctx = this->ctx();
   ctx.Save(strm);
   TBlob save_data;
   NDArray temp;
-  if (ctx.dev_mask() != cpu::kDevMask) {
-    temp = this->Copy(Context::CPU());
+  if (arr.ctx().dev_mask() != cpu::kDevMask) {
+    temp = arr.Copy(Context::CPU());
     temp.WaitToRead();
     save_data = temp.data();
   } else {
-    this->WaitToRead();
-    save_data = this->data();
+    arr.WaitToRead();
+    save_data = arr.data();
   }
   // save type flag
   int32_t type_flag = save_data.type_flag_;
   strm->Write(&type_flag, sizeof(type_flag));
   CHECK(save_data.CheckContiguous());
   size_t type_size = mshadow::mshadow_sizeof(type_flag);
-  strm->Write(save_data.dptr_, type_size * shape_.Size());
+  strm->Write(save_data.dptr_, type_size * arr.shape().Size());
 }
 
-bool LegacyTShapeLoad(dmlc::Stream *strm, TShape *shape) {
-  uint32_t magic;
-  if (strm->Read(&magic, sizeof(uint32_t)) != sizeof(uint32_t)) return false;
+void NDArray::Save(dmlc::Stream *strm) const {
+  SaveArray(*this, this->ctx(), strm);
+}
+
+bool LegacyTShapeLoad(uint32_t magic, dmlc::Stream *strm, TShape *shape) {
   switch (magic) {
     case NDARRAY_V1_MAGIC:
       return shape->Load(strm);
@@ -711,7 +1237,11 @@ bool LegacyTShapeLoad(dmlc::Stream *strm, TShape *shape) {
 bool NDArray::Load(dmlc::Stream *strm) {
   // load shape
   TShape shape;
-  if (!LegacyTShapeLoad(strm, &shape)) return false;
+  uint32_t magic;
+  if (strm->Read(&magic, sizeof(uint32_t)) != sizeof(uint32_t)) return false;
+  if (magic == NDARRAY_V2_MAGIC) return LoadSparse(this, strm);
+  if (magic == NDARRAY_ENCODED_MAGIC) return LoadEncoded(this, strm);
+  if (!LegacyTShapeLoad(magic, strm, &shape)) return false;
   if (shape.ndim() == 0) {
     *this = NDArray(); return true;
   }
@@ -744,11 +1274,17 @@ const uint64_t kMXAPINDArrayListMagic = 0x112;
 
 void NDArray::Save(dmlc::Stream* fo,
                    const std::vector<NDArray>& data,
-                   const std::vector<std::string>& names) {
+                   const std::vector<std::string>& names,
+                   int encoding) {
   uint64_t header = kMXAPINDArrayListMagic, reserved = 0;
   fo->Write(&header, sizeof(header));
   fo->Write(&reserved, sizeof(reserved));
-  fo->Write(data);
+  // the layout of fo->Write(data)
+  uint64_t size = data.size();
+  fo->Write(&size, sizeof(size));
+  for (const NDArray& arr : data) {
+    SaveArray(arr, arr.is_none() ? Context() : arr.ctx(), fo, encoding);
+  }
   fo->Write(names);
 }
 
@@ -770,13 +1306,234 @@ void NDArray::Load(dmlc::Stream* fi,
       << "Invalid NDArray file format";
 }
 
+/*!
+ * \brief writes the snapshots SaveAsync takes to their files on a thread of
+ *  its own, in the order of the saves. Each save is an operation of the
+ *  engine that mutates var_, which completes once its file is written.
+ */
+class AsyncSaver {
+ public:
+  static AsyncSaver* Get() {
+    static AsyncSaver* inst = new AsyncSaver();
+    return inst;
+  }
+
+  void Save(const std::string& fname, const std::vector<NDArray>& data,
+            const std::vector<std::string>& names, int encoding) {
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->fname = fname;
+    job->names = names;
+    job->encoding = encoding;
+    for (const NDArray& arr : data) {
+      job->ctxs.push_back(arr.is_none() ? Context() : arr.ctx());
+      if (arr.is_none()) {
+        job->arrays.push_back(arr);
+        continue;
+      }
+      // the copy is ordered by the engine between the writes of arr, so
+      // that training goes on while it is written
+#if MXNET_USE_CUDA
+      const Context host = arr.ctx().dev_mask() == gpu::kDevMask && !arr.is_sparse() ?
+                           Context::CPUPinned(arr.ctx().dev_id) : Context::CPU();
+#else
+      const Context host = Context::CPU();
+#endif
+      job->arrays.push_back(arr.Copy(host));
+    }
+    // the naive engine completes every operation before the push returns
+    static const bool naive = dmlc::GetEnv("MXNET_ENGINE_TYPE", std::string()) == "NaiveEngine";
+    Engine::Get()->PushAsync([this, job](RunContext ctx, Engine::CallbackOnComplete on_complete) {
+        if (naive) {
+          Write(job.get());
+          on_complete();
+          return;
+        }
+        job->on_complete = on_complete;
+        std::lock_guard<std::mutex> lk(mu_);
+        jobs_.push_back(job);
+        cv_.notify_one();
+      }, Context::CPU(), {}, {var_}, FnProperty::kAsync, 0, PROFILER_MESSAGE("SaveAsync"));
+  }
+
+  /*! \brief waits for the saves, and fails with the first error of a save */
+  void Wait() {
+    Engine::Get()->WaitForVar(var_);
+    std::lock_guard<std::mutex> lk(mu_);
+    if (!error_.empty()) {
+      std::string error;
+      error.swap(error_);
+      LOG(FATAL) << error;
+    }
+  }
+
+ private:
+  struct Job {
+    std::string fname;
+    std::vector<NDArray> arrays;
+    std::vector<Context> ctxs;
+    std::vector<std::string> names;
+    int encoding;
+    Engine::CallbackOnComplete on_complete;
+  };
+
+  AsyncSaver() : var_(Engine::Get()->NewVariable()) {
+    std::thread([this]() { Run(); }).detach();
+  }
+
+  void Run() {
+    while (true) {
+      std::shared_ptr<Job> job;
+      {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [this]() { return !jobs_.empty(); });
+        job = jobs_.front();
+        jobs_.pop_front();
+      }
+      Write(job.get());
+      // the snapshots are freed before the save completes
+      Engine::CallbackOnComplete on_complete = job->on_complete;
+      job.reset();
+      on_complete();
+    }
+  }
+
+  /*! \brief the format of NDArray::Save, each snapshot is written once its copy is done */
+  void Write(Job* job) {
+    try {
+      std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(job->fname.c_str(), "w"));
+      uint64_t header = kMXAPINDArrayListMagic, reserved = 0;
+      uint64_t size = job->arrays.size();
+      fo->Write(&header, sizeof(header));
+      fo->Write(&reserved, sizeof(reserved));
+      fo->Write(&size, sizeof(size));
+      for (size_t i = 0; i < job->arrays.size(); ++i) {
+        SaveArray(job->arrays[i], job->ctxs[i], fo.get(), job->encoding);
+      }
+      fo->Write(job->names);
+    } catch (const dmlc::Error& e) {
+      std::lock_guard<std::mutex> lk(mu_);
+      if (error_.empty()) error_ = std::string("Cannot save ") + job->fname + ": " + e.what();
+    }
+  }
+
+  Engine::VarHandle var_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<std::shared_ptr<Job> > jobs_;
+  std::string error_;
+};
+
+void NDArray::SaveAsync(const std::string& fname,
+                        const std::vector<NDArray>& data,
+                        const std::vector<std::string>& names,
+                        int encoding) {
+  AsyncSaver::Get()->Save(fname, data, names, encoding);
+}
+
+void NDArray::WaitSaves() {
+  AsyncSaver::Get()->Wait();
+}
+
+#ifndef _WIN32
+/*! \brief a private mapping of a file, unmapped with the last array it backs */
+struct MappedFile {
+  void* addr;
+  size_t size;
+  ~MappedFile() { munmap(addr, size); }
+};
+
+/*!
+ * \brief NDArray::Load from the stream over the mapping of a file, with
+ *  the values of cpu dense arrays read in place when they are aligned
+ */
+bool LoadMappedArray(NDArray *arr, dmlc::MemoryFixedSizeStream *strm,
+                     const std::shared_ptr<MappedFile>& file) {
+  TShape shape;
+  uint32_t magic;
+  if (strm->Read(&magic, sizeof(uint32_t)) != sizeof(uint32_t)) return false;
+  if (magic == NDARRAY_V2_MAGIC) return LoadSparse(arr, strm);
+  if (magic == NDARRAY_ENCODED_MAGIC) return LoadEncoded(arr, strm);
+  if (!LegacyTShapeLoad(magic, strm, &shape)) return false;
+  if (shape.ndim() == 0) {
+    *arr = NDArray(); return true;
+  }
+  Context ctx;
+  if (!ctx.Load(strm)) return false;
+  int32_t type_flag;
+  if (strm->Read(&type_flag, sizeof(type_flag)) != sizeof(type_flag)) return false;
+  const size_t type_size = mshadow::mshadow_sizeof(type_flag);
+  const size_t nread = type_size * shape.Size();
+  const size_t offset = strm->Tell();
+  if (offset + nread > file->size) return false;
+  char* dptr = static_cast<char*>(file->addr) + offset;
+#if MXNET_USE_CUDA
+  const bool on_cpu = ctx.dev_mask() == cpu::kDevMask;
+#else
+  const bool on_cpu = true;
+#endif
+  if (on_cpu && reinterpret_cast<uintptr_t>(dptr) % type_size == 0) {
+    *arr = NDArray(TBlob(dptr, shape, cpu::kDevMask, type_flag), 0, file);
+    strm->Seek(offset + nread);
+    return true;
+  }
+  NDArray temp(shape, Context::CPU(), false, type_flag);
+  if (strm->Read(temp.data().dptr_, nread) != nread) return false;
+  *arr = on_cpu ? std::move(temp) : temp.Copy(ctx);
+  return true;
+}
+#endif  // _WIN32
+
+void NDArray::LoadMapped(const std::string& fname,
+                         std::vector<NDArray>* data,
+                         std::vector<std::string>* keys) {
+#ifndef _WIN32
+  int fd = open(fname.c_str(), O_RDONLY);
+  CHECK_GE(fd, 0) << "Cannot open " << fname << ", mapped loads need a local file";
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0);
+  auto file = std::make_shared<MappedFile>();
+  file->size = st.st_size;
+  CHECK_GE(file->size, 2 * sizeof(uint64_t)) << "Invalid NDArray file format";
+  // pages that are written are copied, the others stay shared with the page cache
+  file->addr = mmap(nullptr, file->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  CHECK(file->addr != MAP_FAILED) << "Cannot map " << fname;
+  dmlc::MemoryFixedSizeStream fi(file->addr, file->size);
+  uint64_t header, reserved, size;
+  CHECK(fi.Read(&header))
+      << "Invalid NDArray file format";
+  CHECK(fi.Read(&reserved))
+      << "Invalid NDArray file format";
+  CHECK(header == kMXAPINDArrayListMagic)
+      << "Invalid NDArray file format";
+  CHECK(fi.Read(&size))
+      << "Invalid NDArray file format";
+  data->resize(size);
+  for (uint64_t i = 0; i < size; ++i) {
+    CHECK(LoadMappedArray(&(*data)[i], &fi, file))
+        << "Invalid NDArray file format";
+  }
+  CHECK(fi.Read(keys))
+      << "Invalid NDArray file format";
+  CHECK(keys->size() == 0 || keys->size() == data->size())
+      << "Invalid NDArray file format";
+#else
+  std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(fname.c_str(), "r"));
+  Load(fi.get(), data, keys);
+#endif  // _WIN32
+}
+
 NDArray NDArray::Copy(Context ctx) const {
-  NDArray ret(shape(), ctx, true, dtype_);
+  NDArray ret = is_sparse() ?
+      NDArray(storage_type(), shape(), ctx, true, dtype_) :
+      NDArray(shape(), ctx, true, dtype_);
   CopyFromTo(*this, &ret);
   return ret;
 }
 
 void NDArray::SyncCopyFromCPU(const void *data, size_t size) const {
+  CHECK_EQ(storage_type(), kDefaultStorage)
+      << "NDArray.SyncCopyFromCPU is not supported for the sparse storage";
   TShape dshape = this->shape();
   CHECK_EQ(dshape.Size(), size)
       << "Memory size do not match";
@@ -805,6 +1562,8 @@ void NDArray::SyncCopyFromCPU(const void *data, size_t size) const {
 }
 
 void NDArray::SyncCopyToCPU(void *data, size_t size) const {
+  CHECK_EQ(storage_type(), kDefaultStorage)
+      << "NDArray.SyncCopyToCPU is not supported for the sparse storage";
   TShape dshape = this->shape();
   CHECK_EQ(dshape.Size(), size)
       << "Memory size do not match";
@@ -831,6 +1590,83 @@ void NDArray::SyncCopyToCPU(void *data, size_t size) const {
   }
 }
 
+void NDArray::AsyncCopyFromCPU(const void *data, size_t size,
+                               std::function<void()> on_complete) const {
+  CHECK_EQ(storage_type(), kDefaultStorage)
+      << "NDArray.AsyncCopyFromCPU is not supported for the sparse storage";
+  TShape dshape = this->shape();
+  CHECK_EQ(dshape.Size(), size)
+      << "Memory size do not match";
+  TBlob src((void*)data, dshape, cpu::kDevMask, this->dtype_, 0); // NOLINT(*)
+  NDArray ret = *this;
+  if (this->ctx().dev_mask() == cpu::kDevMask) {
+    Engine::Get()->PushAsync([src, ret, on_complete](RunContext rctx,
+                                                     Engine::CallbackOnComplete done) {
+        TBlob dst = ret.data();
+        ndarray::Copy<cpu, cpu>(src, &dst, Context::CPU(), Context::CPU(), rctx);
+        // the operation, with the captures, can be deleted by the completion
+        std::function<void()> callback = on_complete;
+        done();
+        if (callback) callback();
+      }, this->ctx(), {}, {this->var()},
+      FnProperty::kNormal, 0, PROFILER_MESSAGE("AsyncCopyCPU2CPU"));
+  } else {
+#if MXNET_USE_CUDA
+    Engine::Get()->PushAsync([src, ret, on_complete](RunContext rctx,
+                                                     Engine::CallbackOnComplete done) {
+        TBlob dst = ret.data();
+        ndarray::Copy<cpu, gpu>(src, &dst, Context::CPU(), ret.ctx(), rctx);
+        // Wait GPU kernel to complete
+        rctx.get_stream<gpu>()->Wait();
+        std::function<void()> callback = on_complete;
+        done();
+        if (callback) callback();
+      }, this->ctx(), {}, {this->var()},
+      FnProperty::kCopyToGPU, 0, PROFILER_MESSAGE("AsyncCopyCPU2GPU"));
+#else
+    LOG(FATAL) << "GPU is not enabled";
+#endif
+  }
+}
+
+void NDArray::AsyncCopyToCPU(void *data, size_t size,
+                             std::function<void()> on_complete) const {
+  CHECK_EQ(storage_type(), kDefaultStorage)
+      << "NDArray.AsyncCopyToCPU is not supported for the sparse storage";
+  TShape dshape = this->shape();
+  CHECK_EQ(dshape.Size(), size)
+      << "Memory size do not match";
+  TBlob dst(data, dshape, cpu::kDevMask, this->dtype_, 0); // NOLINT(*)
+  NDArray ret = *this;
+  if (this->ctx().dev_mask() == cpu::kDevMask) {
+    Engine::Get()->PushAsync([dst, ret, on_complete](RunContext rctx,
+                                                     Engine::CallbackOnComplete done) {
+        TBlob out = dst;
+        ndarray::Copy<cpu, cpu>(ret.data(), &out, Context::CPU(), Context::CPU(), rctx);
+        std::function<void()> callback = on_complete;
+        done();
+        if (callback) callback();
+      }, this->ctx(), {this->var()}, {},
+      FnProperty::kNormal, 0, PROFILER_MESSAGE("AsyncCopyCPU2CPU"));
+  } else {
+#if MXNET_USE_CUDA
+    Engine::Get()->PushAsync([dst, ret, on_complete](RunContext rctx,
+                                                     Engine::CallbackOnComplete done) {
+        TBlob out = dst;
+        ndarray::Copy<gpu, cpu>(ret.data(), &out, ret.ctx(), Context::CPU(), rctx);
+        // Wait GPU kernel to complete
+        rctx.get_stream<gpu>()->Wait();
+        std::function<void()> callback = on_complete;
+        done();
+        if (callback) callback();
+      }, this->ctx(), {this->var()}, {},
+      FnProperty::kCopyFromGPU, 0, PROFILER_MESSAGE("AsyncCopyGPU2CPU"));
+#else
+    LOG(FATAL) << "GPU is not enabled";
+#endif
+  }
+}
+
 #if MXNET_PREDICT_ONLY == 0
 // register API function
 // those with underscore will be registered at NDArray
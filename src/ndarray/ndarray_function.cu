@@ -24,7 +24,9 @@
 
 // this will be invoked by nvcc and compile GPU version
 #include <dmlc/logging.h>
+#include <dmlc/parameter.h>
 #include "./ndarray_function.h"
+#include "../common/cuda_utils.h"
 #include "./ndarray_function-inl.h"
 
 namespace mxnet {
@@ -80,6 +82,10 @@ void Copy<gpu, gpu>(const TBlob &from, TBlob *to,
       << "Source and target must have the same data type when copying across devices.";
     mshadow::Stream<gpu> *s = ctx.get_stream<gpu>();
     CHECK(s != NULL) << "need stream in GPU context";
+    // the copy runs on the copy stream of from_ctx, as a direct transfer when
+    // from_ctx can write to the memory of to_ctx
+    static const bool p2p = dmlc::GetEnv("MXNET_ENABLE_GPU_P2P", true);
+    if (p2p) EnablePeerAccess(from_ctx.dev_id, to_ctx.dev_id);
     cudaMemcpyPeerAsync(to->dptr_,
                         to_ctx.dev_id,
                         from.dptr_,
@@ -10,7 +10,9 @@
 #include <mxnet/ndarray.h>
 #include <nnvm/node.h>
 #include <nnvm/graph.h>
+#include <algorithm>
 #include <memory>
+#include "../operator/operator_common.h"
 
 namespace mxnet {
 namespace op {
@@ -58,7 +60,7 @@ class OperatorState {
  public:
   OperatorState(Operator *opr, const OperatorProperty *prop) {
     opr_ = opr;
-    fwd_init_ = bwd_init_ = false;
+    fwd_init_ = false;
 
     in_data_.resize(prop->ListArguments().size());
     out_data_.resize(prop->NumOutputs());
@@ -88,16 +90,16 @@ class OperatorState {
                const std::vector<TBlob>& inputs,
                const std::vector<OpReqType>& req,
                const std::vector<TBlob>& outputs) {
-    if (!fwd_init_) {
-      CHECK_EQ(inputs.size(), in_data_.size() + aux_data_.size());
-      CHECK_EQ(outputs.size(), out_data_.size());
-      for (size_t i = 0; i < in_data_.size(); ++i) in_data_[i] = inputs[i];
-      for (size_t i = 0; i < aux_data_.size(); ++i) {
-        aux_data_[i] = inputs[i + in_data_.size()];
-      }
-      for (size_t i = 0; i < out_data_.size(); ++i) out_data_[i] = outputs[i];
-      fwd_init_ = true;
+    // bind the arrays of every call, a state reused across calls, e.g. by
+    // the cached imperative ops, gets new arrays each time
+    CHECK_EQ(inputs.size(), in_data_.size() + aux_data_.size());
+    CHECK_EQ(outputs.size(), out_data_.size());
+    for (size_t i = 0; i < in_data_.size(); ++i) in_data_[i] = inputs[i];
+    for (size_t i = 0; i < aux_data_.size(); ++i) {
+      aux_data_[i] = inputs[i + in_data_.size()];
     }
+    for (size_t i = 0; i < out_data_.size(); ++i) out_data_[i] = outputs[i];
+    fwd_init_ = true;
     opr_->Forward(ctx, in_data_, req, out_data_, aux_data_);
   }
 
@@ -105,25 +107,22 @@ class OperatorState {
                 const std::vector<TBlob>& inputs,
                 const std::vector<OpReqType>& req,
                 const std::vector<TBlob>& outputs) {
-    if (!bwd_init_) {
-      CHECK(fwd_init_);
-      CHECK_EQ(arg_data_ptr_.size() + aux_data_.size(), inputs.size());
-      for (size_t i = 0; i < arg_data_ptr_.size(); ++i) {
-        *arg_data_ptr_[i] = inputs[i];
-      }
-      for (size_t i = 0; i < aux_data_.size(); ++i) {
-        aux_data_[i] = inputs[inputs.size() - aux_data_.size() + i];
-      }
-      CHECK_EQ(outputs.size(), in_grad_.size());
-      for (size_t i = 0; i < outputs.size(); ++i) in_grad_[i] = outputs[i];
-      bwd_init_ = true;
+    CHECK(fwd_init_);
+    CHECK_EQ(arg_data_ptr_.size() + aux_data_.size(), inputs.size());
+    for (size_t i = 0; i < arg_data_ptr_.size(); ++i) {
+      *arg_data_ptr_[i] = inputs[i];
     }
+    for (size_t i = 0; i < aux_data_.size(); ++i) {
+      aux_data_[i] = inputs[inputs.size() - aux_data_.size() + i];
+    }
+    CHECK_EQ(outputs.size(), in_grad_.size());
+    for (size_t i = 0; i < outputs.size(); ++i) in_grad_[i] = outputs[i];
     opr_->Backward(ctx, out_grad_, in_data_, out_data_, req, in_grad_, aux_data_);
   }
 
  private:
   Operator *opr_;
-  bool fwd_init_, bwd_init_;
+  bool fwd_init_;
   std::vector<TBlob> in_data_, aux_data_, out_data_, in_grad_, out_grad_;
   std::vector<TBlob*> arg_data_ptr_;
 };
@@ -297,6 +296,38 @@ inline std::vector<NodeEntry> OpPropGradient(
       ptr->inputs.begin(), ptr->inputs.begin() + prop.arguments.size());
   std::vector<NodeEntry> ograd(
       out_grads.begin(), out_grads.begin() + prop.ptr->NumVisibleOutputs());
+  // the gradients of the inputs are zero when the ones of the outputs are and the
+  // backward reads them, unless the operator adds to them; the backward node is then
+  // skipped with the forward arrays it would keep, as for the layers under a BlockGrad
+  static auto& nonloss_grad = Op::GetAttr<bool>("TNonlossGradient");
+  if (CheckGradAllZero(ograd) && nonloss_grad.get(ptr->op(), true)) {
+    std::vector<int> out_grad_index(ograd.size());
+    std::vector<int> in_data_index(in_data.size(), -1);
+    std::vector<int> out_data_index(out_data.size(), -1);
+    for (size_t i = 0; i < out_grad_index.size(); ++i) {
+      out_grad_index[i] = static_cast<int>(i);
+    }
+    auto deps = prop.ptr->DeclareBackwardDependency(
+        out_grad_index, in_data_index, out_data_index);
+    if (std::any_of(deps.begin(), deps.end(), [](int d) { return d >= 0; })) {
+      std::vector<NodeEntry> in_grad;
+      for (uint32_t i = 0; i < prop.arguments.size(); ++i) {
+        NodePtr zero = MakeNode("zeros_like",
+                                ptr->attrs.name + "_in" + std::to_string(i) + "_backward",
+                                {ptr->inputs[i]}, nullptr, &ptr);
+        in_grad.emplace_back(NodeEntry{zero, 0, 0});
+      }
+      if (prop.aux_states.size() != 0) {
+        NodePtr ng = Node::Create();
+        ng->attrs.op = Op::Get("_NoGradient");
+        ng->attrs.name = "NoGradient";
+        for (uint32_t i = 0; i < prop.aux_states.size(); ++i) {
+          in_grad.emplace_back(NodeEntry{ng, 0, 0});
+        }
+      }
+      return in_grad;
+    }
+  }
   auto inputs = prop.ptr->BackwardInputs(ograd, in_data, out_data);
   // add all the auxiliary data
   for (uint32_t i = 0; i < prop.aux_states.size(); ++i) {
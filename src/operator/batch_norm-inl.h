@@ -46,9 +46,10 @@ namespace mxnet {
 namespace op {
 
 namespace batchnorm {
-enum BatchNormOpInputs {kData, kGamma, kBeta};  // kGamma: weights, kBeta: biases
+enum BatchNormOpInputs {kData, kGamma, kBeta, kAddend};  // kGamma: weights, kBeta: biases
 enum BatchNormOpOutputs {kOut, kMean, kVar};  // req, out_data
 enum BatchNormOpAuxiliary {kMovingMean, kMovingVar};  // aux_states
+enum BatchNormOpActType {kNoAct, kReLU};
 
 /*! \brief Default channel axis if none specified int he params */
 constexpr int DEFAULT_AXIS = 1;
@@ -63,6 +64,8 @@ struct BatchNormParam : public dmlc::Parameter<BatchNormParam> {
   bool output_mean_var;
   int axis;
   bool cudnn_off;
+  int act_type;
+  bool fuse_add;
   DMLC_DECLARE_PARAMETER(BatchNormParam) {
     DMLC_DECLARE_FIELD(eps).set_default(1e-3f)
     .describe("Epsilon to prevent div 0. "
@@ -81,6 +84,22 @@ struct BatchNormParam : public dmlc::Parameter<BatchNormParam> {
       .describe("Specify which shape axis the channel is specified");
     DMLC_DECLARE_FIELD(cudnn_off).set_default(false)
       .describe("Do not select CUDNN operator, if available");
+    DMLC_DECLARE_FIELD(act_type).set_default(batchnorm::kNoAct)
+      .add_enum("none", batchnorm::kNoAct)
+      .add_enum("relu", batchnorm::kReLU)
+      .describe("Activation function applied to the output, after the addend");
+    DMLC_DECLARE_FIELD(fuse_add).set_default(false)
+      .describe("Add the extra input addend, of the shape of data, to the normalized output");
+  }
+
+  /*! \brief whether the output is more than the normalized data */
+  bool fused() const {
+    return act_type != batchnorm::kNoAct || fuse_add;
+  }
+
+  /*! \brief the number of arguments, addend included */
+  size_t num_args() const {
+    return fuse_add ? 4U : 3U;
   }
 };
 
@@ -115,7 +134,7 @@ class BatchNormOp : public Operator {
     using namespace mshadow;
     using namespace mshadow::expr;
 
-    CHECK_EQ(in_data.size(), 3U);
+    CHECK_EQ(in_data.size(), param_.num_args());
     CHECK_EQ(aux_states.size(), 2U);
     if (ctx.is_train) {
       CHECK_EQ(out_data.size(), 3U);
@@ -165,9 +184,9 @@ class BatchNormOp : public Operator {
                         const std::vector<TBlob> &in_grad,
                         const std::vector<TBlob> &aux_states) {
     CHECK_EQ(out_grad.size(), param_.output_mean_var ? 3U : 1U);
-    CHECK_EQ(in_data.size(), 3U);
+    CHECK_EQ(in_data.size(), param_.num_args());
     CHECK_EQ(out_data.size(), 3U);
-    CHECK_EQ(in_grad.size(), 3U);
+    CHECK_EQ(in_grad.size(), param_.num_args());
     mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
     DoBackward(s, ctx, out_grad, in_data,
                out_data, req, in_grad, aux_states);
@@ -229,7 +248,11 @@ class BatchNormProp : public OperatorProperty {
                   std::vector<TShape> *out_shape,
                   std::vector<TShape> *aux_shape) const override {
     using namespace mshadow;
-    CHECK_EQ(in_shape->size(), 3U) << "Input:[data, gamma, beta]";
+    if (param_.fuse_add) {
+      CHECK_EQ(in_shape->size(), 4U) << "Input:[data, gamma, beta, addend]";
+    } else {
+      CHECK_EQ(in_shape->size(), 3U) << "Input:[data, gamma, beta]";
+    }
     const TShape &dshape = in_shape->at(0);
 
     const size_t channelAxis = static_cast<size_t>(param_.axis < 0
@@ -245,6 +268,9 @@ class BatchNormProp : public OperatorProperty {
 
     in_shape->at(1) = TShape(Shape1(channelCount));
     in_shape->at(2) = TShape(Shape1(channelCount));
+    if (param_.fuse_add) {
+      SHAPE_ASSIGN_CHECK(*in_shape, batchnorm::kAddend, dshape);
+    }
 
     out_shape->clear();
     out_shape->push_back(dshape);                // kOut
@@ -271,12 +297,14 @@ class BatchNormProp : public OperatorProperty {
     MSHADOW_REAL_TYPE_SWITCH_EX(dtype, DTypeX, AccRealX, {
          dtype_param = mshadow::DataType<AccRealX>::kFlag; });
     for (index_t i = 1; i < in_type->size(); ++i) {
+      // the addend has the type of the data
+      const int expected = i == batchnorm::kAddend ? dtype : dtype_param;
       if ((*in_type)[i] == -1) {
-        (*in_type)[i] = dtype_param;
+        (*in_type)[i] = expected;
       } else {
-        CHECK_EQ((*in_type)[i], dtype_param) << "This layer requires uniform type. "
-                                             << "Expected " << dtype_param << " v.s. given "
-                                             << (*in_type)[i] << " at " << ListArguments()[i];
+        CHECK_EQ((*in_type)[i], expected) << "This layer requires uniform type. "
+                                          << "Expected " << expected << " v.s. given "
+                                          << (*in_type)[i] << " at " << ListArguments()[i];
       }
     }
     for (index_t i = 0; i < aux_type->size(); ++i) {
@@ -314,12 +342,22 @@ class BatchNormProp : public OperatorProperty {
     const std::vector<int> &out_grad,
     const std::vector<int> &in_data,
     const std::vector<int> &out_data) const override {
-    return {out_grad[batchnorm::kOut],
-            out_data[batchnorm::kMean],
-            out_data[batchnorm::kVar],
-            in_data[batchnorm::kData],
-            in_data[batchnorm::kGamma]
-           };
+    std::vector<int> deps = {out_grad[batchnorm::kOut],
+                             out_data[batchnorm::kMean],
+                             out_data[batchnorm::kVar],
+                             in_data[batchnorm::kData],
+                             in_data[batchnorm::kGamma]
+                            };
+    // the relu gradient is masked by the output
+    if (param_.act_type == batchnorm::kReLU) deps.push_back(out_data[batchnorm::kOut]);
+    return deps;
+  }
+
+  std::vector<ResourceRequest> BackwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    // for the relu gradient before cuDNN
+    if (param_.act_type == batchnorm::kReLU) return {ResourceRequest::kTempSpace};
+    return {};
   }
 
   int NumVisibleOutputs() const override {
@@ -334,6 +372,9 @@ class BatchNormProp : public OperatorProperty {
   }
 
   std::vector<std::string> ListArguments() const override {
+    if (param_.fuse_add) {
+      return {"data", "gamma", "beta", "addend"};
+    }
     return {"data", "gamma", "beta"};
   }
 
@@ -473,6 +514,24 @@ class BNTensor3 {
   size_t shape_[COUNT];
 };
 
+/*! \brief out = act(out + addend), the addend and the activation after cuDNN */
+struct AddActivation {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const DType* addend, const bool relu) {
+    const DType v = addend != nullptr ? DType(out[i] + addend[i]) : out[i];
+    out[i] = relu && !(v > DType(0)) ? DType(0) : v;
+  }
+};
+
+/*! \brief the gradient before the relu of output out, all of grad if out is null */
+template<int req>
+struct ReLUGrad {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* in_grad, const DType* grad, const DType* out) {
+    KERNEL_ASSIGN(in_grad[i], req, out == nullptr || out[i] > DType(0) ? grad[i] : DType(0));
+  }
+};
+
 inline int GetRealAxis(const TShape& shape, int axis) {
   if (axis < 0) {
     axis += shape.ndim();
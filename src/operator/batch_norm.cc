@@ -84,6 +84,44 @@ static inline void ForEachFast(const BNTensor3<DType1> &in_data,
   }
 }
 
+/*! \brief Fast-foreach over two inputs and an output */
+template<typename DType1, typename DType2, typename DType3, typename OnData>
+static inline void ForEachFast(const BNTensor3<DType1> &in_data1,
+                               const BNTensor3<DType2> &in_data2,
+                               const BNTensor3<DType3> &out_data,
+                               const size_t channel,
+                               OnData onData) {
+  const size_t num         = in_data1.OuterSize();
+  const size_t matrixSize  = in_data1.InnerSize();
+  const size_t skipLength  = in_data1.SkipLengthToNextSameChannelData();
+  const size_t startOffset = in_data1.StartOffset(channel);
+
+  DType1 *data1 = in_data1.dptr_ + startOffset;
+  DType2 *data2 = in_data2.dptr_ + startOffset;
+  DType3 *odata = out_data.dptr_ + startOffset;
+
+  for (size_t outer = 0; outer < num; ++outer) {
+    for (size_t i = 0; i < matrixSize; ++i) {
+      onData(data1++, data2++, odata++);
+    }
+    data1 += skipLength;
+    data2 += skipLength;
+    odata += skipLength;
+  }
+}
+
+/*! \brief the activation of a fused batch normalization */
+template<typename AccReal>
+static inline AccReal Activate(const AccReal v, const bool relu) {
+  return relu && !(v > AccReal(0)) ? AccReal(0) : v;
+}
+
+/*! \brief the gradient before the relu of output out */
+template<typename DType>
+static inline DType ReLUMasked(const DType *grad, const DType *out) {
+  return *out > DType(0) ? *grad : DType(0);
+}
+
 }  // namespace batchnorm
 
 /*! \brief Forward CPU */
@@ -108,6 +146,12 @@ void BatchNormOp<xpu, DType, AccReal>::DoForward(mshadow::Stream<cpu> *,
   const TBlob &meanVector      = out_data[batchnorm::kMean];
   const TBlob &varianceVector  = out_data[batchnorm::kVar];
 
+  // Fused addend and activation
+  batchnorm::BNTensor3<DType> addendData(
+    param_.fuse_add ? in_data[batchnorm::kAddend].dptr<DType>() : nullptr,
+    in_data[batchnorm::kData].shape_, param_.axis);
+  const bool relu = param_.act_type == batchnorm::kReLU;
+
   AccReal *mean = meanVector.dptr<AccReal>();
   AccReal  *var = varianceVector.dptr<AccReal>();
 
@@ -162,7 +206,30 @@ void BatchNormOp<xpu, DType, AccReal>::DoForward(mshadow::Stream<cpu> *,
     const AccReal thisBias = b[channel];
 
     // note that var is still invstd
-    if (!param_.fix_gamma) {
+    if (param_.fused()) {
+      // the addend and the activation are applied while the output is written
+      if (param_.fix_gamma && IsWriting(req[batchnorm::kGamma])) {
+        w[channel] = AccReal(1);
+      }
+      const AccReal scale = param_.fix_gamma ? AccReal(1) : thisWeight;
+      if (IsWriting(req[batchnorm::kData]) && addendData.IsEmpty()) {
+        ForEachFast(inputData, outputData, channel,
+                    [scale, thisBias, thisMean, thisInvstd, relu](const DType *in_data,
+                                                                  DType *out_data) {
+                      const AccReal v = ((*in_data - thisMean) * thisInvstd) * scale + thisBias;
+                      *out_data = static_cast<DType>(batchnorm::Activate(v, relu));
+                    });
+      } else if (IsWriting(req[batchnorm::kData])) {
+        ForEachFast(inputData, addendData, outputData, channel,
+                    [scale, thisBias, thisMean, thisInvstd, relu](const DType *in_data,
+                                                                  const DType *addend,
+                                                                  DType *out_data) {
+                      const AccReal v = ((*in_data - thisMean) * thisInvstd) * scale + thisBias
+                                        + *addend;
+                      *out_data = static_cast<DType>(batchnorm::Activate(v, relu));
+                    });
+      }
+    } else if (!param_.fix_gamma) {
       if (IsWriting(req[batchnorm::kData])) {
         ForEachFast(inputData, outputData, channel,
                     [thisWeight, thisBias, thisMean, thisInvstd](const DType *in_data,
@@ -214,6 +281,15 @@ void BatchNormOp<xpu, DType, AccReal>::DoBackward(mshadow::Stream<cpu> *,
   const TBlob &saveMean = out_data[batchnorm::kMean];
   const TBlob &saveStd  = out_data[batchnorm::kVar];
 
+  // Fused addend and activation
+  const bool relu = param_.act_type == batchnorm::kReLU;
+  batchnorm::BNTensor3<DType> outputData(relu ? out_data[batchnorm::kOut].dptr<DType>() : nullptr,
+                                         in_data[batchnorm::kData].shape_, param_.axis);
+  batchnorm::BNTensor3<DType> gradAddend(
+    param_.fuse_add ? in_grad[batchnorm::kAddend].dptr<DType>() : nullptr,
+    in_data[batchnorm::kData].shape_, param_.axis);
+  const OpReqType addendReq = param_.fuse_add ? req[batchnorm::kAddend] : kNullOp;
+
   const size_t channelCount = inputData.ChannelCount();
   const size_t itemCount    = inputData.Size() / channelCount;
 
@@ -249,19 +325,50 @@ void BatchNormOp<xpu, DType, AccReal>::DoBackward(mshadow::Stream<cpu> *,
       invstd = VARIANCE_TO_INVSTD(runningVarDataPtr[channel], param_.eps);
     }
 
+    // the gradient of the addend is the one before the relu
+    if (!gradAddend.IsEmpty() && addendReq != kNullOp) {
+      const bool addTo = addendReq == kAddTo;
+      if (relu) {
+        ForEachFast(gradOut, outputData, gradAddend, static_cast<size_t>(channel),
+                    [addTo](const DType *gradOut_data, const DType *out_data,
+                            DType *gradAddend_data) {
+                      const DType g = batchnorm::ReLUMasked(gradOut_data, out_data);
+                      *gradAddend_data = addTo ? DType(*gradAddend_data + g) : g;
+                    });
+      } else {
+        ForEachFast(gradOut, gradAddend, static_cast<size_t>(channel),
+                    [addTo](const DType *gradOut_data, DType *gradAddend_data) {
+                      *gradAddend_data = addTo ? DType(*gradAddend_data + *gradOut_data)
+                                               : *gradOut_data;
+                    });
+      }
+    }
+
     // sumGradOut over all gradOutput in feature plane
     AccReal sumGradOut = 0;
-    ForEachFast(gradOut, static_cast<size_t>(channel),
-                [&sumGradOut](const DType *gradOut_data) {
-                  sumGradOut += *gradOut_data;
-                });
-
     // dot product of the Q(X) and gradOuput
     AccReal dotp = 0;
-    ForEachFast(inputData, gradOut, static_cast<size_t>(channel),
-                [&dotp, mean](const DType *thisInputData, const DType *gradOut_data) {
-                  dotp += (*thisInputData - mean) * (*gradOut_data);
-                });
+    if (relu) {
+      ForEachFast(gradOut, outputData, static_cast<size_t>(channel),
+                  [&sumGradOut](const DType *gradOut_data, const DType *out_data) {
+                    sumGradOut += batchnorm::ReLUMasked(gradOut_data, out_data);
+                  });
+      ForEachFast(inputData, gradOut, outputData, static_cast<size_t>(channel),
+                  [&dotp, mean](const DType *thisInputData, const DType *gradOut_data,
+                                const DType *out_data) {
+                    dotp += (*thisInputData - mean) *
+                            batchnorm::ReLUMasked(gradOut_data, out_data);
+                  });
+    } else {
+      ForEachFast(gradOut, static_cast<size_t>(channel),
+                  [&sumGradOut](const DType *gradOut_data) {
+                    sumGradOut += *gradOut_data;
+                  });
+      ForEachFast(inputData, gradOut, static_cast<size_t>(channel),
+                  [&dotp, mean](const DType *thisInputData, const DType *gradOut_data) {
+                    dotp += (*thisInputData - mean) * (*gradOut_data);
+                  });
+    }
 
     if (!gradIn.IsEmpty() && IsWriting(req[batchnorm::kData])) {  // if there's a grad input
       if (is_train_and_not_global_stats) {
@@ -279,20 +386,37 @@ void BatchNormOp<xpu, DType, AccReal>::DoBackward(mshadow::Stream<cpu> *,
 
         const AccReal iw = invstd * w;
         const AccReal gradMean = sumGradOut / itemCount;
-        ForEachFast(gradOut, gradIn, static_cast<size_t>(channel),
-                    [iw, gradMean](const DType *gradOut_data, DType *gradIn_data) {
-                      *gradIn_data = (*gradOut_data - gradMean - *gradIn_data) * iw;
-                    });
+        if (relu) {
+          ForEachFast(gradOut, outputData, gradIn, static_cast<size_t>(channel),
+                      [iw, gradMean](const DType *gradOut_data, const DType *out_data,
+                                     DType *gradIn_data) {
+                        *gradIn_data = (batchnorm::ReLUMasked(gradOut_data, out_data)
+                                        - gradMean - *gradIn_data) * iw;
+                      });
+        } else {
+          ForEachFast(gradOut, gradIn, static_cast<size_t>(channel),
+                      [iw, gradMean](const DType *gradOut_data, DType *gradIn_data) {
+                        *gradIn_data = (*gradOut_data - gradMean - *gradIn_data) * iw;
+                      });
+        }
       } else {
         // when in evaluation mode
         // Q(X) = X - running_mean  ; i.e. input centered to zero mean
         // Y = Q(X) / running_std    ; i.e. BN output before weight and bias
         // dL/dX = w / running_std
         const AccReal iw = invstd * w;
-        ForEachFast(gradOut, gradIn, static_cast<size_t>(channel),
-                    [iw](const DType *gradOut_data, DType *gradIn_data) {
-                      *gradIn_data = *gradOut_data * iw;
-                    });
+        if (relu) {
+          ForEachFast(gradOut, outputData, gradIn, static_cast<size_t>(channel),
+                      [iw](const DType *gradOut_data, const DType *out_data,
+                           DType *gradIn_data) {
+                        *gradIn_data = batchnorm::ReLUMasked(gradOut_data, out_data) * iw;
+                      });
+        } else {
+          ForEachFast(gradOut, gradIn, static_cast<size_t>(channel),
+                      [iw](const DType *gradOut_data, DType *gradIn_data) {
+                        *gradIn_data = *gradOut_data * iw;
+                      });
+        }
       }
     }
 
@@ -320,6 +444,7 @@ Operator *CreateOp<cpu>(BatchNormParam param, const int dtype, const TShape& sha
 #if MXNET_USE_MKL2017 == 1
   if (shape.ndim() == 4
       && param.axis == mxnet::op::batchnorm::DEFAULT_AXIS
+      && !param.fused()
       && !mxnet::op::batchnorm::disable_mkl) {
     switch (dtype) {
       case mshadow::kFloat32:
@@ -396,10 +521,20 @@ axis to be the last item in the input shape.
 Both ``gamma`` and ``beta`` are learnable parameters. But if ``fix_gamma`` is true,
 then set ``gamma`` to 1 and its gradient to 0.
 
+If ``fuse_add`` is true, the extra input ``addend`` is added to the output, and ``act_type``
+applies an activation after it, in the same pass over the data::
+
+  out = relu(batch_norm(data) + addend)
+
+The executor fuses a ``BatchNorm`` followed by ``Activation`` with ``act_type='relu'``,
+possibly through an ``elemwise_add``, into one such operator, unless
+``MXNET_EXEC_FUSE_BN_RELU`` is set to 0.
+
 )code" ADD_FILELINE)
 .add_argument("data", "NDArray-or-Symbol", "Input data to batch normalization")
 .add_argument("gamma", "NDArray-or-Symbol", "gamma array")
 .add_argument("beta", "NDArray-or-Symbol", "beta array")
+.add_argument("addend", "NDArray-or-Symbol", "added to the output if fuse_add is true")
 .add_argument("moving_mean", "NDArray-or-Symbol", "running mean of input")
 .add_argument("moving_var", "NDArray-or-Symbol", "running variance of input")
 .add_arguments(BatchNormParam::__FIELDS__());
@@ -409,9 +544,13 @@ NNVM_REGISTER_OP(BatchNorm)
   "FSetInputVarAttrOnCompose",
   [](const nnvm::NodeAttrs& attrs, nnvm::NodePtr var, const int index) {
     if (var->attrs.dict.find("__init__") != var->attrs.dict.end()) return;
-    if (index == 3) {
+    // the auxiliary states follow the addend
+    auto it = attrs.dict.find("fuse_add");
+    const int aux = it != attrs.dict.end() &&
+                    (it->second == "True" || it->second == "true" || it->second == "1") ? 4 : 3;
+    if (index == aux) {
       var->attrs.dict["__init__"] = "[\"zero\", {}]";
-    } else if (index == 4) {
+    } else if (index == aux + 1) {
       var->attrs.dict["__init__"] = "[\"one\", {}]";
     }
   });
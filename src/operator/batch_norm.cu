@@ -33,6 +33,10 @@
 #define FIX_GAMMA_FLAG        8
 #define IS_TRAINING_FLAG      16
 #define USE_GLOBAL_STATS_FLAG 32
+#define RELU_FLAG             64
+#define ADD_FLAG              128
+#define WRITE_ADDEND_FLAG     256
+#define ADDTO_ADDEND_FLAG     512
 
 #if MXNET_USE_CUDNN == 1 && CUDNN_MAJOR >= 5
 #include "./cudnn_batch_norm-inl.h"
@@ -123,18 +127,35 @@ struct VarOp {
 
 template<typename DType, typename AccReal, typename DeviceTensor>
 struct GradOp {
-  __device__ GradOp(AccReal m, const DeviceTensor i, const DeviceTensor g)
-    : mean(m), input(i), gradOutput(g) {}
+  __device__ GradOp(AccReal m, const DeviceTensor i, const DeviceTensor g,
+                    const DeviceTensor o, const bool r)
+    : mean(m), input(i), gradOutput(g), output(o), relu(r) {}
   __device__ __forceinline__ Float2<DType, AccReal> operator()(int batch, int plane, int n) {
-    const DType g = gradOutput.get_ref(batch, plane, n);
+    DType g = gradOutput.get_ref(batch, plane, n);
+    // the gradient before the fused relu
+    if (relu && !(output.get_ref(batch, plane, n) > DType(0))) g = DType(0);
     const DType c = ScalarConvert<AccReal, DType>::to(input.get_ref(batch, plane, n) - mean);
     return Float2<DType, AccReal>(g, g * c);
   }
   const AccReal mean;
   const DeviceTensor input;
   const DeviceTensor gradOutput;
+  const DeviceTensor output;
+  const bool relu;
 };
 
+/*! \brief v + addend, then the relu, as the flags of a fused batch normalization ask */
+template<typename DType, typename AccReal, typename DeviceTensor>
+static __device__ __forceinline__ DType FusedOutput(AccReal v, const DeviceTensor &addend,
+                                                    const int batch, const int plane,
+                                                    const int x, const uint32_t flags) {
+  if ((flags & ADD_FLAG) != 0) {
+    v += ScalarConvert<DType, AccReal>::to(addend.get_ref(batch, plane, x));
+  }
+  if ((flags & RELU_FLAG) != 0 && !(v > AccReal(0))) v = AccReal(0);
+  return ScalarConvert<AccReal, DType>::to(v);
+}
+
 #if CUDA_VERSION >= 9000
 #define FULLMASK 0xFFFFFFFF
 #define __shfl_xor(...) __shfl_xor_sync(FULLMASK, __VA_ARGS__)
@@ -206,6 +227,7 @@ template <typename DType, typename AccReal, typename DeviceTensor1, typename Dev
 __global__ void BatchNormalizationUpdateOutputInferenceKernel(
   DeviceTensor input,
   DeviceTensor output,
+  DeviceTensor addend,
   DeviceTensor1 runningMean,
   DeviceTensor1 runningVar,
   DeviceTensor1 saveMean,
@@ -235,8 +257,8 @@ __global__ void BatchNormalizationUpdateOutputInferenceKernel(
   for (int batch = 0, nbatch = input.OuterSize(); batch < nbatch; ++batch) {
     for (int x = threadIdx.x, nx = input.InnerSize(); x < nx; x += blockDim.x) {
       const DType inp = input.get_ref(batch, plane, x);
-      output.get_ref(batch, plane, x) =
-        ScalarConvert<AccReal, DType>::to(gamma * (inp - mean) * invstd + beta);
+      output.get_ref(batch, plane, x) = FusedOutput<DType, AccReal>(
+        gamma * (inp - mean) * invstd + beta, addend, batch, plane, x, flags);
     }
   }
 }
@@ -245,6 +267,7 @@ template<typename DType, typename AccReal, typename DeviceTensor1, typename Devi
 __global__ void BatchNormalizationUpdateOutputKernel(
   DeviceTensor input,
   DeviceTensor output,
+  DeviceTensor addend,
   DeviceTensor1 weight,
   DeviceTensor1 bias,
   const AccReal epsilon,
@@ -291,8 +314,8 @@ __global__ void BatchNormalizationUpdateOutputKernel(
   for (int batch = 0, nbatch = input.OuterSize(); batch < nbatch; ++batch) {
     for (int x = threadIdx.x, nx = input.InnerSize(); x < nx; x += blockDim.x) {
       const DType inp = input.get_ref(batch, plane, x);
-      output.get_ref(batch, plane, x) =
-        ScalarConvert<AccReal, DType>::to(gamma * (inp - mean) * invStd + beta);
+      output.get_ref(batch, plane, x) = FusedOutput<DType, AccReal>(
+        gamma * (inp - mean) * invStd + beta, addend, batch, plane, x, flags);
     }
   }
 }
@@ -312,7 +335,9 @@ template<typename DType, typename AccReal, typename DeviceTensor1, typename Devi
 static __global__ void BatchNormalizationBackwardKernel(
   const DeviceTensor input,
   const DeviceTensor gradOutput,
+  const DeviceTensor output,
   DeviceTensor gradInput,
+  DeviceTensor gradAddend,
   CUDATensors<DeviceTensor1> tensors,
   const uint32_t flags,
   const AccReal momentum,
@@ -339,7 +364,8 @@ static __global__ void BatchNormalizationBackwardKernel(
   // Compute two values across (batch, x/y/z) in one pass:
   // 1. Sum(gradOutput)
   // 2. DotProduct(input - mean, gradOutput)
-  GradOp<DType, AccReal, DeviceTensor> g(mean, input, gradOutput);
+  const bool relu = (flags & RELU_FLAG) != 0;
+  GradOp<DType, AccReal, DeviceTensor> g(mean, input, gradOutput, output, relu);
   Float2< DType, AccReal > res = reduce < Float2 < DType, AccReal >,
     GradOp< DType, AccReal, DeviceTensor >, DeviceTensor > (g, gradOutput, plane);
   const AccReal gradOutputSum = res.v1;
@@ -360,10 +386,22 @@ static __global__ void BatchNormalizationBackwardKernel(
                                 * momentum + localVariance * (AccReal(1) - momentum);
   }
 
+  if ((flags & (WRITE_ADDEND_FLAG | ADDTO_ADDEND_FLAG)) != 0) {
+    for (int batch = 0, nbatch = gradOutput.OuterSize(); batch < nbatch; ++batch) {
+      for (int x = threadIdx.x, nx = gradOutput.InnerSize(); x < nx; x += blockDim.x) {
+        DType gradOut = gradOutput.get_ref(batch, plane, x);
+        if (relu && !(output.get_ref(batch, plane, x) > DType(0))) gradOut = DType(0);
+        DType &gradAdd = gradAddend.get_ref(batch, plane, x);
+        gradAdd = (flags & ADDTO_ADDEND_FLAG) != 0 ? DType(gradAdd + gradOut) : gradOut;
+      }
+    }
+  }
+
   if (gradInput.Size() > 0 && (flags & WRITE_DATA_FLAG) != 0) {
     for (int batch = 0, nbatch = gradOutput.OuterSize(); batch < nbatch; ++batch) {
       for (int x = threadIdx.x, nx = gradOutput.InnerSize(); x < nx; x += blockDim.x) {
-        const DType gradOut = gradOutput.get_ref(batch, plane, x);
+        DType gradOut = gradOutput.get_ref(batch, plane, x);
+        if (relu && !(output.get_ref(batch, plane, x) > DType(0))) gradOut = DType(0);
         if (is_train_and_not_global_stats) {
           const DType inp = input.get_ref(batch, plane, x);
           const AccReal proj = (inp - mean) * projScale;
@@ -495,6 +533,9 @@ static void BatchNormalizationUpdateOutput(mshadow::Stream<gpu> *s,
     in_data[batchnorm::kData], param.axis);
   batchnorm::BNTensor3<DType> output = batchnorm::BNTensor3<DType>(
     out_data[batchnorm::kOut], param.axis);
+  batchnorm::BNTensor3<DType> addend = batchnorm::BNTensor3<DType>(
+    param.fuse_add ? in_data[batchnorm::kAddend].dptr<DType>() : nullptr,
+    in_data[batchnorm::kData].shape_, param.axis);
   DeviceTensor1 weight = devicetensor<AccReal, 1>(in_data[batchnorm::kGamma]);
   DeviceTensor1 bias = devicetensor<AccReal, 1>(in_data[batchnorm::kBeta]);
   DeviceTensor1 runningMean = devicetensor<AccReal, 1>(aux_states[batchnorm::kMovingMean]);
@@ -510,7 +551,7 @@ static void BatchNormalizationUpdateOutput(mshadow::Stream<gpu> *s,
     BatchNormalizationUpdateOutputInferenceKernel<DType, AccReal, DeviceTensor1,
       batchnorm::BNTensor3<DType>>
       <<< blocks, threads, 0, mshadow::Stream<gpu>::GetStream(s) >>> (
-      input, output, runningMean, runningVar, saveMean,
+      input, output, addend, runningMean, runningVar, saveMean,
         saveInvStd, weight, bias, eps, flags);
   } else {
     dim3 blocks(input.ChannelCount());
@@ -518,7 +559,7 @@ static void BatchNormalizationUpdateOutput(mshadow::Stream<gpu> *s,
     BatchNormalizationUpdateOutputKernel<DType, AccReal, DeviceTensor1,
       batchnorm::BNTensor3<DType>>
       << < blocks, threads, 0, mshadow::Stream<gpu>::GetStream(s) >> > (
-      input, output, weight, bias, eps, momentum, runningMean, runningVar,
+      input, output, addend, weight, bias, eps, momentum, runningMean, runningVar,
         saveMean, saveInvStd, flags);
   }
   MSHADOW_CUDA_POST_KERNEL_CHECK(BatchNormalizationUpdateOutput);
@@ -542,6 +583,12 @@ static void BatchNormalizationBackward(mshadow::Stream<gpu> *s,
     out_grad[batchnorm::kOut], param.axis);
   batchnorm::BNTensor3<DType>gradInput = batchnorm::BNTensor3<DType>(
     in_grad[batchnorm::kData], param.axis);
+  batchnorm::BNTensor3<DType> output = batchnorm::BNTensor3<DType>(
+    param.act_type == batchnorm::kReLU ? out_data[batchnorm::kOut].dptr<DType>() : nullptr,
+    in_data[batchnorm::kData].shape_, param.axis);
+  batchnorm::BNTensor3<DType> gradAddend = batchnorm::BNTensor3<DType>(
+    param.fuse_add ? in_grad[batchnorm::kAddend].dptr<DType>() : nullptr,
+    in_data[batchnorm::kData].shape_, param.axis);
 
   CUDATensors<DeviceTensor1> tensors;
 
@@ -563,7 +610,7 @@ static void BatchNormalizationBackward(mshadow::Stream<gpu> *s,
   dim3 threads(batchnorm::cuda::getNumThreads(gradOutput.InnerSize(), SMALLER_THREADS));
   BatchNormalizationBackwardKernel<DType, AccReal, DeviceTensor1, batchnorm::BNTensor3<DType>>
     <<< blocks, threads, 0, mshadow::Stream<gpu>::GetStream(s) >>> (
-    input, gradOutput, gradInput, tensors, flags, momentum, eps);
+    input, gradOutput, output, gradInput, gradAddend, tensors, flags, momentum, eps);
   MSHADOW_CUDA_POST_KERNEL_CHECK(BatchNormalizationBackward);
 }
 
@@ -578,6 +625,8 @@ static inline uint32_t SetupFlags(const OpContext &ctx,
   flags |= ctx.is_train ? IS_TRAINING_FLAG : 0;
   flags |= params.fix_gamma ? FIX_GAMMA_FLAG : 0;
   flags |= params.use_global_stats ? USE_GLOBAL_STATS_FLAG : 0;
+  flags |= params.act_type == batchnorm::kReLU ? RELU_FLAG : 0;
+  flags |= params.fuse_add ? ADD_FLAG : 0;
   if (BatchNormOp<xpu, DType, AccReal>::IsWriting(req[batchnorm::kData])) {
     flags |= WRITE_DATA_FLAG;
   }
@@ -621,6 +670,12 @@ void BatchNormOp<xpu, DType, AccReal>::DoBackward(mshadow::Stream<gpu> *stream,
                                                   const std::vector<OpReqType> &req,
                                                   const std::vector<TBlob> &in_grad,
                                                   const std::vector<TBlob> &aux_states) {
+  uint32_t flags = SetupFlags<xpu, DType, AccReal>(ctx, param_, req);
+  if (param_.fuse_add && req[batchnorm::kAddend] == kAddTo) {
+    flags |= ADDTO_ADDEND_FLAG;
+  } else if (param_.fuse_add && IsWriting(req[batchnorm::kAddend])) {
+    flags |= WRITE_ADDEND_FLAG;
+  }
   batchnorm::cuda::BatchNormalizationBackward<DType, AccReal>(
     stream,
     ctx,
@@ -630,7 +685,7 @@ void BatchNormOp<xpu, DType, AccReal>::DoBackward(mshadow::Stream<gpu> *stream,
     out_data,
     in_grad,
     aux_states,
-    SetupFlags<xpu, DType, AccReal>(ctx, param_, req),
+    flags,
     param_.momentum,
     param_.eps);
   MSHADOW_CUDA_POST_KERNEL_CHECK(BatchNormOp_DoBackward_gpu);
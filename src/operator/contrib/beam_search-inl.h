@@ -0,0 +1,208 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file beam_search-inl.h
+ * \brief one step of beam search decoding
+ *
+ * The step scores the beam_size x vocab extensions of the hypotheses of each
+ * batch row, keeps the best beam_size, and gives their tokens, the rows of
+ * their parent hypotheses and whether they have ended. The vocabulary of a
+ * hypothesis is split into chunks whose best beam_size candidates are kept
+ * by one thread each, then one thread per batch row merges the candidates of
+ * its chunks, so a step is two kernels on the cpu and the gpu alike.
+ */
+#ifndef MXNET_OPERATOR_CONTRIB_BEAM_SEARCH_INL_H_
+#define MXNET_OPERATOR_CONTRIB_BEAM_SEARCH_INL_H_
+
+#include <dmlc/parameter.h>
+#include <mxnet/operator_util.h>
+#include <vector>
+#include "../mshadow_op.h"
+#include "../mxnet_op.h"
+#include "../operator_common.h"
+#include "../elemwise_op_common.h"
+
+namespace mxnet {
+namespace op {
+
+namespace beam_search {
+enum BeamSearchInputs {kLogProb, kScore, kFinished};
+enum BeamSearchOutputs {kOutScore, kToken, kParent, kOutFinished};
+/*! \brief the number of tokens of a hypothesis a thread selects from */
+const int kChunk = 512;
+}  // namespace beam_search
+
+struct BeamSearchParam : public dmlc::Parameter<BeamSearchParam> {
+  int beam_size;
+  int eos_id;
+  DMLC_DECLARE_PARAMETER(BeamSearchParam) {
+    DMLC_DECLARE_FIELD(beam_size)
+    .set_lower_bound(1)
+    .describe("Number of hypotheses kept for each batch row.");
+    DMLC_DECLARE_FIELD(eos_id)
+    .set_default(-1)
+    .describe("The end of sequence token. A finished hypothesis is only extended by it, "
+              "with its score unchanged. -1 for none.");
+  }
+};
+
+inline bool BeamSearchShape(const nnvm::NodeAttrs& attrs,
+                            std::vector<TShape>* in_attrs,
+                            std::vector<TShape>* out_attrs) {
+  using namespace beam_search;
+  const BeamSearchParam& param = nnvm::get<BeamSearchParam>(attrs.parsed);
+  CHECK_EQ(in_attrs->size(), 3U);
+  CHECK_EQ(out_attrs->size(), 4U);
+  const TShape& dshape = (*in_attrs)[kLogProb];
+  if (dshape.ndim() == 0) return false;
+  CHECK_EQ(dshape.ndim(), 2U) << "beam_search_step takes (batch * beam_size, vocab) scores";
+  CHECK_EQ(dshape[0] % param.beam_size, 0U)
+    << "The number of hypotheses " << dshape[0] << " is not a multiple of beam_size";
+  CHECK_GE(dshape[1], static_cast<index_t>(param.beam_size))
+    << "The vocabulary is smaller than beam_size";
+  CHECK_LT(param.eos_id, static_cast<int>(dshape[1])) << "eos_id is out of the vocabulary";
+  const TShape rows = mshadow::Shape1(dshape[0]);
+  SHAPE_ASSIGN_CHECK(*in_attrs, kScore, rows);
+  SHAPE_ASSIGN_CHECK(*in_attrs, kFinished, rows);
+  for (int i = 0; i < 4; ++i) SHAPE_ASSIGN_CHECK(*out_attrs, i, rows);
+  return true;
+}
+
+/*!
+ * \brief inserts the candidate of score s and flat index i among the K best
+ *  of score and index, sorted by decreasing score then increasing index, where
+ *  the empty places have index -1
+ */
+template<typename DType>
+MSHADOW_XINLINE void InsertCandidate(DType* score, int* index, const int K,
+                                     const DType s, const int i) {
+  int j = K - 1;
+  if (index[j] >= 0 && (s < score[j] || (s == score[j] && i > index[j]))) return;
+  for (; j > 0; --j) {
+    const DType p = score[j - 1];
+    const int q = index[j - 1];
+    if (q >= 0 && (s < p || (s == p && i > q))) break;
+    score[j] = p;
+    index[j] = q;
+  }
+  score[j] = s;
+  index[j] = i;
+}
+
+/*!
+ * \brief the K best extensions of hypothesis row in the chunk c of its vocab,
+ *  with the flat index (row % K) * V + token within the batch row
+ */
+struct beam_chunk_topk {
+  static const int kCPUGrain = 1;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* cand_score, int* cand_index,
+                                  const DType* logprob, const DType* score,
+                                  const DType* finished, const int K, const int V,
+                                  const int nchunk, const int eos_id) {
+    const int row = i / nchunk, c = i % nchunk;
+    const int begin = c * beam_search::kChunk;
+    const int end = begin + beam_search::kChunk < V ? begin + beam_search::kChunk : V;
+    DType* best_score = cand_score + i * K;
+    int* best_index = cand_index + i * K;
+    for (int j = 0; j < K; ++j) best_index[j] = -1;
+    const int base = (row % K) * V;
+    if (eos_id >= 0 && finished[row] != DType(0)) {
+      if (eos_id >= begin && eos_id < end) {
+        best_score[0] = score[row];
+        best_index[0] = base + eos_id;
+      }
+      return;
+    }
+    const DType* lp = logprob + static_cast<size_t>(row) * V;
+    for (int v = begin; v < end; ++v) {
+      InsertCandidate(best_score, best_index, K, DType(score[row] + lp[v]), base + v);
+    }
+  }
+};
+
+/*! \brief merges the chunk candidates of batch row b into its K hypotheses */
+struct beam_merge {
+  static const int kCPUGrain = 1;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int b, DType* out_score, DType* token, DType* parent,
+                                  DType* out_finished, int* best_index,
+                                  const DType* cand_score, const int* cand_index,
+                                  const DType* finished, const int K, const int V,
+                                  const int nchunk, const int eos_id) {
+    DType* best_score = out_score + b * K;
+    int* best = best_index + b * K;
+    for (int j = 0; j < K; ++j) best[j] = -1;
+    const int ncand = K * nchunk * K;
+    const DType* s = cand_score + b * ncand;
+    const int* idx = cand_index + b * ncand;
+    for (int j = 0; j < ncand; ++j) {
+      if (idx[j] >= 0) InsertCandidate(best_score, best, K, s[j], idx[j]);
+    }
+    for (int j = 0; j < K; ++j) {
+      const int o = b * K + j;
+      const int t = best[j] % V, p = b * K + best[j] / V;
+      token[o] = DType(t);
+      parent[o] = DType(p);
+      out_finished[o] = DType(eos_id >= 0 && (finished[p] != DType(0) || t == eos_id));
+    }
+  }
+};
+
+template<typename xpu>
+void BeamSearchForward(const nnvm::NodeAttrs& attrs,
+                       const OpContext& ctx,
+                       const std::vector<TBlob>& inputs,
+                       const std::vector<OpReqType>& req,
+                       const std::vector<TBlob>& outputs) {
+  using namespace mshadow;
+  using namespace mxnet_op;
+  using namespace beam_search;
+  const BeamSearchParam& param = nnvm::get<BeamSearchParam>(attrs.parsed);
+  Stream<xpu> *s = ctx.get_stream<xpu>();
+  const int K = param.beam_size;
+  const int rows = inputs[kLogProb].size(0), V = inputs[kLogProb].size(1);
+  const int B = rows / K;
+  const int nchunk = (V + kChunk - 1) / kChunk;
+  const size_t ncand = static_cast<size_t>(rows) * nchunk * K;
+  MSHADOW_REAL_TYPE_SWITCH(outputs[kOutScore].type_flag_, DType, {
+    // the candidate scores, then their indices and the selected indices
+    Tensor<xpu, 1, char> workspace = ctx.requested[0].get_space_typed<xpu, 1, char>(
+        Shape1(ncand * sizeof(DType) + (ncand + rows) * sizeof(int)), s);
+    DType* cand_score = reinterpret_cast<DType*>(workspace.dptr_);
+    int* cand_index = reinterpret_cast<int*>(workspace.dptr_ + ncand * sizeof(DType));
+    int* best_index = cand_index + ncand;
+    const DType* finished = inputs[kFinished].dptr<DType>();
+    Kernel<beam_chunk_topk, xpu>::Launch(s, rows * nchunk, cand_score, cand_index,
+                                         inputs[kLogProb].dptr<DType>(),
+                                         inputs[kScore].dptr<DType>(), finished,
+                                         K, V, nchunk, param.eos_id);
+    Kernel<beam_merge, xpu>::Launch(s, B, outputs[kOutScore].dptr<DType>(),
+                                    outputs[kToken].dptr<DType>(),
+                                    outputs[kParent].dptr<DType>(),
+                                    outputs[kOutFinished].dptr<DType>(), best_index,
+                                    cand_score, cand_index, finished, K, V, nchunk,
+                                    param.eos_id);
+  });
+}
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CONTRIB_BEAM_SEARCH_INL_H_
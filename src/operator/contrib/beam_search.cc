@@ -0,0 +1,82 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file beam_search.cc
+ * \brief one step of beam search decoding
+ */
+#include "./beam_search-inl.h"
+
+namespace mxnet {
+namespace op {
+
+DMLC_REGISTER_PARAMETER(BeamSearchParam);
+
+NNVM_REGISTER_OP(_contrib_beam_search_step)
+.describe(R"code(Extends the hypotheses of a beam search by one token.
+
+*data* holds the log probabilities of the next token for the beam_size
+hypotheses of each batch row, (batch * beam_size, vocab), with the hypotheses
+of a batch row next to each other. The candidate for token v of hypothesis k
+scores score[k] + data[k, v], and the beam_size best candidates of each batch
+row, in decreasing order of score, become its new hypotheses. The ties go to
+the lower hypothesis, then the lower token.
+
+Returns, for each new hypothesis, its score, its token, the row of its parent
+hypothesis in data, and whether it has ended. A hypothesis ends with eos_id,
+and from then on is only extended by eos_id at the same score. The state of a
+decoder follows its hypotheses with take(state, parent).
+
+At the first step the hypotheses of a batch row are all the same, and all but
+one should have a score of -inf, so that the beam is not filled with copies.
+
+Example::
+
+  score, token, parent, finished = beam_search_step(log_softmax(logits), score,
+                                                    finished, beam_size=4, eos_id=2)
+  state = take(state, parent)
+
+)code" ADD_FILELINE)
+.set_num_inputs(3)
+.set_num_outputs(4)
+.set_attr_parser(ParamParser<BeamSearchParam>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::string>{"data", "score", "finished"};
+  })
+.set_attr<nnvm::FListOutputNames>("FListOutputNames",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::string>{"score", "token", "parent", "finished"};
+  })
+.set_attr<nnvm::FInferShape>("FInferShape", BeamSearchShape)
+.set_attr<nnvm::FInferType>("FInferType", ElemwiseType<3, 4>)
+.set_attr<FResourceRequest>("FResourceRequest",
+  [](const nnvm::NodeAttrs& attrs) {
+    return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
+  })
+.set_attr<nnvm::FGradient>("FGradient", MakeZeroGradNodes)
+.set_attr<FCompute>("FCompute<cpu>", BeamSearchForward<cpu>)
+.add_argument("data", "NDArray-or-Symbol",
+              "The log probabilities of the next token, (batch * beam_size, vocab).")
+.add_argument("score", "NDArray-or-Symbol", "The scores of the hypotheses.")
+.add_argument("finished", "NDArray-or-Symbol", "1 for the hypotheses that have ended, else 0.")
+.add_arguments(BeamSearchParam::__FIELDS__());
+
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,100 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file compact_bilinear-inl.h
+ * \brief compact bilinear pooling, the count sketch of the pooled outer products
+ *
+ * The pooled outer product of two feature maps of C1 and C2 channels over P
+ * positions is the C1 x C2 product X Y^T, whose count sketch with the hashes
+ * (h1[i] + h2[j]) mod out_dim and the signs s1[i] s2[j] is the compact
+ * bilinear feature. It is computed block of rows by block of rows of X Y^T
+ * with gemm, each block sketched into the output as soon as it is made, so
+ * neither the outer products of the positions nor X Y^T are built whole.
+ */
+#ifndef MXNET_OPERATOR_CONTRIB_COMPACT_BILINEAR_INL_H_
+#define MXNET_OPERATOR_CONTRIB_COMPACT_BILINEAR_INL_H_
+
+#include <dmlc/parameter.h>
+#include <mxnet/operator_util.h>
+#include <vector>
+#include "../linalg.h"
+#include "../mxnet_op.h"
+#include "../operator_common.h"
+#include "../elemwise_op_common.h"
+
+namespace mxnet {
+namespace op {
+
+namespace compact_bilinear {
+enum CompactBilinearInputs {kData1, kData2, kH1, kS1, kH2, kS2};
+/*! \brief the rows of X Y^T made by one gemm */
+const int kBlock = 32;
+}  // namespace compact_bilinear
+
+struct CompactBilinearParam : public dmlc::Parameter<CompactBilinearParam> {
+  int out_dim;
+  DMLC_DECLARE_PARAMETER(CompactBilinearParam) {
+    DMLC_DECLARE_FIELD(out_dim)
+    .set_lower_bound(1)
+    .describe("The dimension of the sketch.");
+  }
+};
+
+inline bool CompactBilinearShape(const nnvm::NodeAttrs& attrs,
+                                 std::vector<TShape>* in_attrs,
+                                 std::vector<TShape>* out_attrs) {
+  using namespace compact_bilinear;
+  const CompactBilinearParam& param = nnvm::get<CompactBilinearParam>(attrs.parsed);
+  CHECK_EQ(in_attrs->size(), 6U);
+  CHECK_EQ(out_attrs->size(), 1U);
+  const TShape& xshape = (*in_attrs)[kData1];
+  const TShape& yshape = (*in_attrs)[kData2];
+  if (xshape.ndim() == 0 || yshape.ndim() == 0) return false;
+  CHECK_GE(xshape.ndim(), 2U) << "compact_bilinear takes (batch, channel, ...) data";
+  CHECK_EQ(xshape.ndim(), yshape.ndim()) << "data1 and data2 have different dimensions";
+  CHECK_EQ(xshape[0], yshape[0]) << "data1 and data2 have different batch sizes";
+  for (index_t i = 2; i < xshape.ndim(); ++i) {
+    CHECK_EQ(xshape[i], yshape[i]) << "data1 and data2 have different positions";
+  }
+  const int channels[] = {kData1, kData1, kData2, kData2};
+  for (int i = kH1; i <= kS2; ++i) {
+    const index_t c = (*in_attrs)[channels[i - kH1]][1];
+    const TShape& hshape = (*in_attrs)[i];
+    if (hshape.ndim() == 0) {
+      SHAPE_ASSIGN_CHECK(*in_attrs, i, mshadow::Shape1(c));
+    } else {
+      CHECK_EQ(hshape.Size(), c) << "A hash or sign vector is not of the number of channels";
+    }
+  }
+  SHAPE_ASSIGN_CHECK(*out_attrs, 0, mshadow::Shape2(xshape[0], param.out_dim));
+  return true;
+}
+
+/*! \brief the sizes of a compact bilinear pooling */
+struct CompactBilinearShapes {
+  index_t N, C1, C2, P, D;
+  CompactBilinearShapes(const TBlob& x, const TBlob& y, int out_dim)
+    : N(x.size(0)), C1(x.size(1)), C2(y.size(1)),
+      P(x.shape_.ProdShape(2, x.ndim())), D(out_dim) {}
+};
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CONTRIB_COMPACT_BILINEAR_INL_H_
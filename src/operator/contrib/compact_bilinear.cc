@@ -0,0 +1,217 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file compact_bilinear.cc
+ * \brief cpu compact bilinear pooling
+ */
+#include "./compact_bilinear-inl.h"
+#include <algorithm>
+
+namespace mxnet {
+namespace op {
+
+namespace compact_bilinear {
+/*! \brief the hash of each channel, folded into [0, out_dim) */
+template<typename DType>
+inline std::vector<index_t> HashIndex(const TBlob& h, index_t D) {
+  const DType* hd = h.dptr<DType>();
+  std::vector<index_t> index(h.Size());
+  for (size_t i = 0; i < index.size(); ++i) {
+    index[i] = static_cast<index_t>(hd[i]) % D;
+  }
+  return index;
+}
+}  // namespace compact_bilinear
+
+// the threads pool whole samples, so that the sketch of a sample is scattered
+// into its own row without atomics; each block of rows of X Y^T is sketched
+// while it is in cache
+void CompactBilinearForward(const nnvm::NodeAttrs& attrs,
+                            const OpContext& ctx,
+                            const std::vector<TBlob>& inputs,
+                            const std::vector<OpReqType>& req,
+                            const std::vector<TBlob>& outputs) {
+  using namespace compact_bilinear;
+  using namespace mshadow;
+  const CompactBilinearParam& param = nnvm::get<CompactBilinearParam>(attrs.parsed);
+  if (req[0] == kNullOp) return;
+  Stream<cpu> *s = ctx.get_stream<cpu>();
+  const CompactBilinearShapes n(inputs[kData1], inputs[kData2], param.out_dim);
+  MSHADOW_SGL_DBL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
+    const DType* x = inputs[kData1].dptr<DType>();
+    const DType* y = inputs[kData2].dptr<DType>();
+    const DType* s1 = inputs[kS1].dptr<DType>();
+    const DType* s2 = inputs[kS2].dptr<DType>();
+    const std::vector<index_t> h1 = HashIndex<DType>(inputs[kH1], n.D);
+    const std::vector<index_t> h2 = HashIndex<DType>(inputs[kH2], n.D);
+    DType* out = outputs[0].dptr<DType>();
+    const int nthread = mxnet_op::KernelNumThreads(n.N, 1);
+    #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+    for (index_t b = 0; b < n.N; ++b) {
+      std::vector<DType> buf(kBlock * n.C2);
+      std::vector<DType> acc(n.D, DType(0));
+      Tensor<cpu, 2, DType> yb(const_cast<DType*>(y) + b * n.C2 * n.P, Shape2(n.C2, n.P), s);
+      for (index_t i0 = 0; i0 < n.C1; i0 += kBlock) {
+        const index_t bi = std::min<index_t>(kBlock, n.C1 - i0);
+        Tensor<cpu, 2, DType> xb(const_cast<DType*>(x) + (b * n.C1 + i0) * n.P,
+                                 Shape2(bi, n.P), s);
+        Tensor<cpu, 2, DType> prod(buf.data(), Shape2(bi, n.C2), s);
+        linalg_gemm(xb, yb, prod, DType(1), DType(0), false, true, s);
+        for (index_t i = 0; i < bi; ++i) {
+          const index_t hi = h1[i0 + i];
+          const DType si = s1[i0 + i];
+          const DType* row = buf.data() + i * n.C2;
+          for (index_t j = 0; j < n.C2; ++j) {
+            index_t k = hi + h2[j];
+            if (k >= n.D) k -= n.D;
+            acc[k] += si * s2[j] * row[j];
+          }
+        }
+      }
+      DType* o = out + b * n.D;
+      for (index_t k = 0; k < n.D; ++k) KERNEL_ASSIGN(o[k], req[0], acc[k]);
+    }
+  });
+}
+
+// the gradient of a block of rows of X Y^T is gathered from the sketch, and
+// multiplied back into the gradients of the block of X and of the whole Y
+void CompactBilinearBackward(const nnvm::NodeAttrs& attrs,
+                             const OpContext& ctx,
+                             const std::vector<TBlob>& inputs,
+                             const std::vector<OpReqType>& req,
+                             const std::vector<TBlob>& outputs) {
+  using namespace compact_bilinear;
+  using namespace mshadow;
+  const CompactBilinearParam& param = nnvm::get<CompactBilinearParam>(attrs.parsed);
+  Stream<cpu> *s = ctx.get_stream<cpu>();
+  // the inputs are the output gradient followed by the inputs of the op
+  const TBlob& ograd = inputs[0];
+  const TBlob& xdata = inputs[1 + kData1];
+  const TBlob& ydata = inputs[1 + kData2];
+  const CompactBilinearShapes n(xdata, ydata, param.out_dim);
+  MSHADOW_SGL_DBL_TYPE_SWITCH(ograd.type_flag_, DType, {
+    for (int i = kH1; i <= kS2; ++i) {
+      if (req[i] == kWriteTo || req[i] == kWriteInplace) {
+        outputs[i].FlatTo1D<cpu, DType>(s) = DType(0);
+      }
+    }
+    const OpReqType xreq = req[kData1], yreq = req[kData2];
+    if (xreq == kNullOp && yreq == kNullOp) return;
+    const DType* g = ograd.dptr<DType>();
+    DType* x = xdata.dptr<DType>();
+    DType* y = ydata.dptr<DType>();
+    const DType* s1 = inputs[1 + kS1].dptr<DType>();
+    const DType* s2 = inputs[1 + kS2].dptr<DType>();
+    const std::vector<index_t> h1 = HashIndex<DType>(inputs[1 + kH1], n.D);
+    const std::vector<index_t> h2 = HashIndex<DType>(inputs[1 + kH2], n.D);
+    DType* dx = outputs[kData1].dptr<DType>();
+    DType* dy = outputs[kData2].dptr<DType>();
+    const int nthread = mxnet_op::KernelNumThreads(n.N, 1);
+    #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+    for (index_t b = 0; b < n.N; ++b) {
+      std::vector<DType> buf(kBlock * n.C2);
+      const DType* gb = g + b * n.D;
+      Tensor<cpu, 2, DType> yb(y + b * n.C2 * n.P, Shape2(n.C2, n.P), s);
+      Tensor<cpu, 2, DType> dyb(dy + b * n.C2 * n.P, Shape2(n.C2, n.P), s);
+      for (index_t i0 = 0; i0 < n.C1; i0 += kBlock) {
+        const index_t bi = std::min<index_t>(kBlock, n.C1 - i0);
+        for (index_t i = 0; i < bi; ++i) {
+          const index_t hi = h1[i0 + i];
+          const DType si = s1[i0 + i];
+          DType* row = buf.data() + i * n.C2;
+          for (index_t j = 0; j < n.C2; ++j) {
+            index_t k = hi + h2[j];
+            if (k >= n.D) k -= n.D;
+            row[j] = si * s2[j] * gb[k];
+          }
+        }
+        Tensor<cpu, 2, DType> grad(buf.data(), Shape2(bi, n.C2), s);
+        if (xreq != kNullOp) {
+          Tensor<cpu, 2, DType> dxb(dx + (b * n.C1 + i0) * n.P, Shape2(bi, n.P), s);
+          linalg_gemm(grad, yb, dxb, DType(1), DType(xreq == kAddTo ? 1 : 0),
+                      false, false, s);
+        }
+        if (yreq != kNullOp) {
+          Tensor<cpu, 2, DType> xb(x + (b * n.C1 + i0) * n.P, Shape2(bi, n.P), s);
+          linalg_gemm(grad, xb, dyb, DType(1), DType(i0 > 0 || yreq == kAddTo ? 1 : 0),
+                      true, false, s);
+        }
+      }
+    }
+  });
+}
+
+DMLC_REGISTER_PARAMETER(CompactBilinearParam);
+
+NNVM_REGISTER_OP(_contrib_compact_bilinear)
+.describe(R"code(Computes the compact bilinear pooling of two feature maps.
+
+The bilinear pooling of *data1*, (batch, C1, ...), and *data2*, (batch, C2, ...),
+over their positions is the C1 x C2 sum of the outer products of their features
+at each position. The compact bilinear feature is its count sketch into out_dim
+bins, with the hash (h1[i] + h2[j]) mod out_dim and the sign s1[i] * s2[j] for
+the pair of channels i, j, which is the circular convolution of the count
+sketches of the two features. Each element of *h1* and *h2* is an integer from 0
+to out_dim - 1, and each element of *s1* and *s2* is either +1 or -1.
+
+The outer products are never made whole: the C1 x C2 pooling is multiplied out a
+block of rows at a time, and each block is sketched into the output at once.
+The operator is only available on CPU; on GPU, count_sketch and fft give the
+same feature.
+
+Example::
+
+  out = compact_bilinear(data1, data2, h1, s1, h2, s2, out_dim=8192)
+
+)code" ADD_FILELINE)
+.set_num_inputs(6)
+.set_num_outputs(1)
+.set_attr_parser(ParamParser<CompactBilinearParam>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::string>{"data1", "data2", "h1", "s1", "h2", "s2"};
+  })
+.set_attr<nnvm::FInferShape>("FInferShape", CompactBilinearShape)
+.set_attr<nnvm::FInferType>("FInferType", ElemwiseType<6, 1>)
+.set_attr<FCompute>("FCompute<cpu>", CompactBilinearForward)
+.set_attr<nnvm::FGradient>("FGradient",
+  [](const nnvm::NodePtr& n, const std::vector<nnvm::NodeEntry>& ograds) {
+    std::vector<nnvm::NodeEntry> heads{ograds[0]};
+    heads.insert(heads.end(), n->inputs.begin(), n->inputs.end());
+    return MakeGradNode("_backward_contrib_compact_bilinear", n, heads, n->attrs.dict);
+  })
+.add_argument("data1", "NDArray-or-Symbol", "The first feature map, (batch, C1, ...).")
+.add_argument("data2", "NDArray-or-Symbol", "The second feature map, (batch, C2, ...).")
+.add_argument("h1", "NDArray-or-Symbol", "The hash of each channel of data1.")
+.add_argument("s1", "NDArray-or-Symbol", "The sign of each channel of data1.")
+.add_argument("h2", "NDArray-or-Symbol", "The hash of each channel of data2.")
+.add_argument("s2", "NDArray-or-Symbol", "The sign of each channel of data2.")
+.add_arguments(CompactBilinearParam::__FIELDS__());
+
+NNVM_REGISTER_OP(_backward_contrib_compact_bilinear)
+.set_num_inputs(7)
+.set_num_outputs(6)
+.set_attr_parser(ParamParser<CompactBilinearParam>)
+.set_attr<nnvm::TIsBackward>("TIsBackward", true)
+.set_attr<FCompute>("FCompute<cpu>", CompactBilinearBackward);
+
+}  // namespace op
+}  // namespace mxnet
@@ -23,13 +23,89 @@
  * \author Chen Zhu
 */
 #include "./count_sketch-inl.h"
+#include <algorithm>
+#include <climits>
+#include <vector>
+#include "../mxnet_op.h"
+
+namespace mshadow {
+/*! \brief keys the OpenMP grain of the cpu count sketch */
+struct CountSketchCPUGrain {};
+
+inline int CountSketchNumThreads(const int n_samples, const int in_dim) {
+  const int nthread = mxnet::op::mxnet_op::KernelNumThreads(
+      static_cast<int>(std::min<size_t>(static_cast<size_t>(n_samples) * in_dim, INT_MAX)),
+      mxnet::op::mxnet_op::KernelGrain<CountSketchCPUGrain>::Get());
+  return std::min(nthread, n_samples);
+}
+
+template<typename DType>
+inline std::vector<int> CountSketchIndex(const Tensor<cpu, 1, DType> &h, const int in_dim) {
+  std::vector<int> index(in_dim);
+  for (int i = 0; i < in_dim; ++i) index[i] = static_cast<int>(h.dptr_[i]);
+  return index;
+}
+
+// the threads sketch whole samples, so that the scatter into a row of out
+// needs no atomics, and the processing batches of the gpu are not needed
+template<typename DType>
+inline void CountSketchForward(const Tensor<cpu, 2, DType> &out,
+                               const Tensor<cpu, 2, DType> &in,
+                               const Tensor<cpu, 1, DType> &h,
+                               const Tensor<cpu, 1, DType> &s,
+                               const int n_samples,
+                               const int processing_batch_size,
+                               const int in_dim,
+                               const int out_dim) {
+  const std::vector<int> index = CountSketchIndex(h, in_dim);
+  const int nthread = CountSketchNumThreads(n_samples, in_dim);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int n = 0; n < n_samples; ++n) {
+    const DType* x = in.dptr_ + static_cast<size_t>(n) * in_dim;
+    DType* o = out.dptr_ + static_cast<size_t>(n) * out_dim;
+    for (int i = 0; i < in_dim; ++i) o[index[i]] += s.dptr_[i] * x[i];
+  }
+}
+
+// a gather of each row of out_grad, which the compiler vectorizes
+template<typename DType>
+inline void CountSketchBackward(const Tensor<cpu, 2, DType> &in_grad,
+                                const Tensor<cpu, 2, DType> &out_grad,
+                                const Tensor<cpu, 1, DType> &h,
+                                const Tensor<cpu, 1, DType> &s,
+                                const int n_samples,
+                                const int processing_batch_size,
+                                const int in_dim,
+                                const int out_dim) {
+  const std::vector<int> index = CountSketchIndex(h, in_dim);
+  const int* idx = index.data();
+  const int nthread = CountSketchNumThreads(n_samples, in_dim);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int n = 0; n < n_samples; ++n) {
+    const DType* g = out_grad.dptr_ + static_cast<size_t>(n) * out_dim;
+    DType* dx = in_grad.dptr_ + static_cast<size_t>(n) * in_dim;
+    for (int i = 0; i < in_dim; ++i) dx[i] = g[idx[i]] * s.dptr_[i];
+  }
+}
+}  // namespace mshadow
+
 namespace mxnet {
 namespace op {
 
 template<>
 Operator *CreateOp<cpu>(CountSketchParam param, int dtype) {
-    LOG(FATAL) << "CountSketch is only available for GPU.";
-    return NULL;
+  Operator *op = NULL;
+  switch (dtype) {
+    case mshadow::kFloat32:
+      op = new CountSketchOp<cpu, float>(param);
+      break;
+    case mshadow::kFloat64:
+      op = new CountSketchOp<cpu, double>(param);
+      break;
+    default:
+      LOG(FATAL) << "Unsupported type " << dtype;
+  }
+  return op;
 }
 Operator *CountSketchProp::CreateOperatorEx(Context ctx, std::vector<TShape> *in_shape,
                                             std::vector<int> *in_type) const {
@@ -44,8 +120,6 @@ DMLC_REGISTER_PARAMETER(CountSketchParam);
 MXNET_REGISTER_OP_PROPERTY(_contrib_count_sketch, CountSketchProp)
 .describe(R"code(Apply CountSketch to input: map a d-dimension data to k-dimension data"
 
-.. note:: `count_sketch` is only available on GPU.
-
 Assume input data has shape (N, d), sign hash table s has shape (N, d),
 index hash table h has shape (N, d) and mapping dimension out_dim = k,
 each element in s is either +1 or -1, each element in h is random integer from 0 to k-1.
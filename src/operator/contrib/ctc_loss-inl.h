@@ -45,7 +45,7 @@ namespace mxnet {
 namespace op {
 
 namespace ctc_loss {
-enum CTCLossOpInputs { kData, kLabel };
+enum CTCLossOpInputs { kData, kLabel, kDataLength };
 enum CTCLossOpOutputs { kOut, kGrad };
 enum CTCLossOpForwardResource { kTempSpace };
 }
@@ -126,9 +126,11 @@ inline void get_workspace_size(std::vector<int> *label_lengths,
 
 // Takes a tensor of labels, and interprets 0-elements at the end of the vector
 // as padding. The tensor is packed into a std::vector without padding
-// characters. The sequence lengths are also inferred from the padding chars
+// characters. The sequence lengths are also inferred from the padding chars,
+// unless lengths gives them
 template <typename DType, typename xpu>
 inline void LabelTensorToPackedVector(mshadow::Tensor<xpu, 2, DType> labels,
+                                      const DType *lengths,
                                       std::vector<int> *packed_labels,
                                       std::vector<int> *label_lengths) {
   int batch = labels.size(0);
@@ -137,8 +139,13 @@ inline void LabelTensorToPackedVector(mshadow::Tensor<xpu, 2, DType> labels,
 
   for (int b = 0; b < batch; ++b) {
     IndexTensorToVector(labels[b], &cpu_labels);
-    auto res = std::find(cpu_labels.begin(), cpu_labels.end(), 0);
-    int len = std::distance(cpu_labels.begin(), res);
+    int len;
+    if (lengths != nullptr) {
+      len = std::min(std::max(static_cast<int>(lengths[b]), 0), max_num_labels);
+    } else {
+      auto res = std::find(cpu_labels.begin(), cpu_labels.end(), 0);
+      len = std::distance(cpu_labels.begin(), res);
+    }
     std::copy(cpu_labels.begin(), cpu_labels.begin() + len,
               std::back_inserter(*packed_labels));
     label_lengths->emplace_back(len);
@@ -146,9 +153,38 @@ inline void LabelTensorToPackedVector(mshadow::Tensor<xpu, 2, DType> labels,
 }
 
 struct CTCLossParam : public dmlc::Parameter<CTCLossParam> {
-  DMLC_DECLARE_PARAMETER(CTCLossParam) {}
+  bool use_data_lengths;
+  bool use_label_lengths;
+  DMLC_DECLARE_PARAMETER(CTCLossParam) {
+    DMLC_DECLARE_FIELD(use_data_lengths).set_default(false)
+      .describe("Whether the data lengths are given. The timesteps after the length of a "
+                "sequence are skipped, and get a zero gradient.");
+    DMLC_DECLARE_FIELD(use_label_lengths).set_default(false)
+      .describe("Whether the label lengths are given, rather than taken from the 0 "
+                "padding of the labels.");
+  }
 };
 
+/*! \brief the index of the label lengths among the inputs */
+inline int CTCLabelLengthIndex(const CTCLossParam &param) {
+  return ctc_loss::kDataLength + param.use_data_lengths;
+}
+
+/*!
+ * \brief the cost of each sequence, and its gradient if train is set. The
+ *  lengths are null, or device pointers to the length of each sequence
+ */
+void CTCLossForward(mshadow::Stream<cpu> *s, const mshadow::Tensor<cpu, 3, real_t> &data,
+                    const mshadow::Tensor<cpu, 2, real_t> &labels, const real_t *data_lengths,
+                    const real_t *label_lengths, mshadow::Tensor<cpu, 1, real_t> costs,
+                    mshadow::Tensor<cpu, 3, real_t> grad, const Resource &workspace,
+                    bool train);
+void CTCLossForward(mshadow::Stream<gpu> *s, const mshadow::Tensor<gpu, 3, real_t> &data,
+                    const mshadow::Tensor<gpu, 2, real_t> &labels, const real_t *data_lengths,
+                    const real_t *label_lengths, mshadow::Tensor<gpu, 1, real_t> costs,
+                    mshadow::Tensor<gpu, 3, real_t> grad, const Resource &workspace,
+                    bool train);
+
 template <typename xpu>
 class CTCLossOp : public Operator {
  public:
@@ -160,7 +196,7 @@ class CTCLossOp : public Operator {
                        const std::vector<TBlob> &aux_args) {
     using namespace mshadow;
     using namespace mshadow::expr;
-    CHECK_EQ(in_data.size(), 2U);
+    CHECK_EQ(in_data.size(), 2U + param_.use_data_lengths + param_.use_label_lengths);
     CHECK_EQ(out_data.size(), 2U);
     Stream<xpu> *s = ctx.get_stream<xpu>();
 
@@ -174,31 +210,12 @@ class CTCLossOp : public Operator {
     Tensor<xpu, 3, real_t> grad =
         out_data[ctc_loss::kGrad].get<xpu, 3, real_t>(s);
 
-    int max_seq_len = data.size(0);
-    int batch_size = data.size(1);
-    int alphabet_size = data.size(2);
-
-    // label_lengths
-    std::vector<int> packed_labels;
-    std::vector<int> label_lengths;
-    LabelTensorToPackedVector(labels, &packed_labels, &label_lengths);
-
-    // allocate temporary workspace
-    std::vector<int> input_lengths(batch_size, max_seq_len);
-    size_t size_bytes;
-    bool gpu = data.kDevCPU ? false : true;
-    get_workspace_size<real_t>(&label_lengths, &input_lengths, alphabet_size,
-                               batch_size, gpu, &size_bytes);
-
-    // round-up so there are enough elems in memory
-    int num_tmp_elems = (size_bytes + sizeof(real_t) - 1) / sizeof(real_t);
-    Tensor<xpu, 1, real_t> workspace =
-        ctx.requested[ctc_loss::kTempSpace].get_space_typed<xpu, 1, real_t>(
-            Shape1(num_tmp_elems), s);
-
-    compute_ctc_cost(data, costs.dptr_, grad.dptr_, packed_labels.data(),
-                     label_lengths.data(), input_lengths.data(),
-                     workspace.dptr_, ctx.is_train);
+    const real_t *data_lengths = param_.use_data_lengths ?
+        in_data[ctc_loss::kDataLength].dptr<real_t>() : nullptr;
+    const real_t *label_lengths = param_.use_label_lengths ?
+        in_data[CTCLabelLengthIndex(param_)].dptr<real_t>() : nullptr;
+    CTCLossForward(s, data, labels, data_lengths, label_lengths, costs, grad,
+                   ctx.requested[ctc_loss::kTempSpace], ctx.is_train);
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -240,7 +257,10 @@ class CTCLossProp : public OperatorProperty {
   int NumOutputs() const override { return 2; }
 
   std::vector<std::string> ListArguments() const override {
-    return {"data", "label"};
+    std::vector<std::string> args = {"data", "label"};
+    if (param_.use_data_lengths) args.emplace_back("data_lengths");
+    if (param_.use_label_lengths) args.emplace_back("label_lengths");
+    return args;
   }
 
   std::vector<std::string> ListOutputs() const override {
@@ -259,7 +279,8 @@ class CTCLossProp : public OperatorProperty {
   bool InferShape(std::vector<TShape> *in_shape, std::vector<TShape> *out_shape,
                   std::vector<TShape> *aux_shape) const override {
     using namespace mshadow;
-    CHECK_EQ(in_shape->size(), 2U) << "Expect two inputs to the symbol.";
+    CHECK_EQ(in_shape->size(), ListArguments().size())
+        << "Expect " << ListArguments().size() << " inputs to the symbol.";
 
     const TShape &dshape = (*in_shape)[ctc_loss::kData];
     const TShape &lshape = (*in_shape)[ctc_loss::kLabel];
@@ -271,6 +292,12 @@ class CTCLossProp : public OperatorProperty {
     CHECK_GE(dshape[0], lshape[1]) << "The max number of labels cannot exceed "
                                       "the maximum sequence length of the "
                                       "input.";
+    if (param_.use_data_lengths) {
+      SHAPE_ASSIGN_CHECK(*in_shape, ctc_loss::kDataLength, Shape1(dshape[1]));
+    }
+    if (param_.use_label_lengths) {
+      SHAPE_ASSIGN_CHECK(*in_shape, CTCLabelLengthIndex(param_), Shape1(dshape[1]));
+    }
 
     TShape oshape(1);
     oshape[0] = dshape[1];  // batch size
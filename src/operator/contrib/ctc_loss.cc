@@ -49,6 +49,46 @@ ctcStatus_t compute_ctc_cost(const Tensor<cpu, 3, DType> activations,
 
 namespace mxnet {
 namespace op {
+
+void CTCLossForward(mshadow::Stream<cpu> *s, const mshadow::Tensor<cpu, 3, real_t> &data,
+                    const mshadow::Tensor<cpu, 2, real_t> &labels, const real_t *data_lengths,
+                    const real_t *label_lengths, mshadow::Tensor<cpu, 1, real_t> costs,
+                    mshadow::Tensor<cpu, 3, real_t> grad, const Resource &workspace,
+                    bool train) {
+  using namespace mshadow;
+  int max_seq_len = data.size(0);
+  int batch_size = data.size(1);
+  int alphabet_size = data.size(2);
+
+  // label_lengths
+  std::vector<int> packed_labels;
+  std::vector<int> lengths;
+  LabelTensorToPackedVector(labels, label_lengths, &packed_labels, &lengths);
+
+  std::vector<int> input_lengths(batch_size, max_seq_len);
+  if (data_lengths != nullptr) {
+    for (int b = 0; b < batch_size; ++b) {
+      input_lengths[b] = std::min(std::max(static_cast<int>(data_lengths[b]), 0), max_seq_len);
+    }
+  }
+
+  // allocate temporary workspace
+  size_t size_bytes;
+  get_workspace_size<real_t>(&lengths, &input_lengths, alphabet_size,
+                             batch_size, false, &size_bytes);
+
+  // round-up so there are enough elems in memory
+  int num_tmp_elems = (size_bytes + sizeof(real_t) - 1) / sizeof(real_t);
+  Tensor<cpu, 1, real_t> tmp = workspace.get_space_typed<cpu, 1, real_t>(
+      Shape1(num_tmp_elems), s);
+
+  // the padded timesteps, and the sequences too short for their labels, are
+  // not written
+  if (train) grad = 0.0f;
+  compute_ctc_cost(data, costs.dptr_, grad.dptr_, packed_labels.data(),
+                   lengths.data(), input_lengths.data(), tmp.dptr_, train);
+}
+
 template <>
 Operator *CreateOp<cpu>(CTCLossParam param, int dtype) {
   return new CTCLossOp<cpu>(param);
@@ -74,6 +114,8 @@ The shapes of the inputs and outputs:
 
 - **data**: *(sequence_length, batch_size, alphabet_size + 1)*
 - **label**: *(batch_size, label_sequence_length)*
+- **data_lengths**: *(batch_size)*, with ``use_data_lengths``
+- **label_lengths**: *(batch_size)*, with ``use_label_lengths``
 - **out**: *(batch_size)*.
 
 ``label`` is a tensor of integers between 1 and *alphabet_size*. If a
@@ -90,6 +132,11 @@ applies a softmax to each vector, which then becomes a vector of probabilities
 over the alphabet. Note that the 0th element of this vector is reserved for the
 special blank character.
 
+With ``use_data_lengths``, sequence ``b`` only has its first
+``data_lengths[b]`` timesteps; the rest are skipped and get a zero gradient.
+With ``use_label_lengths``, the labels of sequence ``b`` are its first
+``label_lengths[b]`` labels, instead of the labels before the first 0.
+
 ``out`` is a list of CTC loss values, one per example in the batch.
 
 See *Connectionist Temporal Classification: Labelling Unsegmented
@@ -100,6 +147,10 @@ information.
     .add_argument("data", "NDArray-or-Symbol", "Input data to the ctc_loss op.")
     .add_argument("label", "NDArray-or-Symbol",
                   "Ground-truth labels for the loss.")
+    .add_argument("data_lengths", "NDArray-or-Symbol",
+                  "The number of timesteps of each sequence, with use_data_lengths.")
+    .add_argument("label_lengths", "NDArray-or-Symbol",
+                  "The number of labels of each sequence, with use_label_lengths.")
     .add_arguments(CTCLossParam::__FIELDS__());
 
 NNVM_REGISTER_OP(_contrib_CTCLoss).add_alias("_contrib_ctc_loss");
@@ -24,34 +24,193 @@
 */
 #include <algorithm>
 #include "./ctc_loss-inl.h"
-#include "./ctc_include/detail/gpu_ctc.h"
-
-namespace mshadow {
-
-template <typename DType>
-ctcStatus_t compute_ctc_cost(const Tensor<gpu, 3, DType> activations,
-                             DType *costs, DType *grads, int *labels,
-                             int *label_lengths, int *input_lengths,
-                             void *workspace, int train) {
-  int minibatch = static_cast<int>(activations.size(1));
-  int alphabet_size = static_cast<int>(activations.size(2));
-  int blank_label = 0;
-  mxnet_warpctc::GpuCTC<DType> ctc(alphabet_size, minibatch, workspace,
-                    activations.stream_->stream_, blank_label);
-  if (train)
-    return ctc.cost_and_grad(activations.dptr_, grads, costs, labels,
-                             label_lengths, input_lengths);
-  else
-    return ctc.score_forward(activations.dptr_, costs, labels,
-                             label_lengths, input_lengths);
+#include "./ctc_include/detail/ctc_helper.h"
+
+namespace mxnet {
+namespace op {
+
+/*!
+ * The gpu loss runs in log space with one block for each sequence, whose
+ * threads split the 2 * L + 1 states of its labels with blanks. The labels
+ * and the lengths are read on the device, so nothing is copied to the host
+ * and the loss does not synchronize with the stream; the blocks of the short
+ * sequences end at their lengths.
+ */
+const int kCTCThreads = 128;
+
+/*! \brief the sum, or the max, of v over the threads of the block */
+template<bool kMax>
+__device__ real_t CTCBlockReduce(real_t v, real_t *smem) {
+  smem[threadIdx.x] = v;
+  __syncthreads();
+  for (int n = kCTCThreads / 2; n > 0; n >>= 1) {
+    if (threadIdx.x < n) {
+      const real_t o = smem[threadIdx.x + n];
+      smem[threadIdx.x] = kMax ? fmaxf(smem[threadIdx.x], o) : smem[threadIdx.x] + o;
+    }
+    __syncthreads();
+  }
+  const real_t ret = smem[0];
+  __syncthreads();
+  return ret;
 }
 
-}  // namespace mshadow
+__device__ inline int CTCLength(const real_t *lengths, const int b, const int max_length) {
+  if (lengths == nullptr) return max_length;
+  const int len = static_cast<int>(lengths[b]);
+  return len < 0 ? 0 : (len > max_length ? max_length : len);
+}
 
-////////////////////////////////////////////////////////////////////////////////
+/*! \brief the log of the softmax denominator of each (timestep, sequence) */
+__global__ void CTCLogSumExpKernel(const real_t *data, const real_t *data_lengths,
+                                   const int max_seq_len, const int batch,
+                                   const int alphabet_size, real_t *lse) {
+  __shared__ real_t smem[kCTCThreads];
+  const int t = blockIdx.x / batch, b = blockIdx.x % batch;
+  if (t >= CTCLength(data_lengths, b, max_seq_len)) return;
+  const real_t *col = data + static_cast<size_t>(blockIdx.x) * alphabet_size;
+  real_t m = -INFINITY;
+  for (int k = threadIdx.x; k < alphabet_size; k += kCTCThreads) m = fmaxf(m, col[k]);
+  m = CTCBlockReduce<true>(m, smem);
+  real_t sum = 0;
+  for (int k = threadIdx.x; k < alphabet_size; k += kCTCThreads) sum += expf(col[k] - m);
+  sum = CTCBlockReduce<false>(sum, smem);
+  if (threadIdx.x == 0) lse[blockIdx.x] = m + logf(sum);
+}
+
+/*!
+ * \brief the cost of sequence blockIdx.x, 0 if its labels do not fit in its
+ *  timesteps, and the gradient of its activations when grad is not null.
+ *  alphas holds max_seq_len x (2 * max_labels + 1) states for each sequence,
+ *  betas two rows of them.
+ */
+__global__ void CTCLossKernel(const real_t *data, const real_t *labels,
+                              const real_t *data_lengths, const real_t *label_lengths,
+                              const real_t *lse, const int max_seq_len, const int batch,
+                              const int alphabet_size, const int max_labels,
+                              real_t *alphas, real_t *betas, real_t *costs, real_t *grad) {
+  ctc_helper::log_plus<real_t> log_plus;
+  __shared__ real_t smem[kCTCThreads];
+  __shared__ int label_len;
+  const int b = blockIdx.x, tid = threadIdx.x;
+  const int T = CTCLength(data_lengths, b, max_seq_len);
+  const real_t *label = labels + static_cast<size_t>(b) * max_labels;
+  if (label_lengths != nullptr) {
+    if (tid == 0) label_len = CTCLength(label_lengths, b, max_labels);
+  } else {
+    // the labels end at the first 0
+    if (tid == 0) label_len = max_labels;
+    __syncthreads();
+    for (int l = tid; l < max_labels; l += kCTCThreads) {
+      if (static_cast<int>(label[l]) == 0) atomicMin(&label_len, l);
+    }
+  }
+  __syncthreads();
+  const int S = 2 * label_len + 1, stride = 2 * max_labels + 1;
+  // the label of state s, blank for the even states
+  auto lab = [label](const int s) { return (s & 1) ? static_cast<int>(label[s / 2]) : 0; };
+  auto logy = [=](const int t, const int s) {
+    const size_t col = static_cast<size_t>(t) * batch + b;
+    return data[col * alphabet_size + lab(s)] - lse[col];
+  };
+  real_t *alpha = alphas + static_cast<size_t>(b) * max_seq_len * stride;
+  for (int s = tid; s < S && T > 0; s += kCTCThreads) {
+    alpha[s] = s < 2 ? logy(0, s) : -INFINITY;
+  }
+  __syncthreads();
+  for (int t = 1; t < T; ++t) {
+    const real_t *prev = alpha + static_cast<size_t>(t - 1) * stride;
+    real_t *cur = alpha + static_cast<size_t>(t) * stride;
+    for (int s = tid; s < S; s += kCTCThreads) {
+      real_t a = prev[s];
+      if (s > 0) a = log_plus(a, prev[s - 1]);
+      if (s > 1 && lab(s) != lab(s - 2)) a = log_plus(a, prev[s - 2]);
+      cur[s] = a + logy(t, s);
+    }
+    __syncthreads();
+  }
+  real_t log_p;
+  if (T == 0) {
+    log_p = S == 1 ? 0 : -INFINITY;
+  } else {
+    const real_t *last = alpha + static_cast<size_t>(T - 1) * stride;
+    log_p = S > 1 ? log_plus(last[S - 1], last[S - 2]) : last[0];
+  }
+  const bool valid = log_p > -INFINITY;
+  if (tid == 0) costs[b] = valid ? -log_p : 0;
+  if (grad == nullptr) return;
+  // the padded timesteps, and all of them if the labels do not fit, get no gradient
+  for (int t = valid ? T : 0; t < max_seq_len; ++t) {
+    real_t *g = grad + (static_cast<size_t>(t) * batch + b) * alphabet_size;
+    for (int k = tid; k < alphabet_size; k += kCTCThreads) g[k] = 0;
+  }
+  if (!valid) return;
+  real_t *beta = betas + static_cast<size_t>(b) * 2 * stride;
+  for (int t = T - 1; t >= 0; --t) {
+    const size_t col = static_cast<size_t>(t) * batch + b;
+    const real_t *act = data + col * alphabet_size;
+    real_t *g = grad + col * alphabet_size;
+    for (int k = tid; k < alphabet_size; k += kCTCThreads) g[k] = expf(act[k] - lse[col]);
+    __syncthreads();
+    const real_t *next = beta + ((t + 1) & 1) * stride;
+    real_t *cur = beta + (t & 1) * stride;
+    const real_t *a = alpha + static_cast<size_t>(t) * stride;
+    real_t blank = 0;
+    for (int s = tid; s < S; s += kCTCThreads) {
+      const real_t y = logy(t, s);
+      real_t v;
+      if (t == T - 1) {
+        v = s >= S - 2 ? y : -INFINITY;
+      } else {
+        v = next[s];
+        if (s + 1 < S) v = log_plus(v, next[s + 1]);
+        if (s + 2 < S && lab(s + 2) != lab(s)) v = log_plus(v, next[s + 2]);
+        v += y;
+      }
+      cur[s] = v;
+      // the posterior of state s at t
+      const real_t occupancy = expf(a[s] + v - y - log_p);
+      const int k = lab(s);
+      if (k == 0) {
+        blank += occupancy;
+      } else {
+        atomicAdd(g + k, -occupancy);
+      }
+    }
+    blank = CTCBlockReduce<false>(blank, smem);
+    if (tid == 0) g[0] -= blank;
+    __syncthreads();
+  }
+}
+
+void CTCLossForward(mshadow::Stream<gpu> *s, const mshadow::Tensor<gpu, 3, real_t> &data,
+                    const mshadow::Tensor<gpu, 2, real_t> &labels, const real_t *data_lengths,
+                    const real_t *label_lengths, mshadow::Tensor<gpu, 1, real_t> costs,
+                    mshadow::Tensor<gpu, 3, real_t> grad, const Resource &workspace,
+                    bool train) {
+  using namespace mshadow;
+  const int max_seq_len = data.size(0), batch = data.size(1), alphabet_size = data.size(2);
+  const int max_labels = labels.size(1);
+  if (batch == 0) return;
+  const size_t stride = 2 * max_labels + 1;
+  const size_t num_cols = static_cast<size_t>(max_seq_len) * batch;
+  Tensor<gpu, 1, real_t> tmp = workspace.get_space_typed<gpu, 1, real_t>(
+      Shape1(num_cols + num_cols * stride + 2 * batch * stride), s);
+  real_t *lse = tmp.dptr_;
+  real_t *alphas = lse + num_cols;
+  real_t *betas = alphas + num_cols * stride;
+  cudaStream_t stream = Stream<gpu>::GetStream(s);
+  if (num_cols > 0) {
+    CTCLogSumExpKernel<<<num_cols, kCTCThreads, 0, stream>>>(
+        data.dptr_, data_lengths, max_seq_len, batch, alphabet_size, lse);
+    MSHADOW_CUDA_POST_KERNEL_CHECK(CTCLogSumExpKernel);
+  }
+  CTCLossKernel<<<batch, kCTCThreads, 0, stream>>>(
+      data.dptr_, labels.dptr_, data_lengths, label_lengths, lse, max_seq_len, batch,
+      alphabet_size, max_labels, alphas, betas, costs.dptr_, train ? grad.dptr_ : nullptr);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(CTCLossKernel);
+}
 
-namespace mxnet {
-namespace op {
 template <>
 Operator *CreateOp<gpu>(CTCLossParam param, int dtype) {
   return new CTCLossOp<gpu>(param);
@@ -0,0 +1,147 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*!
+ * \file cufft_plan-inl.h
+ * \brief the cufft plans of fft and ifft, kept by the operator, and the
+ *  real transforms they are built on
+ */
+#ifndef MXNET_OPERATOR_CONTRIB_CUFFT_PLAN_INL_H_
+#define MXNET_OPERATOR_CONTRIB_CUFFT_PLAN_INL_H_
+#include <dmlc/logging.h>
+#include <map>
+#include <tuple>
+#include "../mxnet_op.h"
+
+#if MXNET_USE_CUDA
+#include <cufft.h>
+
+namespace mxnet {
+namespace op {
+namespace fft {
+
+/*!
+ * \brief completes the rows of n complex values whose first n / 2 + 1 values
+ *  are those of an R2C transform, by the symmetry out[k] = conj(out[n - k])
+ */
+struct hermitian_fill {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const int n) {
+    const int m = n - n / 2 - 1;
+    const int k = n / 2 + 1 + i % m;
+    DType* row = out + 2 * static_cast<int64_t>(i / m) * n;
+    row[2 * k] = row[2 * (n - k)];
+    row[2 * k + 1] = -row[2 * (n - k) + 1];
+  }
+};
+
+/*!
+ * \brief the first n / 2 + 1 values of the hermitian part (x[k] + conj(x[n - k])) / 2
+ *  of the rows of n complex values, whose C2R transform is the real part of
+ *  the inverse transform of the rows
+ */
+struct hermitian_part {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const DType* x, const int n) {
+    const int m = n / 2 + 1;
+    const int k = i % m;
+    const int kc = (n - k) % n;
+    const DType* row = x + 2 * static_cast<int64_t>(i / m) * n;
+    out[2 * i] = DType(0.5f) * (row[2 * k] + row[2 * kc]);
+    out[2 * i + 1] = DType(0.5f) * (row[2 * k + 1] - row[2 * kc + 1]);
+  }
+};
+
+/*!
+ * \brief the plans an operator has made, one per transform type, layout and
+ *  batch size, so that the plans are made at the first call rather than
+ *  at every call. The plans of an operator are run on its stream only
+ */
+class CuFFTPlans {
+ public:
+  CuFFTPlans() {}
+  CuFFTPlans(const CuFFTPlans&) = delete;
+  CuFFTPlans& operator=(const CuFFTPlans&) = delete;
+  ~CuFFTPlans() {
+    for (auto& p : plans_) cufftDestroy(p.second);
+  }
+
+  /*!
+   * \brief the plan of batch transforms of size n, the rows of the input and
+   *  the output idist and odist values apart
+   */
+  cufftHandle Get(cufftType type, int n, int idist, int odist, int batch,
+                  cudaStream_t stream) {
+    const auto key = std::make_tuple(static_cast<int>(type), n, idist, odist, batch);
+    auto it = plans_.find(key);
+    if (it == plans_.end()) {
+      cufftHandle plan;
+      int size = n;
+      int inembed = idist;
+      int onembed = odist;
+      CHECK_EQ(cufftPlanMany(&plan, 1, &size, &inembed, 1, idist, &onembed, 1, odist,
+                             type, batch), CUFFT_SUCCESS) << "cufftPlanMany failed";
+      it = plans_.emplace(key, plan).first;
+    }
+    CHECK_EQ(cufftSetStream(it->second, stream), CUFFT_SUCCESS);
+    return it->second;
+  }
+
+ private:
+  std::map<std::tuple<int, int, int, int, int>, cufftHandle> plans_;
+};
+
+/*!
+ * \brief out = the transforms of the batch real rows of n values of data, as
+ *  rows of n complex values. The R2C transform writes the first half of the
+ *  rows of out and the rest follows by symmetry, so data is not padded
+ */
+template<typename xpu, typename DType>
+inline void RealFFT(CuFFTPlans* plans, mshadow::Stream<xpu>* s, const DType* data,
+                    DType* out, int n, int batch) {
+  cufftHandle plan = plans->Get(CUFFT_R2C, n, n, n, batch,
+                                mshadow::Stream<xpu>::GetStream(s));
+  CHECK_EQ(cufftExecR2C(plan, const_cast<cufftReal*>(reinterpret_cast<const cufftReal*>(data)),
+                        reinterpret_cast<cufftComplex*>(out)), CUFFT_SUCCESS);
+  if (n - n / 2 - 1 > 0) {
+    mxnet_op::Kernel<hermitian_fill, xpu>::Launch(s, batch * (n - n / 2 - 1), out, n);
+  }
+}
+
+/*!
+ * \brief out = the real parts of the unnormalized inverse transforms of the
+ *  batch rows of n complex values of data, by a C2R transform of their
+ *  hermitian parts
+ * \param half space for batch * (n / 2 + 1) complex values
+ */
+template<typename xpu, typename DType>
+inline void RealIFFT(CuFFTPlans* plans, mshadow::Stream<xpu>* s, const DType* data,
+                     DType* half, DType* out, int n, int batch) {
+  const int m = n / 2 + 1;
+  mxnet_op::Kernel<hermitian_part, xpu>::Launch(s, batch * m, half, data, n);
+  cufftHandle plan = plans->Get(CUFFT_C2R, n, m, n, batch,
+                                mshadow::Stream<xpu>::GetStream(s));
+  CHECK_EQ(cufftExecC2R(plan, reinterpret_cast<cufftComplex*>(half),
+                        reinterpret_cast<cufftReal*>(out)), CUFFT_SUCCESS);
+}
+
+}  // namespace fft
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_USE_CUDA
+#endif  // MXNET_OPERATOR_CONTRIB_CUFFT_PLAN_INL_H_
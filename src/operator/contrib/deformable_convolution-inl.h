@@ -124,15 +124,13 @@ class DeformableConvolutionOp : public Operator {
     Stream<xpu>* s = ctx.get_stream<xpu>();
     // allocate workspace for col_buffer
     Tensor<xpu, 1, DType> workspace = ctx.requested[conv::kTempSpace]
-      .get_space_typed<xpu, 1, DType>(Shape1(col_buffer_size_), s);
-    // calculate the shape of col_buffer
+      .get_space_typed<xpu, 1, DType>(Shape1(col_step_size_), s);
+    // calculate the shape of col_buffer of an image
     TShape col_buffer_shape(num_spatial_axes_ + 1);
     col_buffer_shape[0] = conv_in_channels_ * param_.kernel.Size();
     for (index_t i = 1; i < col_buffer_shape.ndim(); ++i) {
       col_buffer_shape[i] = out_data[0].shape_[i + 1];
     }
-    // create a column buffer using workspace and col_buffer_shape
-    TBlob col_buffer(workspace.dptr_, col_buffer_shape, xpu::kDevMask, DataType<DType>::kFlag);
 
     // initialize weight and col_buffer 3D tensors for using gemm
     index_t M = conv_out_channels_ / group_;
@@ -140,19 +138,26 @@ class DeformableConvolutionOp : public Operator {
     index_t K = kernel_dim_;
     Tensor<xpu, 3, DType> weight_3d = in_data[conv::kWeight].get_with_shape<xpu, 3, DType>(
       Shape3(group_, M, K), s);
-    Tensor<xpu, 3, DType> col_buffer_3d = col_buffer.get_with_shape<xpu, 3, DType>(
-      Shape3(group_, K, N), s);
-    Tensor<xpu, 4, DType> output_4d = out_data[conv::kOut].get_with_shape<xpu, 4, DType>(
-      Shape4(num_, group_, M, N), s);
-    for (index_t n = 0; n < num_; ++n) {
-      // transform image to col_buffer in order to use gemm
-      deformable_im2col(s, in_data[conv::kData].dptr<DType>() + n*input_dim_,
-        in_data[conv::kOffset].dptr<DType>() + n*input_offset_dim_, in_data[conv::kData].shape_,
-        col_buffer.shape_, param_.kernel, param_.pad, param_.stride, param_.dilate,
-        param_.num_deformable_group, col_buffer.dptr<DType>());
-      Tensor<xpu, 3, DType> output_3d = output_4d[n];
-      for (index_t g = 0; g < group_; ++g) {
-        ASSIGN_DISPATCH(output_3d[g], req[conv::kOut], dot(weight_3d[g], col_buffer_3d[g]));
+    DType* output = out_data[conv::kOut].dptr<DType>();
+    // the col_buffer holds col_nstep_ columns of nstep_ images
+    for (index_t n = 0; n < num_; n += nstep_) {
+      const index_t nstep = std::min(nstep_, num_ - n);
+      for (index_t col = 0; col < N; col += col_nstep_) {
+        const index_t col_nstep = std::min(col_nstep_, N - col);
+        // transform images to col_buffer in order to use gemm
+        deformable_im2col(s, in_data[conv::kData].dptr<DType>() + n*input_dim_,
+          in_data[conv::kOffset].dptr<DType>() + n*input_offset_dim_, in_data[conv::kData].shape_,
+          col_buffer_shape, param_.kernel, param_.pad, param_.stride, param_.dilate,
+          param_.num_deformable_group, workspace.dptr_, nstep, col, col_nstep);
+        for (index_t i = 0; i < nstep; ++i) {
+          for (index_t g = 0; g < group_; ++g) {
+            Tensor<xpu, 2, DType> col_buffer_2d(workspace.dptr_ + (i*group_ + g)*K*col_nstep,
+                                                Shape2(K, col_nstep), s);
+            Tensor<xpu, 2, DType> output_2d(output + ((n + i)*group_ + g)*M*N + col,
+                                            Shape2(M, col_nstep), N, s);
+            ASSIGN_DISPATCH(output_2d, req[conv::kOut], dot(weight_3d[g], col_buffer_2d));
+          }
+        }
       }
     }
     if (bias_term_) {
@@ -184,15 +189,13 @@ class DeformableConvolutionOp : public Operator {
     Stream<xpu> *s = ctx.get_stream<xpu>();
     // allocate workspace for col_buffer
     Tensor<xpu, 1, DType> workspace = ctx.requested[conv::kTempSpace]
-      .get_space_typed<xpu, 1, DType>(Shape1(col_buffer_size_), s);
-    // calculate the shape of col_buffer
+      .get_space_typed<xpu, 1, DType>(Shape1(col_step_size_), s);
+    // calculate the shape of col_buffer of an image
     TShape col_buffer_shape(num_spatial_axes_ + 1);
     col_buffer_shape[0] = conv_in_channels_ * param_.kernel.Size();
     for (index_t i = 1; i < col_buffer_shape.ndim(); ++i) {
       col_buffer_shape[i] = out_grad[conv::kData].shape_[i + 1];
     }
-    // create a column buffer using workspace and col_buffer_shape
-    TBlob col_buffer(workspace.dptr_, col_buffer_shape, xpu::kDevMask, DataType<DType>::kFlag);
 
     // initialize weight and col_buffer 3D tensors for using gemm
     // For computing dLoss/d(in_data[kData])
@@ -201,10 +204,7 @@ class DeformableConvolutionOp : public Operator {
     index_t K = conv_out_channels_ / group_;
     Tensor<xpu, 3, DType> weight_3d = in_data[conv::kWeight].get_with_shape<xpu, 3, DType>(
       Shape3(group_, K, M), s);
-    Tensor<xpu, 4, DType> out_grad_4d = out_grad[conv::kOut].get_with_shape<xpu, 4, DType>(
-      Shape4(num_, group_, K, N), s);
-    Tensor<xpu, 3, DType> col_buffer_3d = col_buffer.get_with_shape<xpu, 3, DType>(
-      Shape3(group_, M, N), s);
+    const DType* dout = out_grad[conv::kOut].dptr<DType>();
     // For computing dLoss/dWeight
     Tensor<xpu, 3, DType> dweight_3d = in_grad[conv::kWeight].get_with_shape<xpu, 3, DType>(
       Shape3(group_, K, M), s);
@@ -212,42 +212,60 @@ class DeformableConvolutionOp : public Operator {
     Tensor<xpu, 1, DType> data_grad = in_grad[conv::kData].FlatTo1D<xpu, DType>(s);
     data_grad = 0;
 
+    // the col_buffer holds col_nstep_ columns of nstep_ images
+    for (index_t n = 0; n < num_; n += nstep_) {
+      const index_t nstep = std::min(nstep_, num_ - n);
+      for (index_t col = 0; col < N; col += col_nstep_) {
+        const index_t col_nstep = std::min(col_nstep_, N - col);
+        for (index_t i = 0; i < nstep; ++i) {
+          for (index_t g = 0; g < group_; ++g) {
+            Tensor<xpu, 2, DType> col_buffer_2d(workspace.dptr_ + (i*group_ + g)*M*col_nstep,
+                                                Shape2(M, col_nstep), s);
+            Tensor<xpu, 2, DType> out_grad_2d(const_cast<DType*>(dout) +
+                                              ((n + i)*group_ + g)*K*N + col,
+                                              Shape2(K, col_nstep), N, s);
+            col_buffer_2d = dot(weight_3d[g].T(), out_grad_2d);
+          }
+        }
 
-    for (index_t n = 0; n < num_; ++n) {
-      Tensor<xpu, 3, DType> out_grad_3d = out_grad_4d[n];
-      for (index_t g = 0; g < group_; ++g) {
-        col_buffer_3d[g] = dot(weight_3d[g].T(), out_grad_3d[g]);
-      }
-
-      // gradient w.r.t. input coordinate data
-      deformable_col2im_coord(s, col_buffer.dptr<DType>(),
-        in_data[conv::kData].dptr<DType>() + n*input_dim_,
-        in_data[conv::kOffset].dptr<DType>() + n*input_offset_dim_,
-        in_grad[conv::kData].shape_, col_buffer.shape_,
-        param_.kernel, param_.pad, param_.stride, param_.dilate, param_.num_deformable_group,
-        in_grad[conv::kOffset].dptr<DType>() + n*input_offset_dim_,
-        req[conv::kData]);
-
-      // gradient w.r.t. input data
-      deformable_col2im(s, col_buffer.dptr<DType>(),
-        in_data[conv::kOffset].dptr<DType>() + n*input_offset_dim_,
-        in_grad[conv::kData].shape_, col_buffer.shape_,
-        param_.kernel, param_.pad, param_.stride, param_.dilate, param_.num_deformable_group,
-        in_grad[conv::kData].dptr<DType>() + n*input_dim_,
-        req[conv::kData]);
-
-      // gradient w.r.t. weight, dWeight should accumulate across the batch and group
-      deformable_im2col(s, in_data[conv::kData].dptr<DType>() + n*input_dim_,
-        in_data[conv::kOffset].dptr<DType>() + n*input_offset_dim_, in_data[conv::kData].shape_,
-        col_buffer.shape_, param_.kernel, param_.pad, param_.stride, param_.dilate,
-        param_.num_deformable_group, col_buffer.dptr<DType>());
-
-      for (index_t g = 0; g < group_; ++g) {
-        if (0 == n) {
-          ASSIGN_DISPATCH(dweight_3d[g], req[conv::kWeight],
-            dot(out_grad_3d[g], col_buffer_3d[g].T()));
-        } else {
-          dweight_3d[g] += dot(out_grad_3d[g], col_buffer_3d[g].T());
+        // gradient w.r.t. input coordinate data
+        deformable_col2im_coord(s, workspace.dptr_,
+          in_data[conv::kData].dptr<DType>() + n*input_dim_,
+          in_data[conv::kOffset].dptr<DType>() + n*input_offset_dim_,
+          in_grad[conv::kData].shape_, col_buffer_shape,
+          param_.kernel, param_.pad, param_.stride, param_.dilate, param_.num_deformable_group,
+          in_grad[conv::kOffset].dptr<DType>() + n*input_offset_dim_,
+          req[conv::kData], nstep, col, col_nstep);
+
+        // gradient w.r.t. input data
+        deformable_col2im(s, workspace.dptr_,
+          in_data[conv::kOffset].dptr<DType>() + n*input_offset_dim_,
+          in_grad[conv::kData].shape_, col_buffer_shape,
+          param_.kernel, param_.pad, param_.stride, param_.dilate, param_.num_deformable_group,
+          in_grad[conv::kData].dptr<DType>() + n*input_dim_,
+          req[conv::kData], nstep, col, col_nstep);
+
+        if (req[conv::kWeight] == kNullOp) continue;
+        // gradient w.r.t. weight, dWeight should accumulate across the batch and group
+        deformable_im2col(s, in_data[conv::kData].dptr<DType>() + n*input_dim_,
+          in_data[conv::kOffset].dptr<DType>() + n*input_offset_dim_, in_data[conv::kData].shape_,
+          col_buffer_shape, param_.kernel, param_.pad, param_.stride, param_.dilate,
+          param_.num_deformable_group, workspace.dptr_, nstep, col, col_nstep);
+
+        for (index_t i = 0; i < nstep; ++i) {
+          for (index_t g = 0; g < group_; ++g) {
+            Tensor<xpu, 2, DType> col_buffer_2d(workspace.dptr_ + (i*group_ + g)*M*col_nstep,
+                                                Shape2(M, col_nstep), s);
+            Tensor<xpu, 2, DType> out_grad_2d(const_cast<DType*>(dout) +
+                                              ((n + i)*group_ + g)*K*N + col,
+                                              Shape2(K, col_nstep), N, s);
+            if (0 == n && 0 == col && 0 == i) {
+              ASSIGN_DISPATCH(dweight_3d[g], req[conv::kWeight],
+                dot(out_grad_2d, col_buffer_2d.T()));
+            } else {
+              dweight_3d[g] += dot(out_grad_2d, col_buffer_2d.T());
+            }
+          }
         }
       }
     }
@@ -288,6 +306,18 @@ class DeformableConvolutionOp : public Operator {
     output_offset_ = conv_out_channels_ * conv_out_spatial_dim_ / group_;
     // size of the column buffer used for storing im2col-ed pixels
     col_buffer_size_ = kernel_dim_ * group_ * conv_out_spatial_dim_;
+    // the images whose column buffers fit in the workspace are filled at once;
+    // an image that does not fit is done for a range of its columns at a time
+    if (col_buffer_size_ <= param_.workspace) {
+      nstep_ = std::max(std::min(static_cast<index_t>(param_.workspace / col_buffer_size_),
+                                 num_), static_cast<index_t>(1));
+      col_nstep_ = conv_out_spatial_dim_;
+    } else {
+      nstep_ = 1;
+      col_nstep_ = std::max(static_cast<index_t>(param_.workspace / (kernel_dim_ * group_)),
+                            static_cast<index_t>(1));
+    }
+    col_step_size_ = nstep_ * kernel_dim_ * group_ * col_nstep_;
     // input/output image size (#channels * height * width)
     input_dim_ = ishape.ProdShape(1, ishape.ndim());
     input_offset_dim_ = offset_shape.ProdShape(1, offset_shape.ndim());
@@ -311,6 +341,9 @@ class DeformableConvolutionOp : public Operator {
   index_t col_offset_;
   index_t output_offset_;
   index_t col_buffer_size_;
+  index_t nstep_;  // number of images in the column buffer
+  index_t col_nstep_;  // number of columns of each image in the column buffer
+  index_t col_step_size_;  // size of the column buffer that is allocated
   index_t input_dim_;
   index_t input_offset_dim_;
   index_t output_dim_;
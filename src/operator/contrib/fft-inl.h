@@ -26,6 +26,7 @@
 #define MXNET_OPERATOR_CONTRIB_FFT_INL_H_
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <string>
@@ -33,17 +34,14 @@
 #include <iostream>
 #include "../operator_common.h"
 #include "../mshadow_op.h"
-
-#if MXNET_USE_CUDA
-#include <cufft.h>
-#endif
+#include "./cufft_plan-inl.h"
 
 namespace mxnet {
 namespace op {
 namespace fft {
 enum fftOpInputs {kData};
 enum fftOpOutputs {kOutComplex};  // seperate the image and real parts at the moment
-enum fftOpResource {kTempSpace};  // might be requiered as we need to pad the real matrices
+enum fftOpResource {kTempSpace};  // the hermitian parts of the gradient
 }
 
 struct FFTParam : public dmlc::Parameter<FFTParam> {
@@ -59,8 +57,6 @@ class FFTOp : public Operator {
  public:
   explicit FFTOp(FFTParam p) {
     this->param_ = p;
-    init_cufft_ = false;
-    dim_ = 0;
   }
 
   virtual void Forward(const OpContext &ctx,
@@ -74,66 +70,20 @@ class FFTOp : public Operator {
     CHECK_EQ(out_data.size(), 1);
 
     // the last dimention should be the dimension of fft vector
-    if (!init_cufft_) {
-      n_ffts = in_data[fft::kData].shape_.ProdShape(0, in_data[fft::kData].ndim()-1);
-      dim_ = in_data[fft::kData].shape_[in_data[fft::kData].ndim()-1];
-
-      stride_ = param_.compute_size*dim_;
-
-      init_cufft_ = true;
-
-      // will handle the (possibly) incomplete group later
-      num_compute = n_ffts / param_.compute_size;
-    }
-
+    const TShape& ishape = in_data[fft::kData].shape_;
+    const int n_ffts = ishape.ProdShape(0, ishape.ndim()-1);
+    const int dim = ishape[ishape.ndim()-1];
 
     Stream<xpu> *s = ctx.get_stream<xpu>();
-    // const TShape& oshape = out_data[fft::kOutComplex].shape_;
-    const TShape& ishape = in_data[fft::kData].shape_;
-    const TShape& oshape = out_data[fft::kOutComplex].shape_;
     Tensor<xpu, 2, DType> data = in_data[fft::kData].get_with_shape<xpu, 2, DType>(
-          Shape2(n_ffts, dim_), s);
+          Shape2(n_ffts, dim), s);
     Tensor<xpu, 2, DType> out = out_data[fft::kOutComplex].get_with_shape<xpu, 2, DType>(
-          Shape2(n_ffts, dim_*2), s);
-
-    // need temp space to pad the data into complex numbers due to cufft interface
-    Tensor<xpu, 1, DType> workspace =
-            ctx.requested[fft::kTempSpace].get_space_typed<xpu, 1, DType>(
-                Shape1(param_.compute_size*dim_*2), s);
-    Tensor<xpu, 2, DType> complex_data = Tensor<xpu, 2, DType>(workspace.dptr_,
-                                              Shape2(param_.compute_size, dim_*2), s);
-    #if MSHADOW_USE_CUDNN
-    // start fft
-    cufftHandle plan;
-    cufftPlanMany(&plan, 1, &dim_, nullptr, 0, 0, nullptr, 0, 0, CUFFT_C2C, param_.compute_size);
-    for (size_t idx=0; idx < num_compute; ++idx) {
-      complex_data = complex_pad_imag(data.Slice(idx*param_.compute_size,
-                                                 idx*param_.compute_size+param_.compute_size));
-
-      cufftComplex* in_tmp = const_cast<cufftComplex*>(
-        reinterpret_cast<const cufftComplex*>(complex_data.dptr_));
-      cufftComplex* out_tmp = reinterpret_cast<cufftComplex*>(out.dptr_ + 2*idx*stride_);
-      CHECK_EQ(cufftExecC2C(plan, in_tmp, out_tmp, CUFFT_FORWARD), CUFFT_SUCCESS);
-    }
-    cufftDestroy(plan);
-
-    // handle the remaining samples
-    size_t remain_num = n_ffts - param_.compute_size*num_compute;
-    if (remain_num > 0) {
-      cufftHandle plan_remain;
-      cufftPlanMany(&plan_remain, 1, &dim_, nullptr, 0, 0, nullptr, 0, 0,
-                    CUFFT_C2C, remain_num);
-
-      complex_data = Tensor<xpu, 2, DType>(workspace.dptr_,
-                                          Shape2(remain_num, dim_*2), s);
-      complex_data = complex_pad_imag(data.Slice(
-          num_compute*param_.compute_size, num_compute*param_.compute_size+remain_num));
-
-      cufftComplex* in_tmp = const_cast<cufftComplex*>(
-        reinterpret_cast<const cufftComplex*>(complex_data.dptr_));
-      cufftComplex* out_tmp = reinterpret_cast<cufftComplex*>(out.dptr_ + 2*num_compute*stride_);
-      CHECK_EQ(cufftExecC2C(plan_remain, in_tmp, out_tmp, CUFFT_FORWARD), CUFFT_SUCCESS);
-      cufftDestroy(plan_remain);
+          Shape2(n_ffts, dim*2), s);
+    #if MXNET_USE_CUDA
+    // the real rows are transformed straight into out, by sub-batches of compute_size
+    for (int begin = 0; begin < n_ffts; begin += param_.compute_size) {
+      const int num = std::min(param_.compute_size, n_ffts - begin);
+      fft::RealFFT(&plans_, s, data.dptr_ + begin*dim, out.dptr_ + 2*begin*dim, dim, num);
     }
     #endif
   }
@@ -150,69 +100,45 @@ class FFTOp : public Operator {
     CHECK_EQ(out_grad.size(), 1);
     CHECK(in_data.size() == 1 && in_grad.size() == 1);
     CHECK_EQ(req.size(), 1);
-
-    Stream<xpu> *s = ctx.get_stream<xpu>();
+    if (req[fft::kData] == kNullOp) return;
 
     const TShape& ishape = in_grad[fft::kData].shape_;
-    const TShape& oshape = out_grad[fft::kOutComplex].shape_;
+    const int n_ffts = ishape.ProdShape(0, ishape.ndim()-1);
+    const int dim = ishape[ishape.ndim()-1];
+
+    Stream<xpu> *s = ctx.get_stream<xpu>();
     Tensor<xpu, 2, DType> gdata = in_grad[fft::kData].get_with_shape<xpu, 2, DType>(
-          Shape2(n_ffts, dim_), s);
+          Shape2(n_ffts, dim), s);
     Tensor<xpu, 2, DType> grad = out_grad[fft::kOutComplex].get_with_shape<xpu, 2, DType>(
-          Shape2(n_ffts, dim_*2), s);
-    // need temp space to pad the data into complex numbers due to cufft interface
+          Shape2(n_ffts, dim*2), s);
+    // the gradient is the real part of the inverse transform of out_grad, which
+    // need not be hermitian, so the C2R transform is of its hermitian part.
+    // Temp space holds the hermitian parts, and the result when it is added
+    const bool add = req[fft::kData] == kAddTo;
+    const index_t half_size = param_.compute_size*(dim/2+1)*2;
     Tensor<xpu, 1, DType> workspace =
             ctx.requested[fft::kTempSpace].get_space_typed<xpu, 1, DType>(
-                Shape1(param_.compute_size*dim_*2), s);
-    Tensor<xpu, 2, DType> complex_data = Tensor<xpu, 2, DType>(workspace.dptr_,
-                                              Shape2(param_.compute_size, dim_*2), s);
-
-    // by default, we think forward is firstly conducted
-    // In this solution, out_grad must comes from a fft of real signal,
-    // so that it is Hermitian symmetric, giving a real output
-    // but if it is not, remember that we have implemented complex_take_real, and use this
-    #if MSHADOW_USE_CUDNN
-    cufftHandle plan;
-    cufftPlanMany(&plan, 1, &dim_, nullptr, 0, 0, nullptr, 0, 0, CUFFT_C2C, param_.compute_size);
-    for (size_t idx = 0; idx < num_compute; ++idx) {
-      cufftComplex* in_tmp = const_cast<cufftComplex*>(
-        reinterpret_cast<const cufftComplex*>(grad.dptr_ + 2*idx*stride_));
-      cufftComplex* out_tmp = reinterpret_cast<cufftComplex*>(complex_data.dptr_);
-      CHECK_EQ(cufftExecC2C(plan, in_tmp, out_tmp, CUFFT_INVERSE), CUFFT_SUCCESS);
-
-      Assign(gdata.Slice(idx*param_.compute_size, (idx+1)*param_.compute_size),
-             req[fft::kData], complex_toreal(complex_data));
-    }
-    cufftDestroy(plan);
-
-    // handle the remaining samples
-    size_t remain_num = n_ffts - param_.compute_size*num_compute;
-    if (remain_num > 0) {
-      cufftHandle plan_remain;
-      cufftPlanMany(&plan_remain, 1, &dim_, nullptr, 0, 0, nullptr, 0, 0,
-                    CUFFT_C2C, remain_num);
-      complex_data = Tensor<xpu, 2, DType>(workspace.dptr_,
-                                              Shape2(remain_num, dim_*2), s);
-
-      cufftComplex* in_tmp = const_cast<cufftComplex*>(
-        reinterpret_cast<const cufftComplex*>(grad.dptr_ + 2*num_compute*stride_));
-      cufftComplex* out_tmp = reinterpret_cast<cufftComplex*>(complex_data.dptr_);
-      CHECK_EQ(cufftExecC2C(plan_remain, in_tmp, out_tmp, CUFFT_INVERSE), CUFFT_SUCCESS);
-
-      Assign(gdata.Slice(param_.compute_size*num_compute,
-                         param_.compute_size*num_compute+remain_num),
-             req[fft::kData], complex_toreal(complex_data));
-      cufftDestroy(plan_remain);
+                Shape1(half_size + (add ? param_.compute_size*dim : 0)), s);
+    #if MXNET_USE_CUDA
+    for (int begin = 0; begin < n_ffts; begin += param_.compute_size) {
+      const int num = std::min(param_.compute_size, n_ffts - begin);
+      DType* res = add ? workspace.dptr_ + half_size : gdata.dptr_ + begin*dim;
+      fft::RealIFFT(&plans_, s, grad.dptr_ + 2*begin*dim, workspace.dptr_, res, dim, num);
+      if (add) {
+        gdata.Slice(begin, begin+num) += Tensor<xpu, 2, DType>(res, Shape2(num, dim), s);
+      }
     }
     #endif
     // for bp, we should not divide it
     // but for comparison with np.fft.ifft, we should do it.
-    // gdata /= dim_;
+    // gdata /= dim;
   }
 
  private:
   FFTParam param_;
-  int dim_, stride_, num_compute, n_ffts;
-  bool init_cufft_;
+  #if MXNET_USE_CUDA
+  fft::CuFFTPlans plans_;
+  #endif
 };  // class FFTOp
 
 // Declare Factory Function, used for dispatch specialization
@@ -290,11 +216,6 @@ class FFTProp : public OperatorProperty {
     return {out_grad[fft::kOutComplex], in_data[fft::kData]};
   }
 
-  std::vector<ResourceRequest> ForwardResource(
-      const std::vector<TShape> &in_shape) const override {
-    return {ResourceRequest::kTempSpace};
-  }
-
   std::vector<ResourceRequest> BackwardResource(
       const std::vector<TShape> &in_shape) const override {
     return {ResourceRequest::kTempSpace};
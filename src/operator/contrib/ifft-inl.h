@@ -27,16 +27,14 @@
 #include <stdio.h>
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <string>
 #include <utility>
 #include "../operator_common.h"
 #include "../mshadow_op.h"
-
-#if MXNET_USE_CUDA
-#include <cufft.h>
-#endif
+#include "./cufft_plan-inl.h"
 
 namespace mxnet {
 namespace op {
@@ -59,8 +57,6 @@ class IFFTOp : public Operator {
  public:
   explicit IFFTOp(IFFTParam p) {
     this->param_ = p;
-    init_cufft_ = false;
-    dim_ = 0;
   }
 
   virtual void Forward(const OpContext &ctx,
@@ -72,69 +68,40 @@ class IFFTOp : public Operator {
     using namespace mshadow::expr;
     CHECK_EQ(in_data.size(), 1);
     CHECK_EQ(out_data.size(), 1);
+    if (req[ifft::kOut] == kNullOp) return;
 
-    if (!init_cufft_) {
-      n_iffts = in_data[ifft::kData].shape_.ProdShape(0, in_data[ifft::kData].ndim()-1);
-      // remember that input is complex
-      dim_ = in_data[ifft::kData].shape_[in_data[ifft::kData].ndim()-1]/2;
-      // stride_ in the number of complex numbers
-      stride_ = param_.compute_size*dim_;
-
-      init_cufft_ = true;
-
-      num_compute = n_iffts/param_.compute_size;
-    }
+    const TShape& ishape = in_data[ifft::kData].shape_;
+    const int n_iffts = ishape.ProdShape(0, ishape.ndim()-1);
+    // remember that input is complex
+    const int dim = ishape[ishape.ndim()-1]/2;
 
     Stream<xpu> *s = ctx.get_stream<xpu>();
-    const TShape& ishape = in_data[ifft::kData].shape_;
-    const TShape& oshape = out_data[ifft::kOut].shape_;
     Tensor<xpu, 2, DType> data = in_data[ifft::kData].get_with_shape<xpu, 2, DType>(
-          Shape2(n_iffts, dim_*2), s);
+          Shape2(n_iffts, dim*2), s);
     Tensor<xpu, 2, DType> out = out_data[ifft::kOut].get_with_shape<xpu, 2, DType>(
-          Shape2(n_iffts, dim_), s);
-    // need temp space to store the intermediate complex matrices
+          Shape2(n_iffts, dim), s);
+    // the output is the real part of the inverse transform, the C2R transform
+    // of the hermitian part of the input. Temp space holds the hermitian
+    // parts, and the result when it is added
+    const bool add = req[ifft::kOut] == kAddTo;
+    const index_t half_size = param_.compute_size*(dim/2+1)*2;
     Tensor<xpu, 1, DType> workspace =
             ctx.requested[ifft::kTempSpace].get_space_typed<xpu, 1, DType>(
-                Shape1(param_.compute_size*dim_*2), s);
-    Tensor<xpu, 2, DType> complex_data = Tensor<xpu, 2, DType>(workspace.dptr_,
-                                              Shape2(param_.compute_size, dim_*2), s);
-    #if MSHADOW_USE_CUDNN
-    // start ifft
-    cufftHandle plan;
-    cufftPlanMany(&plan, 1, &dim_, nullptr, 0, 0, nullptr, 0, 0, CUFFT_C2C, param_.compute_size);
-    for (size_t idx=0; idx < num_compute; ++idx) {
-      cufftComplex* in_tmp = const_cast<cufftComplex*>(
-        reinterpret_cast<const cufftComplex*>(data.dptr_ + 2*idx*stride_));
-      cufftComplex* out_tmp = reinterpret_cast<cufftComplex*>(complex_data.dptr_);
-      CHECK_EQ(cufftExecC2C(plan, in_tmp, out_tmp, CUFFT_INVERSE), CUFFT_SUCCESS);
-
-      Assign(out.Slice(idx*param_.compute_size, (idx+1)*param_.compute_size),
-             req[ifft::kOut], complex_toreal(complex_data));
-    }
-    cufftDestroy(plan);
-    // handle the remaining samples
-    size_t remain_num = n_iffts - param_.compute_size*num_compute;
-    if (remain_num > 0) {
-      cufftHandle plan_remain;
-      cufftPlanMany(&plan_remain, 1, &dim_, nullptr, 0, 0, nullptr, 0, 0,
-                    CUFFT_C2C, remain_num);
-
-      complex_data = Tensor<xpu, 2, DType>(workspace.dptr_,
-                                              Shape2(remain_num, dim_*2), s);
-
-      cufftComplex* in_tmp = const_cast<cufftComplex*>(
-        reinterpret_cast<const cufftComplex*>(data.dptr_ + 2*num_compute*stride_));
-      cufftComplex* out_tmp = reinterpret_cast<cufftComplex*>(complex_data.dptr_);
-      CHECK_EQ(cufftExecC2C(plan_remain, in_tmp, out_tmp, CUFFT_INVERSE), CUFFT_SUCCESS);
-        Assign(out.Slice(param_.compute_size*num_compute,
-                         param_.compute_size*num_compute+remain_num),
-             req[ifft::kOut], complex_toreal(complex_data));
-      cufftDestroy(plan_remain);
+                Shape1(half_size + (add ? param_.compute_size*dim : 0)), s);
+    #if MXNET_USE_CUDA
+    for (int begin = 0; begin < n_iffts; begin += param_.compute_size) {
+      const int num = std::min(param_.compute_size, n_iffts - begin);
+      DType* res = add ? workspace.dptr_ + half_size : out.dptr_ + begin*dim;
+      fft::RealIFFT(&plans_, s, data.dptr_ + 2*begin*dim, workspace.dptr_, res, dim, num);
+      if (add) {
+        out.Slice(begin, begin+num) += Tensor<xpu, 2, DType>(res, Shape2(num, dim), s);
+      }
     }
     #endif
     // commenting this out to be consistant with caffe
-    // out /= dim_;
+    // out /= dim;
   }
+
   virtual void Backward(const OpContext &ctx,
                         const std::vector<TBlob> &out_grad,
                         const std::vector<TBlob> &in_data,
@@ -148,61 +115,31 @@ class IFFTOp : public Operator {
     CHECK(in_data.size() == 1 && in_grad.size() == 1);
     CHECK_EQ(req.size(), 1);
 
-    Stream<xpu> *s = ctx.get_stream<xpu>();
-
     const TShape& ishape = in_grad[ifft::kData].shape_;
-    const TShape& oshape = out_grad[ifft::kOut].shape_;
+    const int n_iffts = ishape.ProdShape(0, ishape.ndim()-1);
+    const int dim = ishape[ishape.ndim()-1]/2;
+
+    Stream<xpu> *s = ctx.get_stream<xpu>();
     Tensor<xpu, 2, DType> gdata = in_grad[ifft::kData].get_with_shape<xpu, 2, DType>(
-          Shape2(n_iffts, dim_*2), s);
+          Shape2(n_iffts, dim*2), s);
     Tensor<xpu, 2, DType> grad = out_grad[ifft::kOut].get_with_shape<xpu, 2, DType>(
-          Shape2(n_iffts, dim_), s);
-    // need temp space to pad the data into complex numbers due to cufft interface
-    Tensor<xpu, 1, DType> workspace =
-            ctx.requested[ifft::kTempSpace].get_space_typed<xpu, 1, DType>(
-                Shape1(param_.compute_size*dim_*2), s);
-    Tensor<xpu, 2, DType> complex_data = Tensor<xpu, 2, DType>(workspace.dptr_,
-                                              Shape2(param_.compute_size, dim_*2), s);
-    #if MSHADOW_USE_CUDNN
-    // start fft
-    cufftHandle plan;
-    cufftPlanMany(&plan, 1, &dim_, nullptr, 0, 0, nullptr, 0, 0, CUFFT_C2C, param_.compute_size);
-    for (size_t idx = 0; idx < num_compute; ++idx) {
-      complex_data = complex_pad_imag(grad.Slice(idx*param_.compute_size,
-                                                 idx*param_.compute_size+param_.compute_size));
-
-      cufftComplex* in_tmp = const_cast<cufftComplex*>(
-        reinterpret_cast<const cufftComplex*>(complex_data.dptr_));
-      cufftComplex* out_tmp = reinterpret_cast<cufftComplex*>(gdata.dptr_ + 2*idx*stride_);
-      CHECK_EQ(cufftExecC2C(plan, in_tmp, out_tmp, CUFFT_FORWARD), CUFFT_SUCCESS);
-    }
-    cufftDestroy(plan);
-
-    // handle the remaining samples
-    size_t remain_num = n_iffts - param_.compute_size*num_compute;
-    if (remain_num > 0) {
-      cufftHandle plan_remain;
-      cufftPlanMany(&plan_remain, 1, &dim_, nullptr, 0, 0, nullptr, 0, 0,
-                    CUFFT_C2C, remain_num);
-      complex_data = Tensor<xpu, 2, DType>(workspace.dptr_,
-                                          Shape2(remain_num, dim_*2), s);
-      complex_data = complex_pad_imag(grad.Slice(
-          num_compute*param_.compute_size, num_compute*param_.compute_size+remain_num));
-
-      cufftComplex* in_tmp = const_cast<cufftComplex*>(
-        reinterpret_cast<const cufftComplex*>(complex_data.dptr_));
-      cufftComplex* out_tmp = reinterpret_cast<cufftComplex*>(gdata.dptr_ + 2*num_compute*stride_);
-      CHECK_EQ(cufftExecC2C(plan_remain, in_tmp, out_tmp, CUFFT_FORWARD), CUFFT_SUCCESS);
-      cufftDestroy(plan_remain);
+          Shape2(n_iffts, dim), s);
+    #if MXNET_USE_CUDA
+    // the real rows of the gradient are transformed straight into gdata
+    for (int begin = 0; begin < n_iffts; begin += param_.compute_size) {
+      const int num = std::min(param_.compute_size, n_iffts - begin);
+      fft::RealFFT(&plans_, s, grad.dptr_ + begin*dim, gdata.dptr_ + 2*begin*dim, dim, num);
     }
     #endif
     // commenting this out to be consistant with caffe
-    // gdata /= dim_;
+    // gdata /= dim;
   }
 
  private:
   IFFTParam param_;
-  int dim_, stride_, num_compute, n_iffts;
-  bool init_cufft_;
+  #if MXNET_USE_CUDA
+  fft::CuFFTPlans plans_;
+  #endif
 };  // class IFFTOp
 
 // Declare Factory Function, used for dispatch specialization
@@ -285,11 +222,6 @@ class IFFTProp : public OperatorProperty {
     return {ResourceRequest::kTempSpace};
   }
 
-  std::vector<ResourceRequest> BackwardResource(
-      const std::vector<TShape> &in_shape) const override {
-    return {ResourceRequest::kTempSpace};
-  }
-
   std::vector<std::pair<int, void*> > BackwardInplaceOption(
     const std::vector<int> &out_grad,
     const std::vector<int> &in_data,
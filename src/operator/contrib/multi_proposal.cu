@@ -29,9 +29,6 @@
 #include <mxnet/operator.h>
 #include <mshadow/tensor.h>
 #include <mshadow/cuda/reduce.cuh>
-#include <thrust/sort.h>
-#include <thrust/execution_policy.h>
-#include <thrust/functional.h>
 
 #include <map>
 #include <vector>
@@ -43,8 +40,7 @@
 #include "../operator_common.h"
 #include "../mshadow_op.h"
 #include "./multi_proposal-inl.h"
-
-#define DIVUP(m, n) ((m) / (n) + ((m) % (n) > 0))
+#include "./nms.cuh"
 
 #define FRCNN_CUDA_CHECK(condition) \
   /* Code block avoids redefinition of cudaError_t error */ \
@@ -232,175 +228,66 @@ __global__ void FilterBoxKernel(const int count,
   }
 }
 
-// copy score and init order
-// dets (n, 5); score (n, ); order (n, )
-// count should be n (total anchors or proposals)
+// copy score
+// dets (b, n, 5); score (b * n, )
+// count should be b * n (total anchors or proposals)
 template<typename Dtype>
 __global__ void CopyScoreKernel(const int count,
                                 const Dtype* dets,
-                                Dtype* score,
-                                int* order) {
+                                Dtype* score) {
   for (int index = blockIdx.x * blockDim.x + threadIdx.x;
        index < count;
        index += blockDim.x * gridDim.x) {
     score[index] = dets[index * 5 + 4];
-    order[index] = index;
   }
 }
 
-// reorder proposals according to order and keep the top_n proposals
-// prev_dets (n, 5); order (n, ); dets (n, 5)
-// count should be output anchor numbers (top_n)
+// reorder proposals according to order and keep the top_n proposals of each image
+// prev_dets (b, n, 5); order (b, n), into prev_dets; dets (b, top_n, 5)
+// count should be b * top_n
 template<typename Dtype>
 __global__ void ReorderProposalsKernel(const int count,
+                                       const int top_n,
+                                       const int count_anchors,
                                        const Dtype* prev_dets,
                                        const int* order,
                                        Dtype* dets) {
   for (int index = blockIdx.x * blockDim.x + threadIdx.x;
        index < count;
        index += blockDim.x * gridDim.x) {
-    const int order_i = order[index];
+    const int b = index / top_n;
+    const int order_i = order[b * count_anchors + index % top_n];
     for (int j = 0; j < 5; j ++) {
       dets[index * 5 + j] = prev_dets[order_i * 5 + j];
     }
   }
 }
 
-__device__ inline float devIoU(float const * const a, float const * const b) {
-  float left = max(a[0], b[0]), right = min(a[2], b[2]);
-  float top = max(a[1], b[1]), bottom = min(a[3], b[3]);
-  float width = max(right - left + 1, 0.f), height = max(bottom - top + 1, 0.f);
-  float interS = width * height;
-  float Sa = (a[2] - a[0] + 1) * (a[3] - a[1] + 1);
-  float Sb = (b[2] - b[0] + 1) * (b[3] - b[1] + 1);
-  return interS / (Sa + Sb - interS);
-}
-
-__global__ void nms_kernel(const int n_boxes, const float nms_overlap_thresh,
-                           const float *dev_boxes, uint64_t *dev_mask) {
-  const int threadsPerBlock = sizeof(uint64_t) * 8;
-  const int row_start = blockIdx.y;
-  const int col_start = blockIdx.x;
-
-  // if (row_start > col_start) return;
-
-  const int row_size =
-        min(n_boxes - row_start * threadsPerBlock, threadsPerBlock);
-  const int col_size =
-        min(n_boxes - col_start * threadsPerBlock, threadsPerBlock);
-
-  __shared__ float block_boxes[threadsPerBlock * 5];
-  if (threadIdx.x < col_size) {
-    block_boxes[threadIdx.x * 5 + 0] =
-        dev_boxes[(threadsPerBlock * col_start + threadIdx.x) * 5 + 0];
-    block_boxes[threadIdx.x * 5 + 1] =
-        dev_boxes[(threadsPerBlock * col_start + threadIdx.x) * 5 + 1];
-    block_boxes[threadIdx.x * 5 + 2] =
-        dev_boxes[(threadsPerBlock * col_start + threadIdx.x) * 5 + 2];
-    block_boxes[threadIdx.x * 5 + 3] =
-        dev_boxes[(threadsPerBlock * col_start + threadIdx.x) * 5 + 3];
-    block_boxes[threadIdx.x * 5 + 4] =
-        dev_boxes[(threadsPerBlock * col_start + threadIdx.x) * 5 + 4];
-  }
-  __syncthreads();
-
-  if (threadIdx.x < row_size) {
-    const int cur_box_idx = threadsPerBlock * row_start + threadIdx.x;
-    const float *cur_box = dev_boxes + cur_box_idx * 5;
-    int i = 0;
-    uint64_t t = 0;
-    int start = 0;
-    if (row_start == col_start) {
-      start = threadIdx.x + 1;
-    }
-    for (i = start; i < col_size; i++) {
-      if (devIoU(cur_box, block_boxes + i * 5) > nms_overlap_thresh) {
-        t |= 1ULL << i;
-      }
-    }
-    const int col_blocks = DIVUP(n_boxes, threadsPerBlock);
-    dev_mask[cur_box_idx * col_blocks + col_start] = t;
-  }
-}
-
-void _nms(const mshadow::Tensor<gpu, 2>& boxes,
-          const float nms_overlap_thresh,
-          int *keep,
-          int *num_out) {
-  const int threadsPerBlock = sizeof(uint64_t) * 8;
-  const int boxes_num = boxes.size(0);
-  const int boxes_dim = boxes.size(1);
-
-  float* boxes_dev = boxes.dptr_;
-  uint64_t* mask_dev = NULL;
-
-  const int col_blocks = DIVUP(boxes_num, threadsPerBlock);
-  FRCNN_CUDA_CHECK(cudaMalloc(&mask_dev,
-                              boxes_num * col_blocks * sizeof(uint64_t)));
-
-  dim3 blocks(DIVUP(boxes_num, threadsPerBlock),
-              DIVUP(boxes_num, threadsPerBlock));
-  dim3 threads(threadsPerBlock);
-  nms_kernel<<<blocks, threads>>>(boxes_num,
-                                  nms_overlap_thresh,
-                                  boxes_dev,
-                                  mask_dev);
-  FRCNN_CUDA_CHECK(cudaPeekAtLastError());
-  std::vector<uint64_t> mask_host(boxes_num * col_blocks);
-  FRCNN_CUDA_CHECK(cudaMemcpy(&mask_host[0],
-                              mask_dev,
-                              sizeof(uint64_t) * boxes_num * col_blocks,
-                              cudaMemcpyDeviceToHost));
-
-  std::vector<uint64_t> remv(col_blocks);
-  memset(&remv[0], 0, sizeof(uint64_t) * col_blocks);
-
-  int num_to_keep = 0;
-  for (int i = 0; i < boxes_num; i++) {
-    int nblock = i / threadsPerBlock;
-    int inblock = i % threadsPerBlock;
-
-    if (!(remv[nblock] & (1ULL << inblock))) {
-      keep[num_to_keep++] = i;
-      uint64_t *p = &mask_host[0] + i * col_blocks;
-      for (int j = nblock; j < col_blocks; j++) {
-        remv[j] |= p[j];
-      }
-    }
-  }
-  *num_out = num_to_keep;
-
-  FRCNN_CUDA_CHECK(cudaFree(mask_dev));
-}
-
 // copy proposals to output
-// dets (top_n, 5); keep (top_n, ); out (top_n, )
-// count should be top_n (total anchors or proposals)
+// dets (b, top_n, 5); keep (b, top_n); num_keep (b, ); out (b * out_n, 5)
+// count should be b * out_n
 template<typename Dtype>
 __global__ void PrepareOutput(const int count,
+                              const int top_n,
+                              const int out_n,
                               const Dtype* dets,
                               const int* keep,
-                              const int out_size,
-                              const int image_index,
+                              const int* num_keep,
                               Dtype* out,
                               Dtype* score) {
   for (int index = blockIdx.x * blockDim.x + threadIdx.x;
        index < count;
        index += blockDim.x * gridDim.x) {
+    const int image_index = index / out_n;
+    const int i = index % out_n;
+    const int out_size = num_keep[image_index];
+    const Dtype* image_dets = dets + image_index * top_n * 5;
+    const int keep_i = keep[image_index * top_n + (i < out_size ? i : i % out_size)];
     out[index * 5] = image_index;
-    if (index < out_size) {
-      int keep_i = keep[index];
-      for (int j = 0; j < 4; ++j) {
-        out[index * 5 + j + 1] = dets[keep_i * 5 + j];
-      }
-      score[index] = dets[keep_i * 5 + 4];
-    } else {
-      int keep_i = keep[index % out_size];
-      for (int j = 0; j < 4; ++j) {
-        out[index * 5 + j + 1] = dets[keep_i * 5 + j];
-      }
-      score[index] = dets[keep_i * 5 + 4];
+    for (int j = 0; j < 4; ++j) {
+      out[index * 5 + j + 1] = image_dets[keep_i * 5 + j];
     }
+    score[index] = image_dets[keep_i * 5 + 4];
   }
 }
 }  // namespace multi_proposal
@@ -434,6 +321,7 @@ class MultiProposalGPUOp : public Operator{
       << "Sorry, multiple images each device is not implemented.";*/
 
     Stream<xpu> *s = ctx.get_stream<xpu>();
+    cudaStream_t stream = Stream<gpu>::GetStream(s);
 
     Tensor<xpu, 4> scores = in_data[proposal::kClsProb].get<xpu, 4, real_t>(s);
     Tensor<xpu, 4> bbox_deltas = in_data[proposal::kBBoxPred].get<xpu, 4, real_t>(s);
@@ -480,7 +368,7 @@ class MultiProposalGPUOp : public Operator{
     dim3 dimGrid((count + kMaxThreadsPerBlock - 1) / kMaxThreadsPerBlock);
     dim3 dimBlock(kMaxThreadsPerBlock);
     CheckLaunchParam(dimGrid, dimBlock, "ProposalGrid");
-    ProposalGridKernel<<<dimGrid, dimBlock>>>(
+    ProposalGridKernel<<<dimGrid, dimBlock, 0, stream>>>(
       count, num_anchors, height, width, param_.feature_stride,
       scores.dptr_, workspace_proposals.dptr_);
     FRCNN_CUDA_CHECK(cudaPeekAtLastError());
@@ -488,11 +376,11 @@ class MultiProposalGPUOp : public Operator{
     // Transform anchors and bbox_deltas into bboxes
     CheckLaunchParam(dimGrid, dimBlock, "BBoxPred");
     if (param_.iou_loss) {
-      IoUPredKernel<<<dimGrid, dimBlock>>>(
+      IoUPredKernel<<<dimGrid, dimBlock, 0, stream>>>(
         count, num_anchors, height, width, param_.feature_stride, im_info.dptr_,
         workspace_proposals.dptr_, bbox_deltas.dptr_, workspace_proposals.dptr_);
     } else {
-      BBoxPredKernel<<<dimGrid, dimBlock>>>(
+      BBoxPredKernel<<<dimGrid, dimBlock, 0, stream>>>(
         count, num_anchors, height, width, param_.feature_stride, im_info.dptr_,
         workspace_proposals.dptr_, bbox_deltas.dptr_, workspace_proposals.dptr_);
     }
@@ -500,81 +388,79 @@ class MultiProposalGPUOp : public Operator{
 
     // filter boxes with less than rpn_min_size
     CheckLaunchParam(dimGrid, dimBlock, "FilterBox");
-    FilterBoxKernel<<<dimGrid, dimBlock>>>(
+    FilterBoxKernel<<<dimGrid, dimBlock, 0, stream>>>(
       count, count_anchors, param_.rpn_min_size, im_info.dptr_, workspace_proposals.dptr_);
     FRCNN_CUDA_CHECK(cudaPeekAtLastError());
 
-
-
-    dimGrid = dim3((count_anchors + kMaxThreadsPerBlock - 1) / kMaxThreadsPerBlock);
-    dimBlock = dim3(kMaxThreadsPerBlock);
     // Copy score to a continuous memory
     float* score_ptr = NULL;
-    FRCNN_CUDA_CHECK(cudaMalloc(&score_ptr, sizeof(float) * count_anchors));
-    Tensor<xpu, 1> score(score_ptr, Shape1(count_anchors));
+    FRCNN_CUDA_CHECK(cudaMalloc(&score_ptr, sizeof(float) * count));
+    Tensor<xpu, 1> score(score_ptr, Shape1(count), s);
     int* order_ptr = NULL;
-    FRCNN_CUDA_CHECK(cudaMalloc(&order_ptr, sizeof(int) * count_anchors));
-    Tensor<xpu, 1, int> order(order_ptr, Shape1(count_anchors));
+    FRCNN_CUDA_CHECK(cudaMalloc(&order_ptr, sizeof(int) * count * 2));
+    Tensor<xpu, 1, int> order(order_ptr, Shape1(count), s);
+    Tensor<xpu, 1, int> segment(order_ptr + count, Shape1(count), s);
+
+    CheckLaunchParam(dimGrid, dimBlock, "CopyScore");
+    CopyScoreKernel<<<dimGrid, dimBlock, 0, stream>>>(
+      count, workspace_proposals.dptr_, score.dptr_);
+    FRCNN_CUDA_CHECK(cudaPeekAtLastError());
+
+    // argsort the scores of every image, save order
+    char* sort_workspace_ptr = NULL;
+    const size_t sort_workspace_size = nms::SortSegmentsWorkspaceSize(count);
+    FRCNN_CUDA_CHECK(cudaMalloc(&sort_workspace_ptr, sort_workspace_size));
+    Tensor<xpu, 1, char> sort_workspace(sort_workspace_ptr, Shape1(sort_workspace_size), s);
+    nms::SortSegmentsDescending(score, order, segment, count_anchors, &sort_workspace);
+    FRCNN_CUDA_CHECK(cudaFree(sort_workspace_ptr));
 
+    // Reorder proposals according to order
     float* workspace_ordered_proposals_ptr = NULL;
     FRCNN_CUDA_CHECK(cudaMalloc(&workspace_ordered_proposals_ptr,
-        sizeof(float) * rpn_pre_nms_top_n * 5));
-    Tensor<xpu, 2> workspace_ordered_proposals(workspace_ordered_proposals_ptr,
-        Shape2(rpn_pre_nms_top_n, 5));
+        sizeof(float) * num_images * rpn_pre_nms_top_n * 5));
+    Tensor<xpu, 3> workspace_ordered_proposals(workspace_ordered_proposals_ptr,
+        Shape3(num_images, rpn_pre_nms_top_n, 5));
+
+    dimGrid.x = (num_images * rpn_pre_nms_top_n + kMaxThreadsPerBlock - 1) / kMaxThreadsPerBlock;
+    CheckLaunchParam(dimGrid, dimBlock, "ReorderProposals");
+    ReorderProposalsKernel<<<dimGrid, dimBlock, 0, stream>>>(
+      num_images * rpn_pre_nms_top_n, rpn_pre_nms_top_n, count_anchors,
+      workspace_proposals.dptr_, order.dptr_, workspace_ordered_proposals.dptr_);
+    FRCNN_CUDA_CHECK(cudaPeekAtLastError());
 
+    FRCNN_CUDA_CHECK(cudaFree(workspace_proposals_ptr));
+    FRCNN_CUDA_CHECK(cudaFree(score_ptr));
+    FRCNN_CUDA_CHECK(cudaFree(order_ptr));
+
+    // perform nms on all the images at once,
+    // the first rpn_post_nms_top_n kept boxes of each are all that is used
+    uint64_t* mask = NULL;
+    FRCNN_CUDA_CHECK(cudaMalloc(&mask, nms::MaskSize(num_images, rpn_pre_nms_top_n)));
     int* keep;
-    FRCNN_CUDA_CHECK(cudaMalloc(&keep, sizeof(int) * rpn_pre_nms_top_n));
-
-    for (int b = 0; b < num_images; b++) {
-        CheckLaunchParam(dimGrid, dimBlock, "CopyScore");
-        CopyScoreKernel << <dimGrid, dimBlock >> >(
-            count_anchors, workspace_proposals.dptr_ + b * count_anchors * 5,
-            score.dptr_, order.dptr_);
-        FRCNN_CUDA_CHECK(cudaPeekAtLastError());
-
-        // argsort score, save order
-        thrust::stable_sort_by_key(thrust::device,
-            score.dptr_,
-            score.dptr_ + score.size(0),
-            order.dptr_,
-            thrust::greater<real_t>());
-        FRCNN_CUDA_CHECK(cudaPeekAtLastError());
-
-        // Reorder proposals according to order
-
-        dimGrid.x = (rpn_pre_nms_top_n + kMaxThreadsPerBlock - 1) / kMaxThreadsPerBlock;
-        CheckLaunchParam(dimGrid, dimBlock, "ReorderProposals");
-        ReorderProposalsKernel << <dimGrid, dimBlock >> >(
-            rpn_pre_nms_top_n, workspace_proposals.dptr_ + b * count_anchors * 5,
-            order.dptr_, workspace_ordered_proposals.dptr_);
-        FRCNN_CUDA_CHECK(cudaPeekAtLastError());
-
-        // perform nms
-        std::vector<int> _keep(workspace_ordered_proposals.size(0));
-        int out_size = 0;
-        _nms(workspace_ordered_proposals,
-            param_.threshold,
-            &_keep[0],
-            &out_size);
-
-        // copy nms result to gpu
-        FRCNN_CUDA_CHECK(cudaMemcpy(keep, &_keep[0], sizeof(int) * _keep.size(),
-            cudaMemcpyHostToDevice));
-
-        // copy results after nms
-        dimGrid.x = (rpn_post_nms_top_n + kMaxThreadsPerBlock - 1) / kMaxThreadsPerBlock;
-        CheckLaunchParam(dimGrid, dimBlock, "PrepareOutput");
-        PrepareOutput << <dimGrid, dimBlock >> >(
-            rpn_post_nms_top_n, workspace_ordered_proposals.dptr_, keep, out_size, b,
-            out.dptr_ + b * rpn_post_nms_top_n * 5, out_score.dptr_ + b * rpn_post_nms_top_n);
-        FRCNN_CUDA_CHECK(cudaPeekAtLastError());
-    }
+    FRCNN_CUDA_CHECK(cudaMalloc(&keep, sizeof(int) * num_images * (rpn_pre_nms_top_n + 1)));
+    int* num_keep = keep + num_images * rpn_pre_nms_top_n;
+    nms::BoxLayout layout;
+    layout.image_stride = rpn_pre_nms_top_n * 5;
+    layout.box_stride = 5;
+    layout.coord = 0;
+    layout.cls = -1;
+    nms::NonMaximumSuppression<nms::PixelOverlap>(s, workspace_ordered_proposals.dptr_,
+                                                  layout, num_images, rpn_pre_nms_top_n, NULL,
+                                                  param_.threshold, rpn_post_nms_top_n, mask,
+                                                  keep, num_keep, NULL);
+    FRCNN_CUDA_CHECK(cudaFree(mask));
+
+    // copy results after nms
+    dimGrid.x = (num_images * rpn_post_nms_top_n + kMaxThreadsPerBlock - 1) / kMaxThreadsPerBlock;
+    CheckLaunchParam(dimGrid, dimBlock, "PrepareOutput");
+    PrepareOutput<<<dimGrid, dimBlock, 0, stream>>>(
+      num_images * rpn_post_nms_top_n, rpn_pre_nms_top_n, rpn_post_nms_top_n,
+      workspace_ordered_proposals.dptr_, keep, num_keep, out.dptr_, out_score.dptr_);
+    FRCNN_CUDA_CHECK(cudaPeekAtLastError());
+
     // free temporary memory
     FRCNN_CUDA_CHECK(cudaFree(keep));
     FRCNN_CUDA_CHECK(cudaFree(workspace_ordered_proposals_ptr));
-    FRCNN_CUDA_CHECK(cudaFree(workspace_proposals_ptr));
-    FRCNN_CUDA_CHECK(cudaFree(score_ptr));
-    FRCNN_CUDA_CHECK(cudaFree(order_ptr));
   }
 
   virtual void Backward(const OpContext &ctx,
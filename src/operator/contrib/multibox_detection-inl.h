@@ -98,10 +98,11 @@ class MultiBoxDetectionOp : public Operator {
        .get_with_shape<xpu, 2, DType>(Shape2(ashape[1], 4), s);
      Tensor<xpu, 3, DType> out = out_data[mboxdet_enum::kOut]
        .get<xpu, 3, DType>(s);
-     Tensor<xpu, 3, DType> temp_space = ctx.requested[mboxdet_enum::kTempSpace]
-       .get_space_typed<xpu, 3, DType>(out.shape_, s);
+     Tensor<xpu, 1, char> workspace = ctx.requested[mboxdet_enum::kTempSpace]
+       .get_space_typed<xpu, 1, char>(
+         Shape1(MultiBoxDetectionWorkspaceSize(out, param_.nms_topk)), s);
      out = -1.f;
-     MultiBoxDetectionForward(out, cls_prob, loc_pred, anchors, temp_space,
+     MultiBoxDetectionForward(out, cls_prob, loc_pred, anchors, workspace,
        param_.threshold, param_.clip, param_.variances, param_.nms_threshold,
        param_.force_suppress, param_.nms_topk);
   }
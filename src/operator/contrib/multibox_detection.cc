@@ -78,12 +78,18 @@ inline DType CalculateOverlap(const DType *a, const DType *b) {
   return u <= 0.f ? static_cast<DType>(0) : static_cast<DType>(i / u);
 }
 
+template<typename DType>
+inline size_t MultiBoxDetectionWorkspaceSize(const Tensor<cpu, 3, DType> &out,
+                                             const int nms_topk) {
+  return out.shape_.Size() * sizeof(DType);
+}
+
 template<typename DType>
 inline void MultiBoxDetectionForward(const Tensor<cpu, 3, DType> &out,
                                      const Tensor<cpu, 3, DType> &cls_prob,
                                      const Tensor<cpu, 2, DType> &loc_pred,
                                      const Tensor<cpu, 2, DType> &anchors,
-                                     const Tensor<cpu, 3, DType> &temp_space,
+                                     const Tensor<cpu, 1, char> &workspace,
                                      const float threshold,
                                      const bool clip,
                                      const nnvm::Tuple<float> &variances,
@@ -95,6 +101,8 @@ inline void MultiBoxDetectionForward(const Tensor<cpu, 3, DType> &out,
   const int num_anchors = cls_prob.size(2);
   const int num_batches = cls_prob.size(0);
   const DType *p_anchor = anchors.dptr_;
+  Tensor<cpu, 3, DType> temp_space(reinterpret_cast<DType*>(workspace.dptr_), out.shape_,
+                                   out.stream_);
   for (int nbatch = 0; nbatch < num_batches; ++nbatch) {
     const DType *p_cls_prob = cls_prob.dptr_ + nbatch * num_classes * num_anchors;
     const DType *p_loc_pred = loc_pred.dptr_ + nbatch * num_anchors * 4;
@@ -24,6 +24,8 @@
 */
 #include "./multibox_detection-inl.h"
 #include <mshadow/cuda/tensor_gpu-inl.cuh>
+#include <cfloat>
+#include "./nms.cuh"
 
 #define MULTIBOX_DETECTION_CUDA_CHECK(condition) \
   /* Code block avoids redefinition of cudaError_t error */ \
@@ -40,42 +42,26 @@ __device__ void Clip(DType *value, const DType lower, const DType upper) {
   if ((*value) > upper) *value = upper;
 }
 
+// decodes the best class and the box of every anchor of every image into dets,
+// with the score as sort key, and counts the positive detections of each image
 template<typename DType>
-__device__ void CalculateOverlap(const DType *a, const DType *b, DType *iou) {
-  DType w = max(DType(0), min(a[2], b[2]) - max(a[0], b[0]));
-  DType h = max(DType(0), min(a[3], b[3]) - max(a[1], b[1]));
-  DType i = w * h;
-  DType u = (a[2] - a[0]) * (a[3] - a[1]) + (b[2] - b[0]) * (b[3] - b[1]) - i;
-  (*iou) =  u <= 0.f ? static_cast<DType>(0) : static_cast<DType>(i / u);
-}
-
-template<typename DType>
-__global__ void DetectionForwardKernel(DType *out, const DType *cls_prob,
-                                       const DType *loc_pred, const DType *anchors,
-                                       DType *temp_space, const int num_classes,
-                                       const int num_anchors, const float threshold,
-                                       const bool clip, const float vx,
-                                       const float vy, const float vw,
-                                       const float vh, const float nms_threshold,
-                                       const bool force_suppress, const int nms_topk) {
-  const int nbatch = blockIdx.x;  // each block for each batch
-  int index = threadIdx.x;
-  __shared__ int valid_count;
-  out += nbatch * num_anchors * 6;
-  cls_prob += nbatch * num_anchors * num_classes;
-  loc_pred += nbatch * num_anchors * 4;
-
-  if (index == 0) {
-    valid_count = 0;
-  }
-  __syncthreads();
-
-  // apply prediction to anchors
-  for (int i = index; i < num_anchors; i += blockDim.x) {
+__global__ void DetectionDecodeKernel(const int count, DType *dets, float *keys,
+                                      int *num_valid, const DType *cls_prob,
+                                      const DType *loc_pred, const DType *anchors,
+                                      const int num_classes, const int num_anchors,
+                                      const float threshold, const bool clip,
+                                      const float vx, const float vy,
+                                      const float vw, const float vh) {
+  for (int index = blockIdx.x * blockDim.x + threadIdx.x;
+       index < count;
+       index += blockDim.x * gridDim.x) {
+    const int nbatch = index / num_anchors;
+    const int i = index % num_anchors;
+    const DType *p_cls_prob = cls_prob + nbatch * num_anchors * num_classes;
     DType score = -1;
     int id = 0;
     for (int j = 1; j < num_classes; ++j) {
-      DType temp = cls_prob[j * num_anchors + i];
+      DType temp = p_cls_prob[j * num_anchors + i];
       if (temp > score) {
         score = temp;
         id = j;
@@ -84,149 +70,204 @@ __global__ void DetectionForwardKernel(DType *out, const DType *cls_prob,
     if (id > 0 && score < threshold) {
       id = 0;
     }
-
-    if (id > 0) {
-      // valid class
-      int pos = atomicAdd(&valid_count, 1);
-      out[pos * 6] = id - 1;  // restore original class id
-      out[pos * 6 + 1] = (id == 0 ? DType(-1) : score);
-      int offset = i * 4;
-      DType al = anchors[offset];
-      DType at = anchors[offset + 1];
-      DType ar = anchors[offset + 2];
-      DType ab = anchors[offset + 3];
-      DType aw = ar - al;
-      DType ah = ab - at;
-      DType ax = (al + ar) / 2.f;
-      DType ay = (at + ab) / 2.f;
-      DType ox = loc_pred[offset] * vx * aw + ax;
-      DType oy = loc_pred[offset + 1] * vy * ah + ay;
-      DType ow = exp(loc_pred[offset + 2] * vw) * aw / 2;
-      DType oh = exp(loc_pred[offset + 3] * vh) * ah / 2;
-      DType xmin = ox - ow;
-      DType ymin = oy - oh;
-      DType xmax = ox + ow;
-      DType ymax = oy + oh;
-      if (clip) {
-        Clip(&xmin, DType(0), DType(1));
-        Clip(&ymin, DType(0), DType(1));
-        Clip(&xmax, DType(0), DType(1));
-        Clip(&ymax, DType(0), DType(1));
-      }
-      out[pos * 6 + 2] = xmin;
-      out[pos * 6 + 3] = ymin;
-      out[pos * 6 + 4] = xmax;
-      out[pos * 6 + 5] = ymax;
+    if (id == 0) {
+      keys[index] = -FLT_MAX;
+      continue;
     }
-  }
-  __syncthreads();
-
-  if (valid_count < 1 || nms_threshold <= 0 || nms_threshold > 1) return;
-  // if (index == 0) printf("%d\n", valid_count);
-
-  // descent sort according to scores
-  const int size = valid_count;
-  temp_space += nbatch * num_anchors * 6;
-  DType *src = out;
-  DType *dst = temp_space;
-  for (int width = 2; width < (size << 1); width <<= 1) {
-    int slices = (size - 1) / (blockDim.x * width) + 1;
-    int start = width * index * slices;
-    for (int slice = 0; slice < slices; ++slice) {
-      if (start >= size) break;
-      int middle = start + (width >> 1);
-      if (middle > size) middle = size;
-      int end = start + width;
-      if (end > size) end = size;
-      int i = start;
-      int j = middle;
-      for (int k = start; k < end; ++k) {
-        DType score_i = i < size ? src[i * 6 + 1] : DType(-1);
-        DType score_j = j < size ? src[j * 6 + 1] : DType(-1);
-        if (i < middle && (j >= end || score_i > score_j)) {
-          for (int n = 0; n < 6; ++n) {
-            dst[k * 6 + n] = src[i * 6 + n];
-          }
-          ++i;
-        } else {
-          for (int n = 0; n < 6; ++n) {
-            dst[k * 6 + n] = src[j * 6 + n];
-          }
-          ++j;
-        }
-      }
-      start += width;
+    keys[index] = static_cast<float>(score);
+    atomicAdd(num_valid + nbatch, 1);
+    DType *out = dets + index * 6;
+    out[0] = id - 1;  // restore original class id
+    out[1] = score;
+    int offset = i * 4;
+    const DType *p_loc_pred = loc_pred + index * 4;
+    DType al = anchors[offset];
+    DType at = anchors[offset + 1];
+    DType ar = anchors[offset + 2];
+    DType ab = anchors[offset + 3];
+    DType aw = ar - al;
+    DType ah = ab - at;
+    DType ax = (al + ar) / 2.f;
+    DType ay = (at + ab) / 2.f;
+    DType ox = p_loc_pred[0] * vx * aw + ax;
+    DType oy = p_loc_pred[1] * vy * ah + ay;
+    DType ow = exp(p_loc_pred[2] * vw) * aw / 2;
+    DType oh = exp(p_loc_pred[3] * vh) * ah / 2;
+    DType xmin = ox - ow;
+    DType ymin = oy - oh;
+    DType xmax = ox + ow;
+    DType ymax = oy + oh;
+    if (clip) {
+      Clip(&xmin, DType(0), DType(1));
+      Clip(&ymin, DType(0), DType(1));
+      Clip(&xmax, DType(0), DType(1));
+      Clip(&ymax, DType(0), DType(1));
     }
-    __syncthreads();
-    src = src == out? temp_space : out;
-    dst = dst == out? temp_space : out;
+    out[2] = xmin;
+    out[3] = ymin;
+    out[4] = xmax;
+    out[5] = ymax;
   }
-  __syncthreads();
+}
 
-  if (src == temp_space) {
-    // copy from temp to out
-    for (int i = index; i < size * 6; i += blockDim.x) {
-      out[i] = temp_space[i];
+// writes the positive detections of each image in decreasing score order,
+// invalidating the ones past nms_topk
+template<typename DType>
+__global__ void DetectionGatherKernel(const int count, DType *out, const DType *dets,
+                                      const int *order, const int *num_valid,
+                                      const int num_anchors, const int nms_topk) {
+  for (int index = blockIdx.x * blockDim.x + threadIdx.x;
+       index < count;
+       index += blockDim.x * gridDim.x) {
+    const int k = index % num_anchors;
+    if (k >= num_valid[index / num_anchors]) continue;
+    const DType *src = dets + order[index] * 6;
+    for (int j = 0; j < 6; ++j) {
+      out[index * 6 + j] = src[j];
     }
-    __syncthreads();
-  }
-
-  // keep top k detections
-  int ntop = size;
-  if (nms_topk > 0 && nms_topk < ntop) {
-    ntop = nms_topk;
-    for (int i = ntop + index; i < size; i += blockDim.x) {
-      out[i * 6] = -1;
+    if (nms_topk > 0 && k >= nms_topk) {
+      out[index * 6] = -1;
     }
-    __syncthreads();
   }
+}
 
-  // apply NMS
-  for (int compare_pos = 0; compare_pos < ntop; ++compare_pos) {
-    DType compare_id = out[compare_pos * 6];
-    if (compare_id < 0) continue;  // not a valid positive detection, skip
-    DType *compare_loc_ptr = out + compare_pos * 6 + 2;
-    for (int i = compare_pos + index + 1; i < ntop; i += blockDim.x) {
-      DType class_id = out[i * 6];
-      if (class_id < 0) continue;
-      if (force_suppress || (class_id == compare_id)) {
-        DType iou;
-        CalculateOverlap(compare_loc_ptr, out + i * 6 + 2, &iou);
-        if (iou >= nms_threshold) {
-          out[i * 6] = -1;
-        }
-      }
+// invalidates the detections the non-maximum suppression removed
+template<typename DType>
+__global__ void DetectionSuppressKernel(const int count, DType *out, const uint64_t *removed,
+                                        const int *num_valid, const int num_anchors,
+                                        const int num_nms) {
+  using mxnet::op::nms::kBoxesPerWord;
+  for (int index = blockIdx.x * blockDim.x + threadIdx.x;
+       index < count;
+       index += blockDim.x * gridDim.x) {
+    const int nbatch = index / num_nms;
+    const int k = index % num_nms;
+    if (k >= num_valid[nbatch]) continue;
+    const uint64_t word =
+      removed[nbatch * mxnet::op::nms::MaskWords(num_nms) + k / kBoxesPerWord];
+    if (word & (1ULL << (k % kBoxesPerWord))) {
+      out[(nbatch * num_anchors + k) * 6] = -1;
     }
-    __syncthreads();
   }
 }
 }  // namespace cuda
 
+/*!
+ * \brief the workspace is laid out as the nms mask and removed bits, the decoded
+ *  detections, the sort keys, order, segment ids and valid counts, then the
+ *  workspace of the sort. Without a base only the size is computed.
+ */
+struct MultiBoxDetectionWorkspace {
+  uint64_t *mask;
+  uint64_t *removed;
+  char *dets;
+  float *keys;
+  int *order;
+  int *segment;
+  int *num_valid;
+  Tensor<gpu, 1, char> sort_workspace;
+  size_t size;
+
+  MultiBoxDetectionWorkspace(int num_batches, int num_anchors, int num_nms, size_t dets_size,
+                             char *base) : size(0) {
+    using mxnet::op::nms::MaskSize;
+    using mxnet::op::nms::MaskWords;
+    const int count = num_batches * num_anchors;
+    mask = Take<uint64_t>(base, MaskSize(num_batches, num_nms));
+    removed = Take<uint64_t>(base, num_batches * MaskWords(num_nms) * sizeof(uint64_t));
+    dets = Take<char>(base, dets_size);
+    keys = Take<float>(base, count * sizeof(float));
+    order = Take<int>(base, count * sizeof(int));
+    segment = Take<int>(base, count * sizeof(int));
+    num_valid = Take<int>(base, num_batches * sizeof(int));
+    const size_t sort_size = mxnet::op::nms::SortSegmentsWorkspaceSize(count);
+    sort_workspace = Tensor<gpu, 1, char>(Take<char>(base, sort_size), Shape1(sort_size));
+  }
+
+ private:
+  template<typename T>
+  T *Take(char *base, size_t bytes) {
+    T *ptr = base ? reinterpret_cast<T*>(base + size) : NULL;
+    size += bytes;
+    return ptr;
+  }
+};
+
+inline int MultiBoxDetectionNumNMS(int num_anchors, int nms_topk) {
+  return nms_topk > 0 ? std::min(num_anchors, nms_topk) : num_anchors;
+}
+
+template<typename DType>
+inline size_t MultiBoxDetectionWorkspaceSize(const Tensor<gpu, 3, DType> &out,
+                                             const int nms_topk) {
+  const int num_anchors = out.size(1);
+  MultiBoxDetectionWorkspace ws(out.size(0), num_anchors,
+                                MultiBoxDetectionNumNMS(num_anchors, nms_topk),
+                                out.shape_.Size() * sizeof(DType), NULL);
+  return ws.size;
+}
+
 template<typename DType>
 inline void MultiBoxDetectionForward(const Tensor<gpu, 3, DType> &out,
                                      const Tensor<gpu, 3, DType> &cls_prob,
                                      const Tensor<gpu, 2, DType> &loc_pred,
                                      const Tensor<gpu, 2, DType> &anchors,
-                                     const Tensor<gpu, 3, DType> &temp_space,
+                                     const Tensor<gpu, 1, char> &workspace,
                                      const float threshold,
                                      const bool clip,
                                      const nnvm::Tuple<float> &variances,
                                      const float nms_threshold,
                                      const bool force_suppress,
                                      const int nms_topk) {
+  using namespace mxnet::op::nms;
   CHECK_EQ(variances.ndim(), 4) << "Variance size must be 4";
   const int num_classes = cls_prob.size(1);
   const int num_anchors = cls_prob.size(2);
   const int num_batches = cls_prob.size(0);
-  const int num_threads = cuda::kMaxThreadsPerBlock;
-  int num_blocks = num_batches;
-  cuda::CheckLaunchParam(num_blocks, num_threads, "MultiBoxDetection Forward");
-  cudaStream_t stream = Stream<gpu>::GetStream(out.stream_);
-  cuda::DetectionForwardKernel<<<num_blocks, num_threads, 0, stream>>>(out.dptr_,
-    cls_prob.dptr_, loc_pred.dptr_, anchors.dptr_, temp_space.dptr_,
+  const int count = num_batches * num_anchors;
+  const bool apply_nms = nms_threshold > 0 && nms_threshold <= 1;
+  const int num_nms = MultiBoxDetectionNumNMS(num_anchors, nms_topk);
+  Stream<gpu> *s = out.stream_;
+  cudaStream_t stream = Stream<gpu>::GetStream(s);
+  MultiBoxDetectionWorkspace ws(num_batches, num_anchors, num_nms,
+                                out.shape_.Size() * sizeof(DType), workspace.dptr_);
+  CHECK_GE(workspace.size(0), ws.size);
+  ws.sort_workspace.stream_ = s;
+  DType *dets = reinterpret_cast<DType*>(ws.dets);
+
+  MULTIBOX_DETECTION_CUDA_CHECK(cudaMemsetAsync(ws.num_valid, 0, num_batches * sizeof(int),
+                                                stream));
+  const int num_threads = cuda::kBaseThreadNum;
+  const int num_blocks = std::min(cuda::kMaxGridNum, (count + num_threads - 1) / num_threads);
+  cuda::DetectionDecodeKernel<<<num_blocks, num_threads, 0, stream>>>(count,
+    dets, ws.keys, ws.num_valid, cls_prob.dptr_, loc_pred.dptr_, anchors.dptr_,
     num_classes, num_anchors, threshold, clip,
-    variances[0], variances[1], variances[2], variances[3],
-    nms_threshold, force_suppress, nms_topk);
+    variances[0], variances[1], variances[2], variances[3]);
+  MULTIBOX_DETECTION_CUDA_CHECK(cudaPeekAtLastError());
+
+  // the positive detections of each image first, by decreasing score
+  SortSegmentsDescending(Tensor<gpu, 1, float>(ws.keys, Shape1(count), s),
+                         Tensor<gpu, 1, int>(ws.order, Shape1(count), s),
+                         Tensor<gpu, 1, int>(ws.segment, Shape1(count), s),
+                         num_anchors, &ws.sort_workspace);
+  cuda::DetectionGatherKernel<<<num_blocks, num_threads, 0, stream>>>(count,
+    out.dptr_, dets, ws.order, ws.num_valid, num_anchors, apply_nms ? nms_topk : -1);
+  MULTIBOX_DETECTION_CUDA_CHECK(cudaPeekAtLastError());
+  if (!apply_nms) return;
+
+  BoxLayout layout;
+  layout.image_stride = num_anchors * 6;
+  layout.box_stride = 6;
+  layout.coord = 2;
+  layout.cls = force_suppress ? -1 : 0;
+  NonMaximumSuppression<ContinuousOverlap>(s, out.dptr_, layout, num_batches, num_nms,
+                                           ws.num_valid, nms_threshold, 0, ws.mask,
+                                           NULL, NULL, ws.removed);
+  const int nms_count = num_batches * num_nms;
+  cuda::DetectionSuppressKernel<<<std::min(cuda::kMaxGridNum,
+                                           (nms_count + num_threads - 1) / num_threads),
+                                  num_threads, 0, stream>>>(nms_count,
+    out.dptr_, ws.removed, ws.num_valid, num_anchors, num_nms);
   MULTIBOX_DETECTION_CUDA_CHECK(cudaPeekAtLastError());
 }
 }  // namespace mshadow
@@ -56,6 +56,17 @@ enum MultiBoxPriorOpInputs {kData};
 enum MultiBoxPriorOpOutputs {kOut};
 }  // namespace mboxprior_enum
 
+/*!
+ * \brief the anchors of the last shape of the data. They only depend on the shape,
+ *  so the cpu operator computes them again only when it changes.
+ */
+template<typename DType>
+struct MultiBoxPriorCache {
+  int height = -1;
+  int width = -1;
+  std::vector<DType> anchors;
+};
+
 struct MultiBoxPriorParam : public dmlc::Parameter<MultiBoxPriorParam> {
   nnvm::Tuple<float> sizes;
   nnvm::Tuple<float> ratios;
@@ -116,16 +127,14 @@ class MultiBoxPriorOp : public Operator {
     Shape<2> oshape = Shape2(num_anchors * in_width * in_height, 4);
     out = out_data[mboxprior_enum::kOut].get_with_shape<xpu, 2, DType>(oshape, s);
     CHECK_GE(steps_[0] * steps_[1], 0) << "Must specify both step_y and step_x";
-    if (steps_[0] <= 0 || steps_[1] <= 0) {
-      // estimate using layer shape
-      steps_[0] = 1.f / in_height;
-      steps_[1] = 1.f / in_width;
-    }
-    MultiBoxPriorForward(out, sizes_, ratios_, in_width, in_height, steps_, offsets_);
-
-    if (clip_) {
-      Assign(out, req[mboxprior_enum::kOut], F<mshadow_op::clip_zero_one>(out));
+    std::vector<float> steps(steps_);
+    if (steps[0] <= 0 || steps[1] <= 0) {
+      // estimate using layer shape, which may change from a forward to the next
+      steps[0] = 1.f / in_height;
+      steps[1] = 1.f / in_width;
     }
+    MultiBoxPriorForward(out, &cache_, sizes_, ratios_, in_width, in_height, steps, offsets_,
+                         clip_);
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -148,6 +157,7 @@ class MultiBoxPriorOp : public Operator {
   std::vector<float> ratios_;
   std::vector<float> steps_;
   std::vector<float> offsets_;
+  MultiBoxPriorCache<DType> cache_;
 };  // class MultiBoxPriorOp
 
 template<typename xpu>
@@ -24,15 +24,22 @@
 */
 
 #include "./multibox_prior-inl.h"
+#include <algorithm>
 
 namespace mshadow {
 template<typename DType>
 inline void MultiBoxPriorForward(const Tensor<cpu, 2, DType> &out,
+                            mxnet::op::MultiBoxPriorCache<DType> *cache,
                             const std::vector<float> &sizes,
                             const std::vector<float> &ratios,
                             const int in_width, const int in_height,
                             const std::vector<float> &steps,
-                            const std::vector<float> &offsets) {
+                            const std::vector<float> &offsets,
+                            const bool clip) {
+  if (cache->height == in_height && cache->width == in_width) {
+    std::copy(cache->anchors.begin(), cache->anchors.end(), out.dptr_);
+    return;
+  }
   const float step_x = steps[1];
   const float step_y = steps[0];
   const int num_sizes = static_cast<int>(sizes.size());
@@ -68,6 +75,13 @@ inline void MultiBoxPriorForward(const Tensor<cpu, 2, DType> &out,
       }
     }
   }
+  if (clip) {
+    Tensor<cpu, 2, DType> anchors(out);
+    anchors = expr::F<mxnet::op::mshadow_op::clip_zero_one>(anchors);
+  }
+  cache->anchors.assign(out.dptr_, out.dptr_ + out.shape_.Size());
+  cache->height = in_height;
+  cache->width = in_width;
 }
 }  // namespace mshadow
 
@@ -60,11 +60,14 @@ __global__ void AssignPriors(DType *out, const float size,
 
 template<typename DType>
 inline void MultiBoxPriorForward(const Tensor<gpu, 2, DType> &out,
+                            mxnet::op::MultiBoxPriorCache<DType> *cache,
                             const std::vector<float> &sizes,
                             const std::vector<float> &ratios,
                             const int in_width, const int in_height,
                             const std::vector<float> &steps,
-                            const std::vector<float> &offsets) {
+                            const std::vector<float> &offsets,
+                            const bool clip) {
+  // the cache is left to the cpu: generating the anchors costs no more than copying them
   CHECK_EQ(out.CheckContiguous(), true);
   cudaStream_t stream = Stream<gpu>::GetStream(out.stream_);
   DType *out_ptr = out.dptr_;
@@ -98,6 +101,10 @@ inline void MultiBoxPriorForward(const Tensor<gpu, 2, DType> &out,
     ++offset;
   }
   MULTIBOXPRIOR_CUDA_CHECK(cudaPeekAtLastError());
+  if (clip) {
+    Tensor<gpu, 2, DType> anchors(out);
+    anchors = expr::F<mxnet::op::mshadow_op::clip_zero_one>(anchors);
+  }
 }
 }  // namespace mshadow
 
@@ -36,6 +36,7 @@
 #include <valarray>
 #include "../operator_common.h"
 #include "../mshadow_op.h"
+#include "../mxnet_op.h"
 
 namespace mxnet {
 namespace op {
@@ -56,6 +57,41 @@ enum MultiBoxTargetOpOutputs {kLoc, kLocMask, kCls};
 enum MultiBoxTargetOpResource {kTempSpace};
 }  // namespace mboxtarget_enum
 
+namespace mboxtarget {
+/*! \brief the IoU of each anchor with each label of each batch, in one pass */
+struct overlaps {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType *out, const DType *anchors,
+                                  const DType *labels, const int num_anchors,
+                                  const int num_labels, const int label_width) {
+    const int l = i % num_labels;
+    const int a = (i / num_labels) % num_anchors;
+    const int b = i / (num_labels * num_anchors);
+    const DType *anchor = anchors + a * 4;
+    const DType *label = labels + (b * num_labels + l) * label_width + 1;
+    DType iw = (anchor[2] < label[2] ? anchor[2] : label[2]) -
+               (anchor[0] > label[0] ? anchor[0] : label[0]);
+    DType ih = (anchor[3] < label[3] ? anchor[3] : label[3]) -
+               (anchor[1] > label[1] ? anchor[1] : label[1]);
+    iw = iw > DType(0) ? iw : DType(0);
+    ih = ih > DType(0) ? ih : DType(0);
+    const DType intersection = iw * ih;
+    const DType area = (anchor[2] - anchor[0]) * (anchor[3] - anchor[1])
+                       + (label[2] - label[0]) * (label[3] - label[1]) - intersection;
+    out[i] = mshadow_op::safe_divide::Map(intersection, area);
+  }
+};
+
+/*!
+ * \brief the size of the workspace of MultiBoxTargetForward: the overlaps, then
+ *  the flags of the labels, and the matches and flags of the anchors on the gpu
+ */
+inline size_t WorkspaceSize(index_t num_batches, index_t num_anchors, index_t num_labels) {
+  return static_cast<size_t>(num_batches) * (num_anchors * num_labels + num_labels +
+                                             7 * num_anchors);
+}
+}  // namespace mboxtarget
+
 struct MultiBoxTargetParam : public dmlc::Parameter<MultiBoxTargetParam> {
   float overlap_threshold;
   float ignore_label;
@@ -115,50 +151,24 @@ class MultiBoxTargetOp : public Operator {
     index_t num_anchors = anchors.size(0);
     index_t num_labels = labels.size(1);
     // TODO(zhreshold): use maximum valid ground-truth in batch rather than # in dataset
-    Shape<4> temp_shape = Shape4(11, num_batches, num_anchors, num_labels);
-    Tensor<xpu, 4, DType> temp_space = ctx.requested[mboxtarget_enum::kTempSpace]
-      .get_space_typed<xpu, 4, DType>(temp_shape, s);
+    Shape<1> temp_shape = Shape1(mboxtarget::WorkspaceSize(num_batches, num_anchors,
+                                                           num_labels));
+    Tensor<xpu, 1, DType> temp_space = ctx.requested[mboxtarget_enum::kTempSpace]
+      .get_space_typed<xpu, 1, DType>(temp_shape, s);
     loc_target = 0.f;
     loc_mask = 0.0f;
     cls_target = param_.ignore_label;
-    temp_space = -1.0f;
     CHECK_EQ(anchors.CheckContiguous(), true);
     CHECK_EQ(labels.CheckContiguous(), true);
     CHECK_EQ(cls_preds.CheckContiguous(), true);
     CHECK_EQ(loc_target.CheckContiguous(), true);
     CHECK_EQ(loc_mask.CheckContiguous(), true);
     CHECK_EQ(cls_target.CheckContiguous(), true);
-    CHECK_EQ(temp_space.CheckContiguous(), true);
 
     // compute overlaps
-    // TODO(zhreshold): squeeze temporary memory space
-    // temp_space, 0:out, 1:l1, 2:t1, 3:r1, 4:b1, 5:l2, 6:t2, 7:r2, 8:b2
-    // 9: intersection, 10:union
-    temp_space[1] = broadcast_keepdim(broadcast_with_axis(slice<1>(anchors, 0, 1), -1,
-      num_batches), 2, num_labels);
-    temp_space[2] = broadcast_keepdim(broadcast_with_axis(slice<1>(anchors, 1, 2), -1,
-      num_batches), 2, num_labels);
-    temp_space[3] = broadcast_keepdim(broadcast_with_axis(slice<1>(anchors, 2, 3), -1,
-      num_batches), 2, num_labels);
-    temp_space[4] = broadcast_keepdim(broadcast_with_axis(slice<1>(anchors, 3, 4), -1,
-      num_batches), 2, num_labels);
-    Shape<3> temp_reshape = Shape3(num_batches, 1, num_labels);
-    temp_space[5] = broadcast_keepdim(reshape(slice<2>(labels, 1, 2), temp_reshape), 1,
-      num_anchors);
-    temp_space[6] = broadcast_keepdim(reshape(slice<2>(labels, 2, 3), temp_reshape), 1,
-      num_anchors);
-    temp_space[7] = broadcast_keepdim(reshape(slice<2>(labels, 3, 4), temp_reshape), 1,
-      num_anchors);
-    temp_space[8] = broadcast_keepdim(reshape(slice<2>(labels, 4, 5), temp_reshape), 1,
-      num_anchors);
-    temp_space[9] = F<maximum>(ScalarExp<DType>(0.0f),
-      F<minimum>(temp_space[3], temp_space[7]) - F<maximum>(temp_space[1], temp_space[5]))
-        * F<maximum>(ScalarExp<DType>(0.0f),
-        F<minimum>(temp_space[4], temp_space[8]) - F<maximum>(temp_space[2], temp_space[6]));
-    temp_space[10] = (temp_space[3] - temp_space[1]) * (temp_space[4] - temp_space[2])
-     + (temp_space[7] - temp_space[5]) * (temp_space[8] - temp_space[6])
-      - temp_space[9];
-    temp_space[0] = F<safe_divide>(temp_space[9], temp_space[10]);
+    mxnet_op::Kernel<mboxtarget::overlaps, xpu>::Launch(s,
+      num_batches * num_anchors * num_labels, temp_space.dptr_, anchors.dptr_, labels.dptr_,
+      num_anchors, num_labels, labels.size(2));
 
     MultiBoxTargetForward(loc_target, loc_mask, cls_target,
                           anchors, labels, cls_preds, temp_space,
@@ -50,19 +50,47 @@ __global__ void InitGroundTruthFlags(DType *gt_flags, const DType *labels,
   }
 }
 
+/*!
+ * \brief the best match of an anchor within the ground-truths that are not
+ *  matched yet, the first one of equal overlaps.
+ */
+template<typename DType>
+__device__ void FindFreeMatch(DType *iou, DType *gt, const DType *overlaps,
+                              const DType *gt_flags, const int num_labels) {
+  int idx = -1;
+  DType max_value = -1.f;
+  for (int j = 0; j < num_labels; ++j) {
+    if (gt_flags[j] > .5 && overlaps[j] > max_value) {
+      idx = j;
+      max_value = overlaps[j];
+    }
+  }
+  *iou = max_value;
+  *gt = idx;
+}
+
 template<typename DType>
 __global__ void FindBestMatches(DType *best_matches, DType *gt_flags,
-                                DType *anchor_flags, const DType *overlaps,
-                                const int num_anchors, const int num_labels) {
+                                DType *anchor_flags, DType *free_matches,
+                                const DType *overlaps, const int num_anchors,
+                                const int num_labels) {
   int nbatch = blockIdx.x;
   gt_flags += nbatch * num_labels;
   overlaps += nbatch * num_anchors * num_labels;
   best_matches += nbatch * num_anchors;
   anchor_flags += nbatch * num_anchors;
+  // the best free match of each anchor, kept over the iterations
+  DType *free_iou = free_matches + nbatch * num_anchors * 2;
+  DType *free_gt = free_iou + num_anchors;
   const int num_threads = kMaxThreadsPerBlock;
-  __shared__ int max_indices_y[kMaxThreadsPerBlock];
-  __shared__ int max_indices_x[kMaxThreadsPerBlock];
+  __shared__ int max_indices[kMaxThreadsPerBlock];
   __shared__ float max_values[kMaxThreadsPerBlock];
+  __shared__ int matched_gt;
+
+  for (int i = threadIdx.x; i < num_anchors; i += num_threads) {
+    FindFreeMatch(free_iou + i, free_gt + i, overlaps + i * num_labels, gt_flags, num_labels);
+  }
+  __syncthreads();
 
   while (1) {
     // check if all done.
@@ -75,52 +103,62 @@ __global__ void FindBestMatches(DType *best_matches, DType *gt_flags,
     }
     if (finished) break;  // all done.
 
-    // finding max indices in different threads
-    int max_x = -1;
+    // finding the first anchor with the best free match in different threads
     int max_y = -1;
-    DType max_value = 1e-6;  // start with very small overlap
+    float max_value = 1e-6;  // start with very small overlap
     for (int i = threadIdx.x; i < num_anchors; i += num_threads) {
       if (anchor_flags[i] > .5) continue;
-      for (int j = 0; j < num_labels; ++j) {
-        if (gt_flags[j] > .5) {
-          DType temp = overlaps[i * num_labels + j];
-          if (temp > max_value) {
-            max_x = j;
-            max_y = i;
-            max_value = temp;
-          }
-        }
+      if (free_iou[i] > max_value) {
+        max_y = i;
+        max_value = free_iou[i];
       }
     }
-    max_indices_x[threadIdx.x] = max_x;
-    max_indices_y[threadIdx.x] = max_y;
+    max_indices[threadIdx.x] = max_y;
     max_values[threadIdx.x] = max_value;
     __syncthreads();
 
-    if (threadIdx.x == 0) {
-      // merge results and assign best match
-      int max_x = -1;
-      int max_y = -1;
-      DType max_value = -1;
-      for (int k = 0; k < num_threads; ++k) {
-        if (max_indices_y[k] < 0 || max_indices_x[k] < 0) continue;
-        float temp = max_values[k];
-        if (temp > max_value) {
-          max_x = max_indices_x[k];
-          max_y = max_indices_y[k];
-          max_value = temp;
+    // merge results, the first anchor of equal overlaps wins as on the cpu
+    for (int stride = num_threads / 2; stride > 0; stride >>= 1) {
+      if (threadIdx.x < stride) {
+        const int other = threadIdx.x + stride;
+        const int y = max_indices[threadIdx.x];
+        const int other_y = max_indices[other];
+        if (other_y >= 0 && (y < 0 || max_values[other] > max_values[threadIdx.x] ||
+            (max_values[other] == max_values[threadIdx.x] && other_y < y))) {
+          max_indices[threadIdx.x] = other_y;
+          max_values[threadIdx.x] = max_values[other];
         }
       }
-      if (max_x >= 0 && max_y >= 0) {
-        best_matches[max_y] = max_x;
+      __syncthreads();
+    }
+
+    if (threadIdx.x == 0) {
+      // assign best match
+      const int best_y = max_indices[0];
+      if (best_y >= 0) {
+        const int best_x = static_cast<int>(free_gt[best_y]);
+        best_matches[best_y] = best_x;
         // mark flags as visited
-        gt_flags[max_x] = 0.f;
-        anchor_flags[max_y] = 1.f;
+        gt_flags[best_x] = 0.f;
+        anchor_flags[best_y] = 1.f;
+        matched_gt = best_x;
       } else {
         // no more good matches
         for (int i = 0; i < num_labels; ++i) {
           gt_flags[i] = 0.f;
         }
+        matched_gt = -1;
+      }
+    }
+    __syncthreads();
+
+    // only the anchors best matched with the matched ground-truth look again
+    if (matched_gt >= 0) {
+      for (int i = threadIdx.x; i < num_anchors; i += num_threads) {
+        if (anchor_flags[i] < .5 && static_cast<int>(free_gt[i]) == matched_gt) {
+          FindFreeMatch(free_iou + i, free_gt + i, overlaps + i * num_labels, gt_flags,
+                        num_labels);
+        }
       }
     }
     __syncthreads();
@@ -129,31 +167,26 @@ __global__ void FindBestMatches(DType *best_matches, DType *gt_flags,
 
 template<typename DType>
 __global__ void FindGoodMatches(DType *best_matches, DType *anchor_flags,
-                                const DType *overlaps, const int num_anchors,
+                                const DType *overlaps, const int num,
                                 const int num_labels,
                                 const float overlap_threshold) {
-  int nbatch = blockIdx.x;
-  overlaps += nbatch * num_anchors * num_labels;
-  best_matches += nbatch * num_anchors;
-  anchor_flags += nbatch * num_anchors;
-  const int num_threads = kMaxThreadsPerBlock;
-
-  for (int i = threadIdx.x; i < num_anchors; i += num_threads) {
-    if (anchor_flags[i] < 0) {
-      int idx = -1;
-      float max_value = -1.f;
-      for (int j = 0; j < num_labels; ++j) {
-        DType temp = overlaps[i * num_labels + j];
-        if (temp > max_value) {
-          max_value = temp;
-          idx = j;
-        }
-      }
-      if (max_value > overlap_threshold && (idx >= 0)) {
-        best_matches[i] = idx;
-        anchor_flags[i] = 0.9f;
+  // one thread per anchor of every batch
+  int i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= num) return;
+  if (anchor_flags[i] < 0) {
+    int idx = -1;
+    float max_value = -1.f;
+    for (int j = 0; j < num_labels; ++j) {
+      DType temp = overlaps[i * num_labels + j];
+      if (temp > max_value) {
+        max_value = temp;
+        idx = j;
       }
     }
+    if (max_value > overlap_threshold && (idx >= 0)) {
+      best_matches[i] = idx;
+      anchor_flags[i] = 0.9f;
+    }
   }
 }
 
@@ -283,54 +316,56 @@ template<typename DType>
 __global__ void AssignTrainigTargets(DType *loc_target, DType *loc_mask,
                                      DType *cls_target, DType *anchor_flags,
                                      DType *best_matches, DType *labels,
-                                     DType *anchors, const int num_anchors,
+                                     DType *anchors, const int num_batches,
+                                     const int num_anchors,
                                      const int num_labels, const int label_width,
                                      const float vx, const float vy,
                                      const float vw, const float vh) {
-  const int nbatch = blockIdx.x;
+  // one thread per anchor of every batch
+  const int index = blockIdx.x * blockDim.x + threadIdx.x;
+  if (index >= num_batches * num_anchors) return;
+  const int nbatch = index / num_anchors;
+  const int i = index % num_anchors;
   loc_target += nbatch * num_anchors * 4;
   loc_mask += nbatch * num_anchors * 4;
   cls_target += nbatch * num_anchors;
   anchor_flags += nbatch * num_anchors;
   best_matches += nbatch * num_anchors;
   labels += nbatch * num_labels * label_width;
-  const int num_threads = kMaxThreadsPerBlock;
 
-  for (int i = threadIdx.x; i < num_anchors; i += num_threads) {
-    if (anchor_flags[i] > 0.5) {
-      // positive sample
-      int offset_l = static_cast<int>(best_matches[i]) * label_width;
-      cls_target[i] = labels[offset_l] + 1;  // 0 reserved for background
-      int offset = i * 4;
-      loc_mask[offset] = 1;
-      loc_mask[offset + 1] = 1;
-      loc_mask[offset + 2] = 1;
-      loc_mask[offset + 3] = 1;
-      // regression targets
-      float al = anchors[offset];
-      float at = anchors[offset + 1];
-      float ar = anchors[offset + 2];
-      float ab = anchors[offset + 3];
-      float aw = ar - al;
-      float ah = ab - at;
-      float ax = (al + ar) * 0.5;
-      float ay = (at + ab) * 0.5;
-      float gl = labels[offset_l + 1];
-      float gt = labels[offset_l + 2];
-      float gr = labels[offset_l + 3];
-      float gb = labels[offset_l + 4];
-      float gw = gr - gl;
-      float gh = gb - gt;
-      float gx = (gl + gr) * 0.5;
-      float gy = (gt + gb) * 0.5;
-      loc_target[offset] = DType((gx - ax) / aw / vx);  // xmin
-      loc_target[offset + 1] = DType((gy - ay) / ah / vy);  // ymin
-      loc_target[offset + 2] = DType(log(gw / aw) / vw);  // xmax
-      loc_target[offset + 3] = DType(log(gh / ah) / vh);  // ymax
-    } else if (anchor_flags[i] < 0.5 && anchor_flags[i] > -0.5) {
-      // background
-      cls_target[i] = 0;
-    }
+  if (anchor_flags[i] > 0.5) {
+    // positive sample
+    int offset_l = static_cast<int>(best_matches[i]) * label_width;
+    cls_target[i] = labels[offset_l] + 1;  // 0 reserved for background
+    int offset = i * 4;
+    loc_mask[offset] = 1;
+    loc_mask[offset + 1] = 1;
+    loc_mask[offset + 2] = 1;
+    loc_mask[offset + 3] = 1;
+    // regression targets
+    float al = anchors[offset];
+    float at = anchors[offset + 1];
+    float ar = anchors[offset + 2];
+    float ab = anchors[offset + 3];
+    float aw = ar - al;
+    float ah = ab - at;
+    float ax = (al + ar) * 0.5;
+    float ay = (at + ab) * 0.5;
+    float gl = labels[offset_l + 1];
+    float gt = labels[offset_l + 2];
+    float gr = labels[offset_l + 3];
+    float gb = labels[offset_l + 4];
+    float gw = gr - gl;
+    float gh = gb - gt;
+    float gx = (gl + gr) * 0.5;
+    float gy = (gt + gb) * 0.5;
+    loc_target[offset] = DType((gx - ax) / aw / vx);  // xmin
+    loc_target[offset + 1] = DType((gy - ay) / ah / vy);  // ymin
+    loc_target[offset + 2] = DType(log(gw / aw) / vw);  // xmax
+    loc_target[offset + 3] = DType(log(gh / ah) / vh);  // ymax
+  } else if (anchor_flags[i] < 0.5 && anchor_flags[i] > -0.5) {
+    // background
+    cls_target[i] = 0;
   }
 }
 }  // namespace cuda
@@ -342,7 +377,7 @@ inline void MultiBoxTargetForward(const Tensor<gpu, 2, DType> &loc_target,
                            const Tensor<gpu, 2, DType> &anchors,
                            const Tensor<gpu, 3, DType> &labels,
                            const Tensor<gpu, 3, DType> &cls_preds,
-                           const Tensor<gpu, 4, DType> &temp_space,
+                           const Tensor<gpu, 1, DType> &temp_space,
                            const float overlap_threshold,
                            const float background_label,
                            const float negative_mining_ratio,
@@ -359,32 +394,40 @@ inline void MultiBoxTargetForward(const Tensor<gpu, 2, DType> &loc_target,
   CHECK_GE(num_anchors, 1);
   CHECK_EQ(variances.ndim(), 4);
 
+  // the workspace holds the overlaps, the flags of the labels, and the
+  // flags, matches, negative mining buffer and free matches of the anchors
+  cudaStream_t stream = Stream<gpu>::GetStream(temp_space.stream_);
+  const int num_all_anchors = num_batches * num_anchors;
+  const DType *overlaps = temp_space.dptr_;
+  DType *gt_flags = temp_space.dptr_ + num_all_anchors * num_labels;
+  DType *anchor_flags = gt_flags + num_batches * num_labels;
+  DType *best_matches = anchor_flags + num_all_anchors;
+  DType *buffer = best_matches + num_all_anchors;
+  DType *free_matches = buffer + 3 * num_all_anchors;
+
   // init ground-truth flags, by checking valid labels
-  temp_space[1] = 0.f;
-  DType *gt_flags = temp_space[1].dptr_;
   const int num_threads = cuda::kMaxThreadsPerBlock;
   dim3 init_thread_dim(num_threads);
   dim3 init_block_dim((num_batches * num_labels - 1) / num_threads + 1);
   cuda::CheckLaunchParam(init_block_dim, init_thread_dim, "MultiBoxTarget Init");
-  cuda::InitGroundTruthFlags<DType><<<init_block_dim, init_thread_dim>>>(
+  cuda::InitGroundTruthFlags<DType><<<init_block_dim, init_thread_dim, 0, stream>>>(
     gt_flags, labels.dptr_, num_batches, num_labels, label_width);
   MULTIBOX_TARGET_CUDA_CHECK(cudaPeekAtLastError());
 
   // compute best matches
-  temp_space[2] = -1.f;
-  temp_space[3] = -1.f;
-  DType *anchor_flags = temp_space[2].dptr_;
-  DType *best_matches = temp_space[3].dptr_;
-  const DType *overlaps = temp_space[0].dptr_;
+  Tensor<gpu, 1, DType> matches(anchor_flags, Shape1(2 * num_all_anchors), temp_space.stream_);
+  matches = -1.f;
   cuda::CheckLaunchParam(num_batches, num_threads, "MultiBoxTarget Matching");
-  cuda::FindBestMatches<DType><<<num_batches, num_threads>>>(best_matches,
-    gt_flags, anchor_flags, overlaps, num_anchors, num_labels);
+  cuda::FindBestMatches<DType><<<num_batches, num_threads, 0, stream>>>(best_matches,
+    gt_flags, anchor_flags, free_matches, overlaps, num_anchors, num_labels);
   MULTIBOX_TARGET_CUDA_CHECK(cudaPeekAtLastError());
 
   // find good matches with overlap > threshold
+  const int num_blocks = (num_all_anchors - 1) / num_threads + 1;
+  cuda::CheckLaunchParam(num_blocks, num_threads, "MultiBoxTarget Targets");
   if (overlap_threshold > 0) {
-    cuda::FindGoodMatches<DType><<<num_batches, num_threads>>>(best_matches,
-      anchor_flags, overlaps, num_anchors, num_labels,
+    cuda::FindGoodMatches<DType><<<num_blocks, num_threads, 0, stream>>>(best_matches,
+      anchor_flags, overlaps, num_all_anchors, num_labels,
       overlap_threshold);
     MULTIBOX_TARGET_CUDA_CHECK(cudaPeekAtLastError());
   }
@@ -392,24 +435,21 @@ inline void MultiBoxTargetForward(const Tensor<gpu, 2, DType> &loc_target,
   // do negative mining or not
   if (negative_mining_ratio > 0) {
     CHECK_GT(negative_mining_thresh, 0);
-    temp_space[4] = 0;
-    DType *buffer = temp_space[4].dptr_;
-    cuda::NegativeMining<DType><<<num_batches, num_threads>>>(overlaps,
+    Tensor<gpu, 1, DType>(buffer, Shape1(3 * num_all_anchors), temp_space.stream_) = 0;
+    cuda::NegativeMining<DType><<<num_batches, num_threads, 0, stream>>>(overlaps,
       cls_preds.dptr_, anchor_flags, buffer, negative_mining_ratio,
       negative_mining_thresh, minimum_negative_samples,
       num_anchors, num_labels, num_classes);
     MULTIBOX_TARGET_CUDA_CHECK(cudaPeekAtLastError());
   } else {
-    int num_blocks = (num_batches * num_anchors - 1) / num_threads + 1;
-    cuda::CheckLaunchParam(num_blocks, num_threads, "MultiBoxTarget Negative");
-    cuda::UseAllNegatives<DType><<<num_blocks, num_threads>>>(anchor_flags,
-      num_batches * num_anchors);
+    cuda::UseAllNegatives<DType><<<num_blocks, num_threads, 0, stream>>>(anchor_flags,
+      num_all_anchors);
     MULTIBOX_TARGET_CUDA_CHECK(cudaPeekAtLastError());
   }
 
-  cuda::AssignTrainigTargets<DType><<<num_batches, num_threads>>>(
+  cuda::AssignTrainigTargets<DType><<<num_blocks, num_threads, 0, stream>>>(
     loc_target.dptr_, loc_mask.dptr_, cls_target.dptr_, anchor_flags,
-    best_matches, labels.dptr_, anchors.dptr_, num_anchors, num_labels,
+    best_matches, labels.dptr_, anchors.dptr_, num_batches, num_anchors, num_labels,
     label_width, variances[0], variances[1], variances[2], variances[3]);
   MULTIBOX_TARGET_CUDA_CHECK(cudaPeekAtLastError());
 }
@@ -0,0 +1,427 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file multihead_attention-inl.h
+ * \brief fused multi-head scaled dot product attention
+ *
+ * The scores of a block of query rows are computed by a batched gemm into a
+ * buffer of a fixed size, scaled, masked, normalized and dropped out in
+ * place, and multiplied by the values, so that the batch x heads x T x T
+ * scores are never stored. Training keeps the log-sum-exp of each row, from
+ * which the backward recomputes the probabilities block by block, and the
+ * seed of a counter based dropout, which it replays.
+ */
+#ifndef MXNET_OPERATOR_CONTRIB_MULTIHEAD_ATTENTION_INL_H_
+#define MXNET_OPERATOR_CONTRIB_MULTIHEAD_ATTENTION_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator_util.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "../mshadow_op.h"
+#include "../mxnet_op.h"
+#include "../operator_common.h"
+#include "../elemwise_op_common.h"
+#include "../linalg.h"
+
+namespace mxnet {
+namespace op {
+
+namespace attention {
+enum AttentionOpInputs {kQuery, kKey, kValue, kSequenceLength};
+enum AttentionOpOutputs {kOut, kLogSumExp, kSeed};
+enum AttentionOpResource {kTempSpace, kRandom};
+}  // namespace attention
+
+struct MultiHeadAttentionParam : public dmlc::Parameter<MultiHeadAttentionParam> {
+  int num_heads;
+  float scale;
+  float dropout;
+  bool causal;
+  bool use_sequence_length;
+  DMLC_DECLARE_PARAMETER(MultiHeadAttentionParam) {
+    DMLC_DECLARE_FIELD(num_heads).set_lower_bound(1)
+    .describe("Number of heads, the last axis of each input is split between them.");
+    DMLC_DECLARE_FIELD(scale).set_default(0.0f)
+    .describe("Scale of the scores, 0 for 1 / sqrt(the size of a head of the queries).");
+    DMLC_DECLARE_FIELD(dropout).set_default(0.0f).set_range(0.0f, 1.0f)
+    .describe("Fraction of the attention weights dropped in training.");
+    DMLC_DECLARE_FIELD(causal).set_default(false)
+    .describe("Whether query i only attends to the keys up to i + num_keys - num_queries.");
+    DMLC_DECLARE_FIELD(use_sequence_length).set_default(false)
+    .describe("Whether the fourth input gives the number of valid keys of each sequence.");
+  }
+};
+
+/*! \brief the number of score elements a block of query rows may take */
+template<typename xpu>
+struct AttentionScoreBlock {
+  static const size_t kSize = 1 << 18;
+};
+template<>
+struct AttentionScoreBlock<gpu> {
+  static const size_t kSize = 1 << 22;
+};
+
+/*!
+ * \brief the blocks the scores are computed by: rows query rows of nb
+ *  sequences, all the rows of a sequence when there are several
+ */
+struct AttentionBlocking {
+  int nb, rows;
+  AttentionBlocking(const int batch, const int num_queries, const int num_keys,
+                    const size_t cap) {
+    const size_t fit = std::max<size_t>(cap / std::max(num_keys, 1), 1);
+    if (fit >= static_cast<size_t>(num_queries)) {
+      rows = num_queries;
+      nb = static_cast<int>(std::min<size_t>(batch, fit / std::max(num_queries, 1)));
+    } else {
+      rows = static_cast<int>(fit);
+      nb = 1;
+    }
+  }
+};
+
+/*! \brief the type the rows are reduced in, float for fp16 data */
+template<typename DType>
+struct AttentionAccType {
+  typedef DType type;
+};
+template<>
+struct AttentionAccType<mshadow::half::half_t> {
+  typedef float type;
+};
+
+/*! \brief uniform in [0, 1) of a 24 bit seed and an index, the fmix64 of murmur3 */
+MSHADOW_XINLINE float AttentionUniform(const unsigned seed, const uint64_t idx) {
+  uint64_t z = idx * 0x9E3779B97F4A7C15ULL + seed;
+  z ^= z >> 33;
+  z *= 0xFF51AFD7ED558CCDULL;
+  z ^= z >> 33;
+  z *= 0xC4CEB9FE1A85EC53ULL;
+  z ^= z >> 33;
+  return static_cast<float>(z >> 40) * (1.0f / 16777216.0f);
+}
+
+/*! \brief the rows of a block of scores, rows query rows of head h of each sequence */
+struct AttentionRows {
+  int b0, rows, i0, h;
+  int num_heads, num_queries, num_keys;
+  bool causal;
+  /*! \brief probability of dropping a weight, 0 without dropout */
+  float drop;
+
+  MSHADOW_XINLINE int batch(const int r) const { return b0 + r / rows; }
+  MSHADOW_XINLINE int query(const int r) const { return i0 + r % rows; }
+  /*! \brief index of row r in the (batch, heads, queries) log-sum-exp */
+  MSHADOW_XINLINE size_t row_index(const int r) const {
+    return (static_cast<size_t>(batch(r)) * num_heads + h) * num_queries + query(r);
+  }
+  /*! \brief the number of keys row r attends to */
+  template<typename DType>
+  MSHADOW_XINLINE int length(const int r, const DType* seq_len) const {
+    int len = num_keys;
+    if (seq_len != NULL) {
+      const int l = static_cast<int>(seq_len[batch(r)]);
+      len = l < len ? l : len;
+    }
+    if (causal) {
+      const int l = query(r) + num_keys - num_queries + 1;
+      len = l < len ? l : len;
+    }
+    return len > 0 ? len : 0;
+  }
+  /*! \brief the dropout factor of weight j of row r, 0 or 1 / (1 - drop) */
+  MSHADOW_XINLINE float keep(const int r, const int j, const unsigned seed) const {
+    if (drop == 0.0f) return 1.0f;
+    const uint64_t idx = static_cast<uint64_t>(row_index(r)) * num_keys + j;
+    return AttentionUniform(seed, idx) < drop ? 0.0f : 1.0f / (1.0f - drop);
+  }
+};
+
+/*!
+ * \brief the scaled scores of each row become its masked softmax, dropped
+ *  out, and lse its log-sum-exp, +inf for a row of no keys
+ */
+template<typename DType>
+void AttentionForwardRows(mshadow::Stream<cpu>* s, const AttentionRows& blk, const int nrow,
+                          const DType* seq_len, const float* seed, DType* score, float* lse);
+template<typename DType>
+void AttentionForwardRows(mshadow::Stream<gpu>* s, const AttentionRows& blk, const int nrow,
+                          const DType* seq_len, const float* seed, DType* score, float* lse);
+
+/*!
+ * \brief score holds the recomputed scaled scores and dscore the gradient of
+ *  the dropped out weights; they become the dropped out weights and the
+ *  gradient of the scores. out and grad_out are the rows of the head of the
+ *  output and of its gradient, of stride ostride and size dv.
+ */
+template<typename DType>
+void AttentionBackwardRows(mshadow::Stream<cpu>* s, const AttentionRows& blk, const int nrow,
+                           const DType* seq_len, const float* seed, const float* lse,
+                           const DType* out, const DType* grad_out, const int ostride,
+                           const int dv, DType* score, DType* dscore);
+template<typename DType>
+void AttentionBackwardRows(mshadow::Stream<gpu>* s, const AttentionRows& blk, const int nrow,
+                           const DType* seq_len, const float* seed, const float* lse,
+                           const DType* out, const DType* grad_out, const int ostride,
+                           const int dv, DType* score, DType* dscore);
+
+inline bool MultiHeadAttentionShape(const nnvm::NodeAttrs& attrs,
+                                    std::vector<TShape>* in_attrs,
+                                    std::vector<TShape>* out_attrs) {
+  const MultiHeadAttentionParam& param = nnvm::get<MultiHeadAttentionParam>(attrs.parsed);
+  CHECK_EQ(in_attrs->size(), param.use_sequence_length ? 4U : 3U);
+  CHECK_EQ(out_attrs->size(), 3U);
+  const TShape& qshape = in_attrs->at(attention::kQuery);
+  const TShape& kshape = in_attrs->at(attention::kKey);
+  const TShape& vshape = in_attrs->at(attention::kValue);
+  if (qshape.ndim() == 0 || kshape.ndim() == 0 || vshape.ndim() == 0) return false;
+  CHECK_EQ(qshape.ndim(), 3U) << "query should be of shape (batch, num_queries, dim)";
+  CHECK_EQ(kshape.ndim(), 3U) << "key should be of shape (batch, num_keys, dim)";
+  CHECK_EQ(vshape.ndim(), 3U) << "value should be of shape (batch, num_keys, value_dim)";
+  CHECK_EQ(qshape[0], kshape[0]) << "query and key should have the same batch size";
+  CHECK_EQ(qshape[2], kshape[2]) << "query and key should have the same dim";
+  CHECK_EQ(kshape[0], vshape[0]) << "key and value should have the same batch size";
+  CHECK_EQ(kshape[1], vshape[1]) << "key and value should have the same number of keys";
+  CHECK_EQ(qshape[2] % param.num_heads, 0U) << "dim should be a multiple of num_heads";
+  CHECK_EQ(vshape[2] % param.num_heads, 0U) << "value_dim should be a multiple of num_heads";
+  if (param.use_sequence_length) {
+    SHAPE_ASSIGN_CHECK(*in_attrs, attention::kSequenceLength, mshadow::Shape1(qshape[0]));
+  }
+  SHAPE_ASSIGN_CHECK(*out_attrs, attention::kOut,
+                     mshadow::Shape3(qshape[0], qshape[1], vshape[2]));
+  SHAPE_ASSIGN_CHECK(*out_attrs, attention::kLogSumExp,
+                     mshadow::Shape3(qshape[0], param.num_heads, qshape[1]));
+  SHAPE_ASSIGN_CHECK(*out_attrs, attention::kSeed, mshadow::Shape1(1));
+  return true;
+}
+
+inline bool MultiHeadAttentionType(const nnvm::NodeAttrs& attrs,
+                                   std::vector<int>* in_attrs,
+                                   std::vector<int>* out_attrs) {
+  const size_t nin = in_attrs->size();
+  std::vector<int> out_type = {out_attrs->at(attention::kOut)};
+  if (!ElemwiseType<-1, 1>(attrs, in_attrs, &out_type)) return false;
+  CHECK_EQ(nin, in_attrs->size());
+  TYPE_ASSIGN_CHECK(*out_attrs, attention::kOut, out_type[0]);
+  // the statistics of the rows are kept in float32 for any type of the data
+  TYPE_ASSIGN_CHECK(*out_attrs, attention::kLogSumExp, mshadow::kFloat32);
+  TYPE_ASSIGN_CHECK(*out_attrs, attention::kSeed, mshadow::kFloat32);
+  return true;
+}
+
+/*! \brief out[i] = value */
+struct attention_set_seed {
+  MSHADOW_XINLINE static void Map(int i, float* out, const float value) {
+    out[i] = value;
+  }
+};
+
+/*! \brief views the head h of rows [i0, i0 + rows) of sequences [b0, b0 + nb) */
+template<typename xpu, typename DType>
+inline mshadow::Tensor<xpu, 3, DType> AttentionHead(DType* dptr, const int len, const int dim,
+                                                    const int num_heads, const int b0,
+                                                    const int nb, const int i0, const int rows,
+                                                    const int h, mshadow::Stream<xpu>* s) {
+  const size_t stride = static_cast<size_t>(dim) * num_heads;
+  return mshadow::Tensor<xpu, 3, DType>(dptr + (static_cast<size_t>(b0) * len + i0) * stride +
+                                        static_cast<size_t>(h) * dim,
+                                        mshadow::Shape3(nb, rows, dim), stride, s);
+}
+
+template<typename xpu, typename DType>
+void MultiHeadAttentionForwardImpl(const nnvm::NodeAttrs& attrs,
+                                   const OpContext& ctx,
+                                   const std::vector<TBlob>& inputs,
+                                   const std::vector<OpReqType>& req,
+                                   const std::vector<TBlob>& outputs) {
+  using namespace mshadow;
+  using namespace mxnet_op;
+  const MultiHeadAttentionParam& param = nnvm::get<MultiHeadAttentionParam>(attrs.parsed);
+  CHECK_NE(req[attention::kOut], kWriteInplace) << "MultiHeadAttention does not run in place";
+  if (req[attention::kOut] == kNullOp) return;
+  Stream<xpu>* s = ctx.get_stream<xpu>();
+  const TShape& qshape = inputs[attention::kQuery].shape_;
+  const int batch = qshape[0], num_queries = qshape[1];
+  const int num_keys = inputs[attention::kKey].shape_[1];
+  const int H = param.num_heads;
+  const int dk = qshape[2] / H, dv = inputs[attention::kValue].shape_[2] / H;
+  const float scale = param.scale != 0.0f ? param.scale : 1.0f / std::sqrt(static_cast<float>(dk));
+  DType* query = inputs[attention::kQuery].dptr<DType>();
+  DType* key = inputs[attention::kKey].dptr<DType>();
+  DType* value = inputs[attention::kValue].dptr<DType>();
+  const DType* seq_len = param.use_sequence_length ?
+      inputs[attention::kSequenceLength].dptr<DType>() : NULL;
+  DType* out = outputs[attention::kOut].dptr<DType>();
+  float* lse = outputs[attention::kLogSumExp].dptr<float>();
+  float* seed = outputs[attention::kSeed].dptr<float>();
+  const bool dropout = ctx.is_train && param.dropout > 0.0f;
+  float seed_value = 0.0f;
+  if (dropout) {
+    Random<xpu, float>* prnd = ctx.requested[attention::kRandom].get_random<xpu, float>(s);
+    seed_value = static_cast<float>(prnd->GetRandInt() & 0xFFFFFF);
+  }
+  Kernel<attention_set_seed, xpu>::Launch(s, 1, seed, seed_value);
+  if (num_queries == 0 || batch == 0) return;
+  const AttentionBlocking blocking(batch, num_queries, num_keys,
+                                   AttentionScoreBlock<xpu>::kSize);
+  Tensor<xpu, 1, DType> buf = ctx.requested[attention::kTempSpace].get_space_typed<xpu, 1, DType>(
+      Shape1(static_cast<size_t>(blocking.nb) * blocking.rows * num_keys), s);
+  const DType beta = req[attention::kOut] == kAddTo ? DType(1) : DType(0);
+  for (int h = 0; h < H; ++h) {
+    for (int b0 = 0; b0 < batch; b0 += blocking.nb) {
+      const int nb = std::min(blocking.nb, batch - b0);
+      for (int i0 = 0; i0 < num_queries; i0 += blocking.rows) {
+        const int rows = std::min(blocking.rows, num_queries - i0);
+        Tensor<xpu, 3, DType> q = AttentionHead(query, num_queries, dk, H, b0, nb, i0, rows, h, s);
+        Tensor<xpu, 3, DType> k = AttentionHead(key, num_keys, dk, H, b0, nb, 0, num_keys, h, s);
+        Tensor<xpu, 3, DType> v = AttentionHead(value, num_keys, dv, H, b0, nb, 0, num_keys, h, s);
+        Tensor<xpu, 3, DType> o = AttentionHead(out, num_queries, dv, H, b0, nb, i0, rows, h, s);
+        Tensor<xpu, 3, DType> score(buf.dptr_, Shape3(nb, rows, num_keys), s);
+        linalg_batch_gemm(q, k, score, DType(scale), DType(0), false, true, s);
+        const AttentionRows blk = {b0, rows, i0, h, H, num_queries, num_keys, param.causal,
+                                   dropout ? param.dropout : 0.0f};
+        AttentionForwardRows(s, blk, nb * rows, seq_len, seed, score.dptr_, lse);
+        linalg_batch_gemm(score, v, o, DType(1), beta, false, false, s);
+      }
+    }
+  }
+}
+
+/*!
+ * \brief the inputs are the gradient of the output, the inputs of the
+ *  forward, and its output, log-sum-exp and seed
+ */
+template<typename xpu, typename DType>
+void MultiHeadAttentionBackwardImpl(const nnvm::NodeAttrs& attrs,
+                                    const OpContext& ctx,
+                                    const std::vector<TBlob>& inputs,
+                                    const std::vector<OpReqType>& req,
+                                    const std::vector<TBlob>& outputs) {
+  using namespace mshadow;
+  using namespace mxnet_op;
+  const MultiHeadAttentionParam& param = nnvm::get<MultiHeadAttentionParam>(attrs.parsed);
+  const size_t nin = param.use_sequence_length ? 4 : 3;
+  CHECK_EQ(inputs.size(), nin + 4);
+  CHECK_EQ(outputs.size(), nin);
+  Stream<xpu>* s = ctx.get_stream<xpu>();
+  const TBlob& grad_out = inputs[0];
+  const TShape& qshape = inputs[1 + attention::kQuery].shape_;
+  const int batch = qshape[0], num_queries = qshape[1];
+  const int num_keys = inputs[1 + attention::kKey].shape_[1];
+  const int H = param.num_heads;
+  const int dk = qshape[2] / H, dv = inputs[1 + attention::kValue].shape_[2] / H;
+  const float scale = param.scale != 0.0f ? param.scale : 1.0f / std::sqrt(static_cast<float>(dk));
+  DType* query = inputs[1 + attention::kQuery].dptr<DType>();
+  DType* key = inputs[1 + attention::kKey].dptr<DType>();
+  DType* value = inputs[1 + attention::kValue].dptr<DType>();
+  const DType* seq_len = param.use_sequence_length ?
+      inputs[1 + attention::kSequenceLength].dptr<DType>() : NULL;
+  const DType* out = inputs[1 + nin + attention::kOut].dptr<DType>();
+  const float* lse = inputs[1 + nin + attention::kLogSumExp].dptr<float>();
+  const float* seed = inputs[1 + nin + attention::kSeed].dptr<float>();
+  for (size_t i = 0; i < nin; ++i) {
+    CHECK_NE(req[i], kWriteInplace) << "MultiHeadAttention does not run in place";
+    // the gradients are accumulated block by block
+    if (req[i] == kWriteTo) {
+      Kernel<set_zero, xpu>::Launch(s, outputs[i].Size(), outputs[i].dptr<DType>());
+    }
+  }
+  const bool need_q = req[attention::kQuery] != kNullOp;
+  const bool need_k = req[attention::kKey] != kNullOp;
+  const bool need_v = req[attention::kValue] != kNullOp;
+  if ((!need_q && !need_k && !need_v) || num_queries == 0 || batch == 0) return;
+  const AttentionBlocking blocking(batch, num_queries, num_keys,
+                                   AttentionScoreBlock<xpu>::kSize);
+  const size_t block_size = static_cast<size_t>(blocking.nb) * blocking.rows * num_keys;
+  Tensor<xpu, 1, DType> buf = ctx.requested[attention::kTempSpace].get_space_typed<xpu, 1, DType>(
+      Shape1(2 * block_size), s);
+  DType* dquery = outputs[attention::kQuery].dptr<DType>();
+  DType* dkey = outputs[attention::kKey].dptr<DType>();
+  DType* dvalue = outputs[attention::kValue].dptr<DType>();
+  for (int h = 0; h < H; ++h) {
+    for (int b0 = 0; b0 < batch; b0 += blocking.nb) {
+      const int nb = std::min(blocking.nb, batch - b0);
+      for (int i0 = 0; i0 < num_queries; i0 += blocking.rows) {
+        const int rows = std::min(blocking.rows, num_queries - i0);
+        Tensor<xpu, 3, DType> q = AttentionHead(query, num_queries, dk, H, b0, nb, i0, rows, h, s);
+        Tensor<xpu, 3, DType> k = AttentionHead(key, num_keys, dk, H, b0, nb, 0, num_keys, h, s);
+        Tensor<xpu, 3, DType> v = AttentionHead(value, num_keys, dv, H, b0, nb, 0, num_keys, h, s);
+        Tensor<xpu, 3, DType> dout = AttentionHead(grad_out.dptr<DType>(), num_queries, dv, H,
+                                                   b0, nb, i0, rows, h, s);
+        Tensor<xpu, 3, DType> score(buf.dptr_, Shape3(nb, rows, num_keys), s);
+        Tensor<xpu, 3, DType> dscore(buf.dptr_ + block_size, Shape3(nb, rows, num_keys), s);
+        linalg_batch_gemm(q, k, score, DType(scale), DType(0), false, true, s);
+        linalg_batch_gemm(dout, v, dscore, DType(1), DType(0), false, true, s);
+        const AttentionRows blk = {b0, rows, i0, h, H, num_queries, num_keys, param.causal,
+                                   param.dropout};
+        const size_t orow = (static_cast<size_t>(b0) * num_queries + i0) * dv * H +
+                            static_cast<size_t>(h) * dv;
+        AttentionBackwardRows(s, blk, nb * rows, seq_len, seed, lse, out + orow, dout.dptr_,
+                              dv * H, dv, score.dptr_, dscore.dptr_);
+        if (need_v) {
+          Tensor<xpu, 3, DType> dvh = AttentionHead(dvalue, num_keys, dv, H, b0, nb, 0,
+                                                    num_keys, h, s);
+          linalg_batch_gemm(score, dout, dvh, DType(1), DType(1), true, false, s);
+        }
+        if (need_q) {
+          Tensor<xpu, 3, DType> dqh = AttentionHead(dquery, num_queries, dk, H, b0, nb, i0,
+                                                    rows, h, s);
+          linalg_batch_gemm(dscore, k, dqh, DType(scale), DType(1), false, false, s);
+        }
+        if (need_k) {
+          Tensor<xpu, 3, DType> dkh = AttentionHead(dkey, num_keys, dk, H, b0, nb, 0,
+                                                    num_keys, h, s);
+          linalg_batch_gemm(dscore, q, dkh, DType(scale), DType(1), true, false, s);
+        }
+      }
+    }
+  }
+}
+
+template<typename xpu>
+void MultiHeadAttentionForward(const nnvm::NodeAttrs& attrs,
+                               const OpContext& ctx,
+                               const std::vector<TBlob>& inputs,
+                               const std::vector<OpReqType>& req,
+                               const std::vector<TBlob>& outputs) {
+  MSHADOW_REAL_TYPE_SWITCH(outputs[attention::kOut].type_flag_, DType, {
+    MultiHeadAttentionForwardImpl<xpu, DType>(attrs, ctx, inputs, req, outputs);
+  });
+}
+
+template<typename xpu>
+void MultiHeadAttentionBackward(const nnvm::NodeAttrs& attrs,
+                                const OpContext& ctx,
+                                const std::vector<TBlob>& inputs,
+                                const std::vector<OpReqType>& req,
+                                const std::vector<TBlob>& outputs) {
+  MSHADOW_REAL_TYPE_SWITCH(inputs[0].type_flag_, DType, {
+    MultiHeadAttentionBackwardImpl<xpu, DType>(attrs, ctx, inputs, req, outputs);
+  });
+}
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CONTRIB_MULTIHEAD_ATTENTION_INL_H_
@@ -0,0 +1,192 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file multihead_attention.cc
+ * \brief fused multi-head attention, cpu implementation and registration
+ */
+#include "./multihead_attention-inl.h"
+
+namespace mxnet {
+namespace op {
+
+/*! \brief keys the OpenMP grain of the rows of the cpu attention */
+struct AttentionCPUGrain {};
+
+inline int AttentionNumThreads(const int nrow, const int num_keys) {
+  const int nthread = mxnet_op::KernelNumThreads(
+      static_cast<int>(std::min<size_t>(static_cast<size_t>(nrow) * num_keys, INT_MAX)),
+      mxnet_op::KernelGrain<AttentionCPUGrain>::Get());
+  return std::min(nthread, nrow);
+}
+
+template<typename DType>
+void AttentionForwardRows(mshadow::Stream<cpu>* s, const AttentionRows& blk, const int nrow,
+                          const DType* seq_len, const float* seed, DType* score, float* lse) {
+  typedef typename AttentionAccType<DType>::type AType;
+  const int num_keys = blk.num_keys;
+  const unsigned seed_value = static_cast<unsigned>(*seed);
+  const int nthread = AttentionNumThreads(nrow, num_keys);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int r = 0; r < nrow; ++r) {
+    DType* row = score + static_cast<size_t>(r) * num_keys;
+    const int len = blk.length(r, seq_len);
+    if (len == 0) {
+      std::fill(row, row + num_keys, DType(0));
+      lse[blk.row_index(r)] = INFINITY;
+      continue;
+    }
+    AType m = static_cast<AType>(row[0]);
+    for (int j = 1; j < len; ++j) m = std::max(m, static_cast<AType>(row[j]));
+    AType sum = 0;
+    for (int j = 0; j < len; ++j) {
+      const AType e = std::exp(static_cast<AType>(row[j]) - m);
+      row[j] = static_cast<DType>(e);
+      sum += e;
+    }
+    lse[blk.row_index(r)] = static_cast<float>(m + std::log(sum));
+    const AType inv = AType(1) / sum;
+    for (int j = 0; j < len; ++j) {
+      row[j] = static_cast<DType>(static_cast<AType>(row[j]) * inv *
+                                  static_cast<AType>(blk.keep(r, j, seed_value)));
+    }
+    std::fill(row + len, row + num_keys, DType(0));
+  }
+}
+
+template<typename DType>
+void AttentionBackwardRows(mshadow::Stream<cpu>* s, const AttentionRows& blk, const int nrow,
+                           const DType* seq_len, const float* seed, const float* lse,
+                           const DType* out, const DType* grad_out, const int ostride,
+                           const int dv, DType* score, DType* dscore) {
+  typedef typename AttentionAccType<DType>::type AType;
+  const int num_keys = blk.num_keys;
+  const unsigned seed_value = static_cast<unsigned>(*seed);
+  const int nthread = AttentionNumThreads(nrow, num_keys);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int r = 0; r < nrow; ++r) {
+    DType* row = score + static_cast<size_t>(r) * num_keys;
+    DType* drow = dscore + static_cast<size_t>(r) * num_keys;
+    const int len = blk.length(r, seq_len);
+    // the rows of the head of the output and of its gradient
+    const size_t orow = (static_cast<size_t>(r / blk.rows) * blk.num_queries + r % blk.rows) *
+                        ostride;
+    AType d = 0;
+    for (int c = 0; c < dv; ++c) {
+      d += static_cast<AType>(out[orow + c]) * static_cast<AType>(grad_out[orow + c]);
+    }
+    const AType m = static_cast<AType>(lse[blk.row_index(r)]);
+    for (int j = 0; j < len; ++j) {
+      const AType p = std::exp(static_cast<AType>(row[j]) - m);
+      const AType k = blk.keep(r, j, seed_value);
+      row[j] = static_cast<DType>(p * k);
+      drow[j] = static_cast<DType>(p * (static_cast<AType>(drow[j]) * k - d));
+    }
+    std::fill(row + len, row + num_keys, DType(0));
+    std::fill(drow + len, drow + num_keys, DType(0));
+  }
+}
+
+DMLC_REGISTER_PARAMETER(MultiHeadAttentionParam);
+
+NNVM_REGISTER_OP(_contrib_MultiHeadAttention)
+.describe(R"code(Computes the multi-head scaled dot product attention of the queries over
+the keys and the values.
+
+The last axis of each input is split in *num_heads* heads. For head h, the
+weights of query i are the softmax over the keys j of scale * dot(query[i],
+key[j]), with the keys masked out by *sequence_length* and *causal* left out,
+and the output is their average of the values. In training the weights are
+dropped out with probability *dropout*.
+
+The scores are computed a block of queries at a time and never stored, the
+extra memory is a few values per query and head, the log-sum-exp of its
+weights, from which the backward recomputes them. This is the fusion of::
+
+  score = batch_dot(query, key, transpose_b=True) * scale
+  weight = Dropout(softmax(SequenceMask(score, sequence_length)), p=dropout)
+  out = batch_dot(weight, value)
+
+for each head, with inputs of shape (batch, num_queries, num_heads * dim),
+(batch, num_keys, num_heads * dim) and (batch, num_keys, num_heads * value_dim),
+and an output of shape (batch, num_queries, num_heads * value_dim). A query
+of no valid key has an output of 0.
+)code" ADD_FILELINE)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    const MultiHeadAttentionParam& param = nnvm::get<MultiHeadAttentionParam>(attrs.parsed);
+    return param.use_sequence_length ? 4U : 3U;
+  })
+.set_num_outputs(3)
+.set_attr_parser(ParamParser<MultiHeadAttentionParam>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    const MultiHeadAttentionParam& param = nnvm::get<MultiHeadAttentionParam>(attrs.parsed);
+    if (param.use_sequence_length) {
+      return std::vector<std::string>{"query", "key", "value", "sequence_length"};
+    }
+    return std::vector<std::string>{"query", "key", "value"};
+  })
+.set_attr<nnvm::FListOutputNames>("FListOutputNames",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::string>{"output", "logsumexp", "seed"};
+  })
+.set_attr<nnvm::FNumVisibleOutputs>("FNumVisibleOutputs",
+  [](const NodeAttrs& attrs) { return 1U; })
+.set_attr<nnvm::FInferShape>("FInferShape", MultiHeadAttentionShape)
+.set_attr<nnvm::FInferType>("FInferType", MultiHeadAttentionType)
+.set_attr<FResourceRequest>("FResourceRequest",
+  [](const nnvm::NodeAttrs& attrs) {
+    return std::vector<ResourceRequest>{ResourceRequest::kTempSpace, ResourceRequest::kRandom};
+  })
+.set_attr<FCompute>("FCompute<cpu>", MultiHeadAttentionForward<cpu>)
+.set_attr<nnvm::FGradient>("FGradient",
+  [](const nnvm::NodePtr& n, const std::vector<nnvm::NodeEntry>& ograds) {
+    std::vector<nnvm::NodeEntry> heads{ograds[attention::kOut]};
+    for (const auto& e : n->inputs) heads.push_back(e);
+    for (uint32_t i : {attention::kOut, attention::kLogSumExp, attention::kSeed}) {
+      heads.emplace_back(nnvm::NodeEntry{n, i, 0});
+    }
+    return MakeGradNode("_backward_contrib_MultiHeadAttention", n, heads, n->attrs.dict);
+  })
+.add_argument("query", "NDArray-or-Symbol", "The queries, (batch, num_queries, dim).")
+.add_argument("key", "NDArray-or-Symbol", "The keys, (batch, num_keys, dim).")
+.add_argument("value", "NDArray-or-Symbol", "The values, (batch, num_keys, value_dim).")
+.add_argument("sequence_length", "NDArray-or-Symbol",
+              "The number of valid keys of each sequence, (batch,).")
+.add_arguments(MultiHeadAttentionParam::__FIELDS__());
+
+NNVM_REGISTER_OP(_backward_contrib_MultiHeadAttention)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    const MultiHeadAttentionParam& param = nnvm::get<MultiHeadAttentionParam>(attrs.parsed);
+    return param.use_sequence_length ? 8U : 7U;
+  })
+.set_num_outputs([](const nnvm::NodeAttrs& attrs) {
+    const MultiHeadAttentionParam& param = nnvm::get<MultiHeadAttentionParam>(attrs.parsed);
+    return param.use_sequence_length ? 4U : 3U;
+  })
+.set_attr_parser(ParamParser<MultiHeadAttentionParam>)
+.set_attr<nnvm::TIsBackward>("TIsBackward", true)
+.set_attr<FResourceRequest>("FResourceRequest",
+  [](const nnvm::NodeAttrs& attrs) {
+    return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
+  })
+.set_attr<FCompute>("FCompute<cpu>", MultiHeadAttentionBackward<cpu>);
+
+}  // namespace op
+}  // namespace mxnet
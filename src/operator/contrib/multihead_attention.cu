@@ -0,0 +1,149 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file multihead_attention.cu
+ * \brief fused multi-head attention, gpu implementation
+ */
+#include "./multihead_attention-inl.h"
+
+namespace mxnet {
+namespace op {
+
+const int kAttentionThreads = 128;
+
+/*! \brief the sum, or the max, of v over the threads of the block */
+template<bool kMax, typename AType>
+__device__ AType AttentionBlockReduce(AType v, AType* smem) {
+  smem[threadIdx.x] = v;
+  __syncthreads();
+  for (int n = kAttentionThreads / 2; n > 0; n >>= 1) {
+    if (threadIdx.x < n) {
+      const AType o = smem[threadIdx.x + n];
+      smem[threadIdx.x] = kMax ? (o > smem[threadIdx.x] ? o : smem[threadIdx.x])
+                               : smem[threadIdx.x] + o;
+    }
+    __syncthreads();
+  }
+  const AType ret = smem[0];
+  __syncthreads();
+  return ret;
+}
+
+/*! \brief one block for each row of scores */
+template<typename DType>
+__global__ void AttentionForwardRowsKernel(const AttentionRows blk, const DType* seq_len,
+                                           const float* seed, DType* score, float* lse) {
+  typedef typename AttentionAccType<DType>::type AType;
+  __shared__ AType smem[kAttentionThreads];
+  const int r = blockIdx.x;
+  const int num_keys = blk.num_keys;
+  DType* row = score + static_cast<size_t>(r) * num_keys;
+  const int len = blk.length(r, seq_len);
+  if (len == 0) {
+    for (int j = threadIdx.x; j < num_keys; j += kAttentionThreads) row[j] = DType(0);
+    if (threadIdx.x == 0) lse[blk.row_index(r)] = INFINITY;
+    return;
+  }
+  AType m = static_cast<AType>(row[0]);
+  for (int j = threadIdx.x; j < len; j += kAttentionThreads) {
+    const AType v = static_cast<AType>(row[j]);
+    m = v > m ? v : m;
+  }
+  m = AttentionBlockReduce<true>(m, smem);
+  AType sum = 0;
+  for (int j = threadIdx.x; j < len; j += kAttentionThreads) {
+    const AType e = exp(static_cast<AType>(row[j]) - m);
+    row[j] = static_cast<DType>(e);
+    sum += e;
+  }
+  sum = AttentionBlockReduce<false>(sum, smem);
+  if (threadIdx.x == 0) lse[blk.row_index(r)] = static_cast<float>(m + log(sum));
+  const AType inv = AType(1) / sum;
+  const unsigned seed_value = static_cast<unsigned>(*seed);
+  for (int j = threadIdx.x; j < num_keys; j += kAttentionThreads) {
+    row[j] = j < len ? static_cast<DType>(static_cast<AType>(row[j]) * inv *
+                                          static_cast<AType>(blk.keep(r, j, seed_value)))
+                     : DType(0);
+  }
+}
+
+template<typename DType>
+__global__ void AttentionBackwardRowsKernel(const AttentionRows blk, const DType* seq_len,
+                                            const float* seed, const float* lse,
+                                            const DType* out, const DType* grad_out,
+                                            const int ostride, const int dv,
+                                            DType* score, DType* dscore) {
+  typedef typename AttentionAccType<DType>::type AType;
+  __shared__ AType smem[kAttentionThreads];
+  const int r = blockIdx.x;
+  const int num_keys = blk.num_keys;
+  DType* row = score + static_cast<size_t>(r) * num_keys;
+  DType* drow = dscore + static_cast<size_t>(r) * num_keys;
+  const int len = blk.length(r, seq_len);
+  const size_t orow = (static_cast<size_t>(r / blk.rows) * blk.num_queries + r % blk.rows) *
+                      ostride;
+  AType d = 0;
+  for (int c = threadIdx.x; c < dv; c += kAttentionThreads) {
+    d += static_cast<AType>(out[orow + c]) * static_cast<AType>(grad_out[orow + c]);
+  }
+  d = AttentionBlockReduce<false>(d, smem);
+  const AType m = static_cast<AType>(lse[blk.row_index(r)]);
+  const unsigned seed_value = static_cast<unsigned>(*seed);
+  for (int j = threadIdx.x; j < num_keys; j += kAttentionThreads) {
+    if (j < len) {
+      const AType p = exp(static_cast<AType>(row[j]) - m);
+      const AType k = blk.keep(r, j, seed_value);
+      row[j] = static_cast<DType>(p * k);
+      drow[j] = static_cast<DType>(p * (static_cast<AType>(drow[j]) * k - d));
+    } else {
+      row[j] = DType(0);
+      drow[j] = DType(0);
+    }
+  }
+}
+
+template<typename DType>
+void AttentionForwardRows(mshadow::Stream<gpu>* s, const AttentionRows& blk, const int nrow,
+                          const DType* seq_len, const float* seed, DType* score, float* lse) {
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  AttentionForwardRowsKernel<DType><<<nrow, kAttentionThreads, 0, stream>>>(
+      blk, seq_len, seed, score, lse);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(AttentionForwardRowsKernel);
+}
+
+template<typename DType>
+void AttentionBackwardRows(mshadow::Stream<gpu>* s, const AttentionRows& blk, const int nrow,
+                           const DType* seq_len, const float* seed, const float* lse,
+                           const DType* out, const DType* grad_out, const int ostride,
+                           const int dv, DType* score, DType* dscore) {
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  AttentionBackwardRowsKernel<DType><<<nrow, kAttentionThreads, 0, stream>>>(
+      blk, seq_len, seed, lse, out, grad_out, ostride, dv, score, dscore);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(AttentionBackwardRowsKernel);
+}
+
+NNVM_REGISTER_OP(_contrib_MultiHeadAttention)
+.set_attr<FCompute>("FCompute<gpu>", MultiHeadAttentionForward<gpu>);
+
+NNVM_REGISTER_OP(_backward_contrib_MultiHeadAttention)
+.set_attr<FCompute>("FCompute<gpu>", MultiHeadAttentionBackward<gpu>);
+
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,260 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file nms.cuh
+ * \brief batched non-maximum suppression and per-image score sorting on the gpu,
+ *  shared by the detection operators
+ *
+ * The suppression follows the bitmask scheme of the Faster R-CNN implementations:
+ * one kernel computes, for every box, the 64-bit words of the later boxes it
+ * overlaps too much, and one block per image then walks the boxes in order,
+ * keeping a box unless an earlier kept box has its bit set. Nothing is copied to
+ * the host, and all the images of the batch are processed by the same launches.
+ */
+#ifndef MXNET_OPERATOR_CONTRIB_NMS_CUH_
+#define MXNET_OPERATOR_CONTRIB_NMS_CUH_
+
+#include <mshadow/tensor.h>
+#include <mshadow/cuda/tensor_gpu-inl.cuh>
+#include <algorithm>
+#include "../tensor/sort_op.h"
+
+namespace mxnet {
+namespace op {
+namespace nms {
+
+/*! \brief the boxes one mask word covers, and the threads of a mask block */
+const int kBoxesPerWord = 64;
+
+/*! \brief where the boxes of the batch are, in units of DType */
+struct BoxLayout {
+  /*! \brief distance between the first boxes of two images */
+  int image_stride;
+  /*! \brief distance between two boxes of an image */
+  int box_stride;
+  /*! \brief offset of (xmin, ymin, xmax, ymax) in a box */
+  int coord;
+  /*! \brief offset of the class id in a box, -1 to suppress across classes */
+  int cls;
+};
+
+/*! \brief IoU of boxes whose corners are pixel indices, suppressing above the threshold */
+struct PixelOverlap {
+  MSHADOW_XINLINE static bool Suppress(const float *a, const float *b, float threshold) {
+    float left = max(a[0], b[0]), right = min(a[2], b[2]);
+    float top = max(a[1], b[1]), bottom = min(a[3], b[3]);
+    float width = max(right - left + 1, 0.f), height = max(bottom - top + 1, 0.f);
+    float inter = width * height;
+    float sa = (a[2] - a[0] + 1) * (a[3] - a[1] + 1);
+    float sb = (b[2] - b[0] + 1) * (b[3] - b[1] + 1);
+    return inter / (sa + sb - inter) > threshold;
+  }
+};
+
+/*! \brief IoU of boxes with continuous corners, suppressing from the threshold on */
+struct ContinuousOverlap {
+  MSHADOW_XINLINE static bool Suppress(const float *a, const float *b, float threshold) {
+    float w = max(0.f, min(a[2], b[2]) - max(a[0], b[0]));
+    float h = max(0.f, min(a[3], b[3]) - max(a[1], b[1]));
+    float i = w * h;
+    float u = (a[2] - a[0]) * (a[3] - a[1]) + (b[2] - b[0]) * (b[3] - b[1]) - i;
+    return (u <= 0.f ? 0.f : i / u) >= threshold;
+  }
+};
+
+/*! \brief the words of a mask row */
+MSHADOW_XINLINE int MaskWords(int num_boxes) {
+  return (num_boxes + kBoxesPerWord - 1) / kBoxesPerWord;
+}
+
+/*! \brief bytes of the mask NonMaximumSuppression needs */
+inline size_t MaskSize(int num_images, int num_boxes) {
+  return static_cast<size_t>(num_images) * num_boxes * MaskWords(num_boxes) * sizeof(uint64_t);
+}
+
+/*!
+ * \brief block (x, y, z) sets, for the boxes y*64... of image z, the bits of the
+ *  boxes x*64... after them that they suppress
+ */
+template<typename Overlap, typename DType>
+__global__ void NMSMaskKernel(const DType *boxes, const BoxLayout layout,
+                              const int num_boxes, const int *count,
+                              const float threshold, uint64_t *mask) {
+  const int row_start = blockIdx.y, col_start = blockIdx.x, image = blockIdx.z;
+  // only later boxes are suppressed
+  if (col_start < row_start) return;
+  const int n = count ? min(count[image], num_boxes) : num_boxes;
+  const int row_size = min(n - row_start * kBoxesPerWord, kBoxesPerWord);
+  const int col_size = min(n - col_start * kBoxesPerWord, kBoxesPerWord);
+  if (row_size <= 0 || col_size <= 0) return;
+  boxes += image * layout.image_stride;
+
+  __shared__ float col_boxes[kBoxesPerWord * 4];
+  __shared__ float col_cls[kBoxesPerWord];
+  if (threadIdx.x < col_size) {
+    const DType *b = boxes + (col_start * kBoxesPerWord + threadIdx.x) * layout.box_stride;
+    for (int k = 0; k < 4; ++k) col_boxes[threadIdx.x * 4 + k] = b[layout.coord + k];
+    if (layout.cls >= 0) col_cls[threadIdx.x] = b[layout.cls];
+  }
+  __syncthreads();
+
+  if (threadIdx.x < row_size) {
+    const int cur = row_start * kBoxesPerWord + threadIdx.x;
+    const DType *b = boxes + cur * layout.box_stride;
+    float cur_box[4];
+    for (int k = 0; k < 4; ++k) cur_box[k] = b[layout.coord + k];
+    const float cur_cls = layout.cls >= 0 ? static_cast<float>(b[layout.cls]) : 0.f;
+    uint64_t t = 0;
+    for (int i = (row_start == col_start ? threadIdx.x + 1 : 0); i < col_size; ++i) {
+      if ((layout.cls < 0 || col_cls[i] == cur_cls) &&
+          Overlap::Suppress(cur_box, col_boxes + i * 4, threshold)) {
+        t |= 1ULL << i;
+      }
+    }
+    mask[(static_cast<size_t>(image) * num_boxes + cur) * MaskWords(num_boxes) + col_start] = t;
+  }
+}
+
+/*!
+ * \brief block z walks the boxes of image z in order, with the removed bits in
+ *  shared memory, and writes what NonMaximumSuppression returns
+ */
+template<int kThreads>
+__global__ void NMSReduceKernel(const uint64_t *mask, const int num_boxes, const int *count,
+                                const int max_keep, int *keep, int *num_keep,
+                                uint64_t *removed) {
+  extern __shared__ uint64_t remv[];
+  const int image = blockIdx.x, words = MaskWords(num_boxes);
+  const int n = count ? min(count[image], num_boxes) : num_boxes;
+  // the words past the boxes of the image are not computed
+  const int used = MaskWords(n);
+  mask += static_cast<size_t>(image) * num_boxes * words;
+  for (int j = threadIdx.x; j < words; j += kThreads) remv[j] = 0;
+  __syncthreads();
+  // every thread takes the same decisions, so that nk and the barriers agree
+  int nk = 0;
+  for (int i = 0; i < n && (max_keep <= 0 || nk < max_keep); ++i) {
+    const int word = i / kBoxesPerWord;
+    // a row never sets its own bit, so that the writes below do not change this test
+    if (remv[word] & (1ULL << (i % kBoxesPerWord))) continue;
+    if (keep && threadIdx.x == 0) keep[image * num_boxes + nk] = i;
+    ++nk;
+    const uint64_t *row = mask + static_cast<size_t>(i) * words;
+    for (int j = word + threadIdx.x; j < used; j += kThreads) remv[j] |= row[j];
+    __syncthreads();
+  }
+  if (num_keep && threadIdx.x == 0) num_keep[image] = nk;
+  if (removed) {
+    for (int j = threadIdx.x; j < words; j += kThreads) removed[image * words + j] = remv[j];
+  }
+}
+
+/*!
+ * \brief greedy non-maximum suppression of the boxes of every image, which must
+ *  be sorted by decreasing score
+ * \param boxes the boxes of the first image, as described by layout
+ * \param num_images the images of the batch
+ * \param num_boxes the boxes of each image
+ * \param count device array of the boxes of each image to consider, the first
+ *  ones, NULL for all
+ * \param threshold the overlap above which a box is suppressed, see Overlap
+ * \param max_keep the boxes of an image after which the walk stops, 0 for no limit
+ * \param mask workspace of MaskSize(num_images, num_boxes) bytes
+ * \param keep (num_images, num_boxes) indices of the kept boxes, or NULL
+ * \param num_keep (num_images,) the kept boxes of each image, or NULL
+ * \param removed (num_images, MaskWords(num_boxes)) bits of the suppressed boxes, or NULL
+ */
+template<typename Overlap, typename DType>
+inline void NonMaximumSuppression(mshadow::Stream<gpu> *s, const DType *boxes,
+                                  const BoxLayout &layout, int num_images, int num_boxes,
+                                  const int *count, float threshold, int max_keep,
+                                  uint64_t *mask, int *keep, int *num_keep,
+                                  uint64_t *removed) {
+  if (num_images == 0 || num_boxes == 0) return;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  const int words = MaskWords(num_boxes);
+  CHECK_LE(num_images, 65535) << "too many images for the non-maximum suppression";
+  CHECK_LE(words, 65535) << "too many boxes for the non-maximum suppression";
+  NMSMaskKernel<Overlap><<<dim3(words, words, num_images), kBoxesPerWord, 0, stream>>>(
+    boxes, layout, num_boxes, count, threshold, mask);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(NMSMaskKernel);
+  NMSReduceKernel<kBoxesPerWord><<<num_images, kBoxesPerWord, words * sizeof(uint64_t), stream>>>(
+    mask, num_boxes, count, max_keep, keep, num_keep, removed);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(NMSReduceKernel);
+}
+
+template<typename IType>
+__global__ void SegmentIdKernel(const int n, const IType *index, const int segment_size,
+                                IType *segment) {
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < n; i += blockDim.x * gridDim.x) {
+    segment[i] = index[i] / segment_size;
+  }
+}
+
+template<typename IType>
+__global__ void IotaKernel(const int n, IType *index) {
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < n; i += blockDim.x * gridDim.x) {
+    index[i] = i;
+  }
+}
+
+/*! \brief bytes of the workspace SortSegmentsDescending needs for n keys */
+inline size_t SortSegmentsWorkspaceSize(int n) {
+  return std::max(SortByKeyWorkspaceSize<float, int, gpu>(n),
+                  SortByKeyWorkspaceSize<int, int, gpu>(n));
+}
+
+/*!
+ * \brief the positions of the keys of every segment of segment_size keys, in
+ *  decreasing order of key, stably
+ *
+ * All the keys are radix sorted at once, then stably by segment, which leaves
+ * each segment in order. The top-k of a segment are the first k of its indices.
+ * \param keys the keys, overwritten
+ * \param index receives the positions into keys, segment by segment
+ * \param segment workspace of the size of keys
+ * \param workspace SortSegmentsWorkspaceSize(keys.size(0)) bytes
+ */
+inline void SortSegmentsDescending(mshadow::Tensor<gpu, 1, float> keys,
+                                   mshadow::Tensor<gpu, 1, int> index,
+                                   mshadow::Tensor<gpu, 1, int> segment, int segment_size,
+                                   mshadow::Tensor<gpu, 1, char> *workspace) {
+  using namespace mshadow::cuda;
+  const int n = keys.size(0);
+  if (n == 0) return;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(keys.stream_);
+  const int nblock = std::min(kMaxGridNum, (n + kBaseThreadNum - 1) / kBaseThreadNum);
+  IotaKernel<<<nblock, kBaseThreadNum, 0, stream>>>(n, index.dptr_);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(IotaKernel);
+  SortByKey(keys, index, false, workspace);
+  const int num_segments = (n + segment_size - 1) / segment_size;
+  if (num_segments == 1) return;
+  SegmentIdKernel<<<nblock, kBaseThreadNum, 0, stream>>>(n, index.dptr_, segment_size,
+                                                         segment.dptr_);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(SegmentIdKernel);
+  int end_bit = 1;
+  while ((1 << end_bit) < num_segments) ++end_bit;
+  SortByKey(segment, index, true, workspace, 0, end_bit);
+}
+
+}  // namespace nms
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CONTRIB_NMS_CUH_
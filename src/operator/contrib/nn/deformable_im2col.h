@@ -82,6 +82,7 @@
 
 #include <mxnet/base.h>
 #include <mxnet/operator.h>
+#include <cmath>
 #include <cstring>
 #include <vector>
 #include "../../mxnet_op.h"
@@ -89,28 +90,334 @@
 namespace mxnet {
 namespace op {
 
+/*!
+ * \brief the sizes of a deformable im2col. The column buffer holds, for each of
+ *  the images, the columns col_begin, ..., col_begin + col_num - 1 of the output
+ *  plane, so that it can be filled for several images or a part of one at once.
+ */
+struct DeformableIm2colGeometry {
+  int channels, height, width;
+  int kernel_h, kernel_w, pad_h, pad_w, stride_h, stride_w, dilation_h, dilation_w;
+  int height_col, width_col;
+  int deformable_group;
+  int col_begin, col_num;
+};
+
+inline DeformableIm2colGeometry DeformableGeometry(const TShape& im_shape,
+  const TShape& col_shape, const TShape& kernel_shape, const TShape& pad,
+  const TShape& stride, const TShape& dilation, const uint32_t deformable_group,
+  const index_t col_begin, const index_t col_num) {
+  DeformableIm2colGeometry geo;
+  geo.channels = im_shape[1];
+  geo.height = im_shape[2];
+  geo.width = im_shape[3];
+  geo.kernel_h = kernel_shape[0];
+  geo.kernel_w = kernel_shape[1];
+  geo.pad_h = pad[0];
+  geo.pad_w = pad[1];
+  geo.stride_h = stride[0];
+  geo.stride_w = stride[1];
+  geo.dilation_h = dilation[0];
+  geo.dilation_w = dilation[1];
+  geo.height_col = col_shape[1];
+  geo.width_col = col_shape[2];
+  geo.deformable_group = deformable_group;
+  geo.col_begin = col_begin;
+  geo.col_num = col_num;
+  return geo;
+}
+
+template <typename DType>
+MSHADOW_XINLINE DType deformable_im2col_bilinear(const DType* bottom_data, const int data_width,
+  const int height, const int width, DType h, DType w) {
+  int h_low = floor(h);
+  int w_low = floor(w);
+  int h_high;
+  int w_high;
+  if (h_low >= height - 1) {
+    h_high = h_low = height - 1;
+    h = (DType)h_low;
+  } else {
+    h_high = h_low + 1;
+  }
+
+  if (w_low >= width - 1) {
+    w_high = w_low = width - 1;
+    w = (DType)w_low;
+  } else {
+    w_high = w_low + 1;
+  }
+
+  DType lh = h - h_low;
+  DType lw = w - w_low;
+  DType hh = 1 - lh, hw = 1 - lw;
+
+  DType v1 = bottom_data[h_low * data_width + w_low];
+  DType v2 = bottom_data[h_low * data_width + w_high];
+  DType v3 = bottom_data[h_high * data_width + w_low];
+  DType v4 = bottom_data[h_high * data_width + w_high];
+  DType w1 = hh * hw, w2 = hh * lw, w3 = lh * hw, w4 = lh * lw;
+
+  DType val = (w1 * v1 + w2 * v2 + w3 * v3 + w4 * v4);
+  return val;
+}
+
+template <typename DType>
+MSHADOW_XINLINE DType get_gradient_weight(DType argmax_h, DType argmax_w,
+  const int h, const int w, const int height, const int width) {
+  if (argmax_h < 0 || argmax_h > height || argmax_w < 0 || argmax_w > width) {
+    // empty
+    return 0;
+  }
+
+  int argmax_h_low = static_cast<int>(argmax_h);
+  int argmax_w_low = static_cast<int>(argmax_w);
+  int argmax_h_high;
+  int argmax_w_high;
+  if (argmax_h_low >= height - 1) {
+    argmax_h_high = argmax_h_low = height - 1;
+    argmax_h = (DType)argmax_h_low;
+  } else {
+    argmax_h_high = argmax_h_low + 1;
+  }
+  if (argmax_w_low >= width - 1) {
+    argmax_w_high = argmax_w_low = width - 1;
+    argmax_w = (DType)argmax_w_low;
+  } else {
+    argmax_w_high = argmax_w_low + 1;
+  }
+  DType weight = 0;
+  if (h == argmax_h_low) {
+    if (w == argmax_w_low) {
+      weight = (h + 1 - argmax_h) * (w + 1 - argmax_w);
+    } else if (w == argmax_w_high) {
+      weight = (h + 1 - argmax_h) * (argmax_w + 1 - w);
+    }
+  } else if (h == argmax_h_high) {
+    if (w == argmax_w_low) {
+      weight = (argmax_h + 1 - h) * (w + 1 - argmax_w);
+    } else if (w == argmax_w_high) {
+      weight = (argmax_h + 1 - h) * (argmax_w + 1 - w);
+    }
+  }
+  return weight;
+}
+
+template <typename DType>
+MSHADOW_XINLINE DType get_coordinate_weight(DType argmax_h, DType argmax_w,
+  const int height, const int width, const DType* im_data,
+  const int data_width, const int bp_dir) {
+  if (argmax_h < 0 || argmax_h > height || argmax_w < 0 || argmax_w > width) {
+    // empty
+    return 0;
+  }
+
+  int argmax_h_low = static_cast<int>(argmax_h);
+  int argmax_w_low = static_cast<int>(argmax_w);
+  int argmax_h_high;
+  int argmax_w_high;
+  if (argmax_h_low >= height - 1) {
+    argmax_h_high = argmax_h_low = height - 1;
+    argmax_h = (DType)argmax_h_low;
+  } else {
+    argmax_h_high = argmax_h_low + 1;
+  }
+  if (argmax_w_low >= width - 1) {
+    argmax_w_high = argmax_w_low = width - 1;
+    argmax_w = (DType)argmax_w_low;
+  } else {
+    argmax_w_high = argmax_w_low + 1;
+  }
+  DType weight = 0;
+
+  const DType v1 = im_data[argmax_h_low * data_width + argmax_w_low];
+  const DType v2 = im_data[argmax_h_low * data_width + argmax_w_high];
+  const DType v3 = im_data[argmax_h_high * data_width + argmax_w_low];
+  const DType v4 = im_data[argmax_h_high * data_width + argmax_w_high];
+  if (bp_dir == 0) {
+    weight += -1 * (argmax_w_low + 1 - argmax_w) * v1;
+    weight += -1 * (argmax_w - argmax_w_low) * v2;
+    weight += (argmax_w_low + 1 - argmax_w) * v3;
+    weight += (argmax_w - argmax_w_low) * v4;
+  } else if (bp_dir == 1) {
+    weight += -1 * (argmax_h_low + 1 - argmax_h) * v1;
+    weight += (argmax_h_low + 1 - argmax_h) * v2;
+    weight += -1 * (argmax_h - argmax_h_low) * v3;
+    weight += (argmax_h - argmax_h_low) * v4;
+  }
+
+  return weight;
+}
+
+/*!
+ * \brief fill the column buffer of deformable_im2col,
+ *  one (image, input channel, column) per thread.
+ */
+struct deformable_im2col_kernel {
+  static const int kCPUGrain = 256;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int index, const DType* data_im, const DType* data_offset,
+                                  const DeformableIm2colGeometry geo, DType* data_col) {
+    const int q = index % geo.col_num;
+    const int c_im = (index / geo.col_num) % geo.channels;
+    const int b = index / geo.col_num / geo.channels;
+    const int plane = geo.height_col * geo.width_col;
+    const int ksize = geo.kernel_h * geo.kernel_w;
+    const int p = geo.col_begin + q;
+    const int h_col = p / geo.width_col;
+    const int w_col = p % geo.width_col;
+    // compute deformable group index
+    const int deformable_group_index = c_im / (geo.channels / geo.deformable_group);
+
+    const int h_in = h_col * geo.stride_h - geo.pad_h;
+    const int w_in = w_col * geo.stride_w - geo.pad_w;
+    DType* data_col_ptr = data_col + ((b * geo.channels + c_im) * ksize) * geo.col_num + q;
+    const DType* data_im_ptr = data_im + (b * geo.channels + c_im) * geo.height * geo.width;
+    const DType* data_offset_ptr = data_offset +
+      (b * geo.deformable_group + deformable_group_index) * 2 * ksize * plane + p;
+    for (int i = 0; i < geo.kernel_h; ++i) {
+      for (int j = 0; j < geo.kernel_w; ++j) {
+        const DType offset_h = data_offset_ptr[(2 * (i * geo.kernel_w + j)) * plane];
+        const DType offset_w = data_offset_ptr[(2 * (i * geo.kernel_w + j) + 1) * plane];
+        DType val = static_cast<DType>(0);
+        const DType h_im = h_in + i * geo.dilation_h + offset_h;
+        const DType w_im = w_in + j * geo.dilation_w + offset_w;
+        if (h_im >= 0 && w_im >= 0 && h_im < geo.height && w_im < geo.width) {
+          val = deformable_im2col_bilinear(data_im_ptr, geo.width, geo.height, geo.width,
+                                           h_im, w_im);
+        }
+        *data_col_ptr = val;
+        data_col_ptr += geo.col_num;
+      }
+    }
+  }
+};
+
+/*!
+ * \brief the gradient of the offsets from the column buffer,
+ *  one (image, offset channel, column) per thread.
+ */
+struct deformable_col2im_coord_kernel {
+  static const int kCPUGrain = 64;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int index, const DType* data_col, const DType* data_im,
+                                  const DType* data_offset, const DeformableIm2colGeometry geo,
+                                  DType* grad_offset) {
+    const int ksize = geo.kernel_h * geo.kernel_w;
+    const int offset_channels = 2 * ksize * geo.deformable_group;
+    const int q = index % geo.col_num;
+    const int c = (index / geo.col_num) % offset_channels;
+    const int b = index / geo.col_num / offset_channels;
+    const int plane = geo.height_col * geo.width_col;
+    const int p = geo.col_begin + q;
+    const int h_out = p / geo.width_col;
+    const int w_out = p % geo.width_col;
+
+    const int deformable_group_index = c / (2 * ksize);
+    const int offset_c = c - deformable_group_index * 2 * ksize;
+    const int bp_dir = offset_c % 2;
+    // the sampling point of the offset, which is the same for every channel of the group
+    const int kidx = offset_c / 2;
+    const int i = kidx / geo.kernel_w;
+    const int j = kidx % geo.kernel_w;
+    const DType* data_offset_ptr = data_offset +
+      (b * geo.deformable_group + deformable_group_index) * 2 * ksize * plane + p;
+    const DType offset_h = data_offset_ptr[(2 * kidx) * plane];
+    const DType offset_w = data_offset_ptr[(2 * kidx + 1) * plane];
+    DType inv_h = h_out * geo.stride_h - geo.pad_h + i * geo.dilation_h + offset_h;
+    DType inv_w = w_out * geo.stride_w - geo.pad_w + j * geo.dilation_w + offset_w;
+    if (inv_h < 0 || inv_w < 0 || inv_h >= geo.height || inv_w >= geo.width) {
+      inv_h = inv_w = -1;
+    }
+
+    const int channel_per_deformable_group = geo.channels / geo.deformable_group;
+    const int c_begin = b * geo.channels + deformable_group_index * channel_per_deformable_group;
+    DType val = 0;
+    for (int cnt = 0; cnt < channel_per_deformable_group; ++cnt) {
+      const DType weight = get_coordinate_weight(inv_h, inv_w, geo.height, geo.width,
+        data_im + (c_begin + cnt) * geo.height * geo.width, geo.width, bp_dir);
+      val += weight * data_col[((c_begin + cnt) * ksize + kidx) * geo.col_num + q];
+    }
+    grad_offset[(b * offset_channels + c) * plane + p] = val;
+  }
+};
+
+/*!
+ * \brief cpu kernel of deformable_col2im, one (image, input channel) per thread,
+ *  so that the gradient of a pixel is added up without atomics.
+ */
+struct deformable_col2im_cpu_kernel {
+  static const int kCPUGrain = 1;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int index, const DType* data_col, const DType* data_offset,
+                                  const DeformableIm2colGeometry geo, DType* grad_im) {
+    const int c = index % geo.channels;
+    const int b = index / geo.channels;
+    const int plane = geo.height_col * geo.width_col;
+    const int ksize = geo.kernel_h * geo.kernel_w;
+    const int deformable_group_index = c / (geo.channels / geo.deformable_group);
+    const DType* data_col_ptr = data_col + index * ksize * geo.col_num;
+    const DType* data_offset_ptr = data_offset +
+      (b * geo.deformable_group + deformable_group_index) * 2 * ksize * plane;
+    DType* grad_im_ptr = grad_im + index * geo.height * geo.width;
+    for (int kidx = 0; kidx < ksize; ++kidx) {
+      const int i = kidx / geo.kernel_w;
+      const int j = kidx % geo.kernel_w;
+      for (int q = 0; q < geo.col_num; ++q) {
+        const int p = geo.col_begin + q;
+        const int h_in = p / geo.width_col * geo.stride_h - geo.pad_h;
+        const int w_in = p % geo.width_col * geo.stride_w - geo.pad_w;
+        const DType offset_h = data_offset_ptr[(2 * kidx) * plane + p];
+        const DType offset_w = data_offset_ptr[(2 * kidx + 1) * plane + p];
+        const DType cur_inv_h_data = h_in + i * geo.dilation_h + offset_h;
+        const DType cur_inv_w_data = w_in + j * geo.dilation_w + offset_w;
+        const DType cur_top_grad = data_col_ptr[kidx * geo.col_num + q];
+        const int cur_h = static_cast<int>(cur_inv_h_data);
+        const int cur_w = static_cast<int>(cur_inv_w_data);
+        // only the two rows and columns around the sampling point get a weight
+        for (int y = cur_h; y <= cur_h + 1; ++y) {
+          for (int x = cur_w; x <= cur_w + 1; ++x) {
+            if (y >= 0 && y < geo.height && x >= 0 && x < geo.width) {
+              grad_im_ptr[y * geo.width + x] += cur_top_grad *
+                get_gradient_weight(cur_inv_h_data, cur_inv_w_data, y, x, geo.height, geo.width);
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
 /*!\brief
- * cpu function of deformable_im2col algorithm
+ * function of deformable_im2col algorithm
  * \param s device stream
- * \param data_im pointer of an image (C, H, W, ...) in the image batch
- * \param data_offset pointer of offset (C, H, W, ...) in the offset batch
+ * \param data_im pointer of the first image (C, H, W, ...) in the image batch
+ * \param data_offset pointer of the offset (C, H, W, ...) of the first image
  * \param im_shape input image shape in dimensions (N, C, H, W,)
- * \param col_shape column buffer shape (#channels, output_im_height, output_im_width, ...)
+ * \param col_shape column buffer shape of an image
+ *        (#channels, output_im_height, output_im_width, ...)
  * \param kernel_shape kernel filter shape
  * \param pad pad shape
  * \param stride stride shape
  * \param dilation dilation shape
  * \param deformable_group #offset group that deformable convolution use
- * \param data_col column buffer pointer
+ * \param data_col column buffer pointer, (num_images, #channels, col_num)
+ * \param num_images #images to fill the column buffer for
+ * \param col_begin the first column of the output plane in the buffer
+ * \param col_num #columns of the output plane in the buffer
  */
-template <typename DType>
-inline void deformable_im2col(mshadow::Stream<cpu>* s,
+template <typename xpu, typename DType>
+inline void deformable_im2col(mshadow::Stream<xpu>* s,
   const DType* data_im, const DType* data_offset,
   const TShape& im_shape, const TShape& col_shape, const TShape& kernel_shape,
   const TShape& pad, const TShape& stride, const TShape& dilation,
-  const uint32_t deformable_group, DType* data_col) {
+  const uint32_t deformable_group, DType* data_col,
+  const index_t num_images, const index_t col_begin, const index_t col_num) {
   if (2 == kernel_shape.ndim()) {
-    LOG(FATAL) << "only implemented in GPU";
+    mxnet_op::Kernel<deformable_im2col_kernel, xpu>::Launch(s,
+      num_images * im_shape[1] * col_num, data_im, data_offset,
+      DeformableGeometry(im_shape, col_shape, kernel_shape, pad, stride, dilation,
+                         deformable_group, col_begin, col_num), data_col);
   } else {
     LOG(FATAL) << "not implemented";
   }
@@ -120,16 +427,20 @@ inline void deformable_im2col(mshadow::Stream<cpu>* s,
 /*!\brief
  * cpu function of deformable_col2im algorithm
  * \param s device stream
- * \param data_col start pointer of the column buffer to be filled
- * \param data_offset pointer of offset (C, H, W, ...) in the offset batch
+ * \param data_col start pointer of the column buffer, (num_images, #channels, col_num)
+ * \param data_offset pointer of the offset (C, H, W, ...) of the first image
  * \param im_shape input image shape in dimensions (N, C, H, W,)
- * \param col_shape column buffer shape
+ * \param col_shape column buffer shape of an image
  * \param kernel_shape kernel filter shape
  * \param pad pad shape
  * \param stride stride shape
  * \param dilation dilation shape
  * \param deformable_group #offset group that deformable convolution use
- * \param grad_im pointer of a image (C, H, W,...) in the image batch
+ * \param grad_im pointer of the first image (C, H, W,...) in the image batch,
+ *        which the gradient is added to
+ * \param num_images #images in the column buffer
+ * \param col_begin the first column of the output plane in the buffer
+ * \param col_num #columns of the output plane in the buffer
  */
 template <typename DType>
 inline void deformable_col2im(mshadow::Stream<cpu>* s,
@@ -137,35 +448,53 @@ inline void deformable_col2im(mshadow::Stream<cpu>* s,
   const TShape& im_shape, const TShape& col_shape, const TShape& kernel_shape,
   const TShape& pad, const TShape& stride,
   const TShape& dilation, const uint32_t deformable_group,
-  DType* grad_im, OpReqType req) {
-  index_t num_spatial_axes = kernel_shape.ndim();
-  LOG(FATAL) << "only implemented in GPU";
+  DType* grad_im, OpReqType req,
+  const index_t num_images, const index_t col_begin, const index_t col_num) {
+  if (2 == kernel_shape.ndim()) {
+    mxnet_op::Kernel<deformable_col2im_cpu_kernel, cpu>::Launch(s,
+      num_images * im_shape[1], data_col, data_offset,
+      DeformableGeometry(im_shape, col_shape, kernel_shape, pad, stride, dilation,
+                         deformable_group, col_begin, col_num), grad_im);
+  } else {
+    LOG(FATAL) << "not implemented";
+  }
 }
 
 
 /*!\brief
- * cpu function of deformable_col2im_coord algorithm
+ * function of deformable_col2im_coord algorithm
  * \param s device stream
- * \param data_col start pointer of the column buffer to be filled
- * \param data_im pointer of an image (C, H, W, ...) in the image batch
- * \param data_offset pointer of offset (C, H, W, ...) in the offset batch
+ * \param data_col start pointer of the column buffer, (num_images, #channels, col_num)
+ * \param data_im pointer of the first image (C, H, W, ...) in the image batch
+ * \param data_offset pointer of the offset (C, H, W, ...) of the first image
  * \param im_shape input image shape in dimensions (N, C, H, W,)
- * \param col_shape column buffer shape
+ * \param col_shape column buffer shape of an image
  * \param kernel_shape kernel filter shape
  * \param pad pad shape
  * \param stride stride shape
  * \param dilation dilation shape
  * \param deformable_group #offset group that deformable convolution use
- * \param grad_offset pointer of the offset (C, H, W,...) in the offset batch
+ * \param grad_offset pointer of the offset (C, H, W,...) of the first image
+ * \param num_images #images in the column buffer
+ * \param col_begin the first column of the output plane in the buffer
+ * \param col_num #columns of the output plane in the buffer
  */
-
-template <typename DType>
-inline void deformable_col2im_coord(mshadow::Stream<cpu>* s,
+template <typename xpu, typename DType>
+inline void deformable_col2im_coord(mshadow::Stream<xpu>* s,
   const DType* data_col, const DType* data_im, const DType* data_offset, const TShape& im_shape,
   const TShape& col_shape, const TShape& kernel_shape,
   const TShape& pad, const TShape& stride,
-  const TShape& dilation, const uint32_t deformable_group, DType* grad_offset, OpReqType req) {
-  LOG(FATAL) << "only implemented in GPU";
+  const TShape& dilation, const uint32_t deformable_group, DType* grad_offset, OpReqType req,
+  const index_t num_images, const index_t col_begin, const index_t col_num) {
+  if (2 == kernel_shape.ndim()) {
+    mxnet_op::Kernel<deformable_col2im_coord_kernel, xpu>::Launch(s,
+      num_images * 2 * kernel_shape.Size() * deformable_group * col_num,
+      data_col, data_im, data_offset,
+      DeformableGeometry(im_shape, col_shape, kernel_shape, pad, stride, dilation,
+                         deformable_group, col_begin, col_num), grad_offset);
+  } else {
+    LOG(FATAL) << "not implemented";
+  }
 }
 
 }  // namespace op
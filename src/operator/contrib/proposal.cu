@@ -27,9 +27,6 @@
 #include <mxnet/operator.h>
 #include <mshadow/tensor.h>
 #include <mshadow/cuda/reduce.cuh>
-#include <thrust/sort.h>
-#include <thrust/execution_policy.h>
-#include <thrust/functional.h>
 
 #include <map>
 #include <vector>
@@ -41,8 +38,7 @@
 #include "../operator_common.h"
 #include "../mshadow_op.h"
 #include "./proposal-inl.h"
-
-#define DIVUP(m, n) ((m) / (n) + ((m) % (n) > 0))
+#include "./nms.cuh"
 
 #define FRCNN_CUDA_CHECK(condition) \
   /* Code block avoids redefinition of cudaError_t error */ \
@@ -247,113 +243,6 @@ __global__ void ReorderProposalsKernel(const int count,
   }
 }
 
-__device__ inline float devIoU(float const * const a, float const * const b) {
-  float left = max(a[0], b[0]), right = min(a[2], b[2]);
-  float top = max(a[1], b[1]), bottom = min(a[3], b[3]);
-  float width = max(right - left + 1, 0.f), height = max(bottom - top + 1, 0.f);
-  float interS = width * height;
-  float Sa = (a[2] - a[0] + 1) * (a[3] - a[1] + 1);
-  float Sb = (b[2] - b[0] + 1) * (b[3] - b[1] + 1);
-  return interS / (Sa + Sb - interS);
-}
-
-__global__ void nms_kernel(const int n_boxes, const float nms_overlap_thresh,
-                           const float *dev_boxes, uint64_t *dev_mask) {
-  const int threadsPerBlock = sizeof(uint64_t) * 8;
-  const int row_start = blockIdx.y;
-  const int col_start = blockIdx.x;
-
-  // if (row_start > col_start) return;
-
-  const int row_size =
-        min(n_boxes - row_start * threadsPerBlock, threadsPerBlock);
-  const int col_size =
-        min(n_boxes - col_start * threadsPerBlock, threadsPerBlock);
-
-  __shared__ float block_boxes[threadsPerBlock * 5];
-  if (threadIdx.x < col_size) {
-    block_boxes[threadIdx.x * 5 + 0] =
-        dev_boxes[(threadsPerBlock * col_start + threadIdx.x) * 5 + 0];
-    block_boxes[threadIdx.x * 5 + 1] =
-        dev_boxes[(threadsPerBlock * col_start + threadIdx.x) * 5 + 1];
-    block_boxes[threadIdx.x * 5 + 2] =
-        dev_boxes[(threadsPerBlock * col_start + threadIdx.x) * 5 + 2];
-    block_boxes[threadIdx.x * 5 + 3] =
-        dev_boxes[(threadsPerBlock * col_start + threadIdx.x) * 5 + 3];
-    block_boxes[threadIdx.x * 5 + 4] =
-        dev_boxes[(threadsPerBlock * col_start + threadIdx.x) * 5 + 4];
-  }
-  __syncthreads();
-
-  if (threadIdx.x < row_size) {
-    const int cur_box_idx = threadsPerBlock * row_start + threadIdx.x;
-    const float *cur_box = dev_boxes + cur_box_idx * 5;
-    int i = 0;
-    uint64_t t = 0;
-    int start = 0;
-    if (row_start == col_start) {
-      start = threadIdx.x + 1;
-    }
-    for (i = start; i < col_size; i++) {
-      if (devIoU(cur_box, block_boxes + i * 5) > nms_overlap_thresh) {
-        t |= 1ULL << i;
-      }
-    }
-    const int col_blocks = DIVUP(n_boxes, threadsPerBlock);
-    dev_mask[cur_box_idx * col_blocks + col_start] = t;
-  }
-}
-
-void _nms(const mshadow::Tensor<gpu, 2>& boxes,
-          const float nms_overlap_thresh,
-          int *keep,
-          int *num_out) {
-  const int threadsPerBlock = sizeof(uint64_t) * 8;
-  const int boxes_num = boxes.size(0);
-  const int boxes_dim = boxes.size(1);
-
-  float* boxes_dev = boxes.dptr_;
-  uint64_t* mask_dev = NULL;
-
-  const int col_blocks = DIVUP(boxes_num, threadsPerBlock);
-  FRCNN_CUDA_CHECK(cudaMalloc(&mask_dev,
-                              boxes_num * col_blocks * sizeof(uint64_t)));
-
-  dim3 blocks(DIVUP(boxes_num, threadsPerBlock),
-              DIVUP(boxes_num, threadsPerBlock));
-  dim3 threads(threadsPerBlock);
-  nms_kernel<<<blocks, threads>>>(boxes_num,
-                                  nms_overlap_thresh,
-                                  boxes_dev,
-                                  mask_dev);
-  FRCNN_CUDA_CHECK(cudaPeekAtLastError());
-  std::vector<uint64_t> mask_host(boxes_num * col_blocks);
-  FRCNN_CUDA_CHECK(cudaMemcpy(&mask_host[0],
-                              mask_dev,
-                              sizeof(uint64_t) * boxes_num * col_blocks,
-                              cudaMemcpyDeviceToHost));
-
-  std::vector<uint64_t> remv(col_blocks);
-  memset(&remv[0], 0, sizeof(uint64_t) * col_blocks);
-
-  int num_to_keep = 0;
-  for (int i = 0; i < boxes_num; i++) {
-    int nblock = i / threadsPerBlock;
-    int inblock = i % threadsPerBlock;
-
-    if (!(remv[nblock] & (1ULL << inblock))) {
-      keep[num_to_keep++] = i;
-      uint64_t *p = &mask_host[0] + i * col_blocks;
-      for (int j = nblock; j < col_blocks; j++) {
-        remv[j] |= p[j];
-      }
-    }
-  }
-  *num_out = num_to_keep;
-
-  FRCNN_CUDA_CHECK(cudaFree(mask_dev));
-}
-
 // copy proposals to output
 // dets (top_n, 5); keep (top_n, ); out (top_n, )
 // count should be top_n (total anchors or proposals)
@@ -361,9 +250,10 @@ template<typename Dtype>
 __global__ void PrepareOutput(const int count,
                               const Dtype* dets,
                               const int* keep,
-                              const int out_size,
+                              const int* num_keep,
                               Dtype* out,
                               Dtype* score) {
+  const int out_size = *num_keep;
   for (int index = blockIdx.x * blockDim.x + threadIdx.x;
        index < count;
        index += blockDim.x * gridDim.x) {
@@ -413,6 +303,7 @@ class ProposalGPUOp : public Operator{
       << "Sorry, multiple images each device is not implemented.";
 
     Stream<xpu> *s = ctx.get_stream<xpu>();
+    cudaStream_t stream = Stream<gpu>::GetStream(s);
 
     Shape<4> fg_scores_shape = Shape4(in_data[proposal::kClsProb].shape_[0],
                                       in_data[proposal::kClsProb].shape_[1] / 2,
@@ -461,7 +352,7 @@ class ProposalGPUOp : public Operator{
     dim3 dimGrid((count + kMaxThreadsPerBlock - 1) / kMaxThreadsPerBlock);
     dim3 dimBlock(kMaxThreadsPerBlock);
     CheckLaunchParam(dimGrid, dimBlock, "ProposalGrid");
-    ProposalGridKernel<<<dimGrid, dimBlock>>>(
+    ProposalGridKernel<<<dimGrid, dimBlock, 0, stream>>>(
       count, num_anchors, height, width, param_.feature_stride,
       scores.dptr_, workspace_proposals.dptr_);
     FRCNN_CUDA_CHECK(cudaPeekAtLastError());
@@ -481,12 +372,12 @@ class ProposalGPUOp : public Operator{
     // Transform anchors and bbox_deltas into bboxes
     CheckLaunchParam(dimGrid, dimBlock, "BBoxPred");
     if (param_.iou_loss) {
-      IoUPredKernel<<<dimGrid, dimBlock>>>(
+      IoUPredKernel<<<dimGrid, dimBlock, 0, stream>>>(
         count, num_anchors, height, width, real_height, real_width,
         cpu_im_info[0], cpu_im_info[1],
         workspace_proposals.dptr_, bbox_deltas.dptr_, workspace_proposals.dptr_);
     } else {
-      BBoxPredKernel<<<dimGrid, dimBlock>>>(
+      BBoxPredKernel<<<dimGrid, dimBlock, 0, stream>>>(
         count, num_anchors, height, width, real_height, real_width,
         cpu_im_info[0], cpu_im_info[1],
         workspace_proposals.dptr_, bbox_deltas.dptr_, workspace_proposals.dptr_);
@@ -495,30 +386,30 @@ class ProposalGPUOp : public Operator{
 
     // filter boxes with less than rpn_min_size
     CheckLaunchParam(dimGrid, dimBlock, "FilterBox");
-    FilterBoxKernel<<<dimGrid, dimBlock>>>(
+    FilterBoxKernel<<<dimGrid, dimBlock, 0, stream>>>(
       count, param_.rpn_min_size * cpu_im_info[2], workspace_proposals.dptr_);
     FRCNN_CUDA_CHECK(cudaPeekAtLastError());
 
     // Copy score to a continuous memory
     float* score_ptr = NULL;
     FRCNN_CUDA_CHECK(cudaMalloc(&score_ptr, sizeof(float) * count));
-    Tensor<xpu, 1> score(score_ptr, Shape1(count));
+    Tensor<xpu, 1> score(score_ptr, Shape1(count), s);
     int* order_ptr = NULL;
     FRCNN_CUDA_CHECK(cudaMalloc(&order_ptr, sizeof(int) * count));
-    Tensor<xpu, 1, int> order(order_ptr, Shape1(count));
+    Tensor<xpu, 1, int> order(order_ptr, Shape1(count), s);
 
     CheckLaunchParam(dimGrid, dimBlock, "CopyScore");
-    CopyScoreKernel<<<dimGrid, dimBlock>>>(
+    CopyScoreKernel<<<dimGrid, dimBlock, 0, stream>>>(
       count, workspace_proposals.dptr_, score.dptr_, order.dptr_);
     FRCNN_CUDA_CHECK(cudaPeekAtLastError());
 
     // argsort score, save order
-    thrust::stable_sort_by_key(thrust::device,
-                               score.dptr_,
-                               score.dptr_ + score.size(0),
-                               order.dptr_,
-                               thrust::greater<real_t>());
-    FRCNN_CUDA_CHECK(cudaPeekAtLastError());
+    char* sort_workspace_ptr = NULL;
+    const size_t sort_workspace_size = SortByKeyWorkspaceSize<real_t, int, xpu>(count);
+    FRCNN_CUDA_CHECK(cudaMalloc(&sort_workspace_ptr, sort_workspace_size));
+    Tensor<xpu, 1, char> sort_workspace(sort_workspace_ptr, Shape1(sort_workspace_size), s);
+    SortByKey(score, order, false, &sort_workspace);
+    FRCNN_CUDA_CHECK(cudaFree(sort_workspace_ptr));
 
     // Reorder proposals according to order
     float* workspace_ordered_proposals_ptr = NULL;
@@ -529,7 +420,7 @@ class ProposalGPUOp : public Operator{
 
     dimGrid.x = (rpn_pre_nms_top_n + kMaxThreadsPerBlock - 1) / kMaxThreadsPerBlock;
     CheckLaunchParam(dimGrid, dimBlock, "ReorderProposals");
-    ReorderProposalsKernel<<<dimGrid, dimBlock>>>(
+    ReorderProposalsKernel<<<dimGrid, dimBlock, 0, stream>>>(
       rpn_pre_nms_top_n, workspace_proposals.dptr_, order.dptr_, workspace_ordered_proposals.dptr_);
     FRCNN_CUDA_CHECK(cudaPeekAtLastError());
 
@@ -537,24 +428,28 @@ class ProposalGPUOp : public Operator{
     FRCNN_CUDA_CHECK(cudaFree(score_ptr));
     FRCNN_CUDA_CHECK(cudaFree(order_ptr));
 
-    // perform nms
-    std::vector<int> _keep(workspace_ordered_proposals.size(0));
-    int out_size = 0;
-    _nms(workspace_ordered_proposals,
-         param_.threshold,
-         &_keep[0],
-         &out_size);
-
-    // copy nms result to gpu
+    // perform nms, the first rpn_post_nms_top_n kept boxes are all that is used
+    const int pre_nms = workspace_ordered_proposals.size(0);
+    uint64_t* mask = NULL;
+    FRCNN_CUDA_CHECK(cudaMalloc(&mask, nms::MaskSize(1, pre_nms)));
     int* keep;
-    FRCNN_CUDA_CHECK(cudaMalloc(&keep, sizeof(int) * _keep.size()));
-    FRCNN_CUDA_CHECK(cudaMemcpy(keep, &_keep[0], sizeof(int) * _keep.size(),
-                                cudaMemcpyHostToDevice));
+    FRCNN_CUDA_CHECK(cudaMalloc(&keep, sizeof(int) * (pre_nms + 1)));
+    int* out_size = keep + pre_nms;
+    nms::BoxLayout layout;
+    layout.image_stride = pre_nms * 5;
+    layout.box_stride = 5;
+    layout.coord = 0;
+    layout.cls = -1;
+    nms::NonMaximumSuppression<nms::PixelOverlap>(s, workspace_ordered_proposals.dptr_,
+                                                  layout, 1, pre_nms, NULL, param_.threshold,
+                                                  rpn_post_nms_top_n, mask, keep, out_size,
+                                                  NULL);
+    FRCNN_CUDA_CHECK(cudaFree(mask));
 
     // copy results after nms
     dimGrid.x = (rpn_post_nms_top_n + kMaxThreadsPerBlock - 1) / kMaxThreadsPerBlock;
     CheckLaunchParam(dimGrid, dimBlock, "PrepareOutput");
-    PrepareOutput<<<dimGrid, dimBlock>>>(
+    PrepareOutput<<<dimGrid, dimBlock, 0, stream>>>(
       rpn_post_nms_top_n, workspace_ordered_proposals.dptr_, keep, out_size,
       out.dptr_, out_score.dptr_);
     FRCNN_CUDA_CHECK(cudaPeekAtLastError());
@@ -51,7 +51,9 @@ struct quantize {
                                   const float *imin_range, const float *imax_range,
                                   double min_limit, double max_limit) {
     float scale = (max_limit - min_limit) / (*imax_range - *imin_range);
-    out[i] = static_cast<DstDType>((in[i] - *imin_range) * scale + 0.5);
+    // values out of the range saturate instead of wrapping around
+    float q = (in[i] - *imin_range) * scale + 0.5;
+    out[i] = static_cast<DstDType>(q < min_limit ? min_limit : (q > max_limit ? max_limit : q));
     *omin_range = *imin_range;
     *omax_range = *imax_range;
   }
@@ -0,0 +1,146 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file quantized_fully_connected-inl.h
+ * \brief fully connected layer over uint8 data and weights
+ */
+#ifndef MXNET_OPERATOR_CONTRIB_QUANTIZED_FULLY_CONNECTED_INL_H_
+#define MXNET_OPERATOR_CONTRIB_QUANTIZED_FULLY_CONNECTED_INL_H_
+
+#include <mxnet/operator_util.h>
+#include <dmlc/omp.h>
+#include <vector>
+#include "../elemwise_op_common.h"
+#include "../operator_common.h"
+
+namespace mxnet {
+namespace op {
+
+struct QuantizedFullyConnectedParam :
+    public dmlc::Parameter<QuantizedFullyConnectedParam> {
+  int num_hidden;
+  DMLC_DECLARE_PARAMETER(QuantizedFullyConnectedParam) {
+    DMLC_DECLARE_FIELD(num_hidden).set_lower_bound(1)
+    .describe("Number of hidden nodes of the output.");
+  }
+};
+
+namespace qfc {
+enum QuantizedFullyConnectedInputs {
+  kData, kWeight, kBias, kMinData, kMaxData, kMinWeight, kMaxWeight
+};
+}  // namespace qfc
+
+/*!
+ * \brief The values of the data and the weights are affine in their uint8
+ *  codes, `x = min + q * (max - min) / 255`. The dot products of the codes
+ *  are accumulated in int32 and the offsets are added back with the sums of
+ *  the codes of each row, so the output is float32.
+ */
+inline void QuantizedFullyConnectedCompute(const nnvm::NodeAttrs& attrs,
+                                           const OpContext& ctx,
+                                           const std::vector<TBlob>& inputs,
+                                           const std::vector<OpReqType>& req,
+                                           const std::vector<TBlob>& outputs) {
+  using namespace qfc;
+  const QuantizedFullyConnectedParam& param =
+      nnvm::get<QuantizedFullyConnectedParam>(attrs.parsed);
+  if (req[0] == kNullOp) return;
+  CHECK_EQ(req[0], kWriteTo) << "quantized_fully_connected only supports write to";
+  const TBlob& data = inputs[kData];
+  const index_t batch = data.shape_[0];
+  const index_t k = data.shape_.Size() / batch;
+  const index_t n = param.num_hidden;
+  const uint8_t* a = data.dptr<uint8_t>();
+  const uint8_t* w = inputs[kWeight].dptr<uint8_t>();
+  const float* bias = inputs[kBias].dptr<float>();
+  const float min_a = *inputs[kMinData].dptr<float>();
+  const float min_w = *inputs[kMinWeight].dptr<float>();
+  const float scale_a = (*inputs[kMaxData].dptr<float>() - min_a) / 255.0f;
+  const float scale_w = (*inputs[kMaxWeight].dptr<float>() - min_w) / 255.0f;
+  float* out = outputs[0].dptr<float>();
+
+  std::vector<int32_t> sum_a(batch), sum_w(n);
+  #pragma omp parallel for
+  for (index_t i = 0; i < batch; ++i) {
+    int32_t sum = 0;
+    for (index_t j = 0; j < k; ++j) sum += a[i * k + j];
+    sum_a[i] = sum;
+  }
+  #pragma omp parallel for
+  for (index_t i = 0; i < n; ++i) {
+    int32_t sum = 0;
+    for (index_t j = 0; j < k; ++j) sum += w[i * k + j];
+    sum_w[i] = sum;
+  }
+  const float offset = k * min_a * min_w;
+  #pragma omp parallel for
+  for (index_t i = 0; i < batch; ++i) {
+    const uint8_t* row = a + i * k;
+    for (index_t o = 0; o < n; ++o) {
+      const uint8_t* col = w + o * k;
+      int32_t acc = 0;
+      for (index_t j = 0; j < k; ++j) {
+        acc += static_cast<int32_t>(row[j]) * static_cast<int32_t>(col[j]);
+      }
+      out[i * n + o] = offset + min_a * scale_w * sum_w[o] + min_w * scale_a * sum_a[i] +
+          scale_a * scale_w * acc + bias[o];
+    }
+  }
+}
+
+inline bool QuantizedFullyConnectedShape(const nnvm::NodeAttrs& attrs,
+                                         std::vector<TShape> *in_attrs,
+                                         std::vector<TShape> *out_attrs) {
+  using namespace qfc;
+  const QuantizedFullyConnectedParam& param =
+      nnvm::get<QuantizedFullyConnectedParam>(attrs.parsed);
+  CHECK_EQ(in_attrs->size(), 7U);
+  CHECK_EQ(out_attrs->size(), 1U);
+  const TShape& dshape = in_attrs->at(kData);
+  if (dshape.ndim() == 0) return false;
+  const index_t k = dshape.ProdShape(1, dshape.ndim());
+  SHAPE_ASSIGN_CHECK(*in_attrs, kWeight, Shape2(param.num_hidden, k));
+  SHAPE_ASSIGN_CHECK(*in_attrs, kBias, Shape1(param.num_hidden));
+  for (int i = kMinData; i <= kMaxWeight; ++i) {
+    SHAPE_ASSIGN_CHECK(*in_attrs, i, TShape{1});
+  }
+  SHAPE_ASSIGN_CHECK(*out_attrs, 0, Shape2(dshape[0], param.num_hidden));
+  return true;
+}
+
+inline bool QuantizedFullyConnectedType(const nnvm::NodeAttrs& attrs,
+                                        std::vector<int> *in_attrs,
+                                        std::vector<int> *out_attrs) {
+  using namespace qfc;
+  CHECK_EQ(in_attrs->size(), 7U);
+  CHECK_EQ(out_attrs->size(), 1U);
+  TYPE_ASSIGN_CHECK(*in_attrs, kData, mshadow::kUint8);
+  TYPE_ASSIGN_CHECK(*in_attrs, kWeight, mshadow::kUint8);
+  for (int i = kBias; i <= kMaxWeight; ++i) {
+    TYPE_ASSIGN_CHECK(*in_attrs, i, mshadow::kFloat32);
+  }
+  TYPE_ASSIGN_CHECK(*out_attrs, 0, mshadow::kFloat32);
+  return true;
+}
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CONTRIB_QUANTIZED_FULLY_CONNECTED_INL_H_
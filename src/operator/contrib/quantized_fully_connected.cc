@@ -0,0 +1,62 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file quantized_fully_connected.cc
+ * \brief
+ */
+#include "./quantized_fully_connected-inl.h"
+
+namespace mxnet {
+namespace op {
+DMLC_REGISTER_PARAMETER(QuantizedFullyConnectedParam);
+
+NNVM_REGISTER_OP(_contrib_quantized_fully_connected)
+.describe(R"code(Fully connected layer over data and weights quantized to `uint8`
+by `quantize`, for inference.
+
+The dot products are accumulated in int32 and the output is the float32
+result of the layer over the dequantized inputs:
+
+`out = dequantize(data) * dequantize(weight)^T + bias`
+
+The data is flattened to 2 dimensions like in `FullyConnected`.
+)code" ADD_FILELINE)
+.set_attr_parser(ParamParser<QuantizedFullyConnectedParam>)
+.set_num_inputs(7)
+.set_num_outputs(1)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::string>{"data", "weight", "bias", "min_data", "max_data",
+                                    "min_weight", "max_weight"};
+  })
+.set_attr<nnvm::FInferShape>("FInferShape", QuantizedFullyConnectedShape)
+.set_attr<nnvm::FInferType>("FInferType", QuantizedFullyConnectedType)
+.set_attr<FCompute>("FCompute<cpu>", QuantizedFullyConnectedCompute)
+.add_argument("data", "NDArray-or-Symbol", "Input data of type `uint8`")
+.add_argument("weight", "NDArray-or-Symbol", "Weight matrix of type `uint8`")
+.add_argument("bias", "NDArray-or-Symbol", "Bias parameter of type `float32`")
+.add_argument("min_data", "NDArray-or-Symbol", "The minimum scalar value of the data")
+.add_argument("max_data", "NDArray-or-Symbol", "The maximum scalar value of the data")
+.add_argument("min_weight", "NDArray-or-Symbol", "The minimum scalar value of the weight")
+.add_argument("max_weight", "NDArray-or-Symbol", "The maximum scalar value of the weight")
+.add_arguments(QuantizedFullyConnectedParam::__FIELDS__());
+
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,236 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file resize-inl.h
+ * \brief resizes the height and width of images by bilinear or nearest interpolation
+ */
+#ifndef MXNET_OPERATOR_CONTRIB_RESIZE_INL_H_
+#define MXNET_OPERATOR_CONTRIB_RESIZE_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator_util.h>
+#include <cmath>
+#include <vector>
+#include "../mshadow_op.h"
+#include "../mxnet_op.h"
+#include "../operator_common.h"
+#include "../elemwise_op_common.h"
+
+namespace mxnet {
+namespace op {
+
+namespace resize {
+enum ResizeOpInputs {kData};
+enum ResizeOpOutputs {kOut};
+enum ResizeOpType {kNearest, kBilinear};
+}  // namespace resize
+
+struct ResizeParam : public dmlc::Parameter<ResizeParam> {
+  int height;
+  int width;
+  float scale_height;
+  float scale_width;
+  int sample_type;
+  bool align_corners;
+  DMLC_DECLARE_PARAMETER(ResizeParam) {
+    DMLC_DECLARE_FIELD(height).set_default(0).set_lower_bound(0)
+    .describe("Output height. 0 takes the input height times scale_height.");
+    DMLC_DECLARE_FIELD(width).set_default(0).set_lower_bound(0)
+    .describe("Output width. 0 takes the input width times scale_width.");
+    DMLC_DECLARE_FIELD(scale_height).set_default(1.0f).set_lower_bound(0.0f)
+    .describe("Ratio of the output height to the input height, when height is 0.");
+    DMLC_DECLARE_FIELD(scale_width).set_default(1.0f).set_lower_bound(0.0f)
+    .describe("Ratio of the output width to the input width, when width is 0.");
+    DMLC_DECLARE_FIELD(sample_type)
+    .add_enum("nearest", resize::kNearest)
+    .add_enum("bilinear", resize::kBilinear)
+    .set_default(resize::kBilinear)
+    .describe("Interpolation method.");
+    DMLC_DECLARE_FIELD(align_corners).set_default(false)
+    .describe("Map the corner pixels of the input and the output onto each other, "
+    "rather than the corners of their grids. Only used by bilinear sample_type.");
+  }
+};
+
+/*! \brief how the outputs of one axis map to the inputs */
+struct ResizeAxis {
+  int in_size;
+  float ratio;
+  bool align_corners;
+
+  ResizeAxis(const int in, const int out, const bool align) {
+    in_size = in;
+    align_corners = align;
+    if (align) {
+      ratio = out > 1 ? static_cast<float>(in - 1) / (out - 1) : 0.0f;
+    } else {
+      ratio = static_cast<float>(in) / out;
+    }
+  }
+  /*! \brief the input of output o for nearest interpolation */
+  MSHADOW_XINLINE int Nearest(const int o) const {
+    const int i = static_cast<int>(o * ratio);
+    return i < in_size - 1 ? i : in_size - 1;
+  }
+  /*! \brief the two inputs of output o for bilinear interpolation and the weight of i1 */
+  MSHADOW_XINLINE void Bilinear(const int o, int* i0, int* i1, float* lambda) const {
+    const float x = align_corners ? o * ratio : fmaxf((o + 0.5f) * ratio - 0.5f, 0.0f);
+    const int i = static_cast<int>(x);
+    if (i >= in_size - 1) {
+      *i0 = *i1 = in_size - 1;
+      *lambda = 0.0f;
+    } else {
+      *i0 = i;
+      *i1 = i + 1;
+      *lambda = x - i;
+    }
+  }
+};
+
+/*! \brief one thread for each output, a row of outputs reads neighbouring inputs */
+struct resize_forward {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const DType* data, const int in_w,
+                                  const int out_h, const int out_w, const ResizeAxis ay,
+                                  const ResizeAxis ax, const int sample_type,
+                                  const OpReqType req) {
+    const int ox = i % out_w;
+    const int oy = (i / out_w) % out_h;
+    const DType* in = data + static_cast<size_t>(i / out_w / out_h) * ay.in_size * in_w;
+    if (sample_type == resize::kNearest) {
+      KERNEL_ASSIGN(out[i], req, in[ay.Nearest(oy) * in_w + ax.Nearest(ox)]);
+      return;
+    }
+    int y0, y1, x0, x1;
+    float ly, lx;
+    ay.Bilinear(oy, &y0, &y1, &ly);
+    ax.Bilinear(ox, &x0, &x1, &lx);
+    const DType* top = in + y0 * in_w;
+    const DType* bottom = in + y1 * in_w;
+    const float v =
+        (1.0f - ly) * ((1.0f - lx) * static_cast<float>(top[x0]) +
+                       lx * static_cast<float>(top[x1])) +
+        ly * ((1.0f - lx) * static_cast<float>(bottom[x0]) +
+              lx * static_cast<float>(bottom[x1]));
+    KERNEL_ASSIGN(out[i], req, static_cast<DType>(v));
+  }
+};
+
+/*! \brief the sizes of a resize, from the images of shape (num, channels, in_h, in_w) */
+struct ResizeShape {
+  int planes, in_h, in_w, out_h, out_w;
+};
+
+template<typename DType>
+void ResizeForward(mshadow::Stream<cpu>* s, const DType* data, const ResizeShape& shape,
+                   const ResizeParam& param, const OpReqType req, DType* out);
+
+template<typename DType>
+void ResizeForward(mshadow::Stream<gpu>* s, const DType* data, const ResizeShape& shape,
+                   const ResizeParam& param, const OpReqType req, DType* out);
+
+/*! \brief grad_data += the gradient of the resize */
+template<typename DType>
+void ResizeBackwardAcc(mshadow::Stream<cpu>* s, const DType* grad_out, const ResizeShape& shape,
+                       const ResizeParam& param, DType* grad_data);
+
+template<typename DType>
+void ResizeBackwardAcc(mshadow::Stream<gpu>* s, const DType* grad_out, const ResizeShape& shape,
+                       const ResizeParam& param, DType* grad_data);
+
+inline bool ResizeInferShape(const nnvm::NodeAttrs& attrs,
+                             std::vector<TShape>* in_attrs,
+                             std::vector<TShape>* out_attrs) {
+  const ResizeParam& param = nnvm::get<ResizeParam>(attrs.parsed);
+  CHECK_EQ(in_attrs->size(), 1U);
+  CHECK_EQ(out_attrs->size(), 1U);
+  const TShape& dshape = in_attrs->at(resize::kData);
+  if (dshape.ndim() == 0) return false;
+  CHECK_EQ(dshape.ndim(), 4U) << "Resize2D: data should be 4D in (batch, channel, y, x)";
+  TShape oshape = dshape;
+  oshape[2] = param.height > 0 ? param.height
+                               : static_cast<int>(dshape[2] * param.scale_height);
+  oshape[3] = param.width > 0 ? param.width
+                              : static_cast<int>(dshape[3] * param.scale_width);
+  CHECK(oshape[2] > 0 && oshape[3] > 0) << "Resize2D: the output is empty, " << oshape;
+  SHAPE_ASSIGN_CHECK(*out_attrs, resize::kOut, oshape);
+  return true;
+}
+
+inline ResizeShape GetResizeShape(const TShape& dshape, const TShape& oshape) {
+  ResizeShape shape;
+  shape.planes = dshape[0] * dshape[1];
+  shape.in_h = dshape[2];
+  shape.in_w = dshape[3];
+  shape.out_h = oshape[2];
+  shape.out_w = oshape[3];
+  return shape;
+}
+
+template<typename xpu>
+void ResizeForwardCompute(const nnvm::NodeAttrs& attrs,
+                          const OpContext& ctx,
+                          const std::vector<TBlob>& inputs,
+                          const std::vector<OpReqType>& req,
+                          const std::vector<TBlob>& outputs) {
+  const ResizeParam& param = nnvm::get<ResizeParam>(attrs.parsed);
+  CHECK_EQ(inputs.size(), 1U);
+  CHECK_EQ(outputs.size(), 1U);
+  CHECK_NE(req[resize::kOut], kWriteInplace) << "Resize2D does not support kWriteInplace";
+  if (req[resize::kOut] == kNullOp) return;
+  mshadow::Stream<xpu>* s = ctx.get_stream<xpu>();
+  const ResizeShape shape = GetResizeShape(inputs[resize::kData].shape_,
+                                           outputs[resize::kOut].shape_);
+  MSHADOW_REAL_TYPE_SWITCH(outputs[resize::kOut].type_flag_, DType, {
+    ResizeForward(s, inputs[resize::kData].dptr<DType>(), shape, param, req[resize::kOut],
+                  outputs[resize::kOut].dptr<DType>());
+  });
+}
+
+/*! \brief the input is the gradient of the output */
+template<typename xpu>
+void ResizeBackwardCompute(const nnvm::NodeAttrs& attrs,
+                           const OpContext& ctx,
+                           const std::vector<TBlob>& inputs,
+                           const std::vector<OpReqType>& req,
+                           const std::vector<TBlob>& outputs) {
+  using namespace mxnet_op;
+  const ResizeParam& param = nnvm::get<ResizeParam>(attrs.parsed);
+  CHECK_EQ(inputs.size(), 1U);
+  CHECK_EQ(outputs.size(), 1U);
+  CHECK_NE(req[resize::kData], kWriteInplace)
+    << "Resize2D: Backward doesn't support kWriteInplace.";
+  if (req[resize::kData] == kNullOp) return;
+  mshadow::Stream<xpu>* s = ctx.get_stream<xpu>();
+  const TBlob& grad_data = outputs[resize::kData];
+  const ResizeShape shape = GetResizeShape(grad_data.shape_, inputs[resize::kOut].shape_);
+  MSHADOW_REAL_TYPE_SWITCH(grad_data.type_flag_, DType, {
+    if (req[resize::kData] == kWriteTo) {
+      Kernel<set_zero, xpu>::Launch(s, grad_data.Size(), grad_data.dptr<DType>());
+    }
+    ResizeBackwardAcc(s, inputs[resize::kOut].dptr<DType>(), shape, param,
+                      grad_data.dptr<DType>());
+  });
+}
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CONTRIB_RESIZE_INL_H_
@@ -0,0 +1,167 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file resize.cc
+ * \brief resizes the height and width of images by bilinear or nearest interpolation
+ */
+#include "./resize-inl.h"
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+namespace mxnet {
+namespace op {
+
+/*! \brief keys the OpenMP grain of the cpu resize */
+struct ResizeCPUGrain {};
+
+/*! \brief the inputs and the weights of the outputs of one axis, shared by all the planes */
+struct ResizeTable {
+  std::vector<int> i0, i1;
+  std::vector<float> lambda;
+
+  ResizeTable(const ResizeAxis& axis, const int out, const int sample_type)
+    : i0(out), i1(out), lambda(out, 0.0f) {
+    for (int o = 0; o < out; ++o) {
+      if (sample_type == resize::kNearest) {
+        i0[o] = i1[o] = axis.Nearest(o);
+      } else {
+        axis.Bilinear(o, &i0[o], &i1[o], &lambda[o]);
+      }
+    }
+  }
+};
+
+inline int ResizeNumThreads(const int ntask, const size_t work) {
+  const int nthread = mxnet_op::KernelNumThreads(
+      static_cast<int>(std::min<size_t>(work, INT_MAX)),
+      mxnet_op::KernelGrain<ResizeCPUGrain>::Get());
+  return std::min(nthread, ntask);
+}
+
+template<typename DType>
+void ResizeForward(mshadow::Stream<cpu>* s, const DType* data, const ResizeShape& shape,
+                   const ResizeParam& param, const OpReqType req, DType* out) {
+  const ResizeTable ty(ResizeAxis(shape.in_h, shape.out_h, param.align_corners), shape.out_h,
+                       param.sample_type);
+  const ResizeTable tx(ResizeAxis(shape.in_w, shape.out_w, param.align_corners), shape.out_w,
+                       param.sample_type);
+  const int* x0 = tx.i0.data();
+  const int* x1 = tx.i1.data();
+  const float* lx = tx.lambda.data();
+  const int nrow = shape.planes * shape.out_h;
+  const int nthread = ResizeNumThreads(nrow, static_cast<size_t>(nrow) * shape.out_w);
+  // each output row interpolates two input rows with the column tables, so
+  // that the inner loop has no integer division
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int r = 0; r < nrow; ++r) {
+    const int oy = r % shape.out_h;
+    const DType* in = data + static_cast<size_t>(r / shape.out_h) * shape.in_h * shape.in_w;
+    const DType* top = in + ty.i0[oy] * shape.in_w;
+    const DType* bottom = in + ty.i1[oy] * shape.in_w;
+    DType* out_row = out + static_cast<size_t>(r) * shape.out_w;
+    if (param.sample_type == resize::kNearest) {
+      for (int ox = 0; ox < shape.out_w; ++ox) {
+        KERNEL_ASSIGN(out_row[ox], req, top[x0[ox]]);
+      }
+      continue;
+    }
+    const float ly = ty.lambda[oy];
+    for (int ox = 0; ox < shape.out_w; ++ox) {
+      const float t = static_cast<float>(top[x0[ox]]) +
+                      lx[ox] * (static_cast<float>(top[x1[ox]]) -
+                                static_cast<float>(top[x0[ox]]));
+      const float b = static_cast<float>(bottom[x0[ox]]) +
+                      lx[ox] * (static_cast<float>(bottom[x1[ox]]) -
+                                static_cast<float>(bottom[x0[ox]]));
+      KERNEL_ASSIGN(out_row[ox], req, static_cast<DType>(t + ly * (b - t)));
+    }
+  }
+}
+
+template<typename DType>
+void ResizeBackwardAcc(mshadow::Stream<cpu>* s, const DType* grad_out, const ResizeShape& shape,
+                       const ResizeParam& param, DType* grad_data) {
+  const ResizeTable ty(ResizeAxis(shape.in_h, shape.out_h, param.align_corners), shape.out_h,
+                       param.sample_type);
+  const ResizeTable tx(ResizeAxis(shape.in_w, shape.out_w, param.align_corners), shape.out_w,
+                       param.sample_type);
+  const size_t in_plane = static_cast<size_t>(shape.in_h) * shape.in_w;
+  const size_t out_plane = static_cast<size_t>(shape.out_h) * shape.out_w;
+  const int nthread = ResizeNumThreads(shape.planes, shape.planes * out_plane);
+  // the outputs of a plane scatter to overlapping inputs, the threads split the planes
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < shape.planes; ++p) {
+    DType* in = grad_data + p * in_plane;
+    const DType* grad = grad_out + p * out_plane;
+    for (int oy = 0; oy < shape.out_h; ++oy) {
+      DType* top = in + ty.i0[oy] * shape.in_w;
+      DType* bottom = in + ty.i1[oy] * shape.in_w;
+      const float ly = ty.lambda[oy];
+      const DType* grad_row = grad + oy * shape.out_w;
+      for (int ox = 0; ox < shape.out_w; ++ox) {
+        const float g = static_cast<float>(grad_row[ox]);
+        const float lx = tx.lambda[ox];
+        top[tx.i0[ox]] += static_cast<DType>((1.0f - ly) * (1.0f - lx) * g);
+        top[tx.i1[ox]] += static_cast<DType>((1.0f - ly) * lx * g);
+        bottom[tx.i0[ox]] += static_cast<DType>(ly * (1.0f - lx) * g);
+        bottom[tx.i1[ox]] += static_cast<DType>(ly * lx * g);
+      }
+    }
+  }
+}
+
+DMLC_REGISTER_PARAMETER(ResizeParam);
+
+NNVM_REGISTER_OP(_contrib_Resize2D)
+.describe(R"code(Resizes the height and width of images by bilinear or nearest interpolation.
+
+The input is of shape (batch, channel, height, width). The output size is set by
+``height`` and ``width``, or by the input size times ``scale_height`` and
+``scale_width``.
+
+Bilinear interpolation samples the input at the centers of the output pixels,
+``(o + 0.5) * in / out - 0.5``, or with ``align_corners`` at ``o * (in - 1) / (out - 1)``.
+Nearest interpolation takes the input ``floor(o * in / out)``, which is what
+``UpSampling`` with ``sample_type=nearest`` does for integer scales.
+)code" ADD_FILELINE)
+.set_num_inputs(1)
+.set_num_outputs(1)
+.set_attr_parser(ParamParser<ResizeParam>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::string>{"data"};
+  })
+.set_attr<nnvm::FInferShape>("FInferShape", ResizeInferShape)
+.set_attr<nnvm::FInferType>("FInferType", ElemwiseType<1, 1>)
+.set_attr<FCompute>("FCompute<cpu>", ResizeForwardCompute<cpu>)
+.set_attr<nnvm::FGradient>("FGradient", ElemwiseGradUseNone{"_backward_contrib_Resize2D"})
+.add_argument("data", "NDArray-or-Symbol", "Input images, a 4D tensor")
+.add_arguments(ResizeParam::__FIELDS__());
+
+NNVM_REGISTER_OP(_backward_contrib_Resize2D)
+.set_num_inputs(1)
+.set_num_outputs(1)
+.set_attr<nnvm::TIsBackward>("TIsBackward", true)
+.set_attr_parser(ParamParser<ResizeParam>)
+.set_attr<FCompute>("FCompute<cpu>", ResizeBackwardCompute<cpu>);
+
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,92 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file resize.cu
+ * \brief resizes the height and width of images by bilinear or nearest interpolation
+ */
+#include "./resize-inl.h"
+#include "../../common/cuda_utils.h"
+
+namespace mxnet {
+namespace op {
+
+/*!
+ * \brief one thread for each output gradient. Neighbouring outputs share
+ *  inputs, so the scatter is atomic
+ */
+template<typename DType>
+__global__ void ResizeBackwardAccKernel(const int count, const DType* grad_out, const int in_w,
+                                        const int out_h, const int out_w, const ResizeAxis ay,
+                                        const ResizeAxis ax, const int sample_type,
+                                        DType* grad_data) {
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < count;
+       i += blockDim.x * gridDim.x) {
+    const int ox = i % out_w;
+    const int oy = (i / out_w) % out_h;
+    DType* in = grad_data + static_cast<size_t>(i / out_w / out_h) * ay.in_size * in_w;
+    const float g = static_cast<float>(grad_out[i]);
+    if (sample_type == resize::kNearest) {
+      atomicAdd(in + ay.Nearest(oy) * in_w + ax.Nearest(ox), grad_out[i]);
+      continue;
+    }
+    int y0, y1, x0, x1;
+    float ly, lx;
+    ay.Bilinear(oy, &y0, &y1, &ly);
+    ax.Bilinear(ox, &x0, &x1, &lx);
+    atomicAdd(in + y0 * in_w + x0, static_cast<DType>((1.0f - ly) * (1.0f - lx) * g));
+    atomicAdd(in + y0 * in_w + x1, static_cast<DType>((1.0f - ly) * lx * g));
+    atomicAdd(in + y1 * in_w + x0, static_cast<DType>(ly * (1.0f - lx) * g));
+    atomicAdd(in + y1 * in_w + x1, static_cast<DType>(ly * lx * g));
+  }
+}
+
+template<typename DType>
+void ResizeForward(mshadow::Stream<gpu>* s, const DType* data, const ResizeShape& shape,
+                   const ResizeParam& param, const OpReqType req, DType* out) {
+  const int count = shape.planes * shape.out_h * shape.out_w;
+  if (count == 0) return;
+  mxnet_op::Kernel<resize_forward, gpu>::Launch(
+      s, count, out, data, shape.in_w, shape.out_h, shape.out_w,
+      ResizeAxis(shape.in_h, shape.out_h, param.align_corners),
+      ResizeAxis(shape.in_w, shape.out_w, param.align_corners), param.sample_type, req);
+}
+
+template<typename DType>
+void ResizeBackwardAcc(mshadow::Stream<gpu>* s, const DType* grad_out, const ResizeShape& shape,
+                       const ResizeParam& param, DType* grad_data) {
+  const int count = shape.planes * shape.out_h * shape.out_w;
+  if (count == 0) return;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  ResizeBackwardAccKernel<DType>
+    <<<mxnet_op::cuda_get_num_blocks(count), mshadow::cuda::kBaseThreadNum, 0, stream>>>(
+      count, grad_out, shape.in_w, shape.out_h, shape.out_w,
+      ResizeAxis(shape.in_h, shape.out_h, param.align_corners),
+      ResizeAxis(shape.in_w, shape.out_w, param.align_corners), param.sample_type, grad_data);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(ResizeBackwardAccKernel);
+}
+
+NNVM_REGISTER_OP(_contrib_Resize2D)
+.set_attr<FCompute>("FCompute<gpu>", ResizeForwardCompute<gpu>);
+
+NNVM_REGISTER_OP(_backward_contrib_Resize2D)
+.set_attr<FCompute>("FCompute<gpu>", ResizeBackwardCompute<gpu>);
+
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,232 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file roi_align-inl.h
+ * \brief region of interest align operator
+ *
+ * Each ROI is split in pooled_size bins, and each bin is the average of the
+ * bilinear interpolations of the feature map at a grid of points in the
+ * bin, without rounding the coordinates of the ROI or of the bins.
+ */
+#ifndef MXNET_OPERATOR_CONTRIB_ROI_ALIGN_INL_H_
+#define MXNET_OPERATOR_CONTRIB_ROI_ALIGN_INL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/operator_util.h>
+#include <cmath>
+#include <vector>
+#include "../mshadow_op.h"
+#include "../mxnet_op.h"
+#include "../operator_common.h"
+#include "../elemwise_op_common.h"
+
+namespace mxnet {
+namespace op {
+
+namespace roialign {
+enum ROIAlignOpInputs {kData, kBox};
+enum ROIAlignOpOutputs {kOut};
+}  // namespace roialign
+
+struct ROIAlignParam : public dmlc::Parameter<ROIAlignParam> {
+  TShape pooled_size;
+  float spatial_scale;
+  int sample_ratio;
+  DMLC_DECLARE_PARAMETER(ROIAlignParam) {
+    DMLC_DECLARE_FIELD(pooled_size)
+    .set_expect_ndim(2).enforce_nonzero()
+    .describe("ROI Align output roi feature map height and width: (h, w)");
+    DMLC_DECLARE_FIELD(spatial_scale).set_range(0.0, 1.0)
+    .describe("Ratio of input feature map height (or w) to raw image height (or w). "
+    "Equals the reciprocal of total stride in convolutional layers");
+    DMLC_DECLARE_FIELD(sample_ratio).set_default(-1)
+    .describe("Number of sampling points along each axis of a bin. "
+    "A value of 0 or less takes ceil(bin size) points, as many as the bin covers.");
+  }
+};
+
+/*! \brief the bins of a roi, in the coordinates of the feature map */
+struct ROIAlignBox {
+  int batch;
+  float y0, x0;
+  float bin_h, bin_w;
+  /*! \brief sampling points of a bin along each axis */
+  int grid_h, grid_w;
+
+  template<typename DType>
+  MSHADOW_XINLINE ROIAlignBox(const DType* roi, const float spatial_scale,
+                              const int pooled_h, const int pooled_w, const int sample_ratio) {
+    batch = static_cast<int>(roi[0]);
+    x0 = static_cast<float>(roi[1]) * spatial_scale;
+    y0 = static_cast<float>(roi[2]) * spatial_scale;
+    // malformed rois are forced to be at least 1x1
+    const float roi_w = fmaxf(static_cast<float>(roi[3]) * spatial_scale - x0, 1.0f);
+    const float roi_h = fmaxf(static_cast<float>(roi[4]) * spatial_scale - y0, 1.0f);
+    bin_h = roi_h / pooled_h;
+    bin_w = roi_w / pooled_w;
+    grid_h = sample_ratio > 0 ? sample_ratio : static_cast<int>(ceilf(bin_h));
+    grid_w = sample_ratio > 0 ? sample_ratio : static_cast<int>(ceilf(bin_w));
+  }
+  /*! \brief the iy-th sampling row of the bins of row ph */
+  MSHADOW_XINLINE float y(const int ph, const int iy) const {
+    return y0 + ph * bin_h + (iy + 0.5f) * bin_h / grid_h;
+  }
+  /*! \brief the ix-th sampling column of the bins of column pw */
+  MSHADOW_XINLINE float x(const int pw, const int ix) const {
+    return x0 + pw * bin_w + (ix + 0.5f) * bin_w / grid_w;
+  }
+};
+
+/*!
+ * \brief the offsets in a plane of height x width of the four neighbours of
+ *  (y, x) and their bilinear weights
+ * \return false for a point out of the plane, which counts as 0
+ */
+MSHADOW_XINLINE bool ROIAlignBilinear(float y, float x, const int height, const int width,
+                                      int* pos, float* w) {
+  if (y < -1.0f || y > height || x < -1.0f || x > width) return false;
+  y = fmaxf(y, 0.0f);
+  x = fmaxf(x, 0.0f);
+  int y_low = static_cast<int>(y), x_low = static_cast<int>(x);
+  int y_high, x_high;
+  if (y_low >= height - 1) {
+    y_high = y_low = height - 1;
+    y = static_cast<float>(y_low);
+  } else {
+    y_high = y_low + 1;
+  }
+  if (x_low >= width - 1) {
+    x_high = x_low = width - 1;
+    x = static_cast<float>(x_low);
+  } else {
+    x_high = x_low + 1;
+  }
+  const float ly = y - y_low, lx = x - x_low;
+  const float hy = 1.0f - ly, hx = 1.0f - lx;
+  pos[0] = y_low * width + x_low;
+  pos[1] = y_low * width + x_high;
+  pos[2] = y_high * width + x_low;
+  pos[3] = y_high * width + x_high;
+  w[0] = hy * hx;
+  w[1] = hy * lx;
+  w[2] = ly * hx;
+  w[3] = ly * lx;
+  return true;
+}
+
+template<typename DType>
+void ROIAlignForward(mshadow::Stream<cpu>* s, const DType* data, const DType* rois,
+                     const int num_rois, const int channels, const int height, const int width,
+                     const ROIAlignParam& param, DType* out);
+
+template<typename DType>
+void ROIAlignForward(mshadow::Stream<gpu>* s, const DType* data, const DType* rois,
+                     const int num_rois, const int channels, const int height, const int width,
+                     const ROIAlignParam& param, DType* out);
+
+/*! \brief grad_data += the gradient of the rois */
+template<typename DType>
+void ROIAlignBackwardAcc(mshadow::Stream<cpu>* s, const DType* grad_out, const DType* rois,
+                         const int num_rois, const int channels, const int height,
+                         const int width, const ROIAlignParam& param, DType* grad_data);
+
+template<typename DType>
+void ROIAlignBackwardAcc(mshadow::Stream<gpu>* s, const DType* grad_out, const DType* rois,
+                         const int num_rois, const int channels, const int height,
+                         const int width, const ROIAlignParam& param, DType* grad_data);
+
+inline bool ROIAlignShape(const nnvm::NodeAttrs& attrs,
+                          std::vector<TShape>* in_attrs,
+                          std::vector<TShape>* out_attrs) {
+  const ROIAlignParam& param = nnvm::get<ROIAlignParam>(attrs.parsed);
+  CHECK_EQ(in_attrs->size(), 2U) << "Input:[data, rois]";
+  CHECK_EQ(out_attrs->size(), 1U);
+  const TShape& dshape = in_attrs->at(roialign::kData);
+  const TShape& bshape = in_attrs->at(roialign::kBox);
+  if (dshape.ndim() == 0 || bshape.ndim() == 0) return false;
+  CHECK_EQ(dshape.ndim(), 4U) << "data should be a 4D tensor";
+  CHECK_EQ(bshape.ndim(), 2U) << "rois should be a 2D tensor of shape [num_rois, 5]";
+  CHECK_EQ(bshape[1], 5U) << "rois should be a 2D tensor of shape [num_rois, 5]";
+  // out: [num_rois, c, pooled_h, pooled_w]
+  SHAPE_ASSIGN_CHECK(*out_attrs, roialign::kOut,
+                     mshadow::Shape4(bshape[0], dshape[1], param.pooled_size[0],
+                                     param.pooled_size[1]));
+  return true;
+}
+
+template<typename xpu>
+void ROIAlignForwardCompute(const nnvm::NodeAttrs& attrs,
+                            const OpContext& ctx,
+                            const std::vector<TBlob>& inputs,
+                            const std::vector<OpReqType>& req,
+                            const std::vector<TBlob>& outputs) {
+  const ROIAlignParam& param = nnvm::get<ROIAlignParam>(attrs.parsed);
+  CHECK_EQ(inputs.size(), 2U);
+  CHECK_EQ(outputs.size(), 1U);
+  CHECK_NE(req[roialign::kOut], kAddTo) << "ROIAlign does not support kAddTo";
+  if (req[roialign::kOut] == kNullOp) return;
+  mshadow::Stream<xpu>* s = ctx.get_stream<xpu>();
+  const TShape& dshape = inputs[roialign::kData].shape_;
+  MSHADOW_REAL_TYPE_SWITCH(outputs[roialign::kOut].type_flag_, DType, {
+    ROIAlignForward(s, inputs[roialign::kData].dptr<DType>(),
+                    inputs[roialign::kBox].dptr<DType>(),
+                    inputs[roialign::kBox].shape_[0], dshape[1], dshape[2], dshape[3],
+                    param, outputs[roialign::kOut].dptr<DType>());
+  });
+}
+
+/*! \brief the inputs are the gradient of the output and the rois */
+template<typename xpu>
+void ROIAlignBackwardCompute(const nnvm::NodeAttrs& attrs,
+                             const OpContext& ctx,
+                             const std::vector<TBlob>& inputs,
+                             const std::vector<OpReqType>& req,
+                             const std::vector<TBlob>& outputs) {
+  using namespace mxnet_op;
+  const ROIAlignParam& param = nnvm::get<ROIAlignParam>(attrs.parsed);
+  CHECK_EQ(inputs.size(), 2U);
+  CHECK_EQ(outputs.size(), 2U);
+  CHECK_NE(req[roialign::kData], kWriteInplace)
+    << "ROIAlign: Backward doesn't support kWriteInplace.";
+  CHECK_NE(req[roialign::kBox], kWriteInplace)
+    << "ROIAlign: Backward doesn't support kWriteInplace.";
+  mshadow::Stream<xpu>* s = ctx.get_stream<xpu>();
+  const TBlob& grad_data = outputs[roialign::kData];
+  const TBlob& grad_rois = outputs[roialign::kBox];
+  MSHADOW_REAL_TYPE_SWITCH(grad_data.type_flag_, DType, {
+    if (req[roialign::kData] == kWriteTo) {
+      Kernel<set_zero, xpu>::Launch(s, grad_data.Size(), grad_data.dptr<DType>());
+    }
+    if (req[roialign::kData] == kWriteTo || req[roialign::kData] == kAddTo) {
+      ROIAlignBackwardAcc(s, inputs[0].dptr<DType>(), inputs[1].dptr<DType>(),
+                          inputs[1].shape_[0], grad_data.shape_[1], grad_data.shape_[2],
+                          grad_data.shape_[3], param, grad_data.dptr<DType>());
+    }
+    // the rois get no gradient
+    if (req[roialign::kBox] == kWriteTo) {
+      Kernel<set_zero, xpu>::Launch(s, grad_rois.Size(), grad_rois.dptr<DType>());
+    }
+  });
+}
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CONTRIB_ROI_ALIGN_INL_H_
@@ -0,0 +1,187 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file roi_align.cc
+ * \brief region of interest align operator
+ */
+#include "./roi_align-inl.h"
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+namespace mxnet {
+namespace op {
+
+/*! \brief keys the OpenMP grain of the cpu roi align */
+struct ROIAlignCPUGrain {};
+
+/*!
+ * \brief the neighbours and the weights of the samples of each bin of a roi,
+ *  which all its channels share, 4 for each sample of each bin in turn
+ */
+inline void ROIAlignSamples(const ROIAlignBox& box, const int height, const int width,
+                            const int pooled_h, const int pooled_w,
+                            std::vector<int>* pos, std::vector<float>* w) {
+  const int count = box.grid_h * box.grid_w;
+  pos->resize(static_cast<size_t>(pooled_h) * pooled_w * count * 4);
+  w->resize(pos->size());
+  size_t k = 0;
+  for (int ph = 0; ph < pooled_h; ++ph) {
+    for (int pw = 0; pw < pooled_w; ++pw) {
+      for (int iy = 0; iy < box.grid_h; ++iy) {
+        const float y = box.y(ph, iy);
+        for (int ix = 0; ix < box.grid_w; ++ix, k += 4) {
+          if (!ROIAlignBilinear(y, box.x(pw, ix), height, width, &(*pos)[k], &(*w)[k])) {
+            std::fill(pos->begin() + k, pos->begin() + k + 4, 0);
+            std::fill(w->begin() + k, w->begin() + k + 4, 0.0f);
+          }
+        }
+      }
+    }
+  }
+}
+
+inline int ROIAlignNumThreads(const int ntask, const size_t work) {
+  const int nthread = mxnet_op::KernelNumThreads(
+      static_cast<int>(std::min<size_t>(work, INT_MAX)),
+      mxnet_op::KernelGrain<ROIAlignCPUGrain>::Get());
+  return std::min(nthread, ntask);
+}
+
+template<typename DType>
+void ROIAlignForward(mshadow::Stream<cpu>* s, const DType* data, const DType* rois,
+                     const int num_rois, const int channels, const int height, const int width,
+                     const ROIAlignParam& param, DType* out) {
+  const int pooled_h = param.pooled_size[0], pooled_w = param.pooled_size[1];
+  const int nbin = pooled_h * pooled_w;
+  const size_t plane = static_cast<size_t>(height) * width;
+  const int nthread = ROIAlignNumThreads(
+      num_rois, static_cast<size_t>(num_rois) * channels * nbin * 4);
+  // the rois are independent, and their sizes vary
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1) schedule(dynamic)
+  for (int n = 0; n < num_rois; ++n) {
+    const ROIAlignBox box(rois + n * 5, param.spatial_scale, pooled_h, pooled_w,
+                          param.sample_ratio);
+    std::vector<int> pos;
+    std::vector<float> w;
+    ROIAlignSamples(box, height, width, pooled_h, pooled_w, &pos, &w);
+    const int taps = box.grid_h * box.grid_w * 4;
+    const float scale = 1.0f / (box.grid_h * box.grid_w);
+    DType* out_n = out + static_cast<size_t>(n) * channels * nbin;
+    for (int c = 0; c < channels; ++c) {
+      const DType* in_c = data + (static_cast<size_t>(box.batch) * channels + c) * plane;
+      for (int b = 0; b < nbin; ++b) {
+        const int* p = &pos[static_cast<size_t>(b) * taps];
+        const float* wb = &w[static_cast<size_t>(b) * taps];
+        float sum = 0.0f;
+        for (int k = 0; k < taps; ++k) sum += wb[k] * static_cast<float>(in_c[p[k]]);
+        out_n[c * nbin + b] = static_cast<DType>(sum * scale);
+      }
+    }
+  }
+}
+
+template<typename DType>
+void ROIAlignBackwardAcc(mshadow::Stream<cpu>* s, const DType* grad_out, const DType* rois,
+                         const int num_rois, const int channels, const int height,
+                         const int width, const ROIAlignParam& param, DType* grad_data) {
+  const int pooled_h = param.pooled_size[0], pooled_w = param.pooled_size[1];
+  const int nbin = pooled_h * pooled_w;
+  const size_t plane = static_cast<size_t>(height) * width;
+  const int nthread = ROIAlignNumThreads(
+      channels, static_cast<size_t>(num_rois) * channels * nbin * 4);
+  // the rois of an image overlap, so the threads split the channels, whose
+  // planes are disjoint; every thread gets the same channels for each roi
+  #pragma omp parallel num_threads(nthread) if (nthread > 1)
+  {
+    std::vector<int> pos;
+    std::vector<float> w;
+    for (int n = 0; n < num_rois; ++n) {
+      const ROIAlignBox box(rois + n * 5, param.spatial_scale, pooled_h, pooled_w,
+                            param.sample_ratio);
+      ROIAlignSamples(box, height, width, pooled_h, pooled_w, &pos, &w);
+      const int taps = box.grid_h * box.grid_w * 4;
+      const float scale = 1.0f / (box.grid_h * box.grid_w);
+      const DType* grad_n = grad_out + static_cast<size_t>(n) * channels * nbin;
+      #pragma omp for schedule(static) nowait
+      for (int c = 0; c < channels; ++c) {
+        DType* in_c = grad_data + (static_cast<size_t>(box.batch) * channels + c) * plane;
+        for (int b = 0; b < nbin; ++b) {
+          const float g = static_cast<float>(grad_n[c * nbin + b]) * scale;
+          const int* p = &pos[static_cast<size_t>(b) * taps];
+          const float* wb = &w[static_cast<size_t>(b) * taps];
+          for (int k = 0; k < taps; ++k) {
+            in_c[p[k]] += static_cast<DType>(wb[k] * g);
+          }
+        }
+      }
+    }
+  }
+}
+
+DMLC_REGISTER_PARAMETER(ROIAlignParam);
+
+NNVM_REGISTER_OP(_contrib_ROIAlign)
+.describe(R"code(Performs Region of Interest (ROI) Align on the input, as in Mask R-CNN.
+
+Each region of interest is split in ``pooled_size`` bins, without rounding
+its coordinates or the bins' to the cells of the feature map, and each bin
+is the average of the bilinear interpolations of the feature map at
+``sample_ratio`` x ``sample_ratio`` evenly spaced points in the bin.
+
+The output is of shape (num_rois, channels, pooled_size[0], pooled_size[1]),
+and the rois get no gradient.
+)code" ADD_FILELINE)
+.set_num_inputs(2)
+.set_num_outputs(1)
+.set_attr_parser(ParamParser<ROIAlignParam>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::string>{"data", "rois"};
+  })
+.set_attr<nnvm::FListOutputNames>("FListOutputNames",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::string>{"output"};
+  })
+.set_attr<nnvm::FInferShape>("FInferShape", ROIAlignShape)
+.set_attr<nnvm::FInferType>("FInferType", ElemwiseType<2, 1>)
+.set_attr<FCompute>("FCompute<cpu>", ROIAlignForwardCompute<cpu>)
+.set_attr<nnvm::FGradient>("FGradient",
+  [](const nnvm::NodePtr& n, const std::vector<nnvm::NodeEntry>& ograds) {
+    // the data is not read, its gradient takes its shape from the forward node
+    std::vector<nnvm::NodeEntry> heads = {ograds[roialign::kOut], n->inputs[roialign::kBox]};
+    return MakeGradNode("_backward_contrib_ROIAlign", n, heads, n->attrs.dict);
+  })
+.add_argument("data", "NDArray-or-Symbol", "Input data to the pooling operator, a 4D Feature maps")
+.add_argument("rois", "NDArray-or-Symbol", "Bounding box coordinates, a 2D array of "
+"[[batch_index, x1, y1, x2, y2]], where (x1, y1) and (x2, y2) are top left and bottom right "
+"corners of designated region of interest. `batch_index` indicates the index of "
+"corresponding image in the input array")
+.add_arguments(ROIAlignParam::__FIELDS__());
+
+NNVM_REGISTER_OP(_backward_contrib_ROIAlign)
+.set_num_inputs(2)
+.set_num_outputs(2)
+.set_attr<nnvm::TIsBackward>("TIsBackward", true)
+.set_attr_parser(ParamParser<ROIAlignParam>)
+.set_attr<FCompute>("FCompute<cpu>", ROIAlignBackwardCompute<cpu>);
+
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,131 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file roi_align.cu
+ * \brief region of interest align operator
+ */
+#include "./roi_align-inl.h"
+#include "../../common/cuda_utils.h"
+
+namespace mxnet {
+namespace op {
+
+/*! \brief one thread for each output, (roi, channel, bin) */
+template<typename DType>
+__global__ void ROIAlignForwardKernel(const int count, const DType* data, const DType* rois,
+                                      const int channels, const int height, const int width,
+                                      const int pooled_h, const int pooled_w,
+                                      const float spatial_scale, const int sample_ratio,
+                                      DType* out) {
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < count;
+       i += blockDim.x * gridDim.x) {
+    const int pw = i % pooled_w;
+    const int ph = (i / pooled_w) % pooled_h;
+    const int c = (i / pooled_w / pooled_h) % channels;
+    const int n = i / pooled_w / pooled_h / channels;
+    const ROIAlignBox box(rois + n * 5, spatial_scale, pooled_h, pooled_w, sample_ratio);
+    const DType* in_c = data + (static_cast<size_t>(box.batch) * channels + c) * height * width;
+    int pos[4];
+    float w[4];
+    float sum = 0.0f;
+    for (int iy = 0; iy < box.grid_h; ++iy) {
+      const float y = box.y(ph, iy);
+      for (int ix = 0; ix < box.grid_w; ++ix) {
+        if (!ROIAlignBilinear(y, box.x(pw, ix), height, width, pos, w)) continue;
+        for (int k = 0; k < 4; ++k) sum += w[k] * static_cast<float>(in_c[pos[k]]);
+      }
+    }
+    out[i] = static_cast<DType>(sum / (box.grid_h * box.grid_w));
+  }
+}
+
+/*!
+ * \brief one thread for each output gradient. The bins of one roi do not
+ *  overlap but the rois of an image do, so the scatter is atomic
+ */
+template<typename DType>
+__global__ void ROIAlignBackwardAccKernel(const int count, const DType* grad_out,
+                                          const DType* rois, const int channels,
+                                          const int height, const int width,
+                                          const int pooled_h, const int pooled_w,
+                                          const float spatial_scale, const int sample_ratio,
+                                          DType* grad_data) {
+  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < count;
+       i += blockDim.x * gridDim.x) {
+    const int pw = i % pooled_w;
+    const int ph = (i / pooled_w) % pooled_h;
+    const int c = (i / pooled_w / pooled_h) % channels;
+    const int n = i / pooled_w / pooled_h / channels;
+    const ROIAlignBox box(rois + n * 5, spatial_scale, pooled_h, pooled_w, sample_ratio);
+    const float g = static_cast<float>(grad_out[i]) / (box.grid_h * box.grid_w);
+    if (g == 0.0f) continue;
+    DType* in_c = grad_data + (static_cast<size_t>(box.batch) * channels + c) * height * width;
+    int pos[4];
+    float w[4];
+    for (int iy = 0; iy < box.grid_h; ++iy) {
+      const float y = box.y(ph, iy);
+      for (int ix = 0; ix < box.grid_w; ++ix) {
+        if (!ROIAlignBilinear(y, box.x(pw, ix), height, width, pos, w)) continue;
+        for (int k = 0; k < 4; ++k) {
+          if (w[k] != 0.0f) atomicAdd(in_c + pos[k], static_cast<DType>(w[k] * g));
+        }
+      }
+    }
+  }
+}
+
+template<typename DType>
+void ROIAlignForward(mshadow::Stream<gpu>* s, const DType* data, const DType* rois,
+                     const int num_rois, const int channels, const int height, const int width,
+                     const ROIAlignParam& param, DType* out) {
+  const int pooled_h = param.pooled_size[0], pooled_w = param.pooled_size[1];
+  const int count = num_rois * channels * pooled_h * pooled_w;
+  if (count == 0) return;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  ROIAlignForwardKernel<DType>
+    <<<mxnet_op::cuda_get_num_blocks(count), mshadow::cuda::kBaseThreadNum, 0, stream>>>(
+      count, data, rois, channels, height, width, pooled_h, pooled_w,
+      param.spatial_scale, param.sample_ratio, out);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(ROIAlignForwardKernel);
+}
+
+template<typename DType>
+void ROIAlignBackwardAcc(mshadow::Stream<gpu>* s, const DType* grad_out, const DType* rois,
+                         const int num_rois, const int channels, const int height,
+                         const int width, const ROIAlignParam& param, DType* grad_data) {
+  const int pooled_h = param.pooled_size[0], pooled_w = param.pooled_size[1];
+  const int count = num_rois * channels * pooled_h * pooled_w;
+  if (count == 0) return;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  ROIAlignBackwardAccKernel<DType>
+    <<<mxnet_op::cuda_get_num_blocks(count), mshadow::cuda::kBaseThreadNum, 0, stream>>>(
+      count, grad_out, rois, channels, height, width, pooled_h, pooled_w,
+      param.spatial_scale, param.sample_ratio, grad_data);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(ROIAlignBackwardAccKernel);
+}
+
+NNVM_REGISTER_OP(_contrib_ROIAlign)
+.set_attr<FCompute>("FCompute<gpu>", ROIAlignForwardCompute<gpu>);
+
+NNVM_REGISTER_OP(_backward_contrib_ROIAlign)
+.set_attr<FCompute>("FCompute<gpu>", ROIAlignBackwardCompute<gpu>);
+
+}  // namespace op
+}  // namespace mxnet
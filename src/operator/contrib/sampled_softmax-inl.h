@@ -0,0 +1,453 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file sampled_softmax-inl.h
+ * \brief candidate sampling and the sampled softmax loss
+ *
+ * The candidate sampler draws one set of classes shared by the whole batch,
+ * and gives the log of the expected count of each drawn class and of each
+ * label. The sampled softmax loss of a row is the softmax cross entropy over
+ * its label and the shared samples, with the logits corrected by the log
+ * expected counts, and with the samples that hit the label of the row
+ * removed. Only the rows of the weight of these classes are read.
+ */
+#ifndef MXNET_OPERATOR_CONTRIB_SAMPLED_SOFTMAX_INL_H_
+#define MXNET_OPERATOR_CONTRIB_SAMPLED_SOFTMAX_INL_H_
+
+#include <dmlc/parameter.h>
+#include <mxnet/operator_util.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "../mshadow_op.h"
+#include "../mxnet_op.h"
+#include "../operator_common.h"
+#include "../elemwise_op_common.h"
+#include "../linalg.h"
+
+namespace mxnet {
+namespace op {
+
+namespace candidate_sampler {
+enum SamplerType {kLogUniform, kUnigram};
+}  // namespace candidate_sampler
+
+struct CandidateSamplerParam : public dmlc::Parameter<CandidateSamplerParam> {
+  int num_sampled;
+  int range_max;
+  int sampler;
+  DMLC_DECLARE_PARAMETER(CandidateSamplerParam) {
+    DMLC_DECLARE_FIELD(num_sampled)
+    .set_lower_bound(1)
+    .describe("Number of classes drawn for the whole batch.");
+    DMLC_DECLARE_FIELD(range_max)
+    .set_lower_bound(1)
+    .describe("Number of classes, the classes are 0 to range_max - 1.");
+    DMLC_DECLARE_FIELD(sampler)
+    .add_enum("log_uniform", candidate_sampler::kLogUniform)
+    .add_enum("unigram", candidate_sampler::kUnigram)
+    .set_default(candidate_sampler::kLogUniform)
+    .describe("The distribution of the samples. log_uniform is Zipfian, "
+              "P(k) = log((k + 2) / (k + 1)) / log(range_max + 1), for classes "
+              "sorted by decreasing frequency. unigram draws from the "
+              "distribution given as the second input.");
+  }
+};
+
+struct SampledSoftmaxParam : public dmlc::Parameter<SampledSoftmaxParam> {
+  bool remove_accidental_hits;
+  DMLC_DECLARE_PARAMETER(SampledSoftmaxParam) {
+    DMLC_DECLARE_FIELD(remove_accidental_hits)
+    .set_default(true)
+    .describe("Whether to leave out of the softmax of a row the samples "
+              "that are its label.");
+  }
+};
+
+/*! \brief log(num_sampled * P(k)) for the log-uniform distribution */
+MSHADOW_XINLINE float LogUniformLogCount(const int k, const int range_max,
+                                         const int num_sampled) {
+  return logf(num_sampled * log1pf(1.0f / (k + 1)) / logf(range_max + 1.0f));
+}
+
+/*! \brief draws class i, k = floor(exp(u * log(range_max + 1))) - 1 */
+struct log_uniform_sample {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* sampled, DType* log_count,
+                                  const float* uniform, const int range_max,
+                                  const int num_sampled) {
+    int k = static_cast<int>(expf(uniform[i] * logf(range_max + 1.0f))) - 1;
+    k = k < 0 ? 0 : (k < range_max ? k : range_max - 1);
+    sampled[i] = DType(k);
+    log_count[i] = DType(LogUniformLogCount(k, range_max, num_sampled));
+  }
+};
+
+struct log_uniform_count {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* log_count, const DType* label,
+                                  const int range_max, const int num_sampled) {
+    log_count[i] = DType(LogUniformLogCount(static_cast<int>(label[i]), range_max,
+                                            num_sampled));
+  }
+};
+
+/*! \brief draws class i by a binary search of the cdf of the unigram distribution */
+struct unigram_sample {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* sampled, DType* log_count,
+                                  const float* uniform, const float* cdf, const DType* dist,
+                                  const int range_max, const int num_sampled) {
+    const float total = cdf[range_max - 1];
+    const float loc = uniform[i] * total;
+    int lo = 0, hi = range_max - 1;
+    while (lo < hi) {
+      const int mid = (lo + hi) / 2;
+      if (cdf[mid] > loc) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    sampled[i] = DType(lo);
+    log_count[i] = DType(logf(num_sampled * static_cast<float>(dist[lo]) / total));
+  }
+};
+
+struct unigram_count {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* log_count, const DType* label,
+                                  const float* cdf, const DType* dist, const int range_max,
+                                  const int num_sampled) {
+    const float p = static_cast<float>(dist[static_cast<int>(label[i])]) / cdf[range_max - 1];
+    log_count[i] = DType(logf(num_sampled * p));
+  }
+};
+
+/*! \brief out = the inclusive prefix sums of in */
+template<typename DType>
+inline void InclusiveScan(mshadow::Stream<cpu>* s, const DType* in, float* out, const int n) {
+  float acc = 0;
+  for (int i = 0; i < n; ++i) {
+    acc += static_cast<float>(in[i]);
+    out[i] = acc;
+  }
+}
+
+template<typename DType>
+void InclusiveScan(mshadow::Stream<gpu>* s, const DType* in, float* out, const int n);
+
+inline bool CandidateSamplerShape(const nnvm::NodeAttrs& attrs,
+                                  std::vector<TShape>* in_attrs,
+                                  std::vector<TShape>* out_attrs) {
+  const CandidateSamplerParam& param = nnvm::get<CandidateSamplerParam>(attrs.parsed);
+  CHECK_EQ(out_attrs->size(), 3U);
+  if (param.sampler == candidate_sampler::kUnigram) {
+    CHECK_EQ(in_attrs->size(), 2U) << "The unigram sampler takes the label and the distribution";
+    SHAPE_ASSIGN_CHECK(*in_attrs, 1, TShape(mshadow::Shape1(param.range_max)));
+  } else {
+    CHECK_EQ(in_attrs->size(), 1U) << "The log_uniform sampler takes the label only";
+  }
+  const TShape& lshape = (*in_attrs)[0];
+  if (lshape.ndim() == 0) return false;
+  SHAPE_ASSIGN_CHECK(*out_attrs, 0, TShape(mshadow::Shape1(param.num_sampled)));
+  SHAPE_ASSIGN_CHECK(*out_attrs, 1, lshape);
+  SHAPE_ASSIGN_CHECK(*out_attrs, 2, TShape(mshadow::Shape1(param.num_sampled)));
+  return true;
+}
+
+template<typename xpu>
+void CandidateSamplerForward(const nnvm::NodeAttrs& attrs,
+                             const OpContext& ctx,
+                             const std::vector<TBlob>& inputs,
+                             const std::vector<OpReqType>& req,
+                             const std::vector<TBlob>& outputs) {
+  using namespace mshadow;
+  using namespace mxnet_op;
+  const CandidateSamplerParam& param = nnvm::get<CandidateSamplerParam>(attrs.parsed);
+  const int S = param.num_sampled, V = param.range_max;
+  const int N = inputs[0].Size();
+  const bool unigram = param.sampler == candidate_sampler::kUnigram;
+  Stream<xpu> *s = ctx.get_stream<xpu>();
+  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
+    Random<xpu, float> *prnd = ctx.requested[0].get_random<xpu, float>(s);
+    Tensor<xpu, 1, float> workspace = ctx.requested[1].get_space_typed<xpu, 1, float>(
+        Shape1(S + (unigram ? V : 0)), s);
+    Tensor<xpu, 1, float> uniform = workspace.Slice(0, S);
+    prnd->SampleUniform(&uniform, 0, 1);
+    DType* sampled = outputs[0].dptr<DType>();
+    DType* true_count = outputs[1].dptr<DType>();
+    DType* sampled_count = outputs[2].dptr<DType>();
+    const DType* label = inputs[0].dptr<DType>();
+    if (unigram) {
+      const DType* dist = inputs[1].dptr<DType>();
+      float* cdf = workspace.dptr_ + S;
+      InclusiveScan(s, dist, cdf, V);
+      Kernel<unigram_sample, xpu>::Launch(s, S, sampled, sampled_count, uniform.dptr_, cdf,
+                                          dist, V, S);
+      Kernel<unigram_count, xpu>::Launch(s, N, true_count, label, cdf, dist, V, S);
+    } else {
+      Kernel<log_uniform_sample, xpu>::Launch(s, S, sampled, sampled_count, uniform.dptr_, V, S);
+      Kernel<log_uniform_count, xpu>::Launch(s, N, true_count, label, V, S);
+    }
+  });
+}
+
+namespace sampled_softmax {
+enum SampledSoftmaxInputs {kData, kWeight, kBias, kLabel, kSampled, kTrueCount, kSampledCount};
+enum SampledSoftmaxOutputs {kLoss, kProb};
+}  // namespace sampled_softmax
+
+inline bool SampledSoftmaxShape(const nnvm::NodeAttrs& attrs,
+                                std::vector<TShape>* in_attrs,
+                                std::vector<TShape>* out_attrs) {
+  using namespace sampled_softmax;
+  CHECK_EQ(in_attrs->size(), 7U);
+  CHECK_EQ(out_attrs->size(), 2U);
+  const TShape& dshape = (*in_attrs)[kData];
+  const TShape& wshape = (*in_attrs)[kWeight];
+  const TShape& sshape = (*in_attrs)[kSampled];
+  if (dshape.ndim() == 0 || wshape.ndim() == 0 || sshape.ndim() == 0) return false;
+  CHECK_EQ(dshape.ndim(), 2U) << "sampled_softmax_loss takes 2-D data";
+  CHECK_EQ(wshape.ndim(), 2U) << "sampled_softmax_loss takes a 2-D weight";
+  CHECK_EQ(dshape[1], wshape[1]) << "The data and the weight have different numbers of columns";
+  const TShape batch = mshadow::Shape1(dshape[0]);
+  SHAPE_ASSIGN_CHECK(*in_attrs, kBias, mshadow::Shape1(wshape[0]));
+  SHAPE_ASSIGN_CHECK(*in_attrs, kLabel, batch);
+  SHAPE_ASSIGN_CHECK(*in_attrs, kSampled, mshadow::Shape1(sshape.Size()));
+  SHAPE_ASSIGN_CHECK(*in_attrs, kTrueCount, batch);
+  SHAPE_ASSIGN_CHECK(*in_attrs, kSampledCount, mshadow::Shape1(sshape.Size()));
+  SHAPE_ASSIGN_CHECK(*out_attrs, kLoss, batch);
+  SHAPE_ASSIGN_CHECK(*out_attrs, kProb, mshadow::Shape2(dshape[0], sshape.Size() + 1));
+  return true;
+}
+
+/*!
+ * \brief the corrected logit of sample j of row i, in column j + 1 of logits,
+ *  which holds the product of the data and the sample's weight
+ */
+struct sampled_logit {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int idx, DType* logits, const DType* bias,
+                                  const DType* log_count, const DType* sampled,
+                                  const DType* label, const int S, const bool remove_hits) {
+    const int i = idx / S, j = idx % S;
+    DType& l = logits[i * (S + 1) + j + 1];
+    if (remove_hits && sampled[j] == label[i]) {
+      l = mshadow::red::limits::MinValue<DType>();
+    } else {
+      l += bias[j] - log_count[j];
+    }
+  }
+};
+
+/*! \brief the corrected logit of the label of row i, in column 0 */
+struct true_logit {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* logits, const DType* data, const DType* weight,
+                                  const DType* bias, const DType* log_count, const int D,
+                                  const int S) {
+    DType acc = 0;
+    for (int d = 0; d < D; ++d) acc += data[i * D + d] * weight[i * D + d];
+    logits[i * (S + 1)] = acc + bias[i] - log_count[i];
+  }
+};
+
+/*! \brief the softmax of row i in place, and its loss at column 0 */
+template<int req>
+struct sampled_softmax_row {
+  static const int kCPUGrain = 1;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* prob, DType* loss, const int n) {
+    DType* p = prob + i * n;
+    DType m = p[0];
+    for (int j = 1; j < n; ++j) m = p[j] > m ? p[j] : m;
+    DType sum = 0;
+    for (int j = 0; j < n; ++j) {
+      p[j] = exp(p[j] - m);
+      sum += p[j];
+    }
+    const DType l0 = log(p[0]) - log(sum);
+    for (int j = 0; j < n; ++j) p[j] /= sum;
+    KERNEL_ASSIGN(loss[i], req, -l0);
+  }
+};
+
+/*! \brief gathers the weight rows of the samples then of the labels, and their biases */
+template<typename xpu, typename DType>
+inline void GatherClasses(mshadow::Stream<xpu>* s, const TBlob& weight, const TBlob& bias,
+                          const TBlob& sampled, const TBlob& label,
+                          mshadow::Tensor<xpu, 1, DType> idx,
+                          mshadow::Tensor<xpu, 2, DType> w,
+                          mshadow::Tensor<xpu, 2, DType>* b) {
+  using namespace mshadow;
+  using namespace mshadow::expr;
+  const index_t S = sampled.Size(), N = label.Size();
+  Copy(idx.Slice(0, S), sampled.get<xpu, 1, DType>(s), s);
+  Copy(idx.Slice(S, S + N), label.get<xpu, 1, DType>(s), s);
+  w = take(idx, weight.get<xpu, 2, DType>(s));
+  if (b != nullptr) {
+    *b = take(idx, bias.get_with_shape<xpu, 2, DType>(Shape2(bias.Size(), 1), s));
+  }
+}
+
+template<typename xpu>
+void SampledSoftmaxForward(const nnvm::NodeAttrs& attrs,
+                           const OpContext& ctx,
+                           const std::vector<TBlob>& inputs,
+                           const std::vector<OpReqType>& req,
+                           const std::vector<TBlob>& outputs) {
+  using namespace mshadow;
+  using namespace mxnet_op;
+  using namespace sampled_softmax;
+  const SampledSoftmaxParam& param = nnvm::get<SampledSoftmaxParam>(attrs.parsed);
+  Stream<xpu> *s = ctx.get_stream<xpu>();
+  const index_t N = inputs[kData].size(0), D = inputs[kData].size(1);
+  const index_t S = inputs[kSampled].Size();
+  MSHADOW_SGL_DBL_TYPE_SWITCH(outputs[kLoss].type_flag_, DType, {
+    Tensor<xpu, 1, DType> workspace = ctx.requested[0].get_space_typed<xpu, 1, DType>(
+        Shape1((S + N) * (D + 2)), s);
+    Tensor<xpu, 1, DType> idx(workspace.dptr_, Shape1(S + N), s);
+    Tensor<xpu, 2, DType> w(idx.dptr_ + S + N, Shape2(S + N, D), s);
+    Tensor<xpu, 2, DType> b(w.dptr_ + (S + N) * D, Shape2(S + N, 1), s);
+    GatherClasses(s, inputs[kWeight], inputs[kBias], inputs[kSampled], inputs[kLabel], idx, w, &b);
+    Tensor<xpu, 2, DType> data = inputs[kData].get<xpu, 2, DType>(s);
+    Tensor<xpu, 2, DType> prob = outputs[kProb].get<xpu, 2, DType>(s);
+    // the products with the samples, in the columns 1 to S of prob
+    Tensor<xpu, 2, DType> sampled_logits(prob.dptr_ + 1, Shape2(N, S), S + 1, s);
+    linalg_gemm(data, w.Slice(0, S), sampled_logits, DType(1), DType(0), false, true, s);
+    Kernel<sampled_logit, xpu>::Launch(s, N * S, prob.dptr_, b.dptr_,
+                                       inputs[kSampledCount].dptr<DType>(),
+                                       inputs[kSampled].dptr<DType>(),
+                                       inputs[kLabel].dptr<DType>(), S,
+                                       param.remove_accidental_hits);
+    Kernel<true_logit, xpu>::Launch(s, N, prob.dptr_, data.dptr_, w.dptr_ + S * D,
+                                    b.dptr_ + S, inputs[kTrueCount].dptr<DType>(), D, S);
+    MXNET_ASSIGN_REQ_SWITCH(req[kLoss], Req, {
+      Kernel<sampled_softmax_row<Req>, xpu>::Launch(s, N, prob.dptr_,
+                                                    outputs[kLoss].dptr<DType>(), S + 1);
+    });
+  });
+}
+
+/*! \brief the gradient of the logits, ograd * (prob - onehot(0)) */
+struct sampled_logit_grad {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int idx, DType* grad, const DType* prob, const DType* ograd,
+                                  const int n) {
+    const int i = idx / n, j = idx % n;
+    grad[idx] = ograd[i] * (prob[idx] - DType(j == 0));
+  }
+};
+
+/*! \brief out[i][d] (req)= scale[i * stride] * in[i][d], the label terms of the gradients */
+template<int req>
+struct scale_rows {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int idx, DType* out, const DType* scale, const DType* in,
+                                  const int D, const int stride) {
+    KERNEL_ASSIGN(out[idx], req, scale[(idx / D) * stride] * in[idx]);
+  }
+};
+
+/*! \brief the bias gradients of the samples, the column sums, then of the labels */
+struct bias_grad {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int k, DType* out, const DType* grad, const int N,
+                                  const int S) {
+    if (k < S) {
+      DType acc = 0;
+      for (int i = 0; i < N; ++i) acc += grad[i * (S + 1) + k + 1];
+      out[k] = acc;
+    } else {
+      out[k] = grad[(k - S) * (S + 1)];
+    }
+  }
+};
+
+template<typename xpu>
+void SampledSoftmaxBackward(const nnvm::NodeAttrs& attrs,
+                            const OpContext& ctx,
+                            const std::vector<TBlob>& inputs,
+                            const std::vector<OpReqType>& req,
+                            const std::vector<TBlob>& outputs) {
+  using namespace mshadow;
+  using namespace mshadow::expr;
+  using namespace mxnet_op;
+  using namespace sampled_softmax;
+  // inputs are the loss gradient, data, weight, bias, label, sampled and prob, the bias
+  // only for the gathering shared with the forward pass
+  CHECK_EQ(inputs.size(), 7U);
+  CHECK_EQ(outputs.size(), 7U);
+  const TBlob& ograd = inputs[0];
+  const TBlob& in_data = inputs[1];
+  const TBlob& prob = inputs[6];
+  Stream<xpu> *s = ctx.get_stream<xpu>();
+  const index_t N = in_data.size(0), D = in_data.size(1);
+  const index_t S = inputs[5].Size();
+  MSHADOW_SGL_DBL_TYPE_SWITCH(in_data.type_flag_, DType, {
+    for (int k = kLabel; k <= kSampledCount; ++k) {
+      if (req[k] != kNullOp && req[k] != kAddTo) {
+        Tensor<xpu, 1, DType> g = outputs[k].FlatTo1D<xpu, DType>(s);
+        g = scalar<DType>(0);
+      }
+    }
+    if (req[kData] == kNullOp && req[kWeight] == kNullOp && req[kBias] == kNullOp) return;
+    Tensor<xpu, 1, DType> workspace = ctx.requested[0].get_space_typed<xpu, 1, DType>(
+        Shape1((S + N) * (D + 2) + N * (S + 1)), s);
+    Tensor<xpu, 1, DType> idx(workspace.dptr_, Shape1(S + N), s);
+    Tensor<xpu, 2, DType> w(idx.dptr_ + S + N, Shape2(S + N, D), s);
+    Tensor<xpu, 2, DType> db(w.dptr_ + (S + N) * D, Shape2(S + N, 1), s);
+    Tensor<xpu, 2, DType> grad(db.dptr_ + S + N, Shape2(N, S + 1), s);
+    GatherClasses<xpu, DType>(s, inputs[2], inputs[3], inputs[5], inputs[4], idx, w, nullptr);
+    Kernel<sampled_logit_grad, xpu>::Launch(s, N * (S + 1), grad.dptr_, prob.dptr<DType>(),
+                                            ograd.dptr<DType>(), S + 1);
+    const Tensor<xpu, 2, DType> sampled_grad(grad.dptr_ + 1, Shape2(N, S), S + 1, s);
+    Tensor<xpu, 2, DType> data = in_data.get<xpu, 2, DType>(s);
+    if (req[kData] != kNullOp) {
+      Tensor<xpu, 2, DType> ddata = outputs[kData].get<xpu, 2, DType>(s);
+      MXNET_ASSIGN_REQ_SWITCH(req[kData], Req, {
+        Kernel<scale_rows<Req>, xpu>::Launch(s, N * D, ddata.dptr_, grad.dptr_,
+                                             w.dptr_ + S * D, D, S + 1);
+      });
+      linalg_gemm(sampled_grad, w.Slice(0, S), ddata, DType(1), DType(1), false, false, s);
+    }
+    if (req[kWeight] != kNullOp) {
+      // the gathered rows are replaced by their gradients
+      linalg_gemm(sampled_grad, data, w.Slice(0, S), DType(1), DType(0), true, false, s);
+      Kernel<scale_rows<kWriteTo>, xpu>::Launch(s, N * D, w.dptr_ + S * D, grad.dptr_,
+                                                data.dptr_, D, S + 1);
+      Tensor<xpu, 2, DType> dweight = outputs[kWeight].get<xpu, 2, DType>(s);
+      if (req[kWeight] != kAddTo) dweight = scalar<DType>(0);
+      AddTakeGrad(dweight, idx, w);
+    }
+    if (req[kBias] != kNullOp) {
+      Kernel<bias_grad, xpu>::Launch(s, S + N, db.dptr_, grad.dptr_, N, S);
+      Tensor<xpu, 2, DType> dbias = outputs[kBias].get_with_shape<xpu, 2, DType>(
+          Shape2(outputs[kBias].Size(), 1), s);
+      if (req[kBias] != kAddTo) dbias = scalar<DType>(0);
+      AddTakeGrad(dbias, idx, db);
+    }
+  });
+}
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CONTRIB_SAMPLED_SOFTMAX_INL_H_
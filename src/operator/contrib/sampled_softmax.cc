@@ -0,0 +1,148 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file sampled_softmax.cc
+ * \brief candidate sampling and the sampled softmax loss
+ */
+#include "./sampled_softmax-inl.h"
+
+namespace mxnet {
+namespace op {
+
+DMLC_REGISTER_PARAMETER(CandidateSamplerParam);
+DMLC_REGISTER_PARAMETER(SampledSoftmaxParam);
+
+NNVM_REGISTER_OP(_contrib_candidate_sampler)
+.describe(R"code(Draws the classes shared by a batch in a sampled softmax.
+
+Returns the *num_sampled* drawn classes, drawn with replacement, the log of
+the expected count of the label of each example, log(num_sampled * P(label)),
+and the log of the expected count of each drawn class. These are the inputs
+*sampled*, *true_log_count* and *sampled_log_count* of sampled_softmax_loss.
+
+The log_uniform sampler, whose classes are ids sorted by decreasing frequency,
+takes the label only. The unigram sampler also takes the probabilities, or
+counts, of the *range_max* classes.
+
+Example::
+
+  sampled, true_count, sampled_count = candidate_sampler(label, num_sampled=8192,
+                                                         range_max=800000)
+
+)code" ADD_FILELINE)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    const CandidateSamplerParam& param = nnvm::get<CandidateSamplerParam>(attrs.parsed);
+    return param.sampler == candidate_sampler::kUnigram ? 2U : 1U;
+  })
+.set_num_outputs(3)
+.set_attr_parser(ParamParser<CandidateSamplerParam>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    const CandidateSamplerParam& param = nnvm::get<CandidateSamplerParam>(attrs.parsed);
+    if (param.sampler == candidate_sampler::kUnigram) {
+      return std::vector<std::string>{"label", "dist"};
+    }
+    return std::vector<std::string>{"label"};
+  })
+.set_attr<nnvm::FListOutputNames>("FListOutputNames",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::string>{"sampled", "true_log_count", "sampled_log_count"};
+  })
+.set_attr<nnvm::FInferShape>("FInferShape", CandidateSamplerShape)
+.set_attr<nnvm::FInferType>("FInferType", ElemwiseType<-1, 3>)
+.set_attr<FResourceRequest>("FResourceRequest",
+  [](const nnvm::NodeAttrs& attrs) {
+    return std::vector<ResourceRequest>{
+      ResourceRequest::kRandom, ResourceRequest::kTempSpace};
+  })
+.set_attr<nnvm::FGradient>("FGradient", MakeZeroGradNodes)
+.set_attr<FCompute>("FCompute<cpu>", CandidateSamplerForward<cpu>)
+.add_argument("label", "NDArray-or-Symbol", "The labels of the batch.")
+.add_argument("dist", "NDArray-or-Symbol",
+              "The unnormalized probabilities of the classes, for the unigram sampler.")
+.add_arguments(CandidateSamplerParam::__FIELDS__());
+
+NNVM_REGISTER_OP(_contrib_sampled_softmax_loss)
+.describe(R"code(Computes the softmax cross entropy of each example over its label and
+a set of sampled classes shared by the batch.
+
+The logit of class k for example i is dot(data[i], weight[k]) + bias[k] less
+the log expected count of k, from candidate_sampler. The samples equal to the
+label of an example are left out of its softmax when remove_accidental_hits is
+set. Only the rows of *weight* and *bias* of the labels and the samples are
+read, and only they get a gradient.
+
+Example::
+
+  sampled, true_count, sampled_count = candidate_sampler(label, num_sampled=8192,
+                                                         range_max=800000)
+  loss = sampled_softmax_loss(hidden, weight, bias, label, sampled,
+                              true_count, sampled_count)
+
+)code" ADD_FILELINE)
+.set_num_inputs(7)
+.set_num_outputs(2)
+.set_attr_parser(ParamParser<SampledSoftmaxParam>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::string>{"data", "weight", "bias", "label", "sampled",
+                                    "true_log_count", "sampled_log_count"};
+  })
+.set_attr<nnvm::FNumVisibleOutputs>("FNumVisibleOutputs",
+  [](const NodeAttrs& attrs) { return 1U; })
+.set_attr<nnvm::FInferShape>("FInferShape", SampledSoftmaxShape)
+.set_attr<nnvm::FInferType>("FInferType", ElemwiseType<7, 2>)
+.set_attr<FResourceRequest>("FResourceRequest",
+  [](const nnvm::NodeAttrs& attrs) {
+    return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
+  })
+.set_attr<FCompute>("FCompute<cpu>", SampledSoftmaxForward<cpu>)
+.set_attr<nnvm::FGradient>("FGradient",
+  [](const nnvm::NodePtr& n, const std::vector<nnvm::NodeEntry>& ograds) {
+    using namespace sampled_softmax;
+    std::vector<nnvm::NodeEntry> heads{ograds[kLoss]};
+    for (int i : {kData, kWeight, kBias, kLabel, kSampled}) heads.push_back(n->inputs[i]);
+    heads.emplace_back(nnvm::NodeEntry{n, kProb, 0});
+    return MakeGradNode("_backward_contrib_sampled_softmax_loss", n, heads, n->attrs.dict);
+  })
+.add_argument("data", "NDArray-or-Symbol", "The features of the examples, (batch, dim).")
+.add_argument("weight", "NDArray-or-Symbol", "The output projection, (num_classes, dim).")
+.add_argument("bias", "NDArray-or-Symbol", "The bias of the classes.")
+.add_argument("label", "NDArray-or-Symbol", "The class of each example.")
+.add_argument("sampled", "NDArray-or-Symbol", "The shared sampled classes.")
+.add_argument("true_log_count", "NDArray-or-Symbol",
+              "The log expected count of the label of each example.")
+.add_argument("sampled_log_count", "NDArray-or-Symbol",
+              "The log expected count of each sampled class.")
+.add_arguments(SampledSoftmaxParam::__FIELDS__());
+
+NNVM_REGISTER_OP(_backward_contrib_sampled_softmax_loss)
+.set_num_inputs(7)
+.set_num_outputs(7)
+.set_attr_parser(ParamParser<SampledSoftmaxParam>)
+.set_attr<nnvm::TIsBackward>("TIsBackward", true)
+.set_attr<FResourceRequest>("FResourceRequest",
+  [](const nnvm::NodeAttrs& attrs) {
+    return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
+  })
+.set_attr<FCompute>("FCompute<cpu>", SampledSoftmaxBackward<cpu>);
+
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,50 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file sampled_softmax.cu
+ * \brief candidate sampling and the sampled softmax loss
+ */
+#include <thrust/device_ptr.h>
+#include <thrust/execution_policy.h>
+#include <thrust/scan.h>
+#include "./sampled_softmax-inl.h"
+
+namespace mxnet {
+namespace op {
+
+template<typename DType>
+void InclusiveScan(mshadow::Stream<gpu>* s, const DType* in, float* out, const int n) {
+  thrust::device_ptr<const DType> in_ptr(in);
+  thrust::device_ptr<float> out_ptr(out);
+  thrust::inclusive_scan(thrust::cuda::par.on(mshadow::Stream<gpu>::GetStream(s)),
+                         in_ptr, in_ptr + n, out_ptr);
+}
+
+NNVM_REGISTER_OP(_contrib_candidate_sampler)
+.set_attr<FCompute>("FCompute<gpu>", CandidateSamplerForward<gpu>);
+
+NNVM_REGISTER_OP(_contrib_sampled_softmax_loss)
+.set_attr<FCompute>("FCompute<gpu>", SampledSoftmaxForward<gpu>);
+
+NNVM_REGISTER_OP(_backward_contrib_sampled_softmax_loss)
+.set_attr<FCompute>("FCompute<gpu>", SampledSoftmaxBackward<gpu>);
+
+}  // namespace op
+}  // namespace mxnet
@@ -0,0 +1,146 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file tensor_stats-inl.h
+ * \brief the statistics of a tensor, reduced on its device for the monitor
+ */
+#ifndef MXNET_OPERATOR_CONTRIB_TENSOR_STATS_INL_H_
+#define MXNET_OPERATOR_CONTRIB_TENSOR_STATS_INL_H_
+
+#include <mxnet/operator_util.h>
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+#include "../elemwise_op_common.h"
+#include "../mxnet_op.h"
+#include "../operator_common.h"
+
+namespace mxnet {
+namespace op {
+
+namespace tensor_stats {
+/*! \brief the statistics, in the order of the output */
+enum TensorStatsOut {kNorm, kMean, kMaxAbs, kNumNaN, kNumInf, kNumStats};
+/*! \brief the most partial reductions of a tensor */
+const int kMaxChunks = 4096;
+}  // namespace tensor_stats
+
+/*!
+ * \brief reduce the elements i, i + nchunk, ... of in into the statistics
+ *  part[i * kNumStats, ...]; the norm and the mean count the finite elements.
+ */
+struct tensor_stats_partial {
+  // each call reduces a whole chunk
+  static const int kCPUGrain = 1;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, double* part, const DType* in,
+                                  int size, int nchunk) {
+    using namespace tensor_stats;
+    double sumsq = 0, sum = 0, maxabs = 0, nnan = 0, ninf = 0;
+    for (int j = i; j < size; j += nchunk) {
+      const double v = static_cast<double>(in[j]);
+      if (v != v) {
+        nnan += 1;
+      } else if (fabs(v) > DBL_MAX) {
+        ninf += 1;
+      } else {
+        sumsq += v * v;
+        sum += v;
+        maxabs = fabs(v) > maxabs ? fabs(v) : maxabs;
+      }
+    }
+    double* p = part + i * kNumStats;
+    p[kNorm] = sumsq;
+    p[kMean] = sum;
+    p[kMaxAbs] = maxabs;
+    p[kNumNaN] = nnan;
+    p[kNumInf] = ninf;
+  }
+};
+
+/*! \brief fold the partial statistics into out, with a single call */
+struct tensor_stats_final {
+  MSHADOW_XINLINE static void Map(int i, float* out, const double* part,
+                                  int size, int nchunk) {
+    using namespace tensor_stats;
+    double sumsq = 0, sum = 0, maxabs = 0, nnan = 0, ninf = 0;
+    for (int c = 0; c < nchunk; ++c) {
+      const double* p = part + c * kNumStats;
+      sumsq += p[kNorm];
+      sum += p[kMean];
+      maxabs = p[kMaxAbs] > maxabs ? p[kMaxAbs] : maxabs;
+      nnan += p[kNumNaN];
+      ninf += p[kNumInf];
+    }
+    const double nfinite = size - nnan - ninf;
+    out[kNorm] = static_cast<float>(sqrt(sumsq));
+    out[kMean] = nfinite > 0 ? static_cast<float>(sum / nfinite) : 0.0f;
+    out[kMaxAbs] = static_cast<float>(maxabs);
+    out[kNumNaN] = static_cast<float>(nnan);
+    out[kNumInf] = static_cast<float>(ninf);
+  }
+};
+
+template<typename xpu>
+void TensorStatsCompute(const nnvm::NodeAttrs& attrs,
+                        const OpContext& ctx,
+                        const std::vector<TBlob>& inputs,
+                        const std::vector<OpReqType>& req,
+                        const std::vector<TBlob>& outputs) {
+  using namespace mshadow;
+  using namespace mxnet_op;
+  using namespace tensor_stats;
+  CHECK_EQ(inputs.size(), 1U);
+  CHECK_EQ(outputs.size(), 1U);
+  CHECK_EQ(req[0], kWriteTo) << "tensor_stats only supports the write of its output";
+  Stream<xpu> *s = ctx.get_stream<xpu>();
+  const int size = inputs[0].Size();
+  const int nchunk = std::max(1, std::min(size, kMaxChunks));
+  Tensor<xpu, 1, double> part = ctx.requested[0].get_space_typed<xpu, 1, double>(
+      Shape1(nchunk * kNumStats), s);
+  MSHADOW_TYPE_SWITCH(inputs[0].type_flag_, DType, {
+    Kernel<tensor_stats_partial, xpu>::Launch(s, nchunk, part.dptr_,
+        inputs[0].dptr<DType>(), size, nchunk);
+  });
+  Kernel<tensor_stats_final, xpu>::Launch(s, 1, outputs[0].dptr<float>(),
+      part.dptr_, size, nchunk);
+}
+
+inline bool TensorStatsShape(const nnvm::NodeAttrs& attrs,
+                             std::vector<TShape> *in_attrs,
+                             std::vector<TShape> *out_attrs) {
+  CHECK_EQ(in_attrs->size(), 1U);
+  CHECK_EQ(out_attrs->size(), 1U);
+  SHAPE_ASSIGN_CHECK(*out_attrs, 0, mshadow::Shape1(tensor_stats::kNumStats));
+  return !shape_is_none(in_attrs->at(0));
+}
+
+inline bool TensorStatsType(const nnvm::NodeAttrs& attrs,
+                            std::vector<int> *in_attrs,
+                            std::vector<int> *out_attrs) {
+  CHECK_EQ(in_attrs->size(), 1U);
+  CHECK_EQ(out_attrs->size(), 1U);
+  TYPE_ASSIGN_CHECK(*out_attrs, 0, mshadow::kFloat32);
+  return (*in_attrs)[0] != -1;
+}
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_CONTRIB_TENSOR_STATS_INL_H_
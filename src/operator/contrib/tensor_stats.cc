@@ -0,0 +1,65 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file tensor_stats.cc
+ * \brief the statistics of a tensor, reduced on its device
+ */
+#include "./tensor_stats-inl.h"
+
+namespace mxnet {
+namespace op {
+
+NNVM_REGISTER_OP(_contrib_tensor_stats)
+.describe(R"code(Returns the statistics of a tensor used to monitor the training,
+as a float32 vector of 5 elements:
+
+- the L2 norm of the finite elements,
+- the mean of the finite elements,
+- the largest absolute value of the finite elements,
+- the number of NaN elements,
+- the number of infinite elements.
+
+The tensor is reduced on its own device in one pass, so only the 5 values need
+to be copied to read the statistics, e.g. in ``mx.monitor.Monitor``.
+
+Example::
+
+  x = [[1, -3], [nan, inf]]
+  tensor_stats(x) = [3.1622777, -1, 3, 1, 1]
+
+)code" ADD_FILELINE)
+.set_num_inputs(1)
+.set_num_outputs(1)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::string>{"data"};
+  })
+.set_attr<nnvm::FInferShape>("FInferShape", TensorStatsShape)
+.set_attr<nnvm::FInferType>("FInferType", TensorStatsType)
+.set_attr<FResourceRequest>("FResourceRequest",
+  [](const nnvm::NodeAttrs& attrs) {
+    return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
+  })
+.set_attr<FCompute>("FCompute<cpu>", TensorStatsCompute<cpu>)
+.set_attr<nnvm::FGradient>("FGradient", MakeZeroGradNodes)
+.add_argument("data", "NDArray-or-Symbol", "The tensor to summarize.");
+
+}  // namespace op
+}  // namespace mxnet
@@ -37,6 +37,7 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include "./operator_common.h"
 #include "./nn/im2col.h"
@@ -131,17 +132,18 @@ class ConvolutionOp : public Operator {
     CHECK_EQ(req[conv::kOut], kWriteTo);
     LayerSetUp(in_data[conv::kData].shape_, out_data[conv::kOut].shape_);
     Stream<xpu>* s = ctx.get_stream<xpu>();
-    // allocate workspace for col_buffer
-    Tensor<xpu, 1, DType> workspace = ctx.requested[conv::kTempSpace]
-      .get_space_typed<xpu, 1, DType>(Shape1(col_buffer_size_), s);
     // calculate the shape of col_buffer
     TShape col_buffer_shape(num_spatial_axes_ + 1);
     col_buffer_shape[0] = conv_in_channels_ * param_.kernel.Size();
     for (index_t i = 1; i < col_buffer_shape.ndim(); ++i) {
       col_buffer_shape[i] = out_data[0].shape_[i+1];
     }
-    // create a column buffer using workspace and col_buffer_shape
-    TBlob col_buffer(workspace.dptr_, col_buffer_shape, xpu::kDevMask, DataType<DType>::kFlag);
+    // create the column buffers of nstep_ images using workspace and col_buffer_shape,
+    // a 1x1 convolution multiplies the images themselves
+    TBlob col_buffer(is_1x1_ ? in_data[conv::kData].dptr<DType>() :
+                     ctx.requested[conv::kTempSpace].get_space_typed<xpu, 1, DType>(
+                       Shape1(col_buffer_size_ * nstep_), s).dptr_,
+                     col_buffer_shape, xpu::kDevMask, DataType<DType>::kFlag);
 
     // initialize weight and col_buffer 3D tensors for using gemm
     index_t M = conv_out_channels_ / group_;
@@ -153,14 +155,21 @@ class ConvolutionOp : public Operator {
       Shape3(group_, K, N), s);
     Tensor<xpu, 4, DType> output_4d = out_data[conv::kOut].get_with_shape<xpu, 4, DType>(
       Shape4(num_, group_, M, N), s);
-    for (index_t n = 0; n < num_; ++n) {
-      // transform image to col_buffer in order to use gemm
-      im2col(s, in_data[conv::kData].dptr<DType>()+n*input_dim_, in_data[conv::kData].shape_,
-             col_buffer.shape_, param_.kernel, param_.pad, param_.stride, param_.dilate,
-             col_buffer.dptr<DType>());
-      Tensor<xpu, 3, DType> output_3d = output_4d[n];
-      for (index_t g = 0; g < group_; ++g) {
-        ASSIGN_DISPATCH(output_3d[g], req[conv::kOut], dot(weight_3d[g], col_buffer_3d[g]));
+    for (index_t i = 0; i < num_; i += nstep_) {
+      const index_t step = std::min(nstep_, num_ - i);
+      if (!is_1x1_) {
+        // transform the images of the step to col_buffer in order to use gemm
+        im2col_batch(s, in_data[conv::kData].dptr<DType>()+i*input_dim_, step,
+                     in_data[conv::kData].shape_, col_buffer.shape_, param_.kernel, param_.pad,
+                     param_.stride, param_.dilate, col_buffer.dptr<DType>());
+      }
+      for (index_t n = i; n < i + step; ++n) {
+        col_buffer_3d.dptr_ = is_1x1_ ? in_data[conv::kData].dptr<DType>()+n*input_dim_ :
+                              col_buffer.dptr<DType>()+(n-i)*col_buffer_size_;
+        Tensor<xpu, 3, DType> output_3d = output_4d[n];
+        for (index_t g = 0; g < group_; ++g) {
+          ASSIGN_DISPATCH(output_3d[g], req[conv::kOut], dot(weight_3d[g], col_buffer_3d[g]));
+        }
       }
     }
     if (bias_term_) {
@@ -188,17 +197,18 @@ class ConvolutionOp : public Operator {
     CHECK_EQ(in_data[conv::kWeight].CheckContiguous(), true);
     LayerSetUp(in_grad[conv::kData].shape_, out_grad[conv::kOut].shape_);
     Stream<xpu> *s = ctx.get_stream<xpu>();
-    // allocate workspace for col_buffer
-    Tensor<xpu, 1, DType> workspace = ctx.requested[conv::kTempSpace]
-      .get_space_typed<xpu, 1, DType>(Shape1(col_buffer_size_), s);
     // calculate the shape of col_buffer
     TShape col_buffer_shape(num_spatial_axes_ + 1);
     col_buffer_shape[0] = conv_in_channels_ * param_.kernel.Size();
     for (index_t i = 1; i < col_buffer_shape.ndim(); ++i) {
       col_buffer_shape[i] = out_grad[conv::kData].shape_[i+1];
     }
-    // create a column buffer using workspace and col_buffer_shape
-    TBlob col_buffer(workspace.dptr_, col_buffer_shape, xpu::kDevMask, DataType<DType>::kFlag);
+    // create the column buffers of nstep_ images using workspace and col_buffer_shape,
+    // a 1x1 convolution needs none
+    TBlob col_buffer(is_1x1_ ? NULL :
+                     ctx.requested[conv::kTempSpace].get_space_typed<xpu, 1, DType>(
+                       Shape1(col_buffer_size_ * nstep_), s).dptr_,
+                     col_buffer_shape, xpu::kDevMask, DataType<DType>::kFlag);
 
     // initialize weight and col_buffer 3D tensors for using gemm
     // For computing dLoss/d(in_data[kData])
@@ -215,26 +225,46 @@ class ConvolutionOp : public Operator {
     Tensor<xpu, 3, DType> dweight_3d = in_grad[conv::kWeight].get_with_shape<xpu, 3, DType>(
       Shape3(group_, K, M), s);
 
-    for (index_t n = 0; n < num_; ++n) {
-      Tensor<xpu, 3, DType> out_grad_3d = out_grad_4d[n];
+    for (index_t i = 0; i < num_; i += nstep_) {
+      const index_t step = std::min(nstep_, num_ - i);
       // gradient w.r.t. input data
-      for (index_t g = 0; g < group_; ++g) {
-        col_buffer_3d[g] = dot(weight_3d[g].T(), out_grad_3d[g]);
+      if (is_1x1_) {
+        for (index_t n = i; n < i + step; ++n) {
+          col_buffer_3d.dptr_ = in_grad[conv::kData].dptr<DType>()+n*input_dim_;
+          for (index_t g = 0; g < group_; ++g) {
+            ASSIGN_DISPATCH(col_buffer_3d[g], req[conv::kData],
+                            dot(weight_3d[g].T(), out_grad_4d[n][g]));
+          }
+        }
+      } else {
+        if (req[conv::kData] != kNullOp) {
+          for (index_t n = i; n < i + step; ++n) {
+            col_buffer_3d.dptr_ = col_buffer.dptr<DType>()+(n-i)*col_buffer_size_;
+            for (index_t g = 0; g < group_; ++g) {
+              col_buffer_3d[g] = dot(weight_3d[g].T(), out_grad_4d[n][g]);
+            }
+          }
+          col2im_batch(s, col_buffer.dptr<DType>(), step, in_grad[conv::kData].shape_,
+                       col_buffer.shape_, param_.kernel, param_.pad, param_.stride,
+                       param_.dilate, in_grad[conv::kData].dptr<DType>()+i*input_dim_,
+                       req[conv::kData]);
+        }
+        // gradient w.r.t. weight, dWeight should accumulate across the batch and group
+        im2col_batch(s, in_data[conv::kData].dptr<DType>()+i*input_dim_, step,
+                     in_data[conv::kData].shape_, col_buffer.shape_, param_.kernel, param_.pad,
+                     param_.stride, param_.dilate, col_buffer.dptr<DType>());
       }
-      col2im(s, col_buffer.dptr<DType>(), in_grad[conv::kData].shape_, col_buffer.shape_,
-             param_.kernel, param_.pad, param_.stride, param_.dilate,
-             in_grad[conv::kData].dptr<DType>()+n*input_dim_, req[conv::kData]);
-
-      // gradient w.r.t. weight, dWeight should accumulate across the batch and group
-      im2col(s, in_data[conv::kData].dptr<DType>()+n*input_dim_, in_data[conv::kData].shape_,
-             col_buffer.shape_, param_.kernel, param_.pad, param_.stride, param_.dilate,
-             col_buffer.dptr<DType>());
-      for (index_t g = 0; g < group_; ++g) {
-        if (0 == n) {
-          ASSIGN_DISPATCH(dweight_3d[g], req[conv::kWeight],
-                          dot(out_grad_3d[g], col_buffer_3d[g].T()));
-        } else {
-          dweight_3d[g] += dot(out_grad_3d[g], col_buffer_3d[g].T());
+      for (index_t n = i; n < i + step; ++n) {
+        Tensor<xpu, 3, DType> out_grad_3d = out_grad_4d[n];
+        col_buffer_3d.dptr_ = is_1x1_ ? in_data[conv::kData].dptr<DType>()+n*input_dim_ :
+                              col_buffer.dptr<DType>()+(n-i)*col_buffer_size_;
+        for (index_t g = 0; g < group_; ++g) {
+          if (0 == n) {
+            ASSIGN_DISPATCH(dweight_3d[g], req[conv::kWeight],
+                            dot(out_grad_3d[g], col_buffer_3d[g].T()));
+          } else {
+            dweight_3d[g] += dot(out_grad_3d[g], col_buffer_3d[g].T());
+          }
         }
       }
     }
@@ -280,6 +310,13 @@ class ConvolutionOp : public Operator {
     output_dim_ = oshape.ProdShape(1, oshape.ndim());
     num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
     num_kernels_col2im_ = input_dim_;
+    // the cpu lowers the images of a step concurrently, one per thread and within the
+    // workspace, the gpu one at a time
+    nstep_ = 1;
+    if (std::is_same<xpu, cpu>::value && !is_1x1_) {
+      nstep_ = std::max<index_t>(1, std::min<index_t>(
+          std::min<index_t>(num_, omp_get_max_threads()), param_.workspace / col_buffer_size_));
+    }
   }
 
  private:
@@ -303,6 +340,7 @@ class ConvolutionOp : public Operator {
   index_t num_kernels_col2im_;
   bool bias_term_;  // has bias term?
   bool is_1x1_;
+  index_t nstep_;  // number of images lowered at a time
 };  // class ConvolutionOp
 
 template<typename xpu>
@@ -24,6 +24,8 @@
 */
 
 #include "./convolution-inl.h"
+#include "./depthwise_convolution-inl.h"
+#include "./winograd_convolution-inl.h"
 #if MXNET_USE_MKL2017 == 1
 #include <mkl_memory.h>
 #include "./mkl/mkl_memory-inl.h"
@@ -50,6 +52,13 @@ Operator* CreateOp<cpu>(ConvolutionParam param, int dtype,
     })
     return op;
   }
+  // the depthwise convolutions run the direct kernels rather than one gemm per channel
+  if (DepthwiseConvolutionOp<cpu, float>::Supports(param, (*in_shape)[conv::kData], dtype)) {
+    MSHADOW_SGL_DBL_TYPE_SWITCH(dtype, DType, {
+      op = new DepthwiseConvolutionOp<cpu, DType>(param);
+    })
+    return op;
+  }
 #if MXNET_USE_MKL2017 == 1
   if ((param.dilate[0] == 1 && param.dilate[1] == 1)
       && param.kernel.ndim() == 2) {
@@ -78,6 +87,14 @@ Operator* CreateOp<cpu>(ConvolutionParam param, int dtype,
     }
   }
 #endif
+  const int winograd_tile = WinogradConvolutionOp<float>::Tile(param, (*in_shape)[conv::kData],
+                                                               dtype);
+  if (winograd_tile != 0) {
+    MSHADOW_SGL_DBL_TYPE_SWITCH(dtype, DType, {
+      op = new WinogradConvolutionOp<DType>(param, winograd_tile);
+    })
+    return op;
+  }
   MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
     op = new ConvolutionOp<cpu, DType>(param);
   })
@@ -133,6 +150,10 @@ along the first dimension. Next compute the convolution on the *i*-th part of
 the data with the *i*-th weight part. The output is obtained by concatenating all
 the *g* results.
 
+When ``num_group`` equals both ``num_filter`` and the number of input channels,
+in a 2-D convolution of *NCHW* float32 or float64 data, every output channel is
+computed from its input channel alone by dedicated depthwise kernels.
+
 1-D convolution does not have *height* dimension but only *width* in space.
 
 - **data**: *(batch_size, channel, width)*
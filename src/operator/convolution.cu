@@ -24,6 +24,7 @@
 */
 
 #include "./convolution-inl.h"
+#include "./depthwise_convolution-inl.h"
 #include <vector>
 #if MXNET_USE_CUDNN == 1
 #include "./cudnn_convolution-inl.h"
@@ -45,6 +46,13 @@ Operator* CreateOp<gpu>(ConvolutionParam param, int dtype,
     })
     return op;
   }
+  // the depthwise convolutions run the direct kernels rather than one gemm per channel
+  if (DepthwiseConvolutionOp<gpu, float>::Supports(param, (*in_shape)[conv::kData], dtype)) {
+    MSHADOW_SGL_DBL_TYPE_SWITCH(dtype, DType, {
+      op = new DepthwiseConvolutionOp<gpu, DType>(param);
+    })
+    return op;
+  }
 #if MXNET_USE_CUDNN == 1
   // The NVIDIA Pascal architecture was the first to include 16-bit ALUs.
   // Thus, when the framework is compiled with MSHADOW_USE_PASCAL == 1, we
@@ -32,6 +32,7 @@
 #include <string>
 #include <utility>
 #include "./mshadow_op.h"
+#include "./mxnet_op.h"
 #include "./operator_common.h"
 namespace mxnet {
 namespace op {
@@ -39,7 +40,7 @@ namespace op {
 //  These enums are only visible within this header
 namespace Correlation {
 enum  CorrelationOpInputs{kData1, kData2};
-enum  CorrelationOpOutputs{kOut, kTemp1, kTemp2};
+enum  CorrelationOpOutputs{kOut};
 }  //  namespace Correlation
 struct CorrelationParam : public dmlc::Parameter<CorrelationParam> {
   uint32_t max_displacement;
@@ -63,6 +64,132 @@ struct CorrelationParam : public dmlc::Parameter<CorrelationParam> {
     .describe("operation type is either multiplication or subduction");
   }
 };
+/*! \brief the sizes of a correlation, the positions are in the padded images */
+struct CorrelationGeometry {
+  int num, channels, height, width;
+  int pad_size, kernel_size, max_displacement, stride1, stride2;
+  int grid_radius, grid_width;
+  int top_channels, top_height, top_width;
+};
+
+inline CorrelationGeometry MakeCorrelationGeometry(const CorrelationParam& param,
+                                                   const TShape& dshape) {
+  CorrelationGeometry geo;
+  geo.num = dshape[0];
+  geo.channels = dshape[1];
+  geo.height = dshape[2];
+  geo.width = dshape[3];
+  geo.pad_size = param.pad_size;
+  geo.kernel_size = param.kernel_size;
+  geo.max_displacement = param.max_displacement;
+  geo.stride1 = param.stride1;
+  geo.stride2 = param.stride2;
+  const int border_size = param.max_displacement + (param.kernel_size - 1) / 2;
+  geo.top_width = ceil(static_cast<float>(geo.width + 2 * geo.pad_size - border_size * 2)
+                       / static_cast<float>(geo.stride1));
+  geo.top_height = ceil(static_cast<float>(geo.height + 2 * geo.pad_size - border_size * 2)
+                        / static_cast<float>(geo.stride1));
+  geo.grid_radius = param.max_displacement / param.stride2;
+  geo.grid_width = geo.grid_radius * 2 + 1;
+  geo.top_channels = geo.grid_width * geo.grid_width;
+  return geo;
+}
+
+namespace correlation {
+/*! \brief floor(a / b) for b > 0 */
+MSHADOW_XINLINE int FloorDiv(int a, int b) {
+  return a >= 0 ? a / b : -((b - 1 - a) / b);
+}
+
+/*! \brief ceil(a / b) for b > 0 */
+MSHADOW_XINLINE int CeilDiv(int a, int b) {
+  return -FloorDiv(-a, b);
+}
+
+/*! \brief the multiplicative comparison of two pixels and its derivatives */
+struct mul {
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b) {
+    return a * b;
+  }
+  template<typename DType>
+  MSHADOW_XINLINE static DType LeftGrad(DType a, DType b) {
+    return b;
+  }
+  template<typename DType>
+  MSHADOW_XINLINE static DType RightGrad(DType a, DType b) {
+    return a;
+  }
+};
+
+/*! \brief the subtractive comparison of two pixels and its derivatives */
+struct absdiff {
+  template<typename DType>
+  MSHADOW_XINLINE static DType Map(DType a, DType b) {
+    return a >= b ? a - b : b - a;
+  }
+  template<typename DType>
+  MSHADOW_XINLINE static DType LeftGrad(DType a, DType b) {
+    return a >= b ? DType(1) : DType(-1);
+  }
+  template<typename DType>
+  MSHADOW_XINLINE static DType RightGrad(DType a, DType b) {
+    return a >= b ? DType(-1) : DType(1);
+  }
+};
+
+/*!
+ * \brief the gradient of a pixel of data1 (left) or data2, which gathers the
+ *  outputs whose patches cover it, one pixel per thread.
+ */
+template<int req, typename OP, bool left>
+struct backward {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int index, DType* grad, const DType* data1,
+                                  const DType* data2, const DType* out_grad,
+                                  const CorrelationGeometry geo) {
+    const int x = index % geo.width;
+    const int y = (index / geo.width) % geo.height;
+    const int nc = index / geo.width / geo.height;
+    const int n = nc / geo.channels;
+    const int plane = geo.height * geo.width;
+    const DType* self = (left ? data1 : data2) + nc * plane;
+    const DType* other = (left ? data2 : data1) + nc * plane;
+    const DType pixel = self[y * geo.width + x];
+    const int top_plane = geo.top_height * geo.top_width;
+    DType sum = 0;
+    for (int p = -geo.grid_radius; p <= geo.grid_radius; ++p) {
+      for (int o = -geo.grid_radius; o <= geo.grid_radius; ++o) {
+        // the pixel of the other data that is compared with this one
+        const int oy = y + (left ? p : -p) * geo.stride2;
+        const int ox = x + (left ? o : -o) * geo.stride2;
+        // the outputs whose patches of data1 start at most kernel_size - 1 before its pixel
+        const int ly = (left ? y : oy) + geo.pad_size - geo.max_displacement;
+        const int lx = (left ? x : ox) + geo.pad_size - geo.max_displacement;
+        const int ymin = CeilDiv(ly - geo.kernel_size + 1, geo.stride1);
+        const int ymax = FloorDiv(ly, geo.stride1);
+        const int xmin = CeilDiv(lx - geo.kernel_size + 1, geo.stride1);
+        const int xmax = FloorDiv(lx, geo.stride1);
+        if (ymax < 0 || xmax < 0 || ymin >= geo.top_height || xmin >= geo.top_width) continue;
+        const DType value = (oy >= 0 && oy < geo.height && ox >= 0 && ox < geo.width) ?
+                            other[oy * geo.width + ox] : DType(0);
+        const int top_channel = (p + geo.grid_radius) * geo.grid_width + o + geo.grid_radius;
+        const DType* top = out_grad + (n * geo.top_channels + top_channel) * top_plane;
+        DType top_sum = 0;
+        for (int i = ymin > 0 ? ymin : 0; i <= ymax && i < geo.top_height; ++i) {
+          for (int j = xmin > 0 ? xmin : 0; j <= xmax && j < geo.top_width; ++j) {
+            top_sum += top[i * geo.top_width + j];
+          }
+        }
+        sum += top_sum * (left ? OP::LeftGrad(pixel, value) : OP::RightGrad(value, pixel));
+      }
+    }
+    const int sumelems = geo.kernel_size * geo.kernel_size * geo.channels;
+    KERNEL_ASSIGN(grad[index], req, sum / static_cast<DType>(sumelems));
+  }
+};
+}  // namespace correlation
+
 template<typename xpu>
 class CorrelationOp : public Operator {
  public:
@@ -76,43 +203,16 @@ class CorrelationOp : public Operator {
                        const std::vector<TBlob> &aux_args) {
     using namespace mshadow;
     CHECK_EQ(in_data.size(), 2U);
-    CHECK_EQ(out_data.size(), 3U);
+    CHECK_EQ(out_data.size(), 1U);
     Stream<xpu> *s = ctx.get_stream<xpu>();
     Tensor<xpu, 4> data1 = in_data[Correlation::kData1].get<xpu, 4, real_t>(s);
     Tensor<xpu, 4> data2 = in_data[Correlation::kData2].get<xpu, 4, real_t>(s);
     Tensor<xpu, 4> out   = out_data[Correlation::kOut].get<xpu, 4, real_t>(s);
-    Tensor<xpu, 4> tmp1  = out_data[Correlation::kTemp1].get<xpu, 4, real_t>(s);
-    Tensor<xpu, 4> tmp2  = out_data[Correlation::kTemp2].get<xpu, 4, real_t>(s);
-    tmp1 = 0.0f;
-    tmp2 = 0.0f;
-    out = 0.0f;
     CHECK_EQ(data1.CheckContiguous(), true);
     CHECK_EQ(data2.CheckContiguous(), true);
     CHECK_EQ(out.CheckContiguous(), true);
-    CHECK_EQ(tmp1.CheckContiguous(), true);
-    CHECK_EQ(tmp2.CheckContiguous(), true);
-    paddedbottomheight = data1.shape_[2] + 2 * param_.pad_size;
-    paddedbottomwidth  = data1.shape_[3] + 2 * param_.pad_size;
-    kernel_radius_ = (param_.kernel_size - 1) / 2;
-    border_size_ = param_.max_displacement + kernel_radius_;
-    stride1 = param_.stride1;
-    stride2 = param_.stride2;
-    top_width_ = ceil(static_cast<float>(paddedbottomwidth - border_size_ * 2)\
-     / static_cast<float>(stride1));
-    top_height_ = ceil(static_cast<float>(paddedbottomheight - border_size_ * 2)\
-     / static_cast<float>(stride1));
-    neighborhood_grid_radius_ = param_.max_displacement / stride2;
-    neighborhood_grid_width_ = neighborhood_grid_radius_ * 2 + 1;
-    top_channels_ = neighborhood_grid_width_ * neighborhood_grid_width_;
-    num =  data1.shape_[0];
-    channels = data1.shape_[1];
-    height = data1.shape_[2];
-    width = data1.shape_[3];
-    CorrelationForward(out, data1, data2, tmp1, tmp2, top_channels_, top_height_, top_width_,
-                       param_.pad_size, param_.is_multiply,
-                       param_.max_displacement, param_.kernel_size,
-                       neighborhood_grid_radius_, neighborhood_grid_width_,
-                       kernel_radius_, param_.stride1, param_.stride2);
+    const CorrelationGeometry geo = MakeCorrelationGeometry(param_, data1.shape_);
+    CorrelationForward(out, data1, data2, geo, param_.is_multiply);
   }
   virtual void Backward(const OpContext &ctx,
                         const std::vector<TBlob> &out_grad,
@@ -126,39 +226,44 @@ class CorrelationOp : public Operator {
     Tensor<xpu, 4> grad_data1 = in_grad[Correlation::kData1].get<xpu, 4, real_t>(s);
     Tensor<xpu, 4> grad_data2 = in_grad[Correlation::kData2].get<xpu, 4, real_t>(s);
     Tensor<xpu, 4> out_g = out_grad[Correlation::kOut].get<xpu, 4, real_t>(s);
-    Tensor<xpu, 4> tmp1 = out_data[Correlation::kTemp1].get<xpu, 4, real_t>(s);
-    Tensor<xpu, 4> tmp2 = out_data[Correlation::kTemp2].get<xpu, 4, real_t>(s);
-    if (req[0] != kAddTo) grad_data1 = 0.0f;
-    if (req[1] != kAddTo) grad_data2 = 0.0f;
+    Tensor<xpu, 4> data1 = in_data[Correlation::kData1].get<xpu, 4, real_t>(s);
+    Tensor<xpu, 4> data2 = in_data[Correlation::kData2].get<xpu, 4, real_t>(s);
     CHECK_EQ(grad_data1.CheckContiguous(), true);
     CHECK_EQ(grad_data2.CheckContiguous(), true);
     CHECK_EQ(out_g.CheckContiguous(), true);
-    CHECK_EQ(tmp1.CheckContiguous(), true);
-    CHECK_EQ(tmp2.CheckContiguous(), true);
-    CorrelationBackward(out_g, grad_data1, grad_data2, tmp1, tmp2, top_channels_,
-                        top_height_, top_width_, param_.pad_size, param_.is_multiply,
-                        param_.max_displacement, param_.kernel_size, neighborhood_grid_radius_,
-                        neighborhood_grid_width_, kernel_radius_, param_.stride1, param_.stride2,
-                        num, channels, height, width);
+    CHECK_EQ(data1.CheckContiguous(), true);
+    CHECK_EQ(data2.CheckContiguous(), true);
+    const CorrelationGeometry geo = MakeCorrelationGeometry(param_, data1.shape_);
+    if (param_.is_multiply) {
+      BackwardData<correlation::mul>(s, req, grad_data1, grad_data2, data1, data2, out_g, geo);
+    } else {
+      BackwardData<correlation::absdiff>(s, req, grad_data1, grad_data2, data1, data2, out_g,
+                                         geo);
+    }
   }
 
  private:
-    CorrelationParam param_;
-    int paddedbottomheight;
-    int paddedbottomwidth;
-    uint32_t kernel_radius_;
-    uint32_t border_size_;
-    uint32_t stride1;
-    uint32_t stride2;
-    uint32_t top_width_;
-    uint32_t top_height_;
-    uint32_t neighborhood_grid_radius_;
-    uint32_t neighborhood_grid_width_;
-    uint32_t top_channels_;
-    int  num;
-    int  channels;
-    int  height;
-    int  width;
+  template<typename OP>
+  void BackwardData(mshadow::Stream<xpu> *s, const std::vector<OpReqType> &req,
+                    const mshadow::Tensor<xpu, 4> &grad_data1,
+                    const mshadow::Tensor<xpu, 4> &grad_data2,
+                    const mshadow::Tensor<xpu, 4> &data1,
+                    const mshadow::Tensor<xpu, 4> &data2,
+                    const mshadow::Tensor<xpu, 4> &out_g,
+                    const CorrelationGeometry &geo) {
+    using namespace mxnet_op;
+    const int count = data1.shape_.Size();
+    MXNET_ASSIGN_REQ_SWITCH(req[Correlation::kData1], Req, {
+      Kernel<correlation::backward<Req, OP, true>, xpu>::Launch(s, count,
+        grad_data1.dptr_, data1.dptr_, data2.dptr_, out_g.dptr_, geo);
+    });
+    MXNET_ASSIGN_REQ_SWITCH(req[Correlation::kData2], Req, {
+      Kernel<correlation::backward<Req, OP, false>, xpu>::Launch(s, count,
+        grad_data2.dptr_, data1.dptr_, data2.dptr_, out_g.dptr_, geo);
+    });
+  }
+
+  CorrelationParam param_;
 };   //  class CorrelationOp
 //  Decalre Factory function
 template<typename xpu>
@@ -170,13 +275,7 @@ class CorrelationProp : public OperatorProperty {
     return {"data1", "data2"};
   }
   std::vector<std::string> ListOutputs() const override {
-    return {"output", "tmp1", "tmp2"};
-  }
-  int NumOutputs() const override {
-    return 3;
-  }
-  int NumVisibleOutputs() const override {
-    return 1;
+    return {"output"};
   }
 void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
     param_.Init(kwargs);
@@ -193,38 +292,14 @@ void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) overr
     TShape dshape2 = in_shape->at(Correlation::kData2);
     CHECK_EQ(dshape1.ndim(), 4U) << "data should be a 4D tensor";
     CHECK_EQ(dshape2.ndim(), 4U) << "data should be a 4D tensor";
-    int paddedbottomheight;
-    int paddedbottomwidth;
-    uint32_t kernel_radius_;
-    uint32_t stride1;
-    uint32_t stride2;
-    uint32_t top_width_;
-    uint32_t top_height_;
-    uint32_t neighborhood_grid_radius_;
-    uint32_t neighborhood_grid_width_;
-    uint32_t top_channels_;
-    uint32_t border_size_;
-    paddedbottomheight = dshape1[2] + 2*param_.pad_size;
-    paddedbottomwidth  = dshape1[3] + 2*param_.pad_size;
-    kernel_radius_ = (param_.kernel_size -1)/2;
-    border_size_ = param_.max_displacement + kernel_radius_;
-    stride1 = param_.stride1;
-    stride2 = param_.stride2;
-    top_width_ = ceil(static_cast<float>(paddedbottomwidth - border_size_ * 2)\
-     / static_cast<float>(stride1));
-    top_height_ = ceil(static_cast<float>(paddedbottomheight - border_size_ * 2)\
-     / static_cast<float>(stride1));
-    neighborhood_grid_radius_ = param_.max_displacement / stride2;
-    neighborhood_grid_width_ = neighborhood_grid_radius_ * 2 + 1;
-    top_channels_ = neighborhood_grid_width_ * neighborhood_grid_width_;
-    CHECK_GE(top_width_, 1U) <<
+    CHECK_EQ(dshape1, dshape2) << "data1 and data2 should have the same shape";
+    const CorrelationGeometry geo = MakeCorrelationGeometry(param_, dshape1);
+    CHECK_GE(geo.top_width, 1) <<
     "Correlation cannot be done with current settings.Neighborhood and kernel don't fit in blob";
-    CHECK_GE(top_height_, 1U) <<
+    CHECK_GE(geo.top_height, 1) <<
     "Correlation cannot be done with current settings.Neighborhood and kernel don't fit in blob";
     out_shape->clear();
-    out_shape->push_back(Shape4(dshape1[0], top_channels_, top_height_, top_width_));
-    out_shape->push_back(Shape4(dshape1[0], paddedbottomheight, paddedbottomwidth, dshape1[1]));
-    out_shape->push_back(Shape4(dshape1[0], paddedbottomheight, paddedbottomwidth, dshape1[1]));
+    out_shape->push_back(Shape4(dshape1[0], geo.top_channels, geo.top_height, geo.top_width));
     return true;
   }
   OperatorProperty* Copy() const override {
@@ -241,7 +316,7 @@ void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) overr
     const std::vector<int> &in_data,
     const std::vector<int> &out_data) const override {
      return {out_grad[Correlation::kOut],
-     out_data[Correlation::kTemp1], out_data[Correlation::kTemp2]};
+     in_data[Correlation::kData1], in_data[Correlation::kData2]};
 }
   Operator* CreateOperator(Context ctx) const override;
 
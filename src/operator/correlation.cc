@@ -23,125 +23,90 @@
  * \author Xu Dong
 */
 #include "./correlation-inl.h"
+#include <algorithm>
 #include "./mshadow_op.h"
 
 namespace mshadow {
-template<typename Dtype>
-void AddPad(const Tensor<cpu, 4, Dtype> &original,
-            const Tensor<cpu, 4, Dtype> &out,
-            int pad_size)
-{ for (index_t nbatch = 0 ; nbatch < original.size(0) ; nbatch++)
-  for (index_t channel = 0 ; channel < original.size(1) ; channel++)
-    for (index_t h = 0 ; h < original.size(2) ; h++)
-      for (index_t w = 0 ; w < original.size(3) ; w++)
-         out[nbatch][h+pad_size][w+pad_size][channel] = original[nbatch][channel][h][w];
+/*!
+ * \brief the correlation of a row of an output channel, added up one row of the
+ *  patches after another so that the positions of the row are done together.
+ */
+template<typename OP, typename Dtype>
+inline void CorrelationRow(Dtype *top, const Dtype *data1, const Dtype *data2,
+                           const mxnet::op::CorrelationGeometry &geo,
+                           int nbatch, int top_channel, int i) {
+  using mxnet::op::correlation::CeilDiv;
+  const int s2o = (top_channel % geo.grid_width - geo.grid_radius) * geo.stride2;
+  const int s2p = (top_channel / geo.grid_width - geo.grid_radius) * geo.stride2;
+  const int plane = geo.height * geo.width;
+  std::fill(top, top + geo.top_width, Dtype(0));
+  for (int h = 0; h < geo.kernel_size; ++h) {
+    const int y1 = i * geo.stride1 + geo.max_displacement + h - geo.pad_size;
+    const int y2 = y1 + s2p;
+    const bool in1 = y1 >= 0 && y1 < geo.height;
+    const bool in2 = y2 >= 0 && y2 < geo.height;
+    // both pixels are in the padding, which compares to 0
+    if (!in1 && !in2) continue;
+    for (int w = 0; w < geo.kernel_size; ++w) {
+      const int off1 = geo.max_displacement + w - geo.pad_size;
+      const int off2 = off1 + s2o;
+      // the positions j whose two pixels j * stride1 + off are both in the images
+      int jbegin = 0, jend = 0;
+      if (in1 && in2) {
+        jbegin = std::max(std::max(CeilDiv(-off1, geo.stride1), CeilDiv(-off2, geo.stride1)), 0);
+        jend = std::min(std::min(CeilDiv(geo.width - off1, geo.stride1),
+                                 CeilDiv(geo.width - off2, geo.stride1)), geo.top_width);
+        jend = std::max(jend, jbegin);
+      }
+      for (int channel = 0; channel < geo.channels; ++channel) {
+        const int offset = (nbatch * geo.channels + channel) * plane;
+        const Dtype *row1 = data1 + offset + y1 * geo.width;
+        const Dtype *row2 = data2 + offset + y2 * geo.width;
+        for (int j = jbegin; j < jend; ++j) {
+          top[j] += OP::Map(row1[j * geo.stride1 + off1], row2[j * geo.stride1 + off2]);
+        }
+        for (int j = 0; j < geo.top_width; ++j) {
+          if (j == jbegin) j = jend;
+          if (j >= geo.top_width) break;
+          const int x1 = j * geo.stride1 + off1;
+          const int x2 = j * geo.stride1 + off2;
+          const Dtype a = (in1 && x1 >= 0 && x1 < geo.width) ? row1[x1] : Dtype(0);
+          const Dtype b = (in2 && x2 >= 0 && x2 < geo.width) ? row2[x2] : Dtype(0);
+          top[j] += OP::Map(a, b);
+        }
+      }
+    }
+  }
+  const Dtype scale = Dtype(1) / (geo.kernel_size * geo.kernel_size * geo.channels);
+  for (int j = 0; j < geo.top_width; ++j) {
+    top[j] *= scale;
+  }
 }
+
 template<typename Dtype>
 inline void CorrelationForward(const Tensor<cpu, 4, Dtype> &out,
                                const Tensor<cpu, 4, Dtype> &data1,
                                const Tensor<cpu, 4, Dtype> &data2,
-                               const Tensor<cpu, 4, Dtype> &tmp1,
-                               const Tensor<cpu, 4, Dtype> &tmp2,
-                               int top_channels_, int top_height_, int top_width_,
-                               int pad_size_, bool is_multiply,
-                               int max_displacement_, int kernel_size_,
-                               int neighborhood_grid_radius_, int neighborhood_grid_width_,
-                               int  kernel_radius_, int stride1_, int stride2_) {
-  const index_t bnum = data1.size(0);
-  const int bchannels = data1.size(1);
-  const int sumelems = kernel_size_ * kernel_size_ * bchannels;
-  AddPad<Dtype>(data1, tmp1, pad_size_);
-  index_t top_channels_unsigned_ = static_cast<index_t>(top_channels_);
-  AddPad<Dtype>(data2, tmp2, pad_size_);
-  for (index_t i = 0 ; i < static_cast<index_t>(top_height_) ; i++)
-      for (index_t j = 0 ; j < static_cast<index_t>(top_width_); j++)
-        for (index_t nbatch = 0 ; nbatch < bnum ; nbatch++) {
-            int x1 = j*stride1_+max_displacement_;
-            int y1 = i*stride1_+max_displacement_;
-            for (index_t top_channel = 0 ; top_channel < top_channels_unsigned_ ; top_channel++) {
-              int s2o = (top_channel % neighborhood_grid_width_ -\
-                         neighborhood_grid_radius_) * stride2_;
-              int s2p = (top_channel / neighborhood_grid_width_ -\
-                         neighborhood_grid_radius_) * stride2_;
-              int x2 = x1 + s2o;
-              int y2 = y1 + s2p;
-              for (index_t h = 0; h < static_cast<index_t>(kernel_size_); h++)
-                for (index_t w = 0; w < static_cast<index_t>(kernel_size_); w++)
-                  for (index_t channel = 0; channel < static_cast<index_t>(bchannels); channel++) {
-                    if (is_multiply == true)
-                        out[nbatch][top_channel][i][j] += \
-                        tmp1[nbatch][y1+h][x1+w][channel]*tmp2[nbatch][y2+h][x2+w][channel];
-                    else
-                        out[nbatch][top_channel][i][j] += \
-                        fabsf(tmp1[nbatch][y1+h][x1+w][channel]-tmp2[nbatch][y2+h][x2+w][channel]);
-                  }
-              out[nbatch][top_channel][i][j] /= sumelems;
-            }
-        }
-}
-template<typename Dtype>
-inline void CorrelationBackward(const Tensor<cpu, 4, Dtype> &out_grad,
-                                const Tensor<cpu, 4, Dtype> &in_grad1,
-                                const Tensor<cpu, 4, Dtype> &in_grad2,
-                                const Tensor<cpu, 4, Dtype> &tmp1,
-                                const Tensor<cpu, 4, Dtype> &tmp2,
-                                int top_channels_, int top_height_,
-                                int top_width_, int pad_size_,
-                                bool is_multiply, int max_displacement_,
-                                int kernel_size_, int neighborhood_grid_radius_,
-                                int neighborhood_grid_width_,
-                                int  kernel_radius_, int stride1_,
-                                int stride2_, int num,
-                                int channels, int height, int width
-                            ) {
-  const float sumelems = kernel_size_ * kernel_size_ * channels;
-  for (index_t i = 0 ; i < static_cast<index_t>(top_height_) ; i++)
-     for (index_t j = 0 ; j < static_cast<index_t>(top_width_); j++)
-        for (index_t nbatch = 0 ; nbatch < static_cast<index_t>(num) ; nbatch++) {
-            int x1 = j*stride1_+max_displacement_;
-            int y1 = i*stride1_+max_displacement_;
-            for (int top_channel = 0 ; top_channel < top_channels_ ; top_channel++) {
-              int s2o = (top_channel % neighborhood_grid_width_ - \
-              neighborhood_grid_radius_) * stride2_;
-              int s2p = (top_channel / neighborhood_grid_width_ - \
-              neighborhood_grid_radius_) * stride2_;
-              int x2 = x1 + s2o;
-              int y2 = y1 + s2p;
-              for (int h = 0; h < kernel_size_; h++)
-                for (int w = 0; w < kernel_size_; w++)
-                  for (int channel = 0 ; channel < channels; channel++) {
-                    if (is_multiply == true) {
-                      if ((y1 +  h - pad_size_ >= 0) && (x1 + w - pad_size_ >= 0) && \
-                      (y1 + h < height +pad_size_) && (x1 + w < width + pad_size_)) {
-                        in_grad1[nbatch][channel][y1+h-pad_size_][x1+w-pad_size_] += \
-                        out_grad[nbatch][top_channel][i][j] * \
-                        tmp2[nbatch][y2+h][x2+w][channel]/sumelems;
-                       }
-                       if ((y2 +  h - pad_size_ >= 0) && (x2 + w -pad_size_ >=0) && \
-                       (y2 + h < height +pad_size_) && (x2 + w < width + pad_size_)) {
-                       in_grad2[nbatch][channel][y2+h-pad_size_][x2+w-pad_size_] += \
-                       out_grad[nbatch][top_channel][i][j] * \
-                       tmp1[nbatch][y1+h][x1+w][channel]/sumelems;
-                       }
-                    } else {
-                      if ((y1 +  h - pad_size_ >= 0) && (x1 + w -pad_size_ >=0) && \
-                      (y1 + h < height + pad_size_) && (x1 + w < width + pad_size_)) {
-                        Dtype sign  = (tmp1[nbatch][y1+h][x1+w][channel] >= \
-                        tmp2[nbatch][y2+h][x2+w][channel])? Dtype(1.0) : Dtype(-1.0);
-                        in_grad1[nbatch][channel][y1+h-pad_size_][x1+w-pad_size_] +=\
-                        out_grad[nbatch][top_channel][i][j]*sign/sumelems;
-                      }
-                      if ((y2 +  h - pad_size_ >= 0) && (x2 + w - pad_size_ >=0) && \
-                      (y2 + h < height + pad_size_) && (x2 + w < width + pad_size_)) {
-                        Dtype sign  = (tmp1[nbatch][y1+h][x1+w][channel] >= \
-                        tmp2[nbatch][y2+h][x2+w][channel])? Dtype(-1.0) : Dtype(1.0);
-                        in_grad2[nbatch][channel][y2+h-pad_size_][x2+w-pad_size_] +=\
-                        out_grad[nbatch][top_channel][i][j]*sign/sumelems;
-                       }
-                    }
-                  }
-               }
-         }
+                               const mxnet::op::CorrelationGeometry &geo,
+                               bool is_multiply) {
+  using namespace mxnet::op;
+  // the rows of the output channels are split between the threads
+  const int rows = geo.num * geo.top_channels * geo.top_height;
+  const int nthread = mxnet_op::KernelNumThreads(rows, 4);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int row = 0; row < rows; ++row) {
+    const int i = row % geo.top_height;
+    const int top_channel = (row / geo.top_height) % geo.top_channels;
+    const int nbatch = row / geo.top_height / geo.top_channels;
+    Dtype *top = out.dptr_ + static_cast<size_t>(row) * geo.top_width;
+    if (is_multiply) {
+      CorrelationRow<correlation::mul>(top, data1.dptr_, data2.dptr_, geo,
+                                       nbatch, top_channel, i);
+    } else {
+      CorrelationRow<correlation::absdiff>(top, data1.dptr_, data2.dptr_, geo,
+                                           nbatch, top_channel, i);
+    }
+  }
 }
 }  // namespace mshadow
 namespace mxnet {
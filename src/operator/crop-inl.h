@@ -33,6 +33,7 @@
 #include <vector>
 #include <utility>
 #include "./operator_common.h"
+#include "./mxnet_op.h"
 
 namespace mxnet {
 namespace op {
@@ -42,6 +43,41 @@ enum CropOpInputs {kData, kCropLike};
 enum CropOpOutputs {kOut};
 }  // namespace crop_enum
 
+namespace crop {
+/*! \brief copy the row i of out from the window of data at (offset_h, offset_w) */
+struct window {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType *out, const DType *data,
+                                  const int out_h, const int out_w,
+                                  const int in_h, const int in_w,
+                                  const int offset_h, const int offset_w) {
+    const DType *src = data + ((i / out_h) * in_h + i % out_h + offset_h) * in_w + offset_w;
+    DType *dst = out + i * out_w;
+    for (int w = 0; w < out_w; ++w) dst[w] = src[w];
+  }
+};
+
+/*! \brief write the row i of gdata: the row of grad in the window, zeros around it */
+struct window_grad {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType *gdata, const DType *grad,
+                                  const int out_h, const int out_w,
+                                  const int in_h, const int in_w,
+                                  const int offset_h, const int offset_w) {
+    const int h = i % in_h - offset_h;
+    DType *dst = gdata + i * in_w;
+    if (h < 0 || h >= out_h) {
+      for (int w = 0; w < in_w; ++w) dst[w] = 0;
+      return;
+    }
+    const DType *src = grad + ((i / in_h) * out_h + h) * out_w;
+    for (int w = 0; w < offset_w; ++w) dst[w] = 0;
+    for (int w = 0; w < out_w; ++w) dst[offset_w + w] = src[w];
+    for (int w = offset_w + out_w; w < in_w; ++w) dst[w] = 0;
+  }
+};
+}  // namespace crop
+
 struct CropParam : public dmlc::Parameter<CropParam> {
   int num_args;
   TShape offset;
@@ -84,7 +120,10 @@ class CropOp : public Operator {
     Tensor<xpu, 4> data = in_data[crop_enum::kData].get<xpu, 4, real_t>(s);
     Tensor<xpu, 4> out = out_data[crop_enum::kOut].get<xpu, 4, real_t>(s);
     offset_hw_ = InferCropOfferset(data.shape_, out.shape_);
-    out = crop(data, Shape2(out.size(2), out.size(3)), offset_hw_[0], offset_hw_[1]);
+    // one row of the output at a time
+    mxnet_op::Kernel<crop::window, xpu>::Launch(s, out.size(0) * out.size(1) * out.size(2),
+      out.dptr_, data.dptr_, out.size(2), out.size(3), data.size(2), data.size(3),
+      offset_hw_[0], offset_hw_[1]);
   }
 
   // because the crop_like input is only used with it's shape, so we should be
@@ -111,9 +150,10 @@ class CropOp : public Operator {
       gcrop_like = (real_t)0.0f;
     }
     offset_hw_ = InferCropOfferset(gdata.shape_, grad.shape_);
-    gdata = (real_t)0.0f;
-    slice<3>(slice<2>(gdata, offset_hw_[0], offset_hw_[0]+grad.size(2)),
-             offset_hw_[1], offset_hw_[1]+grad.size(3)) = grad;
+    // one row of the data gradient at a time, written once with zeros around the window
+    mxnet_op::Kernel<crop::window_grad, xpu>::Launch(s,
+      gdata.size(0) * gdata.size(1) * gdata.size(2), gdata.dptr_, grad.dptr_,
+      grad.size(2), grad.size(3), gdata.size(2), gdata.size(3), offset_hw_[0], offset_hw_[1]);
   }
 
  private:
@@ -61,6 +61,37 @@ class CuDNNAlgo {
   bool is_tensor_core_algo_;
 };
 
+/*!
+ * \brief The workspace in bytes the algorithms of a cuDNN convolution may use.
+ *  With MXNET_CUDNN_WORKSPACE_AUTO it is the free memory of the gpu, less the
+ *  reserve of the memory pool and the arrays planned by the binds, split among
+ *  the MXNET_GPU_TEMP_COPY copies of the temp space. As all the layers of a gpu
+ *  share the temp space, whose size is the largest workspace asked for, each
+ *  layer may take the whole budget. It is rounded down to a power of two so that
+ *  the layers selected with close budgets share their entries of the registry.
+ * \param dev_id The device index of the gpu.
+ * \param param_byte The workspace given by the parameters of the layer.
+ */
+inline size_t CuDNNWorkspaceByte(int dev_id, size_t param_byte) {
+  static const bool automatic = dmlc::GetEnv("MXNET_CUDNN_WORKSPACE_AUTO", false);
+  if (!automatic) return param_byte;
+  static const int reserve = dmlc::GetEnv("MXNET_GPU_MEM_POOL_RESERVE", 5);
+  static const int ncopy = std::max(dmlc::GetEnv("MXNET_GPU_TEMP_COPY", 1), 1);
+  int cur_dev = 0;
+  CUDA_CALL(cudaGetDevice(&cur_dev));
+  CUDA_CALL(cudaSetDevice(dev_id));
+  size_t free = 0, total = 0;
+  CUDA_CALL(cudaMemGetInfo(&free, &total));
+  CUDA_CALL(cudaSetDevice(cur_dev));
+  const int64_t avail = static_cast<int64_t>(free) - static_cast<int64_t>(total / 100) * reserve
+                        - PlannedGPUMemory(dev_id);
+  if (avail <= 0) return 0;
+  size_t budget = static_cast<size_t>(avail) / ncopy;
+  size_t byte = 1;
+  while (byte <= budget / 2) byte *= 2;
+  return budget == 0 ? 0 : byte;
+}
+
 class CuDNNAlgoReg {
  public:
   template <typename Param>
@@ -123,6 +154,7 @@ class CuDNNAlgoReg {
     reg_[key].fwd = fwd;
     reg_[key].bwd = bwd;
     reg_[key].flt = flt;
+    if (!cache_file_.empty()) AppendToCache(key, reg_[key]);
   }
 
   static CuDNNAlgoReg *Get();
@@ -133,9 +165,18 @@ class CuDNNAlgoReg {
     CuDNNAlgo<cudnnConvolutionBwdDataAlgo_t> bwd;
     CuDNNAlgo<cudnnConvolutionBwdFilterAlgo_t> flt;
   };
+  /*!
+   * \brief load the selections saved in the cache file, if any.
+   *  The cache is given by MXNET_CUDNN_AUTOTUNE_CACHE.
+   */
+  CuDNNAlgoReg();
+  /*! \brief append a selection to the cache file, lock_ must be held */
+  void AppendToCache(const std::string &key, const CudnnAlgorithms &algos);
 
   std::mutex lock_;
   std::unordered_map<std::string, CudnnAlgorithms> reg_;
+  /*! \brief path of the persistent cache, empty if disabled */
+  std::string cache_file_;
 };
 #endif  // __CUDACC__ && CUDNN
 }  // namespace op
@@ -23,9 +23,11 @@
  * \author Junyuan Xie
 */
 #include "./cudnn_algoreg-inl.h"
+#include <dmlc/parameter.h>
 #include <mxnet/base.h>
 #include <mxnet/ndarray.h>
 
+#include <fstream>
 #include <sstream>
 #include <unordered_map>
 
@@ -36,6 +38,53 @@ CuDNNAlgoReg *CuDNNAlgoReg::Get() {
   static CuDNNAlgoReg *ptr = new CuDNNAlgoReg();
   return ptr;
 }
+
+/*
+ * The cache file has one selection per line:
+ *   <cudnn version>\t<key>\t<fwd> <fwd tc> <bwd> <bwd tc> <flt> <flt tc>
+ * New selections are appended, so that several processes can share one file,
+ * and a later line overrides an earlier one with the same key.
+ * Lines from another cuDNN version are ignored.
+ */
+CuDNNAlgoReg::CuDNNAlgoReg() {
+  cache_file_ = dmlc::GetEnv("MXNET_CUDNN_AUTOTUNE_CACHE", std::string());
+  if (cache_file_.empty()) return;
+  std::ifstream is(cache_file_);
+  if (!is.good()) return;
+  std::string line;
+  size_t num_loaded = 0;
+  while (std::getline(is, line)) {
+    size_t first = line.find('\t');
+    size_t last = line.rfind('\t');
+    if (first == std::string::npos || first == last) continue;
+    if (line.substr(0, first) != std::to_string(CUDNN_VERSION)) continue;
+    std::istringstream algos(line.substr(last + 1));
+    int fwd, bwd, flt;
+    bool fwd_tc, bwd_tc, flt_tc;
+    if (!(algos >> fwd >> fwd_tc >> bwd >> bwd_tc >> flt >> flt_tc)) continue;
+    CudnnAlgorithms &entry = reg_[line.substr(first + 1, last - first - 1)];
+    entry.fwd.Set(static_cast<cudnnConvolutionFwdAlgo_t>(fwd), fwd_tc);
+    entry.bwd.Set(static_cast<cudnnConvolutionBwdDataAlgo_t>(bwd), bwd_tc);
+    entry.flt.Set(static_cast<cudnnConvolutionBwdFilterAlgo_t>(flt), flt_tc);
+    ++num_loaded;
+  }
+  LOG(INFO) << "Loaded " << num_loaded << " cuDNN convolution algorithm selections from "
+            << cache_file_;
+}
+
+void CuDNNAlgoReg::AppendToCache(const std::string &key, const CudnnAlgorithms &algos) {
+  std::ofstream os(cache_file_, std::ios::app);
+  if (!os.good()) {
+    LOG(WARNING) << "Cannot write cuDNN autotune cache " << cache_file_
+                 << ", algorithm selections will not be saved";
+    cache_file_.clear();
+    return;
+  }
+  os << CUDNN_VERSION << '\t' << key << '\t'
+     << algos.fwd.AlgoNumber() << ' ' << algos.fwd.IsTensorCoreAlgo() << ' '
+     << algos.bwd.AlgoNumber() << ' ' << algos.bwd.IsTensorCoreAlgo() << ' '
+     << algos.flt.AlgoNumber() << ' ' << algos.flt.IsTensorCoreAlgo() << '\n';
+}
 #endif  // CUDNN
 }  // namespace op
 }  // namespace mxnet
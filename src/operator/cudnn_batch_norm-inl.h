@@ -30,6 +30,7 @@
 #include <string>
 #include <utility>
 #include "batch_norm-inl.h"
+#include "./mxnet_op.h"
 
 namespace mxnet {
 namespace op {
@@ -70,7 +71,7 @@ class CuDNNBatchNormOp : public Operator {
                        const std::vector<TBlob> &aux_states) {
     using namespace mshadow;
     using namespace mshadow::expr;
-    CHECK_EQ(in_data.size(), 3U);
+    CHECK_EQ(in_data.size(), param_.num_args());
     CHECK_EQ(aux_states.size(), 2U);
     if (ctx.is_train) {
       CHECK_EQ(out_data.size(), 3U);
@@ -174,6 +175,14 @@ class CuDNNBatchNormOp : public Operator {
                                                            param_.eps));
       }
     })
+    if (param_.fused()) {
+      // cuDNN fuses the addend and the activation only for NHWC half data with
+      // cudnnBatchNormalizationForwardTrainingEx, they take one more pass here
+      mxnet_op::Kernel<batchnorm::AddActivation, gpu>::Launch(
+        s, y.shape_.Size(), y.dptr_,
+        param_.fuse_add ? in_data[batchnorm::kAddend].dptr<DType>() : nullptr,
+        param_.act_type == batchnorm::kReLU);
+    }
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -186,9 +195,9 @@ class CuDNNBatchNormOp : public Operator {
     using namespace mshadow;
     using namespace mshadow::expr;
     CHECK_EQ(out_grad.size(), 1U);
-    CHECK_EQ(in_data.size(), 3U);
+    CHECK_EQ(in_data.size(), param_.num_args());
     CHECK_EQ(out_data.size(), 3U);
-    CHECK_EQ(in_grad.size(), 3U);
+    CHECK_EQ(in_grad.size(), param_.num_args());
     CHECK(ctx.is_train && !param_.use_global_stats)
         << "use global statistics is not yet supported in CuDNNBatchNorm";
 
@@ -199,6 +208,9 @@ class CuDNNBatchNormOp : public Operator {
       in_grad[cudnnbatchnorm::kData].get_with_shape<gpu, 4, DType>(shape_, s);
     Tensor<gpu, 4, DType> dy =
       out_grad[cudnnbatchnorm::kOut].get_with_shape<gpu, 4, DType>(shape_, s);
+    if (param_.fused()) {
+      dy.dptr_ = FusedGrad(ctx, out_grad, out_data, req, in_grad);
+    }
 
 #if CUDNN_VERSION >= 4007
 #if CUDNN_VERSION >= 7000
@@ -289,6 +301,45 @@ class CuDNNBatchNormOp : public Operator {
   }
 
  private:
+  /*!
+   * \brief the gradient before the addend and the activation, which is
+   *  also the one of the addend. It is written to the gradient of the
+   *  addend if that is not added to, to the workspace otherwise.
+   */
+  DType *FusedGrad(const OpContext &ctx,
+                   const std::vector<TBlob> &out_grad,
+                   const std::vector<TBlob> &out_data,
+                   const std::vector<OpReqType> &req,
+                   const std::vector<TBlob> &in_grad) {
+    using namespace mshadow;
+    using namespace mxnet_op;
+    Stream<gpu> *s = ctx.get_stream<gpu>();
+    const bool relu = param_.act_type == batchnorm::kReLU;
+    const OpReqType addend_req = param_.fuse_add ? req[batchnorm::kAddend] : kNullOp;
+    const int n = shape_.Size();
+    DType *dy = out_grad[cudnnbatchnorm::kOut].dptr<DType>();
+    const DType *y = relu ? out_data[cudnnbatchnorm::kOut].dptr<DType>() : nullptr;
+    if (!relu) {
+      MXNET_ASSIGN_REQ_SWITCH(addend_req, Req, {
+        Kernel<batchnorm::ReLUGrad<Req>, gpu>::Launch(
+          s, n, in_grad[batchnorm::kAddend].dptr<DType>(), dy, y);
+      });
+      return dy;
+    }
+    DType *grad = nullptr;
+    if (addend_req == kWriteTo || addend_req == kWriteInplace) {
+      grad = in_grad[batchnorm::kAddend].dptr<DType>();
+    } else {
+      grad = ctx.requested[0].get_space_typed<gpu, 1, DType>(Shape1(n), s).dptr_;
+    }
+    Kernel<batchnorm::ReLUGrad<kWriteTo>, gpu>::Launch(s, n, grad, dy, y);
+    if (addend_req == kAddTo) {
+      Kernel<batchnorm::ReLUGrad<kAddTo>, gpu>::Launch(
+        s, n, in_grad[batchnorm::kAddend].dptr<DType>(), grad, nullptr);
+    }
+    return grad;
+  }
+
   bool init_cudnn_;
   cudnnDataType_t dtype_;
   int dtype_param_;
@@ -307,6 +358,7 @@ class CuDNNBatchNormProp : public OperatorProperty {
  public:
   void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
     param_.Init(kwargs);
+    CHECK(!param_.fused()) << "CuDNNBatchNorm has no addend nor activation, use BatchNorm";
   }
 
   std::map<std::string, std::string> GetParams() const override {
@@ -315,11 +315,11 @@ class CuDNNConvolutionOp : public Operator {
                        const Context &ctx) {
     using namespace mshadow;
 
-    // NDHWC not supported, NHWC not supported in true fp16
+    // NDHWC not supported, NHWC not supported in true fp16 before v7
     auto layout_val = param.layout.value();
     auto true_fp16 = DataType<DType>::kFlag == kFloat16 &&
       (forward_compute_type == kFloat16 || backward_compute_type == kFloat16);
-    if (layout_val == kNDHWC || layout_val == kNHWC && true_fp16)
+    if (layout_val == kNDHWC || (layout_val == kNHWC && true_fp16 && CUDNN_MAJOR < 7))
       return false;
 
     // Permits graceful fallback to pseudo-fp16 on heterogenous systems
@@ -580,7 +580,12 @@ class CuDNNConvolutionOp : public Operator {
                   const std::vector<TShape>& out_shape,
                   cudnnDataType_t cudnn_forward_compute_type,
                   cudnnDataType_t cudnn_backward_compute_type) {
-    std::string key = CuDNNAlgoReg::Get()->GetKey(param_, in_shape, out_shape, dtype_,
+    // the workspace may be sized by the free memory, the selections are kept by it
+    const size_t workspace_byte =
+        CuDNNWorkspaceByte(ctx.dev_id, static_cast<size_t>(param_.workspace * sizeof(DType)));
+    ConvolutionParam key_param = param_;
+    key_param.workspace = workspace_byte / sizeof(DType);
+    std::string key = CuDNNAlgoReg::Get()->GetKey(key_param, in_shape, out_shape, dtype_,
                                                   cudnn_forward_compute_type,
                                                   cudnn_backward_compute_type,
                                                   SMArch(ctx.dev_id));
@@ -590,7 +595,6 @@ class CuDNNConvolutionOp : public Operator {
       Engine::Get()->PushSync([=](RunContext rctx) {
         mshadow::Stream<gpu> *s = rctx.get_stream<gpu>();
         CHECK_EQ(s->dnn_handle_ownership_, mshadow::Stream<gpu>::OwnHandle);
-        size_t workspace_byte = static_cast<size_t>(param_.workspace * sizeof(DType));
         #if CUDNN_MAJOR >= 7
           // Starting with cuDNNv7, the algo number returned by *Get*() is not the entire
           // story: the notion of whether the algo ran in Tensor Core mode is not known.
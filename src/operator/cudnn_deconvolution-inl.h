@@ -598,7 +598,12 @@ class CuDNNDeconvolutionOp : public Operator {
                   const std::vector<TShape>& out_shape,
                   cudnnDataType_t cudnn_forward_compute_type,
                   cudnnDataType_t cudnn_backward_compute_type) {
-    std::string key = CuDNNAlgoReg::Get()->GetKey(param_, in_shape, out_shape, dtype_,
+    // the workspace may be sized by the free memory, the selections are kept by it
+    const size_t workspace_byte =
+        CuDNNWorkspaceByte(ctx.dev_id, static_cast<size_t>(param_.workspace * sizeof(DType)));
+    DeconvolutionParam key_param = param_;
+    key_param.workspace = workspace_byte / sizeof(DType);
+    std::string key = CuDNNAlgoReg::Get()->GetKey(key_param, in_shape, out_shape, dtype_,
                                                   cudnn_forward_compute_type,
                                                   cudnn_backward_compute_type,
                                                   SMArch(ctx.dev_id));
@@ -608,7 +613,6 @@ class CuDNNDeconvolutionOp : public Operator {
       Engine::Get()->PushSync([=](RunContext rctx) {
         mshadow::Stream <gpu> *s = rctx.get_stream<gpu>();
         CHECK_EQ(s->dnn_handle_ownership_, mshadow::Stream<gpu>::OwnHandle);
-        size_t workspace_byte = static_cast<size_t>(param_.workspace * sizeof(DType));
         #if CUDNN_MAJOR >= 7
           // Starting with cuDNNv7, the algo number returned by *Get*() is not the entire
           // story: the notion of whether the algo ran in Tensor Core mode is not known.
@@ -28,6 +28,7 @@
 #include <mxnet/storage.h>
 #include <vector>
 #include <map>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <cstdint>
@@ -36,12 +37,57 @@
 namespace mxnet {
 namespace op {
 #if defined(__CUDACC__) && MXNET_USE_CUDNN == 1 && CUDNN_MAJOR >= 5
+/*!
+ * \brief The dropout states of the cuDNN RNNs kept across binds. Setting up
+ *  the states runs a kernel over them, an RNN created again, e.g. by a new bind,
+ *  takes the states released by a deleted one instead, and with cuDNN 7 only
+ *  restores its descriptor on them.
+ */
+class CuDNNDropoutStates {
+ public:
+  static CuDNNDropoutStates* Get() {
+    static CuDNNDropoutStates* inst = new CuDNNDropoutStates();
+    return inst;
+  }
+  /*!
+   * \brief take states of size bytes on the gpu dev_id.
+   * \param initialized whether the states were set up by a previous RNN.
+   */
+  Storage::Handle Acquire(int dev_id, size_t size, bool* initialized) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto& free = free_[dev_id];
+      for (auto it = free.begin(); it != free.end(); ++it) {
+        if (it->size == size) {
+          Storage::Handle states = *it;
+          free.erase(it);
+          *initialized = true;
+          return states;
+        }
+      }
+    }
+    *initialized = false;
+    return Storage::Get()->Alloc(size, Context::GPU(dev_id));
+  }
+  /*! \brief give back the states taken by Acquire */
+  void Release(const Storage::Handle& states) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_[states.ctx.dev_id].push_back(states);
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<int, std::vector<Storage::Handle> > free_;
+};
+
 template<typename DType>
 class CuDNNRNNOp : public Operator {
  public:
   explicit CuDNNRNNOp(RNNParam param) {
     this->param_ = param;
     init_cudnn_ = false;
+    dropout_states_.dptr = nullptr;
+    reserve_space_.dptr = nullptr;
     dtype_ = mshadow::DataType<DType>::kCudnnFlag;
     // TensorCore algos only allowed on fp16-I/O convolutions if permitted by the global policy.
     // No tests in place for fp16 RNNs, so leave TensorCore disabled for now.
@@ -75,30 +121,47 @@ class CuDNNRNNOp : public Operator {
       param_.lstm_q_ = true;
     else
       param_.lstm_q_ = false;
+    // the persistent algorithms keep the weights on chip, for small batches
+    std::string algo = dmlc::GetEnv("MXNET_CUDNN_RNN_ALGO", std::string("standard"));
+    #if CUDNN_MAJOR >= 6
+      rnn_algo_ = CUDNN_RNN_ALGO_STANDARD;
+      if (algo == "persist_static") {
+        rnn_algo_ = CUDNN_RNN_ALGO_PERSIST_STATIC;
+      } else if (algo == "persist_dynamic") {
+        rnn_algo_ = CUDNN_RNN_ALGO_PERSIST_DYNAMIC;
+      } else {
+        CHECK_EQ(algo, "standard") << "MXNET_CUDNN_RNN_ALGO should be standard, "
+                                   << "persist_static or persist_dynamic";
+      }
+    #else
+      LOG_IF(WARNING, algo != "standard")
+        << "MXNET_CUDNN_RNN_ALGO is ignored, the persistent algorithms need cuDNN 6";
+    #endif
   }
 
   ~CuDNNRNNOp() {
-    if (init_cudnn_) {
-      for (size_t i = 0; i < x_desc_vec_.size(); ++i) {
-        CUDNN_CALL(cudnnDestroyTensorDescriptor(x_desc_vec_[i]));
-        CUDNN_CALL(cudnnDestroyTensorDescriptor(y_desc_vec_[i]));
-        CUDNN_CALL(cudnnDestroyTensorDescriptor(dx_desc_vec_[i]));
-        CUDNN_CALL(cudnnDestroyTensorDescriptor(dy_desc_vec_[i]));
+    for (auto& kv : shape_descs_) {
+      ShapeDescs& d = kv.second;
+      for (size_t i = 0; i < d.x.size(); ++i) {
+        CUDNN_CALL(cudnnDestroyTensorDescriptor(d.x[i]));
+        CUDNN_CALL(cudnnDestroyTensorDescriptor(d.y[i]));
+        CUDNN_CALL(cudnnDestroyTensorDescriptor(d.dx[i]));
+        CUDNN_CALL(cudnnDestroyTensorDescriptor(d.dy[i]));
       }
-      CUDNN_CALL(cudnnDestroyTensorDescriptor(hx_desc_));
-      CUDNN_CALL(cudnnDestroyTensorDescriptor(cx_desc_));
-      CUDNN_CALL(cudnnDestroyTensorDescriptor(hy_desc_));
-      CUDNN_CALL(cudnnDestroyTensorDescriptor(cy_desc_));
-      CUDNN_CALL(cudnnDestroyTensorDescriptor(dhx_desc_));
-      CUDNN_CALL(cudnnDestroyTensorDescriptor(dcx_desc_));
-      CUDNN_CALL(cudnnDestroyTensorDescriptor(dhy_desc_));
-      CUDNN_CALL(cudnnDestroyTensorDescriptor(dcy_desc_));
-
+      for (cudnnTensorDescriptor_t desc : d.state) {
+        CUDNN_CALL(cudnnDestroyTensorDescriptor(desc));
+      }
+      #if CUDNN_MAJOR >= 6
+        if (d.plan_init) CUDNN_CALL(cudnnDestroyPersistentRNNPlan(d.plan));
+      #endif
+    }
+    if (init_cudnn_) {
       CUDNN_CALL(cudnnDestroyFilterDescriptor(w_desc_));
+      CUDNN_CALL(cudnnDestroyFilterDescriptor(dw_desc_));
       CUDNN_CALL(cudnnDestroyRNNDescriptor(rnn_desc_));
       CUDNN_CALL(cudnnDestroyDropoutDescriptor(dropout_desc_));
-      Storage::Get()->Free(dropout_states_);
-      Storage::Get()->Free(reserve_space_);
+      if (dropout_states_.dptr != nullptr) CuDNNDropoutStates::Get()->Release(dropout_states_);
+      if (reserve_space_.dptr != nullptr) Storage::Get()->Free(reserve_space_);
     }
   }
 
@@ -139,9 +202,7 @@ class CuDNNRNNOp : public Operator {
     CHECK_EQ(hx.CheckContiguous(), true);
     CHECK_EQ(y.CheckContiguous(), true);
 
-    if (!init_cudnn_) {
-      Init(s, in_data, out_data);
-    }
+    Init(s, in_data, out_data);
     // Get temp space
     int temp_size = workspace_size_;
     Tensor<gpu, 1, DType> temp_space =
@@ -252,9 +313,7 @@ class CuDNNRNNOp : public Operator {
     CHECK_EQ(y.CheckContiguous(), true);
     CHECK_EQ(dy.CheckContiguous(), true);
 
-    if (!init_cudnn_) {
-      Init(s, in_data, out_data);
-    }
+    Init(s, in_data, out_data);
 
     // Get temp space
     int temp_size = workspace_size_;
@@ -306,6 +365,18 @@ class CuDNNRNNOp : public Operator {
   }
 
  private:
+  // the descriptors and sizes of a sequence length and a batch size
+  struct ShapeDescs {
+    std::vector<cudnnTensorDescriptor_t> x, y, dx, dy;
+    // hx, cx, hy, cy, dhx, dcx, dhy, dcy
+    std::vector<cudnnTensorDescriptor_t> state;
+    size_t workspace_byte, reserve_byte;
+    #if CUDNN_MAJOR >= 6
+    bool plan_init{false};
+    cudnnPersistentRNNPlan_t plan;
+    #endif
+  };
+
   inline void Init(mshadow::Stream<gpu> *s,
                    const std::vector<TBlob> &in_data,
                    const std::vector<TBlob> &out_data) {
@@ -320,195 +391,59 @@ class CuDNNRNNOp : public Operator {
 
     CHECK_EQ(in_data.size(), in_expected);
     CHECK_EQ(out_data.size(), out_expected);
-    if (!init_cudnn_) {
+    // get input + output tensors
+    Tensor<gpu, 3, DType> x = in_data[rnn_enum::kData].get<gpu, 3, DType>(s);
+    Tensor<gpu, 1, DType> w = in_data[rnn_enum::kParams].get<gpu, 1, DType>(s);
+    const std::pair<int, int> shape(x.shape_[0], x.shape_[1]);
+    if (init_cudnn_ && shape == cur_shape_) return;
+    const bool first = !init_cudnn_;
+    if (first) {
       init_cudnn_ = true;
-      // get input + output tensors
-      Tensor<gpu, 3, DType> x = in_data[rnn_enum::kData].get<gpu, 3, DType>(s);
-      Tensor<gpu, 1, DType> w = in_data[rnn_enum::kParams].get<gpu, 1, DType>(s);
-      param_.seq_length_ = x.shape_[0];
-      param_.batch_size_ = x.shape_[1];
+      CUDA_CALL(cudaGetDevice(&dev_id_));
       param_.input_size_ = x.shape_[2];
 
-      // Tensor Descriptors
-      std::vector<cudnnTensorDescriptor_t> x_vec(param_.seq_length_);
-      std::vector<cudnnTensorDescriptor_t> y_vec(param_.seq_length_);
-      std::vector<cudnnTensorDescriptor_t> dx_vec(param_.seq_length_);
-      std::vector<cudnnTensorDescriptor_t> dy_vec(param_.seq_length_);
-      int dimA[3];
-      int strideA[3];
-      for (int i = 0; i < param_.seq_length_; i++) {
-        CUDNN_CALL(cudnnCreateTensorDescriptor(&x_vec[i]));
-        CUDNN_CALL(cudnnCreateTensorDescriptor(&y_vec[i]));
-        CUDNN_CALL(cudnnCreateTensorDescriptor(&dx_vec[i]));
-        CUDNN_CALL(cudnnCreateTensorDescriptor(&dy_vec[i]));
-
-        dimA[0] = param_.batch_size_;
-        dimA[1] = param_.input_size_;
-        dimA[2] = 1;
-        dimA[0] = param_.batch_size_;
-        dimA[1] = param_.input_size_;
-        strideA[0] = dimA[2] * dimA[1];
-        strideA[1] = dimA[2];
-        strideA[2] = 1;
-
-        CUDNN_CALL(cudnnSetTensorNdDescriptor(x_vec[i],
-                                              dtype_,
-                                              3,
-                                              dimA,
-                                              strideA));
-        CUDNN_CALL(cudnnSetTensorNdDescriptor(dx_vec[i],
-                                              dtype_,
-                                              3,
-                                              dimA,
-                                              strideA));
-        dimA[0] = param_.batch_size_;
-        dimA[1] = param_.bidirectional ? param_.state_size * 2 : param_.state_size;
-        dimA[2] = 1;
-        strideA[0] = dimA[2] * dimA[1];
-        strideA[1] = dimA[2];
-        strideA[2] = 1;
-
-        CUDNN_CALL(cudnnSetTensorNdDescriptor(y_vec[i],
-                                             dtype_,
-                                             3,
-                                             dimA,
-                                             strideA));
-        CUDNN_CALL(cudnnSetTensorNdDescriptor(dy_vec[i],
-                                              dtype_,
-                                              3,
-                                              dimA,
-                                              strideA));
-      }
-      x_desc_vec_ = x_vec;
-      y_desc_vec_ = y_vec;
-      dx_desc_vec_ = dx_vec;
-      dy_desc_vec_ = dy_vec;
-
-      // set the state tensors
-      dimA[0] = param_.num_layers * (param_.bidirectional ? 2 : 1);
-      dimA[1] = param_.batch_size_;
-      dimA[2] = param_.state_size;
-      strideA[0] = dimA[2] * dimA[1];
-      strideA[1] = dimA[2];
-      strideA[2] = 1;
-
-      CUDNN_CALL(cudnnCreateTensorDescriptor(&hx_desc_));
-      CUDNN_CALL(cudnnCreateTensorDescriptor(&cx_desc_));
-      CUDNN_CALL(cudnnCreateTensorDescriptor(&hy_desc_));
-      CUDNN_CALL(cudnnCreateTensorDescriptor(&cy_desc_));
-      CUDNN_CALL(cudnnCreateTensorDescriptor(&dhx_desc_));
-      CUDNN_CALL(cudnnCreateTensorDescriptor(&dcx_desc_));
-      CUDNN_CALL(cudnnCreateTensorDescriptor(&dhy_desc_));
-      CUDNN_CALL(cudnnCreateTensorDescriptor(&dcy_desc_));
-
-      CUDNN_CALL(cudnnSetTensorNdDescriptor(hx_desc_,
-                                            dtype_,
-                                            3,
-                                            dimA,
-                                            strideA));
-      CUDNN_CALL(cudnnSetTensorNdDescriptor(cx_desc_,
-                                            dtype_,
-                                            3,
-                                            dimA,
-                                            strideA));
-      CUDNN_CALL(cudnnSetTensorNdDescriptor(hy_desc_,
-                                            dtype_,
-                                            3,
-                                            dimA,
-                                            strideA));
-      CUDNN_CALL(cudnnSetTensorNdDescriptor(cy_desc_,
-                                            dtype_,
-                                            3,
-                                            dimA,
-                                            strideA));
-      CUDNN_CALL(cudnnSetTensorNdDescriptor(dhx_desc_,
-                                            dtype_,
-                                            3,
-                                            dimA,
-                                            strideA));
-      CUDNN_CALL(cudnnSetTensorNdDescriptor(dcx_desc_,
-                                            dtype_,
-                                            3,
-                                            dimA,
-                                            strideA));
-      CUDNN_CALL(cudnnSetTensorNdDescriptor(dhy_desc_,
-                                            dtype_,
-                                            3,
-                                            dimA,
-                                            strideA));
-      CUDNN_CALL(cudnnSetTensorNdDescriptor(dcy_desc_,
-                                            dtype_,
-                                            3,
-                                            dimA,
-                                            strideA));
-
-      // Create Dropout descriptors
+      // Create Dropout descriptors, the states are only needed to drop
       CUDNN_CALL(cudnnCreateDropoutDescriptor(&dropout_desc_));
-      CUDNN_CALL(cudnnDropoutGetStatesSize(s->dnn_handle_,
-                                           &dropout_byte_));
-      dropout_size_ = dropout_byte_ / sizeof(DType);
-      dropout_states_ = Storage::Get()->Alloc(dropout_byte_, Context::GPU());
-      CUDNN_CALL(cudnnSetDropoutDescriptor(dropout_desc_,
-                                           s->dnn_handle_,
-                                           param_.p,  // keep probability
-                                           dropout_states_.dptr,
-                                           dropout_byte_,
-                                           seed_));
+      if (param_.p > 0) {
+        CUDNN_CALL(cudnnDropoutGetStatesSize(s->dnn_handle_,
+                                             &dropout_byte_));
+        dropout_size_ = dropout_byte_ / sizeof(DType);
+        bool initialized = false;
+        dropout_states_ = CuDNNDropoutStates::Get()->Acquire(dev_id_, dropout_byte_,
+                                                             &initialized);
+        #if CUDNN_MAJOR >= 7
+          if (initialized) {
+            CUDNN_CALL(cudnnRestoreDropoutDescriptor(dropout_desc_,
+                                                     s->dnn_handle_,
+                                                     param_.p,  // drop probability
+                                                     dropout_states_.dptr,
+                                                     dropout_byte_,
+                                                     seed_));
+          }
+        #else
+          initialized = false;
+        #endif
+        if (!initialized) {
+          CUDNN_CALL(cudnnSetDropoutDescriptor(dropout_desc_,
+                                               s->dnn_handle_,
+                                               param_.p,  // drop probability
+                                               dropout_states_.dptr,
+                                               dropout_byte_,
+                                               seed_));
+        }
+      } else {
+        dropout_byte_ = 0;
+        dropout_size_ = 0;
+        CUDNN_CALL(cudnnSetDropoutDescriptor(dropout_desc_,
+                                             s->dnn_handle_,
+                                             0,
+                                             nullptr,
+                                             0,
+                                             seed_));
+      }
       // RNN descriptors
       CUDNN_CALL(cudnnCreateRNNDescriptor(&rnn_desc_));
-
-      #if CUDNN_MAJOR >= 6
-        cudnnRNNAlgo_t rnn_algo = CUDNN_RNN_ALGO_STANDARD;
-        CUDNN_CALL(cudnnSetRNNDescriptor_v6(s->dnn_handle_,
-                                            rnn_desc_,
-                                            param_.state_size,
-                                            param_.num_layers,
-                                            dropout_desc_,
-                                            input_mode_,
-                                            direction_,
-                                            mode_,
-                                            rnn_algo,
-                                            dtype_));
-      #else
-        CUDNN_CALL(cudnnSetRNNDescriptor(rnn_desc_,
-                                         param_.state_size,
-                                         param_.num_layers,
-                                         dropout_desc_,
-                                         input_mode_,
-                                         direction_,
-                                         mode_,
-                                         dtype_));
-      #endif
-      #if CUDNN_MAJOR >= 7
-        cudnnMathType_t math_type = CUDNN_DEFAULT_MATH;
-        if (cudnn_tensor_core_ && rnn_algo == CUDNN_RNN_ALGO_STANDARD) {
-          math_type = CUDNN_TENSOR_OP_MATH;
-        }
-        CUDNN_CALL(cudnnSetRNNMatrixMathType(rnn_desc_, math_type));
-      #endif
-      // Get temp space sizes
-      CUDNN_CALL(cudnnGetRNNWorkspaceSize(s->dnn_handle_,
-                                          rnn_desc_,
-                                          param_.seq_length_,
-                                          x_desc_vec_.data(),
-                                          &workspace_byte_));
-      CUDNN_CALL(cudnnGetRNNTrainingReserveSize(s->dnn_handle_,
-                                                rnn_desc_,
-                                                param_.seq_length_,
-                                                x_desc_vec_.data(),
-                                                &reserve_space_byte_));
-      workspace_size_ = workspace_byte_ / sizeof(DType);
-      // Allocate the reserve space
-      reserve_space_ = Storage::Get()->Alloc(reserve_space_byte_, Context::GPU());
-
-      // Check that number of params are correct
-      size_t cudnn_param_size;
-      CUDNN_CALL(cudnnGetRNNParamsSize(s->dnn_handle_,
-                                       rnn_desc_,
-                                       x_desc_vec_[0],
-                                       &cudnn_param_size,
-                                       dtype_));
-      CHECK_EQ(w.shape_[0] * sizeof(DType), cudnn_param_size);
+      SetRNNDescriptor(s);
 
       // Set param descriptors
       CUDNN_CALL(cudnnCreateFilterDescriptor(&w_desc_));
@@ -525,6 +460,24 @@ class CuDNNRNNOp : public Operator {
                                             format_,
                                             3,
                                             dim_w));
+    }
+    // the descriptors are kept for each sequence length and batch size
+    auto it = shape_descs_.find(shape);
+    if (it == shape_descs_.end()) {
+      it = shape_descs_.emplace(shape, ShapeDescs()).first;
+      CreateShapeDescs(s, shape.first, shape.second, &it->second);
+    }
+    UseShapeDescs(s, shape, it->second);
+
+    if (first) {
+      // Check that number of params are correct
+      size_t cudnn_param_size;
+      CUDNN_CALL(cudnnGetRNNParamsSize(s->dnn_handle_,
+                                       rnn_desc_,
+                                       x_desc_vec_[0],
+                                       &cudnn_param_size,
+                                       dtype_));
+      CHECK_EQ(w.shape_[0] * sizeof(DType), cudnn_param_size);
 
       // Query weight layout
       // cudnnFilterDescriptor_t m_desc;
@@ -564,8 +517,186 @@ class CuDNNRNNOp : public Operator {
     }
   }
 
+  // set up rnn_desc_ for the algorithm rnn_algo_
+  inline void SetRNNDescriptor(mshadow::Stream<gpu> *s) {
+    #if CUDNN_MAJOR >= 6
+      CUDNN_CALL(cudnnSetRNNDescriptor_v6(s->dnn_handle_,
+                                          rnn_desc_,
+                                          param_.state_size,
+                                          param_.num_layers,
+                                          dropout_desc_,
+                                          input_mode_,
+                                          direction_,
+                                          mode_,
+                                          rnn_algo_,
+                                          dtype_));
+    #else
+      CUDNN_CALL(cudnnSetRNNDescriptor(rnn_desc_,
+                                       param_.state_size,
+                                       param_.num_layers,
+                                       dropout_desc_,
+                                       input_mode_,
+                                       direction_,
+                                       mode_,
+                                       dtype_));
+    #endif
+    #if CUDNN_MAJOR >= 7
+      cudnnMathType_t math_type = CUDNN_DEFAULT_MATH;
+      if (cudnn_tensor_core_ && rnn_algo_ == CUDNN_RNN_ALGO_STANDARD) {
+        math_type = CUDNN_TENSOR_OP_MATH;
+      }
+      CUDNN_CALL(cudnnSetRNNMatrixMathType(rnn_desc_, math_type));
+    #endif
+  }
+
+  // create the tensor descriptors of the sequence length and the batch size
+  inline void CreateShapeDescs(mshadow::Stream<gpu> *s, int seq_length, int batch_size,
+                               ShapeDescs *d) {
+    // Tensor Descriptors
+    d->x.resize(seq_length);
+    d->y.resize(seq_length);
+    d->dx.resize(seq_length);
+    d->dy.resize(seq_length);
+    int dimA[3];
+    int strideA[3];
+    for (int i = 0; i < seq_length; i++) {
+      CUDNN_CALL(cudnnCreateTensorDescriptor(&d->x[i]));
+      CUDNN_CALL(cudnnCreateTensorDescriptor(&d->y[i]));
+      CUDNN_CALL(cudnnCreateTensorDescriptor(&d->dx[i]));
+      CUDNN_CALL(cudnnCreateTensorDescriptor(&d->dy[i]));
+
+      dimA[0] = batch_size;
+      dimA[1] = param_.input_size_;
+      dimA[2] = 1;
+      strideA[0] = dimA[2] * dimA[1];
+      strideA[1] = dimA[2];
+      strideA[2] = 1;
+
+      CUDNN_CALL(cudnnSetTensorNdDescriptor(d->x[i],
+                                            dtype_,
+                                            3,
+                                            dimA,
+                                            strideA));
+      CUDNN_CALL(cudnnSetTensorNdDescriptor(d->dx[i],
+                                            dtype_,
+                                            3,
+                                            dimA,
+                                            strideA));
+      dimA[0] = batch_size;
+      dimA[1] = param_.bidirectional ? param_.state_size * 2 : param_.state_size;
+      dimA[2] = 1;
+      strideA[0] = dimA[2] * dimA[1];
+      strideA[1] = dimA[2];
+      strideA[2] = 1;
+
+      CUDNN_CALL(cudnnSetTensorNdDescriptor(d->y[i],
+                                            dtype_,
+                                            3,
+                                            dimA,
+                                            strideA));
+      CUDNN_CALL(cudnnSetTensorNdDescriptor(d->dy[i],
+                                            dtype_,
+                                            3,
+                                            dimA,
+                                            strideA));
+    }
+
+    // set the state tensors
+    dimA[0] = param_.num_layers * (param_.bidirectional ? 2 : 1);
+    dimA[1] = batch_size;
+    dimA[2] = param_.state_size;
+    strideA[0] = dimA[2] * dimA[1];
+    strideA[1] = dimA[2];
+    strideA[2] = 1;
+    d->state.resize(8);
+    for (cudnnTensorDescriptor_t& desc : d->state) {
+      CUDNN_CALL(cudnnCreateTensorDescriptor(&desc));
+      CUDNN_CALL(cudnnSetTensorNdDescriptor(desc,
+                                            dtype_,
+                                            3,
+                                            dimA,
+                                            strideA));
+    }
+
+    #if CUDNN_MAJOR >= 6
+      if (rnn_algo_ == CUDNN_RNN_ALGO_PERSIST_DYNAMIC) {
+        CUDNN_CALL(cudnnCreatePersistentRNNPlan(rnn_desc_, batch_size, dtype_, &d->plan));
+        d->plan_init = true;
+        CUDNN_CALL(cudnnSetPersistentRNNPlan(rnn_desc_, d->plan));
+      }
+    #endif
+    // Get temp space sizes
+    cudnnStatus_t e = cudnnGetRNNWorkspaceSize(s->dnn_handle_,
+                                               rnn_desc_,
+                                               seq_length,
+                                               d->x.data(),
+                                               &d->workspace_byte);
+    #if CUDNN_MAJOR >= 6
+      if (e != CUDNN_STATUS_SUCCESS && rnn_algo_ != CUDNN_RNN_ALGO_STANDARD) {
+        LOG(WARNING) << "The persistent cuDNN RNN algorithm does not support this RNN ("
+                     << cudnnGetErrorString(e) << "), it runs the standard algorithm";
+        rnn_algo_ = CUDNN_RNN_ALGO_STANDARD;
+        SetRNNDescriptor(s);
+        e = cudnnGetRNNWorkspaceSize(s->dnn_handle_,
+                                     rnn_desc_,
+                                     seq_length,
+                                     d->x.data(),
+                                     &d->workspace_byte);
+      }
+    #endif
+    CUDNN_CALL(e);
+    CUDNN_CALL(cudnnGetRNNTrainingReserveSize(s->dnn_handle_,
+                                              rnn_desc_,
+                                              seq_length,
+                                              d->x.data(),
+                                              &d->reserve_byte));
+  }
+
+  // run with the descriptors of a sequence length and a batch size
+  inline void UseShapeDescs(mshadow::Stream<gpu> *s, const std::pair<int, int>& shape,
+                            const ShapeDescs& d) {
+    param_.seq_length_ = shape.first;
+    param_.batch_size_ = shape.second;
+    x_desc_vec_ = d.x;
+    y_desc_vec_ = d.y;
+    dx_desc_vec_ = d.dx;
+    dy_desc_vec_ = d.dy;
+    hx_desc_ = d.state[0];
+    cx_desc_ = d.state[1];
+    hy_desc_ = d.state[2];
+    cy_desc_ = d.state[3];
+    dhx_desc_ = d.state[4];
+    dcx_desc_ = d.state[5];
+    dhy_desc_ = d.state[6];
+    dcy_desc_ = d.state[7];
+    #if CUDNN_MAJOR >= 6
+      if (rnn_algo_ == CUDNN_RNN_ALGO_PERSIST_DYNAMIC && d.plan_init) {
+        CUDNN_CALL(cudnnSetPersistentRNNPlan(rnn_desc_, d.plan));
+      }
+    #endif
+    workspace_byte_ = d.workspace_byte;
+    workspace_size_ = workspace_byte_ / sizeof(DType);
+    reserve_space_byte_ = d.reserve_byte;
+    // Allocate the reserve space, grown for the largest shape
+    if (reserve_space_.dptr == nullptr || reserve_space_.size < reserve_space_byte_) {
+      if (reserve_space_.dptr != nullptr) {
+        // the previous kernels may still use it
+        s->Wait();
+        Storage::Get()->Free(reserve_space_);
+      }
+      reserve_space_ = Storage::Get()->Alloc(reserve_space_byte_, Context::GPU(dev_id_));
+    }
+    cur_shape_ = shape;
+  }
+
   cudnnDataType_t dtype_;
   bool init_cudnn_;
+  int dev_id_;
+  std::map<std::pair<int, int>, ShapeDescs> shape_descs_;
+  std::pair<int, int> cur_shape_;
+  #if CUDNN_MAJOR >= 6
+  cudnnRNNAlgo_t rnn_algo_;
+  #endif
   cudnnRNNDescriptor_t rnn_desc_;
   cudnnRNNMode_t mode_;
   cudnnDirectionMode_t direction_;
@@ -28,6 +28,7 @@
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
 #include <mxnet/operator.h>
+#include <mxnet/ndarray.h>
 #include <mxnet/c_api.h>
 #include <map>
 #include <vector>
@@ -69,6 +70,40 @@ class Registry {
   std::map<std::string, CustomOpPropCreator> registry_;
 };
 
+/*!
+ * \brief Runs the frontend callbacks of the custom operators on threads of
+ *  its own, so that the engine workers run the other operations meanwhile.
+ *  A callback is the body of an asynchronous engine operation, which
+ *  completes once the operations the callback pushed on its arrays are done.
+ */
+class Worker {
+ public:
+  /*!
+   * \brief run fn on a worker thread, then complete the operation of ctx
+   *  after the operations pushed on arrs.
+   *  The naive engine runs fn on the calling thread.
+   */
+  void Push(std::function<void()> fn, const OpContext& ctx, const std::vector<NDArray>& arrs);
+
+  static Worker* Get();
+
+ private:
+  Worker();
+  void Run();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::queue<std::function<void()> > tasks_;
+  /*! \brief the number of threads, and of the ones waiting for a task */
+  int num_threads_{0}, num_idle_{0};
+  /*!
+   * \brief the maximum number of threads, a callback that waits for another
+   *  custom operator needs a thread more
+   */
+  int max_threads_;
+  bool naive_;
+};
+
 }  // namespace custom
 }  // namespace op
 }  // namespace mxnet
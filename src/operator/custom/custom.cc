@@ -24,7 +24,9 @@
 */
 #include "./custom-inl.h"
 #include <mxnet/base.h>
+#include <mxnet/engine.h>
 #include <mxnet/ndarray.h>
+#include <algorithm>
 
 #include "../../ndarray/autograd.h"
 #include "../elemwise_op_common.h"
@@ -38,6 +40,76 @@ Registry* Registry::Get() {
   return &inst;
 }
 
+Worker* Worker::Get() {
+  static Worker* inst = new Worker();
+  return inst;
+}
+
+Worker::Worker()
+    : max_threads_(std::max(dmlc::GetEnv("MXNET_CUSTOM_OP_NUM_THREADS", 16), 1)),
+      naive_(dmlc::GetEnv("MXNET_ENGINE_TYPE", std::string()) == "NaiveEngine") {}
+
+void Worker::Push(std::function<void()> fn, const OpContext& ctx,
+                  const std::vector<NDArray>& arrs) {
+  if (naive_) {
+    fn();
+    ctx.async_on_complete();
+    return;
+  }
+  Engine::CallbackOnComplete on_complete = ctx.async_on_complete;
+  std::unique_lock<std::mutex> lk(mutex_);
+  tasks_.push([fn, on_complete, arrs]() {
+      fn();
+      std::vector<Engine::VarHandle> vars;
+      for (const auto& arr : arrs) {
+        if (!arr.is_none()) vars.push_back(arr.var());
+      }
+      Engine::Get()->PushSync([on_complete](RunContext) {
+          on_complete();
+        }, Context::CPU(), {}, vars, FnProperty::kNormal, 0,
+        PROFILER_MESSAGE("CustomOperator"));
+    });
+  if (static_cast<int>(tasks_.size()) > num_idle_ && num_threads_ < max_threads_) {
+    ++num_threads_;
+    std::thread([this]() { Run(); }).detach();
+  }
+  lk.unlock();
+  cv_.notify_one();
+}
+
+void Worker::Run() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true) {
+    ++num_idle_;
+    cv_.wait(lk, [this]() { return !tasks_.empty(); });
+    --num_idle_;
+    std::function<void()> task = std::move(tasks_.front());
+    tasks_.pop();
+    lk.unlock();
+    try {
+      task();
+    } catch (const dmlc::Error& e) {
+      LOG(FATAL) << e.what() << "\n"
+                 << "An error occurred in a custom operator. Set the environment variable "
+                 << "MXNET_ENGINE_TYPE to NaiveEngine to run the custom operators "
+                 << "on the calling thread, where the error is raised to the frontend.";
+    }
+    lk.lock();
+  }
+}
+
+/*!
+ * \brief an array on the memory of arr with a variable of its own, for the
+ *  operations the callback pushes while the custom operator holds the
+ *  variable of arr.
+ */
+inline NDArray Wrap(const NDArray& arr) {
+  if (arr.is_none()) return arr;
+  CHECK_EQ(arr.storage_type(), kDefaultStorage)
+      << "Custom operator only supports the arrays of the default storage";
+  return NDArray(arr.data(), arr.ctx().dev_id, std::make_shared<NDArray>(arr));
+}
+
 struct CustomParam {
   std::string op_type;
   size_t num_args, num_outs, num_auxs;
@@ -267,34 +339,39 @@ void Forward(const OpStatePtr& state,
   const CustomParam& params = state.get_state<CustomParam>();
   std::vector<void*> ptrs;
   std::vector<int> tags;
+  std::vector<NDArray> arrs;
 
   for (size_t i = 0; i < params.num_args; ++i) {
-    NDArray *nd = new NDArray(inputs[i].Detach());
-    ptrs.push_back(reinterpret_cast<void*>(nd));
+    arrs.push_back(Wrap(inputs[i]));
+    ptrs.push_back(reinterpret_cast<void*>(new NDArray(arrs.back())));
     tags.push_back(0);
   }
 
   for (size_t i = 0; i < params.num_outs; ++i) {
-    NDArray *nd = new NDArray(outputs[i].Detach());
-    ptrs.push_back(reinterpret_cast<void*>(nd));
+    arrs.push_back(Wrap(outputs[i]));
+    ptrs.push_back(reinterpret_cast<void*>(new NDArray(arrs.back())));
     tags.push_back(1);
   }
 
   for (size_t i = 0; i < params.num_auxs; ++i) {
-    NDArray *nd = new NDArray(inputs[i+params.num_args].Detach());
-    ptrs.push_back(reinterpret_cast<void*>(nd));
+    arrs.push_back(Wrap(inputs[i+params.num_args]));
+    ptrs.push_back(reinterpret_cast<void*>(new NDArray(arrs.back())));
     tags.push_back(4);
   }
 
-  bool prev_recording = autograd::AutogradRuntime::Get()->SetIsRecording(false);
-  bool prev_training = autograd::AutogradRuntime::Get()->SetIsTraining(ctx.is_train);
+  const bool is_train = ctx.is_train;
+  Worker::Get()->Push([state, ptrs, tags, req, is_train]() mutable {
+      const CustomParam& params = state.get_state<CustomParam>();
+      bool prev_recording = autograd::AutogradRuntime::Get()->SetIsRecording(false);
+      bool prev_training = autograd::AutogradRuntime::Get()->SetIsTraining(is_train);
 
-  CHECK(reinterpret_cast<CustomOpFBFunc>(params.info->callbacks[kCustomOpForward])(
-    ptrs.size(), ptrs.data(), tags.data(), reinterpret_cast<const int*>(req.data()),
-    static_cast<int>(ctx.is_train), params.info->contexts[kCustomOpForward]));
+      CHECK(reinterpret_cast<CustomOpFBFunc>(params.info->callbacks[kCustomOpForward])(
+        ptrs.size(), ptrs.data(), tags.data(), reinterpret_cast<const int*>(req.data()),
+        static_cast<int>(is_train), params.info->contexts[kCustomOpForward]));
 
-  autograd::AutogradRuntime::Get()->SetIsTraining(prev_training);
-  autograd::AutogradRuntime::Get()->SetIsRecording(prev_recording);
+      autograd::AutogradRuntime::Get()->SetIsTraining(prev_training);
+      autograd::AutogradRuntime::Get()->SetIsRecording(prev_recording);
+    }, ctx, arrs);
 }
 
 
@@ -314,33 +391,38 @@ void Backward(const OpStatePtr& state,
   for (size_t i = 0; i < params.num_args; ++i) tags.push_back(0);
   for (size_t i = 0; i < params.num_outs; ++i) tags.push_back(1);
 
+  std::vector<NDArray> arrs;
   for (size_t i = 0; i < params.bwd_idx.size(); ++i) {
-    NDArray *nd = new NDArray(inputs[i].Detach());
-    ptrs[params.bwd_idx[i]] = reinterpret_cast<void*>(nd);
+    arrs.push_back(Wrap(inputs[i]));
+    ptrs[params.bwd_idx[i]] = reinterpret_cast<void*>(new NDArray(arrs.back()));
   }
   for (size_t i = 0; i < ptrs.size(); ++i) {
     if (ptrs[i] == nullptr) ptrs[i] = reinterpret_cast<void*>(new NDArray());
   }
   for (const auto& i : outputs) {
-    NDArray* nd = new NDArray(i.Detach());
-    ptrs.push_back(reinterpret_cast<void*>(nd));
+    arrs.push_back(Wrap(i));
+    ptrs.push_back(reinterpret_cast<void*>(new NDArray(arrs.back())));
     tags.push_back(2);
   }
   for (size_t i = 0; i < params.num_auxs; ++i) {
-    NDArray* nd = new NDArray(inputs[inputs.size()-params.num_auxs+i].Detach());
-    ptrs.push_back(reinterpret_cast<void*>(nd));
+    arrs.push_back(Wrap(inputs[inputs.size()-params.num_auxs+i]));
+    ptrs.push_back(reinterpret_cast<void*>(new NDArray(arrs.back())));
     tags.push_back(4);
   }
 
-  bool prev_recording = autograd::AutogradRuntime::Get()->SetIsRecording(false);
-  bool prev_training = autograd::AutogradRuntime::Get()->SetIsTraining(ctx.is_train);
+  const bool is_train = ctx.is_train;
+  Worker::Get()->Push([state, ptrs, tags, req, is_train]() mutable {
+      const CustomParam& params = state.get_state<CustomParam>();
+      bool prev_recording = autograd::AutogradRuntime::Get()->SetIsRecording(false);
+      bool prev_training = autograd::AutogradRuntime::Get()->SetIsTraining(is_train);
 
-  CHECK(reinterpret_cast<CustomOpFBFunc>(params.info->callbacks[kCustomOpBackward])(
-    ptrs.size(), ptrs.data(), tags.data(), reinterpret_cast<const int*>(req.data()),
-    static_cast<int>(ctx.is_train), params.info->contexts[kCustomOpBackward]));
+      CHECK(reinterpret_cast<CustomOpFBFunc>(params.info->callbacks[kCustomOpBackward])(
+        ptrs.size(), ptrs.data(), tags.data(), reinterpret_cast<const int*>(req.data()),
+        static_cast<int>(is_train), params.info->contexts[kCustomOpBackward]));
 
-  autograd::AutogradRuntime::Get()->SetIsTraining(prev_training);
-  autograd::AutogradRuntime::Get()->SetIsRecording(prev_recording);
+      autograd::AutogradRuntime::Get()->SetIsTraining(prev_training);
+      autograd::AutogradRuntime::Get()->SetIsRecording(prev_recording);
+    }, ctx, arrs);
 }
 
 
@@ -378,10 +460,12 @@ Please check the tutorial here: http://mxnet.io/how_to/new_op.html.
     return ret;
   })
 .set_attr<FExecType>("FExecType", [](const NodeAttrs& attrs) {
-    return ExecType::kLocal;
+    return ExecType::kAsync;
   })
 .set_attr<nnvm::FGradient>("FGradient", Gradient)
 .set_attr<FCreateOpState>("FCreateOpState", CreateState)
+// the frontend creates the operator, on the binding thread
+.set_attr<bool>("TSerialCreateOpState", true)
 .set_attr<FStatefulComputeEx>("FStatefulComputeEx<cpu>", Forward)
 .set_attr<FStatefulComputeEx>("FStatefulComputeEx<gpu>", Forward)
 .add_argument("data", "NDArray-or-Symbol[]", "Input data for the custom operator.")
@@ -402,7 +486,7 @@ NNVM_REGISTER_OP(_backward_Custom)
 .set_attr<bool>("TIsLayerOpBackward", true)
 .set_attr<bool>("TIsBackward", true)
 .set_attr<FExecType>("FExecType", [](const NodeAttrs& attrs) {
-    return ExecType::kLocal;
+    return ExecType::kAsync;
   })
 .set_attr<FStatefulComputeEx>("FStatefulComputeEx<cpu>", Backward)
 .set_attr<FStatefulComputeEx>("FStatefulComputeEx<gpu>", Backward);
@@ -42,5 +42,9 @@ MXNET_REGISTER_OP_PROPERTY(_Native, NativeOpProp)
 .add_argument("data", "NDArray-or-Symbol[]", "Input data for the custom operator.")
 .add_arguments(NativeOpParam::__FIELDS__());
 
+NNVM_REGISTER_OP(_Native)
+// the frontend computes the gradients, which may not vanish with the ones of the outputs
+.set_attr<bool>("TNonlossGradient", false);
+
 }  // namespace op
 }  // namespace mxnet
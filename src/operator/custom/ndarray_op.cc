@@ -147,5 +147,9 @@ MXNET_REGISTER_OP_PROPERTY(_NDArray, NDArrayOpProp)
 .add_argument("data", "NDArray-or-Symbol[]", "Input data for the custom operator.")
 .add_arguments(NDArrayOpParam::__FIELDS__());
 
+NNVM_REGISTER_OP(_NDArray)
+// the frontend computes the gradients, which may not vanish with the ones of the outputs
+.set_attr<bool>("TNonlossGradient", false);
+
 }  // namespace op
 }  // namespace mxnet
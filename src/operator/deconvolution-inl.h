@@ -32,8 +32,10 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include "./operator_common.h"
+#include "./nn/im2col.h"
 
 
 namespace mxnet {
@@ -190,68 +192,30 @@ class DeconvolutionOp : public Operator {
         << "Must init CuBLAS handle in stream";
 #endif
     const index_t nbatch = data.size(0);
+    // the deconvolution of an image is the col2im of the product of the weight and the image
+    // into the output, which the padding crops
+    const TShape col_shape = this->InitTemp(out.shape_, data.shape_);
+    const TShape out_shape = out_data[deconv::kOut].shape_;
+    const TShape lowered_pad = Shape2(o_pad[0], o_pad[1]);
     Tensor<xpu, 1, DType> workspace =
         ctx.requested[deconv::kTempSpace].get_space_typed<xpu, 1, DType>(
-            Shape1(this->InitTemp(out.shape_, data.shape_)), s);
+            Shape1(col_size_ * nstep_), s);
+    const index_t gstride = col_shape[0] / param_.num_group;
+    const index_t in_dim = data.shape_.ProdShape(1, 4), out_dim = out.shape_.ProdShape(1, 4);
     for (index_t i = 0; i < nbatch; i += nstep_) {
       const index_t step = std::min(nstep_, nbatch - i);
-      Tensor<xpu, 2, DType> temp_col = Tensor<xpu, 2, DType>(
-                                            workspace.dptr_,
-                                            Shape2(shape_colunit_[0],
-                                            shape_colunit_[1] * step), s);
-      Tensor<xpu, 3, DType> temp_dst = Tensor<xpu, 3, DType>(
-                                           workspace.dptr_ + temp_col.shape_.Size(),
-                                           Shape3(shape_dstunit_[0],
-                                           shape_dstunit_[1],
-                                           shape_dstunit_[2] * step), s);
-      temp_dst = reshape(swapaxis<1, 0>(data.Slice(i, i + step)), temp_dst.shape_);
-      if (o_pad[0] == 0 && o_pad[1] == 0) {
-        temp_col = unpack_patch2col(out.Slice(i, i + step),
-                                    param_.kernel[0],
-                                    param_.kernel[1],
-                                    param_.stride[0],
-                                    param_.stride[1],
-                                    param_.dilate[0],
-                                    param_.dilate[1]);
-      } else {
-        temp_col = unpack_patch2col(pad(out.Slice(i, i + step),
-                                        o_pad[0], o_pad[1]),
-                                    param_.kernel[0],
-                                    param_.kernel[1],
-                                    param_.stride[0],
-                                    param_.stride[1],
-                                    param_.dilate[0],
-                                    param_.dilate[1]);
-      }
-      const index_t gstride = temp_col.size(0) / param_.num_group;
-      for (uint32_t gid = 0; gid < param_.num_group; ++gid) {
-        mshadow::Tensor<xpu, 2, DType> tmpc = temp_col.Slice(gstride * gid,
-                                              gstride * (gid + 1));
-        tmpc = dot(wmat[gid].T(), temp_dst[gid]);
-      }
-      if (o_pad[0] == 0 && o_pad[1] == 0) {
-        out.Slice(i, i + step) = pack_col2patch(temp_col,
-                                   out.Slice(i, i + step).shape_,
-                                   param_.kernel[0],
-                                   param_.kernel[1],
-                                   param_.stride[0],
-                                   param_.stride[1],
-                                   param_.dilate[0],
-                                   param_.dilate[1]);
-      } else {
-        Shape<4> pshape = out.Slice(i, i + step).shape_;
-        pshape[2] += 2 * o_pad[0];
-        pshape[3] += 2 * o_pad[1];
-        out.Slice(i, i + step) = crop(pack_col2patch(temp_col,
-                                        pshape,
-                                        param_.kernel[0],
-                                        param_.kernel[1],
-                                        param_.stride[0],
-                                        param_.stride[1],
-                                        param_.dilate[0],
-                                        param_.dilate[1]),
-                                        out[i][0].shape_);
+      for (index_t n = i; n < i + step; ++n) {
+        Tensor<xpu, 3, DType> temp_col(workspace.dptr_ + (n - i) * col_size_,
+                                       Shape3(param_.num_group, gstride,
+                                              col_shape[1] * col_shape[2]), s);
+        Tensor<xpu, 3, DType> data_3d(data.dptr_ + n * in_dim,
+                                      Shape3(param_.num_group, wmat.size(1), temp_col.size(2)), s);
+        for (uint32_t gid = 0; gid < param_.num_group; ++gid) {
+          temp_col[gid] = dot(wmat[gid].T(), data_3d[gid]);
+        }
       }
+      col2im_batch(s, workspace.dptr_, step, out_shape, col_shape, param_.kernel, lowered_pad,
+                   param_.stride, param_.dilate, out.dptr_ + i * out_dim, kWriteTo);
     }
     if (!param_.no_bias) {
       // add bias, broadcast bias to dim 1: channel
@@ -298,61 +262,35 @@ class DeconvolutionOp : public Operator {
     param_.InferPad(dshape, o_pad, o_adj);
 
     const index_t nbatch = data.size(0);
+    const TShape col_shape = this->InitTemp(grad.shape_, data.shape_);
+    const TShape grad_shape = out_grad[deconv::kOut].shape_;
+    const TShape lowered_pad = Shape2(o_pad[0], o_pad[1]);
     Tensor<xpu, 1, DType> workspace =
         ctx.requested[deconv::kTempSpace].get_space_typed<xpu, 1, DType>(
-            Shape1(this->InitTemp(grad.shape_, data.shape_)), s);
+            Shape1(col_size_ * nstep_), s);
+    const index_t gstride = col_shape[0] / param_.num_group;
+    const index_t in_dim = data.shape_.ProdShape(1, 4), out_dim = grad.shape_.ProdShape(1, 4);
     for (index_t i = 0; i < nbatch; i += nstep_) {
       const index_t step = std::min(nstep_, nbatch - i);
-      Tensor<xpu, 2, DType> temp_col = Tensor<xpu, 2, DType>(
-                                           workspace.dptr_,
-                                           Shape2(shape_colunit_[0],
-                                           shape_colunit_[1] * step), s);
-      Tensor<xpu, 3, DType> temp_dst = Tensor<xpu, 3, DType>(
-                                           workspace.dptr_ + temp_col.shape_.Size(),
-                                           Shape3(shape_dstunit_[0],
-                                           shape_dstunit_[1],
-                                           shape_dstunit_[2] * step), s);
-      temp_dst = reshape(swapaxis<1, 0>(data.Slice(i, i + step)), temp_dst.shape_);
-      if (o_pad[0] == 0 && o_pad[1] == 0) {
-        temp_col = unpack_patch2col(grad.Slice(i, i + step),
-                                     param_.kernel[0],
-                                     param_.kernel[1],
-                                     param_.stride[0],
-                                     param_.stride[1],
-                                     param_.dilate[0],
-                                     param_.dilate[1]);
-      } else {
-        temp_col = unpack_patch2col(pad(grad.Slice(i, i + step), o_pad[0], o_pad[1]),
-                                     param_.kernel[0],
-                                     param_.kernel[1],
-                                     param_.stride[0],
-                                     param_.stride[1],
-                                     param_.dilate[0],
-                                     param_.dilate[1]);
-      }
-      const index_t gstride = temp_col.size(0) / param_.num_group;
-      for (uint32_t gid = 0; gid < param_.num_group; ++gid) {
-        Tensor<xpu, 2, DType> tmpc = temp_col.Slice(gstride * gid, gstride * (gid + 1));
-        if (i == 0) {
-          Tensor<xpu, 2, DType> tmp_gwmat = gwmat[gid];
-          Assign(tmp_gwmat, req[deconv::kWeight], dot(temp_dst[gid], tmpc.T()));
-        } else {
-          gwmat[gid] += dot(temp_dst[gid], tmpc.T());
-        }
-      }
-      if (req[deconv::kData] == kWriteTo || req[deconv::kData] == kWriteInplace
-                                         || req[deconv::kData] == kAddTo) {
+      im2col_batch(s, grad.dptr_ + i * out_dim, step, grad_shape, col_shape, param_.kernel,
+                   lowered_pad, param_.stride, param_.dilate, workspace.dptr_);
+      for (index_t n = i; n < i + step; ++n) {
+        Tensor<xpu, 3, DType> temp_col(workspace.dptr_ + (n - i) * col_size_,
+                                       Shape3(param_.num_group, gstride,
+                                              col_shape[1] * col_shape[2]), s);
+        Tensor<xpu, 3, DType> data_3d(data.dptr_ + n * in_dim,
+                                      Shape3(param_.num_group, wmat.size(1), temp_col.size(2)), s);
+        Tensor<xpu, 3, DType> gdata_3d(gdata.dptr_ + n * in_dim, data_3d.shape_, s);
         for (uint32_t gid = 0; gid < param_.num_group; ++gid) {
-          Tensor<xpu, 2, DType> tmpc = temp_col.Slice(gstride * gid, gstride * (gid + 1));
-          temp_dst[gid] = dot(wmat[gid], tmpc);
+          if (n == 0) {
+            Tensor<xpu, 2, DType> tmp_gwmat = gwmat[gid];
+            Assign(tmp_gwmat, req[deconv::kWeight], dot(data_3d[gid], temp_col[gid].T()));
+          } else if (req[deconv::kWeight] != kNullOp) {
+            gwmat[gid] += dot(data_3d[gid], temp_col[gid].T());
+          }
+          Tensor<xpu, 2, DType> tmp_gdata = gdata_3d[gid];
+          Assign(tmp_gdata, req[deconv::kData], dot(wmat[gid], temp_col[gid]));
         }
-        Assign(gdata.Slice(i, i + step),
-               req[deconv::kData],
-               (swapaxis<1, 0>(reshape(temp_dst,
-                                      mshadow::Shape4(gdata.shape_[1],
-                                                      step,
-                                                      gdata.size(2),
-                                                      gdata.size(3))))));
       }
     }
     if (!param_.no_bias) {
@@ -362,38 +300,29 @@ class DeconvolutionOp : public Operator {
   }
 
  private:
-  inline index_t InitTemp(const mshadow::Shape<4> &ishape,
-                          const mshadow::Shape<4> &oshape) {
-    const int ksize_y = param_.kernel[0];
-    const int ksize_x = param_.kernel[1];
-    shape_colunit_ = mshadow::Shape2(ishape[1] * ksize_y * ksize_x,
-                                     oshape[2] * oshape[3]);
-    shape_dstunit_ = mshadow::Shape3(param_.num_group,
-                                     oshape[1] / param_.num_group,
-                                     oshape[2] * oshape[3]);
-    // See convolution for workspace calculations
-    nstep_ = std::max(
-        std::min(
-            static_cast<index_t>(
-                param_.workspace / (shape_colunit_.Size() + shape_dstunit_.Size())),
-            ishape[0]),
-        1U);
-
-    mshadow::Shape<2> scol = mshadow::Shape2(shape_colunit_[0],
-                                             shape_colunit_[1] * nstep_);
-    mshadow::Shape<3> sdst = mshadow::Shape3(shape_dstunit_[0],
-                                             shape_dstunit_[1],
-                                             shape_dstunit_[2] * nstep_);
-    index_t required_size = scol.Size() + sdst.Size();
-    CHECK_GE(param_.workspace, required_size)
-      << "\nMinimum workspace size: " << required_size * sizeof(DType) << " Bytes\n"
+  /*!
+   * \brief the shape of the column buffer of an image of oshape, the output of the
+   *  deconvolution, which also sets col_size_ and nstep_, the number of images the cpu
+   *  lowers at a time
+   */
+  inline TShape InitTemp(const mshadow::Shape<4> &oshape,
+                         const mshadow::Shape<4> &ishape) {
+    const TShape col_shape = mshadow::Shape3(oshape[1] * param_.kernel[0] * param_.kernel[1],
+                                             ishape[2], ishape[3]);
+    col_size_ = col_shape.Size();
+    CHECK_GE(param_.workspace, col_size_)
+      << "\nMinimum workspace size: " << col_size_ * sizeof(DType) << " Bytes\n"
       << "Given: " << param_.workspace * sizeof(DType);
-    return required_size;
+    nstep_ = 1;
+    if (std::is_same<xpu, cpu>::value) {
+      nstep_ = std::max<index_t>(1, std::min<index_t>(
+          std::min<index_t>(ishape[0], omp_get_max_threads()), param_.workspace / col_size_));
+    }
+    return col_shape;
   }
 
   DeconvolutionParam param_;
-  mshadow::Shape<2> shape_colunit_;
-  mshadow::Shape<3> shape_dstunit_;
+  index_t col_size_;
   index_t nstep_;
 };  // class DeconvolutionOp
 
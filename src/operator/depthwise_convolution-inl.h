@@ -0,0 +1,295 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file depthwise_convolution-inl.h
+ * \brief direct kernels of the 2-D convolutions with one filter per input channel
+ *
+ * A depthwise convolution has num_group == num_filter == the number of input
+ * channels, so that every output plane is the cross-correlation of one input
+ * plane with one kh x kw filter. The im2col + gemm of ConvolutionOp would run
+ * one tiny gemm per channel, these kernels compute the planes directly. On the
+ * cpu the taps are accumulated along the output rows, which the compiler turns
+ * into vector multiply-adds, and the planes are split between the OpenMP
+ * threads. On the gpu a block computes a tile of an output plane from a copy
+ * of its input patch in shared memory, each thread keeping several outputs in
+ * registers.
+ */
+#ifndef MXNET_OPERATOR_DEPTHWISE_CONVOLUTION_INL_H_
+#define MXNET_OPERATOR_DEPTHWISE_CONVOLUTION_INL_H_
+
+#include <mxnet/base.h>
+#include <mxnet/operator.h>
+#include <dmlc/logging.h>
+#include <algorithm>
+#include <climits>
+#include <vector>
+#include "./convolution-inl.h"
+#include "./mxnet_op.h"
+
+namespace mxnet {
+namespace op {
+namespace depthwise {
+
+/*! \brief the geometry of a depthwise convolution of NCHW planes */
+struct DepthwiseArgs {
+  int batch, channel;
+  int in_h, in_w, out_h, out_w;
+  int kernel_h, kernel_w;
+  int stride_h, stride_w;
+  int pad_h, pad_w;
+  int dilate_h, dilate_w;
+
+  DepthwiseArgs(const ConvolutionParam& param, const TShape& ishape, const TShape& oshape)
+    : batch(ishape[0]), channel(ishape[1]), in_h(ishape[2]), in_w(ishape[3]),
+      out_h(oshape[2]), out_w(oshape[3]), kernel_h(param.kernel[0]), kernel_w(param.kernel[1]),
+      stride_h(param.stride[0]), stride_w(param.stride[1]), pad_h(param.pad[0]),
+      pad_w(param.pad[1]), dilate_h(param.dilate[0]), dilate_w(param.dilate[1]) {}
+
+  MSHADOW_XINLINE size_t in_plane() const { return static_cast<size_t>(in_h) * in_w; }
+  MSHADOW_XINLINE size_t out_plane() const { return static_cast<size_t>(out_h) * out_w; }
+  MSHADOW_XINLINE int taps() const { return kernel_h * kernel_w; }
+};
+
+/*!
+ * \brief the output columns [*begin, *end) of which the tap at the input
+ *  column offset off, ow * stride_w + off, falls inside the input row
+ */
+inline void ValidCols(const DepthwiseArgs& a, int off, int* begin, int* end) {
+  *begin = off < 0 ? (-off + a.stride_w - 1) / a.stride_w : 0;
+  *end = a.in_w - 1 - off >= 0 ? std::min(a.out_w, (a.in_w - 1 - off) / a.stride_w + 1) : 0;
+}
+
+/*! \brief one output plane of the forward pass, on the cpu */
+template<typename DType>
+inline void ForwardPlane(const DepthwiseArgs& a, const DType* in, const DType* weight,
+                         DType bias, DType* out) {
+  for (int oh = 0; oh < a.out_h; ++oh) {
+    DType* orow = out + static_cast<size_t>(oh) * a.out_w;
+    for (int ow = 0; ow < a.out_w; ++ow) orow[ow] = bias;
+    for (int kh = 0; kh < a.kernel_h; ++kh) {
+      const int ih = oh * a.stride_h - a.pad_h + kh * a.dilate_h;
+      if (ih < 0 || ih >= a.in_h) continue;
+      const DType* irow = in + static_cast<size_t>(ih) * a.in_w;
+      for (int kw = 0; kw < a.kernel_w; ++kw) {
+        const int off = kw * a.dilate_w - a.pad_w;
+        const DType w = weight[kh * a.kernel_w + kw];
+        int begin, end;
+        ValidCols(a, off, &begin, &end);
+        if (a.stride_w == 1) {
+          const DType* src = irow + off;
+          for (int ow = begin; ow < end; ++ow) orow[ow] += w * src[ow];
+        } else {
+          for (int ow = begin; ow < end; ++ow) orow[ow] += w * irow[ow * a.stride_w + off];
+        }
+      }
+    }
+  }
+}
+
+/*! \brief the gradient of one input plane, on the cpu */
+template<typename DType>
+inline void BackwardDataPlane(const DepthwiseArgs& a, const DType* ograd, const DType* weight,
+                              OpReqType req, DType* igrad) {
+  if (req != kAddTo) std::fill(igrad, igrad + a.in_plane(), DType(0));
+  for (int oh = 0; oh < a.out_h; ++oh) {
+    const DType* orow = ograd + static_cast<size_t>(oh) * a.out_w;
+    for (int kh = 0; kh < a.kernel_h; ++kh) {
+      const int ih = oh * a.stride_h - a.pad_h + kh * a.dilate_h;
+      if (ih < 0 || ih >= a.in_h) continue;
+      DType* irow = igrad + static_cast<size_t>(ih) * a.in_w;
+      for (int kw = 0; kw < a.kernel_w; ++kw) {
+        const int off = kw * a.dilate_w - a.pad_w;
+        const DType w = weight[kh * a.kernel_w + kw];
+        int begin, end;
+        ValidCols(a, off, &begin, &end);
+        if (a.stride_w == 1) {
+          DType* dst = irow + off;
+          for (int ow = begin; ow < end; ++ow) dst[ow] += w * orow[ow];
+        } else {
+          for (int ow = begin; ow < end; ++ow) irow[ow * a.stride_w + off] += w * orow[ow];
+        }
+      }
+    }
+  }
+}
+
+/*! \brief wgrad[tap] += the correlation of one output gradient plane with its input plane */
+template<typename DType>
+inline void BackwardWeightPlane(const DepthwiseArgs& a, const DType* ograd, const DType* in,
+                                DType* wgrad) {
+  for (int kh = 0; kh < a.kernel_h; ++kh) {
+    for (int kw = 0; kw < a.kernel_w; ++kw) {
+      const int off = kw * a.dilate_w - a.pad_w;
+      int begin, end;
+      ValidCols(a, off, &begin, &end);
+      DType sum = 0;
+      for (int oh = 0; oh < a.out_h; ++oh) {
+        const int ih = oh * a.stride_h - a.pad_h + kh * a.dilate_h;
+        if (ih < 0 || ih >= a.in_h) continue;
+        const DType* orow = ograd + static_cast<size_t>(oh) * a.out_w;
+        const DType* irow = in + static_cast<size_t>(ih) * a.in_w;
+        if (a.stride_w == 1) {
+          const DType* src = irow + off;
+          for (int ow = begin; ow < end; ++ow) sum += orow[ow] * src[ow];
+        } else {
+          for (int ow = begin; ow < end; ++ow) sum += orow[ow] * irow[ow * a.stride_w + off];
+        }
+      }
+      wgrad[kh * a.kernel_w + kw] += sum;
+    }
+  }
+}
+
+inline int NumThreads(size_t work) {
+  return mxnet_op::KernelNumThreads(static_cast<int>(std::min<size_t>(work, INT_MAX)),
+                                    mxnet_op::KernelGrain<DepthwiseArgs>::Get());
+}
+
+/*! \brief out = the depthwise convolution of in by weight, plus bias if it is not null */
+template<typename DType>
+inline void Forward(mshadow::Stream<cpu>* s, const DepthwiseArgs& a, const DType* in,
+                    const DType* weight, const DType* bias, DType* out) {
+  const int nplane = a.batch * a.channel;
+  const int nthread = NumThreads(static_cast<size_t>(nplane) * a.out_plane() * a.taps());
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    const int c = p % a.channel;
+    ForwardPlane(a, in + p * a.in_plane(), weight + c * a.taps(),
+                 bias != nullptr ? bias[c] : DType(0), out + p * a.out_plane());
+  }
+}
+
+/*! \brief igrad (req) the gradient of the input */
+template<typename DType>
+inline void BackwardData(mshadow::Stream<cpu>* s, const DepthwiseArgs& a, const DType* ograd,
+                         const DType* weight, OpReqType req, DType* igrad) {
+  if (req == kNullOp) return;
+  const int nplane = a.batch * a.channel;
+  const int nthread = NumThreads(static_cast<size_t>(nplane) * a.out_plane() * a.taps());
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    BackwardDataPlane(a, ograd + p * a.out_plane(), weight + (p % a.channel) * a.taps(), req,
+                      igrad + p * a.in_plane());
+  }
+}
+
+/*! \brief wgrad (req) the gradient of the weight, bgrad (breq) the one of the bias if not null */
+template<typename DType>
+inline void BackwardWeight(mshadow::Stream<cpu>* s, const DepthwiseArgs& a, const DType* ograd,
+                           const DType* in, OpReqType req, DType* wgrad,
+                           OpReqType breq, DType* bgrad) {
+  // the channels are split between the threads, which sum over the batch
+  const int nthread = NumThreads(static_cast<size_t>(a.batch) * a.channel * a.out_plane() *
+                                 a.taps());
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int c = 0; c < a.channel; ++c) {
+    if (req != kNullOp) {
+      DType* dw = wgrad + c * a.taps();
+      if (req != kAddTo) std::fill(dw, dw + a.taps(), DType(0));
+      for (int n = 0; n < a.batch; ++n) {
+        const size_t p = static_cast<size_t>(n) * a.channel + c;
+        BackwardWeightPlane(a, ograd + p * a.out_plane(), in + p * a.in_plane(), dw);
+      }
+    }
+    if (bgrad != nullptr && breq != kNullOp) {
+      DType sum = 0;
+      for (int n = 0; n < a.batch; ++n) {
+        const DType* g = ograd + (static_cast<size_t>(n) * a.channel + c) * a.out_plane();
+        for (size_t i = 0; i < a.out_plane(); ++i) sum += g[i];
+      }
+      KERNEL_ASSIGN(bgrad[c], breq, sum);
+    }
+  }
+}
+
+#ifdef __CUDACC__
+#include "./depthwise_convolution.cuh"
+#endif  // __CUDACC__
+
+}  // namespace depthwise
+
+/*!
+ * \brief the 2-D NCHW convolutions with num_group == num_filter == the number
+ *  of input channels, through the direct kernels instead of im2col + gemm
+ */
+template<typename xpu, typename DType>
+class DepthwiseConvolutionOp : public Operator {
+ public:
+  explicit DepthwiseConvolutionOp(const ConvolutionParam& p) : param_(p) {}
+
+  /*!
+   * \brief whether the convolution of data of dshape and type dtype is depthwise, a single
+   *  channel is left to ConvolutionOp, which runs it as one gemm
+   */
+  static bool Supports(const ConvolutionParam& param, const TShape& dshape, int dtype) {
+    return param.kernel.ndim() == 2 && dshape.ndim() == 4 &&
+           param.layout.value() == mshadow::kNCHW &&
+           (dtype == mshadow::kFloat32 || dtype == mshadow::kFloat64) &&
+           param.num_group > 1 && param.num_group == param.num_filter &&
+           param.num_group == dshape[1];
+  }
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    CHECK_EQ(req[conv::kOut], kWriteTo);
+    CHECK_EQ(in_data.size(), param_.no_bias ? 2U : 3U);
+    CHECK_EQ(out_data.size(), 1U);
+    mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+    const depthwise::DepthwiseArgs args(param_, in_data[conv::kData].shape_,
+                                        out_data[conv::kOut].shape_);
+    depthwise::Forward(s, args, in_data[conv::kData].dptr<DType>(),
+                       in_data[conv::kWeight].dptr<DType>(),
+                       param_.no_bias ? nullptr : in_data[conv::kBias].dptr<DType>(),
+                       out_data[conv::kOut].dptr<DType>());
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob>& out_grad,
+                        const std::vector<TBlob>& in_data,
+                        const std::vector<TBlob>& out_data,
+                        const std::vector<OpReqType>& req,
+                        const std::vector<TBlob>& in_grad,
+                        const std::vector<TBlob>& aux_args) {
+    CHECK_EQ(out_grad.size(), 1U);
+    const size_t expected = param_.no_bias ? 2U : 3U;
+    CHECK(in_data.size() == expected && in_grad.size() == expected);
+    CHECK_EQ(req.size(), expected);
+    mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+    const depthwise::DepthwiseArgs args(param_, in_data[conv::kData].shape_,
+                                        out_grad[conv::kOut].shape_);
+    const DType* ograd = out_grad[conv::kOut].dptr<DType>();
+    depthwise::BackwardData(s, args, ograd, in_data[conv::kWeight].dptr<DType>(),
+                            req[conv::kData], in_grad[conv::kData].dptr<DType>());
+    depthwise::BackwardWeight(s, args, ograd, in_data[conv::kData].dptr<DType>(),
+                              req[conv::kWeight], in_grad[conv::kWeight].dptr<DType>(),
+                              param_.no_bias ? kNullOp : req[conv::kBias],
+                              param_.no_bias ? nullptr : in_grad[conv::kBias].dptr<DType>());
+  }
+
+ private:
+  ConvolutionParam param_;
+};  // class DepthwiseConvolutionOp
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_DEPTHWISE_CONVOLUTION_INL_H_
@@ -0,0 +1,246 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file depthwise_convolution.cuh
+ * \brief gpu kernels of the depthwise convolutions
+ */
+#ifndef MXNET_OPERATOR_DEPTHWISE_CONVOLUTION_CUH_
+#define MXNET_OPERATOR_DEPTHWISE_CONVOLUTION_CUH_
+
+/*! \brief a block of kDepthwiseTileW x kDepthwiseThreadsH threads computes a tile of an output
+ *  plane of kDepthwiseTileW x kDepthwiseTileH, kDepthwiseRows outputs of a column per thread */
+const int kDepthwiseTileW = 32;
+const int kDepthwiseThreadsH = 8;
+const int kDepthwiseRows = 4;
+const int kDepthwiseTileH = kDepthwiseThreadsH * kDepthwiseRows;
+/*! \brief the threads of a block of the gradient reductions */
+const int kDepthwiseReduceThreads = 256;
+
+template<typename DType>
+__global__ void depthwise_forward_tiled_kernel(const DepthwiseArgs a,
+                                               const DType* __restrict in,
+                                               const DType* __restrict weight,
+                                               const DType* __restrict bias,
+                                               DType* __restrict out,
+                                               const int tiles_h, const int tiles_w,
+                                               const int patch_h, const int patch_w) {
+  extern __shared__ __align__(8) char smem[];
+  DType* patch = reinterpret_cast<DType*>(smem);
+  DType* filter = patch + patch_h * patch_w;
+  const int tid = threadIdx.y * blockDim.x + threadIdx.x;
+  const int nthread = blockDim.x * blockDim.y;
+  const int ntile = a.batch * a.channel * tiles_h * tiles_w;
+  for (int t = blockIdx.x; t < ntile; t += gridDim.x) {
+    const int p = t / (tiles_h * tiles_w);
+    const int c = p % a.channel;
+    const int oh0 = (t / tiles_w) % tiles_h * kDepthwiseTileH;
+    const int ow0 = t % tiles_w * kDepthwiseTileW;
+    const int ih0 = oh0 * a.stride_h - a.pad_h;
+    const int iw0 = ow0 * a.stride_w - a.pad_w;
+    // the input patch of the tile with its padding, and the filter of the channel
+    const DType* iplane = in + static_cast<size_t>(p) * a.in_plane();
+    for (int i = tid; i < patch_h * patch_w; i += nthread) {
+      const int ih = ih0 + i / patch_w, iw = iw0 + i % patch_w;
+      patch[i] = (ih >= 0 && ih < a.in_h && iw >= 0 && iw < a.in_w) ?
+                 iplane[ih * a.in_w + iw] : DType(0);
+    }
+    for (int i = tid; i < a.taps(); i += nthread) filter[i] = weight[c * a.taps() + i];
+    __syncthreads();
+    DType sum[kDepthwiseRows];
+    #pragma unroll
+    for (int r = 0; r < kDepthwiseRows; ++r) sum[r] = bias != nullptr ? bias[c] : DType(0);
+    for (int kh = 0; kh < a.kernel_h; ++kh) {
+      for (int kw = 0; kw < a.kernel_w; ++kw) {
+        const DType w = filter[kh * a.kernel_w + kw];
+        const int x = threadIdx.x * a.stride_w + kw * a.dilate_w;
+        #pragma unroll
+        for (int r = 0; r < kDepthwiseRows; ++r) {
+          const int y = (threadIdx.y + r * kDepthwiseThreadsH) * a.stride_h + kh * a.dilate_h;
+          sum[r] += w * patch[y * patch_w + x];
+        }
+      }
+    }
+    DType* oplane = out + static_cast<size_t>(p) * a.out_plane();
+    const int ow = ow0 + threadIdx.x;
+    #pragma unroll
+    for (int r = 0; r < kDepthwiseRows; ++r) {
+      const int oh = oh0 + threadIdx.y + r * kDepthwiseThreadsH;
+      if (oh < a.out_h && ow < a.out_w) oplane[oh * a.out_w + ow] = sum[r];
+    }
+    __syncthreads();
+  }
+}
+
+/*! \brief one thread per output, for the patches that do not fit in shared memory */
+template<typename DType>
+__global__ void depthwise_forward_kernel(const DepthwiseArgs a, const DType* __restrict in,
+                                         const DType* __restrict weight,
+                                         const DType* __restrict bias,
+                                         DType* __restrict out, const int N) {
+  CUDA_KERNEL_LOOP(i, N) {
+    const int p = i / a.out_plane(), c = p % a.channel;
+    const int oh = i % a.out_plane() / a.out_w, ow = i % a.out_w;
+    const DType* iplane = in + static_cast<size_t>(p) * a.in_plane();
+    const DType* w = weight + c * a.taps();
+    DType sum = bias != nullptr ? bias[c] : DType(0);
+    for (int kh = 0; kh < a.kernel_h; ++kh) {
+      const int ih = oh * a.stride_h - a.pad_h + kh * a.dilate_h;
+      if (ih < 0 || ih >= a.in_h) continue;
+      for (int kw = 0; kw < a.kernel_w; ++kw) {
+        const int iw = ow * a.stride_w - a.pad_w + kw * a.dilate_w;
+        if (iw >= 0 && iw < a.in_w) sum += w[kh * a.kernel_w + kw] * iplane[ih * a.in_w + iw];
+      }
+    }
+    out[i] = sum;
+  }
+}
+
+/*! \brief one thread per input, which gathers the outputs its taps reach */
+template<typename DType>
+__global__ void depthwise_backward_data_kernel(const DepthwiseArgs a,
+                                               const DType* __restrict ograd,
+                                               const DType* __restrict weight,
+                                               const OpReqType req,
+                                               DType* __restrict igrad, const int N) {
+  CUDA_KERNEL_LOOP(i, N) {
+    const int p = i / a.in_plane(), c = p % a.channel;
+    const int ih = i % a.in_plane() / a.in_w, iw = i % a.in_w;
+    const DType* oplane = ograd + static_cast<size_t>(p) * a.out_plane();
+    const DType* w = weight + c * a.taps();
+    DType sum = 0;
+    for (int kh = 0; kh < a.kernel_h; ++kh) {
+      const int y = ih + a.pad_h - kh * a.dilate_h;
+      if (y < 0 || y % a.stride_h != 0 || y / a.stride_h >= a.out_h) continue;
+      for (int kw = 0; kw < a.kernel_w; ++kw) {
+        const int x = iw + a.pad_w - kw * a.dilate_w;
+        if (x < 0 || x % a.stride_w != 0 || x / a.stride_w >= a.out_w) continue;
+        sum += w[kh * a.kernel_w + kw] * oplane[y / a.stride_h * a.out_w + x / a.stride_w];
+      }
+    }
+    KERNEL_ASSIGN(igrad[i], req, sum);
+  }
+}
+
+/*! \brief the sum of v over the threads of the block */
+template<typename DType>
+__device__ DType DepthwiseBlockSum(DType v, DType* buf) {
+  buf[threadIdx.x] = v;
+  __syncthreads();
+  for (int s = blockDim.x / 2; s > 0; s >>= 1) {
+    if (threadIdx.x < s) buf[threadIdx.x] += buf[threadIdx.x + s];
+    __syncthreads();
+  }
+  const DType sum = buf[0];
+  __syncthreads();
+  return sum;
+}
+
+/*! \brief a block per tap of a channel, or per channel for the bias, sums over the batch */
+template<typename DType>
+__global__ void depthwise_backward_weight_kernel(const DepthwiseArgs a,
+                                                 const DType* __restrict ograd,
+                                                 const DType* __restrict in,
+                                                 const OpReqType req, DType* __restrict wgrad,
+                                                 const OpReqType breq,
+                                                 DType* __restrict bgrad) {
+  __shared__ __align__(8) char smem[kDepthwiseReduceThreads * sizeof(DType)];
+  DType* buf = reinterpret_cast<DType*>(smem);
+  const int taps = a.taps() + (bgrad != nullptr);
+  const int nout = a.batch * a.out_plane();
+  for (int b = blockIdx.x; b < a.channel * taps; b += gridDim.x) {
+    const int c = b / taps, tap = b % taps;
+    if (tap == a.taps() ? breq == kNullOp : req == kNullOp) continue;
+    const int kh = tap / a.kernel_w, kw = tap % a.kernel_w;
+    DType sum = 0;
+    for (int j = threadIdx.x; j < nout; j += blockDim.x) {
+      const size_t p = static_cast<size_t>(j / a.out_plane()) * a.channel + c;
+      const int r = j % a.out_plane();
+      const DType g = ograd[p * a.out_plane() + r];
+      if (tap == a.taps()) {
+        sum += g;
+        continue;
+      }
+      const int ih = r / a.out_w * a.stride_h - a.pad_h + kh * a.dilate_h;
+      const int iw = r % a.out_w * a.stride_w - a.pad_w + kw * a.dilate_w;
+      if (ih >= 0 && ih < a.in_h && iw >= 0 && iw < a.in_w) {
+        sum += g * in[p * a.in_plane() + ih * a.in_w + iw];
+      }
+    }
+    sum = DepthwiseBlockSum(sum, buf);
+    if (threadIdx.x == 0) {
+      if (tap == a.taps()) {
+        KERNEL_ASSIGN(bgrad[c], breq, sum);
+      } else {
+        KERNEL_ASSIGN(wgrad[c * a.taps() + tap], req, sum);
+      }
+    }
+  }
+}
+
+template<typename DType>
+inline void Forward(mshadow::Stream<gpu>* s, const DepthwiseArgs& a, const DType* in,
+                    const DType* weight, const DType* bias, DType* out) {
+  using namespace mxnet_op;
+  cudaStream_t stream = mshadow::Stream<gpu>::GetStream(s);
+  const int patch_h = (kDepthwiseTileH - 1) * a.stride_h + (a.kernel_h - 1) * a.dilate_h + 1;
+  const int patch_w = (kDepthwiseTileW - 1) * a.stride_w + (a.kernel_w - 1) * a.dilate_w + 1;
+  const size_t smem = (patch_h * patch_w + a.taps()) * sizeof(DType);
+  if (smem <= 48 * 1024) {
+    const int tiles_h = (a.out_h + kDepthwiseTileH - 1) / kDepthwiseTileH;
+    const int tiles_w = (a.out_w + kDepthwiseTileW - 1) / kDepthwiseTileW;
+    const int ntile = a.batch * a.channel * tiles_h * tiles_w;
+    const int ngrid = std::min(mshadow::cuda::kMaxGridNum, ntile);
+    depthwise_forward_tiled_kernel<DType>
+      <<<ngrid, dim3(kDepthwiseTileW, kDepthwiseThreadsH), smem, stream>>>(
+        a, in, weight, bias, out, tiles_h, tiles_w, patch_h, patch_w);
+    MSHADOW_CUDA_POST_KERNEL_CHECK(depthwise_forward_tiled_kernel);
+  } else {
+    const int N = a.batch * a.channel * a.out_plane();
+    depthwise_forward_kernel<DType>
+      <<<cuda_get_num_blocks(N), mshadow::cuda::kBaseThreadNum, 0, stream>>>(
+        a, in, weight, bias, out, N);
+    MSHADOW_CUDA_POST_KERNEL_CHECK(depthwise_forward_kernel);
+  }
+}
+
+template<typename DType>
+inline void BackwardData(mshadow::Stream<gpu>* s, const DepthwiseArgs& a, const DType* ograd,
+                         const DType* weight, OpReqType req, DType* igrad) {
+  using namespace mxnet_op;
+  if (req == kNullOp) return;
+  const int N = a.batch * a.channel * a.in_plane();
+  depthwise_backward_data_kernel<DType>
+    <<<cuda_get_num_blocks(N), mshadow::cuda::kBaseThreadNum, 0,
+       mshadow::Stream<gpu>::GetStream(s)>>>(a, ograd, weight, req, igrad, N);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(depthwise_backward_data_kernel);
+}
+
+template<typename DType>
+inline void BackwardWeight(mshadow::Stream<gpu>* s, const DepthwiseArgs& a, const DType* ograd,
+                           const DType* in, OpReqType req, DType* wgrad,
+                           OpReqType breq, DType* bgrad) {
+  const int nblock = a.channel * (a.taps() + (bgrad != nullptr));
+  depthwise_backward_weight_kernel<DType>
+    <<<std::min(mshadow::cuda::kMaxGridNum, nblock), kDepthwiseReduceThreads, 0,
+       mshadow::Stream<gpu>::GetStream(s)>>>(a, ograd, in, req, wgrad, breq, bgrad);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(depthwise_backward_weight_kernel);
+}
+
+#endif  // MXNET_OPERATOR_DEPTHWISE_CONVOLUTION_CUH_
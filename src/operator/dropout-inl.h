@@ -35,13 +35,7 @@
 #include <algorithm>
 #include "./operator_common.h"
 #include "./mshadow_op.h"
-
-#if defined(USE_MKL) && defined(_OPENMP)
-#include <omp.h>
-
-#include <mkl_vml_functions.h>
-#include <mkl_vsl.h>
-#endif  // USE_MKL && _OPENMP
+#include "./mxnet_op.h"
 
 namespace dropout {
 enum DropoutOpInputs {kData};
@@ -53,27 +47,38 @@ enum DropoutOpMode {kTraining, kAlways};
 namespace mxnet {
 namespace op {
 
-#if defined(USE_MKL) && defined(_OPENMP)
-static void bernoulli_generate(int n, double p, int* r) {
-  int seed = 17 + rand() % 4096;  // NOLINT(runtime/threadsafe_fn)
-  int nthr = omp_get_max_threads();
-# pragma omp parallel num_threads(nthr)
-  {
-    const int ithr = omp_get_thread_num();
-    const int avg_amount = (n + nthr - 1) / nthr;
-    const int my_offset = ithr * avg_amount;
-    const int my_amount = std::min(my_offset + avg_amount, n) - my_offset;
-    if (my_amount > 0) {
-      VSLStreamStatePtr stream;
-      vslNewStream(&stream, VSL_BRNG_MCG31, seed);
-      vslSkipAheadStream(stream, my_offset);
-      viRngBernoulli(VSL_RNG_METHOD_BERNOULLI_ICDF, stream, my_amount,
-        r + my_offset, p);
-      vslDeleteStream(&stream);
+/*!
+ * \brief draws whether the 8 elements of a byte of the mask are kept and
+ *  scales the kept ones, in the same kernel. The mask keeps a bit for each
+ *  element, for the backward.
+ */
+template<int req>
+struct DropoutForwardKernel {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, common::random::PhiloxCall call, uint64_t threshold,
+                                  DType scale, int n, const DType* data, DType* out,
+                                  uint8_t* mask) {
+    common::random::PhiloxGenerator gen(call, i);
+    uint8_t bits = 0;
+    for (int j = 0; j < 8; ++j) {
+      const int k = i * 8 + j;
+      const bool keep = gen.Rand() < threshold;
+      if (k < n) KERNEL_ASSIGN(out[k], req, keep ? DType(data[k] * scale) : DType(0));
+      bits |= static_cast<uint8_t>(keep) << j;
     }
+    mask[i] = bits;
   }
-}
-#endif  // USE_MKL && _OPENMP
+};
+
+template<int req>
+struct DropoutBackwardKernel {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType scale, const DType* grad, const uint8_t* mask,
+                                  DType* gdata) {
+    const bool keep = (mask[i / 8] >> (i % 8)) & 1;
+    KERNEL_ASSIGN(gdata[i], req, keep ? DType(grad[i] * scale) : DType(0));
+  }
+};
 
 struct DropoutParam : public dmlc::Parameter<DropoutParam> {
   float p;
@@ -110,28 +115,24 @@ class DropoutOp : public Operator {
       CHECK_EQ(out_data.size(), 2U);
     }
     Stream<xpu> *s = ctx.get_stream<xpu>();
-    Tensor<xpu, 2, DType> data = in_data[dropout::kData].FlatTo2D<xpu, DType>(s);
-    Tensor<xpu, 2, DType> out = out_data[dropout::kOut].FlatTo2D<xpu, DType>(s);
+    const TBlob& data = in_data[dropout::kData];
+    const TBlob& out = out_data[dropout::kOut];
     if (ctx.is_train || mode_ == dropout::kAlways) {
-      Tensor<xpu, 2, DType> mask = out_data[dropout::kMask].FlatTo2D<xpu, DType>(s);
-#if !defined(__CUDACC__) && defined(USE_MKL) && defined(_OPENMP)
-      DType* outptr = out.dptr_;
-      DType* dataptr = data.dptr_;
-      int* maskptr = reinterpret_cast<int*>(mask.dptr_);
-      int count = mask.shape_[0]*mask.shape_[1];
-      bernoulli_generate(count, this->pkeep_, maskptr);
-  #pragma omp parallel for
-      for (int i = 0; i < count; ++i) {
-        outptr[i] = dataptr[i] * maskptr[i] * (1.0f / pkeep_);
-      }
-#else
-      Random<xpu> *prnd = ctx.requested[dropout::kRandom].get_random<xpu, real_t>(s);
-      mask = tcast<DType>(F<mshadow_op::threshold>(
-             prnd->uniform(mask.shape_), pkeep_) * (1.0f / pkeep_));
-      Assign(out, req[dropout::kOut], data * mask);
-#endif  // USE_MKL && _OPENMP
+      // an element is kept when its 32 random bits are below pkeep * 2^32
+      const uint64_t threshold = static_cast<uint64_t>(
+          static_cast<double>(pkeep_) * 4294967296.0);
+      const int n = data.Size();
+      common::random::ParallelRandom *prnd =
+        ctx.requested[dropout::kRandom].get_parallel_random();
+      MXNET_ASSIGN_REQ_SWITCH(req[dropout::kOut], Req, {
+        mxnet_op::Kernel<DropoutForwardKernel<Req>, xpu>::Launch(
+          s, (n + 7) / 8, prnd->Next(), threshold, DType(1.0f / pkeep_), n,
+          data.dptr<DType>(), out.dptr<DType>(), out_data[dropout::kMask].dptr<uint8_t>());
+      });
     } else {
-      Assign(out, req[dropout::kOut], F<mshadow_op::identity>(data));
+      Tensor<xpu, 2, DType> data2 = data.FlatTo2D<xpu, DType>(s);
+      Tensor<xpu, 2, DType> out2 = out.FlatTo2D<xpu, DType>(s);
+      Assign(out2, req[dropout::kOut], F<mshadow_op::identity>(data2));
     }
   }
 
@@ -147,25 +148,16 @@ class DropoutOp : public Operator {
     CHECK_EQ(out_grad.size(), 1U);
     CHECK_EQ(in_grad.size(), 1U);
     Stream<xpu> *s = ctx.get_stream<xpu>();
-    Tensor<xpu, 2, DType> grad = out_grad[dropout::kOut].FlatTo2D<xpu, DType>(s);
-    Tensor<xpu, 2, DType> mask = out_data[dropout::kMask].FlatTo2D<xpu, DType>(s);
-    Tensor<xpu, 2, DType> gdata = in_grad[dropout::kData].FlatTo2D<xpu, DType>(s);
     if (ctx.is_train || mode_ == dropout::kAlways) {
-#if !defined(__CUDACC__) && defined(USE_MKL) && defined(_OPENMP)
-      DType* ingradptr = gdata.dptr_;
-      DType* outgradptr = grad.dptr_;
-      int* maskptr = reinterpret_cast<int*>(mask.dptr_);
-
-      int count = mask.shape_[0]*mask.shape_[1];
-
-      #pragma omp parallel for
-      for (int i = 0; i < count; ++i) {
-        ingradptr[i] = outgradptr[i] * maskptr[i] * (1.0f / pkeep_);
-      }
-#else  // USE_MKL && _OPENMP
-      Assign(gdata, req[dropout::kData], grad * mask);
-#endif  // USE_MKL && _OPENMP
+      const uint8_t* mask = out_data[dropout::kMask].dptr<uint8_t>();
+      MXNET_ASSIGN_REQ_SWITCH(req[dropout::kData], Req, {
+        mxnet_op::Kernel<DropoutBackwardKernel<Req>, xpu>::Launch(
+          s, in_grad[dropout::kData].Size(), DType(1.0f / pkeep_),
+          out_grad[dropout::kOut].dptr<DType>(), mask, in_grad[dropout::kData].dptr<DType>());
+      });
     } else {
+      Tensor<xpu, 2, DType> grad = out_grad[dropout::kOut].FlatTo2D<xpu, DType>(s);
+      Tensor<xpu, 2, DType> gdata = in_grad[dropout::kData].FlatTo2D<xpu, DType>(s);
       Assign(gdata, req[dropout::kData], F<mshadow_op::identity>(grad));
     }
   }
@@ -199,7 +191,7 @@ class DropoutProp : public OperatorProperty {
     if (dshape.ndim() == 0) return false;
     out_shape->clear();
     out_shape->push_back(dshape);
-    out_shape->push_back(dshape);
+    out_shape->push_back(Shape1((dshape.Size() + 7) / 8));
     return true;
   }
 
@@ -214,9 +206,9 @@ class DropoutProp : public OperatorProperty {
       return false;
     }
 
-    size_t nout = this->ListOutputs().size();
     out_type->clear();
-    for (size_t i = 0; i < nout; ++i) out_type->push_back(dtype);
+    out_type->push_back(dtype);
+    out_type->push_back(mshadow::kUint8);
     return true;
   }
 
@@ -253,7 +245,7 @@ class DropoutProp : public OperatorProperty {
 
   std::vector<ResourceRequest> ForwardResource(
     const std::vector<TShape> &in_shape) const override {
-    return {ResourceRequest::kRandom};
+    return {ResourceRequest::kParallelRandom};
   }
 
   int NumVisibleOutputs() const override {
@@ -33,6 +33,7 @@
 #include <utility>
 #include "./operator_common.h"
 #include "./elemwise_op_common.h"
+#include "./packed_weight.h"
 
 
 namespace mxnet {
@@ -48,15 +49,52 @@ enum FullyConnectedOpOutputs {kOut};
 struct FullyConnectedParam : public dmlc::Parameter<FullyConnectedParam> {
   int num_hidden;
   bool no_bias;
+  bool cache_weight;
+  int weight_storage;
   DMLC_DECLARE_PARAMETER(FullyConnectedParam) {
     // TODO(bing) add support for boolean
     DMLC_DECLARE_FIELD(num_hidden).set_lower_bound(1)
     .describe("Number of hidden nodes of the output.");
     DMLC_DECLARE_FIELD(no_bias).set_default(false)
     .describe("Whether to disable bias parameter.");
+    DMLC_DECLARE_FIELD(cache_weight).set_default(false)
+    .describe("Whether the weight stays the same from the first inference forward on, so "
+              "that the cpu forward of float32 data keeps it in weight_storage. A weight at "
+              "another address, as after a rebind, is kept again.");
+    DMLC_DECLARE_FIELD(weight_storage)
+    .add_enum("float32", packed_weight::kFloat32)
+    .add_enum("float16", packed_weight::kFloat16)
+    .add_enum("int8", packed_weight::kInt8)
+    .set_default(packed_weight::kFloat32)
+    .describe("How the weight is kept with cache_weight: float32 packed for the gemm of "
+              "MKL, which other BLAS does without, or float16 or int8 with a scale per "
+              "row, which are converted in the product for batches of up to 16 rows.");
   }
 };
 
+/*!
+ * \brief out = data * wmat^T from the weight kept in packed
+ * \return false if there is no kept weight for xpu, DType and the storage
+ */
+template<typename xpu, typename DType>
+inline bool PackedForward(PackedWeight* packed, int storage,
+                          const mshadow::Tensor<xpu, 2, DType>& data,
+                          const mshadow::Tensor<xpu, 2, DType>& wmat,
+                          mshadow::Tensor<xpu, 2, DType>* out) {
+  return false;
+}
+
+inline bool PackedForward(PackedWeight* packed, int storage,
+                          const mshadow::Tensor<cpu, 2, float>& data,
+                          const mshadow::Tensor<cpu, 2, float>& wmat,
+                          mshadow::Tensor<cpu, 2, float>* out) {
+  const index_t M = data.size(0), N = wmat.size(0), K = wmat.size(1);
+  if (!packed->Matches(wmat.dptr_, M, N, K) && !packed->Pack(wmat.dptr_, M, N, K, storage)) {
+    return false;
+  }
+  return packed->Compute(data.dptr_, M, out->dptr_);
+}
+
 /**
  * \brief This is the implementation of fully connected operator.
  * \tparam xpu The device that the op will be executed on.
@@ -96,7 +134,10 @@ class FullyConnectedOp : public Operator {
     Tensor<xpu, 2, DType> wmat = in_data[fullc::kWeight].get<xpu, 2, DType>(s);
     Tensor<xpu, 2, DType> out = out_data[fullc::kOut].get_with_shape<xpu, 2, DType>(
         Shape2(oshape[0], oshape.ProdShape(1, oshape.ndim())), s);
-    out = dot(data, wmat.T());
+    if (!param_.cache_weight || ctx.is_train ||
+        !PackedForward(&packed_, param_.weight_storage, data, wmat, &out)) {
+      out = dot(data, wmat.T());
+    }
     if (!param_.no_bias) {
       Tensor<xpu, 1, DType> bias = in_data[fullc::kBias].get<xpu, 1, DType>(s);
       out += repmat(bias, data.size(0));
@@ -150,6 +191,8 @@ class FullyConnectedOp : public Operator {
 
  private:
   FullyConnectedParam param_;
+  /*! \brief the weight kept by cache_weight */
+  PackedWeight packed_;
 };  // class FullyConnectedOp
 
 // Decalre Factory function, used for dispatch specialization
@@ -0,0 +1,112 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file half_cpu.h
+ * \brief bulk fp16 <-> fp32 conversions for the cpu kernels
+ *
+ * The cpu has no fp16 arithmetic, the fp16 kernels convert blocks of
+ * kHalfChunk values to fp32, compute in fp32 and convert the results back,
+ * rounding once as the per element mshadow::half::half_t arithmetic does.
+ * The F16C version is compiled with a target attribute and chosen at
+ * runtime, so that a default build uses it on the cpus that have it; the
+ * cuda files, which only run the scalar loops, leave it out.
+ */
+#ifndef MXNET_OPERATOR_HALF_CPU_H_
+#define MXNET_OPERATOR_HALF_CPU_H_
+
+#include <mshadow/base.h>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && !defined(__CUDACC__) && (defined(__x86_64__) || defined(__i386__))
+#define MXNET_HALF_CPU_F16C 1
+#include <immintrin.h>
+#else
+#define MXNET_HALF_CPU_F16C 0
+#endif
+
+namespace mxnet {
+namespace op {
+namespace half_cpu {
+
+/*! \brief the number of values converted at a time, which fit in L1 as fp32 */
+const int kHalfChunk = 256;
+
+#if MXNET_HALF_CPU_F16C
+inline bool HasF16C() {
+  // f16c is not known to __builtin_cpu_supports, the cpus with avx2 have it
+  static const bool f16c = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return f16c;
+}
+
+__attribute__((target("avx,f16c")))
+inline size_t HalfToFloatF16C(const uint16_t* src, float* dst, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+  }
+  return i;
+}
+
+__attribute__((target("avx,f16c")))
+inline size_t FloatToHalfF16C(const float* src, uint16_t* dst, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                     _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+  }
+  return i;
+}
+#endif  // MXNET_HALF_CPU_F16C
+
+/*! \brief dst[0, n) = src[0, n) */
+inline void HalfToFloat(const mshadow::half::half_t* src, float* dst, size_t n) {
+  size_t i = 0;
+#if MXNET_HALF_CPU_F16C
+  if (HasF16C()) i = HalfToFloatF16C(reinterpret_cast<const uint16_t*>(src), dst, n);
+#endif  // MXNET_HALF_CPU_F16C
+  for (; i < n; ++i) dst[i] = static_cast<float>(src[i]);
+}
+
+/*! \brief dst[0, n) = src[0, n), rounded to the nearest */
+inline void FloatToHalf(const float* src, mshadow::half::half_t* dst, size_t n) {
+  size_t i = 0;
+#if MXNET_HALF_CPU_F16C
+  if (HasF16C()) i = FloatToHalfF16C(src, reinterpret_cast<uint16_t*>(dst), n);
+#endif  // MXNET_HALF_CPU_F16C
+  for (; i < n; ++i) dst[i] = mshadow::half::half_t(src[i]);
+}
+
+inline void Convert(const mshadow::half::half_t* src, float* dst, size_t n) {
+  HalfToFloat(src, dst, n);
+}
+
+inline void Convert(const float* src, mshadow::half::half_t* dst, size_t n) {
+  FloatToHalf(src, dst, n);
+}
+
+}  // namespace half_cpu
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_HALF_CPU_H_
@@ -43,6 +43,8 @@ MXNET_REGISTER_OP_PROPERTY(IdentityAttachKLSparseReg, IdentityAttachKLSparseRegP
 .add_arguments(IdentityAttachKLSparseRegParam::__FIELDS__());
 
 NNVM_REGISTER_OP(IdentityAttachKLSparseReg)
+// the penalty is added to the gradient of the output, even when it is zero
+.set_attr<bool>("TNonlossGradient", false)
 .set_attr<nnvm::FSetInputVarAttrOnCompose>("FSetInputVarAttrOnCompose",
     [](const nnvm::NodeAttrs& attrs, nnvm::NodePtr var, const int index) {
       if (var->attrs.dict.find("__init__") != var->attrs.dict.end()) return;
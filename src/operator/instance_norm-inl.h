@@ -31,9 +31,11 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include "./operator_common.h"
 #include "./mshadow_op.h"
+#include "./mxnet_op.h"
 
 namespace mxnet {
 namespace op {
@@ -52,6 +54,78 @@ struct InstanceNormParam : public dmlc::Parameter<InstanceNormParam> {
   }
 };  // struct InstanceNormParam
 
+/*!
+ * \brief the mean and variance of the row i of (n * c, rest) data in one
+ *  Welford pass, and the normalized row in a second
+ */
+template<int req>
+struct InstanceNormFused {
+  static const int kCPUGrain = 4;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, DType* mean, DType* var,
+                                  const DType* data, const DType* gamma, const DType* beta,
+                                  const int channels, const int rest, const DType eps) {
+    const DType* x = data + i * rest;
+    DType m = 0, m2 = 0;
+    for (int k = 0; k < rest; ++k) {
+      const DType delta = x[k] - m;
+      m += delta / (k + 1);
+      m2 += delta * (x[k] - m);
+    }
+    mean[i] = m;
+    var[i] = m2 / rest;
+    const DType scale = gamma[i % channels] / sqrt(var[i] + eps);
+    const DType shift = beta[i % channels] - m * scale;
+    for (int k = 0; k < rest; ++k) {
+      KERNEL_ASSIGN(out[i * rest + k], req, x[k] * scale + shift);
+    }
+  }
+};
+
+/*!
+ * \brief the gradient of the row i from the sums of the gradient of the
+ *  output and of its product with the normalized row, which are kept for the
+ *  gradients of gamma and beta
+ */
+template<int req>
+struct InstanceNormFusedGrad {
+  static const int kCPUGrain = 4;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* gdata, DType* sum_gout, DType* sum_gout_norm,
+                                  const DType* gout, const DType* data, const DType* mean,
+                                  const DType* var, const DType* gamma, const int channels,
+                                  const int rest, const DType eps) {
+    const DType* x = data + i * rest;
+    const DType* g = gout + i * rest;
+    const DType rstd = DType(1) / sqrt(var[i] + eps);
+    DType sg = 0, sgx = 0;
+    for (int k = 0; k < rest; ++k) {
+      sg += g[k];
+      sgx += g[k] * (x[k] - mean[i]);
+    }
+    sgx *= rstd;
+    sum_gout[i] = sg;
+    sum_gout_norm[i] = sgx;
+    const DType a = gamma[i % channels] * rstd;
+    const DType mg = sg / rest, mgx = sgx / rest;
+    for (int k = 0; k < rest; ++k) {
+      KERNEL_ASSIGN(gdata[i * rest + k], req, a * (g[k] - mg - (x[k] - mean[i]) * rstd * mgx));
+    }
+  }
+};
+
+/*! \brief the sum over the batch of the row values of the channel c */
+template<int req>
+struct InstanceNormChannelSum {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int c, DType* out, const DType* rows, const int batch,
+                                  const int channels) {
+    DType sum = 0;
+    for (int n = 0; n < batch; ++n) sum += rows[n * channels + c];
+    KERNEL_ASSIGN(out[c], req, sum);
+  }
+};
+
 template <typename xpu>
 class InstanceNormOp : public Operator {
  public:
@@ -87,6 +161,14 @@ class InstanceNormOp : public Operator {
     Tensor<xpu, 1> var = out_data[instance_norm::kVar].FlatTo1D<xpu, real_t>(s);
     Tensor<xpu, 1> mean =
         out_data[instance_norm::kMean].FlatTo1D<xpu, real_t>(s);
+    if (std::is_same<xpu, cpu>::value) {
+      MXNET_ASSIGN_REQ_SWITCH(req[instance_norm::kOut], req_type, {
+        mxnet_op::Kernel<InstanceNormFused<req_type>, xpu>::Launch(
+            s, n * c, out.dptr_, mean.dptr_, var.dptr_, data.dptr_, gamma.dptr_, beta.dptr_,
+            c, rest_dim, static_cast<real_t>(param_.eps));
+      });
+      return;
+    }
     // Calculate mean + var
     mean = scale * sumall_except_dim<0>(data);
     var = scale * sumall_except_dim<0>(F<mshadow_op::square>(
@@ -146,6 +228,29 @@ class InstanceNormOp : public Operator {
     Tensor<xpu, 1> gmean = workspace[0];
     Tensor<xpu, 1> gvar = workspace[1];
     Tensor<xpu, 1> tmp = workspace[2];
+    if (std::is_same<xpu, cpu>::value) {
+      // gmean and gvar take the sums over each row, then summed over the batch
+      const OpReqType data_req = req[instance_norm::kData];
+      if (data_req == kNullOp) {
+        mxnet_op::Kernel<InstanceNormFusedGrad<kNullOp>, xpu>::Launch(
+            s, n * c, gdata.dptr_, gmean.dptr_, gvar.dptr_, gout.dptr_, data.dptr_,
+            mean.dptr_, var.dptr_, gamma.dptr_, c, rest_dim, static_cast<real_t>(param_.eps));
+      }
+      MXNET_ASSIGN_REQ_SWITCH(data_req, req_type, {
+        mxnet_op::Kernel<InstanceNormFusedGrad<req_type>, xpu>::Launch(
+            s, n * c, gdata.dptr_, gmean.dptr_, gvar.dptr_, gout.dptr_, data.dptr_,
+            mean.dptr_, var.dptr_, gamma.dptr_, c, rest_dim, static_cast<real_t>(param_.eps));
+      });
+      MXNET_ASSIGN_REQ_SWITCH(req[instance_norm::kBeta], req_type, {
+        mxnet_op::Kernel<InstanceNormChannelSum<req_type>, xpu>::Launch(
+            s, c, gbeta.dptr_, gmean.dptr_, n, c);
+      });
+      MXNET_ASSIGN_REQ_SWITCH(req[instance_norm::kGamma], req_type, {
+        mxnet_op::Kernel<InstanceNormChannelSum<req_type>, xpu>::Launch(
+            s, c, ggamma.dptr_, gvar.dptr_, n, c);
+      });
+      return;
+    }
 
     // calculate temps
     gvar = sumall_except_dim<0>(
@@ -30,9 +30,11 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include "./operator_common.h"
 #include "./mshadow_op.h"
+#include "./mxnet_op.h"
 
 namespace mxnet {
 namespace op {
@@ -61,6 +63,67 @@ struct L2NormalizationParam : public dmlc::Parameter<L2NormalizationParam> {
   }
 };
 
+/*!
+ * \brief the groups of the mode over which the norms are taken, as the
+ *  (outer, length, inner) shape of the data whose length axis is normalized
+ */
+inline void L2NormalizationGroups(int mode, const TShape& shape, int* outer, int* length,
+                                  int* inner) {
+  if (mode == l2_normalization::kInstance) {
+    *outer = shape[0];
+    *length = shape.ProdShape(1, shape.ndim());
+    *inner = 1;
+  } else if (mode == l2_normalization::kChannel) {
+    *outer = shape[0];
+    *length = shape[1];
+    *inner = shape.ProdShape(2, shape.ndim());
+  } else {
+    *outer = shape[0] * shape[1];
+    *length = shape.ProdShape(2, shape.ndim());
+    *inner = 1;
+  }
+}
+
+/*! \brief the norm of the group i and the group divided by it, in one thread */
+struct L2NormalizationFused {
+  static const int kCPUGrain = 8;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, DType* norm, const DType* data,
+                                  const int length, const int inner, const DType eps) {
+    const int base = (i / inner) * length * inner + i % inner;
+    DType sum = 0;
+    for (int k = 0; k < length; ++k) {
+      const DType x = data[base + k * inner];
+      sum += x * x;
+    }
+    const DType nrm = sqrt(sum + eps);
+    norm[i] = nrm;
+    for (int k = 0; k < length; ++k) {
+      out[base + k * inner] = data[base + k * inner] / nrm;
+    }
+  }
+};
+
+/*! \brief the gradient of the group i, from its output and norm, in one thread */
+template<int req>
+struct L2NormalizationFusedGrad {
+  static const int kCPUGrain = 8;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* grad_in, const DType* grad_out,
+                                  const DType* out, const DType* norm, const int length,
+                                  const int inner) {
+    const int base = (i / inner) * length * inner + i % inner;
+    DType dot = 0;
+    for (int k = 0; k < length; ++k) {
+      dot += grad_out[base + k * inner] * out[base + k * inner];
+    }
+    for (int k = 0; k < length; ++k) {
+      const int j = base + k * inner;
+      KERNEL_ASSIGN(grad_in[j], req, (grad_out[j] - out[j] * dot) / norm[i]);
+    }
+  }
+};
+
 /**
  * \brief This is the implementation of l2 normalization operator.
  * \tparam xpu The device that the op will be executed on.
@@ -85,6 +148,17 @@ class L2NormalizationOp : public Operator {
     CHECK_EQ(out_data.size(), 2U);
     Stream<xpu> *s = ctx.get_stream<xpu>();
     TShape orig_shape = in_data[l2_normalization::kData].shape_;
+    if (param_.mode != l2_normalization::kInstance) CHECK_GE(orig_shape.ndim(), 3U);
+    if (FuseGroups()) {
+      int outer, length, inner;
+      L2NormalizationGroups(param_.mode, orig_shape, &outer, &length, &inner);
+      mxnet_op::Kernel<L2NormalizationFused, xpu>::Launch(
+          s, outer * inner, out_data[l2_normalization::kOut].dptr<real_t>(),
+          out_data[l2_normalization::kNorm].dptr<real_t>(),
+          in_data[l2_normalization::kData].dptr<real_t>(), length, inner,
+          static_cast<real_t>(param_.eps));
+      return;
+    }
     if (param_.mode == l2_normalization::kInstance) {
       Shape<2> dshape = Shape2(orig_shape[0],
         orig_shape.ProdShape(1, orig_shape.ndim()));
@@ -144,6 +218,19 @@ class L2NormalizationOp : public Operator {
 
     Stream<xpu> *s = ctx.get_stream<xpu>();
     TShape orig_shape = out_data[l2_normalization::kOut].shape_;
+    if (req[l2_normalization::kData] == kNullOp) return;
+    if (FuseGroups()) {
+      int outer, length, inner;
+      L2NormalizationGroups(param_.mode, orig_shape, &outer, &length, &inner);
+      MXNET_ASSIGN_REQ_SWITCH(req[l2_normalization::kData], req_type, {
+        mxnet_op::Kernel<L2NormalizationFusedGrad<req_type>, xpu>::Launch(
+            s, outer * inner, in_grad[l2_normalization::kData].dptr<real_t>(),
+            out_grad[l2_normalization::kOut].dptr<real_t>(),
+            out_data[l2_normalization::kOut].dptr<real_t>(),
+            out_data[l2_normalization::kNorm].dptr<real_t>(), length, inner);
+      });
+      return;
+    }
     if (param_.mode == l2_normalization::kInstance) {
       Shape<2> dshape = Shape2(orig_shape[0],
         orig_shape.ProdShape(1, orig_shape.ndim()));
@@ -204,6 +291,15 @@ class L2NormalizationOp : public Operator {
   }
 
  private:
+  /*!
+   * \brief whether a thread takes a whole group, on the cpu and for the channel
+   *  mode on the gpu, where neighbouring threads read neighbouring values. The
+   *  gpu reduces the long contiguous groups of the other modes with mshadow
+   */
+  bool FuseGroups() const {
+    return std::is_same<xpu, cpu>::value || param_.mode == l2_normalization::kChannel;
+  }
+
   L2NormalizationParam param_;
 };  // class L2NormalizationOp
 
@@ -25,7 +25,9 @@
 #ifndef MXNET_OPERATOR_LINALG_IMPL_H_
 #define MXNET_OPERATOR_LINALG_IMPL_H_
 
+#include <dmlc/omp.h>
 #include <algorithm>
+#include <vector>
 
 // Convenience functions.
 inline void linalg_check_batch_size(int A, int B, int C) {
@@ -34,6 +36,19 @@ inline void linalg_check_batch_size(int A, int B, int C) {
   CHECK_GT(A, 0) << "Zero batch size for arguments to linear algebra operator";
 }
 
+// The matrices of a cpu batch that are too small for the BLAS/LAPACK library to
+// thread are processed by separate OpenMP threads, the larger ones one after the other.
+const int kLinalgBatchParallelMaxDim = 128;
+
+inline int linalg_batch_num_threads(int batch, int dim) {
+#ifdef _OPENMP
+  if (batch < 2 || dim > kLinalgBatchParallelMaxDim || omp_in_parallel()) return 1;
+  return std::min(batch, omp_get_max_threads());
+#else
+  return 1;
+#endif
+}
+
 //////////////////////////////// GEMM ////////////////////////////////////////////
 
 // CPU/GPU-versions of BLAS3 function "gemm". Please refer to the BLAS3-documentation
@@ -65,12 +80,44 @@ void linalg_gemm<cpu, DType>(const Tensor<cpu, 2, DType>& A, const Tensor<cpu, 2
 LINALG_CPU_GEMM(sgemm, float)
 LINALG_CPU_GEMM(dgemm, double)
 
+#if MSHADOW_USE_MKL == 1
+
+// MKL runs the gemms of the batch as one call, which splits them between its threads
+
+#define LINALG_CPU_BATCH_GEMM(fname, DType) \
+template<> inline \
+void linalg_batch_gemm<cpu, DType>(const Tensor<cpu, 3, DType>& A, const Tensor<cpu, 3, DType>& B, \
+                                   const Tensor<cpu, 3, DType>& C, DType alpha, DType beta, \
+                                   bool tA, bool tB, Stream<cpu> *s) { \
+  linalg_check_batch_size(A.size(0), B.size(0), C.size(0)); \
+  check_gemm(A[0], B[0], C[0], alpha, beta, tA, tB); \
+  const MKL_INT batch = A.size(0); \
+  std::vector<const DType*> a(batch), b(batch); \
+  std::vector<DType*> c(batch); \
+  for (MKL_INT i = 0; i < batch; ++i) { \
+    a[i] = A.dptr_ + i * A.size(1) * A.stride_; \
+    b[i] = B.dptr_ + i * B.size(1) * B.stride_; \
+    c[i] = C.dptr_ + i * C.size(1) * C.stride_; \
+  } \
+  const CBLAS_TRANSPOSE ta = tA ? CblasTrans : CblasNoTrans, tb = tB ? CblasTrans : CblasNoTrans; \
+  const MKL_INT m = C.size(1), n = C.size(2), k = tA ? A.size(1) : A.size(2); \
+  const MKL_INT lda = A.stride_, ldb = B.stride_, ldc = C.stride_; \
+  cblas_##fname(CblasRowMajor, &ta, &tb, &m, &n, &k, &alpha, a.data(), &lda, b.data(), &ldb, \
+                &beta, c.data(), &ldc, 1, &batch); \
+}
+LINALG_CPU_BATCH_GEMM(sgemm_batch, float)
+LINALG_CPU_BATCH_GEMM(dgemm_batch, double)
+
+#else
+
 #define LINALG_CPU_BATCH_GEMM(DType) \
 template<> inline \
 void linalg_batch_gemm<cpu, DType>(const Tensor<cpu, 3, DType>& A, const Tensor<cpu, 3, DType>& B, \
                                    const Tensor<cpu, 3, DType>& C, DType alpha, DType beta, \
                                    bool tA, bool tB, Stream<cpu> *s) { \
   linalg_check_batch_size(A.size(0), B.size(0), C.size(0)); \
+  const int nthread = linalg_batch_num_threads(A.size(0), std::max(C.size(1), C.size(2))); \
+  _Pragma("omp parallel for num_threads(nthread) if (nthread > 1)") \
   for (index_t i = 0; i < A.size(0); ++i) { \
     linalg_gemm(A[i], B[i], C[i], alpha, beta, tA, tB); \
   } \
@@ -78,6 +125,28 @@ void linalg_batch_gemm<cpu, DType>(const Tensor<cpu, 3, DType>& A, const Tensor<
 LINALG_CPU_BATCH_GEMM(float)
 LINALG_CPU_BATCH_GEMM(double)
 
+#endif  // MSHADOW_USE_MKL
+
+// BLAS has no float16 gemm, the operators only run it on the gpu
+
+template<> inline
+void linalg_gemm<cpu, mshadow::half::half_t>(const Tensor<cpu, 2, mshadow::half::half_t>& A,
+                                             const Tensor<cpu, 2, mshadow::half::half_t>& B,
+                                             const Tensor<cpu, 2, mshadow::half::half_t>& C,
+                                             mshadow::half::half_t alpha,
+                                             mshadow::half::half_t beta,
+                                             bool tA, bool tB, Stream<cpu> *s) {
+  LOG(FATAL) << "float16 gemm is only supported on the gpu";
+}
+
+template<> inline
+void linalg_batch_gemm<cpu, mshadow::half::half_t>(
+    const Tensor<cpu, 3, mshadow::half::half_t>& A, const Tensor<cpu, 3, mshadow::half::half_t>& B,
+    const Tensor<cpu, 3, mshadow::half::half_t>& C, mshadow::half::half_t alpha,
+    mshadow::half::half_t beta, bool tA, bool tB, Stream<cpu> *s) {
+  LOG(FATAL) << "float16 gemm is only supported on the gpu";
+}
+
 #ifdef __CUDACC__
 
 template<typename DType>
@@ -108,6 +177,100 @@ void linalg_gemm<gpu, DType>(const Tensor<gpu, 2, DType>& A, const Tensor<gpu, 2
 LINALG_GPU_GEMM(Sgemm, float)
 LINALG_GPU_GEMM(Dgemm, double)
 
+// float16 gemms accumulate in float32, on the Tensor Cores from CUDA 9 on
+#if CUDA_VERSION >= 9000
+#define LINALG_CUBLAS_HALF_ALGO CUBLAS_GEMM_DEFAULT_TENSOR_OP
+#elif CUDA_VERSION >= 8000
+#define LINALG_CUBLAS_HALF_ALGO CUBLAS_GEMM_DFALT
+#endif
+
+template<> inline
+void linalg_gemm<gpu, mshadow::half::half_t>(const Tensor<gpu, 2, mshadow::half::half_t>& A,
+                                             const Tensor<gpu, 2, mshadow::half::half_t>& B,
+                                             const Tensor<gpu, 2, mshadow::half::half_t>& C,
+                                             mshadow::half::half_t alpha,
+                                             mshadow::half::half_t beta,
+                                             bool tA, bool tB, Stream<gpu> *s) {
+  using namespace mxnet;
+  using mshadow::gpu;
+  CHECK_NOTNULL(s);
+  check_gemm(A, B, C, alpha, beta, tA, tB);
+  const float alpha_f = static_cast<float>(alpha), beta_f = static_cast<float>(beta);
+#if CUDA_VERSION >= 8000
+  CUBLAS_CALL(cublasGemmEx(Stream<gpu>::GetBlasHandle(s),
+                           (tB ? CUBLAS_OP_T : CUBLAS_OP_N),
+                           (tA ? CUBLAS_OP_T : CUBLAS_OP_N),
+                           C.size(1), C.size(0), (tB ? B.size(1) : B.size(0)),
+                           &alpha_f, B.dptr_, CUDA_R_16F, B.stride_, A.dptr_, CUDA_R_16F, A.stride_,
+                           &beta_f, C.dptr_, CUDA_R_16F, C.stride_, CUDA_R_32F,
+                           LINALG_CUBLAS_HALF_ALGO));
+#else
+  CUBLAS_CALL(cublasSgemmEx(Stream<gpu>::GetBlasHandle(s),
+                            (tB ? CUBLAS_OP_T : CUBLAS_OP_N),
+                            (tA ? CUBLAS_OP_T : CUBLAS_OP_N),
+                            C.size(1), C.size(0), (tB ? B.size(1) : B.size(0)),
+                            &alpha_f, B.dptr_, CUBLAS_DATA_HALF, B.stride_,
+                            A.dptr_, CUBLAS_DATA_HALF, A.stride_,
+                            &beta_f, C.dptr_, CUBLAS_DATA_HALF, C.stride_));
+#endif  // CUDA_VERSION >= 8000
+}
+
+#if CUDA_VERSION >= 8000
+
+// the matrices of a batch are evenly spaced, so that cublas needs no array of their addresses
+
+#define LINALG_GPU_BATCH_GEMM(fname, DType) \
+template<> inline \
+void linalg_batch_gemm<gpu, DType>(const Tensor<gpu, 3, DType>& A, const Tensor<gpu, 3, DType>& B, \
+                                   const Tensor<gpu, 3, DType>& C, DType alpha, DType beta, \
+                                   bool tA, bool tB, Stream<gpu> *s) { \
+  using namespace mxnet; \
+  using mshadow::gpu; \
+  CHECK_NOTNULL(s); \
+  linalg_check_batch_size(A.size(0), B.size(0), C.size(0)); \
+  check_gemm(A[0], B[0], C[0], alpha, beta, tA, tB); \
+  CUBLAS_CALL(cublas##fname(Stream<gpu>::GetBlasHandle(s), \
+                            (tB ? CUBLAS_OP_T : CUBLAS_OP_N), \
+                            (tA ? CUBLAS_OP_T : CUBLAS_OP_N), \
+                            C.size(2), C.size(1), (tB ? B.size(2) : B.size(1)), \
+                            &alpha, B.dptr_, B.stride_, B.size(1) * B.stride_, \
+                            A.dptr_, A.stride_, A.size(1) * A.stride_, \
+                            &beta, C.dptr_, C.stride_, C.size(1) * C.stride_, A.size(0))) \
+}
+LINALG_GPU_BATCH_GEMM(SgemmStridedBatched, float)
+LINALG_GPU_BATCH_GEMM(DgemmStridedBatched, double)
+
+template<> inline
+void linalg_batch_gemm<gpu, mshadow::half::half_t>(
+    const Tensor<gpu, 3, mshadow::half::half_t>& A, const Tensor<gpu, 3, mshadow::half::half_t>& B,
+    const Tensor<gpu, 3, mshadow::half::half_t>& C, mshadow::half::half_t alpha,
+    mshadow::half::half_t beta, bool tA, bool tB, Stream<gpu> *s) {
+  using namespace mxnet;
+  using mshadow::gpu;
+  CHECK_NOTNULL(s);
+  linalg_check_batch_size(A.size(0), B.size(0), C.size(0));
+  check_gemm(A[0], B[0], C[0], alpha, beta, tA, tB);
+#if CUDA_VERSION >= 9000
+  const float alpha_f = static_cast<float>(alpha), beta_f = static_cast<float>(beta);
+  CUBLAS_CALL(cublasGemmStridedBatchedEx(Stream<gpu>::GetBlasHandle(s),
+                                         (tB ? CUBLAS_OP_T : CUBLAS_OP_N),
+                                         (tA ? CUBLAS_OP_T : CUBLAS_OP_N),
+                                         C.size(2), C.size(1), (tB ? B.size(2) : B.size(1)),
+                                         &alpha_f, B.dptr_, CUDA_R_16F, B.stride_,
+                                         B.size(1) * B.stride_,
+                                         A.dptr_, CUDA_R_16F, A.stride_, A.size(1) * A.stride_,
+                                         &beta_f, C.dptr_, CUDA_R_16F, C.stride_,
+                                         C.size(1) * C.stride_, A.size(0), CUDA_R_32F,
+                                         LINALG_CUBLAS_HALF_ALGO));
+#else
+  for (index_t i = 0; i < A.size(0); ++i) {
+    linalg_gemm(A[i], B[i], C[i], alpha, beta, tA, tB, s);
+  }
+#endif  // CUDA_VERSION >= 9000
+}
+
+#else
+
 #define LINALG_GPU_BATCH_GEMM(fname, DType) \
 template<> inline \
 void linalg_batch_gemm<gpu, DType>(const Tensor<gpu, 3, DType>& A, const Tensor<gpu, 3, DType>& B, \
@@ -145,6 +308,19 @@ void linalg_batch_gemm<gpu, DType>(const Tensor<gpu, 3, DType>& A, const Tensor<
 LINALG_GPU_BATCH_GEMM(SgemmBatched, float)
 LINALG_GPU_BATCH_GEMM(DgemmBatched, double)
 
+template<> inline
+void linalg_batch_gemm<gpu, mshadow::half::half_t>(
+    const Tensor<gpu, 3, mshadow::half::half_t>& A, const Tensor<gpu, 3, mshadow::half::half_t>& B,
+    const Tensor<gpu, 3, mshadow::half::half_t>& C, mshadow::half::half_t alpha,
+    mshadow::half::half_t beta, bool tA, bool tB, Stream<gpu> *s) {
+  linalg_check_batch_size(A.size(0), B.size(0), C.size(0));
+  for (index_t i = 0; i < A.size(0); ++i) {
+    linalg_gemm(A[i], B[i], C[i], alpha, beta, tA, tB, s);
+  }
+}
+
+#endif  // CUDA_VERSION >= 8000
+
 #endif
 
 //////////////////////////////// TRSM ////////////////////////////////////////////
@@ -183,6 +359,8 @@ template<> inline \
 void linalg_batch_trsm<cpu, DType>(const Tensor<cpu, 3, DType>& A, const Tensor<cpu, 3, DType>& B, \
                    DType alpha, bool rightside, bool lower, bool transpose, Stream<cpu> *s) { \
   linalg_check_batch_size(A.size(0), B.size(0), B.size(0)); \
+  const int nthread = linalg_batch_num_threads(A.size(0), std::max(B.size(1), B.size(2))); \
+  _Pragma("omp parallel for num_threads(nthread) if (nthread > 1)") \
   for (index_t i = 0; i < A.size(0); ++i) { \
     linalg_trsm(A[i], B[i], alpha, rightside, lower, transpose); \
   } \
@@ -286,8 +464,19 @@ void linalg_batch_trmm<xpu, DType>(const Tensor<xpu, 3, DType>& A, const Tensor<
     linalg_trmm(A[i], B[i], alpha, rightside, lower, transpose, s); \
   } \
 }
-LINALG_XPU_BATCH_TRMM(cpu, float)
-LINALG_XPU_BATCH_TRMM(cpu, double)
+#define LINALG_CPU_BATCH_TRMM(DType) \
+template<> inline \
+void linalg_batch_trmm<cpu, DType>(const Tensor<cpu, 3, DType>& A, const Tensor<cpu, 3, DType>& B, \
+                    DType alpha, bool rightside, bool lower, bool transpose, Stream<cpu> *s) { \
+  linalg_check_batch_size(A.size(0), B.size(0), B.size(0)); \
+  const int nthread = linalg_batch_num_threads(A.size(0), std::max(B.size(1), B.size(2))); \
+  _Pragma("omp parallel for num_threads(nthread) if (nthread > 1)") \
+  for (index_t i = 0; i < A.size(0); ++i) { \
+    linalg_trmm(A[i], B[i], alpha, rightside, lower, transpose); \
+  } \
+}
+LINALG_CPU_BATCH_TRMM(float)
+LINALG_CPU_BATCH_TRMM(double)
 
 #ifdef __CUDACC__
 
@@ -341,15 +530,24 @@ void linalg_potrf<cpu, DType>(const Tensor<cpu, 2, DType>& A, bool lower, Stream
 LINALG_CPU_POTRF(spotrf, float)
 LINALG_CPU_POTRF(dpotrf, double)
 
-#define LINALG_CPU_BATCH_POTRF(DType) \
+// The first matrix is done alone so that a build without lapack fails outside
+// of the parallel region, the failures of the others are reported after it.
+#define LINALG_CPU_BATCH_POTRF(fname, DType) \
 template<> inline \
 void linalg_batch_potrf<cpu, DType>(const Tensor<cpu, 3, DType>& A, bool lower, Stream<cpu> *s) { \
-  for (index_t i = 0; i < A.size(0); ++i) { \
-    linalg_potrf(A[i], lower); \
+  if (A.size(0) == 0) return; \
+  linalg_potrf(A[0], lower); \
+  int failed(0); \
+  const int nthread = linalg_batch_num_threads(A.size(0) - 1, A.size(1)); \
+  _Pragma("omp parallel for num_threads(nthread) if (nthread > 1) reduction(+:failed)") \
+  for (index_t i = 1; i < A.size(0); ++i) { \
+    failed += (MXNET_LAPACK_##fname(MXNET_LAPACK_ROW_MAJOR, (lower ? 'L' : 'U'), A.size(1), \
+               A[i].dptr_, A.stride_) != 0); \
   } \
+  CHECK_EQ(failed, 0) << #fname << " failed in lapack on cpu for " << failed << " matrices."; \
 }
-LINALG_CPU_BATCH_POTRF(float)
-LINALG_CPU_BATCH_POTRF(double)
+LINALG_CPU_BATCH_POTRF(spotrf, float)
+LINALG_CPU_BATCH_POTRF(dpotrf, double)
 
 #if MXNET_USE_CUSOLVER == 1
 
@@ -387,6 +585,36 @@ void linalg_potrf<gpu, DType>(const Tensor<gpu, 2, DType>& A, bool lower, Stream
 LINALG_GPU_POTRF(DnSpotrf, float)
 LINALG_GPU_POTRF(DnDpotrf, double)
 
+#if CUDA_VERSION >= 9010
+
+// cuSOLVER factors the whole batch in one call
+#define LINALG_GPU_BATCH_POTRF(fname, DType) \
+template<> inline \
+void linalg_batch_potrf<gpu, DType>(const Tensor<gpu, 3, DType>& A, bool lower, Stream<gpu> *s) { \
+  using namespace mxnet; \
+  using mshadow::gpu; \
+  CHECK_NOTNULL(s); \
+  CHECK_GT(A.size(0), 0); \
+  check_potrf(A[0], lower); \
+  Storage::Handle offsets = Storage::Get()->Alloc(sizeof(DType*)*A.size(0), Context::GPU()); \
+  Storage::Handle info = Storage::Get()->Alloc(sizeof(int)*A.size(0), Context::GPU()); \
+  using namespace mshadow::cuda; \
+  int ngrid = std::min(kMaxGridNum, \
+                       static_cast<int>((A.size(0) + kBaseThreadNum - 1) / kBaseThreadNum)); \
+  linalgCollectBatchOffsetsGPU<<<ngrid, kBaseThreadNum, 0, mshadow::Stream<gpu>::GetStream(s)>>> \
+    (static_cast<DType **>(offsets.dptr), A.dptr_, A.size(1)*A.stride_, A.size(0)); \
+  CUSOLVER_CALL(cusolver##fname(Stream<gpu>::GetSolverHandle(s), \
+                (lower ? CUBLAS_FILL_MODE_UPPER : CUBLAS_FILL_MODE_LOWER), \
+                A.size(1), static_cast<DType **>(offsets.dptr), A.stride_, \
+                static_cast<int *>(info.dptr), A.size(0))); \
+  Storage::Get()->Free(offsets); \
+  Storage::Get()->Free(info); \
+}
+LINALG_GPU_BATCH_POTRF(DnSpotrfBatched, float)
+LINALG_GPU_BATCH_POTRF(DnDpotrfBatched, double)
+
+#else
+
 #define LINALG_GPU_BATCH_POTRF(fname, DType) \
 template<> inline \
 void linalg_batch_potrf<gpu, DType>(const Tensor<gpu, 3, DType>& A, bool lower, Stream<gpu> *s) { \
@@ -410,6 +638,8 @@ void linalg_batch_potrf<gpu, DType>(const Tensor<gpu, 3, DType>& A, bool lower,
 LINALG_GPU_BATCH_POTRF(DnSpotrf, float)
 LINALG_GPU_BATCH_POTRF(DnDpotrf, double)
 
+#endif  // CUDA_VERSION >= 9010
+
 #endif
 
 //////////////////////////////// POTRI ////////////////////////////////////////////
@@ -435,15 +665,23 @@ void linalg_potri<cpu, DType>(const Tensor<cpu, 2, DType>& A, bool lower, Stream
 LINALG_CPU_POTRI(spotri, float)
 LINALG_CPU_POTRI(dpotri, double)
 
-#define LINALG_CPU_BATCH_POTRI(DType) \
+// like the batch potrf
+#define LINALG_CPU_BATCH_POTRI(fname, DType) \
 template<> inline \
 void linalg_batch_potri<cpu, DType>(const Tensor<cpu, 3, DType>& A, bool lower, Stream<cpu> *s) { \
-  for (index_t i = 0; i < A.size(0); ++i) { \
-    linalg_potri(A[i], lower); \
+  if (A.size(0) == 0) return; \
+  linalg_potri(A[0], lower); \
+  int failed(0); \
+  const int nthread = linalg_batch_num_threads(A.size(0) - 1, A.size(1)); \
+  _Pragma("omp parallel for num_threads(nthread) if (nthread > 1) reduction(+:failed)") \
+  for (index_t i = 1; i < A.size(0); ++i) { \
+    failed += (MXNET_LAPACK_##fname(MXNET_LAPACK_ROW_MAJOR, (lower ? 'L' : 'U'), A.size(1), \
+               A[i].dptr_, A.stride_) != 0); \
   } \
+  CHECK_EQ(failed, 0) << #fname << " failed in lapack on cpu for " << failed << " matrices."; \
 }
-LINALG_CPU_BATCH_POTRI(float)
-LINALG_CPU_BATCH_POTRI(double)
+LINALG_CPU_BATCH_POTRI(spotri, float)
+LINALG_CPU_BATCH_POTRI(dpotri, double)
 
 #ifdef __CUDACC__
 
@@ -25,8 +25,11 @@
 #define MXNET_OPERATOR_LOSS_BINARY_OP_INL_H_
 
 #include <mxnet/operator_util.h>
+#include <algorithm>
+#include <cmath>
 #include <vector>
 #include "./mshadow_op.h"
+#include "./mxnet_op.h"
 #include "./elemwise_op_common.h"
 
 namespace mxnet {
@@ -46,6 +49,157 @@ inline bool SoftmaxCrossEntropyShape(const nnvm::NodeAttrs& attrs,
   return true;
 }
 
+namespace softmax_ce {
+
+/*! \brief the loss of a row is at most -log(1e-8), as if its probability were clipped */
+const float kMaxLoss = 18.420680743952367f;
+
+/*!
+ * \brief merges the running maximum m and sum s of exp(x - m) of a part of a
+ *  row with the ones of another part
+ */
+template<typename AType>
+MSHADOW_XINLINE void Merge(AType* m, AType* s, const AType m2, const AType s2) {
+  if (m2 > *m) {
+    *s = *s * exp(*m - m2) + s2;
+    *m = m2;
+  } else if (s2 > 0) {
+    *s += s2 * exp(m2 - *m);
+  }
+}
+
+/*! \brief log(sum_j exp(x_j)) of a row of n values in one pass */
+template<typename DType, typename AType>
+MSHADOW_XINLINE AType LogSumExp(const DType* x, const int n) {
+  AType m = -INFINITY, s = 0;
+  for (int j = 0; j < n; ++j) Merge(&m, &s, AType(x[j]), AType(1));
+  return m + log(s);
+}
+
+/*! \brief the loss of each row, from its log-sum-exp */
+template<typename AType>
+struct row_loss {
+  /*! \brief a row is enough work for a thread */
+  static const int kCPUGrain = 1;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* loss, const DType* data, const DType* label,
+                                  const int n) {
+    const DType* x = data + static_cast<size_t>(i) * n;
+    const AType l = LogSumExp<DType, AType>(x, n) - AType(x[static_cast<int>(label[i])]);
+    loss[i] = DType(l < AType(kMaxLoss) ? l : AType(kMaxLoss));
+  }
+};
+
+/*! \brief the gradient of a row, its softmax less the one-hot label, times the scale */
+template<typename AType, int req>
+struct row_grad {
+  static const int kCPUGrain = 1;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* grad, const DType* data, const DType* label,
+                                  const DType* scale, const int n) {
+    const DType* x = data + static_cast<size_t>(i) * n;
+    DType* g = grad + static_cast<size_t>(i) * n;
+    const AType lse = LogSumExp<DType, AType>(x, n);
+    const AType a = AType(scale[0]);
+    const int k = static_cast<int>(label[i]);
+    for (int j = 0; j < n; ++j) {
+      const AType p = exp(AType(x[j]) - lse) - AType(j == k);
+      KERNEL_ASSIGN(g[j], req, DType(a * p));
+    }
+  }
+};
+
+#ifdef __CUDACC__
+const int kRowThreads = 256;
+
+/*! \brief the log-sum-exp of row blockIdx.x, reduced over the threads of the block */
+template<typename DType, typename AType>
+__device__ AType BlockLogSumExp(const DType* x, const int n) {
+  __shared__ AType shm[kRowThreads], shs[kRowThreads];
+  AType m = -INFINITY, s = 0;
+  for (int j = threadIdx.x; j < n; j += blockDim.x) Merge(&m, &s, AType(x[j]), AType(1));
+  shm[threadIdx.x] = m;
+  shs[threadIdx.x] = s;
+  __syncthreads();
+  for (int k = blockDim.x / 2; k > 0; k >>= 1) {
+    if (threadIdx.x < k) {
+      Merge(&shm[threadIdx.x], &shs[threadIdx.x], shm[threadIdx.x + k], shs[threadIdx.x + k]);
+    }
+    __syncthreads();
+  }
+  const AType lse = shm[0] + log(shs[0]);
+  __syncthreads();
+  return lse;
+}
+
+template<typename DType, typename AType>
+__global__ void row_loss_kernel(DType* loss, const DType* data, const DType* label,
+                                const int nrow, const int n) {
+  for (int i = blockIdx.x; i < nrow; i += gridDim.x) {
+    const DType* x = data + static_cast<size_t>(i) * n;
+    const AType lse = BlockLogSumExp<DType, AType>(x, n);
+    if (threadIdx.x == 0) {
+      const AType l = lse - AType(x[static_cast<int>(label[i])]);
+      loss[i] = DType(l < AType(kMaxLoss) ? l : AType(kMaxLoss));
+    }
+  }
+}
+
+template<typename DType, typename AType, int req>
+__global__ void row_grad_kernel(DType* grad, const DType* data, const DType* label,
+                                const DType* scale, const int nrow, const int n) {
+  for (int i = blockIdx.x; i < nrow; i += gridDim.x) {
+    const DType* x = data + static_cast<size_t>(i) * n;
+    DType* g = grad + static_cast<size_t>(i) * n;
+    const AType lse = BlockLogSumExp<DType, AType>(x, n);
+    const AType a = AType(scale[0]);
+    const int k = static_cast<int>(label[i]);
+    for (int j = threadIdx.x; j < n; j += blockDim.x) {
+      const AType p = exp(AType(x[j]) - lse) - AType(j == k);
+      KERNEL_ASSIGN(g[j], req, DType(a * p));
+    }
+  }
+}
+
+template<typename DType, typename AType>
+inline void RowLoss(mshadow::Stream<gpu>* s, DType* loss, const DType* data, const DType* label,
+                    const int nrow, const int n) {
+  const int ngrid = std::min(nrow, mshadow::cuda::kMaxGridNum);
+  row_loss_kernel<DType, AType><<<ngrid, kRowThreads, 0, mshadow::Stream<gpu>::GetStream(s)>>>(
+      loss, data, label, nrow, n);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(row_loss_kernel);
+}
+
+template<typename DType, typename AType, int req>
+inline void RowGrad(mshadow::Stream<gpu>* s, DType* grad, const DType* data, const DType* label,
+                    const DType* scale, const int nrow, const int n) {
+  const int ngrid = std::min(nrow, mshadow::cuda::kMaxGridNum);
+  row_grad_kernel<DType, AType, req>
+    <<<ngrid, kRowThreads, 0, mshadow::Stream<gpu>::GetStream(s)>>>(
+      grad, data, label, scale, nrow, n);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(row_grad_kernel);
+}
+#endif  // __CUDACC__
+
+/*! \brief the rows run in parallel on the cpu, each in a single pass */
+template<typename DType, typename AType>
+inline void RowLoss(mshadow::Stream<cpu>* s, DType* loss, const DType* data, const DType* label,
+                    const int nrow, const int n) {
+  mxnet_op::Kernel<row_loss<AType>, cpu>::Launch(s, nrow, loss, data, label, n);
+}
+
+template<typename DType, typename AType, int req>
+inline void RowGrad(mshadow::Stream<cpu>* s, DType* grad, const DType* data, const DType* label,
+                    const DType* scale, const int nrow, const int n) {
+  mxnet_op::Kernel<row_grad<AType, req>, cpu>::Launch(s, nrow, grad, data, label, scale, n);
+}
+
+}  // namespace softmax_ce
+
+/*!
+ * The loss of a row is its log-sum-exp, computed in one pass with a running
+ * maximum, less its label entry, so that only the per row losses are kept.
+ */
 template<typename xpu>
 void SoftmaxCrossEntropyForward(const nnvm::NodeAttrs& attrs,
                                 const OpContext& ctx,
@@ -58,48 +212,38 @@ void SoftmaxCrossEntropyForward(const nnvm::NodeAttrs& attrs,
     << "Binary function only support input/output with the same type";
   CHECK_EQ(outputs[0].type_flag_, inputs[1].type_flag_)
     << "Binary function only support input/output with the same type";
-  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
+  MSHADOW_REAL_TYPE_SWITCH_EX(outputs[0].type_flag_, DType, AType, {
     mshadow::Tensor<xpu, 1, DType> out = outputs[0].get<xpu, 1, DType>(s);
     mshadow::Tensor<xpu, 1, DType> mlabel = inputs[1].get<xpu, 1, DType>(s);
     mshadow::Tensor<xpu, 2, DType> mdata = inputs[0].get<xpu, 2, DType>(s);
-    mshadow::Tensor<xpu, 1, DType> workspace = ctx.requested[0].get_space_typed<xpu, 1, DType>(
-        mshadow::Shape1(mdata.shape_.Size() + mlabel.size(0)), s);
-    mshadow::Tensor<xpu, 2, DType> temp1(workspace.dptr_, mdata.shape_, s);
-    mshadow::Tensor<xpu, 2, DType> temp2(workspace.dptr_ + mdata.shape_.Size(),
+    mshadow::Tensor<xpu, 2, DType> loss = ctx.requested[0].get_space_typed<xpu, 2, DType>(
         mshadow::Shape2(1, mlabel.size(0)), s);
-    // calculate softmax on temp
-    // TODO(tqchen): change to SoftmaxLog later
-    mshadow::Softmax(temp1, mdata);
-    // choose the softmax rows
-    mshadow::Tensor<xpu, 1, DType> tdst = temp2[0];
-    tdst = F<mshadow_op::negation>(
-        F<mshadow_op::log>(
-            F<mshadow_op::maximum>(mat_choose_row_element(temp1, mlabel),
-                                   scalar<DType>(1e-8f))));
-    ASSIGN_DISPATCH(out, req[0], sumall_except_dim<0>(temp2));
+    softmax_ce::RowLoss<DType, AType>(s, loss.dptr_, mdata.dptr_, mlabel.dptr_,
+                                      mdata.size(0), mdata.size(1));
+    ASSIGN_DISPATCH(out, req[0], sumall_except_dim<0>(loss));
   });
 }
 
+/*! \brief the gradient of a row is written in a second pass, after its log-sum-exp */
 template<typename xpu>
 void SoftmaxCrossEntropyBackward(const nnvm::NodeAttrs& attrs,
                                  const OpContext& ctx,
                                  const std::vector<TBlob>& inputs,
                                  const std::vector<OpReqType>& req,
                                  const std::vector<TBlob>& outputs) {
-  using namespace mshadow::expr;
   mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
   CHECK_EQ(req[1], kNullOp)
       << "SoftmaxCrossEntropy: Cannot take gradient wrt label";
-  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
+  if (req[0] == kNullOp) return;
+  MSHADOW_REAL_TYPE_SWITCH_EX(outputs[0].type_flag_, DType, AType, {
     mshadow::Tensor<xpu, 1, DType> mlabel = inputs[2].get<xpu, 1, DType>(s);
     mshadow::Tensor<xpu, 2, DType> mdata = inputs[1].get<xpu, 2, DType>(s);
     mshadow::Tensor<xpu, 2, DType> mdata_grad = outputs[0].get<xpu, 2, DType>(s);
     mshadow::Tensor<xpu, 1, DType> mscale = inputs[0].get<xpu, 1, DType>(s);
-    mshadow::Tensor<xpu, 2, DType> temp = ctx.requested[0].get_space_typed<xpu, 2, DType>(
-        mdata.shape_, s);
-    mshadow::Softmax(temp, mdata);
-    mshadow::SoftmaxGrad(temp, temp, mlabel);
-    ASSIGN_DISPATCH(mdata_grad, req[0], broadcast_scalar(mscale, temp.shape_) * temp);
+    MXNET_ASSIGN_REQ_SWITCH(req[0], Req, {
+      softmax_ce::RowGrad<DType, AType, Req>(s, mdata_grad.dptr_, mdata.dptr_, mlabel.dptr_,
+                                             mscale.dptr_, mdata.size(0), mdata.size(1));
+    });
   });
 }
 
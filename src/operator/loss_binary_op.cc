@@ -55,6 +55,10 @@ Example::
 
   softmax_cross_entropy(data, label) = - log(0.66524084) - log(0.97962922) = 0.4281871
 
+The softmax is not stored: the loss of a row is computed from its
+log-sum-exp in a single pass over the row, and the gradient in a second
+one, so the temporary space is one value per row.
+
 )code" ADD_FILELINE)
 .set_num_inputs(2)
 .set_num_outputs(1)
@@ -72,10 +76,6 @@ Example::
 NNVM_REGISTER_OP(_backward_softmax_cross_entropy)
 .set_num_inputs(3)
 .set_num_outputs(2)
-.set_attr<FResourceRequest>("FResourceRequest",
-  [](const NodeAttrs& attrs) {
-    return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
-  })
 .set_attr<nnvm::TIsBackward>("TIsBackward", true)
 .set_attr<FCompute>("FCompute<cpu>", SoftmaxCrossEntropyBackward<cpu>);
 
@@ -33,6 +33,7 @@
 #include <utility>
 #include "./operator_common.h"
 #include "./mshadow_op.h"
+#include "./mxnet_op.h"
 
 namespace mxnet {
 namespace op {
@@ -59,6 +60,63 @@ struct LRNParam : public dmlc::Parameter<LRNParam> {
   }
 };  // struct LRNParam
 
+/*!
+ * \brief the norms of the channels at the position i of (n, c, size) data, from a
+ *  window of squares sliding over the channels, and the normalized values
+ */
+template<int req>
+struct LRNFused {
+  static const int kCPUGrain = 64;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, DType* tmp_norm, const DType* data,
+                                  const int channels, const int size, const int nsize,
+                                  const DType salpha, const DType knorm, const DType beta) {
+    const int base = (i / size) * channels * size + i % size, half = nsize / 2;
+    DType sum = 0;
+    for (int c = 0; c < channels + half; ++c) {
+      if (c < channels) sum += data[base + c * size] * data[base + c * size];
+      if (c >= nsize) sum -= data[base + (c - nsize) * size] * data[base + (c - nsize) * size];
+      if (c >= half) {
+        const int j = base + (c - half) * size;
+        tmp_norm[j] = knorm + salpha * sum;
+        KERNEL_ASSIGN(out[j], req, data[j] * pow(tmp_norm[j], -beta));
+      }
+    }
+  }
+};
+
+/*!
+ * \brief the gradient at the position i, with the window sliding over the
+ *  products of the output gradient and data scaled by the norm to -beta - 1
+ */
+template<int req>
+struct LRNFusedGrad {
+  static const int kCPUGrain = 64;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* grad_in, const DType* grad,
+                                  const DType* tmp_norm, const DType* data,
+                                  const int channels, const int size, const int nsize,
+                                  const DType salpha, const DType beta) {
+    const int base = (i / size) * channels * size + i % size, half = nsize / 2;
+    DType sum = 0;
+    for (int c = 0; c < channels + half; ++c) {
+      if (c < channels) {
+        const int j = base + c * size;
+        sum += grad[j] * data[j] * pow(tmp_norm[j], -beta - 1);
+      }
+      if (c >= nsize) {
+        const int j = base + (c - nsize) * size;
+        sum -= grad[j] * data[j] * pow(tmp_norm[j], -beta - 1);
+      }
+      if (c >= half) {
+        const int j = base + (c - half) * size;
+        KERNEL_ASSIGN(grad_in[j], req, grad[j] * pow(tmp_norm[j], -beta) -
+                                       2 * beta * salpha * data[j] * sum);
+      }
+    }
+  }
+};
+
 template<typename xpu>
 class LocalResponseNormOp : public Operator {
  public:
@@ -82,8 +140,13 @@ class LocalResponseNormOp : public Operator {
     Tensor<xpu, 4> data = in_data[lrn_enum::kData].get<xpu, 4, real_t>(s);
     Tensor<xpu, 4> out = out_data[lrn_enum::kOut].get<xpu, 4, real_t>(s);
     Tensor<xpu, 4> tmp_norm = out_data[lrn_enum::kTmpNorm].get<xpu, 4, real_t>(s);
-    tmp_norm = chpool<red::sum>(F<mshadow_op::square>(data) , param_.nsize) * salpha + param_.knorm;
-    Assign(out, req[lrn_enum::kOut], data *  F<mshadow_op::power>(tmp_norm, -param_.beta));
+    // one thread per position, the loads of neighbouring threads are contiguous
+    MXNET_ASSIGN_REQ_SWITCH(req[lrn_enum::kOut], req_type, {
+      mxnet_op::Kernel<LRNFused<req_type>, xpu>::Launch(
+          s, data.size(0) * data.size(2) * data.size(3), out.dptr_, tmp_norm.dptr_,
+          data.dptr_, data.size(1), data.size(2) * data.size(3), param_.nsize, salpha,
+          static_cast<real_t>(param_.knorm), static_cast<real_t>(param_.beta));
+    });
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -104,11 +167,12 @@ class LocalResponseNormOp : public Operator {
     Tensor<xpu, 4> tmp_norm = out_data[lrn_enum::kTmpNorm].get<xpu, 4, real_t>(s);
     Tensor<xpu, 4> data = in_data[lrn_enum::kData].get<xpu, 4, real_t>(s);
     Tensor<xpu, 4> grad_in = in_grad[lrn_enum::kData].get<xpu, 4, real_t>(s);
-    grad_in = grad * F<mshadow_op::power>(tmp_norm, -param_.beta);
-    grad_in += (- 2.0f * param_.beta * salpha) *
-               chpool<red::sum>(grad * data *
-                                F<mshadow_op::power>(tmp_norm, -param_.beta - 1.0f),
-                                param_.nsize)  * data;
+    MXNET_ASSIGN_REQ_SWITCH(req[lrn_enum::kData], req_type, {
+      mxnet_op::Kernel<LRNFusedGrad<req_type>, xpu>::Launch(
+          s, data.size(0) * data.size(2) * data.size(3), grad_in.dptr_, grad.dptr_,
+          tmp_norm.dptr_, data.dptr_, data.size(1), data.size(2) * data.size(3),
+          param_.nsize, salpha, static_cast<real_t>(param_.beta));
+    });
   }
 
  private:
@@ -37,80 +37,96 @@
 
 namespace mxnet {
 namespace op {
-template<typename xpu, typename DType>
-static void LayerSetUp(const std::vector<mshadow::Tensor<xpu, 1, DType> > &data,
-  size_t data_shape_size,
-  std::shared_ptr<MKLData<DType> > fwd_top_data) {
-  // Whether to use an asymptotically slower (for >2 inputs) but stabler method
-  // of computing the gradient for the PROD operation. (No effect for SUM op.)
-  // stable_prod_grad_ = 1;
-  size_t dim_src = data_shape_size;
-  size_t *sizes_src = new size_t[dim_src];
-  size_t *strides_src = new size_t[dim_src];
-  for (size_t d = 0; d < dim_src; ++d) {
-    sizes_src[d] = data[0].shape_[dim_src - d - 1];
-    strides_src[d] = (d == 0) ? 1 : strides_src[d - 1] * sizes_src[d - 1];
-  }
-
-  fwd_top_data->create_user_layout(dim_src, sizes_src, strides_src);
-  delete[] sizes_src;
-  delete[] strides_src;
-}
-
-template<typename xpu, typename DType>
-void MKLElementWiseSumCompute_(const nnvm::NodeAttrs& attrs,
-  const OpContext& ctx,
-  const std::vector<TBlob>& in_data,
-  const std::vector<OpReqType>& req,
-  const std::vector<TBlob>& out_data) {
-  using namespace mshadow;
-  using namespace mshadow::expr;
-  if (req[0] == kNullOp) return;
-  size_t size = in_data.size();
-  Stream<xpu> *s = ctx.get_stream<xpu>();
-  std::vector<Tensor<xpu, 1, DType> > data(size);
-  Tensor<xpu, 1, DType> out = out_data[0].FlatTo1D<xpu, DType>(s);
-  bool in_place_flag = false;
-  int in_place_idx = 0;
+#if MKL_EXPERIMENTAL == 1
+/*! \brief name of the private buffers the sums allocate for their outputs */
+static const char kMKLSumOutput[] = "mkl_sum_output";
 
-  for (size_t i = 0; i < size; ++i) {
-    data[i]  = in_data[i].FlatTo1D<xpu, DType>(s);
-    if (data[i].dptr_ == out.dptr_) {
-      in_place_idx = i;
-      in_place_flag = true;
+/*!
+ * \brief sum the inputs in their private layout when they all have the same
+ *  one, so that adding the outputs of mkl operators, as the residual blocks
+ *  do, neither converts them to the plain layout nor the sum back. The sum is
+ *  written in place when the output shares the private buffer of an input,
+ *  otherwise into a private buffer of the output, kept for the next calls.
+ * \return false when the sum is left to the caller, the inputs are then
+ *  unchanged
+ */
+template<typename DType>
+bool MKLPrvElementWiseSum(const std::vector<TBlob> &in_data, OpReqType req,
+                          const TBlob &out_data) {
+  if (req != kWriteTo && req != kWriteInplace) return false;
+  std::shared_ptr<MKLMemHolder> top_mem = out_data.Mkl_mem_;
+  if (top_mem == nullptr || in_data.size() < 2) return false;
+  std::shared_ptr<MKLData<DType> > first;
+  DType *inplace_dst = NULL;
+  for (const TBlob &in : in_data) {
+    if (in.shape_ != out_data.shape_ || mkl_prv_data<DType>(in) == NULL) return false;
+    std::shared_ptr<MKLData<DType> > descr = mkl_get_mem_desc<DType>(in.Mkl_mem_);
+    if (first == nullptr) {
+      first = descr;
+    } else if (!first->layout_compare(descr)) {
+      return false;
     }
+    if (in.Mkl_mem_ == top_mem) inplace_dst = mkl_prv_data<DType>(in);
   }
-  std::shared_ptr<MKLData<DType> > fwd_top_data = MKLData<DType>::create();
-  std::vector<DType> coeffs_  = std::vector<DType>(data.size(), 1);
-  LayerSetUp(data, 1, fwd_top_data);
-
-
-  dnnError_t e;
-  void *eltwise_res[dnnResourceNumber];
-  dnnPrimitive_t sumPrimitive = NULL;
-  e = dnnSumCreate<DType>(&sumPrimitive, NULL, size, fwd_top_data->layout_usr,
-    &coeffs_[0]);
+  std::vector<DType> coeffs(in_data.size(), 1);
+  dnnPrimitive_t sum = NULL;
+  dnnError_t e = dnnSumCreate<DType>(&sum, NULL, in_data.size(), first->layout_int,
+                                     &coeffs[0]);
   CHECK_EQ(e, E_SUCCESS);
-
-  eltwise_res[dnnResourceDst] = reinterpret_cast<void*>(const_cast<DType*>(out.dptr_));
-  eltwise_res[dnnResourceMultipleSrc] =
-    reinterpret_cast<void *>(reinterpret_cast<void *>(in_data[in_place_idx].dptr_));
-  for (size_t i = 1; i < size; ++i) {
-    if (i == in_place_idx) continue;
-    eltwise_res[dnnResourceMultipleSrc + i] =
-      reinterpret_cast<void *>(reinterpret_cast<void *>(in_data[i].dptr_));
+  std::shared_ptr<MKLData<DType> > top_data;
+  if (inplace_dst == NULL) {
+    // reuse the buffer of the previous call, which no other array refers to
+    std::shared_ptr<PrvMemDescr> prev = top_mem->get_prv_descriptor();
+    if (prev != nullptr && prev->get_descr_type() == PrvMemDescr::PRV_DESCR_MKL2017) {
+      top_data = std::static_pointer_cast<MKLData<DType> >(prev);
+      if (top_data->name != kMKLSumOutput || !top_data->layout_compare(first)) {
+        top_data = nullptr;
+      }
+    }
+    if (top_data == nullptr) {
+      const size_t dim = out_data.ndim();
+      std::vector<size_t> sizes(dim), strides(dim);
+      for (size_t d = 0; d < dim; ++d) {
+        sizes[d] = out_data.shape_[dim - d - 1];
+        strides[d] = (d == 0) ? 1 : strides[d - 1] * sizes[d - 1];
+      }
+      top_data = MKLData<DType>::create();
+      top_data->name = kMKLSumOutput;
+      top_data->create_layouts(sum, dnnResourceDst, dim, &sizes[0], &strides[0]);
+    }
+    if (!top_data->conversion_needed()) {
+      // a plain layout is not tracked as private, the caller sums the plain arrays
+      dnnDelete<DType>(sum);
+      return false;
+    }
   }
-
-  e = dnnExecute<DType>(sumPrimitive, eltwise_res);
+  void *sum_res[dnnResourceNumber];
+  for (size_t i = 0; i < in_data.size(); ++i) {
+    sum_res[dnnResourceMultipleSrc + i] =
+        reinterpret_cast<void *>(mkl_prv_data<DType>(in_data[i]));
+  }
+  sum_res[dnnResourceDst] = inplace_dst != NULL ? reinterpret_cast<void *>(inplace_dst)
+                                                : top_data->prv_ptr();
+  e = dnnExecute<DType>(sum, sum_res);
   CHECK_EQ(e, E_SUCCESS);
+  dnnDelete<DType>(sum);
+  if (inplace_dst == NULL) top_mem->set_prv_descriptor(top_data);
+  return true;
+}
 
-  if (sumPrimitive != NULL) {
-    dnnDelete<DType>(sumPrimitive);
-    sumPrimitive = NULL;
+/*! \brief MKLPrvElementWiseSum of the types mkl supports */
+inline bool MKLPrvElementWiseSum(const std::vector<TBlob> &in_data, OpReqType req,
+                                 const TBlob &out_data) {
+  switch (out_data.type_flag_) {
+    case mshadow::kFloat32:
+      return MKLPrvElementWiseSum<float>(in_data, req, out_data);
+    case mshadow::kFloat64:
+      return MKLPrvElementWiseSum<double>(in_data, req, out_data);
+    default:
+      return false;
   }
 }
-
-
+#endif  // MKL_EXPERIMENTAL
 
 }  // namespace op
 }  // namespace mxnet
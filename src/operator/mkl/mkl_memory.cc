@@ -202,10 +202,15 @@ Dtype* MKLMemoryDescriptor<Dtype>::get_converted_prv(
         op::mkl_get_mem_desc<Dtype>(dnn_chunk);
       if (!dnnLayoutCompare<Dtype>(current_descr->layout_int,
         this->layout_int)) {
+        // the cached conversion is only valid for the layout it was made for
+        if (this->convert_prv2prv &&
+            !dnnLayoutCompare<Dtype>(this->descr_prv2prv_conversion->layout_int,
+                                     current_descr->layout_int)) {
+          dnnDelete<Dtype>(this->convert_prv2prv);
+          this->convert_prv2prv = NULL;
+          this->descr_prv2prv_conversion = nullptr;
+        }
         if (this->convert_prv2prv) {
-          CHECK_EQ(dnnLayoutCompare<Dtype>(
-            this->descr_prv2prv_conversion->layout_int,
-            this->layout_int), 0);
           status = 0;
         } else {
           status = dnnConversionCreate<Dtype>(&this->convert_prv2prv,
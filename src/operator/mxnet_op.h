@@ -25,6 +25,8 @@
 #ifndef MXNET_OPERATOR_MXNET_OP_H_
 #define MXNET_OPERATOR_MXNET_OP_H_
 
+#include <dmlc/omp.h>
+#include <dmlc/parameter.h>
 #include <mxnet/base.h>
 #include <algorithm>
 
@@ -194,13 +196,50 @@ template<typename OP, typename xpu>
 struct Kernel;
 
 
+/*!
+ * \brief the number of elements each OpenMP thread of a cpu kernel gets at
+ *  least, OP can set its own with a static kCPUGrain member when its Map is
+ *  much cheaper or dearer than an elementwise operation.
+ */
+template<typename OP, typename = void>
+struct KernelGrain {
+  static int Get() {
+    static const int grain = std::max(dmlc::GetEnv("MXNET_CPU_KERNEL_GRAIN", 4096), 1);
+    return grain;
+  }
+};
+
+template<typename OP>
+struct KernelGrain<OP, decltype(void(OP::kCPUGrain))> {
+  static int Get() { return std::max(static_cast<int>(OP::kCPUGrain), 1); }
+};
+
+/*!
+ * \brief the number of OpenMP threads a cpu kernel of N grains uses, at
+ *  most the team size of the calling thread, which the engine sets to the
+ *  OpenMP budget of its worker, and 1 within a parallel region.
+ */
+inline int KernelNumThreads(int N, int grain) {
+#ifdef _OPENMP
+  if (N < 2 * grain || omp_in_parallel()) return 1;
+  return std::min(omp_get_max_threads(), N / grain);
+#else
+  return 1;
+#endif
+}
+
 template<typename OP>
 struct Kernel<OP, cpu> {
   template<typename ...Args>
   inline static void Launch(mshadow::Stream<cpu> *s, int N, Args... args) {
-#if (MXNET_USE_CUDA == 0)
-    #pragma omp parallel for
-#endif
+    const int nthread = KernelNumThreads(N, KernelGrain<OP>::Get());
+    if (nthread <= 1) {
+      for (int i = 0; i < N; ++i) {
+        OP::Map(i, args...);
+      }
+      return;
+    }
+    #pragma omp parallel for num_threads(nthread) schedule(static)
     for (int i = 0; i < N; ++i) {
       OP::Map(i, args...);
     }
@@ -0,0 +1,233 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file bilinear_sampling.h
+ * \brief cpu bilinear sampling of NCHW data at the (x, y) positions of a grid in
+ *  [-1, 1], shared by BilinearSampler and SpatialTransformer
+ */
+#ifndef MXNET_OPERATOR_NN_BILINEAR_SAMPLING_H_
+#define MXNET_OPERATOR_NN_BILINEAR_SAMPLING_H_
+
+#include <dmlc/omp.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "../mxnet_op.h"
+
+namespace mxnet {
+namespace op {
+namespace bilinear {
+
+/*!
+ * \brief the four neighbours (top left, top right, bottom left, bottom right)
+ *  that a row of output pixels samples. The neighbours out of the image have a
+ *  zero mask and weight and an index clamped to 0, so that the loops over the
+ *  channels need no branch.
+ */
+template<typename DType>
+struct SampleRow {
+  std::vector<int> index[4];
+  std::vector<DType> mask[4];
+  std::vector<DType> weight[4];
+  /*! \brief the weights of the top left neighbour along y and x */
+  std::vector<DType> wy, wx;
+
+  explicit SampleRow(int width) : wy(width), wx(width) {
+    for (int k = 0; k < 4; ++k) {
+      index[k].resize(width);
+      mask[k].resize(width);
+      weight[k].resize(width);
+    }
+  }
+
+  /*! \brief find the neighbours of the positions x_src, y_src of a row */
+  void Setup(const DType *x_src, const DType *y_src, int width, int i_h, int i_w) {
+    for (int w = 0; w < width; ++w) {
+      const DType y_real = (y_src[w] + 1) * (i_h - 1) / 2;
+      const DType x_real = (x_src[w] + 1) * (i_w - 1) / 2;
+      const int top_left_y = static_cast<int>(floor(y_real));
+      const int top_left_x = static_cast<int>(floor(x_real));
+      const DType top_left_y_w = 1.0 - (y_real - top_left_y);
+      const DType top_left_x_w = 1.0 - (x_real - top_left_x);
+      wy[w] = top_left_y_w;
+      wx[w] = top_left_x_w;
+      for (int k = 0; k < 4; ++k) {
+        const int y = top_left_y + k / 2;
+        const int x = top_left_x + k % 2;
+        const bool valid = y >= 0 && y < i_h && x >= 0 && x < i_w;
+        const DType weight_y = k / 2 ? 1.0 - top_left_y_w : top_left_y_w;
+        const DType weight_x = k % 2 ? 1.0 - top_left_x_w : top_left_x_w;
+        index[k][w] = valid ? y * i_w + x : 0;
+        mask[k][w] = valid ? 1 : 0;
+        weight[k][w] = valid ? weight_y * weight_x : 0;
+      }
+    }
+  }
+};
+
+/*!
+ * \brief sample the data of num images of channels x i_h x i_w into out of
+ *  num x channels x o_h x o_w, in parallel over the rows of the output.
+ * \param grid_row called as grid_row(n, h, &x_src, &y_src) to get the positions of
+ *  the output row h of the image n.
+ */
+template<typename DType, typename GridRow>
+inline void SampleForward(DType *out, const DType *data, int num, int channels,
+                          int i_h, int i_w, int o_h, int o_w, GridRow grid_row) {
+  const int rows = num * o_h;
+  const int nthread = mxnet_op::KernelNumThreads(rows, 4);
+  #pragma omp parallel num_threads(nthread) if (nthread > 1)
+  {
+    SampleRow<DType> row(o_w);
+    #pragma omp for schedule(static)
+    for (int r = 0; r < rows; ++r) {
+      const int n = r / o_h, h = r % o_h;
+      const DType *x_src, *y_src;
+      grid_row(n, h, &x_src, &y_src);
+      row.Setup(x_src, y_src, o_w, i_h, i_w);
+      const int *i0 = row.index[0].data(), *i1 = row.index[1].data();
+      const int *i2 = row.index[2].data(), *i3 = row.index[3].data();
+      const DType *w0 = row.weight[0].data(), *w1 = row.weight[1].data();
+      const DType *w2 = row.weight[2].data(), *w3 = row.weight[3].data();
+      for (int c = 0; c < channels; ++c) {
+        const DType *plane = data + static_cast<size_t>(n * channels + c) * i_h * i_w;
+        DType *dst = out + (static_cast<size_t>(n * channels + c) * o_h + h) * o_w;
+        for (int w = 0; w < o_w; ++w) {
+          dst[w] = w0[w] * plane[i0[w]] + w1[w] * plane[i1[w]] +
+                   w2[w] * plane[i2[w]] + w3[w] * plane[i3[w]];
+        }
+      }
+    }
+  }
+}
+
+/*!
+ * \brief the gradients of the output row h of the image n: adds the data gradient
+ *  to gdata, an image of channels x i_h x i_w, and returns the grid gradient
+ *  along y and x in gy, gx.
+ */
+template<typename DType>
+inline void SampleBackwardRow(DType *gdata, DType *gy, DType *gx, const DType *grad,
+                              const DType *data, SampleRow<DType> *row, int n, int h,
+                              int channels, int i_h, int i_w, int o_h, int o_w) {
+  std::fill(gy, gy + o_w, DType(0));
+  std::fill(gx, gx + o_w, DType(0));
+  const int *i0 = row->index[0].data(), *i1 = row->index[1].data();
+  const int *i2 = row->index[2].data(), *i3 = row->index[3].data();
+  const DType *m0 = row->mask[0].data(), *m1 = row->mask[1].data();
+  const DType *m2 = row->mask[2].data(), *m3 = row->mask[3].data();
+  const DType *w0 = row->weight[0].data(), *w1 = row->weight[1].data();
+  const DType *w2 = row->weight[2].data(), *w3 = row->weight[3].data();
+  const DType *wy = row->wy.data(), *wx = row->wx.data();
+  for (int c = 0; c < channels; ++c) {
+    const DType *plane = data + static_cast<size_t>(n * channels + c) * i_h * i_w;
+    const DType *g = grad + (static_cast<size_t>(n * channels + c) * o_h + h) * o_w;
+    DType *gplane = gdata + static_cast<size_t>(c) * i_h * i_w;
+    for (int w = 0; w < o_w; ++w) {
+      gplane[i0[w]] += g[w] * w0[w];
+      gplane[i1[w]] += g[w] * w1[w];
+      gplane[i2[w]] += g[w] * w2[w];
+      gplane[i3[w]] += g[w] * w3[w];
+    }
+    for (int w = 0; w < o_w; ++w) {
+      const DType top_left_v = m0[w] * plane[i0[w]];
+      const DType top_right_v = m1[w] * plane[i1[w]];
+      const DType bottom_left_v = m2[w] * plane[i2[w]];
+      const DType bottom_right_v = m3[w] * plane[i3[w]];
+      const DType cross = top_left_v - top_right_v - bottom_left_v + bottom_right_v;
+      // the grad of the weights of the top left neighbour, then -1 times it is the
+      // grad of the grid
+      gy[w] -= g[w] * (top_right_v - bottom_right_v + cross * wx[w]);
+      gx[w] -= g[w] * (bottom_left_v - bottom_right_v + cross * wy[w]);
+    }
+  }
+}
+
+/*!
+ * \brief the gradients of SampleForward with the grid of num x 2 x o_h x o_w.
+ *  The data gradient is added to gdata and the grid gradient is added to ggrid,
+ *  or written to it if add_grid is false. The images are split over the threads
+ *  when there are enough of them, otherwise the rows of an image are, and each
+ *  thread adds the data gradient up in its own copy of the image before they are
+ *  summed into gdata.
+ */
+template<typename DType>
+inline void SampleBackward(DType *gdata, DType *ggrid, bool add_grid, const DType *grad,
+                           const DType *data, const DType *grid, int num, int channels,
+                           int i_h, int i_w, int o_h, int o_w) {
+  const size_t image = static_cast<size_t>(channels) * i_h * i_w;
+  const int grid_plane = o_h * o_w;
+  const DType scale_y = DType(i_h - 1) / 2, scale_x = DType(i_w - 1) / 2;
+  auto backward_row = [&](DType *gimage, SampleRow<DType> *row, DType *gy, DType *gx,
+                          int n, int h) {
+    const DType *x_src = grid + static_cast<size_t>(n) * 2 * grid_plane + h * o_w;
+    row->Setup(x_src, x_src + grid_plane, o_w, i_h, i_w);
+    SampleBackwardRow(gimage, gy, gx, grad, data, row, n, h, channels, i_h, i_w, o_h, o_w);
+    DType *gx_dst = ggrid + static_cast<size_t>(n) * 2 * grid_plane + h * o_w;
+    DType *gy_dst = gx_dst + grid_plane;
+    for (int w = 0; w < o_w; ++w) {
+      gy_dst[w] = (add_grid ? gy_dst[w] : DType(0)) + gy[w] * scale_y;
+      gx_dst[w] = (add_grid ? gx_dst[w] : DType(0)) + gx[w] * scale_x;
+    }
+  };
+  const int nthread = mxnet_op::KernelNumThreads(num * o_h, 4);
+  if (nthread <= 1 || num >= nthread) {
+    #pragma omp parallel num_threads(nthread) if (nthread > 1)
+    {
+      SampleRow<DType> row(o_w);
+      std::vector<DType> gy(o_w), gx(o_w);
+      #pragma omp for schedule(static)
+      for (int n = 0; n < num; ++n) {
+        for (int h = 0; h < o_h; ++h) {
+          backward_row(gdata + n * image, &row, gy.data(), gx.data(), n, h);
+        }
+      }
+    }
+    return;
+  }
+  // a thread that is not started leaves its copy to zero
+  std::vector<std::vector<DType> > buffer(nthread, std::vector<DType>(image));
+  #pragma omp parallel num_threads(nthread)
+  {
+    const int tid = omp_get_thread_num();
+    SampleRow<DType> row(o_w);
+    std::vector<DType> gy(o_w), gx(o_w);
+    for (int n = 0; n < num; ++n) {
+      std::fill(buffer[tid].begin(), buffer[tid].end(), DType(0));
+      #pragma omp for schedule(static)
+      for (int h = 0; h < o_h; ++h) {
+        backward_row(buffer[tid].data(), &row, gy.data(), gx.data(), n, h);
+      }
+      DType *gimage = gdata + n * image;
+      #pragma omp for schedule(static)
+      for (int i = 0; i < static_cast<int>(image); ++i) {
+        DType sum = 0;
+        for (int t = 0; t < nthread; ++t) sum += buffer[t][i];
+        gimage[i] += sum;
+      }
+    }
+  }
+}
+
+}  // namespace bilinear
+}  // namespace op
+}  // namespace mxnet
+
+#endif  // MXNET_OPERATOR_NN_BILINEAR_SAMPLING_H_
@@ -532,6 +532,40 @@ inline void col2im(mshadow::Stream<gpu>* s,
   }
 }
 
+/*!
+ * \brief im2col of the nimg images at data_im, the column buffer of image i
+ *  at data_col + i * col_shape.Size(), one image after the other on the gpu
+ */
+template <typename DType>
+inline void im2col_batch(mshadow::Stream<gpu>* s,
+                         const DType* data_im, index_t nimg, const TShape& im_shape,
+                         const TShape& col_shape, const TShape& kernel_shape,
+                         const TShape& pad, const TShape& stride,
+                         const TShape& dilation, DType* data_col) {
+  const index_t im_size = im_shape.ProdShape(1, im_shape.ndim());
+  for (index_t i = 0; i < nimg; ++i) {
+    im2col(s, data_im + i * im_size, im_shape, col_shape, kernel_shape, pad, stride,
+           dilation, data_col + i * col_shape.Size());
+  }
+}
+
+/*!
+ * \brief col2im of the column buffers of nimg images at data_col, the one of
+ *  image i at data_col + i * col_shape.Size()
+ */
+template <typename DType>
+inline void col2im_batch(mshadow::Stream<gpu>* s,
+                         const DType* data_col, index_t nimg, const TShape& im_shape,
+                         const TShape& col_shape, const TShape& kernel_shape,
+                         const TShape& pad, const TShape& stride,
+                         const TShape& dilation, DType* data_im, OpReqType req) {
+  const index_t im_size = im_shape.ProdShape(1, im_shape.ndim());
+  for (index_t i = 0; i < nimg; ++i) {
+    col2im(s, data_col + i * col_shape.Size(), im_shape, col_shape, kernel_shape, pad, stride,
+           dilation, data_im + i * im_size, req);
+  }
+}
+
 }  // namespace op
 }  // namespace mxnet
 
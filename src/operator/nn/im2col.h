@@ -81,6 +81,8 @@
 
 #include <mxnet/base.h>
 #include <mxnet/operator.h>
+#include <algorithm>
+#include <climits>
 #include <cstring>
 #include <vector>
 #include "../mxnet_op.h"
@@ -98,6 +100,16 @@ inline bool is_a_ge_zero_and_a_lt_b(int a, int b) {
   return static_cast<unsigned>(a) < static_cast<unsigned>(b);
 }
 
+/*!
+ * \brief the OpenMP threads of the im2col and col2im of channels channels of
+ *  col_size column values each, 1 within a parallel region
+ */
+inline int im2col_num_threads(int channels, int col_size) {
+  const int64_t work = static_cast<int64_t>(channels) * col_size;
+  return channels < 2 ? 1 : std::min(channels, mxnet_op::KernelNumThreads(
+      static_cast<int>(std::min<int64_t>(work, INT_MAX)), mxnet_op::KernelGrain<void>::Get()));
+}
+
 /*!
  * \brief im2col 2D cpu version.
  * DO NOT call this function directly.
@@ -115,31 +127,29 @@ inline void im2col_cpu(const DType* data_im, const int channels,
   const int output_w = (width + 2 * pad_w -
     (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
   const int channel_size = height * width;
-  // TODO(junwu): we tested adding openmp (w/ & w/o collapse clause) here
-  // for testing the performance of convolution operator,
-  // but the total runtime increased by 0.8s for images of shape
-  // (8, 32, 64, 64) and decreased by 0.2s for images of shape
-  // (16, 64, 64, 64). Both kernel shapes are (8, 8). We think the
-  // bottleneck of the convolution operator probably lies in dot().
-  // Hence, adding more threads to the loops contributes little
-  // toward improving the convolution operator's performance.
-  // We will revisit this issue in the future.
-  for (int channel = channels; channel--; data_im += channel_size) {
+  const int col_size = kernel_h * kernel_w * output_h * output_w;
+  // the channels fill their own rows of the column buffer, they are split
+  // between the threads unless the images of a batch already are
+  const int nthread = im2col_num_threads(channels, col_size);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int channel = 0; channel < channels; ++channel) {
+    const DType* data_im_c = data_im + static_cast<size_t>(channel) * channel_size;
+    DType* data_col_c = data_col + static_cast<size_t>(channel) * col_size;
     for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
       for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
         int input_row = -pad_h + kernel_row * dilation_h;
         for (int output_rows = output_h; output_rows; output_rows--) {
           if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
             for (int output_cols = output_w; output_cols; output_cols--) {
-              *(data_col++) = 0;
+              *(data_col_c++) = 0;
             }
           } else {
             int input_col = -pad_w + kernel_col * dilation_w;
             for (int output_col = output_w; output_col; output_col--) {
               if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                *(data_col++) = data_im[input_row * width + input_col];
+                *(data_col_c++) = data_im_c[input_row * width + input_col];
               } else {
-                *(data_col++) = 0;
+                *(data_col_c++) = 0;
               }
               input_col += stride_w;
             }
@@ -185,58 +195,66 @@ inline void im2col_nd_core_cpu(const DType* data_input, const bool im2col,
     kernel_size *= kernel_shape[i];
   }
   const index_t channels_col = col_shape[0];
-  std::vector<index_t> d_offset(num_spatial_axes, 0);
-  std::vector<index_t> d_iter(num_spatial_axes, 0);
-  for (index_t c_col = 0; c_col < channels_col; ++c_col) {
-    // Loop over spatial axes in reverse order to compute a per-axis offset.
-    index_t offset = c_col;
-    for (int d_i = static_cast<int>(num_spatial_axes) - 1; d_i >= 0; --d_i) {
-      if (d_i < static_cast<int>(num_spatial_axes) - 1) {
-        offset /= kernel_shape[d_i + 1];
-      }
-      d_offset[d_i] = offset % kernel_shape[d_i];
-    }
-    for (bool incremented = true; incremented; ) {
-      // Loop over spatial axes in forward order to compute the indices in the
-      // image and column, and whether the index lies in the padding.
-      index_t index_col = c_col;
-      int index_im = c_col / kernel_size;
-      bool is_padding = false;
-      for (index_t d_i = 0; d_i < num_spatial_axes; ++d_i) {
-        const index_t d = d_iter[d_i];
-        const int d_im = static_cast<int>(d * stride[d_i] + d_offset[d_i] * dilation[d_i])
-          - static_cast<int>(pad[d_i]);
-        is_padding |= d_im < 0 || d_im >= static_cast<int>(im_shape[d_i + 2]);
-        index_col *= col_shape[d_i + 1];
-        index_col += d;
-        index_im *= static_cast<int>(im_shape[d_i + 2]);
-        index_im += d_im;
-      }
-      if (im2col) {
-        if (is_padding) {
-          data_output[index_col] = 0;
-        } else {
-          data_output[index_col] = data_input[index_im];
-        }
-      } else if (!is_padding) {  // col2im
-        data_output[index_im] += data_input[index_col];
-      }
-      // Loop over spatial axes in reverse order to choose an index,
-      // like counting.
-      incremented = false;
+  // the rows of a channel only touch its own plane, the channels are split between the threads
+  const int channels = static_cast<int>(channels_col / kernel_size);
+  const int nthread = im2col_num_threads(channels,
+                                         static_cast<int>(col_shape.Size() / channels_col *
+                                                          kernel_size));
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int channel = 0; channel < channels; ++channel) {
+    std::vector<index_t> d_offset(num_spatial_axes, 0);
+    std::vector<index_t> d_iter(num_spatial_axes, 0);
+    for (index_t c_col = channel * kernel_size; c_col < (channel + 1) * kernel_size; ++c_col) {
+      // Loop over spatial axes in reverse order to compute a per-axis offset.
+      index_t offset = c_col;
       for (int d_i = static_cast<int>(num_spatial_axes) - 1; d_i >= 0; --d_i) {
-        const index_t d_max = col_shape[d_i + 1];
-        CHECK_LT(d_iter[d_i], d_max);
-        if (d_iter[d_i] + 1 == d_max) {
-          d_iter[d_i] = 0;
-        } else {  // d_iter[d_i] < d_max - 1
-          ++d_iter[d_i];
-          incremented = true;
-          break;
+        if (d_i < static_cast<int>(num_spatial_axes) - 1) {
+          offset /= kernel_shape[d_i + 1];
         }
+        d_offset[d_i] = offset % kernel_shape[d_i];
       }
-    }  // while(incremented)
-  }  // for (int c = 0; c < channels_col; ++c)
+      for (bool incremented = true; incremented; ) {
+        // Loop over spatial axes in forward order to compute the indices in the
+        // image and column, and whether the index lies in the padding.
+        index_t index_col = c_col;
+        int index_im = c_col / kernel_size;
+        bool is_padding = false;
+        for (index_t d_i = 0; d_i < num_spatial_axes; ++d_i) {
+          const index_t d = d_iter[d_i];
+          const int d_im = static_cast<int>(d * stride[d_i] + d_offset[d_i] * dilation[d_i])
+            - static_cast<int>(pad[d_i]);
+          is_padding |= d_im < 0 || d_im >= static_cast<int>(im_shape[d_i + 2]);
+          index_col *= col_shape[d_i + 1];
+          index_col += d;
+          index_im *= static_cast<int>(im_shape[d_i + 2]);
+          index_im += d_im;
+        }
+        if (im2col) {
+          if (is_padding) {
+            data_output[index_col] = 0;
+          } else {
+            data_output[index_col] = data_input[index_im];
+          }
+        } else if (!is_padding) {  // col2im
+          data_output[index_im] += data_input[index_col];
+        }
+        // Loop over spatial axes in reverse order to choose an index,
+        // like counting.
+        incremented = false;
+        for (int d_i = static_cast<int>(num_spatial_axes) - 1; d_i >= 0; --d_i) {
+          const index_t d_max = col_shape[d_i + 1];
+          CHECK_LT(d_iter[d_i], d_max);
+          if (d_iter[d_i] + 1 == d_max) {
+            d_iter[d_i] = 0;
+          } else {  // d_iter[d_i] < d_max - 1
+            ++d_iter[d_i];
+            incremented = true;
+            break;
+          }
+        }
+      }  // while(incremented)
+    }  // for (c_col of the channel)
+  }  // for (int channel = 0; channel < channels; ++channel)
 }
 
 /*!
@@ -286,29 +304,26 @@ inline void col2im_cpu(const DType* data_col, const int channels,
   const int output_w = (width + 2 * pad_w -
     (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
   const int channel_size = height * width;
-  // TODO(junwu): we tested adding openmp (w/ & w/o collapse clause) here
-  // for testing the performance of convolution operator,
-  // but the total runtime increased by 0.8s for images of shape
-  // (8, 32, 64, 64) and decreased by 0.2s for images of shape
-  // (16, 64, 64, 64). Both kernel shapes are (8, 8). We think the
-  // bottleneck of the convolution operator probably lies in dot().
-  // Hence, adding more threads to the loops contributes little
-  // toward improving the convolution operator's performance.
-  // We will revisit this issue in the future.
-  for (int channel = channels; channel--; data_im += channel_size) {
+  const int col_size = kernel_h * kernel_w * output_h * output_w;
+  // a channel sums its own rows of the column buffer into its own plane
+  const int nthread = im2col_num_threads(channels, col_size);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int channel = 0; channel < channels; ++channel) {
+    const DType* data_col_c = data_col + static_cast<size_t>(channel) * col_size;
+    DType* data_im_c = data_im + static_cast<size_t>(channel) * channel_size;
     for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
       for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
         int input_row = -pad_h + kernel_row * dilation_h;
         for (int output_rows = output_h; output_rows; output_rows--) {
           if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
-            data_col += output_w;
+            data_col_c += output_w;
           } else {
             int input_col = -pad_w + kernel_col * dilation_w;
             for (int output_col = output_w; output_col; output_col--) {
               if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                data_im[input_row * width + input_col] += *data_col;
+                data_im_c[input_row * width + input_col] += *data_col_c;
               }
-              data_col++;
+              data_col_c++;
               input_col += stride_w;
             }
           }
@@ -348,6 +363,69 @@ inline void col2im(mshadow::Stream<cpu>* s,
   }
 }
 
+/*!
+ * \brief the number of threads of the images of a batch, 1 if there are
+ *  fewer images than threads, which then split the channels of each image
+ */
+inline int im2col_batch_threads(index_t nimg, index_t col_size) {
+  const int nthread = mxnet_op::KernelNumThreads(
+      static_cast<int>(std::min<int64_t>(static_cast<int64_t>(nimg) * col_size, INT_MAX)),
+      mxnet_op::KernelGrain<void>::Get());
+  return static_cast<int>(nimg) >= nthread ? nthread : 1;
+}
+
+/*!
+ * \brief im2col of the nimg images at data_im, the column buffer of image i
+ *  at data_col + i * col_shape.Size()
+ * \param s device stream
+ * \param data_im pointer of the first image (C, H, W,...) in the image batch
+ * \param nimg number of images
+ * \param im_shape input image shape in dimensions (N, C, H, W,)
+ * \param col_shape column buffer shape of an image
+ * \param kernel_shape kernel filter shape
+ * \param pad pad shape
+ * \param stride stride shape
+ * \param dilation dilation shape
+ * \param data_col start pointer of the column buffers to be filled
+ */
+template <typename DType>
+inline void im2col_batch(mshadow::Stream<cpu>* s,
+                         const DType* data_im, index_t nimg, const TShape& im_shape,
+                         const TShape& col_shape, const TShape& kernel_shape,
+                         const TShape& pad, const TShape& stride,
+                         const TShape& dilation, DType* data_col) {
+  const index_t im_size = im_shape.ProdShape(1, im_shape.ndim());
+  const index_t col_size = col_shape.Size();
+  const int nthread = im2col_batch_threads(nimg, col_size);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int i = 0; i < static_cast<int>(nimg); ++i) {
+    im2col(s, data_im + i * im_size, im_shape, col_shape, kernel_shape, pad, stride,
+           dilation, data_col + i * col_size);
+  }
+}
+
+/*!
+ * \brief col2im of the column buffers of nimg images at data_col, the one of
+ *  image i at data_col + i * col_shape.Size()
+ * \param data_im pointer of the first image (C, H, W,...) in the image batch
+ * \param req the request of the images
+ */
+template <typename DType>
+inline void col2im_batch(mshadow::Stream<cpu>* s,
+                         const DType* data_col, index_t nimg, const TShape& im_shape,
+                         const TShape& col_shape, const TShape& kernel_shape,
+                         const TShape& pad, const TShape& stride,
+                         const TShape& dilation, DType* data_im, OpReqType req) {
+  const index_t im_size = im_shape.ProdShape(1, im_shape.ndim());
+  const index_t col_size = col_shape.Size();
+  const int nthread = im2col_batch_threads(nimg, col_size);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int i = 0; i < static_cast<int>(nimg); ++i) {
+    col2im(s, data_col + i * col_size, im_shape, col_shape, kernel_shape, pad, stride,
+           dilation, data_im + i * im_size, req);
+  }
+}
+
 }  // namespace op
 }  // namespace mxnet
 #ifdef __CUDACC__
@@ -80,6 +80,8 @@
 #include <mxnet/base.h>
 #include <mxnet/operator.h>
 #include <algorithm>
+#include <climits>
+#include <vector>
 #include "../mxnet_op.h"
 
 namespace mxnet {
@@ -92,14 +94,76 @@ enum PoolingOpType {kMaxPooling, kAvgPooling, kSumPooling};
 enum PoolingOpPadConventionType {kValid, kFull};
 }  // namespace pool_enum
 
+/*! \brief keys the OpenMP grain of the cpu pooling functions */
+struct PoolCPUGrain {};
+
 /*!
- * \brief max pooling cpu function for 1-D images.
+ * \brief the number of OpenMP threads of a cpu pooling of nplane planes,
+ *  each of which reads or writes about work values
+ */
+inline int pool_num_threads(int nplane, size_t work) {
+  const size_t total = std::min<size_t>(static_cast<size_t>(nplane) * work, INT_MAX);
+  const int nthread = mxnet_op::KernelNumThreads(static_cast<int>(total),
+                                                 mxnet_op::KernelGrain<PoolCPUGrain>::Get());
+  return std::min(nthread, nplane);
+}
+
+/*!
+ * \brief whether the windows of a pooling are its whole planes, so that each
+ *  plane reduces to one output
+ */
+inline bool pool_is_global(const TShape& ishape, const TShape& oshape, const TShape& kernel,
+                           const TShape& pad) {
+  for (index_t i = 0; i < kernel.ndim(); ++i) {
+    if (oshape[2 + i] != 1 || kernel[i] != ishape[2 + i] || pad[i] != 0) return false;
+  }
+  return true;
+}
+
+/*!
+ * \brief global pooling cpu function for 1/2/3-D images, a reduction of each
+ *  contiguous plane. Do not call this kernel directly. Use the interface pool().
+ */
+template<typename DType>
+inline void pool_global_cpu(const DType* in_data, const TShape& ishape, const TShape& oshape,
+                            const int pool_type, DType* out_data, int* mask) {
+  using mshadow::red::limits::MinValue;
+  const int nplane = oshape[0] * oshape[1];
+  const int plane = ishape.Size() / nplane;
+  const int nthread = pool_num_threads(nplane, plane);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    const DType* in = in_data + static_cast<size_t>(p) * plane;
+    if (pool_enum::kMaxPooling == pool_type) {
+      DType max_val = MinValue<DType>();
+      int max_idx = -1;
+      for (int i = 0; i < plane; ++i) {
+        if (in[i] > max_val) {
+          max_val = in[i];
+          max_idx = i;
+        }
+      }
+      out_data[p] = max_val;
+      if (mask != nullptr) mask[p] = max_idx;
+    } else {
+      DType sum = 0;
+      for (int i = 0; i < plane; ++i) {
+        sum += in[i];
+      }
+      out_data[p] = (pool_enum::kAvgPooling == pool_type ? sum / plane : sum);
+    }
+  }
+}
+
+/*!
+ * \brief max pooling cpu function for 1-D images. The index in its plane of
+ *  the max of each window is written to mask if it is not null.
  * Do not call this kernel directly. Use the interface pool().
  */
 template<typename DType>
 inline void pool_max_1d_cpu(const DType* in_data, const TShape& ishape, const TShape& oshape,
                             const TShape& kernel, const TShape& pad, const TShape& stride,
-                            DType* out_data) {
+                            DType* out_data, int* mask) {
   using mshadow::red::limits::MinValue;
   const int width = ishape[2];
   const int pooled_width = oshape[2];
@@ -108,34 +172,71 @@ inline void pool_max_1d_cpu(const DType* in_data, const TShape& ishape, const TS
   const int stride_w = stride[0];
   const index_t in_data_offset = ishape[2];
   const index_t out_data_offset = oshape[2];
-  for (index_t n = 0; n < oshape[0]; ++n) {
-    for (index_t c = 0; c < oshape[1]; ++c) {
-      for (int pw = 0; pw < pooled_width; ++pw) {
-        int wstart = pw * stride_w - pad_w;
-        int wend = std::min(wstart + kernel_w, width);
-        wstart = std::max(wstart, 0);
-        DType max_val = MinValue<DType>();
-        for (int w = wstart; w < wend; ++w) {
-          if (in_data[w] > max_val) {
-            max_val = in_data[w];
-          }
+  const int nplane = oshape[0] * oshape[1];
+  const int nthread = pool_num_threads(nplane, static_cast<size_t>(pooled_width) * kernel_w);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    const DType* in = in_data + p * in_data_offset;
+    DType* out = out_data + p * out_data_offset;
+    int* out_mask = mask != nullptr ? mask + p * out_data_offset : nullptr;
+    for (int pw = 0; pw < pooled_width; ++pw) {
+      int wstart = pw * stride_w - pad_w;
+      int wend = std::min(wstart + kernel_w, width);
+      wstart = std::max(wstart, 0);
+      DType max_val = MinValue<DType>();
+      int max_idx = -1;
+      for (int w = wstart; w < wend; ++w) {
+        if (in[w] > max_val) {
+          max_val = in[w];
+          max_idx = w;
         }
-        out_data[pw] = max_val;
       }
-      in_data += in_data_offset;
-      out_data += out_data_offset;
+      out[pw] = max_val;
+      if (out_mask != nullptr) out_mask[pw] = max_idx;
     }
   }
 }
 
 /*!
- * \brief max pooling cpu function for 2-D images.
+ * \brief col_max[w] = the max at w of the nrow rows of in, and col_arg[w] its
+ *  row counted from first_row if col_arg is not null. The rows are read
+ *  contiguously, so that the comparisons vectorize.
+ */
+template<typename DType>
+inline void pool_max_rows(const DType* in, const int nrow, const int width, const int first_row,
+                          DType* col_max, int* col_arg) {
+  std::copy(in, in + width, col_max);
+  if (col_arg == nullptr) {
+    for (int r = 1; r < nrow; ++r) {
+      const DType* row = in + r * width;
+      for (int w = 0; w < width; ++w) {
+        col_max[w] = row[w] > col_max[w] ? row[w] : col_max[w];
+      }
+    }
+  } else {
+    std::fill(col_arg, col_arg + width, first_row);
+    for (int r = 1; r < nrow; ++r) {
+      const DType* row = in + r * width;
+      for (int w = 0; w < width; ++w) {
+        if (row[w] > col_max[w]) {
+          col_max[w] = row[w];
+          col_arg[w] = first_row + r;
+        }
+      }
+    }
+  }
+}
+
+/*!
+ * \brief max pooling cpu function for 2-D images. Each row of windows takes
+ *  the max of its rows first, then of the columns of each window. The index
+ *  in its plane of the max of each window is written to mask if it is not null.
  * Do not call this kernel directly. Use the interface pool().
  */
 template<typename DType>
 inline void pool_max_2d_cpu(const DType* in_data, const TShape& ishape, const TShape& oshape,
                             const TShape& kernel, const TShape& pad, const TShape& stride,
-                            DType* out_data) {
+                            DType* out_data, int* mask) {
   using mshadow::red::limits::MinValue;
   const int height = ishape[2], width = ishape[3];
   const int pooled_height = oshape[2], pooled_width = oshape[3];
@@ -144,43 +245,62 @@ inline void pool_max_2d_cpu(const DType* in_data, const TShape& ishape, const TS
   const int stride_h = stride[0], stride_w = stride[1];
   const index_t in_data_offset = ishape[2] * ishape[3];
   const index_t out_data_offset = oshape[2] * oshape[3];
-  for (index_t n = 0; n < oshape[0]; ++n) {
-    for (index_t c = 0; c < oshape[1]; ++c) {
+  // the columns of the windows are the same for every row of windows
+  std::vector<int> wstarts(pooled_width), wends(pooled_width);
+  for (int pw = 0; pw < pooled_width; ++pw) {
+    const int wstart = pw * stride_w - pad_w;
+    wends[pw] = std::min(wstart + kernel_w, width);
+    wstarts[pw] = std::max(wstart, 0);
+  }
+  const int nplane = oshape[0] * oshape[1];
+  const int nthread = pool_num_threads(nplane, static_cast<size_t>(pooled_height) *
+                                       (kernel_h * width + pooled_width * kernel_w));
+  #pragma omp parallel num_threads(nthread) if (nthread > 1)
+  {
+    std::vector<DType> col_max(width);
+    std::vector<int> col_arg(mask != nullptr ? width : 0);
+    #pragma omp for
+    for (int p = 0; p < nplane; ++p) {
+      const DType* in = in_data + p * in_data_offset;
       for (int ph = 0; ph < pooled_height; ++ph) {
+        int hstart = ph * stride_h - pad_h;
+        const int hend = std::min(hstart + kernel_h, height);
+        hstart = std::max(hstart, 0);
+        DType* out = out_data + p * out_data_offset + ph * pooled_width;
+        int* out_mask = mask != nullptr ? mask + p * out_data_offset + ph * pooled_width : nullptr;
+        if (hstart >= hend) {
+          std::fill(out, out + pooled_width, MinValue<DType>());
+          if (out_mask != nullptr) std::fill(out_mask, out_mask + pooled_width, -1);
+          continue;
+        }
+        pool_max_rows(in + hstart * width, hend - hstart, width, hstart, col_max.data(),
+                      out_mask != nullptr ? col_arg.data() : nullptr);
         for (int pw = 0; pw < pooled_width; ++pw) {
-          int hstart = ph * stride_h - pad_h;
-          int wstart = pw * stride_w - pad_w;
-          int hend = std::min(hstart + kernel_h, height);
-          int wend = std::min(wstart + kernel_w, width);
-          hstart = std::max(hstart, 0);
-          wstart = std::max(wstart, 0);
-          const int pool_index = ph * pooled_width + pw;
           DType max_val = MinValue<DType>();
-          for (int h = hstart; h < hend; ++h) {
-            for (int w = wstart; w < wend; ++w) {
-              const int in_index = h * width + w;
-              if (in_data[in_index] > max_val) {
-                max_val = in_data[in_index];
-              }
+          int max_w = -1;
+          for (int w = wstarts[pw]; w < wends[pw]; ++w) {
+            if (col_max[w] > max_val) {
+              max_val = col_max[w];
+              max_w = w;
             }
           }
-          out_data[pool_index] = max_val;
+          out[pw] = max_val;
+          if (out_mask != nullptr) out_mask[pw] = max_w < 0 ? -1 : col_arg[max_w] * width + max_w;
         }
       }
-      in_data += in_data_offset;
-      out_data += out_data_offset;
     }
   }
 }
 
 /*!
- * \brief max pooling cpu function for 3-D images.
+ * \brief max pooling cpu function for 3-D images. The index in its plane of
+ *  the max of each window is written to mask if it is not null.
  * Do not call this kernel directly. Use the interface pool().
  */
 template<typename DType>
 inline void pool_max_3d_cpu(const DType* in_data, const TShape& ishape, const TShape& oshape,
                             const TShape& kernel, const TShape& pad, const TShape& stride,
-                            DType* out_data) {
+                            DType* out_data, int* mask) {
   using mshadow::red::limits::MinValue;
   const int depth = ishape[2], height = ishape[3], width = ishape[4];
   const int pooled_depth = oshape[2], pooled_height = oshape[3], pooled_width = oshape[4];
@@ -189,38 +309,44 @@ inline void pool_max_3d_cpu(const DType* in_data, const TShape& ishape, const TS
   const int stride_d = stride[0], stride_h = stride[1], stride_w = stride[2];
   const index_t in_data_offset = ishape[2] * ishape[3] * ishape[4];
   const index_t out_data_offset = oshape[2] * oshape[3] * oshape[4];
-  for (index_t n = 0; n < oshape[0]; ++n) {
-    for (index_t c = 0; c < oshape[1]; ++c) {
-      for (int pd = 0; pd < pooled_depth; ++pd) {
-        for (int ph = 0; ph < pooled_height; ++ph) {
-          for (int pw = 0; pw < pooled_width; ++pw) {
-            int dstart = pd * stride_d - pad_d;
-            int hstart = ph * stride_h - pad_h;
-            int wstart = pw * stride_w - pad_w;
-            int dend = std::min(dstart + kernel_d, depth);
-            int hend = std::min(hstart + kernel_h, height);
-            int wend = std::min(wstart + kernel_w, width);
-            dstart = std::max(dstart, 0);
-            hstart = std::max(hstart, 0);
-            wstart = std::max(wstart, 0);
-            const int pool_index = (pd * pooled_height + ph) * pooled_width + pw;
-            DType max_val = MinValue<DType>();
-            for (int d = dstart; d < dend; ++d) {
-              for (int h = hstart; h < hend; ++h) {
-                for (int w = wstart; w < wend; ++w) {
-                  const int in_index = (d * height + h) * width + w;
-                  if (in_data[in_index] > max_val) {
-                    max_val = in_data[in_index];
-                  }
+  const int nplane = oshape[0] * oshape[1];
+  const int nthread = pool_num_threads(nplane, static_cast<size_t>(out_data_offset) *
+                                       kernel_d * kernel_h * kernel_w);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    const DType* in = in_data + p * in_data_offset;
+    DType* out = out_data + p * out_data_offset;
+    int* out_mask = mask != nullptr ? mask + p * out_data_offset : nullptr;
+    for (int pd = 0; pd < pooled_depth; ++pd) {
+      for (int ph = 0; ph < pooled_height; ++ph) {
+        for (int pw = 0; pw < pooled_width; ++pw) {
+          int dstart = pd * stride_d - pad_d;
+          int hstart = ph * stride_h - pad_h;
+          int wstart = pw * stride_w - pad_w;
+          int dend = std::min(dstart + kernel_d, depth);
+          int hend = std::min(hstart + kernel_h, height);
+          int wend = std::min(wstart + kernel_w, width);
+          dstart = std::max(dstart, 0);
+          hstart = std::max(hstart, 0);
+          wstart = std::max(wstart, 0);
+          const int pool_index = (pd * pooled_height + ph) * pooled_width + pw;
+          DType max_val = MinValue<DType>();
+          int max_idx = -1;
+          for (int d = dstart; d < dend; ++d) {
+            for (int h = hstart; h < hend; ++h) {
+              for (int w = wstart; w < wend; ++w) {
+                const int in_index = (d * height + h) * width + w;
+                if (in[in_index] > max_val) {
+                  max_val = in[in_index];
+                  max_idx = in_index;
                 }
               }
             }
-            out_data[pool_index] = max_val;
           }
+          out[pool_index] = max_val;
+          if (out_mask != nullptr) out_mask[pool_index] = max_idx;
         }
       }
-      in_data += in_data_offset;
-      out_data += out_data_offset;
     }
   }
 }
@@ -240,28 +366,30 @@ inline void pool_sum_1d_cpu(const DType* in_data, const TShape& ishape, const TS
   const int stride_w = stride[0];
   const index_t in_data_offset = ishape[2];
   const index_t out_data_offset = oshape[2];
-  for (index_t n = 0; n < oshape[0]; ++n) {
-    for (index_t c = 0; c < oshape[1]; ++c) {
-      for (int pw = 0; pw < pooled_width; ++pw) {
-        int wstart = pw * stride_w - pad_w;
-        int wend = std::min(wstart + kernel_w, width + pad_w);
-        int pool_size = (wend - wstart);
-        wstart = std::max(wstart, 0);
-        wend = std::min(wend, width);
-        DType sum = 0;
-        for (int w = wstart; w < wend; ++w) {
-          sum += in_data[w];
-        }
-        out_data[pw] = (getAvg? sum/pool_size : sum);
+  const int nplane = oshape[0] * oshape[1];
+  const int nthread = pool_num_threads(nplane, static_cast<size_t>(pooled_width) * kernel_w);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    const DType* in = in_data + p * in_data_offset;
+    DType* out = out_data + p * out_data_offset;
+    for (int pw = 0; pw < pooled_width; ++pw) {
+      int wstart = pw * stride_w - pad_w;
+      int wend = std::min(wstart + kernel_w, width + pad_w);
+      int pool_size = (wend - wstart);
+      wstart = std::max(wstart, 0);
+      wend = std::min(wend, width);
+      DType sum = 0;
+      for (int w = wstart; w < wend; ++w) {
+        sum += in[w];
       }
-      in_data += in_data_offset;
-      out_data += out_data_offset;
+      out[pw] = (getAvg? sum/pool_size : sum);
     }
   }
 }
 
 /*!
- * \brief avg/sum pooling cpu function for 2-D images.
+ * \brief avg/sum pooling cpu function for 2-D images. Each row of windows
+ *  sums its rows first, then the columns of each window.
  * Do not call this kernel directly. Use the interface pool().
  */
 template<typename DType>
@@ -275,30 +403,46 @@ inline void pool_sum_2d_cpu(const DType* in_data, const TShape& ishape, const TS
   const int stride_h = stride[0], stride_w = stride[1];
   const index_t in_data_offset = ishape[2] * ishape[3];
   const index_t out_data_offset = oshape[2] * oshape[3];
-  for (index_t n = 0; n < oshape[0]; ++n) {
-    for (index_t c = 0; c < oshape[1]; ++c) {
+  // the columns of the windows, and their widths with the padding
+  std::vector<int> wstarts(pooled_width), wends(pooled_width), wsizes(pooled_width);
+  for (int pw = 0; pw < pooled_width; ++pw) {
+    const int wstart = pw * stride_w - pad_w;
+    const int wend = std::min(wstart + kernel_w, width + pad_w);
+    wsizes[pw] = wend - wstart;
+    wstarts[pw] = std::max(wstart, 0);
+    wends[pw] = std::min(wend, width);
+  }
+  const int nplane = oshape[0] * oshape[1];
+  const int nthread = pool_num_threads(nplane, static_cast<size_t>(pooled_height) *
+                                       (kernel_h * width + pooled_width * kernel_w));
+  #pragma omp parallel num_threads(nthread) if (nthread > 1)
+  {
+    std::vector<DType> col_sum(width);
+    #pragma omp for
+    for (int p = 0; p < nplane; ++p) {
+      const DType* in = in_data + p * in_data_offset;
       for (int ph = 0; ph < pooled_height; ++ph) {
+        int hstart = ph * stride_h - pad_h;
+        int hend = std::min(hstart + kernel_h, height + pad_h);
+        const int hsize = hend - hstart;
+        hstart = std::max(hstart, 0);
+        hend = std::min(hend, height);
+        std::fill(col_sum.begin(), col_sum.end(), DType(0));
+        for (int h = hstart; h < hend; ++h) {
+          const DType* row = in + h * width;
+          for (int w = 0; w < width; ++w) {
+            col_sum[w] += row[w];
+          }
+        }
+        DType* out = out_data + p * out_data_offset + ph * pooled_width;
         for (int pw = 0; pw < pooled_width; ++pw) {
-          int hstart = ph * stride_h - pad_h;
-          int wstart = pw * stride_w - pad_w;
-          int hend = std::min(hstart + kernel_h, height + pad_h);
-          int wend = std::min(wstart + kernel_w, width + pad_w);
-          int pool_size = (hend - hstart) * (wend - wstart);
-          hstart = std::max(hstart, 0);
-          wstart = std::max(wstart, 0);
-          hend = std::min(hend, height);
-          wend = std::min(wend, width);
           DType sum = 0;
-          for (int h = hstart; h < hend; ++h) {
-            for (int w = wstart; w < wend; ++w) {
-              sum += in_data[h*width+w];
-            }
+          for (int w = wstarts[pw]; w < wends[pw]; ++w) {
+            sum += col_sum[w];
           }
-          out_data[ph*pooled_width+pw] = (getAvg? sum/pool_size : sum);
+          out[pw] = (getAvg? sum/(hsize * wsizes[pw]) : sum);
         }
       }
-      in_data += in_data_offset;
-      out_data += out_data_offset;
     }
   }
 }
@@ -318,38 +462,67 @@ inline void pool_sum_3d_cpu(const DType* in_data, const TShape& ishape, const TS
   const int stride_d = stride[0], stride_h = stride[1], stride_w = stride[2];
   const index_t in_data_offset = ishape[2] * ishape[3] * ishape[4];
   const index_t out_data_offset = oshape[2] * oshape[3] * oshape[4];
-  for (index_t n = 0; n < oshape[0]; ++n) {
-    for (index_t c = 0; c < oshape[1]; ++c) {
-      for (int pd = 0; pd < pooled_depth; ++pd) {
-        for (int ph = 0; ph < pooled_height; ++ph) {
-          for (int pw = 0; pw < pooled_width; ++pw) {
-            int dstart = pd * stride_d - pad_d;
-            int hstart = ph * stride_h - pad_h;
-            int wstart = pw * stride_w - pad_w;
-            int dend = std::min(dstart + kernel_d, depth + pad_d);
-            int hend = std::min(hstart + kernel_h, height + pad_h);
-            int wend = std::min(wstart + kernel_w, width + pad_w);
-            int pool_size = (dend - dstart) * (hend - hstart) * (wend - wstart);
-            dstart = std::max(dstart, 0);
-            hstart = std::max(hstart, 0);
-            wstart = std::max(wstart, 0);
-            dend = std::min(dend, depth);
-            hend = std::min(hend, height);
-            wend = std::min(wend, width);
-            DType sum = 0;
-            for (int d = dstart; d < dend; ++d) {
-              for (int h = hstart; h < hend; ++h) {
-                for (int w = wstart; w < wend; ++w) {
-                  sum += in_data[(d*height+h)*width+w];
-                }
+  const int nplane = oshape[0] * oshape[1];
+  const int nthread = pool_num_threads(nplane, static_cast<size_t>(out_data_offset) *
+                                       kernel_d * kernel_h * kernel_w);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    const DType* in = in_data + p * in_data_offset;
+    DType* out = out_data + p * out_data_offset;
+    for (int pd = 0; pd < pooled_depth; ++pd) {
+      for (int ph = 0; ph < pooled_height; ++ph) {
+        for (int pw = 0; pw < pooled_width; ++pw) {
+          int dstart = pd * stride_d - pad_d;
+          int hstart = ph * stride_h - pad_h;
+          int wstart = pw * stride_w - pad_w;
+          int dend = std::min(dstart + kernel_d, depth + pad_d);
+          int hend = std::min(hstart + kernel_h, height + pad_h);
+          int wend = std::min(wstart + kernel_w, width + pad_w);
+          int pool_size = (dend - dstart) * (hend - hstart) * (wend - wstart);
+          dstart = std::max(dstart, 0);
+          hstart = std::max(hstart, 0);
+          wstart = std::max(wstart, 0);
+          dend = std::min(dend, depth);
+          hend = std::min(hend, height);
+          wend = std::min(wend, width);
+          DType sum = 0;
+          for (int d = dstart; d < dend; ++d) {
+            for (int h = hstart; h < hend; ++h) {
+              for (int w = wstart; w < wend; ++w) {
+                sum += in[(d*height+h)*width+w];
               }
             }
-            out_data[(pd*pooled_height+ph)*pooled_width+pw] = (getAvg? sum/pool_size : sum);
           }
+          out[(pd*pooled_height+ph)*pooled_width+pw] = (getAvg? sum/pool_size : sum);
         }
       }
-      in_data += in_data_offset;
-      out_data += out_data_offset;
+    }
+  }
+}
+
+/*!
+ * \brief max unpooling cpu function for 1/2/3-D images, from the indices of
+ *  the maxima that the forward pass wrote to mask.
+ * Do not call this kernel directly. Use the interface unpool().
+ */
+template<typename DType>
+inline void unpool_max_mask_cpu(const DType* out_grad, const int* mask, const TShape& ishape,
+                                const TShape& oshape, DType* in_grad) {
+  const int nplane = oshape[0] * oshape[1];
+  const index_t in_offset = ishape.Size() / nplane;
+  const index_t out_offset = oshape.Size() / nplane;
+  const int nthread = pool_num_threads(nplane, out_offset);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    const DType* grad = out_grad + p * out_offset;
+    const int* idx = mask + p * out_offset;
+    DType* in = in_grad + p * in_offset;
+    for (index_t i = 0; i < out_offset; ++i) {
+      // In the case where pad > 0 and kernel = 1, for example,
+      // a window can have no max.
+      if (idx[i] >= 0) {
+        in[idx[i]] += grad[i];
+      }
     }
   }
 }
@@ -371,29 +544,30 @@ inline void unpool_max_1d_cpu(const DType* out_grad, const DType* in_data,
   const int stride_w = stride[0];
   const index_t in_offset = ishape[2];
   const index_t out_offset = oshape[2];
-  for (index_t n = 0; n < oshape[0]; ++n) {
-    for (index_t c = 0; c < oshape[1]; ++c) {
-      for (int pw = 0; pw < pooled_width; ++pw) {
-        int wstart = pw * stride_w - pad_w;
-        int wend = std::min(wstart + kernel_w, width);
-        wstart = std::max(wstart, 0);
-        int max_idx = -1;
-        for (int w = wstart; w < wend; ++w) {
-          if (in_data[w] == out_data[pw]) {
-            max_idx = w;
-            break;
-          }
-        }
-        // In the case where pad > 0 and kernel = 1, for example,
-        // max_idx can be -1 reaching this step.
-        if (max_idx >= 0) {
-          in_grad[max_idx] += out_grad[pw];
+  const int nplane = oshape[0] * oshape[1];
+  const int nthread = pool_num_threads(nplane, static_cast<size_t>(pooled_width) * kernel_w);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    const DType* in = in_data + p * in_offset;
+    DType* grad = in_grad + p * in_offset;
+    const DType* out = out_data + p * out_offset;
+    const DType* ograd = out_grad + p * out_offset;
+    for (int pw = 0; pw < pooled_width; ++pw) {
+      int wstart = pw * stride_w - pad_w;
+      int wend = std::min(wstart + kernel_w, width);
+      wstart = std::max(wstart, 0);
+      int max_idx = -1;
+      for (int w = wstart; w < wend; ++w) {
+        if (in[w] == out[pw]) {
+          max_idx = w;
+          break;
         }
       }
-      in_data += in_offset;
-      in_grad += in_offset;
-      out_data += out_offset;
-      out_grad += out_offset;
+      // In the case where pad > 0 and kernel = 1, for example,
+      // max_idx can be -1 reaching this step.
+      if (max_idx >= 0) {
+        grad[max_idx] += ograd[pw];
+      }
     }
   }
 }
@@ -415,41 +589,43 @@ inline void unpool_max_2d_cpu(const DType* out_grad, const DType* in_data,
   const int stride_h = stride[0], stride_w = stride[1];
   const index_t in_offset = ishape[2] * ishape[3];
   const index_t out_offset = oshape[2] * oshape[3];
-  for (index_t n = 0; n < oshape[0]; ++n) {
-    for (index_t c = 0; c < oshape[1]; ++c) {
-      for (int ph = 0; ph < pooled_height; ++ph) {
-        for (int pw = 0; pw < pooled_width; ++pw) {
-          int hstart = ph * stride_h - pad_h;
-          int wstart = pw * stride_w - pad_w;
-          int hend = std::min(hstart + kernel_h, height);
-          int wend = std::min(wstart + kernel_w, width);
-          hstart = std::max(hstart, 0);
-          wstart = std::max(wstart, 0);
-          const int pool_index = ph * pooled_width + pw;
-          int max_idx = -1;
-          bool found = false;
-          for (int h = hstart; h < hend; ++h) {
-            for (int w = wstart; w < wend; ++w) {
-              const int idx = h * width + w;
-              if (in_data[idx] == out_data[pool_index]) {
-                max_idx = idx;
-                found = true;
-                break;
-              }
+  const int nplane = oshape[0] * oshape[1];
+  const int nthread = pool_num_threads(nplane, static_cast<size_t>(out_offset) *
+                                       kernel_h * kernel_w);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    const DType* in = in_data + p * in_offset;
+    DType* grad = in_grad + p * in_offset;
+    const DType* out = out_data + p * out_offset;
+    const DType* ograd = out_grad + p * out_offset;
+    for (int ph = 0; ph < pooled_height; ++ph) {
+      for (int pw = 0; pw < pooled_width; ++pw) {
+        int hstart = ph * stride_h - pad_h;
+        int wstart = pw * stride_w - pad_w;
+        int hend = std::min(hstart + kernel_h, height);
+        int wend = std::min(wstart + kernel_w, width);
+        hstart = std::max(hstart, 0);
+        wstart = std::max(wstart, 0);
+        const int pool_index = ph * pooled_width + pw;
+        int max_idx = -1;
+        bool found = false;
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            const int idx = h * width + w;
+            if (in[idx] == out[pool_index]) {
+              max_idx = idx;
+              found = true;
+              break;
             }
-            if (found) break;
-          }
-          // In the case where pad > 0 and kernel = 1, for example,
-          // max_idx can be -1 reaching this step.
-          if (max_idx >= 0) {
-            in_grad[max_idx] += out_grad[pool_index];
           }
+          if (found) break;
+        }
+        // In the case where pad > 0 and kernel = 1, for example,
+        // max_idx can be -1 reaching this step.
+        if (max_idx >= 0) {
+          grad[max_idx] += ograd[pool_index];
         }
       }
-      in_data += in_offset;
-      in_grad += in_offset;
-      out_data += out_offset;
-      out_grad += out_offset;
     }
   }
 }
@@ -471,49 +647,51 @@ inline void unpool_max_3d_cpu(const DType* out_grad, const DType* in_data,
   const int stride_d = stride[0], stride_h = stride[1], stride_w = stride[2];
   const index_t in_offset = ishape[2] * ishape[3] * ishape[4];
   const index_t out_offset = oshape[2] * oshape[3] * oshape[4];
-  for (index_t n = 0; n < oshape[0]; ++n) {
-    for (index_t c = 0; c < oshape[1]; ++c) {
-      for (int pd = 0; pd < pooled_depth; ++pd) {
-        for (int ph = 0; ph < pooled_height; ++ph) {
-          for (int pw = 0; pw < pooled_width; ++pw) {
-            int dstart = pd * stride_d - pad_d;
-            int hstart = ph * stride_h - pad_h;
-            int wstart = pw * stride_w - pad_w;
-            int dend = std::min(dstart + kernel_d, depth);
-            int hend = std::min(hstart + kernel_h, height);
-            int wend = std::min(wstart + kernel_w, width);
-            dstart = std::max(dstart, 0);
-            hstart = std::max(hstart, 0);
-            wstart = std::max(wstart, 0);
-            const int pool_index = (pd * pooled_height + ph) * pooled_width + pw;
-            int max_idx = -1;
-            bool found = false;
-            for (int d = dstart; d < dend; ++d) {
-              for (int h = hstart; h < hend; ++h) {
-                for (int w = wstart; w < wend; ++w) {
-                  const int idx = (d * height + h) * width + w;
-                  if (in_data[idx] == out_data[pool_index]) {
-                    max_idx = idx;
-                    found = true;
-                    break;
-                  }
+  const int nplane = oshape[0] * oshape[1];
+  const int nthread = pool_num_threads(nplane, static_cast<size_t>(out_offset) *
+                                       kernel_d * kernel_h * kernel_w);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    const DType* in = in_data + p * in_offset;
+    DType* grad = in_grad + p * in_offset;
+    const DType* out = out_data + p * out_offset;
+    const DType* ograd = out_grad + p * out_offset;
+    for (int pd = 0; pd < pooled_depth; ++pd) {
+      for (int ph = 0; ph < pooled_height; ++ph) {
+        for (int pw = 0; pw < pooled_width; ++pw) {
+          int dstart = pd * stride_d - pad_d;
+          int hstart = ph * stride_h - pad_h;
+          int wstart = pw * stride_w - pad_w;
+          int dend = std::min(dstart + kernel_d, depth);
+          int hend = std::min(hstart + kernel_h, height);
+          int wend = std::min(wstart + kernel_w, width);
+          dstart = std::max(dstart, 0);
+          hstart = std::max(hstart, 0);
+          wstart = std::max(wstart, 0);
+          const int pool_index = (pd * pooled_height + ph) * pooled_width + pw;
+          int max_idx = -1;
+          bool found = false;
+          for (int d = dstart; d < dend; ++d) {
+            for (int h = hstart; h < hend; ++h) {
+              for (int w = wstart; w < wend; ++w) {
+                const int idx = (d * height + h) * width + w;
+                if (in[idx] == out[pool_index]) {
+                  max_idx = idx;
+                  found = true;
+                  break;
                 }
-                if (found) break;
               }
               if (found) break;
             }
-            // In the case where pad > 0 and kernel = 1, for example,
-            // max_idx can be -1 reaching this step.
-            if (max_idx >= 0) {
-              in_grad[max_idx] += out_grad[pool_index];
-            }
+            if (found) break;
+          }
+          // In the case where pad > 0 and kernel = 1, for example,
+          // max_idx can be -1 reaching this step.
+          if (max_idx >= 0) {
+            grad[max_idx] += ograd[pool_index];
           }
         }
       }
-      in_data += in_offset;
-      in_grad += in_offset;
-      out_data += out_offset;
-      out_grad += out_offset;
     }
   }
 }
@@ -534,23 +712,24 @@ inline void unpool_sum_1d_cpu(const DType* out_grad, const TShape& ishape,
   const int stride_w = stride[0];
   const index_t in_grad_offset = ishape[2];
   const index_t out_grad_offset = oshape[2];
-  for (index_t n = 0; n < oshape[0]; ++n) {
-    for (index_t c = 0; c < oshape[1]; ++c) {
-      for (int pw = 0; pw < pooled_width; ++pw) {
-        int wstart = pw * stride_w - pad_w;
-        int wend = std::min(wstart + kernel_w, width + pad_w);
-        int pool_size = 1;
-        if (isAvg) {
-          pool_size = wend - wstart;
-        }
-        wstart = std::max(wstart, 0);
-        wend = std::min(wend, width);
-        for (int w = wstart; w < wend; ++w) {
-          in_grad[w] += out_grad[pw] / pool_size;
-        }
+  const int nplane = oshape[0] * oshape[1];
+  const int nthread = pool_num_threads(nplane, static_cast<size_t>(pooled_width) * kernel_w);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    DType* grad = in_grad + p * in_grad_offset;
+    const DType* ograd = out_grad + p * out_grad_offset;
+    for (int pw = 0; pw < pooled_width; ++pw) {
+      int wstart = pw * stride_w - pad_w;
+      int wend = std::min(wstart + kernel_w, width + pad_w);
+      int pool_size = 1;
+      if (isAvg) {
+        pool_size = wend - wstart;
+      }
+      wstart = std::max(wstart, 0);
+      wend = std::min(wend, width);
+      for (int w = wstart; w < wend; ++w) {
+        grad[w] += ograd[pw] / pool_size;
       }
-      in_grad += in_grad_offset;
-      out_grad += out_grad_offset;
     }
   }
 }
@@ -571,32 +750,34 @@ inline void unpool_sum_2d_cpu(const DType* out_grad, const TShape& ishape,
   const int stride_h = stride[0], stride_w = stride[1];
   const index_t in_grad_offset = ishape[2] * ishape[3];
   const index_t out_grad_offset = oshape[2] * oshape[3];
-  for (index_t n = 0; n < oshape[0]; ++n) {
-    for (index_t c = 0; c < oshape[1]; ++c) {
-      for (int ph = 0; ph < pooled_height; ++ph) {
-        for (int pw = 0; pw < pooled_width; ++pw) {
-          int hstart = ph * stride_h - pad_h;
-          int wstart = pw * stride_w - pad_w;
-          int hend = std::min(hstart + kernel_h, height + pad_h);
-          int wend = std::min(wstart + kernel_w, width + pad_w);
-          int pool_size = 1;
-          if (isAvg) {
-            pool_size = (hend - hstart) * (wend - wstart);
-          }
-          hstart = std::max(hstart, 0);
-          wstart = std::max(wstart, 0);
-          hend = std::min(hend, height);
-          wend = std::min(wend, width);
-          const int pool_index = ph * pooled_width + pw;
-          for (int h = hstart; h < hend; ++h) {
-            for (int w = wstart; w < wend; ++w) {
-              in_grad[h*width+w] += out_grad[pool_index] / pool_size;
-            }
+  const int nplane = oshape[0] * oshape[1];
+  const int nthread = pool_num_threads(nplane, static_cast<size_t>(out_grad_offset) *
+                                       kernel_h * kernel_w);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    DType* grad = in_grad + p * in_grad_offset;
+    const DType* ograd = out_grad + p * out_grad_offset;
+    for (int ph = 0; ph < pooled_height; ++ph) {
+      for (int pw = 0; pw < pooled_width; ++pw) {
+        int hstart = ph * stride_h - pad_h;
+        int wstart = pw * stride_w - pad_w;
+        int hend = std::min(hstart + kernel_h, height + pad_h);
+        int wend = std::min(wstart + kernel_w, width + pad_w);
+        int pool_size = 1;
+        if (isAvg) {
+          pool_size = (hend - hstart) * (wend - wstart);
+        }
+        hstart = std::max(hstart, 0);
+        wstart = std::max(wstart, 0);
+        hend = std::min(hend, height);
+        wend = std::min(wend, width);
+        const DType g = ograd[ph * pooled_width + pw] / pool_size;
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            grad[h*width+w] += g;
           }
         }
       }
-      in_grad += in_grad_offset;
-      out_grad += out_grad_offset;
     }
   }
 }
@@ -617,40 +798,42 @@ inline void unpool_sum_3d_cpu(const DType* out_grad, const TShape& ishape,
   const int stride_d = stride[0], stride_h = stride[1], stride_w = stride[2];
   const index_t in_grad_offset = ishape[2] * ishape[3] * ishape[4];
   const index_t out_grad_offset = oshape[2] * oshape[3] * oshape[4];
-  for (index_t n = 0; n < oshape[0]; ++n) {
-    for (index_t c = 0; c < oshape[1]; ++c) {
-      for (int pd = 0; pd < pooled_depth; ++pd) {
-        for (int ph = 0; ph < pooled_height; ++ph) {
-          for (int pw = 0; pw < pooled_width; ++pw) {
-            int dstart = pd * stride_d - pad_d;
-            int hstart = ph * stride_h - pad_h;
-            int wstart = pw * stride_w - pad_w;
-            int dend = std::min(dstart + kernel_d, depth + pad_d);
-            int hend = std::min(hstart + kernel_h, height + pad_h);
-            int wend = std::min(wstart + kernel_w, width + pad_w);
-            int pool_size = 1;
-            if (isAvg) {
-              pool_size = (dend - dstart) * (hend - hstart) * (wend - wstart);
-            }
-            dstart = std::max(dstart, 0);
-            hstart = std::max(hstart, 0);
-            wstart = std::max(wstart, 0);
-            dend = std::min(dend, depth);
-            hend = std::min(hend, height);
-            wend = std::min(wend, width);
-            const int pool_index = (pd * pooled_height + ph) * pooled_width + pw;
-            for (int d = dstart; d < dend; ++d) {
-              for (int h = hstart; h < hend; ++h) {
-                for (int w = wstart; w < wend; ++w) {
-                  in_grad[(d*height+h)*width+w] += out_grad[pool_index] / pool_size;
-                }
+  const int nplane = oshape[0] * oshape[1];
+  const int nthread = pool_num_threads(nplane, static_cast<size_t>(out_grad_offset) *
+                                       kernel_d * kernel_h * kernel_w);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int p = 0; p < nplane; ++p) {
+    DType* grad = in_grad + p * in_grad_offset;
+    const DType* ograd = out_grad + p * out_grad_offset;
+    for (int pd = 0; pd < pooled_depth; ++pd) {
+      for (int ph = 0; ph < pooled_height; ++ph) {
+        for (int pw = 0; pw < pooled_width; ++pw) {
+          int dstart = pd * stride_d - pad_d;
+          int hstart = ph * stride_h - pad_h;
+          int wstart = pw * stride_w - pad_w;
+          int dend = std::min(dstart + kernel_d, depth + pad_d);
+          int hend = std::min(hstart + kernel_h, height + pad_h);
+          int wend = std::min(wstart + kernel_w, width + pad_w);
+          int pool_size = 1;
+          if (isAvg) {
+            pool_size = (dend - dstart) * (hend - hstart) * (wend - wstart);
+          }
+          dstart = std::max(dstart, 0);
+          hstart = std::max(hstart, 0);
+          wstart = std::max(wstart, 0);
+          dend = std::min(dend, depth);
+          hend = std::min(hend, height);
+          wend = std::min(wend, width);
+          const int pool_index = (pd * pooled_height + ph) * pooled_width + pw;
+          for (int d = dstart; d < dend; ++d) {
+            for (int h = hstart; h < hend; ++h) {
+              for (int w = wstart; w < wend; ++w) {
+                grad[(d*height+h)*width+w] += ograd[pool_index] / pool_size;
               }
             }
           }
         }
       }
-      in_grad += in_grad_offset;
-      out_grad += out_grad_offset;
     }
   }
 }
@@ -667,16 +850,23 @@ inline void unpool_sum_3d_cpu(const DType* out_grad, const TShape& ishape,
  * \param pool_type supported pooling type: max, avg, sum
  * \param req_type operator request type, only support kWriteTo for now
  * \param out_data pointer of the output tensor data in the format of NCW, NCHW, or NCDHW
+ * \param mask if not null, receives the index in its plane of the max of each
+ *  window of max pooling, for unpool()
  */
 template<typename DType>
 inline void pool(mshadow::Stream<cpu>* s, const DType* in_data, const TShape& ishape,
                  const TShape& oshape, const TShape& kernel, const TShape& pad,
                  const TShape& stride, const int pool_type, OpReqType req_type,
-                 DType* out_data) {
+                 DType* out_data, int* mask = nullptr) {
   CHECK_EQ(req_type, kWriteTo) << "Only support req=kWriteTo in pooling operations";
-  if (kernel.ndim() == 1) {
+  if (pool_enum::kMaxPooling != pool_type) mask = nullptr;
+  if (kernel.ndim() >= 1 && kernel.ndim() <= 3 && pool_is_global(ishape, oshape, kernel, pad) &&
+      (pool_enum::kMaxPooling == pool_type || pool_enum::kAvgPooling == pool_type ||
+       pool_enum::kSumPooling == pool_type)) {
+    pool_global_cpu(in_data, ishape, oshape, pool_type, out_data, mask);
+  } else if (kernel.ndim() == 1) {
     if (pool_enum::kMaxPooling == pool_type) {
-      pool_max_1d_cpu(in_data, ishape, oshape, kernel, pad, stride, out_data);
+      pool_max_1d_cpu(in_data, ishape, oshape, kernel, pad, stride, out_data, mask);
     } else if (pool_enum::kAvgPooling == pool_type) {
       pool_sum_1d_cpu(in_data, ishape, oshape, kernel, pad, stride, out_data, true);
     } else if (pool_enum::kSumPooling == pool_type) {
@@ -686,7 +876,7 @@ inline void pool(mshadow::Stream<cpu>* s, const DType* in_data, const TShape& is
     }
   } else if (kernel.ndim() == 2) {
     if (pool_enum::kMaxPooling == pool_type) {
-      pool_max_2d_cpu(in_data, ishape, oshape, kernel, pad, stride, out_data);
+      pool_max_2d_cpu(in_data, ishape, oshape, kernel, pad, stride, out_data, mask);
     } else if (pool_enum::kAvgPooling == pool_type) {
       pool_sum_2d_cpu(in_data, ishape, oshape, kernel, pad, stride, out_data, true);
     } else if (pool_enum::kSumPooling == pool_type) {
@@ -696,7 +886,7 @@ inline void pool(mshadow::Stream<cpu>* s, const DType* in_data, const TShape& is
     }
   } else if (kernel.ndim() == 3) {
     if (pool_enum::kMaxPooling == pool_type) {
-      pool_max_3d_cpu(in_data, ishape, oshape, kernel, pad, stride, out_data);
+      pool_max_3d_cpu(in_data, ishape, oshape, kernel, pad, stride, out_data, mask);
     } else if (pool_enum::kAvgPooling == pool_type) {
       pool_sum_3d_cpu(in_data, ishape, oshape, kernel, pad, stride, out_data, true);
     } else if (pool_enum::kSumPooling == pool_type) {
@@ -723,17 +913,22 @@ inline void pool(mshadow::Stream<cpu>* s, const DType* in_data, const TShape& is
  * \param pool_type supported pooling type: max, avg, sum
  * \param req_type operator request type: kNullOp, kNullWriteInplace, kNullWriteTo, kNullAddTo
  * \param in_grad pointer of the gradient of the operator's input tensor
+ * \param mask the indices of the maxima written by pool(), if not null, so
+ *  that max unpooling does not search the windows again
  */
 template<typename DType>
 inline void unpool(mshadow::Stream<cpu>* s, const DType* out_grad, const DType* in_data,
                    const DType* out_data, const TShape& ishape, const TShape& oshape,
                    const TShape& kernel, const TShape& pad, const TShape& stride,
-                   const int pool_type, OpReqType req_type, DType* in_grad) {
+                   const int pool_type, OpReqType req_type, DType* in_grad,
+                   const int* mask = nullptr) {
   if (mxnet::kNullOp == req_type) return;
   if (mxnet::kAddTo != req_type) {
     mxnet_op::Kernel<mxnet_op::set_zero, cpu>::Launch(s, ishape.Size(), in_grad);
   }
-  if (kernel.ndim() == 1) {
+  if (pool_enum::kMaxPooling == pool_type && mask != nullptr) {
+    unpool_max_mask_cpu(out_grad, mask, ishape, oshape, in_grad);
+  } else if (kernel.ndim() == 1) {
     if (pool_enum::kMaxPooling == pool_type) {
       unpool_max_1d_cpu(out_grad, in_data, out_data, ishape, oshape, kernel, pad, stride, in_grad);
     } else if (pool_enum::kAvgPooling == pool_type) {
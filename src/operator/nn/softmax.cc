@@ -29,7 +29,10 @@ namespace mxnet {
 namespace op {
 DMLC_REGISTER_PARAMETER(SoftmaxParam);
 
+// softmax operators reduce along an axis, they are not elementwise although
+// they are registered with the elementwise macros
 MXNET_OPERATOR_REGISTER_UNARY(softmax)
+.set_attr<bool>("TIsElemwise", false, 11)
 .describe(R"code(Applies the softmax function.
 
 The resulting array contains elements in the range (0,1) and the elements along the given axis sum up to 1.
@@ -57,11 +60,13 @@ Example::
 .add_arguments(SoftmaxParam::__FIELDS__());
 
 MXNET_OPERATOR_REGISTER_BINARY(_backward_softmax)
+.set_attr<bool>("TIsElemwise", false, 11)
 .set_attr_parser(ParamParser<SoftmaxParam>)
 .set_attr<FCompute>("FCompute<cpu>", SoftmaxGradCompute<cpu, mshadow::op::mul,
                                                         mxnet_op::softmax_bwd>);
 
 MXNET_OPERATOR_REGISTER_UNARY(log_softmax)
+.set_attr<bool>("TIsElemwise", false, 11)
 .describe(R"code(Computes the log softmax of the input.
 This is equivalent to computing softmax followed by log.
 
@@ -84,6 +89,7 @@ Examples::
 .add_arguments(SoftmaxParam::__FIELDS__());
 
 MXNET_OPERATOR_REGISTER_BINARY(_backward_log_softmax)
+.set_attr<bool>("TIsElemwise", false, 11)
 .set_attr_parser(ParamParser<SoftmaxParam>)
 .set_attr<FCompute>("FCompute<cpu>", SoftmaxGradCompute<cpu, mshadow_op::left,
                                                         mxnet_op::log_softmax_bwd>);
@@ -95,7 +95,7 @@ class NNPACKConvolutionOp : public ConvolutionOp<xpu, DType> {
       wmat.dptr_,                   // const float kernel[],
       bias.dptr_,                   // const float bias[],
       out.dptr_,                    // float output[],
-      nnpackinitialize.threadpool,  // pthreadpool_t threadpool,
+      nnpackinitialize.threadpool(),  // pthreadpool_t threadpool,
       nullptr);
     } else {
       status = nnp_convolution_output(
@@ -110,7 +110,7 @@ class NNPACKConvolutionOp : public ConvolutionOp<xpu, DType> {
       wmat.dptr_,                   // const float kernel[],
       bias.dptr_,                   // const float bias[],
       out.dptr_,                    // float output[],
-      nnpackinitialize.threadpool,  // pthreadpool_t threadpool,
+      nnpackinitialize.threadpool(),  // pthreadpool_t threadpool,
       nullptr);
     }
     if (nnp_status_success != status) {
@@ -81,7 +81,7 @@ class NNPACKFullyConnectedOp : public FullyConnectedOp<xpu, DType> {
       data.dptr_,                    // const float input[],
       wmat.dptr_,                    // const float kernel[],
       out.dptr_,                     // float output[],
-      nnpackinitialize.threadpool);  // pthreadpool_t threadpool,
+      nnpackinitialize.threadpool());  // pthreadpool_t threadpool,
     } else {
       status = nnp_fully_connected_output(
       batch_size,                    // size_t batch size of input tensor
@@ -90,7 +90,7 @@ class NNPACKFullyConnectedOp : public FullyConnectedOp<xpu, DType> {
       data.dptr_,                    // const float input[],
       wmat.dptr_,                    // const float kernel[],
       out.dptr_,                     // float output[],
-      nnpackinitialize.threadpool,   // pthreadpool_t threadpool,
+      nnpackinitialize.threadpool(),   // pthreadpool_t threadpool,
       nullptr);
     }
     if (nnp_status_success != status) {
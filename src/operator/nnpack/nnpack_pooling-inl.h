@@ -79,7 +79,7 @@ class NNPACKPoolingOp : public PoolingOp<xpu, DType> {
       output_subsampling,            // struct nnp_size output_subsampling,
       data.dptr_,                    // const float input[],
       out.dptr_,                     // float output[],
-      nnpackinitialize.threadpool);  // pthreadpool_t threadpool,
+      nnpackinitialize.threadpool());  // pthreadpool_t threadpool,
     if (nnp_status_success != status) {
       LOG(FATAL) << "nnpack max pooling feedforward failed status=" << status;
     }
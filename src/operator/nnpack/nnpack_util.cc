@@ -24,6 +24,7 @@
 */
 
 #if MXNET_USE_NNPACK == 1
+#include <dmlc/omp.h>
 #include "nnpack_util.h"
 
 namespace mxnet {
@@ -31,6 +32,31 @@ namespace op {
 
 NNPACKInitialize nnpackinitialize;
 
+pthreadpool_t NNPACKInitialize::threadpool() const {
+  // a pool per engine worker, so that the workers do not contend for the
+  // threads of one pool nor run more threads than their share of the cores
+  struct LocalPool {
+    pthreadpool_t pool = nullptr;
+    int size = 0;
+    ~LocalPool() {
+      if (pool != nullptr) pthreadpool_destroy(pool);
+    }
+  };
+  static thread_local LocalPool local;
+#ifdef _OPENMP
+  const int size = num_threads_ > 0 ? num_threads_ : omp_get_max_threads();
+#else
+  // without OpenMP the workers have no team size to follow
+  const int size = num_threads_ > 0 ? num_threads_ : 4;
+#endif
+  if (size != local.size) {
+    if (local.pool != nullptr) pthreadpool_destroy(local.pool);
+    local.pool = size > 1 ? pthreadpool_create(size) : nullptr;
+    local.size = size;
+  }
+  return local.pool;
+}
+
 }  // namespace op
 }  // namespace mxnet
 #endif  // MXNET_USE_NNPACK
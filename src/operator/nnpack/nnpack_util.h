@@ -33,25 +33,30 @@ namespace mxnet {
 namespace op {
 
 class NNPACKInitialize {
- public:
-  pthreadpool_t threadpool;
-
  public:
   NNPACKInitialize() {
     nnp_status status = nnp_initialize();
     if (nnp_status_success != status) {
       LOG(FATAL) << "nnp_initialize failed status=" << status;
     }
-    int num_threads = dmlc::GetEnv("MXNET_CPU_NNPACK_NTHREADS", 4);
-    this->threadpool = pthreadpool_create(num_threads);
+    num_threads_ = dmlc::GetEnv("MXNET_CPU_NNPACK_NTHREADS", 0);
   }
   virtual ~NNPACKInitialize() {
     nnp_status status = nnp_deinitialize();
     if (nnp_status_success != status) {
       LOG(FATAL) << "nnp_deinitialize failed status=" << status;
     }
-    pthreadpool_destroy(threadpool);
   }
+  /*!
+   * \brief the thread pool of the calling thread, with MXNET_CPU_NNPACK_NTHREADS
+   *  threads or else the OpenMP team size of the thread, which the engine sets
+   *  to the share of the thread. nullptr runs on the calling thread alone.
+   */
+  pthreadpool_t threadpool() const;
+
+ private:
+  /*! \brief threads of each pool, 0 to follow the OpenMP team size */
+  int num_threads_;
 };
 
 // nnpackinitialize will be used in all other nnpack op
@@ -31,6 +31,11 @@
 #include <mshadow/base.h>
 #include <nnvm/op.h>
 #include <nnvm/op_attr_types.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <string>
+#include <type_traits>
 #include <vector>
 #include "./operator_common.h"
 #include "./mshadow_op.h"
@@ -348,6 +353,50 @@ inline void AdamUpdate(const nnvm::NodeAttrs& attrs,
   });
 }
 
+struct MP_AdamKernel {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out_data, float* mean_data, float* var_data,
+    const DType* grad_data, float* weight32, const float param_clip_gradient,
+    const float param_beta1, const float param_beta2, const float param_lr,
+    const float param_wd, const float param_epsilon, const float param_rescale_grad,
+    const OpReqType req) {
+    float w = weight32[i];
+    float g = param_rescale_grad*static_cast<float>(grad_data[i]) + param_wd*w;
+    if (param_clip_gradient >= 0.0f) {
+      g = mshadow_op::clip::Map(g, param_clip_gradient);
+    }
+    const float mean = param_beta1*mean_data[i] + (1.f-param_beta1)*g;
+    const float var = param_beta2*var_data[i] + (1.f-param_beta2)*g*g;
+    mean_data[i] = mean;
+    var_data[i] = var;
+    w = w - param_lr*mean/(sqrtf(var) + param_epsilon);
+    weight32[i] = w;
+    KERNEL_ASSIGN(out_data[i], req, (DType)w);
+  }
+};
+
+template<typename xpu>
+inline void MP_AdamUpdate(const nnvm::NodeAttrs& attrs,
+                          const OpContext &ctx,
+                          const std::vector<TBlob> &inputs,
+                          const std::vector<OpReqType> &req,
+                          const std::vector<TBlob> &outputs) {
+  using namespace mxnet_op;
+  const AdamParam& param = nnvm::get<AdamParam>(attrs.parsed);
+  Stream<xpu>* s = ctx.get_stream<xpu>();
+  MSHADOW_REAL_TYPE_SWITCH(inputs[0].type_flag_, DType, {
+    Tensor<xpu, 2, DType> weight = inputs[0].FlatTo2D<xpu, DType>(s);
+    Tensor<xpu, 2, DType> grad = inputs[1].FlatTo2D<xpu, DType>(s);
+    Tensor<xpu, 2, float> mean = inputs[2].FlatTo2D<xpu, float>(s);
+    Tensor<xpu, 2, float> var = inputs[3].FlatTo2D<xpu, float>(s);
+    Tensor<xpu, 2, float> weight32 = inputs[4].FlatTo2D<xpu, float>(s);
+    Tensor<xpu, 2, DType> out = outputs[0].FlatTo2D<xpu, DType>(s);
+    Kernel<MP_AdamKernel, xpu>::Launch(s, weight.shape_.Size(), out.dptr_, mean.dptr_,
+      var.dptr_, grad.dptr_, weight32.dptr_, param.clip_gradient, param.beta1, param.beta2,
+      param.lr, param.wd, param.epsilon, param.rescale_grad, req[0]);
+  });
+}
+
 // This RMSProp code follows the version in
 // http://arxiv.org/pdf/1308.0850v5.pdf Eq(38) - Eq(45)
 // by Alex Graves, 2013.
@@ -443,6 +492,58 @@ inline void RMSPropAlexUpdate(const nnvm::NodeAttrs &attrs,
   });
 }
 
+struct MP_RMSPropAlexKernel {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out_data, float* state_n_data,
+    float* state_g_data, float* delta_data, const DType* grad_data, float* weight32,
+    const float param_clip_gradient, const float param_gamma1, const float param_gamma2,
+    const float param_lr, const float param_wd, const float param_epsilon,
+    const float param_rescale_grad, const float param_clip_weights, const OpReqType req) {
+    float w = weight32[i];
+    float g = param_rescale_grad*static_cast<float>(grad_data[i]) + param_wd*w;
+    if (param_clip_gradient >= 0.0f) {
+      g = mshadow_op::clip::Map(g, param_clip_gradient);
+    }
+    const float state_n = (1.f-param_gamma1)*g*g + param_gamma1*state_n_data[i];
+    const float state_g = (1.f-param_gamma1)*g + param_gamma1*state_g_data[i];
+    const float delta = param_gamma2*delta_data[i] -
+        param_lr*(g/sqrtf(state_n - state_g*state_g + param_epsilon));
+    state_n_data[i] = state_n;
+    state_g_data[i] = state_g;
+    delta_data[i] = delta;
+    w = w + delta;
+    if (param_clip_weights >= 0.0f) {
+      w = mshadow_op::clip::Map(w, param_clip_weights);
+    }
+    weight32[i] = w;
+    KERNEL_ASSIGN(out_data[i], req, (DType)w);
+  }
+};
+
+template <typename xpu>
+inline void MP_RMSPropAlexUpdate(const nnvm::NodeAttrs &attrs,
+                                 const OpContext &ctx,
+                                 const std::vector<TBlob> &inputs,
+                                 const std::vector<OpReqType> &req,
+                                 const std::vector<TBlob> &outputs) {
+  using namespace mxnet_op;
+  const RMSPropAlexParam &param = nnvm::get<RMSPropAlexParam>(attrs.parsed);
+  Stream<xpu> *s = ctx.get_stream<xpu>();
+  MSHADOW_REAL_TYPE_SWITCH(inputs[0].type_flag_, DType, {
+    Tensor<xpu, 2, DType> weight = inputs[0].FlatTo2D<xpu, DType>(s);
+    Tensor<xpu, 2, DType> grad = inputs[1].FlatTo2D<xpu, DType>(s);
+    Tensor<xpu, 2, float> state_n = inputs[2].FlatTo2D<xpu, float>(s);
+    Tensor<xpu, 2, float> state_g = inputs[3].FlatTo2D<xpu, float>(s);
+    Tensor<xpu, 2, float> delta = inputs[4].FlatTo2D<xpu, float>(s);
+    Tensor<xpu, 2, float> weight32 = inputs[5].FlatTo2D<xpu, float>(s);
+    Tensor<xpu, 2, DType> out = outputs[0].FlatTo2D<xpu, DType>(s);
+    Kernel<MP_RMSPropAlexKernel, xpu>::Launch(s, weight.shape_.Size(), out.dptr_,
+      state_n.dptr_, state_g.dptr_, delta.dptr_, grad.dptr_, weight32.dptr_,
+      param.clip_gradient, param.gamma1, param.gamma2, param.lr, param.wd, param.epsilon,
+      param.rescale_grad, param.clip_weights, req[0]);
+  });
+}
+
 // This RMSProp code follows the version in
 // http://www.cs.toronto.edu/~tijmen/csc321/slides/lecture_slides_lec6.pdf
 // by Tieleman & Hinton, 2012
@@ -542,6 +643,803 @@ inline void RMSPropUpdate(const nnvm::NodeAttrs &attrs, const OpContext &ctx,
   });
 }
 
+struct MP_RMSPropKernel {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out_data, float* state_n_data,
+    const DType* grad_data, float* weight32, const float param_clip_gradient,
+    const float param_gamma1, const float param_lr, const float param_wd,
+    const float param_epsilon, const float param_rescale_grad,
+    const float param_clip_weights, const OpReqType req) {
+    float w = weight32[i];
+    float g = param_rescale_grad*static_cast<float>(grad_data[i]) + param_wd*w;
+    if (param_clip_gradient >= 0.0f) {
+      g = mshadow_op::clip::Map(g, param_clip_gradient);
+    }
+    const float state_n = (1.f-param_gamma1)*g*g + param_gamma1*state_n_data[i];
+    state_n_data[i] = state_n;
+    w = w - param_lr*(g/sqrtf(state_n + param_epsilon));
+    if (param_clip_weights >= 0.0f) {
+      w = mshadow_op::clip::Map(w, param_clip_weights);
+    }
+    weight32[i] = w;
+    KERNEL_ASSIGN(out_data[i], req, (DType)w);
+  }
+};
+
+template <typename xpu>
+inline void MP_RMSPropUpdate(const nnvm::NodeAttrs &attrs, const OpContext &ctx,
+                             const std::vector<TBlob> &inputs,
+                             const std::vector<OpReqType> &req,
+                             const std::vector<TBlob> &outputs) {
+  using namespace mxnet_op;
+  const RMSPropParam &param = nnvm::get<RMSPropParam>(attrs.parsed);
+  Stream<xpu> *s = ctx.get_stream<xpu>();
+  MSHADOW_REAL_TYPE_SWITCH(inputs[0].type_flag_, DType, {
+    Tensor<xpu, 2, DType> weight = inputs[0].FlatTo2D<xpu, DType>(s);
+    Tensor<xpu, 2, DType> grad = inputs[1].FlatTo2D<xpu, DType>(s);
+    Tensor<xpu, 2, float> state_n = inputs[2].FlatTo2D<xpu, float>(s);
+    Tensor<xpu, 2, float> weight32 = inputs[3].FlatTo2D<xpu, float>(s);
+    Tensor<xpu, 2, DType> out = outputs[0].FlatTo2D<xpu, DType>(s);
+    Kernel<MP_RMSPropKernel, xpu>::Launch(s, weight.shape_.Size(), out.dptr_,
+      state_n.dptr_, grad.dptr_, weight32.dptr_, param.clip_gradient, param.gamma1,
+      param.lr, param.wd, param.epsilon, param.rescale_grad, param.clip_weights, req[0]);
+  });
+}
+
+struct MultiSGDParam : public dmlc::Parameter<MultiSGDParam> {
+  nnvm::Tuple<float> lrs;
+  nnvm::Tuple<float> wds;
+  float rescale_grad;
+  float clip_gradient;
+  int num_weights;
+  DMLC_DECLARE_PARAMETER(MultiSGDParam) {
+    DMLC_DECLARE_FIELD(lrs)
+    .describe("Learning rates of the weights.");
+    DMLC_DECLARE_FIELD(wds)
+    .describe("Weight decays of the weights.");
+    DMLC_DECLARE_FIELD(rescale_grad)
+    .set_default(1.0f)
+    .describe("Rescale gradient to grad = rescale_grad*grad.");
+    DMLC_DECLARE_FIELD(clip_gradient)
+    .set_default(-1.0f)
+    .describe("Clip gradient to the range of [-clip_gradient, clip_gradient] "
+              "If clip_gradient <= 0, gradient clipping is turned off. "
+              "grad = max(min(grad, clip_gradient), -clip_gradient).");
+    DMLC_DECLARE_FIELD(num_weights)
+    .set_default(1)
+    .set_lower_bound(1)
+    .describe("Number of updated weights.");
+  }
+};
+
+struct MultiSGDMomParam : public dmlc::Parameter<MultiSGDMomParam> {
+  nnvm::Tuple<float> lrs;
+  nnvm::Tuple<float> wds;
+  float momentum;
+  float rescale_grad;
+  float clip_gradient;
+  int num_weights;
+  DMLC_DECLARE_PARAMETER(MultiSGDMomParam) {
+    DMLC_DECLARE_FIELD(lrs)
+    .describe("Learning rates of the weights.");
+    DMLC_DECLARE_FIELD(wds)
+    .describe("Weight decays of the weights.");
+    DMLC_DECLARE_FIELD(momentum)
+    .set_default(0.0f)
+    .describe("The decay rate of momentum estimates at each epoch.");
+    DMLC_DECLARE_FIELD(rescale_grad)
+    .set_default(1.0f)
+    .describe("Rescale gradient to grad = rescale_grad*grad.");
+    DMLC_DECLARE_FIELD(clip_gradient)
+    .set_default(-1.0f)
+    .describe("Clip gradient to the range of [-clip_gradient, clip_gradient] "
+              "If clip_gradient <= 0, gradient clipping is turned off. "
+              "grad = max(min(grad, clip_gradient), -clip_gradient).");
+    DMLC_DECLARE_FIELD(num_weights)
+    .set_default(1)
+    .set_lower_bound(1)
+    .describe("Number of updated weights.");
+  }
+};
+
+struct MultiAdamParam : public dmlc::Parameter<MultiAdamParam> {
+  nnvm::Tuple<float> lrs;
+  nnvm::Tuple<float> wds;
+  float beta1;
+  float beta2;
+  float epsilon;
+  float rescale_grad;
+  float clip_gradient;
+  int num_weights;
+  DMLC_DECLARE_PARAMETER(MultiAdamParam) {
+    DMLC_DECLARE_FIELD(lrs)
+    .describe("Learning rates of the weights.");
+    DMLC_DECLARE_FIELD(wds)
+    .describe("Weight decays of the weights.");
+    DMLC_DECLARE_FIELD(beta1)
+    .set_default(0.9f)
+    .describe("The decay rate for the 1st moment estimates.");
+    DMLC_DECLARE_FIELD(beta2)
+    .set_default(0.999f)
+    .describe("The decay rate for the 2nd moment estimates.");
+    DMLC_DECLARE_FIELD(epsilon)
+    .set_default(1e-8f)
+    .describe("A small constant for numerical stability.");
+    DMLC_DECLARE_FIELD(rescale_grad)
+    .set_default(1.0f)
+    .describe("Rescale gradient to grad = rescale_grad*grad.");
+    DMLC_DECLARE_FIELD(clip_gradient)
+    .set_default(-1.0f)
+    .describe("Clip gradient to the range of [-clip_gradient, clip_gradient] "
+              "If clip_gradient <= 0, gradient clipping is turned off. "
+              "grad = max(min(grad, clip_gradient), -clip_gradient).");
+    DMLC_DECLARE_FIELD(num_weights)
+    .set_default(1)
+    .set_lower_bound(1)
+    .describe("Number of updated weights.");
+  }
+};
+
+/*! \brief the update of sgd_update, on one value */
+struct MultiSGDRule {
+  static const int kNumStates = 0;
+  float rescale_grad;
+  float clip_gradient;
+  template<typename AType>
+  MSHADOW_XINLINE void operator()(AType* w, AType* state, const AType grad,
+                                  const float lr, const float wd) const {
+    AType g = AType(rescale_grad) * grad;
+    if (clip_gradient >= 0.0f) g = mshadow_op::clip::Map(g, AType(clip_gradient));
+    *w = AType(1.f - lr * wd) * *w - AType(lr) * g;
+  }
+};
+
+/*! \brief the update of sgd_mom_update, the state is the momentum */
+struct MultiSGDMomRule {
+  static const int kNumStates = 1;
+  float momentum;
+  float rescale_grad;
+  float clip_gradient;
+  template<typename AType>
+  MSHADOW_XINLINE void operator()(AType* w, AType* state, const AType grad,
+                                  const float lr, const float wd) const {
+    AType g = AType(rescale_grad) * grad;
+    if (clip_gradient >= 0.0f) g = mshadow_op::clip::Map(g, AType(clip_gradient));
+    state[0] = AType(momentum) * state[0] - AType(lr * wd) * *w - AType(lr) * g;
+    *w += state[0];
+  }
+};
+
+/*! \brief the update of adam_update, the states are the mean and the variance */
+struct MultiAdamRule {
+  static const int kNumStates = 2;
+  float beta1;
+  float beta2;
+  float epsilon;
+  float rescale_grad;
+  float clip_gradient;
+  template<typename AType>
+  MSHADOW_XINLINE void operator()(AType* w, AType* state, const AType grad,
+                                  const float lr, const float wd) const {
+    AType g = AType(rescale_grad) * grad + AType(wd) * *w;
+    if (clip_gradient >= 0.0f) g = mshadow_op::clip::Map(g, AType(clip_gradient));
+    state[0] = AType(beta1) * state[0] + AType(1.f - beta1) * g;
+    state[1] = AType(beta2) * state[1] + AType(1.f - beta2) * g * g;
+    *w -= AType(lr) * state[0] / (mshadow_op::square_root::Map(state[1]) + AType(epsilon));
+  }
+};
+
+/*!
+ * \brief the most weights a launch of a multi-tensor update takes, so that
+ *  its arguments fit in the parameter space of a cuda kernel
+ */
+const int kMultiUpdateMaxWeights = 32;
+
+/*!
+ * \brief the weights of a launch of a multi-tensor update, whose values are
+ *  indexed one after the other from offset[j] for the j-th weight. The
+ *  states are of SType, with the float32 copy of the weight last for mp
+ */
+template<typename DType, typename SType, int kNumStates>
+struct MultiUpdateArgs {
+  int count;
+  int offset[kMultiUpdateMaxWeights + 1];
+  DType* out[kMultiUpdateMaxWeights];
+  const DType* weight[kMultiUpdateMaxWeights];
+  const DType* grad[kMultiUpdateMaxWeights];
+  SType* state[kNumStates > 0 ? kNumStates : 1][kMultiUpdateMaxWeights];
+  float lr[kMultiUpdateMaxWeights];
+  float wd[kMultiUpdateMaxWeights];
+  OpReqType req[kMultiUpdateMaxWeights];
+};
+
+/*! \brief the last of the count weights whose values start at or before i */
+MSHADOW_XINLINE int MultiUpdateWeightOf(const int* offset, const int count, const int i) {
+  int j = 0;
+  int hi = count - 1;
+  while (j < hi) {
+    const int mid = (j + hi + 1) >> 1;
+    if (offset[mid] <= i) {
+      j = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return j;
+}
+
+/*!
+ * \brief updates the values of all the weights of args in one launch. The
+ *  update is computed in float, or double for double weights, and from the
+ *  float32 copy of the weight for mp
+ */
+template<typename Rule, bool mp>
+struct MultiUpdateKernel {
+  template<typename DType, typename SType, int kNumStates>
+  MSHADOW_XINLINE static void Map(int i, const MultiUpdateArgs<DType, SType, kNumStates>& args,
+                                  const Rule rule) {
+    typedef typename std::conditional<std::is_same<DType, double>::value,
+                                      double, float>::type AType;
+    const int j = MultiUpdateWeightOf(args.offset, args.count, i);
+    const int k = i - args.offset[j];
+    const int w32 = kNumStates > 0 ? kNumStates - 1 : 0;
+    AType w = mp ? AType(args.state[w32][j][k]) : AType(args.weight[j][k]);
+    AType state[Rule::kNumStates > 0 ? Rule::kNumStates : 1];
+    for (int s = 0; s < Rule::kNumStates; ++s) state[s] = AType(args.state[s][j][k]);
+    rule(&w, state, AType(args.grad[j][k]), args.lr[j], args.wd[j]);
+    for (int s = 0; s < Rule::kNumStates; ++s) args.state[s][j][k] = SType(state[s]);
+    if (mp) args.state[w32][j][k] = SType(w);
+    KERNEL_ASSIGN(args.out[j][k], args.req[j], DType(w));
+  }
+};
+
+/*!
+ * \brief updates the weights of inputs, given as [weight, grad, states...]
+ *  for each weight, with one kernel launch per kMultiUpdateMaxWeights weights
+ */
+template<typename xpu, typename Rule, bool mp>
+inline void MultiUpdate(const OpContext &ctx, const std::vector<TBlob> &inputs,
+                        const std::vector<OpReqType> &req, const std::vector<TBlob> &outputs,
+                        const nnvm::Tuple<float>& lrs, const nnvm::Tuple<float>& wds,
+                        const Rule& rule) {
+  using namespace mxnet_op;
+  const int kNumStates = Rule::kNumStates + (mp ? 1 : 0);
+  const int group = 2 + kNumStates;
+  const int num_weights = outputs.size();
+  CHECK_EQ(inputs.size(), static_cast<size_t>(num_weights * group));
+  CHECK_EQ(lrs.ndim(), static_cast<index_t>(num_weights)) << "one lr per weight is needed";
+  CHECK_EQ(wds.ndim(), static_cast<index_t>(num_weights)) << "one wd per weight is needed";
+  Stream<xpu>* s = ctx.get_stream<xpu>();
+  MSHADOW_REAL_TYPE_SWITCH(inputs[0].type_flag_, DType, {
+    typedef typename std::conditional<mp, float, DType>::type SType;
+    MultiUpdateArgs<DType, SType, kNumStates> args;
+    args.count = 0;
+    args.offset[0] = 0;
+    for (int n = 0; n < num_weights; ++n) {
+      const int64_t size = inputs[n * group].Size();
+      CHECK_LE(size, INT_MAX) << "a weight of the multi-tensor update is too large";
+      if (args.count > 0 && args.offset[args.count] + size > INT_MAX) {
+        Kernel<MultiUpdateKernel<Rule, mp>, xpu>::Launch(s, args.offset[args.count], args, rule);
+        args.count = 0;
+      }
+      const int j = args.count;
+      args.weight[j] = inputs[n * group].dptr<DType>();
+      args.grad[j] = inputs[n * group + 1].dptr<DType>();
+      for (int k = 0; k < kNumStates; ++k) {
+        args.state[k][j] = inputs[n * group + 2 + k].dptr<SType>();
+      }
+      args.out[j] = outputs[n].dptr<DType>();
+      args.lr[j] = lrs[n];
+      args.wd[j] = wds[n];
+      args.req[j] = req[n];
+      args.offset[j + 1] = args.offset[j] + static_cast<int>(size);
+      args.count = j + 1;
+      if (args.count == kMultiUpdateMaxWeights || n == num_weights - 1) {
+        if (args.offset[args.count] > 0) {
+          Kernel<MultiUpdateKernel<Rule, mp>, xpu>::Launch(s, args.offset[args.count], args, rule);
+        }
+        args.count = 0;
+      }
+    }
+  });
+}
+
+/*! \brief each weight shares its shape with its gradient, states and output */
+template<int num_states>
+inline bool MultiUpdateShape(const nnvm::NodeAttrs& attrs,
+                             std::vector<TShape> *in_attrs,
+                             std::vector<TShape> *out_attrs) {
+  const size_t group = 2 + num_states;
+  CHECK_EQ(in_attrs->size(), out_attrs->size() * group) << " in operator " << attrs.name;
+  bool known = true;
+  for (size_t n = 0; n < out_attrs->size(); ++n) {
+    TShape shape = (*out_attrs)[n];
+    for (size_t k = 0; k < group; ++k) {
+      if (shape.ndim() == 0) shape = (*in_attrs)[n * group + k];
+    }
+    for (size_t k = 0; k < group; ++k) SHAPE_ASSIGN_CHECK(*in_attrs, n * group + k, shape);
+    SHAPE_ASSIGN_CHECK(*out_attrs, n, shape);
+    known = known && shape.ndim() != 0;
+  }
+  return known;
+}
+
+/*!
+ * \brief each weight shares its type with its gradient and output, and with
+ *  its states unless mp, where the states are float32
+ */
+template<int num_states, bool mp>
+inline bool MultiUpdateType(const nnvm::NodeAttrs& attrs,
+                            std::vector<int> *in_attrs,
+                            std::vector<int> *out_attrs) {
+  const size_t group = 2 + num_states;
+  const size_t typed = mp ? 2 : group;
+  CHECK_EQ(in_attrs->size(), out_attrs->size() * group) << " in operator " << attrs.name;
+  bool known = true;
+  for (size_t n = 0; n < out_attrs->size(); ++n) {
+    int dtype = (*out_attrs)[n];
+    for (size_t k = 0; k < typed; ++k) {
+      if (dtype == -1) dtype = (*in_attrs)[n * group + k];
+    }
+    for (size_t k = 0; k < typed; ++k) TYPE_ASSIGN_CHECK(*in_attrs, n * group + k, dtype);
+    TYPE_ASSIGN_CHECK(*out_attrs, n, dtype);
+    for (size_t k = typed; k < group; ++k) {
+      TYPE_ASSIGN_CHECK(*in_attrs, n * group + k, mshadow::kFloat32);
+    }
+    known = known && dtype != -1;
+  }
+  return known;
+}
+
+template<typename xpu>
+inline void MultiSGDUpdate(const nnvm::NodeAttrs& attrs,
+                           const OpContext &ctx,
+                           const std::vector<TBlob> &inputs,
+                           const std::vector<OpReqType> &req,
+                           const std::vector<TBlob> &outputs) {
+  const MultiSGDParam& param = nnvm::get<MultiSGDParam>(attrs.parsed);
+  const MultiSGDRule rule = {param.rescale_grad, param.clip_gradient};
+  MultiUpdate<xpu, MultiSGDRule, false>(ctx, inputs, req, outputs, param.lrs, param.wds, rule);
+}
+
+template<typename xpu>
+inline void MultiMPSGDUpdate(const nnvm::NodeAttrs& attrs,
+                             const OpContext &ctx,
+                             const std::vector<TBlob> &inputs,
+                             const std::vector<OpReqType> &req,
+                             const std::vector<TBlob> &outputs) {
+  const MultiSGDParam& param = nnvm::get<MultiSGDParam>(attrs.parsed);
+  const MultiSGDRule rule = {param.rescale_grad, param.clip_gradient};
+  MultiUpdate<xpu, MultiSGDRule, true>(ctx, inputs, req, outputs, param.lrs, param.wds, rule);
+}
+
+template<typename xpu>
+inline void MultiSGDMomUpdate(const nnvm::NodeAttrs& attrs,
+                              const OpContext &ctx,
+                              const std::vector<TBlob> &inputs,
+                              const std::vector<OpReqType> &req,
+                              const std::vector<TBlob> &outputs) {
+  const MultiSGDMomParam& param = nnvm::get<MultiSGDMomParam>(attrs.parsed);
+  const MultiSGDMomRule rule = {param.momentum, param.rescale_grad, param.clip_gradient};
+  MultiUpdate<xpu, MultiSGDMomRule, false>(ctx, inputs, req, outputs,
+                                           param.lrs, param.wds, rule);
+}
+
+template<typename xpu>
+inline void MultiMPSGDMomUpdate(const nnvm::NodeAttrs& attrs,
+                                const OpContext &ctx,
+                                const std::vector<TBlob> &inputs,
+                                const std::vector<OpReqType> &req,
+                                const std::vector<TBlob> &outputs) {
+  const MultiSGDMomParam& param = nnvm::get<MultiSGDMomParam>(attrs.parsed);
+  const MultiSGDMomRule rule = {param.momentum, param.rescale_grad, param.clip_gradient};
+  MultiUpdate<xpu, MultiSGDMomRule, true>(ctx, inputs, req, outputs,
+                                          param.lrs, param.wds, rule);
+}
+
+template<typename xpu>
+inline void MultiAdamUpdate(const nnvm::NodeAttrs& attrs,
+                            const OpContext &ctx,
+                            const std::vector<TBlob> &inputs,
+                            const std::vector<OpReqType> &req,
+                            const std::vector<TBlob> &outputs) {
+  const MultiAdamParam& param = nnvm::get<MultiAdamParam>(attrs.parsed);
+  const MultiAdamRule rule = {param.beta1, param.beta2, param.epsilon,
+                              param.rescale_grad, param.clip_gradient};
+  MultiUpdate<xpu, MultiAdamRule, false>(ctx, inputs, req, outputs, param.lrs, param.wds, rule);
+}
+
+struct MultiLARSParam : public dmlc::Parameter<MultiLARSParam> {
+  nnvm::Tuple<float> lrs;
+  nnvm::Tuple<float> wds;
+  float eta;
+  float momentum;
+  float epsilon;
+  float rescale_grad;
+  float clip_gradient;
+  int num_weights;
+  DMLC_DECLARE_PARAMETER(MultiLARSParam) {
+    DMLC_DECLARE_FIELD(lrs)
+    .describe("Learning rates of the weights.");
+    DMLC_DECLARE_FIELD(wds)
+    .describe("Weight decays of the weights.");
+    DMLC_DECLARE_FIELD(eta)
+    .set_default(0.001f)
+    .describe("The trust coefficient of the layer-wise learning rates.");
+    DMLC_DECLARE_FIELD(momentum)
+    .set_default(0.0f)
+    .describe("The decay rate of momentum estimates at each epoch.");
+    DMLC_DECLARE_FIELD(epsilon)
+    .set_default(1e-8f)
+    .describe("A small constant for numerical stability.");
+    DMLC_DECLARE_FIELD(rescale_grad)
+    .set_default(1.0f)
+    .describe("Rescale gradient to grad = rescale_grad*grad.");
+    DMLC_DECLARE_FIELD(clip_gradient)
+    .set_default(-1.0f)
+    .describe("Clip gradient to the range of [-clip_gradient, clip_gradient] "
+              "If clip_gradient <= 0, gradient clipping is turned off. "
+              "grad = max(min(grad, clip_gradient), -clip_gradient).");
+    DMLC_DECLARE_FIELD(num_weights)
+    .set_default(1)
+    .set_lower_bound(1)
+    .describe("Number of updated weights.");
+  }
+};
+
+struct MultiLAMBParam : public dmlc::Parameter<MultiLAMBParam> {
+  nnvm::Tuple<float> lrs;
+  nnvm::Tuple<float> wds;
+  nnvm::Tuple<int> steps;
+  float beta1;
+  float beta2;
+  float epsilon;
+  bool bias_correction;
+  float rescale_grad;
+  float clip_gradient;
+  int num_weights;
+  DMLC_DECLARE_PARAMETER(MultiLAMBParam) {
+    DMLC_DECLARE_FIELD(lrs)
+    .describe("Learning rates of the weights.");
+    DMLC_DECLARE_FIELD(wds)
+    .describe("Weight decays of the weights.");
+    DMLC_DECLARE_FIELD(steps)
+    .set_default(nnvm::Tuple<int>())
+    .describe("The number of the update of each weight, counting from 1, for the bias "
+              "correction.");
+    DMLC_DECLARE_FIELD(beta1)
+    .set_default(0.9f)
+    .describe("The decay rate for the 1st moment estimates.");
+    DMLC_DECLARE_FIELD(beta2)
+    .set_default(0.999f)
+    .describe("The decay rate for the 2nd moment estimates.");
+    DMLC_DECLARE_FIELD(epsilon)
+    .set_default(1e-6f)
+    .describe("A small constant for numerical stability.");
+    DMLC_DECLARE_FIELD(bias_correction)
+    .set_default(true)
+    .describe("Whether the moment estimates are divided by 1 - beta^step.");
+    DMLC_DECLARE_FIELD(rescale_grad)
+    .set_default(1.0f)
+    .describe("Rescale gradient to grad = rescale_grad*grad.");
+    DMLC_DECLARE_FIELD(clip_gradient)
+    .set_default(-1.0f)
+    .describe("Clip gradient to the range of [-clip_gradient, clip_gradient] "
+              "If clip_gradient <= 0, gradient clipping is turned off. "
+              "grad = max(min(grad, clip_gradient), -clip_gradient).");
+    DMLC_DECLARE_FIELD(num_weights)
+    .set_default(1)
+    .set_lower_bound(1)
+    .describe("Number of updated weights.");
+  }
+};
+
+/*!
+ * \brief the layer-wise update of LARS, momentum sgd whose lr is scaled by
+ *  eta * |w| / (|g| + wd * |w|) for each weight. The state is the momentum
+ */
+struct MultiLARSRule {
+  static const int kNumStates = 1;
+  /*! \brief whether the states are updated by the norm pass or by the apply pass */
+  static const bool kStatesInNorm = false;
+  float eta;
+  float momentum;
+  float epsilon;
+  float rescale_grad;
+  float clip_gradient;
+  template<typename AType>
+  MSHADOW_XINLINE AType Grad(const AType grad) const {
+    AType g = AType(rescale_grad) * grad;
+    if (clip_gradient >= 0.0f) g = mshadow_op::clip::Map(g, AType(clip_gradient));
+    return g;
+  }
+  /*! \brief the value whose norm, with the one of the weight, scales the lr */
+  template<typename AType>
+  MSHADOW_XINLINE AType Direction(const AType w, AType* state, const AType grad,
+                                  const float wd, const float c1, const float c2) const {
+    return Grad(grad);
+  }
+  template<typename AType>
+  MSHADOW_XINLINE AType Rate(const AType w_norm, const AType d_norm, const float lr,
+                             const float wd) const {
+    if (w_norm > AType(0) && d_norm > AType(0)) {
+      return AType(lr * eta) * w_norm / (d_norm + AType(wd) * w_norm + AType(epsilon));
+    }
+    return AType(lr);
+  }
+  template<typename AType>
+  MSHADOW_XINLINE void Apply(AType* w, AType* state, const AType grad, const AType rate,
+                             const float wd, const float c1, const float c2) const {
+    state[0] = AType(momentum) * state[0] - rate * (Grad(grad) + AType(wd) * *w);
+    *w += state[0];
+  }
+};
+
+/*!
+ * \brief the layer-wise update of LAMB, adam whose step r, with the weight
+ *  decay, is scaled by |w| / |r| for each weight. The states are the mean and
+ *  the variance, and c1 and c2 the bias corrections of the step
+ */
+struct MultiLAMBRule {
+  static const int kNumStates = 2;
+  static const bool kStatesInNorm = true;
+  float beta1;
+  float beta2;
+  float epsilon;
+  float rescale_grad;
+  float clip_gradient;
+  template<typename AType>
+  MSHADOW_XINLINE AType Step(const AType w, const AType* state, const float wd,
+                             const float c1, const float c2) const {
+    return state[0] * AType(c1) /
+        (mshadow_op::square_root::Map(state[1] * AType(c2)) + AType(epsilon)) + AType(wd) * w;
+  }
+  template<typename AType>
+  MSHADOW_XINLINE AType Direction(const AType w, AType* state, const AType grad,
+                                  const float wd, const float c1, const float c2) const {
+    AType g = AType(rescale_grad) * grad;
+    if (clip_gradient >= 0.0f) g = mshadow_op::clip::Map(g, AType(clip_gradient));
+    state[0] = AType(beta1) * state[0] + AType(1.f - beta1) * g;
+    state[1] = AType(beta2) * state[1] + AType(1.f - beta2) * g * g;
+    return Step(w, state, wd, c1, c2);
+  }
+  template<typename AType>
+  MSHADOW_XINLINE AType Rate(const AType w_norm, const AType d_norm, const float lr,
+                             const float wd) const {
+    if (w_norm > AType(0) && d_norm > AType(0)) return AType(lr) * w_norm / d_norm;
+    return AType(lr);
+  }
+  template<typename AType>
+  MSHADOW_XINLINE void Apply(AType* w, AType* state, const AType grad, const AType rate,
+                             const float wd, const float c1, const float c2) const {
+    *w -= rate * Step(*w, state, wd, c1, c2);
+  }
+};
+
+/*! \brief the most values a thread of the norm pass of a layer-wise update sums */
+const int kLayerwiseNormChunk = 1024;
+
+/*!
+ * \brief the weights of a launch of a layer-wise update. The values of the
+ *  j-th weight are indexed from offset[j] as in MultiUpdateArgs, and its
+ *  partial sums of squares from part[j]. The values of a partial sum are
+ *  strided by the number of partial sums of the weight on gpu, so that the
+ *  threads read consecutive values, and consecutive on cpu
+ */
+template<typename DType, typename SType, int kNumStates>
+struct LayerwiseUpdateArgs {
+  int count;
+  bool strided;
+  int offset[kMultiUpdateMaxWeights + 1];
+  int part[kMultiUpdateMaxWeights + 1];
+  DType* out[kMultiUpdateMaxWeights];
+  const DType* weight[kMultiUpdateMaxWeights];
+  const DType* grad[kMultiUpdateMaxWeights];
+  SType* state[kNumStates > 0 ? kNumStates : 1][kMultiUpdateMaxWeights];
+  float lr[kMultiUpdateMaxWeights];
+  float wd[kMultiUpdateMaxWeights];
+  float c1[kMultiUpdateMaxWeights];
+  float c2[kMultiUpdateMaxWeights];
+  OpReqType req[kMultiUpdateMaxWeights];
+};
+
+/*!
+ * \brief the p-th partial sums of the squares of the weights and of their
+ *  directions, written to sums[2 * p] and sums[2 * p + 1]
+ */
+template<typename Rule, bool mp>
+struct LayerwiseNormKernel {
+  template<typename DType, typename SType, int kNumStates, typename AType>
+  MSHADOW_XINLINE static void Map(int p, const LayerwiseUpdateArgs<DType, SType, kNumStates>& args,
+                                  const Rule rule, AType* sums) {
+    const int j = MultiUpdateWeightOf(args.part, args.count, p);
+    const int q = p - args.part[j];
+    const int size = args.offset[j + 1] - args.offset[j];
+    const int stride = args.strided ? args.part[j + 1] - args.part[j] : 1;
+    const int begin = args.strided ? q : q * kLayerwiseNormChunk;
+    const int end = args.strided ? size :
+        (size - begin < kLayerwiseNormChunk ? size : begin + kLayerwiseNormChunk);
+    const int w32 = kNumStates > 0 ? kNumStates - 1 : 0;
+    AType w_sum = 0, d_sum = 0;
+    for (int k = begin; k < end; k += stride) {
+      const AType w = mp ? AType(args.state[w32][j][k]) : AType(args.weight[j][k]);
+      AType state[Rule::kNumStates > 0 ? Rule::kNumStates : 1];
+      for (int s = 0; s < Rule::kNumStates; ++s) state[s] = AType(args.state[s][j][k]);
+      const AType d = rule.Direction(w, state, AType(args.grad[j][k]), args.wd[j],
+                                     args.c1[j], args.c2[j]);
+      if (Rule::kStatesInNorm) {
+        for (int s = 0; s < Rule::kNumStates; ++s) args.state[s][j][k] = SType(state[s]);
+      }
+      w_sum += w * w;
+      d_sum += d * d;
+    }
+    sums[2 * p] = w_sum;
+    sums[2 * p + 1] = d_sum;
+  }
+};
+
+/*! \brief the lr of the j-th weight, from its partial sums */
+template<typename Rule>
+struct LayerwiseRateKernel {
+  template<typename DType, typename SType, int kNumStates, typename AType>
+  MSHADOW_XINLINE static void Map(int j, const LayerwiseUpdateArgs<DType, SType, kNumStates>& args,
+                                  const Rule rule, const AType* sums, AType* rates) {
+    AType w_sum = 0, d_sum = 0;
+    for (int p = args.part[j]; p < args.part[j + 1]; ++p) {
+      w_sum += sums[2 * p];
+      d_sum += sums[2 * p + 1];
+    }
+    rates[j] = rule.Rate(mshadow_op::square_root::Map(w_sum),
+                         mshadow_op::square_root::Map(d_sum), args.lr[j], args.wd[j]);
+  }
+};
+
+/*! \brief updates the i-th value of the weights with the lr of its weight */
+template<typename Rule, bool mp>
+struct LayerwiseApplyKernel {
+  template<typename DType, typename SType, int kNumStates, typename AType>
+  MSHADOW_XINLINE static void Map(int i, const LayerwiseUpdateArgs<DType, SType, kNumStates>& args,
+                                  const Rule rule, const AType* rates) {
+    const int j = MultiUpdateWeightOf(args.offset, args.count, i);
+    const int k = i - args.offset[j];
+    const int w32 = kNumStates > 0 ? kNumStates - 1 : 0;
+    AType w = mp ? AType(args.state[w32][j][k]) : AType(args.weight[j][k]);
+    AType state[Rule::kNumStates > 0 ? Rule::kNumStates : 1];
+    for (int s = 0; s < Rule::kNumStates; ++s) state[s] = AType(args.state[s][j][k]);
+    rule.Apply(&w, state, AType(args.grad[j][k]), rates[j], args.wd[j], args.c1[j], args.c2[j]);
+    if (!Rule::kStatesInNorm) {
+      for (int s = 0; s < Rule::kNumStates; ++s) args.state[s][j][k] = SType(state[s]);
+    }
+    if (mp) args.state[w32][j][k] = SType(w);
+    KERNEL_ASSIGN(args.out[j][k], args.req[j], DType(w));
+  }
+};
+
+/*!
+ * \brief updates the weights of inputs, given as [weight, grad, states...]
+ *  for each weight, with a lr scaled by the norms of each weight. Every
+ *  kMultiUpdateMaxWeights weights take three launches: the partial sums of
+ *  squares, the lrs of the weights and the update. c1 and c2 are passed to
+ *  the rule for each weight
+ */
+template<typename xpu, typename Rule, bool mp>
+inline void LayerwiseUpdate(const OpContext &ctx, const std::vector<TBlob> &inputs,
+                            const std::vector<OpReqType> &req,
+                            const std::vector<TBlob> &outputs,
+                            const nnvm::Tuple<float>& lrs, const nnvm::Tuple<float>& wds,
+                            const std::vector<float>& c1, const std::vector<float>& c2,
+                            const Rule& rule) {
+  using namespace mxnet_op;
+  const int kNumStates = Rule::kNumStates + (mp ? 1 : 0);
+  const int group = 2 + kNumStates;
+  const int num_weights = outputs.size();
+  CHECK_EQ(inputs.size(), static_cast<size_t>(num_weights * group));
+  CHECK_EQ(lrs.ndim(), static_cast<index_t>(num_weights)) << "one lr per weight is needed";
+  CHECK_EQ(wds.ndim(), static_cast<index_t>(num_weights)) << "one wd per weight is needed";
+  Stream<xpu>* s = ctx.get_stream<xpu>();
+  MSHADOW_REAL_TYPE_SWITCH(inputs[0].type_flag_, DType, {
+    typedef typename std::conditional<mp, float, DType>::type SType;
+    typedef typename std::conditional<std::is_same<DType, double>::value,
+                                      double, float>::type AType;
+    // the launches run in turn on the stream, so they share the workspace
+    // of the largest one
+    size_t max_parts = 0, parts = 0;
+    int64_t values = 0;
+    for (int n = 0, j = 0; n < num_weights; ++n) {
+      const int64_t size = inputs[n * group].Size();
+      CHECK_LE(size, INT_MAX) << "a weight of the layer-wise update is too large";
+      if (j == kMultiUpdateMaxWeights || (j > 0 && values + size > INT_MAX)) {
+        parts = 0;
+        values = 0;
+        j = 0;
+      }
+      parts += (size + kLayerwiseNormChunk - 1) / kLayerwiseNormChunk;
+      values += size;
+      ++j;
+      max_parts = std::max(max_parts, parts);
+    }
+    Tensor<xpu, 1, AType> workspace = ctx.requested[0].get_space_typed<xpu, 1, AType>(
+        Shape1(2 * max_parts + kMultiUpdateMaxWeights), s);
+    AType* sums = workspace.dptr_;
+    AType* rates = workspace.dptr_ + 2 * max_parts;
+    LayerwiseUpdateArgs<DType, SType, kNumStates> args;
+    args.strided = std::is_same<xpu, gpu>::value;
+    args.count = 0;
+    args.offset[0] = 0;
+    args.part[0] = 0;
+    auto launch = [&]() {
+      if (args.offset[args.count] > 0) {
+        Kernel<LayerwiseNormKernel<Rule, mp>, xpu>::Launch(s, args.part[args.count], args,
+                                                           rule, sums);
+        Kernel<LayerwiseRateKernel<Rule>, xpu>::Launch(s, args.count, args, rule,
+                                                       static_cast<const AType*>(sums), rates);
+        Kernel<LayerwiseApplyKernel<Rule, mp>, xpu>::Launch(s, args.offset[args.count], args,
+                                                            rule, static_cast<const AType*>(rates));
+      }
+      args.count = 0;
+    };
+    for (int n = 0; n < num_weights; ++n) {
+      const int size = static_cast<int>(inputs[n * group].Size());
+      if (args.count > 0 && static_cast<int64_t>(args.offset[args.count]) + size > INT_MAX) {
+        launch();
+      }
+      const int j = args.count;
+      args.weight[j] = inputs[n * group].dptr<DType>();
+      args.grad[j] = inputs[n * group + 1].dptr<DType>();
+      for (int k = 0; k < kNumStates; ++k) {
+        args.state[k][j] = inputs[n * group + 2 + k].dptr<SType>();
+      }
+      args.out[j] = outputs[n].dptr<DType>();
+      args.lr[j] = lrs[n];
+      args.wd[j] = wds[n];
+      args.c1[j] = c1[n];
+      args.c2[j] = c2[n];
+      args.req[j] = req[n];
+      args.offset[j + 1] = args.offset[j] + size;
+      args.part[j + 1] = args.part[j] + (size + kLayerwiseNormChunk - 1) / kLayerwiseNormChunk;
+      args.count = j + 1;
+      if (args.count == kMultiUpdateMaxWeights || n == num_weights - 1) launch();
+    }
+  });
+}
+
+template<typename xpu, bool mp>
+inline void MultiLARSUpdate(const nnvm::NodeAttrs& attrs,
+                            const OpContext &ctx,
+                            const std::vector<TBlob> &inputs,
+                            const std::vector<OpReqType> &req,
+                            const std::vector<TBlob> &outputs) {
+  const MultiLARSParam& param = nnvm::get<MultiLARSParam>(attrs.parsed);
+  const MultiLARSRule rule = {param.eta, param.momentum, param.epsilon,
+                              param.rescale_grad, param.clip_gradient};
+  const std::vector<float> ones(outputs.size(), 1.0f);
+  LayerwiseUpdate<xpu, MultiLARSRule, mp>(ctx, inputs, req, outputs, param.lrs, param.wds,
+                                          ones, ones, rule);
+}
+
+template<typename xpu, bool mp>
+inline void MultiLAMBUpdate(const nnvm::NodeAttrs& attrs,
+                            const OpContext &ctx,
+                            const std::vector<TBlob> &inputs,
+                            const std::vector<OpReqType> &req,
+                            const std::vector<TBlob> &outputs) {
+  const MultiLAMBParam& param = nnvm::get<MultiLAMBParam>(attrs.parsed);
+  const MultiLAMBRule rule = {param.beta1, param.beta2, param.epsilon,
+                              param.rescale_grad, param.clip_gradient};
+  std::vector<float> c1(outputs.size(), 1.0f), c2(outputs.size(), 1.0f);
+  if (param.bias_correction) {
+    CHECK_EQ(param.steps.ndim(), static_cast<index_t>(outputs.size()))
+      << "one step per weight is needed for the bias correction";
+    for (size_t n = 0; n < outputs.size(); ++n) {
+      CHECK_GE(param.steps[n], 1) << "the steps count from 1";
+      c1[n] = 1.0 / (1.0 - std::pow(static_cast<double>(param.beta1), param.steps[n]));
+      c2[n] = 1.0 / (1.0 - std::pow(static_cast<double>(param.beta2), param.steps[n]));
+    }
+  }
+  LayerwiseUpdate<xpu, MultiLAMBRule, mp>(ctx, inputs, req, outputs, param.lrs, param.wds,
+                                          c1, c2, rule);
+}
+
 }  // namespace op
 }  // namespace mxnet
 
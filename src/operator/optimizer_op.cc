@@ -32,6 +32,32 @@ DMLC_REGISTER_PARAMETER(SGDMomParam);
 DMLC_REGISTER_PARAMETER(AdamParam);
 DMLC_REGISTER_PARAMETER(RMSPropParam);
 DMLC_REGISTER_PARAMETER(RMSPropAlexParam);
+DMLC_REGISTER_PARAMETER(MultiSGDParam);
+DMLC_REGISTER_PARAMETER(MultiSGDMomParam);
+DMLC_REGISTER_PARAMETER(MultiAdamParam);
+DMLC_REGISTER_PARAMETER(MultiLARSParam);
+DMLC_REGISTER_PARAMETER(MultiLAMBParam);
+
+/*! \brief the inputs of a multi-tensor update, weight, grad and the states of each weight */
+static std::vector<std::string> MultiUpdateInputNames(int num_weights,
+                                                      const std::vector<std::string>& states) {
+  std::vector<std::string> ret;
+  for (int i = 0; i < num_weights; ++i) {
+    ret.push_back(std::string("weight_") + std::to_string(i));
+    ret.push_back(std::string("grad_") + std::to_string(i));
+    for (const auto& state : states) ret.push_back(state + "_" + std::to_string(i));
+  }
+  return ret;
+}
+
+/*! \brief the states of a multi-tensor update are updated in place */
+static std::vector<uint32_t> MultiUpdateMutateInputs(int num_weights, int num_states) {
+  std::vector<uint32_t> ret;
+  for (int i = 0; i < num_weights; ++i) {
+    for (int k = 0; k < num_states; ++k) ret.push_back(i * (2 + num_states) + 2 + k);
+  }
+  return ret;
+}
 
 NNVM_REGISTER_OP(sgd_update)
 .describe(R"code(Update function for Stochastic Gradient Descent (SDG) optimizer.
@@ -250,5 +276,383 @@ to be 0.9 and the learning rate :math:`\eta` to be 0.0001.
 .add_argument("delta", "NDArray-or-Symbol", "delta")
 .add_arguments(RMSPropAlexParam::__FIELDS__());
 
+NNVM_REGISTER_OP(mp_adam_update)
+.describe(R"code(Update function for multi-precision Adam optimizer.
+
+It updates as adam_update does, on the float32 copy ``weight32`` of a lower precision
+weight with float32 moments, and writes the weight in its own type in the same pass.
+
+)code" ADD_FILELINE)
+.set_num_inputs(5)
+.set_num_outputs(1)
+.set_attr_parser(ParamParser<AdamParam>)
+.set_attr<nnvm::FInferShape>("FInferShape", ElemwiseShape<5, 1>)
+.set_attr<nnvm::FInferType>("FInferType", MP_SGD_InferType<2, 1, 5>)
+.set_attr<nnvm::FMutateInputs>("FMutateInputs",
+  [](const nnvm::NodeAttrs& attrs) {
+    return std::vector<uint32_t>{2, 3, 4};
+  })
+.set_attr<FCompute>("FCompute<cpu>", MP_AdamUpdate<cpu>)
+.add_argument("weight", "NDArray-or-Symbol", "Weight")
+.add_argument("grad", "NDArray-or-Symbol", "Gradient")
+.add_argument("mean", "NDArray-or-Symbol", "Moving mean")
+.add_argument("var", "NDArray-or-Symbol", "Moving variance")
+.add_argument("weight32", "NDArray-or-Symbol", "Weight32")
+.add_arguments(AdamParam::__FIELDS__());
+
+NNVM_REGISTER_OP(mp_rmsprop_update)
+.describe(R"code(Update function for multi-precision RMSProp optimizer.
+
+It updates as rmsprop_update does, on the float32 copy ``weight32`` of a lower
+precision weight with a float32 ``n``, and writes the weight in its own type in the
+same pass.
+
+)code" ADD_FILELINE)
+.set_num_inputs(4)
+.set_num_outputs(1)
+.set_attr_parser(ParamParser<RMSPropParam>)
+.set_attr<nnvm::FInferShape>("FInferShape", ElemwiseShape<4, 1>)
+.set_attr<nnvm::FInferType>("FInferType", MP_SGD_InferType<2, 1, 4>)
+.set_attr<nnvm::FMutateInputs>("FMutateInputs",
+  [](const nnvm::NodeAttrs &attrs) {
+    return std::vector<uint32_t>{2, 3};
+  })
+.set_attr<FCompute>("FCompute<cpu>", MP_RMSPropUpdate<cpu>)
+.add_argument("weight", "NDArray-or-Symbol", "Weight")
+.add_argument("grad", "NDArray-or-Symbol", "Gradient")
+.add_argument("n", "NDArray-or-Symbol", "n")
+.add_argument("weight32", "NDArray-or-Symbol", "Weight32")
+.add_arguments(RMSPropParam::__FIELDS__());
+
+NNVM_REGISTER_OP(mp_rmspropalex_update)
+.describe(R"code(Update function for multi-precision RMSPropAlex optimizer.
+
+It updates as rmspropalex_update does, on the float32 copy ``weight32`` of a lower
+precision weight with float32 ``n``, ``g`` and ``delta``, and writes the weight in
+its own type in the same pass.
+
+)code" ADD_FILELINE)
+.set_num_inputs(6)
+.set_num_outputs(1)
+.set_attr_parser(ParamParser<RMSPropAlexParam>)
+.set_attr<nnvm::FInferShape>("FInferShape", ElemwiseShape<6, 1>)
+.set_attr<nnvm::FInferType>("FInferType", MP_SGD_InferType<2, 1, 6>)
+.set_attr<nnvm::FMutateInputs>("FMutateInputs",
+  [](const nnvm::NodeAttrs& attrs) {
+    return std::vector<uint32_t>{2, 3, 4, 5};
+  })
+.set_attr<FCompute>("FCompute<cpu>", MP_RMSPropAlexUpdate<cpu>)
+.add_argument("weight", "NDArray-or-Symbol", "Weight")
+.add_argument("grad", "NDArray-or-Symbol", "Gradient")
+.add_argument("n", "NDArray-or-Symbol", "n")
+.add_argument("g", "NDArray-or-Symbol", "g")
+.add_argument("delta", "NDArray-or-Symbol", "delta")
+.add_argument("weight32", "NDArray-or-Symbol", "Weight32")
+.add_arguments(RMSPropAlexParam::__FIELDS__());
+
+NNVM_REGISTER_OP(multi_sgd_update)
+.describe(R"code(Update function for Stochastic Gradient Descent (SDG) optimizer, of
+several weights at once.
+
+It updates each weight as sgd_update does, with the lr and wd of the weight taken
+from ``lrs`` and ``wds``. The inputs are the weight and the gradient of each weight
+in turn, and all the weights are updated in one kernel launch per 32 weights.
+
+)code" ADD_FILELINE)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiSGDParam>(attrs.parsed).num_weights * 2);
+  })
+.set_num_outputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiSGDParam>(attrs.parsed).num_weights);
+  })
+.set_attr_parser(ParamParser<MultiSGDParam>)
+.set_attr<nnvm::FInferShape>("FInferShape", MultiUpdateShape<0>)
+.set_attr<nnvm::FInferType>("FInferType", MultiUpdateType<0, false>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return MultiUpdateInputNames(dmlc::get<MultiSGDParam>(attrs.parsed).num_weights, {});
+  })
+.set_attr<FCompute>("FCompute<cpu>", MultiSGDUpdate<cpu>)
+.add_argument("data", "NDArray-or-Symbol[]", "Weights and gradients")
+.add_arguments(MultiSGDParam::__FIELDS__());
+
+NNVM_REGISTER_OP(multi_sgd_mom_update)
+.describe(R"code(Momentum update function for Stochastic Gradient Descent (SDG) optimizer,
+of several weights at once.
+
+It updates each weight as sgd_mom_update does, with the lr and wd of the weight
+taken from ``lrs`` and ``wds``. The inputs are the weight, the gradient and the
+momentum of each weight in turn, and all the weights are updated in one kernel
+launch per 32 weights.
+
+)code" ADD_FILELINE)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiSGDMomParam>(attrs.parsed).num_weights * 3);
+  })
+.set_num_outputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiSGDMomParam>(attrs.parsed).num_weights);
+  })
+.set_attr_parser(ParamParser<MultiSGDMomParam>)
+.set_attr<nnvm::FInferShape>("FInferShape", MultiUpdateShape<1>)
+.set_attr<nnvm::FInferType>("FInferType", MultiUpdateType<1, false>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return MultiUpdateInputNames(dmlc::get<MultiSGDMomParam>(attrs.parsed).num_weights,
+                                 {"mom"});
+  })
+.set_attr<nnvm::FMutateInputs>("FMutateInputs",
+  [](const nnvm::NodeAttrs& attrs) {
+    return MultiUpdateMutateInputs(dmlc::get<MultiSGDMomParam>(attrs.parsed).num_weights, 1);
+  })
+.set_attr<FCompute>("FCompute<cpu>", MultiSGDMomUpdate<cpu>)
+.add_argument("data", "NDArray-or-Symbol[]", "Weights, gradients and momentums")
+.add_arguments(MultiSGDMomParam::__FIELDS__());
+
+NNVM_REGISTER_OP(multi_mp_sgd_update)
+.describe(R"code(Updater function for multi-precision sgd optimizer, of several weights
+at once.
+
+The inputs are the weight, the gradient and the float32 copy of each weight in
+turn, updated as mp_sgd_update does.
+
+)code" ADD_FILELINE)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiSGDParam>(attrs.parsed).num_weights * 3);
+  })
+.set_num_outputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiSGDParam>(attrs.parsed).num_weights);
+  })
+.set_attr_parser(ParamParser<MultiSGDParam>)
+.set_attr<nnvm::FInferShape>("FInferShape", MultiUpdateShape<1>)
+.set_attr<nnvm::FInferType>("FInferType", MultiUpdateType<1, true>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return MultiUpdateInputNames(dmlc::get<MultiSGDParam>(attrs.parsed).num_weights,
+                                 {"weight32"});
+  })
+.set_attr<nnvm::FMutateInputs>("FMutateInputs",
+  [](const nnvm::NodeAttrs& attrs) {
+    return MultiUpdateMutateInputs(dmlc::get<MultiSGDParam>(attrs.parsed).num_weights, 1);
+  })
+.set_attr<FCompute>("FCompute<cpu>", MultiMPSGDUpdate<cpu>)
+.add_argument("data", "NDArray-or-Symbol[]", "Weights, gradients and float32 weights")
+.add_arguments(MultiSGDParam::__FIELDS__());
+
+NNVM_REGISTER_OP(multi_mp_sgd_mom_update)
+.describe(R"code(Updater function for multi-precision sgd optimizer with momentum, of
+several weights at once.
+
+The inputs are the weight, the gradient, the float32 momentum and the float32 copy
+of each weight in turn, updated as mp_sgd_mom_update does.
+
+)code" ADD_FILELINE)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiSGDMomParam>(attrs.parsed).num_weights * 4);
+  })
+.set_num_outputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiSGDMomParam>(attrs.parsed).num_weights);
+  })
+.set_attr_parser(ParamParser<MultiSGDMomParam>)
+.set_attr<nnvm::FInferShape>("FInferShape", MultiUpdateShape<2>)
+.set_attr<nnvm::FInferType>("FInferType", MultiUpdateType<2, true>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return MultiUpdateInputNames(dmlc::get<MultiSGDMomParam>(attrs.parsed).num_weights,
+                                 {"mom", "weight32"});
+  })
+.set_attr<nnvm::FMutateInputs>("FMutateInputs",
+  [](const nnvm::NodeAttrs& attrs) {
+    return MultiUpdateMutateInputs(dmlc::get<MultiSGDMomParam>(attrs.parsed).num_weights, 2);
+  })
+.set_attr<FCompute>("FCompute<cpu>", MultiMPSGDMomUpdate<cpu>)
+.add_argument("data", "NDArray-or-Symbol[]",
+              "Weights, gradients, momentums and float32 weights")
+.add_arguments(MultiSGDMomParam::__FIELDS__());
+
+NNVM_REGISTER_OP(multi_adam_update)
+.describe(R"code(Update function for Adam optimizer, of several weights at once.
+
+It updates each weight as adam_update does, with the lr and wd of the weight
+taken from ``lrs`` and ``wds``. The inputs are the weight, the gradient, the
+mean and the variance of each weight in turn, and all the weights are updated
+in one kernel launch per 32 weights. The gradients are not modified.
+
+)code" ADD_FILELINE)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiAdamParam>(attrs.parsed).num_weights * 4);
+  })
+.set_num_outputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiAdamParam>(attrs.parsed).num_weights);
+  })
+.set_attr_parser(ParamParser<MultiAdamParam>)
+.set_attr<nnvm::FInferShape>("FInferShape", MultiUpdateShape<2>)
+.set_attr<nnvm::FInferType>("FInferType", MultiUpdateType<2, false>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return MultiUpdateInputNames(dmlc::get<MultiAdamParam>(attrs.parsed).num_weights,
+                                 {"mean", "var"});
+  })
+.set_attr<nnvm::FMutateInputs>("FMutateInputs",
+  [](const nnvm::NodeAttrs& attrs) {
+    return MultiUpdateMutateInputs(dmlc::get<MultiAdamParam>(attrs.parsed).num_weights, 2);
+  })
+.set_attr<FCompute>("FCompute<cpu>", MultiAdamUpdate<cpu>)
+.add_argument("data", "NDArray-or-Symbol[]", "Weights, gradients, means and variances")
+.add_arguments(MultiAdamParam::__FIELDS__());
+
+NNVM_REGISTER_OP(multi_lars_update)
+.describe(R"code(Update function for the LARS optimizer, momentum SGD with layer-wise
+learning rates, of several weights at once.
+
+The learning rate of each weight is scaled by its trust ratio, and the update is
+otherwise the one of sgd_mom_update with the weight decay::
+
+  local_lr = lr * eta * norm(weight) / (norm(grad) + wd * norm(weight) + epsilon)
+  mom = momentum * mom - local_lr * (grad + wd * weight)
+  weight += mom
+
+where ``grad`` is rescaled and clipped, and ``local_lr = lr`` when a norm is 0. The
+inputs are the weight, the gradient and the momentum of each weight in turn. The
+norms are reduced in the update, which takes three kernel launches per 32 weights.
+
+)code" ADD_FILELINE)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiLARSParam>(attrs.parsed).num_weights * 3);
+  })
+.set_num_outputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiLARSParam>(attrs.parsed).num_weights);
+  })
+.set_attr_parser(ParamParser<MultiLARSParam>)
+.set_attr<nnvm::FInferShape>("FInferShape", MultiUpdateShape<1>)
+.set_attr<nnvm::FInferType>("FInferType", MultiUpdateType<1, false>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return MultiUpdateInputNames(dmlc::get<MultiLARSParam>(attrs.parsed).num_weights,
+                                 {"mom"});
+  })
+.set_attr<nnvm::FMutateInputs>("FMutateInputs",
+  [](const nnvm::NodeAttrs& attrs) {
+    return MultiUpdateMutateInputs(dmlc::get<MultiLARSParam>(attrs.parsed).num_weights, 1);
+  })
+.set_attr<FResourceRequest>("FResourceRequest",
+  [](const NodeAttrs& attrs) {
+    return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
+  })
+.set_attr<FCompute>("FCompute<cpu>", MultiLARSUpdate<cpu, false>)
+.add_argument("data", "NDArray-or-Symbol[]", "Weights, gradients and momentums")
+.add_arguments(MultiLARSParam::__FIELDS__());
+
+NNVM_REGISTER_OP(multi_mp_lars_update)
+.describe(R"code(Update function for the multi-precision LARS optimizer, of several
+weights at once.
+
+The inputs are the weight, the gradient, the float32 momentum and the float32 copy
+of each weight in turn, updated as multi_lars_update does on the float32 copies.
+
+)code" ADD_FILELINE)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiLARSParam>(attrs.parsed).num_weights * 4);
+  })
+.set_num_outputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiLARSParam>(attrs.parsed).num_weights);
+  })
+.set_attr_parser(ParamParser<MultiLARSParam>)
+.set_attr<nnvm::FInferShape>("FInferShape", MultiUpdateShape<2>)
+.set_attr<nnvm::FInferType>("FInferType", MultiUpdateType<2, true>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return MultiUpdateInputNames(dmlc::get<MultiLARSParam>(attrs.parsed).num_weights,
+                                 {"mom", "weight32"});
+  })
+.set_attr<nnvm::FMutateInputs>("FMutateInputs",
+  [](const nnvm::NodeAttrs& attrs) {
+    return MultiUpdateMutateInputs(dmlc::get<MultiLARSParam>(attrs.parsed).num_weights, 2);
+  })
+.set_attr<FResourceRequest>("FResourceRequest",
+  [](const NodeAttrs& attrs) {
+    return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
+  })
+.set_attr<FCompute>("FCompute<cpu>", MultiLARSUpdate<cpu, true>)
+.add_argument("data", "NDArray-or-Symbol[]", "Weights, gradients, momentums and float32 weights")
+.add_arguments(MultiLARSParam::__FIELDS__());
+
+NNVM_REGISTER_OP(multi_lamb_update)
+.describe(R"code(Update function for the LAMB optimizer, Adam with layer-wise learning
+rates, of several weights at once.
+
+It updates the moments as adam_update does, and each weight by its trust ratio::
+
+  m = beta1 * m + (1 - beta1) * grad
+  v = beta2 * v + (1 - beta2) * grad**2
+  r = (m / (1 - beta1**step)) / (sqrt(v / (1 - beta2**step)) + epsilon) + wd * weight
+  weight -= lr * norm(weight) / norm(r) * r
+
+where ``grad`` is rescaled and clipped, the ratio of norms is 1 when one of them is 0,
+and the bias corrections are left out unless ``bias_correction``. The inputs are the
+weight, the gradient, the mean and the variance of each weight in turn. The norms are
+reduced in the update, which takes three kernel launches per 32 weights.
+
+)code" ADD_FILELINE)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiLAMBParam>(attrs.parsed).num_weights * 4);
+  })
+.set_num_outputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiLAMBParam>(attrs.parsed).num_weights);
+  })
+.set_attr_parser(ParamParser<MultiLAMBParam>)
+.set_attr<nnvm::FInferShape>("FInferShape", MultiUpdateShape<2>)
+.set_attr<nnvm::FInferType>("FInferType", MultiUpdateType<2, false>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return MultiUpdateInputNames(dmlc::get<MultiLAMBParam>(attrs.parsed).num_weights,
+                                 {"mean", "var"});
+  })
+.set_attr<nnvm::FMutateInputs>("FMutateInputs",
+  [](const nnvm::NodeAttrs& attrs) {
+    return MultiUpdateMutateInputs(dmlc::get<MultiLAMBParam>(attrs.parsed).num_weights, 2);
+  })
+.set_attr<FResourceRequest>("FResourceRequest",
+  [](const NodeAttrs& attrs) {
+    return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
+  })
+.set_attr<FCompute>("FCompute<cpu>", MultiLAMBUpdate<cpu, false>)
+.add_argument("data", "NDArray-or-Symbol[]", "Weights, gradients, means and variances")
+.add_arguments(MultiLAMBParam::__FIELDS__());
+
+NNVM_REGISTER_OP(multi_mp_lamb_update)
+.describe(R"code(Update function for the multi-precision LAMB optimizer, of several
+weights at once.
+
+The inputs are the weight, the gradient, the float32 mean and variance and the float32
+copy of each weight in turn, updated as multi_lamb_update does on the float32 copies.
+
+)code" ADD_FILELINE)
+.set_num_inputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiLAMBParam>(attrs.parsed).num_weights * 5);
+  })
+.set_num_outputs([](const nnvm::NodeAttrs& attrs) {
+    return static_cast<uint32_t>(dmlc::get<MultiLAMBParam>(attrs.parsed).num_weights);
+  })
+.set_attr_parser(ParamParser<MultiLAMBParam>)
+.set_attr<nnvm::FInferShape>("FInferShape", MultiUpdateShape<3>)
+.set_attr<nnvm::FInferType>("FInferType", MultiUpdateType<3, true>)
+.set_attr<nnvm::FListInputNames>("FListInputNames",
+  [](const NodeAttrs& attrs) {
+    return MultiUpdateInputNames(dmlc::get<MultiLAMBParam>(attrs.parsed).num_weights,
+                                 {"mean", "var", "weight32"});
+  })
+.set_attr<nnvm::FMutateInputs>("FMutateInputs",
+  [](const nnvm::NodeAttrs& attrs) {
+    return MultiUpdateMutateInputs(dmlc::get<MultiLAMBParam>(attrs.parsed).num_weights, 3);
+  })
+.set_attr<FResourceRequest>("FResourceRequest",
+  [](const NodeAttrs& attrs) {
+    return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
+  })
+.set_attr<FCompute>("FCompute<cpu>", MultiLAMBUpdate<cpu, true>)
+.add_argument("data", "NDArray-or-Symbol[]",
+              "Weights, gradients, means, variances and float32 weights")
+.add_arguments(MultiLAMBParam::__FIELDS__());
+
 }  // namespace op
 }  // namespace mxnet
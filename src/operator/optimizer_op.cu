@@ -48,5 +48,41 @@ NNVM_REGISTER_OP(rmsprop_update)
 NNVM_REGISTER_OP(rmspropalex_update)
 .set_attr<FCompute>("FCompute<gpu>", RMSPropAlexUpdate<gpu>);
 
+NNVM_REGISTER_OP(mp_adam_update)
+.set_attr<FCompute>("FCompute<gpu>", MP_AdamUpdate<gpu>);
+
+NNVM_REGISTER_OP(mp_rmsprop_update)
+.set_attr<FCompute>("FCompute<gpu>", MP_RMSPropUpdate<gpu>);
+
+NNVM_REGISTER_OP(mp_rmspropalex_update)
+.set_attr<FCompute>("FCompute<gpu>", MP_RMSPropAlexUpdate<gpu>);
+
+NNVM_REGISTER_OP(multi_sgd_update)
+.set_attr<FCompute>("FCompute<gpu>", MultiSGDUpdate<gpu>);
+
+NNVM_REGISTER_OP(multi_sgd_mom_update)
+.set_attr<FCompute>("FCompute<gpu>", MultiSGDMomUpdate<gpu>);
+
+NNVM_REGISTER_OP(multi_mp_sgd_update)
+.set_attr<FCompute>("FCompute<gpu>", MultiMPSGDUpdate<gpu>);
+
+NNVM_REGISTER_OP(multi_mp_sgd_mom_update)
+.set_attr<FCompute>("FCompute<gpu>", MultiMPSGDMomUpdate<gpu>);
+
+NNVM_REGISTER_OP(multi_adam_update)
+.set_attr<FCompute>("FCompute<gpu>", MultiAdamUpdate<gpu>);
+
+NNVM_REGISTER_OP(multi_lars_update)
+.set_attr<FCompute>("FCompute<gpu>", MultiLARSUpdate<gpu, false>);
+
+NNVM_REGISTER_OP(multi_mp_lars_update)
+.set_attr<FCompute>("FCompute<gpu>", MultiLARSUpdate<gpu, true>);
+
+NNVM_REGISTER_OP(multi_lamb_update)
+.set_attr<FCompute>("FCompute<gpu>", MultiLAMBUpdate<gpu, false>);
+
+NNVM_REGISTER_OP(multi_mp_lamb_update)
+.set_attr<FCompute>("FCompute<gpu>", MultiLAMBUpdate<gpu, true>);
+
 }  // namespace op
 }  // namespace mxnet
@@ -0,0 +1,163 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file packed_weight.cc
+ * \brief a constant weight kept for the cpu products with it
+ */
+#include "./packed_weight.h"
+#include <dmlc/logging.h>
+#include <dmlc/omp.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include "./half_cpu.h"
+#include "./mxnet_op.h"
+#if MSHADOW_USE_MKL
+#include <mkl.h>
+#endif
+
+// the packed gemm of MKL came with MKL 2017
+#if MSHADOW_USE_MKL && defined(INTEL_MKL_VERSION) && INTEL_MKL_VERSION >= 20170000
+#define MXNET_PACKED_WEIGHT_MKL 1
+#else
+#define MXNET_PACKED_WEIGHT_MKL 0
+#endif
+
+namespace mxnet {
+namespace op {
+
+PackedWeight::~PackedWeight() {
+#if MXNET_PACKED_WEIGHT_MKL
+  if (mkl_ != nullptr) cblas_sgemm_free(mkl_);
+#endif  // MXNET_PACKED_WEIGHT_MKL
+}
+
+bool PackedWeight::Pack(const float* w, index_t M, index_t N, index_t K, int storage) {
+  using namespace packed_weight;
+#if MXNET_PACKED_WEIGHT_MKL
+  if (mkl_ != nullptr) {
+    cblas_sgemm_free(mkl_);
+    mkl_ = nullptr;
+  }
+#endif  // MXNET_PACKED_WEIGHT_MKL
+  src_ = nullptr;
+  half_.clear();
+  int8_.clear();
+  scale_.clear();
+  const size_t size = static_cast<size_t>(N) * K;
+  switch (storage) {
+    case kFloat32:
+#if MXNET_PACKED_WEIGHT_MKL
+      mkl_ = cblas_sgemm_alloc(CblasBMatrix, M, N, K);
+      CHECK(mkl_ != nullptr) << "Cannot allocate the packed weight";
+      cblas_sgemm_pack(CblasRowMajor, CblasBMatrix, CblasTrans, M, N, K, 1.0f, w, K, mkl_);
+      break;
+#else
+      return false;
+#endif  // MXNET_PACKED_WEIGHT_MKL
+    case kFloat16:
+      half_.resize(size);
+      half_cpu::FloatToHalf(w, half_.data(), size);
+      break;
+    case kInt8:
+      int8_.resize(size);
+      scale_.resize(N);
+      for (index_t n = 0; n < N; ++n) {
+        const float* row = w + static_cast<size_t>(n) * K;
+        float amax = 0;
+        for (index_t k = 0; k < K; ++k) amax = std::max(amax, std::abs(row[k]));
+        const float scale = amax > 0 ? amax / 127 : 1;
+        scale_[n] = scale;
+        int8_t* q = int8_.data() + static_cast<size_t>(n) * K;
+        for (index_t k = 0; k < K; ++k) {
+          q[k] = static_cast<int8_t>(std::lround(row[k] / scale));
+        }
+      }
+      break;
+    default:
+      LOG(FATAL) << "Unknown weight storage " << storage;
+  }
+  src_ = w;
+  m_ = M;
+  n_ = N;
+  k_ = K;
+  return true;
+}
+
+namespace {
+inline void ConvertBlock(const mshadow::half::half_t* src, float* dst, index_t n) {
+  half_cpu::HalfToFloat(src, dst, n);
+}
+
+inline void ConvertBlock(const int8_t* src, float* dst, index_t n) {
+  for (index_t i = 0; i < n; ++i) dst[i] = src[i];
+}
+}  // namespace
+
+template<typename SType>
+void PackedWeight::ConvertCompute(const SType* w, const float* data, index_t M,
+                                  float* out) const {
+  const index_t N = n_, K = k_;
+  const int kBlock = half_cpu::kHalfChunk;
+  const int nthread = mxnet_op::KernelNumThreads(
+      static_cast<int>(std::min<size_t>(static_cast<size_t>(N) * K, INT_MAX)),
+      mxnet_op::KernelGrain<PackedWeight>::Get());
+  // each row of the weight is converted once for all the rows of data
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (index_t n = 0; n < N; ++n) {
+    float block[kBlock];
+    const SType* row = w + static_cast<size_t>(n) * K;
+    for (index_t m = 0; m < M; ++m) out[m * N + n] = 0;
+    for (index_t k0 = 0; k0 < K; k0 += kBlock) {
+      const index_t len = std::min<index_t>(kBlock, K - k0);
+      ConvertBlock(row + k0, block, len);
+      for (index_t m = 0; m < M; ++m) {
+        const float* x = data + static_cast<size_t>(m) * K + k0;
+        float acc = 0;
+        for (index_t k = 0; k < len; ++k) acc += x[k] * block[k];
+        out[m * N + n] += acc;
+      }
+    }
+    if (!scale_.empty()) {
+      for (index_t m = 0; m < M; ++m) out[m * N + n] *= scale_[n];
+    }
+  }
+}
+
+bool PackedWeight::Compute(const float* data, index_t M, float* out) const {
+  CHECK(src_ != nullptr) << "The weight is not packed";
+#if MXNET_PACKED_WEIGHT_MKL
+  if (mkl_ != nullptr) {
+    cblas_sgemm_compute(CblasRowMajor, CblasNoTrans, CblasPacked, M, n_, k_, data, k_,
+                        mkl_, k_, 0.0f, out, n_);
+    return true;
+  }
+#endif  // MXNET_PACKED_WEIGHT_MKL
+  if (M > packed_weight::kMaxRows) return false;
+  if (!half_.empty()) {
+    ConvertCompute(half_.data(), data, M, out);
+  } else {
+    ConvertCompute(int8_.data(), data, M, out);
+  }
+  return true;
+}
+
+}  // namespace op
+}  // namespace mxnet
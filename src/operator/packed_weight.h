@@ -0,0 +1,86 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file packed_weight.h
+ * \brief a constant weight kept for the cpu products with it
+ *
+ * The product out = data * weight^T of an inference pass reads the whole
+ * weight for a few rows of data, so for the small batches of serving it is
+ * bound by the reads of the weight and by the packing gemm does of it on
+ * every call. A PackedWeight is made once from the weight: packed by MKL in
+ * float32, or stored in float16, or in int8 with a float scale per row, and
+ * converted to float32 block by block in the product.
+ */
+#ifndef MXNET_OPERATOR_PACKED_WEIGHT_H_
+#define MXNET_OPERATOR_PACKED_WEIGHT_H_
+
+#include <mshadow/base.h>
+#include <cstdint>
+#include <vector>
+
+namespace mxnet {
+namespace op {
+
+namespace packed_weight {
+enum WeightStorage {kFloat32, kFloat16, kInt8};
+/*! \brief the most rows of data the converting product takes, more go to gemm */
+const int kMaxRows = 16;
+}  // namespace packed_weight
+
+/*! \brief an (N, K) float32 weight, kept for the products out = data * weight^T */
+class PackedWeight {
+ public:
+  PackedWeight() = default;
+  PackedWeight(const PackedWeight&) = delete;
+  PackedWeight& operator=(const PackedWeight&) = delete;
+  ~PackedWeight();
+  /*! \brief whether the weight w of N x K is the one kept, for data of M rows */
+  bool Matches(const float* w, index_t M, index_t N, index_t K) const {
+    return src_ == w && n_ == N && k_ == K && (mkl_ == nullptr || m_ == M);
+  }
+  /*!
+   * \brief keeps the weight w of N x K in storage, for data of M rows
+   * \return false if there is no better product than gemm for the storage
+   */
+  bool Pack(const float* w, index_t M, index_t N, index_t K, int storage);
+  /*!
+   * \brief out = data * weight^T for data of M x K
+   * \return false if M is too large for the product, which leaves out to gemm
+   */
+  bool Compute(const float* data, index_t M, float* out) const;
+
+ private:
+  /*! \brief out = data * weight^T from the float16 or int8 weight */
+  template<typename SType>
+  void ConvertCompute(const SType* w, const float* data, index_t M, float* out) const;
+
+  const float* src_{nullptr};
+  index_t m_{0}, n_{0}, k_{0};
+  /*! \brief the weight packed by MKL */
+  float* mkl_{nullptr};
+  std::vector<mshadow::half::half_t> half_;
+  std::vector<int8_t> int8_;
+  /*! \brief the scale of each row of int8_ */
+  std::vector<float> scale_;
+};
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_PACKED_WEIGHT_H_
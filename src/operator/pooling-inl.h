@@ -33,6 +33,7 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include "./operator_common.h"
 #include "./nn/pool.h"
@@ -48,6 +49,7 @@ struct PoolingParam : public dmlc::Parameter<PoolingParam> {
   int pooling_convention;
   bool global_pool;
   bool cudnn_off;
+  dmlc::optional<int> layout;
   DMLC_DECLARE_PARAMETER(PoolingParam) {
     DMLC_DECLARE_FIELD(global_pool).set_default(false)
     .describe("Ignore kernel size, do global pooling based on current input feature map. ");
@@ -76,6 +78,14 @@ struct PoolingParam : public dmlc::Parameter<PoolingParam> {
 
     DMLC_DECLARE_FIELD(pad).set_default(TShape())
     .describe("pad for pooling: (y, x) or (d, y, x)");
+
+    DMLC_DECLARE_FIELD(layout)
+    .add_enum("NCHW", mshadow::kNCHW)
+    .add_enum("NHWC", mshadow::kNHWC)
+    .set_default(dmlc::optional<int>())
+    .describe("Set layout for input and output of 2D pooling. Empty for default "
+              "layout: NCW for 1d, NCHW for 2d and NCDHW for 3d. "
+              "NHWC is only supported by cuDNN.");
   }
 };
 
@@ -83,6 +93,8 @@ template<typename xpu, typename DType>
 class PoolingOp : public Operator {
  public:
   explicit PoolingOp(PoolingParam p) {
+    CHECK(!p.layout.has_value() || p.layout.value() == mshadow::kNCHW)
+      << "NHWC pooling is only supported by cuDNN";
     this->param_ = p;
   }
 
@@ -96,6 +108,15 @@ class PoolingOp : public Operator {
     CHECK_EQ(out_data.size(), 1U);
     Stream<xpu> *s = ctx.get_stream<xpu>();
     const TShape& ishape = in_data[pool_enum::kData].shape_;
+    // the cpu max pooling of training records the argmax of each window for Backward
+    int* mask = nullptr;
+    if (std::is_same<xpu, cpu>::value && ctx.is_train &&
+        param_.pool_type == pool_enum::kMaxPooling) {
+      mask_.resize(out_data[pool_enum::kOut].shape_.Size());
+      mask = mask_.data();
+    } else {
+      mask_.clear();
+    }
 
     pool(s, in_data[pool_enum::kData].dptr<DType>(),
          in_data[pool_enum::kData].shape_,
@@ -107,7 +128,8 @@ class PoolingOp : public Operator {
          param_.global_pool? TShape(param_.kernel.ndim()) : param_.stride,
          param_.pool_type,
          req[pool_enum::kOut],
-         out_data[pool_enum::kOut].dptr<DType>());
+         out_data[pool_enum::kOut].dptr<DType>(),
+         mask);
   }
 
   virtual void Backward(const OpContext& ctx,
@@ -125,6 +147,7 @@ class PoolingOp : public Operator {
     CHECK_EQ(in_grad.size(), 1U);
     Stream<xpu> *s = ctx.get_stream<xpu>();
     const TShape& ishape = in_data[pool_enum::kData].shape_;
+    const bool has_mask = mask_.size() == out_grad[pool_enum::kOut].shape_.Size();
 
     unpool(s, out_grad[pool_enum::kOut].dptr<DType>(),
            in_data[pool_enum::kData].dptr<DType>(),
@@ -138,11 +161,14 @@ class PoolingOp : public Operator {
            param_.global_pool? TShape(param_.kernel.ndim()) : param_.stride,
            param_.pool_type,
            req[pool_enum::kData],
-           in_grad[pool_enum::kData].dptr<DType>());
+           in_grad[pool_enum::kData].dptr<DType>(),
+           has_mask ? mask_.data() : nullptr);
   }
 
  private:
   PoolingParam param_;
+  /*! \brief the index in its plane of the max of each window of the last training Forward */
+  std::vector<int> mask_;
 };  // class PoolingOp
 
 template<typename xpu>
@@ -170,6 +196,9 @@ class PoolingProp : public OperatorProperty {
       << "stride and kernel should have the same length";
     CHECK_EQ(param_.pad.ndim(), param_.kernel.ndim())
       << "pad and kernel should have the same length";
+    if (param_.layout.has_value()) {
+      CHECK_EQ(param_.kernel.ndim(), 2U) << "Layout is only supported for 2D pooling";
+    }
   }
 
   std::map<std::string, std::string> GetParams() const override {
@@ -180,7 +209,11 @@ class PoolingProp : public OperatorProperty {
                   std::vector<TShape> *out_shape,
                   std::vector<TShape> *aux_shape) const override {
     CHECK_EQ(in_shape->size(), 1U);
-    const TShape &dshape = (*in_shape)[0];
+    TShape dshape = (*in_shape)[0];
+    const bool nhwc = param_.layout.has_value() && param_.layout.value() == mshadow::kNHWC;
+    if (nhwc && dshape.ndim() == 4) {
+      dshape = ConvertLayout(dshape.get<4>(), mshadow::kNHWC, mshadow::kNCHW);
+    }
     CHECK_GE(dshape.ndim(), 3U) << "Pooling: Input data should be  3D in (batch, channel, x)"
                                 << " Or 4D in (batch, channel, y, x) "
                                 << " Or 5D in (batch, channel, d, y, x)";
@@ -231,6 +264,7 @@ class PoolingProp : public OperatorProperty {
                               param_.kernel[1]) / param_.stride[1]));
         }
       }
+      if (nhwc) oshape = ConvertLayout(oshape.get<4>(), mshadow::kNCHW, mshadow::kNHWC);
       out_shape->clear();
       out_shape->push_back(oshape);  // save output shape
     } else if (param_.kernel.ndim() == 3) {
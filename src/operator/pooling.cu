@@ -35,6 +35,10 @@ template<>
 Operator *CreateOp<gpu>(PoolingParam param, int dtype) {
   Operator *op = NULL;
 #if MXNET_USE_CUDNN == 1
+  if (param.layout.has_value() && param.layout.value() == mshadow::kNHWC) {
+    CHECK(!param.cudnn_off && param.pool_type != pool_enum::kSumPooling)
+      << "NHWC pooling is only supported by cuDNN max and avg pooling";
+  }
   if (!param.cudnn_off && param.kernel.ndim() > 1) {
     MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
       switch (param.pool_type) {
@@ -25,6 +25,8 @@
 #define MXNET_OPERATOR_RANDOM_MULTISAMPLE_OP_H_
 
 #include <mxnet/operator_util.h>
+#include <algorithm>
+#include <climits>
 #include <vector>
 #include "../mshadow_op.h"
 #include "../mxnet_op.h"
@@ -132,6 +134,10 @@ inline bool MultiSampleOpType(const nnvm::NodeAttrs& attrs,
   return true;
 }
 
+/*! \brief keys the OpenMP grain of the cpu samplers, whose samples cost far more than a flop */
+struct MultiSampleCPUGrain {
+  static const int kCPUGrain = 256;
+};
 
 template<typename xpu, typename generator>
 void MultiSampleOpForward(const nnvm::NodeAttrs& attrs,
@@ -171,13 +177,18 @@ void MultiSampleOpForward(const nnvm::NodeAttrs& attrs,
 
         // The seeds for the different generators are itself a random sequence. We don't
         // want to create the same samples in case that we have two samplers with same
-        // input parameters.
+        // input parameters. They are drawn up front, as calling a random generator is
+        // not thread safe, so that the samplers run in parallel with the same results
+        // as in sequence.
         std::mt19937 seed_generator(seed);
+        std::vector<int> seeds(N);
+        for (int i = 0; i < N; ++i) seeds[i] = seed_generator();
+        const int nthread = std::min(N, KernelNumThreads(
+            static_cast<int>(std::min<int64_t>(out.Size(), INT_MAX)),
+            KernelGrain<MultiSampleCPUGrain>::Get()));
+        #pragma omp parallel for num_threads(nthread) if (nthread > 1)
         for (int i = 0; i < N; ++i) {
-          // Generate seed for this sampler. Must be mutexed as calling
-          // a random generator is not thread safe.
-          int seed = seed_generator();
-          typename generator::template Sampler<OType> sampler(iptr1[i], iptr2[i], seed);
+          typename generator::template Sampler<OType> sampler(iptr1[i], iptr2[i], seeds[i]);
           // Get the sub-tensor that will hold the results of this sampler.
           Tensor<xpu, 1, OType> slice = samples.Slice(i, i+1).FlatTo1D();
           for (int j = 0; j < M; ++j) {
@@ -107,29 +107,70 @@ inline bool SampleMultinomialOpType(const nnvm::NodeAttrs& attrs,
   return true;
 }
 
+/*! \brief the cdf of a row is scanned in blocks of this many values in parallel */
+const index_t kMultinomialScanBlock = 1024;
+
+/*! \brief one thread for each block of a row: the inclusive scan of the block and its sum */
+struct SampleMultinomialBlockScan {
+  static const int kCPUGrain = 4;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, index_t K, index_t nblock, const DType* dist,
+                                  float* cdf, float* block_sum) {
+    const index_t row = i / nblock;
+    const index_t begin = (i % nblock) * kMultinomialScanBlock;
+    const index_t end = begin + kMultinomialScanBlock < K ? begin + kMultinomialScanBlock : K;
+    float acc = 0.0f;
+    for (index_t k = begin; k < end; ++k) {
+      acc += static_cast<float>(dist[row*K + k]);
+      cdf[row*K + k] = acc;
+    }
+    block_sum[i] = acc;
+  }
+};
+
+/*! \brief one thread for each row: the exclusive scan of its block sums, in place */
+struct SampleMultinomialBlockOffset {
+  MSHADOW_XINLINE static void Map(int i, index_t nblock, float* block_sum) {
+    float acc = 0.0f;
+    for (index_t b = 0; b < nblock; ++b) {
+      const float sum = block_sum[i*nblock + b];
+      block_sum[i*nblock + b] = acc;
+      acc += sum;
+    }
+  }
+};
+
+/*! \brief one thread for each value: adds the sum of the blocks before its block */
+struct SampleMultinomialAddOffset {
+  MSHADOW_XINLINE static void Map(int i, index_t K, index_t nblock, float* cdf,
+                                  const float* block_offset) {
+    cdf[i] += block_offset[(i / K) * nblock + (i % K) / kMultinomialScanBlock];
+  }
+};
+
+/*!
+ * \brief one thread for each sample, which takes the first outcome whose cdf
+ *  exceeds the uniform by a binary search, or the last outcome if none does
+ */
 struct SampleMultinomialKernel {
   template<typename DType, typename IType>
   MSHADOW_XINLINE static void Map(int i, index_t K, index_t M,
-                                  DType* dist, float* uniform, IType* out,
-                                  DType* prob) {
-    for (index_t j = 0; j < M; ++j) {
-      DType loc = static_cast<DType>(uniform[i*M + j]);
-      DType acc = 0;
-      bool found = false;
-      for (index_t k = 0; k < K; ++k) {
-        acc += dist[i*K + k];
-        if (acc > loc) {
-          found = true;
-          out[i*M + j] = static_cast<IType>(k);
-          if (prob != nullptr) prob[i*M + j] = logf(dist[i*K + k]);
-          break;
-        }
-      }
-      if (!found) {
-        out[i*M + j] = static_cast<IType>(K-1);
-        if (prob != nullptr) prob[i*M + j] = logf(dist[i*K + K - 1]);
+                                  const DType* dist, const float* cdf, const float* uniform,
+                                  IType* out, DType* prob) {
+    const index_t row = i / M;
+    const float* row_cdf = cdf + row*K;
+    const float loc = uniform[i];
+    index_t lo = 0, hi = K - 1;
+    while (lo < hi) {
+      const index_t mid = lo + (hi - lo) / 2;
+      if (row_cdf[mid] > loc) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
       }
     }
+    out[i] = static_cast<IType>(lo);
+    if (prob != nullptr) prob[i] = logf(dist[row*K + lo]);
   }
 };
 
@@ -147,15 +188,26 @@ void SampleMultinomialForward(const nnvm::NodeAttrs& attrs,
   index_t K = inputs[0].shape_[inputs[0].ndim()-1];
   index_t N = inputs[0].Size()/K;
   index_t M = outputs[0].Size()/N;
+  index_t nblock = (K + kMultinomialScanBlock - 1) / kMultinomialScanBlock;
 
   Stream<xpu> *s = ctx.get_stream<xpu>();
   MSHADOW_REAL_TYPE_SWITCH(inputs[0].type_flag_, DType, {
     Random<xpu, float> *prnd = ctx.requested[0].get_random<xpu, float>(s);
-    Tensor<xpu, 1, float> uniform =
-      ctx.requested[1].get_space_typed<xpu, 1, float>(Shape1(N*M), s);
+    // the uniforms, the cdfs and the offsets of the blocks of the cdfs
+    Tensor<xpu, 1, float> workspace =
+      ctx.requested[1].get_space_typed<xpu, 1, float>(Shape1(N*M + N*K + N*nblock), s);
+    Tensor<xpu, 1, float> uniform(workspace.dptr_, Shape1(N*M), s);
+    float* cdf = workspace.dptr_ + N*M;
+    float* block_sum = cdf + N*K;
     prnd->SampleUniform(&uniform, 0, 1);
+    Kernel<SampleMultinomialBlockScan, xpu>::Launch(
+      s, N*nblock, K, nblock, inputs[0].dptr<DType>(), cdf, block_sum);
+    if (nblock > 1) {
+      Kernel<SampleMultinomialBlockOffset, xpu>::Launch(s, N, nblock, block_sum);
+      Kernel<SampleMultinomialAddOffset, xpu>::Launch(s, N*K, K, nblock, cdf, block_sum);
+    }
     Kernel<SampleMultinomialKernel, xpu>::Launch(
-      s, N, K, M, inputs[0].dptr<DType>(), uniform.dptr_, outputs[0].dptr<int>(),
+      s, N*M, K, M, inputs[0].dptr<DType>(), cdf, uniform.dptr_, outputs[0].dptr<int>(),
       param.get_prob ? outputs[1].dptr<DType>() : nullptr);
   });
 }
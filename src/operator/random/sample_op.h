@@ -26,9 +26,11 @@
 
 #include <mxnet/operator_util.h>
 #include <mshadow/base.h>
+#include <cmath>
 #include <string>
 #include <vector>
 #include "../mshadow_op.h"
+#include "../mxnet_op.h"
 #include "../elemwise_op_common.h"
 #include "../tensor/init_op.h"
 
@@ -232,21 +234,152 @@ struct SampleGenNegBinomialParam : public dmlc::Parameter<SampleGenNegBinomialPa
   }
 };
 
+/*!
+ * \brief gamma(alpha, beta) by Marsaglia and Tsang, "A simple method for
+ *  generating gamma variables", with u^(1/alpha) boosting alpha < 1
+ */
+MSHADOW_XINLINE float SampleGamma(float alpha, float beta, common::random::PhiloxGenerator* gen) {
+  const float a = alpha < 1.0f ? alpha + 1.0f : alpha;
+  const float d = a - 1.0f / 3.0f;
+  const float c = 1.0f / sqrtf(9.0f * d);
+  float v;
+  while (true) {
+    const float x = gen->Normal();
+    v = 1.0f + c * x;
+    if (v <= 0.0f) continue;
+    v = v * v * v;
+    const float u = gen->Uniform();
+    if (u < 1.0f - 0.0331f * x * x * x * x ||
+        logf(u) < 0.5f * x * x + d * (1.0f - v + logf(v))) break;
+  }
+  float ret = d * v * beta;
+  if (alpha < 1.0f) ret *= powf(gen->Uniform(), 1.0f / alpha);
+  return ret;
+}
+
+/*!
+ * \brief poisson(lam) by multiplying uniforms for small lam, and by the
+ *  transformed rejection of Hormann, "The transformed rejection method for
+ *  generating Poisson random variables", otherwise
+ */
+MSHADOW_XINLINE float SamplePoisson(float lam, common::random::PhiloxGenerator* gen) {
+  if (lam < 10.0f) {
+    const float limit = expf(-lam);
+    float prod = gen->Uniform();
+    int k = 0;
+    while (prod > limit) {
+      prod *= gen->Uniform();
+      ++k;
+    }
+    return static_cast<float>(k);
+  }
+  const float slam = sqrtf(lam);
+  const float loglam = logf(lam);
+  const float b = 0.931f + 2.53f * slam;
+  const float a = -0.059f + 0.02483f * b;
+  const float invalpha = 1.1239f + 1.1328f / (b - 3.4f);
+  const float vr = 0.9277f - 3.6224f / (b - 2.0f);
+  while (true) {
+    const float u = gen->Uniform() - 0.5f;
+    const float v = gen->Uniform();
+    const float us = 0.5f - fabsf(u);
+    if (us <= 0.0f) continue;
+    const float k = floorf((2.0f * a / us + b) * u + lam + 0.43f);
+    if (us >= 0.07f && v <= vr) return k;
+    if (k < 0.0f || (us < 0.013f && v > us)) continue;
+    if (logf(v) + logf(invalpha) - logf(a / (us * us) + b) <=
+        -lam + k * loglam - lgammaf(k + 1.0f)) return k;
+  }
+}
+
+// The samplers of the distributions, each draws a value with the generator of an element.
+struct UniformSample {
+  float low, high;
+  MSHADOW_XINLINE float operator()(common::random::PhiloxGenerator* gen) const {
+    return low + (high - low) * (1.0f - gen->Uniform());
+  }
+};
+
+struct NormalSample {
+  float loc, scale;
+  MSHADOW_XINLINE float operator()(common::random::PhiloxGenerator* gen) const {
+    return loc + scale * gen->Normal();
+  }
+};
+
+struct GammaSample {
+  float alpha, beta;
+  MSHADOW_XINLINE float operator()(common::random::PhiloxGenerator* gen) const {
+    return SampleGamma(alpha, beta, gen);
+  }
+};
+
+struct ExponentialSample {
+  float lam;
+  MSHADOW_XINLINE float operator()(common::random::PhiloxGenerator* gen) const {
+    return -logf(gen->Uniform()) / lam;
+  }
+};
+
+struct PoissonSample {
+  float lam;
+  MSHADOW_XINLINE float operator()(common::random::PhiloxGenerator* gen) const {
+    return SamplePoisson(lam, gen);
+  }
+};
+
+/*! \brief the failures before k successes of probability p, a poisson-gamma mixture */
+struct NegBinomialSample {
+  float k, p;
+  MSHADOW_XINLINE float operator()(common::random::PhiloxGenerator* gen) const {
+    if (k == 0.0f) return 0.0f;
+    return SamplePoisson(SampleGamma(k, (1.0f - p) / p, gen), gen);
+  }
+};
+
+/*! \brief poisson(gamma(1 / alpha, mu * alpha)), which is poisson(mu) for alpha = 0 */
+struct GenNegBinomialSample {
+  float mu, alpha;
+  MSHADOW_XINLINE float operator()(common::random::PhiloxGenerator* gen) const {
+    if (alpha == 0.0f) return SamplePoisson(mu, gen);
+    return SamplePoisson(SampleGamma(1.0f / alpha, mu * alpha, gen), gen);
+  }
+};
+
+/*! \brief draws each element with its own generator of the launch */
+template<typename Sampler>
+struct SampleKernel {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, common::random::PhiloxCall call, Sampler sampler,
+                                  DType* out) {
+    common::random::PhiloxGenerator gen(call, i);
+    out[i] = DType(sampler(&gen));
+  }
+};
+
+/*!
+ * \brief fills outputs[0] with the samples of sampler, in parallel on the
+ *  cpu and the gpu alike. The samples only depend on the seed.
+ */
+template<typename xpu, typename Sampler>
+inline void SampleCompute(const OpContext& ctx, const std::vector<TBlob>& outputs,
+                          const Sampler& sampler) {
+  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+  common::random::ParallelRandom *prnd = ctx.requested[0].get_parallel_random();
+  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
+    mxnet_op::Kernel<SampleKernel<Sampler>, xpu>::Launch(
+      s, outputs[0].Size(), prnd->Next(), sampler, outputs[0].dptr<DType>());
+  });
+}
+
 template<typename xpu>
 void SampleUniform_(const nnvm::NodeAttrs& attrs,
                     const OpContext& ctx,
                     const std::vector<TBlob>& inputs,
                     const std::vector<OpReqType>& req,
                     const std::vector<TBlob>& outputs) {
-  using namespace mxnet::op;
-  using namespace mshadow::expr;
-  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
   const SampleUniformParam& param = nnvm::get<SampleUniformParam>(attrs.parsed);
-  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
-    mshadow::Random<xpu, DType> *prnd = ctx.requested[0].get_random<xpu, DType>(s);
-    mshadow::Tensor<xpu, 2, DType> out = outputs[0].FlatTo2D<xpu, DType>(s);
-    prnd->SampleUniform(&out, param.low, param.high);
-  });
+  SampleCompute<xpu>(ctx, outputs, UniformSample{param.low, param.high});
 }
 
 template<typename xpu>
@@ -255,16 +388,9 @@ void SampleNormal_(const nnvm::NodeAttrs& attrs,
                    const std::vector<TBlob>& inputs,
                    const std::vector<OpReqType>& req,
                    const std::vector<TBlob>& outputs) {
-  using namespace mxnet::op;
-  using namespace mshadow::expr;
-  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
   const SampleNormalParam& param = nnvm::get<SampleNormalParam>(attrs.parsed);
   CHECK_GT(param.scale, 0) << "scale parameter in gaussian has to be positive";
-  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
-    mshadow::Random<xpu, DType> *prnd = ctx.requested[0].get_random<xpu, DType>(s);
-    mshadow::Tensor<xpu, 2, DType> out = outputs[0].FlatTo2D<xpu, DType>(s);
-    prnd->SampleGaussian(&out, param.loc, param.scale);  // NOLINT(*)
-  });
+  SampleCompute<xpu>(ctx, outputs, NormalSample{param.loc, param.scale});
 }
 
 template<typename xpu>
@@ -273,17 +399,10 @@ void SampleGamma_(const nnvm::NodeAttrs& attrs,
                    const std::vector<TBlob>& inputs,
                    const std::vector<OpReqType>& req,
                    const std::vector<TBlob>& outputs) {
-  using namespace mxnet::op;
-  using namespace mshadow::expr;
-  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
   const SampleGammaParam& param = nnvm::get<SampleGammaParam>(attrs.parsed);
   CHECK_GT(param.alpha, 0) << "alpha parameter in gamma distribution has to be positive";
   CHECK_GT(param.beta, 0) << "beta parameter in gamma distribution has to be positive";
-  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
-    mshadow::Random<xpu, DType> *prnd = ctx.requested[0].get_random<xpu, DType>(s);
-    mshadow::Tensor<xpu, 2, DType> out = outputs[0].FlatTo2D<xpu, DType>(s);
-    prnd->SampleGamma(&out, param.alpha, param.beta);  // NOLINT(*)
-  });
+  SampleCompute<xpu>(ctx, outputs, GammaSample{param.alpha, param.beta});
 }
 
 template<typename xpu>
@@ -292,16 +411,9 @@ void SampleExponential_(const nnvm::NodeAttrs& attrs,
                    const std::vector<TBlob>& inputs,
                    const std::vector<OpReqType>& req,
                    const std::vector<TBlob>& outputs) {
-  using namespace mxnet::op;
-  using namespace mshadow::expr;
-  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
   const SampleExponentialParam& param = nnvm::get<SampleExponentialParam>(attrs.parsed);
   CHECK_GT(param.lam, 0) << "lambda parameter in exponential distribution has to be positive";
-  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
-    mshadow::Random<xpu, DType> *prnd = ctx.requested[0].get_random<xpu, DType>(s);
-    mshadow::Tensor<xpu, 2, DType> out = outputs[0].FlatTo2D<xpu, DType>(s);
-    prnd->SampleExponential(&out, param.lam);  // NOLINT(*)
-  });
+  SampleCompute<xpu>(ctx, outputs, ExponentialSample{param.lam});
 }
 
 template<typename xpu>
@@ -310,16 +422,9 @@ void SamplePoisson_(const nnvm::NodeAttrs& attrs,
                    const std::vector<TBlob>& inputs,
                    const std::vector<OpReqType>& req,
                    const std::vector<TBlob>& outputs) {
-  using namespace mxnet::op;
-  using namespace mshadow::expr;
-  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
   const SamplePoissonParam& param = nnvm::get<SamplePoissonParam>(attrs.parsed);
   CHECK_GE(param.lam, 0) << "lambda parameter in poisson distribution has to be non-negative";
-  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
-    mshadow::Random<xpu, DType> *prnd = ctx.requested[0].get_random<xpu, DType>(s);
-    mshadow::Tensor<xpu, 2, DType> out = outputs[0].FlatTo2D<xpu, DType>(s);
-    prnd->SamplePoisson(&out, param.lam);  // NOLINT(*)
-  });
+  SampleCompute<xpu>(ctx, outputs, PoissonSample{param.lam});
 }
 
 template<typename xpu>
@@ -328,17 +433,10 @@ void SampleNegBinomial_(const nnvm::NodeAttrs& attrs,
                    const std::vector<TBlob>& inputs,
                    const std::vector<OpReqType>& req,
                    const std::vector<TBlob>& outputs) {
-  using namespace mxnet::op;
-  using namespace mshadow::expr;
-  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
   const SampleNegBinomialParam& param = nnvm::get<SampleNegBinomialParam>(attrs.parsed);
   CHECK_GE(param.k, 0) << "k parameter in negative binomial distribution has to be non-negative";
   CHECK_GE(param.p, 0) << "p parameter in negative binomial distribution has to be non-negative";
-  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
-    mshadow::Random<xpu, DType> *prnd = ctx.requested[0].get_random<xpu, DType>(s);
-    mshadow::Tensor<xpu, 2, DType> out = outputs[0].FlatTo2D<xpu, DType>(s);
-    prnd->SampleNegativeBinomial(&out, param.k, param.p);  // NOLINT(*)
-  });
+  SampleCompute<xpu>(ctx, outputs, NegBinomialSample{static_cast<float>(param.k), param.p});
 }
 
 template<typename xpu>
@@ -347,19 +445,12 @@ void SampleGenNegBinomial_(const nnvm::NodeAttrs& attrs,
                    const std::vector<TBlob>& inputs,
                    const std::vector<OpReqType>& req,
                    const std::vector<TBlob>& outputs) {
-  using namespace mxnet::op;
-  using namespace mshadow::expr;
-  mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
   const SampleGenNegBinomialParam& param = nnvm::get<SampleGenNegBinomialParam>(attrs.parsed);
   CHECK_GE(param.mu, 0)
     << "mu parameter in generalized negative binomial distribution has to be non-negative";
   CHECK_GE(param.alpha, 0)
     << "alpha parameter in generalized negative binomial distribution has to be non-negative";
-  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
-    mshadow::Random<xpu, DType> *prnd = ctx.requested[0].get_random<xpu, DType>(s);
-    mshadow::Tensor<xpu, 2, DType> out = outputs[0].FlatTo2D<xpu, DType>(s);
-    prnd->SampleGeneralizedNegativeBinomial(&out, param.mu, param.alpha);  // NOLINT(*)
-  });
+  SampleCompute<xpu>(ctx, outputs, GenNegBinomialSample{param.mu, param.alpha});
 }
 
 template<typename ParamType>
@@ -399,7 +490,7 @@ inline bool SampleOpType(const nnvm::NodeAttrs& attrs,
 }
 
 inline std::vector<ResourceRequest> SampleResource(const NodeAttrs& attrs) {
-  return { ResourceRequest::kRandom, ResourceRequest::kTempSpace };
+  return { ResourceRequest::kParallelRandom };
 }
 
 }  // namespace op
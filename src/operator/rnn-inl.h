@@ -34,6 +34,7 @@
 #include <string>
 #include <utility>
 #include "./operator_common.h"
+#include "./rnn_impl.h"
 
 namespace mxnet {
 namespace op {
@@ -120,11 +121,14 @@ struct RNNParam : public dmlc::Parameter<RNNParam> {
   }
 };
 
+/*!
+ * \brief the fused RNN of the cpu, see rnn_impl.h. The reserve space of the
+ *  training forward is kept for the backward.
+ */
 template<typename xpu, typename DType>
 class RNNOp : public Operator {
  public:
-  explicit RNNOp(RNNParam p) {
-  }
+  explicit RNNOp(RNNParam p) : param_(p) {}
 
   virtual void Forward(const OpContext &ctx,
                        const std::vector<TBlob> &in_data,
@@ -132,8 +136,28 @@ class RNNOp : public Operator {
                        const std::vector<TBlob> &out_data,
                        const std::vector<TBlob> &aux_args) {
     using namespace mshadow;
-    using namespace mshadow::expr;
-    // TODO(sbodenstein): add MShadow implementation
+    const bool lstm = param_.mode == rnn_enum::kLstm;
+    CHECK_EQ(in_data.size(), lstm ? 4U : 3U);
+    CHECK_EQ(out_data.size(), param_.state_outputs ? (lstm ? 3U : 2U) : 1U);
+    CHECK(!ctx.is_train || param_.p == 0 || param_.num_layers == 1)
+        << "The cpu RNN does not implement the dropout between the layers";
+    if (req[rnn_enum::kOut] == kNullOp) return;
+    CHECK_NE(req[rnn_enum::kOut], kAddTo) << "RNN does not support kAddTo";
+    const rnn::RNNShape s = GetShape(in_data[rnn_enum::kData].shape_);
+    Stream<xpu> *st = ctx.get_stream<xpu>();
+    Tensor<xpu, 1, DType> workspace = ctx.requested[rnn_enum::kTempSpace]
+        .get_space_typed<xpu, 1, DType>(Shape1(s.forward_workspace()), st);
+    reserve_.resize(s.reserve_space(ctx.is_train));
+    trained_ = ctx.is_train;
+    DType* hy = param_.state_outputs ? out_data[rnn_enum::kStateOut].dptr<DType>() : nullptr;
+    DType* cy = param_.state_outputs && lstm ?
+                out_data[rnn_enum::kStateCellOut].dptr<DType>() : nullptr;
+    rnn::RNNForward(s, ctx.is_train, in_data[rnn_enum::kData].dptr<DType>(),
+                    in_data[rnn_enum::kParams].dptr<DType>(),
+                    in_data[rnn_enum::kState].dptr<DType>(),
+                    lstm ? in_data[rnn_enum::kStateCell].dptr<DType>() : nullptr,
+                    out_data[rnn_enum::kOut].dptr<DType>(), hy, cy,
+                    reserve_.data(), workspace.dptr_);
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -144,12 +168,69 @@ class RNNOp : public Operator {
                         const std::vector<TBlob> &in_grad,
                         const std::vector<TBlob> &aux_args) {
     using namespace mshadow;
-    using namespace mshadow::expr;
-    // TODO(sbodenstein): add MShadow implementation
+    const bool lstm = param_.mode == rnn_enum::kLstm;
+    CHECK(trained_) << "The backward of RNN needs a forward with is_train=True";
+    const rnn::RNNShape s = GetShape(in_data[rnn_enum::kData].shape_);
+    Stream<xpu> *st = ctx.get_stream<xpu>();
+    Tensor<xpu, 1, DType> workspace = ctx.requested[rnn_enum::kTempSpace]
+        .get_space_typed<xpu, 1, DType>(Shape1(s.backward_workspace()), st);
+    // the gradients are written to the inputs of kWriteTo, and added from grads_ otherwise
+    const size_t num_inputs = lstm ? 4 : 3;
+    std::vector<DType*> dptr(num_inputs);
+    size_t extra = 0;
+    for (size_t i = 0; i < num_inputs; ++i) {
+      if (req[i] != kWriteTo && req[i] != kWriteInplace) extra += in_grad[i].Size();
+    }
+    grads_.resize(extra);
+    extra = 0;
+    for (size_t i = 0; i < num_inputs; ++i) {
+      if (req[i] == kWriteTo || req[i] == kWriteInplace) {
+        dptr[i] = in_grad[i].dptr<DType>();
+      } else {
+        dptr[i] = grads_.data() + extra;
+        extra += in_grad[i].Size();
+      }
+    }
+    const DType* dhy = param_.state_outputs ? out_grad[rnn_enum::kStateOut].dptr<DType>()
+                                            : nullptr;
+    const DType* dcy = param_.state_outputs && lstm ?
+                       out_grad[rnn_enum::kStateCellOut].dptr<DType>() : nullptr;
+    rnn::RNNBackward(s, in_data[rnn_enum::kData].dptr<DType>(),
+                     in_data[rnn_enum::kParams].dptr<DType>(),
+                     in_data[rnn_enum::kState].dptr<DType>(),
+                     lstm ? in_data[rnn_enum::kStateCell].dptr<DType>() : nullptr,
+                     out_data[rnn_enum::kOut].dptr<DType>(),
+                     out_grad[rnn_enum::kOut].dptr<DType>(), dhy, dcy, reserve_.data(),
+                     dptr[rnn_enum::kData], dptr[rnn_enum::kParams], dptr[rnn_enum::kState],
+                     lstm ? dptr[rnn_enum::kStateCell] : nullptr, workspace.dptr_);
+    for (size_t i = 0; i < num_inputs; ++i) {
+      if (req[i] != kAddTo) continue;
+      DType* g = in_grad[i].dptr<DType>();
+      const size_t n = in_grad[i].Size();
+      for (size_t j = 0; j < n; ++j) g[j] += dptr[i][j];
+    }
   }
 
  private:
+  rnn::RNNShape GetShape(const TShape& dshape) const {
+    rnn::RNNShape s;
+    s.seq_length = dshape[0];
+    s.batch_size = dshape[1];
+    s.input_size = dshape[2];
+    s.state_size = param_.state_size;
+    s.num_layers = param_.num_layers;
+    s.directions = param_.bidirectional ? 2 : 1;
+    s.mode = param_.mode;
+    return s;
+  }
+
   RNNParam param_;
+  /*! \brief the gates, cells and layer outputs of the last forward */
+  std::vector<DType> reserve_;
+  /*! \brief whether the last forward kept the states of every layer */
+  bool trained_ = false;
+  /*! \brief the gradients which are added to the inputs */
+  std::vector<DType> grads_;
 };  // class RNNOp
 
 template<typename xpu>
@@ -29,9 +29,8 @@ namespace mxnet {
 namespace op {
 template<>
 Operator *CreateOp<cpu>(RNNParam param, int dtype) {
-  LOG(FATAL) << "RNN is only available for gpu at the moment.";
   Operator *op = NULL;
-  MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
+  MSHADOW_SGL_DBL_TYPE_SWITCH(dtype, DType, {
     op = new RNNOp<cpu, DType>(param);
   });
   return op;
@@ -46,7 +45,12 @@ Operator *RNNProp::CreateOperatorEx(Context ctx,
 DMLC_REGISTER_PARAMETER(RNNParam);
 
 MXNET_REGISTER_OP_PROPERTY(RNN, RNNProp)
-.describe("Applies a recurrent layer to input.")
+.describe(R"code(Applies a recurrent layer to input.
+
+The cpu version computes the input projections of all the time steps with one
+gemm per layer and direction, and fuses the gate nonlinearities of a step. It
+does not support dropout between the layers in training.
+)code")
 .add_argument("data", "NDArray-or-Symbol", "Input data to RNN")
 .add_argument("parameters", "NDArray-or-Symbol",
               "Vector of all RNN trainable parameters concatenated")
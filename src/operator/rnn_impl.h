@@ -0,0 +1,330 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file rnn_impl.h
+ * \brief the fused cpu kernels of the RNN operator
+ *
+ * The parameters are laid out as cudnn does: the input and the hidden weights
+ * of every layer and direction, of shape (gates * state_size, input size),
+ * then their biases. The gates are i, f, c, o for the LSTM and r, z, n for
+ * the GRU, whose n gate is tanh(x_n + r * (h_n + b_hn)).
+ *
+ * The input projections of all the time steps of a layer are one gemm, each
+ * step is one gemm of the hidden state followed by one pass computing the
+ * gates. The training forward keeps the gates, cells and layer outputs in a
+ * reserve space, which the backward reads.
+ */
+#ifndef MXNET_OPERATOR_RNN_IMPL_H_
+#define MXNET_OPERATOR_RNN_IMPL_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/omp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "./linalg.h"
+
+namespace mxnet {
+namespace op {
+namespace rnn {
+
+/*! \brief the sizes of an RNN, with its mode as a rnn_enum::RNNModeType */
+struct RNNShape {
+  int seq_length, batch_size, input_size, state_size, num_layers, directions, mode;
+  /*! \brief the number of gates of the mode */
+  int gates() const { return mode == 2 ? 4 : (mode == 3 ? 3 : 1); }
+  bool lstm() const { return mode == 2; }
+  bool gru() const { return mode == 3; }
+  int layer_input(int l) const { return l == 0 ? input_size : directions * state_size; }
+  /*! \brief the reserve space of a layer and direction: the gates, and the cells or h_n */
+  size_t state_space() const {
+    const size_t step = static_cast<size_t>(batch_size) * state_size;
+    return seq_length * step * (gates() + (lstm() || gru() ? 1 : 0));
+  }
+  /*! \brief the reserve space of the outputs of the layers but the last */
+  size_t output_space() const {
+    return static_cast<size_t>(num_layers - 1) * seq_length * batch_size * directions *
+           state_size;
+  }
+  size_t reserve_space(bool train) const {
+    return (train ? num_layers * directions : 1) * state_space() + output_space();
+  }
+  size_t forward_workspace() const {
+    return static_cast<size_t>(batch_size) * gates() * state_size;
+  }
+  /*! \brief dG of a sequence, dG of the hidden state of a step, dh, dc and two dy */
+  size_t backward_workspace() const {
+    const size_t step = static_cast<size_t>(batch_size) * state_size;
+    return seq_length * step * gates() + step * gates() + 2 * step +
+           (num_layers > 1 ? 2 * seq_length * step * directions : 0);
+  }
+};
+
+/*! \brief the weights and biases of a layer and direction in the parameters */
+template<typename DType>
+struct LayerParams {
+  DType *wx = nullptr, *wh = nullptr, *bx, *bh;
+  LayerParams(const RNNShape& s, DType* w, int layer, int dir) {
+    const size_t gh = static_cast<size_t>(s.gates()) * s.state_size;
+    size_t offset = 0;
+    for (int l = 0; l < s.num_layers; ++l) {
+      for (int d = 0; d < s.directions; ++d) {
+        if (l == layer && d == dir) {
+          wx = w + offset;
+          wh = wx + gh * s.layer_input(l);
+        }
+        offset += gh * (s.layer_input(l) + s.state_size);
+      }
+    }
+    bx = w + offset + 2 * gh * (layer * s.directions + dir);
+    bh = bx + gh;
+  }
+};
+
+/*! \brief c = op(a) * op(b) + beta * c, of row-major matrices with leading dimensions */
+template<typename DType>
+inline void RNNGemm(const DType* a, int rows_a, int cols_a, int lda, bool ta,
+                    const DType* b, int rows_b, int cols_b, int ldb, bool tb,
+                    DType* c, int ldc, DType beta) {
+  using mshadow::Tensor;
+  using mshadow::Shape2;
+  Tensor<cpu, 2, DType> A(const_cast<DType*>(a), Shape2(rows_a, cols_a), lda, nullptr);
+  Tensor<cpu, 2, DType> B(const_cast<DType*>(b), Shape2(rows_b, cols_b), ldb, nullptr);
+  Tensor<cpu, 2, DType> C(c, Shape2(ta ? cols_a : rows_a, tb ? rows_b : cols_b), ldc, nullptr);
+  linalg_gemm(A, B, C, DType(1), beta, ta, tb);
+}
+
+template<typename DType>
+inline DType Sigmoid(DType x) { return DType(1) / (DType(1) + std::exp(-x)); }
+
+/*!
+ * \brief the forward of the RNN. x is (T, N, I) and y is (T, N, D * H); hx,
+ *  cx, hy and cy are (L * D, N, H), and hy and cy may be null.
+ * \param train keep the states of every layer for the backward
+ */
+template<typename DType>
+void RNNForward(const RNNShape& s, bool train, const DType* x, DType* w,
+                const DType* hx, const DType* cx, DType* y, DType* hy, DType* cy,
+                DType* reserve, DType* workspace) {
+  const int T = s.seq_length, N = s.batch_size, H = s.state_size, D = s.directions;
+  const int G = s.gates(), GH = G * H, DH = D * H, NH = N * H;
+  DType* gh = workspace;
+  DType* outputs = reserve + (train ? s.num_layers * D : 1) * s.state_space();
+  for (int l = 0; l < s.num_layers; ++l) {
+    const DType* in = l == 0 ? x : outputs + static_cast<size_t>(l - 1) * T * N * DH;
+    DType* out = l + 1 == s.num_layers ? y : outputs + static_cast<size_t>(l) * T * N * DH;
+    const int I = s.layer_input(l);
+    for (int d = 0; d < D; ++d) {
+      const int k = l * D + d;
+      LayerParams<DType> p(s, w, l, d);
+      DType* gates = reserve + (train ? k : 0) * s.state_space();
+      DType* extra = gates + static_cast<size_t>(T) * N * GH;
+      // the input projections of all the steps, with the biases outside of r * h_n
+      RNNGemm(in, T * N, I, I, false, p.wx, GH, I, I, true, gates, GH, DType(0));
+      #pragma omp parallel for
+      for (int r = 0; r < T * N; ++r) {
+        DType* g = gates + static_cast<size_t>(r) * GH;
+        const int shared = s.gru() ? 2 * H : GH;
+        for (int j = 0; j < shared; ++j) g[j] += p.bx[j] + p.bh[j];
+        for (int j = shared; j < GH; ++j) g[j] += p.bx[j];
+      }
+      for (int step = 0; step < T; ++step) {
+        const int t = d == 0 ? step : T - 1 - step;
+        const int tp = d == 0 ? t - 1 : t + 1;
+        const DType* hp = step == 0 ? hx + static_cast<size_t>(k) * NH
+                                    : out + static_cast<size_t>(tp) * N * DH + d * H;
+        const int ldh = step == 0 ? H : DH;
+        const DType* cp = nullptr;
+        if (s.lstm()) {
+          cp = step == 0 ? cx + static_cast<size_t>(k) * NH : extra + static_cast<size_t>(tp) * NH;
+        }
+        RNNGemm(hp, N, H, ldh, false, p.wh, GH, H, H, true, gh, GH, DType(0));
+        DType* g = gates + static_cast<size_t>(t) * N * GH;
+        DType* e = extra + static_cast<size_t>(t) * NH;
+        DType* h = out + static_cast<size_t>(t) * N * DH + d * H;
+        #pragma omp parallel for
+        for (int n = 0; n < N; ++n) {
+          DType* gn = g + n * GH;
+          const DType* ghn = gh + n * GH;
+          for (int j = 0; j < H; ++j) {
+            DType hn;
+            if (s.lstm()) {
+              const DType i = Sigmoid(gn[j] + ghn[j]);
+              const DType f = Sigmoid(gn[H + j] + ghn[H + j]);
+              const DType c = std::tanh(gn[2 * H + j] + ghn[2 * H + j]);
+              const DType o = Sigmoid(gn[3 * H + j] + ghn[3 * H + j]);
+              const DType cell = f * cp[n * H + j] + i * c;
+              gn[j] = i;
+              gn[H + j] = f;
+              gn[2 * H + j] = c;
+              gn[3 * H + j] = o;
+              e[n * H + j] = cell;
+              hn = o * std::tanh(cell);
+            } else if (s.gru()) {
+              const DType r = Sigmoid(gn[j] + ghn[j]);
+              const DType z = Sigmoid(gn[H + j] + ghn[H + j]);
+              const DType hh = ghn[2 * H + j] + p.bh[2 * H + j];
+              const DType c = std::tanh(gn[2 * H + j] + r * hh);
+              gn[j] = r;
+              gn[H + j] = z;
+              gn[2 * H + j] = c;
+              e[n * H + j] = hh;
+              hn = (DType(1) - z) * c + z * hp[n * ldh + j];
+            } else {
+              const DType a = gn[j] + ghn[j];
+              hn = s.mode == 0 ? std::max(a, DType(0)) : std::tanh(a);
+            }
+            h[n * DH + j] = hn;
+          }
+        }
+      }
+      // the states after the last step
+      const int last = d == 0 ? T - 1 : 0;
+      for (int n = 0; n < N; ++n) {
+        if (hy != nullptr) {
+          std::memcpy(hy + static_cast<size_t>(k) * NH + n * H,
+                      out + (static_cast<size_t>(last) * N + n) * DH + d * H, H * sizeof(DType));
+        }
+        if (cy != nullptr && s.lstm()) {
+          std::memcpy(cy + static_cast<size_t>(k) * NH + n * H,
+                      extra + static_cast<size_t>(last) * NH + n * H, H * sizeof(DType));
+        }
+      }
+    }
+  }
+}
+
+/*!
+ * \brief the backward of the RNN after a training forward, writing dx, dw,
+ *  dhx and dcx. dhy and dcy may be null for zero gradients.
+ */
+template<typename DType>
+void RNNBackward(const RNNShape& s, const DType* x, DType* w, const DType* hx,
+                 const DType* cx, const DType* y, const DType* dy, const DType* dhy,
+                 const DType* dcy, const DType* reserve, DType* dx, DType* dw, DType* dhx,
+                 DType* dcx, DType* workspace) {
+  const int T = s.seq_length, N = s.batch_size, H = s.state_size, D = s.directions;
+  const int G = s.gates(), GH = G * H, DH = D * H, NH = N * H;
+  const size_t TN = static_cast<size_t>(T) * N;
+  DType* dg = workspace;
+  DType* dgh_step = dg + TN * GH;
+  DType* dh = dgh_step + static_cast<size_t>(N) * GH;
+  DType* dc = dh + NH;
+  DType* dys[2] = {dc + NH, dc + NH + TN * DH};
+  const DType* outputs = reserve + s.num_layers * D * s.state_space();
+  size_t params = 0;
+  for (int l = 0; l < s.num_layers; ++l) {
+    params += static_cast<size_t>(D) * GH * (s.layer_input(l) + H + 2);
+  }
+  std::fill(dw, dw + params, DType(0));
+  for (int l = s.num_layers - 1; l >= 0; --l) {
+    const DType* in = l == 0 ? x : outputs + static_cast<size_t>(l - 1) * TN * DH;
+    const DType* out = l + 1 == s.num_layers ? y : outputs + static_cast<size_t>(l) * TN * DH;
+    const DType* dout = l + 1 == s.num_layers ? dy : dys[l % 2];
+    const int I = s.layer_input(l);
+    DType* din = l == 0 ? dx : dys[(l + 1) % 2];
+    std::fill(din, din + TN * I, DType(0));
+    for (int d = 0; d < D; ++d) {
+      const int k = l * D + d;
+      LayerParams<DType> p(s, w, l, d);
+      LayerParams<DType> dp(s, dw, l, d);
+      const DType* gates = reserve + k * s.state_space();
+      const DType* extra = gates + TN * GH;
+      if (dhy != nullptr) {
+        std::memcpy(dh, dhy + static_cast<size_t>(k) * NH, NH * sizeof(DType));
+      } else {
+        std::fill(dh, dh + NH, DType(0));
+      }
+      if (s.lstm() && dcy != nullptr) {
+        std::memcpy(dc, dcy + static_cast<size_t>(k) * NH, NH * sizeof(DType));
+      } else {
+        std::fill(dc, dc + NH, DType(0));
+      }
+      for (int step = T - 1; step >= 0; --step) {
+        const int t = d == 0 ? step : T - 1 - step;
+        const int tp = d == 0 ? t - 1 : t + 1;
+        const DType* hp = step == 0 ? hx + static_cast<size_t>(k) * NH
+                                    : out + static_cast<size_t>(tp) * N * DH + d * H;
+        const int ldh = step == 0 ? H : DH;
+        const DType* cp = nullptr;
+        if (s.lstm()) {
+          cp = step == 0 ? cx + static_cast<size_t>(k) * NH : extra + static_cast<size_t>(tp) * NH;
+        }
+        const DType* g = gates + static_cast<size_t>(t) * N * GH;
+        const DType* e = extra + static_cast<size_t>(t) * NH;
+        const DType* h = out + static_cast<size_t>(t) * N * DH + d * H;
+        const DType* dht = dout + static_cast<size_t>(t) * N * DH + d * H;
+        DType* dgt = dg + static_cast<size_t>(t) * N * GH;
+        // the gradient of the hidden projection differs from dgt only for the n gate of a gru
+        DType* dght = s.gru() ? dgh_step : dgt;
+        #pragma omp parallel for
+        for (int n = 0; n < N; ++n) {
+          const DType* gn = g + n * GH;
+          DType* dgn = dgt + n * GH;
+          DType* dghn = dght + n * GH;
+          for (int j = 0; j < H; ++j) {
+            const DType dhj = dht[n * DH + j] + dh[n * H + j];
+            if (s.lstm()) {
+              const DType i = gn[j], f = gn[H + j], c = gn[2 * H + j], o = gn[3 * H + j];
+              const DType tc = std::tanh(e[n * H + j]);
+              const DType dcj = dc[n * H + j] + dhj * o * (DType(1) - tc * tc);
+              dgn[j] = dcj * c * i * (DType(1) - i);
+              dgn[H + j] = dcj * cp[n * H + j] * f * (DType(1) - f);
+              dgn[2 * H + j] = dcj * i * (DType(1) - c * c);
+              dgn[3 * H + j] = dhj * tc * o * (DType(1) - o);
+              dc[n * H + j] = dcj * f;
+            } else if (s.gru()) {
+              const DType r = gn[j], z = gn[H + j], c = gn[2 * H + j], hh = e[n * H + j];
+              const DType dcand = dhj * (DType(1) - z) * (DType(1) - c * c);
+              dgn[j] = dcand * hh * r * (DType(1) - r);
+              dgn[H + j] = dhj * (hp[n * ldh + j] - c) * z * (DType(1) - z);
+              dgn[2 * H + j] = dcand;
+              dghn[j] = dgn[j];
+              dghn[H + j] = dgn[H + j];
+              dghn[2 * H + j] = dcand * r;
+              dh[n * H + j] = dhj * z;
+            } else {
+              const DType hj = h[n * DH + j];
+              dgn[j] = dhj * (s.mode == 0 ? DType(hj > DType(0)) : DType(1) - hj * hj);
+            }
+          }
+        }
+        for (int n = 0; n < N; ++n) {
+          for (int j = 0; j < GH; ++j) dp.bh[j] += dght[n * GH + j];
+        }
+        RNNGemm(dght, N, GH, GH, true, hp, N, H, ldh, false, dp.wh, H, DType(1));
+        RNNGemm(dght, N, GH, GH, false, p.wh, GH, H, H, false, dh, H,
+                s.gru() ? DType(1) : DType(0));
+      }
+      RNNGemm(dg, TN, GH, GH, true, in, TN, I, I, false, dp.wx, I, DType(1));
+      RNNGemm(dg, TN, GH, GH, false, p.wx, GH, I, I, false, din, I, DType(1));
+      for (size_t r = 0; r < TN; ++r) {
+        for (int j = 0; j < GH; ++j) dp.bx[j] += dg[r * GH + j];
+      }
+      std::memcpy(dhx + static_cast<size_t>(k) * NH, dh, NH * sizeof(DType));
+      if (s.lstm()) std::memcpy(dcx + static_cast<size_t>(k) * NH, dc, NH * sizeof(DType));
+    }
+  }
+}
+
+}  // namespace rnn
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_RNN_IMPL_H_
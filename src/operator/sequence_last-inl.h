@@ -34,9 +34,8 @@
 #include <utility>
 #include <vector>
 #include "./mshadow_op.h"
+#include "./mxnet_op.h"
 #include "./operator_common.h"
-#include "./operator_common.h"
-#include "./sequence_op_common.h"
 
 namespace mxnet {
 namespace op {
@@ -57,6 +56,49 @@ struct SequenceLastParam : public dmlc::Parameter<SequenceLastParam> {
   }
 };
 
+/*!
+ * \brief one thread for each value of the (batch, rest) output, which reads
+ *  the last step of its sequence in the (max_seq_len, batch, rest) data
+ */
+struct SequenceLastKernel {
+  template <typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType *out, const DType *in, const DType *lengths,
+                                  const index_t max_seq_len, const index_t batch,
+                                  const index_t rest, const OpReqType req) {
+    const index_t b = i / rest;
+    const index_t t = lengths ? static_cast<index_t>(lengths[b]) - 1 : max_seq_len - 1;
+    KERNEL_ASSIGN(out[i], req, in[t * batch * rest + i]);
+  }
+};
+
+/*!
+ * \brief one thread for each value of the (max_seq_len, batch, rest) data
+ *  gradient, which is the output gradient at the last step of the sequence
+ *  and 0 elsewhere
+ */
+struct SequenceLastGradKernel {
+  template <typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType *in_grad, const DType *out_grad,
+                                  const DType *lengths, const index_t max_seq_len,
+                                  const index_t batch, const index_t rest) {
+    const index_t row = i / rest;
+    const index_t b = row % batch;
+    const index_t t = lengths ? static_cast<index_t>(lengths[b]) - 1 : max_seq_len - 1;
+    in_grad[i] = row / batch == t ? out_grad[i - t * batch * rest] : DType(0);
+  }
+};
+
+/*! \brief one thread for each value of the output gradient, added to the last step */
+struct SequenceLastAddGradKernel {
+  template <typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType *in_grad, const DType *out_grad,
+                                  const DType *lengths, const index_t max_seq_len,
+                                  const index_t batch, const index_t rest) {
+    const index_t t = lengths ? static_cast<index_t>(lengths[i / rest]) - 1 : max_seq_len - 1;
+    in_grad[t * batch * rest + i] += out_grad[i];
+  }
+};
+
 template <typename xpu, typename DType>
 class SequenceLastOp : public Operator {
  public:
@@ -77,29 +119,15 @@ class SequenceLastOp : public Operator {
     index_t n = in_data[seq_last::kData].size(1);
     int max_seq_len = in_data[seq_last::kData].size(0);
     int total_size = in_data[seq_last::kData].Size();
-    Shape<2> s2 = Shape2(n, static_cast<int>(total_size / n / max_seq_len));
-    Shape<3> s3 =
-        Shape3(max_seq_len, n, static_cast<int>(total_size / n / max_seq_len));
-    Tensor<xpu, 3, DType> data =
-        in_data[seq_last::kData].get_with_shape<xpu, 3, DType>(s3, s);
-    Tensor<xpu, 2, DType> out =
-        out_data[seq_last::kOut].get_with_shape<xpu, 2, DType>(s2, s);
-
-    if (param_.use_sequence_length) {
-      std::vector<index_t> indices_vec(n, max_seq_len);
-      IndexTensorToVector(
-          in_data[seq_last::kSequenceLength].get<xpu, 1, DType>(s),
-          &indices_vec);
-      if (req[seq_last::kOut] == kWriteTo) out = 0.0f;
-      index_t seq_ind;
-      for (index_t i = 0; i < n; ++i) {
-        seq_ind = indices_vec[i] - 1;  // 1-indexing
-        out[i] += data[seq_ind][i];
-      }
-    } else {
-      Assign(out, req[seq_last::kOut],
-             F<mshadow_op::identity>(data[max_seq_len - 1]));
-    }
+    index_t rest = total_size / n / max_seq_len;
+    if (req[seq_last::kOut] == kNullOp) return;
+    const DType *lengths = param_.use_sequence_length
+                               ? in_data[seq_last::kSequenceLength].dptr<DType>()
+                               : nullptr;
+    mxnet_op::Kernel<SequenceLastKernel, xpu>::Launch(
+        s, n * rest, out_data[seq_last::kOut].dptr<DType>(),
+        in_data[seq_last::kData].dptr<DType>(), lengths, max_seq_len, n, rest,
+        req[seq_last::kOut]);
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -123,27 +151,19 @@ class SequenceLastOp : public Operator {
     index_t n = in_grad[seq_last::kData].size(1);
     int max_seq_len = in_grad[seq_last::kData].size(0);
     int total_size = in_grad[seq_last::kData].Size();
-    Shape<2> s2 = Shape2(n, static_cast<int>(total_size / n / max_seq_len));
-    Shape<3> s3 =
-        Shape3(max_seq_len, n, static_cast<int>(total_size / n / max_seq_len));
-
-    Tensor<xpu, 3, DType> data_grad =
-        in_grad[seq_last::kData].get_with_shape<xpu, 3, DType>(s3, s);
-    Tensor<xpu, 2, DType> output_grad =
-        out_grad[seq_last::kOut].get_with_shape<xpu, 2, DType>(s2, s);
-
-    // copy indices to vector
-    std::vector<index_t> indices_vec(n, max_seq_len);
-    if (param_.use_sequence_length)
-      IndexTensorToVector(
-          in_data[seq_last::kSequenceLength].get<xpu, 1, DType>(s),
-          &indices_vec);
-
-    index_t seq_ind;
-    if (req[seq_last::kData] == kWriteTo) data_grad = 0.0f;
-    for (index_t i = 0; i < n; ++i) {
-      seq_ind = indices_vec[i] - 1;
-      data_grad[seq_ind][i] += output_grad[i];
+    index_t rest = total_size / n / max_seq_len;
+    const DType *lengths = param_.use_sequence_length
+                               ? in_data[seq_last::kSequenceLength].dptr<DType>()
+                               : nullptr;
+    DType *data_grad = in_grad[seq_last::kData].dptr<DType>();
+    const DType *output_grad = out_grad[seq_last::kOut].dptr<DType>();
+    if (req[seq_last::kData] == kAddTo) {
+      // only the last steps change
+      mxnet_op::Kernel<SequenceLastAddGradKernel, xpu>::Launch(
+          s, n * rest, data_grad, output_grad, lengths, max_seq_len, n, rest);
+    } else {
+      mxnet_op::Kernel<SequenceLastGradKernel, xpu>::Launch(
+          s, max_seq_len * n * rest, data_grad, output_grad, lengths, max_seq_len, n, rest);
     }
   }
 
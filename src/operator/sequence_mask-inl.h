@@ -36,7 +36,7 @@
 #include <utility>
 #include "./operator_common.h"
 #include "./mshadow_op.h"
-#include "./operator_common.h"
+#include "./mxnet_op.h"
 
 namespace mxnet {
 namespace op {
@@ -60,6 +60,26 @@ struct SequenceMaskParam : public dmlc::Parameter<SequenceMaskParam> {
   }
 };
 
+/*!
+ * \brief one thread for each value of the (max_seq_len, batch, rest) data:
+ *  the steps of a sequence before its length are copied, the others set to
+ *  value. In place, the steps before the length are neither read nor written.
+ */
+struct SequenceMaskKernel {
+  template <typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType *out, const DType *in, const DType *lengths,
+                                  const index_t batch, const index_t rest,
+                                  const DType value, const OpReqType req) {
+    const index_t row = i / rest;
+    const index_t t = row / batch;
+    if (lengths != nullptr && t >= static_cast<index_t>(lengths[row % batch])) {
+      KERNEL_ASSIGN(out[i], req, value);
+    } else if (req != kWriteInplace) {
+      KERNEL_ASSIGN(out[i], req, in[i]);
+    }
+  }
+};
+
 template <typename xpu, typename DType>
 class SequenceMaskOp : public Operator {
  public:
@@ -81,17 +101,12 @@ class SequenceMaskOp : public Operator {
     int total_size = in_data[seq_mask::kData].Size();
     int rest_dim = static_cast<int>(total_size / n / max_seq_len);
 
-    Shape<3> s3 = Shape3(max_seq_len, n, rest_dim);
-    Tensor<xpu, 3, DType> data =
-        in_data[seq_mask::kData].get_with_shape<xpu, 3, DType>(s3, s);
-    Tensor<xpu, 3, DType> out =
-        out_data[seq_mask::kOut].get_with_shape<xpu, 3, DType>(s3, s);
-    Assign(out, req[seq_mask::kOut], F<mshadow_op::identity>(data));
-    if (param_.use_sequence_length) {
-      Tensor<xpu, 1, DType> indices =
-          in_data[seq_mask::kSequenceLength].get<xpu, 1, DType>(s);
-      SequenceMask(out, indices, static_cast<DType>(param_.value));
-    }
+    const DType *lengths = param_.use_sequence_length
+                               ? in_data[seq_mask::kSequenceLength].dptr<DType>()
+                               : nullptr;
+    sequence_mask(s, out_data[seq_mask::kOut].dptr<DType>(),
+                  in_data[seq_mask::kData].dptr<DType>(), lengths, max_seq_len, n, rest_dim,
+                  static_cast<DType>(param_.value), req[seq_mask::kOut]);
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -113,24 +128,25 @@ class SequenceMaskOp : public Operator {
     int total_size = in_grad[seq_mask::kData].Size();
     int rest_dim = static_cast<int>(total_size / n / max_seq_len);
 
-    Shape<3> s3 = Shape3(max_seq_len, n, rest_dim);
-
-    Tensor<xpu, 3, DType> data_grad =
-        in_grad[seq_mask::kData].get_with_shape<xpu, 3, DType>(s3, s);
-    Tensor<xpu, 3, DType> output_grad =
-        out_grad[seq_mask::kOut].get_with_shape<xpu, 3, DType>(s3, s);
-
-    Assign(data_grad, req[seq_mask::kData],
-           F<mshadow_op::identity>(output_grad));
-
-    if (param_.use_sequence_length) {
-      Tensor<xpu, 1, DType> indices =
-          in_data[seq_mask::kSequenceLength].get<xpu, 1, DType>(s);
-      SequenceMask(data_grad, indices, DType(0));
-    }
+    const DType *lengths = param_.use_sequence_length
+                               ? in_data[seq_mask::kSequenceLength].dptr<DType>()
+                               : nullptr;
+    sequence_mask(s, in_grad[seq_mask::kData].dptr<DType>(),
+                  out_grad[seq_mask::kOut].dptr<DType>(), lengths, max_seq_len, n, rest_dim,
+                  DType(0), req[seq_mask::kData]);
   }
 
  private:
+  void sequence_mask(mshadow::Stream<xpu> *s, DType *out, const DType *in,
+                     const DType *lengths, const index_t max_seq_len, const index_t batch,
+                     const index_t rest, const DType value, const OpReqType req) {
+    // without lengths nothing is masked, and in place nothing is left to do
+    if (req == kNullOp || (lengths == nullptr && req == kWriteInplace)) return;
+    mxnet_op::Kernel<SequenceMaskKernel, xpu>::Launch(
+        s, max_seq_len * batch * rest, out, in, lengths, batch, rest, value, req);
+  }
+
+
   SequenceMaskParam param_;
 };  // class SequenceMaskOp
 
@@ -219,9 +235,17 @@ class SequenceMaskProp : public OperatorProperty {
       return {out_grad[seq_mask::kOut]};
   }
 
-  std::vector<ResourceRequest> BackwardResource(
-      const std::vector<TShape> &in_shape) const override {
-    return {ResourceRequest::kTempSpace};
+  std::vector<std::pair<int, void *> > ForwardInplaceOption(
+      const std::vector<int> &in_data,
+      const std::vector<void *> &out_data) const override {
+    return {{in_data[seq_mask::kData], out_data[seq_mask::kOut]}};
+  }
+
+  std::vector<std::pair<int, void *> > BackwardInplaceOption(
+      const std::vector<int> &out_grad, const std::vector<int> &in_data,
+      const std::vector<int> &out_data,
+      const std::vector<void *> &in_grad) const override {
+    return {{out_grad[seq_mask::kOut], in_grad[seq_mask::kData]}};
   }
 
   Operator *CreateOperator(Context ctx) const override {
@@ -43,6 +43,9 @@ void IndexTensorToVector(mshadow::Tensor<gpu, 1, DType> data,
       cudaMemcpyAsync(temp_index, data.dptr_, max_seq_len * sizeof(DType),
                       cudaMemcpyDeviceToHost, data.stream_->stream_);
   CHECK_EQ(cuda_status, cudaSuccess) << "cuda memcpy label error";
+  // the copy is asynchronous, it must be done before the values are read
+  cuda_status = cudaStreamSynchronize(data.stream_->stream_);
+  CHECK_EQ(cuda_status, cudaSuccess) << "cuda memcpy label error";
   for (int i = 0; i < max_seq_len; ++i) {
     (*index_vec)[i] = static_cast<index_t>(temp_index[i]);
   }
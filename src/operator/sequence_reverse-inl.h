@@ -60,40 +60,25 @@ struct SequenceReverseParam : public dmlc::Parameter<SequenceReverseParam> {
   }
 };
 
+/*!
+ * \brief one thread for each value of the (max_seq_len, batch, rest) output,
+ *  which gathers its value: the steps of a sequence before its length are
+ *  reversed, the padding after it is copied as is
+ */
 struct ReverseKernel {
   template <typename DType>
   MSHADOW_XINLINE static void Map(
       const int i, DType *const out_data, const DType *const in_data,
       const OpReqType req, const index_t max_seq_len, const index_t batch_size,
-      const index_t other_dim, const index_t numel, const DType *const indices
-      ) {
-    for (index_t batch = 0; batch < batch_size; ++batch) {
-      const index_t num_seq = indices
-                                  ? static_cast<index_t>(indices[batch])
-                                  : max_seq_len;
-      const index_t padded_periods = max_seq_len - num_seq;
-      // padded part
-      if (padded_periods > 0 && i < static_cast<int>(padded_periods)) {
-        const int padded_in_offset =
-            (i + num_seq) * batch_size * other_dim + batch * other_dim;
-
-        for (index_t j = 0; j < other_dim; ++j) {
-          KERNEL_ASSIGN(out_data[padded_in_offset + j], req,
-                        in_data[padded_in_offset + j]);
-        }
-      }
-      // unpadded part
-      if (i < static_cast<int>(num_seq)) {
-        const int in_offset = i * batch_size * other_dim + batch * other_dim;
-        const int out_offset =
-            numel - (i + 1 + padded_periods) * batch_size * other_dim +
-            batch * other_dim;
-
-        for (index_t j = 0; j < other_dim; ++j) {
-          KERNEL_ASSIGN(out_data[out_offset + j], req, in_data[in_offset + j]);
-        }
-      }
-    }
+      const index_t other_dim, const DType *const indices) {
+    const index_t row = i / other_dim;
+    const index_t batch = row % batch_size;
+    const index_t t = row / batch_size;
+    const index_t num_seq =
+        indices ? static_cast<index_t>(indices[batch]) : max_seq_len;
+    const index_t src_t = t < num_seq ? num_seq - 1 - t : t;
+    KERNEL_ASSIGN(out_data[i], req,
+                  in_data[(src_t * batch_size + batch) * other_dim + i % other_dim]);
   }
 };
 
@@ -113,9 +98,10 @@ class SequenceReverseOp : public Operator {
     const index_t other_dim = data.size(2);
     const index_t tensor_numel = data.shape_.Size();
 
+    if (req == kNullOp) return;
     mxnet_op::Kernel<ReverseKernel, xpu>::Launch(
-        s, max_seq_len, out.dptr_, data.dptr_, req, max_seq_len, batch_size,
-        other_dim, tensor_numel, indices);
+        s, tensor_numel, out.dptr_, data.dptr_, req, max_seq_len, batch_size,
+        other_dim, indices);
   }
 
   virtual void Forward(const OpContext &ctx, const std::vector<TBlob> &in_data,
@@ -272,11 +258,6 @@ class SequenceReverseProp : public OperatorProperty {
       return {out_grad[seq_reverse::kOut]};
   }
 
-  std::vector<ResourceRequest> BackwardResource(
-      const std::vector<TShape> &in_shape) const override {
-    return {ResourceRequest::kTempSpace};
-  }
-
   Operator *CreateOperator(Context ctx) const override {
     LOG(FATAL) << "Not Implemented.";
     return NULL;
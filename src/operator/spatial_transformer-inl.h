@@ -98,13 +98,8 @@ class SpatialTransformerOp : public Operator {
       workspace[2][i-1] = 1.0;
     }
     Copy(grid_dst, workspace, grid_dst.stream_);
-    for (index_t batch = 0; batch < data.size(0); batch++) {
-        if (param_.transform_type == st::kAffine) {
-          grid_src[batch] = dot(loc[batch], grid_dst);
-        }
-    }
-    if (param_.sampler_type == st::kBilinear) {
-      BilinearSamplingForward(out, data, grid_src);
+    if (param_.transform_type == st::kAffine && param_.sampler_type == st::kBilinear) {
+      AffineBilinearSamplingForward(out, data, loc, grid_dst, grid_src);
     }
   }
 
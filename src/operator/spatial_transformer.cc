@@ -24,55 +24,48 @@
 */
 
 #include "./spatial_transformer-inl.h"
+#include "./nn/bilinear_sampling.h"
 
 namespace mshadow {
 template<typename DType>
-bool between(DType value, int lowerBound, int upperBound) {
-  return (value >= lowerBound && value <= upperBound);
-}
-template<typename DType>
 inline void BilinearSamplingForward(const Tensor<cpu, 4, DType> &output,
                                     const Tensor<cpu, 4, DType> &input,
                                     const Tensor<cpu, 3, DType> grid_src) {
-  DType *out = output.dptr_;
-  const DType *data = input.dptr_;
   const DType *grid = grid_src.dptr_;
-  int o_n = output.size(0), o_c = output.size(1), o_h = output.size(2), o_w = output.size(3);
-  int i_c = input.size(1), i_h = input.size(2), i_w = input.size(3);
-  for (index_t n = 0; n < static_cast<index_t>(o_n); ++n) {
-    for (index_t c = 0; c < static_cast<index_t>(o_c); ++c) {
-      for (index_t h = 0; h < static_cast<index_t>(o_h); ++h) {
-        for (index_t w = 0; w < static_cast<index_t>(o_w); ++w) {
-          index_t out_index = n * o_c * o_h * o_w + c * o_h * o_w + h * o_w + w;
-          index_t grid_index = n * o_h * o_w * 2 + h * o_w + w;
-          DType y_real = (*(grid + grid_index + o_h * o_w) + 1) * (i_h - 1) / 2;
-          DType x_real = (*(grid + grid_index) + 1) * (i_w - 1) / 2;
-          int top_left_y = static_cast<int>(floor(y_real));
-          int top_left_x = static_cast<int>(floor(x_real));
-          DType top_left_y_w = 1.0 - (y_real - top_left_y);
-          DType top_left_x_w = 1.0 - (x_real - top_left_x);
-          int data_index = n * i_c * i_h * i_w + c * i_h * i_w +
-                           top_left_y * i_w + top_left_x;
-          DType top_left_v = 0;
-          DType top_right_v = 0;
-          DType bottom_left_v = 0;
-          DType bottom_right_v = 0;
-          if (between(top_left_x, 0, i_w-1) && between(top_left_y, 0, i_h-1))
-            top_left_v = *(data + data_index);
-          if (between(top_left_x + 1, 0, i_w-1) && between(top_left_y, 0, i_h-1))
-            top_right_v = *(data + data_index + 1);
-          if (between(top_left_x, 0, i_w-1) && between(top_left_y + 1, 0, i_h-1))
-            bottom_left_v = *(data + data_index + i_w);
-          if (between(top_left_x+1, 0, i_w-1) && between(top_left_y + 1, 0, i_h-1))
-            bottom_right_v = *(data + data_index + i_w + 1);
-          *(out+out_index) = top_left_v * top_left_y_w * top_left_x_w +
-                              top_right_v * top_left_y_w * (1.0 - top_left_x_w) +
-                              bottom_left_v * (1.0 - top_left_y_w) * top_left_x_w +
-                              bottom_right_v * (1.0 - top_left_y_w) * (1.0 - top_left_x_w);
-        }
-      }
+  const int o_h = output.size(2), o_w = output.size(3);
+  // the grid is x_src then y_src of each image
+  auto grid_row = [grid, o_h, o_w](int n, int h, const DType **x_src, const DType **y_src) {
+    *x_src = grid + (n * 2 * o_h + h) * o_w;
+    *y_src = *x_src + o_h * o_w;
+  };
+  mxnet::op::bilinear::SampleForward(output.dptr_, input.dptr_, output.size(0), output.size(1),
+                                     input.size(2), input.size(3), o_h, o_w, grid_row);
+}
+
+template<typename DType>
+inline void AffineBilinearSamplingForward(const Tensor<cpu, 4, DType> &output,
+                                          const Tensor<cpu, 4, DType> &input,
+                                          const Tensor<cpu, 3, DType> &loc,
+                                          const Tensor<cpu, 2, DType> &grid_dst,
+                                          const Tensor<cpu, 3, DType> &grid_src) {
+  const int o_h = output.size(2), o_w = output.size(3);
+  // each row of grid_src is transformed from grid_dst right before it is sampled,
+  // instead of transforming the whole grid first
+  auto grid_row = [&](int n, int h, const DType **x_src, const DType **y_src) {
+    const DType *theta = loc[n].dptr_;
+    const DType *x_dst = grid_dst[0].dptr_ + h * o_w;
+    const DType *y_dst = grid_dst[1].dptr_ + h * o_w;
+    DType *x = grid_src[n][0].dptr_ + h * o_w;
+    DType *y = grid_src[n][1].dptr_ + h * o_w;
+    for (int w = 0; w < o_w; ++w) {
+      x[w] = theta[0] * x_dst[w] + theta[1] * y_dst[w] + theta[2];
+      y[w] = theta[3] * x_dst[w] + theta[4] * y_dst[w] + theta[5];
     }
-  }
+    *x_src = x;
+    *y_src = y;
+  };
+  mxnet::op::bilinear::SampleForward(output.dptr_, input.dptr_, output.size(0), output.size(1),
+                                     input.size(2), input.size(3), o_h, o_w, grid_row);
 }
 
 template<typename DType>
@@ -80,69 +73,14 @@ inline void BilinearSamplingBackward(const Tensor<cpu, 4, DType> &input_grad,
                                      const Tensor<cpu, 3, DType> &grid_src_data,
                                      const Tensor<cpu, 4, DType> &output_grad,
                                      const Tensor<cpu, 4, DType> &input_data) {
-  DType *g_input = input_grad.dptr_;
-  DType *grid_src = grid_src_data.dptr_;
-  const DType *grad = output_grad.dptr_;
-  const DType *data = input_data.dptr_;
-  int o_n = output_grad.size(0), o_c = output_grad.size(1),
-      o_h = output_grad.size(2), o_w = output_grad.size(3);
-  int i_c = input_data.size(1), i_h = input_data.size(2), i_w = input_data.size(3);
-  for (index_t n = 0; n < static_cast<index_t>(o_n); ++n) {
-     for (index_t h = 0; h < static_cast<index_t>(o_h); ++h) {
-        for (index_t w = 0; w < static_cast<index_t>(o_w); ++w) {
-          DType top_left_y_gw = 0.0;
-          DType top_left_x_gw = 0.0;
-          index_t grid_src_index = n * o_h * o_w * 2 + h * o_w + w;
-          DType y_real = (*(grid_src + grid_src_index + o_h * o_w) + 1) * (i_h - 1) / 2;
-          DType x_real = (*(grid_src + grid_src_index) + 1) * (i_w - 1) / 2;
-          index_t top_left_y = static_cast<int>(floor(y_real));
-          index_t top_left_x = static_cast<int>(floor(x_real));
-          DType top_left_y_w = 1.0 - (y_real - top_left_y);
-          DType top_left_x_w = 1.0 - (x_real - top_left_x);
-          for (index_t c = 0; c < static_cast<index_t>(o_c); ++c) {
-            index_t grad_index = n * o_c * o_h * o_w + c * o_h * o_w + h * o_w + w;
-            index_t data_index = n * i_c * i_h * i_w + c * i_h * i_w + top_left_y * i_w
-                                 + top_left_x;
-            // calc 4 vertex value in input data
-            DType top_left_v = 0;
-            DType top_right_v = 0;
-            DType bottom_left_v = 0;
-            DType bottom_right_v = 0;
-            if (between(top_left_x, 0, i_w-1) && between(top_left_y, 0, i_h-1)) {
-              *(g_input + data_index) += *(grad + grad_index) * top_left_y_w * top_left_x_w;
-              top_left_v = *(data + data_index);
-            }
-            if (between(top_left_x+1, 0, i_w-1) && between(top_left_y, 0, i_h-1)) {
-              *(g_input + data_index + 1) += *(grad + grad_index) * top_left_y_w
-                                             * (1.0 - top_left_x_w);
-              top_right_v = *(data + data_index + 1);
-            }
-            if (between(top_left_x, 0, i_w-1) && between(top_left_y+1, 0, i_h-1)) {
-              *(g_input + data_index+ i_w) += *(grad + grad_index) * (1.0 - top_left_y_w)
-                                              * top_left_x_w;
-              bottom_left_v = *(data + data_index + i_w);
-            }
-            if (between(top_left_x+1, 0, i_w-1) && between(top_left_y+1, 0, i_h-1)) {
-              *(g_input + data_index+ i_w + 1) += *(grad + grad_index) * (1.0 - top_left_y_w)
-                                                  * (1.0 - top_left_x_w);
-              bottom_right_v = *(data + data_index + i_w + 1);
-            }
-            // calc weight grad of top_left_w, then multiple -1 is the grad of grid_src
-            top_left_y_gw -= *(grad + grad_index) * (top_right_v - bottom_right_v +
-                             (top_left_v - top_right_v - bottom_left_v + bottom_right_v)
-                             * top_left_x_w);
-            top_left_x_gw -= *(grad + grad_index) * (bottom_left_v - bottom_right_v +
-                             (top_left_v - top_right_v - bottom_left_v + bottom_right_v)
-                             * top_left_y_w);
-          }
-          // calc grid_src grad
-          *(grid_src + grid_src_index + o_h * o_w) = top_left_y_gw * (i_h - 1) / 2;
-          *(grid_src + grid_src_index) = top_left_x_gw * (i_w - 1) / 2;
-        }
-      }
-    }
-  }
-
+  // the grad of the grid overwrites the grid row by row, once the row is sampled
+  mxnet::op::bilinear::SampleBackward(input_grad.dptr_, grid_src_data.dptr_, false,
+                                      output_grad.dptr_, input_data.dptr_,
+                                      grid_src_data.dptr_, output_grad.size(0),
+                                      output_grad.size(1), input_data.size(2),
+                                      input_data.size(3), output_grad.size(2),
+                                      output_grad.size(3));
+}
 }  // namespace mshadow
 
 namespace mxnet {
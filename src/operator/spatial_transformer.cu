@@ -158,6 +158,19 @@ inline void BilinearSamplingForward(const Tensor<gpu, 4, DType> &output,
       i_c, i_h, i_w, data, grid, o_n, o_c, o_h, o_w, out);
 }
 
+template<typename DType>
+inline void AffineBilinearSamplingForward(const Tensor<gpu, 4, DType> &output,
+                                          const Tensor<gpu, 4, DType> &input,
+                                          const Tensor<gpu, 3, DType> &loc,
+                                          const Tensor<gpu, 2, DType> &grid_dst,
+                                          const Tensor<gpu, 3, DType> &grid_src) {
+  using namespace expr;
+  for (index_t batch = 0; batch < input.size(0); batch++) {
+    grid_src[batch] = dot(loc[batch], grid_dst);
+  }
+  BilinearSamplingForward(output, input, grid_src);
+}
+
 template<typename DType>
 inline void BilinearSamplingBackward(const Tensor<gpu, 4, DType> &input_grad,
                                      const Tensor<gpu, 3, DType> &grid_src_data,
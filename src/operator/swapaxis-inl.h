@@ -34,6 +34,7 @@
 #include <string>
 #include <utility>
 #include "./operator_common.h"
+#include "./tensor/transpose_kernel.h"
 
 namespace mxnet {
 namespace op {
@@ -117,6 +118,12 @@ class SwapAxisOp : public Operator {
 
     Reshape2Five(&inter_shape, shape_in, dim1, dim2);
 
+    const TShape axes(Shape5(0, 3, 2, 1, 4));
+    if (transpose_kernel::TransposeTiled(s, data_in.reshape(TShape(inter_shape)), data_out,
+                                         axes)) {
+      return;
+    }
+
     Tensor<xpu, 5, DType> inter_data_in = data_in.get_with_shape<xpu, 5, DType>(inter_shape, s);
 
     Shape<5> inter_shape2 = inter_shape;
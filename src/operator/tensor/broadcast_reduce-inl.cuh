@@ -54,6 +54,23 @@ __global__ void binary_broadcast_kernel(const int N, const bool addto,
   }
 }
 
+/*!
+ * \brief an (m, n) broadcast, see BroadcastAs2D. The column steps are known at
+ *  compile time, and the reused operand is read through the read-only cache
+ */
+template<int lcol, int rcol, typename DType, typename OP>
+__launch_bounds__(kMaxThreadsPerBlock)
+__global__ void binary_broadcast_2d_kernel(const int N, const int n, const bool addto,
+                                           const DType* __restrict lhs,
+                                           const DType* __restrict rhs, DType *out,
+                                           const int lrow, const int rrow) {
+  for (int idx = blockIdx.x * blockDim.x + threadIdx.x; idx < N;
+       idx += blockDim.x * gridDim.x) {
+    const int i = idx / n, k = idx - i * n;
+    assign(&out[idx], addto, OP::Map(lhs[i * lrow + k * lcol], rhs[i * rrow + k * rcol]));
+  }
+}
+
 template<int ndim, typename DType, typename OP>
 void BinaryBroadcastComputeImpl(Stream<gpu> *s, const OpReqType req,
                                 const TBlob& lhs, const TBlob& rhs, const TBlob& out) {
@@ -63,6 +80,22 @@ void BinaryBroadcastComputeImpl(Stream<gpu> *s, const OpReqType req,
   const int warpSize = 32;
   const int unroll = 2;
   int nthread = std::min(kMaxThreadsPerBlock, ((N + warpSize - 1)/warpSize)*warpSize );
+  int m, n, lrow, lcol, rrow, rcol;
+  if (BroadcastAs2D(lhs.shape_.get<ndim>(), rhs.shape_.get<ndim>(), out.shape_.get<ndim>(),
+                    &m, &n, &lrow, &lcol, &rrow, &rcol)) {
+    const int ngrid = std::min(kBaseGridNum, (N + nthread - 1) / nthread);
+    if (lcol && rcol) {
+      binary_broadcast_2d_kernel<1, 1, DType, OP><<<ngrid, nthread, 0, stream>>>(
+        N, n, req == kAddTo, lhs.dptr<DType>(), rhs.dptr<DType>(), out.dptr<DType>(), lrow, rrow);
+    } else if (lcol) {
+      binary_broadcast_2d_kernel<1, 0, DType, OP><<<ngrid, nthread, 0, stream>>>(
+        N, n, req == kAddTo, lhs.dptr<DType>(), rhs.dptr<DType>(), out.dptr<DType>(), lrow, rrow);
+    } else {
+      binary_broadcast_2d_kernel<0, 1, DType, OP><<<ngrid, nthread, 0, stream>>>(
+        N, n, req == kAddTo, lhs.dptr<DType>(), rhs.dptr<DType>(), out.dptr<DType>(), lrow, rrow);
+    }
+    return;
+  }
   int ngrid = std::min(kBaseGridNum, (N + nthread*unroll - 1) / (nthread*unroll));
   Shape<ndim> lstride = calc_stride(lhs.shape_.get<ndim>());
   Shape<ndim> rstride = calc_stride(rhs.shape_.get<ndim>());
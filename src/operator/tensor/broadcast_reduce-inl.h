@@ -29,7 +29,9 @@
 #include <vector>
 #include <string>
 #include <utility>
+#include "../half_cpu.h"
 #include "../mshadow_op.h"
+#include "../mxnet_op.h"
 #include "../elemwise_op_common.h"
 #include "./elemwise_binary_op.h"
 #include "../operator_common.h"
@@ -154,20 +156,61 @@ MSHADOW_XINLINE void binary_broadcast_assign(const int idx, const bool addto,
   assign(&out[idx], addto, OP::Map(lhs[j], rhs[k]));
 }
 
+/*!
+ * \brief whether the compacted broadcast into oshape is an (m, n) one, each
+ *  operand being full, a row, a column or a scalar. Then an operand at row i
+ *  and column k is at i * row + k * col, with col 0 or 1. A single column is
+ *  turned into a single row, so that the rows are long
+ */
+template<int ndim>
+inline bool BroadcastAs2D(const Shape<ndim>& lshape, const Shape<ndim>& rshape,
+                          const Shape<ndim>& oshape, int* m, int* n,
+                          int* lrow, int* lcol, int* rrow, int* rcol) {
+  for (int i = 2; i < ndim; ++i) {
+    if (oshape[i] != 1) return false;
+  }
+  *m = oshape[0];
+  *n = oshape[1];
+  auto steps = [&](const Shape<ndim>& shape, int* row, int* col) {
+    *row = shape[0] == 1 ? 0 : (shape[1] == 1 ? 1 : *n);
+    *col = shape[1] == 1 ? 0 : 1;
+  };
+  steps(lshape, lrow, lcol);
+  steps(rshape, rrow, rcol);
+  if (*n == 1) {
+    std::swap(*m, *n);
+    *lcol = *lrow != 0;
+    *rcol = *rrow != 0;
+    *lrow = *rrow = 0;
+  }
+  return *m > 0 && *n > 0 && (*lcol || *rcol);
+}
+
+/*! \brief the type the cpu reductions accumulate in, float for fp16 */
+template<typename DType>
+struct ReduceAccType {
+  typedef DType type;
+};
+template<>
+struct ReduceAccType<mshadow::half::half_t> {
+  typedef float type;
+};
+
 template<typename Reducer, int ndim, typename DType, typename OP>
 MSHADOW_XINLINE void seq_reduce_assign(const int idx, const int M, const bool addto,
                                        const DType* __restrict big, DType *small,
                                        const Shape<ndim>& bshape, const Shape<ndim>& sshape,
                                        const Shape<ndim>& rshape, const Shape<ndim>& rstride) {
+  typedef typename ReduceAccType<DType>::type AType;
   Shape<ndim> coord = unravel(idx, sshape);
   int j = ravel(coord, bshape);
-  DType val;
+  AType val;
   Reducer::SetInitValue(val);
   for (int k = 0; k < M; ++k) {
     coord = unravel(k, rshape);
-    Reducer::Reduce(val, OP::Map(big[j + dot(coord, rstride)]));
+    Reducer::Reduce(val, AType(OP::Map(big[j + dot(coord, rstride)])));
   }
-  assign(&small[idx], addto, val);
+  assign(&small[idx], addto, DType(val));
 }
 
 #ifdef __CUDACC__
@@ -179,19 +222,97 @@ template<int ndim, typename DType, typename OP>
 void binary_broadcast_compute(const int N, const bool addto, const DType *lhs,
                               const DType *rhs, DType *out, const Shape<ndim> lshape,
                               const Shape<ndim> rshape, const Shape<ndim> oshape) {
+  const int nthread = mxnet_op::KernelNumThreads(N, mxnet_op::KernelGrain<OP>::Get());
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
   for (int idx = 0; idx < N; ++idx) {
     binary_broadcast_assign<ndim, DType, OP>(idx, addto, lhs, rhs, out, lshape, rshape, oshape);
   }
 }
 
+/*!
+ * \brief an (m, n) broadcast in blocks of the rows, with the column steps of
+ *  the operands known at compile time so that the inner loop vectorizes
+ */
+template<int lcol, int rcol, typename DType, typename OP>
+void binary_broadcast_2d(const int m, const int n, const bool addto,
+                         const DType* __restrict lhs, const DType* __restrict rhs,
+                         DType* __restrict out, const int lrow, const int rrow) {
+  const int kBlock = 2048;
+  const int nblock = (n + kBlock - 1) / kBlock;
+  const int nthread = mxnet_op::KernelNumThreads(m * nblock, std::max(
+      mxnet_op::KernelGrain<OP>::Get() / std::min(n, kBlock), 1));
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int t = 0; t < m * nblock; ++t) {
+    const int i = t / nblock, begin = (t % nblock) * kBlock, end = std::min(n, begin + kBlock);
+    const DType* l = lhs + i * lrow;
+    const DType* r = rhs + i * rrow;
+    DType* o = out + i * n;
+    if (addto) {
+      for (int k = begin; k < end; ++k) o[k] += OP::Map(l[k * lcol], r[k * rcol]);
+    } else {
+      for (int k = begin; k < end; ++k) o[k] = OP::Map(l[k * lcol], r[k * rcol]);
+    }
+  }
+}
+
+template<int ndim, typename OP, typename DType>
+inline void binary_broadcast_compute_cpu(const int N, const bool addto, const DType *lhs,
+                                         const DType *rhs, DType *out, const Shape<ndim> lshape,
+                                         const Shape<ndim> rshape, const Shape<ndim> oshape) {
+  int m, n, lrow, lcol, rrow, rcol;
+  if (BroadcastAs2D(lshape, rshape, oshape, &m, &n, &lrow, &lcol, &rrow, &rcol)) {
+    if (lcol && rcol) {
+      binary_broadcast_2d<1, 1, DType, OP>(m, n, addto, lhs, rhs, out, lrow, rrow);
+    } else if (lcol) {
+      binary_broadcast_2d<1, 0, DType, OP>(m, n, addto, lhs, rhs, out, lrow, rrow);
+    } else {
+      binary_broadcast_2d<0, 1, DType, OP>(m, n, addto, lhs, rhs, out, lrow, rrow);
+    }
+    return;
+  }
+  binary_broadcast_compute<ndim, DType, OP>(N, addto, lhs, rhs, out, lshape, rshape, oshape);
+}
+
+/*! \brief fp16 gathers blocks of the operands, which are computed in fp32 */
+template<int ndim, typename OP>
+inline void binary_broadcast_compute_cpu(const int N, const bool addto,
+                                         const mshadow::half::half_t *lhs,
+                                         const mshadow::half::half_t *rhs,
+                                         mshadow::half::half_t *out, const Shape<ndim> lshape,
+                                         const Shape<ndim> rshape, const Shape<ndim> oshape) {
+  using half_cpu::kHalfChunk;
+  const int nchunk = (N + kHalfChunk - 1) / kHalfChunk;
+  const int nthread = mxnet_op::KernelNumThreads(N, mxnet_op::KernelGrain<OP>::Get());
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int c = 0; c < nchunk; ++c) {
+    const int begin = c * kHalfChunk, n = std::min(kHalfChunk, N - begin);
+    mshadow::half::half_t lh[kHalfChunk], rh[kHalfChunk];
+    float a[kHalfChunk], b[kHalfChunk], o[kHalfChunk];
+    for (int i = 0; i < n; ++i) {
+      const Shape<ndim> coord = unravel(begin + i, oshape);
+      lh[i] = lhs[ravel(coord, lshape)];
+      rh[i] = rhs[ravel(coord, rshape)];
+    }
+    half_cpu::HalfToFloat(lh, a, n);
+    half_cpu::HalfToFloat(rh, b, n);
+    if (addto) {
+      half_cpu::HalfToFloat(out + begin, o, n);
+      for (int i = 0; i < n; ++i) o[i] += OP::Map(a[i], b[i]);
+    } else {
+      for (int i = 0; i < n; ++i) o[i] = OP::Map(a[i], b[i]);
+    }
+    half_cpu::FloatToHalf(o, out + begin, n);
+  }
+}
+
 template<int ndim, typename DType, typename OP>
 void BinaryBroadcastComputeImpl(Stream<cpu> *s, const OpReqType req,
                                 const TBlob& lhs, const TBlob& rhs, const TBlob& out) {
   if (req == kNullOp) return;
   int N = out.shape_.Size();
-  binary_broadcast_compute<ndim, DType, OP>(N, req == kAddTo, lhs.dptr<DType>(), rhs.dptr<DType>(),
-                           out.dptr<DType>(), lhs.shape_.get<ndim>(), rhs.shape_.get<ndim>(),
-                           out.shape_.get<ndim>());
+  binary_broadcast_compute_cpu<ndim, OP>(N, req == kAddTo, lhs.dptr<DType>(), rhs.dptr<DType>(),
+                                         out.dptr<DType>(), lhs.shape_.get<ndim>(),
+                                         rhs.shape_.get<ndim>(), out.shape_.get<ndim>());
 }
 
 template<typename Reducer, int ndim, typename DType, typename OP>
@@ -199,12 +320,150 @@ void seq_reduce_compute(const int N, const int M, const bool addto,
                         const DType *big, DType *small, const Shape<ndim> bshape,
                         const Shape<ndim> sshape, const Shape<ndim> rshape,
                         const Shape<ndim> rstride) {
+  const int nthread = mxnet_op::KernelNumThreads(N, std::max(
+      mxnet_op::KernelGrain<Reducer>::Get() / std::max(M, 1), 1));
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
   for (int idx = 0; idx < N; ++idx) {
     seq_reduce_assign<Reducer, ndim, DType, OP>(idx, M, addto, big, small, bshape, sshape, rshape,
       rstride);
   }
 }
 
+/*!
+ * \brief the accumulation of Reducer into the lanes of the contiguous
+ *  reductions. Reducer::Reduce takes volatile arguments, which keeps the
+ *  compiler from vectorizing, so the plain arithmetic reducers are spelled
+ *  out here.
+ */
+template<typename Reducer>
+struct LaneReducer {
+  template<typename DType>
+  MSHADOW_XINLINE static void Reduce(DType& dst, const DType src) {  // NOLINT(*)
+    Reducer::Reduce(dst, src);
+  }
+};
+
+template<>
+struct LaneReducer<mshadow::red::sum> {
+  template<typename DType>
+  MSHADOW_XINLINE static void Reduce(DType& dst, const DType src) {  // NOLINT(*)
+    dst += src;
+  }
+};
+
+template<>
+struct LaneReducer<mshadow_op::product> {
+  template<typename DType>
+  MSHADOW_XINLINE static void Reduce(DType& dst, const DType src) {  // NOLINT(*)
+    dst *= src;
+  }
+};
+
+/*! \brief src[0, n) as the values a reduction accumulates, converted into buf for fp16 */
+template<typename DType>
+inline const DType* ReduceLoad(const DType* src, DType* buf, const int n) {
+  return src;
+}
+
+inline const float* ReduceLoad(const mshadow::half::half_t* src, float* buf, const int n) {
+  half_cpu::HalfToFloat(src, buf, n);
+  return buf;
+}
+
+/*! \brief reduces big[0, M) in independent lanes, which are merged at the end */
+template<typename Reducer, typename DType, typename OP>
+inline typename ReduceAccType<DType>::type seq_reduce_contiguous(const DType* __restrict big,
+                                                                 const int M) {
+  typedef typename ReduceAccType<DType>::type AType;
+  const int kLanes = 8;
+  AType lane[kLanes];
+  AType buf[half_cpu::kHalfChunk];
+  for (int l = 0; l < kLanes; ++l) Reducer::SetInitValue(lane[l]);
+  int k = 0;
+  while (k + kLanes <= M) {
+    const int n = std::min(half_cpu::kHalfChunk, (M - k) / kLanes * kLanes);
+    const AType* __restrict src = ReduceLoad(big + k, buf, n);
+    for (int i = 0; i < n; i += kLanes) {
+      #pragma unroll
+      for (int l = 0; l < kLanes; ++l) {
+        LaneReducer<Reducer>::Reduce(lane[l], AType(OP::Map(src[i + l])));
+      }
+    }
+    k += n;
+  }
+  AType val = lane[0];
+  for (int l = 1; l < kLanes; ++l) Reducer::Reduce(val, lane[l]);
+  for (; k < M; ++k) Reducer::Reduce(val, AType(OP::Map(static_cast<AType>(big[k]))));
+  return val;
+}
+
+/*!
+ * \brief N reductions of M contiguous values each, the last axis reductions
+ *  and the full reduction. The outputs are split between the threads, or the
+ *  values when there are fewer outputs than threads.
+ */
+template<typename Reducer, typename DType, typename OP>
+void seq_reduce_last_axis(const int N, const int M, const bool addto,
+                          const DType* __restrict big, DType* small) {
+  typedef typename ReduceAccType<DType>::type AType;
+  const int grain = mxnet_op::KernelGrain<Reducer>::Get();
+  const int nthread = mxnet_op::KernelNumThreads(N * M, grain);
+  if (N >= nthread) {
+    #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+    for (int idx = 0; idx < N; ++idx) {
+      assign(&small[idx], addto, DType(
+             seq_reduce_contiguous<Reducer, DType, OP>(big + static_cast<size_t>(idx) * M, M)));
+    }
+    return;
+  }
+  std::vector<AType> part(nthread);
+  const int chunk = (M + nthread - 1) / nthread;
+  for (int idx = 0; idx < N; ++idx) {
+    const DType* row = big + static_cast<size_t>(idx) * M;
+    #pragma omp parallel for num_threads(nthread)
+    for (int t = 0; t < nthread; ++t) {
+      const int begin = std::min(t * chunk, M);
+      part[t] = seq_reduce_contiguous<Reducer, DType, OP>(row + begin,
+                                                          std::min(chunk, M - begin));
+    }
+    AType val = part[0];
+    for (int t = 1; t < nthread; ++t) Reducer::Reduce(val, part[t]);
+    assign(&small[idx], addto, DType(val));
+  }
+}
+
+/*!
+ * \brief the reductions over the middle axis of big viewed as (outer, M, S),
+ *  such as the first axis reductions. They run a block of the S contiguous
+ *  outputs at a time, reading big row by row.
+ */
+template<typename Reducer, typename DType, typename OP>
+void seq_reduce_mid_axis(const int outer, const int M, const int S, const bool addto,
+                         const DType* __restrict big, DType* small) {
+  typedef typename ReduceAccType<DType>::type AType;
+  const int kBlock = 256;
+  const int nblock = (S + kBlock - 1) / kBlock;
+  const int nthread = mxnet_op::KernelNumThreads(outer * M * S,
+                                                 mxnet_op::KernelGrain<Reducer>::Get());
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int b = 0; b < outer * nblock; ++b) {
+    const int o = b / nblock;
+    const int begin = (b % nblock) * kBlock;
+    const int n = std::min(kBlock, S - begin);
+    const DType* src = big + static_cast<size_t>(o) * M * S + begin;
+    AType acc[kBlock], buf[kBlock];
+    for (int s = 0; s < n; ++s) Reducer::SetInitValue(acc[s]);
+    for (int k = 0; k < M; ++k, src += S) {
+      const AType* __restrict row = ReduceLoad(src, buf, n);
+      for (int s = 0; s < n; ++s) {
+        LaneReducer<Reducer>::Reduce(acc[s], AType(OP::Map(row[s])));
+      }
+    }
+    DType* dst = small + static_cast<size_t>(o) * S + begin;
+    for (int s = 0; s < n; ++s) assign(&dst[s], addto, DType(acc[s]));
+  }
+}
+
 template<typename Reducer, int ndim, typename DType, typename OP>
 void Reduce(Stream<cpu> *s, const TBlob& small, const OpReqType req,
             const Tensor<cpu, 1, char>& workspace, const TBlob& big) {
@@ -212,9 +471,18 @@ void Reduce(Stream<cpu> *s, const TBlob& small, const OpReqType req,
   Shape<ndim> rshape, rstride;
   int mdim = diff(small.shape_.get<ndim>(), big.shape_.get<ndim>(), &rshape, &rstride);
   int N = small.shape_.Size(), M = rshape.Size();
-  seq_reduce_compute<Reducer, ndim, DType, OP>(
-    N, M, req == kAddTo, big.dptr<DType>(), small.dptr<DType>(), big.shape_.get<ndim>(),
-    small.shape_.get<ndim>(), rshape, rstride);
+  if (mdim == 1 && rstride[0] == 1) {
+    seq_reduce_last_axis<Reducer, DType, OP>(N, M, req == kAddTo, big.dptr<DType>(),
+                                             small.dptr<DType>());
+  } else if (mdim == 1) {
+    const int S = rstride[0];
+    seq_reduce_mid_axis<Reducer, DType, OP>(N / S, M, S, req == kAddTo, big.dptr<DType>(),
+                                            small.dptr<DType>());
+  } else {
+    seq_reduce_compute<Reducer, ndim, DType, OP>(
+      N, M, req == kAddTo, big.dptr<DType>(), small.dptr<DType>(), big.shape_.get<ndim>(),
+      small.shape_.get<ndim>(), rshape, rstride);
+  }
 }
 
 template<int ndim, typename DType>
@@ -268,6 +536,9 @@ void seq_reduce_compute(const int N, const int M, const bool addto,
                         const Shape<ndim> lhs_shape, const Shape<ndim> lhs_stride,
                         const Shape<ndim> rhs_shape, const Shape<ndim> rhs_stride,
                         const Shape<ndim>& lhs_shape0, const Shape<ndim>& rhs_shape0) {
+  const int nthread = mxnet_op::KernelNumThreads(N, std::max(
+      mxnet_op::KernelGrain<Reducer>::Get() / std::max(M, 1), 1));
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
   for (int idx = 0; idx < N; ++idx) {
     seq_reduce_assign<Reducer, ndim, DType, OP1, OP2>(idx, M, addto, big, lhs, rhs, small,
       big_shape, lhs_shape0, rhs_shape0, small_shape, rshape, lhs_shape, rhs_shape, rstride,
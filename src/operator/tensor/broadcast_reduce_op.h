@@ -28,6 +28,7 @@
 #include <vector>
 #include <utility>
 #include <algorithm>
+#include <cstring>
 #include "../mshadow_op.h"
 #include "../elemwise_op_common.h"
 #include "./elemwise_binary_broadcast_op.h"
@@ -461,6 +462,80 @@ void ReduceAxesBackwardUseInOut(const nnvm::NodeAttrs& attrs,
   });
 }
 
+/*!
+ * \brief out[i] of the block j = i / block of out, from the block of in at
+ *  unravel_dot(j, oshape, istride), or from its first element if fill
+ */
+struct broadcast_block {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const DType* in,
+                                  const Shape<MXNET_SPECIAL_MAX_NDIM> oshape,
+                                  const Shape<MXNET_SPECIAL_MAX_NDIM> istride,
+                                  const int block, const bool fill) {
+    const int j = i / block;
+    out[i] = in[mxnet_op::unravel_dot(j, oshape, istride) + (fill ? 0 : i - j * block)];
+  }
+};
+
+/*! \brief out = nblock blocks of block elements, see broadcast_block */
+template<typename xpu, typename DType>
+inline void BroadcastBlocks(Stream<xpu> *s, DType* out, const DType* in,
+                            const Shape<MXNET_SPECIAL_MAX_NDIM>& oshape,
+                            const Shape<MXNET_SPECIAL_MAX_NDIM>& istride,
+                            int nblock, int block, bool fill) {
+  mxnet_op::Kernel<broadcast_block, xpu>::Launch(s, nblock * block, out, in,
+                                                 oshape, istride, block, fill);
+}
+
+/*! \brief on the cpu each block is copied or filled whole */
+template<typename DType>
+inline void BroadcastBlocks(Stream<cpu> *s, DType* out, const DType* in,
+                            const Shape<MXNET_SPECIAL_MAX_NDIM>& oshape,
+                            const Shape<MXNET_SPECIAL_MAX_NDIM>& istride,
+                            int nblock, int block, bool fill) {
+  const int nthread = mxnet_op::KernelNumThreads(
+      nblock * block, mxnet_op::KernelGrain<broadcast_block>::Get());
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int j = 0; j < nblock; ++j) {
+    const DType* src = in + mxnet_op::unravel_dot(j, oshape, istride);
+    DType* dst = out + j * block;
+    if (fill) {
+      std::fill(dst, dst + block, *src);
+    } else {
+      std::memcpy(dst, src, block * sizeof(DType));
+    }
+  }
+}
+
+/*!
+ * \brief out = broadcast_to(in) by blocks of the innermost axis of the compact
+ *  shapes dst_shape and src_shape, which repeat or tile contiguous rows of in
+ * \return false if the axis is too short for the blocks to pay off
+ */
+template<typename xpu>
+inline bool BroadcastBlocksCompute(Stream<xpu> *s, const TBlob& in, const TBlob& out,
+                                   const TShape& src_shape, const TShape& dst_shape) {
+  const int kMinBlock = 16;
+  const int ndim = MXNET_SPECIAL_MAX_NDIM;
+  int last = static_cast<int>(dst_shape.ndim()) - 1;
+  while (last >= 0 && dst_shape[last] == 1) --last;
+  if (last < 0 || dst_shape[last] < kMinBlock) return false;
+  const int block = dst_shape[last];
+  const bool fill = src_shape[last] != dst_shape[last];
+  Shape<ndim> oshape, istride;
+  index_t stride = src_shape[last];
+  for (int i = ndim - 1, k = last - 1; i >= 0; --i, --k) {
+    oshape[i] = k >= 0 ? dst_shape[k] : 1;
+    istride[i] = k >= 0 && src_shape[k] == dst_shape[k] ? stride : 0;
+    if (k >= 0) stride *= src_shape[k];
+  }
+  MSHADOW_TYPE_SWITCH(out.type_flag_, DType, {
+    BroadcastBlocks(s, out.dptr<DType>(), in.dptr<DType>(), oshape, istride,
+                    static_cast<int>(out.Size() / block), block, fill);
+  });
+  return true;
+}
+
 template<typename xpu>
 inline void BroadcastComputeImpl(const nnvm::NodeAttrs& attrs,
                                  const OpContext& ctx,
@@ -473,6 +548,10 @@ inline void BroadcastComputeImpl(const nnvm::NodeAttrs& attrs,
   TShape src_shape, dst_shape;
   BroadcastReduceShapeCompact(outputs[0].shape_, small, &dst_shape, &src_shape);
   Stream<xpu> *s = ctx.get_stream<xpu>();
+  if (req[0] == kWriteTo &&
+      BroadcastBlocksCompute(s, inputs[0], outputs[0], src_shape, dst_shape)) {
+    return;
+  }
   MSHADOW_TYPE_SWITCH(outputs[0].type_flag_, DType, {
     if (dst_shape.ndim() == 2) {
       Tensor<xpu, 2, DType> out =
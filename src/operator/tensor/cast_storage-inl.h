@@ -0,0 +1,233 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file cast_storage-inl.h
+ * \brief Kernels of the casts between the storage types
+ */
+#ifndef MXNET_OPERATOR_TENSOR_CAST_STORAGE_INL_H_
+#define MXNET_OPERATOR_TENSOR_CAST_STORAGE_INL_H_
+
+#include <dmlc/parameter.h>
+#include <algorithm>
+#include <vector>
+#include "./cast_storage.h"
+#include "../mxnet_op.h"
+#include "../operator_common.h"
+
+namespace mxnet {
+namespace op {
+
+struct CastStorageParam : public dmlc::Parameter<CastStorageParam> {
+  int stype;
+  DMLC_DECLARE_PARAMETER(CastStorageParam) {
+    DMLC_DECLARE_FIELD(stype)
+    .add_enum("default", kDefaultStorage)
+    .add_enum("row_sparse", kRowSparseStorage)
+    .add_enum("csr", kCSRStorage)
+    .describe("Output storage type.");
+  }
+};
+
+/*!
+ * \brief the position of row in the sorted rows of a row sparse array,
+ *  -1 if it is not stored
+ */
+MSHADOW_XINLINE int RowSparsePosition(const int* rows, int num_rows, int row) {
+  int lo = 0, hi = num_rows - 1;
+  while (lo <= hi) {
+    const int mid = lo + (hi - lo) / 2;
+    if (rows[mid] == row) return mid;
+    if (rows[mid] < row) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return -1;
+}
+
+/*! \brief one value of a row sparse array per thread, into a zeroed dense one */
+struct rsp_to_dns {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const DType* val, const int* idx,
+                                  int width) {
+    out[idx[i / width] * width + i % width] = val[i];
+  }
+};
+
+/*! \brief one row of a csr array per thread, into a zeroed dense one */
+struct csr_to_dns {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const DType* val, const int* indptr,
+                                  const int* col, int num_cols) {
+    for (int j = indptr[i]; j < indptr[i + 1]; ++j) {
+      out[i * num_cols + col[j]] = val[j];
+    }
+  }
+};
+
+template<typename xpu>
+void CastStorageRspDnsImpl(mshadow::Stream<xpu>* s, const NDArray& rsp, const TBlob& dns) {
+  using namespace mxnet_op;
+  const int width = dns.shape_.ProdShape(1, dns.shape_.ndim());
+  MSHADOW_TYPE_SWITCH(dns.type_flag_, DType, {
+    Kernel<set_zero, xpu>::Launch(s, dns.Size(), dns.dptr<DType>());
+    const TBlob val = rsp.data();
+    if (val.Size() > 0) {
+      Kernel<rsp_to_dns, xpu>::Launch(s, val.Size(), dns.dptr<DType>(), val.dptr<DType>(),
+                                      rsp.aux_data(rowsparse::kIdx).dptr<int>(), width);
+    }
+  });
+}
+
+template<typename xpu>
+void CastStorageCsrDnsImpl(mshadow::Stream<xpu>* s, const NDArray& csr, const TBlob& dns) {
+  using namespace mxnet_op;
+  CHECK_EQ(dns.shape_.ndim(), 2U) << "csr arrays are 2-D";
+  MSHADOW_TYPE_SWITCH(dns.type_flag_, DType, {
+    Kernel<set_zero, xpu>::Launch(s, dns.Size(), dns.dptr<DType>());
+    Kernel<csr_to_dns, xpu>::Launch(s, dns.shape_[0], dns.dptr<DType>(),
+                                    csr.data().dptr<DType>(),
+                                    csr.aux_data(csr::kIndPtr).dptr<int>(),
+                                    csr.aux_data(csr::kIdx).dptr<int>(),
+                                    static_cast<int>(dns.shape_[1]));
+  });
+}
+
+/*! \brief keep the rows of dns with a non-zero, sorted */
+inline void CastStorageDnsRspImpl(mshadow::Stream<cpu>* s, const TBlob& dns, const NDArray& rsp) {
+  const int num_rows = dns.shape_[0];
+  const int width = dns.shape_.ProdShape(1, dns.shape_.ndim());
+  MSHADOW_TYPE_SWITCH(dns.type_flag_, DType, {
+    const DType* in = dns.dptr<DType>();
+    std::vector<int> rows;
+    for (int i = 0; i < num_rows; ++i) {
+      for (int j = 0; j < width; ++j) {
+        if (in[i * width + j] != DType(0)) {
+          rows.push_back(i);
+          break;
+        }
+      }
+    }
+    rsp.CheckAndAlloc({mshadow::Shape1(rows.size())});
+    int* idx = rsp.aux_data(rowsparse::kIdx).dptr<int>();
+    DType* val = rsp.data().dptr<DType>();
+    for (size_t r = 0; r < rows.size(); ++r) {
+      idx[r] = rows[r];
+      std::copy(in + rows[r] * width, in + (rows[r] + 1) * width, val + r * width);
+    }
+  });
+}
+
+inline void CastStorageDnsCsrImpl(mshadow::Stream<cpu>* s, const TBlob& dns, const NDArray& csr) {
+  CHECK_EQ(dns.shape_.ndim(), 2U) << "csr arrays are 2-D";
+  const int num_rows = dns.shape_[0];
+  const int num_cols = dns.shape_[1];
+  MSHADOW_TYPE_SWITCH(dns.type_flag_, DType, {
+    const DType* in = dns.dptr<DType>();
+    int nnz = 0;
+    for (int i = 0; i < num_rows * num_cols; ++i) {
+      if (in[i] != DType(0)) ++nnz;
+    }
+    csr.CheckAndAlloc({mshadow::Shape1(num_rows + 1), mshadow::Shape1(nnz)});
+    int* indptr = csr.aux_data(csr::kIndPtr).dptr<int>();
+    int* col = csr.aux_data(csr::kIdx).dptr<int>();
+    DType* val = csr.data().dptr<DType>();
+    indptr[0] = 0;
+    for (int i = 0, k = 0; i < num_rows; ++i) {
+      for (int j = 0; j < num_cols; ++j) {
+        if (in[i * num_cols + j] != DType(0)) {
+          col[k] = j;
+          val[k++] = in[i * num_cols + j];
+        }
+      }
+      indptr[i + 1] = k;
+    }
+  });
+}
+
+#ifdef __CUDACC__
+inline void CastStorageDnsRspImpl(mshadow::Stream<gpu>* s, const TBlob& dns, const NDArray& rsp) {
+  LOG(FATAL) << "casting a dense array to row_sparse is only implemented on the cpu";
+}
+
+inline void CastStorageDnsCsrImpl(mshadow::Stream<gpu>* s, const TBlob& dns, const NDArray& csr) {
+  LOG(FATAL) << "casting a dense array to csr is only implemented on the cpu";
+}
+#endif  // __CUDACC__
+
+template<typename xpu>
+void CastStorageComputeImpl(mshadow::Stream<xpu>* s, const NDArray& input,
+                            const NDArray& output) {
+  const NDArrayStorageType src = input.storage_type();
+  const NDArrayStorageType dst = output.storage_type();
+  CHECK_EQ(input.shape(), output.shape()) << "cast_storage changes the storage only";
+  CHECK_EQ(input.dtype(), output.dtype()) << "cast_storage changes the storage only";
+  if (src == kRowSparseStorage && dst == kDefaultStorage) {
+    CastStorageRspDnsImpl<xpu>(s, input, output.data());
+  } else if (src == kCSRStorage && dst == kDefaultStorage) {
+    CastStorageCsrDnsImpl<xpu>(s, input, output.data());
+  } else if (src == kDefaultStorage && dst == kRowSparseStorage) {
+    CastStorageDnsRspImpl(s, input.data(), output);
+  } else if (src == kDefaultStorage && dst == kCSRStorage) {
+    CastStorageDnsCsrImpl(s, input.data(), output);
+  } else {
+    LOG(FATAL) << "cast_storage from " << src << " to " << dst << " is not implemented";
+  }
+}
+
+inline bool CastStorageInferStorageType(const nnvm::NodeAttrs& attrs,
+                                        const int dev_mask,
+                                        std::vector<int>* in_attrs,
+                                        std::vector<int>* out_attrs) {
+  CHECK_EQ(in_attrs->size(), 1U);
+  CHECK_EQ(out_attrs->size(), 1U);
+  const CastStorageParam& param = nnvm::get<CastStorageParam>(attrs.parsed);
+  (*out_attrs)[0] = param.stype;
+  return true;
+}
+
+template<typename xpu>
+void CastStorageComputeEx(const nnvm::NodeAttrs& attrs,
+                          const OpContext& ctx,
+                          const std::vector<NDArray>& inputs,
+                          const std::vector<OpReqType>& req,
+                          const std::vector<NDArray>& outputs) {
+  CHECK_EQ(inputs.size(), 1U);
+  CHECK_EQ(outputs.size(), 1U);
+  if (req[0] == kNullOp) return;
+  CHECK_EQ(req[0], kWriteTo) << "cast_storage only writes its output";
+  mshadow::Stream<xpu>* s = ctx.get_stream<xpu>();
+  if (inputs[0].storage_type() == outputs[0].storage_type()) {
+    // nothing to cast, e.g. a dense input cast to dense
+    CHECK_EQ(inputs[0].storage_type(), kDefaultStorage)
+        << "cast_storage does not copy sparse arrays";
+    MSHADOW_TYPE_SWITCH(outputs[0].dtype(), DType, {
+      mshadow::Copy(outputs[0].data().FlatTo1D<xpu, DType>(s),
+                    inputs[0].data().FlatTo1D<xpu, DType>(s), s);
+    });
+    return;
+  }
+  CastStorageComputeImpl<xpu>(s, inputs[0], outputs[0]);
+}
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_TENSOR_CAST_STORAGE_INL_H_
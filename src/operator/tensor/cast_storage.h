@@ -0,0 +1,92 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file cast_storage.h
+ * \brief Casts between the dense and the sparse storage types
+ */
+#ifndef MXNET_OPERATOR_TENSOR_CAST_STORAGE_H_
+#define MXNET_OPERATOR_TENSOR_CAST_STORAGE_H_
+#include <mxnet/ndarray.h>
+#include <mxnet/op_attr_types.h>
+#include <vector>
+
+namespace mxnet {
+namespace op {
+
+/*!
+ * \brief cast input into output, which has another storage type. The casts
+ *  from dense to sparse count the non-zeros and only run on the cpu.
+ */
+template<typename xpu>
+void CastStorageDispatch(mshadow::Stream<xpu>* s, const NDArray& input, const NDArray& output);
+
+/*!
+ * \brief run an FCompute on arrays of which some are sparse. The sparse
+ *  inputs are cast to dense temporaries, and the dense results are cast
+ *  back into the sparse outputs, for the operators without sparse kernels.
+ */
+template<typename xpu>
+inline void FComputeFallback(const FCompute& fn, const nnvm::NodeAttrs& attrs,
+                             const OpContext& ctx,
+                             const std::vector<NDArray>& inputs,
+                             const std::vector<OpReqType>& req,
+                             const std::vector<NDArray>& outputs) {
+  mshadow::Stream<xpu>* s = ctx.get_stream<xpu>();
+  std::vector<TBlob> in_blobs, out_blobs;
+  std::vector<NDArray> temps;
+  for (const auto& i : inputs) {
+    if (i.storage_type() == kDefaultStorage) {
+      in_blobs.push_back(i.data());
+    } else {
+      NDArray tmp(i.shape(), i.ctx(), false, i.dtype());
+      CastStorageDispatch<xpu>(s, i, tmp);
+      temps.push_back(tmp);
+      in_blobs.push_back(tmp.data());
+    }
+  }
+  std::vector<NDArray> out_temps(outputs.size());
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    if (outputs[i].storage_type() == kDefaultStorage) {
+      out_blobs.push_back(outputs[i].data());
+    } else {
+      CHECK_NE(req[i], kAddTo) << "cannot add to a sparse output";
+      out_temps[i] = NDArray(outputs[i].shape(), outputs[i].ctx(), false, outputs[i].dtype());
+      out_blobs.push_back(out_temps[i].data());
+    }
+  }
+  fn(attrs, ctx, in_blobs, req, out_blobs);
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    if (!out_temps[i].is_none() && req[i] != kNullOp) {
+      CastStorageDispatch<xpu>(s, out_temps[i], outputs[i]);
+    }
+  }
+}
+
+/*! \return whether any of the arrays is sparse */
+inline bool HasSparse(const std::vector<NDArray>& arrays) {
+  for (const auto& a : arrays) {
+    if (a.is_sparse()) return true;
+  }
+  return false;
+}
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_TENSOR_CAST_STORAGE_H_
@@ -36,7 +36,8 @@ NNVM_REGISTER_OP(where)
                 " does not have the same shape as x, it must be a 1D array"
                 " whose size is the same as x's first dimension size. Each"
                 " row of the output array is from x's row if the corresponding"
-                " element from condition is true, and from y's row if false.")
+                " element from condition is true, and from y's row if false."
+                " A condition of shape (1,) selects the whole of x or y.")
 .set_num_inputs(3)
 .set_num_outputs(1)
 .set_attr<nnvm::FListInputNames>("FListInputNames",
@@ -45,6 +46,11 @@ NNVM_REGISTER_OP(where)
   })
 .set_attr<nnvm::FInferShape>("FInferShape", WhereOpShape)
 .set_attr<nnvm::FInferType>("FInferType", WhereOpType)
+.set_attr<nnvm::FInplaceOption>("FInplaceOption",
+  [](const NodeAttrs& attrs) {
+    return std::vector<std::pair<int, int> >{{1, 0}, {2, 0}};
+  })
+.set_attr<bool>("TIsElemwise", true)
 .set_attr<FCompute>("FCompute<cpu>", WhereOpForward<cpu>)
 .set_attr<nnvm::FGradient>("FGradient",
   // Use the following lambda function instead of ElemwiseGradUseIn
@@ -82,6 +88,7 @@ NNVM_REGISTER_OP(_backward_where)
 .set_num_inputs(2)
 .set_num_outputs(2)
 .set_attr<nnvm::TIsBackward>("TIsBackward", true)
+.set_attr<bool>("TIsElemwise", true)
 .set_attr<FCompute>("FCompute<cpu>", WhereOpBackward<cpu>);
 
 }  // namespace op
@@ -121,6 +121,9 @@ inline bool WhereOpShape(const nnvm::NodeAttrs& attrs,
   SHAPE_ASSIGN_CHECK(*in_attrs, 2, tshape);
   SHAPE_ASSIGN_CHECK(*out_attrs, 0, tshape);
 
+  const TShape& cshape = (*in_attrs)[0];
+  // a condition of one element selects the whole of x or y
+  if (cshape.ndim() == 1 && cshape[0] == 1) return true;
   if ((*in_attrs)[0].ndim() == tshape.ndim()) {
     if (!shape_assign(&tshape, (*in_attrs)[0])) return false;
     SHAPE_ASSIGN_CHECK(*in_attrs, 0, tshape);
@@ -25,13 +25,14 @@
 #define MXNET_OPERATOR_TENSOR_ELEMWISE_BINARY_OP_H_
 
 #include <mxnet/operator_util.h>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <utility>
 #include "../mxnet_op.h"
 #include "../mshadow_op.h"
 #include "../elemwise_op_common.h"
-#include "../mxnet_op.h"
+#include "../half_cpu.h"
 
 namespace mxnet {
 namespace op {
@@ -45,6 +46,35 @@ struct BinaryOp {
   }
 };
 
+/*! \brief out[i] = OP(lhs[i], rhs[i]) for i in [0, size) */
+template<typename OP, int Req, typename xpu, typename DType>
+inline void BinaryOpLaunch(mshadow::Stream<xpu> *s, const int size, DType* out,
+                           const DType* lhs, const DType* rhs) {
+  mxnet_op::Kernel<BinaryOp<OP, Req>, xpu>::Launch(s, size, out, lhs, rhs);
+}
+
+/*! \brief the cpu fp16 version converts blocks of the operands and computes them in fp32 */
+template<typename OP, int Req>
+inline void BinaryOpLaunch(mshadow::Stream<cpu> *s, const int size, mshadow::half::half_t* out,
+                           const mshadow::half::half_t* lhs, const mshadow::half::half_t* rhs) {
+  using half_cpu::kHalfChunk;
+  const int nchunk = (size + kHalfChunk - 1) / kHalfChunk;
+  const int nthread = mxnet_op::KernelNumThreads(
+      size, mxnet_op::KernelGrain<BinaryOp<OP, Req> >::Get());
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int c = 0; c < nchunk; ++c) {
+    const int begin = c * kHalfChunk, n = std::min(kHalfChunk, size - begin);
+    float a[kHalfChunk], b[kHalfChunk], o[kHalfChunk];
+    half_cpu::HalfToFloat(lhs + begin, a, n);
+    half_cpu::HalfToFloat(rhs + begin, b, n);
+    if (Req == kAddTo) half_cpu::HalfToFloat(out + begin, o, n);
+    for (int i = 0; i < n; ++i) {
+      KERNEL_ASSIGN(o[i], Req, OP::Map(a[i], b[i]));
+    }
+    half_cpu::FloatToHalf(o, out + begin, n);
+  }
+}
+
 template<typename xpu, typename OP, typename DType>
 void BinaryCompute_(const nnvm::NodeAttrs& attrs,
                     const OpContext& ctx,
@@ -60,7 +90,7 @@ void BinaryCompute_(const nnvm::NodeAttrs& attrs,
   DType* lhs_dptr = inputs[0].dptr<DType>();
   DType* rhs_dptr = inputs[1].dptr<DType>();
   MXNET_ASSIGN_REQ_SWITCH(req[0], Req, {
-    Kernel<BinaryOp<OP, Req>, xpu>::Launch(s, size, out_dptr, lhs_dptr, rhs_dptr);
+    BinaryOpLaunch<OP, Req>(s, size, out_dptr, lhs_dptr, rhs_dptr);
   });
 }
 
@@ -228,6 +258,7 @@ void BinaryBackwardUseInWithHalf2(const nnvm::NodeAttrs& attrs,
     })                                                              \
   .set_attr<nnvm::FInferShape>("FInferShape", ElemwiseShape<2, 1>)  \
   .set_attr<nnvm::FInferType>("FInferType", ElemwiseType<2, 1>)     \
+  .set_attr<bool>("TIsElemwise", true)                              \
   .set_attr<nnvm::FInplaceOption>("FInplaceOption",                 \
     [](const NodeAttrs& attrs){                                     \
       return std::vector<std::pair<int, int> >{{0, 0}, {1, 0}};     \
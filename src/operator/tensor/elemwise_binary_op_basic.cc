@@ -23,19 +23,36 @@
  */
 #include "./elemwise_unary_op.h"
 #include "./elemwise_binary_op.h"
+#if MXNET_USE_MKL2017 == 1
+#include <mkl_memory.h>
+#include "../mkl/mkl_memory-inl.h"
+#include "../mkl/mkl_elementwise_sum-inl.h"
+#endif  // MXNET_USE_MKL2017
 
 namespace mxnet {
 namespace op {
+void ElemwiseAddComputeCPU(const nnvm::NodeAttrs& attrs,
+                           const OpContext& ctx,
+                           const std::vector<TBlob>& inputs,
+                           const std::vector<OpReqType>& req,
+                           const std::vector<TBlob>& outputs) {
+#if MKL_EXPERIMENTAL == 1
+  // the outputs of mkl operators are added without leaving their layout
+  if (MKLPrvElementWiseSum(inputs, req[0], outputs[0])) return;
+#endif
+  BinaryCompute<cpu, mshadow::op::plus>(attrs, ctx, inputs, req, outputs);
+}
+
 MXNET_OPERATOR_REGISTER_BINARY(elemwise_add)
 .add_alias("_add").add_alias("_plus").add_alias("_Plus")
 .describe("Adds arguments element-wise.")
-.set_attr<FCompute>("FCompute<cpu>", BinaryCompute<cpu, mshadow::op::plus>)
+.set_attr<FCompute>("FCompute<cpu>", ElemwiseAddComputeCPU)
 .set_attr<nnvm::FGradient>("FGradient", CloneGradient{"_backward_add"});
 
 // specialized gradient add function to do add to optimization
 // this must differ from elemwise_add to prevent add to optimization in forward pass.
 MXNET_OPERATOR_REGISTER_BINARY(_grad_add)
-.set_attr<FCompute>("FCompute<cpu>", BinaryCompute<cpu, mshadow::op::plus>);
+.set_attr<FCompute>("FCompute<cpu>", ElemwiseAddComputeCPU);
 
 NNVM_REGISTER_OP(_backward_add)
 .set_num_inputs(1)
@@ -22,6 +22,11 @@
  * \brief elementwise sum operator
 */
 #include "./elemwise_sum.h"
+#if MXNET_USE_MKL2017 == 1
+#include <mkl_memory.h>
+#include "../mkl/mkl_memory-inl.h"
+#include "../mkl/mkl_elementwise_sum-inl.h"
+#endif  // MXNET_USE_MKL2017
 
 namespace mxnet {
 namespace op {
@@ -54,6 +59,18 @@ std::vector<nnvm::NodeEntry> ElementWiseSumGrad(
   return ret;
 }
 
+void ElementWiseSumComputeCPU(const nnvm::NodeAttrs& attrs,
+                              const OpContext& ctx,
+                              const std::vector<TBlob>& inputs,
+                              const std::vector<OpReqType>& req,
+                              const std::vector<TBlob>& outputs) {
+#if MKL_EXPERIMENTAL == 1
+  // the outputs of mkl operators are summed without leaving their layout
+  if (MKLPrvElementWiseSum(inputs, req[0], outputs[0])) return;
+#endif
+  ElementWiseSumCompute<cpu>(attrs, ctx, inputs, req, outputs);
+}
+
 NNVM_REGISTER_OP(add_n)
 .add_alias("ElementWiseSum")
 .describe(R"doc(Adds all input arguments element-wise.
@@ -78,7 +95,7 @@ NNVM_REGISTER_OP(add_n)
     return ret;
   })
 .set_attr<std::string>("key_var_num_args", "num_args")
-.set_attr<FCompute>("FCompute<cpu>", ElementWiseSumCompute<cpu>)
+.set_attr<FCompute>("FCompute<cpu>", ElementWiseSumComputeCPU)
 .set_attr<nnvm::FInplaceOption>(
     "FInplaceOption", [](const NodeAttrs& attrs) {
       return std::vector<std::pair<int, int> >{{0, 0}};
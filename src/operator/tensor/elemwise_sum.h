@@ -26,6 +26,7 @@
 #define MXNET_OPERATOR_TENSOR_ELEMWISE_SUM_H_
 
 #include <dmlc/logging.h>
+#include <algorithm>
 #include <cstring>
 #include <vector>
 #include "../operator_common.h"
@@ -52,6 +53,67 @@ struct Sum {
   }
 };
 
+/*! \brief the inputs of a sum, passed to the kernels by value */
+template<typename DType>
+struct SumInputs {
+  static const int kMaxInputs = 16;
+  const DType* dptr[kMaxInputs];
+  int num;
+};
+
+/*! \brief sum of the inputs in one pass, an element per i */
+template<int req>
+struct SumN {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const SumInputs<DType> in) {
+    DType sum = in.dptr[0][i];
+    for (int j = 1; j < in.num; ++j) {
+      sum = sum + in.dptr[j][i];
+    }
+    KERNEL_ASSIGN(out[i], req, sum);
+  }
+};
+
+/*! \brief as SumN, kBlock elements per i, so that the loops over the elements vectorize */
+template<int req>
+struct SumNBlock {
+  static const int kBlock = 512;
+  // a grain of 4096 elements, as the elementwise kernels
+  static const int kCPUGrain = 8;
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const SumInputs<DType> in, int size) {
+    const int begin = i * kBlock;
+    const int n = size - begin < kBlock ? size - begin : kBlock;
+    DType acc[kBlock];
+    const DType* in0 = in.dptr[0] + begin;
+    for (int k = 0; k < n; ++k) {
+      acc[k] = in0[k];
+    }
+    for (int j = 1; j < in.num; ++j) {
+      const DType* src = in.dptr[j] + begin;
+      for (int k = 0; k < n; ++k) {
+        acc[k] = acc[k] + src[k];
+      }
+    }
+    for (int k = 0; k < n; ++k) {
+      KERNEL_ASSIGN(out[begin + k], req, acc[k]);
+    }
+  }
+};
+
+template<int req, typename xpu, typename DType>
+inline void LaunchSumN(mshadow::Stream<xpu> *s, int size, DType* out,
+                       const SumInputs<DType>& in) {
+  mxnet_op::Kernel<SumN<req>, xpu>::Launch(s, size, out, in);
+}
+
+template<int req, typename DType>
+inline void LaunchSumN(mshadow::Stream<cpu> *s, int size, DType* out,
+                       const SumInputs<DType>& in) {
+  const int kBlock = SumNBlock<req>::kBlock;
+  mxnet_op::Kernel<SumNBlock<req>, cpu>::Launch(s, (size + kBlock - 1) / kBlock, out, in, size);
+}
+
 template<typename xpu, typename DType>
 void ElementWiseSumCompute_(const nnvm::NodeAttrs& attrs,
                             const OpContext& ctx,
@@ -89,11 +151,18 @@ void ElementWiseSumCompute_(const nnvm::NodeAttrs& attrs,
       break;
     }
     default: {
-      DType* in_0_dptr = in_data[0].dptr<DType>();
-      Kernel<Sum, xpu>::Launch(s, out_size, out_dptr, req[0], in_0_dptr);
-      for (size_t i = 1; i < size; ++i) {
-        DType* in_dptr = in_data[i].dptr<DType>();
-        Kernel<Sum, xpu>::Launch(s, out_size, out_dptr, req[0], out_dptr, in_dptr);
+      // one pass per SumInputs::kMaxInputs inputs, the later ones adding to out
+      SumInputs<DType> in;
+      OpReqType out_req = req[0];
+      for (size_t begin = 0; begin < size; begin += in.kMaxInputs) {
+        in.num = static_cast<int>(std::min<size_t>(in.kMaxInputs, size - begin));
+        for (int j = 0; j < in.num; ++j) {
+          in.dptr[j] = in_data[begin + j].dptr<DType>();
+        }
+        MXNET_ASSIGN_REQ_SWITCH(out_req, req_type, {
+          LaunchSumN<req_type>(s, out_size, out_dptr, in);
+        });
+        out_req = kAddTo;
       }
       break;
     }
@@ -25,11 +25,13 @@
 #define MXNET_OPERATOR_TENSOR_ELEMWISE_UNARY_OP_H_
 
 #include <mxnet/operator_util.h>
+#include <algorithm>
 #include <vector>
 #include <utility>
 #include "../mxnet_op.h"
 #include "../mshadow_op.h"
 #include "../elemwise_op_common.h"
+#include "../half_cpu.h"
 #include "../special_functions-inl.h"
 
 namespace mxnet {
@@ -60,6 +62,42 @@ struct unary_bwd {
   }
 };
 
+/*! \brief out = OP(in), flattened */
+template<typename OP, typename xpu, typename DType>
+inline void UnaryOpAssign(mshadow::Stream<xpu> *s, const OpReqType req, const TBlob& in,
+                          const TBlob& out, DType*) {
+  using namespace mshadow::expr;
+  mshadow::Tensor<xpu, 1, DType> dst = out.FlatTo1D<xpu, DType>(s);
+  ASSIGN_DISPATCH(dst, req, F<OP>(in.FlatTo1D<xpu, DType>(s)));
+}
+
+/*! \brief the cpu fp16 version converts blocks of the input and computes them in fp32 */
+template<typename OP>
+inline void UnaryOpAssign(mshadow::Stream<cpu> *s, const OpReqType req, const TBlob& in,
+                          const TBlob& out, mshadow::half::half_t*) {
+  using half_cpu::kHalfChunk;
+  using mshadow::half::half_t;
+  if (req == kNullOp) return;
+  const int size = static_cast<int>(out.Size());
+  const half_t* src = in.dptr<half_t>();
+  half_t* dst = out.dptr<half_t>();
+  const int nchunk = (size + kHalfChunk - 1) / kHalfChunk;
+  const int nthread = mxnet_op::KernelNumThreads(size, mxnet_op::KernelGrain<OP>::Get());
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int c = 0; c < nchunk; ++c) {
+    const int begin = c * kHalfChunk, n = std::min(kHalfChunk, size - begin);
+    float a[kHalfChunk], o[kHalfChunk];
+    half_cpu::HalfToFloat(src + begin, a, n);
+    if (req == kAddTo) {
+      half_cpu::HalfToFloat(dst + begin, o, n);
+      for (int i = 0; i < n; ++i) o[i] += OP::Map(a[i]);
+    } else {
+      for (int i = 0; i < n; ++i) o[i] = OP::Map(a[i]);
+    }
+    half_cpu::FloatToHalf(o, dst + begin, n);
+  }
+}
+
 template<typename xpu, typename OP>
 void UnaryCompute(const nnvm::NodeAttrs& attrs,
                   const OpContext& ctx,
@@ -67,11 +105,9 @@ void UnaryCompute(const nnvm::NodeAttrs& attrs,
                   const std::vector<OpReqType>& req,
                   const std::vector<TBlob>& outputs) {
   using namespace mshadow;
-  using namespace mshadow::expr;
   Stream<xpu> *s = ctx.get_stream<xpu>();
   MSHADOW_TYPE_SWITCH(outputs[0].type_flag_, DType, {
-    Tensor<xpu, 1, DType> out = outputs[0].FlatTo1D<xpu, DType>(s);
-    ASSIGN_DISPATCH(out, req[0], F<OP>(inputs[0].FlatTo1D<xpu, DType>(s)));
+    UnaryOpAssign<OP>(s, req[0], inputs[0], outputs[0], static_cast<DType*>(nullptr));
   });
 }
 
@@ -119,6 +155,45 @@ inline bool CastType(const nnvm::NodeAttrs& attrs,
   return (*in_attrs)[0] != -1;
 }
 
+template<typename xpu, typename DstDType, typename SrcDType>
+inline void CastAssign(mshadow::Stream<xpu> *s, const OpReqType req, const TBlob& in,
+                       const TBlob& out, DstDType*, SrcDType*) {
+  using namespace mshadow::expr;
+  mshadow::Tensor<xpu, 1, DstDType> dst = out.FlatTo1D<xpu, DstDType>(s);
+  Assign(dst, req, tcast<DstDType>(in.FlatTo1D<xpu, SrcDType>(s)));
+}
+
+/*! \brief the cpu casts between fp16 and fp32 convert in bulk */
+template<typename DstDType, typename SrcDType>
+inline void CastHalfCPU(mshadow::Stream<cpu> *s, const OpReqType req, const TBlob& in,
+                        const TBlob& out) {
+  if (req != kWriteTo && req != kWriteInplace) {
+    CastAssign<cpu, DstDType, SrcDType>(s, req, in, out, nullptr, nullptr);
+    return;
+  }
+  const int size = static_cast<int>(out.Size());
+  const SrcDType* src = in.dptr<SrcDType>();
+  DstDType* dst = out.dptr<DstDType>();
+  const int nthread = mxnet_op::KernelNumThreads(size, mxnet_op::KernelGrain<CastParam>::Get());
+  const int chunk = (size + nthread - 1) / nthread;
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int t = 0; t < nthread; ++t) {
+    const int begin = std::min(t * chunk, size);
+    const int n = std::min(chunk, size - begin);
+    half_cpu::Convert(src + begin, dst + begin, n);
+  }
+}
+
+inline void CastAssign(mshadow::Stream<cpu> *s, const OpReqType req, const TBlob& in,
+                       const TBlob& out, float*, mshadow::half::half_t*) {
+  CastHalfCPU<float, mshadow::half::half_t>(s, req, in, out);
+}
+
+inline void CastAssign(mshadow::Stream<cpu> *s, const OpReqType req, const TBlob& in,
+                       const TBlob& out, mshadow::half::half_t*, float*) {
+  CastHalfCPU<mshadow::half::half_t, float>(s, req, in, out);
+}
+
 template<typename xpu>
 void CastCompute(const nnvm::NodeAttrs& attrs,
                  const OpContext& ctx,
@@ -129,10 +204,9 @@ void CastCompute(const nnvm::NodeAttrs& attrs,
   using namespace mshadow::expr;
   Stream<xpu> *s = ctx.get_stream<xpu>();
   MSHADOW_TYPE_SWITCH(outputs[0].type_flag_, DstDType, {
-    Tensor<xpu, 1, DstDType> out = outputs[0].FlatTo1D<xpu, DstDType>(s);
     MSHADOW_TYPE_SWITCH(inputs[0].type_flag_, SrcDType, {
-      Tensor<xpu, 1, SrcDType> data = inputs[0].FlatTo1D<xpu, SrcDType>(s);
-      Assign(out, req[0], tcast<DstDType>(data));
+      CastAssign(s, req[0], inputs[0], outputs[0], static_cast<DstDType*>(nullptr),
+                 static_cast<SrcDType*>(nullptr));
     });
   });
 }
@@ -178,6 +252,7 @@ struct relu_grad {
   .set_num_outputs(1)                                               \
   .set_attr<nnvm::FInferShape>("FInferShape", ElemwiseShape<1, 1>)  \
   .set_attr<nnvm::FInferType>("FInferType", ElemwiseType<1, 1>)     \
+  .set_attr<bool>("TIsElemwise", true)                              \
   .set_attr<nnvm::FInplaceOption>("FInplaceOption",                 \
     [](const NodeAttrs& attrs){                                     \
       return std::vector<std::pair<int, int> >{{0, 0}};             \
@@ -38,7 +38,7 @@ namespace mxnet {
 namespace op {
 const int kWarpSize = 32;
 
-template<int SZ, typename DType, typename IdxType>
+template<int SZ, typename DType, typename IdxType, typename AType>
 __global__ void AddTakeGradLargeBatchKernel(DType* dst,
                                            // If idx_start == NULL, then in-kernel edge
                                            // detection is used
@@ -48,9 +48,9 @@ __global__ void AddTakeGradLargeBatchKernel(DType* dst,
                                            const IdxType *sorted, const IdxType *index,
                                            const DType *src,
                                            int ymax, int xmax) {
-  // Size of the shared memory is [blockDim.x*SZ*blockDim.y]*sizeof(DType)
+  // Size of the shared memory is [blockDim.x*SZ*blockDim.y]*sizeof(AType)
   extern __shared__ char sh_grad_weight_char[];
-  DType* sh_grad_weight = (DType*)sh_grad_weight_char;
+  AType* sh_grad_weight = (AType*)sh_grad_weight_char;
 
   int iidx_end = (idx_start == NULL) ? ymax : *idx_start_size_ptr;
 
@@ -132,10 +132,10 @@ __global__ void AddTakeGradLargeBatchKernel(DType* dst,
     int idx1 = idx_begin + (threadIdx.y + 1)*num_idx/blockDim.y;
 
     // Read and sum data into grad_weight[]
-    DType grad_weight[SZ];
+    AType grad_weight[SZ];
     #pragma unroll
     for (int ii = 0; ii < SZ; ii++) {
-      grad_weight[ii] = (DType)0;
+      grad_weight[ii] = (AType)0;
     }
     for (int idx=idx0; idx < idx1;idx++) {
       const int src_row = static_cast<int>(index[idx]) * xmax;
@@ -145,7 +145,7 @@ __global__ void AddTakeGradLargeBatchKernel(DType* dst,
         int feature_dim = start_feature + ii * blockDim.x;
         if (feature_dim < xmax)
         {
-          grad_weight[ii] += src[src_row + feature_dim];
+          grad_weight[ii] += static_cast<AType>(src[src_row + feature_dim]);
         }
       }
     }
@@ -156,11 +156,11 @@ __global__ void AddTakeGradLargeBatchKernel(DType* dst,
     __syncthreads();
     // We now have grad_weight[] values, reduce within thread block
     for (int t=1;t < blockDim.y;t <<= 1) {
-      DType tmp[SZ];
+      AType tmp[SZ];
       #pragma unroll
       for (int ii = 0; ii < SZ; ii++) {
         tmp[ii] = (threadIdx.y + t < blockDim.y) ?
-          sh_grad_weight[threadIdx.x + ii*blockDim.x + (threadIdx.y + t)*blockDim.x*SZ] : (DType)0;
+          sh_grad_weight[threadIdx.x + ii*blockDim.x + (threadIdx.y + t)*blockDim.x*SZ] : (AType)0;
       }
       __syncthreads();
       #pragma unroll
@@ -175,7 +175,9 @@ __global__ void AddTakeGradLargeBatchKernel(DType* dst,
       for (int ii = 0; ii < SZ; ii++) {
         int feature_dim = start_feature + ii * blockDim.x;
         if (feature_dim < xmax) {
-          dst[dst_row + feature_dim] += sh_grad_weight[threadIdx.x + ii*blockDim.x];
+          dst[dst_row + feature_dim] = static_cast<DType>(
+            static_cast<AType>(dst[dst_row + feature_dim]) +
+            sh_grad_weight[threadIdx.x + ii*blockDim.x]);
         }
       }
     }
@@ -260,8 +262,10 @@ inline void AddTakeGradLargeBatch(mshadow::Tensor<gpu, 2, DType> dst,
   const int grid_dim_y = min(num_unique_est, mshadow::cuda::kBaseGridNum);
   dim3 dimBlock(block_dim_x, block_dim_y);
   dim3 dimGrid(grid_dim_x, grid_dim_y);
-  // Maximum shared memory usage: 128*4*sizeof(DType), which is 4K for 64bit DType elements
-  int shmem_size = dimBlock.x*SZ*dimBlock.y*sizeof(DType);
+  // fp16 is summed in float
+  typedef typename EmbeddingAccType<DType>::type AType;
+  // Maximum shared memory usage: 128*4*sizeof(AType), which is 4K for 64bit AType elements
+  int shmem_size = dimBlock.x*SZ*dimBlock.y*sizeof(AType);
 
   CHECK_EQ(dst.size(1), src.size(1)) << "AddTakeGradLargeBatch: shape mismatch";
   CHECK_EQ(index.size(0), src.size(0)) << "AddTakeGradLargeBatch: shape mismatch";
@@ -269,7 +273,7 @@ inline void AddTakeGradLargeBatch(mshadow::Tensor<gpu, 2, DType> dst,
 
   switch (SZ) {
     case 1:
-    AddTakeGradLargeBatchKernel<1, DType>
+    AddTakeGradLargeBatchKernel<1, DType, IndexType, AType>
         <<<dimGrid, dimBlock, shmem_size, stream>>>
         (dst.dptr_, sum_counts_ptr, num_runs_ptr,
          sorted.dptr_, index.dptr_, src.dptr_,
@@ -277,7 +281,7 @@ inline void AddTakeGradLargeBatch(mshadow::Tensor<gpu, 2, DType> dst,
          static_cast<int>(src.size(1)));
     break;
     case 2:
-    AddTakeGradLargeBatchKernel<2, DType>
+    AddTakeGradLargeBatchKernel<2, DType, IndexType, AType>
         <<<dimGrid, dimBlock, shmem_size, stream>>>
         (dst.dptr_, sum_counts_ptr, num_runs_ptr,
          sorted.dptr_, index.dptr_, src.dptr_,
@@ -285,7 +289,7 @@ inline void AddTakeGradLargeBatch(mshadow::Tensor<gpu, 2, DType> dst,
          static_cast<int>(src.size(1)));
     break;
     case 3:
-    AddTakeGradLargeBatchKernel<3, DType>
+    AddTakeGradLargeBatchKernel<3, DType, IndexType, AType>
         <<<dimGrid, dimBlock, shmem_size, stream>>>
         (dst.dptr_, sum_counts_ptr, num_runs_ptr,
          sorted.dptr_, index.dptr_, src.dptr_,
@@ -293,7 +297,7 @@ inline void AddTakeGradLargeBatch(mshadow::Tensor<gpu, 2, DType> dst,
          static_cast<int>(src.size(1)));
     break;
     case 4:
-    AddTakeGradLargeBatchKernel<4, DType>
+    AddTakeGradLargeBatchKernel<4, DType, IndexType, AType>
         <<<dimGrid, dimBlock, shmem_size, stream>>>
         (dst.dptr_, sum_counts_ptr, num_runs_ptr,
          sorted.dptr_, index.dptr_, src.dptr_,
@@ -307,6 +311,101 @@ inline void AddTakeGradLargeBatch(mshadow::Tensor<gpu, 2, DType> dst,
   MSHADOW_CUDA_POST_KERNEL_CHECK(AddTakeGradLargeBatchKernel);
 }
 
+/*!
+ * \brief dst[u] = the sum of src[index[p]] over the run [start[u], start[u] + count[u])
+ *  of the sorted indices, a row of dst per thread block row and its features
+ *  over the threads of the block, so that no two threads write the same value
+ */
+template<typename DType, typename AType>
+__global__ void EmbeddingRspGradKernel(DType* dst, const int* start, const int* count,
+                                       const int* index, const DType* src,
+                                       const int nrow, const int ncol) {
+  const int feature_dim = threadIdx.x + blockIdx.x * blockDim.x;
+  if (feature_dim >= ncol) return;
+  for (int u = blockIdx.y; u < nrow; u += gridDim.y) {
+    const int begin = start[u];
+    const int end = begin + count[u];
+    AType sum = 0;
+    for (int p = begin; p < end; ++p) {
+      sum += static_cast<AType>(src[index[p] * ncol + feature_dim]);
+    }
+    dst[u * ncol + feature_dim] = static_cast<DType>(sum);
+  }
+}
+
+inline void EmbeddingBackwardRspImpl(const OpContext& ctx, mshadow::Stream<gpu>* s,
+                                     const TBlob& ograd, const TBlob& data, OpReqType req,
+                                     const NDArray& grad) {
+  using namespace mshadow;
+  using namespace mshadow::expr;
+  using namespace mxnet_op;
+  if (req == kNullOp) return;
+  CHECK_EQ(req, kWriteTo) << "the row sparse gradient of Embedding can only be written";
+  const int K = grad.shape()[0];
+  const int M = grad.shape()[1];
+  const int N = data.Size();
+  if (N == 0) {
+    grad.CheckAndAlloc({Shape1(0)});
+    return;
+  }
+  cudaStream_t stream = Stream<gpu>::GetStream(s);
+  size_t encode_bytes = 0;
+  cub::DeviceRunLengthEncode::Encode<int*, int*, int*, int*>
+    (NULL, encode_bytes, NULL, NULL, NULL, NULL, N, stream);
+  size_t exclusivesum_bytes = 0;
+  cub::DeviceScan::ExclusiveSum<int*, int*>(NULL, exclusivesum_bytes, NULL, NULL, N, stream);
+  const size_t temporary_bytes = std::max(std::max(encode_bytes, exclusivesum_bytes),
+                                          SortByKeyWorkspaceSize<int, int, gpu>(N));
+  const size_t idx_bytes = N * sizeof(int);
+
+  // workspace = [sorted, index, unique, counts, starts, num_runs, temporary_storage]
+  Tensor<gpu, 1, char> workspace =
+    ctx.requested[embedding::kTempSpace].get_space_typed<gpu, 1, char>(
+      Shape1(5 * idx_bytes + sizeof(int) + temporary_bytes), s);
+  Tensor<gpu, 1, int> sorted(reinterpret_cast<int*>(workspace.dptr_), Shape1(N), s);
+  Tensor<gpu, 1, int> index(reinterpret_cast<int*>(workspace.dptr_ + idx_bytes), Shape1(N), s);
+  int* unique_ptr = reinterpret_cast<int*>(workspace.dptr_ + 2 * idx_bytes);
+  int* counts_ptr = reinterpret_cast<int*>(workspace.dptr_ + 3 * idx_bytes);
+  int* starts_ptr = reinterpret_cast<int*>(workspace.dptr_ + 4 * idx_bytes);
+  int* num_runs_ptr = reinterpret_cast<int*>(workspace.dptr_ + 5 * idx_bytes);
+  Tensor<gpu, 1, char> temp_storage(workspace.dptr_ + 5 * idx_bytes + sizeof(int),
+                                    Shape1(temporary_bytes), s);
+
+  // group the positions of the batch by row
+  MSHADOW_TYPE_SWITCH(data.type_flag_, IType, {
+    Kernel<tcast_clip, gpu>::Launch(s, N, sorted.dptr_, data.dptr<IType>(), K);
+  });
+  index = range<int>(0, N);
+  SortByKey(sorted, index, true, &temp_storage, 0, ilog2(K - 1));
+  size_t encode_storage_bytes = temporary_bytes;
+  cub::DeviceRunLengthEncode::Encode<int*, int*, int*, int*>
+    (temp_storage.dptr_, encode_storage_bytes, sorted.dptr_, unique_ptr, counts_ptr,
+     num_runs_ptr, N, stream);
+  // the number of rows of the gradient is needed on the host to allocate it
+  int nnr = 0;
+  CUDA_CALL(cudaMemcpyAsync(&nnr, num_runs_ptr, sizeof(int), cudaMemcpyDeviceToHost, stream));
+  CUDA_CALL(cudaStreamSynchronize(stream));
+  size_t scan_storage_bytes = temporary_bytes;
+  cub::DeviceScan::ExclusiveSum<int*, int*>
+    (temp_storage.dptr_, scan_storage_bytes, counts_ptr, starts_ptr, nnr, stream);
+
+  grad.CheckAndAlloc({Shape1(nnr)});
+  CUDA_CALL(cudaMemcpyAsync(grad.aux_data(rowsparse::kIdx).dptr<int>(), unique_ptr,
+                            nnr * sizeof(int), cudaMemcpyDeviceToDevice, stream));
+  MSHADOW_TYPE_SWITCH(ograd.type_flag_, DType, {
+    typedef typename EmbeddingAccType<DType>::type AType;
+    const int block_dim_x = std::min(4 * kWarpSize, (M + kWarpSize - 1) / kWarpSize * kWarpSize);
+    dim3 dimBlock(block_dim_x);
+    dim3 dimGrid((M + block_dim_x - 1) / block_dim_x,
+                 std::min(nnr, static_cast<int>(mshadow::cuda::kBaseGridNum)));
+    mshadow::cuda::CheckLaunchParam(dimGrid, dimBlock, "EmbeddingRspGrad");
+    EmbeddingRspGradKernel<DType, AType><<<dimGrid, dimBlock, 0, stream>>>(
+      grad.data().dptr<DType>(), starts_ptr, counts_ptr, index.dptr_,
+      ograd.dptr<DType>(), nnr, M);
+    MSHADOW_CUDA_POST_KERNEL_CHECK(EmbeddingRspGradKernel);
+  });
+}
+
 }  // namespace op
 }  // namespace mxnet
 #endif  // MXNET_OPERATOR_TENSOR_INDEXING_OP_CUH_
@@ -70,6 +70,12 @@ Examples::
                            [[  0.,   1.,   2.,   3.,   4.],
                             [ 10.,  11.,  12.,  13.,  14.]]]
 
+The weight can be a ``row_sparse`` array, whose missing rows are zeros. With
+``sparse_grad=True`` the gradient of the weight is computed as a ``row_sparse``
+array holding only the rows looked up in the batch. The indices of a batch are
+grouped by row once and each looked up row is summed by a single thread, in
+float for ``float16`` weights.
+
 )code" ADD_FILELINE)
 .set_num_inputs(2)
 .set_num_outputs(1)
@@ -85,6 +91,7 @@ Examples::
     return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
   })
 .set_attr<FCompute>("FCompute<cpu>", EmbeddingOpForward<cpu>)
+.set_attr<FComputeEx>("FComputeEx<cpu>", EmbeddingOpForwardEx<cpu>)
 .set_attr<nnvm::FGradient>("FGradient",
   [](const nnvm::NodePtr& n, const std::vector<nnvm::NodeEntry>& ograds) {
     return MakeNonlossGradNode("_backward_Embedding", n, ograds,
@@ -97,12 +104,15 @@ Examples::
 NNVM_REGISTER_OP(_backward_Embedding)
 .set_num_inputs(2)
 .set_num_outputs(2)
+.set_attr_parser(ParamParser<EmbeddingParam>)
 .set_attr<FResourceRequest>("FResourceRequest",
   [](const NodeAttrs& attrs) {
     return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
   })
 .set_attr<nnvm::TIsBackward>("TIsBackward", true)
-.set_attr<FCompute>("FCompute<cpu>", EmbeddingOpBackward<cpu>);
+.set_attr<FInferStorageType>("FInferStorageType", EmbeddingBackwardInferStorageType)
+.set_attr<FCompute>("FCompute<cpu>", EmbeddingOpBackward<cpu>)
+.set_attr<FComputeEx>("FComputeEx<cpu>", EmbeddingOpBackwardEx<cpu>);
 
 
 NNVM_REGISTER_OP(take)
@@ -147,6 +157,7 @@ Examples::
     return std::vector<ResourceRequest>{ResourceRequest::kTempSpace};
   })
 .set_attr<FCompute>("FCompute<cpu>", TakeOpForward<cpu>)
+.set_attr<FComputeEx>("FComputeEx<cpu>", TakeOpForwardEx<cpu>)
 .set_attr<nnvm::FGradient>("FGradient",
   [](const nnvm::NodePtr& n,  const std::vector<nnvm::NodeEntry>& ograds) {
     return MakeNonlossGradNode("_backward_take", n, ograds,
@@ -233,6 +244,9 @@ Examples::
 
                                      [[ 0.  0.  1.]
                                       [ 1.  0.  0.]]]
+
+  // a csr array holds the on values only
+  one_hot([1,5,2], 3, stype='csr') = csr with indptr [0 1 1 2], indices [1 2] and data [1. 1.]
 )code" ADD_FILELINE)
 .set_num_outputs(1)
 .set_num_inputs(1)
@@ -243,7 +257,9 @@ Examples::
   })
 .set_attr<nnvm::FInferShape>("FInferShape", OneHotOpShape)
 .set_attr<nnvm::FInferType>("FInferType", OneHotOpType)
+.set_attr<FInferStorageType>("FInferStorageType", OneHotInferStorageType)
 .set_attr<FCompute>("FCompute<cpu>", OneHotOpForward<cpu>)
+.set_attr<FComputeEx>("FComputeEx<cpu>", OneHotOpForwardEx<cpu>)
 .set_attr<nnvm::FGradient>("FGradient", MakeZeroGradNodes)
 .add_argument("indices", "NDArray-or-Symbol", "array of locations where to set on_value")
 .add_arguments(OneHotParam::__FIELDS__());
@@ -27,13 +27,16 @@
 namespace mxnet {
 namespace op {
 NNVM_REGISTER_OP(Embedding)
-.set_attr<FCompute>("FCompute<gpu>", EmbeddingOpForward<gpu>);
+.set_attr<FCompute>("FCompute<gpu>", EmbeddingOpForward<gpu>)
+.set_attr<FComputeEx>("FComputeEx<gpu>", EmbeddingOpForwardEx<gpu>);
 
 NNVM_REGISTER_OP(_backward_Embedding)
-.set_attr<FCompute>("FCompute<gpu>", EmbeddingOpBackward<gpu>);
+.set_attr<FCompute>("FCompute<gpu>", EmbeddingOpBackward<gpu>)
+.set_attr<FComputeEx>("FComputeEx<gpu>", EmbeddingOpBackwardEx<gpu>);
 
 NNVM_REGISTER_OP(take)
-.set_attr<FCompute>("FCompute<gpu>", TakeOpForward<gpu>);
+.set_attr<FCompute>("FCompute<gpu>", TakeOpForward<gpu>)
+.set_attr<FComputeEx>("FComputeEx<gpu>", TakeOpForwardEx<gpu>);
 
 NNVM_REGISTER_OP(_backward_take)
 .set_attr<FCompute>("FCompute<gpu>", TakeOpBackward<gpu>);
@@ -42,7 +45,8 @@ NNVM_REGISTER_OP(batch_take)
 .set_attr<FCompute>("FCompute<gpu>", BatchTakeOpForward<gpu>);
 
 NNVM_REGISTER_OP(one_hot)
-.set_attr<FCompute>("FCompute<gpu>", OneHotOpForward<gpu>);
+.set_attr<FCompute>("FCompute<gpu>", OneHotOpForward<gpu>)
+.set_attr<FComputeEx>("FComputeEx<gpu>", OneHotOpForwardEx<gpu>);
 
 }  // namespace op
 }  // namespace mxnet
@@ -29,6 +29,7 @@
 #include <dmlc/parameter.h>
 #include <mxnet/operator.h>
 #include <mxnet/operator_util.h>
+#include <cstring>
 #include <map>
 #include <vector>
 #include <string>
@@ -40,6 +41,7 @@
 #include "../elemwise_op_common.h"
 #include "../mxnet_op.h"
 #include "./sort_op.h"
+#include "./cast_storage-inl.h"
 
 namespace mxnet {
 namespace op {
@@ -54,6 +56,7 @@ struct EmbeddingParam: public dmlc::Parameter<EmbeddingParam> {
   int input_dim;
   int output_dim;
   int dtype;
+  bool sparse_grad;
   DMLC_DECLARE_PARAMETER(EmbeddingParam) {
     DMLC_DECLARE_FIELD(input_dim).set_lower_bound(1)
     .describe("Vocabulary size of the input indices.");
@@ -66,6 +69,9 @@ struct EmbeddingParam: public dmlc::Parameter<EmbeddingParam> {
     .add_enum("uint8", mshadow::kUint8)
     .add_enum("int32", mshadow::kInt32)
     .describe("Data type of weight.");
+    DMLC_DECLARE_FIELD(sparse_grad).set_default(false)
+    .describe("Compute the gradient of the weight as a row_sparse array of the "
+              "looked up rows.");
   }
 };
 
@@ -170,9 +176,17 @@ inline bool EmbeddingOpType(const nnvm::NodeAttrs& attrs,
   return true;
 }
 
+/*! \brief the row j of a (K, M) array clipped to [0, K - 1] */
+template<typename IType>
+MSHADOW_XINLINE int TakeClip(IType j, int K) {
+  const int k = static_cast<int>(j);
+  return k <= 0 ? 0 : (k >= K ? K - 1 : k);
+}
+
 /*! \brief name the struct Take instead of take
  * to avoid conflict with the take function in mshadow
  */
+template<int req>
 struct Take {
   // assume that idx have been flattened to a 1-D tensor (N,)
   // assume that out_data and in_data have been flattened to 2-D tensors, (N, M) and (K, M)
@@ -182,13 +196,85 @@ struct Take {
   template<typename DType, typename IType>
   MSHADOW_XINLINE static void Map(int i, DType* out_data, const DType* in_data,
                                   const IType* idx, const int M, const int K) {
-    int j = static_cast<int>(idx[i/M]);
-    if (j <= 0) j = 0;
-    else if (j >= K) j = K - 1;
-    out_data[i] = in_data[j * M + i % M];
+    KERNEL_ASSIGN(out_data[i], req, in_data[TakeClip(idx[i/M], K) * M + i % M]);
+  }
+};
+
+/*!
+ * \brief one row of take per cpu thread, copied whole while the row of the
+ *  next index is prefetched, as the rows looked up are scattered in in_data
+ */
+template<int req>
+struct TakeRow {
+  static const int kCPUGrain = 64;
+  template<typename DType, typename IType>
+  inline static void Map(int i, DType* out_data, const DType* in_data,
+                         const IType* idx, const int M, const int K, const int N) {
+#if defined(__GNUC__)
+    if (i + 1 < N) __builtin_prefetch(in_data + TakeClip(idx[i + 1], K) * M);
+#endif
+    const DType* row = in_data + TakeClip(idx[i], K) * M;
+    DType* out = out_data + i * M;
+    if (req == kAddTo) {
+      for (int k = 0; k < M; ++k) out[k] += row[k];
+    } else {
+      std::memcpy(out, row, M * sizeof(DType));
+    }
+  }
+};
+
+/*! \brief out_data = take(in_data, idx) for N indices into a (K, M) in_data */
+template<int req, typename xpu, typename DType, typename IType>
+inline void TakeRows(mshadow::Stream<xpu> *s, DType* out_data, const DType* in_data,
+                     const IType* idx, int N, int M, int K) {
+  mxnet_op::Kernel<Take<req>, xpu>::Launch(s, N * M, out_data, in_data, idx, M, K);
+}
+
+template<int req, typename DType, typename IType>
+inline void TakeRows(mshadow::Stream<cpu> *s, DType* out_data, const DType* in_data,
+                     const IType* idx, int N, int M, int K) {
+  mxnet_op::Kernel<TakeRow<req>, cpu>::Launch(s, N, out_data, in_data, idx, M, K, N);
+}
+
+/*!
+ * \brief Take from a row sparse in_data holding the rows in_rows of the
+ *  (K, M) array, the other rows are zeros
+ */
+struct TakeRsp {
+  template<typename DType, typename IType>
+  MSHADOW_XINLINE static void Map(int i, DType* out_data, const DType* in_data,
+                                  const int* in_rows, const IType* idx, const int M,
+                                  const int K, const int nnr) {
+    const int pos = RowSparsePosition(in_rows, nnr, TakeClip(idx[i/M], K));
+    out_data[i] = pos < 0 ? DType(0) : in_data[pos * M + i % M];
   }
 };
 
+/*! \brief out = take(arr, idx) along the first axis of a row sparse arr */
+template<typename xpu>
+void TakeRspImpl(mshadow::Stream<xpu>* s, const NDArray& arr, const TBlob& idx,
+                 OpReqType req, const TBlob& out) {
+  using namespace mxnet_op;
+  if (req == kNullOp) return;
+  CHECK_EQ(req, kWriteTo) << "take from a row sparse array only writes its output";
+  const TShape& arrshape = arr.shape();
+  const int M = arrshape.ProdShape(1, arrshape.ndim());
+  const int nnr = arr.aux_shape(rowsparse::kIdx)[0];
+  MSHADOW_TYPE_SWITCH(out.type_flag_, DType, {
+    MSHADOW_TYPE_SWITCH(idx.type_flag_, IType, {
+      if (nnr == 0) {
+        Kernel<set_zero, xpu>::Launch(s, out.Size(), out.dptr<DType>());
+      } else {
+        Kernel<TakeRsp, xpu>::Launch(s, out.Size(), out.dptr<DType>(),
+                                     arr.data().dptr<DType>(),
+                                     arr.aux_data(rowsparse::kIdx).dptr<int>(),
+                                     idx.dptr<IType>(), M,
+                                     static_cast<int>(arrshape[0]), nnr);
+      }
+    });
+  });
+}
+
 template<typename xpu>
 void EmbeddingOpForward(const nnvm::NodeAttrs& attrs,
                         const OpContext& ctx,
@@ -215,12 +301,34 @@ void EmbeddingOpForward(const nnvm::NodeAttrs& attrs,
       Tensor<xpu, 2, DType> wmat = inputs[embedding::kWeight].get<xpu, 2, DType>(s);
       Tensor<xpu, 2, DType> out = outputs[embedding::kOut].get_with_shape<xpu, 2, DType>(
         Shape2(oshape.ProdShape(0, oshape.ndim()-1), oshape[oshape.ndim()-1]), s);
-      Kernel<Take, xpu>::Launch(s, oshape.Size(), out.dptr_, wmat.dptr_,
-        data.dptr_, wmat.shape_[1], wmat.shape_[0]);
+      TakeRows<kWriteTo>(s, out.dptr_, wmat.dptr_, data.dptr_, data.shape_[0],
+                         wmat.shape_[1], wmat.shape_[0]);
     });
   });
 }
 
+template<typename xpu>
+void EmbeddingOpForwardEx(const nnvm::NodeAttrs& attrs,
+                          const OpContext& ctx,
+                          const std::vector<NDArray>& inputs,
+                          const std::vector<OpReqType>& req,
+                          const std::vector<NDArray>& outputs) {
+  CHECK_EQ(inputs.size(), 2U);
+  CHECK_EQ(outputs.size(), 1U);
+  const NDArray& weight = inputs[embedding::kWeight];
+  if (weight.storage_type() == kRowSparseStorage &&
+      inputs[embedding::kData].storage_type() == kDefaultStorage &&
+      outputs[embedding::kOut].storage_type() == kDefaultStorage) {
+    CHECK_EQ(weight.shape().ndim(), 2U)
+            << "Embedding layer expects its weight to be two-dimensional. "
+            << weight.shape().ndim() << " dimensional input is given instead";
+    TakeRspImpl<xpu>(ctx.get_stream<xpu>(), weight, inputs[embedding::kData].data(),
+                     req[embedding::kOut], outputs[embedding::kOut].data());
+  } else {
+    FComputeFallback<xpu>(EmbeddingOpForward<xpu>, attrs, ctx, inputs, req, outputs);
+  }
+}
+
 // Returns integer log2(a) rounded up
 inline int ilog2(unsigned int a) {
   int k = 1;
@@ -280,6 +388,145 @@ void AddTakeGradLargeBatchCaller(const OpContext& ctx, mshadow::Tensor<xpu, 2, D
   mxnet::op::AddTakeGradLargeBatch(dst, sorted_data, original_index, src, &temp_storage);
 }
 
+/*! \brief the type the gradient of an embedding is summed in, float for fp16 weights */
+template<typename DType>
+struct EmbeddingAccType {
+  typedef DType type;
+};
+template<>
+struct EmbeddingAccType<mshadow::half::half_t> {
+  typedef float type;
+};
+
+/*!
+ * \brief the indices of a batch grouped by row: the looked up rows sorted and
+ *  deduplicated, and for the u-th of them the positions pos[offset[u],
+ *  offset[u + 1]) of the batch that look it up, in increasing order
+ */
+struct EmbeddingSegments {
+  std::vector<int> rows;
+  std::vector<int> offset;
+  std::vector<int> pos;
+};
+
+/*!
+ * \brief groups the N indices idx, clipped to [0, K - 1], by row. A counting
+ *  sort is used when the vocabulary is not much larger than the batch, a
+ *  comparison sort of the (row, position) pairs otherwise
+ */
+template<typename IType>
+inline void EmbeddingGroupRows(const IType* idx, int N, int K, EmbeddingSegments* seg) {
+  std::vector<int> rows(N);
+  for (int i = 0; i < N; ++i) {
+    const int j = static_cast<int>(idx[i]);
+    rows[i] = j <= 0 ? 0 : (j >= K ? K - 1 : j);
+  }
+  seg->rows.clear();
+  seg->offset.clear();
+  seg->pos.resize(N);
+  if (static_cast<int64_t>(K) <= 8 * static_cast<int64_t>(N)) {
+    std::vector<int> count(K + 1, 0);
+    for (int i = 0; i < N; ++i) ++count[rows[i] + 1];
+    for (int j = 0; j < K; ++j) {
+      if (count[j + 1] != 0) {
+        seg->rows.push_back(j);
+        seg->offset.push_back(count[j]);
+      }
+      count[j + 1] += count[j];
+    }
+    for (int i = 0; i < N; ++i) seg->pos[count[rows[i]]++] = i;
+  } else {
+    std::vector<uint64_t> keys(N);
+    for (int i = 0; i < N; ++i) {
+      keys[i] = (static_cast<uint64_t>(rows[i]) << 32) | static_cast<uint32_t>(i);
+    }
+    std::sort(keys.begin(), keys.end());
+    for (int i = 0; i < N; ++i) {
+      const int j = static_cast<int>(keys[i] >> 32);
+      if (i == 0 || j != seg->rows.back()) {
+        seg->rows.push_back(j);
+        seg->offset.push_back(i);
+      }
+      seg->pos[i] = static_cast<int>(keys[i] & 0xFFFFFFFFU);
+    }
+  }
+  seg->offset.push_back(N);
+}
+
+/*!
+ * \brief sums the rows of src that look up the same row, one row of the
+ *  output per segment, so that the threads never write the same row
+ * \param dst the gradient, with a row per segment when compact, of the
+ *  vocabulary otherwise
+ * \param add add the sums to dst rather than write them
+ */
+template<typename DType>
+inline void EmbeddingSegmentSum(const EmbeddingSegments& seg, const DType* src, int M,
+                                DType* dst, bool compact, bool add) {
+  typedef typename EmbeddingAccType<DType>::type AType;
+  const int nseg = static_cast<int>(seg.rows.size());
+  const int nthread = mxnet_op::KernelNumThreads(static_cast<int>(seg.pos.size()) * M,
+                                                 mxnet_op::KernelGrain<EmbeddingSegments>::Get());
+  #pragma omp parallel num_threads(nthread) if (nthread > 1)
+  {
+    std::vector<AType> acc(M);
+    #pragma omp for schedule(dynamic, 16)
+    for (int u = 0; u < nseg; ++u) {
+      DType* out = dst + static_cast<int64_t>(compact ? u : seg.rows[u]) * M;
+      std::fill(acc.begin(), acc.end(), AType(0));
+      if (add) {
+        for (int k = 0; k < M; ++k) acc[k] = AType(out[k]);
+      }
+      for (int p = seg.offset[u]; p < seg.offset[u + 1]; ++p) {
+        const DType* in = src + static_cast<int64_t>(seg.pos[p]) * M;
+        for (int k = 0; k < M; ++k) acc[k] += AType(in[k]);
+      }
+      for (int k = 0; k < M; ++k) out[k] = DType(acc[k]);
+    }
+  }
+}
+
+/*!
+ * \brief dst += the rows of src summed by index. On the gpu the small batches
+ *  scatter with atomics and the large ones sort the indices first, fp16
+ *  always sorts since it is summed in float
+ */
+template<typename xpu, typename IndexType, typename DType>
+inline void EmbeddingGradAccumulate(const OpContext& ctx, mshadow::Tensor<xpu, 2, DType> dst,
+                                    const mshadow::Tensor<xpu, 1, IndexType>& index,
+                                    const mshadow::Tensor<xpu, 2, DType>& src) {
+  // shape_out_prod ~= the number of elements loaded in AddTakeGrad
+  // shape_in_prod  ~= the number of elements stored in AddTakeGrad
+  // When the number of elements processed is low, use AddTakeGrad.
+  // The approximate cut-off value 16384 was found experimentally on Titan X Pascal
+  uint64_t shape_in_prod =
+    static_cast<uint64_t>(dst.shape_[0])*
+    static_cast<uint64_t>(dst.shape_[1]);
+  uint64_t shape_out_prod =
+    static_cast<uint64_t>(src.shape_[0])*
+    static_cast<uint64_t>(src.shape_[1]);
+  if (shape_out_prod < (uint64_t)16384 && shape_in_prod < (uint64_t)16384 &&
+      !std::is_same<DType, mshadow::half::half_t>::value) {
+    AddTakeGrad(dst, index, src);
+  } else {
+    AddTakeGradLargeBatchCaller(ctx, dst, index, src);
+  }
+}
+
+/*!
+ * \brief the cpu groups the indices once and sums each looked up row on one
+ *  thread, the rows that are not looked up are left as they are
+ */
+template<typename IndexType, typename DType>
+inline void EmbeddingGradAccumulate(const OpContext& ctx, mshadow::Tensor<cpu, 2, DType> dst,
+                                    const mshadow::Tensor<cpu, 1, IndexType>& index,
+                                    const mshadow::Tensor<cpu, 2, DType>& src) {
+  EmbeddingSegments seg;
+  EmbeddingGroupRows(index.dptr_, static_cast<int>(index.size(0)),
+                     static_cast<int>(dst.size(0)), &seg);
+  EmbeddingSegmentSum(seg, src.dptr_, static_cast<int>(src.size(1)), dst.dptr_, false, true);
+}
+
 template<typename xpu>
 void EmbeddingOpBackward(const nnvm::NodeAttrs& attrs,
                          const OpContext& ctx,
@@ -311,21 +558,7 @@ void EmbeddingOpBackward(const nnvm::NodeAttrs& attrs,
         if (req[embedding::kWeight] == kWriteTo) {
           grad_in = scalar<DType>(0.0f);
         }
-        // shape_out_prod ~= the number of elements loaded in AddTakeGrad
-        // shape_in_prod  ~= the number of elements stored in AddTakeGrad
-        // When the number of elements processed is low, use AddTakeGrad.
-        // The approximate cut-off value 16384 was found experimentally on Titan X Pascal
-        uint64_t shape_in_prod =
-          static_cast<uint64_t>(grad_in.shape_[0])*
-          static_cast<uint64_t>(grad_in.shape_[1]);
-        uint64_t shape_out_prod =
-          static_cast<uint64_t>(grad_out.shape_[0])*
-          static_cast<uint64_t>(grad_out.shape_[1]);
-        if (shape_out_prod < (uint64_t)16384 && shape_in_prod < (uint64_t)16384) {
-          AddTakeGrad(grad_in, data, grad_out);
-        } else {
-          AddTakeGradLargeBatchCaller(ctx, grad_in, data, grad_out);
-        }
+        EmbeddingGradAccumulate(ctx, grad_in, data, grad_out);
       } else {
         LOG(FATAL) << "wrong req";
       }
@@ -333,6 +566,74 @@ void EmbeddingOpBackward(const nnvm::NodeAttrs& attrs,
   });
 }
 
+inline bool EmbeddingBackwardInferStorageType(const nnvm::NodeAttrs& attrs,
+                                              const int dev_mask,
+                                              std::vector<int>* in_attrs,
+                                              std::vector<int>* out_attrs) {
+  const EmbeddingParam& param = nnvm::get<EmbeddingParam>(attrs.parsed);
+  CHECK_EQ(in_attrs->size(), 2U);
+  CHECK_EQ(out_attrs->size(), 2U);
+  (*out_attrs)[embedding::kData] = kDefaultStorage;
+  (*out_attrs)[embedding::kWeight] = param.sparse_grad ? kRowSparseStorage : kDefaultStorage;
+  return true;
+}
+
+/*!
+ * \brief the row sparse gradient of the weight only holds the looked up rows,
+ *  so that the update of a large embedding touches the rows of the batch
+ */
+inline void EmbeddingBackwardRspImpl(const OpContext& ctx, mshadow::Stream<cpu>* s,
+                                     const TBlob& ograd, const TBlob& data, OpReqType req,
+                                     const NDArray& grad) {
+  if (req == kNullOp) return;
+  CHECK_EQ(req, kWriteTo) << "the row sparse gradient of Embedding can only be written";
+  const int K = grad.shape()[0];
+  const int M = grad.shape()[1];
+  const int N = data.Size();
+  EmbeddingSegments seg;
+  MSHADOW_TYPE_SWITCH(data.type_flag_, IType, {
+    EmbeddingGroupRows(data.dptr<IType>(), N, K, &seg);
+  });
+  grad.CheckAndAlloc({mshadow::Shape1(seg.rows.size())});
+  std::copy(seg.rows.begin(), seg.rows.end(), grad.aux_data(rowsparse::kIdx).dptr<int>());
+  MSHADOW_TYPE_SWITCH(ograd.type_flag_, DType, {
+    EmbeddingSegmentSum(seg, ograd.dptr<DType>(), M, grad.data().dptr<DType>(), true, false);
+  });
+}
+
+#ifdef __CUDACC__
+/*!
+ * \brief the gpu sorts the indices, counts the runs of each row and sums a
+ *  run per thread block column. The number of rows is copied to the host to
+ *  allocate the gradient
+ */
+inline void EmbeddingBackwardRspImpl(const OpContext& ctx, mshadow::Stream<gpu>* s,
+                                     const TBlob& ograd, const TBlob& data, OpReqType req,
+                                     const NDArray& grad);
+#endif  // __CUDACC__
+
+template<typename xpu>
+void EmbeddingOpBackwardEx(const nnvm::NodeAttrs& attrs,
+                           const OpContext& ctx,
+                           const std::vector<NDArray>& inputs,
+                           const std::vector<OpReqType>& req,
+                           const std::vector<NDArray>& outputs) {
+  CHECK_EQ(inputs.size(), 2U);
+  CHECK_EQ(outputs.size(), 2U);
+  const NDArray& grad = outputs[embedding::kWeight];
+  if (grad.storage_type() == kRowSparseStorage &&
+      inputs[0].storage_type() == kDefaultStorage &&
+      inputs[1].storage_type() == kDefaultStorage) {
+    CHECK_EQ(req[embedding::kData], kNullOp)
+            << "Embedding layer doesn't support calculate data gradient";
+    CHECK_EQ(grad.dtype(), inputs[0].dtype());
+    EmbeddingBackwardRspImpl(ctx, ctx.get_stream<xpu>(), inputs[0].data(), inputs[1].data(),
+                             req[embedding::kWeight], grad);
+  } else {
+    FComputeFallback<xpu>(EmbeddingOpBackward<xpu>, attrs, ctx, inputs, req, outputs);
+  }
+}
+
 namespace take_ {  // to avoid name conflict
 enum TakeOpInputs {kArr, kIdx};
 enum TakeOpOutputs {kOut};
@@ -423,17 +724,37 @@ void TakeOpForward(const nnvm::NodeAttrs& attrs,
   const TShape& oshape = outputs[take_::kOut].shape_;
 
   Stream<xpu> *s = ctx.get_stream<xpu>();
+  if (oshape.Size() == 0) return;
   MSHADOW_TYPE_SWITCH(outputs[0].type_flag_, DType, {  // output data type
     MSHADOW_TYPE_SWITCH(inputs[1].type_flag_, IType, {  // index data type
-      Kernel<Take, xpu>::Launch(s, oshape.Size(),
-                                outputs[take_::kOut].dptr<DType>(),
-                                inputs[take_::kArr].dptr<DType>(),
-                                inputs[take_::kIdx].dptr<IType>(),
-                                oshape.Size()/idxshape.Size(), arrshape[0]);
+      MXNET_ASSIGN_REQ_SWITCH(req[take_::kOut], req_type, {
+        TakeRows<req_type>(s, outputs[take_::kOut].dptr<DType>(),
+                           inputs[take_::kArr].dptr<DType>(),
+                           inputs[take_::kIdx].dptr<IType>(), idxshape.Size(),
+                           oshape.Size()/idxshape.Size(), arrshape[0]);
+      });
     });
   });
 }
 
+template<typename xpu>
+void TakeOpForwardEx(const nnvm::NodeAttrs& attrs,
+                     const OpContext& ctx,
+                     const std::vector<NDArray>& inputs,
+                     const std::vector<OpReqType>& req,
+                     const std::vector<NDArray>& outputs) {
+  CHECK_EQ(inputs.size(), 2U);
+  CHECK_EQ(outputs.size(), 1U);
+  if (inputs[take_::kArr].storage_type() == kRowSparseStorage &&
+      inputs[take_::kIdx].storage_type() == kDefaultStorage &&
+      outputs[take_::kOut].storage_type() == kDefaultStorage) {
+    TakeRspImpl<xpu>(ctx.get_stream<xpu>(), inputs[take_::kArr], inputs[take_::kIdx].data(),
+                     req[take_::kOut], outputs[take_::kOut].data());
+  } else {
+    FComputeFallback<xpu>(TakeOpForward<xpu>, attrs, ctx, inputs, req, outputs);
+  }
+}
+
 template<typename xpu>
 void TakeOpBackward(const nnvm::NodeAttrs& attrs,
                     const OpContext& ctx,
@@ -568,6 +889,7 @@ struct OneHotParam : public dmlc::Parameter<OneHotParam> {
   double off_value;
   int axis;
   int dtype;
+  int stype;
   DMLC_DECLARE_PARAMETER(OneHotParam) {
     DMLC_DECLARE_FIELD(depth)
       .describe("Depth of the one hot dimension.");
@@ -585,6 +907,12 @@ struct OneHotParam : public dmlc::Parameter<OneHotParam> {
       .add_enum("uint8", mshadow::kUint8)
       .add_enum("int32", mshadow::kInt32)
       .describe("DType of the output");
+    DMLC_DECLARE_FIELD(stype)
+      .set_default(kDefaultStorage)
+      .add_enum("default", kDefaultStorage)
+      .add_enum("csr", kCSRStorage)
+      .describe("Storage type of the output. A csr output holds the on values only, "
+                "it needs 1-D indices and an off_value of 0.");
   }
 };
 
@@ -638,19 +966,45 @@ inline bool OneHotOpType(const nnvm::NodeAttrs& attrs,
   return true;
 }
 
+/*! \brief one value of the one hot array per thread */
 template<int req>
 struct one_hot {
   template<typename DType, typename IType>
   MSHADOW_XINLINE static void Map(int i, DType* out, const IType* indices,
-                                  int depth, DType on_value) {
-    int offset = i * depth;
-    int j = static_cast<int>(indices[i]);
-    if (j >= 0 && j < depth) {
-      KERNEL_ASSIGN(out[offset+j], req, on_value);
+                                  int depth, DType on_value, DType off_value) {
+    const bool on = static_cast<int>(indices[i / depth]) == i % depth;
+    KERNEL_ASSIGN(out[i], req, on ? on_value : off_value);
+  }
+};
+
+/*! \brief one row of the one hot array per cpu thread */
+template<int req>
+struct one_hot_row {
+  static const int kCPUGrain = 16;
+  template<typename DType, typename IType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const IType* indices,
+                                  int depth, DType on_value, DType off_value) {
+    const int j = static_cast<int>(indices[i]);
+    for (int k = 0; k < depth; ++k) {
+      KERNEL_ASSIGN(out[i * depth + k], req, k == j ? on_value : off_value);
     }
   }
 };
 
+template<int req, typename xpu, typename DType, typename IType>
+inline void OneHotRows(mshadow::Stream<xpu> *s, DType* out, const IType* indices, int N,
+                       int depth, DType on_value, DType off_value) {
+  mxnet_op::Kernel<one_hot<req>, xpu>::Launch(s, N * depth, out, indices, depth,
+                                              on_value, off_value);
+}
+
+template<int req, typename DType, typename IType>
+inline void OneHotRows(mshadow::Stream<cpu> *s, DType* out, const IType* indices, int N,
+                       int depth, DType on_value, DType off_value) {
+  mxnet_op::Kernel<one_hot_row<req>, cpu>::Launch(s, N, out, indices, depth,
+                                                  on_value, off_value);
+}
+
 template<typename xpu>
 void OneHotOpForward(const nnvm::NodeAttrs& attrs,
                      const OpContext& ctx,
@@ -670,21 +1024,85 @@ void OneHotOpForward(const nnvm::NodeAttrs& attrs,
   const OneHotParam& param = nnvm::get<OneHotParam>(attrs.parsed);
   GetOneHotParams(param, &depth, &on_value, &off_value, &dtype);
   using namespace mxnet_op;
-  using namespace mshadow::expr;
   mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
   MSHADOW_TYPE_SWITCH(outputs[0].type_flag_, DType, {  // output data type switch
-    mshadow::Tensor<xpu, 1, DType> out = outputs[0].FlatTo1D<xpu, DType>(s);
-    ASSIGN_DISPATCH(out, req[0], static_cast<DType>(off_value));
     MXNET_ASSIGN_REQ_SWITCH(req[0], req_type, {  // request type switch
       MSHADOW_TYPE_SWITCH(inputs[0].type_flag_, IType, {  // indices data type switch
-        Kernel<one_hot<req_type>, xpu>::Launch(s, inputs[0].Size(), outputs[0].dptr<DType>(),
-                                               inputs[0].dptr<IType>(), depth,
-                                               static_cast<DType>(on_value));
+        OneHotRows<req_type>(s, outputs[0].dptr<DType>(), inputs[0].dptr<IType>(),
+                             inputs[0].Size(), depth, static_cast<DType>(on_value),
+                             static_cast<DType>(off_value));
       });
     });
   });
 }
 
+inline bool OneHotInferStorageType(const nnvm::NodeAttrs& attrs,
+                                   const int dev_mask,
+                                   std::vector<int>* in_attrs,
+                                   std::vector<int>* out_attrs) {
+  CHECK_EQ(in_attrs->size(), 1U);
+  CHECK_EQ(out_attrs->size(), 1U);
+  (*out_attrs)[0] = nnvm::get<OneHotParam>(attrs.parsed).stype;
+  return true;
+}
+
+/*! \brief the csr one hot array of the 1-D indices, a row holds the on value of a valid index */
+inline void OneHotCsrImpl(mshadow::Stream<cpu>* s, const OneHotParam& param,
+                          const TBlob& indices, OpReqType req, const NDArray& out) {
+  if (req == kNullOp) return;
+  CHECK_EQ(req, kWriteTo) << "one_hot only writes a csr output";
+  CHECK_EQ(indices.ndim(), 1U) << "a csr one_hot needs 1-D indices";
+  CHECK_EQ(param.off_value, 0.0) << "a csr one_hot needs an off_value of 0";
+  const int N = indices.Size();
+  MSHADOW_TYPE_SWITCH(indices.type_flag_, IType, {
+    const IType* idx = indices.dptr<IType>();
+    int nnz = 0;
+    for (int i = 0; i < N; ++i) {
+      const int j = static_cast<int>(idx[i]);
+      if (j >= 0 && j < param.depth) ++nnz;
+    }
+    out.CheckAndAlloc({mshadow::Shape1(N + 1), mshadow::Shape1(nnz)});
+    int* indptr = out.aux_data(csr::kIndPtr).dptr<int>();
+    int* col = out.aux_data(csr::kIdx).dptr<int>();
+    MSHADOW_TYPE_SWITCH(out.dtype(), DType, {
+      DType* val = out.data().dptr<DType>();
+      indptr[0] = 0;
+      for (int i = 0, k = 0; i < N; ++i) {
+        const int j = static_cast<int>(idx[i]);
+        if (j >= 0 && j < param.depth) {
+          col[k] = j;
+          val[k++] = static_cast<DType>(param.on_value);
+        }
+        indptr[i + 1] = k;
+      }
+    });
+  });
+}
+
+#ifdef __CUDACC__
+inline void OneHotCsrImpl(mshadow::Stream<gpu>* s, const OneHotParam& param,
+                          const TBlob& indices, OpReqType req, const NDArray& out) {
+  LOG(FATAL) << "a csr one_hot is only implemented on the cpu";
+}
+#endif  // __CUDACC__
+
+template<typename xpu>
+void OneHotOpForwardEx(const nnvm::NodeAttrs& attrs,
+                       const OpContext& ctx,
+                       const std::vector<NDArray>& inputs,
+                       const std::vector<OpReqType>& req,
+                       const std::vector<NDArray>& outputs) {
+  CHECK_EQ(inputs.size(), 1U);
+  CHECK_EQ(outputs.size(), 1U);
+  if (inputs[0].storage_type() == kDefaultStorage &&
+      outputs[0].storage_type() == kCSRStorage) {
+    OneHotCsrImpl(ctx.get_stream<xpu>(), nnvm::get<OneHotParam>(attrs.parsed),
+                  inputs[0].data(), req[0], outputs[0]);
+  } else {
+    FComputeFallback<xpu>(OneHotOpForward<xpu>, attrs, ctx, inputs, req, outputs);
+  }
+}
+
 }  // namespace op
 }  // namespace mxnet
 #ifdef __CUDACC__
@@ -27,12 +27,17 @@
 #include <mxnet/operator_util.h>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <type_traits>
 #include <utility>
 #include "../mshadow_op.h"
 #include "../elemwise_op_common.h"
 #include "../channel_op_common.h"
 #include "../mxnet_op.h"
+#include "../linalg.h"
 #include "broadcast_reduce_op.h"
+#include "./cast_storage-inl.h"
+#include "./transpose_kernel.h"
 
 #if MXNET_USE_CUDA
 #include <thrust/device_vector.h>
@@ -218,6 +223,7 @@ void TransposeImpl(RunContext ctx,
   using namespace mshadow::expr;
   CHECK_EQ(src.type_flag_, ret.type_flag_);
   Stream<xpu> *s = ctx.get_stream<xpu>();
+  if (axes.ndim() > 0 && transpose_kernel::TransposeTiled(s, src, ret, axes)) return;
   MSHADOW_TYPE_SWITCH(ret.type_flag_, DType, {
     switch (axes.ndim()) {
      case 0:
@@ -570,6 +576,204 @@ inline bool DotShape(const nnvm::NodeAttrs& attrs,
   return true;
 }
 
+/*! \brief one row of the output per thread, out += dot(csr, rhs) */
+struct DotCsrDnsRow {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const DType* val, const int* indptr,
+                                  const int* col, const DType* rhs, int n) {
+    for (int j = indptr[i]; j < indptr[i + 1]; ++j) {
+      const DType v = val[j];
+      const DType* r = rhs + col[j] * n;
+      for (int k = 0; k < n; ++k) {
+        out[i * n + k] += v * r[k];
+      }
+    }
+  }
+};
+
+/*!
+ * \brief one column of the output per thread, out += dot(csr.T, rhs), so that
+ *  no two threads write the same value. With out_rows the output is the value
+ *  array of a row sparse array holding those nnr rows.
+ */
+struct DotCsrTransDnsCol {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int k, DType* out, const DType* val, const int* indptr,
+                                  const int* col, const DType* rhs, int num_rows, int n,
+                                  const int* out_rows, int nnr) {
+    for (int i = 0; i < num_rows; ++i) {
+      for (int j = indptr[i]; j < indptr[i + 1]; ++j) {
+        const int r = out_rows == nullptr ? col[j] : RowSparsePosition(out_rows, nnr, col[j]);
+        out[r * n + k] += val[j] * rhs[i * n + k];
+      }
+    }
+  }
+};
+
+/*! \brief out = dot(lhs, rhs) or dot(lhs.T, rhs) for a csr lhs and dense rhs and out */
+template<typename xpu>
+void DotCsrDnsDnsImpl(mshadow::Stream<xpu>* s, const NDArray& lhs, const TBlob& rhs,
+                      OpReqType req, bool trans_lhs, const TBlob& out) {
+  using namespace mxnet_op;
+  if (req == kNullOp) return;
+  CHECK_NE(req, kWriteInplace);
+  const int num_rows = lhs.shape()[0];
+  const int n = rhs.Size() / rhs.shape_[0];
+  MSHADOW_TYPE_SWITCH(out.type_flag_, DType, {
+    if (req == kWriteTo) {
+      Kernel<set_zero, xpu>::Launch(s, out.Size(), out.dptr<DType>());
+    }
+    const DType* val = lhs.data().dptr<DType>();
+    const int* indptr = lhs.aux_data(csr::kIndPtr).dptr<int>();
+    const int* col = lhs.aux_data(csr::kIdx).dptr<int>();
+    if (!trans_lhs) {
+      Kernel<DotCsrDnsRow, xpu>::Launch(s, num_rows, out.dptr<DType>(), val, indptr, col,
+                                        rhs.dptr<DType>(), n);
+    } else {
+      Kernel<DotCsrTransDnsCol, xpu>::Launch(s, n, out.dptr<DType>(), val, indptr, col,
+                                             rhs.dptr<DType>(), num_rows, n,
+                                             static_cast<const int*>(nullptr), 0);
+    }
+  });
+}
+
+/*!
+ * \brief out = dot(lhs.T, rhs) into a row sparse out that keeps only the rows
+ *  of the columns stored in the csr lhs, e.g. the weight gradient of a
+ *  linear model on sparse features
+ */
+inline void DotCsrTransDnsRspImpl(mshadow::Stream<cpu>* s, const NDArray& lhs,
+                                  const TBlob& rhs, OpReqType req, const NDArray& out) {
+  using namespace mxnet_op;
+  if (req == kNullOp) return;
+  CHECK_EQ(req, kWriteTo) << "the row sparse output of dot can only be written";
+  const TBlob col_blob = lhs.aux_data(csr::kIdx);
+  const int* col = col_blob.dptr<int>();
+  std::vector<int> rows(col, col + col_blob.Size());
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+  out.CheckAndAlloc({mshadow::Shape1(rows.size())});
+  int* out_rows = out.aux_data(rowsparse::kIdx).dptr<int>();
+  std::copy(rows.begin(), rows.end(), out_rows);
+  const int num_rows = lhs.shape()[0];
+  const int n = rhs.Size() / rhs.shape_[0];
+  MSHADOW_TYPE_SWITCH(rhs.type_flag_, DType, {
+    const TBlob val = out.data();
+    Kernel<set_zero, cpu>::Launch(s, val.Size(), val.dptr<DType>());
+    Kernel<DotCsrTransDnsCol, cpu>::Launch(s, n, val.dptr<DType>(), lhs.data().dptr<DType>(),
+                                           lhs.aux_data(csr::kIndPtr).dptr<int>(), col,
+                                           rhs.dptr<DType>(), num_rows, n,
+                                           static_cast<const int*>(out_rows),
+                                           static_cast<int>(rows.size()));
+  });
+}
+
+#ifdef __CUDACC__
+inline void DotCsrTransDnsRspImpl(mshadow::Stream<gpu>* s, const NDArray& lhs,
+                                  const TBlob& rhs, OpReqType req, const NDArray& out) {
+  LOG(FATAL) << "the row sparse output of dot is only implemented on the cpu";
+}
+#endif  // __CUDACC__
+
+template<typename xpu>
+void DotForwardEx(const nnvm::NodeAttrs& attrs,
+                  const OpContext& ctx,
+                  const std::vector<NDArray>& inputs,
+                  const std::vector<OpReqType>& req,
+                  const std::vector<NDArray>& outputs) {
+  const DotParam& param = nnvm::get<DotParam>(attrs.parsed);
+  CHECK_EQ(inputs.size(), 2U);
+  CHECK_EQ(outputs.size(), 1U);
+  if (inputs[0].storage_type() == kCSRStorage &&
+      inputs[1].storage_type() == kDefaultStorage &&
+      outputs[0].storage_type() == kDefaultStorage && !param.transpose_b) {
+    CHECK(outputs[0].dtype() == mshadow::kFloat32 || outputs[0].dtype() == mshadow::kFloat64)
+        << "dot only supports float32 and float64";
+    DotCsrDnsDnsImpl<xpu>(ctx.get_stream<xpu>(), inputs[0], inputs[1].data(), req[0],
+                          param.transpose_a, outputs[0].data());
+  } else {
+    FComputeFallback<xpu>(DotForward_<xpu>, attrs, ctx, inputs, req, outputs);
+  }
+}
+
+/*! \brief the gradient of the rhs is row sparse for a csr lhs on the cpu */
+inline bool DotBackwardInferStorageType(const nnvm::NodeAttrs& attrs,
+                                        const int dev_mask,
+                                        std::vector<int>* in_attrs,
+                                        std::vector<int>* out_attrs) {
+  const DotParam& param = nnvm::get<DotParam>(attrs.parsed);
+  CHECK_EQ(in_attrs->size(), 3U);
+  CHECK_EQ(out_attrs->size(), 2U);
+  const bool rsp_grad = (*in_attrs)[1] == kCSRStorage && !param.transpose_a &&
+                        !param.transpose_b && dev_mask == cpu::kDevMask;
+  (*out_attrs)[0] = kDefaultStorage;
+  (*out_attrs)[1] = rsp_grad ? kRowSparseStorage : kDefaultStorage;
+  return true;
+}
+
+template<typename xpu>
+void DotBackwardEx(const nnvm::NodeAttrs& attrs,
+                   const OpContext& ctx,
+                   const std::vector<NDArray>& inputs,
+                   const std::vector<OpReqType>& req,
+                   const std::vector<NDArray>& outputs) {
+  using namespace mshadow;
+  using namespace mshadow::expr;
+  const DotParam& param = nnvm::get<DotParam>(attrs.parsed);
+  CHECK_EQ(inputs.size(), 3U);
+  CHECK_EQ(outputs.size(), 2U);
+  const NDArray& ograd = inputs[0];
+  const NDArray& lhs = inputs[1];
+  const NDArray& rhs = inputs[2];
+  const NDArray& lhs_grad = outputs[0];
+  const NDArray& rhs_grad = outputs[1];
+  if (lhs.storage_type() != kCSRStorage || ograd.storage_type() != kDefaultStorage ||
+      rhs.storage_type() != kDefaultStorage || lhs_grad.storage_type() != kDefaultStorage ||
+      param.transpose_b ||
+      (rhs_grad.storage_type() == kRowSparseStorage && param.transpose_a) ||
+      rhs_grad.storage_type() == kCSRStorage) {
+    FComputeFallback<xpu>(DotBackward_<xpu>, attrs, ctx, inputs, req, outputs);
+    return;
+  }
+  Stream<xpu>* s = ctx.get_stream<xpu>();
+  CHECK(ograd.dtype() == kFloat32 || ograd.dtype() == kFloat64)
+      << "dot only supports float32 and float64";
+  // dy = dot(x.T, dz) or, for z = dot(x.T, y), dy = dot(x, dz)
+  if (rhs_grad.storage_type() == kRowSparseStorage) {
+    DotCsrTransDnsRspImpl(s, lhs, ograd.data(), req[1], rhs_grad);
+  } else {
+    DotCsrDnsDnsImpl<xpu>(s, lhs, ograd.data(), req[1], !param.transpose_a, rhs_grad.data());
+  }
+  // dx = dot(dz, y.T) or, for z = dot(x.T, y), dx = dot(y, dz.T), which is dense anyway
+  if (req[0] == kNullOp) return;
+  CHECK_NE(req[0], kWriteInplace);
+  const TBlob lg = lhs_grad.data();
+  const TBlob og = ograd.data();
+  const TBlob rd = rhs.data();
+  const int n = rd.Size() / rd.shape_[0];
+  MSHADOW_TYPE_SWITCH(og.type_flag_, DType, {
+    Tensor<xpu, 2, DType> mlhs_grad =
+        lg.get_with_shape<xpu, 2, DType>(Shape2(lg.shape_[0], lg.shape_[1]), s);
+    Tensor<xpu, 2, DType> mout_grad =
+        og.get_with_shape<xpu, 2, DType>(Shape2(og.shape_[0], n), s);
+    Tensor<xpu, 2, DType> mrhs_data =
+        rd.get_with_shape<xpu, 2, DType>(Shape2(rd.shape_[0], n), s);
+    if (param.transpose_a) {
+      ASSIGN_DISPATCH(mlhs_grad, req[0], dot(mrhs_data, mout_grad.T()));
+    } else {
+      ASSIGN_DISPATCH(mlhs_grad, req[0], dot(mout_grad, mrhs_data.T()));
+    }
+  });
+}
+
+/*! \brief float16 runs on the gpu only, the cpu BLAS has no float16 gemm */
+template<typename xpu>
+inline void CheckBatchDotType(int type_flag) {
+  CHECK(type_flag == kFloat32 || type_flag == kFloat64 ||
+        (type_flag == kFloat16 && std::is_same<xpu, gpu>::value))
+      << "batch_dot only supports float32 and float64, and float16 on the gpu";
+}
+
 template<typename xpu>
 void BatchDotForward_(const nnvm::NodeAttrs& attrs,
                       const OpContext& ctx,
@@ -584,33 +788,15 @@ void BatchDotForward_(const nnvm::NodeAttrs& attrs,
       << "Binary function only support input/output with the same type";
   CHECK_EQ(outputs[0].type_flag_, inputs[1].type_flag_)
       << "Binary function only support input/output with the same type";
-  CHECK(outputs[0].type_flag_ == kFloat32 || outputs[0].type_flag_ == kFloat64)
-      << "dot only supports float32 and float64";
-  MSHADOW_TYPE_SWITCH(outputs[0].type_flag_, DType, {
+  CheckBatchDotType<xpu>(outputs[0].type_flag_);
+  if (kNullOp == req[0]) return;
+  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
     mshadow::Tensor<xpu, 3, DType> out = outputs[0].get<xpu, 3, DType>(s);
     mshadow::Tensor<xpu, 3, DType> mlhs = inputs[0].get<xpu, 3, DType>(s);
     mshadow::Tensor<xpu, 3, DType> mrhs = inputs[1].get<xpu, 3, DType>(s);
-    mshadow::Tensor<xpu, 1, DType*> workspace =
-      ctx.requested[0].get_space_typed<xpu, 1, DType*>(mshadow::Shape1(3 * out.size(0)), s);
-    if (kNullOp != req[0]) {
-      if (param.transpose_a && param.transpose_b) {
-        mshadow::BatchGEMM<true, true>(out, mlhs, mrhs, (DType)1.0f,
-                                       (kAddTo == req[0]) ? (DType)1.0f : (DType)0.0f,
-                                       workspace);
-      } else if (!param.transpose_a && param.transpose_b) {
-        mshadow::BatchGEMM<false, true>(out, mlhs, mrhs, (DType)1.0f,
-                                       (kAddTo == req[0]) ? (DType)1.0f : (DType)0.0f,
-                                       workspace);
-      } else if (param.transpose_a && !param.transpose_b) {
-        mshadow::BatchGEMM<true, false>(out, mlhs, mrhs, (DType)1.0f,
-                                       (kAddTo == req[0]) ? (DType)1.0f : (DType)0.0f,
-                                       workspace);
-      } else {
-        mshadow::BatchGEMM<false, false>(out, mlhs, mrhs, (DType)1.0f,
-                                       (kAddTo == req[0]) ? (DType)1.0f : (DType)0.0f,
-                                       workspace);
-      }
-    }
+    linalg_batch_gemm(mlhs, mrhs, out, DType(1.0f),
+                      (kAddTo == req[0]) ? DType(1.0f) : DType(0.0f),
+                      param.transpose_a, param.transpose_b, s);
   });
 }
 
@@ -626,74 +812,55 @@ void BatchDotBackward_(const nnvm::NodeAttrs& attrs,
   const DotParam& param = nnvm::get<DotParam>(attrs.parsed);
   CHECK_NE(req[1], kWriteInplace);
   CHECK_NE(req[0], kWriteInplace);
-  CHECK(outputs[0].type_flag_ == kFloat32 || outputs[0].type_flag_ == kFloat64)
-      << "dot only supports float32 and float64";
-  MSHADOW_TYPE_SWITCH(outputs[0].type_flag_, DType, {
+  CheckBatchDotType<xpu>(outputs[0].type_flag_);
+  MSHADOW_REAL_TYPE_SWITCH(outputs[0].type_flag_, DType, {
     mshadow::Tensor<xpu, 3, DType> mout_grad = inputs[0].get<xpu, 3, DType>(s);
     mshadow::Tensor<xpu, 3, DType> mlhs_data = inputs[1].get<xpu, 3, DType>(s);
     mshadow::Tensor<xpu, 3, DType> mrhs_data = inputs[2].get<xpu, 3, DType>(s);
     mshadow::Tensor<xpu, 3, DType> mlhs_grad = outputs[0].get<xpu, 3, DType>(s);
     mshadow::Tensor<xpu, 3, DType> mrhs_grad = outputs[1].get<xpu, 3, DType>(s);
-    mshadow::Tensor<xpu, 2, DType*> workspace =
-      ctx.requested[0].get_space_typed<xpu, 2, DType*>(
-        mshadow::Shape2(2, 3 * mout_grad.size(0)), s);
-    mshadow::Tensor<xpu, 1, DType*> rhs_workspace = workspace[0];
-    mshadow::Tensor<xpu, 1, DType*> lhs_workspace = workspace[1];
+    const DType one(1.0f), zero(0.0f);
+    const DType rhs_beta = (kAddTo == req[1]) ? one : zero;
+    const DType lhs_beta = (kAddTo == req[0]) ? one : zero;
     if (param.transpose_a && param.transpose_b) {
       // Gradient of z = dot(x.T, y.T)
       // dy = dot(x, dz).T = dot(dz.T, x.T)
       // dx = dot(dz, y).T = dot(y.T, dz.T)
       if (kNullOp != req[1]) {
-        mshadow::BatchGEMM<true, true>(mrhs_grad, mout_grad, mlhs_data, (DType)1.0f,
-                                        (kAddTo == req[1]) ? (DType)1.0f :  (DType)0.0f,
-                                        rhs_workspace);
+        linalg_batch_gemm(mout_grad, mlhs_data, mrhs_grad, one, rhs_beta, true, true, s);
       }
       if (kNullOp != req[0]) {
-        mshadow::BatchGEMM<true, true>(mlhs_grad, mrhs_data, mout_grad, (DType)1.0f,
-                                        (kAddTo == req[0]) ? (DType)1.0f : (DType)0.0f,
-                                        lhs_workspace);
+        linalg_batch_gemm(mrhs_data, mout_grad, mlhs_grad, one, lhs_beta, true, true, s);
       }
     } else if (!param.transpose_a && param.transpose_b) {
       // Gradient of z = dot(x, y.T)
       // dy = dot(x.T, dz).T = dot(dz.T, x)
       // dx = dot(dz, y)
       if (kNullOp != req[1]) {
-        mshadow::BatchGEMM<true, false>(mrhs_grad, mout_grad, mlhs_data, (DType)1.0f,
-                                        (kAddTo == req[1]) ? (DType)1.0f : (DType)0.0f,
-                                        rhs_workspace);
+        linalg_batch_gemm(mout_grad, mlhs_data, mrhs_grad, one, rhs_beta, true, false, s);
       }
       if (kNullOp != req[0]) {
-        mshadow::BatchGEMM<false, false>(mlhs_grad, mout_grad, mrhs_data, (DType)1.0f,
-                                        (kAddTo == req[0]) ? (DType)1.0f : (DType)0.0f,
-                                        lhs_workspace);
+        linalg_batch_gemm(mout_grad, mrhs_data, mlhs_grad, one, lhs_beta, false, false, s);
       }
     } else if (param.transpose_a && !param.transpose_b) {
       // Gradient of z = dot(x.T, y)
       // dy = dot(x, dz)
       // dx = dot(dz, y.T).T = dot(y, dz.T)
       if (kNullOp != req[1]) {
-        mshadow::BatchGEMM<false, false>(mrhs_grad, mlhs_data, mout_grad, (DType)1.0f,
-                                        (kAddTo == req[1]) ? (DType)1.0f : (DType)0.0f,
-                                        rhs_workspace);
+        linalg_batch_gemm(mlhs_data, mout_grad, mrhs_grad, one, rhs_beta, false, false, s);
       }
       if (kNullOp != req[0]) {
-        mshadow::BatchGEMM<false, true>(mlhs_grad, mrhs_data, mout_grad, (DType)1.0f,
-                                        (kAddTo == req[0]) ? (DType)1.0f : (DType)0.0f,
-                                        lhs_workspace);
+        linalg_batch_gemm(mrhs_data, mout_grad, mlhs_grad, one, lhs_beta, false, true, s);
       }
     } else {
       // Gradient of z = dot(x, y)
       // dy = dot(x.T, dz)
       // dx = dot(dz, y.T)
       if (kNullOp != req[1]) {
-        mshadow::BatchGEMM<true, false>(mrhs_grad, mlhs_data, mout_grad, (DType)1.0f,
-                                        (kAddTo == req[1]) ? (DType)1.0f : (DType)0.0f,
-                                        rhs_workspace);
+        linalg_batch_gemm(mlhs_data, mout_grad, mrhs_grad, one, rhs_beta, true, false, s);
       }
       if (kNullOp != req[0]) {
-        mshadow::BatchGEMM<false, true>(mlhs_grad, mout_grad, mrhs_data, (DType)1.0f,
-                                        (kAddTo == req[0]) ? (DType)1.0f : (DType)0.0f,
-                                        lhs_workspace);
+        linalg_batch_gemm(mout_grad, mrhs_data, mlhs_grad, one, lhs_beta, false, true, s);
       }
     }
   });
@@ -1216,33 +1383,35 @@ struct ClipParam : public dmlc::Parameter<ClipParam> {
 };
 
 
+template<int req>
 struct clip {
   template<typename DType>
   MSHADOW_XINLINE static void Map(int i, DType* out, const DType* datas,
                                   DType a_min, DType a_max) {
     DType data = datas[i];
     if (data > a_max) {
-      out[i] = a_max;
+      KERNEL_ASSIGN(out[i], req, a_max);
     } else if (data < a_min) {
-      out[i] = a_min;
+      KERNEL_ASSIGN(out[i], req, a_min);
     } else {
-      out[i] = data;
+      KERNEL_ASSIGN(out[i], req, data);
     }
   }
 };
 
 
+template<int req>
 struct clip_grad {
   template<typename DType>
   MSHADOW_XINLINE static void Map(int i, DType* out, const DType* grad, const DType* datas,
                                   DType a_min, DType a_max) {
     DType data = datas[i];
     if (data > a_max) {
-      out[i] = 0;
+      KERNEL_ASSIGN(out[i], req, DType(0));
     } else if (data < a_min) {
-      out[i] = 0;
+      KERNEL_ASSIGN(out[i], req, DType(0));
     } else {
-      out[i] = grad[i];
+      KERNEL_ASSIGN(out[i], req, grad[i]);
     }
   }
 };
@@ -1261,8 +1430,10 @@ void Clip(const nnvm::NodeAttrs& attrs,
   Stream<xpu> *s = ctx.get_stream<xpu>();
 
   MSHADOW_TYPE_SWITCH(outputs[0].type_flag_, DType, {
-    Kernel<clip, xpu>::Launch(s, outputs[0].Size(), outputs[0].dptr<DType>(),
-    inputs[0].dptr<DType>(), DType(param.a_min), DType(param.a_max));
+    MXNET_ASSIGN_REQ_SWITCH(req[0], req_type, {
+      Kernel<clip<req_type>, xpu>::Launch(s, outputs[0].Size(), outputs[0].dptr<DType>(),
+      inputs[0].dptr<DType>(), DType(param.a_min), DType(param.a_max));
+    });
   });
 }
 
@@ -1278,8 +1449,11 @@ void ClipGrad_(const nnvm::NodeAttrs& attrs,
   CHECK_EQ(inputs[0].type_flag_, outputs[0].type_flag_);
   Stream<xpu> *s = ctx.get_stream<xpu>();
   MSHADOW_TYPE_SWITCH(outputs[0].type_flag_, DType, {
-    Kernel<clip_grad, xpu>::Launch(s, outputs[0].Size(), outputs[0].dptr<DType>(),
-    inputs[0].dptr<DType>(), inputs[1].dptr<DType>(), DType(param.a_min), DType(param.a_max));
+    MXNET_ASSIGN_REQ_SWITCH(req[0], req_type, {
+      Kernel<clip_grad<req_type>, xpu>::Launch(s, outputs[0].Size(), outputs[0].dptr<DType>(),
+      inputs[0].dptr<DType>(), inputs[1].dptr<DType>(), DType(param.a_min),
+      DType(param.a_max));
+    });
   });
 }
 
@@ -1794,6 +1968,41 @@ void ReverseOpForward(const nnvm::NodeAttrs& attrs,
 }
 
 
+/*!
+ * \brief out[r * dpitch + c] = in[r * spitch + c] for the rows of width
+ *  elements, the slices stack copies into and out of
+ */
+struct copy_rows {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const DType* in, const int dpitch,
+                                  const int spitch, const int width) {
+    const int r = i / width, c = i - r * width;
+    out[r * dpitch + c] = in[r * spitch + c];
+  }
+};
+
+/*! \brief copies nrow rows of width elements, see copy_rows */
+template<typename xpu, typename DType>
+inline void CopyRows(mshadow::Stream<xpu> *s, DType* out, int dpitch, const DType* in,
+                     int spitch, int width, int nrow) {
+  mxnet_op::Kernel<copy_rows, xpu>::Launch(s, nrow * width, out, in, dpitch, spitch, width);
+}
+
+/*! \brief on the cpu the rows are copied by chunks of the kernel grain */
+template<typename DType>
+inline void CopyRows(mshadow::Stream<cpu> *s, DType* out, int dpitch, const DType* in,
+                     int spitch, int width, int nrow) {
+  const int grain = mxnet_op::KernelGrain<copy_rows>::Get();
+  const int nthread = mxnet_op::KernelNumThreads(nrow * width, grain);
+  const int nchunk = (width + grain - 1) / grain;
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int i = 0; i < nrow * nchunk; ++i) {
+    const int r = i / nchunk, c = (i - r * nchunk) * grain;
+    std::memcpy(out + r * dpitch + c, in + r * spitch + c,
+                std::min(grain, width - c) * sizeof(DType));
+  }
+}
+
 struct StackParam : public dmlc::Parameter<StackParam> {
   int axis;
   int num_args;
@@ -1863,7 +2072,15 @@ void StackOpForward(const nnvm::NodeAttrs& attrs,
       Shape<3> dshape = Shape3(leading, 1, trailing);
       data[i] = inputs[i].get_with_shape<xpu, 3, DType>(dshape, s);
     }
-    Concatenate(data, &out, 1, req[0]);
+    if (req[0] == kWriteTo) {
+      // each input fills the rows of trailing elements of its slot in out
+      for (index_t i = 0; i < inputs.size(); ++i) {
+        CopyRows(s, out.dptr_ + i * trailing, mid * trailing, data[i].dptr_,
+                 trailing, trailing, leading);
+      }
+    } else {
+      Concatenate(data, &out, 1, req[0]);
+    }
   })
 }
 
@@ -1897,7 +2114,16 @@ void StackOpBackward(const nnvm::NodeAttrs& attrs,
       Shape<3> dshape = Shape3(leading, 1, trailing);
       grad_in[i] = outputs[i].get_with_shape<xpu, 3, DType>(dshape, s);
     }
-    Split(grad, &grad_in, 1, req);
+    if (std::all_of(req.begin(), req.end(),
+                    [](OpReqType r) { return r == kWriteTo || r == kNullOp; })) {
+      for (index_t i = 0; i < outputs.size(); ++i) {
+        if (req[i] == kNullOp) continue;
+        CopyRows(s, grad_in[i].dptr_, trailing, grad.dptr_ + i * trailing,
+                 mid * trailing, trailing, leading);
+      }
+    } else {
+      Split(grad, &grad_in, 1, req);
+    }
   })
 }
 
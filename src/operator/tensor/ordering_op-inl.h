@@ -27,9 +27,13 @@
 #include <mxnet/operator_util.h>
 #include <dmlc/optional.h>
 #include <mshadow/tensor.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 #include <type_traits>
 #include "../mshadow_op.h"
+#include "../mxnet_op.h"
 #include "../elemwise_op_common.h"
 #include "./sort_op.h"
 #include "./indexing_op.h"
@@ -150,6 +154,208 @@ inline void ParseTopKParam(const TShape& src_shape, const TopKParam& param, TSha
                                       << *element_num << ", get k = " << *k;
 }
 
+namespace topk {
+/*! \brief a row selects its k first values rather than sorting when k * kSelectRatio < n */
+const int kSelectRatio = 8;
+/*! \brief the rows shorter than this are sorted by comparisons rather than radix */
+const int kRadixMinSize = 256;
+/*! \brief the fewest values an OpenMP thread sorts or selects from */
+const int kGrain = 4096;
+
+/*!
+ * \brief the bits of a value as an unsigned key whose ascending order is the
+ *  order of the row, -0 and 0 being the same key
+ */
+inline uint32_t SortKey(float v, bool is_ascend) {
+  uint32_t u;
+  std::memcpy(&u, &v, sizeof(u));
+  if (u == 0x80000000u) u = 0;
+  u = (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+  return is_ascend ? u : ~u;
+}
+
+/*! \brief orders the positions of a row by key, the ties by position as a stable sort does */
+struct KeyLess {
+  const uint32_t* key;
+  bool operator()(int a, int b) const {
+    return key[a] < key[b] || (key[a] == key[b] && a < b);
+  }
+};
+
+/*! \brief moves the k first of the positions idx[0, n) to the front of idx, in order */
+inline void Select(const uint32_t* key, int* idx, int n, int k) {
+  KeyLess less = {key};
+  if (k < n) std::nth_element(idx, idx + k, idx + n, less);
+  std::sort(idx, idx + k, less);
+}
+
+/*!
+ * \brief stable LSD radix sort of the positions idx[0, n) by their keys
+ *  key[0, n), using key_tmp and idx_tmp as buffers
+ * \return the sorted positions, either idx or idx_tmp
+ */
+inline const int* RadixSort(uint32_t* key, int* idx, uint32_t* key_tmp, int* idx_tmp, int n) {
+  std::vector<int> hist(4 * 256, 0);
+  for (int i = 0; i < n; ++i) {
+    for (int p = 0; p < 4; ++p) ++hist[p * 256 + ((key[i] >> (8 * p)) & 255)];
+  }
+  for (int p = 0; p < 4; ++p) {
+    int* h = &hist[p * 256];
+    // a digit all the keys share leaves the order as it is
+    if (h[(key[0] >> (8 * p)) & 255] == n) continue;
+    for (int d = 0, sum = 0; d < 256; ++d) {
+      const int c = h[d];
+      h[d] = sum;
+      sum += c;
+    }
+    for (int i = 0; i < n; ++i) {
+      const int pos = h[(key[i] >> (8 * p)) & 255]++;
+      key_tmp[pos] = key[i];
+      idx_tmp[pos] = idx[i];
+    }
+    std::swap(key, key_tmp);
+    std::swap(idx, idx_tmp);
+  }
+  return idx;
+}
+
+/*! \brief the buffers of a thread sorting rows */
+struct Workspace {
+  std::vector<uint32_t> key, key_tmp;
+  std::vector<int> idx, idx_tmp, cand;
+  std::vector<real_t> val;
+};
+
+/*!
+ * \brief writes the values of the row dat at the positions order[0, k) to
+ *  the front of dat, and the positions offset by base to the front of indices
+ */
+inline void WriteRow(real_t* dat, real_t* indices, const int* order, int k, int base,
+                     std::vector<real_t>* val) {
+  val->resize(k);
+  for (int j = 0; j < k; ++j) (*val)[j] = dat[order[j]];
+  for (int j = 0; j < k; ++j) {
+    dat[j] = (*val)[j];
+    indices[j] = static_cast<real_t>(base + order[j]);
+  }
+}
+
+/*! \brief SortRows of a row dat[0, n) by a thread */
+inline void SortRow(real_t* dat, real_t* indices, int n, int k, bool is_ascend, int base,
+                    Workspace* ws) {
+  ws->key.resize(n);
+  ws->idx.resize(n);
+  for (int i = 0; i < n; ++i) {
+    ws->key[i] = SortKey(dat[i], is_ascend);
+    ws->idx[i] = i;
+  }
+  const int* order = ws->idx.data();
+  if (static_cast<int64_t>(k) * kSelectRatio < n || n < kRadixMinSize) {
+    Select(ws->key.data(), ws->idx.data(), n, k);
+  } else {
+    ws->key_tmp.resize(n);
+    ws->idx_tmp.resize(n);
+    order = RadixSort(ws->key.data(), ws->idx.data(), ws->key_tmp.data(), ws->idx_tmp.data(), n);
+  }
+  WriteRow(dat, indices, order, k, base, &ws->val);
+}
+
+/*!
+ * \brief SortRow of a long row whose k first values are selected: each of
+ *  nchunk threads selects the k first of a chunk of the row, and the k first
+ *  of these are the ones of the row.
+ */
+inline void SelectRowChunked(real_t* dat, real_t* indices, int n, int k, bool is_ascend,
+                             int base, int nchunk, Workspace* ws) {
+  ws->key.resize(n);
+  ws->idx.resize(n);
+  ws->cand.resize(static_cast<size_t>(nchunk) * k);
+  std::vector<int> ncand(nchunk);
+  uint32_t* key = ws->key.data();
+  int* idx = ws->idx.data();
+  int* cand = ws->cand.data();
+  const int chunk = (n + nchunk - 1) / nchunk;
+  #pragma omp parallel for num_threads(nchunk) if (nchunk > 1)
+  for (int c = 0; c < nchunk; ++c) {
+    const int begin = std::min(n, c * chunk);
+    const int end = std::min(n, begin + chunk);
+    for (int i = begin; i < end; ++i) {
+      key[i] = SortKey(dat[i], is_ascend);
+      idx[i] = i;
+    }
+    ncand[c] = std::min(k, end - begin);
+    Select(key, idx + begin, end - begin, ncand[c]);
+    std::copy(idx + begin, idx + begin + ncand[c], cand + static_cast<size_t>(c) * k);
+  }
+  int m = 0;
+  for (int c = 0; c < nchunk; ++c) {
+    for (int j = 0; j < ncand[c]; ++j) cand[m++] = cand[static_cast<size_t>(c) * k + j];
+  }
+  Select(key, cand, m, k);
+  WriteRow(dat, indices, cand, k, base, &ws->val);
+}
+}  // namespace topk
+
+/*!
+ * \brief sorts each row of element_num values of dat so that its k first
+ *  values come first, with their indices in the flattened batch in indices,
+ *  and sets batch_id to the row of each index. The gpu sorts the whole
+ *  batch by SortByKey, which is stable, then orders it by row.
+ */
+template<typename xpu>
+inline void TopKSortRows(mshadow::Tensor<xpu, 1, real_t> dat,
+                         mshadow::Tensor<xpu, 1, real_t> indices,
+                         mshadow::Tensor<xpu, 1, real_t> batch_id,
+                         int batch_size, int element_num, int k, bool is_ascend) {
+  using namespace mshadow::expr;
+  // Sort the data and keep record of the correspondence to global indices.
+  mxnet::op::SortByKey(dat, indices, is_ascend);
+  // Calculate the corresponding batch indices of the elements
+  batch_id = F<mshadow_op::floor>(indices / static_cast<real_t>(element_num));
+  // Since the SortByKey performs stable sort, the second SortByKey will reorder
+  //   the dat based on the order of the batch_id
+  mxnet::op::SortByKey(batch_id, dat, true);
+  // Reorder the indices
+  batch_id = F<mshadow_op::floor>(indices / static_cast<real_t>(element_num));
+  mxnet::op::SortByKey(batch_id, indices, true);
+}
+
+/*!
+ * \brief TopKSortRows on the cpu, which only orders the k first values of
+ *  each row: the rows are sorted in parallel, by radix on the bits of the
+ *  values, or the k first selected when k is much smaller than the row. A
+ *  batch of fewer rows than threads selects in parallel within each row.
+ */
+inline void TopKSortRows(mshadow::Tensor<cpu, 1, real_t> dat,
+                         mshadow::Tensor<cpu, 1, real_t> indices,
+                         mshadow::Tensor<cpu, 1, real_t> batch_id,
+                         int batch_size, int element_num, int k, bool is_ascend) {
+  using namespace mshadow::expr;
+  static_assert(std::is_same<real_t, float>::value, "the cpu sort keys are the bits of floats");
+  const int n = element_num;
+  const int nthread = mxnet_op::KernelNumThreads(static_cast<int>(dat.size(0)), topk::kGrain);
+  if (static_cast<int64_t>(k) * topk::kSelectRatio < n && batch_size < nthread) {
+    const int nchunk =
+      mxnet_op::KernelNumThreads(n, std::max(topk::kGrain, k * topk::kSelectRatio));
+    topk::Workspace ws;
+    for (int r = 0; r < batch_size; ++r) {
+      topk::SelectRowChunked(dat.dptr_ + r * n, indices.dptr_ + r * n, n, k, is_ascend, r * n,
+                             nchunk, &ws);
+    }
+  } else {
+    const int nrow_thread = std::min(nthread, batch_size);
+    #pragma omp parallel num_threads(nrow_thread) if (nrow_thread > 1)
+    {
+      topk::Workspace ws;
+      #pragma omp for schedule(static)
+      for (int r = 0; r < batch_size; ++r) {
+        topk::SortRow(dat.dptr_ + r * n, indices.dptr_ + r * n, n, k, is_ascend, r * n, &ws);
+      }
+    }
+  }
+  batch_id = F<mshadow_op::floor>(indices / static_cast<real_t>(element_num));
+}
+
 /*!
    * \brief Implementation of the TopK operation
    *
@@ -217,19 +423,9 @@ void TopKImpl(RunContext ctx,
     CHECK_EQ(mask_val.CheckContiguous(), true);
   }
 
-  // 2. Perform inplace batch sort using the `SortByKey` in MShadow
-  // After sorting, each batch in `sorted_dat` will be sorted in the corresponding order
-  //   and the `indices` will contain the corresponding index in `sorted_dat`
-  // Sort the data and keep record of the correspondence to global indices.
-  mxnet::op::SortByKey(sorted_dat, indices, is_ascend);
-  // Calculate the corresponding batch indices of the elements
-  batch_id = F<mshadow_op::floor>(indices / static_cast<real_t>(element_num));
-  // Since the SortByKey performs stable sort, the second SortByKey will reorder
-  //   the sorted_dat based on the order of the batch_id
-  mxnet::op::SortByKey(batch_id, sorted_dat, true);
-  // Reorder the indices
-  batch_id = F<mshadow_op::floor>(indices / static_cast<real_t>(element_num));
-  mxnet::op::SortByKey(batch_id, indices, true);
+  // 2. Sort each batch of `sorted_dat` in the corresponding order, at least its first k
+  //   elements, and keep in `indices` the corresponding global index of each element
+  TopKSortRows(sorted_dat, indices, batch_id, batch_size, element_num, k, is_ascend);
 
   // 3. Assign results to the ret blob
   if (param.ret_typ == topk_enum::kReturnMask) {
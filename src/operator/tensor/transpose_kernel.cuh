@@ -0,0 +1,77 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file transpose_kernel.cuh
+ * \brief gpu 2-D transposes of the tiled transpose kernels, through a tile
+ *  in shared memory so that both the reads and the writes are coalesced
+ */
+#ifndef MXNET_OPERATOR_TENSOR_TRANSPOSE_KERNEL_CUH_
+#define MXNET_OPERATOR_TENSOR_TRANSPOSE_KERNEL_CUH_
+
+const int kTransposeTile = 32;
+const int kTransposeRows = 8;
+
+template<typename DType>
+__global__ void transpose_tiled_kernel(const TransposePlan plan, const DType* __restrict in,
+                                       DType* __restrict out, const index_t row_tiles,
+                                       const index_t col_tiles) {
+  // one more column so that the threads of a warp read a column from different banks
+  __shared__ __align__(8) char smem[kTransposeTile * (kTransposeTile + 1) * sizeof(DType)];
+  DType (*tile)[kTransposeTile + 1] = reinterpret_cast<DType (*)[kTransposeTile + 1]>(smem);
+  const index_t nrow = plan.nrow(), ncol = plan.ncol();
+  const index_t lda = plan.istride[plan.perm[plan.ndim - 1]];
+  const index_t ldb = plan.ostride[plan.col_pos];
+  const index_t ntile = plan.batch * row_tiles * col_tiles;
+  for (index_t t = blockIdx.x; t < ntile; t += gridDim.x) {
+    const index_t b = t / (row_tiles * col_tiles);
+    const index_t r0 = (t / col_tiles) % row_tiles * kTransposeTile;
+    const index_t c0 = t % col_tiles * kTransposeTile;
+    index_t in_off, out_off;
+    plan.Offsets(b, &in_off, &out_off);
+    // the threads of a warp read along an input row
+    const index_t c = c0 + threadIdx.x;
+    for (int i = threadIdx.y; i < kTransposeTile; i += kTransposeRows) {
+      if (r0 + i < nrow && c < ncol) tile[i][threadIdx.x] = in[in_off + (r0 + i) * lda + c];
+    }
+    __syncthreads();
+    // and write along an output row
+    const index_t r = r0 + threadIdx.x;
+    for (int i = threadIdx.y; i < kTransposeTile; i += kTransposeRows) {
+      if (r < nrow && c0 + i < ncol) out[out_off + (c0 + i) * ldb + r] = tile[threadIdx.x][i];
+    }
+    __syncthreads();
+  }
+}
+
+/*! \brief out = the permutation of in by plan, on the gpu, for the 2-D transposes */
+template<typename DType>
+inline void Transpose(mshadow::Stream<gpu>* s, const TransposePlan& plan,
+                      const DType* in, DType* out) {
+  const index_t row_tiles = (plan.nrow() + kTransposeTile - 1) / kTransposeTile;
+  const index_t col_tiles = (plan.ncol() + kTransposeTile - 1) / kTransposeTile;
+  const index_t ntile = plan.batch * row_tiles * col_tiles;
+  const int ngrid = std::min<index_t>(mshadow::cuda::kMaxGridNum, ntile);
+  transpose_tiled_kernel<DType>
+    <<<ngrid, dim3(kTransposeTile, kTransposeRows), 0, mshadow::Stream<gpu>::GetStream(s)>>>(
+      plan, in, out, row_tiles, col_tiles);
+  MSHADOW_CUDA_POST_KERNEL_CHECK(transpose_tiled_kernel);
+}
+
+#endif  // MXNET_OPERATOR_TENSOR_TRANSPOSE_KERNEL_CUH_
@@ -0,0 +1,283 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file transpose_kernel.h
+ * \brief tiled kernels of transpose and SwapAxis
+ *
+ * A permutation is first compacted: the axes of size 1 are dropped and the
+ * axes that stay next to each other are merged. What is left is either a
+ * copy of contiguous rows, when the last axis stays last, or a batch of 2-D
+ * transposes between the input axis that becomes the last one of the output
+ * and the last input axis. The 2-D transposes run by tiles, which are split
+ * between the OpenMP threads on the cpu and between the blocks on the gpu.
+ */
+#ifndef MXNET_OPERATOR_TENSOR_TRANSPOSE_KERNEL_H_
+#define MXNET_OPERATOR_TENSOR_TRANSPOSE_KERNEL_H_
+
+#include <mxnet/base.h>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <type_traits>
+#include "../mxnet_op.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__CUDACC__)
+#define MXNET_TRANSPOSE_SIMD 1
+#include <immintrin.h>
+#else
+#define MXNET_TRANSPOSE_SIMD 0
+#endif
+
+namespace mxnet {
+namespace op {
+namespace transpose_kernel {
+
+const int kMaxDim = 6;
+
+/*! \brief a compacted permutation, output axis i is input axis perm[i] */
+struct TransposePlan {
+  int ndim;
+  index_t shape[kMaxDim];
+  int perm[kMaxDim];
+  /*! \brief strides of the input axes */
+  index_t istride[kMaxDim];
+  /*! \brief strides of the output axes */
+  index_t ostride[kMaxDim];
+  /*! \brief output position of the last input axis */
+  int col_pos;
+  /*! \brief number of rows to copy or of 2-D transposes */
+  index_t batch;
+
+  /*! \brief whether the last axis stays last, so that rows are copied */
+  MSHADOW_XINLINE bool rows() const { return perm[ndim - 1] == ndim - 1; }
+  /*! \brief the rows of each 2-D transpose, the input axis that becomes the last */
+  MSHADOW_XINLINE index_t nrow() const { return shape[perm[ndim - 1]]; }
+  /*! \brief the columns of each 2-D transpose, the last input axis */
+  MSHADOW_XINLINE index_t ncol() const { return shape[ndim - 1]; }
+  /*!
+   * \brief the offsets in the input and the output of the b-th row or 2-D
+   *  transpose, walking the output axes other than the transposed ones
+   */
+  MSHADOW_XINLINE void Offsets(index_t b, index_t* in_off, index_t* out_off) const {
+    *in_off = 0;
+    *out_off = 0;
+    for (int i = ndim - 2; i >= 0; --i) {
+      if (i == col_pos) continue;
+      const index_t n = shape[perm[i]];
+      const index_t coord = b % n;
+      b /= n;
+      *in_off += coord * istride[perm[i]];
+      *out_off += coord * ostride[i];
+    }
+  }
+};
+
+/*! \brief compacts the permutation axes of an array of the given shape */
+inline TransposePlan MakePlan(const TShape& shape, const TShape& axes) {
+  CHECK_LE(shape.ndim(), static_cast<index_t>(kMaxDim))
+    << "Transpose support at most " << kMaxDim << " dimensions";
+  // drop the axes of size 1
+  int kept[kMaxDim];
+  int m = 0;
+  for (index_t i = 0; i < axes.ndim(); ++i) {
+    if (shape[axes[i]] != 1) kept[m++] = axes[i];
+  }
+  // the runs of consecutive input axes in the output become one axis
+  int first[kMaxDim];
+  index_t size[kMaxDim];
+  int ngroup = 0;
+  for (int i = 0; i < m; ++i) {
+    if (i == 0 || kept[i] != kept[i - 1] + 1) {
+      first[ngroup] = kept[i];
+      size[ngroup++] = 1;
+    }
+    size[ngroup - 1] *= shape[kept[i]];
+  }
+  TransposePlan plan;
+  plan.ndim = ngroup;
+  // the input axis of a group is its rank by first input axis
+  for (int g = 0; g < ngroup; ++g) {
+    int rank = 0;
+    for (int h = 0; h < ngroup; ++h) rank += first[h] < first[g];
+    plan.perm[g] = rank;
+    plan.shape[rank] = size[g];
+  }
+  if (ngroup == 0) {
+    plan.ndim = 1;
+    plan.perm[0] = 0;
+    plan.shape[0] = 1;
+  }
+  index_t stride = 1;
+  for (int i = plan.ndim - 1; i >= 0; --i) {
+    plan.istride[i] = stride;
+    stride *= plan.shape[i];
+  }
+  const index_t total = stride;
+  stride = 1;
+  plan.col_pos = plan.ndim - 1;
+  for (int i = plan.ndim - 1; i >= 0; --i) {
+    plan.ostride[i] = stride;
+    stride *= plan.shape[plan.perm[i]];
+    if (plan.perm[i] == plan.ndim - 1) plan.col_pos = i;
+  }
+  plan.batch = plan.rows() ? total / plan.ncol() : total / (plan.nrow() * plan.ncol());
+  return plan;
+}
+
+#if MXNET_TRANSPOSE_SIMD
+/*! \brief transposes the 8x8 block at in, of row stride lda, into out, of row stride ldb */
+__attribute__((target("avx")))
+inline void Transpose8x8AVX(const float* in, index_t lda, float* out, index_t ldb) {
+  const __m256 r0 = _mm256_loadu_ps(in);
+  const __m256 r1 = _mm256_loadu_ps(in + lda);
+  const __m256 r2 = _mm256_loadu_ps(in + 2 * lda);
+  const __m256 r3 = _mm256_loadu_ps(in + 3 * lda);
+  const __m256 r4 = _mm256_loadu_ps(in + 4 * lda);
+  const __m256 r5 = _mm256_loadu_ps(in + 5 * lda);
+  const __m256 r6 = _mm256_loadu_ps(in + 6 * lda);
+  const __m256 r7 = _mm256_loadu_ps(in + 7 * lda);
+  const __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+  const __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+  const __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+  const __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+  const __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+  const __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+  const __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+  const __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+  const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+  const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+  const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+  _mm256_storeu_ps(out, _mm256_permute2f128_ps(s0, s4, 0x20));
+  _mm256_storeu_ps(out + ldb, _mm256_permute2f128_ps(s1, s5, 0x20));
+  _mm256_storeu_ps(out + 2 * ldb, _mm256_permute2f128_ps(s2, s6, 0x20));
+  _mm256_storeu_ps(out + 3 * ldb, _mm256_permute2f128_ps(s3, s7, 0x20));
+  _mm256_storeu_ps(out + 4 * ldb, _mm256_permute2f128_ps(s0, s4, 0x31));
+  _mm256_storeu_ps(out + 5 * ldb, _mm256_permute2f128_ps(s1, s5, 0x31));
+  _mm256_storeu_ps(out + 6 * ldb, _mm256_permute2f128_ps(s2, s6, 0x31));
+  _mm256_storeu_ps(out + 7 * ldb, _mm256_permute2f128_ps(s3, s7, 0x31));
+}
+
+inline bool HasAVX() {
+  static const bool avx = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+  }();
+  return avx;
+}
+#endif  // MXNET_TRANSPOSE_SIMD
+
+/*!
+ * \brief out[c * ldb + r] = in[r * lda + c] for the tile of nrow x ncol,
+ *  by 8x8 blocks with AVX for the 4 byte types
+ */
+template<typename DType>
+inline void TransposeTile(const DType* in, index_t lda, DType* out, index_t ldb,
+                          index_t nrow, index_t ncol) {
+  index_t r0 = 0;
+#if MXNET_TRANSPOSE_SIMD
+  if (sizeof(DType) == sizeof(float) && HasAVX()) {
+    for (; r0 + 8 <= nrow; r0 += 8) {
+      index_t c0 = 0;
+      for (; c0 + 8 <= ncol; c0 += 8) {
+        Transpose8x8AVX(reinterpret_cast<const float*>(in + r0 * lda + c0), lda,
+                        reinterpret_cast<float*>(out + c0 * ldb + r0), ldb);
+      }
+      for (index_t r = r0; r < r0 + 8; ++r) {
+        for (index_t c = c0; c < ncol; ++c) out[c * ldb + r] = in[r * lda + c];
+      }
+    }
+  }
+#endif  // MXNET_TRANSPOSE_SIMD
+  for (index_t c0 = 0; c0 < ncol; c0 += 8) {
+    const index_t c1 = std::min<index_t>(c0 + 8, ncol);
+    for (index_t r = r0; r < nrow; ++r) {
+      for (index_t c = c0; c < c1; ++c) out[c * ldb + r] = in[r * lda + c];
+    }
+  }
+}
+
+/*! \brief out = the permutation of in by plan, on the cpu */
+template<typename DType>
+inline void Transpose(mshadow::Stream<cpu>* s, const TransposePlan& plan,
+                      const DType* in, DType* out) {
+  const int grain = mxnet_op::KernelGrain<TransposePlan>::Get();
+  if (plan.rows()) {
+    const index_t len = plan.ncol();
+    const int nthread = mxnet_op::KernelNumThreads(
+        static_cast<int>(std::min<size_t>(static_cast<size_t>(plan.batch) * len, INT_MAX)), grain);
+    #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+    for (index_t b = 0; b < plan.batch; ++b) {
+      index_t in_off, out_off;
+      plan.Offsets(b, &in_off, &out_off);
+      std::memcpy(out + out_off, in + in_off, len * sizeof(DType));
+    }
+    return;
+  }
+  // tiles of kTile x kTile that fit in the L1 cache with their output
+  const index_t kTile = 32;
+  const index_t nrow = plan.nrow(), ncol = plan.ncol();
+  const index_t row_tiles = (nrow + kTile - 1) / kTile, col_tiles = (ncol + kTile - 1) / kTile;
+  const index_t lda = plan.istride[plan.perm[plan.ndim - 1]];
+  const index_t ldb = plan.ostride[plan.col_pos];
+  const index_t ntile = plan.batch * row_tiles * col_tiles;
+  const int nthread = mxnet_op::KernelNumThreads(
+      static_cast<int>(std::min<size_t>(static_cast<size_t>(plan.batch) * nrow * ncol, INT_MAX)),
+      grain);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (index_t t = 0; t < ntile; ++t) {
+    const index_t b = t / (row_tiles * col_tiles);
+    const index_t r0 = (t / col_tiles) % row_tiles * kTile;
+    const index_t c0 = t % col_tiles * kTile;
+    index_t in_off, out_off;
+    plan.Offsets(b, &in_off, &out_off);
+    TransposeTile(in + in_off + r0 * lda + c0, lda, out + out_off + c0 * ldb + r0, ldb,
+                  std::min(kTile, nrow - r0), std::min(kTile, ncol - c0));
+  }
+}
+
+#ifdef __CUDACC__
+#include "./transpose_kernel.cuh"
+#endif  // __CUDACC__
+
+/*!
+ * \brief out = the permutation of in by axes with the tiled kernels
+ * \return false if there is no tiled kernel for the permutation on xpu
+ */
+template<typename xpu>
+inline bool TransposeTiled(mshadow::Stream<xpu>* s, const TBlob& in, const TBlob& out,
+                           const TShape& axes) {
+  if (in.shape_.Size() == 0) return true;
+  const TransposePlan plan = MakePlan(in.shape_, axes);
+  if (!std::is_same<xpu, cpu>::value && plan.rows()) return false;
+  MSHADOW_TYPE_SWITCH(out.type_flag_, DType, {
+    Transpose(s, plan, in.dptr<DType>(), out.dptr<DType>());
+  });
+  return true;
+}
+
+}  // namespace transpose_kernel
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_TENSOR_TRANSPOSE_KERNEL_H_
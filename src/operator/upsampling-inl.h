@@ -34,6 +34,7 @@
 #include <string>
 #include <utility>
 #include "./operator_common.h"
+#include "./mxnet_op.h"
 
 namespace mxnet {
 namespace op {
@@ -76,7 +77,7 @@ struct UpSamplingParam : public dmlc::Parameter<UpSamplingParam> {
     "(scale*h_0,scale*w_0) and all other inputs will be upsampled to the"
     "same size. For bilinear upsampling this must be 2; 1 input and 1 weight.");
     DMLC_DECLARE_FIELD(workspace).set_default(512).set_range(0, 8192)
-    .describe("Tmp workspace for deconvolution (MB)");
+    .describe("Not used, bilinear up sampling needs no workspace. Kept for compatibility.");
   }
 };  // struct UpSamplingParam
 
@@ -180,6 +181,166 @@ class UpSamplingNearestOp : public Operator {
   UpSamplingParam param_;
 };  // class UpSamplingNearestOp
 
+/*!
+ * \brief the geometry of the bilinear up sampling, a transposed depthwise
+ *  convolution of stride scale whose kernel covers 2 inputs along each axis:
+ *  out[o] += in[i] * weight[o + pad - i * scale] for the kernel indices in
+ *  [0, kernel)
+ */
+struct UpSamplingBilinearGeom {
+  int channels, in_h, in_w, out_h, out_w;
+  int scale, kernel, pad;
+};
+
+/*! \brief one thread for each output, which gathers the inputs that cover it */
+struct up_bilinear_forward {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* out, const DType* data, const DType* weight,
+                                  const UpSamplingBilinearGeom g, const OpReqType req) {
+    const int ox = i % g.out_w;
+    const int oy = (i / g.out_w) % g.out_h;
+    const int nc = i / g.out_w / g.out_h;
+    const DType* in = data + static_cast<size_t>(nc) * g.in_h * g.in_w;
+    const DType* w = weight + (nc % g.channels) * g.kernel * g.kernel;
+    DType sum = DType(0);
+    const int iy1 = (oy + g.pad) / g.scale, ix1 = (ox + g.pad) / g.scale;
+    for (int iy = iy1 < g.in_h ? iy1 : g.in_h - 1;
+         iy >= 0 && oy + g.pad - iy * g.scale < g.kernel; --iy) {
+      const DType* wy = w + (oy + g.pad - iy * g.scale) * g.kernel;
+      for (int ix = ix1 < g.in_w ? ix1 : g.in_w - 1;
+           ix >= 0 && ox + g.pad - ix * g.scale < g.kernel; --ix) {
+        sum += in[iy * g.in_w + ix] * wy[ox + g.pad - ix * g.scale];
+      }
+    }
+    KERNEL_ASSIGN(out[i], req, sum);
+  }
+};
+
+/*! \brief one thread for each input, which gathers the outputs it covers */
+struct up_bilinear_backward_data {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* grad_data, const DType* grad_out,
+                                  const DType* weight, const UpSamplingBilinearGeom g,
+                                  const OpReqType req) {
+    const int ix = i % g.in_w;
+    const int iy = (i / g.in_w) % g.in_h;
+    const int nc = i / g.in_w / g.in_h;
+    const DType* grad = grad_out + static_cast<size_t>(nc) * g.out_h * g.out_w;
+    const DType* w = weight + (nc % g.channels) * g.kernel * g.kernel;
+    DType sum = DType(0);
+    const int oy0 = iy * g.scale - g.pad, ox0 = ix * g.scale - g.pad;
+    for (int ky = oy0 < 0 ? -oy0 : 0; ky < g.kernel && oy0 + ky < g.out_h; ++ky) {
+      const DType* grad_y = grad + (oy0 + ky) * g.out_w;
+      for (int kx = ox0 < 0 ? -ox0 : 0; kx < g.kernel && ox0 + kx < g.out_w; ++kx) {
+        sum += grad_y[ox0 + kx] * w[ky * g.kernel + kx];
+      }
+    }
+    KERNEL_ASSIGN(grad_data[i], req, sum);
+  }
+};
+
+/*! \brief one thread for each weight, which sums over the batch and the inputs */
+struct up_bilinear_backward_weight {
+  template<typename DType>
+  MSHADOW_XINLINE static void Map(int i, DType* grad_weight, const DType* grad_out,
+                                  const DType* data, const int batch,
+                                  const UpSamplingBilinearGeom g, const OpReqType req) {
+    const int kx = i % g.kernel;
+    const int ky = (i / g.kernel) % g.kernel;
+    const int c = i / g.kernel / g.kernel;
+    // the inputs iy with 0 <= iy * scale - pad + ky < out_h
+    const int iy0 = ky >= g.pad ? 0 : (g.pad - ky + g.scale - 1) / g.scale;
+    const int ix0 = kx >= g.pad ? 0 : (g.pad - kx + g.scale - 1) / g.scale;
+    DType sum = DType(0);
+    for (int n = 0; n < batch; ++n) {
+      const size_t nc = static_cast<size_t>(n) * g.channels + c;
+      const DType* in = data + nc * g.in_h * g.in_w;
+      const DType* grad = grad_out + nc * g.out_h * g.out_w;
+      for (int iy = iy0; iy < g.in_h && iy * g.scale - g.pad + ky < g.out_h; ++iy) {
+        const DType* grad_y = grad + (iy * g.scale - g.pad + ky) * g.out_w;
+        for (int ix = ix0; ix < g.in_w && ix * g.scale - g.pad + kx < g.out_w; ++ix) {
+          sum += in[iy * g.in_w + ix] * grad_y[ix * g.scale - g.pad + kx];
+        }
+      }
+    }
+    KERNEL_ASSIGN(grad_weight[i], req, sum);
+  }
+};
+
+/*!
+ * \brief bilinear up sampling with the depthwise weight, computed directly
+ *  rather than as a deconvolution, so that each output costs the 2x2 inputs
+ *  that cover it. The weight may be learned, its gradient is computed too.
+ */
+template<typename xpu, typename DType>
+class UpSamplingBilinearOp : public Operator {
+ public:
+  explicit UpSamplingBilinearOp(UpSamplingParam p) {
+    this->param_ = p;
+  }
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    using namespace mxnet_op;
+    CHECK_EQ(in_data.size(), 2U);
+    CHECK_EQ(out_data.size(), 1U);
+    if (req[up_enum::kOut] == kNullOp) return;
+    mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+    const TBlob& out = out_data[up_enum::kOut];
+    Kernel<up_bilinear_forward, xpu>::Launch(
+        s, out.Size(), out.dptr<DType>(), in_data[up_enum::kData].dptr<DType>(),
+        in_data[up_enum::kWeight].dptr<DType>(), Geom(in_data[up_enum::kData].shape_),
+        req[up_enum::kOut]);
+  }
+
+  virtual void Backward(const OpContext &ctx,
+                        const std::vector<TBlob> &out_grad,
+                        const std::vector<TBlob> &in_data,
+                        const std::vector<TBlob> &out_data,
+                        const std::vector<OpReqType> &req,
+                        const std::vector<TBlob> &in_grad,
+                        const std::vector<TBlob> &aux_args) {
+    using namespace mxnet_op;
+    CHECK_EQ(out_grad.size(), 1U);
+    CHECK_EQ(in_grad.size(), 2U);
+    mshadow::Stream<xpu> *s = ctx.get_stream<xpu>();
+    const TShape& dshape = in_data[up_enum::kData].shape_;
+    const UpSamplingBilinearGeom g = Geom(dshape);
+    const DType* grad = out_grad[up_enum::kOut].dptr<DType>();
+    if (req[up_enum::kData] != kNullOp) {
+      Kernel<up_bilinear_backward_data, xpu>::Launch(
+          s, in_grad[up_enum::kData].Size(), in_grad[up_enum::kData].dptr<DType>(), grad,
+          in_data[up_enum::kWeight].dptr<DType>(), g, req[up_enum::kData]);
+    }
+    if (req[up_enum::kWeight] != kNullOp) {
+      Kernel<up_bilinear_backward_weight, xpu>::Launch(
+          s, in_grad[up_enum::kWeight].Size(), in_grad[up_enum::kWeight].dptr<DType>(), grad,
+          in_data[up_enum::kData].dptr<DType>(), static_cast<int>(dshape[0]), g,
+          req[up_enum::kWeight]);
+    }
+  }
+
+ private:
+  UpSamplingBilinearGeom Geom(const TShape& dshape) const {
+    UpSamplingBilinearGeom g;
+    g.channels = dshape[1];
+    g.in_h = dshape[2];
+    g.in_w = dshape[3];
+    g.scale = param_.scale;
+    g.out_h = g.in_h * g.scale;
+    g.out_w = g.in_w * g.scale;
+    g.kernel = 2 * g.scale - g.scale % 2;
+    // ceil((scale - 1) / 2)
+    g.pad = g.scale / 2;
+    return g;
+  }
+
+  UpSamplingParam param_;
+};  // class UpSamplingBilinearOp
+
 template<typename xpu>
 Operator *CreateOp(UpSamplingParam param, int dtype);
 
@@ -299,24 +460,6 @@ class UpSamplingProp : public OperatorProperty {
     return {};
   }
 
-  std::vector<ResourceRequest> ForwardResource(
-      const std::vector<TShape> &in_shape) const override {
-    if (param_.sample_type == up_enum::kNearest) {
-      return {};
-    } else {
-      return {ResourceRequest::kTempSpace};
-    }
-  }
-
-  std::vector<ResourceRequest> BackwardResource(
-      const std::vector<TShape> &in_shape) const override {
-    if (param_.sample_type == up_enum::kNearest) {
-      return {};
-    } else {
-      return {ResourceRequest::kTempSpace};
-    }
-  }
-
   Operator* CreateOperator(Context ctx) const override {
     LOG(FATAL) << "Not Implemented";
     return NULL;
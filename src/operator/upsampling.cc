@@ -25,7 +25,6 @@
 
 #include "./upsampling-inl.h"
 #include <nnvm/op_attr_types.h>
-#include "./deconvolution-inl.h"
 
 namespace mxnet {
 namespace op {
@@ -36,23 +35,7 @@ Operator *CreateOp<cpu>(UpSamplingParam param, int dtype) {
     if (param.sample_type == up_enum::kNearest) {
       op = new UpSamplingNearestOp<cpu, DType>(param);
     } else if (param.sample_type == up_enum::kBilinear) {
-      DeconvolutionParam p = DeconvolutionParam();
-      int kernel = 2 * param.scale - param.scale % 2;
-      int stride = param.scale;
-      int pad = static_cast<int>(ceil((param.scale - 1) / 2.));
-      p.workspace = param.workspace;
-      p.num_group = param.num_filter;
-      p.num_filter = param.num_filter;
-      p.no_bias =  true;
-      int shape[] = {1, 1};
-      p.dilate = TShape(shape, shape + 2);
-      shape[0] = shape[1] = kernel;
-      p.kernel = TShape(shape, shape + 2);
-      shape[0] = shape[1] = stride;
-      p.stride = TShape(shape, shape + 2);
-      shape[0] = shape[1] = pad;
-      p.pad = TShape(shape, shape + 2);
-      op = new DeconvolutionOp<cpu, DType>(p);
+      op = new UpSamplingBilinearOp<cpu, DType>(param);
     } else {
       LOG(FATAL) << "Unknown sample type";
     }
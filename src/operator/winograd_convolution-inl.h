@@ -0,0 +1,311 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file winograd_convolution-inl.h
+ * \brief cpu forward pass of the 3x3 stride-1 convolutions by Winograd's minimal filtering
+ *
+ * F(m x m, 3 x 3) computes the outputs by tiles of m x m from the input tiles
+ * of (m + 2) x (m + 2), see Lavin and Gray, Fast Algorithms for Convolutional
+ * Neural Networks. The filters and the input tiles are transformed, the
+ * (m + 2)^2 positions of the transformed tiles are independent gemms over the
+ * channels, and the products are transformed back into the outputs. Unlike
+ * im2col, which copies every input value 9 times, the transformed inputs are
+ * (1 + 2 / m)^2 times the size of the input.
+ */
+#ifndef MXNET_OPERATOR_WINOGRAD_CONVOLUTION_INL_H_
+#define MXNET_OPERATOR_WINOGRAD_CONVOLUTION_INL_H_
+
+#include <dmlc/parameter.h>
+#include <algorithm>
+#include <climits>
+#include <vector>
+#include "./convolution-inl.h"
+#include "./mxnet_op.h"
+
+namespace mxnet {
+namespace op {
+namespace winograd {
+
+/*! \brief the matrices A^T (m x alpha), G (alpha x 3) and B^T (alpha x alpha) of F(m x m, 3 x 3) */
+template<int m>
+struct Transform;
+
+template<>
+struct Transform<2> {
+  static const int kAlpha = 4;
+  template<typename DType>
+  static const DType* AT() {
+    static const DType v[] = {1, 1, 1, 0,
+                              0, 1, -1, -1};
+    return v;
+  }
+  template<typename DType>
+  static const DType* G() {
+    static const DType v[] = {1, 0, 0,
+                              DType(0.5), DType(0.5), DType(0.5),
+                              DType(0.5), -DType(0.5), DType(0.5),
+                              0, 0, 1};
+    return v;
+  }
+  template<typename DType>
+  static const DType* BT() {
+    static const DType v[] = {1, 0, -1, 0,
+                              0, 1, 1, 0,
+                              0, -1, 1, 0,
+                              0, 1, 0, -1};
+    return v;
+  }
+};
+
+template<>
+struct Transform<4> {
+  static const int kAlpha = 6;
+  template<typename DType>
+  static const DType* AT() {
+    static const DType v[] = {1, 1, 1, 1, 1, 0,
+                              0, 1, -1, 2, -2, 0,
+                              0, 1, 1, 4, 4, 0,
+                              0, 1, -1, 8, -8, 1};
+    return v;
+  }
+  template<typename DType>
+  static const DType* G() {
+    static const DType v[] = {DType(1) / 4, 0, 0,
+                              -DType(1) / 6, -DType(1) / 6, -DType(1) / 6,
+                              -DType(1) / 6, DType(1) / 6, -DType(1) / 6,
+                              DType(1) / 24, DType(1) / 12, DType(1) / 6,
+                              DType(1) / 24, -DType(1) / 12, DType(1) / 6,
+                              0, 0, 1};
+    return v;
+  }
+  template<typename DType>
+  static const DType* BT() {
+    static const DType v[] = {4, 0, -5, 0, 1, 0,
+                              0, -4, -4, 1, 1, 0,
+                              0, 4, -4, -1, 1, 0,
+                              0, -2, -1, 2, 1, 0,
+                              0, 2, -1, -2, 1, 0,
+                              0, 4, 0, -5, 0, 1};
+    return v;
+  }
+};
+
+/*! \brief y (r x r) = a (r x k) x (a (r x k) x x (k x k))^T, with a stored row-major */
+template<int r, int k, typename DType>
+inline void Sandwich(const DType* a, const DType* x, DType* y) {
+  DType t[r * k];
+  for (int i = 0; i < r; ++i) {
+    for (int j = 0; j < k; ++j) {
+      DType sum = 0;
+      for (int l = 0; l < k; ++l) sum += a[i * k + l] * x[l * k + j];
+      t[i * k + j] = sum;
+    }
+  }
+  for (int i = 0; i < r; ++i) {
+    for (int j = 0; j < r; ++j) {
+      DType sum = 0;
+      for (int l = 0; l < k; ++l) sum += t[i * k + l] * a[j * k + l];
+      y[i * r + j] = sum;
+    }
+  }
+}
+
+inline int NumThreads(size_t work) {
+  return mxnet_op::KernelNumThreads(static_cast<int>(std::min<size_t>(work, INT_MAX)),
+                                    mxnet_op::KernelGrain<Transform<2> >::Get());
+}
+
+/*! \brief u[xi][k][c] = (G w[k][c] G^T)[xi] */
+template<int m, typename DType>
+inline void TransformFilters(const DType* w, int K, int C, DType* u) {
+  const int a2 = Transform<m>::kAlpha * Transform<m>::kAlpha;
+  const int nthread = NumThreads(static_cast<size_t>(K) * C * a2 * 9);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int kc = 0; kc < K * C; ++kc) {
+    DType t[Transform<m>::kAlpha * Transform<m>::kAlpha];
+    Sandwich<Transform<m>::kAlpha, 3>(Transform<m>::template G<DType>(), w + kc * 9, t);
+    for (int xi = 0; xi < a2; ++xi) u[static_cast<size_t>(xi) * K * C + kc] = t[xi];
+  }
+}
+
+/*!
+ * \brief v[xi][c][p] = (B^T d B)[xi] for the input tiles d of the nimg images of in,
+ *  the tiles p of which are numbered image by image, then row by row
+ */
+template<int m, typename DType>
+inline void TransformInputs(const DType* in, int nimg, int C, int H, int W, int pad_h,
+                            int pad_w, int tiles_h, int tiles_w, DType* v) {
+  const int alpha = Transform<m>::kAlpha, a2 = alpha * alpha;
+  const int ntile = tiles_h * tiles_w, P = nimg * ntile;
+  const int nthread = NumThreads(static_cast<size_t>(nimg) * C * ntile * a2 * alpha);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int ic = 0; ic < nimg * C; ++ic) {
+    const int img = ic / C, c = ic % C;
+    const DType* plane = in + static_cast<size_t>(ic) * H * W;
+    DType d[a2], t[a2];
+    for (int tile = 0; tile < ntile; ++tile) {
+      const int ih0 = tile / tiles_w * m - pad_h, iw0 = tile % tiles_w * m - pad_w;
+      for (int i = 0; i < alpha; ++i) {
+        const int ih = ih0 + i;
+        for (int j = 0; j < alpha; ++j) {
+          const int iw = iw0 + j;
+          d[i * alpha + j] = (ih >= 0 && ih < H && iw >= 0 && iw < W) ?
+                             plane[ih * W + iw] : DType(0);
+        }
+      }
+      Sandwich<alpha, alpha>(Transform<m>::template BT<DType>(), d, t);
+      const size_t p = static_cast<size_t>(img) * ntile + tile;
+      for (int xi = 0; xi < a2; ++xi) v[(static_cast<size_t>(xi) * C + c) * P + p] = t[xi];
+    }
+  }
+}
+
+/*! \brief out[k] = bias[k] + (A^T mt[.][k][p] A) for the tiles p of the nimg images */
+template<int m, typename DType>
+inline void TransformOutputs(const DType* mt, int nimg, int K, int OH, int OW, int tiles_h,
+                             int tiles_w, const DType* bias, DType* out) {
+  const int alpha = Transform<m>::kAlpha, a2 = alpha * alpha;
+  const int ntile = tiles_h * tiles_w, P = nimg * ntile;
+  const int nthread = NumThreads(static_cast<size_t>(nimg) * K * ntile * a2 * alpha);
+  #pragma omp parallel for num_threads(nthread) if (nthread > 1)
+  for (int ik = 0; ik < nimg * K; ++ik) {
+    const int img = ik / K, k = ik % K;
+    DType* plane = out + static_cast<size_t>(ik) * OH * OW;
+    const DType b = bias != nullptr ? bias[k] : DType(0);
+    DType x[a2], y[m * m];
+    for (int tile = 0; tile < ntile; ++tile) {
+      const size_t p = static_cast<size_t>(img) * ntile + tile;
+      for (int xi = 0; xi < a2; ++xi) x[xi] = mt[(static_cast<size_t>(xi) * K + k) * P + p];
+      Sandwich<m, alpha>(Transform<m>::template AT<DType>(), x, y);
+      const int oh0 = tile / tiles_w * m, ow0 = tile % tiles_w * m;
+      for (int i = 0; i < m && oh0 + i < OH; ++i) {
+        for (int j = 0; j < m && ow0 + j < OW; ++j) {
+          plane[(oh0 + i) * OW + ow0 + j] = y[i * m + j] + b;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace winograd
+
+/*!
+ * \brief the 3x3 stride-1 NCHW convolutions of one group, whose forward pass
+ *  runs by Winograd's minimal filtering and backward pass by im2col
+ */
+template<typename DType>
+class WinogradConvolutionOp : public ConvolutionOp<cpu, DType> {
+ public:
+  WinogradConvolutionOp(ConvolutionParam p, int tile)
+    : ConvolutionOp<cpu, DType>(p), param_(p), tile_(tile) {}
+
+  /*!
+   * \brief the output tile m of F(m x m, 3 x 3) for the convolution of data of dshape and
+   *  type dtype, 0 if it is left to im2col. MXNET_CPU_WINOGRAD_CONV = 0 turns the Winograd
+   *  convolutions off, 2 or 4 forces the tile, 1 picks it by the output size
+   */
+  static int Tile(const ConvolutionParam& param, const TShape& dshape, int dtype) {
+    static const int mode = dmlc::GetEnv("MXNET_CPU_WINOGRAD_CONV", 1);
+    if (mode == 0 || param.kernel.ndim() != 2 || dshape.ndim() != 4 ||
+        param.layout.value() != mshadow::kNCHW || param.num_group != 1 ||
+        (dtype != mshadow::kFloat32 && dtype != mshadow::kFloat64)) {
+      return 0;
+    }
+    for (int i = 0; i < 2; ++i) {
+      if (param.kernel[i] != 3 || param.stride[i] != 1 || param.dilate[i] != 1) return 0;
+    }
+    if (mode == 2 || mode == 4) return mode;
+    const int oh = dshape[2] + 2 * param.pad[0] - 2, ow = dshape[3] + 2 * param.pad[1] - 2;
+    // the transforms only pay off when the gemms between them are large enough
+    if (dshape[1] < 16 || param.num_filter < 16 || oh < 4 || ow < 4) return 0;
+    // F(4x4, 3x3) needs 4 multiplications per output against 9 for F(2x2, 3x3), but
+    // wastes more of its tiles on the small images
+    return oh >= 8 && ow >= 8 ? 4 : 2;
+  }
+
+  virtual void Forward(const OpContext &ctx,
+                       const std::vector<TBlob> &in_data,
+                       const std::vector<OpReqType> &req,
+                       const std::vector<TBlob> &out_data,
+                       const std::vector<TBlob> &aux_args) {
+    CHECK_EQ(req[conv::kOut], kWriteTo);
+    CHECK_EQ(in_data.size(), param_.no_bias ? 2U : 3U);
+    CHECK_EQ(out_data.size(), 1U);
+    if (tile_ == 4) {
+      Run<4>(ctx, in_data, out_data);
+    } else {
+      Run<2>(ctx, in_data, out_data);
+    }
+  }
+
+ private:
+  template<int m>
+  void Run(const OpContext &ctx, const std::vector<TBlob> &in_data,
+           const std::vector<TBlob> &out_data) {
+    using namespace mshadow;
+    using namespace mshadow::expr;
+    Stream<cpu> *s = ctx.get_stream<cpu>();
+    const TShape& ishape = in_data[conv::kData].shape_;
+    const TShape& oshape = out_data[conv::kOut].shape_;
+    const int N = ishape[0], C = ishape[1], H = ishape[2], W = ishape[3];
+    const int K = oshape[1], OH = oshape[2], OW = oshape[3];
+    const int a2 = winograd::Transform<m>::kAlpha * winograd::Transform<m>::kAlpha;
+    const int tiles_h = (OH + m - 1) / m, tiles_w = (OW + m - 1) / m;
+    const int ntile = tiles_h * tiles_w;
+    // the images are transformed by batches of at least 512 tiles, so that the gemms are
+    // not too thin
+    const int nimg = std::min(N, std::max(1, (512 + ntile - 1) / ntile));
+    const int P = nimg * ntile;
+    Tensor<cpu, 1, DType> workspace = ctx.requested[conv::kTempSpace]
+      .get_space_typed<cpu, 1, DType>(
+        Shape1(static_cast<index_t>(a2) * (K * C + C * P + K * P)), s);
+    Tensor<cpu, 3, DType> u(workspace.dptr_, Shape3(a2, K, C), s);
+    Tensor<cpu, 3, DType> v(u.dptr_ + u.shape_.Size(), Shape3(a2, C, P), s);
+    Tensor<cpu, 3, DType> mt(v.dptr_ + v.shape_.Size(), Shape3(a2, K, P), s);
+    winograd::TransformFilters<m>(in_data[conv::kWeight].dptr<DType>(), K, C, u.dptr_);
+    const DType* bias = param_.no_bias ? nullptr : in_data[conv::kBias].dptr<DType>();
+    for (int n = 0; n < N; n += nimg) {
+      const int nb = std::min(nimg, N - n);
+      // the last batch may be smaller, its tiles are the first ones of each row of v and mt
+      Tensor<cpu, 3, DType> vb = v, mb = mt;
+      if (nb != nimg) {
+        vb = Tensor<cpu, 3, DType>(v.dptr_, Shape3(a2, C, nb * ntile), s);
+        mb = Tensor<cpu, 3, DType>(mt.dptr_, Shape3(a2, K, nb * ntile), s);
+      }
+      winograd::TransformInputs<m>(in_data[conv::kData].dptr<DType>() +
+                                   static_cast<size_t>(n) * C * H * W, nb, C, H, W,
+                                   param_.pad[0], param_.pad[1], tiles_h, tiles_w, vb.dptr_);
+      for (int xi = 0; xi < a2; ++xi) {
+        mb[xi] = dot(u[xi], vb[xi]);
+      }
+      winograd::TransformOutputs<m>(mb.dptr_, nb, K, OH, OW, tiles_h, tiles_w, bias,
+                                    out_data[conv::kOut].dptr<DType>() +
+                                    static_cast<size_t>(n) * K * OH * OW);
+    }
+  }
+
+  ConvolutionParam param_;
+  /*! \brief m of F(m x m, 3 x 3) */
+  int tile_;
+};  // class WinogradConvolutionOp
+
+}  // namespace op
+}  // namespace mxnet
+#endif  // MXNET_OPERATOR_WINOGRAD_CONVOLUTION_INL_H_
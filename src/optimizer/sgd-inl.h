@@ -137,6 +137,7 @@ class SGDOpt : public Optimizer {
     switch (w.ctx().dev_type) {
      case Context::kCPU:
      case Context::kCPUPinned:
+     case Context::kCPUShared:
       if (param_.momentum > 0.0f) {
         Engine::Get()->PushSync([this, index, w, g, lr, wd](RunContext ctx) {
           call_sgd_mom_update_cpu(ctx, w.data(), g.data(), mom[index].data(), lr, wd, param_);
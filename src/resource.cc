@@ -30,7 +30,10 @@
 #include <mxnet/storage.h>
 #include <limits>
 #include <atomic>
+#include <memory>
+#include <vector>
 #include "./common/lazy_alloc_array.h"
+#include "./engine/profiler.h"
 
 namespace mxnet {
 namespace resource {
@@ -43,8 +46,13 @@ struct SpaceAllocator {
   Storage::Handle handle;
   // internal CPU handle
   Storage::Handle host_handle;
+  // whether the space goes back to the pool when an operation needs much less of it
+  bool elastic;
+  // the MemoryScope of the last request of the space and of the host space
+  uint64_t scope;
+  uint64_t host_scope;
 
-  SpaceAllocator() {
+  SpaceAllocator() : elastic(false), scope(0), host_scope(0) {
     handle.dptr = nullptr;
     handle.size = 0;
     host_handle.dptr = nullptr;
@@ -61,21 +69,47 @@ struct SpaceAllocator {
     }
   }
   inline void* GetSpace(size_t size) {
-    if (handle.size >= size) return handle.dptr;
-    if (handle.size != 0) {
-      Storage::Get()->DirectFree(handle);
-    }
-    handle = Storage::Get()->Alloc(size, ctx);
-    return handle.dptr;
+    return Get(&handle, &scope, size, ctx);
   }
 
   inline void* GetHostSpace(size_t size) {
-    if (host_handle.size >= size) return host_handle.dptr;
-    if (host_handle.size != 0) {
-      Storage::Get()->DirectFree(host_handle);
+    return Get(&host_handle, &host_scope, size, Context());
+  }
+
+ private:
+  inline void Release(Storage::Handle* h) {
+    // the elastic space is kept by the pool, for the other arrays to reuse
+    if (elastic) {
+      Storage::Get()->Free(*h);
+    } else {
+      Storage::Get()->DirectFree(*h);
+    }
+    h->dptr = nullptr;
+    h->size = 0;
+  }
+  inline void* Get(Storage::Handle* h, uint64_t* last_scope, size_t size, Context hctx) {
+    if (elastic) {
+      // the operations that requested the space before the current one have
+      // completed, as they wrote the var of the resource; the calls of one
+      // operation keep sharing the space
+      const uint64_t serial = engine::MemoryScope::Serial();
+      if (h->size != 0 && serial != 0 && serial != *last_scope && size <= h->size / 2) {
+        Release(h);
+      }
+      *last_scope = serial;
+    }
+    const bool alloc = h->size < size;
+    if (alloc) {
+      if (h->size != 0) Release(h);
+      *h = Storage::Get()->Alloc(size, hctx);
     }
-    host_handle = Storage::Get()->Alloc(size, Context());
-    return host_handle.dptr;
+#if MXNET_USE_PROFILER
+    engine::Profiler* profiler = engine::Profiler::Get();
+    if (profiler->GetState() == engine::Profiler::kRunning) {
+      profiler->AddTempSpace(hctx, size, alloc);
+    }
+#endif
+    return h->dptr;
   }
 };
 
@@ -87,20 +121,27 @@ class ResourceManagerImpl : public ResourceManager {
       : global_seed_(0) {
     cpu_temp_space_copy_ = dmlc::GetEnv("MXNET_CPU_TEMP_COPY", 4);
     gpu_temp_space_copy_ = dmlc::GetEnv("MXNET_GPU_TEMP_COPY", 1);
+    cpu_rand_copy_ = dmlc::GetEnv("MXNET_CPU_RAND_COPY", 4);
+    cpu_parallel_rand_copy_ = dmlc::GetEnv("MXNET_CPU_PARALLEL_RAND_COPY", 4);
+    temp_space_elastic_ = dmlc::GetEnv("MXNET_TEMP_SPACE_ELASTIC", false);
     engine_ref_ = Engine::_GetSharedRef();
     storage_ref_ = Storage::_GetSharedRef();
-    cpu_rand_.reset(new ResourceRandom<cpu>(
-        Context::CPU(), global_seed_));
+    cpu_rand_.reset(new ResourceCopies<ResourceRandom<cpu> >(
+        Context::CPU(), cpu_rand_copy_, global_seed_));
     cpu_space_.reset(new ResourceTempSpace(
-        Context::CPU(), cpu_temp_space_copy_));
+        Context::CPU(), cpu_temp_space_copy_, temp_space_elastic_));
+    cpu_parallel_rand_.reset(new ResourceCopies<ResourceParallelRandom>(
+        Context::CPU(), cpu_parallel_rand_copy_, global_seed_));
   }
   ~ResourceManagerImpl() {
     // need explicit delete, before engine get killed
     cpu_rand_.reset(nullptr);
     cpu_space_.reset(nullptr);
+    cpu_parallel_rand_.reset(nullptr);
 #if MXNET_USE_CUDA
     gpu_rand_.Clear();
     gpu_space_.Clear();
+    gpu_parallel_rand_.Clear();
 #endif
     if (engine_ref_ != nullptr) {
       engine_ref_ = nullptr;
@@ -114,8 +155,9 @@ class ResourceManagerImpl : public ResourceManager {
   Resource Request(Context ctx, const ResourceRequest &req) override {
     if (ctx.dev_mask() == cpu::kDevMask) {
       switch (req.type) {
-        case ResourceRequest::kRandom: return cpu_rand_->resource;
+        case ResourceRequest::kRandom: return cpu_rand_->GetNext();
         case ResourceRequest::kTempSpace: return cpu_space_->GetNext();
+        case ResourceRequest::kParallelRandom: return cpu_parallel_rand_->GetNext();
         default: LOG(FATAL) << "Unknown supported type " << req.type;
       }
     } else {
@@ -129,9 +171,14 @@ class ResourceManagerImpl : public ResourceManager {
         }
         case ResourceRequest::kTempSpace: {
           return gpu_space_.Get(ctx.dev_id, [ctx, this]() {
-              return new ResourceTempSpace(ctx, gpu_temp_space_copy_);
+              return new ResourceTempSpace(ctx, gpu_temp_space_copy_, temp_space_elastic_);
             })->GetNext();
         }
+        case ResourceRequest::kParallelRandom: {
+          return gpu_parallel_rand_.Get(ctx.dev_id, [ctx, this]() {
+              return new ResourceParallelRandom(ctx, global_seed_);
+            })->resource;
+        }
         default: LOG(FATAL) << "Unknown supported type " << req.type;
       }
 #else
@@ -145,10 +192,14 @@ class ResourceManagerImpl : public ResourceManager {
   void SeedRandom(uint32_t seed) override {
     global_seed_ = seed;
     cpu_rand_->Seed(global_seed_);
+    cpu_parallel_rand_->Seed(global_seed_);
 #if MXNET_USE_CUDA
     gpu_rand_.ForEach([seed](size_t i, ResourceRandom<gpu> *p) {
         p->Seed(seed);
       });
+    gpu_parallel_rand_.ForEach([seed](size_t i, ResourceParallelRandom *p) {
+        p->Seed(seed);
+      });
 #endif
   }
 
@@ -166,12 +217,15 @@ class ResourceManagerImpl : public ResourceManager {
     mshadow::Random<xpu> *prnd;
     /*! \brief resource representation */
     Resource resource;
+    /*! \brief the number of the copy of the device, which offsets its seed */
+    uint32_t copy;
     /*! \brief constructor */
-    explicit ResourceRandom(Context ctx, uint32_t global_seed)
-        : ctx(ctx) {
+    explicit ResourceRandom(Context ctx, uint32_t global_seed, uint32_t copy = 0)
+        : ctx(ctx), copy(copy) {
       mshadow::SetDevice<xpu>(ctx.dev_id);
       resource.var = Engine::Get()->NewVariable();
-      prnd = new mshadow::Random<xpu>(ctx.dev_id + global_seed * kRandMagic);
+      resource.id = static_cast<int32_t>(copy);
+      prnd = new mshadow::Random<xpu>(CopySeed(ctx, global_seed, copy));
       resource.ptr_ = prnd;
       resource.req = ResourceRequest(ResourceRequest::kRandom);
     }
@@ -184,7 +238,7 @@ class ResourceManagerImpl : public ResourceManager {
     }
     // set seed to a PRNG
     inline void Seed(uint32_t global_seed) {
-      uint32_t seed = ctx.dev_id + global_seed * kRandMagic;
+      uint32_t seed = CopySeed(ctx, global_seed, copy);
       mshadow::Random<xpu> *r = prnd;
       Engine::Get()->PushSync([r, seed](RunContext rctx) {
           r->set_stream(rctx.get_stream<xpu>());
@@ -194,6 +248,83 @@ class ResourceManagerImpl : public ResourceManager {
     }
   };
 
+  // the counter-based random number resources, whose state is on the host for every device
+  struct ResourceParallelRandom {
+    /*! \brief the context of the generator */
+    Context ctx;
+    /*! \brief the generator */
+    common::random::ParallelRandom *prnd;
+    /*! \brief resource representation */
+    Resource resource;
+    /*! \brief the number of the copy of the device, which offsets its seed */
+    uint32_t copy;
+    /*! \brief constructor */
+    explicit ResourceParallelRandom(Context ctx, uint32_t global_seed, uint32_t copy = 0)
+        : ctx(ctx), copy(copy) {
+      resource.var = Engine::Get()->NewVariable();
+      resource.id = static_cast<int32_t>(copy);
+      prnd = new common::random::ParallelRandom(CopySeed(ctx, global_seed, copy));
+      resource.ptr_ = prnd;
+      resource.req = ResourceRequest(ResourceRequest::kParallelRandom);
+    }
+    ~ResourceParallelRandom() {
+      common::random::ParallelRandom *r = prnd;
+      Engine::Get()->DeleteVariable(
+          [r](RunContext rctx) {
+            delete r;
+          }, ctx, resource.var);
+    }
+    // set seed to the generator, after the launches that use the old one
+    inline void Seed(uint32_t global_seed) {
+      uint32_t seed = CopySeed(ctx, global_seed, copy);
+      common::random::ParallelRandom *r = prnd;
+      Engine::Get()->PushSync([r, seed](RunContext rctx) {
+          r->Seed(seed);
+        }, ctx, {}, {resource.var},
+        FnProperty::kNormal, 0, PROFILER_MESSAGE("ResourceParallelRandomSetSeed"));
+    }
+  };
+
+  /*!
+   * \brief the seed of a copy of the random number resources of a device,
+   *  the one of the single copy for the first
+   */
+  static uint32_t CopySeed(Context ctx, uint32_t global_seed, uint32_t copy) {
+    return ctx.dev_id + copy * kMaxNumGPUs + global_seed * kRandMagic;
+  }
+  // independently seeded copies of a random number resource, handed out round robin,
+  // so that the operations which draw from different copies can run in parallel
+  template<typename R>
+  struct ResourceCopies {
+    /*! \brief the copies */
+    std::vector<std::unique_ptr<R> > copies;
+    /*! \brief current pointer to the round robin allocator */
+    std::atomic<size_t> curr_ptr;
+    /*! \brief constructor */
+    ResourceCopies(Context ctx, size_t ncopy, uint32_t global_seed)
+        : curr_ptr(0) {
+      CHECK_GT(ncopy, 0U) << "At least one copy of the random number resources is needed";
+      for (size_t i = 0; i < ncopy; ++i) {
+        copies.emplace_back(new R(ctx, global_seed, static_cast<uint32_t>(i)));
+      }
+    }
+    // get next resource in round robin manner
+    inline Resource GetNext() {
+      const size_t kMaxDigit = std::numeric_limits<size_t>::max() / 2;
+      size_t ptr = ++curr_ptr;
+      if (ptr > kMaxDigit) {
+        curr_ptr.store((ptr + 1) % copies.size());
+      }
+      return copies[ptr % copies.size()]->resource;
+    }
+    // seed every copy, and restart the round robin, so that the operations
+    // pushed after the seed draw the same numbers for the same seed
+    inline void Seed(uint32_t global_seed) {
+      for (auto& c : copies) c->Seed(global_seed);
+      curr_ptr.store(0);
+    }
+  };
+
   // temporal space resource.
   struct ResourceTempSpace {
     /*! \brief the context of the device */
@@ -205,7 +336,7 @@ class ResourceManagerImpl : public ResourceManager {
     /*! \brief current pointer to the round roubin alloator */
     std::atomic<size_t> curr_ptr;
     /*! \brief constructor */
-    explicit ResourceTempSpace(Context ctx, size_t ncopy)
+    ResourceTempSpace(Context ctx, size_t ncopy, bool elastic)
         : ctx(ctx), space(ncopy), resource(ncopy), curr_ptr(0) {
       for (size_t i = 0; i < space.size(); ++i) {
         resource[i].var = Engine::Get()->NewVariable();
@@ -213,6 +344,7 @@ class ResourceManagerImpl : public ResourceManager {
         resource[i].ptr_ = &space[i];
         resource[i].req = ResourceRequest(ResourceRequest::kTempSpace);
         space[i].ctx = ctx;
+        space[i].elastic = elastic;
         CHECK_EQ(space[i].handle.size, 0U);
       }
     }
@@ -242,6 +374,12 @@ class ResourceManagerImpl : public ResourceManager {
   int cpu_temp_space_copy_;
   /*! \brief number of copies in GPU temp space */
   int gpu_temp_space_copy_;
+  /*! \brief whether the temp space is sized by each operation */
+  bool temp_space_elastic_;
+  /*! \brief number of copies of the CPU random number resources */
+  int cpu_rand_copy_;
+  /*! \brief number of copies of the CPU counter-based random number resources */
+  int cpu_parallel_rand_copy_;
   /*! \brief Reference to the engine */
   std::shared_ptr<Engine> engine_ref_;
   /*! \brief Reference to the storage */
@@ -249,14 +387,18 @@ class ResourceManagerImpl : public ResourceManager {
   /*! \brief internal seed to the random number generator */
   uint32_t global_seed_;
   /*! \brief CPU random number resources */
-  std::unique_ptr<ResourceRandom<cpu> > cpu_rand_;
+  std::unique_ptr<ResourceCopies<ResourceRandom<cpu> > > cpu_rand_;
   /*! \brief CPU temp space resources */
   std::unique_ptr<ResourceTempSpace> cpu_space_;
+  /*! \brief CPU counter-based random number resources */
+  std::unique_ptr<ResourceCopies<ResourceParallelRandom> > cpu_parallel_rand_;
 #if MXNET_USE_CUDA
   /*! \brief random number generator for GPU */
   common::LazyAllocArray<ResourceRandom<gpu> > gpu_rand_;
   /*! \brief temp space for GPU */
   common::LazyAllocArray<ResourceTempSpace> gpu_space_;
+  /*! \brief counter-based random number generator for GPU */
+  common::LazyAllocArray<ResourceParallelRandom> gpu_parallel_rand_;
 #endif
 };
 }  // namespace resource
@@ -0,0 +1,297 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file predict_batcher.h
+ * \brief batches the single requests of many threads into the forward passes
+ *  of a pool of predictors that share the weights of one model
+ */
+#ifndef MXNET_SERVING_PREDICT_BATCHER_H_
+#define MXNET_SERVING_PREDICT_BATCHER_H_
+
+#include <dmlc/logging.h>
+#include <mxnet/c_predict_api.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mxnet {
+namespace serving {
+
+/*!
+ * \brief runs the requests of one sample each, which threads submit with Run,
+ *  in batches. A worker takes the queued requests once there are enough for
+ *  the largest batch size, or once the oldest one has waited max_delay, runs
+ *  them with the predictor of the smallest batch size that holds them, the
+ *  rows after the requests left over from earlier batches, and copies the
+ *  rows of the outputs back to the requests.
+ *
+ *  Each worker has a predictor for each batch size, made with
+ *  MXPredCreateShared and MXPredReshape, so that the workers share the
+ *  weights and the batch sizes of a worker share its memory. The inputs of
+ *  cpu predictors are bound to the buffer the requests are gathered into.
+ */
+class PredictBatcher {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  /*!
+   * \param src the predictor whose weights are shared
+   * \param key the input the requests set, whose first axis is the batch
+   * \param sample_shape the shape of the input of one request
+   * \param num_outputs the number of outputs of src
+   * \param batch_sizes the batch sizes of the predictors
+   * \param num_workers the number of batches that run at the same time
+   * \param max_delay_us the longest a request waits for a fuller batch
+   */
+  PredictBatcher(PredictorHandle src, const std::string& key,
+                 const std::vector<mx_uint>& sample_shape, size_t num_outputs,
+                 std::vector<mx_uint> batch_sizes, size_t num_workers, size_t max_delay_us)
+      : key_(key), sample_shape_(sample_shape), batch_sizes_(batch_sizes),
+        max_delay_(max_delay_us) {
+    std::sort(batch_sizes_.begin(), batch_sizes_.end());
+    batch_sizes_.erase(std::unique(batch_sizes_.begin(), batch_sizes_.end()),
+                       batch_sizes_.end());
+    CHECK(!batch_sizes_.empty() && batch_sizes_[0] > 0) << "Invalid batch sizes";
+    CHECK_GT(num_workers, 0U) << "A batcher needs a worker";
+    input_size_ = 1;
+    for (mx_uint s : sample_shape) input_size_ *= s;
+    try {
+      for (size_t i = 0; i < num_workers; ++i) {
+        workers_.emplace_back(new Worker());
+        InitWorker(src, workers_.back().get());
+      }
+      InitOutputs(num_outputs);
+    } catch (const dmlc::Error&) {
+      Free();
+      throw;
+    }
+    for (auto& w : workers_) {
+      Worker* pw = w.get();
+      w->thread = std::thread([this, pw]() { WorkerLoop(pw); });
+    }
+  }
+
+  /*! \brief runs the queued requests, then stops the workers */
+  ~PredictBatcher() {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& w : workers_) w->thread.join();
+    Free();
+  }
+
+  /*! \brief the shape of output index of one request */
+  const std::vector<mx_uint>& OutputShape(size_t index) const {
+    CHECK_LT(index, out_shapes_.size()) << "Output index out of range";
+    return out_shapes_[index];
+  }
+
+  /*!
+   * \brief runs one sample, blocking until its outputs are written
+   * \param input the input of the sample
+   * \param outputs the memory of each output of the sample
+   */
+  void Run(const mx_float* input, mx_float* const* outputs) {
+    Request req;
+    req.input = input;
+    req.outputs = outputs;
+    req.arrival = Clock::now();
+    std::unique_lock<std::mutex> lk(mu_);
+    queue_.push_back(&req);
+    // the worker waiting for a fuller batch may be any of them
+    cv_.notify_all();
+    done_cv_.wait(lk, [&req]() { return req.done; });
+    if (!req.error.empty()) LOG(FATAL) << req.error;
+  }
+
+  size_t input_size() const { return input_size_; }
+  size_t num_outputs() const { return out_sizes_.size(); }
+  size_t output_size(size_t index) const { return out_sizes_[index]; }
+
+ private:
+  struct Request {
+    const mx_float* input;
+    mx_float* const* outputs;
+    Clock::time_point arrival;
+    bool done = false;
+    std::string error;
+  };
+
+  struct Worker {
+    /*! \brief the predictor of each batch size */
+    std::vector<PredictorHandle> preds;
+    /*! \brief the inputs of a batch, which cpu predictors read in place */
+    std::vector<mx_float> input;
+    bool bound = false;
+    /*! \brief a copy of an output of a gpu predictor */
+    std::vector<mx_float> output;
+    std::thread thread;
+  };
+
+  static void Check(int ret) {
+    if (ret != 0) throw dmlc::Error(MXGetLastError());
+  }
+
+  void InitWorker(PredictorHandle src, Worker* w) {
+    const char* key = key_.c_str();
+    const size_t nbucket = batch_sizes_.size();
+    std::vector<mx_uint> shape_data(1, batch_sizes_.back());
+    shape_data.insert(shape_data.end(), sample_shape_.begin(), sample_shape_.end());
+    std::vector<mx_uint> indptr = {0, static_cast<mx_uint>(shape_data.size())};
+    w->preds.assign(nbucket, nullptr);
+    Check(MXPredCreateShared(src, 1, &key, indptr.data(), shape_data.data(),
+                             &w->preds[nbucket - 1]));
+    for (size_t b = 0; b + 1 < nbucket; ++b) {
+      shape_data[0] = batch_sizes_[b];
+      Check(MXPredReshape(1, &key, indptr.data(), shape_data.data(), w->preds[nbucket - 1],
+                          &w->preds[b]));
+    }
+    w->input.assign(batch_sizes_.back() * input_size_, 0.0f);
+    // gpu predictors cannot read the buffer, their inputs are copied
+    w->bound = MXPredBindInput(w->preds[0], key, w->input.data(),
+                               batch_sizes_[0] * input_size_) == 0;
+    for (size_t b = 1; w->bound && b < nbucket; ++b) {
+      Check(MXPredBindInput(w->preds[b], key, w->input.data(), batch_sizes_[b] * input_size_));
+    }
+  }
+
+  /*! \brief the shapes of the outputs of one request, the first axis of each is the batch */
+  void InitOutputs(size_t num_outputs) {
+    const Worker& w = *workers_[0];
+    for (size_t i = 0; i < num_outputs; ++i) {
+      std::vector<mx_uint> sample;
+      for (size_t b = 0; b < batch_sizes_.size(); ++b) {
+        mx_uint* shape_data;
+        mx_uint ndim;
+        Check(MXPredGetOutputShape(w.preds[b], static_cast<mx_uint>(i), &shape_data, &ndim));
+        CHECK(ndim > 0 && shape_data[0] == batch_sizes_[b])
+            << "The first axis of output " << i << " is not the batch";
+        std::vector<mx_uint> s(shape_data + 1, shape_data + ndim);
+        CHECK(b == 0 || s == sample)
+            << "The batch size changes the shape of a sample of output " << i;
+        sample = s;
+      }
+      size_t size = 1;
+      for (mx_uint s : sample) size *= s;
+      out_shapes_.push_back(sample);
+      out_sizes_.push_back(size);
+    }
+  }
+
+  void Free() {
+    for (auto& w : workers_) {
+      for (PredictorHandle p : w->preds) {
+        if (p != nullptr) MXPredFree(p);
+      }
+    }
+  }
+
+  void WorkerLoop(Worker* w) {
+    const size_t max_batch = batch_sizes_.back();
+    std::vector<Request*> batch;
+    std::unique_lock<std::mutex> lk(mu_);
+    while (true) {
+      cv_.wait(lk, [this]() { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) break;
+      // another worker may take the requests while this one waits
+      while (!stop_ && !queue_.empty() && queue_.size() < max_batch) {
+        const Clock::time_point deadline = queue_.front()->arrival + max_delay_;
+        if (Clock::now() >= deadline) break;
+        cv_.wait_until(lk, deadline);
+      }
+      if (queue_.empty()) continue;
+      const size_t n = std::min(queue_.size(), max_batch);
+      batch.assign(queue_.begin(), queue_.begin() + n);
+      queue_.erase(queue_.begin(), queue_.begin() + n);
+      lk.unlock();
+      std::string error;
+      try {
+        RunBatch(w, batch);
+      } catch (const dmlc::Error& e) {
+        error = e.what();
+      }
+      lk.lock();
+      for (Request* req : batch) {
+        req->error = error;
+        req->done = true;
+      }
+      done_cv_.notify_all();
+    }
+  }
+
+  void RunBatch(Worker* w, const std::vector<Request*>& batch) {
+    const size_t n = batch.size();
+    const size_t b = std::lower_bound(batch_sizes_.begin(), batch_sizes_.end(), n) -
+                     batch_sizes_.begin();
+    const size_t batch_size = batch_sizes_[b];
+    PredictorHandle pred = w->preds[b];
+    for (size_t i = 0; i < n; ++i) {
+      std::memcpy(w->input.data() + i * input_size_, batch[i]->input,
+                  input_size_ * sizeof(mx_float));
+    }
+    if (!w->bound) {
+      Check(MXPredSetInput(pred, key_.c_str(), w->input.data(), batch_size * input_size_));
+    }
+    Check(MXPredForward(pred));
+    for (size_t k = 0; k < out_sizes_.size(); ++k) {
+      const size_t size = out_sizes_[k];
+      const mx_float* out;
+      if (w->bound) {
+        mx_uint out_size;
+        Check(MXPredGetOutputPtr(pred, static_cast<mx_uint>(k), &out, &out_size));
+      } else {
+        w->output.resize(batch_size * size);
+        Check(MXPredGetOutput(pred, static_cast<mx_uint>(k), w->output.data(), batch_size * size));
+        out = w->output.data();
+      }
+      for (size_t i = 0; i < n; ++i) {
+        std::memcpy(batch[i]->outputs[k], out + i * size, size * sizeof(mx_float));
+      }
+    }
+  }
+
+  std::string key_;
+  std::vector<mx_uint> sample_shape_;
+  std::vector<mx_uint> batch_sizes_;
+  std::chrono::microseconds max_delay_;
+  size_t input_size_;
+  std::vector<std::vector<mx_uint> > out_shapes_;
+  std::vector<size_t> out_sizes_;
+  std::vector<std::unique_ptr<Worker> > workers_;
+  /*! \brief protects the queue, stop_ and the done flags of the requests */
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::condition_variable done_cv_;
+  std::deque<Request*> queue_;
+  bool stop_ = false;
+};
+
+}  // namespace serving
+}  // namespace mxnet
+#endif  // MXNET_SERVING_PREDICT_BATCHER_H_
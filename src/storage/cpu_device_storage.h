@@ -51,9 +51,9 @@ class CPUDeviceStorage {
 
  private:
   /*!
-   * \brief Alignment of allocation.
+   * \brief Alignment of allocation, a full cache line for AVX-512 loads.
    */
-  static constexpr size_t alignment_ = 16;
+  static constexpr size_t alignment_ = 64;
 };  // class CPUDeviceStorage
 
 inline void* CPUDeviceStorage::Alloc(size_t size) {
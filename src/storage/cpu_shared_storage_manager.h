@@ -0,0 +1,217 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file cpu_shared_storage_manager.h
+ * \brief Storage manager of the CPU memory shared across the processes.
+ */
+#ifndef MXNET_STORAGE_CPU_SHARED_STORAGE_MANAGER_H_
+#define MXNET_STORAGE_CPU_SHARED_STORAGE_MANAGER_H_
+
+#include <dmlc/logging.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include "./storage_manager.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+namespace mxnet {
+namespace storage {
+
+/*!
+ * \brief Storage manager of POSIX shared memory objects, one per
+ *  allocation, named after the process and an id so that another process
+ *  maps an allocation from the two ids. The objects count their references
+ *  in a head before the data, as the processes map them at different
+ *  addresses, and the last release removes the object.
+ */
+class CPUSharedStorageManager final : public StorageManager {
+ public:
+  CPUSharedStorageManager() {
+#ifndef _WIN32
+    pid_ = getpid();
+#else
+    LOG(FATAL) << "shared memory is not supported on windows";
+#endif  // _WIN32
+  }
+  /*!
+   * \brief Release the references of the live mappings, so that the objects
+   *  of a process which exits are not left behind.
+   */
+  ~CPUSharedStorageManager() {
+    for (const auto& m : mappings_) Release(m.first, m.second);
+  }
+
+  void* Alloc(size_t size) override;
+  void Free(void* ptr, size_t size) override { Release(ptr); }
+  void DirectFree(void* ptr, size_t size) override { Release(ptr); }
+  /*!
+   * \brief Map the memory of the id of a process, taking over a reference
+   *  added by IncrementRefCount.
+   * \param size Set to the size of the allocation.
+   */
+  void* Attach(int shared_pid, int shared_id, size_t* size);
+  /*! \brief Add a reference to the memory at ptr, a handle for another process. */
+  void IncrementRefCount(void* ptr) {
+    Head(Find(ptr).base)->ref_count.fetch_add(1);
+  }
+  /*! \brief The ids of the memory at ptr. */
+  void GetIds(void* ptr, int* shared_pid, int* shared_id) {
+    const Mapping m = Find(ptr);
+    *shared_pid = m.shared_pid;
+    *shared_id = m.shared_id;
+  }
+
+ private:
+  /*! \brief a mapping of a shared memory object */
+  struct Mapping {
+    void* base;
+    size_t mapped_size;
+    int shared_pid;
+    int shared_id;
+  };
+  /*! \brief the head of a shared memory object, before its data */
+  struct SharedHead {
+    std::atomic<int> ref_count;
+    size_t size;
+  };
+  static_assert(ATOMIC_INT_LOCK_FREE == 2, "the references are counted across processes");
+  /*! \brief the bytes of the head, which keep the data aligned to a cache line */
+  static constexpr size_t kHeadSize = 64;
+
+  static SharedHead* Head(void* base) { return static_cast<SharedHead*>(base); }
+  static std::string Name(int shared_pid, int shared_id) {
+    return "/mx_" + std::to_string(shared_pid) + "_" + std::to_string(shared_id);
+  }
+
+  Mapping Find(void* ptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = mappings_.find(ptr);
+    CHECK(it != mappings_.end()) << "the memory was not allocated on cpu_shared";
+    return it->second;
+  }
+  /*! \brief map the object of fd and close fd, nullptr on failure */
+  void* Map(int fd, size_t mapped_size, const Mapping& m);
+  void Release(void* ptr) {
+    Mapping m;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = mappings_.find(ptr);
+      CHECK(it != mappings_.end()) << "the memory was not allocated on cpu_shared";
+      m = it->second;
+      mappings_.erase(it);
+    }
+    Release(ptr, m);
+  }
+  void Release(void* ptr, const Mapping& m) {
+#ifndef _WIN32
+    const int count = Head(m.base)->ref_count.fetch_sub(1);
+    munmap(m.base, m.mapped_size);
+    if (count == 1) shm_unlink(Name(m.shared_pid, m.shared_id).c_str());
+#endif  // _WIN32
+  }
+
+  int pid_ = -1;
+  std::atomic<int> next_id_{0};
+  std::mutex mutex_;
+  /*! \brief the mappings by the address of their data */
+  std::unordered_map<void*, Mapping> mappings_;
+};  // class CPUSharedStorageManager
+
+inline void* CPUSharedStorageManager::Map(int fd, size_t mapped_size, const Mapping& m) {
+#ifndef _WIN32
+  void* base = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return nullptr;
+  void* ptr = static_cast<char*>(base) + kHeadSize;
+  std::lock_guard<std::mutex> lock(mutex_);
+  mappings_[ptr] = {base, mapped_size, m.shared_pid, m.shared_id};
+  return ptr;
+#else
+  return nullptr;
+#endif  // _WIN32
+}
+
+inline void* CPUSharedStorageManager::Alloc(size_t size) {
+#ifndef _WIN32
+  const size_t mapped_size = kHeadSize + size;
+  Mapping m{nullptr, mapped_size, pid_, -1};
+  int fd = -1;
+  // the ids of the objects a process left behind are skipped
+  while (fd < 0) {
+    m.shared_id = next_id_++;
+    fd = shm_open(Name(pid_, m.shared_id).c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno != EEXIST) {
+      LOG(FATAL) << "Failed to create the shared memory " << Name(pid_, m.shared_id)
+                 << ": " << strerror(errno);
+    }
+  }
+  void* ptr = nullptr;
+  if (ftruncate(fd, mapped_size) == 0) {
+    ptr = Map(fd, mapped_size, m);
+  } else {
+    close(fd);
+  }
+  if (ptr == nullptr) {
+    shm_unlink(Name(pid_, m.shared_id).c_str());
+    throw std::bad_alloc();
+  }
+  SharedHead* head = Head(static_cast<char*>(ptr) - kHeadSize);
+  new (&head->ref_count) std::atomic<int>(1);
+  head->size = size;
+  return ptr;
+#else
+  return nullptr;
+#endif  // _WIN32
+}
+
+inline void* CPUSharedStorageManager::Attach(int shared_pid, int shared_id, size_t* size) {
+#ifndef _WIN32
+  const std::string name = Name(shared_pid, shared_id);
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    LOG(FATAL) << "Failed to open the shared memory " << name << ": " << strerror(errno)
+               << ", was it freed before it was attached?";
+  }
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0);
+  CHECK_GE(static_cast<size_t>(st.st_size), kHeadSize) << name << " is not an array";
+  void* ptr = Map(fd, st.st_size, {nullptr, 0, shared_pid, shared_id});
+  if (ptr == nullptr) LOG(FATAL) << "Failed to map the shared memory " << name;
+  *size = Head(static_cast<char*>(ptr) - kHeadSize)->size;
+  return ptr;
+#else
+  return nullptr;
+#endif  // _WIN32
+}
+
+}  // namespace storage
+}  // namespace mxnet
+
+#endif  // MXNET_STORAGE_CPU_SHARED_STORAGE_MANAGER_H_
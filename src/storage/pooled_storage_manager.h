@@ -27,29 +27,78 @@
 #if MXNET_USE_CUDA
   #include <cuda_runtime.h>
 #endif  // MXNET_USE_CUDA
+#if defined(__linux__)
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif  // defined(__linux__)
 #include <mxnet/base.h>
 #include <unordered_map>
 #include <vector>
+#include <set>
 #include <mutex>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 #include <new>
+#include <cstdint>
 #include "./storage_manager.h"
+#include "./cpu_device_storage.h"
 #include "../common/cuda_utils.h"
 
 
 namespace mxnet {
 namespace storage {
 
+/*!
+ * \brief Round a request up to its size class.  Sizes up to linear_limit are
+ *  rounded to multiples of granularity, larger sizes to one of four steps
+ *  within their power of two, which bounds the waste to 25%.
+ */
+inline size_t RoundToSizeClass(size_t size, size_t granularity, size_t linear_limit) {
+  const size_t kClassesPerOctave = 4;
+  size = (size + granularity - 1) / granularity * granularity;
+  if (size <= linear_limit) return size;
+  size_t octave = linear_limit;
+  while (octave <= size / 2) octave *= 2;
+  size_t step = octave / kClassesPerOctave;
+  return (size + step - 1) / step * step;
+}
+
 #if MXNET_USE_CUDA
 /*!
  * \brief Storage manager with a memory pool on gpu.
+ *
+ *  Requests are rounded up to size classes and served best-fit from the free
+ *  blocks of earlier cudaMalloc segments.  Blocks larger than the request are
+ *  split, and freed blocks are coalesced with their free neighbours in the
+ *  same segment, so memory released at one size can serve a different size.
+ *  Small requests are carved out of shared segments of kSmallSegment bytes and
+ *  are kept in a separate pool, so they do not fragment the large blocks.
+ *  The segments can be managed memory instead, for arrays that outgrow the gpu.
  */
 class GPUPooledStorageManager final : public StorageManager {
  public:
   /*!
-   * \brief Default constructor.
+   * \brief Constructor.
+   * \param dev_id the device index of the gpu.
+   * \param managed whether the segments are CUDA managed memory, which the driver
+   *  pages out to the host when the gpu is full, instead of failing the allocation.
    */
-  GPUPooledStorageManager() {
+  explicit GPUPooledStorageManager(int dev_id = 0, bool managed = false)
+      : dev_id_(dev_id), managed_(managed) {
     reserve_ = dmlc::GetEnv("MXNET_GPU_MEM_POOL_RESERVE", 5);
+#if CUDA_VERSION >= 8000
+    if (managed_) {
+      int concurrent = 0;
+      CUDA_CALL(cudaDeviceGetAttribute(&concurrent, cudaDevAttrConcurrentManagedAccess,
+                                       dev_id_));
+      if (!concurrent) {
+        LOG(WARNING) << "GPU " << dev_id_ << " does not page managed memory on demand, "
+                     << "its arrays cannot oversubscribe its memory";
+      }
+    }
+#endif  // CUDA_VERSION >= 8000
   }
   /*!
    * \brief Default destructor.
@@ -60,74 +109,443 @@ class GPUPooledStorageManager final : public StorageManager {
 
   void* Alloc(size_t raw_size) override;
   void Free(void* ptr, size_t raw_size) override;
+  void DirectFree(void* ptr, size_t raw_size) override;
+  void GetStats(Storage::Stats* stats) override;
 
-  void DirectFree(void* ptr, size_t raw_size) override {
-    cudaError_t err = cudaFree(ptr);
-    size_t size = raw_size + NDEV;
-    // ignore unloading error, as memory has already been recycled
-    if (err != cudaSuccess && err != cudaErrorCudartUnloading) {
-      LOG(FATAL) << "CUDA: " << cudaGetErrorString(err);
+ private:
+  /*! \brief a contiguous piece of a cudaMalloc segment */
+  struct Block {
+    /*! \brief start address of the block */
+    char* ptr;
+    /*! \brief size of the block in bytes */
+    size_t size;
+    /*! \brief whether the block belongs to the small pool */
+    bool small;
+    /*! \brief whether the block is handed out to a user */
+    bool allocated{false};
+    /*! \brief neighbouring blocks within the same segment */
+    Block* prev{nullptr};
+    Block* next{nullptr};
+    Block(char* ptr, size_t size, bool small)
+        : ptr(ptr), size(size), small(small) {}
+  };
+  /*! \brief order free blocks by size first to get best-fit lookup */
+  struct BlockComparator {
+    bool operator()(const Block* a, const Block* b) const {
+      if (a->size != b->size) return a->size < b->size;
+      return reinterpret_cast<uintptr_t>(a->ptr) < reinterpret_cast<uintptr_t>(b->ptr);
     }
-    used_memory_ -= size;
+  };
+  typedef std::set<Block*, BlockComparator> BlockPool;
+  /*! \brief requests up to this size are served from the small pool */
+  static constexpr size_t kSmallSize = 1 << 20;
+  /*! \brief size of the segments the small pool carves its blocks from */
+  static constexpr size_t kSmallSegment = 2 << 20;
+  /*! \brief granularity (and alignment) of all block sizes */
+  static constexpr size_t kMinBlock = 512;
+  BlockPool& PoolOf(const Block* block) {
+    return block->small ? small_blocks_ : large_blocks_;
   }
-
- private:
+  /*! \brief allocate the memory of a segment with cudaMalloc or cudaMallocManaged */
+  cudaError_t DeviceMalloc(void** ptr, size_t size);
+  /*! \brief allocate a new segment from the device, releasing the pool if needed */
+  void* MallocSegment(size_t size);
+  /*! \brief merge free neighbour src into dst, which is not in any pool */
+  void MergeBlocks(Block* dst, Block* src);
+  /*! \brief return a block to its pool, coalescing it with free neighbours */
+  void FreeBlock(Block* block);
+  /*! \brief release all segments that are completely free */
   void ReleaseAll();
   // internal mutex
   std::mutex mutex_;
   // used memory
   size_t used_memory_ = 0;
+  // highest value of used memory
+  size_t peak_memory_ = 0;
+  // number of allocations served from the pool
+  size_t num_pool_hits_ = 0;
   // percentage of reserved memory
   int reserve_;
+  // device index of the gpu
+  int dev_id_;
+  // whether the segments are managed memory
+  bool managed_;
   // number of devices
   const int NDEV = 32;
-  // memory pool
-  std::unordered_map<size_t, std::vector<void*>> memory_pool_;
+  // pools of free blocks
+  BlockPool small_blocks_;
+  BlockPool large_blocks_;
+  // blocks handed out to users, indexed by address
+  std::unordered_map<void*, Block*> allocated_blocks_;
   DISALLOW_COPY_AND_ASSIGN(GPUPooledStorageManager);
 };  // class GPUPooledStorageManager
 
+cudaError_t GPUPooledStorageManager::DeviceMalloc(void** ptr, size_t size) {
+  if (!managed_) return cudaMalloc(ptr, size);
+  cudaError_t e = cudaMallocManaged(ptr, size, cudaMemAttachGlobal);
+#if CUDA_VERSION >= 8000
+  if (e == cudaSuccess) {
+    // keep the pages on the gpu while they fit, and map them there once evicted,
+    // so that the host never takes them over by touching them
+    cudaMemAdvise(*ptr, size, cudaMemAdviseSetPreferredLocation, dev_id_);
+    cudaMemAdvise(*ptr, size, cudaMemAdviseSetAccessedBy, dev_id_);
+    // the advice is a hint, devices that do not take it still work
+    cudaGetLastError();
+  }
+#endif  // CUDA_VERSION >= 8000
+  return e;
+}
+
+void* GPUPooledStorageManager::MallocSegment(size_t size) {
+  size_t free, total;
+  cudaMemGetInfo(&free, &total);
+  if (free <= total * reserve_ / 100 || size > free - total * reserve_ / 100)
+    ReleaseAll();
+
+  void* ret = nullptr;
+  cudaError_t e = DeviceMalloc(&ret, size);
+  if (e == cudaErrorMemoryAllocation) {
+    // the pool may still hold enough free segments, give them back and retry
+    cudaGetLastError();
+    ReleaseAll();
+    e = DeviceMalloc(&ret, size);
+  }
+  if (e != cudaSuccess && e != cudaErrorCudartUnloading) {
+    LOG(FATAL) << (managed_ ? "cudaMallocManaged" : "cudaMalloc") << " failed: "
+               << cudaGetErrorString(e);
+  }
+  used_memory_ += size;
+  peak_memory_ = std::max(peak_memory_, used_memory_);
+  return ret;
+}
+
 void* GPUPooledStorageManager::Alloc(size_t raw_size) {
   std::lock_guard<std::mutex> lock(mutex_);
-  size_t size = raw_size + NDEV;
-  auto&& reuse_it = memory_pool_.find(size);
-  if (reuse_it == memory_pool_.end() || reuse_it->second.size() == 0) {
-    size_t free, total;
-    cudaMemGetInfo(&free, &total);
-    if (free <= total * reserve_ / 100 || size > free - total * reserve_ / 100)
-      ReleaseAll();
-
-    void* ret = nullptr;
-    cudaError_t e = cudaMalloc(&ret, size);
-    if (e != cudaSuccess && e != cudaErrorCudartUnloading) {
-      LOG(FATAL) << "cudaMalloc failed: " << cudaGetErrorString(e);
-    }
-    used_memory_ += size;
-    return ret;
+  size_t size = RoundToSizeClass(raw_size + NDEV, kMinBlock, kSmallSize);
+  bool small = size <= kSmallSize;
+  BlockPool& pool = small ? small_blocks_ : large_blocks_;
+  Block key(nullptr, size, small);
+  auto it = pool.lower_bound(&key);
+  Block* block;
+  if (it == pool.end()) {
+    size_t segment_size = small ? kSmallSegment : size;
+    block = new Block(static_cast<char*>(MallocSegment(segment_size)),
+                      segment_size, small);
   } else {
-    auto&& reuse_pool = reuse_it->second;
-    auto ret = reuse_pool.back();
-    reuse_pool.pop_back();
-    return ret;
+    block = *it;
+    pool.erase(it);
+    ++num_pool_hits_;
+  }
+  // split off the tail if it is big enough to serve another request
+  size_t remaining = block->size - size;
+  size_t min_split = small ? size_t(kMinBlock) : size_t(kSmallSize);
+  if (remaining >= min_split) {
+    Block* rest = new Block(block->ptr + size, remaining, small);
+    rest->prev = block;
+    rest->next = block->next;
+    if (block->next != nullptr) block->next->prev = rest;
+    block->next = rest;
+    block->size = size;
+    pool.insert(rest);
   }
+  block->allocated = true;
+  allocated_blocks_[block->ptr] = block;
+  return block->ptr;
+}
+
+void GPUPooledStorageManager::MergeBlocks(Block* dst, Block* src) {
+  if (src == nullptr || src->allocated) return;
+  PoolOf(src).erase(src);
+  if (dst->prev == src) {
+    dst->ptr = src->ptr;
+    dst->prev = src->prev;
+    if (dst->prev != nullptr) dst->prev->next = dst;
+  } else {
+    dst->next = src->next;
+    if (dst->next != nullptr) dst->next->prev = dst;
+  }
+  dst->size += src->size;
+  delete src;
+}
+
+void GPUPooledStorageManager::FreeBlock(Block* block) {
+  block->allocated = false;
+  MergeBlocks(block, block->prev);
+  MergeBlocks(block, block->next);
+  PoolOf(block).insert(block);
 }
 
 void GPUPooledStorageManager::Free(void* ptr, size_t raw_size) {
   std::lock_guard<std::mutex> lock(mutex_);
-  size_t size = raw_size + NDEV;
-  auto&& reuse_pool = memory_pool_[size];
-  reuse_pool.push_back(ptr);
+  auto it = allocated_blocks_.find(ptr);
+  CHECK(it != allocated_blocks_.end())
+      << "Free a pointer that is not allocated by the memory pool";
+  Block* block = it->second;
+  allocated_blocks_.erase(it);
+  FreeBlock(block);
+}
+
+void GPUPooledStorageManager::DirectFree(void* ptr, size_t raw_size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = allocated_blocks_.find(ptr);
+  CHECK(it != allocated_blocks_.end())
+      << "Free a pointer that is not allocated by the memory pool";
+  Block* block = it->second;
+  allocated_blocks_.erase(it);
+  if (block->prev != nullptr || block->next != nullptr) {
+    // the segment is shared with other blocks, keep it in the pool
+    FreeBlock(block);
+    return;
+  }
+  cudaError_t err = cudaFree(block->ptr);
+  // ignore unloading error, as memory has already been recycled
+  if (err != cudaSuccess && err != cudaErrorCudartUnloading) {
+    LOG(FATAL) << "CUDA: " << cudaGetErrorString(err);
+  }
+  used_memory_ -= block->size;
+  delete block;
+}
+
+void GPUPooledStorageManager::GetStats(Storage::Stats* stats) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats->bytes_reserved = used_memory_;
+  stats->peak_bytes_reserved = peak_memory_;
+  stats->num_pool_hits = num_pool_hits_;
+  stats->bytes_pooled = 0;
+  stats->largest_pooled_block = 0;
+  for (BlockPool* pool : {&small_blocks_, &large_blocks_}) {
+    for (const Block* block : *pool) stats->bytes_pooled += block->size;
+    if (!pool->empty()) {
+      stats->largest_pooled_block = std::max(stats->largest_pooled_block,
+                                             (*pool->rbegin())->size);
+    }
+  }
 }
 
 void GPUPooledStorageManager::ReleaseAll() {
-  for (auto&& i : memory_pool_) {
-    for (auto&& j : i.second) {
-      DirectFree(j, i.first - NDEV);
+  for (BlockPool* pool : {&small_blocks_, &large_blocks_}) {
+    for (auto it = pool->begin(); it != pool->end();) {
+      Block* block = *it;
+      if (block->prev != nullptr || block->next != nullptr) {
+        ++it;
+        continue;
+      }
+      cudaError_t err = cudaFree(block->ptr);
+      // ignore unloading error, as memory has already been recycled
+      if (err != cudaSuccess && err != cudaErrorCudartUnloading) {
+        LOG(FATAL) << "CUDA: " << cudaGetErrorString(err);
+      }
+      used_memory_ -= block->size;
+      it = pool->erase(it);
+      delete block;
     }
   }
-  memory_pool_.clear();
 }
 #endif  // MXNET_USE_CUDA
 
+/*!
+ * \brief Storage manager with a memory pool on host memory.
+ *
+ *  Free blocks are cached per size class in a number of shards.  A thread
+ *  frees to and allocates from the shard its id hashes to, and only looks at
+ *  the other shards on a miss, so concurrent threads rarely share a lock while
+ *  memory freed by engine workers still serves the pushing thread.  The pages
+ *  of new allocations can optionally be bound to a NUMA node.
+ *
+ * \tparam DeviceStorage the storage that provides the actual host memory,
+ *  CPUDeviceStorage or PinnedMemoryStorage.
+ */
+template <class DeviceStorage>
+class CPUPooledStorageManager final : public StorageManager {
+ public:
+  /*!
+   * \brief Constructor.
+   * \param cache_limit maximum number of bytes kept in the pool.
+   * \param total_limit the pool is released before the bytes allocated from
+   *  DeviceStorage grow beyond this limit, 0 for no limit.
+   * \param numa_node NUMA node to bind new allocations to, -1 for no binding.
+   */
+  CPUPooledStorageManager(size_t cache_limit, size_t total_limit, int numa_node)
+      : total_limit_(total_limit), numa_node_(numa_node) {
+    num_shards_ = std::max(1, dmlc::GetEnv("MXNET_CPU_MEM_POOL_NSHARDS", 8));
+    shard_limit_ = cache_limit / num_shards_;
+    shards_.reset(new Shard[num_shards_]);
+  }
+  /*!
+   * \brief Default destructor.
+   */
+  ~CPUPooledStorageManager() {
+    ReleaseAll();
+  }
+
+  void* Alloc(size_t raw_size) override;
+  void Free(void* ptr, size_t raw_size) override;
+
+  void DirectFree(void* ptr, size_t raw_size) override {
+    DeviceStorage::Free(ptr);
+    used_memory_ -= RoundToSizeClass(raw_size, kMinBlock, kSmallSize);
+  }
+  void GetStats(Storage::Stats* stats) override;
+
+ private:
+  struct Shard {
+    // internal mutex
+    std::mutex mutex;
+    // bytes currently cached in this shard
+    size_t cached_bytes = 0;
+    // memory pool
+    std::unordered_map<size_t, std::vector<void*>> memory_pool;
+  };
+  /*! \brief requests up to this size are rounded to multiples of kMinBlock */
+  static constexpr size_t kSmallSize = 1 << 12;
+  /*! \brief granularity of all block sizes, matching the cache line size */
+  static constexpr size_t kMinBlock = 64;
+  /*! \brief pop a cached block of the given size, or return nullptr */
+  static void* PopFrom(Shard* shard, size_t size);
+  /*! \brief bind the whole pages of a new allocation to numa_node_ */
+  void BindToNode(void* ptr, size_t size);
+  void ReleaseAll();
+  Shard* CurrentShard() {
+    size_t hash = std::hash<std::thread::id>()(std::this_thread::get_id());
+    return &shards_[hash % num_shards_];
+  }
+  // number of shards
+  int num_shards_;
+  // maximum number of bytes a shard caches
+  size_t shard_limit_;
+  // limit of the bytes allocated from DeviceStorage
+  size_t total_limit_;
+  // bytes allocated from DeviceStorage, including cached blocks
+  std::atomic<size_t> used_memory_{0};
+  // highest value of used memory
+  std::atomic<size_t> peak_memory_{0};
+  // number of allocations served from the pool
+  std::atomic<size_t> num_pool_hits_{0};
+  // numa node to bind memory to, -1 for no binding
+  std::atomic<int> numa_node_;
+  // the shards
+  std::unique_ptr<Shard[]> shards_;
+  DISALLOW_COPY_AND_ASSIGN(CPUPooledStorageManager);
+};  // class CPUPooledStorageManager
+
+template <class DeviceStorage>
+void* CPUPooledStorageManager<DeviceStorage>::PopFrom(Shard* shard, size_t size) {
+  auto&& reuse_it = shard->memory_pool.find(size);
+  if (reuse_it == shard->memory_pool.end() || reuse_it->second.size() == 0) {
+    return nullptr;
+  }
+  auto&& reuse_pool = reuse_it->second;
+  void* ret = reuse_pool.back();
+  reuse_pool.pop_back();
+  shard->cached_bytes -= size;
+  return ret;
+}
+
+template <class DeviceStorage>
+void* CPUPooledStorageManager<DeviceStorage>::Alloc(size_t raw_size) {
+  size_t size = RoundToSizeClass(raw_size, kMinBlock, kSmallSize);
+  Shard* home = CurrentShard();
+  {
+    std::lock_guard<std::mutex> lock(home->mutex);
+    void* ret = PopFrom(home, size);
+    if (ret != nullptr) {
+      ++num_pool_hits_;
+      return ret;
+    }
+  }
+  // memory is often freed by another thread, e.g. an engine worker
+  for (int i = 0; i < num_shards_; ++i) {
+    Shard* shard = &shards_[i];
+    if (shard == home) continue;
+    std::unique_lock<std::mutex> lock(shard->mutex, std::try_to_lock);
+    if (!lock.owns_lock()) continue;
+    void* ret = PopFrom(shard, size);
+    if (ret != nullptr) {
+      ++num_pool_hits_;
+      return ret;
+    }
+  }
+  if (total_limit_ != 0 && used_memory_ + size > total_limit_) ReleaseAll();
+  void* ret = DeviceStorage::Alloc(size);
+  size_t used = used_memory_ += size;
+  size_t peak = peak_memory_;
+  while (used > peak && !peak_memory_.compare_exchange_weak(peak, used)) {}
+  BindToNode(ret, size);
+  return ret;
+}
+
+template <class DeviceStorage>
+void CPUPooledStorageManager<DeviceStorage>::Free(void* ptr, size_t raw_size) {
+  size_t size = RoundToSizeClass(raw_size, kMinBlock, kSmallSize);
+  Shard* shard = CurrentShard();
+  {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    if (shard->cached_bytes + size <= shard_limit_) {
+      shard->memory_pool[size].push_back(ptr);
+      shard->cached_bytes += size;
+      return;
+    }
+  }
+  DeviceStorage::Free(ptr);
+  used_memory_ -= size;
+}
+
+template <class DeviceStorage>
+void CPUPooledStorageManager<DeviceStorage>::BindToNode(void* ptr, size_t size) {
+#if defined(__linux__) && defined(SYS_mbind)
+  const uintptr_t kPageSize = 4096;
+  // MPOL_BIND from <numaif.h>, spelled out to avoid depending on libnuma
+  const int kMPolBind = 2;
+  int node = numa_node_;
+  if (node < 0) return;
+  CHECK_LT(node, 64) << "NUMA binding supports up to 64 NUMA nodes";
+  uintptr_t begin = (reinterpret_cast<uintptr_t>(ptr) + kPageSize - 1) & ~(kPageSize - 1);
+  uintptr_t end = (reinterpret_cast<uintptr_t>(ptr) + size) & ~(kPageSize - 1);
+  // pages shared with other blocks keep the default first-touch placement
+  if (end <= begin) return;
+  uint64_t nodemask = uint64_t(1) << node;
+  if (syscall(SYS_mbind, begin, end - begin, kMPolBind, &nodemask,
+              sizeof(nodemask) * 8 + 1, 0) != 0) {
+    LOG(WARNING) << "Failed to bind memory to NUMA node " << node
+                 << ", disable NUMA binding";
+    numa_node_ = -1;
+  }
+#endif  // defined(__linux__) && defined(SYS_mbind)
+}
+
+template <class DeviceStorage>
+void CPUPooledStorageManager<DeviceStorage>::GetStats(Storage::Stats* stats) {
+  stats->bytes_reserved = used_memory_;
+  stats->peak_bytes_reserved = peak_memory_;
+  stats->num_pool_hits = num_pool_hits_;
+  stats->bytes_pooled = 0;
+  stats->largest_pooled_block = 0;
+  for (int i = 0; i < num_shards_; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+    stats->bytes_pooled += shards_[i].cached_bytes;
+    for (auto&& it : shards_[i].memory_pool) {
+      if (!it.second.empty()) {
+        stats->largest_pooled_block = std::max(stats->largest_pooled_block, it.first);
+      }
+    }
+  }
+}
+
+template <class DeviceStorage>
+void CPUPooledStorageManager<DeviceStorage>::ReleaseAll() {
+  for (int i = 0; i < num_shards_; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+    for (auto&& it : shards_[i].memory_pool) {
+      for (auto&& ptr : it.second) {
+        DeviceStorage::Free(ptr);
+        used_memory_ -= it.first;
+      }
+    }
+    shards_[i].memory_pool.clear();
+    shards_[i].cached_bytes = 0;
+  }
+}
+
 }  // namespace storage
 }  // namespace mxnet
 
@@ -22,14 +22,21 @@
 #include <mxnet/storage.h>
 #include <mshadow/tensor.h>
 #include <dmlc/logging.h>
+#if !defined(_MSC_VER)
+#include <unistd.h>
+#endif  // !defined(_MSC_VER)
 #include <array>
+#include <atomic>
+#include <string>
 #include "./storage_manager.h"
 #include "./naive_storage_manager.h"
 #include "./pooled_storage_manager.h"
 #include "./cpu_device_storage.h"
+#include "./cpu_shared_storage_manager.h"
 #include "./pinned_memory_storage.h"
 #include "../common/cuda_utils.h"
 #include "../common/lazy_alloc_array.h"
+#include "../engine/profiler.h"
 
 namespace mxnet {
 
@@ -39,6 +46,9 @@ class StorageImpl : public Storage {
   Handle Alloc(size_t size, Context ctx) override;
   void Free(Handle handle) override;
   void DirectFree(Handle handle) override;
+  Stats GetStats(Context ctx) override;
+  Handle SharedAttach(int shared_pid, int shared_id) override;
+  void SharedIncrementRefCount(Handle handle) override;
   StorageImpl() {}
   virtual ~StorageImpl() = default;
 
@@ -51,7 +61,8 @@ class StorageImpl : public Storage {
 
   static void ActivateDevice(Context ctx) {
     switch (ctx.dev_type) {
-      case Context::kCPU: break;
+      case Context::kCPU:
+      case Context::kCPUShared: break;
       case Context::kGPU:
       case Context::kCPUPinned: {
 #if MXNET_USE_CUDA
@@ -65,9 +76,61 @@ class StorageImpl : public Storage {
         LOG(FATAL) << "Unimplemented device";
     }
   }
+  /*! \return the size of the physical host memory in bytes, 0 if unknown */
+  static size_t PhysicalMemorySize() {
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+    long pages = sysconf(_SC_PHYS_PAGES);  // NOLINT(*)
+    long page_size = sysconf(_SC_PAGESIZE);  // NOLINT(*)
+    if (pages > 0 && page_size > 0) return static_cast<size_t>(pages) * page_size;
+#endif  // defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+    return 0;
+  }
+  /*! \brief counters of one context that do not depend on the manager */
+  struct ContextStats {
+    std::atomic<size_t> bytes_in_use{0};
+    std::atomic<size_t> peak_bytes_in_use{0};
+    std::atomic<size_t> num_allocs{0};
+  };
+  /*! \brief count a release of size bytes */
+  /*! \brief count an allocation of size bytes */
+  static void RecordAlloc(const Context& ctx, ContextStats* stats, size_t size) {
+    ++stats->num_allocs;
+    size_t in_use = stats->bytes_in_use += size;
+    size_t peak = stats->peak_bytes_in_use;
+    while (in_use > peak && !stats->peak_bytes_in_use.compare_exchange_weak(peak, in_use)) {}
+#if MXNET_USE_PROFILER
+    engine::Profiler* profiler = engine::Profiler::Get();
+    if (profiler->IsRecordingMemory()) profiler->AddMemoryEvent(ctx, size, true, in_use);
+#endif
+  }
+  static void RecordFree(const Context& ctx, ContextStats* stats, size_t size) {
+    size_t in_use = stats->bytes_in_use -= size;
+#if MXNET_USE_PROFILER
+    engine::Profiler* profiler = engine::Profiler::Get();
+    if (profiler->IsRecordingMemory()) profiler->AddMemoryEvent(ctx, size, false, in_use);
+#endif
+  }
+  /*! \brief the manager of the shared memory of ctx, created on its first use */
+  storage::CPUSharedStorageManager* SharedManager(Context ctx) {
+    CHECK_EQ(ctx.dev_type, Context::kCPUShared);
+    std::shared_ptr<storage::StorageManager> manager =
+        storage_managers_.at(ctx.dev_type).Get(ctx.dev_id, []() {
+          return new storage::CPUSharedStorageManager();
+        });
+    return static_cast<storage::CPUSharedStorageManager*>(manager.get());
+  }
+  ContextStats* GetContextStats(Context ctx) {
+    if (ctx.dev_id < 0 || static_cast<size_t>(ctx.dev_id) >= kMaxNumberOfDeviceIDs) {
+      return nullptr;
+    }
+    return &context_stats_.at(ctx.dev_type)[ctx.dev_id];
+  }
   // internal storage managers
   std::array<common::LazyAllocArray<storage::StorageManager>,
              kMaxNumberOfDevices> storage_managers_;
+  // allocation counters of each context
+  std::array<std::array<ContextStats, kMaxNumberOfDeviceIDs>,
+             kMaxNumberOfDevices> context_stats_;
 };  // struct Storage::Impl
 #if MXNET_USE_CUDA
 int StorageImpl::num_gpu_device = 0;
@@ -84,7 +147,14 @@ Storage::Handle StorageImpl::Alloc(size_t size, Context ctx) {
         storage::StorageManager *ptr = nullptr;
         switch (ctx.dev_type) {
           case Context::kCPU: {
-            ptr = new storage::NaiveStorageManager<storage::CPUDeviceStorage>();
+            if (dmlc::GetEnv("MXNET_CPU_MEM_POOL_TYPE", std::string("Pooled")) == "Naive") {
+              ptr = new storage::NaiveStorageManager<storage::CPUDeviceStorage>();
+            } else {
+              size_t limit = dmlc::GetEnv("MXNET_CPU_MEM_POOL_LIMIT_MB", 1024);
+              int numa_node = dmlc::GetEnv("MXNET_CPU_NUMA_BIND", false) ? ctx.dev_id : -1;
+              ptr = new storage::CPUPooledStorageManager<storage::CPUDeviceStorage>(
+                  limit << 20, 0, numa_node);
+            }
             break;
           }
           case Context::kCPUPinned: {
@@ -95,7 +165,12 @@ Storage::Handle StorageImpl::Alloc(size_t size, Context ctx) {
               num_gpu_device = 0;
             }
             if (num_gpu_device > 0) {
-              ptr = new storage::NaiveStorageManager<storage::PinnedMemoryStorage>();
+              // pinning too much host memory starves the rest of the system
+              int reserve = dmlc::GetEnv("MXNET_PINNED_MEM_POOL_RESERVE", 5);
+              size_t limit = dmlc::GetEnv("MXNET_PINNED_MEM_POOL_LIMIT_MB", 1024);
+              size_t total = PhysicalMemorySize() / 100 * (100 - reserve);
+              ptr = new storage::CPUPooledStorageManager<storage::PinnedMemoryStorage>(
+                  limit << 20, total, -1);
             } else {
               ptr = new storage::NaiveStorageManager<storage::CPUDeviceStorage>();
             }
@@ -104,11 +179,15 @@ Storage::Handle StorageImpl::Alloc(size_t size, Context ctx) {
 #endif  // MXNET_USE_CUDA
             break;
           }
+          case Context::kCPUShared: {
+            ptr = new storage::CPUSharedStorageManager();
+            break;
+          }
           case Context::kGPU: {
 #if MXNET_USE_CUDA
             CUDA_CALL(cudaGetDeviceCount(&num_gpu_device));
             CHECK_GT(num_gpu_device, 0) << "GPU usage requires at least 1 GPU";
-            ptr = new storage::GPUPooledStorageManager();
+            ptr = new storage::GPUPooledStorageManager(ctx.dev_id, UseManagedMemory());
 #else
             LOG(FATAL) << "Compile with USE_CUDA=1 to enable GPU usage";
 #endif  // MXNET_USE_CUDA
@@ -120,9 +199,28 @@ Storage::Handle StorageImpl::Alloc(size_t size, Context ctx) {
       });
   this->ActivateDevice(ctx);
   hd.dptr = manager->Alloc(size);
+  if (ctx.dev_type == Context::kCPUShared) {
+    SharedManager(ctx)->GetIds(hd.dptr, &hd.shared_pid, &hd.shared_id);
+  }
+  ContextStats* stats = GetContextStats(ctx);
+  if (stats != nullptr) RecordAlloc(ctx, stats, size);
+  return hd;
+}
+
+Storage::Handle StorageImpl::SharedAttach(int shared_pid, int shared_id) {
+  Handle hd;
+  hd.ctx = Context::CPUShared(0);
+  hd.shared_pid = shared_pid;
+  hd.shared_id = shared_id;
+  hd.dptr = SharedManager(hd.ctx)->Attach(shared_pid, shared_id, &hd.size);
+  RecordAlloc(hd.ctx, GetContextStats(hd.ctx), hd.size);
   return hd;
 }
 
+void StorageImpl::SharedIncrementRefCount(Storage::Handle handle) {
+  SharedManager(handle.ctx)->IncrementRefCount(handle.dptr);
+}
+
 void StorageImpl::Free(Storage::Handle handle) {
   const Context &ctx = handle.ctx;
   auto&& device = storage_managers_.at(ctx.dev_type);
@@ -133,6 +231,8 @@ void StorageImpl::Free(Storage::Handle handle) {
       });
   this->ActivateDevice(ctx);
   manager->Free(handle.dptr, handle.size);
+  ContextStats* stats = GetContextStats(ctx);
+  if (stats != nullptr) RecordFree(ctx, stats, handle.size);
 }
 
 void StorageImpl::DirectFree(Storage::Handle handle) {
@@ -146,6 +246,25 @@ void StorageImpl::DirectFree(Storage::Handle handle) {
   this->ActivateDevice(ctx);
   // directly free ths data.
   manager->DirectFree(handle.dptr, handle.size);
+  ContextStats* stats = GetContextStats(ctx);
+  if (stats != nullptr) RecordFree(ctx, stats, handle.size);
+}
+
+Storage::Stats StorageImpl::GetStats(Context ctx) {
+  Stats ret;
+  ContextStats* stats = GetContextStats(ctx);
+  if (stats == nullptr) return ret;
+  ret.bytes_in_use = stats->bytes_in_use;
+  ret.peak_bytes_in_use = stats->peak_bytes_in_use;
+  ret.num_allocs = stats->num_allocs;
+  ret.bytes_reserved = ret.bytes_in_use;
+  ret.peak_bytes_reserved = ret.peak_bytes_in_use;
+  auto&& device = storage_managers_.at(ctx.dev_type);
+  // do not create a manager for a context that has never been used
+  std::shared_ptr<storage::StorageManager> manager = device.Get(
+      ctx.dev_id, []() { return nullptr; });
+  if (manager) manager->GetStats(&ret);
+  return ret;
 }
 
 std::shared_ptr<Storage> Storage::_GetSharedRef() {
@@ -24,6 +24,7 @@
 #ifndef MXNET_STORAGE_STORAGE_MANAGER_H_
 #define MXNET_STORAGE_STORAGE_MANAGER_H_
 
+#include <mxnet/storage.h>
 #include <cstddef>
 
 namespace mxnet {
@@ -52,6 +53,13 @@ class StorageManager {
    * \param size Size of the storage.
    */
   virtual void DirectFree(void* ptr, size_t size) = 0;
+  /*!
+   * \brief Fill in the pool related allocation statistics.
+   *  The caller has set bytes_reserved and peak_bytes_reserved to the bytes
+   *  in use, which is right for managers without a pool.
+   * \param stats The statistics to update.
+   */
+  virtual void GetStats(Storage::Stats* stats) {}
   /*!
    * \brief Destructor.
    */
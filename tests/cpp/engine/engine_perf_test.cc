@@ -0,0 +1,304 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*!
+ * \file engine_perf_test.cc
+ * \brief scheduling throughput and latencies of the engines
+ *
+ * Every engine runs the same workloads of empty or busy CPU operations:
+ *  - push: independent operations, the push cost and the throughput
+ *  - chain: each operation writes the var of the previous one
+ *  - fan_out: one write followed by readers of its var
+ *  - fan_in: writers of their own vars followed by one reader of all
+ *  - priority: the wait of a high priority operation behind busy ones
+ *  - wait_for_var: the wake-up of WaitForVar after the write it waits for
+ *
+ * The benchmark is configured by environment variables:
+ *  - MXNET_ENGINE_BENCH_OPS: the number of operations of a workload, 10000 by default
+ *  - MXNET_ENGINE_BENCH_WIDTH: the readers of fan_out and writers of fan_in, 16 by default
+ *  - MXNET_ENGINE_BENCH_BUSY_US: the run time of the busy operations, 50 by default
+ *  - MXNET_ENGINE_BENCH_ITERS: the number of timed repeats of the latencies, 100 by default
+ *  - MXNET_ENGINE_BENCH_OUTPUT: a file the results are appended to, stdout by default
+ *
+ * Each result is a line of JSON, e.g.
+ * \code
+ * {"engine": "ThreadedEnginePerDevice", "bench": "chain", "ops": 10000,
+ *  "total_us": 15321.4, "per_op_us": 1.532, "p50_us": 0, "p99_us": 0}
+ * \endcode
+ * with the percentiles of the latencies, 0 when the workload has none. Run it by
+ * \code
+ * build/tests/cpp/mxnet_test --gtest_filter=ENGINE_PERF.*
+ * \endcode
+ */
+#include <gtest/gtest.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/engine.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../src/engine/engine_impl.h"
+
+namespace mxnet {
+namespace test {
+namespace engine_perf {
+
+struct BenchConfig {
+  int ops;
+  int width;
+  int busy_us;
+  int iters;
+  std::string output;
+
+  BenchConfig() {
+    ops = dmlc::GetEnv("MXNET_ENGINE_BENCH_OPS", 10000);
+    width = dmlc::GetEnv("MXNET_ENGINE_BENCH_WIDTH", 16);
+    busy_us = dmlc::GetEnv("MXNET_ENGINE_BENCH_BUSY_US", 50);
+    iters = dmlc::GetEnv("MXNET_ENGINE_BENCH_ITERS", 100);
+    output = dmlc::GetEnv("MXNET_ENGINE_BENCH_OUTPUT", std::string());
+    CHECK_GT(ops, 0);
+    CHECK_GT(width, 0);
+    CHECK_GE(busy_us, 0);
+    CHECK_GT(iters, 0);
+  }
+};
+
+typedef std::chrono::steady_clock Clock;
+
+inline double MicrosSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+/*! \brief keep the thread busy for us microseconds, as sleeping would measure the scheduler */
+inline void Busy(int us) {
+  const Clock::time_point end = Clock::now() + std::chrono::microseconds(us);
+  while (Clock::now() < end) {}
+}
+
+/*! \brief one result, printed as a line of JSON */
+struct Result {
+  std::string engine;
+  std::string bench;
+  int ops{0};
+  double total_us{0};
+  std::vector<double> latencies_us;
+
+  double Percentile(int p) {
+    if (latencies_us.empty()) return 0;
+    std::sort(latencies_us.begin(), latencies_us.end());
+    return latencies_us[(latencies_us.size() - 1) * p / 100];
+  }
+
+  std::string ToJSON() {
+    std::ostringstream os;
+    os << "{\"engine\": \"" << engine << "\", \"bench\": \"" << bench
+       << "\", \"ops\": " << ops << ", \"total_us\": " << total_us
+       << ", \"per_op_us\": " << total_us / std::max(ops, 1)
+       << ", \"p50_us\": " << Percentile(50) << ", \"p99_us\": " << Percentile(99) << "}";
+    return os.str();
+  }
+};
+
+class Bench {
+ public:
+  Bench(const BenchConfig& cfg, const std::string& name, Engine* engine)
+      : cfg_(cfg), name_(name), engine_(engine) {}
+
+  ~Bench() {
+    for (auto v : vars_) engine_->DeleteVariable([](RunContext) {}, Context::CPU(), v);
+    engine_->WaitForAll();
+  }
+
+  void Run(std::vector<Result>* results) {
+    results->push_back(Push());
+    results->push_back(Chain());
+    results->push_back(FanOut());
+    results->push_back(FanIn());
+    results->push_back(Priority());
+    results->push_back(WaitForVar());
+  }
+
+ private:
+  Result NewResult(const std::string& bench, int ops) {
+    Result r;
+    r.engine = name_;
+    r.bench = bench;
+    r.ops = ops;
+    return r;
+  }
+
+  Engine::VarHandle Var(size_t i) {
+    while (vars_.size() <= i) vars_.push_back(engine_->NewVariable());
+    return vars_[i];
+  }
+
+  void PushEmpty(std::vector<Engine::VarHandle> const& reads,
+                 std::vector<Engine::VarHandle> const& writes, int priority = 0) {
+    engine_->PushSync([](RunContext) {}, Context::CPU(), reads, writes,
+                      FnProperty::kNormal, priority);
+  }
+
+  // the latencies are the push costs, the total the time to run them all
+  Result Push() {
+    Result r = NewResult("push", cfg_.ops);
+    const int num_vars = std::max(cfg_.width, 1);
+    for (int i = 0; i < num_vars; ++i) Var(i);
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < cfg_.ops; ++i) {
+      const Clock::time_point push = Clock::now();
+      PushEmpty({}, {Var(i % num_vars)});
+      r.latencies_us.push_back(MicrosSince(push));
+    }
+    engine_->WaitForAll();
+    r.total_us = MicrosSince(start);
+    return r;
+  }
+
+  Result Chain() {
+    Result r = NewResult("chain", cfg_.ops);
+    Engine::VarHandle a = Var(0), b = Var(1);
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < cfg_.ops; ++i) {
+      if (i % 2 == 0) {
+        PushEmpty({a}, {b});
+      } else {
+        PushEmpty({b}, {a});
+      }
+    }
+    engine_->WaitForAll();
+    r.total_us = MicrosSince(start);
+    return r;
+  }
+
+  // the latencies are the rounds of one write and width reads
+  Result FanOut() {
+    const int rounds = std::max(cfg_.ops / (cfg_.width + 1), 1);
+    Result r = NewResult("fan_out", rounds * (cfg_.width + 1));
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < rounds; ++i) {
+      const Clock::time_point round = Clock::now();
+      PushEmpty({}, {Var(0)});
+      for (int j = 0; j < cfg_.width; ++j) PushEmpty({Var(0)}, {Var(j + 1)});
+      engine_->WaitForAll();
+      r.latencies_us.push_back(MicrosSince(round));
+    }
+    r.total_us = MicrosSince(start);
+    return r;
+  }
+
+  // the latencies are the rounds of width writes and one read of them all
+  Result FanIn() {
+    const int rounds = std::max(cfg_.ops / (cfg_.width + 1), 1);
+    Result r = NewResult("fan_in", rounds * (cfg_.width + 1));
+    std::vector<Engine::VarHandle> reads;
+    for (int j = 0; j < cfg_.width; ++j) reads.push_back(Var(j + 1));
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < rounds; ++i) {
+      const Clock::time_point round = Clock::now();
+      for (int j = 0; j < cfg_.width; ++j) PushEmpty({}, {Var(j + 1)});
+      PushEmpty(reads, {Var(0)});
+      engine_->WaitForAll();
+      r.latencies_us.push_back(MicrosSince(round));
+    }
+    r.total_us = MicrosSince(start);
+    return r;
+  }
+
+  // the latencies are from the push of a high priority operation to its start,
+  // behind width busy operations on independent vars
+  Result Priority() {
+    Result r = NewResult("priority", cfg_.iters * (cfg_.width + 1));
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < cfg_.iters; ++i) {
+      const int busy_us = cfg_.busy_us;
+      for (int j = 0; j < cfg_.width; ++j) {
+        engine_->PushSync([busy_us](RunContext) { Busy(busy_us); }, Context::CPU(),
+                          {}, {Var(j + 1)});
+      }
+      const Clock::time_point push = Clock::now();
+      double latency = 0;
+      engine_->PushSync([&latency, push](RunContext) { latency = MicrosSince(push); },
+                        Context::CPU(), {}, {Var(0)}, FnProperty::kNormal, 1);
+      engine_->WaitForAll();
+      r.latencies_us.push_back(latency);
+    }
+    r.total_us = MicrosSince(start);
+    return r;
+  }
+
+  // the latencies are from the end of a busy write to the return of the wait for it
+  Result WaitForVar() {
+    Result r = NewResult("wait_for_var", cfg_.iters);
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < cfg_.iters; ++i) {
+      const int busy_us = cfg_.busy_us;
+      std::atomic<int64_t> end{0};
+      engine_->PushSync([busy_us, &end](RunContext) {
+          Busy(busy_us);
+          end.store(Clock::now().time_since_epoch().count());
+        }, Context::CPU(), {}, {Var(0)});
+      engine_->WaitForVar(Var(0));
+      const Clock::time_point woken = Clock::now();
+      r.latencies_us.push_back(std::chrono::duration<double, std::micro>(
+          woken - Clock::time_point(Clock::duration(end.load()))).count());
+    }
+    r.total_us = MicrosSince(start);
+    return r;
+  }
+
+  const BenchConfig& cfg_;
+  std::string name_;
+  Engine* engine_;
+  std::vector<Engine::VarHandle> vars_;
+};
+
+inline void RunBenchmark(const BenchConfig& cfg) {
+  std::vector<std::pair<std::string, Engine*(*)()> > engines = {
+    {"NaiveEngine", engine::CreateNaiveEngine},
+    {"ThreadedEnginePooled", engine::CreateThreadedEnginePooled},
+    {"ThreadedEnginePerDevice", engine::CreateThreadedEnginePerDevice},
+  };
+  std::vector<Result> results;
+  for (const auto& e : engines) {
+    std::unique_ptr<Engine> engine(e.second());
+    Bench(cfg, e.first, engine.get()).Run(&results);
+  }
+  std::ofstream file;
+  if (!cfg.output.empty()) {
+    file.open(cfg.output, std::ios::app);
+    CHECK(file.good()) << "Cannot open " << cfg.output;
+  }
+  std::ostream& os = cfg.output.empty() ? std::cout : file;
+  for (auto& r : results) os << r.ToJSON() << std::endl;
+}
+
+}  // namespace engine_perf
+}  // namespace test
+}  // namespace mxnet
+
+TEST(ENGINE_PERF, Schedule) {
+  mxnet::test::engine_perf::RunBenchmark(mxnet::test::engine_perf::BenchConfig());
+}
@@ -27,12 +27,15 @@
 #include <gtest/gtest.h>
 #include <mxnet/engine.h>
 #include <dmlc/timer.h>
+#include <atomic>
 #include <cstdio>
+#include <cstdlib>
 #include <thread>
 #include <chrono>
 #include <vector>
 
 #include "../src/engine/engine_impl.h"
+#include "../src/engine/work_stealing_queue.h"
 
 /**
  * present the following workload
@@ -154,8 +157,295 @@ TEST(Engine, RandSumExpr) {
   LOG(INFO) << "ThreadedEnginePerDevice\t" << t[3] << " sec";
 }
 
+TEST(Engine, RandSumExprWorkStealing) {
+  setenv("MXNET_CPU_WORKER_NTHREADS", "4", 1);
+  setenv("MXNET_CPU_WORKER_WORK_STEALING", "1", 1);
+  mxnet::Engine* engine = mxnet::engine::CreateThreadedEnginePerDevice();
+  unsetenv("MXNET_CPU_WORKER_WORK_STEALING");
+  unsetenv("MXNET_CPU_WORKER_NTHREADS");
+
+  std::vector<Workload> workloads;
+  int num_var = 100;
+  GenerateWorkload(10000, num_var, 2, 20, 1, 10, &workloads);
+  std::vector<double> expected(num_var, 1.0), data(num_var, 1.0);
+  EvaluateWorloads(workloads, NULL, &expected);
+  double t = EvaluateWorloads(workloads, engine, &data);
+  for (int j = 0; j < num_var; ++j) EXPECT_EQ(expected[j], data[j]);
+  LOG(INFO) << "ThreadedEnginePerDevice (work stealing)\t" << t << " sec";
+}
+
+TEST(Engine, WorkStealingQueue) {
+  const int num_workers = 4;
+  const int num_tasks = 100000;
+  mxnet::engine::WorkStealingQueue<int*> queue(num_workers);
+  std::vector<int> tasks(num_tasks, 0);
+  std::atomic<int> num_done{0};
+  std::vector<std::thread> workers;
+  for (int i = 0; i < num_workers; ++i) {
+    workers.emplace_back([&queue, &tasks, &num_done]() {
+        int* task;
+        while (queue.Pop(&task)) {
+          // tasks in the first half respawn one from the second half
+          // through the worker's own deque
+          size_t idx = task - tasks.data();
+          if (idx < tasks.size() / 2) queue.Push(task + tasks.size() / 2);
+          ++*task;
+          ++num_done;
+        }
+      });
+  }
+  for (int i = 0; i < num_tasks / 2; ++i) queue.Push(&tasks[i]);
+  while (num_done.load() < num_tasks) std::this_thread::yield();
+  queue.SignalForKill();
+  for (auto& t : workers) t.join();
+  for (int i = 0; i < num_tasks; ++i) EXPECT_EQ(tasks[i], 1);
+}
+
+TEST(Engine, PushContention) {
+  // many threads push tiny ops that all read one shared variable,
+  // which measures the cost of the dependency tracking in ThreadedVar
+  using namespace mxnet;
+  const int num_pushers = 4;
+  const int num_ops = 20000;
+  Engine* engine = engine::CreateThreadedEnginePerDevice();
+  Engine::VarHandle shared = engine->NewVariable();
+  std::vector<Engine::VarHandle> vars(num_pushers);
+  std::vector<int> counts(num_pushers, 0);
+  for (auto& v : vars) v = engine->NewVariable();
+
+  double t = dmlc::GetTime();
+  std::vector<std::thread> pushers;
+  for (int i = 0; i < num_pushers; ++i) {
+    pushers.emplace_back([engine, shared, &vars, &counts, num_ops, i]() {
+        int* count = &counts[i];
+        for (int k = 0; k < num_ops; ++k) {
+          engine->PushSync([count](RunContext) { ++*count; },
+                           Context::CPU(), {shared}, {vars[i]});
+        }
+      });
+  }
+  for (auto& p : pushers) p.join();
+  double t_push = dmlc::GetTime() - t;
+  engine->WaitForAll();
+  t = dmlc::GetTime() - t;
+  for (int i = 0; i < num_pushers; ++i) EXPECT_EQ(counts[i], num_ops);
+  LOG(INFO) << "push " << num_pushers * num_ops << " ops from " << num_pushers
+            << " threads: " << num_pushers * num_ops / t_push << " pushes/sec, "
+            << num_pushers * num_ops / t << " ops/sec";
+}
+
+TEST(Engine, PushAsyncBatch) {
+  using namespace mxnet;
+  std::vector<Workload> workloads;
+  int num_var = 100;
+  GenerateWorkload(10000, num_var, 2, 20, 0, 1, &workloads);
+  std::vector<double> expected(num_var, 1.0), data(num_var, 1.0);
+  EvaluateWorloads(workloads, NULL, &expected);
+
+  Engine* engine = engine::CreateThreadedEnginePerDevice();
+  std::vector<Engine::VarHandle> vars;
+  for (int i = 0; i < num_var; ++i) vars.push_back(engine->NewVariable());
+  std::vector<double>* pdata = &data;
+  // push the workloads in batches of various sizes
+  std::vector<Engine::AsyncOpr> batch;
+  size_t batch_size = 1;
+  for (const auto& wl : workloads) {
+    if (wl.reads.size() == 0) continue;
+    batch.emplace_back();
+    Engine::AsyncOpr& opr = batch.back();
+    opr.fn = [wl, pdata](RunContext ctx, Engine::CallbackOnComplete cb) {
+      EvaluateWorload(wl, pdata); cb();
+    };
+    opr.exec_ctx = Context::CPU();
+    for (auto i : wl.reads) {
+      if (i != wl.write) opr.const_vars.push_back(vars[i]);
+    }
+    engine->DeduplicateVarHandle(&opr.const_vars, &opr.mutable_vars);
+    opr.mutable_vars.push_back(vars[wl.write]);
+    if (batch.size() == batch_size) {
+      engine->PushAsyncBatch(&batch);
+      batch.clear();
+      batch_size = batch_size % 64 + 1;
+    }
+  }
+  engine->PushAsyncBatch(&batch);
+  engine->WaitForAll();
+  for (int j = 0; j < num_var; ++j) EXPECT_EQ(expected[j], data[j]);
+}
+
 void Foo(mxnet::RunContext, int i) { printf("The fox says %d\n", i); }
 
+TEST(Engine, SpinWait) {
+  using namespace mxnet;
+  setenv("MXNET_ENGINE_WAIT_SPIN_US", "1000", 1);
+  Engine* engine = engine::CreateThreadedEnginePerDevice();
+  unsetenv("MXNET_ENGINE_WAIT_SPIN_US");
+  auto var = engine->NewVariable();
+  int value = 0;
+  for (int i = 0; i < 100; ++i) {
+    engine->PushSync([&value](RunContext) { ++value; },
+                     Context::CPU(), {}, {var});
+    engine->WaitForVar(var);
+    EXPECT_EQ(value, i + 1);
+  }
+  // a wait longer than the spin time falls back to blocking
+  engine->PushSync([](RunContext) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }, Context::CPU(), {}, {var});
+  engine->WaitForAll();
+  engine->DeleteVariable([](RunContext) {}, Context::CPU(), var);
+  engine->WaitForAll();
+}
+
+TEST(Engine, ViewVariable) {
+  // the writes of the views of disjoint parts run together, and never
+  // with the reads and writes of the whole
+  using namespace mxnet;
+  Engine* engine = engine::CreateThreadedEnginePerDevice();
+  const int num_parts = 4, part_len = 16;
+  auto whole = engine->NewVariable();
+  std::vector<Engine::VarHandle> parts;
+  for (int i = 0; i < num_parts; ++i) parts.push_back(engine->NewViewVariable(whole));
+  std::vector<int> data(num_parts * part_len, 0), expected(data.size(), 0);
+  std::atomic<int> num_partial{0}, num_whole{0};
+  std::atomic<bool> overlapped{false};
+  for (int k = 0; k < 10000; ++k) {
+    const int p = k % num_parts;
+    if (k % 7 == 6) {
+      std::vector<int> snapshot = expected;
+      // reading a part reads the whole
+      engine->PushSync([&, snapshot](RunContext) {
+          ++num_whole;
+          if (num_partial.load() != 0 || data != snapshot) overlapped = true;
+          --num_whole;
+        }, Context::CPU(), {parts[p]}, {});
+    } else if (k % 13 == 12) {
+      engine->PushSync([&](RunContext) {
+          ++num_whole;
+          if (num_partial.load() != 0) overlapped = true;
+          for (auto& x : data) x *= 2;
+          --num_whole;
+        }, Context::CPU(), {}, {whole});
+      for (auto& x : expected) x *= 2;
+    } else {
+      engine->PushSync([&, p](RunContext) {
+          ++num_partial;
+          if (num_whole.load() != 0) overlapped = true;
+          for (int j = 0; j < part_len; ++j) ++data[p * part_len + j];
+          --num_partial;
+        }, Context::CPU(), {}, {parts[p]});
+      for (int j = 0; j < part_len; ++j) ++expected[p * part_len + j];
+    }
+  }
+  engine->WaitForVar(parts[0]);
+  EXPECT_EQ(data, expected);
+  EXPECT_FALSE(overlapped.load());
+  for (auto v : parts) engine->DeleteVariable([](RunContext) {}, Context::CPU(), v);
+  engine->DeleteVariable([](RunContext) {}, Context::CPU(), whole);
+  engine->WaitForAll();
+}
+
+TEST(Engine, Bulk) {
+  // the operations collected into bulks keep the order of their dependencies
+  using namespace mxnet;
+  Engine* engine = engine::CreateThreadedEnginePerDevice();
+  auto a = engine->NewVariable(), b = engine->NewVariable();
+  int va = 0, vb = 0, expected_a = 0, expected_b = 0;
+  EXPECT_EQ(engine->set_bulk_size(5), 0);
+  for (int i = 0; i < 103; ++i) {
+    engine->PushSync([&](RunContext) { va = (va * 3 + 1) % 1000003; },
+                     Context::CPU(), {}, {a});
+    engine->PushSync([&](RunContext) { vb = (vb + va) % 1000003; },
+                     Context::CPU(), {a}, {b});
+    expected_a = (expected_a * 3 + 1) % 1000003;
+    expected_b = (expected_b + expected_a) % 1000003;
+    // a wait pushes the collected operations
+    if (i % 13 == 0) {
+      engine->WaitForVar(b);
+      EXPECT_EQ(vb, expected_b);
+    }
+  }
+  EXPECT_EQ(engine->set_bulk_size(0), 5);
+  engine->WaitForVar(b);
+  EXPECT_EQ(va, expected_a);
+  EXPECT_EQ(vb, expected_b);
+  engine->DeleteVariable([](RunContext) {}, Context::CPU(), a);
+  engine->DeleteVariable([](RunContext) {}, Context::CPU(), b);
+  engine->WaitForAll();
+}
+
+TEST(Engine, Inline) {
+  // the CPU operations run on the calling thread, after the ones pushed before
+  using namespace mxnet;
+  Engine* engine = engine::CreateThreadedEnginePerDevice();
+  auto a = engine->NewVariable();
+  int va = 0;
+  engine->PushSync([&](RunContext) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      va = 1;
+    }, Context::CPU(), {}, {a});
+  EXPECT_FALSE(engine->set_inline(true));
+  EXPECT_TRUE(engine->is_inline());
+  const std::thread::id caller = std::this_thread::get_id();
+  for (int i = 0; i < 10; ++i) {
+    engine->PushSync([&](RunContext) {
+        EXPECT_EQ(std::this_thread::get_id(), caller);
+        va = va * 2 + 1;
+      }, Context::CPU(), {}, {a});
+    EXPECT_EQ(va, (1 << (i + 2)) - 1);
+  }
+  // an asynchronous function may complete later, on another thread
+  std::thread completer;
+  engine->PushAsync([&](RunContext, Engine::CallbackOnComplete on_complete) {
+      completer = std::thread([&va, on_complete]() {
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+          ++va;
+          on_complete();
+        });
+    }, Context::CPU(), {}, {a});
+  EXPECT_EQ(va, 1 << 11);
+  completer.join();
+  EXPECT_TRUE(engine->set_inline(false));
+  engine->DeleteVariable([](RunContext) {}, Context::CPU(), a);
+  engine->WaitForAll();
+}
+
+TEST(Engine, WriteStamp) {
+  // the stamp of a variable changes with the writes pushed on it, or on its parent,
+  // however they are pushed, and not with the reads
+  using namespace mxnet;
+  Engine* engine = engine::CreateThreadedEnginePerDevice();
+  auto a = engine->NewVariable(), b = engine->NewVariable();
+  auto part = engine->NewViewVariable(b);
+  EXPECT_NE(engine->WriteStamp(a), engine->WriteStamp(b));
+  uint64_t stamp = engine->WriteStamp(a);
+  engine->PushSync([](RunContext) {}, Context::CPU(), {a}, {b});
+  EXPECT_EQ(engine->WriteStamp(a), stamp);
+  engine->PushSync([](RunContext) {}, Context::CPU(), {}, {a});
+  EXPECT_GT(engine->WriteStamp(a), stamp);
+  stamp = engine->WriteStamp(part);
+  engine->PushSync([](RunContext) {}, Context::CPU(), {}, {b});
+  EXPECT_GT(engine->WriteStamp(part), stamp);
+  stamp = engine->WriteStamp(b);
+  engine->PushSync([](RunContext) {}, Context::CPU(), {}, {part});
+  EXPECT_GT(engine->WriteStamp(b), stamp);
+  // the operations collected into a bulk or run inline are stamped when pushed
+  engine->set_bulk_size(4);
+  stamp = engine->WriteStamp(a);
+  engine->PushSync([](RunContext) {}, Context::CPU(), {}, {a});
+  EXPECT_GT(engine->WriteStamp(a), stamp);
+  engine->set_bulk_size(0);
+  engine->set_inline(true);
+  stamp = engine->WriteStamp(a);
+  engine->PushSync([](RunContext) {}, Context::CPU(), {}, {a});
+  EXPECT_GT(engine->WriteStamp(a), stamp);
+  engine->set_inline(false);
+  engine->DeleteVariable([](RunContext) {}, Context::CPU(), part);
+  engine->DeleteVariable([](RunContext) {}, Context::CPU(), a);
+  engine->DeleteVariable([](RunContext) {}, Context::CPU(), b);
+  engine->WaitForAll();
+}
+
 TEST(Engine, basics) {
   auto&& engine = mxnet::Engine::Get();
   auto&& var = engine->NewVariable();
@@ -0,0 +1,102 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file image_pack_test.cc
+ * \brief the vectorized HWC to CHW packing of the image iterators
+ */
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <type_traits>
+#include <vector>
+#include "../../src/io/image_pack.h"
+
+namespace {
+
+template<typename DType>
+void CheckPack(int rows, int cols, int channels, bool mirror, bool mean_img) {
+  std::mt19937 rnd(cols * 10 + channels);
+  std::uniform_int_distribution<int> byte(0, 255);
+  // rows with padding, as the rows of a cv::Mat roi
+  const size_t step = cols * channels + 3;
+  std::vector<uint8_t> src(rows * step);
+  for (auto& v : src) v = byte(rnd);
+  std::vector<float> mean(channels * rows * cols);
+  for (auto& v : mean) v = byte(rnd) * 0.5f;
+  mxnet::io::PackParam p;
+  if (!std::is_same<DType, uint8_t>::value) {
+    for (int c = 0; c < 4; ++c) {
+      p.mean[c] = 10.0f * c + 1.0f;
+      p.scale[c] = 0.5f + c;
+      p.bias[c] = c;
+    }
+    if (mean_img) p.mean_img = mean.data();
+  }
+  p.mirror = mirror;
+  std::vector<DType> out(channels * rows * cols);
+  mxnet::io::PackImage(src.data(), step, rows, cols, channels, p, out.data());
+  for (int c = 0; c < channels; ++c) {
+    // BGR(A) to RGB(A)
+    const int sc = channels >= 3 && c < 3 ? 2 - c : c;
+    for (int y = 0; y < rows; ++y) {
+      for (int x = 0; x < cols; ++x) {
+        const float m = p.mean_img != nullptr ? mean[(c * rows + y) * cols + x] : p.mean[c];
+        const float expected = static_cast<float>(static_cast<DType>(
+            (src[y * step + x * channels + sc] - m) * p.scale[c] + p.bias[c]));
+        const int ox = mirror ? cols - 1 - x : x;
+        const float got = static_cast<float>(out[(c * rows + y) * cols + ox]);
+        ASSERT_NEAR(got, expected, 1e-3f * std::fabs(expected) + 1e-4f)
+          << "channel " << c << " row " << y << " col " << x;
+      }
+    }
+  }
+}
+
+template<typename DType>
+void CheckPackShapes() {
+  for (int channels : {1, 3, 4}) {
+    // the widths around the 8 pixels of a vector
+    for (int cols : {1, 7, 8, 13, 64}) {
+      for (int mirror = 0; mirror < 2; ++mirror) {
+        for (int mean_img = 0; mean_img < 2; ++mean_img) {
+          CheckPack<DType>(5, cols, channels, mirror, mean_img);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(ImagePack, Float) {
+  CheckPackShapes<float>();
+}
+
+TEST(ImagePack, Half) {
+  CheckPackShapes<mshadow::half::half_t>();
+}
+
+TEST(ImagePack, UInt8) {
+  CheckPackShapes<uint8_t>();
+}
+
+TEST(ImagePack, Double) {
+  CheckPackShapes<double>();
+}
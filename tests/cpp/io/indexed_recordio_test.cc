@@ -0,0 +1,148 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file indexed_recordio_test.cc
+ * \brief random access reads of a memory-mapped RecordIO file
+ */
+#include <gtest/gtest.h>
+#include <dmlc/io.h>
+#include <dmlc/recordio.h>
+#include <cstdio>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../../src/io/indexed_recordio.h"
+
+#ifndef _WIN32
+TEST(IndexedRecordIO, ReadsEveryRecord) {
+  const std::string rec_path = "indexed_recordio_test.rec";
+  const std::string idx_path = "indexed_recordio_test.idx";
+  const int kRecords = 100;
+  std::vector<std::string> records;
+  {
+    std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(rec_path.c_str(), "w"));
+    std::unique_ptr<dmlc::Stream> fidx(dmlc::Stream::Create(idx_path.c_str(), "w"));
+    dmlc::RecordIOWriter writer(fo.get());
+    for (int i = 0; i < kRecords; ++i) {
+      std::string r(i * 7 + 1, static_cast<char>('a' + i % 26));
+      if (i % 10 == 0) {
+        // RecordIO splits the records around its magic number
+        const uint32_t magic = dmlc::RecordIOWriter::kMagic;
+        r.insert(r.size() / 2, reinterpret_cast<const char*>(&magic), sizeof(magic));
+      }
+      std::ostringstream line;
+      line << i << '\t' << writer.Tell() << '\n';
+      fidx->Write(line.str().c_str(), line.str().size());
+      writer.WriteRecord(r.data(), r.size());
+      records.push_back(r);
+    }
+  }
+  mxnet::common::RANDOM_ENGINE rnd(7);
+  for (int part = 0; part < 2; ++part) {
+    mxnet::io::IndexedRecordIO file(rec_path, idx_path, part, 2, 16);
+    EXPECT_EQ(file.Size(), static_cast<size_t>(kRecords / 2));
+    for (int epoch = 0; epoch < 2; ++epoch) {
+      file.BeforeFirst(epoch ? &rnd : nullptr);
+      std::vector<size_t> ids;
+      std::set<std::string> seen;
+      size_t first = 0;
+      bool head = true;
+      while (file.NextChunk(&ids)) {
+        if (head) first = ids[0];
+        head = false;
+        for (int tid = 0; tid < 3; ++tid) {
+          mxnet::io::ChunkRecordReader reader(&file, ids, tid, 3);
+          dmlc::InputSplit::Blob blob;
+          while (reader.NextRecord(&blob)) {
+            seen.insert(std::string(static_cast<char*>(blob.dptr), blob.size));
+          }
+        }
+      }
+      EXPECT_EQ(seen.size(), static_cast<size_t>(kRecords / 2));
+      for (int i = part * kRecords / 2; i < (part + 1) * kRecords / 2; ++i) {
+        EXPECT_EQ(seen.count(records[i]), 1U);
+      }
+      if (epoch == 0) EXPECT_EQ(first, 0U);
+    }
+  }
+  std::remove(rec_path.c_str());
+  std::remove(idx_path.c_str());
+}
+
+TEST(IndexedRecordIO, DealsChunksEveryEpoch) {
+  const std::string rec_path = "indexed_recordio_shard.rec";
+  const std::string idx_path = "indexed_recordio_shard.idx";
+  const int kRecords = 100, kParts = 3, kChunk = 8;
+  {
+    std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(rec_path.c_str(), "w"));
+    std::unique_ptr<dmlc::Stream> fidx(dmlc::Stream::Create(idx_path.c_str(), "w"));
+    dmlc::RecordIOWriter writer(fo.get());
+    for (int i = 0; i < kRecords; ++i) {
+      std::ostringstream line;
+      line << i << '\t' << writer.Tell() << '\n';
+      fidx->Write(line.str().c_str(), line.str().size());
+      const std::string r = std::to_string(i);
+      writer.WriteRecord(r.data(), r.size());
+    }
+  }
+  std::vector<std::unique_ptr<mxnet::io::IndexedRecordIO> > files;
+  for (int part = 0; part < kParts; ++part) {
+    files.emplace_back(new mxnet::io::IndexedRecordIO(rec_path, idx_path, part, kParts,
+                                                      kChunk, 5));
+  }
+  mxnet::common::RANDOM_ENGINE rnd(7);
+  std::vector<std::set<size_t> > first_epoch(kParts);
+  bool moved = false;
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    std::set<size_t> all;
+    for (int part = 0; part < kParts; ++part) {
+      files[part]->BeforeFirst(&rnd);
+      std::vector<size_t> ids;
+      std::set<size_t> mine, chunks;
+      while (files[part]->NextChunk(&ids)) {
+        mxnet::io::ChunkRecordReader reader(files[part].get(), ids, 0, 1);
+        dmlc::InputSplit::Blob blob;
+        for (size_t id : ids) {
+          ASSERT_TRUE(reader.NextRecord(&blob));
+          EXPECT_EQ(std::string(static_cast<char*>(blob.dptr), blob.size), std::to_string(id));
+          mine.insert(id);
+          chunks.insert(id / kChunk);
+        }
+      }
+      EXPECT_EQ(mine.size(), files[part]->Size());
+      EXPECT_LE(mine.size() - kRecords / kParts, 1U);
+      // the part reads whole chunks of the file, but the ones at its ends
+      EXPECT_LE(chunks.size(), mine.size() / kChunk + 2);
+      for (size_t id : mine) EXPECT_TRUE(all.insert(id).second);
+      if (epoch == 0) {
+        first_epoch[part] = mine;
+      } else if (mine != first_epoch[part]) {
+        moved = true;
+      }
+    }
+    EXPECT_EQ(all.size(), static_cast<size_t>(kRecords));
+  }
+  EXPECT_TRUE(moved);
+  std::remove(rec_path.c_str());
+  std::remove(idx_path.c_str());
+}
+#endif  // _WIN32
@@ -0,0 +1,78 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file remote_recordio_test.cc
+ * \brief the records of the parts of RemoteRecordIOSplit, on a local file
+ */
+#include <gtest/gtest.h>
+#include <dmlc/io.h>
+#include <dmlc/recordio.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../../src/io/remote_recordio.h"
+
+namespace {
+
+std::vector<std::string> ReadAll(dmlc::InputSplit* split) {
+  std::vector<std::string> records;
+  dmlc::InputSplit::Blob blob;
+  while (split->NextRecord(&blob)) {
+    records.emplace_back(static_cast<char*>(blob.dptr), blob.size);
+  }
+  return records;
+}
+
+}  // namespace
+
+TEST(RemoteRecordIOSplit, ReadsTheRecordsOfInputSplit) {
+  const std::string rec_path = "remote_recordio_test.rec";
+  {
+    std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(rec_path.c_str(), "w"));
+    dmlc::RecordIOWriter writer(fo.get());
+    for (int i = 0; i < 2000; ++i) {
+      // records across the chunks, some larger than a chunk
+      std::string r(i % 97 * 131 + 1, static_cast<char>('a' + i % 26));
+      if (i % 500 == 0) r.append(200000, 'z');
+      if (i % 10 == 0) {
+        // RecordIO splits the records around its magic number
+        const uint32_t magic = dmlc::RecordIOWriter::kMagic;
+        r.insert(r.size() / 8 * 4, reinterpret_cast<const char*>(&magic), sizeof(magic));
+      }
+      writer.WriteRecord(r.data(), r.size());
+    }
+  }
+  for (unsigned num_parts : {1U, 3U, 7U}) {
+    for (unsigned part = 0; part < num_parts; ++part) {
+      std::unique_ptr<dmlc::InputSplit> expected(
+          dmlc::InputSplit::Create(rec_path.c_str(), part, num_parts, "recordio"));
+      const std::vector<std::string> records = ReadAll(expected.get());
+      mxnet::io::RemoteRecordIOSplit split(rec_path, part, num_parts, 4, 3, 0);
+      split.HintChunkSize(1 << 16);
+      EXPECT_EQ(split.GetTotalSize(), expected->GetTotalSize());
+      for (int epoch = 0; epoch < 2; ++epoch) {
+        split.BeforeFirst();
+        EXPECT_EQ(ReadAll(&split), records);
+      }
+    }
+  }
+  std::remove(rec_path.c_str());
+}
@@ -0,0 +1,195 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file kvstore_perf_test.cc
+ * \brief push, pull and round-trip bandwidth and latency of a kvstore
+ *
+ * The benchmark is configured by environment variables:
+ *  - MXNET_KVSTORE_BENCH_TYPE: the kvstore type, local by default
+ *  - MXNET_KVSTORE_BENCH_KEYS: the number of keys, 4 by default
+ *  - MXNET_KVSTORE_BENCH_SIZE: the number of values of a key, 1M by default
+ *  - MXNET_KVSTORE_BENCH_DTYPE: float32, float16 or float64
+ *  - MXNET_KVSTORE_BENCH_DEVICES: the number of devices pushing each key, 2 by default
+ *  - MXNET_KVSTORE_BENCH_GPU: push from the gpus rather than the cpu
+ *  - MXNET_KVSTORE_BENCH_ITERS: the number of timed iterations, 10 by default
+ *
+ * For the dist types run it with the launcher, e.g.
+ * \code
+ * MXNET_KVSTORE_BENCH_TYPE=dist_sync tools/launch.py -n 2 \
+ *     build/tests/cpp/mxnet_test --gtest_filter=KVSTORE_PERF.*
+ * \endcode
+ * the servers and the scheduler serve until the workers are done.
+ */
+#include <gtest/gtest.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/engine.h>
+#include <mxnet/kvstore.h>
+#include <mxnet/ndarray.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "test_perf.h"
+#include "test_util.h"
+
+namespace mxnet {
+namespace test {
+namespace kvstore_perf {
+
+struct BenchConfig {
+  std::string type;
+  int num_keys;
+  size_t size;
+  int dtype;
+  int num_devices;
+  bool gpu;
+  int iters;
+
+  BenchConfig() {
+    type = dmlc::GetEnv("MXNET_KVSTORE_BENCH_TYPE", std::string("local"));
+    num_keys = dmlc::GetEnv("MXNET_KVSTORE_BENCH_KEYS", 4);
+    size = dmlc::GetEnv("MXNET_KVSTORE_BENCH_SIZE", static_cast<size_t>(1) << 20);
+    num_devices = dmlc::GetEnv("MXNET_KVSTORE_BENCH_DEVICES", 2);
+    gpu = dmlc::GetEnv("MXNET_KVSTORE_BENCH_GPU", false) && unitTestsWithCuda;
+    iters = dmlc::GetEnv("MXNET_KVSTORE_BENCH_ITERS", 10);
+    const std::string name = dmlc::GetEnv("MXNET_KVSTORE_BENCH_DTYPE", std::string("float32"));
+    if (name == "float32") {
+      dtype = mshadow::kFloat32;
+    } else if (name == "float16") {
+      dtype = mshadow::kFloat16;
+    } else if (name == "float64") {
+      dtype = mshadow::kFloat64;
+    } else {
+      LOG(FATAL) << "Unknown MXNET_KVSTORE_BENCH_DTYPE " << name;
+    }
+    CHECK_GT(num_keys, 0);
+    CHECK_GT(num_devices, 0);
+    CHECK_GT(iters, 0);
+  }
+
+  size_t bytes_per_key() const {
+    return size * mshadow::mshadow_sizeof(dtype);
+  }
+};
+
+/*! \brief the microseconds of each iteration of a phase */
+class Latencies {
+ public:
+  explicit Latencies(const std::string& name) : name_(name) {}
+
+  void Add(uint64_t micros) { micros_.push_back(micros); }
+
+  /*! \brief print the bandwidth of bytes moved per iteration and the percentiles */
+  void Print(size_t bytes) {
+    std::sort(micros_.begin(), micros_.end());
+    uint64_t total = 0;
+    for (uint64_t m : micros_) total += m;
+    const double mean = static_cast<double>(total) / micros_.size();
+    std::cout << std::setw(10) << name_ << std::fixed << std::setprecision(3)
+              << "  bandwidth " << bytes / std::max(mean, 1.0) / 1e3 << " GB/s"
+              << "  latency p50 " << MICRO2MSF(Percentile(50)) << " ms"
+              << "  p90 " << MICRO2MSF(Percentile(90)) << " ms"
+              << "  p99 " << MICRO2MSF(Percentile(99)) << " ms"
+              << "  max " << MICRO2MSF(micros_.back()) << " ms" << std::endl;
+  }
+
+ private:
+  uint64_t Percentile(int p) const {
+    const size_t i = (micros_.size() - 1) * p / 100;
+    return micros_[i];
+  }
+
+  std::string name_;
+  std::vector<uint64_t> micros_;
+};
+
+/*! \brief the time of fn, after all the operations it pushed to the engine are done */
+template<typename F>
+inline uint64_t Time(F fn) {
+  const uint64_t start = perf::getMicroTickCount();
+  fn();
+  Engine::Get()->WaitForAll();
+  return perf::getMicroTickCount() - start;
+}
+
+inline void RunBenchmark(const BenchConfig& cfg) {
+  std::unique_ptr<KVStore> kv(KVStore::Create(cfg.type.c_str()));
+  if (KVStore::IsServerNode() || KVStore::IsSchedulerNode()) {
+    kv->RunServer([](int, const std::string&) {});
+    return;
+  }
+  const TShape shape = mshadow::Shape1(cfg.size);
+  std::vector<int> keys(cfg.num_keys);
+  std::vector<NDArray> init;
+  for (int k = 0; k < cfg.num_keys; ++k) {
+    keys[k] = k;
+    NDArray a(shape, Context::CPU(), false, cfg.dtype);
+    a = 0.0f;
+    init.push_back(a);
+  }
+  kv->Init(keys, init);
+
+  // every key is pushed from and pulled into each device
+  std::vector<int> dev_keys;
+  std::vector<NDArray> grads, weights;
+  std::vector<NDArray*> outs;
+  for (int k = 0; k < cfg.num_keys; ++k) {
+    for (int d = 0; d < cfg.num_devices; ++d) {
+      const Context ctx = cfg.gpu ? Context::GPU(d) : Context::CPU(d);
+      NDArray g(shape, ctx, false, cfg.dtype), w(shape, ctx, false, cfg.dtype);
+      g = 1.0f;
+      dev_keys.push_back(k);
+      grads.push_back(g);
+      weights.push_back(w);
+    }
+  }
+  for (auto& w : weights) outs.push_back(&w);
+
+  std::cout << "kvstore " << cfg.type << " rank " << kv->get_rank() << "/"
+            << kv->get_group_size() << ": " << cfg.num_keys << " keys of "
+            << cfg.bytes_per_key() << " bytes from " << cfg.num_devices
+            << (cfg.gpu ? " gpus" : " cpus") << std::endl;
+  // warm up the buffers of the kvstore and the memory pools
+  Time([&]() { kv->Push(dev_keys, grads, 0); kv->Pull(dev_keys, outs, 0); });
+  kv->Barrier();
+
+  Latencies push("push"), pull("pull"), round_trip("round-trip");
+  for (int i = 0; i < cfg.iters; ++i) {
+    push.Add(Time([&]() { kv->Push(dev_keys, grads, 0); }));
+    pull.Add(Time([&]() { kv->Pull(dev_keys, outs, 0); }));
+    round_trip.Add(Time([&]() { kv->Push(dev_keys, grads, 0); kv->Pull(dev_keys, outs, 0); }));
+  }
+  kv->Barrier();
+  const size_t bytes = cfg.bytes_per_key() * cfg.num_keys * cfg.num_devices;
+  push.Print(bytes);
+  pull.Print(bytes);
+  round_trip.Print(2 * bytes);
+}
+
+}  // namespace kvstore_perf
+}  // namespace test
+}  // namespace mxnet
+
+TEST(KVSTORE_PERF, PushPull) {
+  mxnet::test::kvstore_perf::RunBenchmark(mxnet::test::kvstore_perf::BenchConfig());
+}
@@ -0,0 +1,66 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  \file kernel_launch_test.cc
+ *  \brief Test the OpenMP split of the cpu kernels
+ */
+#include <vector>
+#include "gtest/gtest.h"
+#include "operator/mxnet_op.h"
+
+namespace mxnet {
+namespace op {
+namespace mxnet_op {
+
+struct count_visits {
+  MSHADOW_XINLINE static void Map(int i, int* visits) {
+    ++visits[i];
+  }
+};
+
+struct count_visits_fine {
+  static const int kCPUGrain = 16;
+  MSHADOW_XINLINE static void Map(int i, int* visits) {
+    ++visits[i];
+  }
+};
+
+TEST(KernelLaunch, VisitsEveryIndexOnce) {
+  for (int n : {0, 1, 100, 8191, 8192, 100003}) {
+    std::vector<int> visits(n, 0), fine(n, 0);
+    Kernel<count_visits, cpu>::Launch(nullptr, n, visits.data());
+    Kernel<count_visits_fine, cpu>::Launch(nullptr, n, fine.data());
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(visits[i], 1);
+      EXPECT_EQ(fine[i], 1);
+    }
+  }
+}
+
+TEST(KernelLaunch, NumThreads) {
+  EXPECT_EQ(KernelGrain<count_visits_fine>::Get(), 16);
+  EXPECT_EQ(KernelNumThreads(31, 16), 1);
+  EXPECT_LE(KernelNumThreads(1 << 20, 16), omp_get_max_threads());
+  EXPECT_GE(KernelNumThreads(1 << 20, 16), 1);
+}
+
+}  // namespace mxnet_op
+}  // namespace op
+}  // namespace mxnet
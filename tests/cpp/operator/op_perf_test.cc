@@ -0,0 +1,267 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file op_perf_test.cc
+ * \brief forward and backward time of the registered operators
+ *
+ * Each operator is bound as a symbol on the shape given to its first input, the
+ * other inputs being inferred, and timed on the cpu and, when there is one, on
+ * the gpu. The benchmark is configured by environment variables:
+ *  - MXNET_OP_BENCH_OPS: the operators separated by ';', each with its parameters
+ *    as in "Convolution:kernel=(3,3):num_filter=64"; "all" for every registered
+ *    operator whose inputs can be inferred from the first one, "relu;sigmoid;
+ *    elemwise_add;FullyConnected:num_hidden=1024" by default
+ *  - MXNET_OP_BENCH_SHAPE: the shape of the first input, (64,1024) by default
+ *  - MXNET_OP_BENCH_DTYPE: float32, float16 or float64
+ *  - MXNET_OP_BENCH_ITERS: the number of timed iterations, 10 by default
+ *  - MXNET_OP_BENCH_OUTPUT: a file the results are written to in JSON, to compare
+ *    them across commits
+ * \code
+ * MXNET_OP_BENCH_OPS=all MXNET_OP_BENCH_OUTPUT=ops.json \
+ *     build/tests/cpp/mxnet_test --gtest_filter=OP_PERF.*
+ * \endcode
+ */
+#include <gtest/gtest.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/c_api.h>
+#include <mxnet/engine.h>
+#include <mxnet/executor.h>
+#include <mxnet/ndarray.h>
+#include <nnvm/op_attr_types.h>
+#include <nnvm/symbolic.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "test_perf.h"
+#include "test_util.h"
+
+namespace mxnet {
+namespace test {
+namespace op_perf {
+
+/*! \brief an operator to time, with its parameters */
+struct OpConfig {
+  std::string name;
+  std::unordered_map<std::string, std::string> params;
+};
+
+struct BenchConfig {
+  std::vector<OpConfig> ops;
+  /*! \brief whether ops are all the registered operators */
+  bool all;
+  TShape shape;
+  int dtype;
+  std::string dtype_name;
+  int iters;
+  std::string output;
+
+  BenchConfig() {
+    const std::string ops_str = dmlc::GetEnv("MXNET_OP_BENCH_OPS", std::string(
+        "relu;sigmoid;elemwise_add;FullyConnected:num_hidden=1024"));
+    std::istringstream shape_is(dmlc::GetEnv("MXNET_OP_BENCH_SHAPE", std::string("(64,1024)")));
+    shape_is >> shape;
+    CHECK(!shape_is.fail() && shape.ndim() > 0) << "Bad MXNET_OP_BENCH_SHAPE";
+    dtype_name = dmlc::GetEnv("MXNET_OP_BENCH_DTYPE", std::string("float32"));
+    if (dtype_name == "float32") {
+      dtype = mshadow::kFloat32;
+    } else if (dtype_name == "float16") {
+      dtype = mshadow::kFloat16;
+    } else if (dtype_name == "float64") {
+      dtype = mshadow::kFloat64;
+    } else {
+      LOG(FATAL) << "Unknown MXNET_OP_BENCH_DTYPE " << dtype_name;
+    }
+    iters = dmlc::GetEnv("MXNET_OP_BENCH_ITERS", 10);
+    CHECK_GT(iters, 0);
+    output = dmlc::GetEnv("MXNET_OP_BENCH_OUTPUT", std::string());
+
+    all = ops_str == "all";
+    if (all) {
+      // listing the names also registers the legacy operators
+      mx_uint num_ops;
+      const char **names;
+      CHECK_EQ(MXListAllOpNames(&num_ops, &names), 0);
+      static auto& is_backward = nnvm::Op::GetAttr<nnvm::TIsBackward>("TIsBackward");
+      for (mx_uint i = 0; i < num_ops; ++i) {
+        const nnvm::Op *op = nnvm::Op::Get(names[i]);
+        if (names[i][0] == '_' || is_backward.get(op, false)) continue;
+        ops.push_back(OpConfig{names[i], {}});
+      }
+      std::sort(ops.begin(), ops.end(),
+                [](const OpConfig& a, const OpConfig& b) { return a.name < b.name; });
+      return;
+    }
+    std::istringstream ops_is(ops_str);
+    std::string item;
+    while (std::getline(ops_is, item, ';')) {
+      if (item.empty()) continue;
+      std::istringstream item_is(item);
+      OpConfig op;
+      std::getline(item_is, op.name, ':');
+      std::string kv;
+      while (std::getline(item_is, kv, ':')) {
+        const size_t pos = kv.find('=');
+        CHECK_NE(pos, std::string::npos) << "Bad parameter " << kv << " of " << op.name;
+        op.params[kv.substr(0, pos)] = kv.substr(pos + 1);
+      }
+      ops.push_back(op);
+    }
+  }
+};
+
+/*! \brief the timing of an operator on a device */
+struct Result {
+  std::string op;
+  std::string ctx;
+  /*! \brief median microseconds of an iteration, -1 when not run */
+  double forward_us = -1, backward_us = -1;
+};
+
+/*! \brief the time of fn, after all the operations it pushed to the engine are done */
+template<typename F>
+inline uint64_t Time(F fn) {
+  const uint64_t start = perf::getMicroTickCount();
+  fn();
+  Engine::Get()->WaitForAll();
+  return perf::getMicroTickCount() - start;
+}
+
+inline double Median(std::vector<uint64_t> micros) {
+  std::sort(micros.begin(), micros.end());
+  return static_cast<double>(micros[micros.size() / 2]);
+}
+
+/*!
+ * \brief bind op on ctx and time it
+ * \return false when op cannot be bound on this shape, e.g. as it needs parameters
+ */
+inline bool RunOp(const BenchConfig& cfg, const OpConfig& opc, const Context& ctx,
+                  Result *res) {
+  static auto& fgradient = nnvm::Op::GetAttr<nnvm::FGradient>("FGradient");
+  std::unique_ptr<Executor> exec;
+  std::vector<NDArray> in_args, arg_grads, aux_states;
+  try {
+    const nnvm::Op *op = nnvm::Op::Get(opc.name);
+    nnvm::Symbol s = nnvm::Symbol::CreateFunctor(op, opc.params);
+    s.Compose(nnvm::array_view<const nnvm::Symbol*>(),
+              std::unordered_map<std::string, const nnvm::Symbol*>(), opc.name);
+    const auto arg_names = s.ListInputNames(nnvm::Symbol::kReadOnlyArgs);
+    const auto aux_names = s.ListInputNames(nnvm::Symbol::kAuxiliaryStates);
+    if (arg_names.empty()) return false;
+    std::unordered_map<std::string, TShape> arg_shapes{{arg_names[0], cfg.shape}};
+    std::unordered_map<std::string, int> arg_dtypes;
+    for (const auto& name : arg_names) arg_dtypes[name] = cfg.dtype;
+    const OpReqType req = fgradient.count(op) ? kWriteTo : kNullOp;
+    exec.reset(Executor::SimpleBind(
+        s, ctx, std::map<std::string, Context>(),
+        std::vector<Context>(arg_names.size(), ctx),
+        std::vector<Context>(arg_names.size(), ctx),
+        std::vector<Context>(aux_names.size(), ctx),
+        arg_shapes, arg_dtypes, std::vector<OpReqType>(arg_names.size(), req),
+        std::unordered_set<std::string>(), &in_args, &arg_grads, &aux_states));
+  } catch (const dmlc::Error& e) {
+    return false;
+  }
+  for (auto& arr : in_args) SampleUniform(0.1f, 1.0f, &arr);
+  std::vector<NDArray> head_grads;
+  for (const auto& out : exec->outputs()) {
+    NDArray grad(out.shape(), ctx, false, out.dtype());
+    grad = 1.0f;
+    head_grads.push_back(grad);
+  }
+  const bool backward = !arg_grads.empty() && !arg_grads[0].is_none();
+  // warm up the memory pools and the operator states
+  Time([&]() {
+    exec->Forward(backward);
+    if (backward) exec->Backward(head_grads);
+  });
+
+  std::vector<uint64_t> forward, train;
+  for (int i = 0; i < cfg.iters; ++i) {
+    forward.push_back(Time([&]() { exec->Forward(false); }));
+    if (backward) {
+      train.push_back(Time([&]() {
+        exec->Forward(true);
+        exec->Backward(head_grads);
+      }));
+    }
+  }
+  res->op = opc.name;
+  res->ctx = ctx.dev_mask() == Context::kGPU ? "gpu" : "cpu";
+  res->forward_us = Median(forward);
+  if (backward) res->backward_us = std::max(Median(train) - res->forward_us, 0.0);
+  return true;
+}
+
+inline void WriteJSON(const BenchConfig& cfg, const std::vector<Result>& results) {
+  std::ofstream os(cfg.output);
+  CHECK(os.good()) << "Cannot write " << cfg.output;
+  os << "{\n  \"shape\": \"" << cfg.shape << "\",\n  \"dtype\": \"" << cfg.dtype_name
+     << "\",\n  \"iters\": " << cfg.iters << ",\n  \"results\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    os << (i ? ",\n" : "\n") << "    {\"op\": \"" << r.op << "\", \"ctx\": \"" << r.ctx
+       << "\", \"forward_us\": " << r.forward_us << ", \"backward_us\": " << r.backward_us
+       << "}";
+  }
+  os << "\n  ]\n}\n";
+}
+
+inline void RunBenchmark(const BenchConfig& cfg) {
+  std::vector<Context> contexts{Context::CPU()};
+  if (unitTestsWithCuda) contexts.push_back(Context::GPU(0));
+  std::vector<Result> results;
+  std::cout << "operators on " << cfg.shape << " " << cfg.dtype_name
+            << ", median of " << cfg.iters << " iterations" << std::endl;
+  for (const auto& op : cfg.ops) {
+    for (const auto& ctx : contexts) {
+      Result res;
+      if (!RunOp(cfg, op, ctx, &res)) {
+        if (!cfg.all) LOG(WARNING) << "Cannot bind " << op.name << " on " << cfg.shape;
+        break;
+      }
+      std::cout << std::setw(32) << res.op << " " << res.ctx << std::fixed
+                << std::setprecision(3) << "  forward " << MICRO2MSF(res.forward_us) << " ms";
+      if (res.backward_us >= 0) {
+        std::cout << "  backward " << MICRO2MSF(res.backward_us) << " ms";
+      }
+      std::cout << std::endl;
+      results.push_back(res);
+    }
+  }
+  if (!cfg.output.empty()) WriteJSON(cfg, results);
+}
+
+}  // namespace op_perf
+}  // namespace test
+}  // namespace mxnet
+
+TEST(OP_PERF, Registry) {
+  mxnet::test::op_perf::RunBenchmark(mxnet::test::op_perf::BenchConfig());
+}
@@ -25,6 +25,7 @@
 #include <dmlc/logging.h>
 #include <mxnet/storage.h>
 #include <cstdio>
+#include <cstdint>
 #include "test_util.h"
 
 TEST(Storage, Basic_CPU) {
@@ -61,3 +62,77 @@ TEST(Storage, Basic_GPU) {
 }
 #endif  // MXNET_USE_CUDA
 
+
+#if MXNET_USE_CUDA
+TEST(Storage, Pool_Reuse_GPU) {
+  if (mxnet::test::unitTestsWithCuda) {
+    constexpr size_t kLarge = 8 << 20;
+    constexpr size_t kSmaller = 6 << 20;
+    mxnet::Context context_gpu = mxnet::Context::GPU(0);
+    auto &&storage = mxnet::Storage::Get();
+    // a freed block serves a smaller request of a different size class
+    auto &&handle = storage->Alloc(kLarge, context_gpu);
+    auto ptr = handle.dptr;
+    storage->Free(handle);
+    handle = storage->Alloc(kSmaller, context_gpu);
+    EXPECT_EQ(handle.dptr, ptr);
+    // the split tail is coalesced back, so the full size is reused as well
+    storage->Free(handle);
+    handle = storage->Alloc(kLarge, context_gpu);
+    EXPECT_EQ(handle.dptr, ptr);
+    storage->Free(handle);
+  }
+}
+#endif  // MXNET_USE_CUDA
+
+TEST(Storage, Pool_Reuse_CPU) {
+  constexpr size_t kSize = 1000;
+  auto&& storage = mxnet::Storage::Get();
+  mxnet::Context context_cpu{};
+  // requests of the same size class share pooled blocks
+  auto&& handle = storage->Alloc(kSize, context_cpu);
+  auto ptr = handle.dptr;
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % 64, 0);
+  storage->Free(handle);
+  handle = storage->Alloc(kSize + 20, context_cpu);
+  EXPECT_EQ(handle.dptr, ptr);
+  storage->Free(handle);
+}
+
+TEST(Storage, Stats_CPU) {
+  constexpr size_t kSize = 4096;
+  auto&& storage = mxnet::Storage::Get();
+  mxnet::Context context_cpu{};
+  auto before = storage->GetStats(context_cpu);
+  auto&& handle = storage->Alloc(kSize, context_cpu);
+  auto during = storage->GetStats(context_cpu);
+  EXPECT_EQ(during.num_allocs, before.num_allocs + 1);
+  EXPECT_EQ(during.bytes_in_use, before.bytes_in_use + kSize);
+  EXPECT_GE(during.peak_bytes_in_use, during.bytes_in_use);
+  EXPECT_GE(during.bytes_reserved, during.bytes_in_use);
+  storage->Free(handle);
+  auto after = storage->GetStats(context_cpu);
+  EXPECT_EQ(after.bytes_in_use, before.bytes_in_use);
+  EXPECT_GE(after.peak_bytes_in_use, during.bytes_in_use);
+}
+
+#ifndef _WIN32
+TEST(Storage, Shared_CPU) {
+  constexpr size_t kSize = 1000;
+  auto&& storage = mxnet::Storage::Get();
+  mxnet::Context context_shared = mxnet::Context::CPUShared(0);
+  auto&& handle = storage->Alloc(kSize, context_shared);
+  EXPECT_EQ(handle.ctx, context_shared);
+  EXPECT_GE(handle.shared_pid, 0);
+  EXPECT_GE(handle.shared_id, 0);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(handle.dptr) % 64, 0);
+  static_cast<char*>(handle.dptr)[kSize - 1] = 7;
+  // the attached memory outlives the handle it was shared from
+  storage->SharedIncrementRefCount(handle);
+  storage->Free(handle);
+  auto&& attached = storage->SharedAttach(handle.shared_pid, handle.shared_id);
+  EXPECT_EQ(attached.size, kSize);
+  EXPECT_EQ(static_cast<char*>(attached.dptr)[kSize - 1], 7);
+  storage->Free(attached);
+}
+#endif  // _WIN32
@@ -35,6 +35,16 @@ build/tests/cpp/engine/%.o : tests/cpp/engine/%.cc
 	$(CXX) -std=c++11 $(TEST_CFLAGS) -I$(GTEST_INC) -MM -MT tests/cpp/engine/$* $< > build/tests/cpp/engine/$*.d
 	$(CXX) -c -std=c++11 $(TEST_CFLAGS) -I$(GTEST_INC) -o build/tests/cpp/engine/$*.o $(filter %.cc %.a, $^)
 
+build/tests/cpp/io/%.o : tests/cpp/io/%.cc
+	@mkdir -p $(@D)
+	$(CXX) -std=c++11 $(TEST_CFLAGS) -I$(GTEST_INC) -MM -MT tests/cpp/io/$* $< > build/tests/cpp/io/$*.d
+	$(CXX) -c -std=c++11 $(TEST_CFLAGS) -I$(GTEST_INC) -o build/tests/cpp/io/$*.o $(filter %.cc %.a, $^)
+
+build/tests/cpp/kvstore/%.o : tests/cpp/kvstore/%.cc
+	@mkdir -p $(@D)
+	$(CXX) -std=c++11 $(TEST_CFLAGS) -I$(GTEST_INC) -MM -MT tests/cpp/kvstore/$* $< > build/tests/cpp/kvstore/$*.d
+	$(CXX) -c -std=c++11 $(TEST_CFLAGS) -I$(GTEST_INC) -o build/tests/cpp/kvstore/$*.o $(filter %.cc %.a, $^)
+
 $(TEST): $(TEST_OBJ) lib/libmxnet.so
 	$(CXX) -std=c++11 $(TEST_CFLAGS) -I$(GTEST_INC) -o $@ $^ $(TEST_LDFLAGS) -L$(GTEST_LIB) -lgtest
 
@@ -48,3 +58,5 @@ testclean:
 -include build/tests/cpp/operator/*.d
 -include build/tests/cpp/storage/*.d
 -include build/tests/cpp/engine/*.d
+-include build/tests/cpp/io/*.d
+-include build/tests/cpp/kvstore/*.d
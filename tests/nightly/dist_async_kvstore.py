@@ -0,0 +1,66 @@
+#!/usr/bin/env python
+
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+# pylint: skip-file
+import os
+import sys
+sys.path.insert(0, "../../python/")
+import mxnet as mx
+import numpy as np
+import time
+
+# setup
+keys = [3, 99]
+rate = 2
+shapes = [(2, 2), (1200, 1200)]  # the second one is bigger than BIGARRAY_BOUND
+staleness = int(os.environ.get('MXNET_KVSTORE_STALENESS', 1))
+
+kv = mx.kv.create('dist_async')
+
+# init kv
+kv.init(keys, [mx.nd.ones(s) for s in shapes])
+# init updater on servers
+kv.set_optimizer(mx.optimizer.create('test', rate))
+
+my_rank = kv.rank
+nworker = kv.num_workers
+
+def test_bounded_staleness():
+    nrepeat = 5
+    # each round adds rate * (1 + ... + nworker) once every worker has pushed
+    per_round = (nworker + 1) * nworker * rate / 2
+    for i in range(nrepeat):
+        # let the workers run at different speeds
+        time.sleep(0.1 * my_rank)
+        for k, s in zip(keys, shapes):
+            kv.push(k, mx.nd.ones(s) * (my_rank + 1))
+            val = mx.nd.zeros(s)
+            kv.pull(k, out=val)
+            # every worker has pushed at least i + 1 - staleness times
+            low = 1 + per_round * max(0, i + 1 - staleness)
+            assert val.asnumpy().min() >= low, (k, i, val.asnumpy().min(), low)
+
+    kv._barrier()
+    for k, s in zip(keys, shapes):
+        val = mx.nd.zeros(s)
+        kv.pull(k, out=val)
+        assert np.all(val.asnumpy() == 1 + per_round * nrepeat), val.asnumpy()
+
+if __name__ == "__main__":
+    test_bounded_staleness()
@@ -0,0 +1,57 @@
+#!/usr/bin/env python
+
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+
+# pylint: skip-file
+import sys
+sys.path.insert(0, "../../python/")
+import mxnet as mx
+import numpy as np
+
+# the servers run these optimizers natively, the results must match the
+# python optimizer applied to the summed gradients
+shape = (4, 5)
+big_shape = (1200, 1200)        # bigger than BIGARRAY_BOUND
+nrepeat = 3
+
+kv = mx.kv.create('dist_sync')
+my_rank = kv.rank
+nworker = kv.num_workers
+
+def check_optimizer(optimizer, keys):
+    kv.set_optimizer(optimizer)
+    updater = mx.optimizer.get_updater(optimizer)
+    for key, s in keys:
+        kv.init(key, mx.nd.ones(s))
+        expected = mx.nd.ones(s)
+        for i in range(nrepeat):
+            kv.push(key, mx.nd.ones(s) * (my_rank + 1) * (i + 1))
+            val = mx.nd.zeros(s)
+            kv.pull(key, out=val)
+            grad = mx.nd.ones(s) * nworker * (nworker + 1) / 2 * (i + 1)
+            updater(key, grad, expected)
+            assert np.allclose(val.asnumpy(), expected.asnumpy(), rtol=1e-5, atol=1e-6), \
+                (optimizer, key, i)
+
+def test_native_optimizers():
+    check_optimizer(mx.optimizer.SGD(learning_rate=0.1, momentum=0.9, wd=0.01,
+                                     rescale_grad=0.5), [(3, shape), (4, big_shape)])
+    check_optimizer(mx.optimizer.Adam(learning_rate=0.01, rescale_grad=0.5),
+                    [(5, shape), (6, big_shape)])
+
+if __name__ == "__main__":
+    test_native_optimizers()
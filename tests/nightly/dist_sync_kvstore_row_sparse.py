@@ -0,0 +1,65 @@
+#!/usr/bin/env python
+
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+
+# pylint: skip-file
+import sys
+sys.path.insert(0, "../../python/")
+import mxnet as mx
+import numpy as np
+
+# setup
+shape = (8, 3)
+big_shape = (10000, 120)        # big than BIGARRAY_BOUND
+lr = 0.5
+
+kv = mx.kv.create('dist_sync')
+
+kv.init(3, mx.nd.ones(shape))
+kv.init(99, mx.nd.ones(big_shape))
+# the rows of the weights are updated without state
+kv.set_optimizer(mx.optimizer.create('sgd', learning_rate=lr))
+
+my_rank = kv.rank
+nworker = kv.num_workers
+
+def check_rows(key, shape):
+    num_rows = shape[0]
+    # row 0 is pushed by every worker, row 1 + r by worker r only
+    rows = [0, 1 + my_rank, num_rows - 1 - my_rank]
+    # the other rows of the value are not sent
+    kv.row_sparse_push(key, mx.nd.ones(shape) * (my_rank + 1),
+                       row_ids=mx.nd.array(rows))
+
+    pulled = list(range(min(num_rows, nworker + 1)))
+    val = mx.nd.zeros(shape)
+    kv.row_sparse_pull(key, out=val, row_ids=mx.nd.array(pulled))
+    val = val.asnumpy()
+    expected = np.zeros(shape)
+    expected[0, :] = 1 - lr * nworker * (nworker + 1) / 2
+    for r in range(1, len(pulled)):
+        # row r is also the last row of a worker for a small key
+        pushes = [w for w in range(nworker) if w + 1 == r or num_rows - 1 - w == r]
+        expected[r, :] = 1 - lr * sum(w + 1 for w in pushes)
+    assert np.sum(np.abs(val - expected)) == 0, (val, expected)
+
+def test_sync_row_sparse_push_pull():
+    check_rows(3, shape)
+    check_rows(99, big_shape)
+
+if __name__ == "__main__":
+    test_sync_row_sparse_push_pull()
@@ -44,6 +44,7 @@ USE_CUDA=1
 USE_CUDA_PATH=/usr/local/cuda
 USE_CUDNN=1
 USE_DIST_KVSTORE=1
+USE_NCCL=1
 EOF
 
 juLog -name=Build -error=Error build
@@ -53,6 +54,14 @@ juLog -name=Python.Local.KVStore -error=Error python test_kvstore.py
 
 # python: distributed kvstore
 juLog -name=Python.Distributed.KVStore -error=Error ../../tools/launch.py -n 4 python dist_sync_kvstore.py
+juLog -name=Python.Distributed.KVStore.Compressed -error=Error ../../tools/launch.py -n 4 python dist_sync_kvstore_compressed.py
+juLog -name=Python.Distributed.KVStore.RowSparse -error=Error ../../tools/launch.py -n 4 python dist_sync_kvstore_row_sparse.py
+juLog -name=Python.Distributed.KVStore.NativeOptimizer -error=Error ../../tools/launch.py -n 4 python dist_sync_kvstore_native_optimizer.py
+MXNET_KVSTORE_WIRE_DTYPE=float16 juLog -name=Python.Distributed.KVStore.Float16 -error=Error ../../tools/launch.py -n 4 python dist_sync_kvstore.py
+MXNET_KVSTORE_GROUP_SIZE=2 juLog -name=Python.Distributed.KVStore.Group -error=Error ../../tools/launch.py -n 4 python dist_sync_kvstore.py
+MXNET_KVSTORE_FUSION_BOUND=100000 juLog -name=Python.Distributed.KVStore.Fusion -error=Error ../../tools/launch.py -n 4 python dist_sync_kvstore.py
+MXNET_KVSTORE_FUSION_BOUND=100000 MXNET_KVSTORE_STALENESS=1 juLog -name=Python.Distributed.KVStore.FusionStaleness -error=Error ../../tools/launch.py -n 4 python dist_async_kvstore.py
+MXNET_KVSTORE_STALENESS=1 juLog -name=Python.Distributed.KVStore.Staleness -error=Error ../../tools/launch.py -n 4 python dist_async_kvstore.py
 
 # download data
 juLog -name=DownloadData bash ./download.sh
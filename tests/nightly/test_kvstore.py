@@ -58,6 +58,7 @@ def test_kvstore(kv_type):
 test_kvstore('local_update_cpu')
 test_kvstore('local_allreduce_cpu')
 test_kvstore('local_allreduce_device')
+test_kvstore('nccl')
 
 ## group keys interface
 def test_group_kvstore(kv_type):
@@ -82,3 +83,4 @@ def test_group_kvstore(kv_type):
 test_group_kvstore('local_update_cpu')
 test_group_kvstore('local_allreduce_cpu')
 test_group_kvstore('local_allreduce_device')
+test_group_kvstore('nccl')
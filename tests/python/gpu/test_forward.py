@@ -64,5 +64,144 @@ def test_consistency(dump=False):
     if dump:
         np.savez('data/inception-v3-dump.npz', **{n: a.asnumpy() for n, a in gt.items()})
 
+def test_multi_stream_segment():
+    # independent branches of a bulk segment run on several streams
+    data = mx.sym.Variable('data')
+    branches = []
+    for i in range(4):
+        conv = mx.sym.Convolution(data, kernel=(3, 3), pad=(1, 1), num_filter=8,
+                                  name='conv%d' % i)
+        branches.append(mx.sym.Activation(conv, act_type='relu'))
+    net = mx.sym.Concat(*branches)
+    shape = (4, 3, 16, 16)
+    args = {'data': mx.nd.array(np.random.uniform(-1, 1, shape))}
+    for i in range(4):
+        args['conv%d_weight' % i] = mx.nd.array(np.random.uniform(-1, 1, (8, 3, 3, 3)))
+        args['conv%d_bias' % i] = mx.nd.array(np.random.uniform(-1, 1, (8,)))
+    outputs = []
+    for num_streams in ['1', '4']:
+        os.environ['MXNET_EXEC_SEGMENT_NUM_STREAMS'] = num_streams
+        exe = net.bind(mx.gpu(0), {k: v.as_in_context(mx.gpu(0)) for k, v in args.items()})
+        exe.forward(is_train=False)
+        outputs.append(exe.outputs[0].asnumpy())
+    del os.environ['MXNET_EXEC_SEGMENT_NUM_STREAMS']
+    assert_almost_equal(outputs[0], outputs[1], rtol=1e-5, atol=1e-6)
+
+def test_cuda_graph_segment():
+    # later runs of a bulk segment replay the captured CUDA graph
+    data = mx.sym.Variable('data')
+    net = mx.sym.FullyConnected(data, num_hidden=16, name='fc1')
+    net = mx.sym.Activation(net, act_type='tanh')
+    net = mx.sym.FullyConnected(net, num_hidden=4, name='fc2')
+    shape = (2, 8)
+    os.environ['MXNET_EXEC_ENABLE_CUDA_GRAPH'] = '1'
+    exe = net.simple_bind(mx.gpu(0), data=shape, grad_req='null')
+    del os.environ['MXNET_EXEC_ENABLE_CUDA_GRAPH']
+    for name, arr in exe.arg_dict.items():
+        arr[:] = np.random.uniform(-1, 1, arr.shape)
+    for _ in range(4):
+        x = np.random.uniform(-1, 1, shape)
+        exe.forward(is_train=False, data=x)
+        w1, b1 = exe.arg_dict['fc1_weight'].asnumpy(), exe.arg_dict['fc1_bias'].asnumpy()
+        w2, b2 = exe.arg_dict['fc2_weight'].asnumpy(), exe.arg_dict['fc2_bias'].asnumpy()
+        expected = np.tanh(x.dot(w1.T) + b1).dot(w2.T) + b2
+        assert_almost_equal(exe.outputs[0].asnumpy(), expected, rtol=1e-4, atol=1e-5)
+
+def test_activation_offload():
+    # the activations copied to the host and back give the same gradients
+    data = mx.sym.Variable('data')
+    net = data
+    for i in range(4):
+        net = mx.sym.FullyConnected(net, num_hidden=64, name='fc%d' % i)
+        net = mx.sym.Activation(net, act_type='tanh')
+    shape = (16, 32)
+    args = {}
+    results = []
+    os.environ['MXNET_BACKWARD_OFFLOAD_MIN_KB'] = '0'
+    os.environ['MXNET_BACKWARD_OFFLOAD_PREFETCH'] = '1'
+    for offload in ['0', '1']:
+        os.environ['MXNET_BACKWARD_OFFLOAD'] = offload
+        exe = net.simple_bind(mx.gpu(0), data=shape)
+        for name, arr in exe.arg_dict.items():
+            if name not in args:
+                args[name] = np.random.uniform(-1, 1, arr.shape)
+            arr[:] = args[name]
+        for _ in range(2):
+            exe.forward(is_train=True)
+            exe.backward([mx.nd.ones(exe.outputs[0].shape)])
+        results.append([exe.outputs[0].asnumpy()] +
+                       [exe.grad_dict[name].asnumpy() for name in sorted(args)])
+    for name in ['MXNET_BACKWARD_OFFLOAD', 'MXNET_BACKWARD_OFFLOAD_MIN_KB',
+                 'MXNET_BACKWARD_OFFLOAD_PREFETCH']:
+        del os.environ[name]
+    for expected, actual in zip(results[0], results[1]):
+        assert_almost_equal(expected, actual, rtol=1e-4, atol=1e-5)
+
+def test_auto_mixed_precision():
+    # the convolutions run in float16 while the interface stays in float32
+    data = mx.sym.Variable('data')
+    net = mx.sym.Convolution(data, num_filter=8, kernel=(3, 3), pad=(1, 1), name='conv')
+    net = mx.sym.Activation(net, act_type='relu')
+    net = mx.sym.FullyConnected(net, num_hidden=4, name='fc')
+    net = mx.sym.SoftmaxOutput(net, name='softmax')
+    shape = (4, 3, 8, 8)
+    args = {}
+    results = []
+    for amp in ['0', '1']:
+        os.environ['MXNET_EXEC_AMP'] = amp
+        exe = net.simple_bind(mx.gpu(0), data=shape)
+        for name, arr in exe.arg_dict.items():
+            if name not in args:
+                args[name] = np.random.uniform(-1, 1, arr.shape)
+                if name == 'softmax_label':
+                    args[name] = np.random.randint(0, 4, arr.shape)
+            arr[:] = args[name]
+            assert arr.dtype == np.float32
+        exe.forward(is_train=True)
+        exe.backward()
+        assert exe.outputs[0].dtype == np.float32
+        results.append([exe.outputs[0].asnumpy()] +
+                       [exe.grad_dict[name].asnumpy() for name in ['conv_weight', 'fc_weight']])
+    del os.environ['MXNET_EXEC_AMP']
+    for expected, actual in zip(results[0], results[1]):
+        assert_almost_equal(expected, actual, rtol=5e-2, atol=5e-2)
+
+def test_nhwc_layout():
+    # the interface stays in NCHW while the convolutions run in NHWC
+    data = mx.sym.Variable('data')
+    net = mx.sym.Convolution(data, num_filter=8, kernel=(3, 3), pad=(1, 1), name='conv1')
+    net = mx.sym.BatchNorm(net, fix_gamma=False, name='bn')
+    net = mx.sym.Activation(net, act_type='relu')
+    net = mx.sym.Pooling(net, kernel=(2, 2), stride=(2, 2), pool_type='max')
+    net = net + mx.sym.Convolution(net, num_filter=8, kernel=(1, 1), name='conv2')
+    net = mx.sym.FullyConnected(net, num_hidden=4, name='fc')
+    net = mx.sym.SoftmaxOutput(net, name='softmax')
+    shape = (4, 3, 8, 8)
+    args = {}
+    results = []
+    for layout in ['', 'NHWC']:
+        os.environ['MXNET_EXEC_LAYOUT'] = layout
+        exe = net.simple_bind(mx.gpu(0), data=shape)
+        assert exe.arg_dict['conv1_weight'].shape == (8, 3, 3, 3)
+        for name, arr in exe.arg_dict.items():
+            if name not in args:
+                args[name] = np.random.uniform(-1, 1, arr.shape)
+                if name == 'softmax_label':
+                    args[name] = np.random.randint(0, 4, arr.shape)
+            arr[:] = args[name]
+        exe.forward(is_train=True)
+        exe.backward()
+        results.append([exe.outputs[0].asnumpy()] +
+                       [exe.grad_dict[name].asnumpy() for name in ['conv1_weight', 'bn_gamma',
+                                                                    'conv2_weight']])
+    del os.environ['MXNET_EXEC_LAYOUT']
+    for expected, actual in zip(results[0], results[1]):
+        assert_almost_equal(expected, actual, rtol=1e-3, atol=1e-3)
+
 if __name__ == '__main__':
+    test_nhwc_layout()
+    test_auto_mixed_precision()
+    test_activation_offload()
+    test_cuda_graph_segment()
+    test_multi_stream_segment()
     test_consistency(False)
@@ -256,6 +256,20 @@ def test_fft():
             shape = tuple(np.random.randint(1, maxdim, size=order))
             check_fft(shape)
 
+def test_fft_repeated_calls():
+    # the plans made at the first call are reused, with the sub-batches of
+    # compute_size and the remainder, for even and odd lengths
+    np.random.seed(0)
+    for dim in [6, 7]:
+        for _ in range(3):
+            data = np.random.normal(size=(10, dim)).astype(np.float32)
+            out = mx.contrib.nd.fft(mx.nd.array(data, ctx=mx.gpu(0)), compute_size=4).asnumpy()
+            expected = np.fft.fft(data, axis=-1)
+            assert_almost_equal(out[:, 0::2], expected.real, rtol=1e-3, atol=1e-4)
+            assert_almost_equal(out[:, 1::2], expected.imag, rtol=1e-3, atol=1e-4)
+            back = mx.contrib.nd.ifft(mx.nd.array(out, ctx=mx.gpu(0)), compute_size=4).asnumpy()
+            assert_almost_equal(back / dim, data, rtol=1e-3, atol=1e-4)
+
 def test_batchnorm_with_type():
   ctx_list_v1_2D = [
     {'ctx': mx.cpu(0), 'norm_data': (10, 2, 10, 10), 'type_dict': {'norm_data': np.float32}},
@@ -832,6 +846,18 @@ def test_pooling_versions():
     test_3d_pooling('sum')
 
 
+def test_pooling_nhwc():
+    data = np.random.uniform(-1, 1, (2, 3, 9, 9))
+    for pool_type in ['max', 'avg']:
+        for global_pool in [False, True]:
+            kwargs = {'kernel': (3, 3), 'stride': (2, 2), 'pad': (1, 1),
+                      'pool_type': pool_type, 'global_pool': global_pool}
+            nchw = mx.nd.Pooling(mx.nd.array(data, ctx=mx.gpu(0)), **kwargs)
+            nhwc = mx.nd.Pooling(mx.nd.array(data.transpose((0, 2, 3, 1)), ctx=mx.gpu(0)),
+                                 layout='NHWC', **kwargs)
+            assert_almost_equal(nchw.asnumpy().transpose((0, 2, 3, 1)), nhwc.asnumpy())
+
+
 def test_upsampling_with_type():
     sym = mx.sym.UpSampling(scale=2, num_filter=2, name='up', sample_type='nearest', num_args=1)
     ctx_list = [{'ctx': mx.gpu(0), 'up_arg0': (2, 2, 2, 10), 'type_dict': {'up_arg0': np.float64}},
@@ -1336,6 +1362,82 @@ def test_sequence_reverse():
     check_sequence_reverse(mx.gpu(0))
 
 
+def test_batch_dot_with_type():
+    for transpose_a in [False, True]:
+        for transpose_b in [False, True]:
+            sym = mx.sym.batch_dot(mx.sym.Variable('a'), mx.sym.Variable('b'),
+                                   transpose_a=transpose_a, transpose_b=transpose_b)
+            a_shape = (5, 16, 24) if transpose_a else (5, 24, 16)
+            b_shape = (5, 32, 16) if transpose_b else (5, 16, 32)
+            ctx_list = [{'ctx': mx.gpu(0), 'a': a_shape, 'b': b_shape,
+                         'type_dict': {'a': dtype, 'b': dtype}}
+                        for dtype in [np.float64, np.float32, np.float16]]
+            ctx_list += [{'ctx': mx.cpu(0), 'a': a_shape, 'b': b_shape,
+                          'type_dict': {'a': dtype, 'b': dtype}}
+                         for dtype in [np.float64, np.float32]]
+            check_consistency(sym, ctx_list)
+            check_consistency(sym, ctx_list, grad_req='add')
+
+def test_multibox_detection_gpu():
+    np.random.seed(1234)
+    num_batches, num_classes, num_anchors = 4, 5, 300
+    cls_prob = np.random.uniform(size=(num_batches, num_classes, num_anchors))
+    cls_prob /= cls_prob.sum(axis=1, keepdims=True)
+    loc_pred = np.random.normal(0, 0.1, (num_batches, num_anchors * 4))
+    corner = np.random.uniform(0, 0.8, (1, num_anchors, 2))
+    anchors = np.concatenate([corner, corner + np.random.uniform(0.05, 0.2, corner.shape)], axis=2)
+    for force_suppress in [False, True]:
+        for nms_topk in [-1, 50]:
+            outs = []
+            for ctx in [mx.cpu(0), mx.gpu(0)]:
+                out = mx.nd.contrib.MultiBoxDetection(mx.nd.array(cls_prob, ctx=ctx),
+                                                      mx.nd.array(loc_pred, ctx=ctx),
+                                                      mx.nd.array(anchors, ctx=ctx),
+                                                      force_suppress=force_suppress,
+                                                      nms_topk=nms_topk).asnumpy()
+                outs.append(out)
+            if nms_topk > 0:
+                # the cpu leaves the detections past the top k in their unsorted order
+                outs = [o[:, :nms_topk] for o in outs]
+            assert_almost_equal(outs[0], outs[1], rtol=1e-4, atol=1e-5)
+
+def test_image_record_iter_gpu_decode():
+    from common import get_data
+    get_data.GetCifar10()
+    kwargs = dict(path_imgrec="data/cifar/train.rec", data_shape=(3, 28, 28),
+                  batch_size=100, resize=30, mean_r=123, mean_g=117, mean_b=104,
+                  scale=1.0/58, shuffle=False, preprocess_threads=2)
+    try:
+        gpu_iter = mx.io.ImageRecordIter(gpu_decode=0, **kwargs)
+    except mx.base.MXNetError:
+        # built without nvJPEG
+        return
+    cpu_iter = mx.io.ImageRecordIter(**kwargs)
+    for _ in range(5):
+        cpu_batch, gpu_batch = cpu_iter.next(), gpu_iter.next()
+        assert gpu_batch.data[0].context == mx.gpu(0)
+        assert_almost_equal(cpu_batch.label[0].asnumpy(), gpu_batch.label[0].asnumpy())
+        # the jpeg decoders and the resizes round differently
+        diff = np.abs(cpu_batch.data[0].asnumpy() - gpu_batch.data[0].asnumpy())
+        assert diff.mean() < 0.05, diff.mean()
+
+def test_prefetcher_copy_to_gpu():
+    data = np.arange(60, dtype=np.float32).reshape((20, 3))
+    np.savetxt('copy_to_gpu.csv', data, delimiter=',')
+    kwargs = dict(data_csv='copy_to_gpu.csv', data_shape=(3,), batch_size=4)
+    cpu_iter = mx.io.CSVIter(**kwargs)
+    gpu_iter = mx.io.CSVIter(copy_to_gpu=0, **kwargs)
+    for epoch in range(2):
+        cpu_iter.reset()
+        gpu_iter.reset()
+        nbatch = 0
+        for cpu_batch, gpu_batch in zip(cpu_iter, gpu_iter):
+            assert gpu_batch.data[0].context == mx.gpu(0)
+            assert_almost_equal(cpu_batch.data[0].asnumpy(), gpu_batch.data[0].asnumpy())
+            nbatch += 1
+        assert nbatch == 5
+    os.remove('copy_to_gpu.csv')
+
 if __name__ == '__main__':
     import nose
     nose.runmodule()
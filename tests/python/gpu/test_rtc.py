@@ -20,7 +20,21 @@ import mxnet as mx
 import numpy as np
 from numpy.testing import assert_allclose
 
+def test_fused_elemwise():
+    # chains of elementwise ops in a bulk segment are compiled into one kernel
+    shape = (30, 1000)
+    x = mx.sym.Variable('x')
+    y = mx.sym.Variable('y')
+    z = mx.sym.sigmoid(mx.sym.relu(x) * 2 + y) - 1
+    xnp = np.random.uniform(-1, 1, shape).astype(np.float32)
+    ynp = np.random.uniform(-1, 1, shape).astype(np.float32)
+    exe = z.simple_bind(mx.gpu(0), x=shape, y=shape, grad_req='null')
+    exe.forward(is_train=False, x=xnp, y=ynp)
+    expected = 1 / (1 + np.exp(-(np.maximum(xnp, 0) * 2 + ynp))) - 1
+    assert_allclose(exe.outputs[0].asnumpy(), expected, rtol=1e-5, atol=1e-6)
+
 if __name__ == '__main__':
+    test_fused_elemwise()
     x = mx.nd.zeros((10,), ctx=mx.gpu(0))
     x[:] = 1
     y = mx.nd.zeros((10,), ctx=mx.gpu(0))
@@ -359,6 +359,40 @@ def test_get_symbol():
     assert len(get_symbol(y).list_arguments()) == 2
 
 
+def test_saved_arrays():
+    # the gradients read the inputs (mul), the outputs (sigmoid, exp) or
+    # neither (add) of their operators, whose other arrays are not kept
+    x = mx.nd.array(np.random.uniform(-1, 1, (3, 4)))
+    w = mx.nd.array(np.random.uniform(-1, 1, (3, 4)))
+    data = mx.nd.array(np.random.uniform(-1, 1, (2, 3, 5, 5)))
+    weight = mx.nd.array(np.random.uniform(-1, 1, (4, 3, 3, 3)))
+    x.attach_grad()
+    w.attach_grad()
+    data.attach_grad()
+    xn, wn = x.asnumpy(), w.asnumpy()
+    s = 1 / (1 + np.exp(-(xn * wn + 1)))
+    e = np.exp(s)
+    expected_dx = e * s * (1 - s) * wn
+    expected_dw = e * s * (1 - s) * xn
+    # the backward passes reuse the memory of the previous ones
+    for _ in range(3):
+        with record():
+            y = mx.nd.exp(mx.nd.sigmoid(x * w + 1))
+            z = mx.nd.Convolution(mx.nd.relu(data), weight, kernel=(3, 3), num_filter=4,
+                                  no_bias=True)
+        backward([y, z])
+        assert_almost_equal(x.grad.asnumpy(), expected_dx, rtol=1e-4, atol=1e-5)
+        assert_almost_equal(w.grad.asnumpy(), expected_dw, rtol=1e-4, atol=1e-5)
+    sym = mx.sym.Convolution(mx.sym.relu(mx.sym.Variable('data')), kernel=(3, 3),
+                             num_filter=4, no_bias=True, name='conv')
+    exe = sym.simple_bind(mx.cpu(), data=data.shape, grad_req={'data': 'write',
+                                                               'conv_weight': 'null'})
+    exe.forward(is_train=True, data=data, conv_weight=weight)
+    exe.backward([mx.nd.ones(z.shape)])
+    assert_almost_equal(data.grad.asnumpy(), exe.grad_dict['data'].asnumpy(),
+                        rtol=1e-4, atol=1e-5)
+
+
 if __name__ == "__main__":
     import nose
     nose.runmodule()
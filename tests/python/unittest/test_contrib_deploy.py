@@ -0,0 +1,59 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+import numpy as np
+import mxnet as mx
+from mxnet.test_utils import assert_almost_equal
+
+
+def _forward(sym, arg_params, aux_params, data):
+    exe = sym.simple_bind(mx.cpu(), data=data.shape, grad_req='null')
+    for name, arr in exe.arg_dict.items():
+        if name != 'data':
+            arr[:] = arg_params[name]
+    for name, arr in exe.aux_dict.items():
+        arr[:] = aux_params[name]
+    exe.forward(is_train=False, data=data)
+    return exe.outputs[0].asnumpy()
+
+
+def test_fold_batchnorm():
+    data = mx.sym.Variable('data')
+    net = mx.sym.Convolution(data, num_filter=4, kernel=(3, 3), pad=(1, 1),
+                             no_bias=True, name='conv')
+    net = mx.sym.BatchNorm(net, fix_gamma=False, eps=1e-5, name='bn1')
+    net = mx.sym.Activation(net, act_type='relu')
+    net = mx.sym.FullyConnected(net, num_hidden=3, name='fc')
+    net = mx.sym.BatchNorm(net, name='bn2')
+    shape = (2, 3, 5, 5)
+    arg_shapes, _, aux_shapes = net.infer_shape(data=shape)
+    arg_params = {name: mx.nd.array(np.random.uniform(-1, 1, s))
+                  for name, s in zip(net.list_arguments(), arg_shapes) if name != 'data'}
+    aux_params = {name: mx.nd.array(np.random.uniform(0.5, 1, s))
+                  for name, s in zip(net.list_auxiliary_states(), aux_shapes)}
+    folded, new_args, new_aux = mx.contrib.deploy.fold_batchnorm(net, arg_params, aux_params)
+    assert 'bn1_gamma' not in folded.list_arguments()
+    assert 'conv_bias' in folded.list_arguments()
+    assert len(folded.list_auxiliary_states()) == 0
+    x = np.random.uniform(-1, 1, shape)
+    assert_almost_equal(_forward(net, arg_params, aux_params, x),
+                        _forward(folded, new_args, new_aux, x), rtol=1e-4, atol=1e-5)
+
+
+if __name__ == '__main__':
+    import nose
+    nose.runmodule()
@@ -0,0 +1,60 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+import json
+import numpy as np
+import mxnet as mx
+
+
+def _forward(sym, arg_params, data):
+    exe = sym.simple_bind(mx.cpu(), data=data.shape, grad_req='null')
+    for name, arr in exe.arg_dict.items():
+        if name != 'data':
+            arr[:] = arg_params[name]
+    exe.forward(is_train=False, data=data)
+    return exe.outputs[0].asnumpy()
+
+
+def test_quantize_model():
+    data = mx.sym.Variable('data')
+    net = mx.sym.FullyConnected(data, num_hidden=32, name='fc1')
+    net = mx.sym.Activation(net, act_type='relu')
+    net = mx.sym.FullyConnected(net, num_hidden=10, no_bias=True, name='fc2')
+    shapes, _, _ = net.infer_shape(data=(8, 20))
+    arg_params = {name: mx.nd.array(np.random.uniform(-1, 1, size=shape))
+                  for name, shape in zip(net.list_arguments(), shapes) if name != 'data'}
+    x = np.random.uniform(0, 1, size=(64, 20))
+    calib = mx.io.NDArrayIter(x, batch_size=8)
+
+    qnet, qarg_params, _ = mx.contrib.quantization.quantize_model(
+        net, arg_params, {}, calib, num_batches=4)
+    ops = [node['op'] for node in json.loads(qnet.tojson())['nodes']]
+    assert ops.count('_contrib_quantized_fully_connected') == 2
+    assert 'FullyConnected' not in ops
+    assert qarg_params['fc1_weight_quantized'].dtype == np.uint8
+    assert 'fc1_weight' not in qarg_params
+    assert qnet.list_outputs() == net.list_outputs()
+
+    batch = mx.nd.array(x[:8])
+    expected = _forward(net, arg_params, batch)
+    out = _forward(qnet, qarg_params, batch)
+    assert np.abs(out - expected).max() < 0.05 * np.abs(expected).max()
+
+
+if __name__ == '__main__':
+    import nose
+    nose.runmodule()
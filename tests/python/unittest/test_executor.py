@@ -15,6 +15,7 @@
 # specific language governing permissions and limitations
 # under the License.
 
+import os
 import numpy as np
 import mxnet as mx
 
@@ -152,8 +153,206 @@ def test_reshape():
     # test base exec forward
     exe.forward(is_train=False)
     assert np.all(exe.outputs[0].asnumpy() == 4)
+    # the executor of a shape is cached
+    assert exe.reshape(x=(3,4)) is new_exe
+    other_exe = exe.reshape(x=(2,4))
+    assert other_exe is not new_exe
+    other_exe.forward(is_train=False)
+    assert np.all(other_exe.outputs[0].asnumpy() == 4)
+
+def test_elemwise_chain():
+    # chains of elementwise ops in a bulk segment are fused and run chunk by chunk
+    shape = (300, 1000)
+    x = mx.sym.Variable('x')
+    y = mx.sym.Variable('y')
+    z = mx.sym.sigmoid(mx.sym.relu(x) * 2 + y) - 1
+    xnp = np.random.uniform(-1, 1, shape)
+    ynp = np.random.uniform(-1, 1, shape)
+    s = 1 / (1 + np.exp(-(np.maximum(xnp, 0) * 2 + ynp)))
+    exe = z.simple_bind(mx.cpu(), x=shape, y=shape)
+    exe.arg_dict['x'][:] = xnp
+    exe.arg_dict['y'][:] = ynp
+    exe.forward(is_train=False)
+    assert reldiff(exe.outputs[0].asnumpy(), s - 1) < 1e-5
+    exe.forward(is_train=True)
+    exe.backward([mx.nd.ones(shape)])
+    assert reldiff(exe.outputs[0].asnumpy(), s - 1) < 1e-5
+    ds = s * (1 - s)
+    assert reldiff(exe.grad_dict['x'].asnumpy(), ds * 2 * (xnp > 0)) < 1e-5
+    assert reldiff(exe.grad_dict['y'].asnumpy(), ds) < 1e-5
+
+def test_conditional_chain():
+    # clip and where, with a condition of one element, join the fused chains
+    shape = (300, 1000)
+    x = mx.sym.Variable('x')
+    c = mx.sym.Variable('c')
+    y = mx.sym.clip(x * 3 + 1, a_min=-1, a_max=2)
+    z = mx.sym.where(c, y, x * 2)
+    xnp = np.random.uniform(-1, 1, shape)
+    for cond in [0, 1]:
+        exe = z.simple_bind(mx.cpu(), x=shape, c=(1,))
+        exe.arg_dict['x'][:] = xnp
+        exe.arg_dict['c'][:] = cond
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.ones(shape)])
+        clipped = np.clip(xnp * 3 + 1, -1, 2)
+        inside = ((xnp * 3 + 1 > -1) & (xnp * 3 + 1 < 2)) * 3
+        assert reldiff(exe.outputs[0].asnumpy(), clipped if cond else xnp * 2) < 1e-5
+        assert reldiff(exe.grad_dict['x'].asnumpy(), inside if cond else 2 * np.ones(shape)) < 1e-5
+
+def test_memory_arena():
+    # the internal arrays packed into an arena give the same results
+    data = mx.sym.Variable('data')
+    net = mx.sym.FullyConnected(data, num_hidden=32, name='fc1')
+    net = mx.sym.Activation(net, act_type='relu')
+    left = mx.sym.FullyConnected(net, num_hidden=16, name='fc2')
+    right = mx.sym.FullyConnected(net, num_hidden=16, name='fc3')
+    net = mx.sym.tanh(left) + mx.sym.sigmoid(right)
+    shape = (8, 20)
+    args = {}
+    results = []
+    for arena in ['0', '1']:
+        os.environ['MXNET_EXEC_MEMORY_ARENA'] = arena
+        exe = net.simple_bind(mx.cpu(), data=shape)
+        # share the arena with a second executor
+        exe2 = exe.reshape(data=(4, 20))
+        for name, arr in exe.arg_dict.items():
+            if name not in args:
+                args[name] = np.random.uniform(-1, 1, arr.shape)
+            arr[:] = args[name]
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.ones(exe.outputs[0].shape)])
+        results.append([exe.outputs[0].asnumpy()] +
+                       [exe.grad_dict[name].asnumpy() for name in sorted(args)])
+        exe2.forward(is_train=False)
+        exe2.outputs[0].wait_to_read()
+    del os.environ['MXNET_EXEC_MEMORY_ARENA']
+    for expected, actual in zip(results[0], results[1]):
+        assert reldiff(expected, actual) < 1e-5
+
+def test_mirror_budget():
+    # recomputing the planned nodes in the backward pass gives the same gradients
+    data = mx.sym.Variable('data')
+    net = data
+    for i in range(6):
+        net = mx.sym.FullyConnected(net, num_hidden=32, name='fc%d' % i)
+        net = mx.sym.Activation(net, act_type='tanh')
+    shape = (8, 16)
+    args = {}
+    results = []
+    for budget in ['0', '-1', '0.01']:
+        os.environ['MXNET_BACKWARD_MIRROR_BUDGET_MB'] = budget
+        exe = net.simple_bind(mx.cpu(), data=shape)
+        for name, arr in exe.arg_dict.items():
+            if name not in args:
+                args[name] = np.random.uniform(-1, 1, arr.shape)
+            arr[:] = args[name]
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.ones(exe.outputs[0].shape)])
+        results.append([exe.grad_dict[name].asnumpy() for name in sorted(args)])
+    del os.environ['MXNET_BACKWARD_MIRROR_BUDGET_MB']
+    for result in results[1:]:
+        for expected, actual in zip(results[0], result):
+            assert reldiff(expected, actual) < 1e-5
+
+def test_constant_folding():
+    # the nodes computed from constants only run at bind time
+    x = mx.sym.Variable('x')
+    scale = mx.sym.ones((2, 3)) * 2 + mx.sym.arange(3).reshape((1, 3))
+    y = mx.sym.FullyConnected(x * scale, num_hidden=2, name='fc')
+    expected_scale = 2 + np.arange(3).reshape((1, 3))
+    for folding in ['0', '1']:
+        os.environ['MXNET_EXEC_CONSTANT_FOLDING'] = folding
+        exe = y.simple_bind(mx.cpu(), x=(2, 3))
+        exe.arg_dict['fc_weight'][:] = np.random.uniform(-1, 1, (2, 3))
+        exe.arg_dict['fc_bias'][:] = 0
+        w = exe.arg_dict['fc_weight'].asnumpy()
+        for _ in range(2):
+            xnp = np.random.uniform(-1, 1, (2, 3))
+            exe.forward(is_train=True, x=xnp)
+            exe.backward([mx.nd.ones((2, 2))])
+            assert reldiff(exe.outputs[0].asnumpy(), (xnp * expected_scale).dot(w.T)) < 1e-5
+            assert reldiff(exe.grad_dict['x'].asnumpy(), np.ones((2, 2)).dot(w) * expected_scale) < 1e-5
+    del os.environ['MXNET_EXEC_CONSTANT_FOLDING']
+
+def test_inplace_concat():
+    # writing the inputs of Concat into its output, and viewing the outputs of
+    # SliceChannel in its input, give the same results as the copies
+    data = mx.sym.Variable('data')
+    parts = mx.sym.SliceChannel(data, num_outputs=2, axis=0)
+    branches = [mx.sym.FullyConnected(parts[i], num_hidden=16, name='fc%d' % i)
+                for i in range(2)]
+    net = mx.sym.Concat(*[mx.sym.Activation(b, act_type='relu') for b in branches], dim=0)
+    net = mx.sym.FullyConnected(mx.sym.tanh(net), num_hidden=8, name='out')
+    shape = (8, 20)
+    args = {}
+    results = []
+    for inplace in ['0', '1']:
+        os.environ['MXNET_EXEC_INPLACE_CONCAT'] = inplace
+        exe = net.simple_bind(mx.cpu(), data=shape)
+        for name, arr in exe.arg_dict.items():
+            if name not in args:
+                args[name] = np.random.uniform(-1, 1, arr.shape)
+            arr[:] = args[name]
+        for _ in range(2):
+            exe.forward(is_train=True)
+            exe.backward([mx.nd.ones(exe.outputs[0].shape)])
+        results.append([exe.outputs[0].asnumpy()] +
+                       [exe.grad_dict[name].asnumpy() for name in sorted(args)])
+    del os.environ['MXNET_EXEC_INPLACE_CONCAT']
+    for expected, actual in zip(results[0], results[1]):
+        assert reldiff(expected, actual) < 1e-5
+
+def test_gradient_callback():
+    x = mx.sym.Variable('x')
+    y = mx.sym.FullyConnected(x, num_hidden=3, name='fc')
+    z = mx.sym.make_loss(mx.sym.sum(y))
+    exe = z.simple_bind(mx.cpu(), x=(2, 4), grad_req={'x': 'null', 'fc_weight': 'write',
+                                                      'fc_bias': 'write'})
+    called = []
+    exe.set_gradient_callback(lambda name, grad: called.append((name, grad.shape)))
+    exe.forward(is_train=True, x=np.ones((2, 4)))
+    exe.backward()
+    assert sorted(called) == [('fc_bias', (3,)), ('fc_weight', (3, 4))], called
+    assert reldiff(exe.grad_dict['fc_bias'].asnumpy(), 2 * np.ones((3,))) < 1e-5
+
+def test_pipeline_executor():
+    data = mx.sym.Variable('data')
+    label = mx.sym.Variable('label')
+    with mx.AttrScope(ctx_group='stage1'):
+        net = mx.sym.FullyConnected(data, num_hidden=6, name='fc1')
+        net = mx.sym.Activation(net, act_type='tanh')
+    with mx.AttrScope(ctx_group='stage2'):
+        net = mx.sym.FullyConnected(net, num_hidden=2, name='fc2')
+        net = mx.sym.LinearRegressionOutput(net, label, name='out')
+    group2ctx = {'stage1': mx.cpu(1), 'stage2': mx.cpu(2)}
+    batch, shapes = 10, [('data', (10, 5)), ('label', (10, 2))]
+    inputs = [mx.nd.array(np.random.normal(size=shape)) for _, shape in shapes]
+    exe = net.simple_bind(mx.cpu(), group2ctx=group2ctx, data=(batch, 5), label=(batch, 2),
+                          grad_req={'data': 'null', 'label': 'null', 'fc1_weight': 'write',
+                                    'fc1_bias': 'write', 'fc2_weight': 'write',
+                                    'fc2_bias': 'write'})
+    params = {name: mx.nd.array(np.random.normal(size=arr.shape))
+              for name, arr in exe.arg_dict.items() if name not in ('data', 'label')}
+    exe.copy_params_from(params)
+    exe.forward(is_train=True, data=inputs[0], label=inputs[1])
+    exe.backward()
+    for num_micro_batches in [1, 3, 4]:
+        pipe = mx.executor.PipelineExecutor(net, mx.cpu(), group2ctx, shapes, num_micro_batches)
+        pipe.set_params(params)
+        for _ in range(2):
+            # the gradients of a batch do not add to the ones of the previous batch
+            pipe.forward(inputs, is_train=True)
+            pipe.backward()
+        outputs = np.concatenate([out.asnumpy() for out in pipe.outputs])
+        assert reldiff(exe.outputs[0].asnumpy(), outputs) < 1e-5
+        for name, (weight, grad) in pipe.params.items():
+            assert weight.context == exe.arg_dict[name].context
+            assert reldiff(exe.grad_dict[name].asnumpy(), grad.asnumpy()) < 1e-5
 
 if __name__ == "__main__":
+    test_memory_arena()
     test_bind(disable_bulk_exec=False)
     test_bind(disable_bulk_exec=True)
     test_reshape()
+    test_elemwise_chain()
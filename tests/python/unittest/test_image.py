@@ -52,6 +52,35 @@ def test_imdecode():
         cv_image = cv2.imread(img)
         assert_almost_equal(image.asnumpy(), cv_image)
 
+def test_imdecode_batch():
+    try:
+        import cv2
+    except ImportError:
+        return
+    sources = _get_images()
+    str_images = []
+    for img in sources:
+        with open(img, 'rb') as fp:
+            str_images.append(fp.read())
+    images = mx.image.imdecode_batch(str_images, (64, 48), to_rgb=0, top=2, left=3)
+    assert images.shape == (len(sources), 50, 67, 3)
+    for i, img in enumerate(sources):
+        cv_image = cv2.resize(cv2.imread(img), (64, 48), interpolation=1)
+        cv_image = cv2.copyMakeBorder(cv_image, 2, 0, 3, 0, cv2.BORDER_CONSTANT)
+        assert_almost_equal(images[i].asnumpy(), cv_image)
+
+def test_imresize_batch():
+    batch = mx.nd.array(np.random.randint(0, 256, (4, 20, 30, 3)), dtype=np.uint8)
+    resized = mx.image.imresize(batch, 15, 10)
+    padded = mx.image.copyMakeBorder(batch, top=1, bot=2, left=3, right=4)
+    assert resized.shape == (4, 10, 15, 3)
+    assert padded.shape == (4, 23, 37, 3)
+    for i in range(4):
+        assert_almost_equal(resized[i].asnumpy(), mx.image.imresize(batch[i], 15, 10).asnumpy())
+        assert_almost_equal(padded[i].asnumpy(),
+                            mx.image.copyMakeBorder(batch[i], top=1, bot=2, left=3,
+                                                    right=4).asnumpy())
+
 def test_scale_down():
     assert mx.image.scale_down((640, 480), (720, 120)) == (640, 106)
     assert mx.image.scale_down((360, 1000), (480, 500)) == (360, 375)
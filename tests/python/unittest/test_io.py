@@ -152,6 +152,94 @@ def test_NDArrayIter_h5py():
         else:
             assert(labelcount[i] == 100)
 
+def test_CSVIter():
+    # large enough for several threads per chunk, with labels of another row layout
+    data = np.random.uniform(-10, 10, size=(20001, 8)).astype(np.float32)
+    label = np.arange(20001, dtype=np.float32).reshape((20001, 1))
+    np.savetxt('csv_data.csv', data, delimiter=',', fmt='%.7g')
+    np.savetxt('csv_label.csv', label, delimiter=',', fmt='%d')
+    data = np.loadtxt('csv_data.csv', delimiter=',', dtype=np.float32)
+    batch_size = 64
+    for round_batch in [False, True]:
+        dataiter = mx.io.CSVIter(data_csv='csv_data.csv', data_shape=(2, 4),
+                                 label_csv='csv_label.csv', label_shape=(1,),
+                                 batch_size=batch_size, round_batch=round_batch,
+                                 preprocess_threads=4)
+        nbatch = 0
+        for batch in dataiter:
+            idx = np.arange(nbatch * batch_size, (nbatch + 1) * batch_size) % data.shape[0]
+            num = batch_size - batch.pad
+            assert batch.data[0].shape == (batch_size, 2, 4)
+            assert (batch.data[0].asnumpy()[:num].reshape((num, 8)) == data[idx[:num]]).all()
+            assert (batch.label[0].asnumpy()[:num].flatten() == label[idx[:num]].flatten()).all()
+            if round_batch:
+                assert (batch.label[0].asnumpy().flatten() == label[idx].flatten()).all()
+            nbatch += 1
+        assert nbatch == (data.shape[0] + batch_size - 1) // batch_size
+    os.remove('csv_data.csv')
+    os.remove('csv_label.csv')
+
+def test_LibSVMIter():
+    num_rows, num_cols, batch_size = 10, 5, 4
+    dense = np.zeros((num_rows, num_cols), dtype=np.float32)
+    with open('libsvm_data.t', 'w') as f:
+        for i in range(num_rows):
+            cols = np.random.choice(num_cols, np.random.randint(0, num_cols), replace=False)
+            cols.sort()
+            dense[i, cols] = np.random.randint(1, 10, size=len(cols))
+            f.write('%d %s\n' % (i, ' '.join('%d:%d' % (c, dense[i, c]) for c in cols)))
+    for round_batch in [False, True]:
+        dataiter = mx.io.LibSVMIter(data_libsvm='libsvm_data.t', data_shape=(num_cols,),
+                                    batch_size=batch_size, round_batch=round_batch)
+        nbatch = 0
+        for batch in dataiter:
+            assert batch.data[0].stype == 'csr'
+            idx = np.arange(nbatch * batch_size, (nbatch + 1) * batch_size) % num_rows
+            num = batch_size if round_batch else batch_size - batch.pad
+            assert (batch.data[0].asnumpy()[:num] == dense[idx[:num]]).all()
+            assert (batch.label[0].asnumpy()[:num] == idx[:num]).all()
+            nbatch += 1
+        assert nbatch == 3
+    os.remove('libsvm_data.t')
+
+def test_echo():
+    get_data.GetMNIST_ubyte()
+    batch_size = 100
+    dataiter = mx.io.MNISTIter(
+            image="data/train-images-idx3-ubyte",
+            label="data/train-labels-idx1-ubyte",
+            batch_size=batch_size, shuffle=1, flat=0, silent=0, seed=10,
+            echo_factor=2, echo_rand_mirror=True)
+    nbatch = 0
+    for batch in dataiter:
+        data = batch.data[0].asnumpy()
+        label = batch.label[0].asnumpy()
+        if nbatch % 2 == 0:
+            first_data, first_label = data, label
+        else:
+            # the repeat has the same images, some of them mirrored
+            assert (label == first_label).all()
+            for i in range(batch_size):
+                assert ((data[i] == first_data[i]).all() or
+                        (data[i] == first_data[i][:, :, ::-1]).all())
+        nbatch += 1
+    assert nbatch == 2 * 60000 // batch_size
+
+def test_stats():
+    num_rows, batch_size = 1000, 10
+    np.savetxt('csv_stats.csv', np.ones((num_rows, 4)), delimiter=',', fmt='%d')
+    dataiter = mx.io.CSVIter(data_csv='csv_stats.csv', data_shape=(4,), batch_size=batch_size)
+    nbatch = sum(1 for _ in dataiter)
+    stats = dataiter.stats()
+    assert stats['batches'] == nbatch == num_rows // batch_size
+    assert stats['records_decoded'] == num_rows
+    assert stats['bytes_read'] == os.path.getsize('csv_stats.csv')
+    assert stats['queue_requests'] == nbatch + 1
+    assert 0 <= stats['queue_occupancy'] <= 1
+    assert 0 <= stats['stall_fraction'] <= 1
+    del dataiter
+    os.remove('csv_stats.csv')
+
 
 if __name__ == "__main__":
     test_NDArrayIter()
@@ -159,3 +247,7 @@ if __name__ == "__main__":
         test_NDArrayIter_h5py()
     test_MNISTIter()
     test_Cifar10Rec()
+    test_CSVIter()
+    test_LibSVMIter()
+    test_echo()
+    test_stats()
@@ -110,6 +110,21 @@ def test_aggregator():
     check_aggregator(init_kv_with_str(), 'a', str_keys)
 
 
+def test_aggregator_big_array():
+    """sum arrays large enough to be reduced by several threads"""
+    num_devs = 5
+    big_shape = (1000003,)
+    for dtype in ['float32', 'float16', 'float64']:
+        kv = mx.kv.create()
+        kv.init(3, mx.nd.zeros(big_shape, dtype=dtype))
+        vals = [mx.nd.ones(big_shape, mx.Context('cpu', i), dtype=dtype) * (i + 1)
+                for i in range(num_devs)]
+        kv.push(3, vals)
+        kv.pull(3, out=vals)
+        for v in vals:
+            check_diff_to_scalar(v, num_devs * (num_devs + 1) / 2)
+
+
 def updater(key, recv, local):
     """use updater: +="""
     local += recv
@@ -153,6 +168,27 @@ def test_updater(dev = 'cpu'):
     check_updater(str_kv, 'a', str_keys)
 
 
+def test_pull_unchanged():
+    """pulls skip the arrays holding the value already, but not the written ones"""
+    kv = init_kv()
+    kv.push(3, mx.nd.ones(shape) * 2)
+    vals = [mx.nd.zeros(shape) for _ in range(2)]
+    for _ in range(2):
+        kv.pull(3, out=vals)
+        for v in vals:
+            check_diff_to_scalar(v, 2)
+    vals[0][:] = 5
+    vals[1][1:3] = 7
+    kv.pull(3, out=vals)
+    for v in vals:
+        check_diff_to_scalar(v, 2)
+    kv.push(3, mx.nd.ones(shape))
+    vals.append(mx.nd.zeros(shape))
+    kv.pull(3, out=vals)
+    for v in vals:
+        check_diff_to_scalar(v, 1)
+
+
 def test_get_type():
     kvtype = 'local_allreduce_cpu'
     kv = mx.kv.create(kvtype)
@@ -165,3 +201,4 @@ if __name__ == '__main__':
     test_list_kv_pair()
     test_aggregator()
     test_updater()
+    test_pull_unchanged()
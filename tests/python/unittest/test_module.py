@@ -21,6 +21,7 @@ import numpy as np
 from functools import reduce
 from mxnet.module.executor_group import DataParallelExecutorGroup
 from common import assertRaises
+from mxnet.test_utils import assert_almost_equal
 from collections import namedtuple
 
 
@@ -346,6 +347,32 @@ def test_monitor():
     assert(mon_result_counts == [2, 2, 1, 6, 6, 4])
 
 
+def test_monitor_tensor_stats():
+    x = mx.symbol.Variable('data')
+    x = mx.symbol.FullyConnected(name='fc', data=x, num_hidden=3)
+    x = mx.symbol.LinearRegressionOutput(data=x, name='out')
+    mon = mx.mon.Monitor(2, stat_func=mx.mon.tensor_stats, pattern='fc_output')
+    mod = mx.mod.Module(x, context=[mx.cpu()], label_names=['out_label'])
+    mod.bind([('data', (2, 4))], label_shapes=[('out_label', (2, 3))])
+    mod.install_monitor(mon)
+    mod.init_params()
+    batch = mx.io.DataBatch([mx.nd.ones((2, 4))], [mx.nd.zeros((2, 3))])
+    for i in range(4):
+        mon.tic()
+        mod.forward(batch, is_train=True)
+        res = mon.toc()
+        # only every other batch is monitored
+        assert len(res) == (1 if i % 2 == 0 else 0)
+        if res:
+            (_, name, stats), = res
+    out = mod.get_outputs()[0].asnumpy()
+    assert name == 'fc_output'
+    stats = [float(v) for v in stats.strip().strip('[]').split()]
+    assert_almost_equal(np.array(stats), np.array(
+        [np.sqrt(np.sum(out ** 2)), np.mean(out), np.max(np.abs(out)), 0, 0]),
+        rtol=1e-4, atol=1e-5)
+
+
 def test_executor_group():
     def get_rnn_sym(num_layers, num_words, num_hidden, num_embed, seq_len):
         stack = mx.rnn.SequentialRNNCell()
@@ -576,6 +603,35 @@ def test_forward_reshape():
     assert mod.get_outputs()[0].shape == (3, 5)
 
 
+def test_module_push_in_backward():
+    data = mx.sym.Variable('data')
+    net = mx.sym.FullyConnected(data, num_hidden=8, name='fc1')
+    net = mx.sym.Activation(net, act_type='relu')
+    net = mx.sym.FullyConnected(net, num_hidden=2, name='fc2')
+    net = mx.sym.SoftmaxOutput(net, name='softmax')
+    batch = mx.io.DataBatch([mx.nd.array(np.random.uniform(-1, 1, (8, 5)))],
+                            [mx.nd.array(np.random.randint(0, 2, (8,)))])
+
+    def train(push_in_backward):
+        prev = mx.test_utils.set_env_var('MXNET_KVSTORE_PUSH_IN_BACKWARD', push_in_backward, '0')
+        mod = mx.mod.Module(net, context=[mx.cpu(0), mx.cpu(1)])
+        mod.bind(data_shapes=[('data', (8, 5))], label_shapes=[('softmax_label', (8,))])
+        mx.random.seed(11)
+        mod.init_params(initializer=mx.init.Uniform(0.5))
+        mod.init_optimizer(kvstore='local', optimizer_params={'learning_rate': 0.1})
+        for _ in range(3):
+            mod.forward(batch)
+            mod.backward()
+            mod.update()
+        mx.test_utils.set_env_var('MXNET_KVSTORE_PUSH_IN_BACKWARD', prev)
+        return mod.get_params()[0]
+
+    expected = train('0')
+    result = train('1')
+    for name in expected:
+        assert_almost_equal(expected[name].asnumpy(), result[name].asnumpy())
+
+
 if __name__ == '__main__':
     import nose
     nose.runmodule()
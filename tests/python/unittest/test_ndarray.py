@@ -264,6 +264,51 @@ def test_ndarray_saveload():
         assert np.sum(single_ndarray.asnumpy() != single_ndarray_loaded.asnumpy()) == 0
     os.remove(fname)
 
+
+def test_ndarray_save_encoded():
+    np.random.seed(0)
+    fname = 'tmp_encoded.bin'
+    weight = mx.nd.array(np.random.uniform(-2, 2, (20, 30)))
+    bias = mx.nd.array(np.random.uniform(-2, 2, (30,)))
+    index = mx.nd.array(np.arange(10), dtype=np.int32)
+    data = {'weight': weight, 'bias': bias, 'index': index}
+    for encoding, rtol in [('float16', 1e-3), ('int8', 1.0 / 127)]:
+        for blocking in [True, False]:
+            mx.nd.save(fname, data, blocking=blocking, encoding=encoding)
+            mx.nd.wait_saves()
+            loaded = mx.nd.load(fname)
+            assert loaded['weight'].dtype == np.float32
+            err = np.abs(loaded['weight'].asnumpy() - weight.asnumpy()).max()
+            assert err <= rtol * np.abs(weight.asnumpy()).max()
+            if encoding == 'int8':
+                # the 1-d arrays keep their values
+                assert np.sum(loaded['bias'].asnumpy() != bias.asnumpy()) == 0
+            else:
+                assert_almost_equal(loaded['bias'].asnumpy(), bias.asnumpy(), rtol=1e-3)
+            assert loaded['index'].dtype == np.int32
+            assert np.sum(loaded['index'].asnumpy() != index.asnumpy()) == 0
+    os.remove(fname)
+
+
+def test_ndarray_save_async():
+    np.random.seed(0)
+    fnames = ['tmp_async_%d.bin' % i for i in range(3)]
+    data = [random_ndarray(np.random.randint(1, 5)) for i in range(10)]
+    expected = []
+    for fname in fnames:
+        expected.append([x.asnumpy() for x in data])
+        mx.nd.save(fname, {'x%d' % i : x for i, x in enumerate(data)}, blocking=False)
+        # the arrays change while they are written, the files hold the values of the save
+        for x in data:
+            x += 1
+    mx.nd.wait_saves()
+    for fname, values in zip(fnames, expected):
+        loaded = mx.nd.load(fname)
+        assert len(loaded) == len(values)
+        for i, v in enumerate(values):
+            assert np.sum(loaded['x%d' % i].asnumpy() != v) == 0
+        os.remove(fname)
+
 def test_ndarray_legacy_load():
     data = []
     for i in range(6):
@@ -292,6 +337,85 @@ def test_ndarray_slice():
     assert A[1,2,3,4,5].asscalar() == A2[1,2,3,4,5]
 
 
+def test_ndarray_slice_write():
+    # the writes of disjoint slices are tracked apart, and ordered with the whole
+    A = mx.nd.zeros((8, 5))
+    A2 = np.zeros((8, 5))
+    for k in range(20):
+        for i in range(4):
+            s = A[2*i:2*i+2]
+            s += i + 1
+            A2[2*i:2*i+2] += i + 1
+        A *= 0.5
+        A2 *= 0.5
+    assert same(A.asnumpy(), A2)
+    # a copy between the slices of an array is not skipped
+    A[0:4] = A[4:8]
+    A2[0:4] = A2[4:8]
+    assert same(A.asnumpy(), A2)
+    for i in range(8):
+        A[i] = i
+    assert same(A[3:5].asnumpy(), np.array([[3] * 5, [4] * 5]))
+
+
+def test_ndarray_bulk():
+    # the operations collected into bulks run in order, and a read flushes them
+    A = mx.nd.zeros((3, 4))
+    B = mx.nd.ones((3, 4))
+    A2 = np.zeros((3, 4))
+    with mx.engine.bulk(7):
+        for i in range(50):
+            A += B
+            B = B * 1.01
+            A2 += 1.01 ** i
+            if i % 17 == 0:
+                assert_almost_equal(A.asnumpy(), A2)
+        C = A[1:2]
+        C += 1
+        A2[1:2] += 1
+    assert_almost_equal(A.asnumpy(), A2)
+    assert mx.engine.set_bulk_size(0) == 0
+
+
+def test_ndarray_inline():
+    # the operations run inline see the results of the ones pushed before
+    A = mx.nd.zeros((3, 4))
+    A += 2
+    with mx.engine.inline():
+        B = A * 3
+        B += 1
+        C = mx.nd.dot(B, B.T)
+        assert_almost_equal(B.asnumpy(), np.full((3, 4), 7.0))
+        assert_almost_equal(C.asnumpy(), np.full((3, 3), 196.0))
+    assert not mx.engine.set_inline(False)
+
+
+def test_ndarray_shared_mem():
+    x = mx.nd.array(np.arange(12).reshape((3, 4)), ctx=mx.cpu_shared())
+    assert x.context == mx.cpu_shared()
+    y = mx.nd._new_from_shared_mem(*x._to_shared_mem())
+    assert y.context == mx.cpu_shared()
+    assert y.shape == x.shape and y.dtype == x.dtype
+    assert same(y.asnumpy(), x.asnumpy())
+    # the arrays share the memory
+    y[:] = 5
+    assert same(x.asnumpy(), np.full((3, 4), 5, dtype=np.float32))
+    # the memory outlives x for the handles taken before it is freed
+    handle = x._to_shared_mem()
+    del x
+    z = mx.nd._new_from_shared_mem(*handle)
+    assert same((z + 1).asnumpy(), np.full((3, 4), 6, dtype=np.float32))
+    # the arrays on cpu_shared are pickled as their handles between processes
+    try:
+        from multiprocessing.reduction import ForkingPickler
+    except ImportError:
+        return
+    w = ForkingPickler.loads(ForkingPickler.dumps(z))
+    w[:] = 7
+    assert same(y.asnumpy(), np.full((3, 4), 7, dtype=np.float32))
+    v = ForkingPickler.loads(ForkingPickler.dumps(mx.nd.ones((2,))))
+    assert v.context == mx.cpu() and same(v.asnumpy(), np.ones((2,), dtype=np.float32))
+
 
 def test_ndarray_crop():
     # get crop
@@ -684,6 +808,81 @@ def test_cached():
     op(data, weight, bias, out=o2)
     assert_almost_equal(o2.asnumpy(), o1.asnumpy()+1)
 
+def test_cached_plan():
+    data = mx.sym.Variable('data')
+    sym = mx.sym.FullyConnected(mx.sym.relu(data) * 2, num_hidden=4, name='fc')
+    op = mx.nd.CachedOp(sym)
+    weight = mx.nd.array(np.random.uniform(-1, 1, (4, 5)))
+    bias = mx.nd.array(np.random.uniform(-1, 1, (4,)))
+    def expected(x):
+        return np.dot(np.maximum(x, 0) * 2, weight.asnumpy().T) + bias.asnumpy()
+    # the plans of different shapes, and a plan run again
+    for batch in [3, 7, 3]:
+        x = np.random.uniform(-1, 1, (batch, 5))
+        o = op(mx.nd.array(x), weight, bias)
+        assert_almost_equal(o.asnumpy(), expected(x), rtol=1e-5, atol=1e-5)
+    # the outputs of a plan are not overwritten by the next call
+    x1 = np.random.uniform(-1, 1, (3, 5))
+    x2 = np.random.uniform(-1, 1, (3, 5))
+    o1 = op(mx.nd.array(x1), weight, bias)
+    o2 = op(mx.nd.array(x2), weight, bias)
+    assert_almost_equal(o1.asnumpy(), expected(x1), rtol=1e-5, atol=1e-5)
+    assert_almost_equal(o2.asnumpy(), expected(x2), rtol=1e-5, atol=1e-5)
+    # the recorded calls give the gradients of the imperative operators
+    x = mx.nd.array(x1)
+    x.attach_grad()
+    with mx.autograd.record():
+        o = op(x, weight, bias)
+    o.backward()
+    ref = mx.nd.array(x1)
+    ref.attach_grad()
+    with mx.autograd.record():
+        r = mx.nd.FullyConnected(mx.nd.relu(ref) * 2, weight, bias, num_hidden=4)
+    r.backward()
+    assert_almost_equal(o.asnumpy(), r.asnumpy(), rtol=1e-5, atol=1e-5)
+    assert_almost_equal(x.grad.asnumpy(), ref.grad.asnumpy(), rtol=1e-5, atol=1e-5)
+
+def test_imperative_op():
+    op = mx.nd.ImperativeOp('FullyConnected', 3, num_hidden=4)
+    weight = mx.nd.array(np.random.uniform(-1, 1, (4, 5)))
+    bias = mx.nd.array(np.random.uniform(-1, 1, (4,)))
+    # the inference is kept for a shape, and done again for another
+    for batch in [3, 3, 6, 3]:
+        x = mx.nd.array(np.random.uniform(-1, 1, (batch, 5)))
+        o = op(x, weight, bias)
+        r = mx.nd.FullyConnected(x, weight, bias, num_hidden=4)
+        assert o.shape == (batch, 4)
+        assert_almost_equal(o.asnumpy(), r.asnumpy(), rtol=1e-5, atol=1e-5)
+    op(x, weight, bias, out=o)
+    assert_almost_equal(o.asnumpy(), r.asnumpy(), rtol=1e-5, atol=1e-5)
+    # a given output of another shape is still checked
+    try:
+        op(x, weight, bias, out=mx.nd.zeros((3, 5)))
+        assert False
+    except mx.MXNetError:
+        pass
+    relu = mx.nd.ImperativeOp('Activation', 1, act_type='relu')
+    x = mx.nd.array([[-1, 2], [3, -4]])
+    assert same(relu(x).asnumpy(), np.array([[0, 2], [3, 0]]))
+
+def test_async_copy():
+    import ctypes
+    import threading
+    from mxnet.base import _LIB, check_call
+    x = np.random.uniform(-1, 1, (4, 5)).astype(np.float32)
+    a = mx.nd.zeros((4, 5))
+    check_call(_LIB.MXNDArrayAsyncCopyFromCPU(
+        a.handle, x.ctypes.data_as(ctypes.c_void_p), ctypes.c_size_t(x.size), None, None))
+    b = a * 2
+    out = np.zeros_like(x)
+    done = threading.Event()
+    callback = ctypes.CFUNCTYPE(None, ctypes.c_void_p)(lambda param: done.set())
+    check_call(_LIB.MXNDArrayAsyncCopyToCPU(
+        b.handle, out.ctypes.data_as(ctypes.c_void_p), ctypes.c_size_t(out.size),
+        callback, None))
+    done.wait()
+    assert_almost_equal(out, x * 2)
+
 def test_output():
     shape = (2,2)
     ones = mx.nd.ones(shape)
@@ -17,6 +17,7 @@
 
 # pylint: skip-file
 from __future__ import print_function
+import os
 import numpy as np
 import mxnet as mx
 import random
@@ -66,6 +67,8 @@ def test_elementwise_sum():
         for dim in range(1, maxdim):
             shape = tuple(np.random.randint(1, int(1000**(1.0/dim)), size=dim))
             check_elementwise_sum_with_shape(shape, np.random.randint(1, 8))
+    # more inputs than a pass of the kernel sums
+    check_elementwise_sum_with_shape((3, 700), 20)
 
 
 def check_concat_with_shape(shapes, dimension, skip_second):
@@ -282,6 +285,26 @@ def test_softmax():
     check_softmax_with_shape((3, 4), default_context(), preserve_shape=True)
     check_softmax_with_shape((3, 4, 2), default_context(), preserve_shape=True)
 
+def test_softmax_cross_entropy():
+    for shape in [(3, 5), (4, 3000)]:
+        data = np.random.uniform(-10, 10, shape)
+        data[0, 0] = 80
+        label = np.random.randint(0, shape[1], shape[0])
+        label[0] = 1
+        prob = np_softmax(data)
+        expected = -np.sum(np.log(np.maximum(prob[np.arange(shape[0]), label], 1e-8)))
+        x = mx.sym.Variable('x')
+        y = mx.sym.softmax_cross_entropy(x, mx.sym.Variable('y'))
+        grad = mx.nd.empty(shape)
+        exe = y.bind(default_context(), args={'x': mx.nd.array(data), 'y': mx.nd.array(label)},
+                     args_grad={'x': grad}, grad_req={'x': 'write', 'y': 'null'})
+        exe.forward(is_train=True)
+        assert_almost_equal(exe.outputs[0].asnumpy(), np.array([expected]), rtol=1e-4)
+        exe.backward([mx.nd.array([2])])
+        onehot = np.zeros(shape)
+        onehot[np.arange(shape[0]), label] = 1
+        assert_almost_equal(grad.asnumpy(), 2 * (prob - onehot), rtol=1e-4, atol=1e-6)
+
 def test_python_op():
     X = mx.symbol.Variable('X')
     op = mx.operator.NumpyOp()
@@ -314,6 +337,11 @@ def test_swapaxes():
 
     assert_almost_equal(out, swap_)
 
+    for shape, dim1, dim2 in [((70, 35), 0, 1), ((4, 33, 5, 41), 1, 3), ((40, 3, 50), 2, 0)]:
+        data_tmp = np.random.uniform(-1, 1, shape)
+        out = mx.nd.SwapAxis(mx.nd.array(data_tmp), dim1=dim1, dim2=dim2).asnumpy()
+        assert_almost_equal(out, np.swapaxes(data_tmp, dim1, dim2))
+
 def test_scalarop():
     data = mx.symbol.Variable('data')
     shape = (3, 4)
@@ -479,6 +507,39 @@ def test_embedding():
     exe_test.backward([grad])
     assert_almost_equal(grad_map["embed_weight"].asnumpy(), np.dot(np_onehot.T, np_grad))
 
+def test_embedding_grad_duplicates():
+    in_dim = 50
+    out_dim = 35
+    batch = 600
+    np_data = np.random.randint(low=-2, high=in_dim + 2, size=batch)
+    np_grad = np.random.uniform(-1, 1, (batch, out_dim))
+    clipped = np.clip(np_data, 0, in_dim - 1)
+    expected = np.zeros((in_dim, out_dim))
+    np.add.at(expected, clipped, np_grad)
+    data = mx.sym.Variable('data')
+    for dtype, rtol in [(np.float32, 1e-5), (np.float16, 1e-2)]:
+        for sparse_grad in [False, True]:
+            embed = mx.sym.Embedding(data=data, input_dim=in_dim, output_dim=out_dim,
+                                     dtype=dtype, sparse_grad=sparse_grad, name='embed')
+            if sparse_grad:
+                grad = mx.sparse_nd.zeros('row_sparse', (in_dim, out_dim),
+                                          ctx=default_context(), dtype=dtype)
+            else:
+                grad = mx.nd.ones((in_dim, out_dim), ctx=default_context(), dtype=dtype)
+            exe = embed.bind(default_context(),
+                             args={'data': mx.nd.array(np_data, ctx=default_context()),
+                                   'embed_weight': mx.nd.zeros((in_dim, out_dim),
+                                                               ctx=default_context(),
+                                                               dtype=dtype)},
+                             args_grad={'embed_weight': grad},
+                             grad_req={'data': 'null', 'embed_weight': 'write'})
+            exe.forward(is_train=True)
+            exe.backward([mx.nd.array(np_grad, ctx=default_context(), dtype=dtype)])
+            if sparse_grad:
+                assert_almost_equal(grad.indices.asnumpy(), np.unique(clipped))
+            assert_almost_equal(grad.asnumpy().astype(np.float32), expected,
+                                rtol=rtol, atol=rtol)
+
 # check ops handle duplicate input correctly.
 def test_binary_op_duplicate_input():
     data = mx.symbol.Variable('data')
@@ -774,6 +835,34 @@ def check_deconvolution_target_shape(input_shape, kernel, stride, pad, adj, targ
     arg_shapes, out_shapes, _ = deconv.infer_shape(data=input_shape)
     assert out_shapes[0] == (input_shape[0], 5, 8, 8)
 
+def test_deconvolution_as_convolution_gradient():
+    # several images per step, groups, adj and dilation
+    for shape, num_filter, num_group, kernel, stride, pad, adj, dilate in [
+            ((7, 4, 5, 6), 6, 2, (3, 3), (2, 2), (1, 1), (1, 0), (1, 1)),
+            ((3, 3, 4, 4), 5, 1, (4, 3), (1, 2), (0, 1), (0, 1), (1, 1)),
+            ((5, 2, 6, 5), 2, 1, (3, 3), (1, 1), (2, 2), (0, 0), (2, 2))]:
+        deconv = mx.sym.Deconvolution(data=mx.sym.Variable('x'), weight=mx.sym.Variable('w'),
+                                      num_filter=num_filter, num_group=num_group, kernel=kernel,
+                                      stride=stride, pad=pad, adj=adj, dilate=dilate, no_bias=True)
+        arg_shapes, out_shapes, _ = deconv.infer_shape(x=shape)
+        conv = mx.sym.Convolution(data=mx.sym.Variable('y'), weight=mx.sym.Variable('w'),
+                                  num_filter=shape[1], num_group=num_group, kernel=kernel,
+                                  stride=stride, pad=pad, dilate=dilate, no_bias=True)
+        x = np.random.uniform(-1, 1, shape)
+        w = np.random.uniform(-1, 1, arg_shapes[1])
+        y = np.random.uniform(-1, 1, out_shapes[0])
+        exe = conv.simple_bind(default_context(), y=out_shapes[0])
+        exe.arg_dict['y'][:] = y
+        exe.arg_dict['w'][:] = w
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.array(x)])
+        conv_out = exe.outputs[0].asnumpy()
+        # the deconvolution is the data gradient of the convolution, and the reverse
+        check_symbolic_forward(deconv, [x, w], [exe.grad_dict['y'].asnumpy()],
+                               rtol=1e-3, atol=1e-4)
+        check_symbolic_backward(deconv, [x, w], [y], [conv_out, exe.grad_dict['w'].asnumpy()],
+                                rtol=1e-3, atol=1e-4)
+
 def test_deconvolution():
     check_deconvolution_target_shape(
         input_shape         = (2,3,4,4),
@@ -854,6 +943,73 @@ def test_nearest_upsampling():
                     shapes = [(1,3,base*root_scale*scale**(num_shape-1-i),base*root_scale*scale**(num_shape-1-i)) for i in range(num_shape)]
                     check_nearest_upsampling_with_shape(shapes, scale, root_scale)
 
+def test_bilinear_upsampling():
+    # the direct kernel is the depthwise deconvolution with the same weight
+    for scale in [1, 2, 3, 4]:
+        kernel = 2 * scale - scale % 2
+        pad = int(np.ceil((scale - 1) / 2.))
+        shape = (2, 3, 5, 4)
+        x = np.random.uniform(-1, 1, shape)
+        w = np.random.uniform(-1, 1, (3, 1, kernel, kernel))
+        up = mx.sym.UpSampling(mx.sym.Variable('data'), mx.sym.Variable('weight'),
+                               sample_type='bilinear', scale=scale, num_filter=3, num_args=2)
+        deconv = mx.sym.Deconvolution(mx.sym.Variable('data'), mx.sym.Variable('weight'),
+                                      kernel=(kernel, kernel), stride=(scale, scale),
+                                      pad=(pad, pad), num_filter=3, num_group=3, no_bias=True)
+        ograd = np.random.uniform(-1, 1, (2, 3, 5 * scale, 4 * scale))
+        outs = []
+        for sym in [up, deconv]:
+            exe = sym.simple_bind(default_context(), data=shape, weight=w.shape)
+            exe.arg_dict['data'][:] = x
+            exe.arg_dict['weight'][:] = w
+            exe.forward(is_train=True)
+            exe.backward(mx.nd.array(ograd))
+            outs.append([exe.outputs[0].asnumpy(), exe.grad_dict['data'].asnumpy(),
+                         exe.grad_dict['weight'].asnumpy()])
+        for a, b in zip(outs[0], outs[1]):
+            assert_almost_equal(a, b, rtol=1e-4, atol=1e-5)
+        check_numeric_gradient(up, [x, w], numeric_eps=1e-3, rtol=1e-2, atol=1e-3)
+
+def test_resize2d():
+    def resize_np(x, oh, ow, sample_type, align_corners):
+        N, C, H, W = x.shape
+        def coords(o, size, out):
+            if sample_type == 'nearest':
+                i = min(int(o * float(size) / out), size - 1)
+                return i, i, 0.
+            if align_corners:
+                f = o * (size - 1.) / (out - 1) if out > 1 else 0.
+            else:
+                f = max((o + .5) * float(size) / out - .5, 0.)
+            i = int(f)
+            if i >= size - 1:
+                return size - 1, size - 1, 0.
+            return i, i + 1, f - i
+        out = np.zeros((N, C, oh, ow))
+        for oy in range(oh):
+            y0, y1, ly = coords(oy, H, oh)
+            for ox in range(ow):
+                x0, x1, lx = coords(ox, W, ow)
+                out[:, :, oy, ox] = (1 - ly) * ((1 - lx) * x[:, :, y0, x0] + lx * x[:, :, y0, x1]) + \
+                                    ly * ((1 - lx) * x[:, :, y1, x0] + lx * x[:, :, y1, x1])
+        return out
+
+    x = np.random.uniform(-1, 1, (2, 3, 5, 7))
+    for sample_type in ['nearest', 'bilinear']:
+        for align_corners in [False, True]:
+            for oh, ow in [(10, 14), (3, 4), (8, 1)]:
+                y = mx.nd.contrib.Resize2D(mx.nd.array(x), height=oh, width=ow,
+                                           sample_type=sample_type, align_corners=align_corners)
+                assert_almost_equal(y.asnumpy(), resize_np(x, oh, ow, sample_type, align_corners),
+                                    rtol=1e-4, atol=1e-5)
+            sym = mx.sym.contrib.Resize2D(mx.sym.Variable('data'), scale_height=1.5, scale_width=0.7,
+                                          sample_type=sample_type, align_corners=align_corners)
+            check_numeric_gradient(sym, [x], numeric_eps=1e-3, rtol=1e-2, atol=1e-3)
+    # integer scales match the nearest up sampling
+    y = mx.nd.contrib.Resize2D(mx.nd.array(x), scale_height=2, scale_width=2, sample_type='nearest')
+    z = mx.nd.UpSampling(mx.nd.array(x), scale=2, sample_type='nearest')
+    assert_almost_equal(y.asnumpy(), z.asnumpy())
+
 def test_batchnorm_training():
     for shape in [(2, 3), (2, 3, 2, 2)]:
         data_tmp = np.random.normal(-0.1, 0.1, size=shape)
@@ -925,6 +1081,44 @@ def test_batchnorm_training():
             test = mx.symbol.BatchNorm(data, fix_gamma=False, use_global_stats=True, axis=chaxis)
             check_numeric_gradient(test, [data_tmp, gamma, beta], [xrolling_mean, xrolling_std], numeric_eps=1e-2, rtol=0.2, atol=0.01)
 
+def test_batchnorm_add_relu():
+    shape = (4, 3, 5, 6)
+    x = mx.sym.Variable('x')
+    a = mx.sym.Variable('a')
+    for fuse_add in [False, True]:
+        bn = mx.sym.BatchNorm(x, fix_gamma=False, name='bn')
+        ref = mx.sym.Activation(bn + a if fuse_add else bn, act_type='relu', name='relu')
+        if fuse_add:
+            fused = mx.sym.BatchNorm(x, addend=a, fix_gamma=False, act_type='relu',
+                                     fuse_add=True, name='bn')
+        else:
+            fused = mx.sym.BatchNorm(x, fix_gamma=False, act_type='relu', name='bn')
+        assert fused.list_arguments() == ref.list_arguments()
+        assert fused.list_auxiliary_states() == ref.list_auxiliary_states()
+        shapes = {'x': shape, 'a': shape} if fuse_add else {'x': shape}
+        args = {k: np.random.normal(size=s) for k, s in
+                zip(ref.list_arguments(), ref.infer_shape(**shapes)[0])}
+        out_grad = np.random.normal(size=shape)
+        results = []
+        # the unfused reference, the executor fusion of it and the fused operator
+        for sym, fuse in [(ref, '0'), (ref, '1'), (fused, '0')]:
+            os.environ['MXNET_EXEC_FUSE_BN_RELU'] = fuse
+            try:
+                exe = sym.simple_bind(default_context(), **shapes)
+            finally:
+                del os.environ['MXNET_EXEC_FUSE_BN_RELU']
+            for name, arr in exe.arg_dict.items():
+                arr[:] = args[name]
+            exe.aux_dict['bn_moving_var'][:] = 1
+            exe.forward(is_train=True)
+            exe.backward(mx.nd.array(out_grad))
+            results.append([exe.outputs[0].asnumpy()] +
+                           [exe.grad_dict[k].asnumpy() for k in sorted(exe.grad_dict)] +
+                           [exe.aux_dict[k].asnumpy() for k in sorted(exe.aux_dict)])
+        for res in results[1:]:
+            for r, e in zip(res, results[0]):
+                assert_allclose(r, e, rtol=1e-4, atol=1e-5)
+
 def test_convolution_grouping():
     num_filter = 4
     num_group = 2
@@ -955,6 +1149,130 @@ def test_convolution_grouping():
     for arr1, arr2 in zip(exe1.outputs + exe1.grad_arrays, exe2.outputs + exe2.grad_arrays):
         np.testing.assert_allclose(arr1.asnumpy(), arr2.asnumpy(), rtol=1e-3, atol=1e-4)
 
+def test_depthwise_convolution():
+    for num_base in [4, 16]:
+        for kernel, stride, pad, dilate in [((3, 3), (1, 1), (1, 1), (1, 1)),
+                                            ((3, 3), (2, 2), (1, 1), (1, 1)),
+                                            ((5, 3), (1, 2), (2, 0), (1, 1)),
+                                            ((3, 3), (1, 1), (2, 2), (2, 2))]:
+            for no_bias in [False, True]:
+                num_filter = num_base
+                num_group = num_base
+                shape = (2, num_base, 11, 10)
+
+                x = mx.sym.Variable('x')
+                w = mx.sym.Variable('w')
+                b = mx.sym.Variable('b')
+                if no_bias:
+                    y1 = mx.sym.Convolution(data=x, weight=w, num_filter=num_filter,
+                                            num_group=num_group, kernel=kernel, stride=stride,
+                                            pad=pad, dilate=dilate, no_bias=True)
+                else:
+                    y1 = mx.sym.Convolution(data=x, weight=w, bias=b, num_filter=num_filter,
+                                            num_group=num_group, kernel=kernel, stride=stride,
+                                            pad=pad, dilate=dilate)
+                xslice = mx.sym.SliceChannel(data=x, num_outputs=num_group, axis=1)
+                wslice = mx.sym.SliceChannel(data=w, num_outputs=num_group, axis=0)
+                bslice = mx.sym.SliceChannel(data=b, num_outputs=num_group, axis=0)
+                y2 = mx.sym.Concat(*[mx.sym.Convolution(data=xslice[i], weight=wslice[i],
+                                                        bias=None if no_bias else bslice[i],
+                                                        num_filter=num_filter//num_group,
+                                                        kernel=kernel, stride=stride, pad=pad,
+                                                        dilate=dilate, no_bias=no_bias)
+                                     for i in range(num_group)])
+
+                wshape = (num_filter, shape[1]//num_group, kernel[0], kernel[1])
+                exe1 = y1.simple_bind(default_context(), x=shape)
+                if no_bias:
+                    exe2 = y2.simple_bind(default_context(), x=shape, w=wshape)
+                else:
+                    exe2 = y2.simple_bind(default_context(), x=shape, w=wshape, b=(num_filter,))
+                for arr1, arr2 in zip(exe1.arg_arrays, exe2.arg_arrays):
+                    arr1[:] = np.random.normal(size=arr1.shape)
+                    arr2[:] = arr1
+                exe1.forward(is_train=True)
+                exe1.backward(exe1.outputs[0])
+                exe2.forward(is_train=True)
+                exe2.backward(exe2.outputs[0])
+
+                for arr1, arr2 in zip(exe1.outputs + exe1.grad_arrays,
+                                      exe2.outputs + exe2.grad_arrays):
+                    np.testing.assert_allclose(arr1.asnumpy(), arr2.asnumpy(), rtol=1e-3, atol=1e-3)
+
+def test_pooling():
+    def np_pool(x, kernel, stride, pad, pool_type, out_grad):
+        kh, kw = kernel
+        fill = -np.inf if pool_type == 'max' else 0
+        xp = np.pad(x, ((0, 0), (0, 0), (pad[0], pad[0]), (pad[1], pad[1])), 'constant',
+                    constant_values=fill)
+        oh = (xp.shape[2] - kh) // stride[0] + 1
+        ow = (xp.shape[3] - kw) // stride[1] + 1
+        out = np.zeros(x.shape[:2] + (oh, ow))
+        grad = np.zeros(xp.shape)
+        for n, c, i, j in itertools.product(*[range(d) for d in out.shape]):
+            hs, ws = i * stride[0], j * stride[1]
+            window = xp[n, c, hs:hs+kh, ws:ws+kw]
+            if pool_type == 'max':
+                out[n, c, i, j] = window.max()
+                h, w = np.unravel_index(window.argmax(), window.shape)
+                grad[n, c, hs+h, ws+w] += out_grad[n, c, i, j]
+            else:
+                out[n, c, i, j] = window.mean()
+                grad[n, c, hs:hs+kh, ws:ws+kw] += out_grad[n, c, i, j] / (kh * kw)
+        return out, grad[:, :, pad[0]:pad[0]+x.shape[2], pad[1]:pad[1]+x.shape[3]]
+
+    shape = (2, 3, 9, 10)
+    for pool_type in ['max', 'avg']:
+        for kernel, stride, pad, global_pool in [((2, 2), (2, 2), (0, 0), False),
+                                                 ((3, 3), (1, 1), (0, 0), False),
+                                                 ((3, 3), (2, 2), (1, 1), False),
+                                                 ((2, 3), (1, 2), (1, 0), False),
+                                                 (shape[2:], (1, 1), (0, 0), True)]:
+            x = np.random.normal(size=shape)
+            sym = mx.sym.Pooling(data=mx.sym.Variable('x'), kernel=kernel, stride=stride,
+                                 pad=pad, pool_type=pool_type, global_pool=global_pool)
+            exe = sym.simple_bind(default_context(), x=shape)
+            exe.arg_arrays[0][:] = x
+            exe.forward(is_train=True)
+            out_grad = np.random.normal(size=exe.outputs[0].shape)
+            exe.backward(mx.nd.array(out_grad))
+            out, grad = np_pool(x, kernel, stride, pad, pool_type, out_grad)
+            assert_allclose(exe.outputs[0].asnumpy(), out, rtol=1e-5, atol=1e-5)
+            assert_allclose(exe.grad_arrays[0].asnumpy(), grad, rtol=1e-5, atol=1e-5)
+            # an inference forward does not record the maxima
+            exe.forward(is_train=False)
+            assert_allclose(exe.outputs[0].asnumpy(), out, rtol=1e-5, atol=1e-5)
+
+def test_convolution_winograd_and_1x1():
+    def np_conv(x, w, b, pad):
+        k = w.shape[2]
+        x = np.pad(x, ((0, 0), (0, 0), (pad, pad), (pad, pad)), 'constant')
+        oh, ow = x.shape[2] - k + 1, x.shape[3] - k + 1
+        out = np.zeros((x.shape[0], w.shape[0], oh, ow))
+        for i in range(k):
+            for j in range(k):
+                out += np.einsum('kc,nchw->nkhw', w[:, :, i, j], x[:, :, i:i+oh, j:j+ow])
+        return out + b.reshape((1, -1, 1, 1))
+
+    # F(4x4, 3x3), F(2x2, 3x3) and the 1x1 convolutions without im2col
+    for shape, num_filter, kernel, pad in [((2, 16, 12, 11), 24, 3, 1),
+                                           ((3, 32, 7, 6), 16, 3, 0),
+                                           ((2, 16, 5, 9), 16, 3, 1),
+                                           ((2, 5, 4, 3), 7, 1, 0)]:
+        x = np.random.uniform(-1, 1, shape)
+        w = np.random.uniform(-1, 1, (num_filter, shape[1], kernel, kernel))
+        b = np.random.uniform(-1, 1, (num_filter,))
+        sym = mx.sym.Convolution(data=mx.sym.Variable('x'), weight=mx.sym.Variable('w'),
+                                 bias=mx.sym.Variable('b'), num_filter=num_filter,
+                                 kernel=(kernel, kernel), pad=(pad, pad))
+        check_symbolic_forward(sym, [x, w, b], [np_conv(x, w, b, pad)], rtol=1e-3, atol=1e-3)
+        if kernel == 1:
+            og = np.random.uniform(-1, 1, (shape[0], num_filter) + shape[2:])
+            check_symbolic_backward(sym, [x, w, b], [og],
+                                    [np.einsum('kc,nkhw->nchw', w[:, :, 0, 0], og),
+                                     np.einsum('nkhw,nchw->kc', og, x).reshape(w.shape),
+                                     og.sum(axis=(0, 2, 3))], rtol=1e-3, atol=1e-3)
+
 def gen_broadcast_data(idx):
     # Manually set test cases
     binary_op_data_shape = np.array(
@@ -988,7 +1306,9 @@ def gen_broadcast_data(idx):
         [[1, 1, 65, 2, 22], [1, 1, 65, 1, 1]],
         [[1, 24, 103, 17, 18], [1, 24, 1, 1, 1]],
         [[1, 1, 1, 1, 2], [1, 24, 194, 50, 1]],
-        [[1, 1, 107, 84, 9], [1, 1, 1, 1, 1]]])
+        [[1, 1, 107, 84, 9], [1, 1, 1, 1, 1]],
+        [[1, 3, 1, 1, 4100], [1, 1, 1, 1, 4100]],
+        [[1, 1, 5, 2049, 1], [1, 1, 5, 1, 1]]])
     if idx < binary_op_data_shape.shape[0]:
         l_shape = binary_op_data_shape[idx][0]
         r_shape = binary_op_data_shape[idx][1]
@@ -1408,6 +1728,19 @@ def test_reduce():
                         outgrad.reshape(keepdim_shape) * (np.equal(data, outdata.reshape(keepdim_shape)).astype(np.float)),
                       mx.symbol.min)
 
+def test_reduce_large():
+    # large enough for the cpu reductions to split the work between threads
+    for shape in [(200003,), (3, 50000), (50000, 3), (40, 70, 300), (5, 20000, 2)]:
+        data = np.random.uniform(-1, 1, shape).astype(np.float32)
+        x = mx.nd.array(data)
+        for axis in [None] + list(range(len(shape))):
+            assert_almost_equal(mx.nd.sum(x, axis=axis).asnumpy(),
+                                np.sum(data.astype(np.float64), axis=axis), rtol=1e-3, atol=1e-2)
+            assert_almost_equal(mx.nd.max(x, axis=axis).asnumpy(), np.max(data, axis=axis))
+        assert_almost_equal(mx.nd.norm(x).asnumpy(),
+                            np.linalg.norm(data.astype(np.float64)), rtol=1e-4)
+
+
 def test_broadcast():
     sample_num = 200
     for i in range(sample_num):
@@ -1453,6 +1786,15 @@ def test_transpose():
             y = mx.nd.transpose(x)
             assert_allclose(np.transpose(x.asnumpy()), y.asnumpy())
 
+    # shapes that cross the tiles of the transpose kernels, in several types
+    for dims, axes in [((67, 45), (1, 0)), ((3, 70, 33), (0, 2, 1)), ((9, 1, 40, 37), (2, 1, 3, 0)),
+                       ((5, 6, 7, 8), (0, 2, 1, 3)), ((2, 33, 3, 65), (3, 1, 2, 0))]:
+        for dtype in [np.float32, np.float64, np.float16, np.int32, np.uint8]:
+            data = np.random.uniform(0, 100, size=dims).astype(dtype)
+            y = mx.nd.transpose(mx.nd.array(data, dtype=dtype), axes=axes)
+            assert y.dtype == dtype
+            assert_allclose(np.transpose(data, axes=axes), y.asnumpy())
+
 
 def test_expand_dims():
     for ndim in range(1, 6):
@@ -1851,6 +2193,29 @@ def test_correlation():
     unittest_correlation((5,1,4,4), kernel_size = 3,max_displacement = 1,stride1 = 2,stride2 = 1,pad_size = 2,is_multiply = False)
     unittest_correlation((5,1,6,4), kernel_size = 3,max_displacement = 1,stride1 = 2,stride2 = 1,pad_size = 2,is_multiply = False)
     unittest_correlation((5,1,11,11), kernel_size = 5,max_displacement = 1,stride1 = 1,stride2 = 1,pad_size = 2,is_multiply = False)
+    unittest_correlation((2,3,13,12), kernel_size = 3,max_displacement = 4,stride1 = 1,stride2 = 2,pad_size = 1,is_multiply = True)
+
+
+def test_correlation_grad_add():
+    data_shape = (2, 3, 9, 9)
+    img1 = np.random.random(data_shape)
+    img2 = np.random.random(data_shape)
+    net = get_correlation(img1, img2, 3, 2, 1, 1, 2, True)
+    out_grad = None
+    grads = []
+    for grad_req in ['write', 'add']:
+        exe = net.simple_bind(default_context(), img1=data_shape, img2=data_shape, grad_req=grad_req)
+        exe.arg_dict['img1'][:] = img1
+        exe.arg_dict['img2'][:] = img2
+        exe.grad_dict['img1'][:] = 1
+        exe.grad_dict['img2'][:] = 1
+        exe.forward(is_train=True)
+        if out_grad is None:
+            out_grad = np.random.normal(size=exe.outputs[0].shape)
+        exe.backward(out_grads=mx.nd.array(out_grad))
+        grads.append([exe.grad_dict['img1'].asnumpy(), exe.grad_dict['img2'].asnumpy()])
+    for written, added in zip(*grads):
+        assert_almost_equal(written + 1, added, rtol=1e-4, atol=1e-5)
 
 
 def test_support_vector_machine_l1_svm():
@@ -1958,6 +2323,25 @@ def test_pad():
     check_pad_with_shape(shape1, default_context(), pad1, 'reflect')
     check_pad_with_shape(shape2, default_context(), pad2, 'reflect')
 
+def test_pad_fold_convolution():
+    # the zero padding is folded into the pad of the convolution when binding
+    data = mx.sym.Variable('data')
+    padded = mx.sym.Pad(data, mode='constant', pad_width=(0, 0, 0, 0, 2, 2, 1, 1))
+    folded = mx.sym.Convolution(padded, kernel=(3, 3), pad=(1, 0), num_filter=4, name='conv')
+    direct = mx.sym.Convolution(data, kernel=(3, 3), pad=(3, 1), num_filter=4, name='conv')
+    shapes = {'data': (2, 3, 7, 6), 'conv_weight': (4, 3, 3, 3), 'conv_bias': (4,)}
+    values = {k: np.random.normal(size=v) for k, v in shapes.items()}
+    results = []
+    for sym in [folded, direct]:
+        args = {k: mx.nd.array(v, ctx=default_context()) for k, v in values.items()}
+        grads = {k: mx.nd.zeros(v, ctx=default_context()) for k, v in shapes.items()}
+        exe = sym.bind(default_context(), args=args, args_grad=grads)
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.ones(exe.outputs[0].shape, ctx=default_context())])
+        results.append([exe.outputs[0].asnumpy()] + [grads[k].asnumpy() for k in sorted(shapes)])
+    for a, b in zip(*results):
+        assert_almost_equal(a, b, rtol=1e-4, atol=1e-4)
+
 def np_instance_norm(data, weight, bias, eps):
     spatial_dims = data.shape[2::]
     num_spatial_vals = np.prod(np.array(spatial_dims))
@@ -2042,6 +2426,21 @@ def test_l2_normalization():
                     for width in [5, 7]:
                         check_l2_normalization((nbatch, nchannel, height, width), mode)
 
+def test_lrn():
+    data = mx.symbol.Variable('data')
+    for nsize in [1, 3, 5]:
+        out = mx.symbol.LRN(data=data, alpha=0.1, beta=0.75, knorm=2, nsize=nsize)
+        in_data = np.random.uniform(-1, 1, (2, 6, 3, 4))
+        sq = np.square(in_data)
+        norm = np.zeros_like(in_data)
+        for c in range(in_data.shape[1]):
+            lo, hi = max(c - nsize // 2, 0), min(c + nsize // 2 + 1, in_data.shape[1])
+            norm[:, c] = 2 + 0.1 / nsize * sq[:, lo:hi].sum(axis=1)
+        exe = out.simple_bind(ctx=default_context(), data=in_data.shape)
+        exe.forward(is_train=True, data=in_data)
+        assert_almost_equal(exe.outputs[0].asnumpy(), in_data * np.power(norm, -0.75), rtol=1e-4)
+        check_numeric_gradient(out, [in_data], numeric_eps=1e-3, rtol=1e-2, atol=1e-3)
+
 def sequence_mask_numpy(array, lengths, value):
     arrayMask = array.copy()
     shape = array.shape
@@ -2141,6 +2540,33 @@ def check_sequence_reverse(xpu):
 def test_sequence_reverse():
     check_sequence_reverse(mx.cpu())
 
+def test_sequence_last():
+    shape = (5, 3, 2, 2)
+    x = np.random.uniform(-1, 1, shape)
+    lengths = np.array([5, 2, 1])
+    ograd = np.random.uniform(-1, 1, shape[1:])
+    for use_sequence_length in [False, True]:
+        steps = lengths if use_sequence_length else np.full(3, 5)
+        args = {'data': mx.nd.array(x)}
+        if use_sequence_length:
+            args['sequence_length'] = mx.nd.array(lengths)
+            sym = mx.sym.SequenceLast(mx.sym.Variable('data'), mx.sym.Variable('sequence_length'),
+                                      use_sequence_length=True)
+        else:
+            sym = mx.sym.SequenceLast(mx.sym.Variable('data'))
+        expected = np.array([x[steps[i] - 1, i] for i in range(3)])
+        expected_grad = np.zeros(shape)
+        for i in range(3):
+            expected_grad[steps[i] - 1, i] = ograd[i]
+        for grad_req in ['write', 'add']:
+            grad = mx.nd.ones(shape)
+            exe = sym.bind(default_context(), args=args, args_grad={'data': grad},
+                           grad_req={'data': grad_req, 'sequence_length': 'null'})
+            exe.forward(is_train=True)
+            assert_almost_equal(exe.outputs[0].asnumpy(), expected)
+            exe.backward(mx.nd.array(ograd))
+            assert_almost_equal(grad.asnumpy(), expected_grad + (grad_req == 'add'))
+
 def mathematical_core_binary(name,
                              forward_mxnet_call,
                              forward_numpy_call,
@@ -2352,6 +2778,9 @@ def test_clip():
     check_symbolic_forward(test, [data_tmp], [np.clip(data_tmp, -0.6, 0.6)])
     check_symbolic_backward(test, [data_tmp], [np.ones(shape)],
                             [np.where(data_tmp < 0.6, [1], [0]) * np.where(data_tmp > -0.6, [1], [0])])
+    check_symbolic_backward(test, [data_tmp], [np.ones(shape)],
+                            [np.where(data_tmp < 0.6, [1], [0]) * np.where(data_tmp > -0.6, [1], [0])],
+                            grad_req='add')
 
 def test_init():
     def test_basic_val_init(sym_func, np_func, shape, dtype):
@@ -2478,6 +2907,23 @@ def test_order():
                                              is_ascend=True)])
 
 
+def test_order_long_rows():
+    # long rows select their top k, or radix sort when k is close to the row size,
+    # and the ties keep the order of a stable sort
+    ctx = default_context()
+    for shape in [(1, 50000), (3, 20000), (40, 1000)]:
+        a_npy = np.random.randint(-100, 100, size=shape).astype(np.float32)
+        a = mx.nd.array(a_npy, ctx=ctx)
+        for is_ascend in [True, False]:
+            order = np.argsort(a_npy if is_ascend else -a_npy, axis=-1, kind='mergesort')
+            for k in [1, 10, 100, shape[1] // 2, shape[1]]:
+                ind = mx.nd.topk(a, axis=-1, k=k, ret_typ='indices', is_ascend=is_ascend)
+                assert_almost_equal(ind.asnumpy(), order[:, :k])
+                val = mx.nd.topk(a, axis=-1, k=k, ret_typ='value', is_ascend=is_ascend)
+                assert_almost_equal(val.asnumpy(),
+                                    np.array([r[o] for r, o in zip(a_npy, order[:, :k])]))
+
+
 def test_blockgrad():
     a = mx.sym.Variable('a')
     b = mx.sym.BlockGrad(a)
@@ -2717,7 +3163,8 @@ def test_bilinear_sampler():
     test_case = [[(1,3,15,16),(1,2,10,10)],
                  [(1,6,7,16),(1,2,10,4)],
                  [(1,7,3,16),(1,2,8,11)],
-                 [(1,9,50,50),(1,2,50,50)]]
+                 [(1,9,50,50),(1,2,50,50)],
+                 [(5,3,9,11),(5,2,7,8)]]
 
     for ctx in [default_context()]:
         for item in test_case:
@@ -2776,6 +3223,27 @@ def test_cast():
             assert_almost_equal(exe.grad_arrays[0].asnumpy(), X.astype(dsttype).astype(srctype), rtol=1e-3)
 
 
+def test_float16_kernels():
+    # the fp16 kernels compute in fp32, the results round once to fp16
+    a = np.random.uniform(-2, 2, size=(7, 300)).astype(np.float16)
+    b = np.random.uniform(-2, 2, size=(7, 300)).astype(np.float16)
+    c = np.random.uniform(-2, 2, size=(1, 300)).astype(np.float16)
+    x = mx.nd.array(a, dtype=np.float16)
+    y = mx.nd.array(b, dtype=np.float16)
+    z = mx.nd.array(c, dtype=np.float16)
+    f32 = lambda v: v.astype(np.float32)
+    assert_almost_equal((x + y).asnumpy(), (f32(a) + f32(b)).astype(np.float16), rtol=1e-3)
+    assert_almost_equal(mx.nd.relu(x).asnumpy(), np.maximum(a, 0))
+    assert_almost_equal(mx.nd.exp(x).asnumpy(), np.exp(f32(a)).astype(np.float16), rtol=1e-3)
+    assert_almost_equal(mx.nd.broadcast_add(x, z).asnumpy(),
+                        (f32(a) + f32(c)).astype(np.float16), rtol=1e-3)
+    for axis in [0, 1]:
+        assert_almost_equal(mx.nd.sum(x, axis=axis).asnumpy(),
+                            f32(a).sum(axis=axis).astype(np.float16), rtol=1e-2, atol=1e-2)
+    assert_almost_equal(mx.nd.Cast(x, dtype=np.float32).asnumpy(), f32(a))
+    assert_almost_equal(mx.nd.Cast(mx.nd.array(f32(a)), dtype=np.float16).asnumpy(), a)
+
+
 def test_repeat():
     def test_repeat_forward():
         ndim_max = 6 # max number of dims of the ndarray
@@ -2796,6 +3264,15 @@ def test_repeat():
                 bb = mx.nd.repeat(b, repeats, axis).asnumpy()
                 assert_almost_equal(aa, bb)
 
+    def test_repeat_blocks():
+        # rows long enough to be copied or filled as whole blocks
+        a = np.random.random_sample(size=(4, 3, 50))
+        b = mx.nd.array(a, ctx=default_context())
+        assert_almost_equal(np.repeat(a, 20), mx.nd.repeat(b, 20).asnumpy())
+        for axis in range(3):
+            assert_almost_equal(np.repeat(a, 5, axis), mx.nd.repeat(b, 5, axis).asnumpy())
+        assert_almost_equal(np.tile(a, (2, 1, 3)), mx.nd.tile(b, (2, 1, 3)).asnumpy())
+
     def test_repeat_backward(axis):
         data = mx.sym.Variable('data')
         n1 = 3
@@ -2845,6 +3322,7 @@ def test_repeat():
         check_numeric_gradient(test, [data_tmp], numeric_eps=1e-3, rtol=1e-2)
 
     test_repeat_forward()
+    test_repeat_blocks()
     test_repeat_backward(axis=0)
     test_repeat_backward(axis=1)
     test_repeat_numeric_gradient()
@@ -3246,6 +3724,44 @@ def test_ctc_loss():
     check_ctc_loss(acts2, labels2, true_loss)
 
 
+def test_ctc_loss_with_lengths():
+    np.random.seed(1234)
+    T, B, A = 6, 3, 5
+    acts = np.random.normal(size=(T, B, A)).astype(np.float32)
+    labels = np.array([[2, 3, 3, 1], [1, 4, 0, 0], [4, 4, 2, 3]], dtype=np.float32)
+    data_lengths = np.array([6, 4, 5], dtype=np.float32)
+    label_lengths = np.array([2, 2, 1], dtype=np.float32)
+    data = mx.sym.Variable('data')
+    label = mx.sym.Variable('label')
+    lengths = [mx.sym.Variable('data_lengths'), mx.sym.Variable('label_lengths')]
+    ctc = mx.contrib.sym.ctc_loss(data, label, *lengths, use_data_lengths=True,
+                                  use_label_lengths=True)
+    exe = ctc.bind(default_context(), args={'data': mx.nd.array(acts), 'label': mx.nd.array(labels),
+                                            'data_lengths': mx.nd.array(data_lengths),
+                                            'label_lengths': mx.nd.array(label_lengths)},
+                   args_grad={'data': mx.nd.zeros(acts.shape)})
+    exe.forward(is_train=True)
+    exe.backward(mx.nd.ones((B,)))
+    loss = exe.outputs[0].asnumpy()
+    grad = exe.grad_dict['data'].asnumpy()
+    # each sequence has the loss and the gradient of its unpadded part alone
+    for b in range(B):
+        t, l = int(data_lengths[b]), int(label_lengths[b])
+        single = mx.contrib.sym.ctc_loss(data, label)
+        exe_b = single.bind(default_context(),
+                            args={'data': mx.nd.array(acts[:t, b:b + 1]),
+                                  'label': mx.nd.array(labels[b:b + 1, :l])},
+                            args_grad={'data': mx.nd.zeros((t, 1, A))})
+        exe_b.forward(is_train=True)
+        exe_b.backward(mx.nd.ones((1,)))
+        assert_almost_equal(loss[b:b + 1], exe_b.outputs[0].asnumpy(), rtol=1e-4, atol=1e-5)
+        assert_almost_equal(grad[:t, b:b + 1], exe_b.grad_dict['data'].asnumpy(),
+                            rtol=1e-4, atol=1e-5)
+        assert_almost_equal(grad[t:, b], np.zeros((T - t, A)))
+    check_numeric_gradient(ctc, [acts, labels, data_lengths, label_lengths],
+                           grad_nodes=['data'], rtol=0.05, atol=1e-3)
+
+
 def test_quantization_op():
     min0 = mx.nd.array([0.0])
     max0 = mx.nd.array([1.0])
@@ -3259,6 +3775,45 @@ def test_quantization_op():
     assert same(qa.asnumpy(), qa_real.asnumpy())
     assert same(a_.asnumpy(),  a_real.asnumpy())
 
+    # values out of the range saturate
+    qb, _, _ = mx.contrib.nd.quantize(mx.nd.array([-0.5, 1.5]), min0, max0, out_type='uint8')
+    assert same(qb.asnumpy(), np.array([0, 255]))
+
+def test_quantized_fully_connected_op():
+    data = np.random.uniform(-1, 3, size=(4, 3, 5)).astype(np.float32)
+    weight = np.random.uniform(-2, 1, size=(6, 15)).astype(np.float32)
+    bias = np.random.uniform(-1, 1, size=(6,)).astype(np.float32)
+    qdata, min_d, max_d = mx.contrib.nd.quantize(mx.nd.array(data), mx.nd.array([-1]),
+                                                 mx.nd.array([3]), out_type='uint8')
+    qweight, min_w, max_w = mx.contrib.nd.quantize(mx.nd.array(weight), mx.nd.array([-2]),
+                                                   mx.nd.array([1]), out_type='uint8')
+    out = mx.contrib.nd.quantized_fully_connected(qdata, qweight, mx.nd.array(bias),
+                                                  min_d, max_d, min_w, max_w, num_hidden=6)
+    # the same layer over the dequantized inputs
+    data_ = mx.contrib.nd.dequantize(qdata, min_d, max_d, out_type='float32').asnumpy()
+    weight_ = mx.contrib.nd.dequantize(qweight, min_w, max_w, out_type='float32').asnumpy()
+    expected = np.dot(data_.reshape((4, 15)), weight_.T) + bias
+    assert out.dtype == np.float32
+    assert_almost_equal(out.asnumpy(), expected, rtol=1e-4, atol=1e-4)
+
+def test_fully_connected_cache_weight():
+    data = np.random.uniform(-1, 1, size=(2, 300)).astype(np.float32)
+    weight = np.random.uniform(-1, 1, size=(40, 300)).astype(np.float32)
+    bias = np.random.uniform(-1, 1, size=(40,)).astype(np.float32)
+    expected = np.dot(data, weight.T) + bias
+    for storage, tol in [('float32', 1e-4), ('float16', 1e-2), ('int8', 1e-1)]:
+        fc = mx.sym.FullyConnected(mx.sym.var('data'), num_hidden=40, name='fc',
+                                   cache_weight=True, weight_storage=storage)
+        exe = fc.bind(default_context(), args={'data': mx.nd.array(data),
+                                               'fc_weight': mx.nd.array(weight),
+                                               'fc_bias': mx.nd.array(bias)})
+        # the second pass reads the weight kept by the first
+        for _ in range(2):
+            exe.forward(is_train=False)
+            assert_almost_equal(exe.outputs[0].asnumpy(), expected, rtol=tol, atol=tol)
+        exe.forward(is_train=True)
+        assert_almost_equal(exe.outputs[0].asnumpy(), expected, rtol=1e-4, atol=1e-4)
+
 def test_reciprocal_op():
     data_tmp = np.random.rand(3, 4) * 10 - 5
     # Avoid possible division by 0 errors
@@ -3315,6 +3870,35 @@ def test_custom_op():
         y = mx.nd.Custom(x, op_type='sqr')
         y.backward()
 
+    # the callbacks run on threads of their own, one may wait for another
+    class AddSqr(mx.operator.CustomOp):
+        def forward(self, is_train, req, in_data, out_data, aux):
+            y = mx.nd.Custom(in_data[0], op_type='sqr')
+            self.assign(out_data[0], req[0], mx.nd.array(y.asnumpy() + in_data[0].asnumpy()))
+
+    @mx.operator.register("addsqr")
+    class AddSqrProp(mx.operator.CustomOpProp):
+        def __init__(self):
+            super(AddSqrProp, self).__init__(need_top_grad=False)
+
+        def list_arguments(self):
+            return ['data']
+
+        def list_outputs(self):
+            return ['output']
+
+        def infer_shape(self, in_shape):
+            return in_shape, [in_shape[0]], []
+
+        def create_operator(self, ctx, shapes, dtypes):
+            return AddSqr()
+
+    x = mx.nd.array(np.random.uniform(-1, 1, size=(4, 10)))
+    ys = [mx.nd.Custom(x + i, op_type='addsqr') * 2 for i in range(4)]
+    for i, y in enumerate(ys):
+        xi = x.asnumpy() + i
+        assert_almost_equal(y.asnumpy(), (xi * xi + xi) * 2)
+
 
 def test_psroipooling():
     for num_rois in [1, 2]:
@@ -3340,6 +3924,138 @@ def test_psroipooling():
                         check_numeric_gradient(op, [im_data, rois_data], rtol=rtol, atol=atol,
                                                grad_nodes=grad_nodes, ctx=mx.gpu(0))
 
+def test_roi_align():
+    def bilinear(y, x, height, width):
+        # the neighbours of (y, x) and their weights, none out of the map
+        if y < -1 or y > height or x < -1 or x > width:
+            return []
+        y, x = max(y, 0.), max(x, 0.)
+        y_low, x_low = int(y), int(x)
+        if y_low >= height - 1:
+            y_low = y_high = height - 1
+            y = float(y_low)
+        else:
+            y_high = y_low + 1
+        if x_low >= width - 1:
+            x_low = x_high = width - 1
+            x = float(x_low)
+        else:
+            x_high = x_low + 1
+        ly, lx = y - y_low, x - x_low
+        hy, hx = 1. - ly, 1. - lx
+        return [(y_low, x_low, hy * hx), (y_low, x_high, hy * lx),
+                (y_high, x_low, ly * hx), (y_high, x_high, ly * lx)]
+
+    def roi_align_np(data, rois, ograd, pooled_size, spatial_scale, sample_ratio):
+        _, C, H, W = data.shape
+        PH, PW = pooled_size
+        out = np.zeros((rois.shape[0], C, PH, PW))
+        dgrad = np.zeros(data.shape)
+        for n, roi in enumerate(rois):
+            b = int(roi[0])
+            x0, y0 = roi[1] * spatial_scale, roi[2] * spatial_scale
+            roi_w = max(roi[3] * spatial_scale - x0, 1.)
+            roi_h = max(roi[4] * spatial_scale - y0, 1.)
+            bin_h, bin_w = roi_h / PH, roi_w / PW
+            gh = sample_ratio if sample_ratio > 0 else int(np.ceil(bin_h))
+            gw = sample_ratio if sample_ratio > 0 else int(np.ceil(bin_w))
+            for ph in range(PH):
+                for pw in range(PW):
+                    for iy in range(gh):
+                        y = y0 + ph * bin_h + (iy + .5) * bin_h / gh
+                        for ix in range(gw):
+                            x = x0 + pw * bin_w + (ix + .5) * bin_w / gw
+                            for yy, xx, w in bilinear(y, x, H, W):
+                                out[n, :, ph, pw] += w * data[b, :, yy, xx] / (gh * gw)
+                                dgrad[b, :, yy, xx] += w * ograd[n, :, ph, pw] / (gh * gw)
+        return out, dgrad
+
+    np.random.seed(1234)
+    data = mx.symbol.Variable(name='data')
+    rois = mx.symbol.Variable(name='rois')
+    x1 = np.random.rand(2, 3, 12, 8).astype('float32')
+    # rois out of the map, smaller than a cell and overlapping
+    x2 = np.array([[0, 1.1, 1.1, 6.2, 6.2], [1, 6.1, 2.1, 8.2, 11.2], [1, 3.1, 1.1, 5.2, 10.2],
+                   [0, 3, 3, 3, 3], [0, -2, -3, 15, 30], [1, 6.5, 6.2, 6.7, 6.3]], dtype='float32')
+    for pooled_size, spatial_scale, sample_ratio in [((2, 2), 1, 2), ((3, 2), 0.5, -1),
+                                                     ((4, 4), 1, -1), ((1, 3), 1, 1)]:
+        test = mx.sym.contrib.ROIAlign(data=data, rois=rois, pooled_size=pooled_size,
+                                       spatial_scale=spatial_scale, sample_ratio=sample_ratio)
+        ograd = np.random.rand(x2.shape[0], x1.shape[1], *pooled_size).astype('float32')
+        out_np, dgrad_np = roi_align_np(x1, x2, ograd, pooled_size, spatial_scale, sample_ratio)
+        exe = test.bind(default_context(), args={'data': mx.nd.array(x1), 'rois': mx.nd.array(x2)},
+                        args_grad={'data': mx.nd.ones(x1.shape), 'rois': mx.nd.ones(x2.shape)},
+                        grad_req={'data': 'add', 'rois': 'write'})
+        exe.forward(is_train=True)
+        assert_almost_equal(exe.outputs[0].asnumpy(), out_np, rtol=1e-4, atol=1e-5)
+        exe.backward(mx.nd.array(ograd))
+        assert_almost_equal(exe.grad_dict['data'].asnumpy(), dgrad_np + 1, rtol=1e-4, atol=1e-5)
+        assert_almost_equal(exe.grad_dict['rois'].asnumpy(), np.zeros(x2.shape))
+        # the output is linear in the data
+        check_numeric_gradient(sym=test, location=[x1, x2],
+                               grad_nodes={'data': 'write', 'rois': 'null'},
+                               numeric_eps=1e-3, rtol=1e-2, atol=1e-3)
+
+
+def test_multihead_attention():
+    def attention_np(q, k, v, num_heads, seq_len, causal):
+        B, Tq, _ = q.shape
+        Tk = k.shape[1]
+        dk, dv = q.shape[2] // num_heads, v.shape[2] // num_heads
+        out = np.zeros((B, Tq, num_heads * dv))
+        for b in range(B):
+            for h in range(num_heads):
+                qh = q[b, :, h * dk:(h + 1) * dk]
+                kh = k[b, :, h * dk:(h + 1) * dk]
+                vh = v[b, :, h * dv:(h + 1) * dv]
+                score = np.dot(qh, kh.T) / np.sqrt(dk)
+                for i in range(Tq):
+                    n = Tk if seq_len is None else min(Tk, int(seq_len[b]))
+                    if causal:
+                        n = min(n, i + Tk - Tq + 1)
+                    if n <= 0:
+                        continue
+                    w = np.exp(score[i, :n] - score[i, :n].max())
+                    out[b, i, h * dv:(h + 1) * dv] = np.dot(w / w.sum(), vh[:n])
+        return out
+
+    np.random.seed(1234)
+    B, Tq, Tk, H, dk, dv = 3, 4, 5, 2, 3, 2
+    q = np.random.normal(size=(B, Tq, H * dk)).astype('float32')
+    k = np.random.normal(size=(B, Tk, H * dk)).astype('float32')
+    v = np.random.normal(size=(B, Tk, H * dv)).astype('float32')
+    # a sequence without any valid key has an output of 0
+    seq_len = np.array([5, 2, 0], dtype='float32')
+    query, key, value = mx.sym.Variable('query'), mx.sym.Variable('key'), mx.sym.Variable('value')
+    length = mx.sym.Variable('sequence_length')
+    for use_len, causal in itertools.product([False, True], [False, True]):
+        if use_len:
+            test = mx.sym.contrib.MultiHeadAttention(query, key, value, length, num_heads=H,
+                                                     use_sequence_length=True, causal=causal)
+            location = [q, k, v, seq_len]
+        else:
+            test = mx.sym.contrib.MultiHeadAttention(query, key, value, num_heads=H,
+                                                     causal=causal)
+            location = [q, k, v]
+        expected = attention_np(q, k, v, H, seq_len if use_len else None, causal)
+        check_symbolic_forward(test, location, [expected], rtol=1e-4, atol=1e-5)
+        grad_nodes = {'query': 'write', 'key': 'write', 'value': 'write'}
+        if use_len:
+            grad_nodes['sequence_length'] = 'null'
+        check_numeric_gradient(test, location, grad_nodes=grad_nodes,
+                               numeric_eps=1e-3, rtol=1e-2, atol=1e-3)
+
+    # the dropout only applies in training, and keeps the expected output
+    test = mx.sym.contrib.MultiHeadAttention(query, key, value, num_heads=H, dropout=0.5)
+    args = {'query': mx.nd.array(q), 'key': mx.nd.array(k), 'value': mx.nd.array(v)}
+    exe = test.bind(default_context(), args=args)
+    exe.forward(is_train=False)
+    assert_almost_equal(exe.outputs[0].asnumpy(), attention_np(q, k, v, H, None, False),
+                        rtol=1e-4, atol=1e-5)
+    exe.forward(is_train=True)
+    assert not np.allclose(exe.outputs[0].asnumpy(), attention_np(q, k, v, H, None, False))
+
+
 def test_deformable_convolution():
     for num_batch in [1, 2]:
         for num_channel_data, num_deformable_group in itertools.product([4, 8], [1, 2]):
@@ -3371,10 +4087,35 @@ def test_deformable_convolution():
                             rtol, atol = 1.0, 1e-2
                         else:
                             rtol, atol = 0.05, 1e-3
-                        # By now we only have gpu implementation
-                        if mx.Context.default_ctx.device_type == 'gpu':
-                            check_numeric_gradient(op, [im_data, offset_data, weight, bias], rtol=rtol, atol=atol,
-                                                   grad_nodes=grad_nodes, ctx=mx.gpu(0))
+                        check_numeric_gradient(op, [im_data, offset_data, weight, bias], rtol=rtol, atol=atol,
+                                               grad_nodes=grad_nodes, ctx=default_context())
+
+
+def test_deformable_convolution_workspace():
+    # a workspace too small for the column buffer of an image is filled a few columns at a time,
+    # and the default one for all images at once, which must give the same results
+    num_batch, num_channel_data, num_deformable_group = 3, 4, 2
+    im_data = np.random.rand(num_batch, num_channel_data, 7, 6)
+    offset_data = np.random.rand(num_batch, num_deformable_group * 3 * 3 * 2, 7, 6) * 0.8 + 0.1
+    weight = np.random.normal(0, 0.1, (6, num_channel_data // 2, 3, 3))
+    bias = np.random.normal(0, 0.1, (6,))
+    out_grad = np.random.normal(0, 1, (num_batch, 6, 7, 6))
+    results = []
+    for workspace in [1024, 0]:
+        op = mx.contrib.sym.DeformableConvolution(data=mx.sym.Variable('data'),
+                                                  offset=mx.sym.Variable('offset'),
+                                                  num_filter=6, num_group=2, pad=(1, 1), kernel=(3, 3),
+                                                  num_deformable_group=num_deformable_group,
+                                                  workspace=workspace, name='conv')
+        args = {'data': mx.nd.array(im_data), 'offset': mx.nd.array(offset_data),
+                'conv_weight': mx.nd.array(weight), 'conv_bias': mx.nd.array(bias)}
+        grads = {k: mx.nd.zeros(v.shape) for k, v in args.items()}
+        exe = op.bind(default_context(), args=args, args_grad=grads)
+        exe.forward(is_train=True)
+        exe.backward([mx.nd.array(out_grad)])
+        results.append([exe.outputs[0].asnumpy()] + [grads[k].asnumpy() for k in sorted(grads)])
+    for expected, actual in zip(*results):
+        assert_almost_equal(expected, actual, rtol=1e-4, atol=1e-5)
 
 
 def test_deformable_psroipooling():
@@ -3653,6 +4394,88 @@ def test_laop():
       check_numeric_gradient(test_sumlogdiag, [a])
 
 
+def test_laop_large_batch():
+    # many small distinct matrices, as the batched factorizations get them
+    np.random.seed(7)
+    batch, n = 200, 5
+    x = np.random.uniform(-1, 1, (batch, n, n))
+    a = np.matmul(x, np.transpose(x, (0, 2, 1))) + n * np.eye(n)
+    l = np.linalg.cholesky(a)
+    b = np.random.uniform(-1, 1, (batch, n, 3))
+
+    data1 = mx.symbol.Variable('data1')
+    data2 = mx.symbol.Variable('data2')
+    check_symbolic_forward(mx.sym.linalg_potrf(data1), [a], [l], atol=1e-4)
+    check_symbolic_forward(mx.sym.linalg_potri(data1), [l], [np.linalg.inv(a)], atol=1e-4)
+    check_symbolic_forward(mx.sym.linalg_trsm(data1, data2), [l, b],
+                           [np.linalg.solve(l, b)], atol=1e-4)
+    check_symbolic_forward(mx.sym.linalg_trmm(data1, data2), [l, b],
+                           [np.matmul(l, b)], atol=1e-4)
+    check_symbolic_forward(mx.sym.linalg_gemm2(data1, data2), [l, b],
+                           [np.matmul(l, b)], atol=1e-4)
+
+def test_candidate_sampler():
+    label = mx.nd.array([0, 3, 9])
+    sampled, true_count, sampled_count = mx.contrib.nd.candidate_sampler(
+        label, num_sampled=2000, range_max=10)
+    sampled = sampled.asnumpy()
+    assert sampled.shape == (2000,) and sampled.min() >= 0 and sampled.max() <= 9
+    log_count = lambda k: np.log(2000 * np.log((k + 2.) / (k + 1.)) / np.log(11.))
+    assert_almost_equal(true_count.asnumpy(), log_count(np.array([0, 3, 9])), rtol=1e-4)
+    assert_almost_equal(sampled_count.asnumpy(), log_count(sampled), rtol=1e-4)
+    # class 0 is drawn with probability log(2) / log(11)
+    assert abs(np.mean(sampled == 0) - np.log(2) / np.log(11)) < 0.05
+
+    dist = mx.nd.array([0, 3, 0, 1])
+    sampled, true_count, sampled_count = mx.contrib.nd.candidate_sampler(
+        mx.nd.array([1, 3]), dist, num_sampled=1000, range_max=4, sampler='unigram')
+    sampled = sampled.asnumpy()
+    assert set(np.unique(sampled)) <= set([1, 3])
+    assert abs(np.mean(sampled == 1) - 0.75) < 0.05
+    assert_almost_equal(true_count.asnumpy(), np.log(1000 * np.array([0.75, 0.25])), rtol=1e-4)
+
+
+def test_sampled_softmax_loss():
+    N, D, V, S = 4, 5, 12, 6
+    data = np.random.normal(size=(N, D))
+    weight = np.random.normal(size=(V, D))
+    bias = np.random.normal(size=(V,))
+    label = np.array([1, 4, 4, 7])
+    sampled = np.array([0, 4, 9, 4, 2, 11])
+    true_count = np.random.uniform(-1, 0, size=(N,))
+    sampled_count = np.random.uniform(-1, 0, size=(S,))
+
+    def np_loss(data, weight, bias):
+        true_logit = np.sum(data * weight[label], axis=1) + bias[label] - true_count
+        logits = np.dot(data, weight[sampled].T) + bias[sampled] - sampled_count
+        logits[label[:, None] == sampled[None, :]] = -np.inf
+        logits = np.concatenate([true_logit[:, None], logits], axis=1)
+        return -np.log(np_softmax(logits)[:, 0])
+
+    args = [mx.sym.Variable(name) for name in ['data', 'weight', 'bias', 'label', 'sampled',
+                                               'true_count', 'sampled_count']]
+    loss = mx.contrib.sym.sampled_softmax_loss(*args)
+    values = [data, weight, bias, label, sampled, true_count, sampled_count]
+    arrays = [mx.nd.array(v) for v in values]
+    grads = [mx.nd.zeros(v.shape) for v in values[:3]]
+    exe = loss.bind(default_context(), args=arrays, args_grad=grads + [None] * 4,
+                    grad_req=['write'] * 3 + ['null'] * 4)
+    exe.forward(is_train=True)
+    assert_almost_equal(exe.outputs[0].asnumpy(), np_loss(data, weight, bias), rtol=1e-4)
+    exe.backward([mx.nd.ones((N,))])
+    # numeric gradients of the summed loss
+    eps = 1e-4
+    for k, grad in enumerate(grads):
+        expected = np.zeros(values[k].shape)
+        for idx in np.ndindex(*values[k].shape):
+            params = [v.copy() for v in values[:3]]
+            params[k][idx] += eps
+            up = np.sum(np_loss(*params))
+            params[k][idx] -= 2 * eps
+            expected[idx] = (up - np.sum(np_loss(*params))) / (2 * eps)
+        assert_almost_equal(grad.asnumpy(), expected, rtol=1e-2, atol=1e-3)
+
+
 def test_stack():
     for _ in range(100):
         ndim = random.randint(1, 5)
@@ -3705,6 +4528,144 @@ def test_dropout():
     exe.backward([mx.nd.ones((10, 10))], is_train=False)
     assert (exe.grad_arrays[0].asnumpy() == exe.outputs[0].asnumpy()).all()
 
+    # the mask only depends on the seed, and the size is not a multiple of the 8 bits of a byte
+    x = mx.sym.var('data')
+    y = mx.sym.Dropout(x, p=0.3)
+    exe = y.simple_bind(ctx=default_context(), data=(7, 13))
+    exe.arg_arrays[0][:] = 1
+    mx.random.seed(42)
+    exe.forward(is_train=True)
+    out1 = exe.outputs[0].asnumpy()
+    exe.forward(is_train=True)
+    out2 = exe.outputs[0].asnumpy()
+    mx.random.seed(42)
+    exe.forward(is_train=True)
+    out3 = exe.outputs[0].asnumpy()
+    assert (out1 == out3).all()
+    assert not (out1 == out2).all()
+    exe.backward([mx.nd.ones((7, 13))])
+    assert_almost_equal(exe.grad_arrays[0].asnumpy(), out3)
+
+
+def test_multibox_prior():
+    data = mx.sym.Variable('data')
+    net = mx.sym.contrib.MultiBoxPrior(data, sizes=[0.5], clip=True)
+    for h, w in [(2, 2), (4, 3)]:
+        exe = net.simple_bind(ctx=default_context(), data=(1, 3, h, w))
+        cy, cx = np.meshgrid((np.arange(h) + 0.5) / h, (np.arange(w) + 0.5) / w, indexing='ij')
+        expected = np.stack([cx - 0.25, cy - 0.25, cx + 0.25, cy + 0.25], axis=-1)
+        expected = np.clip(expected.reshape((1, h * w, 4)), 0, 1)
+        # the anchors of the second forward come from the cache on the cpu
+        for _ in range(2):
+            exe.forward(is_train=False)
+            assert_almost_equal(exe.outputs[0].asnumpy(), expected)
+
+
+def test_multibox_target():
+    anchors = mx.nd.array([[[0.1, 0.1, 0.4, 0.4], [0.5, 0.5, 0.9, 0.9], [0.55, 0.5, 0.9, 0.95]]],
+                          ctx=default_context())
+    labels = mx.nd.array([[[1, 0.5, 0.5, 0.9, 0.9], [-1, -1, -1, -1, -1], [-1, -1, -1, -1, -1]]],
+                         ctx=default_context())
+    cls_preds = mx.nd.zeros((1, 3, 3), ctx=default_context())
+    loc_target, loc_mask, cls_target = mx.nd.contrib.MultiBoxTarget(anchors, labels, cls_preds,
+                                                                    overlap_threshold=0.5)
+    # the second anchor is the bipartite match, the third one is above the threshold
+    assert_almost_equal(cls_target.asnumpy(), np.array([[0, 2, 2]]))
+    assert_almost_equal(loc_mask.asnumpy(), np.array([[0] * 4 + [1] * 8]))
+    assert_almost_equal(loc_target.asnumpy()[0, 4:8], np.zeros(4), atol=1e-5)
+
+
+def test_beam_search_step():
+    def beam_search_step_npy(logprob, score, finished, beam_size, eos_id):
+        vocab = logprob.shape[1]
+        cand = score[:, None] + logprob
+        if eos_id >= 0:
+            ended = finished != 0
+            cand[ended] = -np.inf
+            cand[ended, eos_id] = score[ended]
+        cand = cand.reshape((-1, beam_size * vocab))
+        # np.argsort is not stable for equal scores, sorting by -score then index is
+        best = np.lexsort((np.tile(np.arange(cand.shape[1]), (cand.shape[0], 1)), -cand))
+        best = best[:, :beam_size]
+        out_score = cand[np.arange(cand.shape[0])[:, None], best].reshape(-1)
+        token = (best % vocab).reshape(-1)
+        parent = (best // vocab + np.arange(cand.shape[0])[:, None] * beam_size).reshape(-1)
+        ended = (finished[parent] != 0) | (token == eos_id) if eos_id >= 0 \
+            else np.zeros(token.shape, dtype=bool)
+        return out_score, token, parent, ended.astype(np.float32)
+
+    for batch, beam_size, vocab, eos_id in [(2, 3, 10, 1), (3, 4, 1300, 7), (1, 1, 600, -1)]:
+        rows = batch * beam_size
+        logprob = np.log(np.random.uniform(0.01, 1, (rows, vocab))).astype(np.float32)
+        score = np.random.uniform(-5, 0, (rows,)).astype(np.float32)
+        finished = (np.random.uniform(size=(rows,)) < 0.3).astype(np.float32)
+        outs = mx.nd.contrib.beam_search_step(mx.nd.array(logprob, ctx=default_context()),
+                                              mx.nd.array(score, ctx=default_context()),
+                                              mx.nd.array(finished, ctx=default_context()),
+                                              beam_size=beam_size, eos_id=eos_id)
+        expected = beam_search_step_npy(logprob, score, finished, beam_size, eos_id)
+        assert_almost_equal(outs[0].asnumpy(), expected[0], rtol=1e-5, atol=1e-5)
+        for out, exp in zip(outs[1:], expected[1:]):
+            assert same(out.asnumpy(), exp)
+
+
+def test_compact_bilinear():
+    # the operator and the cpu count sketch only run on cpu
+    ctx = mx.cpu()
+    def compact_bilinear_npy(x, y, h1, s1, h2, s2, out_dim):
+        pooled = np.einsum('nip,njp->nij', x.reshape(x.shape[:2] + (-1,)),
+                           y.reshape(y.shape[:2] + (-1,)))
+        out = np.zeros((x.shape[0], out_dim))
+        bins = (h1[:, None] + h2[None, :]) % out_dim
+        sign = s1[:, None] * s2[None, :]
+        for n in range(x.shape[0]):
+            np.add.at(out[n], bins, sign * pooled[n])
+        return out
+
+    for shape1, shape2, out_dim in [((2, 5), (2, 7), 16), ((3, 40, 2, 3), (3, 9, 2, 3), 64)]:
+        x = np.random.normal(size=shape1)
+        y = np.random.normal(size=shape2)
+        h1 = np.random.randint(0, out_dim, shape1[1])
+        h2 = np.random.randint(0, out_dim, shape2[1])
+        s1 = np.random.randint(0, 2, shape1[1]) * 2 - 1
+        s2 = np.random.randint(0, 2, shape2[1]) * 2 - 1
+        out = mx.nd.contrib.compact_bilinear(*[mx.nd.array(a, ctx=ctx) for a in
+                                               (x, y, h1, s1, h2, s2)], out_dim=out_dim)
+        assert_almost_equal(out.asnumpy(), compact_bilinear_npy(x, y, h1, s1, h2, s2, out_dim),
+                            rtol=1e-3, atol=1e-4)
+        sym = mx.sym.contrib.compact_bilinear(out_dim=out_dim, name='cbp')
+        location = {'cbp_data1': x, 'cbp_data2': y, 'cbp_h1': h1, 'cbp_s1': s1,
+                    'cbp_h2': h2, 'cbp_s2': s2}
+        check_numeric_gradient(sym, location, grad_nodes=['cbp_data1', 'cbp_data2'],
+                               numeric_eps=1e-2, rtol=5e-2, atol=1e-2, ctx=ctx)
+
+    # the cpu count sketch
+    n, in_dim, out_dim = 4, 30, 8
+    x = np.random.normal(size=(n, in_dim))
+    h = np.random.randint(0, out_dim, (1, in_dim))
+    s = np.random.randint(0, 2, (1, in_dim)) * 2 - 1
+    out = mx.nd.contrib.count_sketch(mx.nd.array(x, ctx=ctx), mx.nd.array(h, ctx=ctx),
+                                     mx.nd.array(s, ctx=ctx), out_dim=out_dim)
+    expected = np.zeros((n, out_dim))
+    for i in range(in_dim):
+        expected[:, h[0, i]] += x[:, i] * s[0, i]
+    assert_almost_equal(out.asnumpy(), expected, rtol=1e-3, atol=1e-4)
+
+
+def test_tensor_stats():
+    ctx = default_context()
+    for shape in [(1,), (7,), (30, 50), (3, 4, 5, 6)]:
+        for dtype in [np.float32, np.float64, np.int32]:
+            x = np.random.uniform(-10, 10, shape).astype(dtype)
+            out = mx.nd.contrib.tensor_stats(mx.nd.array(x, ctx=ctx, dtype=dtype)).asnumpy()
+            x = x.astype(np.float64)
+            expected = [np.sqrt(np.sum(x * x)), np.mean(x), np.max(np.abs(x)), 0, 0]
+            assert_almost_equal(out, np.array(expected), rtol=1e-4, atol=1e-4)
+    # the norm and the mean only count the finite elements
+    x = np.array([[1, -3, np.nan], [np.inf, -np.inf, 2]], dtype=np.float32)
+    out = mx.nd.contrib.tensor_stats(mx.nd.array(x, ctx=ctx)).asnumpy()
+    assert_almost_equal(out, np.array([np.sqrt(14), 0, 3, 1, 2]), rtol=1e-5, atol=1e-5)
+
 
 if __name__ == '__main__':
     import nose
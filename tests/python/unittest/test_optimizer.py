@@ -15,6 +15,7 @@
 # specific language governing permissions and limitations
 # under the License.
 
+import os
 import numpy as np
 import mxnet as mx
 import math
@@ -407,7 +408,111 @@ def test_rms():
     for kwarg in kwargs:
         compare_optimizer(opt1(**kwarg), opt2(**kwarg), shape, np.float32)
 
+def test_multi_precision_adam_rms():
+    # the float16 updates with master weights follow the float32 updates
+    mx.random.seed(0)
+    shape = (3, 4, 5)
+    configs = [(mx.optimizer.Adam, {'clip_gradient': 0.4, 'wd': 0.03}),
+               (mx.optimizer.RMSProp, {'rescale_grad': 0.8, 'clip_weights': 0.5}),
+               (mx.optimizer.RMSProp, {'centered': True, 'wd': 0.05})]
+    for opt, kwargs in configs:
+        opt32, opt16 = opt(**kwargs), opt(multi_precision=True, **kwargs)
+        w32 = mx.random.uniform(shape=shape, ctx=default_context())
+        w16 = w32.astype(np.float16)
+        w32 = w16.astype(np.float32)
+        state32, state16 = opt32.create_state(0, w32), opt16.create_state(0, w16)
+        assert len(state16) == len(state32) + 1
+        for _ in range(3):
+            g16 = mx.random.uniform(-1, 1, shape=shape, ctx=default_context()).astype(np.float16)
+            opt32.update(0, w32, g16.astype(np.float32), state32)
+            opt16.update(0, w16, g16, state16)
+            assert w16.dtype == np.float16
+            assert_almost_equal(state16[-1].asnumpy(), w32.asnumpy(), rtol=1e-5, atol=1e-6)
+            assert_almost_equal(w16.asnumpy(), w32.asnumpy().astype(np.float16),
+                                rtol=1e-3, atol=1e-3)
+
+def test_lars_lamb():
+    # the layer-wise updates against numpy, with weights of several norm chunks
+    mx.random.seed(0)
+    shapes = [(40, 50), (5,), (3, 4, 5)]
+    rescale_grad, clip_gradient, wd, lr = 0.8, 0.5, 0.01, 0.1
+
+    def trust(w_norm, d_norm, ratio):
+        return ratio if w_norm > 0 and d_norm > 0 else 1.
+
+    for name in ['lars', 'lamb']:
+        if name == 'lars':
+            opt = mx.optimizer.LARS(momentum=0.9, eta=0.01, learning_rate=lr, wd=wd,
+                                    rescale_grad=rescale_grad, clip_gradient=clip_gradient)
+        else:
+            opt = mx.optimizer.LAMB(learning_rate=lr, wd=wd, rescale_grad=rescale_grad,
+                                    clip_gradient=clip_gradient)
+        updater = mx.optimizer.get_updater(opt)
+        weights = [mx.random.uniform(-1, 1, shape=s, ctx=default_context()) for s in shapes]
+        ref = [w.asnumpy().astype(np.float64) for w in weights]
+        states = [[np.zeros(s), np.zeros(s)] for s in shapes]
+        for t in range(1, 3):
+            grads = [mx.random.uniform(-1, 1, shape=s, ctx=default_context()) for s in shapes]
+            updater.update_multi(list(range(len(shapes))), grads, weights)
+            for w, g, st in zip(ref, grads, states):
+                g = np.clip(rescale_grad * g.asnumpy(), -clip_gradient, clip_gradient)
+                w_norm = np.linalg.norm(w)
+                if name == 'lars':
+                    g_norm = np.linalg.norm(g)
+                    local_lr = lr * trust(w_norm, g_norm,
+                                          0.01 * w_norm / (g_norm + wd * w_norm + 1e-8))
+                    st[0][:] = 0.9 * st[0] - local_lr * (g + wd * w)
+                    w += st[0]
+                else:
+                    st[0][:] = 0.9 * st[0] + 0.1 * g
+                    st[1][:] = 0.999 * st[1] + 0.001 * g * g
+                    r = (st[0] / (1 - 0.9**t)) / (np.sqrt(st[1] / (1 - 0.999**t)) + 1e-6) + wd * w
+                    r_norm = np.linalg.norm(r)
+                    w -= lr * trust(w_norm, r_norm, w_norm / r_norm) * r
+            for w, r in zip(weights, ref):
+                assert_almost_equal(w.asnumpy(), r, rtol=1e-4, atol=1e-5)
+
+def test_update_multi():
+    # the multi-tensor updates match the updates of each weight
+    mx.random.seed(0)
+    shapes = [(3, 4), (5,), (2, 3, 2), (1,), (7, 2), (4,), (6, 1)]
+    configs = [(mx.optimizer.SGD, {'momentum': 0.0}, np.float32),
+               (mx.optimizer.SGD, {'momentum': 0.9, 'clip_gradient': 0.3, 'wd': 0.01},
+                np.float32),
+               (mx.optimizer.SGD, {'momentum': 0.0, 'multi_precision': True}, np.float16),
+               (mx.optimizer.SGD, {'momentum': 0.9, 'multi_precision': True, 'wd': 0.02},
+                np.float16),
+               (mx.optimizer.Adam, {'rescale_grad': 0.5, 'wd': 0.01}, np.float32),
+               (mx.optimizer.Adam, {'clip_gradient': 0.2}, np.float64),
+               (mx.optimizer.NAG, {'momentum': 0.9}, np.float32)]
+    os.environ['MXNET_OPTIMIZER_AGGREGATION_SIZE'] = '3'
+    try:
+        for opt, kwargs, dtype in configs:
+            opt1, opt2 = opt(**kwargs), opt(**kwargs)
+            lr_mult = {i: 1.0 + 0.5 * i for i in range(len(shapes))}
+            opt1.set_lr_mult(lr_mult)
+            opt2.set_lr_mult(lr_mult)
+            upd1, upd2 = mx.optimizer.get_updater(opt1), mx.optimizer.get_updater(opt2)
+            w1 = [mx.random.uniform(shape=s, ctx=default_context()).astype(dtype)
+                  for s in shapes]
+            w2 = [w.copy() for w in w1]
+            for _ in range(2):
+                grads = [mx.random.uniform(-1, 1, shape=s, ctx=default_context()).astype(dtype)
+                         for s in shapes]
+                for i, (g, w) in enumerate(zip(grads, w1)):
+                    upd1(i, g, w)
+                upd2.update_multi(list(range(len(shapes))), grads, w2)
+            rtol = 1e-2 if dtype == np.float16 else 1e-5
+            for a, b in zip(w1, w2):
+                assert a.dtype == b.dtype
+                assert_almost_equal(a.asnumpy(), b.asnumpy(), rtol=rtol, atol=rtol)
+    finally:
+        del os.environ['MXNET_OPTIMIZER_AGGREGATION_SIZE']
+
 if __name__ == '__main__':
     test_adam()
     test_rms()
     test_sgd()
+    test_update_multi()
+    test_multi_precision_adam_rms()
+    test_lars_lamb()
@@ -60,5 +60,101 @@ def test_profiler():
     print('duration: {0}s'.format(duration))
     print('          {0}ms/operator'.format(duration*1000/iter_num))
 
+def test_profiler_aggregate():
+    profiler.profiler_set_config(mode='all', filename='test_profile_aggregate.txt',
+                                 aggregate=True)
+    profiler.profiler_set_state('run')
+    a = mx.nd.ones((16, 16))
+    for _ in range(10):
+        a = a + 1
+    a.wait_to_read()
+    profiler.profiler_set_state('stop')
+    table = profiler.dumps(reset=True)
+    profiler.profiler_set_config(mode='symbolic', filename='profile.json', aggregate=False)
+    lines = [l.split() for l in table.splitlines()]
+    assert any(l[0] == 'Device' and l[1] == 'cpu/0' for l in lines if l)
+    row = [l for l in lines if l and l[0] == '_plus_scalar']
+    assert len(row) == 1 and int(row[0][1]) == 10, table
+    # the statistics are cleared by the reset
+    assert '_plus_scalar' not in profiler.dumps()
+
+def test_profiler_ring_buffer():
+    import json
+    profiler.profiler_set_config(mode='all', filename='profile.json')
+    profiler.set_ring_buffer(8)
+    profiler.profiler_set_state('run')
+    a = mx.nd.ones((16, 16))
+    for _ in range(20):
+        a = a + 1
+    a.wait_to_read()
+    filename = 'test_profile_ring.json'
+    profiler.dump_ring(filename)
+    profiler.profiler_set_state('stop')
+    profiler.set_ring_buffer(0)
+    with open(filename) as f:
+        events = [e for e in json.load(f)['traceEvents'] if e['ph'] == 'B']
+    # the rings only keep the last events of each thread
+    names = [e['name'] for e in events]
+    assert 0 < names.count('_plus_scalar') <= 16, names
+
+def test_profiler_memory():
+    import json
+    filename = 'test_profile_memory.json'
+    profiler.profiler_set_config(mode='all', filename=filename, memory=True)
+    profiler.profiler_set_state('run')
+    data = mx.sym.Variable('data')
+    net = mx.sym.FullyConnected(data, num_hidden=64, name='fc')
+    exe = net.simple_bind(mx.cpu(), data=(32, 128))
+    exe.forward(is_train=False)
+    exe.outputs[0].wait_to_read()
+    profiler.profiler_set_state('stop')
+    profiler.dump_profile()
+    profiler.profiler_set_config(mode='symbolic', filename='profile.json', memory=False)
+    with open(filename) as f:
+        events = json.load(f)['traceEvents']
+    allocs = [e for e in events if e['name'] == 'Alloc']
+    assert any(e['args']['scope'] == 'GraphExecutor::Bind' for e in allocs)
+    assert any(e['name'] == 'memory_in_use' and e['ph'] == 'C' for e in events)
+
+def test_profiler_scheduling():
+    import json
+    filename = 'test_profile_scheduling.json'
+    profiler.profiler_set_config(mode='all', filename=filename)
+    profiler.profiler_set_state('run')
+    a = mx.nd.ones((64, 64))
+    for _ in range(10):
+        a = mx.nd.dot(a, a) / 64
+    a.wait_to_read()
+    profiler.profiler_set_state('stop')
+    profiler.dump_profile()
+    profiler.profiler_set_config(mode='symbolic', filename='profile.json')
+    with open(filename) as f:
+        events = json.load(f)['traceEvents']
+    dots = [e for e in events if e['name'] == 'dot' and e['ph'] == 'B']
+    assert len(dots) == 10
+    for e in dots:
+        assert set(e['args']) == set(['deps_wait_us', 'queue_wait_us', 'launch_us'])
+    assert any(e['name'] == 'queue_depth' and e['ph'] == 'C' for e in events)
+
+def test_profiler_temp_space():
+    profiler.profiler_set_config(mode='all', filename='test_profile_temp_space.txt',
+                                 aggregate=True)
+    profiler.profiler_set_state('run')
+    for n in [100, 1000]:
+        mx.nd.topk(mx.nd.ones((n,)), k=2).wait_to_read()
+    profiler.profiler_set_state('stop')
+    table = profiler.dumps(reset=True)
+    profiler.profiler_set_config(mode='symbolic', filename='profile.json', aggregate=False)
+    temp = table[table.index('Temp space of device'):]
+    row = [l.split() for l in temp.splitlines() if l.startswith('topk')][0]
+    assert int(row[1]) == 2, table
+    # the workspace of topk is 3 floats per value
+    assert float(row[3]) >= 1000 * 3 * 4 / 1024.0, table
+
 if __name__ == '__main__':
     test_profiler()
+    test_profiler_aggregate()
+    test_profiler_ring_buffer()
+    test_profiler_memory()
+    test_profiler_scheduling()
+    test_profiler_temp_space()
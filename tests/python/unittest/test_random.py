@@ -50,70 +50,69 @@ def check_with_device(device, dtype):
             ]
         }
     ]
-    if device.device_type == 'cpu':
-        symbols.extend([
-            {
-                'name': 'gamma',
-                'symbol': mx.sym.random_gamma,
-                'multisymbol': mx.sym.sample_gamma,
-                'ndop': mx.random.gamma,
-                'params': { 'alpha': 9.0, 'beta': 0.5 },
-                'inputs': [ ('alpha', [ [ 0.0, 2.5 ], [ 9.75, 11.0 ] ]) , ('beta', [ [ 1.0, 0.7 ], [ 0.5, 0.3 ] ]) ],
-                'checks': [
-                    ('mean', lambda x, params: np.mean(x.astype(np.float64)) - params['alpha'] * params['beta'], tol),
-                    ('std', lambda x, params: np.std(x.astype(np.float64)) - np.sqrt(params['alpha'] * params['beta'] ** 2), tol)
-                ]
-            },
-            {
-                'name': 'exponential',
-                'symbol': mx.sym.random_exponential,
-                'multisymbol': mx.sym.sample_exponential,
-                'ndop': mx.random.exponential,
-                'params': { 'lam': 4.0 },
-                'inputs': [ ('lam', [ [ 1.0, 8.5 ], [ 2.7 , 0.5 ] ]) ],
-                'checks': [
-                    ('mean', lambda x, params: np.mean(x.astype(np.float64)) - 1.0 / params['lam'], tol),
-                    ('std', lambda x, params: np.std(x.astype(np.float64)) - 1.0 / params['lam'], tol)
-                ]
-            },
-            {
-                'name': 'poisson',
-                'symbol': mx.sym.random_poisson,
-                'ndop': mx.random.poisson,
-                'multisymbol': mx.sym.sample_poisson,
-                'params': { 'lam': 4.0 },
-                'inputs': [ ('lam', [ [ 1.0, 8.5 ], [ 2.7 , 0.5 ] ]) ],
-                'checks': [
-                    ('mean', lambda x, params: np.mean(x.astype(np.float64)) - params['lam'], tol),
-                    ('std', lambda x, params: np.std(x.astype(np.float64)) - np.sqrt(params['lam']), tol)
-                ]
-            },
-            {
-                'name': 'neg-binomial',
-                'symbol': mx.sym.random_negative_binomial,
-                'multisymbol': mx.sym.sample_negative_binomial,
-                'ndop': mx.random.negative_binomial,
-                'params': { 'k': 3, 'p': 0.4 },
-                'inputs': [ ('k', [ [ 20, 49 ], [ 15 , 16 ] ]) , ('p', [ [ 0.4 , 0.77 ], [ 0.5, 0.84 ] ]) ],
-                'checks': [
-                    ('mean', lambda x, params: np.mean(x.astype(np.float64)) - params['k'] * (1.0 - params['p']) /  params['p'], tol),
-                    ('std', lambda x, params: np.std(x.astype(np.float64)) - np.sqrt(params['k'] * (1.0 - params['p']))/params['p'], tol)
-                ]
-            },
-            {
-                'name': 'gen-neg-binomial',
-                'symbol': mx.sym.random_generalized_negative_binomial,
-                'multisymbol': mx.sym.sample_generalized_negative_binomial,
-                'ndop': mx.random.generalized_negative_binomial,
-                'params': { 'mu': 2.0, 'alpha': 0.3 },
-                'inputs': [ ('mu', [ [ 2.0, 2.5 ], [ 1.3, 1.9 ] ]) , ('alpha', [ [ 1.0, 0.1 ], [ 0.2, 0.5 ] ]) ],
-                'checks': [
-                    ('mean', lambda x, params: np.mean(x.astype(np.float64)) - params['mu'], tol),
-                    ('std', lambda x, params: np.std(x.astype(np.float64)) - np.sqrt(params['mu'] + params['alpha'] * params['mu'] ** 2 ), tol)
-                ]
-            }
-
-        ])
+    symbols.extend([
+        {
+            'name': 'gamma',
+            'symbol': mx.sym.random_gamma,
+            'multisymbol': mx.sym.sample_gamma,
+            'ndop': mx.random.gamma,
+            'params': { 'alpha': 9.0, 'beta': 0.5 },
+            'inputs': [ ('alpha', [ [ 0.0, 2.5 ], [ 9.75, 11.0 ] ]) , ('beta', [ [ 1.0, 0.7 ], [ 0.5, 0.3 ] ]) ],
+            'checks': [
+                ('mean', lambda x, params: np.mean(x.astype(np.float64)) - params['alpha'] * params['beta'], tol),
+                ('std', lambda x, params: np.std(x.astype(np.float64)) - np.sqrt(params['alpha'] * params['beta'] ** 2), tol)
+            ]
+        },
+        {
+            'name': 'exponential',
+            'symbol': mx.sym.random_exponential,
+            'multisymbol': mx.sym.sample_exponential,
+            'ndop': mx.random.exponential,
+            'params': { 'lam': 4.0 },
+            'inputs': [ ('lam', [ [ 1.0, 8.5 ], [ 2.7 , 0.5 ] ]) ],
+            'checks': [
+                ('mean', lambda x, params: np.mean(x.astype(np.float64)) - 1.0 / params['lam'], tol),
+                ('std', lambda x, params: np.std(x.astype(np.float64)) - 1.0 / params['lam'], tol)
+            ]
+        },
+        {
+            'name': 'poisson',
+            'symbol': mx.sym.random_poisson,
+            'ndop': mx.random.poisson,
+            'multisymbol': mx.sym.sample_poisson,
+            'params': { 'lam': 4.0 },
+            'inputs': [ ('lam', [ [ 1.0, 8.5 ], [ 2.7 , 0.5 ] ]) ],
+            'checks': [
+                ('mean', lambda x, params: np.mean(x.astype(np.float64)) - params['lam'], tol),
+                ('std', lambda x, params: np.std(x.astype(np.float64)) - np.sqrt(params['lam']), tol)
+            ]
+        },
+        {
+            'name': 'neg-binomial',
+            'symbol': mx.sym.random_negative_binomial,
+            'multisymbol': mx.sym.sample_negative_binomial,
+            'ndop': mx.random.negative_binomial,
+            'params': { 'k': 3, 'p': 0.4 },
+            'inputs': [ ('k', [ [ 20, 49 ], [ 15 , 16 ] ]) , ('p', [ [ 0.4 , 0.77 ], [ 0.5, 0.84 ] ]) ],
+            'checks': [
+                ('mean', lambda x, params: np.mean(x.astype(np.float64)) - params['k'] * (1.0 - params['p']) /  params['p'], tol),
+                ('std', lambda x, params: np.std(x.astype(np.float64)) - np.sqrt(params['k'] * (1.0 - params['p']))/params['p'], tol)
+            ]
+        },
+        {
+            'name': 'gen-neg-binomial',
+            'symbol': mx.sym.random_generalized_negative_binomial,
+            'multisymbol': mx.sym.sample_generalized_negative_binomial,
+            'ndop': mx.random.generalized_negative_binomial,
+            'params': { 'mu': 2.0, 'alpha': 0.3 },
+            'inputs': [ ('mu', [ [ 2.0, 2.5 ], [ 1.3, 1.9 ] ]) , ('alpha', [ [ 1.0, 0.1 ], [ 0.2, 0.5 ] ]) ],
+            'checks': [
+                ('mean', lambda x, params: np.mean(x.astype(np.float64)) - params['mu'], tol),
+                ('std', lambda x, params: np.std(x.astype(np.float64)) - np.sqrt(params['mu'] + params['alpha'] * params['mu'] ** 2 ), tol)
+            ]
+        }
+
+    ])
 
     shape = (100, 100)
     for symbdic in symbols:
@@ -127,7 +126,7 @@ def check_with_device(device, dtype):
         ret1 = ndop(**params).asnumpy()
         mx.random.seed(128)
         ret2 = ndop(**params).asnumpy()
-        assert device.device_type == 'gpu' or same(ret1, ret2), \
+        assert same(ret1, ret2), \
                 "ndarray test: `%s` should give the same result with the same seed" % name
 
         for check_name, check_func, tol in symbdic['checks']:
@@ -150,7 +149,7 @@ def check_with_device(device, dtype):
         mx.random.seed(128)
         yexec.forward()
         un2 = (yexec.outputs[0] - x).copyto(device)
-        assert device.device_type == 'gpu' or same(un1.asnumpy(), un2.asnumpy()), \
+        assert same(un1.asnumpy(), un2.asnumpy()), \
                 "symbolic test: `%s` should give the same result with the same seed" % name
 
         ret1 = un1.asnumpy()
@@ -211,6 +210,38 @@ def test_sample_multinomial():
         mx.test_utils.assert_almost_equal(real_dx, dx.asnumpy()[i])
 
 
+def test_sample_multinomial_large():
+    # the cdf of a row spans several scan blocks, and outcomes of zero probability are never drawn
+    k = 3000
+    x = np.zeros((2, k))
+    x[0, [10, 1500, 2999]] = [0.2, 0.3, 0.5]
+    x[1, [0, 1023, 1024]] = [0.5, 0.25, 0.25]
+    y = mx.nd.sample_multinomial(mx.nd.array(x), shape=5000).asnumpy()
+    for i in range(x.shape[0]):
+        assert (x[i][y[i]] > 0).all()
+        freq = np.bincount(y[i], minlength=k) / 5000.0
+        mx.test_utils.assert_almost_equal(freq, x[i], rtol=0.1, atol=0.02)
+
+def test_random_copies():
+    # the samplers draw from the copies of the generators in turn, the
+    # counter-based ones and the ones of the multi-distribution samplers
+    def draw():
+        mx.random.seed(42)
+        low, high = mx.nd.zeros((100,)), mx.nd.ones((100,))
+        return [mx.nd.random_uniform(shape=(100,)).asnumpy() for _ in range(8)] + \
+               [mx.nd.sample_uniform(low, high).asnumpy() for _ in range(8)]
+    first = draw()
+    second = draw()
+    for a, b in zip(first, second):
+        assert same(a, b)
+    for i in range(8):
+        for j in range(i):
+            assert not same(first[i], first[j])
+            assert not same(first[8 + i], first[8 + j])
+
+
 if __name__ == '__main__':
     test_random()
     test_sample_multinomial()
+    test_sample_multinomial_large()
+    test_random_copies()
@@ -296,6 +296,58 @@ def test_convgru():
     args, outs, auxs = outputs.infer_shape(rnn_t0_data=(1, 3, 16, 10), rnn_t1_data=(1, 3, 16, 10), rnn_t2_data=(1, 3, 16, 10))
     assert outs == [(1, 10, 16, 10), (1, 10, 16, 10), (1, 10, 16, 10)]
 
+def check_rnn_consistency(cell1, cell2, dshape=(4, 3, 8)):
+    """Compares the outputs and the input gradients of two cells on the cpu,
+    with the weights of cell1 packed for cell2."""
+    data = mx.sym.Variable('data')
+    sym1, _ = cell1.unroll(dshape[1], data, merge_outputs=True)
+    sym2, _ = cell2.unroll(dshape[1], data, merge_outputs=True)
+    mods = []
+    for sym in [sym1, sym2]:
+        mod = mx.mod.Module(sym, label_names=None, context=mx.cpu())
+        mod.bind(data_shapes=[('data', dshape)], label_shapes=None,
+                 inputs_need_grad=True)
+        mods.append(mod)
+
+    mods[0].init_params()
+    args, auxs = mods[0].get_params()
+    args = cell1.unpack_weights(args)
+    args = cell2.pack_weights(args)
+    mods[1].set_params(args, auxs)
+
+    batch = mx.io.DataBatch(data=[mx.random.uniform(shape=dshape)], label=[])
+    outputs = []
+    for mod in mods:
+        mod.forward(batch, is_train=True)
+        out = mod.get_outputs()[0]
+        mod.backward([mx.nd.ones(out.shape)])
+        outputs.append((out.asnumpy(), mod.get_input_grads()[0].asnumpy()))
+    assert_allclose(outputs[0][0], outputs[1][0], rtol=1e-4, atol=1e-5)
+    assert_allclose(outputs[0][1], outputs[1][1], rtol=1e-4, atol=1e-5)
+
+
+def test_fused_cpu():
+    cells = {'rnn_relu': lambda p: mx.rnn.RNNCell(6, activation='relu', prefix=p),
+             'rnn_tanh': lambda p: mx.rnn.RNNCell(6, activation='tanh', prefix=p),
+             'lstm': lambda p: mx.rnn.LSTMCell(6, prefix=p),
+             'gru': lambda p: mx.rnn.GRUCell(6, prefix=p)}
+    for mode, cell in cells.items():
+        fused = mx.rnn.FusedRNNCell(6, num_layers=2, mode=mode, prefix='')
+        stack = mx.rnn.SequentialRNNCell()
+        stack.add(cell('l0_'))
+        stack.add(cell('l1_'))
+        check_rnn_consistency(fused, stack)
+        check_rnn_consistency(stack, fused)
+
+        fused = mx.rnn.FusedRNNCell(6, num_layers=2, mode=mode, prefix='',
+                                    bidirectional=True)
+        stack = mx.rnn.SequentialRNNCell()
+        stack.add(mx.rnn.BidirectionalCell(cell('l0_'), cell('r0_'), output_prefix='bi_l0_'))
+        stack.add(mx.rnn.BidirectionalCell(cell('l1_'), cell('r1_'), output_prefix='bi_l1_'))
+        check_rnn_consistency(fused, stack)
+        check_rnn_consistency(stack, fused)
+
+
 if __name__ == '__main__':
     import nose
     nose.runmodule()
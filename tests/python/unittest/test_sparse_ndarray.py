@@ -0,0 +1,140 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+import os
+import mxnet as mx
+import numpy as np
+from mxnet.test_utils import *
+
+
+def rand_sparse(shape, density=0.3):
+    dns = np.random.uniform(-1, 1, shape).astype(np.float32)
+    dns[np.random.uniform(0, 1, shape) > density] = 0
+    return dns
+
+
+def test_cast_storage():
+    for stype in ['row_sparse', 'csr']:
+        dns = rand_sparse((5, 4))
+        sp = mx.nd.array(dns).tostype(stype)
+        assert sp.stype == stype
+        assert_almost_equal(sp.asnumpy(), dns)
+        assert_almost_equal(mx.nd.cast_storage(sp, stype='default').asnumpy(), dns)
+    dns = np.zeros((4, 3), dtype=np.float32)
+    dns[[0, 2]] = 1
+    rsp = mx.nd.array(dns).tostype('row_sparse')
+    assert_almost_equal(rsp.indices.asnumpy(), np.array([0, 2]))
+    assert_almost_equal(rsp.data.asnumpy(), np.ones((2, 3)))
+
+
+def test_sparse_constructors():
+    csr = mx.sparse_nd.csr_matrix([1, 2, 3], [1, 0, 2], [0, 1, 1, 3], (3, 3))
+    assert_almost_equal(csr.asnumpy(), np.array([[0, 1, 0], [0, 0, 0], [2, 0, 3]]))
+    assert_almost_equal(csr.indptr.asnumpy(), np.array([0, 1, 1, 3]))
+    rsp = mx.sparse_nd.row_sparse_array([[1, 2]], [1], (3, 2))
+    assert_almost_equal(rsp.asnumpy(), np.array([[0, 0], [1, 2], [0, 0]]))
+    for stype in ['row_sparse', 'csr']:
+        zeros = mx.sparse_nd.zeros(stype, (3, 2))
+        assert zeros.stype == stype
+        assert_almost_equal(zeros.asnumpy(), np.zeros((3, 2)))
+
+
+def test_sparse_dot():
+    lhs = rand_sparse((6, 5))
+    rhs = np.random.uniform(-1, 1, (5, 3)).astype(np.float32)
+    csr = mx.nd.array(lhs).tostype('csr')
+    out = mx.nd.dot(csr, mx.nd.array(rhs))
+    assert out.stype == 'default'
+    assert_almost_equal(out.asnumpy(), np.dot(lhs, rhs), rtol=1e-4)
+    rhs_t = np.random.uniform(-1, 1, (6, 3)).astype(np.float32)
+    out = mx.nd.dot(csr, mx.nd.array(rhs_t), transpose_a=True)
+    assert_almost_equal(out.asnumpy(), np.dot(lhs.T, rhs_t), rtol=1e-4)
+
+
+def test_sparse_dot_grad():
+    lhs = rand_sparse((6, 5))
+    lhs[:, 1] = 0
+    rhs = np.random.uniform(-1, 1, (5, 3)).astype(np.float32)
+    ograd = np.random.uniform(-1, 1, (6, 3)).astype(np.float32)
+    data = mx.sym.Variable('data')
+    weight = mx.sym.Variable('weight')
+    out = mx.sym.dot(data, weight)
+    rsp_grad = mx.nd.array(rhs).tostype('row_sparse')
+    exe = out.bind(mx.cpu(), args={'data': mx.nd.array(lhs).tostype('csr'),
+                                   'weight': mx.nd.array(rhs)},
+                   args_grad={'weight': rsp_grad}, grad_req={'data': 'null', 'weight': 'write'})
+    exe.forward(is_train=True)
+    exe.backward([mx.nd.array(ograd)])
+    assert rsp_grad.stype == 'row_sparse'
+    assert 1 not in rsp_grad.indices.asnumpy()
+    assert_almost_equal(rsp_grad.asnumpy(), np.dot(lhs.T, ograd), rtol=1e-4)
+
+
+def test_sparse_embedding():
+    weight = rand_sparse((10, 4), density=0.5)
+    idx = np.array([[1, 3], [9, 0]], dtype=np.float32)
+    rsp = mx.nd.array(weight).tostype('row_sparse')
+    out = mx.nd.Embedding(mx.nd.array(idx), rsp, input_dim=10, output_dim=4)
+    assert_almost_equal(out.asnumpy(), weight[idx.astype(np.int32)])
+    out = mx.nd.take(rsp, mx.nd.array(idx))
+    assert_almost_equal(out.asnumpy(), weight[idx.astype(np.int32)])
+
+
+def test_sparse_embedding_grad():
+    idx = np.array([1, 3, 1, 7], dtype=np.float32)
+    ograd = np.random.uniform(-1, 1, (4, 5)).astype(np.float32)
+    data = mx.sym.Variable('data')
+    embed = mx.sym.Embedding(data, input_dim=10, output_dim=5, sparse_grad=True, name='embed')
+    grad = mx.sparse_nd.zeros('row_sparse', (10, 5))
+    exe = embed.bind(mx.cpu(), args={'data': mx.nd.array(idx),
+                                     'embed_weight': mx.nd.ones((10, 5))},
+                     args_grad={'embed_weight': grad},
+                     grad_req={'data': 'null', 'embed_weight': 'write'})
+    exe.forward(is_train=True)
+    exe.backward([mx.nd.array(ograd)])
+    expected = np.zeros((10, 5), dtype=np.float32)
+    for i, j in enumerate(idx.astype(np.int32)):
+        expected[j] += ograd[i]
+    assert_almost_equal(grad.indices.asnumpy(), np.array([1, 3, 7]))
+    assert_almost_equal(grad.asnumpy(), expected, rtol=1e-5)
+
+
+def test_sparse_one_hot():
+    idx = np.array([1, 5, 2, -1, 0], dtype=np.float32)
+    out = mx.nd.one_hot(mx.nd.array(idx), depth=3, on_value=2, stype='csr')
+    assert out.stype == 'csr'
+    assert_almost_equal(out.indptr.asnumpy(), np.array([0, 1, 1, 2, 2, 3]))
+    assert_almost_equal(out.asnumpy(), mx.nd.one_hot(mx.nd.array(idx), depth=3,
+                                                     on_value=2).asnumpy())
+
+
+def test_sparse_save_load():
+    fname = 'tmp_sparse.params'
+    arrays = {'rsp': mx.nd.array(rand_sparse((5, 3))).tostype('row_sparse'),
+              'csr': mx.nd.array(rand_sparse((4, 6))).tostype('csr'),
+              'dns': mx.nd.array(rand_sparse((2, 2)))}
+    mx.nd.save(fname, arrays)
+    loaded = mx.nd.load(fname)
+    os.remove(fname)
+    for k, v in arrays.items():
+        assert loaded[k].stype == v.stype
+        assert_almost_equal(loaded[k].asnumpy(), v.asnumpy())
+
+
+if __name__ == '__main__':
+    import nose
+    nose.runmodule()
@@ -224,6 +224,31 @@ def test_zero_prop():
     assert big > small2
     assert small1 == small2
 
+def test_zero_prop_layers():
+    data = mx.sym.Variable('data')
+    for i in range(4):
+        data = mx.sym.FullyConnected(data, num_hidden=1024, name='fc%d' % i)
+        data = mx.sym.Activation(data, act_type='relu', name='relu%d' % i)
+
+    exe = data.simple_bind(ctx=mx.cpu(), data=(256, 1024))
+    big = int(re.search('Total (\d+) MB allocated', exe.debug_str()).group(1))
+
+    exe = data.simple_bind(ctx=mx.cpu(), data=(256, 1024), grad_req='null')
+    small1 = int(re.search('Total (\d+) MB allocated', exe.debug_str()).group(1))
+
+    # the layers under the stop_gradient run no backward, their gradients are zero
+    data = mx.sym.stop_gradient(data)
+    exe = data.simple_bind(ctx=mx.cpu(), data=(256, 1024))
+    small2 = int(re.search('Total (\d+) MB allocated', exe.debug_str()).group(1))
+    assert '_backward_FullyConnected' not in exe.debug_str()
+
+    assert big > small2
+    assert small1 == small2
+    exe.forward(is_train=True)
+    exe.backward()
+    for grad in exe.grad_arrays:
+        assert (grad.asnumpy() == 0).all()
+
 def test_zero_prop2():
     x = mx.sym.Variable('x')
     idx = mx.sym.Variable('idx')
@@ -26,6 +26,7 @@
  *  Image List Format: unique-image-index label[s] path-to-image
  * \sa dmlc/recordio.h
  */
+#include <algorithm>
 #include <cctype>
 #include <cstring>
 #include <string>
@@ -34,6 +35,7 @@
 #include <sstream>
 #include <dmlc/base.h>
 #include <dmlc/io.h>
+#include <dmlc/omp.h>
 #include <dmlc/timer.h>
 #include <dmlc/logging.h>
 #include <dmlc/recordio.h>
@@ -60,34 +62,167 @@ int GetInterMethod(int inter_method, int old_width, int old_height, int new_widt
         return inter_method;
     }
 }
+/*! \brief the settings of the packing of an image */
+struct PackOptions {
+  std::string root;
+  int label_width = 1;
+  int pack_label = 0;
+  int new_size = -1;
+  int max_size = -1;
+  int center_crop = 0;
+  int color_mode = CV_LOAD_IMAGE_COLOR;
+  int unchanged = 0;
+  int inter_method = CV_INTER_LINEAR;
+  std::string encoding = ".jpg";
+  std::vector<int> encode_params;
+};
+
+/*!
+ * \brief read, resize and encode the image of a line of the list into the
+ *  content of its record
+ * \return false if the line has no image
+ */
+bool PackImage(const std::string& sline, const PackOptions& opt, std::mt19937* prnd,
+               uint64_t* image_id, std::string* blob) {
+  using dmlc::BeginPtr;
+  const static size_t kBufferSize = 1 << 20UL;
+  mxnet::io::ImageRecordIO rec;
+  std::istringstream is(sline);
+  if (!(is >> rec.header.image_id[0] >> rec.header.label)) return false;
+  *image_id = rec.header.image_id[0];
+  std::vector<float> label_buf(opt.label_width, 0.f);
+  label_buf[0] = rec.header.label;
+  for (int k = 1; k < opt.label_width; ++k) {
+    CHECK(is >> label_buf[k])
+        << "Invalid ImageList, did you provide the correct label_width?";
+  }
+  if (opt.pack_label) rec.header.flag = opt.label_width;
+  blob->clear();
+  rec.SaveHeader(blob);
+  if (opt.pack_label) {
+    size_t bsize = blob->size();
+    blob->resize(bsize + label_buf.size()*sizeof(float));
+    memcpy(BeginPtr(*blob) + bsize,
+           BeginPtr(label_buf), label_buf.size()*sizeof(float));
+  }
+  std::string fname;
+  CHECK(std::getline(is, fname));
+  // eliminate invalid chars in the end
+  while (fname.length() != 0 &&
+         (isspace(*fname.rbegin()) || !isprint(*fname.rbegin()))) {
+    fname.resize(fname.length() - 1);
+  }
+  // eliminate invalid chars in beginning.
+  const char *p = fname.c_str();
+  while (isspace(*p)) ++p;
+  std::string path = opt.root + p;
+  // use "r" is equal to rb in dmlc::Stream
+  dmlc::Stream *fi = dmlc::Stream::Create(path.c_str(), "r");
+  std::vector<unsigned char> decode_buf;
+  size_t imsize = 0;
+  while (true) {
+    decode_buf.resize(imsize + kBufferSize);
+    size_t nread = fi->Read(BeginPtr(decode_buf) + imsize, kBufferSize);
+    imsize += nread;
+    decode_buf.resize(imsize);
+    if (nread != kBufferSize) break;
+  }
+  delete fi;
+
+  if (opt.unchanged != 1) {
+    cv::Mat img = cv::imdecode(decode_buf, opt.color_mode);
+    CHECK(img.data != NULL) << "OpenCV decode fail:" << path;
+    cv::Mat res = img;
+    if (opt.new_size > 0) {
+      const int new_size = opt.new_size;
+      if (opt.center_crop) {
+        if (img.rows > img.cols) {
+          int margin = (img.rows - img.cols)/2;
+          img = img(cv::Range(margin, margin+img.cols), cv::Range(0, img.cols));
+        } else {
+          int margin = (img.cols - img.rows)/2;
+          img = img(cv::Range(0, img.rows), cv::Range(margin, margin + img.rows));
+        }
+      }
+      int interpolation_method = 1;
+      if (img.rows > img.cols) {
+          if (img.cols != new_size) {
+              interpolation_method = GetInterMethod(opt.inter_method, img.cols, img.rows, new_size, img.rows * new_size / img.cols, *prnd);
+              cv::resize(img, res, cv::Size(new_size, img.rows * new_size / img.cols), 0, 0, interpolation_method);
+          } else {
+              res = img.clone();
+          }
+      } else {
+          if (img.rows != new_size) {
+              interpolation_method = GetInterMethod(opt.inter_method, img.cols, img.rows, new_size * img.cols / img.rows, new_size, *prnd);
+              cv::resize(img, res, cv::Size(new_size * img.cols / img.rows, new_size), 0, 0, interpolation_method);
+          } else {
+              res = img.clone();
+          }
+      }
+    }
+    // shrink the longer edge to max_size, keeping the aspect ratio
+    const int longer = std::max(res.rows, res.cols);
+    if (opt.max_size > 0 && longer > opt.max_size) {
+      const cv::Size size(std::max(1, res.cols * opt.max_size / longer),
+                          std::max(1, res.rows * opt.max_size / longer));
+      cv::Mat shrunk;
+      cv::resize(res, shrunk, size, 0, 0,
+                 GetInterMethod(opt.inter_method, res.cols, res.rows, size.width, size.height,
+                                *prnd));
+      res = shrunk;
+    }
+    std::vector<unsigned char> encode_buf;
+    CHECK(cv::imencode(opt.encoding, res, encode_buf, opt.encode_params));
+
+    // write buffer
+    size_t bsize = blob->size();
+    blob->resize(bsize + encode_buf.size());
+    memcpy(BeginPtr(*blob) + bsize,
+           BeginPtr(encode_buf), encode_buf.size());
+  } else {
+    size_t bsize = blob->size();
+    blob->resize(bsize + decode_buf.size());
+    memcpy(BeginPtr(*blob) + bsize,
+           BeginPtr(decode_buf), decode_buf.size());
+  }
+  return true;
+}
+
+/*! \brief the path of output with its .rec extension replaced by ext */
+std::string SidePath(std::string output, const char* ext) {
+  if (output.size() > 4 && output.compare(output.size() - 4, 4, ".rec") == 0) {
+    output.resize(output.size() - 4);
+  }
+  return output + ext;
+}
+
 int main(int argc, char *argv[]) {
   if (argc < 4) {
     printf("Usage: <image.lst> <image_root_dir> <output.rec> [additional parameters in form key=value]\n"\
            "Possible additional parameters:\n"\
            "\tcolor=USE_COLOR[default=1] Force color (1), gray image (0) or keep source unchanged (-1).\n"\
            "\tresize=newsize resize the shorter edge of image to the newsize, original images will be packed by default\n"\
+           "\tmax_size=MAX_SIZE[default=-1] shrink the longer edge of the images larger than MAX_SIZE to MAX_SIZE, after resize.\n"\
            "\tlabel_width=WIDTH[default=1] specify the label_width in the list, by default set to 1\n"\
            "\tpack_label=PACK_LABEL[default=0] whether to also pack multi dimenional label in the record file\n"\
            "\tnsplit=NSPLIT[default=1] used for part generation, logically split the image.list to NSPLIT parts by position\n"\
            "\tpart=PART[default=0] used for part generation, pack the images from the specific part in image.list\n"\
            "\tcenter_crop=CENTER_CROP[default=0] specify whether to crop the center image to make it square.\n"\
-           "\tquality=QUALITY[default=95] JPEG quality for encoding (1-100, default: 95) or PNG compression for encoding (1-9, default: 3).\n"\
-           "\tencoding=ENCODING[default='.jpg'] Encoding type. Can be '.jpg' or '.png'\n"\
+           "\tquality=QUALITY[default=95] JPEG or WebP quality for encoding (1-100, default: 95) or PNG compression for encoding (1-9, default: 3).\n"\
+           "\tencoding=ENCODING[default='.jpg'] Encoding type. Can be '.jpg', '.png' or '.webp' if OpenCV supports it\n"\
            "\tinter_method=INTER_METHOD[default=1] NN(0) BILINEAR(1) CUBIC(2) AREA(3) LANCZOS4(4) AUTO(9) RAND(10).\n"\
-           "\tunchanged=UNCHANGED[default=0] Keep the original image encoding, size and color. If set to 1, it will ignore the others parameters.\n");
+           "\tunchanged=UNCHANGED[default=0] Keep the original image encoding, size and color. If set to 1, it will ignore the others parameters.\n"\
+           "\tnum_thread=NUM_THREAD[default=number of cores] The number of threads decoding and encoding the images, which are written in the order of the list.\n"\
+           "\tchunk_size=CHUNK_SIZE[default=0] Also write a .chunks file of the first and end offsets and the number of records of every CHUNK_SIZE records, 0 to skip it.\n");
     return 0;
   }
-  int label_width = 1;
-  int pack_label = 0;
-  int new_size = -1;
+  PackOptions opt;
   int nsplit = 1;
   int partid = 0;
-  int center_crop = 0;
   int quality = 95;
-  int color_mode = CV_LOAD_IMAGE_COLOR;
-  int unchanged = 0;
-  int inter_method = CV_INTER_LINEAR;
-  std::string encoding(".jpg");
+  int num_thread = omp_get_num_procs();
+  size_t chunk_size = 0;
   for (int i = 4; i < argc; ++i) {
     char key[128], val[128];
     int effct_len = 0;
@@ -99,50 +234,60 @@ int main(int argc, char *argv[]) {
 #endif
 
     if (effct_len == 2) {
-      if (!strcmp(key, "resize")) new_size = atoi(val);
-      if (!strcmp(key, "label_width")) label_width = atoi(val);
-      if (!strcmp(key, "pack_label")) pack_label = atoi(val);
+      if (!strcmp(key, "resize")) opt.new_size = atoi(val);
+      if (!strcmp(key, "max_size")) opt.max_size = atoi(val);
+      if (!strcmp(key, "label_width")) opt.label_width = atoi(val);
+      if (!strcmp(key, "pack_label")) opt.pack_label = atoi(val);
       if (!strcmp(key, "nsplit")) nsplit = atoi(val);
       if (!strcmp(key, "part")) partid = atoi(val);
-      if (!strcmp(key, "center_crop")) center_crop = atoi(val);
+      if (!strcmp(key, "center_crop")) opt.center_crop = atoi(val);
       if (!strcmp(key, "quality")) quality = atoi(val);
-      if (!strcmp(key, "color")) color_mode = atoi(val);
-      if (!strcmp(key, "encoding")) encoding = std::string(val);
-      if (!strcmp(key, "unchanged")) unchanged = atoi(val);
-      if (!strcmp(key, "inter_method")) inter_method = atoi(val);
+      if (!strcmp(key, "color")) opt.color_mode = atoi(val);
+      if (!strcmp(key, "encoding")) opt.encoding = std::string(val);
+      if (!strcmp(key, "unchanged")) opt.unchanged = atoi(val);
+      if (!strcmp(key, "inter_method")) opt.inter_method = atoi(val);
+      if (!strcmp(key, "num_thread")) num_thread = atoi(val);
+      if (!strcmp(key, "chunk_size")) chunk_size = atoi(val);
     }
   }
   // Check parameters ranges
-  if (color_mode != -1 && color_mode != 0 && color_mode != 1) {
+  if (opt.color_mode != -1 && opt.color_mode != 0 && opt.color_mode != 1) {
     LOG(FATAL) << "Color mode must be -1, 0 or 1.";
   }
-  if (encoding != std::string(".jpg") && encoding != std::string(".png")) {
-    LOG(FATAL) << "Encoding mode must be .jpg or .png.";
+  if (opt.encoding != std::string(".jpg") && opt.encoding != std::string(".png") &&
+      opt.encoding != std::string(".webp")) {
+    LOG(FATAL) << "Encoding mode must be .jpg, .png or .webp.";
   }
-  if (label_width <= 1 && pack_label) {
+  if (opt.label_width <= 1 && opt.pack_label) {
     LOG(FATAL) << "pack_label can only be used when label_width > 1";
   }
-  if (new_size > 0) {
-    LOG(INFO) << "New Image Size: Short Edge " << new_size;
+  if (num_thread < 1) {
+    LOG(FATAL) << "num_thread must be at least 1";
+  }
+  if (opt.new_size > 0) {
+    LOG(INFO) << "New Image Size: Short Edge " << opt.new_size;
   } else {
     LOG(INFO) << "Keep origin image size";
   }
-  if (center_crop) {
+  if (opt.max_size > 0) {
+    LOG(INFO) << "Max Image Size: Long Edge " << opt.max_size;
+  }
+  if (opt.center_crop) {
     LOG(INFO) << "Center cropping to square";
   }
-  if (color_mode == 0) {
+  if (opt.color_mode == 0) {
     LOG(INFO) << "Use gray images";
   }
-  if (color_mode == -1) {
+  if (opt.color_mode == -1) {
     LOG(INFO) << "Keep original color mode";
   }
-  LOG(INFO) << "Encoding is " << encoding;
+  LOG(INFO) << "Encoding is " << opt.encoding;
 
-  if (encoding == std::string(".png") && quality > 9) {
+  if (opt.encoding == std::string(".png") && quality > 9) {
       quality = 3;
   }
-  if (inter_method != 1) {
-      switch (inter_method) {
+  if (opt.inter_method != 1) {
+      switch (opt.inter_method) {
         case 0:
             LOG(INFO) << "Use inter_method CV_INTER_NN";
             break;
@@ -167,11 +312,11 @@ int main(int argc, char *argv[]) {
       }
   }
   std::random_device rd;
-  std::mt19937 prnd(rd());
+  // one generator per thread, for inter_method=10
+  std::vector<std::mt19937> prnds;
+  for (int i = 0; i < num_thread; ++i) prnds.emplace_back(rd());
   using namespace dmlc;
-  const static size_t kBufferSize = 1 << 20UL;
-  std::string root = argv[2];
-  mxnet::io::ImageRecordIO rec;
+  opt.root = argv[2];
   size_t imcnt = 0;
   double tstart = dmlc::GetTime();
   dmlc::InputSplit *flist = dmlc::InputSplit::
@@ -186,116 +331,80 @@ int main(int argc, char *argv[]) {
   dmlc::Stream *fo = dmlc::Stream::Create(os.str().c_str(), "w");
   LOG(INFO) << "Output: " << os.str();
   dmlc::RecordIOWriter writer(fo);
-  std::string fname, path, blob;
-  std::vector<unsigned char> decode_buf;
-  std::vector<unsigned char> encode_buf;
-  std::vector<int> encode_params;
-  if (encoding == std::string(".png")) {
-      encode_params.push_back(CV_IMWRITE_PNG_COMPRESSION);
-      encode_params.push_back(quality);
+  // the index of the records, as python's MXIndexedRecordIO writes it
+  std::string idx_path = SidePath(os.str(), ".idx");
+  dmlc::Stream *fidx = dmlc::Stream::Create(idx_path.c_str(), "w");
+  LOG(INFO) << "Index: " << idx_path;
+  dmlc::Stream *fchunk = nullptr;
+  if (chunk_size > 0) {
+    std::string chunk_path = SidePath(os.str(), ".chunks");
+    fchunk = dmlc::Stream::Create(chunk_path.c_str(), "w");
+    LOG(INFO) << "Chunk index: " << chunk_path << ", " << chunk_size << " records per chunk";
+  }
+  if (opt.encoding == std::string(".png")) {
+      opt.encode_params.push_back(CV_IMWRITE_PNG_COMPRESSION);
+      opt.encode_params.push_back(quality);
       LOG(INFO) << "PNG encoding compression: " << quality;
+  } else if (opt.encoding == std::string(".webp")) {
+      opt.encode_params.push_back(CV_IMWRITE_WEBP_QUALITY);
+      opt.encode_params.push_back(quality);
+      std::vector<unsigned char> probe;
+      CHECK(cv::imencode(opt.encoding, cv::Mat(8, 8, CV_8UC3, cv::Scalar(0, 0, 0)), probe,
+                         opt.encode_params))
+          << "OpenCV is built without WebP";
+      LOG(INFO) << "WebP encoding quality: " << quality;
   } else {
-      encode_params.push_back(CV_IMWRITE_JPEG_QUALITY);
-      encode_params.push_back(quality);
+      opt.encode_params.push_back(CV_IMWRITE_JPEG_QUALITY);
+      opt.encode_params.push_back(quality);
       LOG(INFO) << "JPEG encoding quality: " << quality;
   }
+  LOG(INFO) << "Use " << num_thread << " threads";
   dmlc::InputSplit::Blob line;
-  std::vector<float> label_buf(label_width, 0.f);
-
-  while (flist->NextRecord(&line)) {
-    std::string sline(static_cast<char*>(line.dptr), line.size);
-    std::istringstream is(sline);
-    if (!(is >> rec.header.image_id[0] >> rec.header.label)) continue;
-    label_buf[0] = rec.header.label;
-    for (int k = 1; k < label_width; ++k) {
-      CHECK(is >> label_buf[k])
-          << "Invalid ImageList, did you provide the correct label_width?";
-    }
-    if (pack_label) rec.header.flag = label_width;
-    rec.SaveHeader(&blob);
-    if (pack_label) {
-      size_t bsize = blob.size();
-      blob.resize(bsize + label_buf.size()*sizeof(float));
-      memcpy(BeginPtr(blob) + bsize,
-             BeginPtr(label_buf), label_buf.size()*sizeof(float));
+  // the images are packed in batches, and written in the order of the list
+  const size_t kBatch = 64 * num_thread;
+  std::vector<std::string> lines, blobs(kBatch);
+  std::vector<uint64_t> image_ids(kBatch);
+  std::vector<char> packed(kBatch);
+  size_t chunk_begin = 0, chunk_count = 0;
+  bool more = true;
+  while (more) {
+    lines.clear();
+    while (lines.size() < kBatch && (more = flist->NextRecord(&line))) {
+      lines.emplace_back(static_cast<char*>(line.dptr), line.size);
     }
-    CHECK(std::getline(is, fname));
-    // eliminate invalid chars in the end
-    while (fname.length() != 0 &&
-           (isspace(*fname.rbegin()) || !isprint(*fname.rbegin()))) {
-      fname.resize(fname.length() - 1);
+    const int n = static_cast<int>(lines.size());
+    #pragma omp parallel for num_threads(num_thread) schedule(dynamic)
+    for (int i = 0; i < n; ++i) {
+      packed[i] = PackImage(lines[i], opt, &prnds[omp_get_thread_num()], &image_ids[i],
+                            &blobs[i]);
     }
-    // eliminate invalid chars in beginning.
-    const char *p = fname.c_str();
-    while (isspace(*p)) ++p;
-    path = root + p;
-    // use "r" is equal to rb in dmlc::Stream
-    dmlc::Stream *fi = dmlc::Stream::Create(path.c_str(), "r");
-    decode_buf.clear();
-    size_t imsize = 0;
-    while (true) {
-      decode_buf.resize(imsize + kBufferSize);
-      size_t nread = fi->Read(BeginPtr(decode_buf) + imsize, kBufferSize);
-      imsize += nread;
-      decode_buf.resize(imsize);
-      if (nread != kBufferSize) break;
-    }
-    delete fi;
-
-
-    if (unchanged != 1) {
-      cv::Mat img = cv::imdecode(decode_buf, color_mode);
-      CHECK(img.data != NULL) << "OpenCV decode fail:" << path;
-      cv::Mat res = img;
-      if (new_size > 0) {
-        if (center_crop) {
-          if (img.rows > img.cols) {
-            int margin = (img.rows - img.cols)/2;
-            img = img(cv::Range(margin, margin+img.cols), cv::Range(0, img.cols));
-          } else {
-            int margin = (img.cols - img.rows)/2;
-            img = img(cv::Range(0, img.rows), cv::Range(margin, margin + img.rows));
-          }
-        }
-        int interpolation_method = 1;
-        if (img.rows > img.cols) {
-            if (img.cols != new_size) {
-                interpolation_method = GetInterMethod(inter_method, img.cols, img.rows, new_size, img.rows * new_size / img.cols, prnd);
-                cv::resize(img, res, cv::Size(new_size, img.rows * new_size / img.cols), 0, 0, interpolation_method);
-            } else {
-                res = img.clone();
-            }
-        } else {
-            if (img.rows != new_size) {
-                interpolation_method = GetInterMethod(inter_method, img.cols, img.rows, new_size * img.cols / img.rows, new_size, prnd);
-                cv::resize(img, res, cv::Size(new_size * img.cols / img.rows, new_size), 0, 0, interpolation_method);
-            } else {
-                res = img.clone();
-            }
-        }
+    for (int i = 0; i < n; ++i) {
+      if (!packed[i]) continue;
+      if (chunk_count == 0) chunk_begin = writer.Tell();
+      std::ostringstream idx_line;
+      idx_line << image_ids[i] << '\t' << writer.Tell() << '\n';
+      fidx->Write(idx_line.str().c_str(), idx_line.str().size());
+      writer.WriteRecord(BeginPtr(blobs[i]), blobs[i].size());
+      if (fchunk != nullptr && ++chunk_count == chunk_size) {
+        std::ostringstream chunk_line;
+        chunk_line << chunk_begin << '\t' << writer.Tell() << '\t' << chunk_count << '\n';
+        fchunk->Write(chunk_line.str().c_str(), chunk_line.str().size());
+        chunk_count = 0;
+      }
+      ++imcnt;
+      if (imcnt % 1000 == 0) {
+        LOG(INFO) << imcnt << " images processed, " << GetTime() - tstart << " sec elapsed";
       }
-      encode_buf.clear();
-      CHECK(cv::imencode(encoding, res, encode_buf, encode_params));
-
-      // write buffer
-      size_t bsize = blob.size();
-      blob.resize(bsize + encode_buf.size());
-      memcpy(BeginPtr(blob) + bsize,
-             BeginPtr(encode_buf), encode_buf.size());
-    } else {
-      size_t bsize = blob.size();
-      blob.resize(bsize + decode_buf.size());
-      memcpy(BeginPtr(blob) + bsize,
-             BeginPtr(decode_buf), decode_buf.size());
-    }
-    writer.WriteRecord(BeginPtr(blob), blob.size());
-    // write header
-    ++imcnt;
-    if (imcnt % 1000 == 0) {
-      LOG(INFO) << imcnt << " images processed, " << GetTime() - tstart << " sec elapsed";
     }
   }
+  if (fchunk != nullptr && chunk_count != 0) {
+    std::ostringstream chunk_line;
+    chunk_line << chunk_begin << '\t' << writer.Tell() << '\t' << chunk_count << '\n';
+    fchunk->Write(chunk_line.str().c_str(), chunk_line.str().size());
+  }
   LOG(INFO) << "Total: " << imcnt << " images processed, " << GetTime() - tstart << " sec elapsed";
+  delete fchunk;
+  delete fidx;
   delete fo;
   delete flist;
   return 0;
@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+
+"""
+measure the per call overhead of imperative operators on small arrays, calling
+each operator from mx.nd, which parses its parameters and creates the operator
+on every call, and from an mx.nd.ImperativeOp, which parses them once and
+keeps the operator while the shapes of its arrays stay the same.
+
+The times are the medians, in microseconds per call, of --repeat rounds of
+--calls calls each, e.g.
+    python imperative_overhead.py --calls 1000 --ctx gpu
+"""
+import argparse
+import time
+import mxnet as mx
+
+# name, number of inputs, parameters and shapes of the inputs of each operator
+OPS = [
+    ('Convolution', 3, {'kernel': (3, 3), 'num_filter': 4, 'pad': (1, 1)},
+     [(1, 4, 8, 8), (4, 4, 3, 3), (4,)]),
+    ('FullyConnected', 3, {'num_hidden': 8}, [(2, 16), (8, 16), (8,)]),
+    ('BatchNorm', 5, {'fix_gamma': False}, [(2, 4, 8, 8), (4,), (4,), (4,), (4,)]),
+    ('Pooling', 1, {'kernel': (2, 2), 'stride': (2, 2), 'pool_type': 'max'}, [(1, 4, 8, 8)]),
+    ('Activation', 1, {'act_type': 'relu'}, [(2, 16)]),
+    ('SoftmaxOutput', 2, {}, [(2, 16), (2,)]),
+    ('Dropout', 1, {'p': 0.5}, [(2, 16)]),
+]
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    return values[n // 2] if n % 2 else 0.5 * (values[n // 2 - 1] + values[n // 2])
+
+def per_call(fn, calls, repeat):
+    """median time of a call of fn, in microseconds"""
+    fn().wait_to_read()
+    times = []
+    for _ in range(repeat):
+        tic = time.time()
+        for _ in range(calls):
+            out = fn()
+        out.wait_to_read()
+        times.append((time.time() - tic) / calls * 1e6)
+    return median(times)
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure the overhead of imperative operators')
+    parser.add_argument('--calls', type=int, default=500,
+                        help='the number of calls of a round')
+    parser.add_argument('--repeat', type=int, default=5,
+                        help='the number of rounds')
+    parser.add_argument('--ctx', type=str, default='cpu', choices=['cpu', 'gpu'],
+                        help='the device of the arrays')
+    args = parser.parse_args()
+    ctx = mx.gpu() if args.ctx == 'gpu' else mx.cpu()
+
+    print('%-15s %12s %14s' % ('operator', 'mx.nd(us)', 'ImperativeOp(us)'))
+    for name, num_inputs, params, shapes in OPS:
+        inputs = [mx.nd.ones(s, ctx=ctx) for s in shapes]
+        func = getattr(mx.nd, name)
+        handle = mx.nd.ImperativeOp(name, num_inputs, **params)
+        def call_nd():
+            out = func(*inputs, **params)
+            return out[0] if isinstance(out, list) else out
+        def call_handle():
+            out = handle(*inputs)
+            return out[0] if isinstance(out, list) else out
+        print('%-15s %12.1f %14.1f' % (
+            name, per_call(call_nd, args.calls, args.repeat),
+            per_call(call_handle, args.calls, args.repeat)))
+
+if __name__ == '__main__':
+    main()
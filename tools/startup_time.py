@@ -0,0 +1,115 @@
+#!/usr/bin/env python
+
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""
+measure the startup time of fresh processes: the import of mxnet, the first
+ndarray operation and the first forward of an executor.
+
+Each run is a new python process. With --budget the script fails when the
+median of a stage, in seconds, is over its budget, e.g.
+    python startup_time.py --runs 10 --budget import=0.5 --budget first_op=0.1
+"""
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+STAGES = ['import', 'first_op', 'first_forward']
+
+# runs in the child, prints the time of each stage and the number of threads
+CHILD = r'''
+import json, os, time
+def threads():
+    try:
+        with open('/proc/self/status') as f:
+            for line in f:
+                if line.startswith('Threads:'):
+                    return int(line.split()[1])
+    except IOError:
+        pass
+    return -1
+res = {}
+tic = time.time()
+import mxnet as mx
+res['import'] = time.time() - tic
+res['threads_after_import'] = threads()
+tic = time.time()
+a = mx.nd.ones((2, 2))
+(a + 1).wait_to_read()
+res['first_op'] = time.time() - tic
+tic = time.time()
+data = mx.sym.Variable('data')
+net = mx.sym.FullyConnected(data, num_hidden=8, name='fc')
+exe = net.simple_bind(mx.cpu(), data=(1, 4), grad_req='null')
+exe.forward(is_train=False)
+exe.outputs[0].wait_to_read()
+res['first_forward'] = time.time() - tic
+res['threads'] = threads()
+print('STARTUP ' + json.dumps(res))
+'''
+
+def run_once(python, env):
+    out = subprocess.check_output([python, '-c', CHILD], env=env)
+    for line in out.decode('utf-8').splitlines():
+        if line.startswith('STARTUP '):
+            return json.loads(line[len('STARTUP '):])
+    raise RuntimeError('no timing in the output of the child')
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    return values[n // 2] if n % 2 else 0.5 * (values[n // 2 - 1] + values[n // 2])
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure the startup time of mxnet')
+    parser.add_argument('--runs', type=int, default=5,
+                        help='the number of processes to start')
+    parser.add_argument('--python', type=str, default=sys.executable,
+                        help='the python interpreter of the processes')
+    parser.add_argument('--budget', type=str, action='append', default=[],
+                        help='stage=seconds, the largest median allowed for a stage')
+    args = parser.parse_args()
+
+    budgets = {}
+    for b in args.budget:
+        stage, sec = b.split('=')
+        assert stage in STAGES, 'unknown stage %s, the stages are %s' % (stage, STAGES)
+        budgets[stage] = float(sec)
+
+    env = dict(os.environ)
+    results = [run_once(args.python, env) for _ in range(args.runs)]
+
+    failed = False
+    print('%-15s %10s %10s %10s %10s' % ('stage', 'median(s)', 'min(s)', 'max(s)', 'budget'))
+    for stage in STAGES:
+        values = [r[stage] for r in results]
+        budget = budgets.get(stage)
+        over = budget is not None and median(values) > budget
+        failed = failed or over
+        print('%-15s %10.4f %10.4f %10.4f %10s%s' % (
+            stage, median(values), min(values), max(values),
+            '-' if budget is None else '%.4f' % budget, ' OVER' if over else ''))
+    print('threads after import: %d, after the forward: %d' % (
+        results[-1]['threads_after_import'], results[-1]['threads']))
+    if failed:
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()